@@ -0,0 +1,551 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/compat/regex.h>
+
+#include <ome/files/AllocationStatistics.h>
+#include <ome/files/Trace.h>
+
+#include "benchmark.h"
+
+#ifdef __linux__
+# include <unistd.h>
+#endif
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      namespace
+      {
+
+        // Largest batch of iterations between clock reads.
+        const uint64_t max_batch = 1000000U;
+
+        /// Result of running a benchmark.
+        struct Result
+        {
+          /// Benchmark name.
+          std::string name;
+          /// Number of iterations.
+          uint64_t iterations;
+          /// Mean time per iteration (nanoseconds).
+          double time;
+          /// Throughput (bytes per second), or 0 if unknown.
+          double bytesPerSecond;
+          /// Named counters.
+          State::counter_list counters;
+          /// Error message, if the benchmark failed.
+          std::string error;
+        };
+
+        // Escape a string for JSON output.
+        std::string
+        json_escape(const std::string& text)
+        {
+          std::ostringstream os;
+          for (const auto c : text)
+            {
+              switch (c)
+                {
+                case '"':
+                  os << "\\\"";
+                  break;
+                case '\\':
+                  os << "\\\\";
+                  break;
+                case '\n':
+                  os << "\\n";
+                  break;
+                default:
+                  if (static_cast<unsigned char>(c) < 0x20)
+                    os << boost::format("\\u%04x") % static_cast<unsigned int>(c);
+                  else
+                    os << c;
+                  break;
+                }
+            }
+          return os.str();
+        }
+
+        void
+        write_console(std::ostream&              os,
+                      const std::vector<Result>& results)
+        {
+          std::string::size_type width = 9U;
+          for (const auto& result : results)
+            width = std::max(width, result.name.size());
+
+          os << std::left << std::setw(static_cast<int>(width)) << "Benchmark"
+             << std::right << std::setw(16) << "Time (ns)"
+             << std::setw(14) << "Iterations"
+             << std::setw(16) << "MiB/s" << '\n';
+          for (const auto& result : results)
+            {
+              os << std::left << std::setw(static_cast<int>(width)) << result.name << std::right;
+              if (!result.error.empty())
+                {
+                  os << "  ERROR: " << result.error << '\n';
+                  continue;
+                }
+              os << std::setw(16) << std::fixed << std::setprecision(1) << result.time
+                 << std::setw(14) << result.iterations;
+              if (result.bytesPerSecond > 0.0)
+                os << std::setw(16) << std::setprecision(1) << result.bytesPerSecond / (1024.0 * 1024.0);
+              else if (!result.counters.empty())
+                os << std::setw(16) << "";
+              for (const auto& counter : result.counters)
+                os << "  " << counter.first << '=' << std::setprecision(0) << counter.second;
+              os << '\n';
+            }
+        }
+
+        void
+        write_csv(std::ostream&              os,
+                  const std::vector<Result>& results)
+        {
+          os << "name,iterations,real_time,time_unit,bytes_per_second,error_message\n";
+          for (const auto& result : results)
+            {
+              os << '"' << result.name << "\","
+                 << result.iterations << ','
+                 << std::fixed << std::setprecision(3) << result.time << ",ns,"
+                 << std::setprecision(0) << result.bytesPerSecond << ",\""
+                 << result.error << "\"\n";
+            }
+        }
+
+        void
+        write_json(std::ostream&              os,
+                   const std::vector<Result>& results)
+        {
+          os << "{\n  \"context\": {\n"
+             << "    \"library\": \"OME Files\",\n"
+             << "    \"library_build_type\": \"" <<
+#ifdef NDEBUG
+            "release"
+#else
+            "debug"
+#endif
+             << "\"\n  },\n  \"benchmarks\": [";
+          bool first = true;
+          for (const auto& result : results)
+            {
+              os << (first ? "\n" : ",\n")
+                 << "    {\n"
+                 << "      \"name\": \"" << json_escape(result.name) << "\",\n"
+                 << "      \"run_name\": \"" << json_escape(result.name) << "\",\n"
+                 << "      \"run_type\": \"iteration\",\n";
+              if (!result.error.empty())
+                os << "      \"error_occurred\": true,\n"
+                   << "      \"error_message\": \"" << json_escape(result.error) << "\",\n";
+              os << "      \"iterations\": " << result.iterations << ",\n"
+                 << "      \"real_time\": " << std::fixed << std::setprecision(3) << result.time << ",\n"
+                 << "      \"cpu_time\": " << result.time << ",\n"
+                 << "      \"time_unit\": \"ns\"";
+              if (result.bytesPerSecond > 0.0)
+                os << ",\n      \"bytes_per_second\": " << std::setprecision(0) << result.bytesPerSecond;
+              // Counters are reported as additional fields, as for
+              // Google Benchmark user counters.
+              for (const auto& counter : result.counters)
+                os << ",\n      \"" << json_escape(counter.first) << "\": "
+                   << std::setprecision(0) << counter.second;
+              os << "\n    }";
+              first = false;
+            }
+          os << "\n  ]\n}\n";
+        }
+
+        // Get the value of an option of the form --name=value.
+        bool
+        option_value(const std::string& arg,
+                     const std::string& name,
+                     std::string&       value)
+        {
+          const std::string prefix("--" + name + "=");
+          if (arg.compare(0, prefix.size(), prefix) != 0)
+            return false;
+          value = arg.substr(prefix.size());
+          return true;
+        }
+
+      }
+
+      State::State(clock::duration minTime,
+                   bool            memory):
+        minTime(minTime),
+        running(false),
+        start(),
+        pauseStart(),
+        paused(clock::duration::zero()),
+        elapsed(clock::duration::zero()),
+        iterations(0U),
+        batch(1U),
+        remaining(0U),
+        bytes(0U),
+        counters(),
+        memory(memory),
+        memoryStart(),
+        memoryPause(),
+        memoryPaused(),
+        heapStart(0U)
+      {
+      }
+
+      State::memory_counts
+      State::memoryCounts()
+      {
+        const HeapUsage heap(heapUsage());
+        return memory_counts{{heap.allocations,
+                              heap.bytes,
+                              AllocationStatistics::get(AllocationStatistics::TILE_BUFFER).allocations,
+                              AllocationStatistics::get(AllocationStatistics::PIXEL_BUFFER).allocations,
+                              AllocationStatistics::get(AllocationStatistics::METADATA_MAP).allocations}};
+      }
+
+      void
+      State::setMemoryCounters()
+      {
+        static const char *names[] =
+          {
+            "allocs_per_iter",
+            "alloc_bytes_per_iter",
+            "tile_buffer_allocs_per_iter",
+            "pixel_buffer_allocs_per_iter",
+            "metadata_map_entries_per_iter"
+          };
+
+        const memory_counts end(memoryCounts());
+        const double count = iterations ? static_cast<double>(iterations) : 1.0;
+        for (memory_counts::size_type i = 0; i < end.size(); ++i)
+          setCounter(names[i],
+                     static_cast<double>(end[i] - memoryStart[i] - memoryPaused[i]) / count);
+
+        const uint64_t peak = heapUsage().peak;
+        setCounter("peak_heap_bytes",
+                   static_cast<double>(peak > heapStart ? peak - heapStart : 0U));
+        setCounter("peak_rss_bytes", static_cast<double>(peakResidentMemory()));
+      }
+
+      bool
+      State::nextBatch()
+      {
+        const clock::time_point now(clock::now());
+
+        if (!running)
+          {
+            running = true;
+            if (memory)
+              {
+                resetHeapPeak();
+                heapStart = heapUsage().live;
+                memoryStart = memoryCounts();
+              }
+            start = clock::now();
+          }
+        else
+          {
+            iterations += batch;
+            elapsed = now - start - paused;
+            if (elapsed >= minTime)
+              {
+                if (memory)
+                  setMemoryCounters();
+                return false;
+              }
+            batch = std::min(batch * 2U, max_batch);
+          }
+
+        remaining = batch - 1U;
+        return true;
+      }
+
+      void
+      State::pauseTiming()
+      {
+        pauseStart = clock::now();
+        if (memory)
+          memoryPause = memoryCounts();
+      }
+
+      void
+      State::resumeTiming()
+      {
+        if (memory)
+          {
+            const memory_counts current(memoryCounts());
+            for (memory_counts::size_type i = 0; i < current.size(); ++i)
+              memoryPaused[i] += current[i] - memoryPause[i];
+          }
+        paused += clock::now() - pauseStart;
+      }
+
+      void
+      State::setBytesProcessed(uint64_t bytes)
+      {
+        this->bytes = bytes;
+      }
+
+      void
+      State::setCounter(const std::string& name,
+                        double             value)
+      {
+        for (auto& counter : counters)
+          {
+            if (counter.first == name)
+              {
+                counter.second = value;
+                return;
+              }
+          }
+        counters.push_back(std::make_pair(name, value));
+      }
+
+      uint64_t
+      State::getIterations() const
+      {
+        return iterations;
+      }
+
+      State::clock::duration
+      State::getElapsed() const
+      {
+        return elapsed;
+      }
+
+      uint64_t
+      State::getBytesProcessed() const
+      {
+        return bytes;
+      }
+
+      const State::counter_list&
+      State::getCounters() const
+      {
+        return counters;
+      }
+
+      uint64_t
+      residentMemory()
+      {
+#ifdef __linux__
+        // The second field of statm is the resident size in pages.
+        std::FILE *statm = std::fopen("/proc/self/statm", "r");
+        if (!statm)
+          return 0U;
+        unsigned long size = 0U;
+        unsigned long resident = 0U;
+        const int fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+        std::fclose(statm);
+        if (fields != 2)
+          return 0U;
+        return static_cast<uint64_t>(resident) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#else
+        return 0U;
+#endif
+      }
+
+      Registry::Registry():
+        benchmarks()
+      {
+      }
+
+      void
+      Registry::add(const std::string&   name,
+                    const function_type& function)
+      {
+        benchmarks.push_back(Benchmark{name, function});
+      }
+
+      int
+      Registry::run(int   argc,
+                    char *argv[])
+      {
+        std::string filter(".*");
+        double minTime = 0.5;
+        std::string format("console");
+        std::string output;
+        std::string trace;
+        bool memory = false;
+        bool list = false;
+
+        for (int i = 1; i < argc; ++i)
+          {
+            const std::string arg(argv[i]);
+            std::string value;
+            if (option_value(arg, "filter", value))
+              filter = value;
+            else if (option_value(arg, "min-time", value))
+              minTime = std::stod(value);
+            else if (option_value(arg, "format", value))
+              format = value;
+            else if (option_value(arg, "output", value))
+              output = value;
+            else if (option_value(arg, "trace", value))
+              trace = value;
+            else if (arg == "--memory")
+              memory = true;
+            else if (arg == "--list")
+              list = true;
+            else
+              {
+                std::cerr << "Usage: " << argv[0]
+                          << " [--filter=REGEX] [--min-time=SECONDS] [--format=console|csv|json] [--output=FILE] [--trace=FILE] [--memory] [--list]\n";
+                return 2;
+              }
+          }
+
+        if (format != "console" && format != "csv" && format != "json")
+          {
+            std::cerr << "Unknown format: " << format << '\n';
+            return 2;
+          }
+
+        // Trace events are written for the duration of the run.
+        struct TraceGuard
+        {
+          ~TraceGuard() { ome::files::setTraceSink(std::shared_ptr<ome::files::TraceSink>()); }
+        } traceguard;
+        if (!trace.empty())
+          {
+            if (!ome::files::traceEnabled())
+              std::cerr << "Warning: library built without tracing; " << trace << " will be empty\n";
+            try
+              {
+                ome::files::setTraceSink(std::make_shared<ome::files::ChromeTraceSink>(trace));
+              }
+            catch (const std::exception& e)
+              {
+                std::cerr << e.what() << '\n';
+                return 1;
+              }
+          }
+
+        // Library allocations are only counted when measuring memory.
+        struct StatisticsGuard
+        {
+          ~StatisticsGuard() { ome::files::AllocationStatistics::setEnabled(false); }
+        } statisticsguard;
+        if (memory)
+          ome::files::AllocationStatistics::setEnabled(true);
+
+        const ome::compat::regex match(filter);
+        const State::clock::duration duration
+          (std::chrono::duration_cast<State::clock::duration>(std::chrono::duration<double>(minTime)));
+
+        std::vector<Result> results;
+        bool failed = false;
+        for (const auto& benchmark : benchmarks)
+          {
+            if (!ome::compat::regex_search(benchmark.name, match))
+              continue;
+            if (list)
+              {
+                std::cout << benchmark.name << '\n';
+                continue;
+              }
+
+            Result result{benchmark.name, 0U, 0.0, 0.0, State::counter_list(), std::string()};
+            try
+              {
+                if (memory)
+                  resetPeakResidentMemory();
+                State state(duration, memory);
+                benchmark.function(state);
+                const double seconds = std::chrono::duration<double>(state.getElapsed()).count();
+                result.iterations = state.getIterations();
+                if (result.iterations)
+                  result.time = seconds * 1.0e9 / static_cast<double>(result.iterations);
+                if (seconds > 0.0)
+                  result.bytesPerSecond = static_cast<double>(state.getBytesProcessed()) *
+                    static_cast<double>(result.iterations) / seconds;
+                result.counters = state.getCounters();
+              }
+            catch (const std::exception& e)
+              {
+                result.error = e.what();
+                failed = true;
+              }
+            results.push_back(result);
+
+            // Report progress when writing to a file.
+            if (!output.empty())
+              std::cerr << result.name << (result.error.empty() ? "" : " (failed)") << '\n';
+          }
+
+        if (list)
+          return 0;
+
+        std::ofstream file;
+        if (!output.empty())
+          {
+            file.open(output.c_str());
+            if (!file)
+              {
+                std::cerr << "Failed to open " << output << '\n';
+                return 1;
+              }
+          }
+        std::ostream& os(output.empty() ? std::cout : file);
+
+        if (format == "json")
+          write_json(os, results);
+        else if (format == "csv")
+          write_csv(os, results);
+        else
+          write_console(os, results);
+
+        return failed ? 1 : 0;
+      }
+
+    }
+  }
+}
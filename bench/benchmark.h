@@ -0,0 +1,416 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_BENCH_BENCHMARK_H
+#define OME_FILES_BENCH_BENCHMARK_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      /**
+       * Benchmark state.
+       *
+       * A benchmark function is passed the state, and repeats the
+       * operation being timed while keepRunning() returns @c true.
+       * Iterations are run in batches of increasing size, so that
+       * the clock is not read on every iteration of a very short
+       * operation.  Setup which should not be timed may be excluded
+       * with pauseTiming() and resumeTiming().
+       *
+       * If memory measurement is enabled, heap allocations and
+       * library buffer allocations made while timing are counted,
+       * and reported per iteration as counters once the benchmark
+       * completes.
+       */
+      class State
+      {
+      public:
+        /// Clock used for timing.
+        typedef std::chrono::steady_clock clock;
+
+        /**
+         * Constructor.
+         *
+         * @param minTime the minimum time to run for.
+         * @param memory @c true to measure memory use.
+         */
+        explicit
+        State(clock::duration minTime,
+              bool            memory = false);
+
+        /**
+         * Check if another iteration should be run.
+         *
+         * @returns @c true to run another iteration, or @c false
+         * once the minimum time has elapsed.
+         */
+        bool
+        keepRunning()
+        {
+          if (remaining)
+            {
+              --remaining;
+              return true;
+            }
+          return nextBatch();
+        }
+
+        /// Stop the timer.
+        void
+        pauseTiming();
+
+        /// Restart the timer.
+        void
+        resumeTiming();
+
+        /**
+         * Set the number of bytes processed by each iteration.
+         *
+         * @param bytes the number of bytes.
+         */
+        void
+        setBytesProcessed(uint64_t bytes);
+
+        /**
+         * Set a named counter to report with the result.
+         *
+         * Counters record measurements other than time, such as
+         * memory use or file size.  Setting an existing counter
+         * replaces its value.
+         *
+         * @param name the counter name.
+         * @param value the counter value.
+         */
+        void
+        setCounter(const std::string& name,
+                   double             value);
+
+        /**
+         * Get the number of iterations run.
+         *
+         * @returns the number of iterations.
+         */
+        uint64_t
+        getIterations() const;
+
+        /**
+         * Get the time taken, excluding paused time.
+         *
+         * @returns the time taken.
+         */
+        clock::duration
+        getElapsed() const;
+
+        /**
+         * Get the number of bytes processed by each iteration.
+         *
+         * @returns the number of bytes, or @c 0 if not set.
+         */
+        uint64_t
+        getBytesProcessed() const;
+
+        /// Named counters.
+        typedef std::vector<std::pair<std::string, double>> counter_list;
+
+        /**
+         * Get the named counters, in the order first set.
+         *
+         * @returns the counters.
+         */
+        const counter_list&
+        getCounters() const;
+
+      private:
+        /**
+         * Complete the current batch and start the next.
+         *
+         * @returns @c true to run another iteration, or @c false
+         * once the minimum time has elapsed.
+         */
+        bool
+        nextBatch();
+
+        /// Memory counts: heap allocations, heap bytes and library allocations.
+        typedef std::array<uint64_t, 5> memory_counts;
+
+        /**
+         * Get the current memory counts.
+         *
+         * @returns the counts.
+         */
+        static memory_counts
+        memoryCounts();
+
+        /// Set the memory counters for the completed run.
+        void
+        setMemoryCounters();
+
+        /// Minimum time to run for.
+        clock::duration minTime;
+        /// The timer has been started.
+        bool running;
+        /// Start of timing.
+        clock::time_point start;
+        /// Start of the current pause.
+        clock::time_point pauseStart;
+        /// Total time paused.
+        clock::duration paused;
+        /// Time taken, excluding paused time.
+        clock::duration elapsed;
+        /// Iterations completed.
+        uint64_t iterations;
+        /// Size of the current batch.
+        uint64_t batch;
+        /// Iterations remaining in the current batch.
+        uint64_t remaining;
+        /// Bytes processed by each iteration.
+        uint64_t bytes;
+        /// Named counters.
+        counter_list counters;
+        /// Measure memory use.
+        bool memory;
+        /// Memory counts at the start of timing.
+        memory_counts memoryStart;
+        /// Memory counts at the start of the current pause.
+        memory_counts memoryPause;
+        /// Memory counts accumulated while paused.
+        memory_counts memoryPaused;
+        /// Live heap size at the start of timing.
+        uint64_t heapStart;
+      };
+
+      /// A benchmark function.
+      typedef std::function<void (State&)> function_type;
+
+      /**
+       * Set of benchmarks.
+       *
+       * Benchmarks are registered by name, and run in registration
+       * order.  Parameterised benchmarks should include the
+       * parameters in the name, separated by @c /, so that they may
+       * be selected with a filter.
+       */
+      class Registry
+      {
+      public:
+        /// Constructor.
+        Registry();
+
+        /**
+         * Register a benchmark.
+         *
+         * @param name the benchmark name.
+         * @param function the benchmark function.
+         */
+        void
+        add(const std::string&   name,
+            const function_type& function);
+
+        /**
+         * Run the benchmarks and report the results.
+         *
+         * Options:
+         * - @c --filter=REGEX run only the benchmarks whose names
+         *   match the regular expression.
+         * - @c --min-time=SECONDS the minimum time to run each
+         *   benchmark for (default 0.5).
+         * - @c --format=console|csv|json the result format.
+         * - @c --output=FILE write the results to a file rather than
+         *   standard output.
+         * - @c --trace=FILE write trace events to a file.
+         * - @c --memory report allocation counts, peak heap size and
+         *   peak resident size for each benchmark.
+         * - @c --list list the benchmark names without running them.
+         *
+         * The JSON format follows the layout used by Google
+         * Benchmark, so that its comparison tools may be used.
+         *
+         * @param argc the number of arguments.
+         * @param argv the arguments.
+         * @returns the process exit status.
+         */
+        int
+        run(int   argc,
+            char *argv[]);
+
+      private:
+        /// A registered benchmark.
+        struct Benchmark
+        {
+          /// Name.
+          std::string name;
+          /// Function.
+          function_type function;
+        };
+
+        /// Registered benchmarks.
+        std::vector<Benchmark> benchmarks;
+      };
+
+      /**
+       * Prevent the compiler from optimising away a value.
+       *
+       * @param value the value to keep.
+       */
+      template<typename T>
+      inline void
+      doNotOptimize(const T& value)
+      {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const T *sink;
+        sink = &value;
+#endif
+      }
+
+      /**
+       * Get the resident memory size of this process.
+       *
+       * @returns the size in bytes, or @c 0 if it is not available
+       * on this platform.
+       */
+      uint64_t
+      residentMemory();
+
+      /**
+       * Get the peak resident memory size of this process.
+       *
+       * @returns the size in bytes, or @c 0 if it is not available
+       * on this platform.
+       */
+      uint64_t
+      peakResidentMemory();
+
+      /**
+       * Reset the peak resident memory size to the current size.
+       *
+       * This has no effect on platforms where the peak may not be
+       * reset.
+       */
+      void
+      resetPeakResidentMemory();
+
+      /// Heap usage, counted by the replaced global allocation functions.
+      struct HeapUsage
+      {
+        /// Total number of allocations.
+        uint64_t allocations;
+        /// Total number of bytes allocated.
+        uint64_t bytes;
+        /// Number of bytes currently allocated.
+        uint64_t live;
+        /// Peak number of bytes allocated.
+        uint64_t peak;
+      };
+
+      /**
+       * Get the heap usage of this process.
+       *
+       * @returns the heap usage.
+       */
+      HeapUsage
+      heapUsage();
+
+      /// Reset the peak heap usage to the current usage.
+      void
+      resetHeapPeak();
+
+      /**
+       * Register the synthetic dataset benchmarks.
+       *
+       * @param registry the registry to add to.
+       */
+      void
+      registerDatasetBenchmarks(Registry& registry);
+
+      /**
+       * Register the OME-XML benchmarks.
+       *
+       * @param registry the registry to add to.
+       */
+      void
+      registerOMEXMLBenchmarks(Registry& registry);
+
+      /**
+       * Register the pixel buffer benchmarks.
+       *
+       * @param registry the registry to add to.
+       */
+      void
+      registerPixelBufferBenchmarks(Registry& registry);
+
+      /**
+       * Register the TIFF read and write benchmarks.
+       *
+       * @param registry the registry to add to.
+       */
+      void
+      registerTIFFBenchmarks(Registry& registry);
+
+      /**
+       * Register the tile coverage benchmarks.
+       *
+       * @param registry the registry to add to.
+       */
+      void
+      registerTileCoverageBenchmarks(Registry& registry);
+
+    }
+  }
+}
+
+#endif // OME_FILES_BENCH_BENCHMARK_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,303 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/OMETIFFReader.h>
+
+#include "benchmark.h"
+#include "generator.h"
+
+using ome::files::PlaneRegion;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+using ome::files::in::OMETIFFReader;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      namespace
+      {
+
+        // A temporary directory, removed with its contents on
+        // destruction.
+        class TemporaryDirectory
+        {
+        public:
+          TemporaryDirectory():
+            path(boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path("ome-files-bench-%%%%-%%%%-%%%%"))
+          {
+          }
+
+          ~TemporaryDirectory()
+          {
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(path, ec);
+          }
+
+          boost::filesystem::path path;
+        };
+
+        // Report the size and memory use of an open dataset.
+        void
+        set_dataset_counters(State&                         state,
+                             const boost::filesystem::path& dir,
+                             const DatasetSpec&             spec,
+                             uint64_t                       baseMemory)
+        {
+          uint64_t bytes = 0U;
+          for (boost::filesystem::directory_iterator i(dir), end; i != end; ++i)
+            bytes += boost::filesystem::file_size(i->path());
+
+          state.setCounter("ifds", static_cast<double>(spec.series * spec.planeCount()));
+          state.setCounter("file_bytes", static_cast<double>(bytes));
+          const uint64_t memory = residentMemory();
+          if (memory > baseMemory)
+            state.setCounter("reader_memory_bytes", static_cast<double>(memory - baseMemory));
+        }
+
+        // Open a dataset.
+        void
+        open(State&             state,
+             const DatasetSpec& spec)
+        {
+          TemporaryDirectory dir;
+          const boost::filesystem::path file(generateDataset(dir.path, spec));
+
+          while (state.keepRunning())
+            {
+              OMETIFFReader reader;
+              reader.setId(file);
+              doNotOptimize(reader.getSeriesCount());
+              reader.close();
+            }
+
+          const uint64_t baseMemory = residentMemory();
+          OMETIFFReader reader;
+          reader.setId(file);
+          set_dataset_counters(state, dir.path, spec, baseMemory);
+        }
+
+        // Write a dataset.  Each iteration writes to a new
+        // directory, which is removed untimed.
+        void
+        write(State&             state,
+              const DatasetSpec& spec)
+        {
+          TemporaryDirectory dir;
+          uint64_t count = 0U;
+
+          while (state.keepRunning())
+            {
+              const boost::filesystem::path subdir(dir.path / std::to_string(count++));
+              boost::filesystem::create_directory(subdir);
+              doNotOptimize(generateDataset(subdir, spec));
+
+              state.pauseTiming();
+              boost::filesystem::remove_all(subdir);
+              state.resumeTiming();
+            }
+        }
+
+        // Close an open dataset.  Opening is not timed.
+        void
+        close(State&             state,
+              const DatasetSpec& spec)
+        {
+          TemporaryDirectory dir;
+          const boost::filesystem::path file(generateDataset(dir.path, spec));
+
+          while (state.keepRunning())
+            {
+              state.pauseTiming();
+              OMETIFFReader reader;
+              reader.setId(file);
+              state.resumeTiming();
+
+              reader.close();
+            }
+        }
+
+        // Read regions of randomly chosen planes of a dataset.  A
+        // size of zero reads whole planes.
+        void
+        read(State&              state,
+             const DatasetSpec&  spec,
+             dimension_size_type size)
+        {
+          TemporaryDirectory dir;
+          const boost::filesystem::path file(generateDataset(dir.path, spec));
+
+          const dimension_size_type w = size ? std::min(size, spec.sizeX) : spec.sizeX;
+          const dimension_size_type h = size ? std::min(size, spec.sizeY) : spec.sizeY;
+
+          // Choose the reads up front, so that the random number
+          // generation is not timed.
+          struct Read
+          {
+            dimension_size_type series;
+            dimension_size_type plane;
+            PlaneRegion region;
+          };
+          std::vector<Read> reads;
+          std::mt19937_64 random(spec.seed);
+          for (dimension_size_type i = 0U; i < 1024U; ++i)
+            {
+              Read r;
+              r.series = random() % spec.series;
+              r.plane = random() % spec.planeCount();
+              r.region = PlaneRegion(random() % (spec.sizeX - w + 1U),
+                                     random() % (spec.sizeY - h + 1U),
+                                     w, h);
+              reads.push_back(r);
+            }
+
+          const uint64_t baseMemory = residentMemory();
+          OMETIFFReader reader;
+          reader.setId(file);
+
+          VariantPixelBuffer buf;
+          state.setBytesProcessed(w * h * bytesPerPixel(spec.pixelType));
+          std::vector<Read>::size_type next = 0U;
+          while (state.keepRunning())
+            {
+              const Read& r(reads[next]);
+              reader.openBytesAt(r.series, 0U, r.plane, buf, r.region);
+              doNotOptimize(buf.data());
+              next = (next + 1U) % reads.size();
+            }
+
+          set_dataset_counters(state, dir.path, spec, baseMemory);
+        }
+
+        // Register the benchmarks for a dataset.
+        void
+        add_dataset(Registry&           registry,
+                    const std::string&  name,
+                    const DatasetSpec&  spec,
+                    dimension_size_type region)
+        {
+          registry.add("Dataset/open/" + name,
+                       [=](State& state) { open(state, spec); });
+          registry.add("Dataset/openBytes/" + name,
+                       [=](State& state) { read(state, spec, 0U); });
+          registry.add("Dataset/write/" + name,
+                       [=](State& state) { write(state, spec); });
+          registry.add("Dataset/close/" + name,
+                       [=](State& state) { close(state, spec); });
+          if (region)
+            registry.add("Dataset/openBytes/" + name + "/region:" + std::to_string(region),
+                         [=](State& state) { read(state, spec, region); });
+        }
+
+      }
+
+      void
+      registerDatasetBenchmarks(Registry& registry)
+      {
+        // Many IFDs in one file.
+        for (const dimension_size_type ifds : {100U, 1000U, 10000U})
+          {
+            DatasetSpec spec;
+            spec.sizeX = spec.sizeY = 64U;
+            spec.sizeZ = ifds;
+            add_dataset(registry, "ifds:" + std::to_string(ifds), spec, 0U);
+          }
+
+        // Many files.
+        for (const dimension_size_type files : {10U, 100U, 1000U})
+          {
+            DatasetSpec spec;
+            spec.sizeX = spec.sizeY = 64U;
+            spec.sizeZ = files;
+            spec.files = files;
+            add_dataset(registry, "files:" + std::to_string(files), spec, 0U);
+          }
+
+        // Large OME-XML.
+        for (const dimension_size_type annotations : {1000U, 10000U, 100000U})
+          {
+            DatasetSpec spec;
+            spec.sizeX = spec.sizeY = 64U;
+            spec.annotations = annotations;
+            registry.add("Dataset/open/annotations:" + std::to_string(annotations),
+                         [=](State& state) { open(state, spec); });
+          }
+
+        // Large tiled planes.
+        for (const dimension_size_type size : {2048U, 8192U})
+          {
+            DatasetSpec spec;
+            spec.sizeX = spec.sizeY = size;
+            spec.pixelType = ome::xml::model::enums::PixelType::UINT16;
+            spec.tileSize = 256U;
+            registry.add("Dataset/openBytes/size:" + std::to_string(size) + "/region:256",
+                         [=](State& state) { read(state, spec, 256U); });
+          }
+
+        // Larger datasets (for example x=100000,y=100000,tile=1024
+        // or z=50000 or z=5000,files=5000) may be specified in the
+        // environment, since they take too long to generate for
+        // every run.
+        const char *custom = std::getenv("OME_FILES_BENCH_DATASET");
+        if (custom && *custom)
+          {
+            const DatasetSpec spec(parseDatasetSpec(custom));
+            add_dataset(registry, "custom:" + formatDatasetSpec(spec), spec,
+                        spec.tileSize ? spec.tileSize : 256U);
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,381 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/out/OMETIFFWriter.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+#include <ome/xml/model/enums/DimensionOrder.h>
+
+#include "generator.h"
+
+#ifndef _MSC_VER
+# include <sys/resource.h>
+#endif
+
+using ome::files::CoreMetadata;
+using ome::files::PixelBufferBase;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+using ome::files::out::OMETIFFWriter;
+using ome::xml::meta::OMEXMLMetadata;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      namespace
+      {
+
+        // Rows written in each call to saveBytes when not tiled.
+        const dimension_size_type band_rows = 256U;
+
+        // Fill a band of rows with a pattern offset for each plane.
+        struct PatternVisitor
+        {
+          typedef void result_type;
+
+          uint64_t offset;
+          dimension_size_type y;
+
+          template<typename T>
+          void
+          operator() (T& v) const
+          {
+            typedef typename T::element_type::value_type value_type;
+
+            const auto shape = v->shape();
+            const dimension_size_type width = shape[DIM_SPATIAL_X];
+            const dimension_size_type height = shape[DIM_SPATIAL_Y];
+            value_type *data = v->data();
+            for (dimension_size_type row = 0U; row < height; ++row)
+              for (dimension_size_type col = 0U; col < width; ++col)
+                *data++ = static_cast<value_type>((col + (y + row) * 3U + offset) % 251U);
+          }
+        };
+
+        // Parse a size value.
+        dimension_size_type
+        parse_size(const std::string& key,
+                   const std::string& value)
+        {
+          std::istringstream is(value);
+          dimension_size_type size = 0U;
+          if (!(is >> size) || !is.eof())
+            {
+              boost::format fmt("Invalid value ‘%1%’ for dataset key ‘%2%’");
+              fmt % value % key;
+              throw std::runtime_error(fmt.str());
+            }
+          return size;
+        }
+
+        // Allow the writer to hold all the files of the dataset open.
+        void
+        raise_file_limit(dimension_size_type files)
+        {
+#ifndef _MSC_VER
+          struct rlimit limit;
+          if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+              limit.rlim_cur != RLIM_INFINITY &&
+              limit.rlim_cur < files + 64U)
+            {
+              limit.rlim_cur = limit.rlim_max;
+              setrlimit(RLIMIT_NOFILE, &limit);
+            }
+#else
+          static_cast<void>(files);
+#endif
+        }
+
+        // Name of a file of the dataset.
+        boost::filesystem::path
+        file_name(const boost::filesystem::path& dir,
+                  const DatasetSpec&             spec,
+                  dimension_size_type            file)
+        {
+          if (spec.files == 1U)
+            return dir / "dataset.ome.tif";
+          return dir / (boost::format("dataset-%05d.ome.tif") % file).str();
+        }
+
+      }
+
+      DatasetSpec::DatasetSpec():
+        seed(0U),
+        series(1U),
+        sizeX(512U),
+        sizeY(512U),
+        sizeZ(1U),
+        sizeC(1U),
+        sizeT(1U),
+        pixelType(PixelType::UINT8),
+        files(1U),
+        tileSize(0U),
+        compression(),
+        annotations(0U)
+      {
+      }
+
+      dimension_size_type
+      DatasetSpec::planeCount() const
+      {
+        return sizeZ * sizeC * sizeT;
+      }
+
+      DatasetSpec
+      parseDatasetSpec(const std::string& text)
+      {
+        DatasetSpec spec;
+
+        std::istringstream is(text);
+        std::string item;
+        while (std::getline(is, item, ','))
+          {
+            if (item.empty())
+              continue;
+            const std::string::size_type sep = item.find('=');
+            if (sep == std::string::npos)
+              {
+                boost::format fmt("Invalid dataset specification item ‘%1%’");
+                fmt % item;
+                throw std::runtime_error(fmt.str());
+              }
+            const std::string key(item.substr(0, sep));
+            const std::string value(item.substr(sep + 1));
+
+            if (key == "seed")
+              spec.seed = parse_size(key, value);
+            else if (key == "series")
+              spec.series = parse_size(key, value);
+            else if (key == "x")
+              spec.sizeX = parse_size(key, value);
+            else if (key == "y")
+              spec.sizeY = parse_size(key, value);
+            else if (key == "z")
+              spec.sizeZ = parse_size(key, value);
+            else if (key == "c")
+              spec.sizeC = parse_size(key, value);
+            else if (key == "t")
+              spec.sizeT = parse_size(key, value);
+            else if (key == "type")
+              spec.pixelType = PixelType(value);
+            else if (key == "files")
+              spec.files = parse_size(key, value);
+            else if (key == "tile")
+              spec.tileSize = parse_size(key, value);
+            else if (key == "compression")
+              spec.compression = value;
+            else if (key == "annotations")
+              spec.annotations = parse_size(key, value);
+            else
+              {
+                boost::format fmt("Unknown dataset key ‘%1%’");
+                fmt % key;
+                throw std::runtime_error(fmt.str());
+              }
+          }
+
+        if (!spec.series || !spec.sizeX || !spec.sizeY || !spec.planeCount() || !spec.files)
+          throw std::runtime_error("Dataset dimensions and file count must be nonzero");
+        if (spec.files > spec.series * spec.planeCount())
+          throw std::runtime_error("Dataset has more files than planes");
+
+        return spec;
+      }
+
+      std::string
+      formatDatasetSpec(const DatasetSpec& spec)
+      {
+        const DatasetSpec defaults;
+        std::ostringstream os;
+        const char *sep = "";
+
+        const auto size = [&](const char *key, uint64_t value, uint64_t fallback)
+          {
+            if (value != fallback)
+              {
+                os << sep << key << '=' << value;
+                sep = ",";
+              }
+          };
+
+        size("seed", spec.seed, defaults.seed);
+        size("series", spec.series, defaults.series);
+        size("x", spec.sizeX, defaults.sizeX);
+        size("y", spec.sizeY, defaults.sizeY);
+        size("z", spec.sizeZ, defaults.sizeZ);
+        size("c", spec.sizeC, defaults.sizeC);
+        size("t", spec.sizeT, defaults.sizeT);
+        if (spec.pixelType != defaults.pixelType)
+          {
+            os << sep << "type=" << spec.pixelType;
+            sep = ",";
+          }
+        size("files", spec.files, defaults.files);
+        size("tile", spec.tileSize, defaults.tileSize);
+        if (spec.compression)
+          {
+            os << sep << "compression=" << *spec.compression;
+            sep = ",";
+          }
+        size("annotations", spec.annotations, defaults.annotations);
+
+        return os.str();
+      }
+
+      boost::filesystem::path
+      generateDataset(const boost::filesystem::path& dir,
+                      const DatasetSpec&             spec)
+      {
+        if (!spec.series || !spec.sizeX || !spec.sizeY || !spec.planeCount() || !spec.files)
+          throw std::runtime_error("Dataset dimensions and file count must be nonzero");
+        const dimension_size_type total = spec.series * spec.planeCount();
+        if (spec.files > total)
+          throw std::runtime_error("Dataset has more files than planes");
+
+        boost::filesystem::create_directories(dir);
+        raise_file_limit(spec.files);
+
+        std::mt19937_64 random(spec.seed);
+
+        std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+        for (dimension_size_type s = 0U; s < spec.series; ++s)
+          {
+            std::shared_ptr<CoreMetadata> core(std::make_shared<CoreMetadata>());
+            core->sizeX = spec.sizeX;
+            core->sizeY = spec.sizeY;
+            core->sizeZ = spec.sizeZ;
+            core->sizeT = spec.sizeT;
+            core->sizeC.assign(spec.sizeC, 1U);
+            core->pixelType = spec.pixelType;
+            core->bitsPerPixel = significantBitsPerPixel(spec.pixelType);
+            core->dimensionOrder = DimensionOrder::XYZCT;
+            core->interleaved = false;
+            seriesList.push_back(core);
+          }
+
+        std::shared_ptr<OMEXMLMetadata> meta(std::make_shared<OMEXMLMetadata>());
+        fillMetadata(*meta, seriesList);
+        // Unlinked annotations, to inflate the OME-XML.
+        for (dimension_size_type a = 0U; a < spec.annotations; ++a)
+          {
+            meta->setLongAnnotationID(createID("Annotation", a), a);
+            meta->setLongAnnotationValue(static_cast<int64_t>(random() >> 1U), a);
+          }
+
+        OMETIFFWriter writer;
+        writer.setMetadataRetrieve(meta);
+        writer.setInterleaved(false);
+        writer.setWriteSequentially(true);
+        if (spec.tileSize)
+          {
+            writer.setTileSizeX(spec.tileSize);
+            writer.setTileSizeY(spec.tileSize);
+          }
+        if (spec.compression)
+          writer.setCompression(*spec.compression);
+
+        const dimension_size_type rows = spec.tileSize ? spec.tileSize : band_rows;
+        const PixelBufferBase::storage_order_type order
+          (PixelBufferBase::make_storage_order(DimensionOrder::XYZTC, false));
+        VariantPixelBuffer buf;
+        dimension_size_type bufRows = 0U;
+
+        dimension_size_type index = 0U;
+        dimension_size_type currentFile = spec.files;
+        for (dimension_size_type s = 0U; s < spec.series; ++s)
+          {
+            for (dimension_size_type p = 0U; p < spec.planeCount(); ++p, ++index)
+              {
+                const dimension_size_type file = index * spec.files / total;
+                if (file != currentFile)
+                  {
+                    writer.setId(file_name(dir, spec, file));
+                    currentFile = file;
+                  }
+                writer.setSeries(s);
+
+                const uint64_t offset = random();
+                for (dimension_size_type y = 0U; y < spec.sizeY; y += rows)
+                  {
+                    const dimension_size_type h = std::min(rows, spec.sizeY - y);
+                    if (h != bufRows)
+                      {
+                        std::array<VariantPixelBuffer::size_type, 9> bufshape;
+                        bufshape[DIM_SPATIAL_X] = spec.sizeX;
+                        bufshape[DIM_SPATIAL_Y] = h;
+                        bufshape[DIM_SUBCHANNEL] = bufshape[DIM_SPATIAL_Z] = bufshape[DIM_TEMPORAL_T] =
+                          bufshape[DIM_CHANNEL] = bufshape[DIM_MODULO_Z] = bufshape[DIM_MODULO_T] =
+                          bufshape[DIM_MODULO_C] = 1U;
+                        buf.setBuffer(bufshape, spec.pixelType, order);
+                        bufRows = h;
+                      }
+
+                    ome::compat::visit(PatternVisitor{offset, y}, buf.vbuffer());
+                    writer.saveBytes(p, buf, 0U, y, spec.sizeX, h);
+                  }
+              }
+          }
+        writer.close();
+
+        return file_name(dir, spec, 0U);
+      }
+
+    }
+  }
+}
@@ -0,0 +1,156 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_BENCH_GENERATOR_H
+#define OME_FILES_BENCH_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <ome/files/Types.h>
+
+#include <ome/xml/model/enums/PixelType.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      /**
+       * Specification of a synthetic dataset.
+       *
+       * A dataset is made of a number of identical series, each of
+       * which has sizeZ × sizeC × sizeT single-sample planes.  The
+       * planes are divided in order between the files, so that each
+       * file holds a contiguous run of planes.
+       */
+      struct DatasetSpec
+      {
+        /// Seed for the pixel data and annotation values.
+        uint64_t seed;
+        /// Number of series.
+        dimension_size_type series;
+        /// Plane width.
+        dimension_size_type sizeX;
+        /// Plane height.
+        dimension_size_type sizeY;
+        /// Number of focal planes.
+        dimension_size_type sizeZ;
+        /// Number of channels.
+        dimension_size_type sizeC;
+        /// Number of timepoints.
+        dimension_size_type sizeT;
+        /// Pixel type.
+        ome::xml::model::enums::PixelType pixelType;
+        /// Number of files.
+        dimension_size_type files;
+        /// Tile size, or @c 0 to use the writer default.
+        dimension_size_type tileSize;
+        /// Compression codec name, or none if uncompressed.
+        boost::optional<std::string> compression;
+        /// Number of annotations to add to the OME-XML.
+        dimension_size_type annotations;
+
+        /// Constructor (512×512 single plane uint8 dataset).
+        DatasetSpec();
+
+        /**
+         * Get the number of planes in each series.
+         *
+         * @returns the plane count.
+         */
+        dimension_size_type
+        planeCount() const;
+      };
+
+      /**
+       * Parse a dataset specification.
+       *
+       * The specification is a comma-separated list of @c key=value
+       * pairs; keys not specified take their default value.  Valid
+       * keys are @c seed, @c series, @c x, @c y, @c z, @c c, @c t,
+       * @c type (pixel type name), @c files, @c tile, @c compression
+       * and @c annotations, for example
+       * <tt>x=100000,y=100000,tile=1024,type=uint16</tt>.
+       *
+       * @param text the specification to parse.
+       * @returns the specification.
+       * @throws std::runtime_error if the specification is invalid.
+       */
+      DatasetSpec
+      parseDatasetSpec(const std::string& text);
+
+      /**
+       * Format a dataset specification.
+       *
+       * Only values differing from the defaults are included.
+       *
+       * @param spec the specification to format.
+       * @returns the specification text, suitable for parsing with
+       * parseDatasetSpec().
+       */
+      std::string
+      formatDatasetSpec(const DatasetSpec& spec);
+
+      /**
+       * Generate a synthetic dataset.
+       *
+       * The dataset is written with OMETIFFWriter.  The pixel data,
+       * dimensions, file layout and annotations depend only upon the
+       * specification, so that the same dataset is generated for the
+       * same seed; only the UUIDs of the files differ.
+       *
+       * @param dir the directory in which to write the files.
+       * @param spec the dataset specification.
+       * @returns the path of the first file of the dataset.
+       * @throws std::runtime_error if the specification is invalid.
+       */
+      boost::filesystem::path
+      generateDataset(const boost::filesystem::path& dir,
+                      const DatasetSpec&             spec);
+
+    }
+  }
+}
+
+#endif // OME_FILES_BENCH_GENERATOR_H
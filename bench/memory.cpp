@@ -0,0 +1,235 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "benchmark.h"
+
+// The global allocation functions are replaced to count heap
+// allocations and the peak heap size.  Each allocation is preceded
+// by a header recording its size, which is large enough to retain
+// the alignment of the storage returned by malloc().
+
+namespace
+{
+
+  const std::size_t header_size = alignof(std::max_align_t);
+
+  std::atomic<uint64_t> heap_allocations(0U);
+  std::atomic<uint64_t> heap_bytes(0U);
+  std::atomic<uint64_t> heap_live(0U);
+  std::atomic<uint64_t> heap_peak(0U);
+
+  void *
+  counted_allocate(std::size_t size)
+  {
+    void *raw = std::malloc(size + header_size);
+    if (!raw)
+      return nullptr;
+    *static_cast<std::size_t *>(raw) = size;
+
+    heap_allocations.fetch_add(1U, std::memory_order_relaxed);
+    heap_bytes.fetch_add(size, std::memory_order_relaxed);
+    const uint64_t live = heap_live.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = heap_peak.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !heap_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+      ;
+
+    return static_cast<char *>(raw) + header_size;
+  }
+
+  void
+  counted_free(void *ptr)
+  {
+    if (!ptr)
+      return;
+    void *raw = static_cast<char *>(ptr) - header_size;
+    heap_live.fetch_sub(*static_cast<std::size_t *>(raw), std::memory_order_relaxed);
+    std::free(raw);
+  }
+
+}
+
+void *
+operator new(std::size_t size)
+{
+  if (!size)
+    size = 1U;
+  while (true)
+    {
+      void *ptr = counted_allocate(size);
+      if (ptr)
+        return ptr;
+      std::new_handler handler = std::get_new_handler();
+      if (!handler)
+        throw std::bad_alloc();
+      handler();
+    }
+}
+
+void *
+operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void *
+operator new(std::size_t           size,
+             const std::nothrow_t& /* tag */) noexcept
+{
+  try
+    {
+      return operator new(size);
+    }
+  catch (const std::bad_alloc&)
+    {
+      return nullptr;
+    }
+}
+
+void *
+operator new[](std::size_t           size,
+               const std::nothrow_t& tag) noexcept
+{
+  return operator new(size, tag);
+}
+
+void
+operator delete(void *ptr) noexcept
+{
+  counted_free(ptr);
+}
+
+void
+operator delete[](void *ptr) noexcept
+{
+  counted_free(ptr);
+}
+
+void
+operator delete(void                  *ptr,
+                const std::nothrow_t& /* tag */) noexcept
+{
+  counted_free(ptr);
+}
+
+void
+operator delete[](void                  *ptr,
+                  const std::nothrow_t& /* tag */) noexcept
+{
+  counted_free(ptr);
+}
+
+void
+operator delete(void        *ptr,
+                std::size_t /* size */) noexcept
+{
+  counted_free(ptr);
+}
+
+void
+operator delete[](void        *ptr,
+                  std::size_t /* size */) noexcept
+{
+  counted_free(ptr);
+}
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      HeapUsage
+      heapUsage()
+      {
+        return HeapUsage{heap_allocations.load(std::memory_order_relaxed),
+                         heap_bytes.load(std::memory_order_relaxed),
+                         heap_live.load(std::memory_order_relaxed),
+                         heap_peak.load(std::memory_order_relaxed)};
+      }
+
+      void
+      resetHeapPeak()
+      {
+        heap_peak.store(heap_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+
+      uint64_t
+      peakResidentMemory()
+      {
+#ifdef __linux__
+        std::FILE *status = std::fopen("/proc/self/status", "r");
+        if (!status)
+          return 0U;
+        char line[256];
+        unsigned long kib = 0U;
+        while (std::fgets(line, sizeof(line), status))
+          if (std::sscanf(line, "VmHWM: %lu kB", &kib) == 1)
+            break;
+        std::fclose(status);
+        return static_cast<uint64_t>(kib) * 1024U;
+#else
+        return 0U;
+#endif
+      }
+
+      void
+      resetPeakResidentMemory()
+      {
+#ifdef __linux__
+        // Writing 5 resets the peak resident size (VmHWM) to the
+        // current resident size.
+        std::FILE *clear = std::fopen("/proc/self/clear_refs", "w");
+        if (clear)
+          {
+            std::fputs("5", clear);
+            std::fclose(clear);
+          }
+#endif
+      }
+
+    }
+  }
+}
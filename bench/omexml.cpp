@@ -0,0 +1,181 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/tiff/Field.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/Tags.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include "benchmark.h"
+
+using ome::files::CoreMetadata;
+using ome::files::dimension_size_type;
+using ome::files::tiff::TIFF;
+using ome::xml::meta::OMEXMLMetadata;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      namespace
+      {
+
+        // Read a test data file.
+        std::string
+        read_file(const std::string& name)
+        {
+          const std::string path(std::string(OME_FILES_BENCH_DATA_DIR "/") + name);
+          std::ifstream in(path.c_str(), std::ios::binary);
+          if (!in)
+            throw std::runtime_error("Failed to open " + path);
+          return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        // Read the OME-XML text embedded in a test data file.
+        std::string
+        read_omexml(const std::string& name)
+        {
+          const std::string path(std::string(OME_FILES_BENCH_DATA_DIR "/") + name);
+          std::shared_ptr<TIFF> tiff(TIFF::open(path, "r"));
+          std::string text;
+          tiff->getDirectoryByIndex(0)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(text);
+          return text;
+        }
+
+        // Create OME-XML text for a number of images.
+        std::string
+        make_omexml(dimension_size_type images)
+        {
+          std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+          for (dimension_size_type i = 0U; i < images; ++i)
+            {
+              std::shared_ptr<CoreMetadata> core(std::make_shared<CoreMetadata>());
+              core->sizeX = 512U;
+              core->sizeY = 512U;
+              core->sizeZ = 10U;
+              core->sizeT = 10U;
+              core->sizeC.assign(3U, 1U);
+              seriesList.push_back(core);
+            }
+
+          OMEXMLMetadata meta;
+          fillMetadata(meta, seriesList);
+          return getOMEXML(meta, OMEXML_VALIDATE_NONE);
+        }
+
+        // Parse OME-XML text.
+        void
+        parse(State&             state,
+              const std::string& text)
+        {
+          state.setBytesProcessed(text.size());
+          while (state.keepRunning())
+            {
+              std::shared_ptr<OMEXMLMetadata> meta(createOMEXMLMetadata(text));
+              doNotOptimize(meta->getImageCount());
+            }
+        }
+
+        // Upgrade OME-XML text from an older model version.
+        void
+        upgrade(State&             state,
+                const std::string& text)
+        {
+          state.setBytesProcessed(text.size());
+          while (state.keepRunning())
+            doNotOptimize(transformToLatestModelVersion(text));
+        }
+
+        // Serialise OME-XML metadata.
+        void
+        serialize(State&                 state,
+                  const std::string&     text,
+                  OMEXMLValidationPolicy policy)
+        {
+          std::shared_ptr<OMEXMLMetadata> meta(createOMEXMLMetadata(text));
+          state.setBytesProcessed(text.size());
+          while (state.keepRunning())
+            doNotOptimize(getOMEXML(*meta, policy));
+        }
+
+      }
+
+      void
+      registerOMEXMLBenchmarks(Registry& registry)
+      {
+        registry.add("OMEXML/parse/18x24y5z5t2c8b-text",
+                     [](State& state) { parse(state, read_file("18x24y5z5t2c8b-text.ome")); });
+        registry.add("OMEXML/upgrade/2010-06-18x24y5z1t2c8b-text",
+                     [](State& state) { upgrade(state, read_omexml("2010-06-18x24y5z1t2c8b-text.ome.tiff")); });
+        registry.add("OMEXML/parse/2010-06-18x24y5z1t2c8b-text",
+                     [](State& state) { parse(state, read_omexml("2010-06-18x24y5z1t2c8b-text.ome.tiff")); });
+        registry.add("OMEXML/serialize/18x24y5z5t2c8b-text/validate",
+                     [](State& state) { serialize(state, read_file("18x24y5z5t2c8b-text.ome"), OMEXML_VALIDATE_ALL); });
+        registry.add("OMEXML/serialize/18x24y5z5t2c8b-text/novalidate",
+                     [](State& state) { serialize(state, read_file("18x24y5z5t2c8b-text.ome"), OMEXML_VALIDATE_NONE); });
+
+        for (const dimension_size_type images : {1U, 100U, 1000U})
+          {
+            const std::string suffix(std::to_string(images) + "-images");
+            registry.add("OMEXML/parse/" + suffix,
+                         [=](State& state) { parse(state, make_omexml(images)); });
+            registry.add("OMEXML/serialize/" + suffix + "/validate",
+                         [=](State& state) { serialize(state, make_omexml(images), OMEXML_VALIDATE_ALL); });
+            registry.add("OMEXML/serialize/" + suffix + "/novalidate",
+                         [=](State& state) { serialize(state, make_omexml(images), OMEXML_VALIDATE_NONE); });
+          }
+      }
+
+    }
+  }
+}
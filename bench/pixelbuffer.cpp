@@ -0,0 +1,215 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <string>
+#include <utility>
+
+#include <ome/files/Downsample.h>
+#include <ome/files/FormatTools.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+#include <ome/xml/model/enums/DimensionOrder.h>
+#include <ome/xml/model/enums/PixelType.h>
+
+#include "benchmark.h"
+
+using ome::files::PixelBufferBase;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      namespace
+      {
+
+        // Count the non-zero pixels in a buffer.
+        struct CountVisitor
+        {
+          typedef dimension_size_type result_type;
+
+          template<typename T>
+          dimension_size_type
+          operator() (const T& v) const
+          {
+            typedef typename T::element_type::value_type value_type;
+
+            dimension_size_type count = 0U;
+            const value_type *data = v->data();
+            const value_type *end = data + v->num_elements();
+            for (; data != end; ++data)
+              if (*data != value_type())
+                ++count;
+            return count;
+          }
+        };
+
+        // Create a square buffer with three samples per pixel.
+        void
+        make_buffer(VariantPixelBuffer& buf,
+                    dimension_size_type size,
+                    PixelType           pixeltype,
+                    bool                interleaved)
+        {
+          std::array<VariantPixelBuffer::size_type, 9> shape;
+          shape[DIM_SPATIAL_X] = size;
+          shape[DIM_SPATIAL_Y] = size;
+          shape[DIM_SUBCHANNEL] = 3U;
+          shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+            shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1U;
+          buf.setBuffer(shape, pixeltype,
+                        PixelBufferBase::make_storage_order(DimensionOrder::XYZTC, interleaved));
+        }
+
+        // Visit every pixel of a buffer.
+        void
+        visit(State&    state,
+              PixelType pixeltype)
+        {
+          VariantPixelBuffer buf;
+          make_buffer(buf, 512U, pixeltype, true);
+          state.setBytesProcessed(buf.num_elements() * bytesPerPixel(pixeltype));
+
+          while (state.keepRunning())
+            doNotOptimize(ome::compat::visit(CountVisitor(), buf.vbuffer()));
+        }
+
+        // Assign one buffer to another, converting the storage
+        // order if not the same.
+        void
+        assign(State&    state,
+               PixelType pixeltype,
+               bool      transpose)
+        {
+          VariantPixelBuffer src;
+          VariantPixelBuffer dest;
+          make_buffer(src, 512U, pixeltype, true);
+          make_buffer(dest, 512U, pixeltype, !transpose);
+          state.setBytesProcessed(src.num_elements() * bytesPerPixel(pixeltype));
+
+          while (state.keepRunning())
+            {
+              dest = src;
+              doNotOptimize(dest.data());
+            }
+        }
+
+        // Downsample a buffer by a factor of two.
+        void
+        downsample(State&             state,
+                   PixelType          pixeltype,
+                   tiff::Downsampling method,
+                   bool               interleaved)
+        {
+          VariantPixelBuffer src;
+          VariantPixelBuffer dest;
+          make_buffer(src, 1024U, pixeltype, interleaved);
+          state.setBytesProcessed(src.num_elements() * bytesPerPixel(pixeltype));
+
+          while (state.keepRunning())
+            {
+              ome::files::downsample(src, dest, 2U, method);
+              doNotOptimize(dest.data());
+            }
+        }
+
+        // Convert ZCT coordinates to plane indexes.
+        void
+        get_index(State&             state,
+                  const std::string& order)
+        {
+          const dimension_size_type sizeZ = 16U, sizeC = 4U, sizeT = 32U;
+          const dimension_size_type count = sizeZ * sizeC * sizeT;
+          while (state.keepRunning())
+            for (dimension_size_type t = 0U; t < sizeT; ++t)
+              for (dimension_size_type c = 0U; c < sizeC; ++c)
+                for (dimension_size_type z = 0U; z < sizeZ; ++z)
+                  doNotOptimize(getIndex(order, sizeZ, sizeC, sizeT, count, z, c, t));
+        }
+
+      }
+
+      void
+      registerPixelBufferBenchmarks(Registry& registry)
+      {
+        const PixelType::value_map_type& pv = PixelType::values();
+        for (const auto& i : pv)
+          {
+            const PixelType pixeltype(i.first);
+            const std::string name(i.second);
+            registry.add("VariantPixelBuffer/visit/" + name,
+                         [=](State& state) { visit(state, pixeltype); });
+            registry.add("VariantPixelBuffer/assign/" + name + "/same",
+                         [=](State& state) { assign(state, pixeltype, false); });
+            registry.add("VariantPixelBuffer/assign/" + name + "/transpose",
+                         [=](State& state) { assign(state, pixeltype, true); });
+
+            const std::array<std::pair<tiff::Downsampling, std::string>, 4> methods
+              {{{tiff::DOWNSAMPLE_NEAREST, "nearest"},
+                {tiff::DOWNSAMPLE_MEAN, "mean"},
+                {tiff::DOWNSAMPLE_MODE, "mode"},
+                {tiff::DOWNSAMPLE_OR, "or"}}};
+            for (const auto& method : methods)
+              {
+                if (!downsamplingSupported(pixeltype, method.first))
+                  continue;
+                const tiff::Downsampling m(method.first);
+                registry.add("Downsample/" + method.second + "/" + name + "/planar",
+                             [=](State& state) { downsample(state, pixeltype, m, false); });
+                registry.add("Downsample/" + method.second + "/" + name + "/interleaved",
+                             [=](State& state) { downsample(state, pixeltype, m, true); });
+              }
+          }
+
+        for (const std::string order : {"XYZCT", "XYCTZ", "XYTCZ"})
+          registry.add("FormatTools/getIndex/" + order,
+                       [=](State& state) { get_index(state, order); });
+      }
+
+    }
+  }
+}
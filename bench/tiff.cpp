@@ -0,0 +1,265 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/xml/model/enums/DimensionOrder.h>
+#include <ome/xml/model/enums/PixelType.h>
+
+#include "benchmark.h"
+
+using ome::files::PixelBufferBase;
+using ome::files::PlaneRegion;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      namespace
+      {
+
+        // Image size.
+        const dimension_size_type image_size = 512U;
+
+        // Fill a buffer with a compressible pattern.
+        struct FillVisitor
+        {
+          typedef void result_type;
+
+          template<typename T>
+          void
+          operator() (T& v) const
+          {
+            typedef typename T::element_type::value_type value_type;
+
+            value_type *data = v->data();
+            for (dimension_size_type i = 0U; i < v->num_elements(); ++i)
+              data[i] = static_cast<value_type>((i / 7U) % 251U);
+          }
+        };
+
+        /// Parameters of a TIFF benchmark.
+        struct Parameters
+        {
+          /// Pixel type.
+          PixelType pixeltype;
+          /// Strips or tiles.
+          tiff::TileType tiletype;
+          /// Planar configuration.
+          tiff::PlanarConfiguration planarconfig;
+          /// Codec name, or none if uncompressed.
+          boost::optional<std::string> compression;
+        };
+
+        // A temporary file, removed on destruction.
+        class TemporaryFile
+        {
+        public:
+          TemporaryFile():
+            path(boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path("ome-files-bench-%%%%-%%%%-%%%%.tiff"))
+          {
+          }
+
+          ~TemporaryFile()
+          {
+            boost::system::error_code ec;
+            boost::filesystem::remove(path, ec);
+          }
+
+          boost::filesystem::path path;
+        };
+
+        // Create the source image.
+        void
+        make_image(VariantPixelBuffer& buf,
+                   const Parameters&   params)
+        {
+          std::array<VariantPixelBuffer::size_type, 9> shape;
+          shape[DIM_SPATIAL_X] = image_size;
+          shape[DIM_SPATIAL_Y] = image_size;
+          shape[DIM_SUBCHANNEL] = 3U;
+          shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+            shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1U;
+          buf.setBuffer(shape, params.pixeltype,
+                        PixelBufferBase::make_storage_order(DimensionOrder::XYZTC,
+                                                            params.planarconfig == tiff::CONTIG));
+          ome::compat::visit(FillVisitor(), buf.vbuffer());
+        }
+
+        // Write the image to a new TIFF file.
+        void
+        write_image(const boost::filesystem::path& path,
+                    const Parameters&              params,
+                    const VariantPixelBuffer&      buf)
+        {
+          std::shared_ptr<TIFF> tiff(TIFF::open(path, "w"));
+          std::shared_ptr<IFD> ifd(tiff->getCurrentDirectory());
+
+          ifd->setImageWidth(image_size);
+          ifd->setImageHeight(image_size);
+          ifd->setTileType(params.tiletype);
+          ifd->setTileWidth(params.tiletype == tiff::TILE ? 256U : static_cast<uint32_t>(image_size));
+          ifd->setTileHeight(params.tiletype == tiff::TILE ? 256U : 32U);
+          ifd->setPixelType(params.pixeltype);
+          ifd->setBitsPerSample(significantBitsPerPixel(params.pixeltype));
+          ifd->setSamplesPerPixel(3U);
+          ifd->setPlanarConfiguration(params.planarconfig);
+          ifd->setPhotometricInterpretation(tiff::MIN_IS_BLACK);
+          if (params.compression)
+            ifd->setCompression(tiff::getCodecScheme(*params.compression));
+
+          ifd->writeImage(buf);
+          tiff->writeCurrentDirectory();
+          tiff->close();
+        }
+
+        // Write a complete image.
+        void
+        write(State&            state,
+              const Parameters& params)
+        {
+          VariantPixelBuffer buf;
+          make_image(buf, params);
+          TemporaryFile file;
+          state.setBytesProcessed(buf.num_elements() * bytesPerPixel(params.pixeltype));
+
+          while (state.keepRunning())
+            write_image(file.path, params, buf);
+        }
+
+        // Read a region of an image.
+        void
+        read(State&              state,
+             const Parameters&   params,
+             dimension_size_type size)
+        {
+          TemporaryFile file;
+          {
+            VariantPixelBuffer buf;
+            make_image(buf, params);
+            write_image(file.path, params, buf);
+          }
+
+          std::shared_ptr<TIFF> tiff(TIFF::open(file.path, "r"));
+          std::shared_ptr<IFD> ifd(tiff->getDirectoryByIndex(0U));
+
+          // Read regions in turn from across the image, so that the
+          // same region is not read repeatedly.
+          std::vector<PlaneRegion> regions;
+          const dimension_size_type step = std::max(size, image_size / 8U);
+          for (dimension_size_type y = 0U; y + size <= image_size; y += step)
+            for (dimension_size_type x = 0U; x + size <= image_size; x += step)
+              regions.push_back(PlaneRegion(x, y, size, size));
+
+          VariantPixelBuffer buf;
+          state.setBytesProcessed(size * size * 3U * bytesPerPixel(params.pixeltype));
+          std::vector<PlaneRegion>::size_type next = 0U;
+          while (state.keepRunning())
+            {
+              const PlaneRegion& r(regions[next]);
+              ifd->readImage(buf, r.x, r.y, r.w, r.h);
+              doNotOptimize(buf.data());
+              next = (next + 1U) % regions.size();
+            }
+        }
+
+      }
+
+      void
+      registerTIFFBenchmarks(Registry& registry)
+      {
+        const PixelType::value_map_type& pv = PixelType::values();
+        for (const auto& i : pv)
+          {
+            const std::vector<std::string>& available(tiff::getCodecNames(i.first));
+            std::vector<boost::optional<std::string>> codecs;
+            codecs.push_back(boost::none);
+            for (const std::string codec : {"LZW", "Deflate"})
+              if (std::find(available.begin(), available.end(), codec) != available.end())
+                codecs.push_back(codec);
+
+            for (const auto tiletype : {tiff::STRIP, tiff::TILE})
+              for (const auto planarconfig : {tiff::CONTIG, tiff::SEPARATE})
+                for (const auto& codec : codecs)
+                  {
+                    const Parameters params{i.first, tiletype, planarconfig, codec};
+                    const std::string suffix
+                      ((boost::format("%1%/%2%/%3%/%4%")
+                        % i.second
+                        % (tiletype == tiff::TILE ? "tile" : "strip")
+                        % (planarconfig == tiff::CONTIG ? "contig" : "separate")
+                        % (codec ? *codec : std::string("none"))).str());
+
+                    registry.add("TIFF/writeImage/" + suffix,
+                                 [=](State& state) { write(state, params); });
+                    for (const dimension_size_type size : {1U, 16U, 256U, 512U})
+                      registry.add("TIFF/readImage/" + suffix + "/region:" + std::to_string(size),
+                                   [=](State& state) { read(state, params, size); });
+                  }
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,144 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <memory>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/TileCoverage.h>
+
+#include "benchmark.h"
+
+using ome::files::PlaneRegion;
+using ome::files::TileCoverage;
+using ome::files::dimension_size_type;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace bench
+    {
+
+      namespace
+      {
+
+        // Regions covering an image, in row order.
+        std::vector<PlaneRegion>
+        regions(dimension_size_type size,
+                dimension_size_type width,
+                dimension_size_type height)
+        {
+          std::vector<PlaneRegion> list;
+          for (dimension_size_type y = 0; y < size; y += height)
+            for (dimension_size_type x = 0; x < size; x += width)
+              list.push_back(PlaneRegion(x, y, width, height) & PlaneRegion(0, 0, size, size));
+          return list;
+        }
+
+        // Create a coverage using tile row intervals or the R*Tree.
+        std::shared_ptr<TileCoverage>
+        make_coverage(dimension_size_type tile,
+                      bool                tiled)
+        {
+          return tiled ? std::make_shared<TileCoverage>(tile, tile) : std::make_shared<TileCoverage>();
+        }
+
+        // Insert regions into an empty coverage.
+        void
+        insert(State&              state,
+               dimension_size_type tile,
+               dimension_size_type region,
+               bool                tiled)
+        {
+          const std::vector<PlaneRegion> list(regions(4096U, region, region));
+          while (state.keepRunning())
+            {
+              std::shared_ptr<TileCoverage> coverage(make_coverage(tile, tiled));
+              for (const auto& r : list)
+                coverage->insert(r);
+              doNotOptimize(coverage->size());
+            }
+        }
+
+        // Check if tiles are covered by a complete coverage.
+        void
+        covered(State&              state,
+                dimension_size_type tile,
+                dimension_size_type region,
+                bool                tiled)
+        {
+          const std::vector<PlaneRegion> list(regions(4096U, region, region));
+          const std::vector<PlaneRegion> tiles(regions(4096U, tile, tile));
+          std::shared_ptr<TileCoverage> coverage(make_coverage(tile, tiled));
+          for (const auto& r : list)
+            coverage->insert(r);
+
+          while (state.keepRunning())
+            for (const auto& t : tiles)
+              doNotOptimize(coverage->covered(t));
+        }
+
+      }
+
+      void
+      registerTileCoverageBenchmarks(Registry& registry)
+      {
+        for (const dimension_size_type tile : {64U, 256U})
+          for (const dimension_size_type region : {16U, 64U, 256U})
+            {
+              if (region > tile)
+                continue;
+              for (const bool tiled : {false, true})
+                {
+                  const std::string suffix
+                    ((boost::format("tile:%1%/region:%2%/%3%")
+                      % tile % region % (tiled ? "intervals" : "rtree")).str());
+                  registry.add("TileCoverage/insert/" + suffix,
+                               [=](State& state) { insert(state, tile, region, tiled); });
+                  registry.add("TileCoverage/covered/" + suffix,
+                               [=](State& state) { covered(state, tile, region, tiled); });
+                }
+            }
+      }
+
+    }
+  }
+}
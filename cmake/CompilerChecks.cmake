@@ -149,3 +149,30 @@ int main(void) {
   return 0;
 }"
   OME_HAVE_SNPRINTF)
+
+if(io-uring)
+  # io_uring system calls and kernel interface (Linux ≥ 5.1)
+  check_cxx_source_compiles("
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+int main(void) {
+  struct io_uring_params params;
+  struct io_uring_sqe sqe;
+  sqe.opcode = IORING_OP_READV;
+  return __NR_io_uring_setup + __NR_io_uring_enter + sizeof(params) + sizeof(sqe);
+}"
+    OME_FILES_HAVE_IO_URING)
+endif()
+
+if(dlpack)
+  # DLPack tensor interchange (header only)
+  check_include_file_cxx(dlpack/dlpack.h OME_FILES_HAVE_DLPACK)
+endif()
+
+# Linux writeback control for streaming writes
+check_cxx_source_compiles("
+#include <fcntl.h>
+int main(void) {
+  return sync_file_range(0, 0, 0, SYNC_FILE_RANGE_WRITE);
+}"
+  OME_FILES_HAVE_SYNC_FILE_RANGE)
@@ -36,3 +36,18 @@
 
 find_package(TIFF 4.0.3 REQUIRED)
 find_package(PNG REQUIRED)
+
+include(CheckSymbolExists)
+set(CMAKE_REQUIRED_INCLUDES_SAVE ${CMAKE_REQUIRED_INCLUDES})
+set(CMAKE_REQUIRED_LIBRARIES_SAVE ${CMAKE_REQUIRED_LIBRARIES})
+set(CMAKE_REQUIRED_INCLUDES ${CMAKE_REQUIRED_INCLUDES} ${TIFF_INCLUDE_DIR})
+set(CMAKE_REQUIRED_LIBRARIES ${CMAKE_REQUIRED_LIBRARIES} ${TIFF_LIBRARIES})
+# Decoding tiles from memory (libtiff ≥ 4.0.10)
+check_symbol_exists(TIFFReadFromUserBuffer tiffio.h OME_FILES_HAVE_TIFFREADFROMUSERBUFFER)
+set(CMAKE_REQUIRED_INCLUDES ${CMAKE_REQUIRED_INCLUDES_SAVE})
+set(CMAKE_REQUIRED_LIBRARIES ${CMAKE_REQUIRED_LIBRARIES_SAVE})
+
+if(jpeg)
+  find_package(JPEG)
+endif()
+set(OME_FILES_HAVE_JPEG ${JPEG_FOUND})
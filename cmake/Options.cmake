@@ -10,6 +10,26 @@ option(fatal-warnings "Compiler warnings are errors" OFF)
 option(test "Enable unit tests (requires gtest)" ON)
 option(extended-tests "Enable extended tests (more comprehensive, longer run time)" ON)
 
+# Performance benchmarks.
+option(benchmarks "Enable performance benchmarks" OFF)
+
+# I/O statistics instrumentation.
+option(io-statistics "Enable I/O statistics counters and timers" ON)
+set(OME_FILES_IO_STATISTICS ${io-statistics})
+
+# Trace event emission.
+option(tracing "Enable trace event emission (Chrome trace JSON)" OFF)
+set(OME_FILES_TRACE ${tracing})
+
+# libjpeg tile decoding.
+option(jpeg "Decode JPEG-compressed tiles with libjpeg (if available)" ON)
+
+# Asynchronous tile reads.
+option(io-uring "Read tile data with io_uring on Linux (if available)" ON)
+
+# Zero-copy tensor export.
+option(dlpack "Export pixel buffers as DLPack tensors (if available)" ON)
+
 # The installation is relocatable; this affects path lookups (if OFF,
 # paths are assumed to be their configured absolute install location;
 # paths will still be introspected as a fallback); if ON paths will be
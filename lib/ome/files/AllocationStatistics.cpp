@@ -0,0 +1,100 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+
+#include <ome/files/AllocationStatistics.h>
+
+namespace
+{
+
+  struct AtomicCounts
+  {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bytes;
+  };
+
+  // Zero-initialised as a static.
+  std::array<AtomicCounts, ome::files::AllocationStatistics::kind_count> counts;
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    const std::size_t AllocationStatistics::kind_count;
+
+    std::atomic<bool> AllocationStatistics::active(false);
+
+    void
+    AllocationStatistics::setEnabled(bool enable)
+    {
+      active.store(enable, std::memory_order_relaxed);
+    }
+
+    AllocationStatistics::Counts
+    AllocationStatistics::get(Kind kind)
+    {
+      const AtomicCounts& c(counts.at(kind));
+      return Counts{c.allocations.load(std::memory_order_relaxed),
+                    c.bytes.load(std::memory_order_relaxed)};
+    }
+
+    void
+    AllocationStatistics::reset()
+    {
+      for (auto& c : counts)
+        {
+          c.allocations.store(0U, std::memory_order_relaxed);
+          c.bytes.store(0U, std::memory_order_relaxed);
+        }
+    }
+
+    void
+    AllocationStatistics::add(Kind     kind,
+                              uint64_t bytes)
+    {
+      AtomicCounts& c(counts[kind]);
+      c.allocations.fetch_add(1U, std::memory_order_relaxed);
+      c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+  }
+}
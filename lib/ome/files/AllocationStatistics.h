@@ -0,0 +1,158 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_ALLOCATIONSTATISTICS_H
+#define OME_FILES_ALLOCATIONSTATISTICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Process-wide allocation counters.
+     *
+     * Counts the allocations made by the library's main memory
+     * holders, so that memory regressions in a particular operation
+     * (such as a cache holding a whole plane, or repeated copies of
+     * metadata) may be detected, for example by the benchmark
+     * harness.  Unlike IOStatistics, which is per reader and
+     * writer, the counts are for the whole process.
+     *
+     * Counting is disabled by default, when it costs a single
+     * relaxed atomic load per allocation.  All methods are
+     * thread-safe.
+     */
+    class AllocationStatistics
+    {
+    public:
+      /// Memory holders.
+      enum Kind
+        {
+          TILE_BUFFER,  ///< TileBuffer storage.
+          PIXEL_BUFFER, ///< PixelBuffer storage allocated internally or with a PixelBufferAllocator.
+          METADATA_MAP  ///< MetadataMap entries (key and value storage).
+        };
+
+      /// Number of kinds.
+      static const std::size_t kind_count = METADATA_MAP + 1U;
+
+      /// Allocation counts.
+      struct Counts
+      {
+        /// Number of allocations.
+        uint64_t allocations;
+        /// Total size of allocations (bytes).
+        uint64_t bytes;
+      };
+
+      /**
+       * Enable or disable counting.
+       *
+       * @param enable @c true to count allocations, @c false to stop.
+       */
+      static void
+      setEnabled(bool enable);
+
+      /**
+       * Check if counting is enabled.
+       *
+       * @returns @c true if allocations are being counted.
+       */
+      static bool
+      getEnabled()
+      {
+        return active.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * Record an allocation, if counting is enabled.
+       *
+       * @param kind the memory holder.
+       * @param bytes the size of the allocation.
+       */
+      static void
+      record(Kind     kind,
+             uint64_t bytes)
+      {
+        if (active.load(std::memory_order_relaxed))
+          add(kind, bytes);
+      }
+
+      /**
+       * Get the counts for a memory holder.
+       *
+       * @param kind the memory holder.
+       * @returns the counts since the last reset().
+       */
+      static Counts
+      get(Kind kind);
+
+      /// Reset all counts to zero.
+      static void
+      reset();
+
+    private:
+      /**
+       * Add to the counts for a memory holder.
+       *
+       * @param kind the memory holder.
+       * @param bytes the size of the allocation.
+       */
+      static void
+      add(Kind     kind,
+          uint64_t bytes);
+
+      /// Counting is enabled.
+      static std::atomic<bool> active;
+    };
+
+  }
+}
+
+#endif // OME_FILES_ALLOCATIONSTATISTICS_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
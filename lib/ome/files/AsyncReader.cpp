@@ -0,0 +1,247 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#include <ome/files/AsyncReader.h>
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    class AsyncReader::State
+    {
+    public:
+      /// A queued request.
+      struct Request
+      {
+        /// Series index.
+        dimension_size_type                      series;
+        /// Resolution index.
+        dimension_size_type                      resolution;
+        /// Plane index.
+        dimension_size_type                      plane;
+        /// Region to read.
+        PlaneRegion                              region;
+        /// Completion callback.
+        callback_type                            callback;
+        /// Cancellation token of the requesting thread (if any).
+        std::shared_ptr<const CancellationToken> token;
+      };
+
+      /// Reader.
+      std::shared_ptr<const FormatReader> reader;
+      /// Executor running the reading tasks.
+      std::shared_ptr<Executor>           executor;
+      /// Maximum number of reading tasks.
+      unsigned int                        concurrency;
+      /// Mutex protecting the queue and counts.
+      mutable std::mutex                  mutex;
+      /// Signalled when no requests are outstanding.
+      mutable std::condition_variable     idle;
+      /// Requests not yet started.
+      std::deque<Request>                 queue;
+      /// Number of reading tasks submitted.
+      unsigned int                        tasks;
+      /// Number of requests queued or being read.
+      dimension_size_type                 outstanding;
+
+      State(std::shared_ptr<const FormatReader> reader,
+            unsigned int                        concurrency):
+        reader(reader),
+        executor(reader->getExecutor()),
+        concurrency(concurrency ? concurrency : std::max(executor->concurrency(), 1U)),
+        mutex(),
+        idle(),
+        queue(),
+        tasks(0U),
+        outstanding(0U)
+      {
+      }
+
+      // Queue a request, and start a reading task if fewer than the
+      // maximum are running.
+      static void
+      submit(const std::shared_ptr<State>& state,
+             Request&&                     request)
+      {
+        bool start = false;
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          state->queue.push_back(std::move(request));
+          ++state->outstanding;
+          if (state->tasks < state->concurrency)
+            {
+              ++state->tasks;
+              start = true;
+            }
+        }
+
+        if (start)
+          state->executor->submit([state]() { drain(state); });
+      }
+
+      // Read queued requests until the queue is empty.
+      static void
+      drain(const std::shared_ptr<State>& state)
+      {
+        for (;;)
+          {
+            Request request;
+            {
+              std::lock_guard<std::mutex> lock(state->mutex);
+              if (state->queue.empty())
+                {
+                  --state->tasks;
+                  return;
+                }
+              request = std::move(state->queue.front());
+              state->queue.pop_front();
+            }
+
+            result_type buf(std::make_shared<VariantPixelBuffer>());
+            std::exception_ptr error;
+            try
+              {
+                CancellationToken::Scope scope(request.token.get());
+                if (request.token)
+                  request.token->check();
+                state->reader->openBytesAt(request.series, request.resolution, request.plane,
+                                           *buf, request.region);
+              }
+            catch (...)
+              {
+                buf.reset();
+                error = std::current_exception();
+              }
+
+            try
+              {
+                request.callback(buf, error);
+              }
+            catch (...)
+              {
+              }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!--state->outstanding)
+              state->idle.notify_all();
+          }
+      }
+    };
+
+    AsyncReader::AsyncReader(std::shared_ptr<const FormatReader> reader,
+                             unsigned int                        concurrency):
+      state(std::make_shared<State>(reader, concurrency))
+    {
+    }
+
+    AsyncReader::~AsyncReader()
+    {
+      wait();
+    }
+
+    std::future<AsyncReader::result_type>
+    AsyncReader::openBytesAsync(dimension_size_type series,
+                                dimension_size_type resolution,
+                                dimension_size_type plane,
+                                const PlaneRegion&  region)
+    {
+      std::shared_ptr<std::promise<result_type>> promise(std::make_shared<std::promise<result_type>>());
+      std::future<result_type> result(promise->get_future());
+      openBytesAsync(series, resolution, plane, region,
+                     [promise](result_type        buf,
+                               std::exception_ptr error)
+                     {
+                       if (error)
+                         promise->set_exception(error);
+                       else
+                         promise->set_value(buf);
+                     });
+      return result;
+    }
+
+    void
+    AsyncReader::openBytesAsync(dimension_size_type  series,
+                                dimension_size_type  resolution,
+                                dimension_size_type  plane,
+                                const PlaneRegion&   region,
+                                callback_type        callback)
+    {
+      State::Request request;
+      request.series = series;
+      request.resolution = resolution;
+      request.plane = plane;
+      request.region = region;
+      request.callback = std::move(callback);
+      // A copy of the token shares its state, and outlives the scope
+      // of the caller.
+      if (const CancellationToken *cancel = CancellationToken::current())
+        request.token = std::make_shared<const CancellationToken>(*cancel);
+
+      State::submit(state, std::move(request));
+    }
+
+    dimension_size_type
+    AsyncReader::pending() const
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      return state->outstanding;
+    }
+
+    void
+    AsyncReader::wait() const
+    {
+      std::unique_lock<std::mutex> lock(state->mutex);
+      state->idle.wait(lock, [this]() { return state->outstanding == 0U; });
+    }
+
+    const std::shared_ptr<const FormatReader>&
+    AsyncReader::getReader() const
+    {
+      return state->reader;
+    }
+
+  }
+}
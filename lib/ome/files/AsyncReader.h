@@ -0,0 +1,200 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_ASYNCREADER_H
+#define OME_FILES_ASYNCREADER_H
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Asynchronous reading of image regions.
+     *
+     * Each request reads a region of a plane of any series and
+     * resolution with FormatReader::openBytesAt(), and completes
+     * either a future or a callback.  Requests are queued, and read
+     * by a limited number of tasks submitted to the executor of the
+     * reader (see FormatReader::getExecutor()), so that any number
+     * of requests may be outstanding without a thread for each, or
+     * flooding the executor.  The calling thread is never blocked,
+     * which permits use from an event loop:
+     *
+     * \code{.cpp}
+     * AsyncReader async(reader);
+     * async.openBytesAsync(series, resolution, plane, region,
+     *                      [](std::shared_ptr<VariantPixelBuffer> buf,
+     *                         std::exception_ptr                  error)
+     *                      {
+     *                        // Post the result back to the event loop.
+     *                      });
+     * \endcode
+     *
+     * The cancellation token of the thread making a request (see
+     * CancellationToken) applies to the request, and is checked
+     * before it is started.  The reader must not be closed, nor
+     * setId() called, while requests are outstanding; the
+     * destructor waits for all outstanding requests.
+     */
+    class AsyncReader
+    {
+    public:
+      /// Result type.
+      typedef std::shared_ptr<VariantPixelBuffer> result_type;
+
+      /**
+       * Completion callback.
+       *
+       * Called once for each request, by an executor thread, with
+       * the pixel data read, or with null pixel data and the
+       * exception thrown by the read.  The callback must not
+       * block; any exception it throws is discarded.
+       */
+      typedef std::function<void (result_type        buf,
+                                  std::exception_ptr error)> callback_type;
+
+      /**
+       * Constructor.
+       *
+       * @param reader the reader to read from; its metadata must
+       * already be initialized with setId().
+       * @param concurrency the maximum number of requests read
+       * concurrently, or @c 0 for the concurrency of the executor
+       * of the reader.
+       */
+      explicit
+      AsyncReader(std::shared_ptr<const FormatReader> reader,
+                  unsigned int                        concurrency = 0U);
+
+      /**
+       * Destructor.
+       *
+       * Waits for all outstanding requests.
+       */
+      ~AsyncReader();
+
+      /// @cond SKIP
+      AsyncReader (const AsyncReader&) = delete;
+
+      AsyncReader&
+      operator= (const AsyncReader&) = delete;
+      /// @endcond SKIP
+
+      /**
+       * Read a region asynchronously, completing a future.
+       *
+       * @param series the series index.
+       * @param resolution the resolution index within the series.
+       * @param plane the plane index within the series.
+       * @param region the sub-image to read.
+       * @returns a future for the pixel data; its get() rethrows
+       * any exception thrown by the read.
+       */
+      std::future<result_type>
+      openBytesAsync(dimension_size_type series,
+                     dimension_size_type resolution,
+                     dimension_size_type plane,
+                     const PlaneRegion&  region);
+
+      /**
+       * Read a region asynchronously, calling a callback.
+       *
+       * @param series the series index.
+       * @param resolution the resolution index within the series.
+       * @param plane the plane index within the series.
+       * @param region the sub-image to read.
+       * @param callback the function to call on completion.
+       */
+      void
+      openBytesAsync(dimension_size_type  series,
+                     dimension_size_type  resolution,
+                     dimension_size_type  plane,
+                     const PlaneRegion&   region,
+                     callback_type        callback);
+
+      /**
+       * Get the number of outstanding requests.
+       *
+       * @returns the number of requests queued or being read.
+       */
+      dimension_size_type
+      pending() const;
+
+      /**
+       * Wait for all outstanding requests.
+       *
+       * Callbacks of the requests have returned when this returns.
+       */
+      void
+      wait() const;
+
+      /**
+       * Get the reader.
+       *
+       * @returns the reader.
+       */
+      const std::shared_ptr<const FormatReader>&
+      getReader() const;
+
+    private:
+      class State;
+
+      /// Request queue, shared with the reading tasks.
+      std::shared_ptr<State> state;
+    };
+
+  }
+}
+
+#endif // OME_FILES_ASYNCREADER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,122 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/ReadCancelledException.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      /// The token of the innermost scope of the current thread.
+      thread_local const CancellationToken *current_token = nullptr;
+
+    }
+
+    CancellationToken::CancellationToken():
+      state(std::make_shared<State>(time_point::max()))
+    {
+    }
+
+    CancellationToken::CancellationToken(time_point deadline):
+      state(std::make_shared<State>(deadline))
+    {
+    }
+
+    CancellationToken::CancellationToken(clock_type::duration timeout):
+      state(std::make_shared<State>(clock_type::now() + timeout))
+    {
+    }
+
+    void
+    CancellationToken::cancel() const
+    {
+      state->cancelled = true;
+    }
+
+    bool
+    CancellationToken::cancelled() const
+    {
+      return state->cancelled.load(std::memory_order_relaxed) ||
+        (state->deadline != time_point::max() && clock_type::now() >= state->deadline);
+    }
+
+    void
+    CancellationToken::check() const
+    {
+      if (state->cancelled.load(std::memory_order_relaxed))
+        throw ReadCancelledException("Read cancelled");
+      if (state->deadline != time_point::max() && clock_type::now() >= state->deadline)
+        throw ReadCancelledException("Read deadline exceeded");
+    }
+
+    CancellationToken::time_point
+    CancellationToken::getDeadline() const
+    {
+      return state->deadline;
+    }
+
+    const CancellationToken *
+    CancellationToken::current()
+    {
+      return current_token;
+    }
+
+    CancellationToken::Scope::Scope(const CancellationToken& token):
+      previous(current_token)
+    {
+      current_token = &token;
+    }
+
+    CancellationToken::Scope::Scope(const CancellationToken *token):
+      previous(current_token)
+    {
+      current_token = token;
+    }
+
+    CancellationToken::Scope::~Scope()
+    {
+      current_token = previous;
+    }
+
+  }
+}
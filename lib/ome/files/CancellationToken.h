@@ -0,0 +1,221 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_CANCELLATIONTOKEN_H
+#define OME_FILES_CANCELLATIONTOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Cancellation of reads in progress.
+     *
+     * A token is cancelled by calling cancel(), or when its deadline
+     * passes.  Copies of a token share the same state, so a token
+     * may be cancelled from another thread using a copy.
+     *
+     * A token applies to all reads made by the current thread while
+     * a Scope referring to it exists:
+     *
+     * \code{.cpp}
+     * CancellationToken token(std::chrono::milliseconds(200));
+     * {
+     *   CancellationToken::Scope scope(token);
+     *   reader.openBytesAt(series, resolution, plane, buf, region);
+     * }
+     * \endcode
+     *
+     * The token is checked between tiles when decoding an image
+     * region, by each parallel decoding task, between planes when
+     * reading plane stacks, and before starting each prefetched
+     * plane; a cancelled read throws ReadCancelledException.  Reads
+     * already started are not interrupted within a tile.  A scope
+     * is propagated to the tasks of Executor::parallel(), and to
+     * planes queued for prefetching.
+     */
+    class CancellationToken
+    {
+    public:
+      /// Clock type for deadlines.
+      typedef std::chrono::steady_clock clock_type;
+
+      /// Deadline type.
+      typedef clock_type::time_point time_point;
+
+      /**
+       * Construct a token without a deadline.
+       */
+      CancellationToken();
+
+      /**
+       * Construct a token with a deadline.
+       *
+       * @param deadline the time after which reads are cancelled.
+       */
+      explicit
+      CancellationToken(time_point deadline);
+
+      /**
+       * Construct a token with a timeout.
+       *
+       * @param timeout the time from now after which reads are
+       * cancelled.
+       */
+      explicit
+      CancellationToken(clock_type::duration timeout);
+
+      /**
+       * Cancel all reads using this token or any copy of it.
+       *
+       * This is thread-safe.
+       */
+      void
+      cancel() const;
+
+      /**
+       * Check if cancelled.
+       *
+       * @returns @c true if cancel() was called or the deadline has
+       * passed, @c false otherwise.
+       */
+      bool
+      cancelled() const;
+
+      /**
+       * Throw if cancelled.
+       *
+       * @throws ReadCancelledException if cancel() was called or
+       * the deadline has passed.
+       */
+      void
+      check() const;
+
+      /**
+       * Get the deadline.
+       *
+       * @returns the deadline, or time_point::max() if none.
+       */
+      time_point
+      getDeadline() const;
+
+      /**
+       * Get the token of the current thread.
+       *
+       * @returns the token of the innermost Scope of the current
+       * thread, or null if none.
+       */
+      static
+      const CancellationToken *
+      current();
+
+      /**
+       * Apply a token to the reads of the current thread.
+       *
+       * The previous token of the thread is restored on destruction.
+       * The token must outlive the scope.
+       */
+      class Scope
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param token the token to apply.
+         */
+        explicit
+        Scope(const CancellationToken& token);
+
+        /**
+         * Constructor.
+         *
+         * @param token the token to apply, or null for none.
+         */
+        explicit
+        Scope(const CancellationToken *token);
+
+        /// Destructor.
+        ~Scope();
+
+        /// @cond SKIP
+        Scope (const Scope&) = delete;
+
+        Scope&
+        operator= (const Scope&) = delete;
+        /// @endcond SKIP
+
+      private:
+        /// The token of the enclosing scope.
+        const CancellationToken *previous;
+      };
+
+    private:
+      /// State shared between copies.
+      struct State
+      {
+        /// cancel() was called.
+        std::atomic<bool> cancelled;
+        /// Deadline (time_point::max() if none).
+        time_point deadline;
+
+        State(time_point deadline):
+          cancelled(false),
+          deadline(deadline)
+        {
+        }
+      };
+
+      /// Shared state.
+      std::shared_ptr<State> state;
+    };
+
+  }
+}
+
+#endif // OME_FILES_CANCELLATIONTOKEN_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
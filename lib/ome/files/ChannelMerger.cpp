@@ -0,0 +1,410 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/ChannelMerger.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      // Add a single-subchannel buffer sharing the storage of one
+      // subchannel of a planar buffer, and return the storage.
+      struct SubchannelSliceVisitor
+      {
+        std::vector<VariantPixelBuffer>&           slices;
+        dimension_size_type                        subC;
+        const PixelBufferBase::storage_order_type& order;
+
+        SubchannelSliceVisitor(std::vector<VariantPixelBuffer>&           slices,
+                               dimension_size_type                        subC,
+                               const PixelBufferBase::storage_order_type& order):
+          slices(slices),
+          subC(subC),
+          order(order)
+        {}
+
+        template<typename T>
+        const void *
+        operator()(const T& v)
+        {
+          typedef typename T::element_type buffer_type;
+
+          std::array<VariantPixelBuffer::size_type, 9> shape;
+          const VariantPixelBuffer::size_type *shape_ptr(v->shape());
+          std::copy(shape_ptr, shape_ptr + PixelBufferBase::dimensions,
+                    shape.begin());
+          shape[DIM_SUBCHANNEL] = 1;
+
+          typename buffer_type::value_type *data =
+            v->data() + (v->strides()[DIM_SUBCHANNEL] * static_cast<PixelBufferBase::index>(subC));
+
+          std::shared_ptr<buffer_type> slice
+            (std::make_shared<buffer_type>(data, shape, v->pixelType(),
+                                           v->endianType(), order));
+          slices.emplace_back(slice);
+          return data;
+        }
+      };
+
+      // Get the storage of a buffer.
+      struct StorageVisitor
+      {
+        template<typename T>
+        const void *
+        operator()(const T& v)
+        {
+          return v ? static_cast<const void *>(v->data()) : nullptr;
+        }
+      };
+
+    }
+
+    const dimension_size_type ChannelMerger::max_channels;
+
+    ChannelMerger::ChannelMerger(const std::shared_ptr<FormatReader>& reader):
+      detail::ChannelReaderWrapper(reader)
+    {
+    }
+
+    ChannelMerger::~ChannelMerger()
+    {
+    }
+
+    bool
+    ChannelMerger::updateCoreMetadata(CoreMetadata& metadata) const
+    {
+      const dimension_size_type channels = metadata.sizeC.size();
+
+      if (channels < 2U || channels > max_channels ||
+          metadata.indexed || metadata.moduloC.size() != 1U)
+        return false;
+      for (const auto samples : metadata.sizeC)
+        {
+          if (samples != 1U)
+            return false;
+        }
+
+      metadata.sizeC.assign(1U, channels);
+      metadata.imageCount /= channels;
+      metadata.interleaved = false;
+
+      return true;
+    }
+
+    void
+    ChannelMerger::readMerged(dimension_size_type                     index,
+                              dimension_size_type                     plane,
+                              const std::vector<VariantPixelBuffer *>& bufs,
+                              const std::vector<PlaneRegion>&          regions,
+                              const read_function&                     read) const
+    {
+      checkPlane(index, plane);
+
+      const CoreMetadata& mcore(*core.at(index));
+      const dimension_size_type samples = mcore.sizeC.at(0);
+
+      // Each destination is planar, so that each subchannel is a
+      // contiguous plane which the wrapped reader may fill directly.
+      const PixelBufferBase::storage_order_type planar
+        (PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, false));
+      const PixelBufferBase::storage_order_type order
+        (PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC,
+                                             getReaderCoreMetadata(index).interleaved));
+
+      for (std::vector<VariantPixelBuffer *>::size_type i = 0; i < bufs.size(); ++i)
+        {
+          VariantPixelBuffer& buf(*bufs[i]);
+
+          std::array<VariantPixelBuffer::size_type, 9> shape, dest_shape;
+          shape[DIM_SPATIAL_X] = regions[i].w;
+          shape[DIM_SPATIAL_Y] = regions[i].h;
+          shape[DIM_SUBCHANNEL] = samples;
+          shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+            shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+          const VariantPixelBuffer::size_type *dest_shape_ptr(buf.shape());
+          std::copy(dest_shape_ptr, dest_shape_ptr + PixelBufferBase::dimensions,
+                    dest_shape.begin());
+
+          if (mcore.pixelType != buf.pixelType() ||
+              !(planar == buf.storage_order()) ||
+              shape != dest_shape)
+            buf.setBuffer(shape, mcore.pixelType, planar, buf.allocator());
+        }
+
+      const DimensionIndexer::coords_type coords(getIndexer(index).coords(plane));
+      const DimensionIndexer readerIndexer(getReaderIndexer(index));
+
+      std::vector<VariantPixelBuffer> slices;
+      std::vector<const void *> storage;
+      for (dimension_size_type s = 0; s < samples; ++s)
+        {
+          // Reserved so that the slices are never copied.
+          slices.clear();
+          slices.reserve(bufs.size());
+          storage.clear();
+          for (const auto buf : bufs)
+            {
+              SubchannelSliceVisitor v(slices, s, order);
+              storage.push_back(ome::compat::visit(v, buf->vbuffer()));
+            }
+
+          read(readerIndexer.index(coords[0], s, coords[2]), slices);
+
+          // If the reader replaced a slice rather than filling it,
+          // for example to use a different storage order, copy it.
+          for (std::vector<VariantPixelBuffer>::size_type i = 0; i < slices.size(); ++i)
+            {
+              StorageVisitor v;
+              if (ome::compat::visit(v, slices[i].vbuffer()) != storage[i])
+                {
+                  VariantPixelBufferView view(*bufs[i],
+                                              PlaneRegion(0, 0, regions[i].w, regions[i].h),
+                                              s);
+                  view.copyFrom(slices[i]);
+                }
+            }
+        }
+    }
+
+    void
+    ChannelMerger::openBytes(dimension_size_type plane,
+                             VariantPixelBuffer& buf) const
+    {
+      openBytes(plane, buf, 0, 0, getSizeX(), getSizeY());
+    }
+
+    void
+    ChannelMerger::openBytes(dimension_size_type plane,
+                             VariantPixelBuffer& buf,
+                             dimension_size_type x,
+                             dimension_size_type y,
+                             dimension_size_type w,
+                             dimension_size_type h) const
+    {
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openBytes(plane, buf, x, y, w, h);
+          return;
+        }
+
+      readMerged(index, plane, {&buf}, {PlaneRegion(x, y, w, h)},
+                 [&](dimension_size_type               wrappedPlane,
+                     std::vector<VariantPixelBuffer>& slices)
+                 {
+                   reader->openBytes(wrappedPlane, slices.front(), x, y, w, h);
+                 });
+    }
+
+    void
+    ChannelMerger::openBytesBatch(dimension_size_type              plane,
+                                  const std::vector<PlaneRegion>&  regions,
+                                  std::vector<VariantPixelBuffer>& bufs) const
+    {
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openBytesBatch(plane, regions, bufs);
+          return;
+        }
+
+      bufs.resize(regions.size());
+      std::vector<VariantPixelBuffer *> dests;
+      for (auto& buf : bufs)
+        dests.push_back(&buf);
+
+      // Each channel is read as a batch, so tiles covered by several
+      // regions are still only decoded once per channel.
+      readMerged(index, plane, dests, regions,
+                 [&](dimension_size_type               wrappedPlane,
+                     std::vector<VariantPixelBuffer>& slices)
+                 {
+                   reader->openBytesBatch(wrappedPlane, regions, slices);
+                 });
+    }
+
+    void
+    ChannelMerger::openBytesDecimated(dimension_size_type plane,
+                                      VariantPixelBuffer& buf,
+                                      const PlaneRegion&  region,
+                                      dimension_size_type xstep,
+                                      dimension_size_type ystep) const
+    {
+      if (xstep == 0U || ystep == 0U)
+        {
+          boost::format fmt("Invalid decimation step %1%×%2%");
+          fmt % xstep % ystep;
+          throw std::logic_error(fmt.str());
+        }
+
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openBytesDecimated(plane, buf, region, xstep, ystep);
+          return;
+        }
+
+      const PlaneRegion size(0, 0,
+                             (region.w + xstep - 1U) / xstep,
+                             (region.h + ystep - 1U) / ystep);
+
+      readMerged(index, plane, {&buf}, {size},
+                 [&](dimension_size_type               wrappedPlane,
+                     std::vector<VariantPixelBuffer>& slices)
+                 {
+                   reader->openBytesDecimated(wrappedPlane, slices.front(),
+                                              region, xstep, ystep);
+                 });
+    }
+
+    void
+    ChannelMerger::openBytesAt(dimension_size_type series,
+                               dimension_size_type resolution,
+                               dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               const PlaneRegion&  region) const
+    {
+      const dimension_size_type index = coreIndexAt(series, resolution);
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openBytesAt(series, resolution, plane, buf, region);
+          return;
+        }
+
+      readMerged(index, plane, {&buf}, {region},
+                 [&](dimension_size_type               wrappedPlane,
+                     std::vector<VariantPixelBuffer>& slices)
+                 {
+                   reader->openBytesAt(series, resolution, wrappedPlane,
+                                       slices.front(), region);
+                 });
+    }
+
+    void
+    ChannelMerger::forEachTile(dimension_size_type  plane,
+                               const tile_callback& callback) const
+    {
+      setPlane(plane);
+
+      if (!isChanged(getCoreIndex()))
+        {
+          ReaderWrapper::forEachTile(plane, callback);
+          return;
+        }
+
+      // The channels are not stored together, so read regions of
+      // the optimal size in row order.
+      const dimension_size_type sizeX = getSizeX();
+      const dimension_size_type sizeY = getSizeY();
+      const dimension_size_type tileWidth = std::max(getOptimalTileWidth(), dimension_size_type(1U));
+      const dimension_size_type tileHeight = std::max(getOptimalTileHeight(), dimension_size_type(1U));
+
+      VariantPixelBuffer buf;
+      for (dimension_size_type y = 0; y < sizeY; y += tileHeight)
+        for (dimension_size_type x = 0; x < sizeX; x += tileWidth)
+          {
+            const PlaneRegion region(x, y,
+                                     std::min(tileWidth, sizeX - x),
+                                     std::min(tileHeight, sizeY - y));
+            openBytes(plane, buf, region.x, region.y, region.w, region.h);
+            callback(region, buf);
+          }
+    }
+
+    void
+    ChannelMerger::openThumbBytes(dimension_size_type plane,
+                                  VariantPixelBuffer& buf) const
+    {
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openThumbBytes(plane, buf);
+          return;
+        }
+
+      const PlaneRegion size(0, 0,
+                             std::max(getThumbSizeX(), dimension_size_type(1U)),
+                             std::max(getThumbSizeY(), dimension_size_type(1U)));
+
+      readMerged(index, plane, {&buf}, {size},
+                 [&](dimension_size_type               wrappedPlane,
+                     std::vector<VariantPixelBuffer>& slices)
+                 {
+                   reader->openThumbBytes(wrappedPlane, slices.front());
+                 });
+    }
+
+    dimension_size_type
+    ChannelMerger::getOptimalTileWidth(dimension_size_type channel) const
+    {
+      if (!isChanged(getCoreIndex()))
+        return ReaderWrapper::getOptimalTileWidth(channel);
+      return reader->getOptimalTileWidth();
+    }
+
+    dimension_size_type
+    ChannelMerger::getOptimalTileHeight(dimension_size_type channel) const
+    {
+      if (!isChanged(getCoreIndex()))
+        return ReaderWrapper::getOptimalTileHeight(channel);
+      return reader->getOptimalTileHeight();
+    }
+
+  }
+}
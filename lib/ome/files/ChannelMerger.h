@@ -0,0 +1,192 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_CHANNELMERGER_H
+#define OME_FILES_CHANNELMERGER_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/ChannelReaderWrapper.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Reader wrapper merging separate channels into RGB planes.
+     *
+     * For each series with between two and four channels of a
+     * single sample, which are not indexed, the channels of each
+     * plane are presented as the subchannels of a single RGB
+     * plane.  The image count is reduced accordingly, and the
+     * merged planes are not interleaved.  Other series are
+     * presented unchanged.
+     *
+     * Merged planes are read without intermediate copies: the
+     * destination buffer is allocated once with planar storage,
+     * and each channel is read by the wrapped reader directly into
+     * its subchannel of the destination.
+     *
+     * The MetadataStore is not changed, and continues to describe
+     * the channels of the wrapped reader.
+     */
+    class ChannelMerger : public detail::ChannelReaderWrapper
+    {
+    public:
+      /// The maximum number of channels to merge.
+      static const dimension_size_type max_channels = 4U;
+
+      /**
+       * Constructor.
+       *
+       * @param reader the reader to wrap.
+       * @throws std::logic_error if the reader is null.
+       */
+      explicit
+      ChannelMerger(const std::shared_ptr<FormatReader>& reader);
+
+      /// Destructor.
+      virtual
+      ~ChannelMerger();
+
+    protected:
+      // Documented in superclass.
+      bool
+      updateCoreMetadata(CoreMetadata& metadata) const;
+
+    private:
+      /**
+       * Function to read a channel of a plane.
+       *
+       * The plane index is the index in the wrapped reader, and the
+       * buffers refer to the subchannels of the destination buffers.
+       */
+      typedef std::function<void (dimension_size_type               plane,
+                                  std::vector<VariantPixelBuffer>& bufs)> read_function;
+
+      /**
+       * Read the channels of a plane into merged buffers.
+       *
+       * @param index the core index.
+       * @param plane the merged plane index.
+       * @param bufs the destination buffers.
+       * @param regions the size of each destination buffer; only
+       * the width and height are used.
+       * @param read the function to read each channel.
+       */
+      void
+      readMerged(dimension_size_type                     index,
+                 dimension_size_type                     plane,
+                 const std::vector<VariantPixelBuffer *>& bufs,
+                 const std::vector<PlaneRegion>&          regions,
+                 const read_function&                     read) const;
+
+    public:
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const;
+
+      // Documented in superclass.
+      void
+      openBytesBatch(dimension_size_type              plane,
+                     const std::vector<PlaneRegion>&  regions,
+                     std::vector<VariantPixelBuffer>& bufs) const;
+
+      // Documented in superclass.
+      void
+      openBytesDecimated(dimension_size_type plane,
+                         VariantPixelBuffer& buf,
+                         const PlaneRegion&  region,
+                         dimension_size_type xstep,
+                         dimension_size_type ystep) const;
+
+      // Documented in superclass.
+      void
+      openBytesAt(dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  const PlaneRegion&  region) const;
+
+      // Documented in superclass.
+      void
+      forEachTile(dimension_size_type  plane,
+                  const tile_callback& callback) const;
+
+      // Documented in superclass.
+      void
+      openThumbBytes(dimension_size_type plane,
+                     VariantPixelBuffer& buf) const;
+
+      using ReaderWrapper::getOptimalTileWidth;
+      using ReaderWrapper::getOptimalTileHeight;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileWidth(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileHeight(dimension_size_type channel) const;
+    };
+
+  }
+}
+
+#endif // OME_FILES_CHANNELMERGER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
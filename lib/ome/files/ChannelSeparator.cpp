@@ -0,0 +1,369 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/ChannelSeparator.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      // Check if a region lies within another region.
+      bool
+      contains(const PlaneRegion& outer,
+               const PlaneRegion& inner)
+      {
+        return inner.x >= outer.x &&
+          inner.y >= outer.y &&
+          inner.x + inner.w <= outer.x + outer.w &&
+          inner.y + inner.h <= outer.y + outer.h;
+      }
+
+    }
+
+    ChannelSeparator::ChannelSeparator(const std::shared_ptr<FormatReader>& reader):
+      detail::ChannelReaderWrapper(reader),
+      cacheMutex(),
+      cached(false),
+      cachedIndex(0U),
+      cachedPlane(0U),
+      cachedRegion(),
+      cachedBuffer()
+    {
+    }
+
+    ChannelSeparator::~ChannelSeparator()
+    {
+    }
+
+    bool
+    ChannelSeparator::updateCoreMetadata(CoreMetadata& metadata) const
+    {
+      if (metadata.indexed || metadata.moduloC.size() != 1U)
+        return false;
+
+      dimension_size_type channels = 0U;
+      for (const auto samples : metadata.sizeC)
+        channels += samples;
+
+      if (channels == metadata.sizeC.size())
+        return false;
+
+      metadata.imageCount = (metadata.imageCount / metadata.sizeC.size()) * channels;
+      metadata.sizeC.assign(channels, 1U);
+      metadata.interleaved = false;
+
+      return true;
+    }
+
+    std::array<dimension_size_type, 2>
+    ChannelSeparator::readerChannel(dimension_size_type index,
+                                    dimension_size_type channel) const
+    {
+      const std::vector<dimension_size_type>& sizeC(getReaderCoreMetadata(index).sizeC);
+
+      std::array<dimension_size_type, 2> ret{{0U, channel}};
+      while (ret[1] >= sizeC.at(ret[0]))
+        {
+          ret[1] -= sizeC.at(ret[0]);
+          ++ret[0];
+        }
+      return ret;
+    }
+
+    std::array<dimension_size_type, 2>
+    ChannelSeparator::readerPlane(dimension_size_type index,
+                                  dimension_size_type plane) const
+    {
+      checkPlane(index, plane);
+
+      const DimensionIndexer::coords_type coords(getIndexer(index).coords(plane));
+      const std::array<dimension_size_type, 2> channel(readerChannel(index, coords[1]));
+
+      std::array<dimension_size_type, 2> ret
+        {{getReaderIndexer(index).index(coords[0], channel[0], coords[2]), channel[1]}};
+      return ret;
+    }
+
+    void
+    ChannelSeparator::readSeparated(dimension_size_type  index,
+                                    dimension_size_type  plane,
+                                    VariantPixelBuffer&  buf,
+                                    const PlaneRegion&   region,
+                                    const read_function& read) const
+    {
+      const std::array<dimension_size_type, 2> rplane(readerPlane(index, plane));
+
+      std::lock_guard<std::mutex> lock(cacheMutex);
+
+      if (!cached ||
+          cachedIndex != index ||
+          cachedPlane != rplane[0] ||
+          !contains(cachedRegion, region))
+        {
+          cached = false;
+          read(rplane[0], cachedBuffer);
+          cachedIndex = index;
+          cachedPlane = rplane[0];
+          cachedRegion = region;
+          cached = true;
+        }
+
+      VariantPixelBufferView view(cachedBuffer,
+                                  PlaneRegion(region.x - cachedRegion.x,
+                                              region.y - cachedRegion.y,
+                                              region.w, region.h),
+                                  rplane[1]);
+      view.copyTo(buf,
+                  PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, false));
+    }
+
+    void
+    ChannelSeparator::clearCache() const
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      cached = false;
+      cachedBuffer.vbuffer() = VariantPixelBuffer().vbuffer();
+    }
+
+    void
+    ChannelSeparator::setId(const boost::filesystem::path& id)
+    {
+      clearCache();
+      detail::ChannelReaderWrapper::setId(id);
+    }
+
+    void
+    ChannelSeparator::close(bool fileOnly)
+    {
+      clearCache();
+      detail::ChannelReaderWrapper::close(fileOnly);
+    }
+
+    void
+    ChannelSeparator::openBytes(dimension_size_type plane,
+                                VariantPixelBuffer& buf) const
+    {
+      openBytes(plane, buf, 0, 0, getSizeX(), getSizeY());
+    }
+
+    void
+    ChannelSeparator::openBytes(dimension_size_type plane,
+                                VariantPixelBuffer& buf,
+                                dimension_size_type x,
+                                dimension_size_type y,
+                                dimension_size_type w,
+                                dimension_size_type h) const
+    {
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openBytes(plane, buf, x, y, w, h);
+          return;
+        }
+
+      readSeparated(index, plane, buf, PlaneRegion(x, y, w, h),
+                    [&](dimension_size_type wrappedPlane,
+                        VariantPixelBuffer& dest)
+                    {
+                      reader->openBytes(wrappedPlane, dest, x, y, w, h);
+                    });
+    }
+
+    void
+    ChannelSeparator::openBytesBatch(dimension_size_type              plane,
+                                     const std::vector<PlaneRegion>&  regions,
+                                     std::vector<VariantPixelBuffer>& bufs) const
+    {
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openBytesBatch(plane, regions, bufs);
+          return;
+        }
+
+      const std::array<dimension_size_type, 2> rplane(readerPlane(index, plane));
+
+      std::vector<VariantPixelBuffer> rbufs;
+      reader->openBytesBatch(rplane[0], regions, rbufs);
+
+      bufs.resize(regions.size());
+      for (std::vector<VariantPixelBuffer>::size_type i = 0; i < rbufs.size(); ++i)
+        {
+          detail::CopySubchannelVisitor v(bufs[i], rplane[1]);
+          ome::compat::visit(v, rbufs[i].vbuffer());
+        }
+    }
+
+    void
+    ChannelSeparator::openBytesDecimated(dimension_size_type plane,
+                                         VariantPixelBuffer& buf,
+                                         const PlaneRegion&  region,
+                                         dimension_size_type xstep,
+                                         dimension_size_type ystep) const
+    {
+      if (xstep == 0U || ystep == 0U)
+        {
+          boost::format fmt("Invalid decimation step %1%×%2%");
+          fmt % xstep % ystep;
+          throw std::logic_error(fmt.str());
+        }
+
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openBytesDecimated(plane, buf, region, xstep, ystep);
+          return;
+        }
+
+      const std::array<dimension_size_type, 2> rplane(readerPlane(index, plane));
+
+      VariantPixelBuffer rbuf;
+      reader->openBytesDecimated(rplane[0], rbuf, region, xstep, ystep);
+
+      detail::CopySubchannelVisitor v(buf, rplane[1]);
+      ome::compat::visit(v, rbuf.vbuffer());
+    }
+
+    void
+    ChannelSeparator::openBytesAt(dimension_size_type series,
+                                  dimension_size_type resolution,
+                                  dimension_size_type plane,
+                                  VariantPixelBuffer& buf,
+                                  const PlaneRegion&  region) const
+    {
+      const dimension_size_type index = coreIndexAt(series, resolution);
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openBytesAt(series, resolution, plane, buf, region);
+          return;
+        }
+
+      readSeparated(index, plane, buf, region,
+                    [&](dimension_size_type wrappedPlane,
+                        VariantPixelBuffer& dest)
+                    {
+                      reader->openBytesAt(series, resolution, wrappedPlane, dest, region);
+                    });
+    }
+
+    void
+    ChannelSeparator::forEachTile(dimension_size_type  plane,
+                                  const tile_callback& callback) const
+    {
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::forEachTile(plane, callback);
+          return;
+        }
+
+      const std::array<dimension_size_type, 2> rplane(readerPlane(index, plane));
+
+      VariantPixelBuffer buf;
+      reader->forEachTile(rplane[0],
+                          [&](const PlaneRegion&        region,
+                              const VariantPixelBuffer& chunk)
+                          {
+                            detail::CopySubchannelVisitor v(buf, rplane[1]);
+                            ome::compat::visit(v, chunk.vbuffer());
+                            callback(region, buf);
+                          });
+    }
+
+    void
+    ChannelSeparator::openThumbBytes(dimension_size_type plane,
+                                     VariantPixelBuffer& buf) const
+    {
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        {
+          ReaderWrapper::openThumbBytes(plane, buf);
+          return;
+        }
+
+      const std::array<dimension_size_type, 2> rplane(readerPlane(index, plane));
+
+      // Thumbnails are cached by the wrapped reader.
+      VariantPixelBuffer rbuf;
+      reader->openThumbBytes(rplane[0], rbuf);
+
+      detail::CopySubchannelVisitor v(buf, rplane[1]);
+      ome::compat::visit(v, rbuf.vbuffer());
+    }
+
+    dimension_size_type
+    ChannelSeparator::getOptimalTileWidth(dimension_size_type channel) const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        return ReaderWrapper::getOptimalTileWidth(channel);
+      return reader->getOptimalTileWidth(readerChannel(index, channel)[0]);
+    }
+
+    dimension_size_type
+    ChannelSeparator::getOptimalTileHeight(dimension_size_type channel) const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isChanged(index))
+        return ReaderWrapper::getOptimalTileHeight(channel);
+      return reader->getOptimalTileHeight(readerChannel(index, channel)[0]);
+    }
+
+  }
+}
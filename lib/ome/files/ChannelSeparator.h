@@ -0,0 +1,245 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_CHANNELSEPARATOR_H
+#define OME_FILES_CHANNELSEPARATOR_H
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/ChannelReaderWrapper.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Reader wrapper separating RGB channels into separate planes.
+     *
+     * For each series with any channel of more than one sample,
+     * which is not indexed, each sample is presented as a separate
+     * channel of a single sample.  The image count is increased
+     * accordingly, and the separated planes are not interleaved.
+     * Other series are presented unchanged.
+     *
+     * Separating the channels of a plane requires the whole
+     * (typically interleaved) plane to be decoded, so the region of
+     * the last plane read is cached.  Reading the samples of the
+     * same plane in turn, for the same or a contained region,
+     * decodes the plane only once; each read copies a single
+     * subchannel from the cached plane.
+     *
+     * The MetadataStore is not changed, and continues to describe
+     * the channels of the wrapped reader.
+     */
+    class ChannelSeparator : public detail::ChannelReaderWrapper
+    {
+    private:
+      /// Mutex for the cached plane.
+      mutable std::mutex cacheMutex;
+
+      /// Is a plane cached?
+      mutable bool cached;
+
+      /// Core index of the cached plane.
+      mutable dimension_size_type cachedIndex;
+
+      /// Wrapped reader plane index of the cached plane.
+      mutable dimension_size_type cachedPlane;
+
+      /// Region of the cached plane.
+      mutable PlaneRegion cachedRegion;
+
+      /// Pixel data of the cached plane.
+      mutable VariantPixelBuffer cachedBuffer;
+
+    public:
+      /**
+       * Constructor.
+       *
+       * @param reader the reader to wrap.
+       * @throws std::logic_error if the reader is null.
+       */
+      explicit
+      ChannelSeparator(const std::shared_ptr<FormatReader>& reader);
+
+      /// Destructor.
+      virtual
+      ~ChannelSeparator();
+
+    protected:
+      // Documented in superclass.
+      bool
+      updateCoreMetadata(CoreMetadata& metadata) const;
+
+    private:
+      /**
+       * Function to read a region of a plane.
+       *
+       * The plane index is the index in the wrapped reader.
+       */
+      typedef std::function<void (dimension_size_type plane,
+                                  VariantPixelBuffer& buf)> read_function;
+
+      /**
+       * Get the wrapped reader channel of a separated channel.
+       *
+       * @param index the core index.
+       * @param channel the separated channel.
+       * @returns the wrapped reader channel and its subchannel.
+       */
+      std::array<dimension_size_type, 2>
+      readerChannel(dimension_size_type index,
+                    dimension_size_type channel) const;
+
+      /**
+       * Get the wrapped reader plane of a separated plane.
+       *
+       * @param index the core index.
+       * @param plane the separated plane.
+       * @returns the wrapped reader plane and subchannel.
+       * @throws std::logic_error if the plane is invalid.
+       */
+      std::array<dimension_size_type, 2>
+      readerPlane(dimension_size_type index,
+                  dimension_size_type plane) const;
+
+      /**
+       * Read a region of a separated plane using the cache.
+       *
+       * @param index the core index.
+       * @param plane the separated plane.
+       * @param buf the destination buffer.
+       * @param region the region to read.
+       * @param read the function to read the region of the wrapped
+       * reader plane if not cached.
+       */
+      void
+      readSeparated(dimension_size_type  index,
+                    dimension_size_type  plane,
+                    VariantPixelBuffer&  buf,
+                    const PlaneRegion&   region,
+                    const read_function& read) const;
+
+      /// Discard the cached plane.
+      void
+      clearCache() const;
+
+    public:
+      // Documented in superclass.
+      void
+      setId(const boost::filesystem::path& id);
+
+      // Documented in superclass.
+      void
+      close(bool fileOnly = false);
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const;
+
+      // Documented in superclass.
+      void
+      openBytesBatch(dimension_size_type              plane,
+                     const std::vector<PlaneRegion>&  regions,
+                     std::vector<VariantPixelBuffer>& bufs) const;
+
+      // Documented in superclass.
+      void
+      openBytesDecimated(dimension_size_type plane,
+                         VariantPixelBuffer& buf,
+                         const PlaneRegion&  region,
+                         dimension_size_type xstep,
+                         dimension_size_type ystep) const;
+
+      // Documented in superclass.
+      void
+      openBytesAt(dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  const PlaneRegion&  region) const;
+
+      // Documented in superclass.
+      void
+      forEachTile(dimension_size_type  plane,
+                  const tile_callback& callback) const;
+
+      // Documented in superclass.
+      void
+      openThumbBytes(dimension_size_type plane,
+                     VariantPixelBuffer& buf) const;
+
+      using ReaderWrapper::getOptimalTileWidth;
+      using ReaderWrapper::getOptimalTileHeight;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileWidth(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileHeight(dimension_size_type channel) const;
+    };
+
+  }
+}
+
+#endif // OME_FILES_CHANNELSEPARATOR_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -37,6 +37,26 @@
 
 #include <ome/files/CoreMetadata.h>
 
+namespace
+{
+
+  bool
+  equal_modulo(const ome::files::Modulo& lhs,
+               const ome::files::Modulo& rhs)
+  {
+    return (lhs.parentDimension == rhs.parentDimension &&
+            lhs.start == rhs.start &&
+            lhs.step == rhs.step &&
+            lhs.end == rhs.end &&
+            lhs.parentType == rhs.parentType &&
+            lhs.type == rhs.type &&
+            lhs.typeDescription == rhs.typeDescription &&
+            lhs.unit == rhs.unit &&
+            lhs.labels == rhs.labels);
+  }
+
+}
+
 namespace ome
 {
   namespace files
@@ -101,5 +121,34 @@ namespace ome
     {
     }
 
+    bool
+    operator== (const CoreMetadata& lhs,
+                const CoreMetadata& rhs)
+    {
+      return (lhs.sizeX == rhs.sizeX &&
+              lhs.sizeY == rhs.sizeY &&
+              lhs.sizeZ == rhs.sizeZ &&
+              lhs.sizeC == rhs.sizeC &&
+              lhs.sizeT == rhs.sizeT &&
+              lhs.thumbSizeX == rhs.thumbSizeX &&
+              lhs.thumbSizeY == rhs.thumbSizeY &&
+              lhs.pixelType == rhs.pixelType &&
+              lhs.bitsPerPixel == rhs.bitsPerPixel &&
+              lhs.imageCount == rhs.imageCount &&
+              equal_modulo(lhs.moduloZ, rhs.moduloZ) &&
+              equal_modulo(lhs.moduloT, rhs.moduloT) &&
+              equal_modulo(lhs.moduloC, rhs.moduloC) &&
+              lhs.dimensionOrder == rhs.dimensionOrder &&
+              lhs.orderCertain == rhs.orderCertain &&
+              lhs.littleEndian == rhs.littleEndian &&
+              lhs.interleaved == rhs.interleaved &&
+              lhs.indexed == rhs.indexed &&
+              lhs.falseColor == rhs.falseColor &&
+              lhs.metadataComplete == rhs.metadataComplete &&
+              lhs.thumbnail == rhs.thumbnail &&
+              lhs.resolutionCount == rhs.resolutionCount &&
+              lhs.seriesMetadata.map() == rhs.seriesMetadata.map());
+    }
+
   }
 }
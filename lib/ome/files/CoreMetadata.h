@@ -169,6 +169,35 @@ namespace ome
       ~CoreMetadata();
     };
 
+    /**
+     * Compare CoreMetadata for equality.
+     *
+     * All fields are compared, including the series metadata.  Only
+     * the CoreMetadata fields are compared; the fields of derived
+     * classes are not considered.
+     *
+     * @param lhs the first CoreMetadata to compare.
+     * @param rhs the second CoreMetadata to compare.
+     * @returns @c true if equal, @c false otherwise.
+     */
+    bool
+    operator== (const CoreMetadata& lhs,
+                const CoreMetadata& rhs);
+
+    /**
+     * Compare CoreMetadata for inequality.
+     *
+     * @param lhs the first CoreMetadata to compare.
+     * @param rhs the second CoreMetadata to compare.
+     * @returns @c true if not equal, @c false otherwise.
+     */
+    inline bool
+    operator!= (const CoreMetadata& lhs,
+                const CoreMetadata& rhs)
+    {
+      return !(lhs == rhs);
+    }
+
     /**
      * Output CoreMetadata to output stream.
      *
@@ -0,0 +1,204 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <ome/files/config-internal.h>
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+
+#include <boost/endian/conversion.hpp>
+
+#include <ome/files/DLPack.h>
+
+#ifdef OME_FILES_HAVE_DLPACK
+#include <dlpack/dlpack.h>
+#endif // OME_FILES_HAVE_DLPACK
+
+using ome::files::EndianType;
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ::ome::xml::model::enums::PixelType;
+
+#ifdef OME_FILES_HAVE_DLPACK
+
+namespace
+{
+
+  // Storage for a managed tensor.  The tensor is the first member,
+  // so that the address of the tensor passed to the deleter is also
+  // the address of its context.
+  template<typename T>
+  struct ManagedBuffer
+  {
+    DLManagedTensor                                  tensor;
+    std::shared_ptr<PixelBuffer<T>>                  buffer;
+    std::array<int64_t, PixelBufferBase::dimensions> shape;
+    std::array<int64_t, PixelBufferBase::dimensions> strides;
+  };
+
+  template<typename T>
+  void
+  delete_managed(DLManagedTensor *self)
+  {
+    delete static_cast<ManagedBuffer<T> *>(self->manager_ctx);
+  }
+
+  // DLPack type code and size of each element.
+  template<typename T>
+  DLDataType
+  dl_type(PixelType pixeltype)
+  {
+    DLDataType type;
+    type.bits = static_cast<uint8_t>(sizeof(T) * 8U);
+    type.lanes = 1U;
+
+    switch(pixeltype)
+      {
+      case PixelType::INT8:
+      case PixelType::INT16:
+      case PixelType::INT32:
+        type.code = kDLInt;
+        break;
+      case PixelType::UINT8:
+      case PixelType::UINT16:
+      case PixelType::UINT32:
+        type.code = kDLUInt;
+        break;
+      case PixelType::FLOAT:
+      case PixelType::DOUBLE:
+        type.code = kDLFloat;
+        break;
+      case PixelType::COMPLEXFLOAT:
+      case PixelType::COMPLEXDOUBLE:
+        type.code = kDLComplex;
+        break;
+      case PixelType::BIT:
+#if defined(DLPACK_MAJOR_VERSION) || (defined(DLPACK_VERSION) && DLPACK_VERSION >= 80)
+        type.code = kDLBool;
+#else
+        type.code = kDLUInt;
+#endif
+        break;
+      default:
+        throw std::logic_error("Unsupported pixel type for DLPack export");
+      }
+
+    return type;
+  }
+
+  struct DLPackVisitor
+  {
+    template<typename T>
+    DLManagedTensor *
+    operator()(const std::shared_ptr<PixelBuffer<T>>& buffer)
+    {
+      if (!buffer)
+        throw std::logic_error("Null pixel buffer");
+
+      const EndianType endian = buffer->endianType();
+      if ((endian == ome::files::ENDIAN_BIG &&
+           boost::endian::order::big != boost::endian::order::native) ||
+          (endian == ome::files::ENDIAN_LITTLE &&
+           boost::endian::order::little != boost::endian::order::native))
+        throw std::logic_error("DLPack export requires pixel data in the native byte order");
+
+      std::unique_ptr<ManagedBuffer<T>> managed(new ManagedBuffer<T>());
+      managed->buffer = buffer;
+
+      const PixelBufferBase::size_type *shape = buffer->shape();
+      const PixelBufferBase::index *strides = buffer->strides();
+      for (uint16_t d = 0; d < PixelBufferBase::dimensions; ++d)
+        {
+          managed->shape[d] = static_cast<int64_t>(shape[d]);
+          managed->strides[d] = static_cast<int64_t>(strides[d]);
+        }
+
+      DLTensor& t(managed->tensor.dl_tensor);
+      t.data = const_cast<T *>(buffer->origin());
+      t.device.device_type = kDLCPU;
+      t.device.device_id = 0;
+      t.ndim = static_cast<int32_t>(PixelBufferBase::dimensions);
+      t.dtype = dl_type<T>(buffer->pixelType());
+      t.shape = managed->shape.data();
+      t.strides = managed->strides.data();
+      t.byte_offset = 0U;
+
+      managed->tensor.manager_ctx = managed.get();
+      managed->tensor.deleter = &delete_managed<T>;
+
+      return &managed.release()->tensor;
+    }
+  };
+
+}
+
+#endif // OME_FILES_HAVE_DLPACK
+
+namespace ome
+{
+  namespace files
+  {
+
+    bool
+    haveDLPack()
+    {
+#ifdef OME_FILES_HAVE_DLPACK
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    DLManagedTensor *
+    toDLPack(const VariantPixelBuffer& buffer)
+    {
+#ifdef OME_FILES_HAVE_DLPACK
+      if (!buffer.valid())
+        throw std::logic_error("Invalid pixel buffer");
+
+      DLPackVisitor v;
+      return ome::compat::visit(v, buffer.vbuffer());
+#else
+      static_cast<void>(buffer);
+      throw std::runtime_error("DLPack export is not available (OME-Files was built without DLPack)");
+#endif
+    }
+
+  }
+}
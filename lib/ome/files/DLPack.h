@@ -0,0 +1,106 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DLPACK_H
+#define OME_FILES_DLPACK_H
+
+#include <ome/files/VariantPixelBuffer.h>
+
+/// DLPack managed tensor (defined by dlpack/dlpack.h).
+struct DLManagedTensor;
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Check if DLPack export is available.
+     *
+     * DLPack export requires the DLPack header when OME-Files is
+     * built; it is not needed by users of this interface.
+     *
+     * @returns @c true if toDLPack() is available, @c false if it
+     * always throws.
+     */
+    bool
+    haveDLPack();
+
+    /**
+     * Export a pixel buffer as a DLPack tensor without copying.
+     *
+     * The tensor refers to the pixel data of the buffer, and shares
+     * ownership of the contained PixelBuffer, which remains valid
+     * until the tensor deleter is called, even if @p buffer is
+     * destroyed or reset to a new buffer in the meantime.  If the
+     * PixelBuffer uses external storage, the storage must remain
+     * valid until then.  Writes through either the buffer or the
+     * tensor are visible to the other.
+     *
+     * The tensor has nine dimensions, in the same logical order as
+     * the buffer (@c DIM_SPATIAL_X first and @c DIM_SUBCHANNEL
+     * last), with the strides of its storage order, so that
+     * interleaved and planar buffers are both exported as they are
+     * stored.  The data pointer is the origin of the buffer (the
+     * element at index zero), with a zero byte offset.  Complex
+     * pixel types are exported as @c kDLComplex, and @c BIT pixels
+     * (one @c bool per element) as @c kDLBool where available, or
+     * as 8 bit @c kDLUInt otherwise.  The device is always @c kDLCPU.
+     *
+     * The caller, or the framework it passes the tensor to, must
+     * call the deleter of the returned tensor exactly once.
+     *
+     * @param buffer the buffer to export.
+     * @returns a newly allocated managed tensor.
+     * @throws std::logic_error if the buffer is not valid, or is not
+     * in the native byte order.
+     * @throws std::runtime_error if DLPack export is not available.
+     */
+    DLManagedTensor *
+    toDLPack(const VariantPixelBuffer& buffer);
+
+  }
+}
+
+#endif // OME_FILES_DLPACK_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
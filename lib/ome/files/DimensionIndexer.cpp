@@ -0,0 +1,198 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/DimensionIndexer.h>
+
+using ome::xml::model::enums::DimensionOrder;
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      void
+      throw_exception(const std::string& dim,
+                      const std::string& what,
+                      dimension_size_type value)
+      {
+        boost::format fmt("Invalid %1% %2%: %3%");
+        fmt % dim % what % value;
+        throw std::out_of_range(fmt.str());
+      }
+
+      void
+      throw_exception(const std::string& dim,
+                      const std::string& what,
+                      dimension_size_type value1,
+                      dimension_size_type value2)
+      {
+        boost::format fmt("Invalid %1% %2%: %3%/%4%");
+        fmt % dim % what % value1 % value2;
+        throw std::out_of_range(fmt.str());
+      }
+
+    }
+
+    DimensionIndexer::DimensionIndexer(DimensionOrder      order,
+                                       dimension_size_type zSize,
+                                       dimension_size_type cSize,
+                                       dimension_size_type tSize,
+                                       dimension_size_type num):
+      DimensionIndexer(order, zSize, cSize, tSize, 1U, 1U, 1U, num)
+    {
+    }
+
+    // No switch default to avoid -Wunreachable-code errors.
+    // However, this then makes -Wswitch-default complain.  Disable
+    // temporarily.
+#ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+
+    DimensionIndexer::DimensionIndexer(DimensionOrder      order,
+                                       dimension_size_type zSize,
+                                       dimension_size_type cSize,
+                                       dimension_size_type tSize,
+                                       dimension_size_type moduloZSize,
+                                       dimension_size_type moduloCSize,
+                                       dimension_size_type moduloTSize,
+                                       dimension_size_type num):
+      order(order),
+      sizes{{zSize, cSize, tSize}},
+      modulo{{moduloZSize, moduloCSize, moduloTSize}},
+      stride(),
+      num(num)
+    {
+      if (!zSize)
+        throw_exception("Z", "size", zSize);
+      if (!tSize)
+        throw_exception("T", "size", tSize);
+      if (!cSize)
+        throw_exception("C", "size", cSize);
+      if (!moduloZSize)
+        throw_exception("ModuloZ", "size", moduloZSize);
+      if (!moduloTSize)
+        throw_exception("ModuloT", "size", moduloTSize);
+      if (!moduloCSize)
+        throw_exception("ModuloC", "size", moduloCSize);
+
+      if (!num)
+        {
+          boost::format fmt("Invalid image count: %1%");
+          fmt % num;
+          throw std::logic_error(fmt.str());
+        }
+
+      if (num != (zSize * cSize * tSize))
+        {
+          boost::format fmt("ZCT/image count mismatch (sizeZ=%1%, sizeT=%2%, sizeC=%3%, total=%4%");
+          fmt % zSize % tSize % cSize % num;
+          throw std::logic_error(fmt.str());
+        }
+
+      // Rasterization order of Z (0), C (1) and T (2), fastest
+      // varying first.
+      std::array<dimension_size_type, 3> raster{{0U, 1U, 2U}};
+      switch(order)
+        {
+        case DimensionOrder::XYZCT:
+          raster = {{0U, 1U, 2U}};
+          break;
+        case DimensionOrder::XYZTC:
+          raster = {{0U, 2U, 1U}};
+          break;
+        case DimensionOrder::XYCZT:
+          raster = {{1U, 0U, 2U}};
+          break;
+        case DimensionOrder::XYCTZ:
+          raster = {{1U, 2U, 0U}};
+          break;
+        case DimensionOrder::XYTZC:
+          raster = {{2U, 0U, 1U}};
+          break;
+        case DimensionOrder::XYTCZ:
+          raster = {{2U, 1U, 0U}};
+          break;
+        }
+
+      dimension_size_type s = 1U;
+      for (const auto dim : raster)
+        {
+          stride[dim] = s;
+          s *= sizes[dim];
+        }
+    }
+
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+
+    void
+    DimensionIndexer::checkCoords(dimension_size_type z,
+                                  dimension_size_type c,
+                                  dimension_size_type t) const
+    {
+      if (z >= sizes[0])
+        throw_exception("Z", "index", z, sizes[0]);
+      if (t >= sizes[2])
+        throw_exception("T", "index", t, sizes[2]);
+      if (c >= sizes[1])
+        throw_exception("C", "index", c, sizes[1]);
+    }
+
+    void
+    DimensionIndexer::checkIndex(dimension_size_type index) const
+    {
+      if (index >= num)
+        {
+          boost::format fmt("Invalid index: %1%");
+          fmt % index;
+          throw std::out_of_range(fmt.str());
+        }
+    }
+
+  }
+}
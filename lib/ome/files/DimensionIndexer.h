@@ -0,0 +1,333 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DIMENSIONINDEXER_H
+#define OME_FILES_DIMENSIONINDEXER_H
+
+#include <array>
+
+#include <ome/files/Types.h>
+
+#include <ome/xml/model/enums/DimensionOrder.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Conversion between plane indexes and @c Z, @c C and @c T
+     * coordinates.
+     *
+     * This performs the same conversions as ome::files::getIndex()
+     * and ome::files::getZCTCoords(), but the dimension order and
+     * sizes are validated once, on construction, rather than on
+     * every conversion.  The conversions are then simple arithmetic
+     * using precomputed strides, which is suitable for iterating
+     * over large numbers of planes.
+     *
+     * The index() and coords() methods do not check their
+     * arguments; use checkCoords() and checkIndex() when the
+     * arguments are not known to be in range.
+     */
+    class DimensionIndexer
+    {
+    public:
+      /// @c Z, @c C and @c T coordinates.
+      typedef std::array<dimension_size_type, 3> coords_type;
+
+      /// @c Z, @c C, @c T, @c ModuloZ, @c ModuloC and @c ModuloT coordinates.
+      typedef std::array<dimension_size_type, 6> modulo_coords_type;
+
+      /**
+       * Constructor.
+       *
+       * @param order the dimension order.
+       * @param zSize total number of focal planes (real size).
+       * @param cSize total number of channels (real size).
+       * @param tSize total number of time points (real size).
+       * @param num total number of image planes (zSize * cSize * tSize),
+       *   specified as a consistency check.
+       * @throws std::logic_error or std::out_of_range if the sizes
+       * are invalid.
+       */
+      DimensionIndexer(ome::xml::model::enums::DimensionOrder order,
+                       dimension_size_type                    zSize,
+                       dimension_size_type                    cSize,
+                       dimension_size_type                    tSize,
+                       dimension_size_type                    num);
+
+      /**
+       * Constructor with modulo dimensions.
+       *
+       * @param order the dimension order.
+       * @param zSize total number of focal planes (real size).
+       * @param cSize total number of channels (real size).
+       * @param tSize total number of time points (real size).
+       * @param moduloZSize total number of ModuloZ planes (real size).
+       * @param moduloCSize total number of ModuloC channels (real size).
+       * @param moduloTSize total number of ModuloT time points (real size).
+       * @param num total number of image planes (zSize * cSize * tSize),
+       *   specified as a consistency check.
+       * @throws std::logic_error or std::out_of_range if the sizes
+       * are invalid.
+       */
+      DimensionIndexer(ome::xml::model::enums::DimensionOrder order,
+                       dimension_size_type                    zSize,
+                       dimension_size_type                    cSize,
+                       dimension_size_type                    tSize,
+                       dimension_size_type                    moduloZSize,
+                       dimension_size_type                    moduloCSize,
+                       dimension_size_type                    moduloTSize,
+                       dimension_size_type                    num);
+
+      /**
+       * Get the dimension order.
+       *
+       * @returns the dimension order.
+       */
+      ome::xml::model::enums::DimensionOrder
+      getDimensionOrder() const
+      {
+        return order;
+      }
+
+      /**
+       * Get the total number of image planes.
+       *
+       * @returns the number of planes.
+       */
+      dimension_size_type
+      size() const
+      {
+        return num;
+      }
+
+      /**
+       * Check @c Z, @c C and @c T coordinates are in range.
+       *
+       * @param z the @c Z coordinate (real size).
+       * @param c the @c C coordinate (real size).
+       * @param t the @c T coordinate (real size).
+       * @throws std::out_of_range if any coordinate is out of range.
+       */
+      void
+      checkCoords(dimension_size_type z,
+                  dimension_size_type c,
+                  dimension_size_type t) const;
+
+      /**
+       * Check @c Z, @c C, @c T, @c ModuloZ, @c ModuloC and @c
+       * ModuloT coordinates are in range.
+       *
+       * As for ome::files::getIndex(), the coordinates are checked
+       * after combining each dimension with its modulo dimension.
+       *
+       * @param z the @c Z coordinate (effective size).
+       * @param c the @c C coordinate (effective size).
+       * @param t the @c T coordinate (effective size).
+       * @param moduloZ the @c ModuloZ coordinate.
+       * @param moduloC the @c ModuloC coordinate.
+       * @param moduloT the @c ModuloT coordinate.
+       * @throws std::out_of_range if any coordinate is out of range.
+       */
+      void
+      checkCoords(dimension_size_type z,
+                  dimension_size_type c,
+                  dimension_size_type t,
+                  dimension_size_type moduloZ,
+                  dimension_size_type moduloC,
+                  dimension_size_type moduloT) const
+      {
+        checkCoords((z * modulo[0]) + moduloZ,
+                    (c * modulo[1]) + moduloC,
+                    (t * modulo[2]) + moduloT);
+      }
+
+      /**
+       * Check a plane index is in range.
+       *
+       * @param index the plane index.
+       * @throws std::out_of_range if the index is out of range.
+       */
+      void
+      checkIndex(dimension_size_type index) const;
+
+      /**
+       * Get the plane index of @c Z, @c C and @c T coordinates.
+       *
+       * @param z the @c Z coordinate (real size).
+       * @param c the @c C coordinate (real size).
+       * @param t the @c T coordinate (real size).
+       * @returns the plane index.
+       */
+      dimension_size_type
+      index(dimension_size_type z,
+            dimension_size_type c,
+            dimension_size_type t) const
+      {
+        return (z * stride[0]) + (c * stride[1]) + (t * stride[2]);
+      }
+
+      /**
+       * Get the plane index of @c Z, @c C, @c T, @c ModuloZ, @c
+       * ModuloC and @c ModuloT coordinates.
+       *
+       * @param z the @c Z coordinate (effective size).
+       * @param c the @c C coordinate (effective size).
+       * @param t the @c T coordinate (effective size).
+       * @param moduloZ the @c ModuloZ coordinate.
+       * @param moduloC the @c ModuloC coordinate.
+       * @param moduloT the @c ModuloT coordinate.
+       * @returns the plane index.
+       */
+      dimension_size_type
+      index(dimension_size_type z,
+            dimension_size_type c,
+            dimension_size_type t,
+            dimension_size_type moduloZ,
+            dimension_size_type moduloC,
+            dimension_size_type moduloT) const
+      {
+        return index((z * modulo[0]) + moduloZ,
+                     (c * modulo[1]) + moduloC,
+                     (t * modulo[2]) + moduloT);
+      }
+
+      /**
+       * Get the @c Z, @c C and @c T coordinates of a plane index.
+       *
+       * @param index the plane index.
+       * @returns the @c Z, @c C and @c T coordinates (real sizes).
+       */
+      coords_type
+      coords(dimension_size_type index) const
+      {
+        coords_type ret;
+        ret[0] = (index / stride[0]) % sizes[0];
+        ret[1] = (index / stride[1]) % sizes[1];
+        ret[2] = (index / stride[2]) % sizes[2];
+        return ret;
+      }
+
+      /**
+       * Get the @c Z, @c C, @c T, @c ModuloZ, @c ModuloC and @c
+       * ModuloT coordinates of a plane index.
+       *
+       * @param index the plane index.
+       * @returns the @c Z, @c C, @c T, @c ModuloZ, @c ModuloC and
+       * @c ModuloT coordinates (effective sizes).
+       */
+      modulo_coords_type
+      moduloCoords(dimension_size_type index) const
+      {
+        const coords_type real(coords(index));
+        modulo_coords_type ret;
+        ret[0] = real[0] / modulo[0];
+        ret[1] = real[1] / modulo[1];
+        ret[2] = real[2] / modulo[2];
+        ret[3] = real[0] % modulo[0];
+        ret[4] = real[1] % modulo[1];
+        ret[5] = real[2] % modulo[2];
+        return ret;
+      }
+
+      /**
+       * Get the plane indexes of a range of coordinates.
+       *
+       * @param begin the start of the range of coords_type coordinates.
+       * @param end the end of the range of coords_type coordinates.
+       * @param dest the destination for the plane indexes.
+       * @returns the end of the destination range.
+       */
+      template<typename InputIterator, typename OutputIterator>
+      OutputIterator
+      batchIndex(InputIterator  begin,
+                 InputIterator  end,
+                 OutputIterator dest) const
+      {
+        for (; begin != end; ++begin, ++dest)
+          {
+            const coords_type& c(*begin);
+            *dest = index(c[0], c[1], c[2]);
+          }
+        return dest;
+      }
+
+      /**
+       * Get the coordinates of a range of plane indexes.
+       *
+       * @param begin the start of the range of plane indexes.
+       * @param end the end of the range of plane indexes.
+       * @param dest the destination for the coords_type coordinates.
+       * @returns the end of the destination range.
+       */
+      template<typename InputIterator, typename OutputIterator>
+      OutputIterator
+      batchCoords(InputIterator  begin,
+                  InputIterator  end,
+                  OutputIterator dest) const
+      {
+        for (; begin != end; ++begin, ++dest)
+          *dest = coords(*begin);
+        return dest;
+      }
+
+    private:
+      /// Dimension order.
+      ome::xml::model::enums::DimensionOrder order;
+      /// @c Z, @c C and @c T sizes (real sizes).
+      coords_type sizes;
+      /// @c ModuloZ, @c ModuloC and @c ModuloT sizes.
+      coords_type modulo;
+      /// @c Z, @c C and @c T index strides.
+      coords_type stride;
+      /// Total number of planes.
+      dimension_size_type num;
+    };
+
+  }
+}
+
+#endif // OME_FILES_DIMENSIONINDEXER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,591 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <numeric>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/DimensionSwapper.h>
+
+using ome::xml::model::enums::DimensionOrder;
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      // Index of a dimension in ZCT order.
+      dimension_size_type
+      zct_index(char dimension)
+      {
+        return dimension == 'Z' ? 0U : dimension == 'C' ? 1U : 2U;
+      }
+
+      // Modulo annotation of a dimension in ZCT order.
+      Modulo&
+      zct_modulo(CoreMetadata&       core,
+                 dimension_size_type dimension)
+      {
+        return dimension == 0U ? core.moduloZ : dimension == 1U ? core.moduloC : core.moduloT;
+      }
+
+    }
+
+    DimensionSwapper::DimensionSwapper(const std::shared_ptr<FormatReader>& reader):
+      ReaderWrapper(reader),
+      core(),
+      inputOrder(),
+      plane(0U)
+    {
+    }
+
+    DimensionSwapper::~DimensionSwapper()
+    {
+    }
+
+    void
+    DimensionSwapper::swapDimensions(DimensionOrder order)
+    {
+      getCurrentCore();
+
+      const dimension_size_type first = seriesToCoreIndex(getSeries());
+      const dimension_size_type count = getResolutionCount();
+      const std::string& to(order);
+
+      for (dimension_size_type index = first; index < first + count; ++index)
+        {
+          const CoreMetadata& rc(*reader->getCoreMetadataList().at(index));
+          CoreMetadata& c(*core.at(index));
+
+          const std::string& from(rc.dimensionOrder);
+          const std::array<dimension_size_type, 3> sizes{{rc.sizeZ, rc.sizeC.size(), rc.sizeT}};
+          const std::array<const Modulo *, 3> modulo{{&rc.moduloZ, &rc.moduloC, &rc.moduloT}};
+
+          // Source dimension of each dimension; the dimensions are
+          // at positions 2-4, following X and Y.
+          std::array<dimension_size_type, 3> src{{0U, 1U, 2U}};
+          for (std::string::size_type i = 2U; i < 5U; ++i)
+            src[zct_index(to.at(i))] = zct_index(from.at(i));
+
+          if (sizes[src[1]] != sizes[1])
+            {
+              for (const auto samples : rc.sizeC)
+                {
+                  if (samples != rc.sizeC.front())
+                    throw std::logic_error("Can not change the channel count of channels with differing sample counts");
+                }
+            }
+
+          for (dimension_size_type dim = 0; dim < 3U; ++dim)
+            {
+              Modulo& m(zct_modulo(c, dim));
+              m = *modulo[src[dim]];
+              m.parentDimension = std::string(1U, "ZCT"[dim]);
+            }
+
+          c.sizeZ = sizes[src[0]];
+          c.sizeC = rc.sizeC;
+          if (sizes[src[1]] != sizes[1])
+            c.sizeC.assign(sizes[src[1]], rc.sizeC.front());
+          c.sizeT = sizes[src[2]];
+          c.dimensionOrder = order;
+          inputOrder.at(index) = order;
+        }
+
+      plane = 0U;
+    }
+
+    DimensionOrder
+    DimensionSwapper::getInputOrder() const
+    {
+      getCurrentCore();
+      return inputOrder.at(getCoreIndex());
+    }
+
+    void
+    DimensionSwapper::setOutputOrder(DimensionOrder order)
+    {
+      getCurrentCore();
+
+      const dimension_size_type first = seriesToCoreIndex(getSeries());
+      const dimension_size_type count = getResolutionCount();
+
+      for (dimension_size_type index = first; index < first + count; ++index)
+        core.at(index)->dimensionOrder = order;
+
+      plane = 0U;
+    }
+
+    DimensionOrder
+    DimensionSwapper::getOutputOrder() const
+    {
+      return getCurrentCore().dimensionOrder;
+    }
+
+    CoreMetadata&
+    DimensionSwapper::getCurrentCore() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (index >= core.size() || !core.at(index))
+        throw std::logic_error("Current file not set");
+      return *core.at(index);
+    }
+
+    bool
+    DimensionSwapper::isSwapped(dimension_size_type index) const
+    {
+      return index < core.size() && core.at(index) &&
+        (isRelabelled(index) || !(core.at(index)->dimensionOrder == inputOrder.at(index)));
+    }
+
+    bool
+    DimensionSwapper::isRelabelled(dimension_size_type index) const
+    {
+      return index < core.size() && core.at(index) &&
+        !(inputOrder.at(index) == reader->getCoreMetadataList().at(index)->dimensionOrder);
+    }
+
+    DimensionIndexer
+    DimensionSwapper::getIndexer(dimension_size_type index,
+                                 DimensionOrder      order) const
+    {
+      const CoreMetadata& c(*core.at(index));
+      return DimensionIndexer(order,
+                              c.sizeZ,
+                              c.sizeC.size(),
+                              c.sizeT,
+                              c.moduloZ.size(),
+                              c.moduloC.size(),
+                              c.moduloT.size(),
+                              c.imageCount);
+    }
+
+    dimension_size_type
+    DimensionSwapper::readerPlane(dimension_size_type index,
+                                  dimension_size_type plane) const
+    {
+      if (!isSwapped(index))
+        return plane;
+
+      if (plane >= core.at(index)->imageCount)
+        {
+          boost::format fmt("Invalid plane: %1%");
+          fmt % plane;
+          throw std::logic_error(fmt.str());
+        }
+
+      const std::array<dimension_size_type, 3> coords
+        (getIndexer(index, core.at(index)->dimensionOrder).coords(plane));
+      return getIndexer(index, inputOrder.at(index)).index(coords[0], coords[1], coords[2]);
+    }
+
+    void
+    DimensionSwapper::setId(const boost::filesystem::path& id)
+    {
+      ReaderWrapper::setId(id);
+
+      core.clear();
+      inputOrder.clear();
+      plane = 0U;
+
+      for (const auto& c : reader->getCoreMetadataList())
+        {
+          if (c)
+            {
+              core.push_back(std::make_shared<CoreMetadata>(*c));
+              inputOrder.push_back(c->dimensionOrder);
+            }
+          else
+            {
+              core.push_back(std::shared_ptr<CoreMetadata>());
+              inputOrder.push_back(DimensionOrder(DimensionOrder::XYZCT));
+            }
+        }
+    }
+
+    void
+    DimensionSwapper::close(bool fileOnly)
+    {
+      ReaderWrapper::close(fileOnly);
+
+      if (!fileOnly)
+        {
+          core.clear();
+          inputOrder.clear();
+          plane = 0U;
+        }
+    }
+
+    bool
+    DimensionSwapper::isRGB(dimension_size_type channel) const
+    {
+      return getRGBChannelCount(channel) > 1U;
+    }
+
+    dimension_size_type
+    DimensionSwapper::getSizeZ() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getSizeZ();
+      return core.at(index)->sizeZ;
+    }
+
+    dimension_size_type
+    DimensionSwapper::getSizeT() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getSizeT();
+      return core.at(index)->sizeT;
+    }
+
+    dimension_size_type
+    DimensionSwapper::getSizeC() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getSizeC();
+      const std::vector<dimension_size_type>& sizeC(core.at(index)->sizeC);
+      return std::accumulate(sizeC.begin(), sizeC.end(), dimension_size_type(0));
+    }
+
+    dimension_size_type
+    DimensionSwapper::getEffectiveSizeC() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getEffectiveSizeC();
+      return core.at(index)->sizeC.size();
+    }
+
+    dimension_size_type
+    DimensionSwapper::getRGBChannelCount(dimension_size_type channel) const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getRGBChannelCount(channel);
+      return core.at(index)->sizeC.at(channel);
+    }
+
+    dimension_size_type
+    DimensionSwapper::getOptimalTileWidth(dimension_size_type channel) const
+    {
+      if (!isRelabelled(getCoreIndex()))
+        return ReaderWrapper::getOptimalTileWidth(channel);
+      return reader->getOptimalTileWidth();
+    }
+
+    dimension_size_type
+    DimensionSwapper::getOptimalTileHeight(dimension_size_type channel) const
+    {
+      if (!isRelabelled(getCoreIndex()))
+        return ReaderWrapper::getOptimalTileHeight(channel);
+      return reader->getOptimalTileHeight();
+    }
+
+    void
+    DimensionSwapper::getLookupTable(dimension_size_type plane,
+                                     VariantPixelBuffer& buf) const
+    {
+      reader->getLookupTable(readerPlane(getCoreIndex(), plane), buf);
+    }
+
+    Modulo&
+    DimensionSwapper::getModuloZ()
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getModuloZ();
+      return core.at(index)->moduloZ;
+    }
+
+    const Modulo&
+    DimensionSwapper::getModuloZ() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getModuloZ();
+      return core.at(index)->moduloZ;
+    }
+
+    Modulo&
+    DimensionSwapper::getModuloT()
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getModuloT();
+      return core.at(index)->moduloT;
+    }
+
+    const Modulo&
+    DimensionSwapper::getModuloT() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getModuloT();
+      return core.at(index)->moduloT;
+    }
+
+    Modulo&
+    DimensionSwapper::getModuloC()
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getModuloC();
+      return core.at(index)->moduloC;
+    }
+
+    const Modulo&
+    DimensionSwapper::getModuloC() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isRelabelled(index))
+        return ReaderWrapper::getModuloC();
+      return core.at(index)->moduloC;
+    }
+
+    const std::string&
+    DimensionSwapper::getDimensionOrder() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isSwapped(index))
+        return ReaderWrapper::getDimensionOrder();
+      return core.at(index)->dimensionOrder;
+    }
+
+    bool
+    DimensionSwapper::isInterleaved(dimension_size_type channel) const
+    {
+      if (!isRelabelled(getCoreIndex()))
+        return ReaderWrapper::isInterleaved(channel);
+      return reader->isInterleaved();
+    }
+
+    void
+    DimensionSwapper::openBytes(dimension_size_type plane,
+                                VariantPixelBuffer& buf) const
+    {
+      setPlane(plane);
+      reader->openBytes(readerPlane(getCoreIndex(), plane), buf);
+    }
+
+    void
+    DimensionSwapper::openBytes(dimension_size_type plane,
+                                VariantPixelBuffer& buf,
+                                dimension_size_type x,
+                                dimension_size_type y,
+                                dimension_size_type w,
+                                dimension_size_type h) const
+    {
+      setPlane(plane);
+      reader->openBytes(readerPlane(getCoreIndex(), plane), buf, x, y, w, h);
+    }
+
+    void
+    DimensionSwapper::openBytesBatch(dimension_size_type              plane,
+                                     const std::vector<PlaneRegion>&  regions,
+                                     std::vector<VariantPixelBuffer>& bufs) const
+    {
+      setPlane(plane);
+      reader->openBytesBatch(readerPlane(getCoreIndex(), plane), regions, bufs);
+    }
+
+    void
+    DimensionSwapper::openBytesDecimated(dimension_size_type plane,
+                                         VariantPixelBuffer& buf,
+                                         const PlaneRegion&  region,
+                                         dimension_size_type xstep,
+                                         dimension_size_type ystep) const
+    {
+      setPlane(plane);
+      reader->openBytesDecimated(readerPlane(getCoreIndex(), plane), buf, region, xstep, ystep);
+    }
+
+    void
+    DimensionSwapper::openBytesAt(dimension_size_type series,
+                                  dimension_size_type resolution,
+                                  dimension_size_type plane,
+                                  VariantPixelBuffer& buf,
+                                  const PlaneRegion&  region) const
+    {
+      const dimension_size_type index = seriesToCoreIndex(series) + resolution;
+      reader->openBytesAt(series, resolution, readerPlane(index, plane), buf, region);
+    }
+
+    void
+    DimensionSwapper::openBytesInto(dimension_size_type     series,
+                                    dimension_size_type     resolution,
+                                    dimension_size_type     plane,
+                                    VariantPixelBufferView& buf,
+                                    const PlaneRegion&      region) const
+    {
+      const dimension_size_type index = seriesToCoreIndex(series) + resolution;
+      reader->openBytesInto(series, resolution, readerPlane(index, plane), buf, region);
+    }
+
+    void
+    DimensionSwapper::forEachTile(dimension_size_type  plane,
+                                  const tile_callback& callback) const
+    {
+      setPlane(plane);
+      reader->forEachTile(readerPlane(getCoreIndex(), plane), callback);
+    }
+
+    void
+    DimensionSwapper::openThumbBytes(dimension_size_type plane,
+                                     VariantPixelBuffer& buf) const
+    {
+      setPlane(plane);
+      reader->openThumbBytes(readerPlane(getCoreIndex(), plane), buf);
+    }
+
+    void
+    DimensionSwapper::openRawTile(dimension_size_type   plane,
+                                  dimension_size_type   tile,
+                                  std::vector<uint8_t>& buf) const
+    {
+      setPlane(plane);
+      reader->openRawTile(readerPlane(getCoreIndex(), plane), tile, buf);
+    }
+
+    void
+    DimensionSwapper::setSeries(dimension_size_type series) const
+    {
+      ReaderWrapper::setSeries(series);
+      plane = 0U;
+    }
+
+    void
+    DimensionSwapper::setPlane(dimension_size_type plane) const
+    {
+      reader->setPlane(readerPlane(getCoreIndex(), plane));
+      this->plane = plane;
+    }
+
+    dimension_size_type
+    DimensionSwapper::getPlane() const
+    {
+      if (!isSwapped(getCoreIndex()))
+        return ReaderWrapper::getPlane();
+      return plane;
+    }
+
+    dimension_size_type
+    DimensionSwapper::getIndex(dimension_size_type z,
+                               dimension_size_type c,
+                               dimension_size_type t) const
+    {
+      if (!isSwapped(getCoreIndex()))
+        return ReaderWrapper::getIndex(z, c, t);
+      const DimensionIndexer indexer(getDimensionIndexer());
+      indexer.checkCoords(z, c, t);
+      return indexer.index(z, c, t);
+    }
+
+    dimension_size_type
+    DimensionSwapper::getIndex(dimension_size_type z,
+                               dimension_size_type c,
+                               dimension_size_type t,
+                               dimension_size_type moduloZ,
+                               dimension_size_type moduloC,
+                               dimension_size_type moduloT) const
+    {
+      if (!isSwapped(getCoreIndex()))
+        return ReaderWrapper::getIndex(z, c, t, moduloZ, moduloC, moduloT);
+      const DimensionIndexer indexer(getDimensionIndexer());
+      indexer.checkCoords(z, c, t, moduloZ, moduloC, moduloT);
+      return indexer.index(z, c, t, moduloZ, moduloC, moduloT);
+    }
+
+    std::array<dimension_size_type, 3>
+    DimensionSwapper::getZCTCoords(dimension_size_type index) const
+    {
+      if (!isSwapped(getCoreIndex()))
+        return ReaderWrapper::getZCTCoords(index);
+      const DimensionIndexer indexer(getDimensionIndexer());
+      indexer.checkIndex(index);
+      return indexer.coords(index);
+    }
+
+    std::array<dimension_size_type, 6>
+    DimensionSwapper::getZCTModuloCoords(dimension_size_type index) const
+    {
+      if (!isSwapped(getCoreIndex()))
+        return ReaderWrapper::getZCTModuloCoords(index);
+      const DimensionIndexer indexer(getDimensionIndexer());
+      indexer.checkIndex(index);
+      return indexer.moduloCoords(index);
+    }
+
+    DimensionIndexer
+    DimensionSwapper::getDimensionIndexer() const
+    {
+      const dimension_size_type index = getCoreIndex();
+      if (!isSwapped(index))
+        return ReaderWrapper::getDimensionIndexer();
+      return getIndexer(index, core.at(index)->dimensionOrder);
+    }
+
+    const std::vector<std::shared_ptr<CoreMetadata>>&
+    DimensionSwapper::getCoreMetadataList() const
+    {
+      return core;
+    }
+
+    void
+    DimensionSwapper::setCoreIndex(dimension_size_type index) const
+    {
+      ReaderWrapper::setCoreIndex(index);
+      plane = 0U;
+    }
+
+    void
+    DimensionSwapper::setResolution(dimension_size_type resolution) const
+    {
+      ReaderWrapper::setResolution(resolution);
+      plane = 0U;
+    }
+
+  }
+}
@@ -0,0 +1,407 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DIMENSIONSWAPPER_H
+#define OME_FILES_DIMENSIONSWAPPER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/DimensionIndexer.h>
+#include <ome/files/ReaderWrapper.h>
+
+#include <ome/xml/model/enums/DimensionOrder.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Reader wrapper presenting the Z, C and T dimensions of a
+     * reader in a different order.
+     *
+     * Two orders may be set for each series:
+     *
+     * - The input order, set with swapDimensions(), reinterprets
+     *   the dimensions of the wrapped reader.  The sizes of the
+     *   wrapped reader are kept in place and relabelled, for use
+     *   when a format stores its dimensions in an order other than
+     *   the one it reports.
+     * - The output order, set with setOutputOrder(), changes the
+     *   order in which planes are presented without changing the
+     *   sizes, for example to present XYZCT data as XYCZT.
+     *
+     * Only plane indexes are remapped.  Each plane is read by the
+     * wrapped reader directly into the destination buffer, so
+     * reordering has no per-pixel cost.
+     *
+     * The MetadataStore is not changed, and continues to describe
+     * the dimensions of the wrapped reader.
+     */
+    class DimensionSwapper : public ReaderWrapper
+    {
+    public:
+      /**
+       * Constructor.
+       *
+       * @param reader the reader to wrap.
+       * @throws std::logic_error if the reader is null.
+       */
+      explicit
+      DimensionSwapper(const std::shared_ptr<FormatReader>& reader);
+
+      /// Destructor.
+      virtual
+      ~DimensionSwapper();
+
+      /**
+       * Set the input dimension order for the current series.
+       *
+       * The Z, C and T sizes (and modulo annotations) of the
+       * wrapped reader are relabelled so that the dimension at each
+       * position of the wrapped reader order takes the name at the
+       * same position of @p order.  The output order is reset to
+       * the input order.  All resolutions of the series are
+       * changed.
+       *
+       * @param order the input dimension order.
+       * @throws std::logic_error if the current file is not set, or
+       * if the channel count would change for channels with
+       * differing sample counts.
+       */
+      void
+      swapDimensions(ome::xml::model::enums::DimensionOrder order);
+
+      /**
+       * Get the input dimension order for the current series.
+       *
+       * @returns the input dimension order.
+       */
+      ome::xml::model::enums::DimensionOrder
+      getInputOrder() const;
+
+      /**
+       * Set the output dimension order for the current series.
+       *
+       * All resolutions of the series are changed.
+       *
+       * @param order the output dimension order.
+       * @throws std::logic_error if the current file is not set.
+       */
+      void
+      setOutputOrder(ome::xml::model::enums::DimensionOrder order);
+
+      /**
+       * Get the output dimension order for the current series.
+       *
+       * This is the same as getDimensionOrder().
+       *
+       * @returns the output dimension order.
+       */
+      ome::xml::model::enums::DimensionOrder
+      getOutputOrder() const;
+
+    private:
+      /**
+       * Get the presented CoreMetadata of the current core index.
+       *
+       * @returns the CoreMetadata.
+       * @throws std::logic_error if the current file is not set.
+       */
+      CoreMetadata&
+      getCurrentCore() const;
+
+      /**
+       * Check if the dimensions of a core index are swapped.
+       *
+       * @param index the core index.
+       * @returns @c true if the input or output order differs from
+       * the wrapped reader order, @c false otherwise.
+       */
+      bool
+      isSwapped(dimension_size_type index) const;
+
+      /**
+       * Check if the dimensions of a core index are relabelled.
+       *
+       * @param index the core index.
+       * @returns @c true if the input order differs from the
+       * wrapped reader order, @c false otherwise.
+       */
+      bool
+      isRelabelled(dimension_size_type index) const;
+
+      /**
+       * Get a dimension indexer for a core index.
+       *
+       * @param index the core index.
+       * @param order the dimension order to index.
+       * @returns the dimension indexer.
+       */
+      DimensionIndexer
+      getIndexer(dimension_size_type                    index,
+                 ome::xml::model::enums::DimensionOrder order) const;
+
+      /**
+       * Get the wrapped reader plane index of a plane.
+       *
+       * @param index the core index.
+       * @param plane the presented plane index.
+       * @returns the wrapped reader plane index.
+       * @throws std::logic_error if the plane index is invalid.
+       */
+      dimension_size_type
+      readerPlane(dimension_size_type index,
+                  dimension_size_type plane) const;
+
+    public:
+      // Documented in superclass.
+      void
+      setId(const boost::filesystem::path& id);
+
+      // Documented in superclass.
+      void
+      close(bool fileOnly = false);
+
+      // Documented in superclass.
+      bool
+      isRGB(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeZ() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeT() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeC() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getEffectiveSizeC() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getRGBChannelCount(dimension_size_type channel) const;
+
+      using ReaderWrapper::getOptimalTileWidth;
+      using ReaderWrapper::getOptimalTileHeight;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileWidth(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileHeight(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      void
+      getLookupTable(dimension_size_type plane,
+                     VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      Modulo&
+      getModuloZ();
+
+      // Documented in superclass.
+      const Modulo&
+      getModuloZ() const;
+
+      // Documented in superclass.
+      Modulo&
+      getModuloT();
+
+      // Documented in superclass.
+      const Modulo&
+      getModuloT() const;
+
+      // Documented in superclass.
+      Modulo&
+      getModuloC();
+
+      // Documented in superclass.
+      const Modulo&
+      getModuloC() const;
+
+      // Documented in superclass.
+      const std::string&
+      getDimensionOrder() const;
+
+      // Documented in superclass.
+      bool
+      isInterleaved(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const;
+
+      // Documented in superclass.
+      void
+      openBytesBatch(dimension_size_type              plane,
+                     const std::vector<PlaneRegion>&  regions,
+                     std::vector<VariantPixelBuffer>& bufs) const;
+
+      // Documented in superclass.
+      void
+      openBytesDecimated(dimension_size_type plane,
+                         VariantPixelBuffer& buf,
+                         const PlaneRegion&  region,
+                         dimension_size_type xstep,
+                         dimension_size_type ystep) const;
+
+      // Documented in superclass.
+      void
+      openBytesAt(dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  const PlaneRegion&  region) const;
+
+      // Documented in superclass.
+      void
+      openBytesInto(dimension_size_type     series,
+                    dimension_size_type     resolution,
+                    dimension_size_type     plane,
+                    VariantPixelBufferView& buf,
+                    const PlaneRegion&      region) const;
+
+      // Documented in superclass.
+      void
+      forEachTile(dimension_size_type  plane,
+                  const tile_callback& callback) const;
+
+      // Documented in superclass.
+      void
+      openThumbBytes(dimension_size_type plane,
+                     VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openRawTile(dimension_size_type   plane,
+                  dimension_size_type   tile,
+                  std::vector<uint8_t>& buf) const;
+
+      // Documented in superclass.
+      void
+      setSeries(dimension_size_type series) const;
+
+      // Documented in superclass.
+      void
+      setPlane(dimension_size_type plane) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getPlane() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getIndex(dimension_size_type z,
+               dimension_size_type c,
+               dimension_size_type t) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getIndex(dimension_size_type z,
+               dimension_size_type c,
+               dimension_size_type t,
+               dimension_size_type moduloZ,
+               dimension_size_type moduloC,
+               dimension_size_type moduloT) const;
+
+      // Documented in superclass.
+      std::array<dimension_size_type, 3>
+      getZCTCoords(dimension_size_type index) const;
+
+      // Documented in superclass.
+      std::array<dimension_size_type, 6>
+      getZCTModuloCoords(dimension_size_type index) const;
+
+      // Documented in superclass.
+      DimensionIndexer
+      getDimensionIndexer() const;
+
+      // Documented in superclass.
+      const std::vector<std::shared_ptr<CoreMetadata>>&
+      getCoreMetadataList() const;
+
+      // Documented in superclass.
+      void
+      setCoreIndex(dimension_size_type index) const;
+
+      // Documented in superclass.
+      void
+      setResolution(dimension_size_type resolution) const;
+
+    private:
+      /// The CoreMetadata presented for each core index.
+      std::vector<std::shared_ptr<CoreMetadata>> core;
+
+      /// The input dimension order of each core index.
+      std::vector<ome::xml::model::enums::DimensionOrder> inputOrder;
+
+      /// The current plane.
+      mutable dimension_size_type plane;
+    };
+
+  }
+}
+
+#endif // OME_FILES_DIMENSIONSWAPPER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
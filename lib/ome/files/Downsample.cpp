@@ -0,0 +1,265 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/Downsample.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/detail/Downsample.h>
+
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+using ::ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  // Sample type and number of samples of a pixel language type;
+  // complex values are pairs of real samples.
+  template<typename T>
+  struct DownsampleProperties
+  {
+    typedef T sample_type;
+    static const dimension_size_type samples = 1U;
+  };
+
+  template<typename T>
+  struct DownsampleProperties<std::complex<T>>
+  {
+    typedef T sample_type;
+    static const dimension_size_type samples = 2U;
+  };
+
+  struct DownsampleVisitor
+  {
+    VariantPixelBuffer&                   dest;
+    dimension_size_type                   factor;
+    ome::files::tiff::Downsampling        method;
+
+    DownsampleVisitor(VariantPixelBuffer&            dest,
+                      dimension_size_type            factor,
+                      ome::files::tiff::Downsampling method):
+      dest(dest),
+      factor(factor),
+      method(method)
+    {}
+
+    template<typename T>
+    void
+    operator() (const std::shared_ptr<PixelBuffer<T>>& in)
+    {
+      typedef DownsampleProperties<T> props;
+      typedef typename props::sample_type sample_type;
+      typedef typename PixelBuffer<T>::indices_type indices_type;
+
+      std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+      std::copy(in->shape(), in->shape() + PixelBufferBase::dimensions, shape.begin());
+      const dimension_size_type width = shape[ome::files::DIM_SPATIAL_X];
+      const dimension_size_type height = shape[ome::files::DIM_SPATIAL_Y];
+      const dimension_size_type subchannels = shape[ome::files::DIM_SUBCHANNEL];
+      shape[ome::files::DIM_SPATIAL_X] = ome::files::downsampledSize(width, factor);
+      shape[ome::files::DIM_SPATIAL_Y] = ome::files::downsampledSize(height, factor);
+
+      dest.setBuffer(shape, in->pixelType(), in->storage_order(), dest.allocator());
+      PixelBuffer<T>& out(*ome::compat::get<std::shared_ptr<PixelBuffer<T>>>(dest.vbuffer()));
+
+      if (!in->num_elements())
+        return;
+
+      // Interleaved subchannels are downsampled as components of
+      // each pixel, and planar subchannels separately.  Rows are
+      // used in place if contiguous in X, and copied otherwise.
+      const boost::multi_array_types::index *strides = in->strides();
+      const boost::multi_array_types::index *bases = in->index_bases();
+      const bool interleaved = (subchannels > 1U &&
+                                strides[ome::files::DIM_SUBCHANNEL] == 1 &&
+                                strides[ome::files::DIM_SPATIAL_X] == static_cast<boost::multi_array_types::index>(subchannels));
+      const bool contiguous = interleaved || strides[ome::files::DIM_SPATIAL_X] == 1;
+      const dimension_size_type pixels = interleaved ? subchannels : 1U;
+      const dimension_size_type components = pixels * props::samples;
+      const dimension_size_type outwidth = shape[ome::files::DIM_SPATIAL_X];
+
+      std::unique_ptr<T[]> rows;
+      std::unique_ptr<T[]> row;
+      if (!contiguous)
+        {
+          rows.reset(new T[width * factor]);
+          row.reset(new T[outwidth]);
+        }
+
+      // Iterate over every row of every plane, and every
+      // subchannel unless interleaved.
+      indices_type idx;
+      idx.fill(0);
+      while (true)
+        {
+          for (dimension_size_type y = 0; y < shape[ome::files::DIM_SPATIAL_Y]; ++y)
+            {
+              const dimension_size_type sy = y * factor;
+              const dimension_size_type nrows = std::min(factor, height - sy);
+
+              indices_type srcidx;
+              for (dimension_size_type d = 0; d < PixelBufferBase::dimensions; ++d)
+                srcidx[d] = idx[d] + bases[d];
+              srcidx[ome::files::DIM_SPATIAL_Y] += static_cast<typename indices_type::value_type>(sy);
+              indices_type destidx(idx);
+              destidx[ome::files::DIM_SPATIAL_Y] = static_cast<typename indices_type::value_type>(y);
+
+              if (contiguous)
+                {
+                  ome::files::detail::downsampleRow(reinterpret_cast<const sample_type *>(&in->at(srcidx)),
+                                                    static_cast<std::ptrdiff_t>(strides[ome::files::DIM_SPATIAL_Y] *
+                                                                                static_cast<std::ptrdiff_t>(props::samples)),
+                                                    nrows, width, components, factor, method,
+                                                    reinterpret_cast<sample_type *>(&out.at(destidx)));
+                }
+              else
+                {
+                  for (dimension_size_type j = 0; j < nrows; ++j)
+                    for (dimension_size_type x = 0; x < width; ++x)
+                      {
+                        srcidx[ome::files::DIM_SPATIAL_Y] = bases[ome::files::DIM_SPATIAL_Y] + static_cast<typename indices_type::value_type>(sy + j);
+                        srcidx[ome::files::DIM_SPATIAL_X] = bases[ome::files::DIM_SPATIAL_X] + static_cast<typename indices_type::value_type>(x);
+                        rows[(j * width) + x] = in->at(srcidx);
+                      }
+                  ome::files::detail::downsampleRow(reinterpret_cast<const sample_type *>(rows.get()),
+                                                    static_cast<std::ptrdiff_t>(width * props::samples),
+                                                    nrows, width, props::samples, factor, method,
+                                                    reinterpret_cast<sample_type *>(row.get()));
+                  for (dimension_size_type x = 0; x < outwidth; ++x)
+                    {
+                      destidx[ome::files::DIM_SPATIAL_X] = static_cast<typename indices_type::value_type>(x);
+                      out.at(destidx) = row[x];
+                    }
+                }
+            }
+
+          // Next plane (or subchannel).
+          dimension_size_type d = 0;
+          for (; d < PixelBufferBase::dimensions; ++d)
+            {
+              if (d == ome::files::DIM_SPATIAL_X || d == ome::files::DIM_SPATIAL_Y ||
+                  (d == ome::files::DIM_SUBCHANNEL && interleaved))
+                continue;
+              if (static_cast<dimension_size_type>(++idx[d]) < shape[d])
+                break;
+              idx[d] = 0;
+            }
+          if (d == PixelBufferBase::dimensions)
+            break;
+        }
+    }
+  };
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    dimension_size_type
+    downsampledSize(dimension_size_type size,
+                    dimension_size_type factor)
+    {
+      if (!factor)
+        throw std::logic_error("Downsampling factor must be nonzero");
+      return (size + factor - 1U) / factor;
+    }
+
+    bool
+    downsamplingSupported(PixelType          pixeltype,
+                          tiff::Downsampling method)
+    {
+      switch (method)
+        {
+        case tiff::DOWNSAMPLE_NEAREST:
+        case tiff::DOWNSAMPLE_MEAN:
+          return true;
+        case tiff::DOWNSAMPLE_MODE:
+        case tiff::DOWNSAMPLE_OR:
+          switch (pixeltype)
+            {
+            case PixelType::BIT:
+            case PixelType::INT8:
+            case PixelType::INT16:
+            case PixelType::INT32:
+            case PixelType::UINT8:
+            case PixelType::UINT16:
+            case PixelType::UINT32:
+              return true;
+            default:
+              return false;
+            }
+        default:
+          return false;
+        }
+    }
+
+    void
+    downsample(const VariantPixelBuffer& src,
+               VariantPixelBuffer&       dest,
+               dimension_size_type       factor,
+               tiff::Downsampling        method)
+    {
+      if (&src == &dest)
+        throw std::logic_error("Downsampling source and destination must be different buffers");
+      if (!factor)
+        throw std::logic_error("Downsampling factor must be nonzero");
+      if (!downsamplingSupported(src.pixelType(), method))
+        {
+          boost::format fmt("Downsampling method not supported for %1% pixel type");
+          fmt % src.pixelType();
+          throw std::logic_error(fmt.str());
+        }
+
+      DownsampleVisitor v(dest, factor, method);
+      ome::compat::visit(v, src.vbuffer());
+    }
+
+  }
+}
@@ -0,0 +1,134 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DOWNSAMPLE_H
+#define OME_FILES_DOWNSAMPLE_H
+
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/Types.h>
+
+#include <ome/xml/model/enums/PixelType.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Get the size of a downsampled dimension.
+     *
+     * Partial blocks at the edge are kept, so the size is rounded
+     * up.
+     *
+     * @param size the size of the dimension.
+     * @param factor the downsampling factor.
+     * @returns the downsampled size.
+     * @throws std::logic_error if the factor is zero.
+     */
+    dimension_size_type
+    downsampledSize(dimension_size_type size,
+                    dimension_size_type factor);
+
+    /**
+     * Check if a downsampling method is defined for a pixel type.
+     *
+     * Nearest neighbour and mean downsampling are defined for all
+     * pixel types.  Mode and bitwise OR downsampling, intended for
+     * label images and masks, are only defined for integer and @c
+     * BIT pixel types.
+     *
+     * @param pixeltype the pixel type.
+     * @param method the downsampling method.
+     * @returns @c true if the method is defined for the pixel type.
+     */
+    bool
+    downsamplingSupported(::ome::xml::model::enums::PixelType pixeltype,
+                          tiff::Downsampling                  method);
+
+    /**
+     * Downsample a pixel buffer.
+     *
+     * Each plane is reduced by the same factor in X and Y, and each
+     * destination pixel is reduced from a block of up to @p factor
+     * × @p factor source pixels; the blocks at the right and bottom
+     * edges are partial if the plane size is not a multiple of the
+     * factor (see downsampledSize()).  Each subchannel is
+     * downsampled separately, and complex values have their real
+     * and imaginary parts downsampled separately.  The methods are
+     * as for sub-resolutions of TIFF files (see
+     * tiff::TIFF::setSubResolutions()): the mean of integer samples
+     * is rounded to nearest, and of @c BIT samples is the majority
+     * value, rounding up; the mode is the most frequent value, with
+     * ties resolved by the first value in row order.
+     *
+     * This is the implementation shared by pyramid writing and
+     * thumbnail generation, and is used for tiles and for whole
+     * planes alike.  Rows of pixels are downsampled in place where
+     * the storage order is contiguous in X (as for
+     * PixelBufferBase::make_storage_order()), and copied otherwise.
+     * Blocks of 2×2 are specialised, with the mean of single
+     * component 8- and 16-bit integer samples using SIMD
+     * instructions where available.
+     *
+     * @param src the source pixel buffer.
+     * @param dest the destination pixel buffer, which is resized
+     * to the downsampled shape with the pixel type and storage
+     * order of the source.
+     * @param factor the downsampling factor.
+     * @param method the downsampling method.
+     * @throws std::logic_error if the factor is zero, the method is
+     * not defined for the pixel type, or the source and destination
+     * are the same buffer.
+     */
+    void
+    downsample(const VariantPixelBuffer& src,
+               VariantPixelBuffer&       dest,
+               dimension_size_type       factor = 2U,
+               tiff::Downsampling        method = tiff::DOWNSAMPLE_MEAN);
+
+  }
+}
+
+#endif // OME_FILES_DOWNSAMPLE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
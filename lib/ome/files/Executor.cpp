@@ -0,0 +1,349 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      /// Mutex serialising access to the global executor.
+      std::mutex global_mutex;
+
+      /// The global executor (if created or set).
+      std::shared_ptr<Executor> global_executor;
+
+      /// The pool owning the current thread (null if not a pool thread).
+      thread_local const void *current_pool = nullptr;
+
+      /// The index of the current thread in its pool.
+      thread_local std::size_t current_worker = 0U;
+
+      /// State shared by the tasks of a parallel() call.
+      struct ParallelState
+      {
+        /// Task to run.
+        const Executor::indexed_task_type *task;
+        /// Cancellation token of the caller (null if none).
+        const CancellationToken *cancel;
+        /// Number of tasks.
+        unsigned int count;
+        /// Index of the next task to start.
+        std::atomic<unsigned int> next;
+        /// Number of tasks completed.
+        unsigned int done;
+        /// Exception thrown by each task.
+        std::vector<std::exception_ptr> errors;
+        /// Lock for done.
+        std::mutex mutex;
+        /// Signalled when a task completes.
+        std::condition_variable completed;
+
+        ParallelState(const Executor::indexed_task_type& task,
+                      unsigned int                       count):
+          task(&task),
+          cancel(CancellationToken::current()),
+          count(count),
+          next(0U),
+          done(0U),
+          errors(count),
+          mutex(),
+          completed()
+        {
+        }
+
+        // Run tasks until none remain to be started.  The task and
+        // token are only used while tasks remain, so a late helper
+        // never refers to them after parallel() has returned.
+        void
+        run()
+        {
+          for (unsigned int i = next++; i < count; i = next++)
+            {
+              try
+                {
+                  CancellationToken::Scope scope(cancel);
+                  if (cancel)
+                    cancel->check();
+                  (*task)(i);
+                }
+              catch (...)
+                {
+                  errors[i] = std::current_exception();
+                }
+
+              std::lock_guard<std::mutex> lock(mutex);
+              if (++done == count)
+                completed.notify_all();
+            }
+        }
+      };
+
+    }
+
+    Executor::Executor()
+    {
+    }
+
+    Executor::~Executor()
+    {
+    }
+
+    void
+    Executor::parallel(unsigned int              count,
+                       const indexed_task_type& task)
+    {
+      if (count == 0U)
+        return;
+
+      if (count == 1U)
+        {
+          task(0U);
+          return;
+        }
+
+      std::shared_ptr<ParallelState> state(std::make_shared<ParallelState>(task, count));
+
+      const unsigned int helpers(std::min(count - 1U, std::max(concurrency(), 1U)));
+      for (unsigned int h = 0U; h < helpers; ++h)
+        submit([state]() { state->run(); });
+
+      // Run tasks not yet started by the executor, and then wait
+      // for those which were.
+      state->run();
+
+      {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->completed.wait(lock, [&state]() { return state->done == state->count; });
+      }
+
+      for (const auto& error : state->errors)
+        if (error)
+          std::rethrow_exception(error);
+    }
+
+    std::shared_ptr<Executor>
+    Executor::global()
+    {
+      std::lock_guard<std::mutex> lock(global_mutex);
+      if (!global_executor)
+        global_executor = std::make_shared<ThreadPoolExecutor>();
+      return global_executor;
+    }
+
+    void
+    Executor::setGlobal(const std::shared_ptr<Executor>& executor)
+    {
+      std::lock_guard<std::mutex> lock(global_mutex);
+      global_executor = executor;
+    }
+
+    class ThreadPoolExecutor::Impl
+    {
+    public:
+      /// Queue of a single thread.
+      struct Worker
+      {
+        /// Lock for tasks.
+        std::mutex mutex;
+        /// Pending tasks.
+        std::deque<task_type> tasks;
+      };
+
+      /// Per-thread queues.
+      std::vector<std::unique_ptr<Worker>> workers;
+      /// Threads.
+      std::vector<std::thread> threads;
+      /// Queue for the next task submitted by a thread outside the pool.
+      std::atomic<std::size_t> nextWorker;
+      /// Number of queued tasks.
+      std::size_t pending;
+      /// Stop the threads when no tasks are pending.
+      bool stop;
+      /// Lock for pending and stop.
+      std::mutex mutex;
+      /// Signalled when a task is submitted or stop is set.
+      std::condition_variable submitted;
+
+      Impl(unsigned int threads):
+        workers(),
+        threads(),
+        nextWorker(0U),
+        pending(0U),
+        stop(false),
+        mutex(),
+        submitted()
+      {
+        if (!threads)
+          threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+        for (unsigned int t = 0U; t < threads; ++t)
+          workers.push_back(std::unique_ptr<Worker>(new Worker()));
+        for (unsigned int t = 0U; t < threads; ++t)
+          this->threads.push_back(std::thread([this, t]() { run(t); }));
+      }
+
+      ~Impl()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          stop = true;
+        }
+        submitted.notify_all();
+
+        for (auto& thread : threads)
+          thread.join();
+      }
+
+      void
+      submit(task_type task)
+      {
+        const std::size_t w = current_pool == this ?
+          current_worker : nextWorker++ % workers.size();
+
+        {
+          // Count the task before it may be taken.
+          std::lock_guard<std::mutex> lock(mutex);
+          {
+            std::lock_guard<std::mutex> queuelock(workers[w]->mutex);
+            workers[w]->tasks.push_back(std::move(task));
+          }
+          ++pending;
+        }
+        submitted.notify_one();
+      }
+
+      // Take the newest task from the queue of this thread, or else
+      // the oldest task from the queue of another thread.
+      bool
+      take(std::size_t w,
+           task_type&  task)
+      {
+        for (std::size_t i = 0U; i < workers.size(); ++i)
+          {
+            Worker& worker(*workers[(w + i) % workers.size()]);
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if (worker.tasks.empty())
+              continue;
+            if (i == 0U)
+              {
+                task = std::move(worker.tasks.back());
+                worker.tasks.pop_back();
+              }
+            else
+              {
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+              }
+            return true;
+          }
+        return false;
+      }
+
+      void
+      run(std::size_t w)
+      {
+        current_pool = this;
+        current_worker = w;
+
+        while (true)
+          {
+            task_type task;
+            if (take(w, task))
+              {
+                {
+                  std::lock_guard<std::mutex> lock(mutex);
+                  --pending;
+                }
+                try
+                  {
+                    task();
+                  }
+                catch (...)
+                  {
+                    // Tasks must not throw.
+                  }
+                continue;
+              }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            submitted.wait(lock, [this]() { return stop || pending; });
+            if (stop && !pending)
+              break;
+          }
+      }
+    };
+
+    ThreadPoolExecutor::ThreadPoolExecutor(unsigned int threads):
+      Executor(),
+      impl(new Impl(threads))
+    {
+    }
+
+    ThreadPoolExecutor::~ThreadPoolExecutor()
+    {
+    }
+
+    void
+    ThreadPoolExecutor::submit(task_type task)
+    {
+      impl->submit(std::move(task));
+    }
+
+    unsigned int
+    ThreadPoolExecutor::concurrency() const
+    {
+      return static_cast<unsigned int>(impl->workers.size());
+    }
+
+  }
+}
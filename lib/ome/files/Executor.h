@@ -0,0 +1,216 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_EXECUTOR_H
+#define OME_FILES_EXECUTOR_H
+
+#include <functional>
+#include <memory>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Executor of tasks for parallel reading and writing.
+     *
+     * All parallel work done by the library (decoding and encoding
+     * tiles, reading planes from several files and prefetching
+     * planes) is run as tasks submitted to an executor, rather than
+     * by threads started for each operation.  The number of threads
+     * in use is therefore bounded by the executor, however many
+     * readers and writers are in use, and an application may supply
+     * its own executor to share an existing thread pool.
+     *
+     * The executor used by default is the global executor, which is
+     * a ThreadPoolExecutor unless replaced with setGlobal().  An
+     * executor may also be set for each reader and writer.
+     *
+     * Tasks may submit further tasks, and may call parallel() from
+     * within a task; the caller of parallel() runs any tasks not yet
+     * started itself, so nested parallel work can not deadlock even
+     * if every thread of the executor is waiting.
+     */
+    class Executor
+    {
+    public:
+      /// Task type.
+      typedef std::function<void ()> task_type;
+
+      /// Indexed task type.
+      typedef std::function<void (unsigned int)> indexed_task_type;
+
+      /// Constructor.
+      Executor();
+
+      /// Destructor.
+      virtual
+      ~Executor();
+
+      /// @cond SKIP
+      Executor (const Executor&) = delete;
+
+      Executor&
+      operator= (const Executor&) = delete;
+      /// @endcond SKIP
+
+      /**
+       * Submit a task to be run asynchronously.
+       *
+       * The task may be run by any thread, at any later time.
+       * Tasks must not throw; any exception is discarded.
+       *
+       * @param task the task to run.
+       */
+      virtual
+      void
+      submit(task_type task) = 0;
+
+      /**
+       * Get the number of tasks which may run concurrently.
+       *
+       * @returns the number of threads.
+       */
+      virtual
+      unsigned int
+      concurrency() const = 0;
+
+      /**
+       * Run a number of tasks in parallel, and wait for them.
+       *
+       * The task is called once for each index in the range [0,
+       * @p count), using up to @p count threads: the calling thread
+       * and up to concurrency() tasks submitted to this executor.
+       * The calling thread runs any tasks which have not been
+       * started by the executor.  The cancellation token of the
+       * calling thread (see CancellationToken) applies to the
+       * tasks, and is checked before each task is started.
+       *
+       * @param count the number of tasks.
+       * @param task the task to run for each index.
+       * @throws the first exception thrown by a task, if any, after
+       * all tasks have completed or been cancelled.
+       */
+      void
+      parallel(unsigned int              count,
+               const indexed_task_type& task);
+
+      /**
+       * Get the global executor.
+       *
+       * This is the executor used by all readers and writers
+       * without an executor of their own.  It is created on first
+       * use, with one thread per processor.
+       *
+       * @returns the global executor.
+       */
+      static
+      std::shared_ptr<Executor>
+      global();
+
+      /**
+       * Set the global executor.
+       *
+       * Readers and writers already using the previous global
+       * executor will continue to use it until their current
+       * operation completes.
+       *
+       * @param executor the executor to use, or null to restore the
+       * default thread pool.
+       */
+      static
+      void
+      setGlobal(const std::shared_ptr<Executor>& executor);
+    };
+
+    /**
+     * Work-stealing thread pool executor.
+     *
+     * Each thread has its own queue of tasks.  Tasks submitted from
+     * a pool thread are added to the queue of that thread, and run
+     * most recent first, since their data are most likely to be
+     * cached; tasks submitted from other threads are distributed
+     * between the queues in turn.  A thread with an empty queue
+     * takes the oldest task from the queue of another thread.
+     *
+     * All methods are thread-safe.  The destructor completes all
+     * submitted tasks before joining the threads.
+     */
+    class ThreadPoolExecutor : public Executor
+    {
+    public:
+      /**
+       * Constructor.
+       *
+       * The threads are started on construction.
+       *
+       * @param threads the number of threads; @c 0 to use one
+       * thread per processor.
+       */
+      explicit
+      ThreadPoolExecutor(unsigned int threads = 0U);
+
+      /// Destructor.
+      virtual
+      ~ThreadPoolExecutor();
+
+      // Documented in superclass.
+      void
+      submit(task_type task);
+
+      // Documented in superclass.
+      unsigned int
+      concurrency() const;
+
+    private:
+      class Impl;
+      /// Private implementation details.
+      std::unique_ptr<Impl> impl;
+    };
+
+  }
+}
+
+#endif // OME_FILES_EXECUTOR_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
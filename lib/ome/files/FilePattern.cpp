@@ -0,0 +1,414 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#include <ome/files/FilePattern.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      bool
+      is_digits(const std::string& str)
+      {
+        return !str.empty() &&
+          std::all_of(str.begin(), str.end(),
+                      [](char c){ return std::isdigit(static_cast<unsigned char>(c)) != 0; });
+      }
+
+      // Zero-pad a number to a minimum width.
+      std::string
+      pad(dimension_size_type value,
+          std::string::size_type width)
+      {
+        std::string str(std::to_string(value));
+        if (str.size() < width)
+          str.insert(0U, width - str.size(), '0');
+        return str;
+      }
+
+      // Compare digit strings numerically, then by width.
+      bool
+      numeric_less(const std::string& lhs,
+                   const std::string& rhs)
+      {
+        const std::string::size_type lz = std::min(lhs.find_first_not_of('0'), lhs.size());
+        const std::string::size_type rz = std::min(rhs.find_first_not_of('0'), rhs.size());
+        const std::string::size_type ln = lhs.size() - lz;
+        const std::string::size_type rn = rhs.size() - rz;
+        if (ln != rn)
+          return ln < rn;
+        const int cmp = lhs.compare(lz, ln, rhs, rz, rn);
+        if (cmp != 0)
+          return cmp < 0;
+        return lhs.size() < rhs.size();
+      }
+
+      typedef std::set<std::string, bool (*)(const std::string&, const std::string&)> value_set;
+
+      // Split a filename into alternating literal and numeric
+      // parts; the first and last parts are literal.
+      std::vector<std::string>
+      split_numbers(const std::string& name)
+      {
+        std::vector<std::string> parts(1U);
+        for (const char c : name)
+          {
+            const bool digit = std::isdigit(static_cast<unsigned char>(c)) != 0;
+            if (digit != (parts.size() % 2U == 0U))
+              parts.push_back(std::string());
+            parts.back() += c;
+          }
+        if (parts.size() % 2U == 0U)
+          parts.push_back(std::string());
+        return parts;
+      }
+
+      std::vector<std::string>
+      parse_block(const std::string& block)
+      {
+        std::vector<std::string> values;
+
+        const std::string::size_type dash = block.find('-');
+        if (block.find(',') != std::string::npos)
+          {
+            std::string::size_type start = 0U;
+            while (true)
+              {
+                const std::string::size_type end = block.find(',', start);
+                values.push_back(block.substr(start, end == std::string::npos ? end : end - start));
+                if (end == std::string::npos)
+                  break;
+                start = end + 1U;
+              }
+          }
+        else if (dash != std::string::npos)
+          {
+            const std::string first(block.substr(0U, dash));
+            const std::string last(block.substr(dash + 1U));
+            if (is_digits(first) && is_digits(last))
+              {
+                const dimension_size_type begin = std::stoull(first);
+                const dimension_size_type end = std::stoull(last);
+                for (dimension_size_type v = begin; v <= end; ++v)
+                  values.push_back(pad(v, first.size()));
+              }
+          }
+        else
+          {
+            values.push_back(block);
+          }
+
+        if (values.empty() ||
+            std::any_of(values.begin(), values.end(),
+                        [](const std::string& v){ return v.empty(); }))
+          {
+            boost::format fmt("Invalid file pattern block: <%1%>");
+            fmt % block;
+            throw std::logic_error(fmt.str());
+          }
+
+        return values;
+      }
+
+      std::string
+      block_string(const std::vector<std::string>& values)
+      {
+        bool range = values.size() > 1U && is_digits(values.front());
+        if (range)
+          {
+            const dimension_size_type first = std::stoull(values.front());
+            for (std::vector<std::string>::size_type i = 0; i < values.size(); ++i)
+              {
+                if (values[i] != pad(first + i, values.front().size()))
+                  {
+                    range = false;
+                    break;
+                  }
+              }
+          }
+
+        std::string str("<");
+        if (range)
+          {
+            str += values.front();
+            str += '-';
+            str += values.back();
+          }
+        else
+          {
+            for (std::vector<std::string>::size_type i = 0; i < values.size(); ++i)
+              {
+                if (i)
+                  str += ',';
+                str += values[i];
+              }
+          }
+        str += '>';
+        return str;
+      }
+
+    }
+
+    FilePattern::FilePattern():
+      pattern(),
+      literals(1U),
+      blocks()
+    {
+    }
+
+    FilePattern::FilePattern(const std::string& pattern):
+      pattern(pattern),
+      literals(1U),
+      blocks()
+    {
+      std::string::size_type pos = 0U;
+      while (pos < pattern.size())
+        {
+          const std::string::size_type start = pattern.find('<', pos);
+          literals.back() += pattern.substr(pos, start == std::string::npos ? start : start - pos);
+          if (start == std::string::npos)
+            break;
+
+          const std::string::size_type end = pattern.find('>', start);
+          if (end == std::string::npos)
+            {
+              boost::format fmt("Unterminated file pattern block: %1%");
+              fmt % pattern;
+              throw std::logic_error(fmt.str());
+            }
+
+          blocks.push_back(parse_block(pattern.substr(start + 1U, end - start - 1U)));
+          literals.push_back(std::string());
+          pos = end + 1U;
+        }
+    }
+
+    FilePattern
+    FilePattern::findPattern(const boost::filesystem::path& file)
+    {
+      const boost::filesystem::path dir(file.parent_path());
+      const std::vector<std::string> parts(split_numbers(file.filename().string()));
+
+      // Numeric parts of the similar files, including file.
+      std::vector<std::vector<std::string>> similar;
+      for (boost::filesystem::directory_iterator i(dir.empty() ? boost::filesystem::path(".") : dir), end;
+           i != end;
+           ++i)
+        {
+          if (!boost::filesystem::is_regular_file(i->status()))
+            continue;
+
+          const std::vector<std::string> candidate(split_numbers(i->path().filename().string()));
+          if (candidate.size() != parts.size())
+            continue;
+
+          bool match = true;
+          for (std::vector<std::string>::size_type p = 0; p < parts.size(); p += 2U)
+            {
+              if (candidate[p] != parts[p])
+                {
+                  match = false;
+                  break;
+                }
+            }
+          if (match)
+            similar.push_back(candidate);
+        }
+
+      // Values of each numeric part.
+      std::map<std::vector<std::string>::size_type, value_set> values;
+      for (std::vector<std::string>::size_type p = 1U; p < parts.size(); p += 2U)
+        {
+          value_set v(numeric_less);
+          v.insert(parts[p]);
+          for (const auto& s : similar)
+            v.insert(s[p]);
+          if (v.size() > 1U)
+            values.insert(std::make_pair(p, v));
+        }
+
+      dimension_size_type combinations = 1U;
+      for (const auto& v : values)
+        combinations *= v.second.size();
+
+      if (!values.empty() && combinations != similar.size())
+        {
+          // Vary the last varying part alone.
+          const std::vector<std::string>::size_type last = values.rbegin()->first;
+          value_set v(numeric_less);
+          for (const auto& s : similar)
+            {
+              bool match = true;
+              for (std::vector<std::string>::size_type p = 1U; p < parts.size(); p += 2U)
+                {
+                  if (p != last && s[p] != parts[p])
+                    {
+                      match = false;
+                      break;
+                    }
+                }
+              if (match)
+                v.insert(s[last]);
+            }
+          values.clear();
+          if (v.size() > 1U)
+            values.insert(std::make_pair(last, v));
+        }
+
+      FilePattern fp;
+      if (!dir.empty())
+        {
+          fp.literals.back() = dir.string();
+          fp.literals.back() += static_cast<char>(boost::filesystem::path::preferred_separator);
+        }
+      for (std::vector<std::string>::size_type p = 0; p < parts.size(); ++p)
+        {
+          const auto v = values.find(p);
+          if (v != values.end())
+            {
+              fp.blocks.push_back(std::vector<std::string>(v->second.begin(), v->second.end()));
+              fp.literals.push_back(std::string());
+            }
+          else
+            {
+              fp.literals.back() += parts[p];
+            }
+        }
+      fp.updatePattern();
+
+      return fp;
+    }
+
+    const std::string&
+    FilePattern::getPattern() const
+    {
+      return pattern;
+    }
+
+    dimension_size_type
+    FilePattern::getBlockCount() const
+    {
+      return blocks.size();
+    }
+
+    const std::vector<std::string>&
+    FilePattern::getBlock(dimension_size_type block) const
+    {
+      return blocks.at(block);
+    }
+
+    const std::string&
+    FilePattern::getPrefix(dimension_size_type block) const
+    {
+      return literals.at(block);
+    }
+
+    dimension_size_type
+    FilePattern::getFileCount() const
+    {
+      dimension_size_type count = 1U;
+      for (const auto& block : blocks)
+        count *= block.size();
+      return count;
+    }
+
+    boost::filesystem::path
+    FilePattern::getFile(dimension_size_type index) const
+    {
+      if (index >= getFileCount())
+        {
+          boost::format fmt("Invalid file index: %1%");
+          fmt % index;
+          throw std::logic_error(fmt.str());
+        }
+
+      // The last block varies fastest.
+      std::vector<std::string::size_type> indexes(blocks.size());
+      for (dimension_size_type b = blocks.size(); b > 0U; --b)
+        {
+          indexes[b - 1U] = index % blocks[b - 1U].size();
+          index /= blocks[b - 1U].size();
+        }
+
+      std::string name(literals.front());
+      for (dimension_size_type b = 0U; b < blocks.size(); ++b)
+        {
+          name += blocks[b][indexes[b]];
+          name += literals[b + 1U];
+        }
+      return boost::filesystem::path(name);
+    }
+
+    std::vector<boost::filesystem::path>
+    FilePattern::getFiles() const
+    {
+      std::vector<boost::filesystem::path> files;
+      const dimension_size_type count = getFileCount();
+      files.reserve(count);
+      for (dimension_size_type i = 0U; i < count; ++i)
+        files.push_back(getFile(i));
+      return files;
+    }
+
+    void
+    FilePattern::updatePattern()
+    {
+      pattern = literals.front();
+      for (dimension_size_type b = 0U; b < blocks.size(); ++b)
+        {
+          pattern += block_string(blocks[b]);
+          pattern += literals[b + 1U];
+        }
+    }
+
+  }
+}
@@ -0,0 +1,190 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_FILEPATTERN_H
+#define OME_FILES_FILEPATTERN_H
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * A pattern describing a set of files with similar names.
+     *
+     * A pattern is a filename containing numeric blocks in angle
+     * brackets.  Each block is either a range, @c \<first-last\>,
+     * or a list, @c \<a,b,c\>.  The values of a range are
+     * zero-padded to the width of @c first, so @c img_\<001-120\>.tif
+     * matches @c img_001.tif to @c img_120.tif.  The files of a
+     * pattern are every combination of block values, with the
+     * last block varying fastest.
+     *
+     * findPattern() derives a pattern from a single file and the
+     * other files in its directory.
+     */
+    class FilePattern
+    {
+    public:
+      /**
+       * Constructor.
+       *
+       * @param pattern the file pattern.
+       * @throws std::logic_error if a block is invalid.
+       */
+      explicit
+      FilePattern(const std::string& pattern);
+
+      /**
+       * Find the pattern of a file.
+       *
+       * The numeric parts of the filename are compared with the
+       * other files in the same directory which differ only in
+       * their numeric parts.  Each numeric part with more than one
+       * value becomes a block.  If the files found are not every
+       * combination of the values, only the last numeric part which
+       * varies becomes a block, with the other parts fixed to the
+       * values of @p file.
+       *
+       * @param file the file to find the pattern of.
+       * @returns the pattern; this matches @p file alone if no
+       * similar files were found.
+       */
+      static
+      FilePattern
+      findPattern(const boost::filesystem::path& file);
+
+      /**
+       * Get the pattern.
+       *
+       * @returns the pattern string.
+       */
+      const std::string&
+      getPattern() const;
+
+      /**
+       * Get the number of blocks.
+       *
+       * @returns the block count.
+       */
+      dimension_size_type
+      getBlockCount() const;
+
+      /**
+       * Get the values of a block.
+       *
+       * @param block the block index.
+       * @returns the values.
+       */
+      const std::vector<std::string>&
+      getBlock(dimension_size_type block) const;
+
+      /**
+       * Get the text preceding a block.
+       *
+       * This is the part of the pattern between the previous block
+       * (or the start of the filename) and the block, and may be
+       * used to determine what the block represents.
+       *
+       * @param block the block index.
+       * @returns the preceding text.
+       */
+      const std::string&
+      getPrefix(dimension_size_type block) const;
+
+      /**
+       * Get the number of files matching the pattern.
+       *
+       * @returns the file count.
+       */
+      dimension_size_type
+      getFileCount() const;
+
+      /**
+       * Get a file matching the pattern.
+       *
+       * @param index the file index.
+       * @returns the filename.
+       * @throws std::logic_error if the index is invalid.
+       */
+      boost::filesystem::path
+      getFile(dimension_size_type index) const;
+
+      /**
+       * Get all the files matching the pattern.
+       *
+       * @returns the filenames, in pattern order.
+       */
+      std::vector<boost::filesystem::path>
+      getFiles() const;
+
+    private:
+      /// Empty constructor for findPattern().
+      FilePattern();
+
+      /**
+       * Set the pattern string from the literals and blocks.
+       */
+      void
+      updatePattern();
+
+      /// The pattern.
+      std::string pattern;
+      /// The text surrounding the blocks (one more than the blocks).
+      std::vector<std::string> literals;
+      /// The values of each block.
+      std::vector<std::vector<std::string>> blocks;
+    };
+
+  }
+}
+
+#endif // OME_FILES_FILEPATTERN_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,767 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/FileStitcher.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      // Index of a dimension in ZCT order.
+      dimension_size_type
+      zct_index(char dimension)
+      {
+        return dimension == 'Z' ? 0U : dimension == 'C' ? 1U : 2U;
+      }
+
+      // Guess the dimension of a pattern block from the word
+      // preceding it.
+      char
+      guess_axis(const std::string& prefix)
+      {
+        std::string::size_type start = prefix.size();
+        while (start > 0U && std::isalpha(static_cast<unsigned char>(prefix[start - 1U])))
+          --start;
+
+        std::string word(prefix.substr(start));
+        std::transform(word.begin(), word.end(), word.begin(),
+                       [](char c){ return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+        static const std::vector<std::string> zwords{"z", "zs", "focal", "plane", "section", "slice"};
+        static const std::vector<std::string> cwords{"c", "ch", "channel", "w", "wave", "wavelength"};
+
+        if (std::find(zwords.begin(), zwords.end(), word) != zwords.end())
+          return 'Z';
+        if (std::find(cwords.begin(), cwords.end(), word) != cwords.end())
+          return 'C';
+        return 'T';
+      }
+
+    }
+
+    const dimension_size_type FileStitcher::default_open_file_limit;
+
+    FileStitcher::FileStitcher(const std::shared_ptr<FormatReader>& reader,
+                               const reader_factory&                factory):
+      ReaderWrapper(reader),
+      factory(factory),
+      pattern(),
+      files(),
+      axes(),
+      fileCounts{{1U, 1U, 1U}},
+      core(),
+      plane(0U),
+      poolMutex(),
+      openFileLimit(default_open_file_limit),
+      pool(),
+      poolIndex()
+    {
+      if (!factory)
+        throw std::logic_error("Reader factory is null");
+    }
+
+    FileStitcher::~FileStitcher()
+    {
+    }
+
+    const FilePattern&
+    FileStitcher::getFilePattern() const
+    {
+      if (!pattern)
+        throw std::logic_error("Current file not set");
+      return *pattern;
+    }
+
+    const std::vector<char>&
+    FileStitcher::getAxisTypes() const
+    {
+      return axes;
+    }
+
+    void
+    FileStitcher::setOpenFileLimit(dimension_size_type limit)
+    {
+      std::lock_guard<std::mutex> lock(poolMutex);
+      openFileLimit = limit;
+      evict();
+    }
+
+    dimension_size_type
+    FileStitcher::getOpenFileLimit() const
+    {
+      std::lock_guard<std::mutex> lock(poolMutex);
+      return openFileLimit;
+    }
+
+    dimension_size_type
+    FileStitcher::getOpenFileCount() const
+    {
+      std::lock_guard<std::mutex> lock(poolMutex);
+      return pool.size();
+    }
+
+    void
+    FileStitcher::openPlanes(const std::vector<dimension_size_type>& planes,
+                             std::vector<VariantPixelBuffer>&        bufs) const
+    {
+      const dimension_size_type index = getCoreIndex();
+      const std::array<dimension_size_type, 2> sr(seriesResolution(index));
+      const PlaneRegion region(0U, 0U, getSizeX(), getSizeY());
+
+      std::vector<location_type> locations;
+      locations.reserve(planes.size());
+      for (const auto p : planes)
+        locations.push_back(core.empty() ? location_type{{0U, p}} : locate(index, p));
+
+      bufs.resize(planes.size());
+
+      const dimension_size_type nthreads =
+        std::min(static_cast<dimension_size_type>(std::max(getDecodeThreads(), 1U)),
+                 static_cast<dimension_size_type>(planes.size()));
+
+      if (nthreads < 2U)
+        {
+          for (std::vector<location_type>::size_type i = 0; i < locations.size(); ++i)
+            getFileReader(locations[i][0])->openBytesAt(sr[0], sr[1], locations[i][1], bufs[i], region);
+          return;
+        }
+
+      // Each task reads every nthreads-th plane.  Consecutive
+      // planes are usually in different files, which are read
+      // concurrently with separate readers.
+      getExecutor()->parallel(static_cast<unsigned int>(nthreads),
+                              [&](unsigned int t)
+                              {
+                                for (dimension_size_type i = t; i < locations.size(); i += nthreads)
+                                  getFileReader(locations[i][0])->openBytesAt(sr[0], sr[1], locations[i][1], bufs[i], region);
+                              });
+    }
+
+    FileStitcher::location_type
+    FileStitcher::locate(dimension_size_type index,
+                         dimension_size_type plane) const
+    {
+      if (plane >= core.at(index)->imageCount)
+        {
+          boost::format fmt("Invalid plane: %1%");
+          fmt % plane;
+          throw std::logic_error(fmt.str());
+        }
+
+      const CoreMetadata& fc(*reader->getCoreMetadataList().at(index));
+      const std::array<dimension_size_type, 3> coords(getIndexer(index).coords(plane));
+      const std::array<dimension_size_type, 3> fileSizes{{fc.sizeZ, fc.sizeC.size(), fc.sizeT}};
+
+      std::array<dimension_size_type, 3> along;
+      std::array<dimension_size_type, 3> within;
+      for (dimension_size_type d = 0; d < 3U; ++d)
+        {
+          along[d] = coords[d] / fileSizes[d];
+          within[d] = coords[d] % fileSizes[d];
+        }
+
+      // The last block varies fastest, both in the file order and
+      // along each dimension.
+      dimension_size_type file = 0U;
+      dimension_size_type stride = 1U;
+      for (dimension_size_type b = axes.size(); b > 0U; --b)
+        {
+          const dimension_size_type count = pattern->getBlock(b - 1U).size();
+          const dimension_size_type d = zct_index(axes[b - 1U]);
+          file += (along[d] % count) * stride;
+          along[d] /= count;
+          stride *= count;
+        }
+
+      const DimensionIndexer fileIndexer(fc.dimensionOrder,
+                                         fc.sizeZ,
+                                         fc.sizeC.size(),
+                                         fc.sizeT,
+                                         fc.moduloZ.size(),
+                                         fc.moduloC.size(),
+                                         fc.moduloT.size(),
+                                         fc.imageCount);
+
+      return location_type{{file, fileIndexer.index(within[0], within[1], within[2])}};
+    }
+
+    std::shared_ptr<FormatReader>
+    FileStitcher::getFileReader(dimension_size_type file) const
+    {
+      if (file == 0U)
+        return reader;
+
+      {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        auto found = poolIndex.find(file);
+        if (found != poolIndex.end())
+          {
+            pool.splice(pool.begin(), pool, found->second);
+            return found->second->second;
+          }
+      }
+
+      // Open without holding the lock, so that other files may be
+      // opened and read concurrently.
+      std::shared_ptr<FormatReader> fileReader(factory());
+      fileReader->setFlattenedResolutions(reader->hasFlattenedResolutions());
+      fileReader->setIndexedExpanded(reader->isIndexedExpanded());
+      fileReader->setNormalized(reader->isNormalized());
+      fileReader->setDecodeThreads(reader->getDecodeThreads());
+      fileReader->setExecutor(reader->getExecutor());
+      fileReader->setOriginalMetadataPopulated(false);
+      fileReader->setId(files.at(file));
+
+      std::lock_guard<std::mutex> lock(poolMutex);
+      auto found = poolIndex.find(file);
+      if (found != poolIndex.end())
+        {
+          // Opened concurrently by another thread.
+          pool.splice(pool.begin(), pool, found->second);
+          return found->second->second;
+        }
+
+      pool.push_front(std::make_pair(file, fileReader));
+      poolIndex.insert(std::make_pair(file, pool.begin()));
+      evict();
+
+      return fileReader;
+    }
+
+    void
+    FileStitcher::evict() const
+    {
+      if (openFileLimit == 0U)
+        return;
+
+      auto i = pool.end();
+      while (pool.size() > openFileLimit && i != pool.begin())
+        {
+          --i;
+          // Readers referenced outside the pool are in use.
+          if (i->second.use_count() == 1)
+            {
+              i->second->close();
+              poolIndex.erase(i->first);
+              i = pool.erase(i);
+            }
+        }
+    }
+
+    std::array<dimension_size_type, 2>
+    FileStitcher::seriesResolution(dimension_size_type index) const
+    {
+      const dimension_size_type series = coreIndexToSeries(index);
+      return std::array<dimension_size_type, 2>{{series, index - seriesToCoreIndex(series)}};
+    }
+
+    DimensionIndexer
+    FileStitcher::getIndexer(dimension_size_type index) const
+    {
+      const CoreMetadata& c(*core.at(index));
+      return DimensionIndexer(c.dimensionOrder,
+                              c.sizeZ,
+                              c.sizeC.size(),
+                              c.sizeT,
+                              c.moduloZ.size(),
+                              c.moduloC.size(),
+                              c.moduloT.size(),
+                              c.imageCount);
+    }
+
+    void
+    FileStitcher::setId(const boost::filesystem::path& id)
+    {
+      close();
+
+      const std::string& name(id.string());
+      pattern = std::make_shared<FilePattern>(name.find('<') != std::string::npos ?
+                                              FilePattern(name) :
+                                              FilePattern::findPattern(id));
+      files = pattern->getFiles();
+
+      ReaderWrapper::setId(files.front());
+
+      fileCounts = {{1U, 1U, 1U}};
+      for (dimension_size_type b = 0; b < pattern->getBlockCount(); ++b)
+        {
+          axes.push_back(guess_axis(pattern->getPrefix(b)));
+          fileCounts[zct_index(axes.back())] *= pattern->getBlock(b).size();
+        }
+
+      for (const auto& c : reader->getCoreMetadataList())
+        {
+          std::shared_ptr<CoreMetadata> stitched;
+          if (c)
+            {
+              stitched = std::make_shared<CoreMetadata>(*c);
+              stitched->sizeZ *= fileCounts[0];
+              stitched->sizeC.clear();
+              for (dimension_size_type i = 0; i < fileCounts[1]; ++i)
+                stitched->sizeC.insert(stitched->sizeC.end(), c->sizeC.begin(), c->sizeC.end());
+              stitched->sizeT *= fileCounts[2];
+              stitched->imageCount *= fileCounts[0] * fileCounts[1] * fileCounts[2];
+            }
+          core.push_back(stitched);
+        }
+    }
+
+    void
+    FileStitcher::close(bool fileOnly)
+    {
+      ReaderWrapper::close(fileOnly);
+
+      {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        for (auto& entry : pool)
+          entry.second->close();
+        pool.clear();
+        poolIndex.clear();
+      }
+
+      if (!fileOnly)
+        {
+          pattern.reset();
+          files.clear();
+          axes.clear();
+          fileCounts = {{1U, 1U, 1U}};
+          core.clear();
+          plane = 0U;
+        }
+    }
+
+    const std::vector<boost::filesystem::path>
+    FileStitcher::getUsedFiles(bool noPixels) const
+    {
+      std::vector<boost::filesystem::path> used(ReaderWrapper::getUsedFiles(noPixels));
+      if (!noPixels && files.size() > 1U)
+        used.insert(used.end(), files.begin() + 1, files.end());
+      return used;
+    }
+
+    const std::vector<boost::filesystem::path>
+    FileStitcher::getSeriesUsedFiles(bool noPixels) const
+    {
+      std::vector<boost::filesystem::path> used(ReaderWrapper::getSeriesUsedFiles(noPixels));
+      if (!noPixels && files.size() > 1U)
+        used.insert(used.end(), files.begin() + 1, files.end());
+      return used;
+    }
+
+    dimension_size_type
+    FileStitcher::getImageCount() const
+    {
+      if (core.empty())
+        return ReaderWrapper::getImageCount();
+      return core.at(getCoreIndex())->imageCount;
+    }
+
+    bool
+    FileStitcher::isRGB(dimension_size_type channel) const
+    {
+      return getRGBChannelCount(channel) > 1U;
+    }
+
+    dimension_size_type
+    FileStitcher::getSizeZ() const
+    {
+      if (core.empty())
+        return ReaderWrapper::getSizeZ();
+      return core.at(getCoreIndex())->sizeZ;
+    }
+
+    dimension_size_type
+    FileStitcher::getSizeT() const
+    {
+      if (core.empty())
+        return ReaderWrapper::getSizeT();
+      return core.at(getCoreIndex())->sizeT;
+    }
+
+    dimension_size_type
+    FileStitcher::getSizeC() const
+    {
+      if (core.empty())
+        return ReaderWrapper::getSizeC();
+      return ReaderWrapper::getSizeC() * fileCounts[1];
+    }
+
+    dimension_size_type
+    FileStitcher::getEffectiveSizeC() const
+    {
+      if (core.empty())
+        return ReaderWrapper::getEffectiveSizeC();
+      return core.at(getCoreIndex())->sizeC.size();
+    }
+
+    dimension_size_type
+    FileStitcher::getRGBChannelCount(dimension_size_type channel) const
+    {
+      if (core.empty())
+        return ReaderWrapper::getRGBChannelCount(channel);
+      return core.at(getCoreIndex())->sizeC.at(channel);
+    }
+
+    bool
+    FileStitcher::isInterleaved(dimension_size_type channel) const
+    {
+      if (core.empty())
+        return ReaderWrapper::isInterleaved(channel);
+      return ReaderWrapper::isInterleaved(channel % ReaderWrapper::getEffectiveSizeC());
+    }
+
+    dimension_size_type
+    FileStitcher::getOptimalTileWidth(dimension_size_type channel) const
+    {
+      if (core.empty())
+        return ReaderWrapper::getOptimalTileWidth(channel);
+      return ReaderWrapper::getOptimalTileWidth(channel % ReaderWrapper::getEffectiveSizeC());
+    }
+
+    dimension_size_type
+    FileStitcher::getOptimalTileHeight(dimension_size_type channel) const
+    {
+      if (core.empty())
+        return ReaderWrapper::getOptimalTileHeight(channel);
+      return ReaderWrapper::getOptimalTileHeight(channel % ReaderWrapper::getEffectiveSizeC());
+    }
+
+    void
+    FileStitcher::getLookupTable(dimension_size_type plane,
+                                 VariantPixelBuffer& buf) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::getLookupTable(plane, buf);
+          return;
+        }
+
+      const dimension_size_type index = getCoreIndex();
+      const location_type location(locate(index, plane));
+      std::shared_ptr<FormatReader> fileReader(getFileReader(location[0]));
+      fileReader->setCoreIndex(index);
+      fileReader->getLookupTable(location[1], buf);
+    }
+
+    void
+    FileStitcher::openBytes(dimension_size_type plane,
+                            VariantPixelBuffer& buf) const
+    {
+      openBytes(plane, buf, 0U, 0U, getSizeX(), getSizeY());
+    }
+
+    void
+    FileStitcher::openBytes(dimension_size_type plane,
+                            VariantPixelBuffer& buf,
+                            dimension_size_type x,
+                            dimension_size_type y,
+                            dimension_size_type w,
+                            dimension_size_type h) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::openBytes(plane, buf, x, y, w, h);
+          return;
+        }
+
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      const std::array<dimension_size_type, 2> sr(seriesResolution(index));
+      const location_type location(locate(index, plane));
+      getFileReader(location[0])->openBytesAt(sr[0], sr[1], location[1], buf, PlaneRegion(x, y, w, h));
+    }
+
+    void
+    FileStitcher::openBytesBatch(dimension_size_type              plane,
+                                 const std::vector<PlaneRegion>&  regions,
+                                 std::vector<VariantPixelBuffer>& bufs) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::openBytesBatch(plane, regions, bufs);
+          return;
+        }
+
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      const location_type location(locate(index, plane));
+      std::shared_ptr<FormatReader> fileReader(getFileReader(location[0]));
+      fileReader->setCoreIndex(index);
+      fileReader->openBytesBatch(location[1], regions, bufs);
+    }
+
+    void
+    FileStitcher::openBytesDecimated(dimension_size_type plane,
+                                     VariantPixelBuffer& buf,
+                                     const PlaneRegion&  region,
+                                     dimension_size_type xstep,
+                                     dimension_size_type ystep) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::openBytesDecimated(plane, buf, region, xstep, ystep);
+          return;
+        }
+
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      const location_type location(locate(index, plane));
+      std::shared_ptr<FormatReader> fileReader(getFileReader(location[0]));
+      fileReader->setCoreIndex(index);
+      fileReader->openBytesDecimated(location[1], buf, region, xstep, ystep);
+    }
+
+    void
+    FileStitcher::openBytesAt(dimension_size_type series,
+                              dimension_size_type resolution,
+                              dimension_size_type plane,
+                              VariantPixelBuffer& buf,
+                              const PlaneRegion&  region) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::openBytesAt(series, resolution, plane, buf, region);
+          return;
+        }
+
+      const location_type location(locate(seriesToCoreIndex(series) + resolution, plane));
+      getFileReader(location[0])->openBytesAt(series, resolution, location[1], buf, region);
+    }
+
+    void
+    FileStitcher::openBytesInto(dimension_size_type     series,
+                                dimension_size_type     resolution,
+                                dimension_size_type     plane,
+                                VariantPixelBufferView& buf,
+                                const PlaneRegion&      region) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::openBytesInto(series, resolution, plane, buf, region);
+          return;
+        }
+
+      const location_type location(locate(seriesToCoreIndex(series) + resolution, plane));
+      getFileReader(location[0])->openBytesInto(series, resolution, location[1], buf, region);
+    }
+
+    void
+    FileStitcher::forEachTile(dimension_size_type  plane,
+                              const tile_callback& callback) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::forEachTile(plane, callback);
+          return;
+        }
+
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      const location_type location(locate(index, plane));
+      std::shared_ptr<FormatReader> fileReader(getFileReader(location[0]));
+      fileReader->setCoreIndex(index);
+      fileReader->forEachTile(location[1], callback);
+    }
+
+    void
+    FileStitcher::openThumbBytes(dimension_size_type plane,
+                                 VariantPixelBuffer& buf) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::openThumbBytes(plane, buf);
+          return;
+        }
+
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      const location_type location(locate(index, plane));
+      std::shared_ptr<FormatReader> fileReader(getFileReader(location[0]));
+      fileReader->setCoreIndex(index);
+      fileReader->openThumbBytes(location[1], buf);
+    }
+
+    void
+    FileStitcher::openRawTile(dimension_size_type   plane,
+                              dimension_size_type   tile,
+                              std::vector<uint8_t>& buf) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::openRawTile(plane, tile, buf);
+          return;
+        }
+
+      setPlane(plane);
+
+      const dimension_size_type index = getCoreIndex();
+      const location_type location(locate(index, plane));
+      std::shared_ptr<FormatReader> fileReader(getFileReader(location[0]));
+      fileReader->setCoreIndex(index);
+      fileReader->openRawTile(location[1], tile, buf);
+    }
+
+    void
+    FileStitcher::setSeries(dimension_size_type series) const
+    {
+      ReaderWrapper::setSeries(series);
+      plane = 0U;
+    }
+
+    void
+    FileStitcher::setPlane(dimension_size_type plane) const
+    {
+      if (core.empty())
+        {
+          ReaderWrapper::setPlane(plane);
+          return;
+        }
+
+      if (plane >= getImageCount())
+        {
+          boost::format fmt("Invalid plane: %1%");
+          fmt % plane;
+          throw std::logic_error(fmt.str());
+        }
+      this->plane = plane;
+    }
+
+    dimension_size_type
+    FileStitcher::getPlane() const
+    {
+      if (core.empty())
+        return ReaderWrapper::getPlane();
+      return plane;
+    }
+
+    dimension_size_type
+    FileStitcher::getIndex(dimension_size_type z,
+                           dimension_size_type c,
+                           dimension_size_type t) const
+    {
+      if (core.empty())
+        return ReaderWrapper::getIndex(z, c, t);
+      const DimensionIndexer indexer(getDimensionIndexer());
+      indexer.checkCoords(z, c, t);
+      return indexer.index(z, c, t);
+    }
+
+    dimension_size_type
+    FileStitcher::getIndex(dimension_size_type z,
+                           dimension_size_type c,
+                           dimension_size_type t,
+                           dimension_size_type moduloZ,
+                           dimension_size_type moduloC,
+                           dimension_size_type moduloT) const
+    {
+      if (core.empty())
+        return ReaderWrapper::getIndex(z, c, t, moduloZ, moduloC, moduloT);
+      const DimensionIndexer indexer(getDimensionIndexer());
+      indexer.checkCoords(z, c, t, moduloZ, moduloC, moduloT);
+      return indexer.index(z, c, t, moduloZ, moduloC, moduloT);
+    }
+
+    std::array<dimension_size_type, 3>
+    FileStitcher::getZCTCoords(dimension_size_type index) const
+    {
+      if (core.empty())
+        return ReaderWrapper::getZCTCoords(index);
+      const DimensionIndexer indexer(getDimensionIndexer());
+      indexer.checkIndex(index);
+      return indexer.coords(index);
+    }
+
+    std::array<dimension_size_type, 6>
+    FileStitcher::getZCTModuloCoords(dimension_size_type index) const
+    {
+      if (core.empty())
+        return ReaderWrapper::getZCTModuloCoords(index);
+      const DimensionIndexer indexer(getDimensionIndexer());
+      indexer.checkIndex(index);
+      return indexer.moduloCoords(index);
+    }
+
+    DimensionIndexer
+    FileStitcher::getDimensionIndexer() const
+    {
+      if (core.empty())
+        return ReaderWrapper::getDimensionIndexer();
+      return getIndexer(getCoreIndex());
+    }
+
+    const std::vector<std::shared_ptr<CoreMetadata>>&
+    FileStitcher::getCoreMetadataList() const
+    {
+      if (core.empty())
+        return ReaderWrapper::getCoreMetadataList();
+      return core;
+    }
+
+    void
+    FileStitcher::setCoreIndex(dimension_size_type index) const
+    {
+      ReaderWrapper::setCoreIndex(index);
+      plane = 0U;
+    }
+
+    void
+    FileStitcher::setResolution(dimension_size_type resolution) const
+    {
+      ReaderWrapper::setResolution(resolution);
+      plane = 0U;
+    }
+
+  }
+}
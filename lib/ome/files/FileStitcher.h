@@ -0,0 +1,445 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_FILESTITCHER_H
+#define OME_FILES_FILESTITCHER_H
+
+#include <array>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/DimensionIndexer.h>
+#include <ome/files/FilePattern.h>
+#include <ome/files/ReaderWrapper.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Reader presenting a set of files with similar names as a
+     * single dataset.
+     *
+     * The id is either a FilePattern, or a file from which the
+     * pattern is found with FilePattern::findPattern().  Each
+     * block of the pattern is assigned to the Z, C or T dimension
+     * from the text preceding it (for example @c _z001, @c _c1 or
+     * @c _t0005); blocks which can not be assigned are assumed to
+     * be timepoints.  The files along each dimension are stacked,
+     * so a pattern of single-plane files becomes a dataset with
+     * one plane per file.
+     *
+     * Only the first file is opened by setId(), using the wrapped
+     * reader.  The other files are assumed to have the same
+     * metadata, and are opened only when their pixel data are
+     * read, using readers created by a factory.  The readers of
+     * these files are kept in a pool, and the least recently used
+     * idle readers are closed when the pool exceeds its limit, so
+     * that datasets of many thousands of files do not exhaust the
+     * open file limit of the process.  Readers in use are never
+     * closed, so the limit may be exceeded temporarily.
+     *
+     * openPlanes() reads several planes, reading from different
+     * files in parallel.
+     *
+     * The MetadataStore is not changed, and describes the first
+     * file only.
+     */
+    class FileStitcher : public ReaderWrapper
+    {
+    public:
+      /// Factory to create a reader for a file.
+      typedef std::function<std::shared_ptr<FormatReader>()> reader_factory;
+
+      /// Default limit of open file readers.
+      static const dimension_size_type default_open_file_limit = 64U;
+
+      /**
+       * Constructor.
+       *
+       * @param reader the reader for the first file.
+       * @param factory the factory to create readers for the other
+       * files.
+       * @throws std::logic_error if the reader or factory is null.
+       */
+      FileStitcher(const std::shared_ptr<FormatReader>& reader,
+                   const reader_factory&                factory);
+
+      /// Destructor.
+      virtual
+      ~FileStitcher();
+
+      /**
+       * Get the file pattern.
+       *
+       * @returns the file pattern.
+       * @throws std::logic_error if the current file is not set.
+       */
+      const FilePattern&
+      getFilePattern() const;
+
+      /**
+       * Get the dimension of each block of the file pattern.
+       *
+       * @returns the dimension (@c 'Z', @c 'C' or @c 'T') of each
+       * block.
+       */
+      const std::vector<char>&
+      getAxisTypes() const;
+
+      /**
+       * Set the maximum number of files to hold open.
+       *
+       * The first file is always open, and is not counted.  A limit
+       * of zero disables closing.
+       *
+       * @param limit the maximum number of open files.
+       */
+      void
+      setOpenFileLimit(dimension_size_type limit);
+
+      /**
+       * Get the maximum number of files to hold open.
+       *
+       * @returns the maximum number of open files.
+       */
+      dimension_size_type
+      getOpenFileLimit() const;
+
+      /**
+       * Get the number of files currently open.
+       *
+       * The first file is not counted.
+       *
+       * @returns the open file count.
+       */
+      dimension_size_type
+      getOpenFileCount() const;
+
+      /**
+       * Obtain several whole image planes.
+       *
+       * This is equivalent to calling openBytes() for each plane,
+       * but planes are read concurrently with up to
+       * getDecodeThreads() tasks on the executor (see
+       * getExecutor()), so that planes stored in different files
+       * are read in parallel.  The current plane is not changed.
+       *
+       * @param planes the plane indexes within the current series.
+       * @param bufs the destination pixel buffers; resized to the
+       * number of planes, with one buffer per plane.
+       * @throws FormatException if there was a problem reading a
+       * file.
+       * @throws std::logic_error if a plane index is invalid.
+       */
+      void
+      openPlanes(const std::vector<dimension_size_type>& planes,
+                 std::vector<VariantPixelBuffer>&        bufs) const;
+
+    private:
+      /// Location of a plane: the file and plane within the file.
+      typedef std::array<dimension_size_type, 2> location_type;
+
+      /**
+       * Get the location of a plane.
+       *
+       * @param index the core index.
+       * @param plane the plane index.
+       * @returns the file index and the plane index within the file.
+       * @throws std::logic_error if the plane index is invalid.
+       */
+      location_type
+      locate(dimension_size_type index,
+             dimension_size_type plane) const;
+
+      /**
+       * Get the reader for a file, opening it if needed.
+       *
+       * The returned reader is not closed by the pool while
+       * referenced.
+       *
+       * @param file the file index.
+       * @returns the reader.
+       */
+      std::shared_ptr<FormatReader>
+      getFileReader(dimension_size_type file) const;
+
+      /// Close least recently used idle readers to fit the limit.
+      void
+      evict() const;
+
+      /**
+       * Get the series and resolution of a core index.
+       *
+       * @param index the core index.
+       * @returns the series and resolution.
+       */
+      std::array<dimension_size_type, 2>
+      seriesResolution(dimension_size_type index) const;
+
+      /**
+       * Get a dimension indexer for the stitched planes.
+       *
+       * @param index the core index.
+       * @returns the dimension indexer.
+       */
+      DimensionIndexer
+      getIndexer(dimension_size_type index) const;
+
+    public:
+      // Documented in superclass.
+      void
+      setId(const boost::filesystem::path& id);
+
+      // Documented in superclass.
+      void
+      close(bool fileOnly = false);
+
+      // Documented in superclass.
+      const std::vector<boost::filesystem::path>
+      getUsedFiles(bool noPixels = false) const;
+
+      // Documented in superclass.
+      const std::vector<boost::filesystem::path>
+      getSeriesUsedFiles(bool noPixels = false) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getImageCount() const;
+
+      // Documented in superclass.
+      bool
+      isRGB(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeZ() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeT() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeC() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getEffectiveSizeC() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getRGBChannelCount(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      bool
+      isInterleaved(dimension_size_type channel) const;
+
+      using ReaderWrapper::isInterleaved;
+      using ReaderWrapper::getOptimalTileWidth;
+      using ReaderWrapper::getOptimalTileHeight;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileWidth(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileHeight(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      void
+      getLookupTable(dimension_size_type plane,
+                     VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const;
+
+      // Documented in superclass.
+      void
+      openBytesBatch(dimension_size_type              plane,
+                     const std::vector<PlaneRegion>&  regions,
+                     std::vector<VariantPixelBuffer>& bufs) const;
+
+      // Documented in superclass.
+      void
+      openBytesDecimated(dimension_size_type plane,
+                         VariantPixelBuffer& buf,
+                         const PlaneRegion&  region,
+                         dimension_size_type xstep,
+                         dimension_size_type ystep) const;
+
+      // Documented in superclass.
+      void
+      openBytesAt(dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  const PlaneRegion&  region) const;
+
+      // Documented in superclass.
+      void
+      openBytesInto(dimension_size_type     series,
+                    dimension_size_type     resolution,
+                    dimension_size_type     plane,
+                    VariantPixelBufferView& buf,
+                    const PlaneRegion&      region) const;
+
+      // Documented in superclass.
+      void
+      forEachTile(dimension_size_type  plane,
+                  const tile_callback& callback) const;
+
+      // Documented in superclass.
+      void
+      openThumbBytes(dimension_size_type plane,
+                     VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openRawTile(dimension_size_type   plane,
+                  dimension_size_type   tile,
+                  std::vector<uint8_t>& buf) const;
+
+      // Documented in superclass.
+      void
+      setSeries(dimension_size_type series) const;
+
+      // Documented in superclass.
+      void
+      setPlane(dimension_size_type plane) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getPlane() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getIndex(dimension_size_type z,
+               dimension_size_type c,
+               dimension_size_type t) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getIndex(dimension_size_type z,
+               dimension_size_type c,
+               dimension_size_type t,
+               dimension_size_type moduloZ,
+               dimension_size_type moduloC,
+               dimension_size_type moduloT) const;
+
+      // Documented in superclass.
+      std::array<dimension_size_type, 3>
+      getZCTCoords(dimension_size_type index) const;
+
+      // Documented in superclass.
+      std::array<dimension_size_type, 6>
+      getZCTModuloCoords(dimension_size_type index) const;
+
+      // Documented in superclass.
+      DimensionIndexer
+      getDimensionIndexer() const;
+
+      // Documented in superclass.
+      const std::vector<std::shared_ptr<CoreMetadata>>&
+      getCoreMetadataList() const;
+
+      // Documented in superclass.
+      void
+      setCoreIndex(dimension_size_type index) const;
+
+      // Documented in superclass.
+      void
+      setResolution(dimension_size_type resolution) const;
+
+    private:
+      /// Open file reader pool, in order of use (most recently used first).
+      typedef std::list<std::pair<dimension_size_type, std::shared_ptr<FormatReader>>> pool_type;
+
+      /// Factory to create file readers.
+      reader_factory factory;
+      /// The file pattern.
+      std::shared_ptr<FilePattern> pattern;
+      /// The files of the pattern.
+      std::vector<boost::filesystem::path> files;
+      /// The dimension of each block of the pattern.
+      std::vector<char> axes;
+      /// The number of files along Z, C and T.
+      std::array<dimension_size_type, 3> fileCounts;
+      /// The stitched CoreMetadata of each core index.
+      std::vector<std::shared_ptr<CoreMetadata>> core;
+      /// The current plane.
+      mutable dimension_size_type plane;
+
+      /// Mutex serialising access to the pool.
+      mutable std::mutex poolMutex;
+      /// Maximum number of open file readers.
+      dimension_size_type openFileLimit;
+      /// Open file readers, in order of use.
+      mutable pool_type pool;
+      /// Mapping of file index to open file reader.
+      mutable std::map<dimension_size_type, pool_type::iterator> poolIndex;
+    };
+
+  }
+}
+
+#endif // OME_FILES_FILESTITCHER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
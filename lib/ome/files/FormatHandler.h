@@ -40,6 +40,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -49,6 +50,8 @@
 #include <boost/optional.hpp>
 #include <boost/version.hpp>
 
+#include <ome/files/IOStatistics.h>
+
 namespace ome
 {
   namespace files
@@ -169,6 +172,20 @@ namespace ome
       void
       close(bool fileOnly = false) = 0;
 
+      /**
+       * Get the I/O statistics.
+       *
+       * The statistics record the pixel data and metadata I/O of
+       * this reader or writer, including that of all the files it
+       * opens.  They are not reset by close(); use
+       * IOStatistics::reset() to start counting afresh.
+       *
+       * @returns the statistics.
+       */
+      virtual
+      std::shared_ptr<IOStatistics>
+      getIOStatistics() const = 0;
+
       // -- Utility methods --
 
       /**
@@ -39,6 +39,7 @@
 #define OME_FILES_FORMATREADER_H
 
 #include <array>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -49,10 +50,12 @@
 #include <ome/compat/memory.h>
 
 #include <ome/files/CoreMetadata.h>
+#include <ome/files/DimensionIndexer.h>
 #include <ome/files/FileInfo.h>
 #include <ome/files/FormatHandler.h>
 #include <ome/files/MetadataConfigurable.h>
 #include <ome/files/MetadataMap.h>
+#include <ome/files/PlaneRegion.h>
 #include <ome/files/Types.h>
 
 #include <ome/xml/meta/MetadataStore.h>
@@ -62,7 +65,9 @@ namespace ome
   namespace files
   {
 
+    class Executor;
     class VariantPixelBuffer;
+    class VariantPixelBufferView;
 
     /**
      * Interface for all biological file format readers.
@@ -75,6 +80,24 @@ namespace ome
     public:
       using FormatHandler::isThisType;
 
+      /**
+       * Tile callback.
+       *
+       * Called with the region of a chunk of an image plane and the
+       * pixel buffer containing it.
+       */
+      typedef std::function<void (const PlaneRegion&        region,
+                                  const VariantPixelBuffer& buf)> tile_callback;
+
+      /**
+       * Range of plane coordinates.
+       *
+       * The range is half-open: the first element is the first
+       * coordinate included, and the second element is one past the
+       * last coordinate included.
+       */
+      typedef std::array<dimension_size_type, 2> plane_range;
+
       /// File grouping options.
       enum FileGroupOption
         {
@@ -572,6 +595,8 @@ namespace ome
        * @param h the height of the sub-image.
        * @throws FormatException if there was a problem parsing the metadata of the
        *   file.
+       * @throws ReadCancelledException if the read was cancelled
+       *   by the CancellationToken of the current thread.
        */
       virtual
       void
@@ -582,11 +607,201 @@ namespace ome
                 dimension_size_type w,
                 dimension_size_type h) const = 0;
 
+      /**
+       * Obtain several sub-images of an image plane.
+       *
+       * This is equivalent to calling openBytes() for each region,
+       * but may be considerably more efficient when reading many
+       * regions of the same plane, since formats storing pixel data
+       * in tiles (e.g. TIFF) may decode each tile covered by the
+       * regions only once.
+       *
+       * @param plane the plane index within the series.
+       * @param regions the sub-images to read.
+       * @param bufs the destination pixel buffers; resized to the
+       * number of regions, with one buffer per region.
+       * @throws FormatException if there was a problem parsing the metadata of the
+       *   file.
+       */
+      virtual
+      void
+      openBytesBatch(dimension_size_type              plane,
+                     const std::vector<PlaneRegion>&  regions,
+                     std::vector<VariantPixelBuffer>& bufs) const = 0;
+
+      /**
+       * Obtain a decimated sub-image of an image plane.
+       *
+       * Only every @p xstep th column and @p ystep th row of the
+       * region, starting from its upper-left corner, are obtained,
+       * into a VariantPixelBuffer of size
+       *
+       * \code{.cpp}
+       * ⌈w/xstep⌉ * ⌈h/ystep⌉ * bytesPerPixel * getRGBChannelCount(channel)
+       * \endcode
+       *
+       * This avoids reading the whole region at full size in order
+       * to obtain a reduced-size preview.
+       *
+       * @param plane the plane index within the series.
+       * @param buf the destination pixel buffer.
+       * @param region the sub-image to read.
+       * @param xstep the column step (1 to read every column).
+       * @param ystep the row step (1 to read every row).
+       * @throws FormatException if there was a problem parsing the metadata of the
+       *   file.
+       * @throws std::logic_error if either step is zero.
+       */
+      virtual
+      void
+      openBytesDecimated(dimension_size_type plane,
+                         VariantPixelBuffer& buf,
+                         const PlaneRegion&  region,
+                         dimension_size_type xstep,
+                         dimension_size_type ystep) const = 0;
+
+      /**
+       * Obtain a sub-image of an image plane of any series and
+       * resolution.
+       *
+       * Unlike openBytes(), the series, resolution and plane are
+       * specified explicitly, and the current series, resolution
+       * and plane of the reader are neither used nor changed.  This
+       * permits a single reader, with its metadata parsed once, to
+       * serve requests from many threads concurrently.  Formats
+       * storing pixel data in TIFF files read concurrently; other
+       * formats serialise the requests.  The reader must not be
+       * closed, nor setId() called, while requests are in progress.
+       *
+       * @param series the series index.
+       * @param resolution the resolution index within the series.
+       * @param plane the plane index within the series.
+       * @param buf the destination pixel buffer.
+       * @param region the sub-image to read.
+       * @throws FormatException if there was a problem parsing the metadata of the
+       *   file.
+       * @throws std::logic_error if the series, resolution or plane
+       * is invalid.
+       */
+      virtual
+      void
+      openBytesAt(dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  const PlaneRegion&  region) const = 0;
+
+      /**
+       * Obtain a sub-image of an image plane of any series and
+       * resolution into caller-owned memory.
+       *
+       * This is equivalent to openBytesAt(), but the destination is
+       * a view, typically of memory owned by another library (see
+       * VariantPixelBufferView), which is never resized.  The view
+       * must have the pixel type of the series, the size of the
+       * region, and getRGBChannelCount() subchannels; rows may be
+       * padded, and samples interleaved or planar.  Where the
+       * reader and the layout of the view permit, pixel data is
+       * decoded straight into the viewed memory; otherwise the
+       * region is read into a temporary buffer and copied.
+       *
+       * @param series the series index.
+       * @param resolution the resolution index within the series.
+       * @param plane the plane index within the series.
+       * @param buf the destination pixel buffer view.
+       * @param region the sub-image to read.
+       * @throws FormatException if there was a problem parsing the metadata of the
+       *   file.
+       * @throws std::logic_error if the series, resolution or plane
+       * is invalid, or the pixel type or size of the view does not
+       * match the sub-image.
+       */
+      virtual
+      void
+      openBytesInto(dimension_size_type     series,
+                    dimension_size_type     resolution,
+                    dimension_size_type     plane,
+                    VariantPixelBufferView& buf,
+                    const PlaneRegion&      region) const = 0;
+
+      /**
+       * Obtain a sub-image of several image planes of any series and
+       * resolution.
+       *
+       * The sub-image of each plane within the @c Z, @c C and @c T
+       * ranges is obtained into a single VariantPixelBuffer of size
+       *
+       * \code{.cpp}
+       * w * h * zCount * cCount * tCount * bytesPerPixel * getRGBChannelCount(channel)
+       * \endcode
+       *
+       * with each plane stored at its offset from the start of the
+       * ranges in the @c Z, @c C and @c T dimensions.  This is
+       * equivalent to calling openBytesAt() for each plane and
+       * copying the planes into the larger buffer, but planes are
+       * read concurrently with up to getDecodeThreads() threads, and
+       * one plane buffer per thread is reused for every plane.  As
+       * for openBytesAt(), the current series, resolution and plane
+       * are neither used nor changed.  All the channels in the range
+       * must have the same number of subchannels.
+       *
+       * @param series the series index.
+       * @param resolution the resolution index within the series.
+       * @param zRange the @c Z coordinates to read (real size).
+       * @param cRange the @c C coordinates to read (effective size).
+       * @param tRange the @c T coordinates to read (real size).
+       * @param buf the destination pixel buffer.
+       * @param region the sub-image to read.
+       * @throws FormatException if there was a problem parsing the metadata of the
+       *   file.
+       * @throws std::logic_error if the series or resolution is
+       * invalid, if any range is empty or outside the image, or if
+       * the channels differ in their number of subchannels.
+       */
+      virtual
+      void
+      openBytesStack(dimension_size_type series,
+                     dimension_size_type resolution,
+                     const plane_range&  zRange,
+                     const plane_range&  cRange,
+                     const plane_range&  tRange,
+                     VariantPixelBuffer& buf,
+                     const PlaneRegion&  region) const = 0;
+
+      /**
+       * Read an image plane in chunks.
+       *
+       * The plane is read one chunk at a time into a single reused
+       * pixel buffer, and each chunk is passed to the callback.
+       * Memory use is proportional to the chunk size rather than
+       * the plane size, allowing planes too large to hold in memory
+       * to be processed, for example to compute histograms or
+       * statistics.  Formats storing pixel data in tiles or strips
+       * (e.g. TIFF) deliver their native tiles or strips in file
+       * order; other formats deliver regions of the optimal tile
+       * size in row order.  The buffer is only valid for the
+       * duration of the callback, and the callback must not read
+       * from this reader.
+       *
+       * @param plane the plane index within the series.
+       * @param callback the function to call for each chunk.
+       * @throws FormatException if there was a problem parsing the metadata of the
+       *   file.
+       */
+      virtual
+      void
+      forEachTile(dimension_size_type  plane,
+                  const tile_callback& callback) const = 0;
+
       /**
        * Obtain a thumbnail of an image plane.
        *
        * Obtail and copy the thumbnail for the specified image plane
-       * from the current series into a VariantPixelBuffer.
+       * from the current series into a VariantPixelBuffer of size
+       * getThumbSizeX() × getThumbSizeY().  The thumbnail is
+       * sampled from the smallest resolution no smaller than the
+       * thumbnail, using a decimated read of one band of rows at a
+       * time.  Thumbnails are cached until the reader is closed.
        *
        * @param plane the plane index within the series.
        * @param buf the destination pixel buffer.
@@ -596,6 +811,28 @@ namespace ome
       openThumbBytes(dimension_size_type plane,
                      VariantPixelBuffer& buf) const = 0;
 
+      /**
+       * Obtain a raw (still compressed) tile of an image plane.
+       *
+       * Copy the raw data for the specified tile of an image plane
+       * from the current series, exactly as stored in the file and
+       * without decoding.  This permits copying image data between
+       * files without decompressing and recompressing it, using
+       * FormatWriter::saveRawTile().  The tile numbering, size and
+       * compression are format-specific.
+       *
+       * @param plane the plane index within the series.
+       * @param tile the tile index within the plane.
+       * @param buf the destination buffer; resized to fit the tile.
+       * @throws std::runtime_error if the reader does not support
+       * raw tile access.
+       */
+      virtual
+      void
+      openRawTile(dimension_size_type   plane,
+                  dimension_size_type   tile,
+                  std::vector<uint8_t>& buf) const = 0;
+
       /**
        * Get the number of image series in this file.
        *
@@ -656,6 +893,18 @@ namespace ome
       /**
        * Set float normalization.
        *
+       * When enabled, floating point pixel data read with
+       * openBytes(), openBytesAt(), openBytesInto(),
+       * openBytesStack(), openBytesBatch() and openBytesDecimated()
+       * is scaled to the range [0, 1].  The same range is used for
+       * every region of a plane, so that tiles and whole planes
+       * read separately match: TIFF readers use the minimum and
+       * maximum recorded in the tile summaries of the plane (see
+       * tiff::IFD::getNormalizationRange()), and otherwise the range
+       * of the pixel type, [0, 1], is used.  NaN values are
+       * preserved and values outside the range are clamped to 0 or
+       * 1.  Integer pixel data is not changed.
+       *
        * @param normalize @c true to enable normalization, or @c false
        * to disable.
        */
@@ -674,6 +923,114 @@ namespace ome
       bool
       isNormalized() const = 0;
 
+      /**
+       * Set indexed color expansion.
+       *
+       * When enabled, indexed color images are expanded to RGB
+       * using their lookup tables while the pixel data are read, so
+       * that the pixel data returned by openBytes() are RGB, and the
+       * core metadata describe an RGB image with three @c UINT16
+       * subchannels which is not indexed.  This avoids a separate
+       * pass over the indexes using getLookupTable().  Formats
+       * without support for expansion will ignore this setting.
+       * Disabled by default.
+       *
+       * @param expand @c true to enable expansion, or @c false to
+       * disable.
+       */
+      virtual
+      void
+      setIndexedExpanded(bool expand) = 0;
+
+      /**
+       * Get indexed color expansion.
+       *
+       * @returns @c true if indexed color expansion is enabled,
+       * @c false otherwise.
+       */
+      virtual
+      bool
+      isIndexedExpanded() const = 0;
+
+      /**
+       * Set the number of threads to use for decoding pixel data.
+       *
+       * For formats storing pixel data in multiple independently
+       * compressed tiles or strips (e.g. TIFF), reading a plane or
+       * region spanning several tiles may decode them in parallel
+       * using this number of threads.  Formats without support for
+       * parallel decoding will ignore this setting.  The default is
+       * @c 1 (serial decoding).
+       *
+       * @param threads the number of threads; @c 0 is treated as
+       * @c 1.
+       */
+      virtual
+      void
+      setDecodeThreads(unsigned int threads) = 0;
+
+      /**
+       * Get the number of threads to use for decoding pixel data.
+       *
+       * @returns the number of threads.
+       */
+      virtual
+      unsigned int
+      getDecodeThreads() const = 0;
+
+      /**
+       * Set the executor for parallel reading.
+       *
+       * Parallel decoding (see setDecodeThreads()), prefetching
+       * (see setPrefetchPlanes()) and the reading of plane stacks
+       * and of planes from several files are run as tasks on this
+       * executor, so the threads used by all readers sharing an
+       * executor are bounded by it.  This only has an effect on
+       * reads started after it is set.
+       *
+       * @param executor the executor to use, or null to use the
+       * global executor (see Executor::global()).
+       */
+      virtual
+      void
+      setExecutor(const std::shared_ptr<Executor>& executor) = 0;
+
+      /**
+       * Get the executor for parallel reading.
+       *
+       * @returns the executor set with setExecutor(), or else the
+       * global executor.
+       */
+      virtual
+      std::shared_ptr<Executor>
+      getExecutor() const = 0;
+
+      /**
+       * Set the number of planes to prefetch.
+       *
+       * When reading planes in order with openBytes(), the
+       * following planes of the same series and resolution (using
+       * the same region) may be read ahead in the background, so
+       * that reading and decoding overlap with the processing of the
+       * current plane by the caller.  A subsequent openBytes() call
+       * for a prefetched plane returns the prefetched pixel data.
+       * The default is @c 0 (no prefetching).
+       *
+       * @param planes the number of planes to read ahead.
+       */
+      virtual
+      void
+      setPrefetchPlanes(dimension_size_type planes) = 0;
+
+      /**
+       * Get the number of planes to prefetch.
+       *
+       * @returns the number of planes.
+       */
+      virtual
+      dimension_size_type
+      getPrefetchPlanes() const = 0;
+
       /**
        * Specifies whether or not to save proprietary metadata
        * in the MetadataStore.
@@ -696,6 +1053,36 @@ namespace ome
       bool
       isOriginalMetadataPopulated() const = 0;
 
+      /**
+       * Specifies whether or not to read original metadata on
+       * demand.
+       *
+       * When enabled, the global and series original metadata, and
+       * the original metadata annotations saved in the
+       * MetadataStore, are not read when the file is opened.  They
+       * are read on the first call to getGlobalMetadata(),
+       * getSeriesMetadata(), getCoreMetadataList() or
+       * getMetadataStore(), and then cached until the reader is
+       * closed.  This keeps opening cheap when the original metadata
+       * is not needed.  Disabled by default.
+       *
+       * @param lazy @c true to read on demand or @c false to read on
+       * opening.
+       */
+      virtual
+      void
+      setOriginalMetadataLazy(bool lazy) = 0;
+
+      /**
+       * Check if original metadata is read on demand.
+       *
+       * @returns @c true if read on demand, @c false if read on
+       * opening.
+       */
+      virtual
+      bool
+      isOriginalMetadataLazy() const = 0;
+
       /**
        * Set file grouping.
        *
@@ -886,6 +1273,21 @@ namespace ome
       std::array<dimension_size_type, 6>
       getZCTModuloCoords(dimension_size_type index) const = 0;
 
+      /**
+       * Get a dimension indexer for the current series.
+       *
+       * The indexer performs the same conversions as getIndex(),
+       * getZCTCoords() and getZCTModuloCoords(), but validates the
+       * dimension order and sizes only once.  It is intended for
+       * iterating over many planes; it is not updated if the
+       * current series or resolution are changed.
+       *
+       * @returns the dimension indexer.
+       */
+      virtual
+      DimensionIndexer
+      getDimensionIndexer() const = 0;
+
       /**
        * Get a global metadata value.
        *
@@ -61,7 +61,9 @@ namespace ome
   namespace files
   {
 
+    class Executor;
     class VariantPixelBuffer;
+    class VariantPixelBufferView;
 
     /**
      * Interface for all biological file format writers.
@@ -85,6 +87,15 @@ namespace ome
       /// Frame rate type.
       typedef uint16_t frame_rate_type;
 
+      /**
+       * Range of plane coordinates.
+       *
+       * The range is half-open: the first element is the first
+       * coordinate included, and the second element is one past the
+       * last coordinate included.
+       */
+      typedef std::array<dimension_size_type, 2> plane_range;
+
     protected:
       /// Constructor.
       FormatWriter()
@@ -168,6 +179,180 @@ namespace ome
                 dimension_size_type w,
                 dimension_size_type h) = 0;
 
+      /**
+       * Save an image plane, taking ownership of the pixel buffer.
+       *
+       * This is equivalent to saving from a VariantPixelBuffer, but
+       * the caller gives up the buffer, which the writer may then
+       * encode from or adopt directly instead of copying it.  The
+       * buffer contents are unspecified after the call.
+       *
+       * @param plane the plane index within the series.
+       * @param buf the source pixel buffer.
+       * @throws FormatException if any of the parameters are invalid.
+       */
+      virtual
+      void
+      saveBytes(dimension_size_type  plane,
+                VariantPixelBuffer&& buf) = 0;
+
+      /**
+       * Save a region of an image plane, taking ownership of the
+       * pixel buffer.
+       *
+       * This is equivalent to saving from a VariantPixelBuffer, but
+       * the caller gives up the buffer, which the writer may then
+       * encode from or adopt directly instead of copying it.  The
+       * buffer contents are unspecified after the call.
+       *
+       * @param plane the plane index within the series.
+       * @param buf the source pixel buffer.
+       * @param x the @c X coordinate of the upper-left corner of the sub-image.
+       * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+       * @param w the width of the sub-image.
+       * @param h the height of the sub-image.
+       * @throws FormatException if any of the parameters are invalid.
+       */
+      virtual
+      void
+      saveBytes(dimension_size_type  plane,
+                VariantPixelBuffer&& buf,
+                dimension_size_type  x,
+                dimension_size_type  y,
+                dimension_size_type  w,
+                dimension_size_type  h) = 0;
+
+      /**
+       * Save an image plane from a pixel buffer view.
+       *
+       * This is equivalent to saving from a VariantPixelBuffer, but
+       * the view may refer to a crop or subchannel subset of a
+       * larger buffer, which will not be copied if the writer can
+       * consume the view directly.  The view must match the size of
+       * the region being written; its storage order does not matter.
+       *
+       * @param plane the plane index within the series.
+       * @param buf the source pixel buffer view.
+       * @param x the @c X coordinate of the upper-left corner of the sub-image.
+       * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+       * @param w the width of the sub-image.
+       * @param h the height of the sub-image.
+       * @throws FormatException if any of the parameters are invalid.
+       */
+      virtual
+      void
+      saveBytes(dimension_size_type            plane,
+                const VariantPixelBufferView& buf,
+                dimension_size_type            x,
+                dimension_size_type            y,
+                dimension_size_type            w,
+                dimension_size_type            h) = 0;
+
+      /**
+       * Save several image planes of a series.
+       *
+       * Write every plane within the @c Z, @c C and @c T ranges
+       * from a single VariantPixelBuffer of size
+       *
+       * \code{.cpp}
+       * getSizeX * getSizeY * zCount * cCount * tCount * bytesPerPixel * getRGBChannelCount()
+       * \endcode
+       *
+       * with each plane stored at its offset from the start of the
+       * ranges in the @c Z, @c C and @c T dimensions, as obtained
+       * by FormatReader::openBytesStack().  This is equivalent to
+       * calling saveBytes() with a view of each plane in plane
+       * index order, but writers may encode and write the planes
+       * of the stack together.  The series is made the active
+       * series.
+       *
+       * @param series the series index.
+       * @param zRange the @c Z coordinates to write (real size).
+       * @param cRange the @c C coordinates to write (effective size).
+       * @param tRange the @c T coordinates to write (real size).
+       * @param buf the source pixel buffer.
+       * @throws FormatException if any of the parameters are invalid.
+       * @throws std::logic_error if any range is empty or outside
+       * the image.
+       */
+      virtual
+      void
+      saveBytesStack(dimension_size_type series,
+                     const plane_range&  zRange,
+                     const plane_range&  cRange,
+                     const plane_range&  tRange,
+                     VariantPixelBuffer& buf) = 0;
+
+      /**
+       * Save a raw (already compressed) tile of an image plane.
+       *
+       * Write the raw data for the specified tile of an image plane
+       * to the current series in the current file, exactly as
+       * provided and without encoding.  This is intended for use
+       * with data obtained from FormatReader::openRawTile(); the
+       * writer must be configured with the same pixel type,
+       * interleaving, tile size and compression as the source.
+       * Raw and encoded writes must not be mixed within the same
+       * plane.
+       *
+       * @param plane the plane index within the series.
+       * @param tile the tile index within the plane.
+       * @param data the raw tile data.
+       * @param size the size of @c data in bytes.
+       * @throws std::runtime_error if the writer does not support
+       * raw tile access.
+       */
+      virtual
+      void
+      saveRawTile(dimension_size_type plane,
+                  dimension_size_type tile,
+                  const uint8_t       *data,
+                  dimension_size_type size) = 0;
+
+      /**
+       * Save a native-size tile of an image plane.
+       *
+       * Write the pixel data for the specified tile of an image
+       * plane to the current series in the current file.  Unlike
+       * saveBytes(), the tile is encoded and written directly,
+       * without caching or tracking partial tile coverage.  The
+       * buffer must have the native tile size of the writer (see
+       * getTileSizeX() and getTileSizeY()), including for edge
+       * tiles, which must be padded.
+       *
+       * @param plane the plane index within the series.
+       * @param tile the tile index within the plane.
+       * @param buf the pixel data to save.
+       * @throws std::runtime_error if the writer does not support
+       * native tile access.
+       */
+      virtual
+      void
+      saveTile(dimension_size_type       plane,
+               dimension_size_type       tile,
+               const VariantPixelBuffer& buf) = 0;
+
+      /**
+       * Map an image plane for writing in place.
+       *
+       * Set @c buf to refer directly to the storage of the
+       * specified plane of the current series in the current file,
+       * so that pixel data may be computed into the file without
+       * copying and without calling saveBytes().  The buffer has
+       * the pixel type, dimensions and storage order of the plane,
+       * and is only valid until close() is called; it must not be
+       * used afterward.
+       *
+       * @param plane the plane index within the series.
+       * @param buf the buffer to refer to the plane.
+       * @throws std::runtime_error if the writer can not map the
+       * plane.
+       */
+      virtual
+      void
+      mapBytes(dimension_size_type plane,
+               VariantPixelBuffer& buf) = 0;
+
       /**
        * Set the active series.
        *
@@ -392,6 +577,101 @@ namespace ome
       bool
       getWriteSequentially() const = 0;
 
+      /**
+       * Set the number of threads to use for encoding.
+       *
+       * Writers which compress pixel data in independent tiles
+       * (e.g. TIFF) may compress the tiles completed by each
+       * saveBytes() call in parallel using this number of threads.
+       * The default of @c 1 compresses all tiles serially; writers
+       * which do not support parallel encoding will ignore this
+       * setting.
+       *
+       * @param threads the number of threads; @c 0 is treated as
+       * @c 1.
+       */
+      virtual
+      void
+      setWriteThreads(unsigned int threads) = 0;
+
+      /**
+       * Get the number of threads to use for encoding.
+       *
+       * @returns the number of threads.
+       */
+      virtual
+      unsigned int
+      getWriteThreads() const = 0;
+
+      /**
+       * Set the executor for parallel writing.
+       *
+       * Parallel encoding (see setWriteThreads()) is run as tasks
+       * on this executor, so the threads used by all writers
+       * sharing an executor are bounded by it.  This only has an
+       * effect on writes started after it is set.
+       *
+       * @param executor the executor to use, or null to use the
+       * global executor (see Executor::global()).
+       */
+      virtual
+      void
+      setExecutor(const std::shared_ptr<Executor>& executor) = 0;
+
+      /**
+       * Get the executor for parallel writing.
+       *
+       * @returns the executor set with setExecutor(), or else the
+       * global executor.
+       */
+      virtual
+      std::shared_ptr<Executor>
+      getExecutor() const = 0;
+
+      /**
+       * Set the depth of the write-behind queue.
+       *
+       * With a depth of @c 0 (the default), saveBytes(), saveTile()
+       * and saveRawTile() encode and write the pixel data before
+       * returning.  With a positive depth, writers supporting
+       * asynchronous writing copy the pixel data into a pooled
+       * buffer and return at once, while a background thread
+       * encodes and writes it.  No more than @c depth writes are
+       * pending at once; further calls block until there is space
+       * in the queue.  An error in a pending write is reported by a
+       * later call, or by flush() or close().  close() always
+       * completes all pending writes.  Writers which do not support
+       * asynchronous writing ignore this setting.
+       *
+       * @param depth the maximum number of pending writes.
+       */
+      virtual
+      void
+      setWriteQueueDepth(dimension_size_type depth) = 0;
+
+      /**
+       * Get the depth of the write-behind queue.
+       *
+       * @returns the maximum number of pending writes, or @c 0 if
+       * writing synchronously.
+       */
+      virtual
+      dimension_size_type
+      getWriteQueueDepth() const = 0;
+
+      /**
+       * Complete all pending writes.
+       *
+       * This waits for the write-behind queue to be emptied; it has
+       * no effect when writing synchronously.
+       *
+       * @throws the exception thrown by the first failed pending
+       * write, if any.
+       */
+      virtual
+      void
+      flush() = 0;
+
       /**
        * Set the requested tile width.
        *
@@ -0,0 +1,222 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/DimensionIndexer.h>
+#include <ome/files/HaloRegion.h>
+#include <ome/files/VariantPixelBufferView.h>
+
+using ome::files::BorderMode;
+using ome::files::PixelBuffer;
+using ome::files::dimension_size_type;
+
+namespace
+{
+
+  // Map a coordinate outside the image to the coordinate inside the
+  // image whose value it takes.  Reflection has a period of twice
+  // the image size, so that halos wider than the image are filled.
+  int64_t
+  border_coord(int64_t    i,
+               int64_t    size,
+               BorderMode mode)
+  {
+    if (mode == ome::files::BORDER_REPLICATE)
+      return std::min(std::max(i, int64_t(0)), size - 1);
+
+    const int64_t period = size * 2;
+    int64_t m = i % period;
+    if (m < 0)
+      m += period;
+    return m < size ? m : period - 1 - m;
+  }
+
+  // Fill the pixels of the buffer outside the part read from the
+  // image.  The pixel taken by each border pixel is always inside
+  // the part read, so the order of filling is unimportant.
+  struct HaloFillVisitor
+  {
+    BorderMode mode;
+    // Position of the buffer origin in the image.
+    int64_t    originX;
+    int64_t    originY;
+    // Image size.
+    int64_t    sizeX;
+    int64_t    sizeY;
+
+    HaloFillVisitor(BorderMode mode,
+                    int64_t    originX,
+                    int64_t    originY,
+                    int64_t    sizeX,
+                    int64_t    sizeY):
+      mode(mode),
+      originX(originX),
+      originY(originY),
+      sizeX(sizeX),
+      sizeY(sizeY)
+    {}
+
+    template<typename T>
+    void
+    operator() (std::shared_ptr<PixelBuffer<T>>& v) const
+    {
+      PixelBuffer<T>& b(*v);
+      const int64_t width = static_cast<int64_t>(b.shape()[ome::files::DIM_SPATIAL_X]);
+      const int64_t height = static_cast<int64_t>(b.shape()[ome::files::DIM_SPATIAL_Y]);
+      const dimension_size_type samples = b.shape()[ome::files::DIM_SUBCHANNEL];
+
+      typedef typename PixelBuffer<T>::indices_type indices_type;
+      typedef typename indices_type::value_type index_type;
+
+      indices_type dest, src;
+      dest.fill(0);
+      src.fill(0);
+
+      for (int64_t y = 0; y < height; ++y)
+        {
+          const int64_t iy = originY + y;
+          const bool rowInside = iy >= 0 && iy < sizeY;
+          for (int64_t x = 0; x < width; ++x)
+            {
+              const int64_t ix = originX + x;
+              if (rowInside && ix >= 0 && ix < sizeX)
+                {
+                  // Skip to the right border of the row.
+                  x = std::max(x, sizeX - originX - 1);
+                  continue;
+                }
+
+              dest[ome::files::DIM_SPATIAL_X] = static_cast<index_type>(x);
+              dest[ome::files::DIM_SPATIAL_Y] = static_cast<index_type>(y);
+              src[ome::files::DIM_SPATIAL_X] = static_cast<index_type>(border_coord(ix, sizeX, mode) - originX);
+              src[ome::files::DIM_SPATIAL_Y] = static_cast<index_type>(border_coord(iy, sizeY, mode) - originY);
+
+              for (dimension_size_type s = 0; s < samples; ++s)
+                {
+                  dest[ome::files::DIM_SUBCHANNEL] = src[ome::files::DIM_SUBCHANNEL] =
+                    static_cast<index_type>(s);
+                  b.at(dest) = (mode == ome::files::BORDER_ZERO) ? T() : b.at(src);
+                }
+            }
+        }
+    }
+  };
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    void
+    openBytesHalo(const FormatReader& reader,
+                  dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  const PlaneRegion&  region,
+                  dimension_size_type halo,
+                  BorderMode          mode)
+    {
+      const CoreMetadata& core(*reader.getCoreMetadataList().at(reader.seriesToCoreIndex(series) + resolution));
+
+      if (plane >= core.imageCount)
+        {
+          boost::format fmt("Invalid plane: %1%");
+          fmt % plane;
+          throw std::logic_error(fmt.str());
+        }
+
+      if (region.w == 0 || region.h == 0 ||
+          region.x + region.w > core.sizeX ||
+          region.y + region.h > core.sizeY)
+        {
+          boost::format fmt("Region (%1%,%2% %3%x%4%) is not inside the image (%5%x%6%)");
+          fmt % region.x % region.y % region.w % region.h % core.sizeX % core.sizeY;
+          throw std::logic_error(fmt.str());
+        }
+
+      const DimensionIndexer indexer(core.dimensionOrder,
+                                     core.sizeZ,
+                                     core.sizeC.size(),
+                                     core.sizeT,
+                                     core.imageCount);
+
+      std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+      shape.fill(1U);
+      shape[DIM_SPATIAL_X] = region.w + halo * 2U;
+      shape[DIM_SPATIAL_Y] = region.h + halo * 2U;
+      shape[DIM_SUBCHANNEL] = core.sizeC.at(indexer.coords(plane)[1]);
+      buf.setBuffer(shape, core.pixelType, buf.storage_order(), buf.allocator());
+
+      // The part of the extended region inside the image, and its
+      // position in the buffer.
+      const dimension_size_type x0 = region.x > halo ? region.x - halo : 0U;
+      const dimension_size_type y0 = region.y > halo ? region.y - halo : 0U;
+      const dimension_size_type x1 = std::min(region.x + region.w + halo, core.sizeX);
+      const dimension_size_type y1 = std::min(region.y + region.h + halo, core.sizeY);
+      const PlaneRegion inside(x0, y0, x1 - x0, y1 - y0);
+
+      VariantPixelBufferView view(buf, PlaneRegion(x0 + halo - region.x,
+                                                   y0 + halo - region.y,
+                                                   inside.w, inside.h));
+      reader.openBytesInto(series, resolution, plane, view, inside);
+
+      if (halo > region.x || halo > region.y ||
+          region.x + region.w + halo > core.sizeX ||
+          region.y + region.h + halo > core.sizeY)
+        {
+          HaloFillVisitor v(mode,
+                            static_cast<int64_t>(region.x) - static_cast<int64_t>(halo),
+                            static_cast<int64_t>(region.y) - static_cast<int64_t>(halo),
+                            static_cast<int64_t>(core.sizeX),
+                            static_cast<int64_t>(core.sizeY));
+          ome::compat::visit(v, buf.vbuffer());
+        }
+    }
+
+  }
+}
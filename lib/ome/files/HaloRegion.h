@@ -0,0 +1,115 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_HALOREGION_H
+#define OME_FILES_HALOREGION_H
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Border fill for pixels of a halo outside the image.
+     */
+    enum BorderMode
+      {
+        BORDER_ZERO,      ///< Zero (000|abc…xyz|000)
+        BORDER_REPLICATE, ///< Repeat the edge pixel (aaa|abc…xyz|zzz)
+        BORDER_REFLECT    ///< Mirror, including the edge pixel (cba|abc…xyz|zyx)
+      };
+
+    /**
+     * Read a region of a plane surrounded by a halo.
+     *
+     * The destination buffer is resized to the region extended by
+     * @p halo pixels on every side, with the pixel type and
+     * subchannels of the plane.  The part of the extended region
+     * inside the image, including any halo which lies inside the
+     * image, is read directly into the buffer with
+     * FormatReader::openBytesInto(); the remainder of the halo is
+     * then filled according to @p mode.  Reflection is repeated if
+     * the halo is wider than the image.
+     *
+     * This is intended for filters processing an image in chunks,
+     * where each chunk needs its neighbourhood.  Neighbouring chunk
+     * reads overlap, so the same tiles are decoded repeatedly unless
+     * the reader keeps decoded tiles.  Set a tiff::DecodedTileCache
+     * on TIFF readers (see in::MinimalTIFFReader::setTileCache()) so
+     * that each tile is decoded once and shared between chunks.
+     *
+     * The storage order and allocator of @p buf are retained.
+     *
+     * @param reader the reader to use.
+     * @param series the series index.
+     * @param resolution the resolution index within the series.
+     * @param plane the plane index within the series.
+     * @param buf the destination pixel buffer.
+     * @param region the sub-image to read, excluding the halo.
+     * @param halo the width of the halo (pixels).
+     * @param mode the fill for the halo outside the image.
+     * @throws FormatException if there was a problem parsing the
+     * metadata of the file.
+     * @throws std::logic_error if the series, resolution or plane
+     * is invalid, or the region is empty or not inside the image.
+     */
+    void
+    openBytesHalo(const FormatReader& reader,
+                  dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  const PlaneRegion&  region,
+                  dimension_size_type halo,
+                  BorderMode          mode = BORDER_REFLECT);
+
+  }
+}
+
+#endif // OME_FILES_HALOREGION_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
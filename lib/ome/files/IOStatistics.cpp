@@ -0,0 +1,221 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <ome/files/IOStatistics.h>
+#include <ome/files/config-internal.h>
+
+namespace
+{
+
+  const std::array<std::string, ome::files::IOStatistics::counter_count> counter_names
+    {{
+        "bytes_read",
+        "bytes_written",
+        "tiles_decoded",
+        "tiles_encoded",
+        "tile_cache_hits",
+        "tile_cache_misses",
+        "files_opened",
+        "directories_read",
+        "metadata_parsed"
+      }};
+
+  const std::array<std::string, ome::files::IOStatistics::timer_count> timer_names
+    {{
+        "open",
+        "directory",
+        "decode",
+        "encode",
+        "copy",
+        "lock_wait",
+        "metadata_parse"
+      }};
+
+  const std::array<std::string, ome::files::IOStatistics::lock_site_count> lock_site_names
+    {{
+        "other",
+        "tag",
+        "directory",
+        "decode",
+        "encode"
+      }};
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    IOStatistics::IOStatistics():
+      counters(),
+      timers(),
+      lockWaits(),
+      lockHolds()
+    {
+      reset();
+    }
+
+    IOStatistics::~IOStatistics()
+    {
+    }
+
+    bool
+    IOStatistics::enabled()
+    {
+#ifdef OME_FILES_IO_STATISTICS
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    void
+    IOStatistics::record(Timer                    timer,
+                         std::chrono::nanoseconds duration)
+    {
+      record(timers[timer], duration);
+    }
+
+    void
+    IOStatistics::recordLock(LockSite                 site,
+                             std::chrono::nanoseconds wait,
+                             std::chrono::nanoseconds hold)
+    {
+      record(lockWaits[site], wait);
+      record(lockHolds[site], hold);
+    }
+
+    void
+    IOStatistics::record(AtomicHistogram&         histogram,
+                         std::chrono::nanoseconds duration)
+    {
+      const uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0U;
+
+      // Bucket by the position of the most significant bit.
+      std::size_t bucket = 0U;
+      for (uint64_t v = ns >> 1U; v && bucket < histogram_buckets - 1U; v >>= 1U)
+        ++bucket;
+
+      histogram.count.fetch_add(1U, std::memory_order_relaxed);
+      histogram.total.fetch_add(ns, std::memory_order_relaxed);
+      histogram.buckets[bucket].fetch_add(1U, std::memory_order_relaxed);
+    }
+
+    uint64_t
+    IOStatistics::getCounter(Counter counter) const
+    {
+      return counters[counter].load(std::memory_order_relaxed);
+    }
+
+    IOStatistics::Histogram
+    IOStatistics::getHistogram(Timer timer) const
+    {
+      return snapshot(timers[timer]);
+    }
+
+    IOStatistics::Histogram
+    IOStatistics::getLockWait(LockSite site) const
+    {
+      return snapshot(lockWaits[site]);
+    }
+
+    IOStatistics::Histogram
+    IOStatistics::getLockHold(LockSite site) const
+    {
+      return snapshot(lockHolds[site]);
+    }
+
+    IOStatistics::Histogram
+    IOStatistics::snapshot(const AtomicHistogram& histogram)
+    {
+      Histogram ret;
+      ret.count = histogram.count.load(std::memory_order_relaxed);
+      ret.total = histogram.total.load(std::memory_order_relaxed);
+      for (std::size_t i = 0U; i < histogram_buckets; ++i)
+        ret.buckets[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+      return ret;
+    }
+
+    void
+    IOStatistics::reset()
+    {
+      for (auto& counter : counters)
+        counter.store(0U, std::memory_order_relaxed);
+      auto clear = [](AtomicHistogram& histogram)
+        {
+          histogram.count.store(0U, std::memory_order_relaxed);
+          histogram.total.store(0U, std::memory_order_relaxed);
+          for (auto& bucket : histogram.buckets)
+            bucket.store(0U, std::memory_order_relaxed);
+        };
+
+      for (auto& histogram : timers)
+        clear(histogram);
+      for (auto& histogram : lockWaits)
+        clear(histogram);
+      for (auto& histogram : lockHolds)
+        clear(histogram);
+    }
+
+    const std::string&
+    IOStatistics::name(Counter counter)
+    {
+      return counter_names[counter];
+    }
+
+    const std::string&
+    IOStatistics::name(Timer timer)
+    {
+      return timer_names[timer];
+    }
+
+    const std::string&
+    IOStatistics::name(LockSite site)
+    {
+      return lock_site_names[site];
+    }
+
+  }
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,370 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_IOSTATISTICS_H
+#define OME_FILES_IOSTATISTICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * I/O and timing statistics.
+     *
+     * Counters and timing histograms recording where the time is
+     * spent reading and writing pixel data and metadata.  Each
+     * reader and writer holds an instance, obtained with
+     * FormatHandler::getIOStatistics(), which is shared with the
+     * TIFF files it opens.
+     *
+     * All updates use relaxed atomic operations, so a single
+     * instance may be updated concurrently by separate threads, and
+     * read while being updated; the values read are not a consistent
+     * snapshot of all counters.  Counting costs an atomic increment,
+     * and timing costs two clock reads and three atomic increments,
+     * which is small compared with the I/O being measured.
+     *
+     * The library is only instrumented if built with the
+     * @c io-statistics option (the default); otherwise, the
+     * instrumentation is compiled out, and all values remain zero.
+     * Use enabled() to check.
+     */
+    class IOStatistics
+    {
+    public:
+      /// Event counters.
+      enum Counter
+        {
+          BYTES_READ,        ///< Bytes of pixel data read (decoded size, or stored size for raw tiles).
+          BYTES_WRITTEN,     ///< Bytes of pixel data written (decoded size, or stored size for raw tiles).
+          TILES_DECODED,     ///< Tiles and strips decoded.
+          TILES_ENCODED,     ///< Tiles and strips encoded.
+          TILE_CACHE_HITS,   ///< Decoded tiles found in the tile cache.
+          TILE_CACHE_MISSES, ///< Decoded tiles not found in the tile cache.
+          FILES_OPENED,      ///< TIFF files opened.
+          DIRECTORIES_READ,  ///< TIFF directories (IFDs) read.
+          METADATA_PARSED    ///< OME-XML documents parsed.
+        };
+
+      /// Number of event counters.
+      static const std::size_t counter_count = METADATA_PARSED + 1U;
+
+      /// Timed operations.
+      enum Timer
+        {
+          OPEN,           ///< Opening TIFF files.
+          DIRECTORY,      ///< Reading TIFF directories (IFDs).
+          DECODE,         ///< Reading and decoding tiles and strips in libtiff.
+          ENCODE,         ///< Encoding and writing tiles and strips in libtiff.
+          COPY,           ///< Copying decoded pixel data to the destination buffer.
+          LOCK_WAIT,      ///< Waiting for a TIFF file lock held by another thread.
+          METADATA_PARSE  ///< Parsing OME-XML metadata.
+        };
+
+      /// Number of timed operations.
+      static const std::size_t timer_count = METADATA_PARSE + 1U;
+
+      /// Call sites holding the TIFF file lock, by category.
+      enum LockSite
+        {
+          LOCK_OTHER,     ///< Uncategorised use.
+          LOCK_TAG,       ///< Reading and writing tags.
+          LOCK_DIRECTORY, ///< Switching, reading and writing directories.
+          LOCK_DECODE,    ///< Reading and decoding tiles and strips.
+          LOCK_ENCODE     ///< Encoding and writing tiles and strips.
+        };
+
+      /// Number of lock call sites.
+      static const std::size_t lock_site_count = LOCK_ENCODE + 1U;
+
+      /**
+       * Number of histogram buckets.
+       *
+       * Bucket @c i counts durations of at least 2<sup>i</sup>
+       * and less than 2<sup>i+1</sup> nanoseconds; bucket @c 0
+       * also counts zero durations, and the last bucket also counts
+       * all longer durations.
+       */
+      static const std::size_t histogram_buckets = 40U;
+
+      /// Duration histogram of a timed operation.
+      struct Histogram
+      {
+        /// Number of operations.
+        uint64_t count;
+        /// Total duration (nanoseconds).
+        uint64_t total;
+        /// Number of operations in each bucket.
+        std::array<uint64_t, histogram_buckets> buckets;
+      };
+
+      /**
+       * Timer for a scope.
+       *
+       * The time from construction to destruction is recorded.  If
+       * constructed with a null statistics pointer, nothing is
+       * recorded and the clock is not read.
+       */
+      class ScopedTimer
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param stats the statistics to record in, or null.
+         * @param timer the operation being timed.
+         */
+        ScopedTimer(IOStatistics *stats,
+                    Timer         timer):
+          stats(stats),
+          timer(timer),
+          start(stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+        {}
+
+        /// Destructor.
+        ~ScopedTimer()
+        {
+          if (stats)
+            stats->record(timer, std::chrono::steady_clock::now() - start);
+        }
+
+        /// @cond SKIP
+        ScopedTimer (const ScopedTimer&) = delete;
+
+        ScopedTimer&
+        operator= (const ScopedTimer&) = delete;
+        /// @endcond SKIP
+
+      private:
+        /// Statistics to record in.
+        IOStatistics *stats;
+        /// Operation being timed.
+        Timer timer;
+        /// Start time.
+        std::chrono::steady_clock::time_point start;
+      };
+
+      /// Constructor.
+      IOStatistics();
+
+      /// @cond SKIP
+      IOStatistics (const IOStatistics&) = delete;
+
+      IOStatistics&
+      operator= (const IOStatistics&) = delete;
+      /// @endcond SKIP
+
+      /// Destructor.
+      ~IOStatistics();
+
+      /**
+       * Check if the library was built with instrumentation.
+       *
+       * @returns @c true if built with the @c io-statistics option,
+       * or @c false if the instrumentation was compiled out.
+       */
+      static bool
+      enabled();
+
+      /**
+       * Add to a counter.
+       *
+       * @param counter the counter to add to.
+       * @param value the value to add.
+       */
+      void
+      add(Counter  counter,
+          uint64_t value = 1U)
+      {
+        counters[counter].fetch_add(value, std::memory_order_relaxed);
+      }
+
+      /**
+       * Record the duration of an operation.
+       *
+       * @param timer the operation.
+       * @param duration the duration of the operation.
+       */
+      void
+      record(Timer                    timer,
+             std::chrono::nanoseconds duration);
+
+      /**
+       * Get the value of a counter.
+       *
+       * @param counter the counter to get.
+       * @returns the value.
+       */
+      uint64_t
+      getCounter(Counter counter) const;
+
+      /**
+       * Get the duration histogram of an operation.
+       *
+       * @param timer the operation.
+       * @returns the histogram.
+       */
+      Histogram
+      getHistogram(Timer timer) const;
+
+      /**
+       * Record a use of the TIFF file lock.
+       *
+       * Nested (recursive) locking within a thread is recorded only
+       * for the outermost lock.
+       *
+       * @param site the call site category.
+       * @param wait the time spent waiting to acquire the lock.
+       * @param hold the time the lock was held.
+       */
+      void
+      recordLock(LockSite                 site,
+                 std::chrono::nanoseconds wait,
+                 std::chrono::nanoseconds hold);
+
+      /**
+       * Get the lock acquisition wait histogram of a call site.
+       *
+       * Every acquisition is counted, including those which did not
+       * need to wait.
+       *
+       * @param site the call site category.
+       * @returns the histogram.
+       */
+      Histogram
+      getLockWait(LockSite site) const;
+
+      /**
+       * Get the lock hold time histogram of a call site.
+       *
+       * @param site the call site category.
+       * @returns the histogram.
+       */
+      Histogram
+      getLockHold(LockSite site) const;
+
+      /// Reset all counters and histograms to zero.
+      void
+      reset();
+
+      /**
+       * Get the name of a counter.
+       *
+       * @param counter the counter.
+       * @returns the name, for example @c "bytes_read".
+       */
+      static const std::string&
+      name(Counter counter);
+
+      /**
+       * Get the name of a timed operation.
+       *
+       * @param timer the operation.
+       * @returns the name, for example @c "decode".
+       */
+      static const std::string&
+      name(Timer timer);
+
+      /**
+       * Get the name of a lock call site.
+       *
+       * @param site the call site category.
+       * @returns the name, for example @c "tag".
+       */
+      static const std::string&
+      name(LockSite site);
+
+    private:
+      /// Histogram of atomic counters.
+      struct AtomicHistogram
+      {
+        /// Number of operations.
+        std::atomic<uint64_t> count;
+        /// Total duration (nanoseconds).
+        std::atomic<uint64_t> total;
+        /// Number of operations in each bucket.
+        std::array<std::atomic<uint64_t>, histogram_buckets> buckets;
+      };
+
+      /**
+       * Add a duration to a histogram.
+       *
+       * @param histogram the histogram to update.
+       * @param duration the duration to add.
+       */
+      static void
+      record(AtomicHistogram&         histogram,
+             std::chrono::nanoseconds duration);
+
+      /**
+       * Get a snapshot of a histogram.
+       *
+       * @param histogram the histogram to copy.
+       * @returns the copy.
+       */
+      static Histogram
+      snapshot(const AtomicHistogram& histogram);
+
+      /// Event counters.
+      std::array<std::atomic<uint64_t>, counter_count> counters;
+      /// Timing histograms.
+      std::array<AtomicHistogram, timer_count> timers;
+      /// Lock wait histograms.
+      std::array<AtomicHistogram, lock_site_count> lockWaits;
+      /// Lock hold histograms.
+      std::array<AtomicHistogram, lock_site_count> lockHolds;
+    };
+
+  }
+}
+
+#endif // OME_FILES_IOSTATISTICS_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,305 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <stdexcept>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#include <ome/common/filesystem.h>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/Memoizer.h>
+#include <ome/files/detail/FormatReader.h>
+#include <ome/files/detail/Memo.h>
+
+using boost::filesystem::path;
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      /// Memo file magic.
+      const char magic[8] = { 'O', 'M', 'E', 'M', 'E', 'M', 'O', '1' };
+
+      /// Byte order mark (the memo is stored in native byte order).
+      const uint64_t byteorder = 0x0102030405060708ULL;
+
+      /**
+       * Get the size and modification time of a file.
+       *
+       * @param filename the file to check.
+       * @param filesize the file size to set.
+       * @param mtime the modification time to set.
+       * @returns @c true on success, @c false on failure.
+       */
+      bool
+      fileStamp(const path& filename,
+                uint64_t&   filesize,
+                int64_t&    mtime)
+      {
+        boost::system::error_code ec;
+        boost::uintmax_t size = boost::filesystem::file_size(filename, ec);
+        if (ec)
+          return false;
+        std::time_t time = boost::filesystem::last_write_time(filename, ec);
+        if (ec)
+          return false;
+
+        filesize = static_cast<uint64_t>(size);
+        mtime = static_cast<int64_t>(time);
+        return true;
+      }
+
+    }
+
+    const uint64_t Memoizer::memo_version;
+
+    Memoizer::Memoizer(const std::shared_ptr<FormatReader>& reader,
+                       const boost::filesystem::path&       directory):
+      ReaderWrapper(reader),
+      directory(directory),
+      loaded(false),
+      saved(false)
+    {
+    }
+
+    Memoizer::~Memoizer()
+    {
+    }
+
+    const boost::filesystem::path&
+    Memoizer::getCacheDirectory() const
+    {
+      return directory;
+    }
+
+    boost::filesystem::path
+    Memoizer::getMemoFile(const boost::filesystem::path& id) const
+    {
+      boost::format fmt("%016x.memo");
+      fmt % static_cast<uint64_t>(std::hash<std::string>()(id.string()));
+      return directory / fmt.str();
+    }
+
+    bool
+    Memoizer::isLoadedFromMemo() const
+    {
+      return loaded;
+    }
+
+    bool
+    Memoizer::isSavedToMemo() const
+    {
+      return saved;
+    }
+
+    void
+    Memoizer::setId(const boost::filesystem::path& id)
+    {
+      path canonicalpath = id;
+      try
+        {
+          canonicalpath = ome::common::canonical(id);
+        }
+      catch (const std::exception&)
+        {
+        }
+
+      const boost::optional<path>& current(reader->getCurrentFile());
+      if (current && *current == canonicalpath)
+        return;
+
+      loaded = saved = false;
+
+      const detail::FormatReader *memoizable = dynamic_cast<const detail::FormatReader *>(reader.get());
+      if (memoizable && loadMemo(canonicalpath))
+        {
+          loaded = true;
+          return;
+        }
+
+      ReaderWrapper::setId(id);
+
+      if (memoizable && memoizable->isMemoizable())
+        {
+          try
+            {
+              saveMemo(canonicalpath);
+              saved = true;
+            }
+          catch (const std::exception&)
+            {
+              // The memo is optional; the cache directory may not be
+              // writable.
+            }
+        }
+    }
+
+    void
+    Memoizer::close(bool fileOnly)
+    {
+      if (!fileOnly)
+        loaded = saved = false;
+      ReaderWrapper::close(fileOnly);
+    }
+
+    bool
+    Memoizer::loadMemo(const boost::filesystem::path& id)
+    {
+      detail::FormatReader& memoizable(dynamic_cast<detail::FormatReader&>(*reader));
+
+      boost::filesystem::ifstream in(getMemoFile(id),
+                                     std::ios::in | std::ios::binary);
+      if (!in)
+        return false;
+
+      try
+        {
+          detail::MemoReader memo(in);
+
+          char filemagic[sizeof(magic)];
+          memo.readBytes(filemagic, sizeof(filemagic));
+          if (std::memcmp(filemagic, magic, sizeof(magic)) != 0 ||
+              memo.readUInt() != byteorder ||
+              memo.readUInt() != memo_version ||
+              memo.readString() != id.string())
+            return false;
+
+          // Every used file must be unchanged.
+          const uint64_t count = memo.readCount(sizeof(uint64_t) * 3U);
+          for (uint64_t i = 0; i < count; ++i)
+            {
+              const path file(memo.readString());
+              const uint64_t filesize = memo.readUInt();
+              const int64_t mtime = memo.readInt();
+
+              uint64_t currentsize;
+              int64_t currentmtime;
+              if (!fileStamp(file, currentsize, currentmtime) ||
+                  currentsize != filesize ||
+                  currentmtime != mtime)
+                return false;
+            }
+
+          return memoizable.restoreMemo(memo);
+        }
+      catch (const std::exception&)
+        {
+          // Invalid or truncated memo; initialize normally.
+          return false;
+        }
+    }
+
+    void
+    Memoizer::saveMemo(const boost::filesystem::path& id)
+    {
+      const detail::FormatReader& memoizable(dynamic_cast<const detail::FormatReader&>(*reader));
+
+      boost::system::error_code ec;
+      boost::filesystem::create_directories(directory, ec);
+
+      const path memofile(getMemoFile(id));
+      path tmp(memofile);
+      tmp += boost::filesystem::unique_path(".%%%%-%%%%-%%%%.tmp");
+
+      try
+        {
+          boost::filesystem::ofstream out(tmp,
+                                          std::ios::out | std::ios::binary | std::ios::trunc);
+          if (!out)
+            throw FormatException("Failed to open memo");
+
+          detail::MemoWriter memo(out);
+          memo.writeBytes(magic, sizeof(magic));
+          memo.writeUInt(byteorder);
+          memo.writeUInt(memo_version);
+          memo.writeString(id.string());
+
+          const std::vector<path> files(reader->getUsedFiles());
+          memo.writeUInt(files.size());
+          for (const auto& file : files)
+            {
+              uint64_t filesize;
+              int64_t mtime;
+              if (!fileStamp(file, filesize, mtime))
+                {
+                  boost::format fmt("Failed to get size and modification time of ‘%1%’");
+                  fmt % file.string();
+                  throw FormatException(fmt.str());
+                }
+              memo.writeString(file.string());
+              memo.writeUInt(filesize);
+              memo.writeInt(mtime);
+            }
+
+          memoizable.saveMemo(memo);
+
+          out.close();
+          if (!out)
+            throw FormatException("Failed to write memo");
+        }
+      catch (...)
+        {
+          boost::filesystem::remove(tmp, ec);
+          throw;
+        }
+
+      // Renamed into place, so that concurrent readers never see a
+      // partial memo.
+      boost::filesystem::rename(tmp, memofile, ec);
+      if (ec)
+        {
+          boost::filesystem::remove(tmp, ec);
+          boost::format fmt("Failed to write memo ‘%1%’");
+          fmt % memofile.string();
+          throw FormatException(fmt.str());
+        }
+    }
+
+  }
+}
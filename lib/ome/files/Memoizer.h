@@ -0,0 +1,178 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_MEMOIZER_H
+#define OME_FILES_MEMOIZER_H
+
+#include <cstdint>
+#include <memory>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/ReaderWrapper.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Reader saving its initialized state for fast re-opening.
+     *
+     * After the wrapped reader is initialized by setId(), its state
+     * (core metadata, original metadata, MetadataStore and any
+     * reader-specific state such as the plane to file and IFD
+     * mapping and the TIFF directory offsets) is saved as a memo
+     * file in a cache directory.  When the same file is opened
+     * again, the state is restored from the memo without reading
+     * the file, provided that the size and modification time of
+     * every used file are unchanged, and that the reader settings
+     * are the same.  Otherwise, the file is initialized normally
+     * and the memo is replaced.
+     *
+     * Memos are an optimization only: failure to read or write a
+     * memo is not an error.  Only readers derived from
+     * detail::FormatReader which are memoizable (see
+     * detail::FormatReader::isMemoizable()) are memoized, so the
+     * Memoizer should wrap the format reader directly; other
+     * readers are initialized normally.
+     */
+    class Memoizer : public ReaderWrapper
+    {
+    public:
+      /// Memo format version.
+      static const uint64_t memo_version = 3U;
+
+      /**
+       * Constructor.
+       *
+       * @param reader the reader to wrap.
+       * @param directory the directory in which to save memos;
+       * created if it does not exist.
+       * @throws std::logic_error if the reader is null.
+       */
+      Memoizer(const std::shared_ptr<FormatReader>& reader,
+               const boost::filesystem::path&       directory);
+
+      /// Destructor.
+      virtual
+      ~Memoizer();
+
+      /**
+       * Get the memo cache directory.
+       *
+       * @returns the directory.
+       */
+      const boost::filesystem::path&
+      getCacheDirectory() const;
+
+      /**
+       * Get the memo file for a file.
+       *
+       * @param id the canonical filename.
+       * @returns the memo filename.
+       */
+      boost::filesystem::path
+      getMemoFile(const boost::filesystem::path& id) const;
+
+      /**
+       * Check if the current file was restored from a memo.
+       *
+       * @returns @c true if restored by the last setId(), @c false
+       * if initialized normally.
+       */
+      bool
+      isLoadedFromMemo() const;
+
+      /**
+       * Check if a memo was saved for the current file.
+       *
+       * @returns @c true if saved by the last setId(), @c false
+       * otherwise.
+       */
+      bool
+      isSavedToMemo() const;
+
+      // Documented in superclass.
+      void
+      setId(const boost::filesystem::path& id);
+
+      // Documented in superclass.
+      void
+      close(bool fileOnly = false);
+
+    private:
+      /**
+       * Restore the reader state from a memo.
+       *
+       * @param id the canonical filename.
+       * @returns @c true if restored, @c false if the memo is
+       * missing, out of date or unusable.
+       */
+      bool
+      loadMemo(const boost::filesystem::path& id);
+
+      /**
+       * Save the reader state in a memo.
+       *
+       * @param id the canonical filename.
+       * @throws FormatException if the memo could not be written.
+       */
+      void
+      saveMemo(const boost::filesystem::path& id);
+
+      /// Memo cache directory.
+      boost::filesystem::path directory;
+
+      /// Current file restored from a memo.
+      bool loaded;
+
+      /// Memo saved for the current file.
+      bool saved;
+    };
+
+  }
+}
+
+#endif // OME_FILES_MEMOIZER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,346 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include <ome/files/MemoryBudget.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    const std::size_t MemoryBudget::component_count;
+
+    MemoryBudget::Reservation::Reservation():
+      budget(nullptr),
+      component(PREFETCH),
+      bytes(0U)
+    {
+    }
+
+    MemoryBudget::Reservation::Reservation(MemoryBudget        *budget,
+                                           Component            component,
+                                           dimension_size_type  bytes):
+      budget(budget),
+      component(component),
+      bytes(bytes)
+    {
+    }
+
+    MemoryBudget::Reservation::Reservation(Reservation&& rhs):
+      budget(rhs.budget),
+      component(rhs.component),
+      bytes(rhs.bytes)
+    {
+      rhs.budget = nullptr;
+      rhs.bytes = 0U;
+    }
+
+    MemoryBudget::Reservation&
+    MemoryBudget::Reservation::operator= (Reservation&& rhs)
+    {
+      if (this != &rhs)
+        {
+          release();
+          budget = rhs.budget;
+          component = rhs.component;
+          bytes = rhs.bytes;
+          rhs.budget = nullptr;
+          rhs.bytes = 0U;
+        }
+      return *this;
+    }
+
+    MemoryBudget::Reservation::~Reservation()
+    {
+      release();
+    }
+
+    bool
+    MemoryBudget::Reservation::valid() const
+    {
+      return budget != nullptr;
+    }
+
+    dimension_size_type
+    MemoryBudget::Reservation::size() const
+    {
+      return bytes;
+    }
+
+    void
+    MemoryBudget::Reservation::release()
+    {
+      if (!budget)
+        return;
+
+      {
+        std::lock_guard<std::mutex> lock(budget->mutex);
+        budget->reserved[component] -= bytes;
+        budget->remove(component, bytes);
+      }
+      budget->released.notify_all();
+      budget = nullptr;
+      bytes = 0U;
+    }
+
+    MemoryBudget::MemoryBudget(dimension_size_type limit):
+      limit(limit),
+      total(0U),
+      usage(),
+      peak(),
+      mutex(),
+      released(),
+      reserved(),
+      reclaimers(),
+      nextid(0U),
+      reclaimMutex()
+    {
+      for (auto& u : usage)
+        u = 0U;
+      for (auto& p : peak)
+        p = 0U;
+      reserved.fill(0U);
+    }
+
+    MemoryBudget::~MemoryBudget()
+    {
+    }
+
+    MemoryBudget&
+    MemoryBudget::global()
+    {
+      // Never destroyed, since caches and pools with static storage
+      // duration may release memory after it would be.
+      static MemoryBudget *budget = new MemoryBudget();
+      return *budget;
+    }
+
+    void
+    MemoryBudget::setLimit(dimension_size_type limit)
+    {
+      this->limit = limit;
+      reclaim();
+      // Waiting reservations may now fit.
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+      }
+      released.notify_all();
+    }
+
+    dimension_size_type
+    MemoryBudget::getLimit() const
+    {
+      return limit;
+    }
+
+    void
+    MemoryBudget::add(Component           component,
+                      dimension_size_type bytes)
+    {
+      total.fetch_add(bytes, std::memory_order_relaxed);
+      const dimension_size_type current = usage[component].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+      dimension_size_type previous = peak[component].load(std::memory_order_relaxed);
+      while (current > previous &&
+             !peak[component].compare_exchange_weak(previous, current, std::memory_order_relaxed));
+    }
+
+    void
+    MemoryBudget::remove(Component           component,
+                         dimension_size_type bytes)
+    {
+      total.fetch_sub(bytes, std::memory_order_relaxed);
+      usage[component].fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    bool
+    MemoryBudget::exceeded() const
+    {
+      const dimension_size_type lim = limit.load(std::memory_order_relaxed);
+      return lim && total.load(std::memory_order_relaxed) > lim;
+    }
+
+    bool
+    MemoryBudget::fits(dimension_size_type bytes) const
+    {
+      const dimension_size_type lim = limit.load(std::memory_order_relaxed);
+      return !lim || total.load(std::memory_order_relaxed) + bytes <= lim;
+    }
+
+    void
+    MemoryBudget::reclaim()
+    {
+      if (!exceeded())
+        return;
+
+      std::unique_lock<std::mutex> reclaiming(reclaimMutex, std::try_to_lock);
+      if (!reclaiming.owns_lock())
+        return;
+
+      std::vector<Reclaimer> current;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = reclaimers;
+      }
+
+      // Removal of a reclaimer waits for reclaimMutex, so each
+      // remains valid while it is called.
+      for (const auto& r : current)
+        {
+          const dimension_size_type lim = limit.load(std::memory_order_relaxed);
+          const dimension_size_type used = total.load(std::memory_order_relaxed);
+          if (!lim || used <= lim)
+            break;
+          r.reclaim(used - lim);
+        }
+    }
+
+    MemoryBudget::Reservation
+    MemoryBudget::reserve(Component           component,
+                          dimension_size_type bytes)
+    {
+      if (!bytes)
+        return Reservation();
+
+      if (!fits(bytes))
+        reclaim();
+
+      std::unique_lock<std::mutex> lock(mutex);
+      // Only reservations of the same component are waited for;
+      // others may be held by the caller.
+      released.wait(lock,
+                    [this, component, bytes]()
+                    {
+                      const dimension_size_type lim = limit.load(std::memory_order_relaxed);
+                      return !lim || !reserved[component] ||
+                        total.load(std::memory_order_relaxed) + bytes <= lim;
+                    });
+      reserved[component] += bytes;
+      add(component, bytes);
+      return Reservation(this, component, bytes);
+    }
+
+    MemoryBudget::Reservation
+    MemoryBudget::tryReserve(Component           component,
+                             dimension_size_type bytes)
+    {
+      if (!bytes)
+        return Reservation();
+
+      if (!fits(bytes))
+        {
+          reclaim();
+          if (!fits(bytes))
+            return Reservation();
+        }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      reserved[component] += bytes;
+      add(component, bytes);
+      return Reservation(this, component, bytes);
+    }
+
+    MemoryBudget::reclaimer_id
+    MemoryBudget::addReclaimer(Component        component,
+                               reclaim_function reclaimer)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      const reclaimer_id id = nextid++;
+      Reclaimer r{id, component, std::move(reclaimer)};
+      auto pos = std::upper_bound(reclaimers.begin(), reclaimers.end(), r,
+                                  [](const Reclaimer& lhs, const Reclaimer& rhs)
+                                  { return lhs.component < rhs.component; });
+      reclaimers.insert(pos, std::move(r));
+      return id;
+    }
+
+    void
+    MemoryBudget::removeReclaimer(reclaimer_id id)
+    {
+      std::lock_guard<std::mutex> reclaiming(reclaimMutex);
+      std::lock_guard<std::mutex> lock(mutex);
+
+      reclaimers.erase(std::remove_if(reclaimers.begin(), reclaimers.end(),
+                                      [id](const Reclaimer& r) { return r.id == id; }),
+                       reclaimers.end());
+    }
+
+    dimension_size_type
+    MemoryBudget::getUsage(Component component) const
+    {
+      return usage[component].load(std::memory_order_relaxed);
+    }
+
+    dimension_size_type
+    MemoryBudget::getUsage() const
+    {
+      return total.load(std::memory_order_relaxed);
+    }
+
+    dimension_size_type
+    MemoryBudget::getPeakUsage(Component component) const
+    {
+      return peak[component].load(std::memory_order_relaxed);
+    }
+
+    void
+    MemoryBudget::resetPeakUsage()
+    {
+      for (std::size_t i = 0; i < component_count; ++i)
+        peak[i] = usage[i].load(std::memory_order_relaxed);
+    }
+
+    const std::string&
+    MemoryBudget::name(Component component)
+    {
+      static const std::array<std::string, component_count> names
+        {{
+            "tile_buffer_pool",
+            "decoded_tile_cache",
+            "write_tile_cache",
+            "prefetch",
+            "write_queue"
+          }};
+      return names.at(component);
+    }
+
+  }
+}
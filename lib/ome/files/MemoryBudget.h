@@ -0,0 +1,430 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_MEMORYBUDGET_H
+#define OME_FILES_MEMORYBUDGET_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Process-wide memory budget for caches and in-flight buffers.
+     *
+     * The tile caches, tile buffer pools, prefetched planes and
+     * asynchronous write queues of all readers and writers record
+     * the memory they hold with the global budget, by component, so
+     * that the total may be limited and reported in one place.
+     * Each cache and pool retains its own limit; the budget limits
+     * their total.
+     *
+     * When the total exceeds the limit:
+     *
+     * - caches are asked to evict with reclaim(), in order of
+     *   component (idle tile buffers first, then decoded tiles);
+     * - pools retain no idle buffers which would exceed it;
+     * - prefetching stops, since tryReserve() fails;
+     * - asynchronous writes block in reserve() until earlier writes
+     *   have completed and released their reservations.
+     *
+     * Memory which can not be reclaimed, such as partially written
+     * tiles, is counted but never refused, and a reservation is
+     * granted if no other reservation for the same component is
+     * outstanding, so the budget can not deadlock.  The limit is therefore a target, which may
+     * be exceeded by the memory in use by a single operation.
+     *
+     * The default limit is zero (unlimited); usage is recorded
+     * whether or not a limit is set.  All methods are thread-safe.
+     */
+    class MemoryBudget
+    {
+    public:
+      /// Memory holders, in order of reclaiming.
+      enum Component
+        {
+          TILE_BUFFER_POOL,   ///< Idle buffers retained by TileBufferPool.
+          DECODED_TILE_CACHE, ///< Decoded tiles held by tiff::DecodedTileCache.
+          WRITE_TILE_CACHE,   ///< Partially written tiles held by TileCache.
+          PREFETCH,           ///< Planes prefetched by readers.
+          WRITE_QUEUE         ///< Pixel data copied for asynchronous writing.
+        };
+
+      /// Number of components.
+      static const std::size_t component_count = WRITE_QUEUE + 1U;
+
+      /**
+       * Function to reclaim memory.
+       *
+       * Called with the number of bytes to free; returns the number
+       * of bytes freed.  It must not call reclaim() or reserve().
+       */
+      typedef std::function<dimension_size_type (dimension_size_type)> reclaim_function;
+
+      /// Reclaimer registration identifier.
+      typedef uint64_t reclaimer_id;
+
+      /**
+       * Reservation of memory.
+       *
+       * The reserved memory is released on destruction, or by
+       * release().  A default-constructed reservation is empty.
+       */
+      class Reservation
+      {
+      public:
+        /// Construct an empty reservation.
+        Reservation();
+
+        /**
+         * Move constructor.
+         *
+         * @param rhs the reservation to take; empty on return.
+         */
+        Reservation(Reservation&& rhs);
+
+        /**
+         * Move assignment.
+         *
+         * @param rhs the reservation to take; empty on return.
+         * @returns the reservation.
+         */
+        Reservation&
+        operator= (Reservation&& rhs);
+
+        /// Destructor.
+        ~Reservation();
+
+        /// @cond SKIP
+        Reservation (const Reservation&) = delete;
+
+        Reservation&
+        operator= (const Reservation&) = delete;
+        /// @endcond SKIP
+
+        /**
+         * Check if memory is reserved.
+         *
+         * @returns @c true if not empty, @c false otherwise.
+         */
+        bool
+        valid() const;
+
+        /**
+         * Get the reserved size.
+         *
+         * @returns the size (bytes).
+         */
+        dimension_size_type
+        size() const;
+
+        /// Release the reserved memory.
+        void
+        release();
+
+      private:
+        friend class MemoryBudget;
+
+        /**
+         * Constructor.
+         *
+         * @param budget the budget reserved from.
+         * @param component the component reserved for.
+         * @param bytes the size reserved.
+         */
+        Reservation(MemoryBudget *budget,
+                    Component     component,
+                    dimension_size_type bytes);
+
+        /// The budget reserved from.
+        MemoryBudget *budget;
+        /// The component reserved for.
+        Component component;
+        /// The size reserved.
+        dimension_size_type bytes;
+      };
+
+      /**
+       * Constructor.
+       *
+       * @param limit the limit (bytes), or @c 0 for no limit.
+       */
+      explicit
+      MemoryBudget(dimension_size_type limit = 0U);
+
+      /// Destructor.
+      ~MemoryBudget();
+
+      /// @cond SKIP
+      MemoryBudget (const MemoryBudget&) = delete;
+
+      MemoryBudget&
+      operator= (const MemoryBudget&) = delete;
+      /// @endcond SKIP
+
+      /**
+       * Get the global budget.
+       *
+       * This is used by all the caches and queues of the library.
+       * It is never destroyed, so remains usable by caches destroyed
+       * during static destruction.
+       *
+       * @returns the global budget.
+       */
+      static
+      MemoryBudget&
+      global();
+
+      /**
+       * Set the limit.
+       *
+       * Caches are asked to evict if the new limit is exceeded.
+       *
+       * @param limit the limit (bytes), or @c 0 for no limit.
+       */
+      void
+      setLimit(dimension_size_type limit);
+
+      /**
+       * Get the limit.
+       *
+       * @returns the limit (bytes), or @c 0 if there is no limit.
+       */
+      dimension_size_type
+      getLimit() const;
+
+      /**
+       * Record memory held by a component.
+       *
+       * This only records the memory; it is not refused if over
+       * budget.  Call reclaim() afterward, without holding any
+       * lock used by a reclaimer, to evict if over budget.
+       *
+       * @param component the component holding the memory.
+       * @param bytes the size (bytes).
+       */
+      void
+      add(Component           component,
+          dimension_size_type bytes);
+
+      /**
+       * Record memory released by a component.
+       *
+       * @param component the component which held the memory.
+       * @param bytes the size (bytes).
+       */
+      void
+      remove(Component           component,
+             dimension_size_type bytes);
+
+      /**
+       * Check if the limit is exceeded.
+       *
+       * @returns @c true if a limit is set and the total usage
+       * exceeds it, @c false otherwise.
+       */
+      bool
+      exceeded() const;
+
+      /**
+       * Check if memory would fit within the limit.
+       *
+       * @param bytes the size (bytes).
+       * @returns @c true if no limit is set or adding @p bytes
+       * would not exceed it, @c false otherwise.
+       */
+      bool
+      fits(dimension_size_type bytes) const;
+
+      /**
+       * Evict from caches until within the limit.
+       *
+       * Reclaimers are called in order of component until the total
+       * usage is within the limit.  If another thread is already
+       * reclaiming, this returns immediately.
+       */
+      void
+      reclaim();
+
+      /**
+       * Reserve memory, waiting if over budget.
+       *
+       * If the reservation would exceed the limit after reclaiming,
+       * this waits until other reservations for the same component
+       * are released; if there are none, the reservation is granted
+       * regardless.  Reservations which may block must therefore
+       * only be held by tasks which complete without waiting for the
+       * caller.
+       *
+       * @param component the component to reserve for.
+       * @param bytes the size (bytes).
+       * @returns the reservation.
+       */
+      Reservation
+      reserve(Component           component,
+              dimension_size_type bytes);
+
+      /**
+       * Reserve memory if within budget.
+       *
+       * @param component the component to reserve for.
+       * @param bytes the size (bytes).
+       * @returns the reservation, or an empty reservation if the
+       * limit would be exceeded.
+       */
+      Reservation
+      tryReserve(Component           component,
+                 dimension_size_type bytes);
+
+      /**
+       * Register a reclaimer.
+       *
+       * @param component the component reclaimed from.
+       * @param reclaimer the function to call to reclaim memory.
+       * @returns the registration identifier.
+       */
+      reclaimer_id
+      addReclaimer(Component        component,
+                   reclaim_function reclaimer);
+
+      /**
+       * Remove a reclaimer.
+       *
+       * If the reclaimer is being called, this waits for it to
+       * return; on return, it will not be called again.
+       *
+       * @param id the registration identifier.
+       */
+      void
+      removeReclaimer(reclaimer_id id);
+
+      /**
+       * Get the memory held by a component.
+       *
+       * @param component the component.
+       * @returns the size (bytes).
+       */
+      dimension_size_type
+      getUsage(Component component) const;
+
+      /**
+       * Get the memory held by all components.
+       *
+       * @returns the size (bytes).
+       */
+      dimension_size_type
+      getUsage() const;
+
+      /**
+       * Get the peak memory held by a component.
+       *
+       * @param component the component.
+       * @returns the size (bytes).
+       */
+      dimension_size_type
+      getPeakUsage(Component component) const;
+
+      /// Reset the peak usage of all components to the current usage.
+      void
+      resetPeakUsage();
+
+      /**
+       * Get the name of a component.
+       *
+       * @param component the component.
+       * @returns the name, for example @c "decoded_tile_cache".
+       */
+      static const std::string&
+      name(Component component);
+
+    private:
+      /// A registered reclaimer.
+      struct Reclaimer
+      {
+        /// Registration identifier.
+        reclaimer_id id;
+        /// Component reclaimed from.
+        Component component;
+        /// Function to call.
+        reclaim_function reclaim;
+      };
+
+      /// Limit (bytes), or 0 for no limit.
+      std::atomic<dimension_size_type> limit;
+      /// Total usage (bytes).
+      std::atomic<dimension_size_type> total;
+      /// Usage by component (bytes).
+      std::array<std::atomic<dimension_size_type>, component_count> usage;
+      /// Peak usage by component (bytes).
+      std::array<std::atomic<dimension_size_type>, component_count> peak;
+      /// Lock for reservations and the reclaimer list.
+      std::mutex mutex;
+      /// Signalled when a reservation is released.
+      std::condition_variable released;
+      /// Total size of outstanding reservations by component (bytes).
+      std::array<dimension_size_type, component_count> reserved;
+      /// Registered reclaimers, in order of component.
+      std::vector<Reclaimer> reclaimers;
+      /// Next registration identifier.
+      reclaimer_id nextid;
+      /// Held while reclaiming.
+      std::mutex reclaimMutex;
+    };
+
+  }
+}
+
+#endif // OME_FILES_MEMORYBUDGET_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
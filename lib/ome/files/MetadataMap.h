@@ -47,10 +47,13 @@
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <ome/compat/variant.h>
 
+#include <ome/files/AllocationStatistics.h>
+
 namespace ome
 {
   namespace files
@@ -156,11 +159,37 @@ namespace ome
       set(const key_type&   key,
           const value_type& value)
       {
-        iterator i = find(key);
-        if (i != end())
-          erase(i);
-        map_type::value_type newvalue(key, value);
-        insert(newvalue);
+        iterator i = discriminating_map.lower_bound(key);
+        if (i != end() && i->first == key)
+          i->second = value;
+        else
+          {
+            discriminating_map.emplace_hint(i, key, value);
+            record_entry(key);
+          }
+      }
+
+      /**
+       * Add a key-value pair to the map, moving the value.
+       *
+       * @note If a key by the same already exists in the map, it will
+       * be removed and replaced.
+       *
+       * @param key the key name.
+       * @param value the abstract value.
+       */
+      void
+      set(const key_type& key,
+          value_type&&    value)
+      {
+        iterator i = discriminating_map.lower_bound(key);
+        if (i != end() && i->first == key)
+          i->second = std::move(value);
+        else
+          {
+            discriminating_map.emplace_hint(i, key, std::move(value));
+            record_entry(key);
+          }
       }
 
       /**
@@ -177,8 +206,7 @@ namespace ome
       set(const key_type& key,
           const T&        value)
       {
-        value_type v = value;
-        set(key, v);
+        set(key, value_type(value));
       }
 
       /**
@@ -337,7 +365,41 @@ namespace ome
       std::pair<iterator, bool>
       insert(map_type::value_type& value)
       {
-        return discriminating_map.insert(value);
+        std::pair<iterator, bool> ret(discriminating_map.insert(value));
+        if (ret.second)
+          record_entry(value.first);
+        return ret;
+      }
+
+      /**
+       * Insert a range of values into the map.
+       *
+       * As for insert(map_type::value_type&), keys which already
+       * exist in the map are not replaced; if a key occurs more than
+       * once in the range, the first value is inserted.  The range
+       * is sorted by key once, and then inserted in order using the
+       * previous insertion as a position hint, so that inserting a
+       * large number of values avoids a full search of the map for
+       * each key.
+       *
+       * @param begin the start of the range of key-value pairs.
+       * @param end the end of the range of key-value pairs.
+       */
+      template <typename InputIterator>
+      void
+      insert(InputIterator begin,
+             InputIterator end)
+      {
+        typedef std::pair<key_type, value_type> pair_type;
+
+        std::vector<pair_type> values(begin, end);
+        std::stable_sort(values.begin(), values.end(),
+                         [](const pair_type& lhs, const pair_type& rhs)
+                         { return lhs.first < rhs.first; });
+
+        iterator hint = discriminating_map.begin();
+        for (auto& value : values)
+          hint = std::next(insert_hint(hint, std::move(value.first), std::move(value.second)).first);
       }
 
       /**
@@ -363,6 +425,47 @@ namespace ome
       }
 
     private:
+      /**
+       * Insert a value into the map with a position hint.
+       *
+       * The value is inserted directly before the hint if the key
+       * belongs there, avoiding a search of the map; otherwise the
+       * map is searched as for insert().
+       *
+       * @param hint the position before which to insert.
+       * @param key the key name.
+       * @param value the value.
+       * @returns an iterator to the inserted key, or prexisting key
+       * if present, and @c true if the value was inserted, @c false
+       * otherwise.
+       */
+      template <typename K, typename V>
+      std::pair<iterator, bool>
+      insert_hint(iterator hint,
+                  K&&      key,
+                  V&&      value)
+      {
+        const size_type oldsize = size();
+        iterator i = discriminating_map.emplace_hint(hint, std::forward<K>(key), std::forward<V>(value));
+        const bool inserted = size() != oldsize;
+        if (inserted)
+          record_entry(i->first);
+        return std::make_pair(i, inserted);
+      }
+
+      /**
+       * Record the allocation of a new entry (see
+       * AllocationStatistics).
+       *
+       * @param key the key of the entry.
+       */
+      static void
+      record_entry(const key_type& key)
+      {
+        AllocationStatistics::record(AllocationStatistics::METADATA_MAP,
+                                     sizeof(map_type::value_type) + key.size());
+      }
+
       /// Functor to get a map key.
       struct getkey
       {
@@ -392,9 +495,10 @@ namespace ome
       std::vector<key_type>
       keys() const
       {
+        // The map is ordered by key, so the keys are already sorted.
         std::vector<key_type> ret;
+        ret.reserve(size());
         std::transform(begin(), end(), std::back_inserter(ret), getkey());
-        std::sort(ret.begin(), ret.end());
 
         return ret;
       }
@@ -410,10 +514,19 @@ namespace ome
       merge(const MetadataMap& map,
             const std::string& prefix)
       {
+        if (map.empty())
+          return;
+
+        // The prefixed keys retain the order of the merged map, so
+        // each key is inserted after the previous one.
+        iterator hint = discriminating_map.lower_bound(prefix + map.begin()->first);
+        key_type key;
         for (const auto& m : map)
           {
-            map_type::value_type v(prefix + m.first, m.second);
-            insert(v);
+            key.reserve(prefix.size() + m.first.size());
+            key.assign(prefix);
+            key.append(m.first);
+            hint = std::next(insert_hint(hint, key, m.second).first);
           }
       }
 
@@ -822,13 +935,20 @@ namespace ome
           typename std::vector<T>::size_type idx = 1;
           // Determine the optimal padding based on the maximum digit count.
           int sf = static_cast<int>(std::log10(static_cast<float>(c.size()))) + 1;
+          // Build the keys directly; constructing a stream for
+          // each element is expensive for large vectors.
+          MetadataMap::key_type elementkey;
           for (typename std::vector<T>::const_iterator i = c.begin();
                i != c.end();
                ++i, ++idx)
             {
-              std::ostringstream os;
-              os << key << " #" << std::setw(sf) << std::setfill('0') << std::right << idx;
-              map.set(os.str(), *i);
+              const std::string number(std::to_string(idx));
+              elementkey.assign(key);
+              elementkey.append(" #");
+              if (number.size() < static_cast<std::string::size_type>(sf))
+                elementkey.append(static_cast<std::string::size_type>(sf) - number.size(), '0');
+              elementkey.append(number);
+              map.set(elementkey, *i);
             }
         }
 
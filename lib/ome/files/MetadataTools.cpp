@@ -35,24 +35,31 @@
  * #L%
  */
 
+#include <deque>
+#include <map>
 #include <string>
+#include <vector>
 
 #include <boost/format.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
 
+#include <ome/files/DimensionIndexer.h>
 #include <ome/files/FormatException.h>
 #include <ome/files/FormatTools.h>
 #include <ome/files/MetadataTools.h>
 #include <ome/files/PixelProperties.h>
 #include <ome/files/XMLTools.h>
+#include <ome/files/detail/OMEXMLScan.h>
+#include <ome/files/detail/Trace.h>
+#include <ome/files/detail/XMLPlatform.h>
 
 #include <ome/compat/regex.h>
 
-#include <ome/common/xml/Platform.h>
 #include <ome/common/xml/String.h>
 #include <ome/common/xml/dom/Document.h>
 #include <ome/common/xml/dom/Element.h>
 #include <ome/common/xml/dom/NodeList.h>
-#include <ome/common/xsl/Platform.h>
 
 #include <ome/xml/Document.h>
 #include <ome/xml/OMETransform.h>
@@ -74,11 +81,20 @@
 #include <ome/xml/model/XMLAnnotation.h>
 #include <ome/xml/model/primitives/Timestamp.h>
 
+#include <xercesc/dom/DOMDocument.hpp>
+#include <xercesc/dom/DOMElement.hpp>
+#include <xercesc/dom/DOMException.hpp>
+#include <xercesc/dom/DOMImplementation.hpp>
+#include <xercesc/dom/DOMImplementationRegistry.hpp>
+#include <xercesc/dom/DOMText.hpp>
 #include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/sax2/Attributes.hpp>
 #include <xercesc/sax/SAXException.hpp>
 #include <xercesc/sax2/DefaultHandler.hpp>
 #include <xercesc/sax2/SAX2XMLReader.hpp>
 #include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/util/XMLString.hpp>
+#include <xercesc/util/XMLUniDefs.hpp>
 
 // Include last due to side effect of MPL vector limit setting which can change the default
 #include <boost/lexical_cast.hpp>
@@ -109,6 +125,34 @@ namespace
   /// Use default creation date?
   bool defaultCreationDate = false;
 
+  /// Schema and transform catalogue resolvers for model upgrades.
+  struct ModelResolvers
+  {
+    /// Schema catalogue.
+    ome::xml::OMEEntityResolver entity;
+    /// Transform catalogue.
+    ome::xml::OMETransformResolver transform;
+  };
+
+  /**
+   * Get the model resolvers for the calling thread.
+   *
+   * The resolvers load and parse the schema and transform
+   * catalogues when constructed, which is a large part of the cost
+   * of a single upgrade.  They are created once per thread and
+   * reused for all later upgrades, so that no locking is needed
+   * when upgrading concurrently.
+   *
+   * @returns the resolvers for this thread.
+   */
+  ModelResolvers&
+  modelResolvers()
+  {
+    ome::files::detail::initXSLPlatform();
+    thread_local ModelResolvers resolvers;
+    return resolvers;
+  }
+
   template<typename T>
   void parseNodeValue(::ome::common::xml::dom::Node& node,
                       T&                             value)
@@ -167,6 +211,385 @@ namespace
     std::string version;
   };
 
+  /// Magic number at the start of binary OME-XML.
+  const char binary_omexml_magic[] = "OMEBXML1";
+
+  /// Binary OME-XML token types.
+  enum BinaryOMEXMLToken
+    {
+      BINARY_OMEXML_END = 0,     ///< End of element.
+      BINARY_OMEXML_ELEMENT = 1, ///< Start of element with attributes.
+      BINARY_OMEXML_TEXT = 2     ///< Character data.
+    };
+
+  /**
+   * Encode OME-XML SAX events as binary OME-XML.
+   *
+   * Unsigned integers are stored as little-endian base 128 varints.
+   * Strings other than character data are interned: a reference of
+   * zero is followed by a new string, which is added to the string
+   * table, and other references are one-based indexes into the
+   * table.
+   */
+  class BinaryOMEXMLEncoder : public xercesc::DefaultHandler
+  {
+  public:
+    BinaryOMEXMLEncoder(std::string& data):
+      xercesc::DefaultHandler(),
+      data(data),
+      strings(),
+      text()
+    {}
+
+    virtual ~BinaryOMEXMLEncoder() {}
+
+    void
+    startElement(const XMLCh* const         uri,
+                 const XMLCh* const         /* localname */,
+                 const XMLCh* const         qname,
+                 const xercesc::Attributes& attrs)
+    {
+      flushText();
+      writeUInt(BINARY_OMEXML_ELEMENT);
+      writeString(uri);
+      writeString(qname);
+      const XMLSize_t count = attrs.getLength();
+      writeUInt(count);
+      for (XMLSize_t i = 0; i < count; ++i)
+        {
+          writeString(attrs.getURI(i));
+          writeString(attrs.getQName(i));
+          writeString(attrs.getValue(i));
+        }
+    }
+
+    void
+    endElement(const XMLCh* const /* uri */,
+               const XMLCh* const /* localname */,
+               const XMLCh* const /* qname */)
+    {
+      flushText();
+      writeUInt(BINARY_OMEXML_END);
+    }
+
+    void
+    characters(const XMLCh* const chars,
+               const XMLSize_t    length)
+    {
+      text.insert(text.end(), chars, chars + length);
+    }
+
+  private:
+    void
+    writeUInt(uint64_t value)
+    {
+      while (value >= 0x80U)
+        {
+          data += static_cast<char>((value & 0x7FU) | 0x80U);
+          value >>= 7;
+        }
+      data += static_cast<char>(value);
+    }
+
+    void
+    writeBytes(const std::string& value)
+    {
+      writeUInt(value.size());
+      data += value;
+    }
+
+    void
+    writeString(const XMLCh* const value)
+    {
+      const std::string s(value ? static_cast<std::string>(ome::common::xml::String(value)) : std::string());
+
+      auto i = strings.find(s);
+      if (i != strings.end())
+        writeUInt(i->second);
+      else
+        {
+          writeUInt(0U);
+          writeBytes(s);
+          strings.insert(std::make_pair(s, strings.size() + 1U));
+        }
+    }
+
+    void
+    flushText()
+    {
+      if (!text.empty())
+        {
+          text.push_back(0);
+          writeUInt(BINARY_OMEXML_TEXT);
+          writeBytes(ome::common::xml::String(text.data()));
+          text.clear();
+        }
+    }
+
+    /// Encoded data.
+    std::string& data;
+    /// Interned strings and their references.
+    std::map<std::string, uint64_t> strings;
+    /// Pending character data.
+    std::vector<XMLCh> text;
+  };
+
+  /**
+   * Decode binary OME-XML into a DOM document.
+   */
+  class BinaryOMEXMLDecoder
+  {
+  public:
+    BinaryOMEXMLDecoder(const std::string& data):
+      pos(data.data()),
+      end(data.data() + data.size()),
+      strings()
+    {
+      const std::size_t magic_size(sizeof(binary_omexml_magic) - 1U);
+      if (data.size() < magic_size ||
+          data.compare(0, magic_size, binary_omexml_magic) != 0)
+        throw ome::files::FormatException("Invalid binary OME-XML magic number");
+      pos += magic_size;
+    }
+
+    xercesc::DOMDocument *
+    decode()
+    {
+      static const XMLCh ls[] = {xercesc::chLatin_L, xercesc::chLatin_S, xercesc::chNull};
+      static const XMLCh xmlns[] = {xercesc::chLatin_x, xercesc::chLatin_m, xercesc::chLatin_l,
+                                    xercesc::chLatin_n, xercesc::chLatin_s, xercesc::chNull};
+
+      if (readUInt() != BINARY_OMEXML_ELEMENT)
+        throw ome::files::FormatException("Binary OME-XML does not start with an element");
+
+      xercesc::DOMImplementation *impl = xercesc::DOMImplementationRegistry::getDOMImplementation(ls);
+      if (!impl)
+        throw std::runtime_error("No XML DOM implementation available");
+
+      const XMLCh *ns = readString();
+      const XMLCh *qname = readString();
+      xercesc::DOMDocument *doc = impl->createDocument(ns, qname, 0);
+      try
+        {
+          std::vector<xercesc::DOMElement *> elements;
+          elements.push_back(doc->getDocumentElement());
+          readAttributes(*elements.back(), xmlns);
+
+          while (!elements.empty())
+            {
+              switch (readUInt())
+                {
+                case BINARY_OMEXML_END:
+                  elements.pop_back();
+                  break;
+                case BINARY_OMEXML_ELEMENT:
+                  {
+                    ns = readString();
+                    qname = readString();
+                    xercesc::DOMElement *element = doc->createElementNS(ns, qname);
+                    elements.back()->appendChild(element);
+                    elements.push_back(element);
+                    readAttributes(*element, xmlns);
+                  }
+                  break;
+                case BINARY_OMEXML_TEXT:
+                  {
+                    std::string text(readBytes());
+                    elements.back()->appendChild(doc->createTextNode(ome::common::xml::String(text)));
+                  }
+                  break;
+                default:
+                  throw ome::files::FormatException("Invalid binary OME-XML token");
+                }
+            }
+
+          if (pos != end)
+            throw ome::files::FormatException("Trailing data after binary OME-XML document");
+        }
+      catch (const xercesc::DOMException& e)
+        {
+          doc->release();
+          boost::format fmt("Invalid binary OME-XML element: %1%");
+          fmt % ome::common::xml::String(e.getMessage());
+          throw ome::files::FormatException(fmt.str());
+        }
+      catch (...)
+        {
+          doc->release();
+          throw;
+        }
+
+      return doc;
+    }
+
+  private:
+    uint64_t
+    readUInt()
+    {
+      uint64_t value = 0U;
+      for (unsigned int shift = 0U; shift < 64U; shift += 7U)
+        {
+          if (pos == end)
+            throw ome::files::FormatException("Truncated binary OME-XML");
+          const uint8_t byte = static_cast<uint8_t>(*pos++);
+          value |= static_cast<uint64_t>(byte & 0x7FU) << shift;
+          if (!(byte & 0x80U))
+            return value;
+        }
+      throw ome::files::FormatException("Invalid binary OME-XML integer");
+    }
+
+    std::string
+    readBytes()
+    {
+      const uint64_t size = readUInt();
+      if (size > static_cast<uint64_t>(end - pos))
+        throw ome::files::FormatException("Truncated binary OME-XML");
+      std::string value(pos, static_cast<std::size_t>(size));
+      pos += size;
+      return value;
+    }
+
+    const XMLCh *
+    readString()
+    {
+      const uint64_t ref = readUInt();
+      if (ref == 0U)
+        {
+          ome::common::xml::String value(readBytes());
+          const XMLCh *chars = value;
+          strings.emplace_back(chars, chars + xercesc::XMLString::stringLen(chars) + 1U);
+          return strings.back().data();
+        }
+      if (ref > strings.size())
+        throw ome::files::FormatException("Invalid binary OME-XML string reference");
+      return strings[static_cast<std::size_t>(ref - 1U)].data();
+    }
+
+    void
+    readAttributes(xercesc::DOMElement& element,
+                   const XMLCh         *xmlns)
+    {
+      static const XMLCh xmlns_uri[] = {
+        xercesc::chLatin_h, xercesc::chLatin_t, xercesc::chLatin_t, xercesc::chLatin_p,
+        xercesc::chColon, xercesc::chForwardSlash, xercesc::chForwardSlash,
+        xercesc::chLatin_w, xercesc::chLatin_w, xercesc::chLatin_w, xercesc::chPeriod,
+        xercesc::chLatin_w, xercesc::chDigit_3, xercesc::chPeriod,
+        xercesc::chLatin_o, xercesc::chLatin_r, xercesc::chLatin_g, xercesc::chForwardSlash,
+        xercesc::chDigit_2, xercesc::chDigit_0, xercesc::chDigit_0, xercesc::chDigit_0,
+        xercesc::chForwardSlash,
+        xercesc::chLatin_x, xercesc::chLatin_m, xercesc::chLatin_l,
+        xercesc::chLatin_n, xercesc::chLatin_s, xercesc::chForwardSlash, xercesc::chNull};
+
+      const uint64_t count = readUInt();
+      for (uint64_t i = 0; i < count; ++i)
+        {
+          const XMLCh *ns = readString();
+          const XMLCh *qname = readString();
+          const XMLCh *value = readString();
+
+          // Namespace declarations must be in the XMLNS namespace,
+          // whatever the SAX parser reported.
+          if (xercesc::XMLString::equals(qname, xmlns) ||
+              (xercesc::XMLString::startsWith(qname, xmlns) &&
+               qname[xercesc::XMLString::stringLen(xmlns)] == xercesc::chColon))
+            ns = xmlns_uri;
+
+          element.setAttributeNS(ns, qname, value);
+        }
+    }
+
+    /// Current position.
+    const char *pos;
+    /// End of data.
+    const char *end;
+    /// Interned strings, null terminated.
+    std::deque<std::vector<XMLCh>> strings;
+  };
+
+  /**
+   * Append an ID index to an LSID.
+   *
+   * Equivalent to formatting ":%1%" but without the overhead of
+   * boost::format, since IDs are created for every series, channel
+   * and plane when filling metadata.
+   *
+   * @param id the ID to append to.
+   * @param idx the index to append.
+   */
+  void
+  append_id_index(std::string&                    id,
+                  ome::files::dimension_size_type idx)
+  {
+    char buf[21];
+    char *end = buf + sizeof(buf);
+    char *pos = end;
+    do
+      {
+        *--pos = static_cast<char>('0' + (idx % 10U));
+        idx /= 10U;
+      }
+    while (idx);
+    id += ':';
+    id.append(pos, end);
+  }
+
+  /**
+   * Fill Plane TheZ, TheC and TheT for all planes in a series.
+   *
+   * The planes are filled last to first, so that the Plane list is
+   * sized once by the first setter rather than grown by one element
+   * for every plane.
+   *
+   * @param store the metadata store.
+   * @param series the series to fill.
+   * @param indexer the dimension indexer for the series.
+   */
+  void
+  fill_planes(MetadataStore&                      store,
+              ome::files::dimension_size_type     series,
+              const ome::files::DimensionIndexer& indexer)
+  {
+    for (ome::files::dimension_size_type p = indexer.size(); p-- > 0U;)
+      {
+        const ome::files::DimensionIndexer::coords_type coords(indexer.coords(p));
+        // The cast to int here is nasty, but the data model
+        // isn't using unsigned types…
+        store.setPlaneTheZ(static_cast<int>(coords[0]), series, p);
+        store.setPlaneTheC(static_cast<int>(coords[1]), series, p);
+        store.setPlaneTheT(static_cast<int>(coords[2]), series, p);
+      }
+  }
+
+  /**
+   * Add MetadataOnly to all series without TiffData or BinData.
+   *
+   * References are resolved once for all series, rather than once
+   * per series.
+   *
+   * @param omexml the OME-XML metadata store.
+   * @param seriesCount the number of series to check.
+   */
+  void
+  add_metadata_only(OMEXMLMetadata&                 omexml,
+                    ome::files::dimension_size_type seriesCount)
+  {
+    std::vector<ome::files::dimension_size_type> metadataOnly;
+    for (ome::files::dimension_size_type s = 0; s < seriesCount; ++s)
+      {
+        if (omexml.getTiffDataCount(s) == 0 &&
+            omexml.getPixelsBinDataCount(s) == 0)
+          metadataOnly.push_back(s);
+      }
+
+    if (!metadataOnly.empty())
+      {
+        omexml.resolveReferences();
+        for (const auto& s : metadataOnly)
+          ome::files::addMetadataOnly(omexml, s, false);
+      }
+  }
+
 }
 
 namespace ome
@@ -178,10 +601,11 @@ namespace ome
     createID(std::string const&  type,
              dimension_size_type idx)
     {
-      static boost::format fmt("%1%:%2%");
-      fmt.clear();
-      fmt % type % idx;
-      return fmt.str();
+      std::string id;
+      id.reserve(type.size() + 21U);
+      id += type;
+      append_id_index(id, idx);
+      return id;
     }
 
     std::string
@@ -189,10 +613,12 @@ namespace ome
              dimension_size_type idx1,
              dimension_size_type idx2)
     {
-      static boost::format fmt("%1%:%2%:%3%");
-      fmt.clear();
-      fmt % type % idx1 % idx2;
-      return fmt.str();
+      std::string id;
+      id.reserve(type.size() + 42U);
+      id += type;
+      append_id_index(id, idx1);
+      append_id_index(id, idx2);
+      return id;
     }
 
     std::string
@@ -201,10 +627,13 @@ namespace ome
              dimension_size_type idx2,
              dimension_size_type idx3)
     {
-      static boost::format fmt("%1%:%2%:%3%:%4%");
-      fmt.clear();
-      fmt % type % idx1 % idx2 % idx3;
-      return fmt.str();
+      std::string id;
+      id.reserve(type.size() + 63U);
+      id += type;
+      append_id_index(id, idx1);
+      append_id_index(id, idx2);
+      append_id_index(id, idx3);
+      return id;
     }
 
     std::string
@@ -214,31 +643,30 @@ namespace ome
              dimension_size_type idx3,
              dimension_size_type idx4)
     {
-      static boost::format fmt("%1%:%2%:%3%:%4%:%5%");
-      fmt.clear();
-      fmt % type % idx1 % idx2 % idx3 % idx4;
-      return fmt.str();
+      std::string id;
+      id.reserve(type.size() + 84U);
+      id += type;
+      append_id_index(id, idx1);
+      append_id_index(id, idx2);
+      append_id_index(id, idx3);
+      append_id_index(id, idx4);
+      return id;
     }
 
     std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
     createOMEXMLMetadata(ome::common::xml::dom::Document& document)
     {
-      ome::common::xsl::Platform xslplat;
+      detail::initXSLPlatform();
       ome::common::xml::dom::Document upgraded_doc;
       ome::common::xml::dom::Element docroot;
 
       if (getModelVersion(document) != OME_XML_MODEL_VERSION)
         {
           // Transform to latest
-          ome::xml::OMEEntityResolver entity_resolver;
-          ome::xml::OMETransformResolver transform_resolver;
-
           std::string xml;
           ome::common::xml::dom::writeDocument(document, xml);
 
-          std::string upgraded_xml;
-          ome::xml::transform(OME_XML_MODEL_VERSION, xml, upgraded_xml,
-                              entity_resolver, transform_resolver);
+          std::string upgraded_xml(transformToLatestModelVersion(xml));
 
           try
             {
@@ -271,9 +699,10 @@ namespace ome
     std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
     createOMEXMLMetadata(const boost::filesystem::path& file)
     {
+      OME_FILES_TRACE(trace, "metadata", "parse_omexml");
+
       // Parse OME-XML into DOM Document.
-      ome::common::xml::Platform xmlplat;
-      ome::common::xsl::Platform xslplat;
+      detail::initXSLPlatform();
       ome::common::xml::dom::Document doc;
       try
         {
@@ -292,9 +721,10 @@ namespace ome
     std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
     createOMEXMLMetadata(const std::string& text)
     {
+      OME_FILES_TRACE(trace, "metadata", "parse_omexml");
+
       // Parse OME-XML into DOM Document.
-      ome::common::xml::Platform xmlplat;
-      ome::common::xsl::Platform xslplat;
+      detail::initXSLPlatform();
       ome::common::xml::dom::Document doc;
       try
         {
@@ -311,12 +741,42 @@ namespace ome
       return createOMEXMLMetadata(doc);
     }
 
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
+    createOMEXMLMetadata(const char  *text,
+                         std::size_t  length)
+    {
+      OME_FILES_TRACE(trace, "metadata", "parse_omexml");
+
+      // Parse OME-XML into DOM Document, reading directly from the
+      // text rather than a copy.
+      typedef boost::iostreams::stream<boost::iostreams::array_source> array_stream;
+
+      detail::initXSLPlatform();
+      ome::common::xml::dom::Document doc;
+      try
+        {
+          array_stream stream(text, length);
+          doc = ome::xml::createDocument(stream, ome::common::xml::dom::ParseParameters(),
+                                         "OME-XML text");
+        }
+      catch (const std::runtime_error&) // retry without strict validation
+        {
+          ome::common::xml::dom::ParseParameters params;
+          params.doSchema = false;
+          params.validationSchemaFullChecking = false;
+          array_stream stream(text, length);
+          doc = ome::xml::createDocument(stream, params, "Broken OME-XML text");
+        }
+      return createOMEXMLMetadata(doc);
+    }
+
     std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
     createOMEXMLMetadata(std::istream& stream)
     {
+      OME_FILES_TRACE(trace, "metadata", "parse_omexml");
+
       // Parse OME-XML into DOM Document.
-      ome::common::xml::Platform xmlplat;
-      ome::common::xsl::Platform xslplat;
+      detail::initXSLPlatform();
       ome::common::xml::dom::Document doc;
       try
         {
@@ -379,20 +839,154 @@ namespace ome
     getOMEXML(::ome::xml::meta::OMEXMLMetadata& omexml,
               bool                              validate)
     {
+      return getOMEXML(omexml, validate ? OMEXML_VALIDATE_ALL : OMEXML_VALIDATE_NONE);
+    }
+
+    std::string
+    getOMEXML(::ome::xml::meta::OMEXMLMetadata& omexml,
+              OMEXMLValidationPolicy            policy)
+    {
+      OME_FILES_TRACE(trace, "metadata", "serialize_omexml");
+
       std::string xml(omexml.dumpXML());
 
-      if (validate && !validateOMEXML(xml))
+      if (!validateOMEXML(xml, policy))
         throw std::runtime_error("Invalid OME-XML document");
 
       return xml;
     }
 
+    std::string
+    getBinaryOMEXML(::ome::xml::meta::OMEXMLMetadata& omexml)
+    {
+      OME_FILES_TRACE(trace, "metadata", "serialize_binary_omexml");
+
+      std::string xml(omexml.dumpXML());
+
+      detail::initXMLPlatform();
+
+      std::shared_ptr<xercesc::SAX2XMLReader> parser(xercesc::XMLReaderFactory::createXMLReader());
+      // The document was created from the model, so it is not
+      // validated again.  Namespace declarations are kept as
+      // attributes so that the document round-trips unchanged.
+      parser->setFeature(xercesc::XMLUni::fgSAX2CoreValidation, false);
+      parser->setFeature(xercesc::XMLUni::fgXercesSchemaFullChecking, false);
+      parser->setFeature(xercesc::XMLUni::fgXercesLoadSchema, false);
+      parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpaces, true);
+      parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpacePrefixes, true);
+
+      xercesc::MemBufInputSource source(reinterpret_cast<const XMLByte *>(xml.c_str()),
+                                        static_cast<XMLSize_t>(xml.size()),
+                                        common::xml::String("OME-XML binary encoding"));
+
+      std::string data(binary_omexml_magic, sizeof(binary_omexml_magic) - 1U);
+      data.reserve(xml.size() / 4U);
+
+      BinaryOMEXMLEncoder handler(data);
+      parser->setContentHandler(&handler);
+
+      try
+        {
+          parser->parse(source);
+        }
+      catch (const xercesc::XMLException& e)
+        {
+          boost::format fmt("Failed to encode binary OME-XML: %1%");
+          fmt % ome::common::xml::String(e.getMessage());
+          throw FormatException(fmt.str());
+        }
+      catch (const xercesc::SAXException& e)
+        {
+          boost::format fmt("Failed to encode binary OME-XML: %1%");
+          fmt % ome::common::xml::String(e.getMessage());
+          throw FormatException(fmt.str());
+        }
+
+      return data;
+    }
+
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
+    createOMEXMLMetadataFromBinary(const std::string& data)
+    {
+      OME_FILES_TRACE(trace, "metadata", "parse_binary_omexml");
+
+      // Build the DOM Document directly, without parsing or
+      // validation.
+      detail::initXMLPlatform();
+      BinaryOMEXMLDecoder decoder(data);
+      ome::common::xml::dom::Document doc(decoder.decode(), true);
+      return createOMEXMLMetadata(doc);
+    }
+
     bool
     validateOMEXML(const std::string& document)
     {
       return validateXML(document, "OME-XML document for validation");
     }
 
+    bool
+    validateOMEXMLStructure(const std::string& document)
+    {
+      detail::OMEXMLSummary summary;
+      if (!detail::scanOMEXML(document, summary))
+        return false;
+
+      for (const auto& image : summary.images)
+        {
+          if (image.id.empty() || image.pixelsID.empty() ||
+              !image.sizeX || !image.sizeY || !image.sizeZ ||
+              !image.sizeC || !image.sizeT ||
+              !image.channelCount || image.channelCount > image.sizeC)
+            return false;
+
+          try
+            {
+              ome::xml::model::enums::PixelType type(image.pixelType);
+              ome::xml::model::enums::DimensionOrder order(image.dimensionOrder);
+            }
+          catch (const std::exception&)
+            {
+              return false;
+            }
+        }
+
+      return true;
+    }
+
+    // No switch default to avoid -Wunreachable-code errors.
+    // However, this then makes -Wswitch-default complain.  Disable
+    // temporarily.
+#ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+
+    bool
+    validateOMEXML(const std::string&     document,
+                   OMEXMLValidationPolicy policy)
+    {
+      bool valid = true;
+
+      switch(policy)
+        {
+        case OMEXML_VALIDATE_ALL:
+        case OMEXML_VALIDATE_FIRST:
+          valid = validateOMEXML(document);
+          break;
+        case OMEXML_VALIDATE_STRUCTURE:
+          valid = validateOMEXMLStructure(document);
+          break;
+        case OMEXML_VALIDATE_NONE:
+          break;
+        }
+
+      return valid;
+    }
+
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+
     bool
     validateModel(::ome::xml::meta::Metadata& meta,
                   bool                        correct)
@@ -519,8 +1113,9 @@ namespace ome
                  bool                             doImageName)
     {
       dimension_size_type oldseries = reader.getSeries();
+      const dimension_size_type seriesCount = reader.getSeriesCount();
 
-      for (dimension_size_type s = 0; s < reader.getSeriesCount(); ++s)
+      for (dimension_size_type s = 0; s < seriesCount; ++s)
         {
           reader.setSeries(s);
 
@@ -530,13 +1125,11 @@ namespace ome
           if (doImageName && !!cfile)
             {
               nos << (*cfile).string();
-              if (reader.getSeriesCount() > 1)
+              if (seriesCount > 1)
                 nos << " #" << (s + 1);
             }
           std::string imageName = nos.str();
 
-          std::string pixelType = reader.getPixelType();
-
           if (!imageName.empty())
             store.setImageID(createID("Image", s), s);
           if (!!cfile)
@@ -544,86 +1137,52 @@ namespace ome
 
           fillPixels(store, reader);
 
-          try
-            {
-              OMEXMLMetadata& omexml(dynamic_cast<OMEXMLMetadata&>(store));
-              if (omexml.getTiffDataCount(s) == 0 &&
-                  omexml.getPixelsBinDataCount(s) == 0)
-                addMetadataOnly(omexml, s);
-            }
-          catch (const std::bad_cast&)
-            {
-            }
-
-          if (doPlane)
-            {
-              for (dimension_size_type p = 0; p < reader.getImageCount(); ++p)
-                {
-                  std::array<dimension_size_type, 3> coords = reader.getZCTCoords(p);
-                  // The cast to int here is nasty, but the data model
-                  // isn't using unsigned types…
-                  store.setPlaneTheZ(static_cast<int>(coords[0]), s, p);
-                  store.setPlaneTheC(static_cast<int>(coords[1]), s, p);
-                  store.setPlaneTheT(static_cast<int>(coords[2]), s, p);
-                }
-            }
-
+          if (doPlane && reader.getImageCount())
+            fill_planes(store, s, reader.getDimensionIndexer());
         }
 
+      OMEXMLMetadata *omexml(dynamic_cast<OMEXMLMetadata *>(&store));
+      if (omexml)
+        add_metadata_only(*omexml, seriesCount);
+
       reader.setSeries(oldseries);
     }
 
     void
-    fillMetadata(::ome::xml::meta::MetadataStore&                 store,
-                 const std::vector<std::shared_ptr<CoreMetadata>> seriesList,
-                 bool                                             doPlane)
+    fillMetadata(::ome::xml::meta::MetadataStore&                  store,
+                 const std::vector<std::shared_ptr<CoreMetadata>>& seriesList,
+                 bool                                              doPlane)
     {
       dimension_size_type s = 0U;
       for (std::vector<std::shared_ptr<CoreMetadata>>::const_iterator i = seriesList.begin();
            i != seriesList.end();
            ++i, ++s)
         {
-          std::string pixelType = (*i)->pixelType;
+          const CoreMetadata& core(**i);
 
           store.setImageID(createID("Image", s), s);
 
-          fillPixels(store, **i, s);
+          fillPixels(store, core, s);
 
-          try
-            {
-              OMEXMLMetadata& omexml(dynamic_cast<OMEXMLMetadata&>(store));
-              if (omexml.getTiffDataCount(s) == 0 &&
-                  omexml.getPixelsBinDataCount(s) == 0)
-                addMetadataOnly(omexml, s);
-            }
-          catch (const std::bad_cast&)
+          if (doPlane && core.imageCount)
             {
-            }
-
-          if (doPlane)
-            {
-              for (dimension_size_type p = 0; p < (*i)->imageCount; ++p)
-                {
-                  dimension_size_type sizeZT = (*i)->sizeZ * (*i)->sizeT;
-                  dimension_size_type effSizeC = 1U;
-                  if (sizeZT)
-                    effSizeC = (*i)->imageCount / sizeZT;
-
-                  std::array<dimension_size_type, 3> coords =
-                    getZCTCoords((*i)->dimensionOrder,
-                                 (*i)->sizeZ,
-                                 effSizeC,
-                                 (*i)->sizeT,
-                                 (*i)->imageCount,
-                                 p);
-                  // The cast to int here is nasty, but the data model
-                  // isn't using unsigned types…
-                  store.setPlaneTheZ(static_cast<int>(coords[0]), s, p);
-                  store.setPlaneTheC(static_cast<int>(coords[1]), s, p);
-                  store.setPlaneTheT(static_cast<int>(coords[2]), s, p);
-                }
+              dimension_size_type sizeZT = core.sizeZ * core.sizeT;
+              dimension_size_type effSizeC = 1U;
+              if (sizeZT)
+                effSizeC = core.imageCount / sizeZT;
+
+              const DimensionIndexer indexer(core.dimensionOrder,
+                                             core.sizeZ,
+                                             effSizeC,
+                                             core.sizeT,
+                                             core.imageCount);
+              fill_planes(store, s, indexer);
             }
         }
+
+      OMEXMLMetadata *omexml(dynamic_cast<OMEXMLMetadata *>(&store));
+      if (omexml)
+        add_metadata_only(*omexml, seriesList.size());
     }
 
     void
@@ -660,8 +1219,10 @@ namespace ome
       store.setPixelsSizeT(static_cast<PositiveInteger::value_type>(reader.getSizeT()), series);
       store.setPixelsSizeC(static_cast<PositiveInteger::value_type>(reader.getSizeC()), series);
 
+      // Channels are filled last to first so that the Channel list
+      // is sized once.
       dimension_size_type effSizeC = reader.getEffectiveSizeC();
-      for (dimension_size_type c = 0; c < effSizeC; ++c)
+      for (dimension_size_type c = effSizeC; c-- > 0U;)
         {
           store.setChannelID(createID("Channel", series, c), series, c);
           store.setChannelSamplesPerPixel(static_cast<PositiveInteger::value_type>(reader.getRGBChannelCount(c)), series, c);
@@ -691,9 +1252,11 @@ namespace ome
                            (std::accumulate(seriesMetadata.sizeC.begin(), seriesMetadata.sizeC.end(),
                                             dimension_size_type(0))), series);
 
+      // Channels are filled last to first so that the Channel list
+      // is sized once.
       dimension_size_type effSizeC = seriesMetadata.sizeC.size();
 
-      for (dimension_size_type c = 0; c < effSizeC; ++c)
+      for (dimension_size_type c = effSizeC; c-- > 0U;)
         {
           dimension_size_type rgbC = seriesMetadata.sizeC.at(c);
 
@@ -775,7 +1338,7 @@ namespace ome
             {
               try
                 {
-                  ome::common::xml::Platform xmlplat;
+                  detail::initXMLPlatform();
                   ::ome::common::xml::dom::Document xmlroot(::ome::xml::createDocument(xmlannotation->getValue()));
                   ::ome::common::xml::dom::NodeList nodes(xmlroot.getElementsByTagName(tag));
 
@@ -986,7 +1549,7 @@ namespace ome
                       wrappedValue += annotation->getValue();
                       wrappedValue += "</wrapped>";
 
-                      common::xml::Platform xmlplat;
+                      detail::initXMLPlatform();
                       common::xml::dom::ParseParameters params;
                       params.validationScheme = xercesc::XercesDOMParser::Val_Never;
                       common::xml::dom::Document doc(ome::xml::createDocument(wrappedValue));
@@ -1065,6 +1628,9 @@ namespace ome
               ids.insert(omexml.getXMLAnnotationID(i));
             }
 
+          // Reused for each value to avoid constructing a stream per
+          // annotation.
+          std::ostringstream value;
           for (MetadataMap::const_iterator i = flat.begin();
                i != flat.end();
                ++i, ++annotationIndex)
@@ -1077,7 +1643,8 @@ namespace ome
                 }
               while (ids.find(id) != ids.end());
 
-              std::ostringstream value;
+              value.str(std::string());
+              value.clear();
               ome::compat::visit(::ome::files::detail::MetadataMapValueTypeOStreamVisitor(value), i->second);
 
               std::shared_ptr<OriginalMetadataAnnotation> orig(std::make_shared<OriginalMetadataAnnotation>());
@@ -1123,7 +1690,7 @@ namespace ome
     std::string
     getModelVersion(const std::string& document)
     {
-      ome::common::xml::Platform xmlplat;
+      detail::initXMLPlatform();
 
       std::shared_ptr<xercesc::SAX2XMLReader> parser(xercesc::XMLReaderFactory::createXMLReader());
       // We only want to get the schema version, so disable checking
@@ -1175,16 +1742,23 @@ namespace ome
     std::string
     transformToLatestModelVersion(const std::string& document)
     {
-      ome::xml::OMEEntityResolver entity_resolver;
-      ome::xml::OMETransformResolver transform_resolver;
+      ModelResolvers& resolvers(modelResolvers());
+
+      OME_FILES_TRACE(trace, "metadata", "upgrade_omexml");
 
       std::string upgraded_xml;
       ome::xml::transform(OME_XML_MODEL_VERSION, document, upgraded_xml,
-                          entity_resolver, transform_resolver);
+                          resolvers.entity, resolvers.transform);
 
       return upgraded_xml;
     }
 
+    void
+    preloadOMEXML()
+    {
+      modelResolvers();
+    }
+
     bool
     defaultCreationDateEnabled()
     {
@@ -35,6 +35,7 @@
  * #L%
  */
 
+#include <cstddef>
 #include <string>
 
 #include <boost/filesystem/path.hpp>
@@ -57,6 +58,17 @@ namespace ome
   namespace files
   {
 
+    /**
+     * OME-XML document validation policy.
+     */
+    enum OMEXMLValidationPolicy
+      {
+        OMEXML_VALIDATE_ALL,       ///< Validate every document against the schema.
+        OMEXML_VALIDATE_FIRST,     ///< Validate the first document of a dataset only.
+        OMEXML_VALIDATE_STRUCTURE, ///< Check the Image, Pixels, Channel and TiffData structure only.
+        OMEXML_VALIDATE_NONE       ///< Do not validate.
+      };
+
     // Use overloaded functions for creating identifiers since
     // pre-C++11 compilers don't support the C99 stdarg interface.
 
@@ -143,6 +155,21 @@ namespace ome
     std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
     createOMEXMLMetadata(const std::string& text);
 
+    /**
+     * Create OME-XML metadata from XML text in memory.
+     *
+     * The text is parsed in place, without making a copy, which is
+     * preferable for large documents such as the ImageDescription
+     * of an OME-TIFF (see tiff::Field::view()).
+     *
+     * @param text the XML text.
+     * @param length the length of the XML text.
+     * @returns the OME-XML metadata.
+     */
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
+    createOMEXMLMetadata(const char  *text,
+                         std::size_t  length);
+
     /**
      * Create OME-XML metadata from XML input stream.
      *
@@ -201,6 +228,59 @@ namespace ome
     getOMEXML(::ome::xml::meta::OMEXMLMetadata& omexml,
               bool                              validate = true);
 
+    /**
+     * Get OME-XML document from OME-XML metadata.
+     *
+     * This will convert the OME-XML metadata to an XML document
+     * string, and validate it according to the specified policy.
+     * Since there is only a single document, @c
+     * OMEXML_VALIDATE_FIRST is equivalent to @c OMEXML_VALIDATE_ALL.
+     *
+     * @param omexml the OME-XML metadata store.
+     * @param policy the validation policy.
+     * @returns the OME-XML metadata as an XML document string.
+     * @throws std::runtime_error if validation fails.
+     */
+    std::string
+    getOMEXML(::ome::xml::meta::OMEXMLMetadata& omexml,
+              OMEXMLValidationPolicy            policy);
+
+    /**
+     * Get compact binary OME-XML from OME-XML metadata.
+     *
+     * The OME-XML document is encoded as a sequence of element,
+     * attribute and text tokens.  Namespaces, element and attribute
+     * names and attribute values are stored once and then referred
+     * to by index, so the many repeated names and values of large
+     * plates and image sets are stored compactly.  The encoding is
+     * independent of byte order.
+     *
+     * Unlike OME-XML text, the binary form is loaded with
+     * createOMEXMLMetadataFromBinary() without parsing or schema
+     * validation, so it is suited to passing metadata between
+     * processes which trust each other.
+     *
+     * @param omexml the OME-XML metadata store.
+     * @returns the binary OME-XML.
+     * @throws FormatException if the metadata could not be encoded.
+     */
+    std::string
+    getBinaryOMEXML(::ome::xml::meta::OMEXMLMetadata& omexml);
+
+    /**
+     * Create OME-XML metadata from compact binary OME-XML.
+     *
+     * The binary form is created by getBinaryOMEXML().  The metadata
+     * are identical to those from the OME-XML text of the original
+     * metadata.
+     *
+     * @param data the binary OME-XML.
+     * @returns the OME-XML metadata.
+     * @throws FormatException if the binary OME-XML is invalid.
+     */
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
+    createOMEXMLMetadataFromBinary(const std::string& data);
+
     /**
      * Validate an OME-XML document.
      *
@@ -210,6 +290,34 @@ namespace ome
     bool
     validateOMEXML(const std::string& document);
 
+    /**
+     * Validate the structure of an OME-XML document.
+     *
+     * This is a lightweight check of the parts of the document
+     * needed to interpret the pixel data, without schema
+     * validation.  The root element must be @c OME, and each Image
+     * must have an ID and Pixels with an ID, nonzero sizes, a valid
+     * pixel type and dimension order, and between one and SizeC
+     * Channel elements.  The rest of the document is not checked.
+     *
+     * @param document the XML document source.
+     * @returns @c true if valid, @c false if invalid.
+     */
+    bool
+    validateOMEXMLStructure(const std::string& document);
+
+    /**
+     * Validate an OME-XML document according to a policy.
+     *
+     * @param document the XML document source.
+     * @param policy the validation policy.
+     * @returns @c true if valid or not validated, @c false if
+     * invalid.
+     */
+    bool
+    validateOMEXML(const std::string&     document,
+                   OMEXMLValidationPolicy policy);
+
     /**
      * Validate a metadata store.
      *
@@ -254,9 +362,9 @@ namespace ome
      * @param doPlane create Plane elements if @c true.
      */
     void
-    fillMetadata(::ome::xml::meta::MetadataStore&                 store,
-                 const std::vector<std::shared_ptr<CoreMetadata>> seriesList,
-                 bool                                             doPlane = false);
+    fillMetadata(::ome::xml::meta::MetadataStore&                  store,
+                 const std::vector<std::shared_ptr<CoreMetadata>>& seriesList,
+                 bool                                              doPlane = false);
 
     /**
      * Fill all OME-XML metadata store Pixels elements from reader core metadata.
@@ -452,12 +560,32 @@ namespace ome
     /**
      * Transform an OME-XML document to the latest model version
      *
+     * The schema and transform catalogues are loaded on first use
+     * by each thread, and reused for all later transforms by the
+     * same thread.  This function may be called concurrently from
+     * several threads.
+     *
      * @param document the OME-XML document.
      * @returns the transformed OME-XML document.
      */
     std::string
     transformToLatestModelVersion(const std::string& document);
 
+    /**
+     * Initialise OME-XML support now rather than on first use.
+     *
+     * The XML and XSLT platforms, and the schema and transform
+     * catalogues, are otherwise set up lazily by the first function
+     * which needs them, which adds to the latency of the first read
+     * of an OME-TIFF file.  Call this early (for example, while
+     * starting up, or from a worker thread before it is given any
+     * work) to pay this cost up front.  The platforms are shared by
+     * all threads; the catalogues are loaded for the calling thread
+     * only.  Calling this is never required.
+     */
+    void
+    preloadOMEXML();
+
     /**
      * Enable or disable default creation date.
      *
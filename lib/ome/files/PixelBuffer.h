@@ -38,20 +38,28 @@
 #ifndef OME_FILES_PIXELBUFFER_H
 #define OME_FILES_PIXELBUFFER_H
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
 #include <istream>
+#include <iterator>
 #include <limits>
 #include <memory>
+#include <new>
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 
 // Disable expensive bounds checking
 #define BOOST_DISABLE_ASSERTS 1
 #include <boost/multi_array.hpp>
 
+#include <ome/files/AllocationStatistics.h>
+#include <ome/files/PixelBufferAllocator.h>
 #include <ome/files/PixelProperties.h>
+#include <ome/files/detail/Interleave.h>
 
 #include <ome/compat/variant.h>
 
@@ -198,6 +206,311 @@ namespace ome
       const EndianType endiantype;
     };
 
+    namespace detail
+    {
+
+      /**
+       * Check if two multi-dimensional arrays have the same layout.
+       *
+       * Arrays with the same shape and storage order have their
+       * elements in the same logical order in memory, so may be
+       * compared or copied as contiguous blocks.
+       *
+       * @param lhs the first array.
+       * @param rhs the second array.
+       * @returns @c true if the layouts match, @c false otherwise.
+       */
+      template<typename A, typename B>
+      inline bool
+      same_layout(const A& lhs,
+                  const B& rhs)
+      {
+        return lhs.num_dimensions() == rhs.num_dimensions() &&
+          std::equal(lhs.shape(), lhs.shape() + lhs.num_dimensions(), rhs.shape()) &&
+          lhs.storage_order() == rhs.storage_order();
+      }
+
+      /**
+       * Compare contiguous integer pixel values for equality.
+       *
+       * Integer values are equal only if their representations are
+       * equal, so the values are compared as raw memory.
+       *
+       * @param lhs the first values.
+       * @param rhs the second values.
+       * @param count the number of values.
+       * @returns @c true if equal, @c false otherwise.
+       */
+      template<typename T>
+      inline typename std::enable_if<std::is_integral<T>::value, bool>::type
+      contiguous_equal(const T      *lhs,
+                       const T      *rhs,
+                       std::size_t   count)
+      {
+        return !count || lhs == rhs || std::memcmp(lhs, rhs, count * sizeof(T)) == 0;
+      }
+
+      /**
+       * Compare contiguous floating point or complex pixel values for
+       * equality.
+       *
+       * The values are compared with @c ==, so that NaN values are
+       * never equal and signed zeros are equal, as for element-wise
+       * comparison.  Values are compared in blocks without an early
+       * exit within each block, to permit vectorisation.
+       *
+       * @param lhs the first values.
+       * @param rhs the second values.
+       * @param count the number of values.
+       * @returns @c true if equal, @c false otherwise.
+       */
+      template<typename T>
+      inline typename std::enable_if<!std::is_integral<T>::value, bool>::type
+      contiguous_equal(const T      *lhs,
+                       const T      *rhs,
+                       std::size_t   count)
+      {
+        const std::size_t block = 4096U / sizeof(T);
+        for (std::size_t i = 0; i < count; i += block)
+          {
+            const std::size_t n = std::min(block, count - i);
+            bool equal = true;
+            for (std::size_t j = 0; j < n; ++j)
+              equal &= lhs[i + j] == rhs[i + j];
+            if (!equal)
+              return false;
+          }
+        return true;
+      }
+
+      /**
+       * Transpose a matrix with a small, fixed column count.
+       *
+       * This is the deinterleaving case: each source row is a pixel
+       * of @c N samples, and each destination row is a plane of a
+       * single sample.  Whole blocks of pixels are deinterleaved
+       * with SIMD instructions where available (see
+       * deinterleaveSamples()), and the remainder with a loop
+       * unrolled for the fixed sample count.
+       *
+       * @param src the source matrix.
+       * @param dest the destination matrix.
+       * @param destld the distance between destination rows.
+       * @param rows the number of source rows (pixels).
+       */
+      template<std::size_t N, typename T>
+      inline void
+      transpose_columns(const T      *src,
+                        T            *dest,
+                        std::size_t   destld,
+                        std::size_t   rows)
+      {
+        std::size_t r = 0;
+        if (std::is_trivially_copyable<T>::value)
+          r = deinterleaveSamples(src, dest, destld, rows, N, sizeof(T));
+        for (; r < rows; ++r)
+          for (std::size_t c = 0; c < N; ++c)
+            dest[(c * destld) + r] = src[(r * N) + c];
+      }
+
+      /**
+       * Transpose a matrix with a small, fixed row count.
+       *
+       * This is the interleaving case: each source row is a plane of
+       * a single sample, and each destination row is a pixel of @c N
+       * samples.  SIMD instructions are used as for
+       * transpose_columns() (see interleaveSamples()).
+       *
+       * @param src the source matrix.
+       * @param srcld the distance between source rows.
+       * @param dest the destination matrix.
+       * @param cols the number of source columns (pixels).
+       */
+      template<std::size_t N, typename T>
+      inline void
+      transpose_rows(const T      *src,
+                     std::size_t   srcld,
+                     T            *dest,
+                     std::size_t   cols)
+      {
+        std::size_t c = 0;
+        if (std::is_trivially_copyable<T>::value)
+          c = interleaveSamples(src, srcld, dest, cols, N, sizeof(T));
+        for (; c < cols; ++c)
+          for (std::size_t r = 0; r < N; ++r)
+            dest[(c * N) + r] = src[(r * srcld) + c];
+      }
+
+      /**
+       * Transpose a row-major matrix.
+       *
+       * Element <tt>[r][c]</tt> of the source is copied to element
+       * <tt>[c][r]</tt> of the destination.  This converts between
+       * interleaved (chunky) and planar samples: a block of pixels
+       * with interleaved samples is a matrix of @c pixels rows and
+       * @c samples columns, and its transpose is the planar layout.
+       *
+       * Common sample counts (2, 3 and 4) use SIMD and unrolled
+       * kernels.
+       * Other sizes are transposed in square blocks which fit in
+       * the cache.  The source and destination must not overlap.
+       *
+       * @param src the source matrix.
+       * @param srcld the distance between source rows (at least @c cols).
+       * @param dest the destination matrix.
+       * @param destld the distance between destination rows (at least @c rows).
+       * @param rows the number of source rows.
+       * @param cols the number of source columns.
+       */
+      template<typename T>
+      inline void
+      transpose(const T      *src,
+                std::size_t   srcld,
+                T            *dest,
+                std::size_t   destld,
+                std::size_t   rows,
+                std::size_t   cols)
+      {
+        if (cols == srcld)
+          {
+            if (cols == 2U)
+              return transpose_columns<2U>(src, dest, destld, rows);
+            if (cols == 3U)
+              return transpose_columns<3U>(src, dest, destld, rows);
+            if (cols == 4U)
+              return transpose_columns<4U>(src, dest, destld, rows);
+          }
+        if (rows == destld)
+          {
+            if (rows == 2U)
+              return transpose_rows<2U>(src, srcld, dest, cols);
+            if (rows == 3U)
+              return transpose_rows<3U>(src, srcld, dest, cols);
+            if (rows == 4U)
+              return transpose_rows<4U>(src, srcld, dest, cols);
+          }
+
+        const std::size_t block = 64U;
+        for (std::size_t r0 = 0; r0 < rows; r0 += block)
+          {
+            const std::size_t r1 = std::min(rows, r0 + block);
+            for (std::size_t c0 = 0; c0 < cols; c0 += block)
+              {
+                const std::size_t c1 = std::min(cols, c0 + block);
+                for (std::size_t c = c0; c < c1; ++c)
+                  for (std::size_t r = r0; r < r1; ++r)
+                    dest[(c * destld) + r] = src[(r * srcld) + c];
+              }
+          }
+      }
+
+      /**
+       * Check if two arrays differ only in subchannel interleaving.
+       *
+       * This is the case for buffers of the same shape and
+       * dimension order, one created with interleaved and the other
+       * with planar storage order (see
+       * PixelBufferBase::make_storage_order()).  Each plane of
+       * pixels and samples is then a matrix transpose of the other.
+       *
+       * @param dest the destination array.
+       * @param src the source array.
+       * @param rows set to the number of rows of each source plane.
+       * @param cols set to the number of columns of each source plane.
+       * @returns @c true if the layouts are transposed, @c false otherwise.
+       */
+      template<typename A, typename B>
+      inline bool
+      subchannel_transposed(const A&      dest,
+                            const B&      src,
+                            std::size_t&  rows,
+                            std::size_t&  cols)
+      {
+        if (dest.num_dimensions() != 9U || src.num_dimensions() != 9U ||
+            !std::equal(dest.shape(), dest.shape() + 9U, src.shape()))
+          return false;
+
+        for (std::size_t i = 0; i < 9U; ++i)
+          if (!dest.storage_order().ascending(i) || !src.storage_order().ascending(i) ||
+              (i > 2U && dest.storage_order().ordering(i) != src.storage_order().ordering(i)))
+            return false;
+
+        const bool src_interleaved = (src.storage_order().ordering(0) == DIM_SUBCHANNEL &&
+                                      src.storage_order().ordering(1) == DIM_SPATIAL_X &&
+                                      src.storage_order().ordering(2) == DIM_SPATIAL_Y);
+        const bool src_planar = (src.storage_order().ordering(0) == DIM_SPATIAL_X &&
+                                 src.storage_order().ordering(1) == DIM_SPATIAL_Y &&
+                                 src.storage_order().ordering(2) == DIM_SUBCHANNEL);
+        const bool dest_interleaved = (dest.storage_order().ordering(0) == DIM_SUBCHANNEL &&
+                                       dest.storage_order().ordering(1) == DIM_SPATIAL_X &&
+                                       dest.storage_order().ordering(2) == DIM_SPATIAL_Y);
+        const bool dest_planar = (dest.storage_order().ordering(0) == DIM_SPATIAL_X &&
+                                  dest.storage_order().ordering(1) == DIM_SPATIAL_Y &&
+                                  dest.storage_order().ordering(2) == DIM_SUBCHANNEL);
+
+        const std::size_t pixels = src.shape()[DIM_SPATIAL_X] * src.shape()[DIM_SPATIAL_Y];
+        const std::size_t samples = src.shape()[DIM_SUBCHANNEL];
+
+        if (src_interleaved && dest_planar)
+          {
+            rows = pixels;
+            cols = samples;
+            return true;
+          }
+        if (src_planar && dest_interleaved)
+          {
+            rows = samples;
+            cols = pixels;
+            return true;
+          }
+        return false;
+      }
+
+    }
+
+    /**
+     * A row of pixels in a pixel buffer or pixel buffer view.
+     *
+     * This is obtained with PixelBuffer::row() or
+     * PixelBufferView::row(), and permits a whole row, or with
+     * ystride a whole plane, to be accessed with pointer arithmetic
+     * rather than computing a multi-dimensional index for each
+     * pixel with @c at().  Subchannel @c s of the pixel in column
+     * @c x is at <tt>data[x * xstride + s * sstride]</tt>, relative
+     * to the subchannel of the row, and the same pixel in the
+     * following row is @c ystride elements later.
+     */
+    template<typename T>
+    struct PixelRow
+    {
+      /// The first pixel of the row.
+      T *data;
+      /// The number of pixels in the row.
+      PixelBufferBase::size_type width;
+      /// The stride between pixels, in elements.
+      PixelBufferBase::index xstride;
+      /// The stride between subchannels, in elements.
+      PixelBufferBase::index sstride;
+      /// The stride between rows, in elements.
+      PixelBufferBase::index ystride;
+
+      /**
+       * Check if the samples of the row are contiguous.
+       *
+       * @param samples the number of subchannels of each pixel to
+       * include.
+       * @returns @c true if the @c width × @c samples elements
+       * starting at @c data are the samples of the row in order,
+       * or @c false otherwise.
+       */
+      bool
+      contiguous(PixelBufferBase::size_type samples) const
+      {
+        return (xstride == static_cast<PixelBufferBase::index>(samples) &&
+                (samples == 1U || sstride == 1));
+      }
+    };
+
     /**
      * Buffer for a specific pixel type.
      *
@@ -260,29 +573,39 @@ namespace ome
       explicit PixelBuffer():
         PixelBufferBase(::ome::xml::model::enums::PixelType::UINT8, ENDIAN_NATIVE),
         multiarray(std::shared_ptr<array_type>(new array_type(boost::extents[1][1][1][1][1][1][1][1][1],
-                                                              PixelBufferBase::default_storage_order())))
+                                                              PixelBufferBase::default_storage_order()))),
+        pixelstorage(),
+        pixelallocator()
       {}
 
       /**
        * Construct from extents (internal storage).
        *
-       * Storage for the buffer will be allocated internally.
+       * Storage for the buffer will be allocated internally, using
+       * the specified allocator if not null.
        *
        * @param extents the extent of each dimension.
        * @param pixeltype the pixel type to store.
        * @param endiantype the required endianness of the pixel type.
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
+       * @param allocator the storage allocator, or null to use the
+       * default @c multi_array storage.
        */
       template<class ExtentList>
       explicit
-      PixelBuffer(const ExtentList&                   extents,
-                  ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
-                  EndianType                          endiantype = ENDIAN_NATIVE,
-                  const storage_order_type&           storage = PixelBufferBase::default_storage_order()):
+      PixelBuffer(const ExtentList&                            extents,
+                  ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                  EndianType                                   endiantype = ENDIAN_NATIVE,
+                  const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                  const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>()):
         PixelBufferBase(pixeltype, endiantype),
-        multiarray(std::shared_ptr<array_type>(new array_type(extents, storage)))
-      {}
+        multiarray(),
+        pixelstorage(),
+        pixelallocator(allocator)
+      {
+        allocate(extents, storage);
+      }
 
       /**
        * Construct from extents (external storage).
@@ -306,28 +629,82 @@ namespace ome
                   EndianType                           endiantype = ENDIAN_NATIVE,
                   const storage_order_type&            storage = PixelBufferBase::default_storage_order()):
         PixelBufferBase(pixeltype, endiantype),
-        multiarray(std::shared_ptr<array_ref_type>(new array_ref_type(pixeldata, extents, storage)))
+        multiarray(std::shared_ptr<array_ref_type>(new array_ref_type(pixeldata, extents, storage))),
+        pixelstorage(),
+        pixelallocator()
       {}
 
+      /**
+       * Construct from extents or ranges (shared storage).
+       *
+       * The buffer will reference the start of the provided storage,
+       * and will keep it alive for the lifetime of this object.  The
+       * pixel values are value-initialised, as for internal storage.
+       * This permits storage to be reused for buffers of differing
+       * type and shape.
+       *
+       * @param sharedstorage the storage for pixel data; this must be
+       * suitably aligned for @c value_type.
+       * @param size the size of the storage (bytes).
+       * @param extents the extent or range of each dimension.
+       * @param pixeltype the pixel type to store.
+       * @param endiantype the required endianness of the pixel type.
+       * @param storage the storage ordering, defaulting to C array
+       * storage ordering.
+       * @param allocator the allocator the storage was obtained
+       * from, if any.
+       * @throws std::logic_error if the storage is too small.
+       */
+      template<class ExtentList>
+      explicit
+      PixelBuffer(const std::shared_ptr<void>&                 sharedstorage,
+                  dimension_size_type                          size,
+                  const ExtentList&                            extents,
+                  ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                  EndianType                                   endiantype = ENDIAN_NATIVE,
+                  const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                  const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>()):
+        PixelBufferBase(pixeltype, endiantype),
+        multiarray(),
+        pixelstorage(sharedstorage),
+        pixelallocator(allocator)
+      {
+        const dimension_size_type required = storage_size(extents);
+        if (!sharedstorage || required > size)
+          throw std::logic_error("PixelBuffer storage too small for extents");
+
+        value_type *data = static_cast<value_type *>(sharedstorage.get());
+        initialise(data, required / sizeof(value_type));
+        multiarray = std::shared_ptr<array_ref_type>(new array_ref_type(data, extents, storage));
+      }
+
       /**
        * Construct from ranges (internal storage).
        *
-       * Storage for the buffer will be allocated internally.
+       * Storage for the buffer will be allocated internally, using
+       * the specified allocator if not null.
        *
        * @param range the range of each dimension.
        * @param pixeltype the pixel type to store.
        * @param endiantype the required endianness of the pixel type.
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
+       * @param allocator the storage allocator, or null to use the
+       * default @c multi_array storage.
        */
       explicit
-      PixelBuffer(const range_type&                   range,
-                  ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
-                  EndianType                          endiantype = ENDIAN_NATIVE,
-                  const storage_order_type&           storage = PixelBufferBase::default_storage_order()):
+      PixelBuffer(const range_type&                            range,
+                  ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                  EndianType                                   endiantype = ENDIAN_NATIVE,
+                  const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                  const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>()):
         PixelBufferBase(pixeltype, endiantype),
-        multiarray(std::shared_ptr<array_type>(new array_type(range, storage)))
-      {}
+        multiarray(),
+        pixelstorage(),
+        pixelallocator(allocator)
+      {
+        allocate(range, storage);
+      }
 
       /**
        * Construct from ranges (external storage).
@@ -350,7 +727,9 @@ namespace ome
                   EndianType                           endiantype = ENDIAN_NATIVE,
                   const storage_order_type&            storage = PixelBufferBase::default_storage_order()):
         PixelBufferBase(pixeltype, endiantype),
-        multiarray(std::shared_ptr<array_ref_type>(new array_ref_type(pixeldata, range, storage)))
+        multiarray(std::shared_ptr<array_ref_type>(new array_ref_type(pixeldata, range, storage))),
+        pixelstorage(),
+        pixelallocator()
       {}
 
       /**
@@ -364,13 +743,29 @@ namespace ome
       explicit
       PixelBuffer(const PixelBuffer& buffer):
         PixelBufferBase(buffer),
-        multiarray(buffer.multiarray)
+        multiarray(buffer.multiarray),
+        pixelstorage(buffer.pixelstorage),
+        pixelallocator(buffer.pixelallocator)
       {}
 
       /// Destructor.
       virtual ~PixelBuffer()
       {}
 
+      /**
+       * Get the storage size required for a buffer.
+       *
+       * @param extents the extent or range of each dimension.
+       * @returns the storage size (bytes).
+       */
+      template<class ExtentList>
+      static dimension_size_type
+      storage_size(const ExtentList& extents)
+      {
+        const array_ref_type sizing(static_cast<value_type *>(nullptr), extents);
+        return sizing.num_elements() * sizeof(value_type);
+      }
+
       /**
        * Get the pixel data.
        *
@@ -448,12 +843,16 @@ namespace ome
        * Check if the buffer is internally managed.
        *
        * @returns @c true if the @c MultiArray data is managed
-       * internally (i.e. is a @c multi_array) or @c false if not
-       * managed (i.e. is a @c multi_array_ref).
+       * internally (i.e. is a @c multi_array, or uses storage from
+       * an allocator) or @c false if not managed (i.e. is a @c
+       * multi_array_ref over external storage).
        */
       bool
       managed() const
       {
+        if (pixelstorage)
+          return true;
+
         bool managed = true;
         try
           {
@@ -466,6 +865,18 @@ namespace ome
         return managed;
       }
 
+      /**
+       * Get the storage allocator.
+       *
+       * @returns the allocator, or null if the default @c
+       * multi_array storage or external storage is used.
+       */
+      const std::shared_ptr<PixelBufferAllocator>&
+      allocator() const
+      {
+        return pixelallocator;
+      }
+
       /**
        * Get the number of pixel elements in the multi-dimensional array.
        *
@@ -568,8 +979,7 @@ namespace ome
       PixelBuffer&
       operator = (const PixelBuffer& rhs)
       {
-        array() = rhs.array();
-        return *this;
+        return *this = rhs.array();
       }
 
       /**
@@ -577,7 +987,10 @@ namespace ome
        *
        * The dimension extents must be compatible, but the storage
        * ordering does not.  The buffer contents will be assigned in
-       * the logical order rather than the storage order.
+       * the logical order rather than the storage order.  Buffers
+       * differing only in the interleaving of samples (see
+       * make_storage_order()) are converted by transposing each
+       * plane.
        *
        * @param rhs the pixel buffer to assign.
        * @returns the assigned buffer.
@@ -585,7 +998,25 @@ namespace ome
       PixelBuffer&
       operator = (const array_ref_type& rhs)
       {
-        array() = rhs;
+        array_ref_type& lhs(array());
+        std::size_t rows, cols;
+        // Copy as a contiguous block if the layout matches.
+        if (detail::same_layout(lhs, rhs))
+          {
+            if (lhs.data() != rhs.data())
+              std::copy(rhs.data(), rhs.data() + rhs.num_elements(), lhs.data());
+          }
+        // Transpose each plane if only the sample interleaving differs.
+        else if (detail::subchannel_transposed(lhs, rhs, rows, cols))
+          {
+            const std::size_t plane = rows * cols;
+            for (std::size_t offset = 0; plane && offset < rhs.num_elements(); offset += plane)
+              detail::transpose(rhs.data() + offset, cols,
+                                lhs.data() + offset, rows,
+                                rows, cols);
+          }
+        else
+          lhs = rhs;
         return *this;
       }
 
@@ -598,7 +1029,7 @@ namespace ome
       bool
       operator == (const PixelBuffer& rhs) const
       {
-        return array() == rhs.array();
+        return *this == rhs.array();
       }
 
       /**
@@ -610,7 +1041,11 @@ namespace ome
       bool
       operator == (const array_ref_type& rhs) const
       {
-        return array() == rhs;
+        const array_ref_type& lhs(array());
+        // Compare as a contiguous block if the layout matches.
+        if (detail::same_layout(lhs, rhs))
+          return detail::contiguous_equal(lhs.data(), rhs.data(), lhs.num_elements());
+        return lhs == rhs;
       }
 
       /**
@@ -622,7 +1057,7 @@ namespace ome
       bool
       operator != (const PixelBuffer& rhs) const
       {
-        return array() != rhs.array();
+        return !(*this == rhs.array());
       }
 
       /**
@@ -634,7 +1069,7 @@ namespace ome
       bool
       operator != (const array_ref_type& rhs) const
       {
-        return array() != rhs;
+        return !(*this == rhs);
       }
 
       /**
@@ -746,7 +1181,8 @@ namespace ome
       assign(InputIterator begin,
              InputIterator end)
       {
-        array().assign(begin, end);
+        assign_range(begin, end,
+                     typename std::iterator_traits<InputIterator>::iterator_category());
       }
 
       /**
@@ -781,6 +1217,63 @@ namespace ome
         return array()(indices);
       }
 
+      /**
+       * Get a row of pixels.
+       *
+       * The row starts at column zero of the specified row, plane,
+       * channel and subchannel; the modulo dimensions are zero.  The
+       * index is computed once for the whole row, rather than for
+       * each pixel as with at().
+       *
+       * @note The position is not checked; take care to ensure it
+       * is always valid.
+       *
+       * @param y the row.
+       * @param z the Z plane.
+       * @param t the timepoint.
+       * @param c the channel.
+       * @param subchannel the subchannel.
+       * @returns the row.
+       */
+      PixelRow<value_type>
+      row(index y,
+          index z = 0,
+          index t = 0,
+          index c = 0,
+          index subchannel = 0)
+      {
+        const index *s = strides();
+        PixelRow<value_type> r{array().origin() +
+                               (y * s[DIM_SPATIAL_Y]) + (z * s[DIM_SPATIAL_Z]) +
+                               (t * s[DIM_TEMPORAL_T]) + (c * s[DIM_CHANNEL]) +
+                               (subchannel * s[DIM_SUBCHANNEL]),
+                               shape()[DIM_SPATIAL_X],
+                               s[DIM_SPATIAL_X], s[DIM_SUBCHANNEL], s[DIM_SPATIAL_Y]};
+        return r;
+      }
+
+      /**
+       * Get a row of pixels.
+       *
+       * @copydetails row(index,index,index,index,index)
+       */
+      PixelRow<const value_type>
+      row(index y,
+          index z = 0,
+          index t = 0,
+          index c = 0,
+          index subchannel = 0) const
+      {
+        const index *s = strides();
+        PixelRow<const value_type> r{array().origin() +
+                                     (y * s[DIM_SPATIAL_Y]) + (z * s[DIM_SPATIAL_Z]) +
+                                     (t * s[DIM_TEMPORAL_T]) + (c * s[DIM_CHANNEL]) +
+                                     (subchannel * s[DIM_SUBCHANNEL]),
+                                     shape()[DIM_SPATIAL_X],
+                                     s[DIM_SPATIAL_X], s[DIM_SUBCHANNEL], s[DIM_SPATIAL_Y]};
+        return r;
+      }
+
       /**
        * Read raw pixel data from a stream in physical storage order.
        *
@@ -818,6 +1311,99 @@ namespace ome
       }
 
     private:
+      /**
+       * Assign pixel values from an input range.
+       *
+       * Values are copied one at a time until either the range or
+       * the buffer is exhausted.
+       *
+       * @param begin the start of the range to assign.
+       * @param end the end of the range to assign.
+       */
+      template <typename InputIterator>
+      void
+      assign_range(InputIterator begin,
+                   InputIterator end,
+                   std::input_iterator_tag)
+      {
+        array().assign(begin, end);
+      }
+
+      /**
+       * Assign pixel values from a random access range.
+       *
+       * The values are copied with std::copy, which uses a block
+       * copy for contiguous ranges of the same type.
+       *
+       * @param begin the start of the range to assign.
+       * @param end the end of the range to assign.
+       */
+      template <typename RandomAccessIterator>
+      void
+      assign_range(RandomAccessIterator begin,
+                   RandomAccessIterator end,
+                   std::random_access_iterator_tag)
+      {
+        typedef typename std::iterator_traits<RandomAccessIterator>::difference_type difference_type;
+        const difference_type count = std::min(end - begin,
+                                               static_cast<difference_type>(num_elements()));
+        if (count > 0)
+          std::copy(begin, begin + count, data());
+      }
+
+      /**
+       * Allocate the multi-dimensional pixel array.
+       *
+       * If an allocator is set, the array references storage
+       * obtained from the allocator, otherwise it is a @c
+       * multi_array.
+       *
+       * @param extents the extent or range of each dimension.
+       * @param storage the storage ordering.
+       */
+      template<class ExtentList>
+      void
+      allocate(const ExtentList&         extents,
+               const storage_order_type& storage)
+      {
+        if (!pixelallocator)
+          {
+            std::shared_ptr<array_type> array(new array_type(extents, storage));
+            AllocationStatistics::record(AllocationStatistics::PIXEL_BUFFER,
+                                         array->num_elements() * sizeof(value_type));
+            multiarray = array;
+            return;
+          }
+
+        const dimension_size_type size = storage_size(extents);
+        AllocationStatistics::record(AllocationStatistics::PIXEL_BUFFER, size);
+
+        std::shared_ptr<PixelBufferAllocator> alloc(pixelallocator);
+        value_type *data = static_cast<value_type *>(alloc->allocate(size));
+        initialise(data, size / sizeof(value_type));
+
+        pixelstorage = std::shared_ptr<void>(data,
+                                             [alloc, size](void *ptr)
+                                             {
+                                               alloc->deallocate(ptr, size);
+                                             });
+        multiarray = std::shared_ptr<array_ref_type>(new array_ref_type(data, extents, storage));
+      }
+
+      /**
+       * Value-initialise storage, as for @c multi_array.
+       *
+       * @param data the storage to initialise.
+       * @param count the number of elements to initialise.
+       */
+      static void
+      initialise(value_type          *data,
+                 dimension_size_type  count)
+      {
+        for (dimension_size_type i = 0; i < count; ++i)
+          new (data + i) value_type();
+      }
+
       /**
        * Multi-dimensional pixel array.  This may be either a @c
        * multi_array containing the data directly, or a @c
@@ -835,6 +1421,15 @@ namespace ome
        */
       ome::compat::variant<std::shared_ptr<array_type>,
                            std::shared_ptr<array_ref_type>> multiarray;
+
+      /**
+       * Storage obtained from an allocator or shared with other
+       * buffers, referenced by @c multiarray, or null if not used.
+       */
+      std::shared_ptr<void> pixelstorage;
+
+      /// Storage allocator, or null if not using an allocator.
+      std::shared_ptr<PixelBufferAllocator> pixelallocator;
     };
 
     namespace detail
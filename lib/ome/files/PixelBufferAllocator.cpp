@@ -0,0 +1,315 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <new>
+
+#ifdef __linux__
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+#include <ome/files/PixelBufferAllocator.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      // System heap.
+      class StandardAllocator : public PixelBufferAllocator
+      {
+      public:
+        StandardAllocator():
+          PixelBufferAllocator()
+        {
+        }
+
+        virtual
+        ~StandardAllocator()
+        {
+        }
+
+        void *
+        allocate(dimension_size_type size)
+        {
+          return ::operator new(static_cast<std::size_t>(size));
+        }
+
+        void
+        deallocate(void                *ptr,
+                   dimension_size_type  /* size */)
+        {
+          ::operator delete(ptr);
+        }
+      };
+
+      // Directly mapped memory, optionally using huge pages and
+      // bound to a NUMA node.  Falls back to the system heap on
+      // platforms without mmap.
+      class MappedAllocator : public PixelBufferAllocator
+      {
+      public:
+        MappedAllocator(bool hugepages,
+                        int  node):
+          PixelBufferAllocator(),
+          hugepages(hugepages),
+          node(node)
+        {
+        }
+
+        virtual
+        ~MappedAllocator()
+        {
+        }
+
+        void *
+        allocate(dimension_size_type size)
+        {
+#ifdef __linux__
+          if (!size)
+            size = 1U;
+          void *ptr = mmap(nullptr, static_cast<std::size_t>(size),
+                           PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+          if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+
+# ifdef MADV_HUGEPAGE
+          if (hugepages)
+            madvise(ptr, static_cast<std::size_t>(size), MADV_HUGEPAGE);
+# endif // MADV_HUGEPAGE
+
+# ifdef SYS_mbind
+          if (node >= 0 &&
+              static_cast<unsigned int>(node) < sizeof(unsigned long) * 8U)
+            {
+              // MPOL_BIND from <numaif.h>, which is not always
+              // installed; the binding is advisory, so failure is
+              // not an error.
+              const int mpol_bind = 2;
+              unsigned long nodemask = 1UL << node;
+              syscall(SYS_mbind, ptr, static_cast<unsigned long>(size), mpol_bind,
+                      &nodemask, static_cast<unsigned long>(sizeof(nodemask) * 8U), 0U);
+            }
+# endif // SYS_mbind
+
+          return ptr;
+#else // ! __linux__
+          return ::operator new(static_cast<std::size_t>(size));
+#endif // __linux__
+        }
+
+        void
+        deallocate(void                *ptr,
+                   dimension_size_type  size)
+        {
+#ifdef __linux__
+          if (!size)
+            size = 1U;
+          munmap(ptr, static_cast<std::size_t>(size));
+#else // ! __linux__
+          ::operator delete(ptr);
+#endif // __linux__
+        }
+
+      private:
+        bool hugepages;
+        int  node;
+      };
+
+      class PixelBufferPoolAllocatorConcrete : public PixelBufferPoolAllocator
+      {
+      public:
+        PixelBufferPoolAllocatorConcrete(const std::shared_ptr<PixelBufferAllocator>& upstream,
+                                         dimension_size_type                          limit):
+          PixelBufferPoolAllocator(upstream, limit)
+        {
+        }
+
+        virtual
+        ~PixelBufferPoolAllocatorConcrete()
+        {
+        }
+      };
+
+    }
+
+    PixelBufferAllocator::PixelBufferAllocator()
+    {
+    }
+
+    PixelBufferAllocator::~PixelBufferAllocator()
+    {
+    }
+
+    const std::shared_ptr<PixelBufferAllocator>&
+    PixelBufferAllocator::standard()
+    {
+      static const std::shared_ptr<PixelBufferAllocator> allocator(std::make_shared<StandardAllocator>());
+      return allocator;
+    }
+
+    const std::shared_ptr<PixelBufferAllocator>&
+    PixelBufferAllocator::hugePages()
+    {
+      static const std::shared_ptr<PixelBufferAllocator> allocator(std::make_shared<MappedAllocator>(true, -1));
+      return allocator;
+    }
+
+    std::shared_ptr<PixelBufferAllocator>
+    PixelBufferAllocator::numaNode(unsigned int node,
+                                   bool         hugepages)
+    {
+      return std::make_shared<MappedAllocator>(hugepages, static_cast<int>(node));
+    }
+
+    const dimension_size_type PixelBufferPoolAllocator::default_limit;
+
+    PixelBufferPoolAllocator::PixelBufferPoolAllocator(const std::shared_ptr<PixelBufferAllocator>& upstream,
+                                                       dimension_size_type                          limit):
+      PixelBufferAllocator(),
+      upstream(upstream),
+      mutex(),
+      limit(limit),
+      retained(0U),
+      blocks()
+    {
+    }
+
+    PixelBufferPoolAllocator::~PixelBufferPoolAllocator()
+    {
+      clear();
+    }
+
+    std::shared_ptr<PixelBufferPoolAllocator>
+    PixelBufferPoolAllocator::create(const std::shared_ptr<PixelBufferAllocator>& upstream,
+                                     dimension_size_type                          limit)
+    {
+      return std::make_shared<PixelBufferPoolAllocatorConcrete>(upstream, limit);
+    }
+
+    void *
+    PixelBufferPoolAllocator::allocate(dimension_size_type size)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto found = blocks.find(size);
+        if (found != blocks.end() && !found->second.empty())
+          {
+            void *ptr = found->second.back();
+            found->second.pop_back();
+            if (found->second.empty())
+              blocks.erase(found);
+            retained -= size;
+            return ptr;
+          }
+      }
+
+      return upstream->allocate(size);
+    }
+
+    void
+    PixelBufferPoolAllocator::deallocate(void                *ptr,
+                                         dimension_size_type  size)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (retained + size <= limit)
+          {
+            blocks[size].push_back(ptr);
+            retained += size;
+            return;
+          }
+      }
+
+      upstream->deallocate(ptr, size);
+    }
+
+    void
+    PixelBufferPoolAllocator::setLimit(dimension_size_type limit)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->limit = limit;
+      trim();
+    }
+
+    dimension_size_type
+    PixelBufferPoolAllocator::getLimit() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return limit;
+    }
+
+    dimension_size_type
+    PixelBufferPoolAllocator::size() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return retained;
+    }
+
+    void
+    PixelBufferPoolAllocator::clear()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      dimension_size_type oldlimit = limit;
+      limit = 0U;
+      trim();
+      limit = oldlimit;
+    }
+
+    void
+    PixelBufferPoolAllocator::trim()
+    {
+      while (retained > limit && !blocks.empty())
+        {
+          auto largest = --blocks.end();
+          upstream->deallocate(largest->second.back(), largest->first);
+          retained -= largest->first;
+          largest->second.pop_back();
+          if (largest->second.empty())
+            blocks.erase(largest);
+        }
+    }
+
+  }
+}
@@ -0,0 +1,260 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_PIXELBUFFERALLOCATOR_H
+#define OME_FILES_PIXELBUFFERALLOCATOR_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Storage allocator for pixel buffers.
+     *
+     * By default, PixelBuffer storage is allocated by its @c
+     * multi_array.  An allocator may be used instead to control the
+     * placement of large buffers, for example to back them with
+     * transparent huge pages to reduce page fault and TLB costs, to
+     * bind them to a NUMA node close to the threads which will
+     * process them, or to reuse released buffers from a pool.
+     *
+     * Allocators are shared by the buffers they allocate, and so
+     * will outlive them.  All allocators provided here are
+     * thread-safe.
+     */
+    class PixelBufferAllocator
+    {
+    protected:
+      /// Constructor.
+      PixelBufferAllocator();
+
+    public:
+      /// Destructor.
+      virtual
+      ~PixelBufferAllocator();
+
+      /// @cond SKIP
+      PixelBufferAllocator (const PixelBufferAllocator&) = delete;
+
+      PixelBufferAllocator&
+      operator= (const PixelBufferAllocator&) = delete;
+      /// @endcond SKIP
+
+      /**
+       * Allocate storage.
+       *
+       * The storage is suitably aligned for any pixel type.  Its
+       * contents are unspecified.
+       *
+       * @param size the size of the storage (bytes).
+       * @returns the allocated storage.
+       * @throws std::bad_alloc if the allocation failed.
+       */
+      virtual
+      void *
+      allocate(dimension_size_type size) = 0;
+
+      /**
+       * Deallocate storage.
+       *
+       * @param ptr the storage to deallocate, previously returned
+       * by allocate().
+       * @param size the size of the storage (bytes), as passed to
+       * allocate().
+       */
+      virtual
+      void
+      deallocate(void                *ptr,
+                 dimension_size_type  size) = 0;
+
+      /**
+       * Get an allocator using the system heap.
+       *
+       * @returns the allocator.
+       */
+      static
+      const std::shared_ptr<PixelBufferAllocator>&
+      standard();
+
+      /**
+       * Get an allocator using transparent huge pages.
+       *
+       * Storage is mapped directly and marked as eligible for
+       * transparent huge pages.  Where this is not supported, the
+       * system heap is used.
+       *
+       * @returns the allocator.
+       */
+      static
+      const std::shared_ptr<PixelBufferAllocator>&
+      hugePages();
+
+      /**
+       * Create an allocator using memory on a specific NUMA node.
+       *
+       * Storage is mapped directly and bound to the specified node.
+       * Where this is not supported, or the node does not exist,
+       * the binding is skipped and the storage is placed by the
+       * system default policy.
+       *
+       * @param node the NUMA node index.
+       * @param hugepages @c true to also use transparent huge pages.
+       * @returns the allocator.
+       */
+      static
+      std::shared_ptr<PixelBufferAllocator>
+      numaNode(unsigned int node,
+               bool         hugepages = false);
+    };
+
+    /**
+     * Pool allocator for pixel buffers.
+     *
+     * Released storage is retained for reuse, grouped by size, since
+     * buffers for the planes of an image are typically of the same
+     * size; an allocation is only satisfied by retained storage of
+     * exactly the requested size.  The total size of retained
+     * storage is bounded; storage released when the limit is reached
+     * is returned to the upstream allocator.
+     */
+    class PixelBufferPoolAllocator : public PixelBufferAllocator
+    {
+    protected:
+      /**
+       * Constructor.
+       *
+       * @param upstream the allocator to obtain storage from.
+       * @param limit the maximum total size of retained storage (bytes).
+       */
+      PixelBufferPoolAllocator(const std::shared_ptr<PixelBufferAllocator>& upstream,
+                               dimension_size_type                          limit);
+
+    public:
+      /// Destructor.
+      virtual
+      ~PixelBufferPoolAllocator();
+
+      /**
+       * Create a pool allocator.
+       *
+       * @param upstream the allocator to obtain storage from.
+       * @param limit the maximum total size of retained storage (bytes).
+       * @returns the allocator.
+       */
+      static
+      std::shared_ptr<PixelBufferPoolAllocator>
+      create(const std::shared_ptr<PixelBufferAllocator>& upstream = PixelBufferAllocator::standard(),
+             dimension_size_type                          limit = default_limit);
+
+      // Documented in superclass.
+      void *
+      allocate(dimension_size_type size);
+
+      // Documented in superclass.
+      void
+      deallocate(void                *ptr,
+                 dimension_size_type  size);
+
+      /**
+       * Set the maximum total size of retained storage.
+       *
+       * @param limit the limit (bytes).
+       */
+      void
+      setLimit(dimension_size_type limit);
+
+      /**
+       * Get the maximum total size of retained storage.
+       *
+       * @returns the limit (bytes).
+       */
+      dimension_size_type
+      getLimit() const;
+
+      /**
+       * Get the total size of retained storage.
+       *
+       * @returns the size (bytes).
+       */
+      dimension_size_type
+      size() const;
+
+      /**
+       * Free all retained storage.
+       */
+      void
+      clear();
+
+      /// Default limit for retained storage (bytes).
+      static const dimension_size_type default_limit = 1024U * 1024U * 1024U;
+
+    private:
+      /// Free retained storage until within the limit (mutex held).
+      void
+      trim();
+
+      /// Allocator to obtain storage from.
+      std::shared_ptr<PixelBufferAllocator> upstream;
+      /// Mutex serialising access to the pool.
+      mutable std::mutex mutex;
+      /// Maximum total size of retained storage.
+      dimension_size_type limit;
+      /// Total size of retained storage.
+      dimension_size_type retained;
+      /// Retained storage, by size.
+      std::map<dimension_size_type, std::vector<void *>> blocks;
+    };
+
+  }
+}
+
+#endif // OME_FILES_PIXELBUFFERALLOCATOR_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
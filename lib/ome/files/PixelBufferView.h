@@ -0,0 +1,248 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_PIXELBUFFERVIEW_H
+#define OME_FILES_PIXELBUFFERVIEW_H
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/PixelBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * View of a subset of a PixelBuffer.
+     *
+     * The view refers to a block of pixel data by its origin,
+     * extents and strides, in the same logical dimension order as
+     * PixelBuffer.  It does not own or copy the pixel data, so it may
+     * describe a crop or a subchannel of a larger buffer without any
+     * allocation.  When created from a PixelBuffer, the buffer is
+     * kept alive for the lifetime of the view.
+     *
+     * Elements along a dimension are not necessarily contiguous;
+     * code accessing the data directly must take the strides into
+     * account.
+     */
+    template<typename T>
+    class PixelBufferView : public PixelBufferBase
+    {
+    public:
+      /// Type of pixel values.
+      typedef T value_type;
+
+      /// Size type.
+      typedef PixelBufferBase::size_type size_type;
+
+      /// Index type.
+      typedef PixelBufferBase::index index;
+
+      /// Type used to index all dimensions.
+      typedef PixelBufferBase::indices_type indices_type;
+
+      /// Extent of each dimension.
+      typedef std::array<size_type, PixelBufferBase::dimensions> extents_type;
+
+      /// Stride of each dimension, in elements.
+      typedef std::array<index, PixelBufferBase::dimensions> strides_type;
+
+      /**
+       * Construct from external storage.
+       *
+       * The storage must exist for the lifetime of this object.
+       *
+       * @param origin the address of the element at index zero.
+       * @param extents the extent of each dimension.
+       * @param strides the stride of each dimension, in elements.
+       * @param pixeltype the pixel type of the data.
+       * @param endiantype the endianness of the data.
+       */
+      PixelBufferView(value_type                          *origin,
+                      const extents_type&                  extents,
+                      const strides_type&                  strides,
+                      ::ome::xml::model::enums::PixelType  pixeltype,
+                      EndianType                           endiantype = ENDIAN_NATIVE):
+        PixelBufferBase(pixeltype, endiantype),
+        buffer(),
+        vieworigin(origin),
+        viewextents(extents),
+        viewstrides(strides)
+      {}
+
+      /**
+       * Construct from a subset of a pixel buffer.
+       *
+       * @param buffer the pixel buffer to view.
+       * @param offset the index of the first element in each dimension.
+       * @param extents the extent of each dimension.
+       * @throws std::logic_error if the subset is outside the buffer.
+       */
+      PixelBufferView(const std::shared_ptr<PixelBuffer<T>>& buffer,
+                      const indices_type&                     offset,
+                      const extents_type&                     extents):
+        PixelBufferBase(buffer->pixelType(), buffer->endianType()),
+        buffer(buffer),
+        vieworigin(),
+        viewextents(extents),
+        viewstrides()
+      {
+        const size_type *shape = buffer->shape();
+        const index *strides = buffer->strides();
+        for (uint16_t d = 0; d < PixelBufferBase::dimensions; ++d)
+          {
+            if (offset[d] < 0 ||
+                static_cast<size_type>(offset[d]) + extents[d] > shape[d])
+              {
+                boost::format fmt("PixelBufferView dimension %1% range [%2%,%3%) outside buffer extent %4%");
+                fmt % d % offset[d] % (static_cast<size_type>(offset[d]) + extents[d]) % shape[d];
+                throw std::logic_error(fmt.str());
+              }
+            viewstrides[d] = strides[d];
+          }
+        vieworigin = &buffer->at(offset);
+      }
+
+      /// Destructor.
+      virtual
+      ~PixelBufferView()
+      {}
+
+      /**
+       * Get the extent of each dimension.
+       *
+       * @returns an array of extents (size is the dimension count).
+       */
+      const size_type *
+      shape() const
+      {
+        return viewextents.data();
+      }
+
+      /**
+       * Get the stride of each dimension, in elements.
+       *
+       * @returns an array of strides (size is the dimension count).
+       */
+      const index *
+      strides() const
+      {
+        return viewstrides.data();
+      }
+
+      /**
+       * Get the number of elements in the view.
+       *
+       * @returns the element count.
+       */
+      size_type
+      num_elements() const
+      {
+        size_type count = 1U;
+        for (const auto extent : viewextents)
+          count *= extent;
+        return count;
+      }
+
+      /**
+       * Get the pixel value at an index.
+       *
+       * @note The index is not checked; take care to ensure it is
+       * always valid.
+       *
+       * @param indices the multi-dimensional index within the view.
+       * @returns a reference to the pixel value.
+       */
+      value_type&
+      at(const indices_type& indices) const
+      {
+        index offset = 0;
+        for (uint16_t d = 0; d < PixelBufferBase::dimensions; ++d)
+          offset += indices[d] * viewstrides[d];
+        return vieworigin[offset];
+      }
+
+      /**
+       * Get a row of pixels.
+       *
+       * @copydetails PixelBuffer::row(index,index,index,index,index)
+       */
+      PixelRow<value_type>
+      row(index y,
+          index z = 0,
+          index t = 0,
+          index c = 0,
+          index subchannel = 0) const
+      {
+        PixelRow<value_type> r{vieworigin +
+                               (y * viewstrides[DIM_SPATIAL_Y]) + (z * viewstrides[DIM_SPATIAL_Z]) +
+                               (t * viewstrides[DIM_TEMPORAL_T]) + (c * viewstrides[DIM_CHANNEL]) +
+                               (subchannel * viewstrides[DIM_SUBCHANNEL]),
+                               viewextents[DIM_SPATIAL_X],
+                               viewstrides[DIM_SPATIAL_X], viewstrides[DIM_SUBCHANNEL],
+                               viewstrides[DIM_SPATIAL_Y]};
+        return r;
+      }
+
+    private:
+      /// Viewed buffer (null if external storage).
+      std::shared_ptr<PixelBuffer<T>> buffer;
+      /// Address of the element at index zero.
+      value_type *vieworigin;
+      /// Extent of each dimension.
+      extents_type viewextents;
+      /// Stride of each dimension.
+      strides_type viewstrides;
+    };
+
+  }
+}
+
+#endif // OME_FILES_PIXELBUFFERVIEW_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
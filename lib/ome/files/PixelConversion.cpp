@@ -0,0 +1,113 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cmath>
+#include <stdexcept>
+
+#include <ome/files/PixelConversion.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+namespace
+{
+
+  // Value of a pixel for range computation.
+  template<typename T>
+  inline double
+  range_value(const T& v)
+  {
+    return static_cast<double>(v);
+  }
+
+  template<typename T>
+  inline double
+  range_value(const std::complex<T>& v)
+  {
+    return static_cast<double>(std::abs(v));
+  }
+
+  struct PBRangeVisitor
+  {
+    double& min;
+    double& max;
+
+    PBRangeVisitor(double& min,
+                   double& max):
+      min(min),
+      max(max)
+    {}
+
+    template <typename T>
+    void
+    operator() (const T& v)
+    {
+      if (!v)
+        throw std::runtime_error("Null pixel type");
+
+      const typename T::element_type::value_type *data = v->data();
+      const ome::files::dimension_size_type count = v->num_elements();
+      if (!count)
+        return;
+
+      min = max = range_value(data[0]);
+      for (ome::files::dimension_size_type i = 1; i < count; ++i)
+        {
+          const double value = range_value(data[i]);
+          min = std::min(min, value);
+          max = std::max(max, value);
+        }
+    }
+  };
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    PixelConversion
+    PixelConversion::normalise(const VariantPixelBuffer& buf)
+    {
+      double min = 0.0, max = 1.0;
+      PBRangeVisitor v(min, max);
+      ome::compat::visit(v, buf.vbuffer());
+      return PixelConversion(min, max);
+    }
+
+  }
+}
@@ -0,0 +1,575 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_PIXELCONVERSION_H
+#define OME_FILES_PIXELCONVERSION_H
+
+#include <algorithm>
+#include <complex>
+#include <limits>
+#include <type_traits>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    class VariantPixelBuffer;
+
+    /**
+     * Scaling policy for pixel type conversion.
+     */
+    enum ConversionScaling
+      {
+        CONVERT_CLAMP, ///< Convert values directly, clamping to the destination type range.
+        CONVERT_SCALE, ///< Scale the source type range to the destination type range.
+        CONVERT_RANGE  ///< Scale a source value range to the destination type range.
+      };
+
+    namespace detail
+    {
+
+      /**
+       * Value range of a pixel type for conversion.
+       *
+       * Integer types use their full range.  Floating point types
+       * are assumed to be normalised to the range [0,1].  Complex
+       * types use the range of their components.
+       */
+      template<typename T>
+      struct ConversionTraits
+      {
+        /// Component type.
+        typedef T component_type;
+        /// Values are integers which must be clamped and rounded.
+        static const bool integer = std::numeric_limits<T>::is_integer;
+        /// Values require double precision for exact conversion.
+        static const bool wide = !integer || sizeof(T) > 2;
+
+        /**
+         * Get the minimum value.
+         *
+         * @returns the minimum value.
+         */
+        static double
+        min()
+        {
+          return integer ? static_cast<double>(std::numeric_limits<T>::min()) : 0.0;
+        }
+
+        /**
+         * Get the maximum value.
+         *
+         * @returns the maximum value.
+         */
+        static double
+        max()
+        {
+          return integer ? static_cast<double>(std::numeric_limits<T>::max()) : 1.0;
+        }
+      };
+
+      /// Value range of a single-precision pixel type for conversion.
+      template<>
+      struct ConversionTraits<float>
+      {
+        /// Component type.
+        typedef float component_type;
+        /// Values are integers which must be clamped and rounded.
+        static const bool integer = false;
+        /// Values require double precision for exact conversion.
+        static const bool wide = false;
+
+        /**
+         * Get the minimum value.
+         *
+         * @returns the minimum value.
+         */
+        static double
+        min()
+        {
+          return 0.0;
+        }
+
+        /**
+         * Get the maximum value.
+         *
+         * @returns the maximum value.
+         */
+        static double
+        max()
+        {
+          return 1.0;
+        }
+      };
+
+      /// Value range of a complex pixel type for conversion.
+      template<typename T>
+      struct ConversionTraits<std::complex<T>> : public ConversionTraits<T>
+      {
+      };
+
+      /**
+       * Linear conversion coefficients.
+       *
+       * Destination values are computed as <tt>source × a + b</tt>,
+       * clamped to [lo, hi] for integer destination types.
+       */
+      template<typename W>
+      struct ConversionKernel
+      {
+        /// Scale factor.
+        W a;
+        /// Offset.
+        W b;
+        /// Minimum destination value.
+        W lo;
+        /// Maximum destination value.
+        W hi;
+        /// Convert to @c bool by testing for non-zero values.
+        bool nonzero;
+        /// The conversion does not change any value.
+        bool identity;
+      };
+
+      /**
+       * Working precision for a conversion.
+       *
+       * Single precision is exact for 8- and 16-bit integers, and so
+       * is used unless either type requires double precision.
+       */
+      template<typename S, typename D>
+      struct ConversionWorkType
+      {
+        /// Working type.
+        typedef typename std::conditional<ConversionTraits<S>::wide || ConversionTraits<D>::wide,
+                                          double, float>::type type;
+      };
+
+      /**
+       * Store a scaled value in an integer type.
+       *
+       * @param v the value to store.
+       * @param k the conversion coefficients.
+       * @returns the clamped and rounded value.
+       */
+      template<typename D, typename W>
+      inline
+      typename std::enable_if<std::numeric_limits<D>::is_integer && !std::is_same<D, bool>::value, D>::type
+      store(W                           v,
+            const ConversionKernel<W>&  k)
+      {
+        v = std::min(std::max((v * k.a) + k.b, k.lo), k.hi);
+        // Round half away from zero without a function call, so
+        // that the loop may be vectorised.
+        v += (v < W(0)) ? W(-0.5) : W(0.5);
+        return static_cast<D>(v);
+      }
+
+      /**
+       * Store a scaled value in a @c bool.
+       *
+       * @param v the value to store.
+       * @param k the conversion coefficients.
+       * @returns @c true if non-zero (when clamping) or at least
+       * half of the destination range (when scaling).
+       */
+      template<typename D, typename W>
+      inline
+      typename std::enable_if<std::is_same<D, bool>::value, D>::type
+      store(W                           v,
+            const ConversionKernel<W>&  k)
+      {
+        return k.nonzero ? (v != W(0)) : (((v * k.a) + k.b) >= W(0.5));
+      }
+
+      /**
+       * Store a scaled value in a floating point type.
+       *
+       * @param v the value to store.
+       * @param k the conversion coefficients.
+       * @returns the scaled value.
+       */
+      template<typename D, typename W>
+      inline
+      typename std::enable_if<!std::numeric_limits<D>::is_integer, D>::type
+      store(W                           v,
+            const ConversionKernel<W>&  k)
+      {
+        return static_cast<D>((v * k.a) + k.b);
+      }
+
+      /**
+       * Copy values of differing type (no-op).
+       *
+       * @returns @c false.
+       */
+      template<typename S, typename D>
+      inline bool
+      copy_identity(const S             * /* src */,
+                    D                   * /* dest */,
+                    dimension_size_type   /* count */)
+      {
+        return false;
+      }
+
+      /**
+       * Copy values of the same type.
+       *
+       * @param src the source values.
+       * @param dest the destination values.
+       * @param count the number of values.
+       * @returns @c true.
+       */
+      template<typename T>
+      inline bool
+      copy_identity(const T             *src,
+                    T                   *dest,
+                    dimension_size_type  count)
+      {
+        std::copy(src, src + count, dest);
+        return true;
+      }
+
+      /**
+       * Convert between real pixel types.
+       *
+       * Each pair of source and destination types has its own
+       * branch-free loop, suitable for vectorisation by the
+       * compiler.
+       */
+      template<typename S, typename D>
+      struct PixelConverter
+      {
+        /// Working type.
+        typedef typename ConversionWorkType<S, D>::type work_type;
+
+        /**
+         * Convert values.
+         *
+         * @param src the source values.
+         * @param dest the destination values.
+         * @param count the number of values.
+         * @param k the conversion coefficients.
+         */
+        static void
+        convert(const S                            *src,
+                D                                  *dest,
+                dimension_size_type                 count,
+                const ConversionKernel<work_type>&  k)
+        {
+          if (k.identity && copy_identity(src, dest, count))
+            return;
+          for (dimension_size_type i = 0; i < count; ++i)
+            dest[i] = store<D>(static_cast<work_type>(src[i]), k);
+        }
+      };
+
+      /// Convert from a complex pixel type to a real pixel type (magnitude).
+      template<typename S, typename D>
+      struct PixelConverter<std::complex<S>, D>
+      {
+        /// Working type.
+        typedef typename ConversionWorkType<S, D>::type work_type;
+
+        /**
+         * Convert values.
+         *
+         * @param src the source values.
+         * @param dest the destination values.
+         * @param count the number of values.
+         * @param k the conversion coefficients.
+         */
+        static void
+        convert(const std::complex<S>              *src,
+                D                                  *dest,
+                dimension_size_type                 count,
+                const ConversionKernel<work_type>&  k)
+        {
+          for (dimension_size_type i = 0; i < count; ++i)
+            dest[i] = store<D>(static_cast<work_type>(std::abs(src[i])), k);
+        }
+      };
+
+      /// Convert from a real pixel type to a complex pixel type.
+      template<typename S, typename D>
+      struct PixelConverter<S, std::complex<D>>
+      {
+        /// Working type.
+        typedef typename ConversionWorkType<S, D>::type work_type;
+
+        /**
+         * Convert values.
+         *
+         * @param src the source values.
+         * @param dest the destination values.
+         * @param count the number of values.
+         * @param k the conversion coefficients.
+         */
+        static void
+        convert(const S                            *src,
+                std::complex<D>                    *dest,
+                dimension_size_type                 count,
+                const ConversionKernel<work_type>&  k)
+        {
+          for (dimension_size_type i = 0; i < count; ++i)
+            dest[i] = std::complex<D>(store<D>(static_cast<work_type>(src[i]), k), D(0));
+        }
+      };
+
+      /// Convert between complex pixel types.
+      template<typename S, typename D>
+      struct PixelConverter<std::complex<S>, std::complex<D>>
+      {
+        /// Working type.
+        typedef typename ConversionWorkType<S, D>::type work_type;
+
+        /**
+         * Convert values.
+         *
+         * The offset is only applied to the real part.
+         *
+         * @param src the source values.
+         * @param dest the destination values.
+         * @param count the number of values.
+         * @param k the conversion coefficients.
+         */
+        static void
+        convert(const std::complex<S>              *src,
+                std::complex<D>                    *dest,
+                dimension_size_type                 count,
+                const ConversionKernel<work_type>&  k)
+        {
+          if (k.identity && copy_identity(src, dest, count))
+            return;
+          for (dimension_size_type i = 0; i < count; ++i)
+            dest[i] = std::complex<D>(static_cast<D>((static_cast<work_type>(src[i].real()) * k.a) + k.b),
+                                      static_cast<D>(static_cast<work_type>(src[i].imag()) * k.a));
+        }
+      };
+
+    }
+
+    /**
+     * Pixel type conversion.
+     *
+     * Values are converted linearly, using the scaling policy to
+     * choose the source value range mapped onto the destination type
+     * range.  Integer destination values are clamped and rounded to
+     * the nearest integer.  Floating point types are treated as
+     * having the range [0,1] when scaling.  Complex values are
+     * converted to real values using their magnitude; real values
+     * are converted to complex values with no imaginary part.
+     * @c bool values are @c 0 or @c 1; when clamping, conversion to
+     * @c bool tests for non-zero values, otherwise for values in the
+     * upper half of the scaled range.
+     *
+     * The conversion may be applied to raw arrays, such as tile
+     * buffers during reading, using convert(), or to whole pixel
+     * buffers using VariantPixelBuffer::convertTo().
+     */
+    class PixelConversion
+    {
+    public:
+      /**
+       * Constructor.
+       *
+       * @param scaling the scaling policy; use the range constructor
+       * for @c CONVERT_RANGE.
+       */
+      explicit
+      PixelConversion(ConversionScaling scaling = CONVERT_CLAMP):
+        scalingPolicy(scaling == CONVERT_RANGE ? CONVERT_CLAMP : scaling),
+        rangeMin(0.0),
+        rangeMax(1.0)
+      {}
+
+      /**
+       * Constructor for a source value range.
+       *
+       * The range will be mapped onto the destination type range.
+       *
+       * @param min the minimum source value.
+       * @param max the maximum source value.
+       */
+      PixelConversion(double min,
+                      double max):
+        scalingPolicy(CONVERT_RANGE),
+        rangeMin(min),
+        rangeMax(max)
+      {}
+
+      /**
+       * Create a conversion which normalises a buffer.
+       *
+       * The range of values in the buffer will be mapped onto the
+       * destination type range.
+       *
+       * @param buf the buffer to normalise.
+       * @returns the conversion.
+       */
+      static PixelConversion
+      normalise(const VariantPixelBuffer& buf);
+
+      /**
+       * Get the scaling policy.
+       *
+       * @returns the scaling policy.
+       */
+      ConversionScaling
+      scaling() const
+      {
+        return scalingPolicy;
+      }
+
+      /**
+       * Get the minimum source value (@c CONVERT_RANGE only).
+       *
+       * @returns the minimum value.
+       */
+      double
+      min() const
+      {
+        return rangeMin;
+      }
+
+      /**
+       * Get the maximum source value (@c CONVERT_RANGE only).
+       *
+       * @returns the maximum value.
+       */
+      double
+      max() const
+      {
+        return rangeMax;
+      }
+
+      /**
+       * Get the conversion coefficients for a pair of types.
+       *
+       * @returns the coefficients.
+       */
+      template<typename S, typename D>
+      detail::ConversionKernel<typename detail::ConversionWorkType<typename detail::ConversionTraits<S>::component_type,
+                                                                   typename detail::ConversionTraits<D>::component_type>::type>
+      kernel() const
+      {
+        typedef detail::ConversionTraits<S> source_traits;
+        typedef detail::ConversionTraits<D> dest_traits;
+        typedef typename detail::ConversionWorkType<typename source_traits::component_type,
+                                                    typename dest_traits::component_type>::type work_type;
+
+        double smin = 0.0, smax = 1.0;
+        const double dmin = dest_traits::min(), dmax = dest_traits::max();
+        double a = 1.0, b = 0.0;
+
+        switch (scalingPolicy)
+          {
+          case CONVERT_SCALE:
+            smin = source_traits::min();
+            smax = source_traits::max();
+            break;
+          case CONVERT_RANGE:
+            smin = rangeMin;
+            smax = rangeMax;
+            break;
+          case CONVERT_CLAMP:
+          default:
+            smin = dmin;
+            smax = dmax;
+            break;
+          }
+
+        if (smax != smin)
+          {
+            a = (dmax - dmin) / (smax - smin);
+            b = dmin - (smin * a);
+          }
+        else
+          {
+            a = 0.0;
+            b = dmin;
+          }
+
+        detail::ConversionKernel<work_type> k;
+        k.a = static_cast<work_type>(a);
+        k.b = static_cast<work_type>(b);
+        k.lo = static_cast<work_type>(dmin);
+        k.hi = static_cast<work_type>(dmax);
+        k.nonzero = (scalingPolicy == CONVERT_CLAMP);
+        k.identity = (a == 1.0 && b == 0.0);
+        return k;
+      }
+
+      /**
+       * Convert pixel values.
+       *
+       * @param src the source values.
+       * @param dest the destination values.
+       * @param count the number of values.
+       */
+      template<typename S, typename D>
+      void
+      convert(const S             *src,
+              D                   *dest,
+              dimension_size_type  count) const
+      {
+        detail::PixelConverter<S, D>::convert(src, dest, count, kernel<S, D>());
+      }
+
+    private:
+      /// Scaling policy.
+      ConversionScaling scalingPolicy;
+      /// Minimum source value.
+      double rangeMin;
+      /// Maximum source value.
+      double rangeMax;
+    };
+
+  }
+}
+
+#endif // OME_FILES_PIXELCONVERSION_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
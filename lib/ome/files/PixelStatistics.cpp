@@ -0,0 +1,215 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+#include <boost/preprocessor.hpp>
+
+#include <ome/files/PixelConversion.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PixelStatistics.h>
+
+using ::ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  // Histogram range of a pixel type.  Integer ranges include the
+  // maximum value, so that each value has its own bin when the
+  // number of bins matches the number of values.
+  template<typename T>
+  void
+  pixel_range(double& min,
+              double& max)
+  {
+    typedef ome::files::detail::ConversionTraits<T> traits;
+
+    min = traits::min();
+    max = traits::max();
+    if (traits::integer)
+      max += 1.0;
+  }
+
+  void
+  merge_sample(ome::files::PixelStatistics::Sample&       dest,
+               const ome::files::PixelStatistics::Sample& src)
+  {
+    dest.count += src.count;
+    dest.min = std::min(dest.min, src.min);
+    dest.max = std::max(dest.max, src.max);
+    dest.sum += src.sum;
+    if (dest.histogram.size() < src.histogram.size())
+      dest.histogram.resize(src.histogram.size(), 0U);
+    for (std::vector<uint64_t>::size_type i = 0; i < src.histogram.size(); ++i)
+      dest.histogram[i] += src.histogram[i];
+  }
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    // No switch default to avoid -Wunreachable-code errors.
+    // However, this then makes -Wswitch-default complain.  Disable
+    // temporarily.
+#ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+
+#define RANGE_PT_CASE(maR, maProperty, maType)                                              \
+        case PixelType::maType:                                                             \
+          pixel_range<PixelProperties< PixelType::maType>::std_type>(rangeMin, rangeMax);   \
+          break;
+
+    PixelStatistics::PixelStatistics(::ome::xml::model::enums::PixelType pixeltype,
+                                     dimension_size_type                 bins):
+      mutex(),
+      rangeMin(0.0),
+      rangeMax(1.0),
+      bins(bins),
+      stats()
+    {
+      if (!bins)
+        throw std::logic_error("Histogram bin count must not be zero");
+
+      switch(pixeltype)
+        {
+          BOOST_PP_SEQ_FOR_EACH(RANGE_PT_CASE, _, OME_XML_MODEL_ENUMS_PIXELTYPE_VALUES);
+        }
+    }
+
+#undef RANGE_PT_CASE
+
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+
+    PixelStatistics::PixelStatistics(double              min,
+                                     double              max,
+                                     dimension_size_type bins):
+      mutex(),
+      rangeMin(min),
+      rangeMax(max),
+      bins(bins),
+      stats()
+    {
+      if (!bins)
+        throw std::logic_error("Histogram bin count must not be zero");
+      if (!(min < max))
+        {
+          boost::format fmt("Invalid histogram range [%1%,%2%)");
+          fmt % min % max;
+          throw std::logic_error(fmt.str());
+        }
+    }
+
+    PixelStatistics::~PixelStatistics()
+    {
+    }
+
+    void
+    PixelStatistics::merge(const Accumulator& accumulator)
+    {
+      const std::vector<Sample>& samples(accumulator.samples());
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if (stats.size() < samples.size())
+        stats.resize(samples.size(), Sample(bins));
+      for (std::vector<Sample>::size_type s = 0; s < samples.size(); ++s)
+        merge_sample(stats[s], samples[s]);
+    }
+
+    void
+    PixelStatistics::reset()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stats.clear();
+    }
+
+    dimension_size_type
+    PixelStatistics::size() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return stats.size();
+    }
+
+    PixelStatistics::Sample
+    PixelStatistics::get(dimension_size_type sample) const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (sample < stats.size())
+        return stats[sample];
+      return Sample(bins);
+    }
+
+    PixelStatistics::Sample
+    PixelStatistics::combined() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Sample ret(bins);
+      for (const auto& s : stats)
+        merge_sample(ret, s);
+      return ret;
+    }
+
+    double
+    PixelStatistics::getRangeMin() const
+    {
+      return rangeMin;
+    }
+
+    double
+    PixelStatistics::getRangeMax() const
+    {
+      return rangeMax;
+    }
+
+    dimension_size_type
+    PixelStatistics::getBins() const
+    {
+      return bins;
+    }
+
+  }
+}
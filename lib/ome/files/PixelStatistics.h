@@ -0,0 +1,511 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+#ifndef OME_FILES_PIXELSTATISTICS_H
+#define OME_FILES_PIXELSTATISTICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include <ome/files/Types.h>
+#include <ome/files/detail/SampleStatistics.h>
+
+#include <ome/xml/model/enums/PixelType.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace detail
+    {
+
+      /**
+       * Value of a pixel for statistics.
+       *
+       * Real values are used directly.
+       *
+       * @param v the pixel value.
+       * @returns the value.
+       */
+      template<typename T>
+      inline T
+      statistic_value(const T& v)
+      {
+        return v;
+      }
+
+      /**
+       * Value of a complex pixel for statistics.
+       *
+       * Complex values use their magnitude.
+       *
+       * @param v the pixel value.
+       * @returns the magnitude.
+       */
+      template<typename T>
+      inline double
+      statistic_value(const std::complex<T>& v)
+      {
+        return static_cast<double>(std::abs(v));
+      }
+
+      /**
+       * Check if a value should be excluded from statistics.
+       *
+       * @param v the value.
+       * @returns @c true if the value is NaN, @c false otherwise.
+       */
+      template<typename V>
+      inline bool
+      statistic_skip(const V& v)
+      {
+        return std::is_floating_point<V>::value && v != v;
+      }
+
+      /**
+       * Type used to sum values of type @c V.
+       *
+       * Integer values are summed exactly using 64-bit integers;
+       * floating point values are summed as @c double.
+       */
+      template<typename V>
+      struct StatisticSumType
+      {
+        /// Sum type.
+        typedef typename std::conditional<std::is_integral<V>::value,
+                                          typename std::conditional<std::is_signed<V>::value,
+                                                                    int64_t,
+                                                                    uint64_t>::type,
+                                          double>::type type;
+      };
+
+      /**
+       * Accumulate the minimum, maximum and sum of values with a
+       * scalar loop.
+       *
+       * @param data the values.
+       * @param count the number of values.
+       * @param stride the distance between values, in elements.
+       * @param min the minimum value.
+       * @param max the maximum value.
+       * @param sum the sum of the values.
+       * @returns the number of values accumulated, excluding NaN.
+       */
+      template<typename T, typename V, typename S>
+      inline dimension_size_type
+      statistic_range_scalar(const T             *data,
+                             dimension_size_type  count,
+                             std::ptrdiff_t       stride,
+                             V&                   min,
+                             V&                   max,
+                             S&                   sum)
+      {
+        dimension_size_type n = 0U;
+        for (dimension_size_type i = 0; i < count; ++i, data += stride)
+          {
+            const V v = statistic_value(*data);
+            if (statistic_skip(v))
+              continue;
+            min = v < min ? v : min;
+            max = v > max ? v : max;
+            sum += static_cast<S>(v);
+            ++n;
+          }
+        return n;
+      }
+
+      /**
+       * Accumulate the minimum, maximum and sum of real values.
+       *
+       * Contiguous values use accumulateSamples(), which uses SIMD
+       * instructions where available.
+       *
+       * @param data the values.
+       * @param count the number of values.
+       * @param stride the distance between values, in elements.
+       * @param min the minimum value.
+       * @param max the maximum value.
+       * @param sum the sum of the values.
+       * @returns the number of values accumulated, excluding NaN.
+       */
+      template<typename T, typename S>
+      inline dimension_size_type
+      statistic_range(const T             *data,
+                      dimension_size_type  count,
+                      std::ptrdiff_t       stride,
+                      T&                   min,
+                      T&                   max,
+                      S&                   sum)
+      {
+        if (stride == 1)
+          return accumulateSamples(data, count, min, max, sum);
+        return statistic_range_scalar(data, count, stride, min, max, sum);
+      }
+
+      /**
+       * Accumulate the minimum, maximum and sum of complex values.
+       *
+       * The magnitudes are accumulated with a scalar loop.
+       *
+       * @param data the values.
+       * @param count the number of values.
+       * @param stride the distance between values, in elements.
+       * @param min the minimum magnitude.
+       * @param max the maximum magnitude.
+       * @param sum the sum of the magnitudes.
+       * @returns the number of values accumulated, excluding NaN.
+       */
+      template<typename T, typename S>
+      inline dimension_size_type
+      statistic_range(const std::complex<T> *data,
+                      dimension_size_type    count,
+                      std::ptrdiff_t         stride,
+                      double&                min,
+                      double&                max,
+                      S&                     sum)
+      {
+        return statistic_range_scalar(data, count, stride, min, max, sum);
+      }
+
+    }
+
+    /**
+     * Per-sample pixel statistics.
+     *
+     * The minimum, maximum, mean and a histogram of the pixel values
+     * are accumulated separately for each sample (subchannel).
+     * Statistics may be accumulated while pixel data is read or
+     * written, for example by setting a statistics sink with
+     * tiff::TIFF::setStatistics(), so that a second pass over the
+     * pixel data is not needed.
+     *
+     * Values are accumulated into an Accumulator, which is not
+     * thread-safe and is intended for use by a single thread over a
+     * small block of pixel data such as a tile, and then merged into
+     * the PixelStatistics under a lock.  The statistics may hence be
+     * shared between threads decoding or encoding tiles in parallel.
+     *
+     * The histogram bins divide the half-open range [min, max)
+     * equally.  Values outside the range are counted in the first or
+     * last bin.  Complex values use their magnitude.  NaN values are
+     * not counted.
+     */
+    class PixelStatistics
+    {
+    public:
+      /// Statistics for a single sample.
+      struct Sample
+      {
+        /// Number of values.
+        uint64_t count;
+        /// Minimum value (infinity if no values).
+        double min;
+        /// Maximum value (-infinity if no values).
+        double max;
+        /// Sum of values.
+        double sum;
+        /// Histogram bin counts.
+        std::vector<uint64_t> histogram;
+
+        /**
+         * Constructor.
+         *
+         * @param bins the number of histogram bins.
+         */
+        explicit
+        Sample(dimension_size_type bins = 0U):
+          count(0U),
+          min(std::numeric_limits<double>::infinity()),
+          max(-std::numeric_limits<double>::infinity()),
+          sum(0.0),
+          histogram(bins, 0U)
+        {}
+
+        /**
+         * Get the mean value.
+         *
+         * @returns the mean, or zero if there are no values.
+         */
+        double
+        mean() const
+        {
+          return count ? sum / static_cast<double>(count) : 0.0;
+        }
+      };
+
+      /**
+       * Statistics accumulator.
+       *
+       * Accumulates statistics for a block of pixel data before
+       * merging into the shared statistics with
+       * PixelStatistics::merge().
+       */
+      class Accumulator
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param stats the statistics to obtain the histogram range
+         * and bin count from.
+         */
+        explicit
+        Accumulator(const PixelStatistics& stats):
+          lo(stats.getRangeMin()),
+          scale(static_cast<double>(stats.getBins()) / (stats.getRangeMax() - stats.getRangeMin())),
+          maxbin(static_cast<double>(stats.getBins() - 1U)),
+          bins(stats.getBins()),
+          accumulated()
+        {}
+
+        /**
+         * Add pixel values.
+         *
+         * The minimum, maximum and sum of contiguous real values
+         * are accumulated with detail::accumulateSamples(), which
+         * uses SIMD instructions where available; strided and
+         * complex values use a scalar loop.  The histogram is
+         * counted in a separate scalar pass.
+         *
+         * @param sample the sample (subchannel) index.
+         * @param data the values.
+         * @param count the number of values.
+         * @param stride the distance between values, in elements.
+         */
+        template<typename T>
+        void
+        add(dimension_size_type sample,
+            const T            *data,
+            dimension_size_type count,
+            std::ptrdiff_t      stride = 1)
+        {
+          typedef decltype(detail::statistic_value(*data)) value_type;
+          typedef typename detail::StatisticSumType<value_type>::type sum_type;
+
+          if (!count)
+            return;
+
+          if (accumulated.size() <= sample)
+            accumulated.resize(sample + 1U, Sample(bins));
+          Sample& s(accumulated[sample]);
+
+          value_type vmin = std::numeric_limits<value_type>::max();
+          value_type vmax = std::numeric_limits<value_type>::lowest();
+          sum_type vsum = sum_type();
+          const uint64_t n = detail::statistic_range(data, count, stride, vmin, vmax, vsum);
+
+          uint64_t *histogram = s.histogram.data();
+          for (dimension_size_type i = 0; i < count; ++i, data += stride)
+            {
+              const value_type v = detail::statistic_value(*data);
+              if (detail::statistic_skip(v))
+                continue;
+              double bin = (static_cast<double>(v) - lo) * scale;
+              bin = bin < 0.0 ? 0.0 : bin;
+              bin = bin > maxbin ? maxbin : bin;
+              ++histogram[static_cast<dimension_size_type>(bin)];
+            }
+
+          if (n)
+            {
+              s.count += n;
+              s.min = std::min(s.min, static_cast<double>(vmin));
+              s.max = std::max(s.max, static_cast<double>(vmax));
+              s.sum += static_cast<double>(vsum);
+            }
+        }
+
+        /**
+         * Get the accumulated statistics.
+         *
+         * @returns the statistics for each sample.
+         */
+        const std::vector<Sample>&
+        samples() const
+        {
+          return accumulated;
+        }
+
+      private:
+        /// Minimum of histogram range.
+        double lo;
+        /// Histogram bins per unit value.
+        double scale;
+        /// Index of last histogram bin.
+        double maxbin;
+        /// Number of histogram bins.
+        dimension_size_type bins;
+        /// Accumulated statistics for each sample.
+        std::vector<Sample> accumulated;
+      };
+
+      /**
+       * Constructor using the range of a pixel type.
+       *
+       * Integer types use their full range, with one bin per value
+       * if the number of bins matches the number of values.
+       * Floating point and complex types use the range [0,1); set
+       * the range explicitly for unnormalised data.
+       *
+       * @param pixeltype the pixel type.
+       * @param bins the number of histogram bins.
+       * @throws std::logic_error if @p bins is zero.
+       */
+      explicit
+      PixelStatistics(::ome::xml::model::enums::PixelType pixeltype,
+                      dimension_size_type                 bins = 256U);
+
+      /**
+       * Constructor using an explicit histogram range.
+       *
+       * @param min the minimum of the histogram range.
+       * @param max the maximum of the histogram range (exclusive).
+       * @param bins the number of histogram bins.
+       * @throws std::logic_error if @p bins is zero or the range is
+       * empty.
+       */
+      PixelStatistics(double              min,
+                      double              max,
+                      dimension_size_type bins);
+
+      /// Destructor.
+      ~PixelStatistics();
+
+      /// @cond SKIP
+      PixelStatistics (const PixelStatistics&) = delete;
+
+      PixelStatistics&
+      operator= (const PixelStatistics&) = delete;
+      /// @endcond SKIP
+
+      /**
+       * Merge accumulated statistics.
+       *
+       * @param accumulator the accumulated statistics to merge.
+       */
+      void
+      merge(const Accumulator& accumulator);
+
+      /**
+       * Discard all statistics.
+       *
+       * The histogram range and bin count are unchanged.
+       */
+      void
+      reset();
+
+      /**
+       * Get the number of samples with statistics.
+       *
+       * @returns the number of samples.
+       */
+      dimension_size_type
+      size() const;
+
+      /**
+       * Get the statistics for a sample.
+       *
+       * @param sample the sample (subchannel) index.
+       * @returns the statistics; these will be empty if no values
+       * have been accumulated for the sample.
+       */
+      Sample
+      get(dimension_size_type sample) const;
+
+      /**
+       * Get the statistics combined over all samples.
+       *
+       * @returns the combined statistics.
+       */
+      Sample
+      combined() const;
+
+      /**
+       * Get the minimum of the histogram range.
+       *
+       * @returns the minimum value.
+       */
+      double
+      getRangeMin() const;
+
+      /**
+       * Get the maximum of the histogram range (exclusive).
+       *
+       * @returns the maximum value.
+       */
+      double
+      getRangeMax() const;
+
+      /**
+       * Get the number of histogram bins.
+       *
+       * @returns the number of bins.
+       */
+      dimension_size_type
+      getBins() const;
+
+    private:
+      /// Mutex serialising access to the statistics.
+      mutable std::mutex mutex;
+      /// Minimum of histogram range.
+      double rangeMin;
+      /// Maximum of histogram range (exclusive).
+      double rangeMax;
+      /// Number of histogram bins.
+      dimension_size_type bins;
+      /// Statistics for each sample.
+      std::vector<Sample> stats;
+    };
+
+  }
+}
+
+#endif // OME_FILES_PIXELSTATISTICS_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
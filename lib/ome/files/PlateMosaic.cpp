@@ -0,0 +1,381 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include <boost/format.hpp>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/Executor.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/PlateMosaic.h>
+
+#include <ome/xml/meta/MetadataException.h>
+
+using ome::files::CoreMetadata;
+using ome::files::FormatReader;
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::PlaneRegion;
+using ome::files::PlateField;
+using ome::files::PlateLayout;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+
+namespace
+{
+
+  // Zero a buffer.
+  struct ClearVisitor
+  {
+    template<typename T>
+    void
+    operator() (const std::shared_ptr<PixelBuffer<T>>& v) const
+    {
+      std::fill(v->data(), v->data() + v->num_elements(), T());
+    }
+  };
+
+  // Copy a buffer into a region of the mosaic by nearest neighbour
+  // sampling.
+  struct PlaceVisitor
+  {
+    VariantPixelBuffer& dest;
+    const PlaneRegion&  region;
+
+    PlaceVisitor(VariantPixelBuffer& dest,
+                 const PlaneRegion&  region):
+      dest(dest),
+      region(region)
+    {}
+
+    template<typename T>
+    void
+    operator() (const std::shared_ptr<PixelBuffer<T>>& v) const
+    {
+      const PixelBuffer<T>& src(*v);
+      PixelBuffer<T>& out(*ome::compat::get<std::shared_ptr<PixelBuffer<T>>>(dest.vbuffer()));
+
+      const PixelBufferBase::index *sstrides = src.strides();
+      const PixelBufferBase::index *dstrides = out.strides();
+      const dimension_size_type width = src.shape()[ome::files::DIM_SPATIAL_X];
+      const dimension_size_type height = src.shape()[ome::files::DIM_SPATIAL_Y];
+      const dimension_size_type samples = src.shape()[ome::files::DIM_SUBCHANNEL];
+
+      // Source column of each destination column (pixel centres).
+      std::vector<PixelBufferBase::index> columns(region.w);
+      for (dimension_size_type x = 0; x < region.w; ++x)
+        columns[x] = static_cast<PixelBufferBase::index>(((2U * x + 1U) * width) / (2U * region.w)) *
+          sstrides[ome::files::DIM_SPATIAL_X];
+
+      for (dimension_size_type s = 0; s < samples; ++s)
+        {
+          const T *splane = src.origin() + (sstrides[ome::files::DIM_SUBCHANNEL] *
+                                            static_cast<PixelBufferBase::index>(s));
+          T *dplane = out.array().origin() + (dstrides[ome::files::DIM_SUBCHANNEL] *
+                                              static_cast<PixelBufferBase::index>(s));
+          for (dimension_size_type y = 0; y < region.h; ++y)
+            {
+              const T *srow = splane + static_cast<PixelBufferBase::index>(((2U * y + 1U) * height) / (2U * region.h)) *
+                sstrides[ome::files::DIM_SPATIAL_Y];
+              T *drow = dplane + static_cast<PixelBufferBase::index>(region.y + y) * dstrides[ome::files::DIM_SPATIAL_Y] +
+                static_cast<PixelBufferBase::index>(region.x) * dstrides[ome::files::DIM_SPATIAL_X];
+              for (dimension_size_type x = 0; x < region.w; ++x, drow += dstrides[ome::files::DIM_SPATIAL_X])
+                *drow = srow[columns[x]];
+            }
+        }
+    }
+  };
+
+  // Core metadata of a series, from the largest resolution to the
+  // smallest.  Flattened resolutions are separate series.
+  std::vector<std::shared_ptr<CoreMetadata>>
+  series_resolutions(const FormatReader& reader,
+                     dimension_size_type series)
+  {
+    const std::vector<std::shared_ptr<CoreMetadata>>& core(reader.getCoreMetadataList());
+    dimension_size_type index = 0U;
+    dimension_size_type count = 1U;
+    if (reader.hasFlattenedResolutions())
+      index = series;
+    else
+      {
+        for (dimension_size_type s = 0U; s < series && index < core.size() && core[index]; ++s)
+          index += core[index]->resolutionCount;
+        if (index < core.size() && core[index])
+          count = core[index]->resolutionCount;
+      }
+
+    if (index >= core.size() || !core[index] || index + count > core.size())
+      {
+        boost::format fmt("Invalid series: %1%");
+        fmt % series;
+        throw std::logic_error(fmt.str());
+      }
+
+    return std::vector<std::shared_ptr<CoreMetadata>>(core.begin() + static_cast<std::ptrdiff_t>(index),
+                                                      core.begin() + static_cast<std::ptrdiff_t>(index + count));
+  }
+
+  // A field to read: the resolution to read it from, and its region
+  // in the mosaic.
+  struct FieldRead
+  {
+    dimension_size_type series;
+    dimension_size_type resolution;
+    dimension_size_type sizeX;
+    dimension_size_type sizeY;
+    PlaneRegion region;
+  };
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    PlateLayout
+    plateLayout(const ::ome::xml::meta::MetadataRetrieve& meta,
+                dimension_size_type                       plate)
+    {
+      if (plate >= meta.getPlateCount())
+        {
+          boost::format fmt("Invalid plate: %1%");
+          fmt % plate;
+          throw std::logic_error(fmt.str());
+        }
+
+      std::map<std::string, dimension_size_type> images;
+      for (dimension_size_type image = 0U; image < meta.getImageCount(); ++image)
+        images.insert(std::make_pair(meta.getImageID(image), image));
+
+      PlateLayout layout;
+      try
+        {
+          layout.rows = static_cast<dimension_size_type>(meta.getPlateRows(plate));
+        }
+      catch (const ::ome::xml::meta::MetadataException&)
+        {
+        }
+      try
+        {
+          layout.columns = static_cast<dimension_size_type>(meta.getPlateColumns(plate));
+        }
+      catch (const ::ome::xml::meta::MetadataException&)
+        {
+        }
+
+      dimension_size_type maxFields = 0U;
+      for (dimension_size_type well = 0U; well < meta.getWellCount(plate); ++well)
+        {
+          const dimension_size_type row = static_cast<dimension_size_type>(meta.getWellRow(plate, well));
+          const dimension_size_type column = static_cast<dimension_size_type>(meta.getWellColumn(plate, well));
+          layout.rows = std::max(layout.rows, row + 1U);
+          layout.columns = std::max(layout.columns, column + 1U);
+
+          const dimension_size_type samples = meta.getWellSampleCount(plate, well);
+          maxFields = std::max(maxFields, samples);
+          for (dimension_size_type sample = 0U; sample < samples; ++sample)
+            {
+              std::map<std::string, dimension_size_type>::const_iterator image = images.end();
+              try
+                {
+                  image = images.find(meta.getWellSampleImageRef(plate, well, sample));
+                }
+              catch (const ::ome::xml::meta::MetadataException&)
+                {
+                }
+              if (image == images.end())
+                continue;
+
+              PlateField field;
+              field.series = image->second;
+              field.row = row;
+              field.column = column;
+              field.field = sample;
+              layout.fields.push_back(field);
+            }
+        }
+
+      if (maxFields)
+        {
+          layout.fieldColumns = static_cast<dimension_size_type>
+            (std::ceil(std::sqrt(static_cast<double>(maxFields))));
+          layout.fieldRows = (maxFields + layout.fieldColumns - 1U) / layout.fieldColumns;
+        }
+
+      return layout;
+    }
+
+    void
+    composePlateMosaic(const FormatReader& reader,
+                       const PlateLayout&  layout,
+                       dimension_size_type plane,
+                       dimension_size_type cellSizeX,
+                       dimension_size_type cellSizeY,
+                       VariantPixelBuffer& buf)
+    {
+      if (layout.fields.empty())
+        throw std::logic_error("Plate layout has no fields");
+      if (!cellSizeX || !cellSizeY)
+        throw std::logic_error("Mosaic cell size must not be zero");
+
+      // Choose the resolution and place of every field before
+      // reading, so that all problems are found up front.
+      std::vector<FieldRead> reads;
+      reads.reserve(layout.fields.size());
+      ::ome::xml::model::enums::PixelType pixeltype(::ome::xml::model::enums::PixelType::UINT8);
+      dimension_size_type samples = 0U;
+      for (const auto& field : layout.fields)
+        {
+          if (field.row >= layout.rows || field.column >= layout.columns ||
+              field.field >= layout.fieldRows * layout.fieldColumns)
+            {
+              boost::format fmt("Field %1% of well (%2%, %3%) is outside the plate layout");
+              fmt % field.field % field.row % field.column;
+              throw std::logic_error(fmt.str());
+            }
+
+          const std::vector<std::shared_ptr<CoreMetadata>> resolutions(series_resolutions(reader, field.series));
+          const CoreMetadata& full(*resolutions.front());
+
+          if (plane >= full.imageCount)
+            {
+              boost::format fmt("Invalid plane %1% for series %2%");
+              fmt % plane % field.series;
+              throw std::logic_error(fmt.str());
+            }
+
+          const dimension_size_type fieldSamples = full.sizeC.empty() ? 1U : full.sizeC.front();
+          if (reads.empty())
+            {
+              pixeltype = full.pixelType;
+              samples = fieldSamples;
+            }
+          if (full.pixelType != pixeltype ||
+              std::count(full.sizeC.begin(), full.sizeC.end(), samples) !=
+              static_cast<std::ptrdiff_t>(full.sizeC.size()))
+            {
+              boost::format fmt("Series %1% differs in pixel type or subchannels from series %2%");
+              fmt % field.series % layout.fields.front().series;
+              throw std::logic_error(fmt.str());
+            }
+
+          // Reduce to fit the cell, keeping the aspect ratio.
+          dimension_size_type w = full.sizeX;
+          dimension_size_type h = full.sizeY;
+          if (w > cellSizeX || h > cellSizeY)
+            {
+              if (full.sizeX * cellSizeY >= full.sizeY * cellSizeX)
+                {
+                  w = cellSizeX;
+                  h = std::max(dimension_size_type(1U), (full.sizeY * cellSizeX) / full.sizeX);
+                }
+              else
+                {
+                  h = cellSizeY;
+                  w = std::max(dimension_size_type(1U), (full.sizeX * cellSizeY) / full.sizeY);
+                }
+            }
+
+          FieldRead read;
+          read.series = field.series;
+          read.resolution = 0U;
+          for (dimension_size_type r = 1U; r < resolutions.size(); ++r)
+            if (resolutions[r]->sizeX >= w && resolutions[r]->sizeY >= h)
+              read.resolution = r;
+          read.sizeX = resolutions[read.resolution]->sizeX;
+          read.sizeY = resolutions[read.resolution]->sizeY;
+
+          const dimension_size_type cellX = (field.column * layout.fieldColumns) + (field.field % layout.fieldColumns);
+          const dimension_size_type cellY = (field.row * layout.fieldRows) + (field.field / layout.fieldColumns);
+          read.region = PlaneRegion((cellX * cellSizeX) + ((cellSizeX - w) / 2U),
+                                    (cellY * cellSizeY) + ((cellSizeY - h) / 2U),
+                                    w, h);
+          reads.push_back(read);
+        }
+
+      std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+      shape.fill(1U);
+      shape[DIM_SPATIAL_X] = layout.columns * layout.fieldColumns * cellSizeX;
+      shape[DIM_SPATIAL_Y] = layout.rows * layout.fieldRows * cellSizeY;
+      shape[DIM_SUBCHANNEL] = samples;
+      buf.setBuffer(shape, pixeltype, PixelBufferBase::default_storage_order(), buf.allocator());
+      ClearVisitor clear;
+      ome::compat::visit(clear, buf.vbuffer());
+
+      auto place = [&](const FieldRead& read,
+                       VariantPixelBuffer& scratch)
+        {
+          reader.openBytesAt(read.series, read.resolution, plane, scratch,
+                             PlaneRegion(0U, 0U, read.sizeX, read.sizeY));
+          PlaceVisitor v(buf, read.region);
+          ome::compat::visit(v, scratch.vbuffer());
+        };
+
+      const unsigned int nthreads = static_cast<unsigned int>
+        (std::min(static_cast<dimension_size_type>(std::max(reader.getDecodeThreads(), 1U)),
+                  static_cast<dimension_size_type>(reads.size())));
+
+      if (nthreads < 2U)
+        {
+          VariantPixelBuffer scratch;
+          for (const auto& read : reads)
+            place(read, scratch);
+          return;
+        }
+
+      // Each task reads every nthreads-th field with its own reused
+      // buffer, into a disjoint part of the mosaic.
+      reader.getExecutor()->parallel(nthreads,
+                                     [&](unsigned int t)
+                                     {
+                                       VariantPixelBuffer scratch;
+                                       for (dimension_size_type i = t; i < reads.size(); i += nthreads)
+                                         place(reads[i], scratch);
+                                     });
+    }
+
+  }
+}
@@ -0,0 +1,177 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_PLATEMOSAIC_H
+#define OME_FILES_PLATEMOSAIC_H
+
+#include <vector>
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+#include <ome/xml/meta/MetadataRetrieve.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * A field of a plate mosaic.
+     */
+    struct PlateField
+    {
+      /// Series (Image index) of the field.
+      dimension_size_type series;
+      /// Well row.
+      dimension_size_type row;
+      /// Well column.
+      dimension_size_type column;
+      /// Field index within the well.
+      dimension_size_type field;
+    };
+
+    /**
+     * Layout of a plate mosaic.
+     *
+     * The mosaic is a grid of wells, each of which is a grid of
+     * fields, each of which is a cell holding a reduced image of one
+     * series.
+     */
+    struct PlateLayout
+    {
+      /// Number of well rows.
+      dimension_size_type rows;
+      /// Number of well columns.
+      dimension_size_type columns;
+      /// Number of field rows within each well.
+      dimension_size_type fieldRows;
+      /// Number of field columns within each well.
+      dimension_size_type fieldColumns;
+      /// The fields to show.
+      std::vector<PlateField> fields;
+
+      /// Constructor (empty layout).
+      PlateLayout():
+        rows(0U),
+        columns(0U),
+        fieldRows(0U),
+        fieldColumns(0U),
+        fields()
+      {}
+    };
+
+    /**
+     * Get the mosaic layout of a plate.
+     *
+     * Each WellSample of each Well of the plate is a field, with the
+     * series of the Image it refers to, the row and column of its
+     * Well, and its position in the Well's list of WellSamples.
+     * WellSamples without an Image are left out.  The plate has the
+     * Plate Rows and Columns where present, enlarged to hold every
+     * Well if needed.  The fields of each well are laid out in a
+     * grid as close to square as possible, with enough cells for
+     * the well with the most fields.
+     *
+     * @param meta the metadata to use.
+     * @param plate the plate index.
+     * @returns the layout.
+     * @throws std::logic_error if the plate index is invalid.
+     */
+    PlateLayout
+    plateLayout(const ::ome::xml::meta::MetadataRetrieve& meta,
+                dimension_size_type                       plate);
+
+    /**
+     * Compose a plate mosaic.
+     *
+     * Each field is reduced to fit its cell, keeping its aspect
+     * ratio, and centred in the cell; cells without a field are
+     * zero.  Images smaller than the cell are not enlarged.  Each
+     * field is read from the smallest resolution of its series no
+     * smaller than the reduced image, and reduced by nearest
+     * neighbour sampling, so that for pyramidal data only a small
+     * image is read for each field.
+     *
+     * The fields are read with FormatReader::openBytesAt(), which
+     * neither uses nor changes the current series of the reader,
+     * and in parallel, using up to FormatReader::getDecodeThreads()
+     * tasks of the reader's executor, each with its own reused
+     * buffer.  Formats which serialise concurrent reads are still
+     * read correctly, but not in parallel.
+     *
+     * The series are the series of the reader, which must not have
+     * flattened resolutions for the sub-resolutions to be used.
+     * Every series must have the pixel type of the first field, and
+     * every channel the same number of subchannels.
+     *
+     * @param reader the reader to use.
+     * @param layout the plate layout.
+     * @param plane the plane index to show within each series.
+     * @param cellSizeX the width of each cell.
+     * @param cellSizeY the height of each cell.
+     * @param buf the destination pixel buffer, which is resized to
+     * hold the mosaic.
+     * @throws FormatException if there was a problem reading a
+     * field.
+     * @throws std::logic_error if the layout has no fields, a field
+     * is outside the layout, a series or plane is invalid, the cell
+     * size is zero, or the pixel types or subchannels of the series
+     * differ.
+     * @throws ReadCancelledException if the read was cancelled (see
+     * CancellationToken).
+     */
+    void
+    composePlateMosaic(const FormatReader& reader,
+                       const PlateLayout&  layout,
+                       dimension_size_type plane,
+                       dimension_size_type cellSizeX,
+                       dimension_size_type cellSizeY,
+                       VariantPixelBuffer& buf);
+
+  }
+}
+
+#endif // OME_FILES_PLATEMOSAIC_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
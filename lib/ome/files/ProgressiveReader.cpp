@@ -0,0 +1,502 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/Executor.h>
+#include <ome/files/ProgressiveReader.h>
+
+namespace
+{
+
+  using ome::files::CoreMetadata;
+  using ome::files::FormatReader;
+  using ome::files::PlaneRegion;
+  using ome::files::dimension_size_type;
+
+  // Initial throughput estimate (pixels per second).
+  const double default_throughput = 50.0e6;
+
+  // Weight of each read in the throughput estimate.
+  const double throughput_weight = 0.25;
+
+  // Get the core metadata for all resolutions of a series.
+  std::vector<std::shared_ptr<CoreMetadata>>
+  series_resolutions(const FormatReader& reader,
+                     dimension_size_type series)
+  {
+    const std::vector<std::shared_ptr<CoreMetadata>>& core(reader.getCoreMetadataList());
+    dimension_size_type index = 0U;
+    dimension_size_type count = 1U;
+    if (reader.hasFlattenedResolutions())
+      index = series;
+    else
+      {
+        for (dimension_size_type s = 0U; s < series && index < core.size() && core[index]; ++s)
+          index += core[index]->resolutionCount;
+        if (index < core.size() && core[index])
+          count = core[index]->resolutionCount;
+      }
+
+    if (index >= core.size() || !core[index] || index + count > core.size())
+      {
+        boost::format fmt("Invalid series: %1%");
+        fmt % series;
+        throw std::logic_error(fmt.str());
+      }
+
+    return std::vector<std::shared_ptr<CoreMetadata>>(core.begin() + static_cast<std::ptrdiff_t>(index),
+                                                      core.begin() + static_cast<std::ptrdiff_t>(index + count));
+  }
+
+  // Scale a region to another resolution, rounding outward so that
+  // the scaled region covers the original.
+  PlaneRegion
+  scale_region(const PlaneRegion&  region,
+               const CoreMetadata& from,
+               const CoreMetadata& to)
+  {
+    const dimension_size_type x0 = region.x * to.sizeX / from.sizeX;
+    const dimension_size_type y0 = region.y * to.sizeY / from.sizeY;
+    dimension_size_type x1 = ((region.x + region.w) * to.sizeX + from.sizeX - 1U) / from.sizeX;
+    dimension_size_type y1 = ((region.y + region.h) * to.sizeY + from.sizeY - 1U) / from.sizeY;
+    x1 = std::max(std::min(x1, to.sizeX), x0 + 1U);
+    y1 = std::max(std::min(y1, to.sizeY), y0 + 1U);
+    return PlaneRegion(x0, y0, x1 - x0, y1 - y0);
+  }
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    class ProgressiveReader::Impl
+    {
+    public:
+      /// An outstanding request.
+      struct Request
+      {
+        /// Request identifier.
+        request_type                             id;
+        /// Series index.
+        dimension_size_type                      series;
+        /// Plane index.
+        dimension_size_type                      plane;
+        /// Updates to read, coarsest first, without pixel data.
+        std::vector<ProgressiveUpdate>           levels;
+        /// Update callback.
+        callback_type                            callback;
+        /// Cancellation token of the requesting thread (if any).
+        std::shared_ptr<const CancellationToken> caller;
+        /// Token cancelling the reads of the request.
+        CancellationToken                        token;
+        /// Time of the request.
+        std::chrono::steady_clock::time_point    start;
+        /// Mutex serialising callbacks, and protecting the
+        /// following members; recursive so that the callback may
+        /// cancel its own request.
+        std::recursive_mutex                     mutex;
+        /// Number of levels up to the finest delivered.
+        std::size_t                              delivered;
+        /// The final update has been delivered, or the request was
+        /// cancelled.
+        bool                                     finished;
+      };
+
+      /// A queued read: the request and its level.
+      typedef std::pair<std::shared_ptr<Request>, std::size_t> job_type;
+
+      /// Position in the queue: area and read sequence number.
+      typedef std::pair<dimension_size_type, uint64_t> queue_key;
+
+      /// Reader.
+      std::shared_ptr<const FormatReader> reader;
+      /// Executor running the reading tasks.
+      std::shared_ptr<Executor> executor;
+      /// Maximum number of reading tasks.
+      unsigned int concurrency;
+      /// Lock for all the following members.
+      mutable std::mutex mutex;
+      /// Signalled when a read or request completes.
+      mutable std::condition_variable completed;
+      /// Outstanding requests.
+      std::map<request_type, std::shared_ptr<Request>> requests;
+      /// Queued reads, smallest first.
+      std::map<queue_key, job_type> queue;
+      /// Next read sequence number.
+      uint64_t sequence;
+      /// Next request identifier.
+      request_type nextId;
+      /// Number of reading tasks submitted to the executor.
+      unsigned int runners;
+      /// Number of reads in progress.
+      std::size_t nactive;
+      /// Estimated throughput (pixels per second).
+      double throughput;
+
+      Impl(std::shared_ptr<const FormatReader> reader,
+           unsigned int                        concurrency):
+        reader(reader),
+        executor(reader->getExecutor()),
+        concurrency(concurrency ? concurrency : std::max(executor->concurrency(), 1U)),
+        mutex(),
+        completed(),
+        requests(),
+        queue(),
+        sequence(0U),
+        nextId(0U),
+        runners(0U),
+        nactive(0U),
+        throughput(default_throughput)
+      {
+      }
+
+      // Submit runner tasks while the queue has more reads than the
+      // runners can start.  The lock is released before submitting,
+      // since an executor may run the task immediately.  The
+      // destructor waits for the runners, so the tasks do not own
+      // the implementation; were they to, the last reference to the
+      // reader, and so to its executor, could be released by an
+      // executor thread.
+      void
+      schedule(std::unique_lock<std::mutex>& lock)
+      {
+        unsigned int start = 0U;
+        while (runners < concurrency && queue.size() > runners - nactive)
+          {
+            ++runners;
+            ++start;
+          }
+        lock.unlock();
+
+        for (unsigned int i = 0U; i < start; ++i)
+          executor->submit([this]() { run(); });
+      }
+
+      // Read queued reads in order until none remain.
+      void
+      run()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!queue.empty())
+          {
+            auto next = queue.begin();
+            const job_type job(next->second);
+            queue.erase(next);
+            ++nactive;
+            lock.unlock();
+
+            Request& request(*job.first);
+            const ProgressiveUpdate& level(request.levels.at(job.second));
+            std::shared_ptr<VariantPixelBuffer> buf(std::make_shared<VariantPixelBuffer>());
+            std::exception_ptr error;
+            const std::chrono::steady_clock::time_point begin(std::chrono::steady_clock::now());
+            try
+              {
+                if (request.caller)
+                  request.caller->check();
+                CancellationToken::Scope scope(request.token);
+                request.token.check();
+                reader->openBytesAt(request.series, level.resolution, request.plane,
+                                    *buf, level.region);
+              }
+            catch (...)
+              {
+                buf.reset();
+                error = std::current_exception();
+              }
+            const std::chrono::steady_clock::time_point end(std::chrono::steady_clock::now());
+
+            const bool done = deliver(request, job.second, buf, error, end);
+
+            lock.lock();
+            const double seconds = std::chrono::duration<double>(end - begin).count();
+            if (!error && seconds > 0.0)
+              throughput += throughput_weight *
+                ((static_cast<double>(level.region.area()) / seconds) - throughput);
+            if (done)
+              remove(request.id);
+            --nactive;
+            completed.notify_all();
+          }
+        --runners;
+        completed.notify_all();
+      }
+
+      // Call the callback with a completed read, unless the request
+      // is finished or a finer level was delivered.  Returns true if
+      // this finished the request.
+      static bool
+      deliver(Request&                                     request,
+              std::size_t                                  level,
+              std::shared_ptr<VariantPixelBuffer>          buf,
+              std::exception_ptr                           error,
+              const std::chrono::steady_clock::time_point& end)
+      {
+        std::lock_guard<std::recursive_mutex> guard(request.mutex);
+        if (request.finished || (!error && level < request.delivered))
+          return false;
+
+        ProgressiveUpdate update(request.levels.at(level));
+        update.pixels = buf;
+        update.elapsed = end - request.start;
+        if (error)
+          update.final = true;
+        request.delivered = level + 1U;
+        if (update.final)
+          {
+            request.finished = true;
+            // Reads of coarser levels are no longer needed.
+            request.token.cancel();
+          }
+
+        try
+          {
+            request.callback(update, error);
+          }
+        catch (...)
+          {
+          }
+        return update.final;
+      }
+
+      // Remove a request and its queued reads.  The mutex must be
+      // held.
+      std::shared_ptr<Request>
+      remove(request_type id)
+      {
+        std::shared_ptr<Request> request;
+        auto found = requests.find(id);
+        if (found == requests.end())
+          return request;
+
+        request = found->second;
+        requests.erase(found);
+        for (auto i = queue.begin(); i != queue.end();)
+          {
+            if (i->second.first == request)
+              queue.erase(i++);
+            else
+              ++i;
+          }
+        completed.notify_all();
+        return request;
+      }
+    };
+
+    ProgressiveReader::ProgressiveReader(std::shared_ptr<const FormatReader> reader,
+                                         unsigned int                        concurrency):
+      impl(std::make_shared<Impl>(reader, concurrency))
+    {
+    }
+
+    ProgressiveReader::~ProgressiveReader()
+    {
+      std::vector<request_type> ids;
+      {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        for (const auto& request : impl->requests)
+          ids.push_back(request.first);
+      }
+      for (const auto& id : ids)
+        cancel(id);
+
+      std::unique_lock<std::mutex> lock(impl->mutex);
+      impl->completed.wait(lock, [this]() { return impl->runners == 0U; });
+    }
+
+    ProgressiveReader::request_type
+    ProgressiveReader::read(dimension_size_type       series,
+                            dimension_size_type       plane,
+                            const PlaneRegion&        region,
+                            std::chrono::milliseconds budget,
+                            callback_type             callback,
+                            dimension_size_type       resolution)
+    {
+      const std::vector<std::shared_ptr<CoreMetadata>> resolutions(series_resolutions(*impl->reader, series));
+      if (resolution >= resolutions.size())
+        {
+          boost::format fmt("Invalid resolution %1% for series %2%");
+          fmt % resolution % series;
+          throw std::logic_error(fmt.str());
+        }
+
+      const CoreMetadata& target(*resolutions[resolution]);
+      if (plane >= target.imageCount)
+        {
+          boost::format fmt("Invalid plane %1% for series %2%");
+          fmt % plane % series;
+          throw std::logic_error(fmt.str());
+        }
+      if (!region.valid() ||
+          region.x + region.w > target.sizeX ||
+          region.y + region.h > target.sizeY)
+        {
+          boost::format fmt("Invalid region %1% for series %2% resolution %3%");
+          fmt % region % series % resolution;
+          throw std::logic_error(fmt.str());
+        }
+
+      std::shared_ptr<Impl::Request> request(std::make_shared<Impl::Request>());
+      request->series = series;
+      request->plane = plane;
+      request->callback = std::move(callback);
+      // A copy of the token shares its state, and outlives the scope
+      // of the caller.
+      if (const CancellationToken *cancel = CancellationToken::current())
+        request->caller = std::make_shared<const CancellationToken>(*cancel);
+      request->delivered = 0U;
+      request->finished = false;
+
+      // Coarser resolutions, coarsest first, then the target.
+      for (dimension_size_type r = resolutions.size() - 1U; r >= resolution; --r)
+        {
+          const CoreMetadata& core(*resolutions[r]);
+          if (r == resolution ||
+              (core.sizeX < target.sizeX && core.sizeY <= target.sizeY) ||
+              (core.sizeX <= target.sizeX && core.sizeY < target.sizeY))
+            {
+              ProgressiveUpdate update;
+              update.resolution = r;
+              update.region = r == resolution ? region : scale_region(region, target, core);
+              request->levels.push_back(update);
+            }
+          if (r == 0U)
+            break;
+        }
+      request->levels.back().final = true;
+
+      std::unique_lock<std::mutex> lock(impl->mutex);
+
+      // Start with the finest level expected to be read within the
+      // budget, or the coarsest.
+      const double budgetPixels = impl->throughput * std::chrono::duration<double>(budget).count();
+      std::size_t first = 0U;
+      for (std::size_t i = request->levels.size(); i > 0U; --i)
+        {
+          if (static_cast<double>(request->levels[i - 1U].region.area()) <= budgetPixels)
+            {
+              first = i - 1U;
+              break;
+            }
+        }
+      request->levels.erase(request->levels.begin(),
+                            request->levels.begin() + static_cast<std::ptrdiff_t>(first));
+
+      request->id = impl->nextId++;
+      request->start = std::chrono::steady_clock::now();
+      impl->requests.insert(std::make_pair(request->id, request));
+      for (std::size_t i = 0U; i < request->levels.size(); ++i)
+        impl->queue.insert(std::make_pair(Impl::queue_key(request->levels[i].region.area(), impl->sequence++),
+                                          Impl::job_type(request, i)));
+
+      const request_type id(request->id);
+      impl->schedule(lock);
+      return id;
+    }
+
+    bool
+    ProgressiveReader::cancel(request_type request)
+    {
+      std::shared_ptr<Impl::Request> removed;
+      {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        removed = impl->remove(request);
+      }
+      if (!removed)
+        return false;
+
+      // Wait for any callback in progress.
+      std::lock_guard<std::recursive_mutex> guard(removed->mutex);
+      const bool outstanding = !removed->finished;
+      removed->finished = true;
+      removed->token.cancel();
+      return outstanding;
+    }
+
+    dimension_size_type
+    ProgressiveReader::pending() const
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      return impl->requests.size();
+    }
+
+    void
+    ProgressiveReader::wait() const
+    {
+      std::unique_lock<std::mutex> lock(impl->mutex);
+      impl->completed.wait(lock, [this]() { return impl->requests.empty() && impl->nactive == 0U; });
+    }
+
+    double
+    ProgressiveReader::getThroughput() const
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      return impl->throughput;
+    }
+
+    void
+    ProgressiveReader::setThroughput(double pixelsPerSecond)
+    {
+      if (!(pixelsPerSecond > 0.0))
+        throw std::logic_error("Throughput must be positive");
+
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      impl->throughput = pixelsPerSecond;
+    }
+
+    const std::shared_ptr<const FormatReader>&
+    ProgressiveReader::getReader() const
+    {
+      return impl->reader;
+    }
+
+  }
+}
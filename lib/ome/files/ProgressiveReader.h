@@ -0,0 +1,273 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_PROGRESSIVEREADER_H
+#define OME_FILES_PROGRESSIVEREADER_H
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * A progressive read result.
+     *
+     * The region read at one resolution of the pyramid.
+     */
+    struct ProgressiveUpdate
+    {
+      /// The resolution index within the series.
+      dimension_size_type                       resolution;
+      /// The region read, at this resolution.
+      PlaneRegion                               region;
+      /// The pixel data (null on error).
+      std::shared_ptr<const VariantPixelBuffer> pixels;
+      /// @c true if this is the last update for the request.
+      bool                                      final;
+      /// Time since the request was made.
+      std::chrono::steady_clock::duration       elapsed;
+
+      /// Constructor.
+      ProgressiveUpdate():
+        resolution(0U),
+        region(),
+        pixels(),
+        final(false),
+        elapsed()
+      {}
+    };
+
+    /**
+     * Progressive reading of image regions.
+     *
+     * Interactive viewers need something to show promptly, even for
+     * a large region whose full resolution read takes some time.
+     * Each request reads a region of a plane first at a coarse
+     * resolution of the pyramid, chosen to be read within a time
+     * budget, and then at each finer resolution in turn down to the
+     * requested resolution, calling a callback with the result of
+     * each:
+     *
+     * \code{.cpp}
+     * ProgressiveReader progressive(reader);
+     * progressive.read(series, plane, region, std::chrono::milliseconds(50),
+     *                  [](const ProgressiveUpdate& update,
+     *                     std::exception_ptr       error)
+     *                  {
+     *                    // Post update.pixels back to the event loop,
+     *                    // scaling update.region to the view.
+     *                  });
+     * \endcode
+     *
+     * The first resolution read is the finest whose region is
+     * expected to be read within the budget, using an estimate of
+     * the read throughput (in pixels per second) measured from
+     * previous reads, or the coarsest resolution if none is.  The
+     * estimate may be set with setThroughput(), for example from
+     * previous sessions.  Images without sub-resolutions are read
+     * once, at the requested resolution.
+     *
+     * Reads of all requests are queued in order of size, smallest
+     * first, so that the coarse reads of a new request are started
+     * before the fine reads of earlier requests, and are read by a
+     * limited number of tasks submitted to the executor of the
+     * reader (see FormatReader::getExecutor()).  Updates for a
+     * request are delivered in order of resolution, coarsest first;
+     * a read completing after a finer one for the same request is
+     * discarded.
+     *
+     * The cancellation token of the thread making a request (see
+     * CancellationToken) applies to the request.  The reader must
+     * not be closed, nor setId() called, while requests are
+     * outstanding; the destructor cancels and waits for all
+     * outstanding requests.
+     */
+    class ProgressiveReader
+    {
+    public:
+      /// Request identifier type.
+      typedef uint64_t request_type;
+
+      /**
+       * Update callback.
+       *
+       * Called by an executor thread for each resolution read, with
+       * the last update marked final, or once with the exception
+       * thrown by a read, which ends the request.  Calls for a
+       * request are serialised.  The callback must not block; any
+       * exception it throws is discarded.
+       */
+      typedef std::function<void (const ProgressiveUpdate& update,
+                                  std::exception_ptr       error)> callback_type;
+
+      /**
+       * Constructor.
+       *
+       * @param reader the reader to read from; its metadata must
+       * already be initialized with setId().
+       * @param concurrency the maximum number of reads made
+       * concurrently, or @c 0 for the concurrency of the executor
+       * of the reader.
+       */
+      explicit
+      ProgressiveReader(std::shared_ptr<const FormatReader> reader,
+                        unsigned int                        concurrency = 0U);
+
+      /**
+       * Destructor.
+       *
+       * Cancels and waits for all outstanding requests.
+       */
+      ~ProgressiveReader();
+
+      /// @cond SKIP
+      ProgressiveReader (const ProgressiveReader&) = delete;
+
+      ProgressiveReader&
+      operator= (const ProgressiveReader&) = delete;
+      /// @endcond SKIP
+
+      /**
+       * Read a region progressively.
+       *
+       * @param series the series index.
+       * @param plane the plane index within the series.
+       * @param region the sub-image to read, at @p resolution.
+       * @param budget the time within which the first update
+       * should be delivered.
+       * @param callback the function to call with each update.
+       * @param resolution the resolution index within the series of
+       * the final update.
+       * @returns the request identifier.
+       * @throws std::logic_error if the series, plane, resolution or
+       * region are invalid.
+       */
+      request_type
+      read(dimension_size_type       series,
+           dimension_size_type       plane,
+           const PlaneRegion&        region,
+           std::chrono::milliseconds budget,
+           callback_type             callback,
+           dimension_size_type       resolution = 0U);
+
+      /**
+       * Cancel a request.
+       *
+       * Its queued reads are discarded, and its reads in progress
+       * are cancelled between tiles.  A callback in progress is
+       * waited for, and no further calls are made to the callback
+       * once this returns.
+       *
+       * @param request the request to cancel.
+       * @returns @c true if the request was outstanding, @c false if
+       * it had completed.
+       */
+      bool
+      cancel(request_type request);
+
+      /**
+       * Get the number of outstanding requests.
+       *
+       * @returns the number of requests without a final update.
+       */
+      dimension_size_type
+      pending() const;
+
+      /**
+       * Wait for all outstanding requests.
+       *
+       * Callbacks of the requests have returned when this returns.
+       */
+      void
+      wait() const;
+
+      /**
+       * Get the estimated read throughput.
+       *
+       * @returns the throughput in pixels per second.
+       */
+      double
+      getThroughput() const;
+
+      /**
+       * Set the estimated read throughput.
+       *
+       * The estimate is updated by subsequent reads.
+       *
+       * @param pixelsPerSecond the throughput in pixels per second.
+       * @throws std::logic_error if not positive.
+       */
+      void
+      setThroughput(double pixelsPerSecond);
+
+      /**
+       * Get the reader.
+       *
+       * @returns the reader.
+       */
+      const std::shared_ptr<const FormatReader>&
+      getReader() const;
+
+    private:
+      class Impl;
+
+      /// Request queue, shared with the reading tasks.
+      std::shared_ptr<Impl> impl;
+    };
+
+  }
+}
+
+#endif // OME_FILES_PROGRESSIVEREADER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,385 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include <type_traits>
+
+#include <boost/format.hpp>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/PixelStatistics.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/Projection.h>
+#include <ome/files/VariantPixelBufferView.h>
+#include <ome/files/detail/Projection.h>
+
+using ome::files::FormatReader;
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::PlaneRegion;
+using ome::files::ProjectionMode;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+using ::ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  // Type used to accumulate sums of values of type T.
+  template<typename T>
+  struct ProjectionSumType
+  {
+    typedef typename ome::files::detail::StatisticSumType<T>::type type;
+  };
+
+  template<typename T>
+  struct ProjectionSumType<std::complex<T>>
+  {
+    typedef std::complex<double> type;
+  };
+
+  // Type of projected sums of values of type T.
+  template<typename T>
+  struct ProjectionSumOutput
+  {
+    typedef double type;
+  };
+
+  template<typename T>
+  struct ProjectionSumOutput<std::complex<T>>
+  {
+    typedef std::complex<double> type;
+  };
+
+  // Mean of values of type T from their sum.
+  template<typename T>
+  struct ProjectionMean
+  {
+    template<typename S>
+    static T
+    value(const S& sum,
+          double   count)
+    {
+      const double mean = static_cast<double>(sum) / count;
+      return static_cast<T>(std::is_integral<T>::value ? std::round(mean) : mean);
+    }
+  };
+
+  template<>
+  struct ProjectionMean<bool>
+  {
+    static bool
+    value(uint64_t sum,
+          double   count)
+    {
+      return static_cast<double>(sum) * 2.0 >= count;
+    }
+  };
+
+  template<typename T>
+  struct ProjectionMean<std::complex<T>>
+  {
+    static std::complex<T>
+    value(const std::complex<double>& sum,
+          double                      count)
+    {
+      return std::complex<T>(sum / count);
+    }
+  };
+
+  void
+  read_band(const FormatReader& reader,
+            dimension_size_type plane,
+            const PlaneRegion&  band,
+            VariantPixelBuffer& buf)
+  {
+    if (const ome::files::CancellationToken *cancel = ome::files::CancellationToken::current())
+      cancel->check();
+
+    reader.openBytes(plane, buf, band.x, band.y, band.w, band.h);
+  }
+
+  // Project one band, with the first plane already read into the
+  // scratch buffer.  Each further plane is read into the scratch
+  // buffer, replacing the first, so the first is only used before
+  // the second is read.
+  struct ProjectBandVisitor
+  {
+    const FormatReader&                     reader;
+    const std::vector<dimension_size_type>& planes;
+    ProjectionMode                          mode;
+    const PlaneRegion&                      band;
+    VariantPixelBuffer&                     scratch;
+    VariantPixelBuffer&                     out;
+
+    ProjectBandVisitor(const FormatReader&                     reader,
+                       const std::vector<dimension_size_type>& planes,
+                       ProjectionMode                          mode,
+                       const PlaneRegion&                      band,
+                       VariantPixelBuffer&                     scratch,
+                       VariantPixelBuffer&                     out):
+      reader(reader),
+      planes(planes),
+      mode(mode),
+      band(band),
+      scratch(scratch),
+      out(out)
+    {}
+
+    template<typename T>
+    void
+    operator() (const std::shared_ptr<PixelBuffer<T>>& first)
+    {
+      const VariantPixelBuffer::size_type n = first->num_elements();
+      std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+      std::copy(first->shape(), first->shape() + PixelBufferBase::dimensions, shape.begin());
+      const PixelBufferBase::storage_order_type order(first->storage_order());
+      const PixelType pixeltype(first->pixelType());
+
+      if (mode == ome::files::PROJECTION_MAX)
+        {
+          out.setBuffer(shape, pixeltype, order, out.allocator());
+          T *acc = out.data<T>();
+          std::copy(first->data(), first->data() + n, acc);
+
+          for (auto p = planes.begin() + 1; p != planes.end(); ++p)
+            {
+              read_band(reader, *p, band, scratch);
+              ome::files::detail::projectMax(acc, scratch.data<T>(), n);
+            }
+          return;
+        }
+
+      typedef typename ProjectionSumType<T>::type sum_type;
+      std::vector<sum_type> acc(first->data(), first->data() + n);
+
+      for (auto p = planes.begin() + 1; p != planes.end(); ++p)
+        {
+          read_band(reader, *p, band, scratch);
+          ome::files::detail::projectSum(acc.data(), scratch.data<T>(), n);
+        }
+
+      if (mode == ome::files::PROJECTION_SUM)
+        {
+          typedef typename ProjectionSumOutput<T>::type output_type;
+          out.setBuffer(shape, ome::files::projectionPixelType(pixeltype, mode), order, out.allocator());
+          output_type *dest = out.data<output_type>();
+          for (VariantPixelBuffer::size_type i = 0; i < n; ++i)
+            dest[i] = static_cast<output_type>(acc[i]);
+        }
+      else
+        {
+          out.setBuffer(shape, pixeltype, order, out.allocator());
+          T *dest = out.data<T>();
+          const double count = static_cast<double>(planes.size());
+          for (VariantPixelBuffer::size_type i = 0; i < n; ++i)
+            dest[i] = ProjectionMean<T>::value(acc[i], count);
+        }
+    }
+  };
+
+  void
+  project_band(const FormatReader&                     reader,
+               const std::vector<dimension_size_type>& planes,
+               ProjectionMode                          mode,
+               const PlaneRegion&                      band,
+               VariantPixelBuffer&                     scratch,
+               VariantPixelBuffer&                     out)
+  {
+    read_band(reader, planes.front(), band, scratch);
+    ProjectBandVisitor v(reader, planes, mode, band, scratch, out);
+    ome::compat::visit(v, scratch.vbuffer());
+  }
+
+  // Split the plane into bands of rows.
+  std::vector<PlaneRegion>
+  make_bands(const FormatReader&                     reader,
+             const std::vector<dimension_size_type>& planes,
+             dimension_size_type                     rows)
+  {
+    if (planes.empty())
+      throw std::logic_error("No planes to project");
+
+    const dimension_size_type sizeX = reader.getSizeX();
+    const dimension_size_type sizeY = reader.getSizeY();
+    if (!rows)
+      rows = reader.getOptimalTileHeight();
+    rows = std::max(std::min(rows, sizeY), dimension_size_type(1U));
+
+    std::vector<PlaneRegion> bands;
+    for (dimension_size_type y = 0; y < sizeY; y += rows)
+      bands.push_back(PlaneRegion(0U, y, sizeX, std::min(rows, sizeY - y)));
+    return bands;
+  }
+
+  unsigned int
+  project_threads(const FormatReader& reader,
+                  dimension_size_type bands)
+  {
+    return static_cast<unsigned int>
+      (std::min(static_cast<dimension_size_type>(std::max(reader.getDecodeThreads(), 1U)),
+                bands));
+  }
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    PixelType
+    projectionPixelType(PixelType      pixeltype,
+                        ProjectionMode mode)
+    {
+      if (mode != PROJECTION_SUM)
+        return pixeltype;
+
+      switch(pixeltype)
+        {
+        case PixelType::COMPLEXFLOAT:
+        case PixelType::COMPLEXDOUBLE:
+          return PixelType::COMPLEXDOUBLE;
+        default:
+          return PixelType::DOUBLE;
+        }
+    }
+
+    void
+    projectPlanes(const FormatReader&                     reader,
+                  const std::vector<dimension_size_type>& planes,
+                  ProjectionMode                          mode,
+                  VariantPixelBuffer&                     buf,
+                  dimension_size_type                     rows)
+    {
+      const std::vector<PlaneRegion> bands(make_bands(reader, planes, rows));
+
+      auto store = [&](const PlaneRegion& band,
+                       VariantPixelBuffer& projected)
+        {
+          VariantPixelBufferView view(buf, band);
+          view.copyFrom(projected);
+        };
+
+      // The first band determines the shape and type of the
+      // projection.
+      VariantPixelBuffer scratch;
+      VariantPixelBuffer first;
+      project_band(reader, planes, mode, bands.front(), scratch, first);
+
+      std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+      std::copy(first.shape(), first.shape() + PixelBufferBase::dimensions, shape.begin());
+      shape[DIM_SPATIAL_Y] = reader.getSizeY();
+      buf.setBuffer(shape, first.pixelType(), first.storage_order(), buf.allocator());
+      store(bands.front(), first);
+
+      const unsigned int nthreads = project_threads(reader, bands.size() - 1U);
+
+      if (nthreads < 2U)
+        {
+          for (dimension_size_type i = 1U; i < bands.size(); ++i)
+            {
+              project_band(reader, planes, mode, bands[i], scratch, first);
+              store(bands[i], first);
+            }
+          return;
+        }
+
+      // Each task projects every nthreads-th band with its own
+      // reused buffers, into a disjoint part of the projection.
+      reader.getExecutor()->parallel(nthreads,
+                                     [&](unsigned int t)
+                                     {
+                                       VariantPixelBuffer tscratch;
+                                       VariantPixelBuffer tout;
+                                       for (dimension_size_type i = 1U + t; i < bands.size(); i += nthreads)
+                                         {
+                                           project_band(reader, planes, mode, bands[i], tscratch, tout);
+                                           store(bands[i], tout);
+                                         }
+                                     });
+    }
+
+    void
+    projectPlanes(const FormatReader&                     reader,
+                  const std::vector<dimension_size_type>& planes,
+                  ProjectionMode                          mode,
+                  FormatWriter&                           writer,
+                  dimension_size_type                     plane,
+                  dimension_size_type                     rows)
+    {
+      const std::vector<PlaneRegion> bands(make_bands(reader, planes, rows));
+      const unsigned int nthreads = project_threads(reader, bands.size());
+
+      // Bands are projected in groups of nthreads, and each group is
+      // saved in order before the next is started, so that only one
+      // group is held in memory.
+      std::vector<VariantPixelBuffer> scratch(nthreads);
+      std::vector<VariantPixelBuffer> projected(nthreads);
+
+      for (dimension_size_type start = 0U; start < bands.size(); start += nthreads)
+        {
+          const unsigned int count = static_cast<unsigned int>
+            (std::min(static_cast<dimension_size_type>(nthreads), bands.size() - start));
+
+          if (count < 2U)
+            project_band(reader, planes, mode, bands[start], scratch[0], projected[0]);
+          else
+            reader.getExecutor()->parallel(count,
+                                           [&](unsigned int t)
+                                           {
+                                             project_band(reader, planes, mode, bands[start + t],
+                                                          scratch[t], projected[t]);
+                                           });
+
+          for (unsigned int t = 0; t < count; ++t)
+            {
+              const PlaneRegion& band(bands[start + t]);
+              writer.saveBytes(plane, projected[t], band.x, band.y, band.w, band.h);
+            }
+        }
+    }
+
+  }
+}
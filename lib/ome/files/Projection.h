@@ -0,0 +1,170 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_PROJECTION_H
+#define OME_FILES_PROJECTION_H
+
+#include <vector>
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/FormatWriter.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+#include <ome/xml/model/enums/PixelType.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Intensity projection.
+     */
+    enum ProjectionMode
+      {
+        PROJECTION_MAX,  ///< Maximum intensity (complex values by magnitude).
+        PROJECTION_MEAN, ///< Mean intensity.
+        PROJECTION_SUM   ///< Sum of intensities.
+      };
+
+    /**
+     * Get the pixel type of a projection.
+     *
+     * Maximum and mean projections have the pixel type of the
+     * planes projected; integer means are rounded to the nearest
+     * integer, and @c BIT means are @c true if at least half the
+     * values are @c true.  Sums are @c DOUBLE, or @c COMPLEXDOUBLE
+     * for complex pixel types.
+     *
+     * @param pixeltype the pixel type of the planes to project.
+     * @param mode the projection.
+     * @returns the pixel type of the projected plane.
+     */
+    ::ome::xml::model::enums::PixelType
+    projectionPixelType(::ome::xml::model::enums::PixelType pixeltype,
+                        ProjectionMode                      mode);
+
+    /**
+     * Project planes of the current series and resolution.
+     *
+     * The planes are streamed one band of rows at a time: each plane
+     * is read for the band, and accumulated into the projection of
+     * the band, so that the planes are never held in memory, however
+     * many there are.  Bands are projected in parallel, using up to
+     * FormatReader::getDecodeThreads() tasks of the reader's
+     * executor, each holding the accumulator and one plane for a
+     * single band.  Apart from these, only the projected plane is
+     * held in memory.
+     *
+     * Typical projections select the planes of a Z or T stack with
+     * DimensionIndexer.  Accumulation is done with integers for
+     * integer pixel types, so that sums are exact, and @c double
+     * otherwise.  Each plane of a band is accumulated with
+     * detail::projectMax() or detail::projectSum(), which use SSE2
+     * or NEON instructions where available for the common pixel
+     * types, and a scalar loop for the remaining values and other
+     * types.
+     *
+     * @param reader the reader to use.
+     * @param planes the plane indices to project.
+     * @param mode the projection.
+     * @param buf the destination pixel buffer, which is resized to
+     * the plane size with the pixel type of projectionPixelType().
+     * @param rows the height of each band, or zero to use
+     * FormatReader::getOptimalTileHeight().
+     * @throws FormatException if there was a problem parsing the
+     * metadata of the file.
+     * @throws std::logic_error if no planes are specified, or a plane
+     * is invalid.
+     * @throws ReadCancelledException if the read was cancelled (see
+     * CancellationToken).
+     */
+    void
+    projectPlanes(const FormatReader&                     reader,
+                  const std::vector<dimension_size_type>& planes,
+                  ProjectionMode                          mode,
+                  VariantPixelBuffer&                     buf,
+                  dimension_size_type                     rows = 0U);
+
+    /**
+     * Project planes of the current series and resolution to a
+     * writer.
+     *
+     * This is equivalent to projecting into a buffer, but each band
+     * is saved to the current series of @p writer with
+     * FormatWriter::saveBytes() as soon as it is projected, so that
+     * the projected plane is never held in memory.  Up to
+     * FormatReader::getDecodeThreads() bands are projected in
+     * parallel, and saved in order.  The writer must be set up for a
+     * plane of the same size, with the pixel type of
+     * projectionPixelType().
+     *
+     * @param reader the reader to use.
+     * @param planes the plane indices to project.
+     * @param mode the projection.
+     * @param writer the destination writer.
+     * @param plane the plane index to save within the current series
+     * of the writer.
+     * @param rows the height of each band, or zero to use
+     * FormatReader::getOptimalTileHeight().
+     * @throws FormatException if there was a problem parsing the
+     * metadata of the file, or saving the plane.
+     * @throws std::logic_error if no planes are specified, or a plane
+     * is invalid.
+     * @throws ReadCancelledException if the read was cancelled (see
+     * CancellationToken).
+     */
+    void
+    projectPlanes(const FormatReader&                     reader,
+                  const std::vector<dimension_size_type>& planes,
+                  ProjectionMode                          mode,
+                  FormatWriter&                           writer,
+                  dimension_size_type                     plane,
+                  dimension_size_type                     rows = 0U);
+
+  }
+}
+
+#endif // OME_FILES_PROJECTION_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
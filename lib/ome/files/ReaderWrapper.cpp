@@ -0,0 +1,814 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <stdexcept>
+
+#include <ome/files/ReaderWrapper.h>
+#include <ome/files/detail/PlaneStack.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    ReaderWrapper::ReaderWrapper(const std::shared_ptr<FormatReader>& reader):
+      FormatReader(),
+      reader(reader)
+    {
+      if (!reader)
+        throw std::logic_error("Wrapped reader is null");
+    }
+
+    ReaderWrapper::~ReaderWrapper()
+    {
+    }
+
+    const std::shared_ptr<FormatReader>&
+    ReaderWrapper::getReader() const
+    {
+      return reader;
+    }
+
+    bool
+    ReaderWrapper::isThisType(const boost::filesystem::path& name,
+                              bool                           open) const
+    {
+      return reader->isThisType(name, open);
+    }
+
+    const std::string&
+    ReaderWrapper::getFormat() const
+    {
+      return reader->getFormat();
+    }
+
+    const std::string&
+    ReaderWrapper::getFormatDescription() const
+    {
+      return reader->getFormatDescription();
+    }
+
+    const std::vector<boost::filesystem::path>&
+    ReaderWrapper::getSuffixes() const
+    {
+      return reader->getSuffixes();
+    }
+
+    const std::vector<boost::filesystem::path>&
+    ReaderWrapper::getCompressionSuffixes() const
+    {
+      return reader->getCompressionSuffixes();
+    }
+
+    void
+    ReaderWrapper::setId(const boost::filesystem::path& id)
+    {
+      reader->setId(id);
+    }
+
+    void
+    ReaderWrapper::close(bool fileOnly)
+    {
+      reader->close(fileOnly);
+    }
+
+    std::shared_ptr<IOStatistics>
+    ReaderWrapper::getIOStatistics() const
+    {
+      return reader->getIOStatistics();
+    }
+
+    const std::set<MetadataOptions::MetadataLevel>&
+    ReaderWrapper::getSupportedMetadataLevels()
+    {
+      return reader->getSupportedMetadataLevels();
+    }
+
+    void
+    ReaderWrapper::setMetadataOptions(const MetadataOptions& options)
+    {
+      reader->setMetadataOptions(options);
+    }
+
+    const MetadataOptions&
+    ReaderWrapper::getMetadataOptions() const
+    {
+      return static_cast<const FormatReader&>(*reader).getMetadataOptions();
+    }
+
+    MetadataOptions&
+    ReaderWrapper::getMetadataOptions()
+    {
+      return reader->getMetadataOptions();
+    }
+
+    bool
+    ReaderWrapper::isThisType(const uint8_t *begin,
+                              const uint8_t *end) const
+    {
+      return reader->isThisType(begin, end);
+    }
+
+    bool
+    ReaderWrapper::isThisType(const uint8_t *begin,
+                              std::size_t     length) const
+    {
+      return reader->isThisType(begin, length);
+    }
+
+    bool
+    ReaderWrapper::isThisType(std::istream& stream) const
+    {
+      return reader->isThisType(stream);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getImageCount() const
+    {
+      return reader->getImageCount();
+    }
+
+    bool
+    ReaderWrapper::isRGB(dimension_size_type channel) const
+    {
+      return reader->isRGB(channel);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getSizeX() const
+    {
+      return reader->getSizeX();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getSizeY() const
+    {
+      return reader->getSizeY();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getSizeZ() const
+    {
+      return reader->getSizeZ();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getSizeT() const
+    {
+      return reader->getSizeT();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getSizeC() const
+    {
+      return reader->getSizeC();
+    }
+
+    ome::xml::model::enums::PixelType
+    ReaderWrapper::getPixelType() const
+    {
+      return reader->getPixelType();
+    }
+
+    pixel_size_type
+    ReaderWrapper::getBitsPerPixel() const
+    {
+      return reader->getBitsPerPixel();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getEffectiveSizeC() const
+    {
+      return reader->getEffectiveSizeC();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getRGBChannelCount(dimension_size_type channel) const
+    {
+      return reader->getRGBChannelCount(channel);
+    }
+
+    bool
+    ReaderWrapper::isIndexed() const
+    {
+      return reader->isIndexed();
+    }
+
+    bool
+    ReaderWrapper::isFalseColor() const
+    {
+      return reader->isFalseColor();
+    }
+
+    void
+    ReaderWrapper::getLookupTable(dimension_size_type plane,
+                                  VariantPixelBuffer& buf) const
+    {
+      reader->getLookupTable(plane, buf);
+    }
+
+    Modulo&
+    ReaderWrapper::getModuloZ()
+    {
+      return reader->getModuloZ();
+    }
+
+    const Modulo&
+    ReaderWrapper::getModuloZ() const
+    {
+      return static_cast<const FormatReader&>(*reader).getModuloZ();
+    }
+
+    Modulo&
+    ReaderWrapper::getModuloT()
+    {
+      return reader->getModuloT();
+    }
+
+    const Modulo&
+    ReaderWrapper::getModuloT() const
+    {
+      return static_cast<const FormatReader&>(*reader).getModuloT();
+    }
+
+    Modulo&
+    ReaderWrapper::getModuloC()
+    {
+      return reader->getModuloC();
+    }
+
+    const Modulo&
+    ReaderWrapper::getModuloC() const
+    {
+      return static_cast<const FormatReader&>(*reader).getModuloC();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getThumbSizeX() const
+    {
+      return reader->getThumbSizeX();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getThumbSizeY() const
+    {
+      return reader->getThumbSizeY();
+    }
+
+    bool
+    ReaderWrapper::isLittleEndian() const
+    {
+      return reader->isLittleEndian();
+    }
+
+    const std::string&
+    ReaderWrapper::getDimensionOrder() const
+    {
+      return reader->getDimensionOrder();
+    }
+
+    bool
+    ReaderWrapper::isOrderCertain() const
+    {
+      return reader->isOrderCertain();
+    }
+
+    bool
+    ReaderWrapper::isThumbnailSeries() const
+    {
+      return reader->isThumbnailSeries();
+    }
+
+    bool
+    ReaderWrapper::isInterleaved() const
+    {
+      return reader->isInterleaved();
+    }
+
+    bool
+    ReaderWrapper::isInterleaved(dimension_size_type channel) const
+    {
+      return reader->isInterleaved(channel);
+    }
+
+    void
+    ReaderWrapper::openBytes(dimension_size_type plane,
+                             VariantPixelBuffer& buf) const
+    {
+      reader->openBytes(plane, buf);
+    }
+
+    void
+    ReaderWrapper::openBytes(dimension_size_type plane,
+                             VariantPixelBuffer& buf,
+                             dimension_size_type x,
+                             dimension_size_type y,
+                             dimension_size_type w,
+                             dimension_size_type h) const
+    {
+      reader->openBytes(plane, buf, x, y, w, h);
+    }
+
+    void
+    ReaderWrapper::openBytesBatch(dimension_size_type              plane,
+                                  const std::vector<PlaneRegion>&  regions,
+                                  std::vector<VariantPixelBuffer>& bufs) const
+    {
+      reader->openBytesBatch(plane, regions, bufs);
+    }
+
+    void
+    ReaderWrapper::openBytesDecimated(dimension_size_type plane,
+                                      VariantPixelBuffer& buf,
+                                      const PlaneRegion&  region,
+                                      dimension_size_type xstep,
+                                      dimension_size_type ystep) const
+    {
+      reader->openBytesDecimated(plane, buf, region, xstep, ystep);
+    }
+
+    void
+    ReaderWrapper::openBytesAt(dimension_size_type series,
+                               dimension_size_type resolution,
+                               dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               const PlaneRegion&  region) const
+    {
+      reader->openBytesAt(series, resolution, plane, buf, region);
+    }
+
+    void
+    ReaderWrapper::openBytesInto(dimension_size_type     series,
+                                 dimension_size_type     resolution,
+                                 dimension_size_type     plane,
+                                 VariantPixelBufferView& buf,
+                                 const PlaneRegion&      region) const
+    {
+      reader->openBytesInto(series, resolution, plane, buf, region);
+    }
+
+    void
+    ReaderWrapper::openBytesStack(dimension_size_type series,
+                                  dimension_size_type resolution,
+                                  const plane_range&  zRange,
+                                  const plane_range&  cRange,
+                                  const plane_range&  tRange,
+                                  VariantPixelBuffer& buf,
+                                  const PlaneRegion&  region) const
+    {
+      // Read through openBytesAt() rather than forwarding, so that
+      // wrappers transforming planes need not override this method.
+      const dimension_size_type index = seriesToCoreIndex(series) + resolution;
+      readPlaneStack(*getCoreMetadataList().at(index),
+                     zRange, cRange, tRange, buf, getDecodeThreads(), *getExecutor(),
+                     [&](dimension_size_type plane,
+                         VariantPixelBuffer& dest)
+                     {
+                       openBytesAt(series, resolution, plane, dest, region);
+                     });
+    }
+
+    void
+    ReaderWrapper::forEachTile(dimension_size_type  plane,
+                               const tile_callback& callback) const
+    {
+      reader->forEachTile(plane, callback);
+    }
+
+    void
+    ReaderWrapper::openThumbBytes(dimension_size_type plane,
+                                  VariantPixelBuffer& buf) const
+    {
+      reader->openThumbBytes(plane, buf);
+    }
+
+    void
+    ReaderWrapper::openRawTile(dimension_size_type   plane,
+                               dimension_size_type   tile,
+                               std::vector<uint8_t>& buf) const
+    {
+      reader->openRawTile(plane, tile, buf);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getSeriesCount() const
+    {
+      return reader->getSeriesCount();
+    }
+
+    void
+    ReaderWrapper::setSeries(dimension_size_type series) const
+    {
+      reader->setSeries(series);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getSeries() const
+    {
+      return reader->getSeries();
+    }
+
+    void
+    ReaderWrapper::setPlane(dimension_size_type plane) const
+    {
+      reader->setPlane(plane);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getPlane() const
+    {
+      return reader->getPlane();
+    }
+
+    void
+    ReaderWrapper::setNormalized(bool normalize)
+    {
+      reader->setNormalized(normalize);
+    }
+
+    bool
+    ReaderWrapper::isNormalized() const
+    {
+      return reader->isNormalized();
+    }
+
+    void
+    ReaderWrapper::setIndexedExpanded(bool expand)
+    {
+      reader->setIndexedExpanded(expand);
+    }
+
+    bool
+    ReaderWrapper::isIndexedExpanded() const
+    {
+      return reader->isIndexedExpanded();
+    }
+
+    void
+    ReaderWrapper::setDecodeThreads(unsigned int threads)
+    {
+      reader->setDecodeThreads(threads);
+    }
+
+    unsigned int
+    ReaderWrapper::getDecodeThreads() const
+    {
+      return reader->getDecodeThreads();
+    }
+
+    void
+    ReaderWrapper::setExecutor(const std::shared_ptr<Executor>& executor)
+    {
+      reader->setExecutor(executor);
+    }
+
+    std::shared_ptr<Executor>
+    ReaderWrapper::getExecutor() const
+    {
+      return reader->getExecutor();
+    }
+
+    void
+    ReaderWrapper::setPrefetchPlanes(dimension_size_type planes)
+    {
+      reader->setPrefetchPlanes(planes);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getPrefetchPlanes() const
+    {
+      return reader->getPrefetchPlanes();
+    }
+
+    void
+    ReaderWrapper::setOriginalMetadataPopulated(bool populate)
+    {
+      reader->setOriginalMetadataPopulated(populate);
+    }
+
+    bool
+    ReaderWrapper::isOriginalMetadataPopulated() const
+    {
+      return reader->isOriginalMetadataPopulated();
+    }
+
+    void
+    ReaderWrapper::setOriginalMetadataLazy(bool lazy)
+    {
+      reader->setOriginalMetadataLazy(lazy);
+    }
+
+    bool
+    ReaderWrapper::isOriginalMetadataLazy() const
+    {
+      return reader->isOriginalMetadataLazy();
+    }
+
+    void
+    ReaderWrapper::setGroupFiles(bool group)
+    {
+      reader->setGroupFiles(group);
+    }
+
+    bool
+    ReaderWrapper::isGroupFiles() const
+    {
+      return reader->isGroupFiles();
+    }
+
+    bool
+    ReaderWrapper::isMetadataComplete() const
+    {
+      return reader->isMetadataComplete();
+    }
+
+    FormatReader::FileGroupOption
+    ReaderWrapper::fileGroupOption(const std::string& id)
+    {
+      return reader->fileGroupOption(id);
+    }
+
+    const std::vector<boost::filesystem::path>
+    ReaderWrapper::getUsedFiles(bool noPixels) const
+    {
+      return reader->getUsedFiles(noPixels);
+    }
+
+    const std::vector<boost::filesystem::path>
+    ReaderWrapper::getSeriesUsedFiles(bool noPixels) const
+    {
+      return reader->getSeriesUsedFiles(noPixels);
+    }
+
+    std::vector<FileInfo>
+    ReaderWrapper::getAdvancedUsedFiles(bool noPixels) const
+    {
+      return reader->getAdvancedUsedFiles(noPixels);
+    }
+
+    std::vector<FileInfo>
+    ReaderWrapper::getAdvancedSeriesUsedFiles(bool noPixels) const
+    {
+      return reader->getAdvancedSeriesUsedFiles(noPixels);
+    }
+
+    const boost::optional<boost::filesystem::path>&
+    ReaderWrapper::getCurrentFile() const
+    {
+      return reader->getCurrentFile();
+    }
+
+    const std::vector<std::string>&
+    ReaderWrapper::getDomains() const
+    {
+      return reader->getDomains();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getIndex(dimension_size_type z,
+                            dimension_size_type c,
+                            dimension_size_type t) const
+    {
+      return reader->getIndex(z, c, t);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getIndex(dimension_size_type z,
+                            dimension_size_type c,
+                            dimension_size_type t,
+                            dimension_size_type moduloZ,
+                            dimension_size_type moduloC,
+                            dimension_size_type moduloT) const
+    {
+      return reader->getIndex(z, c, t, moduloZ, moduloC, moduloT);
+    }
+
+    std::array<dimension_size_type, 3>
+    ReaderWrapper::getZCTCoords(dimension_size_type index) const
+    {
+      return reader->getZCTCoords(index);
+    }
+
+    std::array<dimension_size_type, 6>
+    ReaderWrapper::getZCTModuloCoords(dimension_size_type index) const
+    {
+      return reader->getZCTModuloCoords(index);
+    }
+
+    DimensionIndexer
+    ReaderWrapper::getDimensionIndexer() const
+    {
+      return reader->getDimensionIndexer();
+    }
+
+    const MetadataMap::value_type&
+    ReaderWrapper::getMetadataValue(const std::string& field) const
+    {
+      return reader->getMetadataValue(field);
+    }
+
+    const MetadataMap::value_type&
+    ReaderWrapper::getSeriesMetadataValue(const MetadataMap::key_type& field) const
+    {
+      return reader->getSeriesMetadataValue(field);
+    }
+
+    const MetadataMap&
+    ReaderWrapper::getGlobalMetadata() const
+    {
+      return reader->getGlobalMetadata();
+    }
+
+    const MetadataMap&
+    ReaderWrapper::getSeriesMetadata() const
+    {
+      return reader->getSeriesMetadata();
+    }
+
+    const std::vector<std::shared_ptr<CoreMetadata>>&
+    ReaderWrapper::getCoreMetadataList() const
+    {
+      return reader->getCoreMetadataList();
+    }
+
+    void
+    ReaderWrapper::setMetadataFiltered(bool filter)
+    {
+      reader->setMetadataFiltered(filter);
+    }
+
+    bool
+    ReaderWrapper::isMetadataFiltered() const
+    {
+      return reader->isMetadataFiltered();
+    }
+
+    void
+    ReaderWrapper::setMetadataStore(std::shared_ptr<::ome::xml::meta::MetadataStore>& store)
+    {
+      reader->setMetadataStore(store);
+    }
+
+    const std::shared_ptr<::ome::xml::meta::MetadataStore>&
+    ReaderWrapper::getMetadataStore() const
+    {
+      return static_cast<const FormatReader&>(*reader).getMetadataStore();
+    }
+
+    std::shared_ptr<::ome::xml::meta::MetadataStore>&
+    ReaderWrapper::getMetadataStore()
+    {
+      return reader->getMetadataStore();
+    }
+
+    std::vector<std::shared_ptr<::ome::files::FormatReader>>
+    ReaderWrapper::getUnderlyingReaders() const
+    {
+      return std::vector<std::shared_ptr<::ome::files::FormatReader>>{reader};
+    }
+
+    bool
+    ReaderWrapper::isSingleFile(const boost::filesystem::path& id) const
+    {
+      return reader->isSingleFile(id);
+    }
+
+    uint32_t
+    ReaderWrapper::getRequiredDirectories(const std::vector<std::string>& files) const
+    {
+      return reader->getRequiredDirectories(files);
+    }
+
+    const std::string&
+    ReaderWrapper::getDatasetStructureDescription() const
+    {
+      return reader->getDatasetStructureDescription();
+    }
+
+    const std::vector<std::string>&
+    ReaderWrapper::getPossibleDomains(const std::string& id) const
+    {
+      return reader->getPossibleDomains(id);
+    }
+
+    bool
+    ReaderWrapper::hasCompanionFiles() const
+    {
+      return reader->hasCompanionFiles();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getOptimalTileWidth(dimension_size_type channel) const
+    {
+      return reader->getOptimalTileWidth(channel);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getOptimalTileHeight(dimension_size_type channel) const
+    {
+      return reader->getOptimalTileHeight(channel);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getOptimalTileWidth() const
+    {
+      return reader->getOptimalTileWidth();
+    }
+
+    dimension_size_type
+    ReaderWrapper::getOptimalTileHeight() const
+    {
+      return reader->getOptimalTileHeight();
+    }
+
+    dimension_size_type
+    ReaderWrapper::seriesToCoreIndex(dimension_size_type series) const
+    {
+      return reader->seriesToCoreIndex(series);
+    }
+
+    dimension_size_type
+    ReaderWrapper::coreIndexToSeries(dimension_size_type index) const
+    {
+      return reader->coreIndexToSeries(index);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getCoreIndex() const
+    {
+      return reader->getCoreIndex();
+    }
+
+    void
+    ReaderWrapper::setCoreIndex(dimension_size_type index) const
+    {
+      reader->setCoreIndex(index);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getResolutionCount() const
+    {
+      return reader->getResolutionCount();
+    }
+
+    void
+    ReaderWrapper::setResolution(dimension_size_type resolution) const
+    {
+      reader->setResolution(resolution);
+    }
+
+    dimension_size_type
+    ReaderWrapper::getResolution() const
+    {
+      return reader->getResolution();
+    }
+
+    bool
+    ReaderWrapper::hasFlattenedResolutions() const
+    {
+      return reader->hasFlattenedResolutions();
+    }
+
+    void
+    ReaderWrapper::setFlattenedResolutions(bool flatten)
+    {
+      reader->setFlattenedResolutions(flatten);
+    }
+
+  }
+}
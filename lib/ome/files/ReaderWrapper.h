@@ -0,0 +1,603 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_READERWRAPPER_H
+#define OME_FILES_READERWRAPPER_H
+
+#include <memory>
+
+#include <ome/files/FormatReader.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Reader forwarding all methods to another reader.
+     *
+     * This is the base for readers which modify the behaviour of
+     * another reader, for example to present its pixel data
+     * differently.  Derived classes override only the methods whose
+     * behaviour they change; all other methods are forwarded to the
+     * wrapped reader unchanged.
+     */
+    class ReaderWrapper : public FormatReader
+    {
+    protected:
+      /// The wrapped reader.
+      std::shared_ptr<FormatReader> reader;
+
+    public:
+      /**
+       * Constructor.
+       *
+       * @param reader the reader to wrap.
+       * @throws std::logic_error if the reader is null.
+       */
+      explicit
+      ReaderWrapper(const std::shared_ptr<FormatReader>& reader);
+
+      /// Destructor.
+      virtual
+      ~ReaderWrapper();
+
+      /**
+       * Get the wrapped reader.
+       *
+       * @returns the wrapped reader.
+       */
+      const std::shared_ptr<FormatReader>&
+      getReader() const;
+
+      // Documented in superclass.
+      bool
+      isThisType(const boost::filesystem::path& name,
+                 bool                           open = true) const;
+
+      // Documented in superclass.
+      const std::string&
+      getFormat() const;
+
+      // Documented in superclass.
+      const std::string&
+      getFormatDescription() const;
+
+      // Documented in superclass.
+      const std::vector<boost::filesystem::path>&
+      getSuffixes() const;
+
+      // Documented in superclass.
+      const std::vector<boost::filesystem::path>&
+      getCompressionSuffixes() const;
+
+      // Documented in superclass.
+      void
+      setId(const boost::filesystem::path& id);
+
+      // Documented in superclass.
+      void
+      close(bool fileOnly = false);
+
+      // Documented in superclass.
+      std::shared_ptr<IOStatistics>
+      getIOStatistics() const;
+
+      // Documented in superclass.
+      const std::set<MetadataOptions::MetadataLevel>&
+      getSupportedMetadataLevels();
+
+      // Documented in superclass.
+      void
+      setMetadataOptions(const MetadataOptions& options);
+
+      // Documented in superclass.
+      const MetadataOptions&
+      getMetadataOptions() const;
+
+      // Documented in superclass.
+      MetadataOptions&
+      getMetadataOptions();
+
+      // Documented in superclass.
+      bool
+      isThisType(const uint8_t *begin,
+                 const uint8_t *end) const;
+
+      // Documented in superclass.
+      bool
+      isThisType(const uint8_t *begin,
+                 std::size_t     length) const;
+
+      // Documented in superclass.
+      bool
+      isThisType(std::istream& stream) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getImageCount() const;
+
+      // Documented in superclass.
+      bool
+      isRGB(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeX() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeY() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeZ() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeT() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSizeC() const;
+
+      // Documented in superclass.
+      ome::xml::model::enums::PixelType
+      getPixelType() const;
+
+      // Documented in superclass.
+      pixel_size_type
+      getBitsPerPixel() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getEffectiveSizeC() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getRGBChannelCount(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      bool
+      isIndexed() const;
+
+      // Documented in superclass.
+      bool
+      isFalseColor() const;
+
+      // Documented in superclass.
+      void
+      getLookupTable(dimension_size_type plane,
+                     VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      Modulo&
+      getModuloZ();
+
+      // Documented in superclass.
+      const Modulo&
+      getModuloZ() const;
+
+      // Documented in superclass.
+      Modulo&
+      getModuloT();
+
+      // Documented in superclass.
+      const Modulo&
+      getModuloT() const;
+
+      // Documented in superclass.
+      Modulo&
+      getModuloC();
+
+      // Documented in superclass.
+      const Modulo&
+      getModuloC() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getThumbSizeX() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getThumbSizeY() const;
+
+      // Documented in superclass.
+      bool
+      isLittleEndian() const;
+
+      // Documented in superclass.
+      const std::string&
+      getDimensionOrder() const;
+
+      // Documented in superclass.
+      bool
+      isOrderCertain() const;
+
+      // Documented in superclass.
+      bool
+      isThumbnailSeries() const;
+
+      // Documented in superclass.
+      bool
+      isInterleaved() const;
+
+      // Documented in superclass.
+      bool
+      isInterleaved(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openBytes(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const;
+
+      // Documented in superclass.
+      void
+      openBytesBatch(dimension_size_type              plane,
+                     const std::vector<PlaneRegion>&  regions,
+                     std::vector<VariantPixelBuffer>& bufs) const;
+
+      // Documented in superclass.
+      void
+      openBytesDecimated(dimension_size_type plane,
+                         VariantPixelBuffer& buf,
+                         const PlaneRegion&  region,
+                         dimension_size_type xstep,
+                         dimension_size_type ystep) const;
+
+      // Documented in superclass.
+      void
+      openBytesAt(dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  const PlaneRegion&  region) const;
+
+      // Documented in superclass.
+      void
+      openBytesInto(dimension_size_type     series,
+                    dimension_size_type     resolution,
+                    dimension_size_type     plane,
+                    VariantPixelBufferView& buf,
+                    const PlaneRegion&      region) const;
+
+      // Documented in superclass.
+      void
+      openBytesStack(dimension_size_type series,
+                     dimension_size_type resolution,
+                     const plane_range&  zRange,
+                     const plane_range&  cRange,
+                     const plane_range&  tRange,
+                     VariantPixelBuffer& buf,
+                     const PlaneRegion&  region) const;
+
+      // Documented in superclass.
+      void
+      forEachTile(dimension_size_type  plane,
+                  const tile_callback& callback) const;
+
+      // Documented in superclass.
+      void
+      openThumbBytes(dimension_size_type plane,
+                     VariantPixelBuffer& buf) const;
+
+      // Documented in superclass.
+      void
+      openRawTile(dimension_size_type   plane,
+                  dimension_size_type   tile,
+                  std::vector<uint8_t>& buf) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSeriesCount() const;
+
+      // Documented in superclass.
+      void
+      setSeries(dimension_size_type series) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getSeries() const;
+
+      // Documented in superclass.
+      void
+      setPlane(dimension_size_type plane) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getPlane() const;
+
+      // Documented in superclass.
+      void
+      setNormalized(bool normalize);
+
+      // Documented in superclass.
+      bool
+      isNormalized() const;
+
+      // Documented in superclass.
+      void
+      setIndexedExpanded(bool expand);
+
+      // Documented in superclass.
+      bool
+      isIndexedExpanded() const;
+
+      // Documented in superclass.
+      void
+      setDecodeThreads(unsigned int threads);
+
+      // Documented in superclass.
+      unsigned int
+      getDecodeThreads() const;
+
+      // Documented in superclass.
+      void
+      setExecutor(const std::shared_ptr<Executor>& executor);
+
+      // Documented in superclass.
+      std::shared_ptr<Executor>
+      getExecutor() const;
+
+      // Documented in superclass.
+      void
+      setPrefetchPlanes(dimension_size_type planes);
+
+      // Documented in superclass.
+      dimension_size_type
+      getPrefetchPlanes() const;
+
+      // Documented in superclass.
+      void
+      setOriginalMetadataPopulated(bool populate);
+
+      // Documented in superclass.
+      bool
+      isOriginalMetadataPopulated() const;
+
+      // Documented in superclass.
+      void
+      setOriginalMetadataLazy(bool lazy);
+
+      // Documented in superclass.
+      bool
+      isOriginalMetadataLazy() const;
+
+      // Documented in superclass.
+      void
+      setGroupFiles(bool group);
+
+      // Documented in superclass.
+      bool
+      isGroupFiles() const;
+
+      // Documented in superclass.
+      bool
+      isMetadataComplete() const;
+
+      // Documented in superclass.
+      FileGroupOption
+      fileGroupOption(const std::string& id);
+
+      // Documented in superclass.
+      const std::vector<boost::filesystem::path>
+      getUsedFiles(bool noPixels = false) const;
+
+      // Documented in superclass.
+      const std::vector<boost::filesystem::path>
+      getSeriesUsedFiles(bool noPixels = false) const;
+
+      // Documented in superclass.
+      std::vector<FileInfo>
+      getAdvancedUsedFiles(bool noPixels = false) const;
+
+      // Documented in superclass.
+      std::vector<FileInfo>
+      getAdvancedSeriesUsedFiles(bool noPixels = false) const;
+
+      // Documented in superclass.
+      const boost::optional<boost::filesystem::path>&
+      getCurrentFile() const;
+
+      // Documented in superclass.
+      const std::vector<std::string>&
+      getDomains() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getIndex(dimension_size_type z,
+               dimension_size_type c,
+               dimension_size_type t) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getIndex(dimension_size_type z,
+               dimension_size_type c,
+               dimension_size_type t,
+               dimension_size_type moduloZ,
+               dimension_size_type moduloC,
+               dimension_size_type moduloT) const;
+
+      // Documented in superclass.
+      std::array<dimension_size_type, 3>
+      getZCTCoords(dimension_size_type index) const;
+
+      // Documented in superclass.
+      std::array<dimension_size_type, 6>
+      getZCTModuloCoords(dimension_size_type index) const;
+
+      // Documented in superclass.
+      DimensionIndexer
+      getDimensionIndexer() const;
+
+      // Documented in superclass.
+      const MetadataMap::value_type&
+      getMetadataValue(const std::string& field) const;
+
+      // Documented in superclass.
+      const MetadataMap::value_type&
+      getSeriesMetadataValue(const MetadataMap::key_type& field) const;
+
+      // Documented in superclass.
+      const MetadataMap&
+      getGlobalMetadata() const;
+
+      // Documented in superclass.
+      const MetadataMap&
+      getSeriesMetadata() const;
+
+      // Documented in superclass.
+      const std::vector<std::shared_ptr<CoreMetadata>>&
+      getCoreMetadataList() const;
+
+      // Documented in superclass.
+      void
+      setMetadataFiltered(bool filter);
+
+      // Documented in superclass.
+      bool
+      isMetadataFiltered() const;
+
+      // Documented in superclass.
+      void
+      setMetadataStore(std::shared_ptr<::ome::xml::meta::MetadataStore>& store);
+
+      // Documented in superclass.
+      const std::shared_ptr<::ome::xml::meta::MetadataStore>&
+      getMetadataStore() const;
+
+      // Documented in superclass.
+      std::shared_ptr<::ome::xml::meta::MetadataStore>&
+      getMetadataStore();
+
+      // Documented in superclass.
+      std::vector<std::shared_ptr<::ome::files::FormatReader>>
+      getUnderlyingReaders() const;
+
+      // Documented in superclass.
+      bool
+      isSingleFile(const boost::filesystem::path& id) const;
+
+      // Documented in superclass.
+      uint32_t
+      getRequiredDirectories(const std::vector<std::string>& files) const;
+
+      // Documented in superclass.
+      const std::string&
+      getDatasetStructureDescription() const;
+
+      // Documented in superclass.
+      const std::vector<std::string>&
+      getPossibleDomains(const std::string& id) const;
+
+      // Documented in superclass.
+      bool
+      hasCompanionFiles() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileWidth(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileHeight(dimension_size_type channel) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileWidth() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getOptimalTileHeight() const;
+
+      // Documented in superclass.
+      dimension_size_type
+      seriesToCoreIndex(dimension_size_type series) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      coreIndexToSeries(dimension_size_type index) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getCoreIndex() const;
+
+      // Documented in superclass.
+      void
+      setCoreIndex(dimension_size_type index) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getResolutionCount() const;
+
+      // Documented in superclass.
+      void
+      setResolution(dimension_size_type resolution) const;
+
+      // Documented in superclass.
+      dimension_size_type
+      getResolution() const;
+
+      // Documented in superclass.
+      bool
+      hasFlattenedResolutions() const;
+
+      // Documented in superclass.
+      void
+      setFlattenedResolutions(bool flatten);
+    };
+
+  }
+}
+
+#endif // OME_FILES_READERWRAPPER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
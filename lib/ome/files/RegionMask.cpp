@@ -0,0 +1,574 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <locale>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/format.hpp>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/RegionMask.h>
+
+using ome::files::MaskSpan;
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::PlaneRegion;
+using ome::files::RegionMask;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+
+namespace
+{
+
+  typedef std::pair<dimension_size_type, dimension_size_type> range_type;
+
+  // First pixel whose centre is at or after a coordinate.
+  inline int64_t
+  first_pixel(double v)
+  {
+    return static_cast<int64_t>(std::ceil(v - 0.5));
+  }
+
+  // Parse OME-XML points ("x1,y1 x2,y2 ...").
+  std::vector<RegionMask::point_type>
+  parse_points(std::string text)
+  {
+    std::replace(text.begin(), text.end(), ',', ' ');
+    std::istringstream is(text);
+    is.imbue(std::locale::classic());
+
+    std::vector<RegionMask::point_type> points;
+    double x, y;
+    while (is >> x >> y)
+      points.push_back(RegionMask::point_type(x, y));
+    return points;
+  }
+
+  // Add the nonzero pixels of a buffer to a mask.
+  struct MaskVisitor
+  {
+    RegionMask&         mask;
+    dimension_size_type x0;
+    dimension_size_type y0;
+
+    MaskVisitor(RegionMask&         mask,
+                dimension_size_type x0,
+                dimension_size_type y0):
+      mask(mask),
+      x0(x0),
+      y0(y0)
+    {}
+
+    template<typename T>
+    void
+    operator() (const std::shared_ptr<PixelBuffer<T>>& v) const
+    {
+      const PixelBuffer<T>& b(*v);
+      const PixelBufferBase::index *strides = b.strides();
+      const dimension_size_type width = b.shape()[ome::files::DIM_SPATIAL_X];
+      const dimension_size_type height = b.shape()[ome::files::DIM_SPATIAL_Y];
+
+      const T *row = b.origin();
+      for (dimension_size_type y = 0; y < height; ++y, row += strides[ome::files::DIM_SPATIAL_Y])
+        {
+          const T *p = row;
+          dimension_size_type start = 0U;
+          bool in = false;
+          for (dimension_size_type x = 0; x < width; ++x, p += strides[ome::files::DIM_SPATIAL_X])
+            {
+              const bool set = (*p != T());
+              if (set && !in)
+                start = x;
+              else if (!set && in)
+                mask.addSpan(x0 + start, y0 + y, x - start);
+              in = set;
+            }
+          if (in)
+            mask.addSpan(x0 + start, y0 + y, width - start);
+        }
+    }
+  };
+
+  // Copy the pixels of the spans within a tile into the masked
+  // values.
+  struct CopyVisitor
+  {
+    VariantPixelBuffer&                     dest;
+    const PlaneRegion&                      tile;
+    const std::vector<MaskSpan>&            spans;
+    const std::vector<dimension_size_type>& offsets;
+
+    CopyVisitor(VariantPixelBuffer&                     dest,
+                const PlaneRegion&                      tile,
+                const std::vector<MaskSpan>&            spans,
+                const std::vector<dimension_size_type>& offsets):
+      dest(dest),
+      tile(tile),
+      spans(spans),
+      offsets(offsets)
+    {}
+
+    template<typename T>
+    void
+    operator() (const std::shared_ptr<PixelBuffer<T>>& v) const
+    {
+      const PixelBuffer<T>& src(*v);
+      PixelBuffer<T>& out(*ome::compat::get<std::shared_ptr<PixelBuffer<T>>>(dest.vbuffer()));
+
+      const PixelBufferBase::index *sstrides = src.strides();
+      const PixelBufferBase::index *dstrides = out.strides();
+      const dimension_size_type samples = src.shape()[ome::files::DIM_SUBCHANNEL];
+
+      // First span of the first row of the tile.
+      MaskSpan first;
+      first.x = 0U;
+      first.y = tile.y;
+      first.w = 0U;
+      std::vector<MaskSpan>::const_iterator span =
+        std::lower_bound(spans.begin(), spans.end(), first,
+                         [](const MaskSpan& lhs, const MaskSpan& rhs)
+                         {
+                           return lhs.y < rhs.y;
+                         });
+
+      for (; span != spans.end() && span->y < tile.y + tile.h; ++span)
+        {
+          const dimension_size_type x0 = std::max(span->x, tile.x);
+          const dimension_size_type x1 = std::min(span->x + span->w, tile.x + tile.w);
+          if (x0 >= x1)
+            continue;
+
+          const dimension_size_type offset = offsets[static_cast<std::size_t>(span - spans.begin())] + (x0 - span->x);
+          for (dimension_size_type s = 0; s < samples; ++s)
+            {
+              const T *in = src.origin() +
+                (static_cast<PixelBufferBase::index>(s) * sstrides[ome::files::DIM_SUBCHANNEL]) +
+                (static_cast<PixelBufferBase::index>(span->y - tile.y) * sstrides[ome::files::DIM_SPATIAL_Y]) +
+                (static_cast<PixelBufferBase::index>(x0 - tile.x) * sstrides[ome::files::DIM_SPATIAL_X]);
+              T *o = out.array().origin() +
+                (static_cast<PixelBufferBase::index>(s) * dstrides[ome::files::DIM_SUBCHANNEL]) +
+                (static_cast<PixelBufferBase::index>(offset) * dstrides[ome::files::DIM_SPATIAL_X]);
+              for (dimension_size_type x = x0; x < x1;
+                   ++x, in += sstrides[ome::files::DIM_SPATIAL_X], o += dstrides[ome::files::DIM_SPATIAL_X])
+                *o = *in;
+            }
+        }
+    }
+  };
+
+  // Tiles touched by runs of pixels, clipped to the image.
+  std::vector<PlaneRegion>
+  span_tiles(const std::vector<MaskSpan>& spans,
+             dimension_size_type          tileWidth,
+             dimension_size_type          tileHeight,
+             dimension_size_type          sizeX,
+             dimension_size_type          sizeY)
+  {
+    std::set<range_type> touched; // Tile row and column.
+    for (const auto& span : spans)
+      {
+        const dimension_size_type row = span.y / tileHeight;
+        for (dimension_size_type column = span.x / tileWidth;
+             column <= (span.x + span.w - 1U) / tileWidth;
+             ++column)
+          touched.insert(range_type(row, column));
+      }
+
+    const PlaneRegion image(0U, 0U, sizeX, sizeY);
+    std::vector<PlaneRegion> tiles;
+    tiles.reserve(touched.size());
+    for (const auto& t : touched)
+      tiles.push_back(image & PlaneRegion(t.second * tileWidth, t.first * tileHeight, tileWidth, tileHeight));
+    return tiles;
+  }
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    RegionMask::RegionMask():
+      rows()
+    {
+    }
+
+    void
+    RegionMask::addSpan(dimension_size_type x,
+                        dimension_size_type y,
+                        dimension_size_type w)
+    {
+      if (!w)
+        return;
+
+      // Merge with any overlapping or adjacent ranges.
+      std::vector<range_type>& ranges(rows[y]);
+      dimension_size_type start = x;
+      dimension_size_type end = x + w;
+      std::vector<range_type>::iterator first =
+        std::lower_bound(ranges.begin(), ranges.end(), start,
+                         [](const range_type& r, dimension_size_type v)
+                         {
+                           return r.second < v;
+                         });
+      std::vector<range_type>::iterator last = first;
+      for (; last != ranges.end() && last->first <= end; ++last)
+        {
+          start = std::min(start, last->first);
+          end = std::max(end, last->second);
+        }
+      first = ranges.erase(first, last);
+      ranges.insert(first, range_type(start, end));
+    }
+
+    void
+    RegionMask::addClipped(int64_t y,
+                           int64_t x0,
+                           int64_t x1)
+    {
+      x0 = std::max(x0, int64_t(0));
+      if (y < 0 || x1 <= x0)
+        return;
+      addSpan(static_cast<dimension_size_type>(x0), static_cast<dimension_size_type>(y),
+              static_cast<dimension_size_type>(x1 - x0));
+    }
+
+    void
+    RegionMask::addRectangle(double x,
+                             double y,
+                             double width,
+                             double height)
+    {
+      const int64_t x0 = first_pixel(x);
+      const int64_t x1 = first_pixel(x + width);
+      const int64_t y1 = first_pixel(y + height);
+      for (int64_t row = first_pixel(y); row < y1; ++row)
+        addClipped(row, x0, x1);
+    }
+
+    void
+    RegionMask::addEllipse(double x,
+                           double y,
+                           double radiusX,
+                           double radiusY)
+    {
+      if (!(radiusX > 0.0) || !(radiusY > 0.0))
+        return;
+
+      const int64_t y1 = static_cast<int64_t>(std::floor(y + radiusY - 0.5));
+      for (int64_t row = first_pixel(y - radiusY); row <= y1; ++row)
+        {
+          const double dy = (static_cast<double>(row) + 0.5 - y) / radiusY;
+          if (dy * dy > 1.0)
+            continue;
+          const double half = radiusX * std::sqrt(1.0 - (dy * dy));
+          addClipped(row, first_pixel(x - half),
+                     static_cast<int64_t>(std::floor(x + half - 0.5)) + 1);
+        }
+    }
+
+    void
+    RegionMask::addPolygon(const std::vector<point_type>& points)
+    {
+      if (points.size() < 3U)
+        return;
+
+      double miny = points.front().second;
+      double maxy = miny;
+      for (const auto& p : points)
+        {
+          miny = std::min(miny, p.second);
+          maxy = std::max(maxy, p.second);
+        }
+
+      // Edge crossings at the centre of each row, filled with the
+      // even-odd rule.
+      std::vector<double> crossings;
+      const int64_t y1 = first_pixel(maxy);
+      for (int64_t row = first_pixel(miny); row < y1; ++row)
+        {
+          const double yc = static_cast<double>(row) + 0.5;
+          crossings.clear();
+          for (std::size_t i = 0; i < points.size(); ++i)
+            {
+              const point_type& a(points[i]);
+              const point_type& b(points[(i + 1U) % points.size()]);
+              if ((a.second <= yc) != (b.second <= yc))
+                crossings.push_back(a.first + ((yc - a.second) * (b.first - a.first) / (b.second - a.second)));
+            }
+          std::sort(crossings.begin(), crossings.end());
+          for (std::size_t i = 0; i + 1U < crossings.size(); i += 2U)
+            addClipped(row, first_pixel(crossings[i]), first_pixel(crossings[i + 1U]));
+        }
+    }
+
+    void
+    RegionMask::addPolyline(const std::vector<point_type>& points)
+    {
+      if (points.size() == 1U)
+        addPoint(points.front().first, points.front().second);
+
+      // Sample each segment at least twice per pixel.
+      for (std::size_t i = 0; i + 1U < points.size(); ++i)
+        {
+          const point_type& a(points[i]);
+          const point_type& b(points[i + 1U]);
+          const double length = std::max(std::abs(b.first - a.first), std::abs(b.second - a.second));
+          const int64_t steps = static_cast<int64_t>(std::ceil(length * 2.0));
+          for (int64_t step = 0; step <= steps; ++step)
+            {
+              const double t = steps ? static_cast<double>(step) / static_cast<double>(steps) : 0.0;
+              addPoint(a.first + (t * (b.first - a.first)), a.second + (t * (b.second - a.second)));
+            }
+        }
+    }
+
+    void
+    RegionMask::addPoint(double x,
+                         double y)
+    {
+      const int64_t px = static_cast<int64_t>(std::floor(x));
+      addClipped(static_cast<int64_t>(std::floor(y)), px, px + 1);
+    }
+
+    void
+    RegionMask::addMask(const VariantPixelBuffer& mask,
+                        dimension_size_type       x,
+                        dimension_size_type       y)
+    {
+      MaskVisitor v(*this, x, y);
+      ome::compat::visit(v, mask.vbuffer());
+    }
+
+    void
+    RegionMask::addROI(const ::ome::xml::meta::MetadataRetrieve& meta,
+                       dimension_size_type                       roi)
+    {
+      if (roi >= meta.getROICount())
+        {
+          boost::format fmt("Invalid ROI: %1%");
+          fmt % roi;
+          throw std::logic_error(fmt.str());
+        }
+
+      for (dimension_size_type shape = 0U; shape < meta.getShapeCount(roi); ++shape)
+        {
+          const std::string type(meta.getShapeType(roi, shape));
+          if (type == "Rectangle")
+            addRectangle(meta.getRectangleX(roi, shape), meta.getRectangleY(roi, shape),
+                         meta.getRectangleWidth(roi, shape), meta.getRectangleHeight(roi, shape));
+          else if (type == "Ellipse")
+            addEllipse(meta.getEllipseX(roi, shape), meta.getEllipseY(roi, shape),
+                       meta.getEllipseRadiusX(roi, shape), meta.getEllipseRadiusY(roi, shape));
+          else if (type == "Polygon")
+            addPolygon(parse_points(meta.getPolygonPoints(roi, shape)));
+          else if (type == "Polyline")
+            addPolyline(parse_points(meta.getPolylinePoints(roi, shape)));
+          else if (type == "Line")
+            {
+              std::vector<point_type> points;
+              points.push_back(point_type(meta.getLineX1(roi, shape), meta.getLineY1(roi, shape)));
+              points.push_back(point_type(meta.getLineX2(roi, shape), meta.getLineY2(roi, shape)));
+              addPolyline(points);
+            }
+          else if (type == "Point")
+            addPoint(meta.getPointX(roi, shape), meta.getPointY(roi, shape));
+          else if (type != "Label")
+            {
+              boost::format fmt("Unsupported shape type %1% in ROI %2%");
+              fmt % type % roi;
+              throw std::logic_error(fmt.str());
+            }
+        }
+    }
+
+    bool
+    RegionMask::empty() const
+    {
+      return rows.empty();
+    }
+
+    dimension_size_type
+    RegionMask::size() const
+    {
+      dimension_size_type count = 0U;
+      for (const auto& row : rows)
+        for (const auto& r : row.second)
+          count += r.second - r.first;
+      return count;
+    }
+
+    PlaneRegion
+    RegionMask::bounds() const
+    {
+      if (rows.empty())
+        return PlaneRegion();
+
+      dimension_size_type x0 = rows.begin()->second.front().first;
+      dimension_size_type x1 = rows.begin()->second.back().second;
+      for (const auto& row : rows)
+        {
+          x0 = std::min(x0, row.second.front().first);
+          x1 = std::max(x1, row.second.back().second);
+        }
+      const dimension_size_type y0 = rows.begin()->first;
+      const dimension_size_type y1 = rows.rbegin()->first + 1U;
+      return PlaneRegion(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    std::vector<MaskSpan>
+    RegionMask::spans(const PlaneRegion& region) const
+    {
+      std::vector<MaskSpan> ret;
+      for (auto row = rows.lower_bound(region.y);
+           row != rows.end() && row->first < region.y + region.h;
+           ++row)
+        {
+          for (const auto& r : row->second)
+            {
+              const dimension_size_type x0 = std::max(r.first, region.x);
+              const dimension_size_type x1 = std::min(r.second, region.x + region.w);
+              if (x0 >= x1)
+                continue;
+              MaskSpan span;
+              span.x = x0;
+              span.y = row->first;
+              span.w = x1 - x0;
+              ret.push_back(span);
+            }
+        }
+      return ret;
+    }
+
+    std::vector<PlaneRegion>
+    maskTiles(const FormatReader& reader,
+              const RegionMask&   mask)
+    {
+      const dimension_size_type sizeX = reader.getSizeX();
+      const dimension_size_type sizeY = reader.getSizeY();
+      return span_tiles(mask.spans(PlaneRegion(0U, 0U, sizeX, sizeY)),
+                        std::max(reader.getOptimalTileWidth(), dimension_size_type(1U)),
+                        std::max(reader.getOptimalTileHeight(), dimension_size_type(1U)),
+                        sizeX, sizeY);
+    }
+
+    void
+    readMasked(const FormatReader& reader,
+               dimension_size_type plane,
+               const RegionMask&   mask,
+               MaskedPixels&       pixels)
+    {
+      if (plane >= reader.getImageCount())
+        {
+          boost::format fmt("Invalid plane: %1%");
+          fmt % plane;
+          throw std::logic_error(fmt.str());
+        }
+
+      const dimension_size_type sizeX = reader.getSizeX();
+      const dimension_size_type sizeY = reader.getSizeY();
+      pixels.spans = mask.spans(PlaneRegion(0U, 0U, sizeX, sizeY));
+
+      // Position of the values of each span.
+      std::vector<dimension_size_type> offsets;
+      offsets.reserve(pixels.spans.size());
+      dimension_size_type count = 0U;
+      for (const auto& span : pixels.spans)
+        {
+          offsets.push_back(count);
+          count += span.w;
+        }
+
+      std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+      shape.fill(1U);
+      shape[DIM_SPATIAL_X] = count;
+      shape[DIM_SUBCHANNEL] = reader.getRGBChannelCount(reader.getZCTCoords(plane)[1]);
+      pixels.values.setBuffer(shape, reader.getPixelType(), PixelBufferBase::default_storage_order(),
+                              pixels.values.allocator());
+
+      const std::vector<PlaneRegion> tiles
+        (span_tiles(pixels.spans,
+                    std::max(reader.getOptimalTileWidth(), dimension_size_type(1U)),
+                    std::max(reader.getOptimalTileHeight(), dimension_size_type(1U)),
+                    sizeX, sizeY));
+
+      auto read_tile = [&](const PlaneRegion& tile,
+                           VariantPixelBuffer& buf)
+        {
+          if (const CancellationToken *cancel = CancellationToken::current())
+            cancel->check();
+
+          reader.openBytes(plane, buf, tile.x, tile.y, tile.w, tile.h);
+          CopyVisitor v(pixels.values, tile, pixels.spans, offsets);
+          ome::compat::visit(v, buf.vbuffer());
+        };
+
+      const unsigned int nthreads = static_cast<unsigned int>
+        (std::min(static_cast<dimension_size_type>(std::max(reader.getDecodeThreads(), 1U)),
+                  static_cast<dimension_size_type>(tiles.size())));
+
+      if (nthreads < 2U)
+        {
+          VariantPixelBuffer buf;
+          for (const auto& tile : tiles)
+            read_tile(tile, buf);
+          return;
+        }
+
+      // Each task reads every nthreads-th tile, and copies its pixels
+      // into a disjoint part of the values.
+      reader.getExecutor()->parallel(nthreads,
+                                     [&](unsigned int t)
+                                     {
+                                       VariantPixelBuffer buf;
+                                       for (dimension_size_type i = t; i < tiles.size(); i += nthreads)
+                                         read_tile(tiles[i], buf);
+                                     });
+    }
+
+  }
+}
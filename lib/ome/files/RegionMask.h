@@ -0,0 +1,311 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_REGIONMASK_H
+#define OME_FILES_REGIONMASK_H
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+#include <ome/xml/meta/MetadataRetrieve.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * A horizontal run of pixels.
+     */
+    struct MaskSpan
+    {
+      /// Column of the first pixel.
+      dimension_size_type x;
+      /// Row.
+      dimension_size_type y;
+      /// Number of pixels.
+      dimension_size_type w;
+    };
+
+    /**
+     * A set of pixels of an image plane, such as the pixels within
+     * one or more ROI shapes.
+     *
+     * The set is held as runs of pixels for each row, so its size
+     * is proportional to the outline of the shapes rather than
+     * their area.  Shapes are rasterised by pixel centre: a pixel
+     * is in a shape if the centre of the pixel, at (x + 0.5, y +
+     * 0.5), is inside the shape.  Lines and points include the
+     * pixels they pass through.  Parts of shapes at negative
+     * coordinates are left out.
+     */
+    class RegionMask
+    {
+    public:
+      /// A 2D point (x, y).
+      typedef std::pair<double, double> point_type;
+
+      /// Constructor (empty mask).
+      RegionMask();
+
+      /**
+       * Add a run of pixels.
+       *
+       * @param x the column of the first pixel.
+       * @param y the row.
+       * @param w the number of pixels.
+       */
+      void
+      addSpan(dimension_size_type x,
+              dimension_size_type y,
+              dimension_size_type w);
+
+      /**
+       * Add a rectangle.
+       *
+       * @param x the left edge.
+       * @param y the top edge.
+       * @param width the width.
+       * @param height the height.
+       */
+      void
+      addRectangle(double x,
+                   double y,
+                   double width,
+                   double height);
+
+      /**
+       * Add an ellipse.
+       *
+       * @param x the centre column.
+       * @param y the centre row.
+       * @param radiusX the horizontal radius.
+       * @param radiusY the vertical radius.
+       */
+      void
+      addEllipse(double x,
+                 double y,
+                 double radiusX,
+                 double radiusY);
+
+      /**
+       * Add a polygon.
+       *
+       * The polygon is closed, and filled with the even-odd rule.
+       *
+       * @param points the vertices.
+       */
+      void
+      addPolygon(const std::vector<point_type>& points);
+
+      /**
+       * Add a line or polyline.
+       *
+       * @param points the vertices.
+       */
+      void
+      addPolyline(const std::vector<point_type>& points);
+
+      /**
+       * Add a point.
+       *
+       * @param x the column.
+       * @param y the row.
+       */
+      void
+      addPoint(double x,
+               double y);
+
+      /**
+       * Add the nonzero pixels of a mask image.
+       *
+       * Only the first subchannel of the first plane is used.
+       *
+       * @param mask the mask image, of any pixel type.
+       * @param x the column of the first pixel of the mask.
+       * @param y the row of the first pixel of the mask.
+       */
+      void
+      addMask(const VariantPixelBuffer& mask,
+              dimension_size_type       x = 0U,
+              dimension_size_type       y = 0U);
+
+      /**
+       * Add the shapes of an ROI.
+       *
+       * Rectangle, Ellipse, Polygon, Polyline, Line and Point
+       * shapes are added; Label shapes have no area and are
+       * ignored.  Shape transforms and the TheZ, TheT and TheC
+       * attributes of the shapes are not used.
+       *
+       * @param meta the metadata to use.
+       * @param roi the ROI index.
+       * @throws std::logic_error if the ROI index is invalid, or the
+       * ROI contains Mask shapes.
+       */
+      void
+      addROI(const ::ome::xml::meta::MetadataRetrieve& meta,
+             dimension_size_type                       roi);
+
+      /**
+       * Check if the mask is empty.
+       *
+       * @returns @c true if the mask has no pixels.
+       */
+      bool
+      empty() const;
+
+      /**
+       * Get the number of pixels in the mask.
+       *
+       * @returns the number of pixels.
+       */
+      dimension_size_type
+      size() const;
+
+      /**
+       * Get the bounding box of the mask.
+       *
+       * @returns the bounding box, which is empty if the mask is
+       * empty.
+       */
+      PlaneRegion
+      bounds() const;
+
+      /**
+       * Get the runs of pixels within a region.
+       *
+       * The runs are sorted by row and then column, and do not
+       * overlap or touch.
+       *
+       * @param region the region to clip the runs to.
+       * @returns the runs.
+       */
+      std::vector<MaskSpan>
+      spans(const PlaneRegion& region) const;
+
+    private:
+      /// Add a run of pixels, clipped to non-negative coordinates.
+      void
+      addClipped(int64_t y,
+                 int64_t x0,
+                 int64_t x1);
+
+      /// Sorted, disjoint half-open pixel ranges of each row.
+      std::map<dimension_size_type, std::vector<std::pair<dimension_size_type, dimension_size_type>>> rows;
+    };
+
+    /**
+     * Pixels read within a mask.
+     */
+    struct MaskedPixels
+    {
+      /// Runs of pixels, sorted by row and then column.
+      std::vector<MaskSpan> spans;
+      /**
+       * Pixel values of each run in turn, with the pixels along
+       * the @c X dimension, a @c Y size of one, and the
+       * subchannels of the plane.
+       */
+      VariantPixelBuffer values;
+    };
+
+    /**
+     * Get the tiles of the current series and resolution touched by
+     * a mask.
+     *
+     * The tiles are aligned with the tiles of the image (see
+     * FormatReader::getOptimalTileWidth() and
+     * FormatReader::getOptimalTileHeight()), clipped to the image,
+     * and sorted by row and then column.  Only tiles containing at
+     * least one pixel of the mask are included, so sparse and
+     * elongated shapes touch far fewer tiles than their bounding
+     * box.
+     *
+     * @param reader the reader to use.
+     * @param mask the mask.
+     * @returns the tiles.
+     */
+    std::vector<PlaneRegion>
+    maskTiles(const FormatReader& reader,
+              const RegionMask&   mask);
+
+    /**
+     * Read the pixels of a plane of the current series and
+     * resolution within a mask.
+     *
+     * Only the tiles touched by the mask (see maskTiles()) are
+     * read, and only the pixels within the mask are kept, so that
+     * memory use is proportional to the size of the mask.  Tiles
+     * are read in parallel, using up to
+     * FormatReader::getDecodeThreads() tasks of the reader's
+     * executor.  Parts of the mask outside the image are left out.
+     *
+     * @param reader the reader to use.
+     * @param plane the plane index within the series.
+     * @param mask the mask.
+     * @param pixels the runs of pixels read and their values.
+     * @throws FormatException if there was a problem parsing the
+     * metadata of the file.
+     * @throws std::logic_error if the plane is invalid.
+     * @throws ReadCancelledException if the read was cancelled (see
+     * CancellationToken).
+     */
+    void
+    readMasked(const FormatReader& reader,
+               dimension_size_type plane,
+               const RegionMask&   mask,
+               MaskedPixels&       pixels);
+
+  }
+}
+
+#endif // OME_FILES_REGIONMASK_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,556 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/Render.h>
+#include <ome/files/detail/Render.h>
+
+#include <ome/xml/model/primitives/Color.h>
+
+using ome::files::ChannelRendering;
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::PlaneRegion;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+using ::ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  typedef std::array<uint8_t, 3> rgb_type;
+
+  template<typename T>
+  inline double
+  render_value(const T& v)
+  {
+    return static_cast<double>(v);
+  }
+
+  template<typename T>
+  inline double
+  render_value(const std::complex<T>& v)
+  {
+    return static_cast<double>(std::abs(v));
+  }
+
+  // Types rendered with a table indexed by the pixel value.
+  template<typename T>
+  struct DirectRender : std::integral_constant<bool,
+                                               std::is_integral<T>::value && sizeof(T) <= 2U>
+  {};
+
+  template<typename T>
+  inline std::size_t
+  direct_index(const T& v)
+  {
+    return static_cast<std::size_t>(static_cast<int64_t>(v) -
+                                    static_cast<int64_t>(std::numeric_limits<T>::min()));
+  }
+
+  // Settings of one subchannel prepared for a pixel type.
+  struct ChannelKernel
+  {
+    PixelType                 pixeltype;
+    bool                      active;
+    double                    min;
+    double                    scale;
+    std::array<rgb_type, 256> colours;
+    // Colour of each value, for pixel types of up to 16 bits.
+    std::vector<rgb_type>     direct;
+
+    ChannelKernel(const ChannelRendering& setting,
+                  PixelType               pixeltype):
+      pixeltype(pixeltype),
+      active(setting.active),
+      min(setting.min),
+      scale(setting.max > setting.min ?
+            255.0 / (setting.max - setting.min) :
+            std::numeric_limits<double>::max()),
+      colours(),
+      direct()
+    {
+      if (!setting.lut.empty())
+        {
+          if (setting.lut.size() != colours.size())
+            {
+              boost::format fmt("Colour table has %1% entries; 256 required");
+              fmt % setting.lut.size();
+              throw std::logic_error(fmt.str());
+            }
+          std::copy(setting.lut.begin(), setting.lut.end(), colours.begin());
+        }
+      else
+        {
+          for (unsigned int i = 0; i < colours.size(); ++i)
+            for (unsigned int k = 0; k < 3U; ++k)
+              colours[i][k] = static_cast<uint8_t>(((setting.colour[k] * i) + 127U) / 255U);
+        }
+
+      int64_t first = 0;
+      std::size_t count = 0U;
+      switch(pixeltype)
+        {
+        case PixelType::BIT:
+          count = 2U;
+          break;
+        case PixelType::INT8:
+          first = std::numeric_limits<int8_t>::min();
+          count = 256U;
+          break;
+        case PixelType::UINT8:
+          count = 256U;
+          break;
+        case PixelType::INT16:
+          first = std::numeric_limits<int16_t>::min();
+          count = 65536U;
+          break;
+        case PixelType::UINT16:
+          count = 65536U;
+          break;
+        default:
+          break;
+        }
+
+      if (active && count)
+        {
+          direct.resize(count);
+          for (std::size_t i = 0; i < count; ++i)
+            direct[i] = colours[ome::files::detail::windowIndex(static_cast<double>(first + static_cast<int64_t>(i)), min, scale)];
+        }
+    }
+  };
+
+  // Window a row of values.
+  template<typename T>
+  void
+  window_row(const T                *src,
+             PixelBufferBase::index  stride,
+             dimension_size_type     width,
+             const ChannelKernel&    kernel,
+             uint8_t                *indices)
+  {
+    for (dimension_size_type x = 0; x < width; ++x, src += stride)
+      indices[x] = ome::files::detail::windowIndex(render_value(*src), kernel.min, kernel.scale);
+  }
+
+  void
+  window_row(const float            *src,
+             PixelBufferBase::index  stride,
+             dimension_size_type     width,
+             const ChannelKernel&    kernel,
+             uint8_t                *indices)
+  {
+    ome::files::detail::windowIndices(src, stride, width, kernel.min, kernel.scale, indices);
+  }
+
+  void
+  window_row(const double           *src,
+             PixelBufferBase::index  stride,
+             dimension_size_type     width,
+             const ChannelKernel&    kernel,
+             uint8_t                *indices)
+  {
+    ome::files::detail::windowIndices(src, stride, width, kernel.min, kernel.scale, indices);
+  }
+
+  inline void
+  set_colour(uint8_t        *out,
+             const rgb_type& c)
+  {
+    out[0] = c[0];
+    out[1] = c[1];
+    out[2] = c[2];
+  }
+
+  // Set the RGB colours of a row of values; alpha is untouched.
+  template<typename T>
+  void
+  colour_row(const T                *src,
+             PixelBufferBase::index  stride,
+             dimension_size_type     width,
+             const ChannelKernel&    kernel,
+             uint8_t                * /* indices */,
+             uint8_t                *out,
+             std::true_type)
+  {
+    for (dimension_size_type x = 0; x < width; ++x, src += stride, out += 4)
+      set_colour(out, kernel.direct[direct_index(*src)]);
+  }
+
+  template<typename T>
+  void
+  colour_row(const T                *src,
+             PixelBufferBase::index  stride,
+             dimension_size_type     width,
+             const ChannelKernel&    kernel,
+             uint8_t                *indices,
+             uint8_t                *out,
+             std::false_type)
+  {
+    window_row(src, stride, width, kernel, indices);
+    for (dimension_size_type x = 0; x < width; ++x, out += 4)
+      set_colour(out, kernel.colours[indices[x]]);
+  }
+
+  // Add the colour of one subchannel of a buffer.
+  struct RenderVisitor
+  {
+    dimension_size_type  subchannel;
+    const ChannelKernel& kernel;
+    uint8_t             *dest;
+    dimension_size_type  rowPitch;
+
+    RenderVisitor(dimension_size_type  subchannel,
+                  const ChannelKernel& kernel,
+                  uint8_t             *dest,
+                  dimension_size_type  rowPitch):
+      subchannel(subchannel),
+      kernel(kernel),
+      dest(dest),
+      rowPitch(rowPitch)
+    {}
+
+    template<typename T>
+    void
+    operator() (const std::shared_ptr<PixelBuffer<T>>& v) const
+    {
+      const PixelBuffer<T>& b(*v);
+      const PixelBufferBase::index *strides = b.strides();
+      const dimension_size_type width = b.shape()[ome::files::DIM_SPATIAL_X];
+      const dimension_size_type height = b.shape()[ome::files::DIM_SPATIAL_Y];
+      const T *row = b.origin() + (strides[ome::files::DIM_SUBCHANNEL] *
+                                   static_cast<PixelBufferBase::index>(subchannel));
+
+      // Direct tables are only usable for the pixel type they were
+      // prepared for.
+      const bool direct = !kernel.direct.empty() && kernel.pixeltype == b.pixelType();
+
+      // Each row is coloured with zero alpha, and then added to the
+      // destination with saturation.
+      std::vector<uint8_t> colours(width * 4U, 0U);
+      std::vector<uint8_t> indices(direct ? 0U : width);
+
+      for (dimension_size_type y = 0; y < height; ++y, row += strides[ome::files::DIM_SPATIAL_Y])
+        {
+          if (direct)
+            colour_row(row, strides[ome::files::DIM_SPATIAL_X], width, kernel, indices.data(), colours.data(),
+                       std::integral_constant<bool, DirectRender<T>::value>());
+          else
+            colour_row(row, strides[ome::files::DIM_SPATIAL_X], width, kernel, indices.data(), colours.data(),
+                       std::false_type());
+          ome::files::detail::addSaturated(colours.data(), colours.size(), dest + (y * rowPitch));
+        }
+    }
+  };
+
+  // Set a region of the destination to opaque black.
+  void
+  clear_rgba(uint8_t             *dest,
+             dimension_size_type  width,
+             dimension_size_type  height,
+             dimension_size_type  rowPitch)
+  {
+    for (dimension_size_type y = 0; y < height; ++y)
+      {
+        uint8_t *out = dest + (y * rowPitch);
+        for (dimension_size_type x = 0; x < width; ++x, out += 4)
+          {
+            out[0] = out[1] = out[2] = 0U;
+            out[3] = 255U;
+          }
+      }
+  }
+
+  // Add the colour of every subchannel of a buffer, using the
+  // kernels from the given index.
+  void
+  render_buffer(const VariantPixelBuffer&         buf,
+                const std::vector<ChannelKernel>& kernels,
+                dimension_size_type               first,
+                uint8_t                          *dest,
+                dimension_size_type               rowPitch)
+  {
+    const dimension_size_type samples = buf.shape()[ome::files::DIM_SUBCHANNEL];
+    for (dimension_size_type s = 0; s < samples; ++s)
+      {
+        const ChannelKernel& kernel(kernels.at(first + s));
+        if (!kernel.active)
+          continue;
+        RenderVisitor v(s, kernel, dest, rowPitch);
+        ome::compat::visit(v, buf.vbuffer());
+      }
+  }
+
+  // Colours used in turn without a Channel Color.
+  const std::array<rgb_type, 3> default_colours
+    {{
+        {{255U, 0U, 0U}},
+        {{0U, 255U, 0U}},
+        {{0U, 0U, 255U}}
+      }};
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    std::vector<ChannelRendering>
+    defaultChannelRendering(const ::ome::xml::meta::MetadataRetrieve& meta,
+                            dimension_size_type                       series)
+    {
+      const PixelType pixeltype(meta.getPixelsType(series));
+
+      double min = 0.0;
+      double max = 1.0;
+      if (isInteger(pixeltype))
+        {
+          pixel_size_type bits = bitsPerPixel(pixeltype);
+          try
+            {
+              bits = std::min(bits, static_cast<pixel_size_type>(meta.getPixelsSignificantBits(series)));
+            }
+          catch (const ::ome::xml::meta::MetadataException&)
+            {
+              // No SignificantBits; use the pixel type.
+            }
+          if (isSigned(pixeltype))
+            {
+              min = -std::ldexp(1.0, static_cast<int>(bits) - 1);
+              max = std::ldexp(1.0, static_cast<int>(bits) - 1) - 1.0;
+            }
+          else
+            max = std::ldexp(1.0, static_cast<int>(bits)) - 1.0;
+        }
+
+      std::vector<ChannelRendering> settings;
+      const dimension_size_type channels = meta.getChannelCount(series);
+      for (dimension_size_type c = 0; c < channels; ++c)
+        {
+          dimension_size_type samples = 1U;
+          try
+            {
+              samples = meta.getChannelSamplesPerPixel(series, c);
+            }
+          catch (const ::ome::xml::meta::MetadataException&)
+            {
+              // No SamplesPerPixel; default to 1.
+            }
+
+          for (dimension_size_type s = 0; s < samples; ++s)
+            {
+              ChannelRendering setting;
+              setting.min = min;
+              setting.max = max;
+              setting.colour = default_colours[settings.size() % default_colours.size()];
+
+              if (samples == 1U)
+                {
+                  try
+                    {
+                      const ::ome::xml::model::primitives::Color colour(meta.getChannelColor(series, c));
+                      setting.colour = rgb_type{{colour.getRed(), colour.getGreen(), colour.getBlue()}};
+                    }
+                  catch (const ::ome::xml::meta::MetadataException&)
+                    {
+                      if (channels == 1U)
+                        setting.colour = rgb_type{{255U, 255U, 255U}};
+                    }
+                }
+
+              settings.push_back(setting);
+            }
+        }
+
+      return settings;
+    }
+
+    void
+    renderRGBA(const std::vector<VariantPixelBuffer>& planes,
+               const std::vector<ChannelRendering>&   channels,
+               uint8_t                               *dest,
+               dimension_size_type                    rowPitch)
+    {
+      if (planes.empty())
+        throw std::logic_error("No planes to render");
+
+      const dimension_size_type width = planes.front().shape()[DIM_SPATIAL_X];
+      const dimension_size_type height = planes.front().shape()[DIM_SPATIAL_Y];
+
+      std::vector<ChannelKernel> kernels;
+      for (const auto& plane : planes)
+        {
+          if (plane.shape()[DIM_SPATIAL_X] != width ||
+              plane.shape()[DIM_SPATIAL_Y] != height)
+            {
+              boost::format fmt("Plane size (%1%x%2%) does not match first plane (%3%x%4%)");
+              fmt % plane.shape()[DIM_SPATIAL_X] % plane.shape()[DIM_SPATIAL_Y] % width % height;
+              throw std::logic_error(fmt.str());
+            }
+          for (dimension_size_type s = 0; s < plane.shape()[DIM_SUBCHANNEL]; ++s)
+            {
+              if (kernels.size() >= channels.size())
+                break;
+              kernels.push_back(ChannelKernel(channels[kernels.size()], plane.pixelType()));
+            }
+        }
+
+      dimension_size_type samples = 0U;
+      for (const auto& plane : planes)
+        samples += plane.shape()[DIM_SUBCHANNEL];
+      if (samples != channels.size())
+        {
+          boost::format fmt("%1% channel settings do not match %2% subchannels");
+          fmt % channels.size() % samples;
+          throw std::logic_error(fmt.str());
+        }
+
+      clear_rgba(dest, width, height, rowPitch);
+
+      dimension_size_type first = 0U;
+      for (const auto& plane : planes)
+        {
+          render_buffer(plane, kernels, first, dest, rowPitch);
+          first += plane.shape()[DIM_SUBCHANNEL];
+        }
+    }
+
+    void
+    renderRGBA(const FormatReader&                     reader,
+               const std::vector<dimension_size_type>& planes,
+               const PlaneRegion&                      region,
+               const std::vector<ChannelRendering>&    channels,
+               uint8_t                                *dest,
+               dimension_size_type                     rowPitch)
+    {
+      if (planes.empty())
+        throw std::logic_error("No planes to render");
+
+      if (region.w == 0 || region.h == 0 ||
+          region.x + region.w > reader.getSizeX() ||
+          region.y + region.h > reader.getSizeY())
+        {
+          boost::format fmt("Region (%1%,%2% %3%x%4%) is not inside the image (%5%x%6%)");
+          fmt % region.x % region.y % region.w % region.h % reader.getSizeX() % reader.getSizeY();
+          throw std::logic_error(fmt.str());
+        }
+
+      // Subchannels of each plane, and the settings of each
+      // subchannel prepared once for all tiles.
+      std::vector<dimension_size_type> first;
+      dimension_size_type samples = 0U;
+      for (auto plane : planes)
+        {
+          first.push_back(samples);
+          samples += reader.getRGBChannelCount(reader.getZCTCoords(plane)[1]);
+        }
+      if (samples != channels.size())
+        {
+          boost::format fmt("%1% channel settings do not match %2% subchannels");
+          fmt % channels.size() % samples;
+          throw std::logic_error(fmt.str());
+        }
+
+      std::vector<ChannelKernel> kernels;
+      for (const auto& setting : channels)
+        kernels.push_back(ChannelKernel(setting, reader.getPixelType()));
+
+      // Tiles aligned with the tiles of the image.
+      const dimension_size_type tileWidth = std::max(reader.getOptimalTileWidth(), dimension_size_type(1U));
+      const dimension_size_type tileHeight = std::max(reader.getOptimalTileHeight(), dimension_size_type(1U));
+      std::vector<PlaneRegion> tiles;
+      for (dimension_size_type y = (region.y / tileHeight) * tileHeight; y < region.y + region.h; y += tileHeight)
+        for (dimension_size_type x = (region.x / tileWidth) * tileWidth; x < region.x + region.w; x += tileWidth)
+          tiles.push_back(region & PlaneRegion(x, y, tileWidth, tileHeight));
+
+      auto render_tile = [&](const PlaneRegion& tile,
+                             VariantPixelBuffer& buf)
+        {
+          uint8_t *out = dest + ((tile.y - region.y) * rowPitch) + ((tile.x - region.x) * 4U);
+          clear_rgba(out, tile.w, tile.h, rowPitch);
+
+          for (dimension_size_type i = 0; i < planes.size(); ++i)
+            {
+              if (const CancellationToken *cancel = CancellationToken::current())
+                cancel->check();
+
+              reader.openBytes(planes[i], buf, tile.x, tile.y, tile.w, tile.h);
+              render_buffer(buf, kernels, first[i], out, rowPitch);
+            }
+        };
+
+      const unsigned int nthreads = static_cast<unsigned int>
+        (std::min(static_cast<dimension_size_type>(std::max(reader.getDecodeThreads(), 1U)),
+                  static_cast<dimension_size_type>(tiles.size())));
+
+      if (nthreads < 2U)
+        {
+          VariantPixelBuffer buf;
+          for (const auto& tile : tiles)
+            render_tile(tile, buf);
+          return;
+        }
+
+      // Each task renders every nthreads-th tile into a disjoint part
+      // of the destination.
+      reader.getExecutor()->parallel(nthreads,
+                                     [&](unsigned int t)
+                                     {
+                                       VariantPixelBuffer buf;
+                                       for (dimension_size_type i = t; i < tiles.size(); i += nthreads)
+                                         render_tile(tiles[i], buf);
+                                     });
+    }
+
+  }
+}
@@ -0,0 +1,183 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_RENDER_H
+#define OME_FILES_RENDER_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+#include <ome/xml/meta/MetadataRetrieve.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Display settings for a single channel (or subchannel).
+     *
+     * Values are windowed linearly, so that @c min and below map to
+     * the first entry of the colour table and @c max and above map
+     * to the last.  The colour table is @c lut if it is not empty,
+     * and otherwise a ramp from black to @c colour.  Complex values
+     * are rendered by magnitude.
+     */
+    struct ChannelRendering
+    {
+      /// Render this channel.
+      bool active;
+      /// Lower bound of the window.
+      double min;
+      /// Upper bound of the window.
+      double max;
+      /// Colour (red, green, blue) of the channel at the top of the window.
+      std::array<uint8_t, 3> colour;
+      /// Colour table (red, green, blue; 256 entries), or empty to use @c colour.
+      std::vector<std::array<uint8_t, 3>> lut;
+
+      /// Constructor (white, with a window of [0, 1]).
+      ChannelRendering():
+        active(true),
+        min(0.0),
+        max(1.0),
+        colour{{255U, 255U, 255U}},
+        lut()
+      {}
+    };
+
+    /**
+     * Get default display settings for a series.
+     *
+     * There is one setting for each subchannel of each channel, in
+     * order.  The colour is the Channel Color where present, and
+     * otherwise white for a single subchannel, or red, green and
+     * blue in turn.  The window is the range of the significant
+     * bits of integer pixel types, and [0, 1] for floating point
+     * and complex pixel types.
+     *
+     * @param meta the metadata to use.
+     * @param series the image index.
+     * @returns the settings.
+     */
+    std::vector<ChannelRendering>
+    defaultChannelRendering(const ::ome::xml::meta::MetadataRetrieve& meta,
+                            dimension_size_type                       series);
+
+    /**
+     * Render pixel buffers to RGBA8.
+     *
+     * Each buffer holds the plane of one channel, and contributes
+     * one setting per subchannel, in order; @p channels must have
+     * one setting for each subchannel of every buffer.  The colour
+     * of each active channel is added, saturating at 255, and alpha
+     * is always 255.  The buffers may have any pixel type and
+     * storage order, but must have the same width and height.
+     *
+     * For pixel types of up to 16 bits, the window and colour table
+     * are combined into a table indexed by the pixel value, so that
+     * no arithmetic is done per pixel.  Floating point values are
+     * windowed, and the channels are added, using SIMD instructions
+     * where available (SSE2 and NEON).
+     *
+     * @param planes the planes to render.
+     * @param channels the settings for each subchannel.
+     * @param dest the first pixel of the destination, which has four
+     * bytes (red, green, blue, alpha) per pixel.
+     * @param rowPitch the distance between the first pixels of
+     * adjacent rows of the destination (bytes).
+     * @throws std::logic_error if the number of settings or the size
+     * of the buffers do not match, or a colour table does not have
+     * 256 entries.
+     */
+    void
+    renderRGBA(const std::vector<VariantPixelBuffer>& planes,
+               const std::vector<ChannelRendering>&   channels,
+               uint8_t                               *dest,
+               dimension_size_type                    rowPitch);
+
+    /**
+     * Read and render a region of the current series to RGBA8.
+     *
+     * This is equivalent to reading the region of each plane and
+     * rendering them, but the region is read tile by tile (see
+     * FormatReader::getOptimalTileWidth() and
+     * FormatReader::getOptimalTileHeight()), and each tile is
+     * rendered as soon as it is read, so that only one tile of each
+     * plane is held in memory, and is rendered while still in the
+     * cache.  Tiles are read and rendered in parallel, using up to
+     * FormatReader::getDecodeThreads() tasks of the reader's
+     * executor.
+     *
+     * @param reader the reader to use.
+     * @param planes the plane index of each channel to render.
+     * @param region the region to render.
+     * @param channels the settings for each subchannel.
+     * @param dest the first pixel of the destination, which has four
+     * bytes (red, green, blue, alpha) per pixel.
+     * @param rowPitch the distance between the first pixels of
+     * adjacent rows of the destination (bytes).
+     * @throws FormatException if there was a problem parsing the
+     * metadata of the file.
+     * @throws std::logic_error if a plane or the region is invalid,
+     * or the settings do not match the subchannels of the planes.
+     */
+    void
+    renderRGBA(const FormatReader&                     reader,
+               const std::vector<dimension_size_type>& planes,
+               const PlaneRegion&                      region,
+               const std::vector<ChannelRendering>&    channels,
+               uint8_t                                *dest,
+               dimension_size_type                     rowPitch);
+
+  }
+}
+
+#endif // OME_FILES_RENDER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
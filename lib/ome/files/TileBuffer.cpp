@@ -35,8 +35,10 @@
  * #L%
  */
 
+#include <cstdint>
 #include <cstring>
 
+#include <ome/files/AllocationStatistics.h>
 #include <ome/files/TileBuffer.h>
 
 namespace ome
@@ -44,16 +46,25 @@ namespace ome
   namespace files
   {
 
+    const dimension_size_type TileBuffer::alignment;
+
     TileBuffer::TileBuffer(dimension_size_type size):
       bufsize(size),
-      buf(new uint8_t[size])
+      raw(new uint8_t[size + alignment - 1]),
+      buf()
     {
+      std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(raw);
+      addr = (addr + (alignment - 1)) & ~static_cast<std::uintptr_t>(alignment - 1);
+      buf = reinterpret_cast<uint8_t *>(addr);
+
       std::memset(buf, 0, size);
+
+      AllocationStatistics::record(AllocationStatistics::TILE_BUFFER, size + alignment - 1);
     }
 
     TileBuffer::~TileBuffer()
     {
-      delete[] buf;
+      delete[] raw;
     }
 
     dimension_size_type
@@ -50,11 +50,16 @@ namespace ome
     /**
      * Tile pixel data buffer.
      *
-     * Pixel data for a single tile.
+     * Pixel data for a single tile.  The data are aligned to
+     * TileBuffer::alignment bytes, which is suitable for use with
+     * SIMD instructions.
      */
     class TileBuffer
     {
     public:
+      /// Alignment of the buffer data (bytes).
+      static const dimension_size_type alignment = 64U;
+
       /**
        * Constructor.
        *
@@ -103,7 +108,9 @@ namespace ome
     private:
       /// Buffer size (bytes).
       dimension_size_type bufsize;
-      /// Raw buffer.
+      /// Raw allocation, including alignment padding.
+      uint8_t *raw;
+      /// Aligned buffer (within raw).
       uint8_t *buf;
     };
 
@@ -0,0 +1,219 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+
+#include <ome/files/MemoryBudget.h>
+#include <ome/files/TileBufferPool.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    namespace
+    {
+
+      class TileBufferPoolConcrete : public TileBufferPool
+      {
+      public:
+        TileBufferPoolConcrete(dimension_size_type limit):
+          TileBufferPool(limit)
+        {
+        }
+
+        virtual
+        ~TileBufferPoolConcrete()
+        {
+        }
+      };
+
+    }
+
+    const dimension_size_type TileBufferPool::default_limit;
+
+    TileBufferPool::TileBufferPool(dimension_size_type limit):
+      mutex(),
+      limit(limit),
+      retained(0U),
+      buffers(),
+      reclaimer(MemoryBudget::global().addReclaimer
+                (MemoryBudget::TILE_BUFFER_POOL,
+                 [this](dimension_size_type size) { return reclaim(size); }))
+    {
+    }
+
+    TileBufferPool::~TileBufferPool()
+    {
+      MemoryBudget::global().removeReclaimer(reclaimer);
+      MemoryBudget::global().remove(MemoryBudget::TILE_BUFFER_POOL, retained);
+    }
+
+    std::shared_ptr<TileBufferPool>
+    TileBufferPool::create(dimension_size_type limit)
+    {
+      return std::make_shared<TileBufferPoolConcrete>(limit);
+    }
+
+    const std::shared_ptr<TileBufferPool>&
+    TileBufferPool::global()
+    {
+      static std::shared_ptr<TileBufferPool> pool(create());
+      return pool;
+    }
+
+    TileBufferPool::value_type
+    TileBufferPool::acquire(dimension_size_type size,
+                            bool                clear)
+    {
+      std::unique_ptr<TileBuffer> buffer;
+
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        auto i = buffers.find(size);
+        if (i != buffers.end() && !i->second.empty())
+          {
+            buffer = std::move(i->second.back());
+            i->second.pop_back();
+            retained -= size;
+            MemoryBudget::global().remove(MemoryBudget::TILE_BUFFER_POOL, size);
+          }
+      }
+
+      if (buffer)
+        {
+          if (clear)
+            std::memset(buffer->data(), 0, buffer->size());
+        }
+      else
+        buffer.reset(new TileBuffer(size));
+
+      std::weak_ptr<TileBufferPool> pool(shared_from_this());
+      return value_type(buffer.release(),
+                        [pool](TileBuffer *released)
+                        {
+                          std::shared_ptr<TileBufferPool> p(pool.lock());
+                          if (p)
+                            p->release(released);
+                          else
+                            delete released;
+                        });
+    }
+
+    void
+    TileBufferPool::release(TileBuffer *buffer)
+    {
+      std::unique_ptr<TileBuffer> owned(buffer);
+
+      std::lock_guard<std::mutex> guard(mutex);
+
+      // Retain nothing which would exceed the global memory budget.
+      if (retained + owned->size() <= limit && MemoryBudget::global().fits(owned->size()))
+        {
+          retained += owned->size();
+          MemoryBudget::global().add(MemoryBudget::TILE_BUFFER_POOL, owned->size());
+          buffers[owned->size()].push_back(std::move(owned));
+        }
+    }
+
+    void
+    TileBufferPool::setLimit(dimension_size_type limit)
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+
+      this->limit = limit;
+      trim(limit);
+    }
+
+    dimension_size_type
+    TileBufferPool::getLimit() const
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+
+      return limit;
+    }
+
+    dimension_size_type
+    TileBufferPool::size() const
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+
+      return retained;
+    }
+
+    void
+    TileBufferPool::clear()
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+
+      buffers.clear();
+      MemoryBudget::global().remove(MemoryBudget::TILE_BUFFER_POOL, retained);
+      retained = 0U;
+    }
+
+    dimension_size_type
+    TileBufferPool::reclaim(dimension_size_type size)
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+
+      return trim(retained > size ? retained - size : 0U);
+    }
+
+    dimension_size_type
+    TileBufferPool::trim(dimension_size_type limit)
+    {
+      dimension_size_type freed = 0U;
+
+      // Free buffers until within the limit.
+      for (auto i = buffers.begin(); i != buffers.end() && retained > limit; ++i)
+        {
+          while (!i->second.empty() && retained > limit)
+            {
+              retained -= i->first;
+              freed += i->first;
+              i->second.pop_back();
+            }
+        }
+
+      MemoryBudget::global().remove(MemoryBudget::TILE_BUFFER_POOL, freed);
+      return freed;
+    }
+
+  }
+}
@@ -0,0 +1,222 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TILEBUFFERPOOL_H
+#define OME_FILES_TILEBUFFERPOOL_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ome/files/MemoryBudget.h>
+#include <ome/files/Types.h>
+#include <ome/files/TileBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * Pool of reusable tile buffers.
+     *
+     * Allocating and freeing large tile buffers for every image read
+     * or tile written is costly.  The pool hands out TileBuffer
+     * objects, and takes them back for reuse when the last reference
+     * to them is released.  Released buffers are grouped by size,
+     * since all the tiles of an image (other than the final strip)
+     * are of the same size; a request is only satisfied by a
+     * released buffer of exactly the requested size.  The total size
+     * of retained buffers is bounded; buffers released when the
+     * limit is reached are freed.  Retained buffers are also counted
+     * by the global MemoryBudget; none are retained which would
+     * exceed its limit, and it may free them when reclaiming memory.
+     *
+     * All methods are thread-safe.  Buffers may outlive the pool;
+     * they will be freed rather than returned to it.
+     */
+    class TileBufferPool : public std::enable_shared_from_this<TileBufferPool>
+    {
+    public:
+      /// Tile buffer type.
+      typedef std::shared_ptr<TileBuffer> value_type;
+
+    protected:
+      /**
+       * Constructor.
+       *
+       * @param limit the maximum total size of retained buffers (bytes).
+       */
+      explicit
+      TileBufferPool(dimension_size_type limit);
+
+    public:
+      /// Destructor.
+      virtual ~TileBufferPool();
+
+      /// @cond SKIP
+      TileBufferPool (const TileBufferPool&) = delete;
+
+      TileBufferPool&
+      operator= (const TileBufferPool&) = delete;
+      /// @endcond SKIP
+
+      /**
+       * Create a tile buffer pool.
+       *
+       * @param limit the maximum total size of retained buffers (bytes).
+       * @returns the new pool.
+       */
+      static
+      std::shared_ptr<TileBufferPool>
+      create(dimension_size_type limit = default_limit);
+
+      /**
+       * Get the global tile buffer pool.
+       *
+       * This is the pool used internally when reading and writing
+       * images.
+       *
+       * @returns the global pool.
+       */
+      static
+      const std::shared_ptr<TileBufferPool>&
+      global();
+
+      /**
+       * Get a tile buffer.
+       *
+       * A released buffer of the requested size is reused if
+       * available, otherwise a new buffer is allocated.  New
+       * buffers are always zero-filled.
+       *
+       * @param size the buffer size (bytes).
+       * @param clear @c true to zero-fill reused buffers, @c false if
+       * the caller will overwrite the entire buffer.
+       * @returns the tile buffer.  It will be returned to the pool
+       * when the last reference to it is released.
+       */
+      value_type
+      acquire(dimension_size_type size,
+              bool                clear = true);
+
+      /**
+       * Set the maximum total size of retained buffers.
+       *
+       * @param limit the limit (bytes).
+       */
+      void
+      setLimit(dimension_size_type limit);
+
+      /**
+       * Get the maximum total size of retained buffers.
+       *
+       * @returns the limit (bytes).
+       */
+      dimension_size_type
+      getLimit() const;
+
+      /**
+       * Get the total size of retained buffers.
+       *
+       * @returns the size (bytes).
+       */
+      dimension_size_type
+      size() const;
+
+      /**
+       * Free all retained buffers.
+       */
+      void
+      clear();
+
+      /// Default limit for retained buffers (bytes).
+      static const dimension_size_type default_limit = 256U * 1024U * 1024U;
+
+    private:
+      /**
+       * Return a buffer to the pool.
+       *
+       * @param buffer the buffer to release; ownership is
+       * transferred to the pool.
+       */
+      void
+      release(TileBuffer *buffer);
+
+      /**
+       * Free retained buffers for the global memory budget.
+       *
+       * @param size the size to free.
+       * @returns the size of the buffers freed.
+       */
+      dimension_size_type
+      reclaim(dimension_size_type size);
+
+      /**
+       * Free retained buffers until within a limit (lock must be
+       * held).
+       *
+       * @param limit the maximum total size of retained buffers.
+       * @returns the size of the buffers freed.
+       */
+      dimension_size_type
+      trim(dimension_size_type limit);
+
+      /// Mutex serialising access to the pool.
+      mutable std::mutex mutex;
+      /// Maximum total size of retained buffers.
+      dimension_size_type limit;
+      /// Total size of retained buffers.
+      dimension_size_type retained;
+      /// Retained buffers, by size.
+      std::map<dimension_size_type, std::vector<std::unique_ptr<TileBuffer>>> buffers;
+      /// Registration with the global memory budget.
+      MemoryBudget::reclaimer_id reclaimer;
+    };
+
+  }
+}
+
+#endif // OME_FILES_TILEBUFFERPOOL_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -35,6 +35,10 @@
  * #L%
  */
 
+#include <cstring>
+
+#include <ome/files/MemoryBudget.h>
+#include <ome/files/TileBufferPool.h>
 #include <ome/files/TileCache.h>
 
 namespace ome
@@ -42,36 +46,130 @@ namespace ome
   namespace files
   {
 
+    const dimension_size_type TileCache::default_free_limit;
+
     TileCache::TileCache():
-      cache()
+      slots(),
+      freelist(),
+      freelimit(default_free_limit),
+      count(0U)
     {
     }
 
+    TileCache::TileCache(dimension_size_type tilecount):
+      slots(),
+      freelist(),
+      freelimit(default_free_limit),
+      count(0U)
+    {
+      reserve(tilecount);
+    }
+
     TileCache::~TileCache()
     {
+      dimension_size_type charged = 0U;
+      for (const auto& s : slots)
+        charged += s.charged;
+      for (const auto& b : freelist)
+        charged += b->size();
+      MemoryBudget::global().remove(MemoryBudget::WRITE_TILE_CACHE, charged);
+    }
+
+    void
+    TileCache::reserve(dimension_size_type tilecount)
+    {
+      if (slots.size() < tilecount)
+        slots.resize(tilecount);
+    }
+
+    void
+    TileCache::setFreeLimit(dimension_size_type limit)
+    {
+      freelimit = limit;
+      trim(freelimit);
+    }
+
+    dimension_size_type
+    TileCache::getFreeLimit() const
+    {
+      return freelimit;
+    }
+
+    dimension_size_type
+    TileCache::freeSize() const
+    {
+      return freelist.size();
+    }
+
+    TileCache::Slot&
+    TileCache::slot(key_type tileindex)
+    {
+      if (tileindex >= slots.size())
+        slots.resize(tileindex + 1);
+      return slots[tileindex];
+    }
+
+    void
+    TileCache::recycle(Slot& s)
+    {
+      MemoryBudget& budget(MemoryBudget::global());
+      budget.remove(MemoryBudget::WRITE_TILE_CACHE, s.charged);
+      s.charged = 0U;
+      if (s.buffer && s.buffer.use_count() == 1 && freelist.size() < freelimit)
+        {
+          budget.add(MemoryBudget::WRITE_TILE_CACHE, s.buffer->size());
+          freelist.push_back(s.buffer);
+        }
+      s.buffer.reset();
+    }
+
+    void
+    TileCache::trim(dimension_size_type limit)
+    {
+      // Released buffers return to the TileBufferPool.
+      while (freelist.size() > limit)
+        {
+          MemoryBudget::global().remove(MemoryBudget::WRITE_TILE_CACHE, freelist.back()->size());
+          freelist.pop_back();
+        }
     }
 
     bool
     TileCache::insert(key_type   tileindex,
                       value_type tilebuffer)
     {
-      std::pair<std::map<key_type, value_type>::iterator, bool> i =
-        cache.insert(std::pair<key_type, value_type>(tileindex, tilebuffer));
-      return i.second;
+      Slot& s(slot(tileindex));
+      if (s.present)
+        return false;
+
+      s.present = true;
+      s.buffer = tilebuffer;
+      if (tilebuffer)
+        {
+          s.charged = tilebuffer->size();
+          MemoryBudget::global().add(MemoryBudget::WRITE_TILE_CACHE, s.charged);
+        }
+      ++count;
+      return true;
     }
 
     void
     TileCache::erase(key_type tileindex)
     {
-      cache.erase(tileindex);
+      if (tileindex < slots.size() && slots[tileindex].present)
+        {
+          Slot& s(slots[tileindex]);
+          recycle(s);
+          s.present = false;
+          --count;
+        }
     }
 
     TileCache::value_type
     TileCache::find(key_type tileindex)
     {
-      std::map<key_type, value_type>::iterator i = cache.find(tileindex);
-      if (i != cache.end())
-        return i->second;
+      if (tileindex < slots.size())
+        return slots[tileindex].buffer;
       else
         return value_type();
     }
@@ -79,38 +177,75 @@ namespace ome
     const TileCache::value_type
     TileCache::find(key_type tileindex) const
     {
-      std::map<key_type, value_type>::const_iterator i = cache.find(tileindex);
-      if (i != cache.end())
-        return i->second;
+      if (tileindex < slots.size())
+        return slots[tileindex].buffer;
       else
         return value_type();
     }
 
+    TileBuffer&
+    TileCache::acquire(key_type            tileindex,
+                       dimension_size_type buffersize)
+    {
+      Slot& s(slot(tileindex));
+      if (!s.present)
+        {
+          s.present = true;
+          ++count;
+        }
+
+      if (!s.buffer)
+        {
+          // Buffers from the free list are already counted.
+          while (!freelist.empty() && !s.buffer)
+            {
+              if (freelist.back()->size() == buffersize)
+                {
+                  s.buffer = freelist.back();
+                  std::memset(s.buffer->data(), 0, s.buffer->size());
+                }
+              else
+                MemoryBudget::global().remove(MemoryBudget::WRITE_TILE_CACHE, freelist.back()->size());
+              freelist.pop_back();
+            }
+          if (!s.buffer)
+            {
+              s.buffer = TileBufferPool::global()->acquire(buffersize);
+              MemoryBudget::global().add(MemoryBudget::WRITE_TILE_CACHE, buffersize);
+            }
+          s.charged = buffersize;
+        }
+
+      return *s.buffer;
+    }
+
     dimension_size_type
     TileCache::size() const
     {
-      return cache.size();
+      return count;
     }
 
     void
     TileCache::clear()
     {
-      cache.clear();
+      for (auto& s : slots)
+        {
+          recycle(s);
+          s.present = false;
+        }
+      count = 0U;
     }
 
     TileCache::value_type&
     TileCache::operator[](key_type tileindex)
     {
-      std::map<key_type, value_type>::iterator i = cache.find(tileindex);
-      if (i != cache.end())
-        return i->second;
-      else
+      Slot& s(slot(tileindex));
+      if (!s.present)
         {
-          value_type value;
-          std::pair<std::map<key_type, value_type>::iterator, bool> i =
-            cache.insert(std::pair<key_type, value_type>(tileindex, value));
-          return i.first->second;
+          s.present = true;
+          ++count;
         }
+      return s.buffer;
     }
 
   }
@@ -41,8 +41,8 @@
 #include <ome/files/Types.h>
 #include <ome/files/TileBuffer.h>
 
-#include <map>
 #include <memory>
+#include <vector>
 
 namespace ome
 {
@@ -53,7 +53,15 @@ namespace ome
      * Tile cache.
      *
      * This is a collection of TileBuffer objects indexed by tile
-     * number.
+     * number.  Tiles are stored in a dense array of slots indexed
+     * directly by tile number, so lookup is constant time.  Buffers
+     * removed from the cache are retained on a free list, and reused
+     * by acquire() to avoid repeated allocation; new buffers are
+     * obtained from the global TileBufferPool.  The free list is
+     * bounded; surplus buffers are released back to the pool, where
+     * the MemoryBudget may reclaim them.  The buffers held are
+     * counted by the global MemoryBudget (buffers assigned using
+     * operator[] are not counted).
      */
     class TileCache
     {
@@ -66,6 +74,14 @@ namespace ome
       /// Constructor.
       TileCache();
 
+      /**
+       * Constructor with preallocated slots.
+       *
+       * @param tilecount the number of tile slots to preallocate.
+       */
+      explicit
+      TileCache(dimension_size_type tilecount);
+
       /// Destructor.
       virtual ~TileCache();
 
@@ -79,6 +95,52 @@ namespace ome
       operator= (const TileCache&) = delete;
       /// @endcond SKIP
 
+      /**
+       * Preallocate tile slots.
+       *
+       * Slots are added on demand as tiles are inserted; reserving
+       * the expected tile count (e.g. from
+       * tiff::TileInfo::tileCount()) avoids reallocating the slot
+       * array.
+       *
+       * @param tilecount the number of tile slots to preallocate.
+       */
+      void
+      reserve(dimension_size_type tilecount);
+
+      /**
+       * Set the maximum number of buffers on the free list.
+       *
+       * Buffers are only reused for later tiles, so retaining the
+       * buffers of one row of tiles (e.g. from
+       * tiff::TileInfo::tileColumnCount()) is sufficient when
+       * writing in row order.  Buffers in excess of the limit are
+       * released.
+       *
+       * @param limit the maximum number of free buffers.
+       */
+      void
+      setFreeLimit(dimension_size_type limit);
+
+      /**
+       * Get the maximum number of buffers on the free list.
+       *
+       * @returns the maximum number of free buffers.
+       */
+      dimension_size_type
+      getFreeLimit() const;
+
+      /**
+       * Get the number of buffers on the free list.
+       *
+       * @returns the number of free buffers.
+       */
+      dimension_size_type
+      freeSize() const;
+
+      /// Default maximum number of buffers on the free list.
+      static const dimension_size_type default_free_limit = 16U;
+
       /**
        * Insert a tile into the tile cache.
        *
@@ -99,6 +161,10 @@ namespace ome
       /**
        * Remove a tile from the tile cache.
        *
+       * If the tile buffer is not referenced elsewhere, it is
+       * retained on the free list for reuse by acquire(), unless the
+       * free list is full.
+       *
        * @param tileindex the tile to remove.
        */
       void
@@ -125,6 +191,24 @@ namespace ome
       const value_type
       find(key_type tileindex) const;
 
+      /**
+       * Get or create a tile in the tile cache.
+       *
+       * If the tile index is not present, a buffer of the specified
+       * size is inserted, reusing a buffer from the free list if one
+       * of the correct size is available.  Reused buffers are
+       * zero-filled, as for newly allocated buffers.
+       *
+       * @param tileindex the tile index to get.
+       * @param buffersize the tile buffer size (bytes), if
+       * inserting a new tile buffer.
+       * @returns the tile buffer corresponding to the specified
+       * tile index.
+       */
+      TileBuffer&
+      acquire(key_type            tileindex,
+              dimension_size_type buffersize);
+
       /**
        * Get the tile cache size.
        *
@@ -135,6 +219,9 @@ namespace ome
 
       /**
        * Clear the tile cache.
+       *
+       * Unreferenced tile buffers are retained on the free list, up
+       * to its limit.
        */
       void
       clear();
@@ -155,8 +242,56 @@ namespace ome
       operator[](key_type tileindex);
 
     private:
-      /// Mapping of tile number to tile buffer.
-      std::map<key_type, value_type> cache;
+      /// A tile slot.
+      struct Slot
+      {
+        /// The slot contains a tile (which may be null).
+        bool present;
+        /// The tile buffer.
+        value_type buffer;
+        /// Size counted by the global memory budget.
+        dimension_size_type charged;
+
+        Slot():
+          present(false),
+          buffer(),
+          charged(0U)
+        {}
+      };
+
+      /**
+       * Get a slot, adding slots if required.
+       *
+       * @param tileindex the tile index of the slot.
+       * @returns the slot.
+       */
+      Slot&
+      slot(key_type tileindex);
+
+      /**
+       * Move the tile buffer of a slot to the free list.
+       *
+       * @param s the slot to recycle; its buffer is null on return.
+       */
+      void
+      recycle(Slot& s);
+
+      /**
+       * Release free buffers in excess of a limit.
+       *
+       * @param limit the number of free buffers to keep.
+       */
+      void
+      trim(dimension_size_type limit);
+
+      /// Tile slots, indexed by tile number.
+      std::vector<Slot> slots;
+      /// Unused tile buffers available for reuse.
+      std::vector<value_type> freelist;
+      /// Maximum number of buffers on the free list.
+      dimension_size_type freelimit;
+      /// Number of tiles present.
+      dimension_size_type count;
     };
 
   }
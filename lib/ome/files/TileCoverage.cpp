@@ -45,7 +45,11 @@
 #endif
 
 #include <algorithm>
+#include <iterator>
 #include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
 
 #include <ome/files/Types.h>
 #include <ome/files/TileCoverage.h>
@@ -118,21 +122,225 @@ namespace ome
     class TileCoverage::Impl
     {
     public:
+      /// Covered rows of a tile, for regions starting at its left edge.
+      struct TileRows
+      {
+        /// Width of the covered rows.
+        dimension_size_type w;
+        /// Covered row intervals as half-open ranges of [y1..y2).
+        std::map<dimension_size_type, dimension_size_type> rows;
+      };
+
       /// Region coverage stored as box ranges.
 #ifdef OME_HAVE_BOOST_GEOMETRY_INDEX_RTREE_HPP
       geomi::rtree<box, geomi::quadratic<16> > rtree;
 #else // ! OME_HAVE_BOOST_GEOMETRY_INDEX_RTREE_HPP
       std::list<box> rtree;
 #endif // OME_HAVE_BOOST_GEOMETRY_INDEX_RTREE_HPP
+      /// Tile width (zero if not using tile row intervals).
+      dimension_size_type tilewidth;
+      /// Tile height (zero if not using tile row intervals).
+      dimension_size_type tileheight;
+      /// Covered rows of each tile, indexed by tile row and column.
+      std::unordered_map<dimension_size_type, TileRows> tiles;
+      /// Total number of row intervals in tiles.
+      dimension_size_type intervals;
 
       /**
        * Constructor.
+       *
+       * @param tilewidth the tile width.
+       * @param tileheight the tile height.
        */
-      Impl():
-        rtree()
+      Impl(dimension_size_type tilewidth = 0,
+           dimension_size_type tileheight = 0):
+        rtree(),
+        tilewidth(tilewidth),
+        tileheight(tileheight),
+        tiles(),
+        intervals(0)
       {
       }
 
+      /**
+       * Get the key of the tile containing a region.
+       *
+       * @param region the region to check.
+       * @param key the tile key.
+       * @returns @c true if the region is within a single tile,
+       * starting at its left edge, or @c false otherwise.
+       */
+      bool
+      tileKey(const PlaneRegion&   region,
+              dimension_size_type& key) const
+      {
+        if (!tilewidth || !tileheight || !region.valid())
+          return false;
+
+        dimension_size_type col = region.x / tilewidth;
+        dimension_size_type row = region.y / tileheight;
+
+        if (region.x != col * tilewidth ||
+            (region.x + region.w - 1) / tilewidth != col ||
+            (region.y + region.h - 1) / tileheight != row)
+          return false;
+
+        key = (row << 32) | col;
+        return true;
+      }
+
+      /**
+       * Covered area within a region from the tile row intervals.
+       *
+       * @param region the region to check.
+       * @returns the covered area.
+       */
+      dimension_size_type
+      tileCoverage(const PlaneRegion& region) const
+      {
+        dimension_size_type area = 0;
+
+        if (tiles.empty() || !region.valid())
+          return area;
+
+        dimension_size_type colstart = region.x / tilewidth;
+        dimension_size_type collimit = ((region.x + region.w - 1) / tilewidth) + 1;
+        dimension_size_type rowstart = region.y / tileheight;
+        dimension_size_type rowlimit = ((region.y + region.h - 1) / tileheight) + 1;
+
+        if ((collimit - colstart) * (rowlimit - rowstart) <= tiles.size())
+          {
+            for (dimension_size_type row = rowstart; row < rowlimit; ++row)
+              for (dimension_size_type col = colstart; col < collimit; ++col)
+                {
+                  auto i = tiles.find((row << 32) | col);
+                  if (i != tiles.end())
+                    area += tileCoverage(i->first, i->second, region);
+                }
+          }
+        else
+          {
+            for (const auto& tile : tiles)
+              area += tileCoverage(tile.first, tile.second, region);
+          }
+
+        return area;
+      }
+
+      /**
+       * Covered area within a region for a single tile.
+       *
+       * @param key the tile key.
+       * @param tile the covered tile rows.
+       * @param region the region to check.
+       * @returns the covered area.
+       */
+      dimension_size_type
+      tileCoverage(dimension_size_type key,
+                   const TileRows&     tile,
+                   const PlaneRegion&  region) const
+      {
+        dimension_size_type area = 0;
+
+        dimension_size_type x = (key & 0xFFFFFFFFU) * tilewidth;
+        PlaneRegion columns(PlaneRegion(x, region.y, tile.w, region.h) & region);
+        if (!columns.valid())
+          return area;
+
+        // First interval which may overlap the region.
+        auto i = tile.rows.upper_bound(region.y);
+        if (i != tile.rows.begin())
+          --i;
+
+        for (; i != tile.rows.end() && i->first < region.y + region.h; ++i)
+          {
+            dimension_size_type y1 = std::max(i->first, region.y);
+            dimension_size_type y2 = std::min(i->second, region.y + region.h);
+            if (y2 > y1)
+              area += (y2 - y1) * columns.w;
+          }
+
+        return area;
+      }
+
+      /**
+       * Covered area within a region from the box ranges.
+       *
+       * @param region the region to check.
+       * @returns the covered area.
+       */
+      dimension_size_type
+      boxCoverage(const PlaneRegion& region)
+      {
+        dimension_size_type area = 0;
+
+        if (rtree.empty())
+          return area;
+
+        box b(box_from_region(region));
+        std::vector<box> results = intersecting(b);
+
+        for(const auto& i : results)
+          {
+            PlaneRegion test(region_from_box(i));
+            PlaneRegion intersection = region & test;
+
+            if (intersection.valid())
+              area += intersection.area();
+          }
+
+        return area;
+      }
+
+      /**
+       * Insert a region as a tile row interval.
+       *
+       * @param region the region to insert.
+       * @param key the key of the tile containing the region.
+       * @returns @c true if the region was inserted, or @c false if
+       * it is not compatible with the tile's existing row intervals
+       * and must be stored as a box range.
+       */
+      bool
+      insertRows(const PlaneRegion&  region,
+                 dimension_size_type key)
+      {
+        auto t = tiles.find(key);
+        if (t == tiles.end())
+          t = tiles.insert(std::make_pair(key, TileRows{region.w, {}})).first;
+        else if (t->second.w != region.w)
+          return false;
+
+        std::map<dimension_size_type, dimension_size_type>& rows(t->second.rows);
+
+        dimension_size_type y1 = region.y;
+        dimension_size_type y2 = region.y + region.h;
+
+        // Merge with the adjacent preceding and following intervals.
+        auto next = rows.lower_bound(y1);
+        if (next != rows.begin())
+          {
+            auto prev = std::prev(next);
+            if (prev->second == y1)
+              {
+                y1 = prev->first;
+                rows.erase(prev);
+                --intervals;
+              }
+          }
+        if (next != rows.end() && next->first == y2)
+          {
+            y2 = next->second;
+            rows.erase(next);
+            --intervals;
+          }
+
+        rows.insert(std::make_pair(y1, y2));
+        ++intervals;
+
+        return true;
+      }
+
       /// Destructor.
       ~Impl()
       {
@@ -198,6 +406,12 @@ namespace ome
     {
     }
 
+    TileCoverage::TileCoverage(dimension_size_type tilewidth,
+                               dimension_size_type tileheight):
+      impl(std::shared_ptr<Impl>(new Impl(tilewidth, tileheight)))
+    {
+    }
+
     TileCoverage::~TileCoverage()
     {
     }
@@ -210,6 +424,11 @@ namespace ome
 
       if (coverage(region) == 0)
         {
+          dimension_size_type key;
+          if (coalesce && impl->tileKey(region, key) &&
+              impl->insertRows(region, key))
+            return true;
+
           box b(box_from_region(region));
 
           if (!coalesce)
@@ -303,32 +522,21 @@ namespace ome
     dimension_size_type
     TileCoverage::size() const
     {
-      return impl->rtree.size();
+      return impl->rtree.size() + impl->intervals;
     }
 
     void
     TileCoverage::clear()
     {
       impl->rtree.clear();
+      impl->tiles.clear();
+      impl->intervals = 0;
     }
 
     dimension_size_type
     TileCoverage::coverage(const PlaneRegion& region) const
     {
-      box b(box_from_region(region));
-      std::vector<box> results = impl->intersecting(b);
-
-      dimension_size_type area = 0;
-      for(const auto& i : results)
-        {
-          PlaneRegion test(region_from_box(i));
-          PlaneRegion intersection = region & test;
-
-          if (intersection.valid())
-            area += intersection.area();
-        }
-
-      return area;
+      return impl->boxCoverage(region) + impl->tileCoverage(region);
     }
 
     bool
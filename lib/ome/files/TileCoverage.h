@@ -56,6 +56,14 @@ namespace ome
      * used, for example, to prevent writing out incomplete tiles
      * and to output tiles in order when used with an accompanying
      * tile cache.
+     *
+     * If constructed with a tile size, regions which lie within a
+     * single tile and start at its left edge are stored as row
+     * intervals of the tile rather than in the R*Tree.  This is the
+     * common case when writing tiles or strips in scanline or tile
+     * order, and makes inserting such regions and checking if a tile
+     * is covered constant time operations; other regions fall back
+     * to the R*Tree.
      */
     class TileCoverage
     {
@@ -63,6 +71,15 @@ namespace ome
       /// Constructor.
       TileCoverage();
 
+      /**
+       * Constructor with tile size.
+       *
+       * @param tilewidth the tile width.
+       * @param tileheight the tile height.
+       */
+      TileCoverage(dimension_size_type tilewidth,
+                   dimension_size_type tileheight);
+
       /// Destructor.
       virtual ~TileCoverage();
 
@@ -81,7 +98,8 @@ namespace ome
        * than 5) and hence lookups will be very fast.  It will be
        * necessary to disable coalescing if the regions will
        * subsequently be removed, since region splitting is not
-       * implemented.
+       * implemented.  When a tile size is set, only coalesced
+       * inserts are stored as tile row intervals.
        *
        * @param region the region to insert.
        * @param coalesce @c true to merge with adjacent tiles, or @c
@@ -0,0 +1,329 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/ReadCancelledException.h>
+#include <ome/files/TileScheduler.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    bool
+    operator< (const TileRequest& lhs,
+               const TileRequest& rhs)
+    {
+      return std::tie(lhs.series, lhs.resolution, lhs.plane,
+                      lhs.region.x, lhs.region.y, lhs.region.w, lhs.region.h) <
+        std::tie(rhs.series, rhs.resolution, rhs.plane,
+                 rhs.region.x, rhs.region.y, rhs.region.w, rhs.region.h);
+    }
+
+    class TileScheduler::Impl : public std::enable_shared_from_this<Impl>
+    {
+    public:
+      /// Position in the queue: priority and request sequence number.
+      typedef std::pair<priority_type, uint64_t> queue_key;
+
+      /// Order by descending priority, then ascending sequence.
+      struct QueueOrder
+      {
+        bool
+        operator() (const queue_key& lhs,
+                    const queue_key& rhs) const
+        {
+          if (lhs.first != rhs.first)
+            return lhs.first > rhs.first;
+          return lhs.second < rhs.second;
+        }
+      };
+
+      /// A queued or active request.
+      struct Entry
+      {
+        /// Position in the queue (if not started).
+        queue_key key;
+        /// The read has started.
+        bool started;
+        /// Token cancelling the read.
+        CancellationToken token;
+        /// Result of the read.
+        std::promise<result_type> promise;
+        /// Shared result of the read.
+        future_type future;
+
+        Entry(const queue_key& key):
+          key(key),
+          started(false),
+          token(),
+          promise(),
+          future(promise.get_future().share())
+        {
+        }
+      };
+
+      /// Reader.
+      std::shared_ptr<const FormatReader> reader;
+      /// Executor.
+      std::shared_ptr<Executor> executor;
+      /// Maximum number of runner tasks.
+      unsigned int concurrency;
+      /// Lock for all the following members.
+      mutable std::mutex mutex;
+      /// Signalled when a read completes.
+      mutable std::condition_variable completed;
+      /// Queued and active requests.
+      std::map<TileRequest, std::shared_ptr<Entry>> entries;
+      /// Queued requests, in order of reading.
+      std::map<queue_key, TileRequest, QueueOrder> queue;
+      /// Next sequence number.
+      uint64_t sequence;
+      /// Number of runner tasks submitted to the executor.
+      unsigned int runners;
+      /// Number of active requests.
+      std::size_t nactive;
+
+      Impl(std::shared_ptr<const FormatReader> reader,
+           std::shared_ptr<Executor>           executor,
+           unsigned int                        concurrency):
+        reader(reader),
+        executor(executor ? executor : reader->getExecutor()),
+        concurrency(concurrency ? concurrency : this->executor->concurrency()),
+        mutex(),
+        completed(),
+        entries(),
+        queue(),
+        sequence(0U),
+        runners(0U),
+        nactive(0U)
+      {
+        if (!this->concurrency)
+          this->concurrency = 1U;
+      }
+
+      // Submit a runner task if the queue has more requests than
+      // the runners can start.  The lock is released before
+      // submitting, since an executor may run the task immediately.
+      void
+      schedule(std::unique_lock<std::mutex>& lock)
+      {
+        if (runners >= concurrency || queue.size() <= runners - nactive)
+          return;
+
+        ++runners;
+        lock.unlock();
+        std::shared_ptr<Impl> self(shared_from_this());
+        executor->submit([self]() { self->run(); });
+      }
+
+      // Read queued requests in order until none remain.
+      void
+      run()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!queue.empty())
+          {
+            auto next = queue.begin();
+            const TileRequest request(next->second);
+            queue.erase(next);
+            std::shared_ptr<Entry> entry(entries.at(request));
+            entry->started = true;
+            ++nactive;
+            lock.unlock();
+
+            try
+              {
+                CancellationToken::Scope scope(entry->token);
+                entry->token.check();
+                std::shared_ptr<VariantPixelBuffer> buf(std::make_shared<VariantPixelBuffer>());
+                reader->openBytesAt(request.series, request.resolution, request.plane,
+                                    *buf, request.region);
+                entry->promise.set_value(buf);
+              }
+            catch (...)
+              {
+                entry->promise.set_exception(std::current_exception());
+              }
+
+            lock.lock();
+            // The entry is replaced if cancelled and requested again.
+            auto found = entries.find(request);
+            if (found != entries.end() && found->second == entry)
+              entries.erase(found);
+            --nactive;
+            completed.notify_all();
+          }
+        --runners;
+      }
+
+      // Remove a queued or active request; a queued request is
+      // completed with ReadCancelledException, and an active request
+      // is cancelled between tiles.  A later request for the same
+      // tile is read again.
+      void
+      cancel(std::map<TileRequest, std::shared_ptr<Entry>>::iterator i)
+      {
+        std::shared_ptr<Entry> entry(i->second);
+        entries.erase(i);
+        if (entry->started)
+          {
+            entry->token.cancel();
+          }
+        else
+          {
+            queue.erase(entry->key);
+            entry->promise.set_exception
+              (std::make_exception_ptr(ReadCancelledException("Read cancelled")));
+            completed.notify_all();
+          }
+      }
+    };
+
+    TileScheduler::TileScheduler(std::shared_ptr<const FormatReader> reader,
+                                 std::shared_ptr<Executor>           executor,
+                                 unsigned int                        concurrency):
+      impl(std::make_shared<Impl>(reader, executor, concurrency))
+    {
+    }
+
+    TileScheduler::~TileScheduler()
+    {
+      cancelAll();
+      std::unique_lock<std::mutex> lock(impl->mutex);
+      impl->completed.wait(lock, [this]() { return impl->nactive == 0U; });
+    }
+
+    TileScheduler::future_type
+    TileScheduler::request(const TileRequest& request,
+                           priority_type      priority)
+    {
+      std::unique_lock<std::mutex> lock(impl->mutex);
+
+      auto found = impl->entries.find(request);
+      if (found != impl->entries.end())
+        {
+          std::shared_ptr<Impl::Entry> entry(found->second);
+          if (!entry->started && priority > entry->key.first)
+            {
+              impl->queue.erase(entry->key);
+              entry->key.first = priority;
+              impl->queue.insert(std::make_pair(entry->key, request));
+            }
+          return entry->future;
+        }
+
+      std::shared_ptr<Impl::Entry> entry
+        (std::make_shared<Impl::Entry>(Impl::queue_key(priority, impl->sequence++)));
+      impl->entries.insert(std::make_pair(request, entry));
+      impl->queue.insert(std::make_pair(entry->key, request));
+      future_type future(entry->future);
+      impl->schedule(lock);
+      return future;
+    }
+
+    bool
+    TileScheduler::setPriority(const TileRequest& request,
+                               priority_type      priority)
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+
+      auto found = impl->entries.find(request);
+      if (found == impl->entries.end() || found->second->started)
+        return false;
+
+      std::shared_ptr<Impl::Entry> entry(found->second);
+      impl->queue.erase(entry->key);
+      entry->key.first = priority;
+      impl->queue.insert(std::make_pair(entry->key, request));
+      return true;
+    }
+
+    bool
+    TileScheduler::cancel(const TileRequest& request)
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+
+      auto found = impl->entries.find(request);
+      if (found == impl->entries.end())
+        return false;
+
+      impl->cancel(found);
+      return true;
+    }
+
+    void
+    TileScheduler::cancelAll()
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+
+      for (auto i = impl->entries.begin(); i != impl->entries.end();)
+        impl->cancel(i++);
+    }
+
+    std::size_t
+    TileScheduler::queued() const
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      return impl->queue.size();
+    }
+
+    std::size_t
+    TileScheduler::active() const
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      return impl->nactive;
+    }
+
+    void
+    TileScheduler::wait() const
+    {
+      std::unique_lock<std::mutex> lock(impl->mutex);
+      impl->completed.wait(lock, [this]() { return impl->queue.empty() && impl->nactive == 0U; });
+    }
+
+  }
+}
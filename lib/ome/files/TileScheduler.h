@@ -0,0 +1,251 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TILESCHEDULER_H
+#define OME_FILES_TILESCHEDULER_H
+
+#include <cstddef>
+#include <future>
+#include <memory>
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    class Executor;
+
+    /**
+     * A tile read request.
+     *
+     * The arguments of FormatReader::openBytesAt().
+     */
+    struct TileRequest
+    {
+      /// The series index.
+      dimension_size_type series;
+      /// The resolution index within the series.
+      dimension_size_type resolution;
+      /// The plane index within the series.
+      dimension_size_type plane;
+      /// The region to read.
+      PlaneRegion region;
+
+      /**
+       * Constructor.
+       *
+       * @param series the series index.
+       * @param resolution the resolution index within the series.
+       * @param plane the plane index within the series.
+       * @param region the region to read.
+       */
+      TileRequest(dimension_size_type series,
+                  dimension_size_type resolution,
+                  dimension_size_type plane,
+                  const PlaneRegion&  region):
+        series(series),
+        resolution(resolution),
+        plane(plane),
+        region(region)
+      {}
+    };
+
+    /**
+     * Compare tile requests.
+     *
+     * @param lhs the first request.
+     * @param rhs the second request.
+     * @returns @c true if @p lhs orders before @p rhs, @c false
+     * otherwise.
+     */
+    bool
+    operator< (const TileRequest& lhs,
+               const TileRequest& rhs);
+
+    /**
+     * Scheduler of tile reads by priority.
+     *
+     * Interactive viewers request many tiles at once, at several
+     * resolutions, and the tiles currently visible matter more than
+     * those being prefetched.  Requests are queued with a priority,
+     * and read with FormatReader::openBytesAt() in order of
+     * priority (highest first, and in order of request for equal
+     * priorities) by up to a fixed number of tasks on the executor.
+     * Since only as many requests are started as there are tasks,
+     * a high priority request is started as soon as a task is free,
+     * whatever is queued behind it.
+     *
+     * A request for a tile already queued or being read is merged
+     * with it, sharing its result, and raises its priority if
+     * higher.  The priority of a queued request may be changed
+     * with setPriority(), for example as the view moves, and
+     * requests no longer needed may be cancelled.  Requests being
+     * read are cancelled using a CancellationToken, between tiles.
+     *
+     * All methods are thread-safe.  The destructor cancels all
+     * requests and waits for the reads in progress.
+     */
+    class TileScheduler
+    {
+    public:
+      /// Priority type; higher priorities are read first.
+      typedef int priority_type;
+
+      /// Result type.
+      typedef std::shared_ptr<const VariantPixelBuffer> result_type;
+
+      /// Future result type.
+      typedef std::shared_future<result_type> future_type;
+
+      /**
+       * Constructor.
+       *
+       * @param reader the reader to read tiles with; it must have
+       * been initialised with setId(), and must not be closed while
+       * the scheduler exists.
+       * @param executor the executor to run reads on, or null to use
+       * the executor of the reader.
+       * @param concurrency the maximum number of concurrent reads;
+       * @c 0 to use the concurrency of the executor.
+       */
+      explicit
+      TileScheduler(std::shared_ptr<const FormatReader> reader,
+                    std::shared_ptr<Executor>           executor = std::shared_ptr<Executor>(),
+                    unsigned int                        concurrency = 0U);
+
+      /// Destructor.
+      ~TileScheduler();
+
+      /// @cond SKIP
+      TileScheduler (const TileScheduler&) = delete;
+
+      TileScheduler&
+      operator= (const TileScheduler&) = delete;
+      /// @endcond SKIP
+
+      /**
+       * Request a tile.
+       *
+       * If the tile is already queued or being read, the existing
+       * request is used, and its priority is raised to @p priority
+       * if higher.
+       *
+       * @param request the tile to read.
+       * @param priority the priority of the request.
+       * @returns the result of the read; errors reading the tile,
+       * and ReadCancelledException if the request is cancelled,
+       * are thrown when getting the result.
+       */
+      future_type
+      request(const TileRequest& request,
+              priority_type      priority);
+
+      /**
+       * Change the priority of a queued request.
+       *
+       * @param request the tile to change.
+       * @param priority the new priority.
+       * @returns @c true if the request is queued, or @c false if it
+       * is not queued (never requested, being read, or completed).
+       */
+      bool
+      setPriority(const TileRequest& request,
+                  priority_type      priority);
+
+      /**
+       * Cancel a request.
+       *
+       * A queued request is removed from the queue, and a request
+       * being read is cancelled between tiles.
+       *
+       * @param request the tile to cancel.
+       * @returns @c true if the request was queued or being read,
+       * @c false otherwise.
+       */
+      bool
+      cancel(const TileRequest& request);
+
+      /**
+       * Cancel all requests.
+       */
+      void
+      cancelAll();
+
+      /**
+       * Get the number of queued requests.
+       *
+       * @returns the number of requests not yet started.
+       */
+      std::size_t
+      queued() const;
+
+      /**
+       * Get the number of requests being read.
+       *
+       * @returns the number of requests started but not completed.
+       */
+      std::size_t
+      active() const;
+
+      /**
+       * Wait until no requests are queued or being read.
+       */
+      void
+      wait() const;
+
+    private:
+      class Impl;
+      /// Private implementation details.
+      std::shared_ptr<Impl> impl;
+    };
+
+  }
+}
+
+#endif // OME_FILES_TILESCHEDULER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,203 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <atomic>
+#include <iomanip>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/Trace.h>
+#include <ome/files/config-internal.h>
+
+namespace
+{
+
+  /// Serialise access to the global sink.
+  std::mutex sink_mutex;
+
+  /// Global sink.
+  std::shared_ptr<ome::files::TraceSink> sink;
+
+  /// Fast check for an active sink.
+  std::atomic<bool> sink_active(false);
+
+  /// Time origin for events.
+  const std::chrono::steady_clock::time_point origin(std::chrono::steady_clock::now());
+
+  /// Next thread identifier.
+  std::atomic<uint64_t> next_thread(1U);
+
+  uint64_t
+  thread_id()
+  {
+    thread_local const uint64_t id = next_thread.fetch_add(1U, std::memory_order_relaxed);
+    return id;
+  }
+
+  // Chrome trace times are in microseconds; keep nanosecond precision.
+  void
+  write_microseconds(std::ostream& stream,
+                     uint64_t      ns)
+  {
+    stream << ns / 1000U << '.'
+           << std::setw(3) << std::setfill('0') << ns % 1000U
+           << std::setfill(' ');
+  }
+
+  uint64_t
+  since_origin(std::chrono::steady_clock::time_point time)
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - origin).count());
+  }
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    TraceSink::TraceSink()
+    {
+    }
+
+    TraceSink::~TraceSink()
+    {
+    }
+
+    ChromeTraceSink::ChromeTraceSink(const boost::filesystem::path& filename):
+      TraceSink(),
+      mutex(),
+      stream(filename.string().c_str(), std::ios::out | std::ios::trunc),
+      events(0U)
+    {
+      if (!stream)
+        {
+          boost::format fmt("Failed to open trace file ‘%1%’");
+          fmt % filename.string();
+          throw std::runtime_error(fmt.str());
+        }
+      stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    }
+
+    ChromeTraceSink::~ChromeTraceSink()
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      stream << "\n]}\n";
+    }
+
+    void
+    ChromeTraceSink::write(const TraceEvent& event)
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      stream << (events ? ",\n" : "\n")
+             << "{\"name\":\"" << event.name
+             << "\",\"cat\":\"" << event.category
+             << "\",\"ph\":\"X\",\"ts\":";
+      write_microseconds(stream, event.start);
+      stream << ",\"dur\":";
+      write_microseconds(stream, event.duration);
+      stream << ",\"pid\":1,\"tid\":" << event.thread << '}';
+      ++events;
+    }
+
+    void
+    setTraceSink(std::shared_ptr<TraceSink> newsink)
+    {
+      std::lock_guard<std::mutex> guard(sink_mutex);
+      sink = newsink;
+      sink_active.store(static_cast<bool>(sink), std::memory_order_relaxed);
+    }
+
+    std::shared_ptr<TraceSink>
+    getTraceSink()
+    {
+      std::lock_guard<std::mutex> guard(sink_mutex);
+      return sink;
+    }
+
+    bool
+    traceEnabled()
+    {
+#ifdef OME_FILES_TRACE
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    TraceScope::TraceScope(const char *category,
+                           const char *name):
+      category(category),
+      name(name),
+      active(sink_active.load(std::memory_order_relaxed)),
+      start(active ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+    {
+    }
+
+    TraceScope::~TraceScope()
+    {
+      if (!active)
+        return;
+
+      std::chrono::steady_clock::time_point end(std::chrono::steady_clock::now());
+      std::shared_ptr<TraceSink> current(getTraceSink());
+      if (current)
+        {
+          TraceEvent event{name, category, since_origin(start),
+                           since_origin(end) - since_origin(start), thread_id()};
+          try
+            {
+              current->write(event);
+            }
+          catch (...)
+            {
+              // Tracing must never break the traced operation.
+            }
+        }
+    }
+
+  }
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,222 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TRACE_H
+#define OME_FILES_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include <boost/filesystem/path.hpp>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * A trace event.
+     *
+     * A completed operation, recorded by TraceScope.
+     */
+    struct TraceEvent
+    {
+      /// Event name (a string literal).
+      const char *name;
+      /// Event category (a string literal).
+      const char *category;
+      /// Start time (nanoseconds since a process-wide origin).
+      uint64_t start;
+      /// Duration (nanoseconds).
+      uint64_t duration;
+      /// Identifier of the thread performing the operation.
+      uint64_t thread;
+    };
+
+    /**
+     * Destination for trace events.
+     *
+     * Implementations must be safe to call concurrently from
+     * multiple threads.
+     */
+    class TraceSink
+    {
+    public:
+      /// Constructor.
+      TraceSink();
+
+      /// Destructor.
+      virtual
+      ~TraceSink();
+
+      /**
+       * Write an event.
+       *
+       * @param event the event to write.
+       */
+      virtual
+      void
+      write(const TraceEvent& event) = 0;
+
+      /// @cond SKIP
+      TraceSink (const TraceSink&) = delete;
+
+      TraceSink&
+      operator= (const TraceSink&) = delete;
+      /// @endcond SKIP
+    };
+
+    /**
+     * Trace sink writing Chrome trace event JSON.
+     *
+     * Events are written as complete ("X") events in the JSON object
+     * format, which may be loaded by @c chrome://tracing or the
+     * Perfetto UI.  The document is completed when the sink is
+     * destroyed.
+     */
+    class ChromeTraceSink : public TraceSink
+    {
+    public:
+      /**
+       * Constructor.
+       *
+       * @param filename the file to write.
+       * @throws std::runtime_error if the file could not be opened.
+       */
+      explicit
+      ChromeTraceSink(const boost::filesystem::path& filename);
+
+      /// Destructor.
+      virtual
+      ~ChromeTraceSink();
+
+      // Documented in superclass.
+      void
+      write(const TraceEvent& event);
+
+    private:
+      /// Serialise writes.
+      std::mutex mutex;
+      /// Output stream.
+      std::ofstream stream;
+      /// Number of events written.
+      uint64_t events;
+    };
+
+    /**
+     * Set the global trace sink.
+     *
+     * Trace events are only recorded if the library was built with
+     * the @c tracing option and a sink is set.
+     *
+     * @param sink the sink to use, or null to stop tracing.
+     */
+    void
+    setTraceSink(std::shared_ptr<TraceSink> sink);
+
+    /**
+     * Get the global trace sink.
+     *
+     * @returns the sink, or null if not tracing.
+     */
+    std::shared_ptr<TraceSink>
+    getTraceSink();
+
+    /**
+     * Check if the library was built with trace event emission.
+     *
+     * @returns @c true if built with the @c tracing option, or
+     * @c false if tracing was compiled out.
+     */
+    bool
+    traceEnabled();
+
+    /**
+     * Trace a scope.
+     *
+     * If a trace sink is set on construction, an event covering the
+     * time from construction to destruction is written to it on
+     * destruction.  Otherwise, nothing is recorded and the clock is
+     * not read.
+     */
+    class TraceScope
+    {
+    public:
+      /**
+       * Constructor.
+       *
+       * @param category the event category (must be a string literal).
+       * @param name the event name (must be a string literal).
+       */
+      TraceScope(const char *category,
+                 const char *name);
+
+      /// Destructor.
+      ~TraceScope();
+
+      /// @cond SKIP
+      TraceScope (const TraceScope&) = delete;
+
+      TraceScope&
+      operator= (const TraceScope&) = delete;
+      /// @endcond SKIP
+
+    private:
+      /// Event category.
+      const char *category;
+      /// Event name.
+      const char *name;
+      /// Tracing active at construction.
+      bool active;
+      /// Start time.
+      std::chrono::steady_clock::time_point start;
+    };
+
+  }
+}
+
+#endif // OME_FILES_TRACE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -35,6 +35,7 @@
  * #L%
  */
 
+#include <algorithm>
 #include <type_traits>
 
 #include <ome/files/VariantPixelBuffer.h>
@@ -90,6 +91,55 @@ namespace
     }
   };
 
+  struct PBAllocatorVisitor
+  {
+    template <typename T>
+    std::shared_ptr<ome::files::PixelBufferAllocator>
+    operator() (const T& v)
+    {
+      if (!v)
+        throw std::runtime_error("Null pixel type");
+      return v->allocator();
+    }
+  };
+
+  // Check if a buffer is the sole user of storage.
+  struct PBUsesStorageVisitor
+  {
+    const void *storage;
+
+    PBUsesStorageVisitor(const void *storage):
+      storage(storage)
+    {}
+
+    template <typename T>
+    bool
+    operator() (const T& v)
+    {
+      return v && v.use_count() == 1 &&
+        static_cast<const void *>(v->data()) == storage;
+    }
+  };
+
+  struct PBConvertVisitor
+  {
+    const ome::files::PixelConversion& conversion;
+
+    PBConvertVisitor(const ome::files::PixelConversion& conversion):
+      conversion(conversion)
+    {}
+
+    template <typename T, typename U>
+    void
+    operator() (const T& dest,
+                const U& src) const
+    {
+      if (!dest || !src)
+        throw std::runtime_error("Null pixel type");
+      conversion.convert(src->data(), dest->data(), src->num_elements());
+    }
+  };
+
   struct PBNumElementsVisitor
   {
     template <typename T>
@@ -316,7 +366,10 @@ namespace ome
   {
 
     VariantPixelBuffer::VariantPixelBuffer(const VariantPixelBuffer& buffer):
-      buffer()
+      buffer(),
+      reserved(),
+      reservedSize(0U),
+      reservedAllocator()
     {
       PBCopyVisitor v(this->buffer);
       ome::compat::visit(v, buffer.buffer);
@@ -336,6 +389,87 @@ namespace ome
       return ome::compat::visit(v, buffer);
     }
 
+    std::shared_ptr<PixelBufferAllocator>
+    VariantPixelBuffer::allocator() const
+    {
+      PBAllocatorVisitor v;
+      return ome::compat::visit(v, buffer);
+    }
+
+    void
+    VariantPixelBuffer::reserve(dimension_size_type                          size,
+                                const std::shared_ptr<PixelBufferAllocator>& allocator)
+    {
+      if (!reusable(size, allocator))
+        reserveStorage(size, allocator);
+    }
+
+    dimension_size_type
+    VariantPixelBuffer::capacity() const
+    {
+      return reserved ? reservedSize : 0U;
+    }
+
+    void
+    VariantPixelBuffer::convertTo(VariantPixelBuffer&                 dest,
+                                  ::ome::xml::model::enums::PixelType pixeltype,
+                                  const PixelConversion&              conversion) const
+    {
+      // Hold the source, in case dest is this buffer.
+      const VariantPixelBuffer src(*this);
+
+      std::array<size_type, PixelBufferBase::dimensions> extents;
+      std::copy(src.shape(), src.shape() + PixelBufferBase::dimensions, extents.begin());
+      dest.setBuffer(extents, pixeltype, src.storage_order(), dest.allocator());
+
+      ome::compat::visit(PBConvertVisitor(conversion), dest.buffer, src.buffer);
+    }
+
+    bool
+    VariantPixelBuffer::reusable(dimension_size_type                          size,
+                                 const std::shared_ptr<PixelBufferAllocator>& allocator) const
+    {
+      if (!reserved || size > reservedSize ||
+          (allocator && allocator != reservedAllocator))
+        return false;
+
+      // Only referenced here, or additionally by the current buffer
+      // if it is not shared.
+      switch (reserved.use_count())
+        {
+        case 1:
+          return true;
+        case 2:
+          {
+            PBUsesStorageVisitor v(reserved.get());
+            return ome::compat::visit(v, buffer);
+          }
+        default:
+          return false;
+        }
+    }
+
+    void
+    VariantPixelBuffer::reserveStorage(dimension_size_type                          size,
+                                       const std::shared_ptr<PixelBufferAllocator>& allocator)
+    {
+      std::shared_ptr<PixelBufferAllocator> alloc(allocator);
+      if (!alloc)
+        alloc = reservedAllocator;
+      if (!alloc)
+        alloc = PixelBufferAllocator::standard();
+
+      // Release unused storage before allocating its replacement.
+      reserved.reset();
+      reserved = std::shared_ptr<void>(alloc->allocate(size),
+                                       [alloc, size](void *ptr)
+                                       {
+                                         alloc->deallocate(ptr, size);
+                                       });
+      reservedSize = size;
+      reservedAllocator = alloc;
+    }
+
     boost::multi_array_types::size_type
     VariantPixelBuffer::num_elements() const
     {
@@ -41,6 +41,7 @@
 #include <memory>
 
 #include <ome/files/PixelBuffer.h>
+#include <ome/files/PixelConversion.h>
 #include <ome/files/PixelProperties.h>
 
 #include <ome/compat/variant.h>
@@ -121,7 +122,10 @@ namespace ome
        */
       explicit
       VariantPixelBuffer():
-        buffer(createBuffer(boost::extents[1][1][1][1][1][1][1][1][1]))
+        buffer(createBuffer(boost::extents[1][1][1][1][1][1][1][1][1])),
+        reserved(),
+        reservedSize(0U),
+        reservedAllocator()
       {
       }
 
@@ -134,13 +138,19 @@ namespace ome
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
        * @param pixeltype the pixel type to store.
+       * @param allocator the storage allocator, or null to use the
+       * default storage.
        */
       template<class ExtentList>
       explicit
-      VariantPixelBuffer(const ExtentList&                   extents,
-                         ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
-                         const storage_order_type&           storage = PixelBufferBase::default_storage_order()):
-        buffer(createBuffer(extents, pixeltype, storage))
+      VariantPixelBuffer(const ExtentList&                            extents,
+                         ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                         const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                         const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>()):
+        buffer(createBuffer(extents, pixeltype, storage, allocator)),
+        reserved(),
+        reservedSize(0U),
+        reservedAllocator()
       {
       }
 
@@ -153,12 +163,18 @@ namespace ome
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
        * @param pixeltype the pixel type to store.
+       * @param allocator the storage allocator, or null to use the
+       * default storage.
        */
       explicit
-      VariantPixelBuffer(const range_type&                   range,
-                         ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
-                         const storage_order_type&           storage = PixelBufferBase::default_storage_order()):
-        buffer(createBuffer(range, pixeltype, storage))
+      VariantPixelBuffer(const range_type&                            range,
+                         ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                         const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                         const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>()):
+        buffer(createBuffer(range, pixeltype, storage, allocator)),
+        reserved(),
+        reservedSize(0U),
+        reservedAllocator()
       {
       }
 
@@ -181,7 +197,10 @@ namespace ome
       template<typename T>
       explicit
       VariantPixelBuffer(std::shared_ptr<PixelBuffer<T>>& buffer):
-        buffer(buffer)
+        buffer(buffer),
+        reserved(),
+        reservedSize(0U),
+        reservedAllocator()
       {
       }
 
@@ -222,15 +241,18 @@ namespace ome
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
        * @param pixeltype the pixel type to store.
+       * @param allocator the storage allocator, or null to use the
+       * default storage.
        * @returns the new buffer contained in a variant.
        */
       template<class T, class ExtentList>
       static variant_buffer_type
-      makeBuffer(const ExtentList&                   extents,
-                 const storage_order_type&           storage,
-                 ::ome::xml::model::enums::PixelType pixeltype)
+      makeBuffer(const ExtentList&                            extents,
+                 const storage_order_type&                    storage,
+                 ::ome::xml::model::enums::PixelType          pixeltype,
+                 const std::shared_ptr<PixelBufferAllocator>& allocator)
       {
-        return variant_buffer_type(std::shared_ptr<PixelBuffer<T>>(new PixelBuffer<T>(extents, pixeltype, ENDIAN_NATIVE, storage)));
+        return variant_buffer_type(std::shared_ptr<PixelBuffer<T>>(new PixelBuffer<T>(extents, pixeltype, ENDIAN_NATIVE, storage, allocator)));
       }
 
       /**
@@ -242,15 +264,18 @@ namespace ome
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
        * @param pixeltype the pixel type to store.
+       * @param allocator the storage allocator, or null to use the
+       * default storage.
        * @returns the new buffer contained in a variant.
        */
       template<class T>
       static variant_buffer_type
-      makeBuffer(const range_type&                   range,
-                 const storage_order_type&           storage,
-                 ::ome::xml::model::enums::PixelType pixeltype)
+      makeBuffer(const range_type&                            range,
+                 const storage_order_type&                    storage,
+                 ::ome::xml::model::enums::PixelType          pixeltype,
+                 const std::shared_ptr<PixelBufferAllocator>& allocator)
       {
-        return variant_buffer_type(std::shared_ptr<PixelBuffer<T>>(new PixelBuffer<T>(range, pixeltype, ENDIAN_NATIVE, storage)));
+        return variant_buffer_type(std::shared_ptr<PixelBuffer<T>>(new PixelBuffer<T>(range, pixeltype, ENDIAN_NATIVE, storage, allocator)));
       }
 
       // No switch default to avoid -Wunreachable-code errors.
@@ -263,7 +288,7 @@ namespace ome
 
 #define OME_FILES_VARIANTPIXELBUFFER_CREATEEXTENTS_CASE(maR, maProperty, maType) \
           case ::ome::xml::model::enums::PixelType::maType:                      \
-            buf = makeBuffer<PixelProperties<::ome::xml::model::enums::PixelType::maType>::std_type>(extents, storage, pixeltype); \
+            buf = makeBuffer<PixelProperties<::ome::xml::model::enums::PixelType::maType>::std_type>(extents, storage, pixeltype, allocator); \
             break;
 
       /**
@@ -275,13 +300,16 @@ namespace ome
        * @param pixeltype the pixel type to store.
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
+       * @param allocator the storage allocator, or null to use the
+       * default storage.
        * @returns the new buffer contained in a variant.
        */
       template<class ExtentList>
       static variant_buffer_type
-      createBuffer(const ExtentList&                   extents,
-                   ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
-                   const storage_order_type&           storage = PixelBufferBase::default_storage_order())
+      createBuffer(const ExtentList&                            extents,
+                   ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                   const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                   const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>())
       {
         variant_buffer_type buf;
 
@@ -297,7 +325,7 @@ namespace ome
 
 #define OME_FILES_VARIANTPIXELBUFFER_CREATERANGE_CASE(maR, maProperty, maType) \
           case ::ome::xml::model::enums::PixelType::maType:                    \
-            buf = makeBuffer<PixelProperties<::ome::xml::model::enums::PixelType::maType>::std_type>(range, storage, pixeltype); \
+            buf = makeBuffer<PixelProperties<::ome::xml::model::enums::PixelType::maType>::std_type>(range, storage, pixeltype, allocator); \
             break;
 
       /**
@@ -309,12 +337,15 @@ namespace ome
        * @param pixeltype the pixel type to store.
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
+       * @param allocator the storage allocator, or null to use the
+       * default storage.
        * @returns the new buffer contained in a variant.
        */
       static variant_buffer_type
-      createBuffer(const range_type&                   range,
-                   ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
-                   const storage_order_type&           storage = PixelBufferBase::default_storage_order())
+      createBuffer(const range_type&                            range,
+                   ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                   const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                   const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>())
       {
         variant_buffer_type buf;
 
@@ -328,58 +359,168 @@ namespace ome
 
 #undef OME_FILES_VARIANTPIXELBUFFER_CREATERANGE_CASE
 
-#ifdef __GNUC__
-#  pragma GCC diagnostic pop
-#endif
+      /**
+       * Reset buffer from extents or ranges, reusing storage (helper).
+       *
+       * The reserved storage is reused if it is large enough and
+       * not referenced by any other buffer, otherwise new storage
+       * is reserved.
+       *
+       * @param extents the extent or range of each dimension.
+       * @param storage the storage ordering.
+       * @param pixeltype the pixel type to store.
+       * @param allocator the storage allocator, or null to use the
+       * allocator of the reserved storage.
+       */
+      template<class T, class ExtentList>
+      void
+      resetBuffer(const ExtentList&                            extents,
+                  const storage_order_type&                    storage,
+                  ::ome::xml::model::enums::PixelType          pixeltype,
+                  const std::shared_ptr<PixelBufferAllocator>& allocator)
+      {
+        const dimension_size_type size = PixelBuffer<T>::storage_size(extents);
+        if (!reusable(size, allocator))
+          reserveStorage(size, allocator);
+        buffer = variant_buffer_type(std::shared_ptr<PixelBuffer<T>>(new PixelBuffer<T>(reserved, reservedSize, extents,
+                                                                                        pixeltype, ENDIAN_NATIVE, storage,
+                                                                                        reservedAllocator)));
+      }
+
+#define OME_FILES_VARIANTPIXELBUFFER_RESET_CASE(maR, maProperty, maType) \
+          case ::ome::xml::model::enums::PixelType::maType:              \
+            resetBuffer<PixelProperties<::ome::xml::model::enums::PixelType::maType>::std_type>(extents, storage, pixeltype, allocator); \
+            break;
 
     public:
       /**
        * Set the buffer from extents (helper).
        *
-       * Storage for the buffer will be allocated internally.
+       * Storage for the buffer will be allocated internally.  The
+       * storage of the existing buffer is reused if it is large
+       * enough and is not referenced elsewhere (for example by a
+       * shallow copy of this buffer); see reserve().
        *
        * @param extents the extent of each dimension.
        * @param pixeltype the pixel type to store.
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
+       * @param allocator the storage allocator, or null to use the
+       * default storage.
        */
       template<class ExtentList>
       void
-      setBuffer(const ExtentList&                   extents,
-                ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
-                const storage_order_type&           storage = PixelBufferBase::default_storage_order())
+      setBuffer(const ExtentList&                            extents,
+                ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>())
       {
-        buffer = createBuffer(extents, pixeltype, storage);
+        switch(pixeltype)
+          {
+            BOOST_PP_SEQ_FOR_EACH(OME_FILES_VARIANTPIXELBUFFER_RESET_CASE, _, OME_XML_MODEL_ENUMS_PIXELTYPE_VALUES);
+          }
       }
 
       /**
        * Set the buffer from ranges (internal storage).
        *
-       * Storage for the buffer will be allocated internally.
+       * Storage for the buffer will be allocated internally.  The
+       * storage of the existing buffer is reused if it is large
+       * enough and is not referenced elsewhere (for example by a
+       * shallow copy of this buffer); see reserve().
        *
        * @param range the range of each dimension.
        * @param pixeltype the pixel type to store.
        * @param storage the storage ordering, defaulting to C array
        * storage ordering.
+       * @param allocator the storage allocator, or null to use the
+       * default storage.
        */
       void
-      setBuffer(const range_type&                   range,
-                ::ome::xml::model::enums::PixelType pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
-                const storage_order_type&           storage = PixelBufferBase::default_storage_order())
+      setBuffer(const range_type&                            range,
+                ::ome::xml::model::enums::PixelType          pixeltype = ::ome::xml::model::enums::PixelType::UINT8,
+                const storage_order_type&                    storage = PixelBufferBase::default_storage_order(),
+                const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>())
       {
-        buffer = createBuffer(range, pixeltype, storage);
+        const range_type& extents(range);
+        switch(pixeltype)
+          {
+            BOOST_PP_SEQ_FOR_EACH(OME_FILES_VARIANTPIXELBUFFER_RESET_CASE, _, OME_XML_MODEL_ENUMS_PIXELTYPE_VALUES);
+          }
       }
 
+#undef OME_FILES_VARIANTPIXELBUFFER_RESET_CASE
+
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+
+      /**
+       * Reserve storage for the buffer.
+       *
+       * Subsequent calls to setBuffer() requiring no more than the
+       * reserved size will reuse the storage rather than allocating.
+       * Storage currently in use by this buffer is reused if large
+       * enough; otherwise new storage is allocated, and the current
+       * buffer contents are unchanged until the next setBuffer().
+       *
+       * @param size the size of the storage (bytes).
+       * @param allocator the storage allocator, or null to use the
+       * allocator of the currently reserved storage, or the system
+       * heap if none is reserved.
+       */
+      void
+      reserve(dimension_size_type                          size,
+              const std::shared_ptr<PixelBufferAllocator>& allocator = std::shared_ptr<PixelBufferAllocator>());
+
+      /**
+       * Get the size of the reserved storage.
+       *
+       * @returns the size (bytes), or @c 0 if no storage is reserved.
+       */
+      dimension_size_type
+      capacity() const;
+
+      /**
+       * Convert the buffer to a different pixel type.
+       *
+       * The destination will have the same shape and storage order
+       * as this buffer; its storage will be reused if possible.  The
+       * destination may be this buffer.
+       *
+       * @param dest the destination buffer.
+       * @param pixeltype the destination pixel type.
+       * @param conversion the conversion to apply.
+       */
+      void
+      convertTo(VariantPixelBuffer&                 dest,
+                ::ome::xml::model::enums::PixelType pixeltype,
+                const PixelConversion&              conversion = PixelConversion()) const;
+
       /**
        * Check if the buffer is internally managed.
        *
        * @returns @c true if the @c MultiArray data is managed
-       * internally (i.e. is a @c multi_array) or @c false if not
-       * managed (i.e. is a @c multi_array_ref).
+       * internally (i.e. is a @c multi_array, or uses storage from
+       * an allocator) or @c false if not managed (i.e. is a @c
+       * multi_array_ref over external storage).
        */
       bool
       managed() const;
 
+      /**
+       * Get the storage allocator.
+       *
+       * Readers resizing a buffer will reuse its allocator, so
+       * setting a buffer with an allocator before reading will
+       * place the pixel data with that allocator.
+       *
+       * @returns the allocator, or null if the default @c
+       * multi_array storage or external storage is used.
+       */
+      std::shared_ptr<PixelBufferAllocator>
+      allocator() const;
+
       /**
        * Get the number of pixel elements in the multi-dimensional array.
        *
@@ -612,9 +753,41 @@ namespace ome
       inline void
       write(std::basic_ostream<charT,traits>& stream) const;
 
+    private:
+      /**
+       * Check if the reserved storage may be reused.
+       *
+       * @param size the required size (bytes).
+       * @param allocator the required allocator, or null for any.
+       * @returns @c true if large enough and not referenced by any
+       * buffer other than this one.
+       */
+      bool
+      reusable(dimension_size_type                          size,
+               const std::shared_ptr<PixelBufferAllocator>& allocator) const;
+
+      /**
+       * Reserve new storage.
+       *
+       * @param size the size of the storage (bytes).
+       * @param allocator the storage allocator, or null to use the
+       * allocator of the currently reserved storage.
+       */
+      void
+      reserveStorage(dimension_size_type                          size,
+                     const std::shared_ptr<PixelBufferAllocator>& allocator);
+
     protected:
       /// Pixel storage.
       variant_buffer_type buffer;
+
+    private:
+      /// Reserved storage, reused by setBuffer().
+      std::shared_ptr<void> reserved;
+      /// Size of the reserved storage (bytes).
+      dimension_size_type reservedSize;
+      /// Allocator for the reserved storage.
+      std::shared_ptr<PixelBufferAllocator> reservedAllocator;
     };
 
     namespace detail
@@ -716,7 +889,7 @@ namespace ome
         {
           if (!v)
             throw std::runtime_error("Null pixel type");
-          v->array().assign(begin, end);
+          v->assign(begin, end);
         }
 
         /**
@@ -841,9 +1014,32 @@ namespace ome
 
           T& destbuf = ome::compat::get<T>(dest.vbuffer());
 
-          typename boost::multi_array_types::index_gen indices;
-          typedef boost::multi_array_types::index_range range;
-          destbuf->array() = v->array()[boost::indices[range()][range()][range()][range()][range()][range(subC,subC+1)][range()][range()][range()]];
+          if (dest_shape[DIM_MODULO_Z] != 1U ||
+              dest_shape[DIM_MODULO_T] != 1U ||
+              dest_shape[DIM_MODULO_C] != 1U)
+            {
+              typedef boost::multi_array_types::index_range range;
+              destbuf->array() = v->array()[boost::indices[range()][range()][range()][range()][range()][range(subC,subC+1)][range()][range()][range()]];
+              return;
+            }
+
+          // Copy each row of the subchannel using the row strides
+          // rather than indexing each pixel.
+          typedef PixelBufferBase::index index;
+          const index sc = static_cast<index>(subC);
+          for (index c = 0; c < static_cast<index>(dest_shape[DIM_CHANNEL]); ++c)
+            for (index t = 0; t < static_cast<index>(dest_shape[DIM_TEMPORAL_T]); ++t)
+              for (index z = 0; z < static_cast<index>(dest_shape[DIM_SPATIAL_Z]); ++z)
+                for (index y = 0; y < static_cast<index>(dest_shape[DIM_SPATIAL_Y]); ++y)
+                  {
+                    const auto srow = v->row(y, z, t, c, sc);
+                    const auto drow = destbuf->row(y, z, t, c);
+                    if (srow.xstride == 1 && drow.xstride == 1)
+                      std::copy(srow.data, srow.data + srow.width, drow.data);
+                    else
+                      for (index x = 0; x < static_cast<index>(srow.width); ++x)
+                        drow.data[x * drow.xstride] = srow.data[x * srow.xstride];
+                  }
         }
       };
 
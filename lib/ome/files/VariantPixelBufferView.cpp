@@ -0,0 +1,358 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+
+#include <boost/format.hpp>
+
+#include <ome/files/VariantPixelBufferView.h>
+
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::PixelBufferView;
+using ome::files::VariantPixelBuffer;
+using ome::files::VariantPixelBufferView;
+using ::ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  struct PBVCreateVisitor
+  {
+    VariantPixelBufferView::variant_buffer_type& dest;
+    const VariantPixelBufferView::indices_type&  offset;
+    const VariantPixelBufferView::extents_type&  extents;
+
+    PBVCreateVisitor(VariantPixelBufferView::variant_buffer_type& dest,
+                     const VariantPixelBufferView::indices_type&  offset,
+                     const VariantPixelBufferView::extents_type&  extents):
+      dest(dest),
+      offset(offset),
+      extents(extents)
+    {}
+
+    template <typename T>
+    void
+    operator() (const std::shared_ptr<PixelBuffer<T>>& v)
+    {
+      if (!v)
+        throw std::runtime_error("Null pixel type");
+      dest = std::make_shared<PixelBufferView<T>>(v, offset, extents);
+    }
+  };
+
+  struct PBVShapeVisitor
+  {
+    template <typename T>
+    const boost::multi_array_types::size_type *
+    operator() (const T& v)
+    {
+      if (!v)
+        throw std::runtime_error("Null pixel type");
+      return v->shape();
+    }
+  };
+
+  struct PBVNumElementsVisitor
+  {
+    template <typename T>
+    boost::multi_array_types::size_type
+    operator() (const T& v)
+    {
+      if (!v)
+        throw std::runtime_error("Null pixel type");
+      return v->num_elements();
+    }
+  };
+
+  struct PBVPixelTypeVisitor
+  {
+    template <typename T>
+    PixelType
+    operator() (const T& v)
+    {
+      if (!v)
+        throw std::runtime_error("Null pixel type");
+      return v->pixelType();
+    }
+  };
+
+  // Create a view of caller-owned memory of a given pixel type,
+  // with strides in bytes.
+  template<typename T>
+  VariantPixelBufferView::variant_buffer_type
+  make_raw_view(void                                        *data,
+                PixelType                                    pixeltype,
+                const VariantPixelBufferView::extents_type&  extents,
+                const std::array<ome::files::dimension_size_type,
+                                 PixelBufferBase::dimensions>& bytestrides)
+  {
+    typename PixelBufferView<T>::strides_type strides;
+    for (uint16_t d = 0; d < PixelBufferBase::dimensions; ++d)
+      {
+        if (bytestrides[d] % sizeof(T))
+          {
+            boost::format fmt("Stride %1% of dimension %2% is not a multiple of the %3% byte pixel size");
+            fmt % bytestrides[d] % d % sizeof(T);
+            throw std::logic_error(fmt.str());
+          }
+        strides[d] = static_cast<PixelBufferBase::index>(bytestrides[d] / sizeof(T));
+      }
+    return std::make_shared<PixelBufferView<T>>(static_cast<T *>(data), extents, strides, pixeltype);
+  }
+
+  // Advance a multi-dimensional index; returns false at the end.
+  bool
+  next_index(VariantPixelBufferView::indices_type&     idx,
+             const boost::multi_array_types::size_type *shape)
+  {
+    for (uint16_t d = 0; d < PixelBufferBase::dimensions; ++d)
+      {
+        if (static_cast<boost::multi_array_types::size_type>(++idx[d]) < shape[d])
+          return true;
+        idx[d] = 0;
+      }
+    return false;
+  }
+
+  // Copy between a view and a buffer of the same pixel type.
+  struct PBVCopyVisitor
+  {
+    const VariantPixelBuffer& buffer;
+    bool                      toView;
+
+    PBVCopyVisitor(const VariantPixelBuffer& buffer,
+                   bool                      toView):
+      buffer(buffer),
+      toView(toView)
+    {}
+
+    template <typename T>
+    void
+    operator() (const std::shared_ptr<PixelBufferView<T>>& v)
+    {
+      const std::shared_ptr<PixelBuffer<T>>& b(ome::compat::get<std::shared_ptr<PixelBuffer<T>>>(buffer.vbuffer()));
+
+      const boost::multi_array_types::size_type *shape = v->shape();
+      if (!v->num_elements())
+        return;
+
+      VariantPixelBufferView::indices_type idx;
+      idx.fill(0);
+      do
+        {
+          if (toView)
+            v->at(idx) = b->at(idx);
+          else
+            b->at(idx) = v->at(idx);
+        }
+      while (next_index(idx, shape));
+    }
+  };
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+
+    VariantPixelBufferView::VariantPixelBufferView(VariantPixelBuffer& buffer):
+      buffer()
+    {
+      indices_type offset;
+      offset.fill(0);
+      extents_type extents;
+      std::copy(buffer.shape(), buffer.shape() + PixelBufferBase::dimensions, extents.begin());
+
+      PBVCreateVisitor v(this->buffer, offset, extents);
+      ome::compat::visit(v, buffer.vbuffer());
+    }
+
+    VariantPixelBufferView::VariantPixelBufferView(VariantPixelBuffer&  buffer,
+                                                   const indices_type&  offset,
+                                                   const extents_type&  extents):
+      buffer()
+    {
+      PBVCreateVisitor v(this->buffer, offset, extents);
+      ome::compat::visit(v, buffer.vbuffer());
+    }
+
+    VariantPixelBufferView::VariantPixelBufferView(VariantPixelBuffer& buffer,
+                                                   const PlaneRegion&  region):
+      buffer()
+    {
+      indices_type offset;
+      offset.fill(0);
+      offset[DIM_SPATIAL_X] = static_cast<indices_type::value_type>(region.x);
+      offset[DIM_SPATIAL_Y] = static_cast<indices_type::value_type>(region.y);
+      extents_type extents;
+      std::copy(buffer.shape(), buffer.shape() + PixelBufferBase::dimensions, extents.begin());
+      extents[DIM_SPATIAL_X] = region.w;
+      extents[DIM_SPATIAL_Y] = region.h;
+
+      PBVCreateVisitor v(this->buffer, offset, extents);
+      ome::compat::visit(v, buffer.vbuffer());
+    }
+
+    VariantPixelBufferView::VariantPixelBufferView(VariantPixelBuffer& buffer,
+                                                   const PlaneRegion&  region,
+                                                   dimension_size_type subC):
+      buffer()
+    {
+      indices_type offset;
+      offset.fill(0);
+      offset[DIM_SPATIAL_X] = static_cast<indices_type::value_type>(region.x);
+      offset[DIM_SPATIAL_Y] = static_cast<indices_type::value_type>(region.y);
+      offset[DIM_SUBCHANNEL] = static_cast<indices_type::value_type>(subC);
+      extents_type extents;
+      std::copy(buffer.shape(), buffer.shape() + PixelBufferBase::dimensions, extents.begin());
+      extents[DIM_SPATIAL_X] = region.w;
+      extents[DIM_SPATIAL_Y] = region.h;
+      extents[DIM_SUBCHANNEL] = 1U;
+
+      PBVCreateVisitor v(this->buffer, offset, extents);
+      ome::compat::visit(v, buffer.vbuffer());
+    }
+
+    // No switch default to avoid -Wunreachable-code errors.
+    // However, this then makes -Wswitch-default complain.  Disable
+    // temporarily.
+#ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+
+#define OME_FILES_VARIANTPIXELBUFFERVIEW_RAW_CASE(maR, maProperty, maType) \
+    case ::ome::xml::model::enums::PixelType::maType:                        \
+      buffer = make_raw_view<PixelProperties<::ome::xml::model::enums::PixelType::maType>::std_type>(data, pixeltype, extents, strides); \
+      break;
+
+    VariantPixelBufferView::VariantPixelBufferView(void                                *data,
+                                                   ::ome::xml::model::enums::PixelType  pixeltype,
+                                                   dimension_size_type                  width,
+                                                   dimension_size_type                  height,
+                                                   dimension_size_type                  samples,
+                                                   dimension_size_type                  pixelStride,
+                                                   dimension_size_type                  rowPitch,
+                                                   dimension_size_type                  sampleStride):
+      buffer()
+    {
+      if (!data)
+        throw std::logic_error("Null pixel data");
+
+      extents_type extents;
+      extents.fill(1U);
+      extents[DIM_SPATIAL_X] = width;
+      extents[DIM_SPATIAL_Y] = height;
+      extents[DIM_SUBCHANNEL] = samples;
+
+      // Dimensions of extent 1 are never stepped.
+      std::array<dimension_size_type, PixelBufferBase::dimensions> strides;
+      strides.fill(0U);
+      strides[DIM_SPATIAL_X] = pixelStride;
+      strides[DIM_SPATIAL_Y] = rowPitch;
+      strides[DIM_SUBCHANNEL] = sampleStride;
+
+      switch(pixeltype)
+        {
+          BOOST_PP_SEQ_FOR_EACH(OME_FILES_VARIANTPIXELBUFFERVIEW_RAW_CASE, _, OME_XML_MODEL_ENUMS_PIXELTYPE_VALUES);
+        }
+    }
+
+#undef OME_FILES_VARIANTPIXELBUFFERVIEW_RAW_CASE
+
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+
+    const VariantPixelBufferView::size_type *
+    VariantPixelBufferView::shape() const
+    {
+      PBVShapeVisitor v;
+      return ome::compat::visit(v, buffer);
+    }
+
+    VariantPixelBufferView::size_type
+    VariantPixelBufferView::num_elements() const
+    {
+      PBVNumElementsVisitor v;
+      return ome::compat::visit(v, buffer);
+    }
+
+    ::ome::xml::model::enums::PixelType
+    VariantPixelBufferView::pixelType() const
+    {
+      PBVPixelTypeVisitor v;
+      return ome::compat::visit(v, buffer);
+    }
+
+    void
+    VariantPixelBufferView::copyTo(VariantPixelBuffer&                       dest,
+                                   const PixelBufferBase::storage_order_type& storage) const
+    {
+      extents_type extents;
+      std::copy(shape(), shape() + PixelBufferBase::dimensions, extents.begin());
+
+      if (dest.pixelType() != pixelType() ||
+          !std::equal(extents.begin(), extents.end(), dest.shape()))
+        dest.setBuffer(extents, pixelType(), storage);
+
+      PBVCopyVisitor v(dest, false);
+      ome::compat::visit(v, buffer);
+    }
+
+    void
+    VariantPixelBufferView::copyFrom(const VariantPixelBuffer& source)
+    {
+      if (source.pixelType() != pixelType())
+        {
+          boost::format fmt("Pixel type %1% incompatible with view pixel type %2%");
+          fmt % source.pixelType() % pixelType();
+          throw std::logic_error(fmt.str());
+        }
+      if (!std::equal(shape(), shape() + PixelBufferBase::dimensions, source.shape()))
+        throw std::logic_error("Buffer shape incompatible with view shape");
+
+      PBVCopyVisitor v(source, true);
+      ome::compat::visit(v, buffer);
+    }
+
+  }
+}
@@ -0,0 +1,259 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_VARIANTPIXELBUFFERVIEW_H
+#define OME_FILES_VARIANTPIXELBUFFERVIEW_H
+
+#include <ome/files/PixelBufferView.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+
+    /**
+     * View of a subset of a VariantPixelBuffer.
+     *
+     * This class uses a variant to support PixelBufferView for all
+     * pixel types, and refers to a crop or subchannel subset of a
+     * VariantPixelBuffer without copying it.  Views may be passed to
+     * FormatWriter::saveBytes() to write part of a larger buffer
+     * directly, and may be filled from a VariantPixelBuffer with
+     * copyFrom().
+     */
+    class VariantPixelBufferView
+    {
+    public:
+      /// Map a PixelType enum to a shared view using a standard language type.
+      template<int P>
+      using PT = std::shared_ptr<PixelBufferView<typename PixelProperties<P>::std_type>>;
+
+      /// View type, allowing assignment of all view types.
+      using variant_buffer_type =
+        ome::compat::variant<PT<::ome::xml::model::enums::PixelType::INT8>,
+                             PT<::ome::xml::model::enums::PixelType::INT16>,
+                             PT<::ome::xml::model::enums::PixelType::INT32>,
+                             PT<::ome::xml::model::enums::PixelType::UINT8>,
+                             PT<::ome::xml::model::enums::PixelType::UINT16>,
+                             PT<::ome::xml::model::enums::PixelType::UINT32>,
+                             PT<::ome::xml::model::enums::PixelType::BIT>,
+                             PT<::ome::xml::model::enums::PixelType::FLOAT>,
+                             PT<::ome::xml::model::enums::PixelType::DOUBLE>,
+                             PT<::ome::xml::model::enums::PixelType::COMPLEXFLOAT>,
+                             PT<::ome::xml::model::enums::PixelType::COMPLEXDOUBLE>>;
+
+      /// Size type.
+      typedef PixelBufferBase::size_type size_type;
+
+      /// Type used to index all dimensions.
+      typedef PixelBufferBase::indices_type indices_type;
+
+      /// Extent of each dimension.
+      typedef std::array<size_type, PixelBufferBase::dimensions> extents_type;
+
+      /**
+       * Construct a view of a whole buffer.
+       *
+       * @param buffer the buffer to view.
+       */
+      explicit
+      VariantPixelBufferView(VariantPixelBuffer& buffer);
+
+      /**
+       * Construct a view of a subset of a buffer.
+       *
+       * @param buffer the buffer to view.
+       * @param offset the index of the first element in each dimension.
+       * @param extents the extent of each dimension.
+       * @throws std::logic_error if the subset is outside the buffer.
+       */
+      VariantPixelBufferView(VariantPixelBuffer&  buffer,
+                             const indices_type&  offset,
+                             const extents_type&  extents);
+
+      /**
+       * Construct a view of a spatial region of a buffer.
+       *
+       * All subchannels are included.
+       *
+       * @param buffer the buffer to view.
+       * @param region the region of the buffer to view.
+       * @throws std::logic_error if the region is outside the buffer.
+       */
+      VariantPixelBufferView(VariantPixelBuffer& buffer,
+                             const PlaneRegion&  region);
+
+      /**
+       * Construct a view of a single subchannel of a spatial region
+       * of a buffer.
+       *
+       * @param buffer the buffer to view.
+       * @param region the region of the buffer to view.
+       * @param subC the subchannel to view.
+       * @throws std::logic_error if the region or subchannel is
+       * outside the buffer.
+       */
+      VariantPixelBufferView(VariantPixelBuffer& buffer,
+                             const PlaneRegion&  region,
+                             dimension_size_type subC);
+
+      /**
+       * Construct a view of caller-owned memory.
+       *
+       * The memory holds a @p width × @p height image with @p
+       * samples subchannels of @p pixeltype, in native endianness.
+       * The strides are in bytes, so that memory owned by other
+       * libraries may be viewed directly, including rows padded to
+       * an alignment, and both interleaved and planar samples.  The
+       * memory must exist for the lifetime of the view.
+       *
+       * @param data the address of the first sample of the first
+       * pixel.
+       * @param pixeltype the pixel type.
+       * @param width the width of the image (pixels).
+       * @param height the height of the image (rows).
+       * @param samples the number of subchannels.
+       * @param pixelStride the distance between the first samples
+       * of adjacent pixels of a row (bytes).
+       * @param rowPitch the distance between the first pixels of
+       * adjacent rows (bytes).
+       * @param sampleStride the distance between adjacent
+       * subchannels of a pixel (bytes).
+       * @throws std::logic_error if the data is null, or a stride is
+       * not a multiple of the size of @p pixeltype.
+       */
+      VariantPixelBufferView(void                                *data,
+                             ::ome::xml::model::enums::PixelType  pixeltype,
+                             dimension_size_type                  width,
+                             dimension_size_type                  height,
+                             dimension_size_type                  samples,
+                             dimension_size_type                  pixelStride,
+                             dimension_size_type                  rowPitch,
+                             dimension_size_type                  sampleStride);
+
+      /// Destructor.
+      virtual
+      ~VariantPixelBufferView()
+      {}
+
+      /**
+       * Get a reference to the variant view.
+       *
+       * @returns a reference to the view.
+       */
+      variant_buffer_type&
+      vbuffer()
+      {
+        return buffer;
+      }
+
+      /**
+       * Get a reference to the variant view.
+       *
+       * @returns a reference to the view.
+       */
+      const variant_buffer_type&
+      vbuffer() const
+      {
+        return buffer;
+      }
+
+      /**
+       * Get the extent of each dimension.
+       *
+       * @returns an array of extents (size is the dimension count).
+       */
+      const size_type *
+      shape() const;
+
+      /**
+       * Get the number of elements in the view.
+       *
+       * @returns the element count.
+       */
+      size_type
+      num_elements() const;
+
+      /**
+       * Get the type of pixels stored in the viewed buffer.
+       *
+       * @returns the pixel type.
+       */
+      ::ome::xml::model::enums::PixelType
+      pixelType() const;
+
+      /**
+       * Copy the viewed pixels into a buffer.
+       *
+       * The destination is resized with the specified storage order
+       * if its pixel type or shape differ from the view.
+       *
+       * @param dest the destination buffer.
+       * @param storage the storage order to use if resizing.
+       */
+      void
+      copyTo(VariantPixelBuffer&                       dest,
+             const PixelBufferBase::storage_order_type& storage = PixelBufferBase::default_storage_order()) const;
+
+      /**
+       * Copy pixels from a buffer into the view.
+       *
+       * @param source the source buffer; its pixel type and shape
+       * must match the view.
+       * @throws std::logic_error if the pixel type or shape differ.
+       */
+      void
+      copyFrom(const VariantPixelBuffer& source);
+
+    private:
+      /// View of the buffer.
+      variant_buffer_type buffer;
+    };
+
+  }
+}
+
+#endif // OME_FILES_VARIANTPIXELBUFFERVIEW_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
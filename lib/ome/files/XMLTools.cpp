@@ -35,12 +35,16 @@
  * #L%
  */
 
-#include <cctype>
+#include <cstring>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 
 #include <ome/files/XMLTools.h>
+#include <ome/files/detail/XMLPlatform.h>
 
 #include <ome/common/xml/ErrorReporter.h>
-#include <ome/common/xml/Platform.h>
 #include <ome/common/xml/String.h>
 
 #include <ome/xml/Document.h>
@@ -53,6 +57,117 @@ namespace
   const std::string xsi_ns("http://www.w3.org/2001/XMLSchema-instance");
   const std::string xml_schema_path("http://www.w3.org/2001/XMLSchema");
 
+  // Get the entity replacing a character, or null if the character
+  // is not escaped.
+  const char *
+  escape_entity(char c)
+  {
+    switch(c)
+      {
+      case '<':
+        return "&lt;";
+      case '>':
+        return "&gt;";
+      case '&':
+        return "&amp;";
+      case '"':
+        return "&quot;";
+      case '\'':
+        return "&apos;";
+      default:
+        return nullptr;
+      }
+  }
+
+  // Find the next character to escape, starting from pos.  Returns
+  // the string size if there are none.
+  std::string::size_type
+  find_escape(const std::string&     s,
+              std::string::size_type pos)
+  {
+    const std::string::size_type size = s.size();
+    const char *data = s.data();
+
+#if defined(__SSE2__)
+    // Skip whole 16-byte blocks with no characters to escape.
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i quot = _mm_set1_epi8('"');
+    const __m128i apos = _mm_set1_epi8('\'');
+    for (; pos + 16U <= size; pos += 16U)
+      {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+        const __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt),
+                                                    _mm_cmpeq_epi8(v, gt)),
+                                       _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, amp),
+                                                                 _mm_cmpeq_epi8(v, quot)),
+                                                    _mm_cmpeq_epi8(v, apos)));
+        if (_mm_movemask_epi8(m))
+          break;
+      }
+#endif
+
+    for (; pos < size; ++pos)
+      {
+        if (escape_entity(data[pos]))
+          break;
+      }
+    return pos;
+  }
+
+  // Check if a character is a control code to remove; all except for
+  // newline, tab and cr.
+  bool
+  is_removed_control(char c)
+  {
+    const unsigned char u = static_cast<unsigned char>(c);
+    return ((u < 0x20U && c != '\n' && c != '\t' && c != '\r') || u == 0x7FU);
+  }
+
+  // Find the next character to sanitize (a removed control code, or
+  // # following &), starting from pos.  Returns the string size if
+  // there are none.
+  std::string::size_type
+  find_sanitize(const std::string&     s,
+                std::string::size_type pos)
+  {
+    const std::string::size_type size = s.size();
+    const char *data = s.data();
+
+#if defined(__SSE2__)
+    // Skip whole 16-byte blocks with no control codes or #.
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i hash = _mm_set1_epi8('#');
+    for (; pos + 16U <= size; pos += 16U)
+      {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+        // Unsigned v <= 0x1F, excluding newline, tab and cr.
+        const __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl);
+        const __m128i allowed = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lf),
+                                                          _mm_cmpeq_epi8(v, tab)),
+                                             _mm_cmpeq_epi8(v, cr));
+        const __m128i m = _mm_or_si128(_mm_andnot_si128(allowed, control),
+                                       _mm_or_si128(_mm_cmpeq_epi8(v, del),
+                                                    _mm_cmpeq_epi8(v, hash)));
+        if (_mm_movemask_epi8(m))
+          break;
+      }
+#endif
+
+    for (; pos < size; ++pos)
+      {
+        if (is_removed_control(data[pos]) ||
+            (pos && data[pos] == '#' && data[pos - 1] == '&'))
+          break;
+      }
+    return pos;
+  }
+
 }
 
 namespace ome
@@ -63,64 +178,71 @@ namespace ome
     std::string
     escapeXML(const std::string& s)
     {
+      std::string::size_type pos = find_escape(s, 0U);
+
+      // Return unchanged if nothing needs escaping.
+      if (pos == s.size())
+        return s;
+
+      // Compute the escaped size to allocate only once.
+      std::string::size_type size = s.size();
+      for (std::string::size_type i = pos; i < s.size(); i = find_escape(s, i + 1U))
+        size += std::strlen(escape_entity(s[i])) - 1U;
+
       std::string ret;
-      ret.reserve(s.size());
+      ret.reserve(size);
+      ret.append(s, 0U, pos);
 
-      for (const auto& i : s)
+      while (pos < s.size())
         {
-          switch(i)
-            {
-            case '<':
-              ret += "&lt;";
-              break;
-            case '>':
-              ret += "&gt;";
-              break;
-            case '&':
-              ret += "&amp;";
-              break;
-            case '"':
-              ret += "&quot;";
-              break;
-            case '\'':
-              ret += "&apos;";
-              break;
-            default:
-              ret += i;
-              break;
-            }
+          ret += escape_entity(s[pos]);
+          const std::string::size_type next = find_escape(s, pos + 1U);
+          ret.append(s, pos + 1U, next - pos - 1U);
+          pos = next;
         }
+
       return ret;
     }
 
     std::string
     sanitizeXML(const std::string& s)
     {
+      std::string::size_type pos = find_sanitize(s, 0U);
+
+      // Return unchanged if nothing needs filtering.
+      if (pos == s.size())
+        return s;
+
+      // Compute the filtered size to allocate only once.  Control
+      // codes are removed; &# is replaced with &amp;#.
+      std::string::size_type size = s.size();
+      for (std::string::size_type i = pos; i < s.size(); i = find_sanitize(s, i + 1U))
+        {
+          if (s[i] == '#')
+            size += 4U;
+          else
+            --size;
+        }
+
       std::string ret;
-      ret.reserve(s.size());
+      ret.reserve(size);
+      ret.append(s, 0U, pos);
 
-      for(std::string::const_iterator i = s.begin();
-          i != s.end();
-          ++i)
+      while (pos < s.size())
         {
-          char v = *i;
-          // Remove all control characters except for newline, tab and
-          // cr.  Note that the java code also removes codepoints
-          // which are not defined in unicode, but we don't have any
-          // means of doing that with just the standard library, so
+          // Note that the java code also removes codepoints which
+          // are not defined in unicode, but we don't have any means
+          // of doing that with just the standard library, so
           // undefined characters are currently passed through.
-          if (std::iscntrl(*i) && '\n' != *i && '\t' != *i && '\r' != *i)
-            v = 0;
-
-          // Eliminate invalid "&#" sequences
-          if (i != s.begin() && '&' == *(i-1) && '#' == *i)
+          if (s[pos] == '#')
             {
-              ret.resize(ret.size() - 1);
-              ret += "&amp;";
+              // Eliminate invalid "&#" sequences
+              ret.resize(ret.size() - 1U);
+              ret += "&amp;#";
             }
-
-          if (v)
-            ret += v;
+          const std::string::size_type next = find_sanitize(s, pos + 1U);
+          ret.append(s, pos + 1U, next - pos - 1U);
+          pos = next;
         }
 
       return ret;
@@ -132,9 +254,13 @@ namespace ome
     {
       bool valid = true;
 
+      // Keep the XML platform initialised between calls, so that
+      // repeated validation does not reinitialise the parser and
+      // reload the schemas each time.
+      detail::initXMLPlatform();
+
       try
         {
-          ome::common::xml::Platform xmlplat;
           ome::xml::createDocument(s);
         }
       catch (const std::runtime_error&)
@@ -98,6 +98,10 @@ namespace ome
      * Validate XML in an XML string.
      *
      * @param s the string to validate.
+     * The XML platform is initialised on first use and kept for
+     * the lifetime of the process, so that repeated validation
+     * reuses the loaded schemas.
+     *
      * @param loc the file location or other descriptive text for the
      * string; used for error reporting only.
      * @returns @c true if valid, @c false if invalid.
@@ -0,0 +1,223 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSSE3__)
+# include <tmmintrin.h>
+# define OME_FILES_BASE64_SSSE3 1
+#endif
+
+#include <ome/files/detail/Base64.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        // Markers for characters which are not in the alphabet.
+        const uint8_t skip = 0x40U;
+        const uint8_t pad = 0x41U;
+        const uint8_t invalid = 0xFFU;
+
+        // Value of each character.
+        struct DecodeTable
+        {
+          uint8_t value[256];
+
+          DecodeTable()
+          {
+            static const char alphabet[] =
+              "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+            std::fill(value, value + 256, invalid);
+            for (uint8_t i = 0; i < 64U; ++i)
+              value[static_cast<uint8_t>(alphabet[i])] = i;
+            value[static_cast<uint8_t>(' ')] = skip;
+            value[static_cast<uint8_t>('\t')] = skip;
+            value[static_cast<uint8_t>('\n')] = skip;
+            value[static_cast<uint8_t>('\r')] = skip;
+            value[static_cast<uint8_t>('=')] = pad;
+          }
+        };
+
+        const DecodeTable&
+        table()
+        {
+          static const DecodeTable t;
+          return t;
+        }
+
+#if defined(OME_FILES_BASE64_SSSE3)
+        // Decode 16 characters to 12 bytes.  The characters are
+        // classified by their high and low nibbles, and translated
+        // by an offset chosen by the high nibble (after Muła and
+        // Lemire).  Returns false, without writing, if any character
+        // is not in the alphabet, including whitespace and padding.
+        bool
+        decode_16(const char *src,
+                  uint8_t    *dest)
+        {
+          const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                               0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+          const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+          const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                                 0, 0, 0, 0, 0, 0, 0, 0);
+          const __m128i mask_2f = _mm_set1_epi8(0x2F);
+
+          __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+
+          const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+          const __m128i lo_nibbles = _mm_and_si128(v, mask_2f);
+          const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+          const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+          if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())))
+            return false;
+
+          // '/' shares its high nibble with '+'.
+          const __m128i eq_2f = _mm_cmpeq_epi8(v, mask_2f);
+          v = _mm_add_epi8(v, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles)));
+
+          // Merge the 6-bit values into 24-bit groups, and pack the
+          // groups into 12 bytes.
+          v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+          v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+          v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+                                                8, 14, 13, 12, -1, -1, -1, -1));
+
+          uint8_t packed[16];
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(packed), v);
+          std::memcpy(dest, packed, 12);
+          return true;
+        }
+#endif
+
+      }
+
+      bool
+      base64Decode(const char            *src,
+                   dimension_size_type    size,
+                   std::vector<uint8_t>&  dest)
+      {
+        const uint8_t *value = table().value;
+        const char *end = src + size;
+
+        // Upper bound; trimmed once the size is known.
+        dest.resize(static_cast<std::vector<uint8_t>::size_type>(((size + 3U) / 4U) * 3U));
+        uint8_t *out = dest.data();
+
+        uint32_t group = 0U;
+        unsigned int count = 0U;
+
+        while (src != end)
+          {
+#if defined(OME_FILES_BASE64_SSSE3)
+            // At a group boundary, decode runs without whitespace
+            // sixteen characters at a time.
+            if (count == 0U)
+              {
+                while (end - src >= 16 && decode_16(src, out))
+                  {
+                    src += 16;
+                    out += 12;
+                  }
+                if (src == end)
+                  break;
+              }
+#endif
+
+            const uint8_t v = value[static_cast<uint8_t>(*src++)];
+            if (v < 64U)
+              {
+                group = (group << 6) | v;
+                if (++count == 4U)
+                  {
+                    out[0] = static_cast<uint8_t>(group >> 16);
+                    out[1] = static_cast<uint8_t>(group >> 8);
+                    out[2] = static_cast<uint8_t>(group);
+                    out += 3;
+                    group = 0U;
+                    count = 0U;
+                  }
+              }
+            else if (v == pad)
+              {
+                // Padding ends the data.
+                if (count < 2U)
+                  return false;
+                break;
+              }
+            else if (v != skip)
+              return false;
+          }
+
+        // Any trailing padding and whitespace.
+        for (; src != end; ++src)
+          {
+            const uint8_t v = value[static_cast<uint8_t>(*src)];
+            if (v != pad && v != skip)
+              return false;
+          }
+
+        // Final partial group.
+        if (count == 1U)
+          return false;
+        if (count == 2U)
+          {
+            *out++ = static_cast<uint8_t>(group >> 4);
+          }
+        else if (count == 3U)
+          {
+            *out++ = static_cast<uint8_t>(group >> 10);
+            *out++ = static_cast<uint8_t>(group >> 2);
+          }
+
+        dest.resize(static_cast<std::vector<uint8_t>::size_type>(out - dest.data()));
+        return true;
+      }
+
+    }
+  }
+}
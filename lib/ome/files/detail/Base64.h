@@ -0,0 +1,83 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_BASE64_H
+#define OME_FILES_DETAIL_BASE64_H
+
+#include <cstdint>
+#include <vector>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Decode base64 text.
+       *
+       * Whitespace (including line breaks) is skipped anywhere in
+       * the text, and the final group may be padded with @c = or
+       * unpadded.  Runs of 16 characters without whitespace are
+       * decoded with SSSE3 instructions where available.
+       *
+       * @param src the base64 text.
+       * @param size the size of @c src in bytes.
+       * @param dest the destination; resized to the decoded size.
+       * @returns @c true on success, or @c false if the text
+       * contains an invalid character or is truncated.
+       */
+      bool
+      base64Decode(const char            *src,
+                   dimension_size_type    size,
+                   std::vector<uint8_t>&  dest);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_BASE64_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
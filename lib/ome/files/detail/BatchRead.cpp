@@ -0,0 +1,508 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/config-internal.h>
+#include <ome/files/detail/BatchRead.h>
+
+#ifndef _MSC_VER
+#  include <unistd.h>
+#endif
+
+#ifdef OME_FILES_HAVE_IO_URING
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#endif
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        std::runtime_error
+        read_error(int error)
+        {
+          boost::format fmt("Failed to read file: %1%");
+          fmt % (error ? std::strerror(error) : "unexpected end of file");
+          return std::runtime_error(fmt.str());
+        }
+
+#ifndef _MSC_VER
+
+        // Read a request in full with pread.
+        void
+        pread_full(int                     fd,
+                   const BatchReadRequest& request)
+        {
+          std::size_t done = 0U;
+          while (done < request.size)
+            {
+              ssize_t count = ::pread(fd,
+                                      static_cast<char *>(request.buf) + done,
+                                      request.size - done,
+                                      static_cast<off_t>(request.offset + done));
+              if (count < 0 && errno == EINTR)
+                continue;
+              if (count <= 0)
+                throw read_error(count < 0 ? errno : 0);
+              done += static_cast<std::size_t>(count);
+            }
+        }
+
+#endif // ! _MSC_VER
+
+#ifdef OME_FILES_HAVE_IO_URING
+
+        /**
+         * io_uring submission and completion queues.
+         *
+         * A minimal interface to the kernel rings, using the system
+         * calls directly rather than liburing.
+         */
+        class Ring
+        {
+        public:
+          /**
+           * Constructor.
+           *
+           * If the ring can not be set up, valid() is @c false.
+           *
+           * @param entries the submission queue size.
+           */
+          explicit
+          Ring(unsigned entries):
+            ringfd(-1),
+            sqptr(MAP_FAILED),
+            sqsize(0U),
+            cqptr(MAP_FAILED),
+            cqsize(0U),
+            sqes(static_cast<io_uring_sqe *>(MAP_FAILED)),
+            sqessize(0U),
+            sqhead(),
+            sqtail(),
+            sqmask(),
+            sqarray(),
+            sqentries(0U),
+            cqhead(),
+            cqtail(),
+            cqmask(),
+            cqes()
+          {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+
+            ringfd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+            if (ringfd < 0)
+              return;
+
+            sqsize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+            cqsize = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+            sqessize = params.sq_entries * sizeof(io_uring_sqe);
+
+            sqptr = ::mmap(nullptr, sqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ringfd, IORING_OFF_SQ_RING);
+            cqptr = ::mmap(nullptr, cqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ringfd, IORING_OFF_CQ_RING);
+            sqes = static_cast<io_uring_sqe *>(::mmap(nullptr, sqessize, PROT_READ | PROT_WRITE,
+                                                      MAP_SHARED | MAP_POPULATE,
+                                                      ringfd, IORING_OFF_SQES));
+            if (sqptr == MAP_FAILED || cqptr == MAP_FAILED || sqes == MAP_FAILED)
+              {
+                release();
+                return;
+              }
+
+            char *sq = static_cast<char *>(sqptr);
+            sqhead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+            sqtail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sqmask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sqarray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            sqentries = params.sq_entries;
+
+            char *cq = static_cast<char *>(cqptr);
+            cqhead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            cqtail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            cqmask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+          }
+
+          /// Destructor.
+          ~Ring()
+          {
+            release();
+          }
+
+          Ring(const Ring&) = delete;
+          Ring& operator=(const Ring&) = delete;
+
+          /// @returns @c true if the ring was set up.
+          bool
+          valid() const
+          {
+            return ringfd >= 0;
+          }
+
+          /// @returns the submission queue size.
+          unsigned
+          capacity() const
+          {
+            return sqentries;
+          }
+
+          /**
+           * Queue a read.  The caller must ensure the submission
+           * queue is not full, and that @p iov remains valid until
+           * the read completes.
+           *
+           * @param fd the file descriptor to read.
+           * @param offset the file offset.
+           * @param iov the buffer to read into.
+           * @param user the value to return on completion.
+           */
+          void
+          queueRead(int       fd,
+                    uint64_t  offset,
+                    iovec    *iov,
+                    uint64_t  user)
+          {
+            const unsigned tail = *sqtail;
+            const unsigned index = tail & *sqmask;
+
+            io_uring_sqe& sqe(sqes[index]);
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = fd;
+            sqe.off = offset;
+            sqe.addr = reinterpret_cast<uint64_t>(iov);
+            sqe.len = 1U;
+            sqe.user_data = user;
+
+            sqarray[index] = index;
+            __atomic_store_n(sqtail, tail + 1U, __ATOMIC_RELEASE);
+          }
+
+          /**
+           * Submit queued reads and wait for completions.
+           *
+           * @param submit the number of reads to submit.
+           * @param wait the number of completions to wait for.
+           * @returns the number of reads submitted, or a negative
+           * error number.
+           */
+          int
+          enter(unsigned submit,
+                unsigned wait)
+          {
+            int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringfd, submit, wait,
+                                                 wait ? IORING_ENTER_GETEVENTS : 0U,
+                                                 nullptr, 0));
+            return ret < 0 ? -errno : ret;
+          }
+
+          /**
+           * Process available completions.
+           *
+           * @param handle function called with the user value and
+           * result of each completion.
+           */
+          template<typename F>
+          void
+          reap(F handle)
+          {
+            unsigned head = *cqhead;
+            const unsigned tail = __atomic_load_n(cqtail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head)
+              {
+                const io_uring_cqe& cqe(cqes[head & *cqmask]);
+                const uint64_t user = cqe.user_data;
+                const int res = cqe.res;
+                __atomic_store_n(cqhead, head + 1U, __ATOMIC_RELEASE);
+                handle(user, res);
+              }
+          }
+
+        private:
+          void
+          release()
+          {
+            if (sqes != MAP_FAILED)
+              ::munmap(sqes, sqessize);
+            if (cqptr != MAP_FAILED)
+              ::munmap(cqptr, cqsize);
+            if (sqptr != MAP_FAILED)
+              ::munmap(sqptr, sqsize);
+            if (ringfd >= 0)
+              ::close(ringfd);
+            sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+            cqptr = sqptr = MAP_FAILED;
+            ringfd = -1;
+          }
+
+          /// Ring file descriptor.
+          int ringfd;
+          /// Submission queue ring mapping.
+          void *sqptr;
+          /// Submission queue ring mapping size.
+          std::size_t sqsize;
+          /// Completion queue ring mapping.
+          void *cqptr;
+          /// Completion queue ring mapping size.
+          std::size_t cqsize;
+          /// Submission queue entries.
+          io_uring_sqe *sqes;
+          /// Submission queue entries mapping size.
+          std::size_t sqessize;
+          /// Submission queue head.
+          unsigned *sqhead;
+          /// Submission queue tail.
+          unsigned *sqtail;
+          /// Submission queue index mask.
+          unsigned *sqmask;
+          /// Submission queue index array.
+          unsigned *sqarray;
+          /// Submission queue size.
+          unsigned sqentries;
+          /// Completion queue head.
+          unsigned *cqhead;
+          /// Completion queue tail.
+          unsigned *cqtail;
+          /// Completion queue index mask.
+          unsigned *cqmask;
+          /// Completion queue entries.
+          io_uring_cqe *cqes;
+        };
+
+        /// Submission queue size (maximum reads in flight).
+        const unsigned ring_entries = 64U;
+
+        /// The ring of the current thread.
+        std::unique_ptr<Ring>&
+        thread_ring_storage()
+        {
+          thread_local std::unique_ptr<Ring> ring;
+          return ring;
+        }
+
+        // Get the ring for this thread, or null if io_uring is not
+        // available.  Setup failure (for example if io_uring is
+        // disabled by the kernel or a seccomp policy) is remembered
+        // so that it is only attempted once.
+        Ring *
+        thread_ring()
+        {
+          static std::atomic<bool> unavailable(false);
+          std::unique_ptr<Ring>& ring(thread_ring_storage());
+
+          if (!ring && !unavailable.load(std::memory_order_relaxed))
+            {
+              std::unique_ptr<Ring> created(new Ring(ring_entries));
+              if (created->valid())
+                ring = std::move(created);
+              else
+                unavailable.store(true, std::memory_order_relaxed);
+            }
+          return ring.get();
+        }
+
+        // Read a batch with io_uring.  Reads are kept in flight up
+        // to the queue depth; short reads are resubmitted for the
+        // remainder.
+        void
+        uring_read(Ring&                                     ring,
+                   int                                       fd,
+                   const std::vector<BatchReadRequest>&      requests,
+                   const std::function<void (std::size_t)>&  complete)
+        {
+          std::vector<iovec> iovs(requests.size());
+          std::vector<std::size_t> done(requests.size(), 0U);
+          std::exception_ptr error;
+
+          std::size_t next = 0U;
+          unsigned queued = 0U;
+          unsigned inflight = 0U;
+
+          auto queue = [&](std::size_t index)
+            {
+              iovs[index].iov_base = static_cast<char *>(requests[index].buf) + done[index];
+              iovs[index].iov_len = requests[index].size - done[index];
+              ring.queueRead(fd, requests[index].offset + done[index], &iovs[index], index);
+              ++queued;
+            };
+
+          while ((!error && next < requests.size()) || queued || inflight)
+            {
+              for (; !error && next < requests.size() && queued + inflight < ring.capacity(); ++next)
+                {
+                  if (requests[next].size)
+                    queue(next);
+                  else
+                    {
+                      try
+                        {
+                          complete(next);
+                        }
+                      catch (...)
+                        {
+                          error = std::current_exception();
+                        }
+                    }
+                }
+
+              if (!queued && !inflight)
+                continue;
+
+              int ret = ring.enter(queued, 1U);
+              if (ret < 0)
+                {
+                  if (ret == -EINTR || ret == -EAGAIN || ret == -EBUSY)
+                    continue;
+                  // Reads in flight would write into the buffers
+                  // after they are released if not waited for.
+                  if (inflight)
+                    std::terminate();
+                  // Discard the ring with any reads still queued.
+                  thread_ring_storage().reset();
+                  throw read_error(-ret);
+                }
+              queued -= static_cast<unsigned>(ret);
+              inflight += static_cast<unsigned>(ret);
+
+              ring.reap([&](uint64_t user, int res)
+                {
+                  --inflight;
+                  const std::size_t index = static_cast<std::size_t>(user);
+                  if (res == -EINTR || res == -EAGAIN)
+                    {
+                      queue(index);
+                      return;
+                    }
+                  if (res <= 0)
+                    {
+                      if (!error)
+                        error = std::make_exception_ptr(read_error(-res));
+                      return;
+                    }
+                  done[index] += static_cast<std::size_t>(res);
+                  if (done[index] < requests[index].size)
+                    queue(index);
+                  else if (!error)
+                    {
+                      try
+                        {
+                          complete(index);
+                        }
+                      catch (...)
+                        {
+                          error = std::current_exception();
+                        }
+                    }
+                });
+            }
+
+          if (error)
+            std::rethrow_exception(error);
+        }
+
+#endif // OME_FILES_HAVE_IO_URING
+
+      }
+
+      bool
+      asyncBatchRead()
+      {
+#ifdef OME_FILES_HAVE_IO_URING
+        return thread_ring() != nullptr;
+#else
+        return false;
+#endif
+      }
+
+#ifdef _MSC_VER
+
+      bool
+      readBatch(int                                       /* fd */,
+                const std::vector<BatchReadRequest>&      /* requests */,
+                const std::function<void (std::size_t)>&  /* complete */)
+      {
+        return false;
+      }
+
+#else // ! _MSC_VER
+
+      bool
+      readBatch(int                                       fd,
+                const std::vector<BatchReadRequest>&      requests,
+                const std::function<void (std::size_t)>&  complete)
+      {
+#ifdef OME_FILES_HAVE_IO_URING
+        Ring *ring = thread_ring();
+        if (ring)
+          {
+            uring_read(*ring, fd, requests, complete);
+            return true;
+          }
+#endif // OME_FILES_HAVE_IO_URING
+
+        for (std::vector<BatchReadRequest>::size_type i = 0; i < requests.size(); ++i)
+          {
+            pread_full(fd, requests[i]);
+            complete(i);
+          }
+        return true;
+      }
+
+#endif // _MSC_VER
+
+    }
+  }
+}
@@ -0,0 +1,115 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_BATCHREAD_H
+#define OME_FILES_DETAIL_BATCHREAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * A single read of a batch.
+       */
+      struct BatchReadRequest
+      {
+        /// File offset to read from.
+        uint64_t     offset;
+        /// Buffer to read into.
+        void        *buf;
+        /// Number of bytes to read.
+        std::size_t  size;
+      };
+
+      /**
+       * Check if batches are read asynchronously.
+       *
+       * @returns @c true if readBatch() uses io_uring, or @c false
+       * if it reads each request in turn.
+       */
+      bool
+      asyncBatchRead();
+
+      /**
+       * Read a batch of ranges from a file descriptor.
+       *
+       * On Linux, the requests are submitted together with io_uring
+       * (as many as the queue depth allows), and @p complete is
+       * called for each request as soon as it has been read, in
+       * order of completion, so processing overlaps the remaining
+       * reads.  Where io_uring is unavailable (not built, or not
+       * permitted by the kernel), each request is read in turn with
+       * pread.  The file position is not used or changed.
+       *
+       * If @p complete throws, no further requests are submitted,
+       * and the exception is rethrown once the reads in progress
+       * have finished, so that their buffers may be released.
+       *
+       * @param fd the file descriptor.
+       * @param requests the ranges to read.
+       * @param complete function called with the index of each
+       * request once read.
+       * @returns @c false if reading from a file descriptor is not
+       * supported on this platform, in which case nothing is read.
+       * @throws std::runtime_error if a range can not be read in
+       * full.
+       */
+      bool
+      readBatch(int                                       fd,
+                const std::vector<BatchReadRequest>&      requests,
+                const std::function<void (std::size_t)>&  complete);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_BATCHREAD_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
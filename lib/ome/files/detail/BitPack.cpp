@@ -0,0 +1,472 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+#endif
+#if defined(__SSSE3__)
+# include <tmmintrin.h>
+# define OME_FILES_BITPACK_SSSE3 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define OME_FILES_BITPACK_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define OME_FILES_BITPACK_NEON 1
+#endif
+
+#include <ome/files/detail/BitPack.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        // Unpack whole bytes; dest receives 8 values per byte.
+        void
+        unpack_bytes(const uint8_t       *src,
+                     bool                *dest,
+                     dimension_size_type  nbytes)
+        {
+          dimension_size_type i = 0;
+
+#if defined(__AVX2__)
+          {
+            uint8_t *out = reinterpret_cast<uint8_t *>(dest);
+            // Each 128-bit lane expands two source bytes.
+            const __m256i shuffle = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+                                                     1, 1, 1, 1, 1, 1, 1, 1,
+                                                     2, 2, 2, 2, 2, 2, 2, 2,
+                                                     3, 3, 3, 3, 3, 3, 3, 3);
+            const __m256i mask = _mm256_set1_epi64x(static_cast<long long>(0x0102040810204080ULL));
+            const __m256i one = _mm256_set1_epi8(1);
+            for (; i + 4 <= nbytes; i += 4)
+              {
+                int32_t word;
+                std::memcpy(&word, src + i, sizeof(word));
+                __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(word), shuffle);
+                v = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(v, mask), mask), one);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + (i * 8U)), v);
+              }
+          }
+#elif defined(OME_FILES_BITPACK_SSE2)
+          {
+            uint8_t *out = reinterpret_cast<uint8_t *>(dest);
+            const __m128i mask = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                              1, 2, 4, 8, 16, 32, 64, -128);
+            const __m128i one = _mm_set1_epi8(1);
+            for (; i + 16 <= nbytes; i += 16)
+              {
+                // Replicate each source byte eight times.
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                __m128i b8[2] = {_mm_unpacklo_epi8(v, v), _mm_unpackhi_epi8(v, v)};
+                for (int h = 0; h < 2; ++h)
+                  {
+                    __m128i b16[2] = {_mm_unpacklo_epi16(b8[h], b8[h]), _mm_unpackhi_epi16(b8[h], b8[h])};
+                    for (int q = 0; q < 2; ++q)
+                      {
+                        __m128i b32[2] = {_mm_unpacklo_epi32(b16[q], b16[q]), _mm_unpackhi_epi32(b16[q], b16[q])};
+                        for (int e = 0; e < 2; ++e)
+                          {
+                            __m128i r = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(b32[e], mask), mask), one);
+                            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + ((i + (h * 8) + (q * 4) + (e * 2)) * 8U)), r);
+                          }
+                      }
+                  }
+              }
+          }
+#elif defined(OME_FILES_BITPACK_NEON)
+          {
+            uint8_t *out = reinterpret_cast<uint8_t *>(dest);
+            static const uint8_t maskbits[8] = {128, 64, 32, 16, 8, 4, 2, 1};
+            const uint8x8_t mask = vld1_u8(maskbits);
+            const uint8x8_t one = vdup_n_u8(1);
+            for (; i < nbytes; ++i)
+              {
+                uint8x8_t v = vdup_n_u8(src[i]);
+                vst1_u8(out + (i * 8U), vand_u8(vtst_u8(v, mask), one));
+              }
+          }
+#endif
+
+          for (; i < nbytes; ++i)
+            {
+              const uint8_t byte = src[i];
+              bool *d = dest + (i * 8U);
+              d[0] = (byte & 0x80U) != 0;
+              d[1] = (byte & 0x40U) != 0;
+              d[2] = (byte & 0x20U) != 0;
+              d[3] = (byte & 0x10U) != 0;
+              d[4] = (byte & 0x08U) != 0;
+              d[5] = (byte & 0x04U) != 0;
+              d[6] = (byte & 0x02U) != 0;
+              d[7] = (byte & 0x01U) != 0;
+            }
+        }
+
+        // Pack whole bytes; src provides 8 values per byte.
+        void
+        pack_bytes(const bool          *src,
+                   uint8_t             *dest,
+                   dimension_size_type  nbytes)
+        {
+          dimension_size_type i = 0;
+
+#if defined(__AVX2__)
+          {
+            const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+            // Reverse the bit order within each byte of the mask.
+            const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+                                                     15, 14, 13, 12, 11, 10, 9, 8,
+                                                     7, 6, 5, 4, 3, 2, 1, 0,
+                                                     15, 14, 13, 12, 11, 10, 9, 8);
+            const __m256i zero = _mm256_setzero_si256();
+            for (; i + 4 <= nbytes; i += 4)
+              {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + (i * 8U)));
+                v = _mm256_shuffle_epi8(_mm256_cmpgt_epi8(v, zero), reverse);
+                int32_t bits = _mm256_movemask_epi8(v);
+                std::memcpy(dest + i, &bits, sizeof(bits));
+              }
+          }
+#elif defined(OME_FILES_BITPACK_SSE2)
+          {
+            const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+            // Bit-reversal of each mask byte, since movemask places
+            // the first value in the least significant bit.
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 2 <= nbytes; i += 2)
+              {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + (i * 8U)));
+                unsigned int bits = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpgt_epi8(v, zero)));
+                for (int b = 0; b < 2; ++b)
+                  {
+                    uint32_t x = (bits >> (b * 8)) & 0xFFU;
+                    x = ((x * 0x0802U & 0x22110U) | (x * 0x8020U & 0x88440U)) * 0x10101U >> 16;
+                    dest[i + b] = static_cast<uint8_t>(x);
+                  }
+              }
+          }
+#elif defined(OME_FILES_BITPACK_NEON)
+          {
+            const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+            static const uint8_t maskbits[8] = {128, 64, 32, 16, 8, 4, 2, 1};
+            const uint8x8_t mask = vld1_u8(maskbits);
+            for (; i < nbytes; ++i)
+              {
+                uint8x8_t v = vand_u8(vtst_u8(vld1_u8(in + (i * 8U)), vdup_n_u8(0xFFU)), mask);
+                // Horizontal sum of distinct bits.
+                uint16x4_t s16 = vpaddl_u8(v);
+                uint32x2_t s32 = vpaddl_u16(s16);
+                uint64x1_t s64 = vpaddl_u32(s32);
+                dest[i] = static_cast<uint8_t>(vget_lane_u64(s64, 0));
+              }
+          }
+#endif
+
+          for (; i < nbytes; ++i)
+            {
+              const bool *s = src + (i * 8U);
+              dest[i] = static_cast<uint8_t>((s[0] << 7) | (s[1] << 6) |
+                                             (s[2] << 5) | (s[3] << 4) |
+                                             (s[4] << 3) | (s[5] << 2) |
+                                             (s[6] << 1) | (s[7] << 0));
+            }
+        }
+
+        // Unpack samples of any size up to 16 bits.
+        template<typename T>
+        void
+        unpack_samples(const uint8_t       *src,
+                       T                   *dest,
+                       dimension_size_type  count,
+                       uint16_t             bits)
+        {
+          const uint32_t mask = (1U << bits) - 1U;
+          uint32_t acc = 0;
+          unsigned int avail = 0;
+          for (dimension_size_type i = 0; i < count; ++i)
+            {
+              while (avail < bits)
+                {
+                  acc = (acc << 8) | *src++;
+                  avail += 8;
+                }
+              avail -= bits;
+              dest[i] = static_cast<T>((acc >> avail) & mask);
+            }
+        }
+
+        // Pack samples of any size up to 16 bits.
+        template<typename T>
+        void
+        pack_samples(const T             *src,
+                     uint8_t             *dest,
+                     dimension_size_type  count,
+                     uint16_t             bits)
+        {
+          const uint32_t mask = (1U << bits) - 1U;
+          uint32_t acc = 0;
+          unsigned int fill = 0;
+          for (dimension_size_type i = 0; i < count; ++i)
+            {
+              acc = (acc << bits) | (static_cast<uint32_t>(src[i]) & mask);
+              fill += bits;
+              while (fill >= 8)
+                {
+                  fill -= 8;
+                  *dest++ = static_cast<uint8_t>(acc >> fill);
+                }
+            }
+          if (fill)
+            *dest = static_cast<uint8_t>(acc << (8 - fill));
+        }
+
+        // Unpack 12-bit samples; every three bytes hold two samples.
+        void
+        unpack_12(const uint8_t       *src,
+                  uint16_t            *dest,
+                  dimension_size_type  count)
+        {
+          dimension_size_type i = 0;
+
+#if defined(OME_FILES_BITPACK_SSSE3)
+          {
+            // Gather each sample's two bytes into a little-endian
+            // word; even samples are then in the upper 12 bits and
+            // odd samples in the lower 12 bits.
+            const __m128i shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+                                                  7, 6, 8, 7, 10, 9, 11, 10);
+            const __m128i oddmask = _mm_setr_epi16(0, 0x0FFF, 0, 0x0FFF,
+                                                   0, 0x0FFF, 0, 0x0FFF);
+            const __m128i evenmask = _mm_setr_epi16(0x0FFF, 0, 0x0FFF, 0,
+                                                    0x0FFF, 0, 0x0FFF, 0);
+            // Eight samples use 12 bytes, but 16 are loaded.
+            for (; i + 11 <= count; i += 8, src += 12)
+              {
+                __m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src)), shuffle);
+                v = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 4), evenmask),
+                                 _mm_and_si128(v, oddmask));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), v);
+              }
+          }
+#endif
+
+          for (; i + 2 <= count; i += 2, src += 3)
+            {
+              dest[i] = static_cast<uint16_t>((src[0] << 4) | (src[1] >> 4));
+              dest[i + 1] = static_cast<uint16_t>(((src[1] & 0x0FU) << 8) | src[2]);
+            }
+          if (i < count)
+            dest[i] = static_cast<uint16_t>((src[0] << 4) | (src[1] >> 4));
+        }
+
+        // Pack 12-bit samples; every two samples fill three bytes.
+        void
+        pack_12(const uint16_t      *src,
+                uint8_t             *dest,
+                dimension_size_type  count)
+        {
+          dimension_size_type i = 0;
+
+#if defined(OME_FILES_BITPACK_SSSE3)
+          {
+            // Combine each sample pair into a 24-bit value per 32-bit
+            // lane, then emit its bytes in big-endian order.
+            const __m128i mask = _mm_set1_epi32(0x0FFF);
+            const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+                                                  8, 14, 13, 12, -1, -1, -1, -1);
+            for (; i + 8 <= count; i += 8, dest += 12)
+              {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                v = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, mask), 12),
+                                 _mm_and_si128(_mm_srli_epi32(v, 16), mask));
+                v = _mm_shuffle_epi8(v, shuffle);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dest), v);
+                int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+                std::memcpy(dest + 8, &tail, sizeof(tail));
+              }
+          }
+#endif
+
+          for (; i + 2 <= count; i += 2, dest += 3)
+            {
+              const uint16_t a = src[i] & 0x0FFFU;
+              const uint16_t b = src[i + 1] & 0x0FFFU;
+              dest[0] = static_cast<uint8_t>(a >> 4);
+              dest[1] = static_cast<uint8_t>(((a & 0x0FU) << 4) | (b >> 8));
+              dest[2] = static_cast<uint8_t>(b);
+            }
+          if (i < count)
+            {
+              const uint16_t a = src[i] & 0x0FFFU;
+              dest[0] = static_cast<uint8_t>(a >> 4);
+              dest[1] = static_cast<uint8_t>((a & 0x0FU) << 4);
+            }
+        }
+
+      }
+
+      void
+      unpackBits(const uint8_t       *src,
+                 dimension_size_type  srcbit,
+                 bool                *dest,
+                 dimension_size_type  count)
+      {
+        src += srcbit / 8U;
+        srcbit %= 8U;
+
+        // Unaligned head.
+        while (count && srcbit)
+          {
+            *dest++ = (*src & (0x80U >> srcbit)) != 0;
+            --count;
+            if (++srcbit == 8U)
+              {
+                srcbit = 0;
+                ++src;
+              }
+          }
+
+        // Whole bytes.
+        dimension_size_type nbytes = count / 8U;
+        unpack_bytes(src, dest, nbytes);
+        src += nbytes;
+        dest += nbytes * 8U;
+        count %= 8U;
+
+        // Tail.
+        for (dimension_size_type b = 0; b < count; ++b)
+          *dest++ = (*src & (0x80U >> b)) != 0;
+      }
+
+      void
+      packBits(const bool          *src,
+               uint8_t             *dest,
+               dimension_size_type  destbit,
+               dimension_size_type  count)
+      {
+        dest += destbit / 8U;
+        destbit %= 8U;
+
+        // Unaligned head.
+        while (count && destbit)
+          {
+            if (*src++)
+              *dest |= static_cast<uint8_t>(0x80U >> destbit);
+            --count;
+            if (++destbit == 8U)
+              {
+                destbit = 0;
+                ++dest;
+              }
+          }
+
+        // Whole bytes.
+        dimension_size_type nbytes = count / 8U;
+        pack_bytes(src, dest, nbytes);
+        src += nbytes * 8U;
+        dest += nbytes;
+        count %= 8U;
+
+        // Tail.
+        for (dimension_size_type b = 0; b < count; ++b)
+          if (*src++)
+            *dest |= static_cast<uint8_t>(0x80U >> b);
+      }
+
+      void
+      unpackSamples(const uint8_t       *src,
+                    uint8_t             *dest,
+                    dimension_size_type  count,
+                    uint16_t             bits)
+      {
+        if (bits == 8U)
+          std::memcpy(dest, src, count);
+        else
+          unpack_samples(src, dest, count, bits);
+      }
+
+      void
+      unpackSamples(const uint8_t       *src,
+                    uint16_t            *dest,
+                    dimension_size_type  count,
+                    uint16_t             bits)
+      {
+        if (bits == 12U)
+          unpack_12(src, dest, count);
+        else
+          unpack_samples(src, dest, count, bits);
+      }
+
+      void
+      packSamples(const uint8_t       *src,
+                  uint8_t             *dest,
+                  dimension_size_type  count,
+                  uint16_t             bits)
+      {
+        if (bits == 8U)
+          std::memcpy(dest, src, count);
+        else
+          pack_samples(src, dest, count, bits);
+      }
+
+      void
+      packSamples(const uint16_t      *src,
+                  uint8_t             *dest,
+                  dimension_size_type  count,
+                  uint16_t             bits)
+      {
+        if (bits == 12U)
+          pack_12(src, dest, count);
+        else
+          pack_samples(src, dest, count, bits);
+      }
+
+    }
+  }
+}
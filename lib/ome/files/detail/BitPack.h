@@ -0,0 +1,181 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_BITPACK_H
+#define OME_FILES_DETAIL_BITPACK_H
+
+#include <cstdint>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Unpack bits into booleans.
+       *
+       * Bits are numbered from the most significant bit of each
+       * byte, as for TIFF images with a FillOrder of 1.  The source
+       * need not be byte-aligned; any unaligned leading and trailing
+       * bits are handled individually, and whole bytes are unpacked
+       * using SIMD instructions where available.
+       *
+       * @param src the packed source data.
+       * @param srcbit the offset of the first bit in @c src.
+       * @param dest the destination; must have space for @c count
+       * values.
+       * @param count the number of bits to unpack.
+       */
+      void
+      unpackBits(const uint8_t       *src,
+                 dimension_size_type  srcbit,
+                 bool                *dest,
+                 dimension_size_type  count);
+
+      /**
+       * Pack booleans into bits.
+       *
+       * Bits are numbered from the most significant bit of each
+       * byte, as for TIFF images with a FillOrder of 1.  The
+       * destination need not be byte-aligned.  Set bits are combined
+       * with the existing content of partially-filled leading and
+       * trailing bytes; whole bytes are overwritten.  Whole bytes are
+       * packed using SIMD instructions where available.
+       *
+       * @param src the source values.
+       * @param dest the packed destination data.
+       * @param destbit the offset of the first bit in @c dest.
+       * @param count the number of values to pack.
+       */
+      void
+      packBits(const bool          *src,
+               uint8_t             *dest,
+               dimension_size_type  destbit,
+               dimension_size_type  count);
+
+      /**
+       * Unpack samples of fewer bits than their storage type.
+       *
+       * Samples are packed most significant bit first with no
+       * padding between them, as for TIFF images with a
+       * BitsPerSample which is not a multiple of 8.  The source must
+       * start on a byte boundary (TIFF rows always do).  12-bit
+       * samples are unpacked using SIMD instructions where
+       * available; other sizes use a scalar bit accumulator.
+       *
+       * @param src the packed source data.
+       * @param dest the destination; must have space for @c count
+       * values.
+       * @param count the number of samples to unpack.
+       * @param bits the number of bits per sample (1–8).
+       */
+      void
+      unpackSamples(const uint8_t       *src,
+                    uint8_t             *dest,
+                    dimension_size_type  count,
+                    uint16_t             bits);
+
+      /**
+       * Unpack samples of fewer bits than their storage type.
+       *
+       * @copydetails unpackSamples(const uint8_t*,uint8_t*,dimension_size_type,uint16_t)
+       *
+       * @param src the packed source data.
+       * @param dest the destination; must have space for @c count
+       * values.
+       * @param count the number of samples to unpack.
+       * @param bits the number of bits per sample (1–16).
+       */
+      void
+      unpackSamples(const uint8_t       *src,
+                    uint16_t            *dest,
+                    dimension_size_type  count,
+                    uint16_t             bits);
+
+      /**
+       * Pack samples into fewer bits than their storage type.
+       *
+       * This is the inverse of unpackSamples().  Bits above @c bits
+       * in each sample are discarded.  The destination starts on a
+       * byte boundary and is overwritten; unused trailing bits of
+       * the last byte are set to zero.
+       *
+       * @param src the source samples.
+       * @param dest the packed destination; must have space for
+       * <tt>(count * bits + 7) / 8</tt> bytes.
+       * @param count the number of samples to pack.
+       * @param bits the number of bits per sample (1–8).
+       */
+      void
+      packSamples(const uint8_t       *src,
+                  uint8_t             *dest,
+                  dimension_size_type  count,
+                  uint16_t             bits);
+
+      /**
+       * Pack samples into fewer bits than their storage type.
+       *
+       * @copydetails packSamples(const uint8_t*,uint8_t*,dimension_size_type,uint16_t)
+       *
+       * @param src the source samples.
+       * @param dest the packed destination; must have space for
+       * <tt>(count * bits + 7) / 8</tt> bytes.
+       * @param count the number of samples to pack.
+       * @param bits the number of bits per sample (1–16).
+       */
+      void
+      packSamples(const uint16_t      *src,
+                  uint8_t             *dest,
+                  dimension_size_type  count,
+                  uint16_t             bits);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_BITPACK_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
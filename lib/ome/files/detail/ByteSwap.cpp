@@ -0,0 +1,169 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+
+#include <boost/endian/conversion.hpp>
+
+#if defined(__AVX2__)
+# include <immintrin.h>
+#endif
+#if defined(__SSSE3__)
+# include <tmmintrin.h>
+# define OME_FILES_BYTESWAP_SSSE3 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define OME_FILES_BYTESWAP_NEON 1
+#endif
+
+#include <ome/files/detail/ByteSwap.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        // Swap whole 32-byte (AVX2) or 16-byte (SSSE3) blocks of
+        // values of size bytes with a byte shuffle; returns the
+        // number of bytes swapped.
+        template<int size>
+        dimension_size_type
+        swap_blocks(uint8_t             *data,
+                    dimension_size_type  nbytes)
+        {
+          dimension_size_type i = 0;
+
+#if defined(__AVX2__)
+          {
+            const __m256i shuffle
+              (size == 2 ? _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14) :
+               size == 4 ? _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12) :
+               _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+            for (; i + 32 <= nbytes; i += 32)
+              {
+                __m256i *p = reinterpret_cast<__m256i *>(data + i);
+                _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), shuffle));
+              }
+          }
+#elif defined(OME_FILES_BYTESWAP_SSSE3)
+          {
+            const __m128i shuffle
+              (size == 2 ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14) :
+               size == 4 ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12) :
+               _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+            for (; i + 16 <= nbytes; i += 16)
+              {
+                __m128i *p = reinterpret_cast<__m128i *>(data + i);
+                _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), shuffle));
+              }
+          }
+#elif defined(OME_FILES_BYTESWAP_NEON)
+          for (; i + 16 <= nbytes; i += 16)
+            {
+              uint8x16_t v = vld1q_u8(data + i);
+              v = size == 2 ? vrev16q_u8(v) : size == 4 ? vrev32q_u8(v) : vrev64q_u8(v);
+              vst1q_u8(data + i, v);
+            }
+#else
+          static_cast<void>(data);
+          static_cast<void>(nbytes);
+#endif
+
+          return i;
+        }
+
+        // Swap the remaining values individually.
+        template<typename T>
+        void
+        swap_values(uint8_t             *data,
+                    dimension_size_type  count)
+        {
+          for (dimension_size_type i = 0; i < count; ++i)
+            {
+              T value;
+              std::memcpy(&value, data + (i * sizeof(T)), sizeof(T));
+              boost::endian::endian_reverse_inplace(value);
+              std::memcpy(data + (i * sizeof(T)), &value, sizeof(T));
+            }
+        }
+
+        template<typename T>
+        void
+        swap(void                *data,
+             dimension_size_type  count)
+        {
+          uint8_t *bytes = static_cast<uint8_t *>(data);
+          const dimension_size_type done = swap_blocks<sizeof(T)>(bytes, count * sizeof(T));
+          swap_values<T>(bytes + done, count - (done / sizeof(T)));
+        }
+
+      }
+
+      void
+      byteswap16(void                *data,
+                 dimension_size_type  count)
+      {
+        swap<uint16_t>(data, count);
+      }
+
+      void
+      byteswap32(void                *data,
+                 dimension_size_type  count)
+      {
+        swap<uint32_t>(data, count);
+      }
+
+      void
+      byteswap64(void                *data,
+                 dimension_size_type  count)
+      {
+        swap<uint64_t>(data, count);
+      }
+
+    }
+  }
+}
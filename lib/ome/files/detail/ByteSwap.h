@@ -0,0 +1,163 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_BYTESWAP_H
+#define OME_FILES_DETAIL_BYTESWAP_H
+
+#include <complex>
+#include <cstdint>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Byteswap an array of 16-bit values in place.
+       *
+       * SIMD instructions are used where available.  The data need
+       * not be aligned.
+       *
+       * @param data the values to swap.
+       * @param count the number of values.
+       */
+      void
+      byteswap16(void                *data,
+                 dimension_size_type  count);
+
+      /**
+       * Byteswap an array of 32-bit values in place.
+       *
+       * @copydetails byteswap16()
+       */
+      void
+      byteswap32(void                *data,
+                 dimension_size_type  count);
+
+      /**
+       * Byteswap an array of 64-bit values in place.
+       *
+       * @copydetails byteswap16()
+       */
+      void
+      byteswap64(void                *data,
+                 dimension_size_type  count);
+
+      /**
+       * Byteswap properties of a pixel language type.
+       *
+       * Scalar types are swapped as a single component.
+       */
+      template<typename T>
+      struct ByteSwapProperties
+      {
+        /// Component type.
+        typedef T component_type;
+        /// Number of components.
+        static const dimension_size_type components = 1U;
+      };
+
+      /// Byteswap properties for complex float (two components).
+      template<>
+      struct ByteSwapProperties<std::complex<float>>
+      {
+        /// Component type.
+        typedef float component_type;
+        /// Number of components.
+        static const dimension_size_type components = 2U;
+      };
+
+      /// Byteswap properties for complex double (two components).
+      template<>
+      struct ByteSwapProperties<std::complex<double>>
+      {
+        /// Component type.
+        typedef double component_type;
+        /// Number of components.
+        static const dimension_size_type components = 2U;
+      };
+
+      /**
+       * Byteswap an array of pixel values in place.
+       *
+       * This is the bulk equivalent of calling byteswap() for each
+       * value.  Complex values have each component swapped, and
+       * single byte values are left unchanged.
+       *
+       * @param data the values to swap.
+       * @param count the number of values.
+       */
+      template<typename T>
+      inline void
+      byteswap(T                   *data,
+               dimension_size_type  count)
+      {
+        typedef ByteSwapProperties<T> props;
+        const dimension_size_type n = count * props::components;
+
+        switch (sizeof(typename props::component_type))
+          {
+          case 2U:
+            byteswap16(data, n);
+            break;
+          case 4U:
+            byteswap32(data, n);
+            break;
+          case 8U:
+            byteswap64(data, n);
+            break;
+          default:
+            break;
+          }
+      }
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_BYTESWAP_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
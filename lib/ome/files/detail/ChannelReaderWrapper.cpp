@@ -0,0 +1,352 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
+#include <ome/files/detail/ChannelReaderWrapper.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      ChannelReaderWrapper::ChannelReaderWrapper(const std::shared_ptr<FormatReader>& reader):
+        ReaderWrapper(reader),
+        core(),
+        changed(),
+        plane(0U)
+      {
+      }
+
+      ChannelReaderWrapper::~ChannelReaderWrapper()
+      {
+      }
+
+      bool
+      ChannelReaderWrapper::isChanged(dimension_size_type index) const
+      {
+        return index < changed.size() && changed[index];
+      }
+
+      dimension_size_type
+      ChannelReaderWrapper::coreIndexAt(dimension_size_type series,
+                                        dimension_size_type resolution) const
+      {
+        dimension_size_type index = seriesToCoreIndex(series);
+        dimension_size_type count = 1;
+
+        if (index >= core.size() || !core.at(index))
+          {
+            boost::format fmt("Invalid series: %1%");
+            fmt % series;
+            throw std::logic_error(fmt.str());
+          }
+
+        if (!hasFlattenedResolutions())
+          count = core.at(index)->resolutionCount;
+
+        if (resolution >= count)
+          {
+            boost::format fmt("Invalid resolution: %1%");
+            fmt % resolution;
+            throw std::logic_error(fmt.str());
+          }
+
+        return index + resolution;
+      }
+
+      void
+      ChannelReaderWrapper::checkPlane(dimension_size_type index,
+                                       dimension_size_type plane) const
+      {
+        if (plane >= core.at(index)->imageCount)
+          {
+            boost::format fmt("Invalid plane: %1%");
+            fmt % plane;
+            throw std::logic_error(fmt.str());
+          }
+      }
+
+      DimensionIndexer
+      ChannelReaderWrapper::getIndexer(dimension_size_type index) const
+      {
+        const CoreMetadata& c(*core.at(index));
+        return DimensionIndexer(c.dimensionOrder,
+                                c.sizeZ,
+                                c.sizeC.size(),
+                                c.sizeT,
+                                c.moduloZ.size(),
+                                c.moduloC.size(),
+                                c.moduloT.size(),
+                                c.imageCount);
+      }
+
+      DimensionIndexer
+      ChannelReaderWrapper::getReaderIndexer(dimension_size_type index) const
+      {
+        const CoreMetadata& c(getReaderCoreMetadata(index));
+        return DimensionIndexer(c.dimensionOrder,
+                                c.sizeZ,
+                                c.sizeC.size(),
+                                c.sizeT,
+                                c.moduloZ.size(),
+                                c.moduloC.size(),
+                                c.moduloT.size(),
+                                c.imageCount);
+      }
+
+      const CoreMetadata&
+      ChannelReaderWrapper::getReaderCoreMetadata(dimension_size_type index) const
+      {
+        return *reader->getCoreMetadataList().at(index);
+      }
+
+      void
+      ChannelReaderWrapper::setId(const boost::filesystem::path& id)
+      {
+        ReaderWrapper::setId(id);
+
+        core.clear();
+        changed.clear();
+        plane = 0U;
+
+        for (const auto& c : reader->getCoreMetadataList())
+          {
+            std::shared_ptr<CoreMetadata> copy;
+            bool update = false;
+            if (c)
+              {
+                copy = std::make_shared<CoreMetadata>(*c);
+                update = updateCoreMetadata(*copy);
+              }
+            core.push_back(copy);
+            changed.push_back(update);
+          }
+      }
+
+      void
+      ChannelReaderWrapper::close(bool fileOnly)
+      {
+        ReaderWrapper::close(fileOnly);
+
+        if (!fileOnly)
+          {
+            core.clear();
+            changed.clear();
+            plane = 0U;
+          }
+      }
+
+      dimension_size_type
+      ChannelReaderWrapper::getImageCount() const
+      {
+        const dimension_size_type index = getCoreIndex();
+        if (!isChanged(index))
+          return ReaderWrapper::getImageCount();
+        return core.at(index)->imageCount;
+      }
+
+      bool
+      ChannelReaderWrapper::isRGB(dimension_size_type channel) const
+      {
+        return getRGBChannelCount(channel) > 1U;
+      }
+
+      dimension_size_type
+      ChannelReaderWrapper::getEffectiveSizeC() const
+      {
+        const dimension_size_type index = getCoreIndex();
+        if (!isChanged(index))
+          return ReaderWrapper::getEffectiveSizeC();
+        return core.at(index)->sizeC.size();
+      }
+
+      dimension_size_type
+      ChannelReaderWrapper::getRGBChannelCount(dimension_size_type channel) const
+      {
+        const dimension_size_type index = getCoreIndex();
+        if (!isChanged(index))
+          return ReaderWrapper::getRGBChannelCount(channel);
+        return core.at(index)->sizeC.at(channel);
+      }
+
+      bool
+      ChannelReaderWrapper::isInterleaved() const
+      {
+        return isInterleaved(0);
+      }
+
+      bool
+      ChannelReaderWrapper::isInterleaved(dimension_size_type channel) const
+      {
+        const dimension_size_type index = getCoreIndex();
+        if (!isChanged(index))
+          return ReaderWrapper::isInterleaved(channel);
+        return core.at(index)->interleaved;
+      }
+
+      void
+      ChannelReaderWrapper::openRawTile(dimension_size_type   plane,
+                                        dimension_size_type   tile,
+                                        std::vector<uint8_t>& buf) const
+      {
+        if (isChanged(getCoreIndex()))
+          throw std::runtime_error("Raw tiles are not available for merged or separated channels");
+        ReaderWrapper::openRawTile(plane, tile, buf);
+      }
+
+      void
+      ChannelReaderWrapper::openBytesInto(dimension_size_type     series,
+                                          dimension_size_type     resolution,
+                                          dimension_size_type     plane,
+                                          VariantPixelBufferView& buf,
+                                          const PlaneRegion&      region) const
+      {
+        if (!isChanged(coreIndexAt(series, resolution)))
+          {
+            ReaderWrapper::openBytesInto(series, resolution, plane, buf, region);
+            return;
+          }
+
+        VariantPixelBuffer tmp;
+        openBytesAt(series, resolution, plane, tmp, region);
+        buf.copyFrom(tmp);
+      }
+
+      void
+      ChannelReaderWrapper::setSeries(dimension_size_type series) const
+      {
+        ReaderWrapper::setSeries(series);
+        plane = 0U;
+      }
+
+      void
+      ChannelReaderWrapper::setPlane(dimension_size_type plane) const
+      {
+        if (plane >= getImageCount())
+          {
+            boost::format fmt("Invalid plane: %1%");
+            fmt % plane;
+            throw std::logic_error(fmt.str());
+          }
+        this->plane = plane;
+      }
+
+      dimension_size_type
+      ChannelReaderWrapper::getPlane() const
+      {
+        return plane;
+      }
+
+      dimension_size_type
+      ChannelReaderWrapper::getIndex(dimension_size_type z,
+                                     dimension_size_type c,
+                                     dimension_size_type t) const
+      {
+        const DimensionIndexer indexer(getDimensionIndexer());
+        indexer.checkCoords(z, c, t);
+        return indexer.index(z, c, t);
+      }
+
+      dimension_size_type
+      ChannelReaderWrapper::getIndex(dimension_size_type z,
+                                     dimension_size_type c,
+                                     dimension_size_type t,
+                                     dimension_size_type moduloZ,
+                                     dimension_size_type moduloC,
+                                     dimension_size_type moduloT) const
+      {
+        const DimensionIndexer indexer(getDimensionIndexer());
+        indexer.checkCoords(z, c, t, moduloZ, moduloC, moduloT);
+        return indexer.index(z, c, t, moduloZ, moduloC, moduloT);
+      }
+
+      std::array<dimension_size_type, 3>
+      ChannelReaderWrapper::getZCTCoords(dimension_size_type index) const
+      {
+        const DimensionIndexer indexer(getDimensionIndexer());
+        indexer.checkIndex(index);
+        return indexer.coords(index);
+      }
+
+      std::array<dimension_size_type, 6>
+      ChannelReaderWrapper::getZCTModuloCoords(dimension_size_type index) const
+      {
+        const DimensionIndexer indexer(getDimensionIndexer());
+        indexer.checkIndex(index);
+        return indexer.moduloCoords(index);
+      }
+
+      DimensionIndexer
+      ChannelReaderWrapper::getDimensionIndexer() const
+      {
+        const dimension_size_type index = getCoreIndex();
+        if (!isChanged(index))
+          return ReaderWrapper::getDimensionIndexer();
+        return getIndexer(index);
+      }
+
+      const std::vector<std::shared_ptr<CoreMetadata>>&
+      ChannelReaderWrapper::getCoreMetadataList() const
+      {
+        return core;
+      }
+
+      void
+      ChannelReaderWrapper::setCoreIndex(dimension_size_type index) const
+      {
+        ReaderWrapper::setCoreIndex(index);
+        plane = 0U;
+      }
+
+      void
+      ChannelReaderWrapper::setResolution(dimension_size_type resolution) const
+      {
+        ReaderWrapper::setResolution(resolution);
+        plane = 0U;
+      }
+
+    }
+  }
+}
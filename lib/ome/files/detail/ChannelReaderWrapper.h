@@ -0,0 +1,287 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_CHANNELREADERWRAPPER_H
+#define OME_FILES_DETAIL_CHANNELREADERWRAPPER_H
+
+#include <memory>
+#include <vector>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/DimensionIndexer.h>
+#include <ome/files/ReaderWrapper.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Reader wrapper presenting the channels of a reader differently.
+       *
+       * This is the common base of ChannelMerger and
+       * ChannelSeparator.  When the id is set, the CoreMetadata of
+       * the wrapped reader is copied for each core index, and the
+       * derived class updates the copy to describe the channels it
+       * presents.  The image count, channel, interleaving and plane
+       * indexing methods then use the updated metadata.  Series
+       * whose channels are left unchanged are forwarded to the
+       * wrapped reader.
+       *
+       * The current plane is tracked by the wrapper, since the plane
+       * indexes of the wrapper and wrapped reader differ.
+       */
+      class ChannelReaderWrapper : public ReaderWrapper
+      {
+      protected:
+        /// List type for storing CoreMetadata.
+        typedef std::vector<std::shared_ptr<CoreMetadata>> coremetadata_list_type;
+
+        /// The CoreMetadata presented for each core index.
+        coremetadata_list_type core;
+
+        /// Whether the channels of each core index are changed.
+        std::vector<bool> changed;
+
+        /// The current plane.
+        mutable dimension_size_type plane;
+
+        /**
+         * Constructor.
+         *
+         * @param reader the reader to wrap.
+         * @throws std::logic_error if the reader is null.
+         */
+        explicit
+        ChannelReaderWrapper(const std::shared_ptr<FormatReader>& reader);
+
+      public:
+        /// Destructor.
+        virtual
+        ~ChannelReaderWrapper();
+
+      protected:
+        /**
+         * Update CoreMetadata to describe the presented channels.
+         *
+         * @param metadata a copy of the CoreMetadata of the wrapped
+         * reader for one core index.
+         * @returns @c true if the channels were changed, or @c false
+         * if the metadata was left unchanged.
+         */
+        virtual
+        bool
+        updateCoreMetadata(CoreMetadata& metadata) const = 0;
+
+        /**
+         * Check if the channels of a core index are changed.
+         *
+         * @param index the core index.
+         * @returns @c true if changed, @c false otherwise.
+         */
+        bool
+        isChanged(dimension_size_type index) const;
+
+        /**
+         * Get the core index of a series and resolution.
+         *
+         * @param series the series.
+         * @param resolution the resolution within the series.
+         * @returns the core index.
+         * @throws std::logic_error if the series or resolution is
+         * invalid.
+         */
+        dimension_size_type
+        coreIndexAt(dimension_size_type series,
+                    dimension_size_type resolution) const;
+
+        /**
+         * Check a plane index is valid for a core index.
+         *
+         * @param index the core index.
+         * @param plane the plane index.
+         * @throws std::logic_error if the plane index is invalid.
+         */
+        void
+        checkPlane(dimension_size_type index,
+                   dimension_size_type plane) const;
+
+        /**
+         * Get the dimension indexer of the presented planes.
+         *
+         * @param index the core index.
+         * @returns the dimension indexer.
+         */
+        DimensionIndexer
+        getIndexer(dimension_size_type index) const;
+
+        /**
+         * Get the dimension indexer of the wrapped reader planes.
+         *
+         * @param index the core index.
+         * @returns the dimension indexer.
+         */
+        DimensionIndexer
+        getReaderIndexer(dimension_size_type index) const;
+
+        /**
+         * Get the wrapped reader CoreMetadata.
+         *
+         * @param index the core index.
+         * @returns the CoreMetadata.
+         */
+        const CoreMetadata&
+        getReaderCoreMetadata(dimension_size_type index) const;
+
+      public:
+        // Documented in superclass.
+        void
+        setId(const boost::filesystem::path& id);
+
+        // Documented in superclass.
+        void
+        close(bool fileOnly = false);
+
+        // Documented in superclass.
+        dimension_size_type
+        getImageCount() const;
+
+        // Documented in superclass.
+        bool
+        isRGB(dimension_size_type channel) const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getEffectiveSizeC() const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getRGBChannelCount(dimension_size_type channel) const;
+
+        // Documented in superclass.
+        bool
+        isInterleaved() const;
+
+        // Documented in superclass.
+        bool
+        isInterleaved(dimension_size_type channel) const;
+
+        // Documented in superclass.
+        void
+        openRawTile(dimension_size_type   plane,
+                    dimension_size_type   tile,
+                    std::vector<uint8_t>& buf) const;
+
+        /**
+         * @copydoc ome::files::FormatReader::openBytesInto(dimension_size_type,dimension_size_type,dimension_size_type,VariantPixelBufferView&,const PlaneRegion&)const
+         *
+         * Where the channels are changed, the region is read with
+         * openBytesAt() and copied into the view.
+         */
+        void
+        openBytesInto(dimension_size_type     series,
+                      dimension_size_type     resolution,
+                      dimension_size_type     plane,
+                      VariantPixelBufferView& buf,
+                      const PlaneRegion&      region) const;
+
+        // Documented in superclass.
+        void
+        setSeries(dimension_size_type series) const;
+
+        // Documented in superclass.
+        void
+        setPlane(dimension_size_type plane) const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getPlane() const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getIndex(dimension_size_type z,
+                 dimension_size_type c,
+                 dimension_size_type t) const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getIndex(dimension_size_type z,
+                 dimension_size_type c,
+                 dimension_size_type t,
+                 dimension_size_type moduloZ,
+                 dimension_size_type moduloC,
+                 dimension_size_type moduloT) const;
+
+        // Documented in superclass.
+        std::array<dimension_size_type, 3>
+        getZCTCoords(dimension_size_type index) const;
+
+        // Documented in superclass.
+        std::array<dimension_size_type, 6>
+        getZCTModuloCoords(dimension_size_type index) const;
+
+        // Documented in superclass.
+        DimensionIndexer
+        getDimensionIndexer() const;
+
+        // Documented in superclass.
+        const std::vector<std::shared_ptr<CoreMetadata>>&
+        getCoreMetadataList() const;
+
+        // Documented in superclass.
+        void
+        setCoreIndex(dimension_size_type index) const;
+
+        // Documented in superclass.
+        void
+        setResolution(dimension_size_type resolution) const;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_CHANNELREADERWRAPPER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
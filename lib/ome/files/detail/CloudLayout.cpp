@@ -0,0 +1,723 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/detail/CloudLayout.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        // TIFF tags which need relocation.
+        const uint16_t tag_stripoffsets = 273U;
+        const uint16_t tag_stripbytecounts = 279U;
+        const uint16_t tag_freeoffsets = 288U;
+        const uint16_t tag_tileoffsets = 324U;
+        const uint16_t tag_tilebytecounts = 325U;
+        const uint16_t tag_subifd = 330U;
+        const uint16_t tag_jpegifoffset = 513U;
+        const uint16_t tag_exififd = 34665U;
+        const uint16_t tag_gpsifd = 34853U;
+        const uint16_t tag_interopifd = 40965U;
+
+        // No directory follows the last of a file.
+        const std::size_t no_link = static_cast<std::size_t>(-1);
+
+        // TIFF field types which refer to IFDs.
+        const uint16_t type_ifd = 13U;
+        const uint16_t type_ifd8 = 18U;
+
+        // Size of a TIFF field type, or zero if unknown.
+        uint64_t
+        typeSize(uint16_t type)
+        {
+          switch(type)
+            {
+            case 1U: // BYTE
+            case 2U: // ASCII
+            case 6U: // SBYTE
+            case 7U: // UNDEFINED
+              return 1U;
+            case 3U: // SHORT
+            case 8U: // SSHORT
+              return 2U;
+            case 4U: // LONG
+            case 9U: // SLONG
+            case 11U: // FLOAT
+            case 13U: // IFD
+              return 4U;
+            case 5U: // RATIONAL
+            case 10U: // SRATIONAL
+            case 12U: // DOUBLE
+            case 16U: // LONG8
+            case 17U: // SLONG8
+            case 18U: // IFD8
+              return 8U;
+            default:
+              return 0U;
+            }
+        }
+
+        // A directory entry, with its value in file byte order.
+        struct Entry
+        {
+          uint16_t tag;
+          uint16_t type;
+          uint64_t count;
+          std::vector<uint8_t> value;
+          uint64_t offset; // Destination offset of the value, if not inline.
+        };
+
+        // A directory, with source offsets until relocated.
+        struct Directory
+        {
+          std::vector<Entry> entries;
+          uint64_t next;
+          std::size_t file; // Source file index.
+          std::size_t link; // Directory following the last of a file, if any.
+          std::vector<uint64_t> subifds;
+          std::vector<uint64_t> dataOffsets;
+          std::vector<uint64_t> dataSizes;
+          uint64_t offset;
+          uint64_t level;
+          uint64_t plane;
+        };
+
+        // Relocates the directories and data of a TIFF file.
+        class CloudLayout
+        {
+        public:
+          explicit
+          CloudLayout(const std::vector<boost::filesystem::path>& sources):
+            sources(sources),
+            file(sources.size()),
+            source(),
+            in(),
+            fileSize(0U),
+            bigEndian(false),
+            bigTIFF(false),
+            directories(),
+            index(),
+            copies()
+          {
+            if (sources.empty())
+              throw std::logic_error("No TIFF files to copy");
+          }
+
+          void
+          write(const boost::filesystem::path& destination)
+          {
+            readDirectories();
+
+            const uint64_t dataStart = layoutDirectories();
+            const uint64_t end = layoutData(dataStart);
+            if (!bigTIFF && end > 0xFFFFFFFFULL)
+              throw FormatException("Relocated TIFF data exceeds the 4 GiB limit of a classic TIFF");
+
+            std::vector<uint8_t> header(dataStart, 0U);
+            writeDirectories(header);
+
+            boost::filesystem::ofstream out(destination,
+                                            std::ios::out | std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char *>(header.data()),
+                      static_cast<std::streamsize>(header.size()));
+
+            std::vector<char> buf;
+            for (const auto& copy : copies)
+              {
+                open(copy.first.first);
+                buf.resize(copy.second);
+                in.seekg(static_cast<std::streamoff>(copy.first.second), std::ios::beg);
+                in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+                if (!in)
+                  {
+                    boost::format fmt("Failed to read tile data from %1%");
+                    fmt % source;
+                    throw std::runtime_error(fmt.str());
+                  }
+                out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+              }
+
+            out.close();
+            if (!out)
+              {
+                boost::format fmt("Failed to write %1%");
+                fmt % destination;
+                throw std::runtime_error(fmt.str());
+              }
+          }
+
+        private:
+          // Make a source file current for reading.
+          void
+          open(std::size_t next)
+          {
+            if (next == file)
+              return;
+
+            in.close();
+            in.clear();
+            file = next;
+            source = sources.at(file);
+            in.open(source, std::ios::in | std::ios::binary);
+            if (!in)
+              {
+                boost::format fmt("Failed to open %1%");
+                fmt % source;
+                throw std::runtime_error(fmt.str());
+              }
+            in.seekg(0, std::ios::end);
+            fileSize = static_cast<uint64_t>(in.tellg());
+          }
+
+          uint64_t
+          decode(const uint8_t *data,
+                 uint64_t       size) const
+          {
+            uint64_t value = 0U;
+            for (uint64_t i = 0U; i < size; ++i)
+              {
+                const uint64_t byte = bigEndian ? data[i] : data[size - 1U - i];
+                value = (value << 8U) | byte;
+              }
+            return value;
+          }
+
+          void
+          encode(uint8_t  *data,
+                 uint64_t  size,
+                 uint64_t  value) const
+          {
+            for (uint64_t i = 0U; i < size; ++i)
+              {
+                const uint64_t shift = 8U * (bigEndian ? size - 1U - i : i);
+                data[i] = static_cast<uint8_t>((value >> shift) & 0xFFU);
+              }
+          }
+
+          void
+          read(uint64_t              offset,
+               std::vector<uint8_t>& buf)
+          {
+            in.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+            in.read(reinterpret_cast<char *>(buf.data()), static_cast<std::streamsize>(buf.size()));
+            if (!in)
+              {
+                boost::format fmt("%1% is not a valid TIFF file: Failed to read %2% bytes at offset %3%");
+                fmt % source % buf.size() % offset;
+                throw FormatException(fmt.str());
+              }
+          }
+
+          uint64_t
+          readValue(uint64_t offset,
+                    uint64_t size)
+          {
+            std::vector<uint8_t> buf(size);
+            read(offset, buf);
+            return decode(buf.data(), size);
+          }
+
+          // Values of an offset or byte count array.
+          std::vector<uint64_t>
+          values(const Entry& entry) const
+          {
+            const uint64_t size = typeSize(entry.type);
+            std::vector<uint64_t> ret;
+            ret.reserve(entry.count);
+            for (uint64_t i = 0U; i < entry.count; ++i)
+              ret.push_back(decode(entry.value.data() + (i * size), size));
+            return ret;
+          }
+
+          void
+          setValues(Entry&                       entry,
+                    const std::vector<uint64_t>& values) const
+          {
+            const uint64_t size = typeSize(entry.type);
+            for (uint64_t i = 0U; i < entry.count; ++i)
+              {
+                if (size < 8U && values[i] >> (8U * size))
+                  throw FormatException("Relocated TIFF offset does not fit its field type");
+                encode(entry.value.data() + (i * size), size, values[i]);
+              }
+          }
+
+          std::size_t
+          readDirectory(uint64_t offset,
+                        uint64_t level,
+                        uint64_t plane)
+          {
+            const uint64_t inlineSize = bigTIFF ? 8U : 4U;
+            const uint64_t entrySize = bigTIFF ? 20U : 12U;
+
+            Directory dir;
+            dir.file = file;
+            dir.link = no_link;
+            dir.level = level;
+            dir.plane = plane;
+            dir.offset = 0U;
+
+            const uint64_t count = readValue(offset, bigTIFF ? 8U : 2U);
+            if (count > 0xFFFFU)
+              {
+                boost::format fmt("%1% is not a valid TIFF file: IFD at offset %2% has %3% entries");
+                fmt % source % offset % count;
+                throw FormatException(fmt.str());
+              }
+            std::vector<uint8_t> raw(count * entrySize + inlineSize);
+            read(offset + (bigTIFF ? 8U : 2U), raw);
+            dir.next = decode(raw.data() + (count * entrySize), inlineSize);
+
+            for (uint64_t i = 0U; i < count; ++i)
+              {
+                const uint8_t *field = raw.data() + (i * entrySize);
+                Entry entry;
+                entry.tag = static_cast<uint16_t>(decode(field, 2U));
+                entry.type = static_cast<uint16_t>(decode(field + 2U, 2U));
+                entry.count = decode(field + 4U, inlineSize);
+                entry.offset = 0U;
+
+                const uint64_t size = typeSize(entry.type);
+                if (!size)
+                  {
+                    boost::format fmt("%1% is not a valid TIFF file: Unknown type %2% for tag %3%");
+                    fmt % source % entry.type % entry.tag;
+                    throw FormatException(fmt.str());
+                  }
+                if (entry.count > fileSize / size + inlineSize)
+                  {
+                    boost::format fmt("%1% is not a valid TIFF file: Invalid count %2% for tag %3%");
+                    fmt % source % entry.count % entry.tag;
+                    throw FormatException(fmt.str());
+                  }
+                if (entry.tag == tag_freeoffsets || entry.tag == tag_jpegifoffset ||
+                    entry.tag == tag_exififd || entry.tag == tag_gpsifd || entry.tag == tag_interopifd ||
+                    ((entry.type == type_ifd || entry.type == type_ifd8) && entry.tag != tag_subifd))
+                  {
+                    boost::format fmt("%1% contains tag %2%, which refers to data that can not be relocated");
+                    fmt % source % entry.tag;
+                    throw FormatException(fmt.str());
+                  }
+
+                entry.value.resize(entry.count * size);
+                const uint8_t *valuefield = field + 4U + inlineSize;
+                if (entry.value.size() <= inlineSize)
+                  std::copy(valuefield, valuefield + entry.value.size(), entry.value.begin());
+                else
+                  read(decode(valuefield, inlineSize), entry.value);
+
+                switch(entry.tag)
+                  {
+                  case tag_stripoffsets:
+                  case tag_tileoffsets:
+                    dir.dataOffsets = values(entry);
+                    break;
+                  case tag_stripbytecounts:
+                  case tag_tilebytecounts:
+                    dir.dataSizes = values(entry);
+                    break;
+                  case tag_subifd:
+                    dir.subifds = values(entry);
+                    break;
+                  default:
+                    break;
+                  }
+
+                dir.entries.push_back(entry);
+              }
+
+            if (dir.dataOffsets.size() != dir.dataSizes.size())
+              {
+                boost::format fmt("%1% is not a valid TIFF file: IFD at offset %2% has %3% data offsets but %4% byte counts");
+                fmt % source % offset % dir.dataOffsets.size() % dir.dataSizes.size();
+                throw FormatException(fmt.str());
+              }
+
+            const std::size_t ret = directories.size();
+            directories.push_back(dir);
+            index[std::make_pair(file, offset)] = ret;
+            return ret;
+          }
+
+          // Read a SubIFD and any IFDs chained to it.
+          void
+          readSubDirectories(uint64_t offset,
+                             uint64_t level,
+                             uint64_t plane)
+          {
+            while (offset && index.find(std::make_pair(file, offset)) == index.end())
+              {
+                const std::size_t dir = readDirectory(offset, level, plane);
+                const std::vector<uint64_t> subifds(directories[dir].subifds);
+                for (std::size_t i = 0U; i < subifds.size(); ++i)
+                  readSubDirectories(subifds[i], level + i + 1U, plane);
+                offset = directories[dir].next;
+              }
+          }
+
+          // Read the directories of the current file, numbering its
+          // planes from the specified plane, and return the number of
+          // planes read.
+          uint64_t
+          readFileDirectories(uint64_t firstPlane)
+          {
+            std::vector<uint8_t> header(4U);
+            read(0U, header);
+            bool fileBigEndian;
+            if (header[0] == 'I' && header[1] == 'I')
+              fileBigEndian = false;
+            else if (header[0] == 'M' && header[1] == 'M')
+              fileBigEndian = true;
+            else
+              {
+                boost::format fmt("%1% is not a valid TIFF file: Invalid endian header");
+                fmt % source;
+                throw FormatException(fmt.str());
+              }
+            if (file && fileBigEndian != bigEndian)
+              {
+                boost::format fmt("%1% has a different byte order from %2%");
+                fmt % source % sources.front();
+                throw FormatException(fmt.str());
+              }
+            bigEndian = fileBigEndian;
+
+            const uint64_t version = decode(header.data() + 2U, 2U);
+            if (version != 0x2AU && version != 0x2BU)
+              {
+                boost::format fmt("%1% is not a valid TIFF file: Invalid version %2%");
+                fmt % source % version;
+                throw FormatException(fmt.str());
+              }
+            if (file && (version == 0x2BU) != bigTIFF)
+              {
+                boost::format fmt("%1% has a different offset size from %2%");
+                fmt % source % sources.front();
+                throw FormatException(fmt.str());
+              }
+            bigTIFF = version == 0x2BU;
+            if (bigTIFF && readValue(4U, 2U) != 8U)
+              {
+                boost::format fmt("%1% uses a nonstandard offset size");
+                fmt % source;
+                throw FormatException(fmt.str());
+              }
+
+            uint64_t offset = bigTIFF ? readValue(8U, 8U) : readValue(4U, 4U);
+            uint64_t plane = firstPlane;
+            for (; offset; ++plane)
+              {
+                if (index.find(std::make_pair(file, offset)) != index.end())
+                  {
+                    boost::format fmt("%1% is not a valid TIFF file: IFD loop at offset %2%");
+                    fmt % source % offset;
+                    throw FormatException(fmt.str());
+                  }
+                const std::size_t dir = readDirectory(offset, 0U, plane);
+                const std::vector<uint64_t> subifds(directories[dir].subifds);
+                for (std::size_t i = 0U; i < subifds.size(); ++i)
+                  readSubDirectories(subifds[i], i + 1U, plane);
+                offset = directories[dir].next;
+              }
+
+            if (plane == firstPlane)
+              {
+                boost::format fmt("%1% is not a valid TIFF file: No IFDs");
+                fmt % source;
+                throw FormatException(fmt.str());
+              }
+            return plane - firstPlane;
+          }
+
+          // Read the directories of all files, chaining the first
+          // IFD of each file to the last IFD of the preceding file.
+          void
+          readDirectories()
+          {
+            uint64_t plane = 0U;
+            std::size_t last = no_link;
+            for (std::size_t next = 0U; next < sources.size(); ++next)
+              {
+                open(next);
+                const std::size_t first = directories.size();
+                plane += readFileDirectories(plane);
+                if (last != no_link)
+                  directories[last].link = first;
+                // The last IFD of the file is the last IFD of its
+                // chain, which is read before its SubIFDs.
+                for (std::size_t i = first; i < directories.size(); ++i)
+                  if (directories[i].level == 0U)
+                    last = i;
+              }
+          }
+
+          // Place the directories and their values after the
+          // header, and return the end offset.
+          uint64_t
+          layoutDirectories()
+          {
+            const uint64_t inlineSize = bigTIFF ? 8U : 4U;
+            uint64_t pos = bigTIFF ? 16U : 8U;
+
+            for (auto& dir : directories)
+              {
+                // IFDs and values must start on a word boundary.
+                pos += pos & 1U;
+                dir.offset = pos;
+                pos += bigTIFF ? 8U + (20U * dir.entries.size()) + 8U : 2U + (12U * dir.entries.size()) + 4U;
+                for (auto& entry : dir.entries)
+                  {
+                    if (entry.value.size() <= inlineSize)
+                      continue;
+                    pos += pos & 1U;
+                    entry.offset = pos;
+                    pos += entry.value.size();
+                  }
+              }
+
+            return pos;
+          }
+
+          // Place the tile and strip data after the directories,
+          // smallest resolution first, and return the end offset.
+          uint64_t
+          layoutData(uint64_t start)
+          {
+            std::vector<std::size_t> order(directories.size());
+            for (std::size_t i = 0U; i < order.size(); ++i)
+              order[i] = i;
+            std::stable_sort(order.begin(), order.end(),
+                             [this](std::size_t lhs, std::size_t rhs)
+                             {
+                               const Directory& l(directories[lhs]);
+                               const Directory& r(directories[rhs]);
+                               if (l.level != r.level)
+                                 return l.level > r.level;
+                               return l.plane < r.plane;
+                             });
+
+            // Data shared by several tiles is copied once.
+            std::map<copy_key, uint64_t> copied;
+            uint64_t pos = start;
+            for (std::size_t i : order)
+              {
+                Directory& dir(directories[i]);
+                for (std::size_t tile = 0U; tile < dir.dataOffsets.size(); ++tile)
+                  {
+                    uint64_t& offset(dir.dataOffsets[tile]);
+                    const uint64_t size = dir.dataSizes[tile];
+                    if (!offset || !size)
+                      {
+                        // Sparse tile.
+                        offset = 0U;
+                        continue;
+                      }
+                    open(dir.file);
+                    if (offset > fileSize || size > fileSize - offset)
+                      {
+                        boost::format fmt("%1% is not a valid TIFF file: Tile data at offset %2% exceeds the file size");
+                        fmt % source % offset;
+                        throw FormatException(fmt.str());
+                      }
+                    const copy_key key(std::make_pair(dir.file, offset), size);
+                    auto existing = copied.find(key);
+                    if (existing != copied.end())
+                      offset = existing->second;
+                    else
+                      {
+                        copies.push_back(key);
+                        copied.insert(std::make_pair(key, pos));
+                        offset = pos;
+                        pos += size;
+                      }
+                  }
+              }
+
+            return pos;
+          }
+
+          uint64_t
+          relocated(std::size_t file,
+                    uint64_t    offset) const
+          {
+            if (!offset)
+              return 0U;
+            return directories[index.at(std::make_pair(file, offset))].offset;
+          }
+
+          // Serialise the header, directories and values.
+          void
+          writeDirectories(std::vector<uint8_t>& buf)
+          {
+            const uint64_t inlineSize = bigTIFF ? 8U : 4U;
+
+            buf[0] = buf[1] = bigEndian ? 'M' : 'I';
+            if (bigTIFF)
+              {
+                encode(&buf[2], 2U, 0x2BU);
+                encode(&buf[4], 2U, 8U);
+                encode(&buf[6], 2U, 0U);
+                encode(&buf[8], 8U, directories.front().offset);
+              }
+            else
+              {
+                encode(&buf[2], 2U, 0x2AU);
+                encode(&buf[4], 4U, directories.front().offset);
+              }
+
+            for (auto& dir : directories)
+              {
+                std::vector<uint64_t> subifds(dir.subifds);
+                for (auto& subifd : subifds)
+                  subifd = relocated(dir.file, subifd);
+
+                uint8_t *pos = &buf[dir.offset];
+                encode(pos, bigTIFF ? 8U : 2U, dir.entries.size());
+                pos += bigTIFF ? 8U : 2U;
+                for (auto& entry : dir.entries)
+                  {
+                    switch(entry.tag)
+                      {
+                      case tag_stripoffsets:
+                      case tag_tileoffsets:
+                        setValues(entry, dir.dataOffsets);
+                        break;
+                      case tag_subifd:
+                        setValues(entry, subifds);
+                        break;
+                      default:
+                        break;
+                      }
+
+                    encode(pos, 2U, entry.tag);
+                    encode(pos + 2U, 2U, entry.type);
+                    encode(pos + 4U, inlineSize, entry.count);
+                    uint8_t *valuefield = pos + 4U + inlineSize;
+                    if (entry.value.size() <= inlineSize)
+                      std::copy(entry.value.begin(), entry.value.end(), valuefield);
+                    else
+                      {
+                        encode(valuefield, inlineSize, entry.offset);
+                        std::copy(entry.value.begin(), entry.value.end(), &buf[entry.offset]);
+                      }
+                    pos += bigTIFF ? 20U : 12U;
+                  }
+                encode(pos, inlineSize,
+                       dir.link != no_link ? directories[dir.link].offset : relocated(dir.file, dir.next));
+              }
+          }
+
+          // Source file index and offset.
+          typedef std::pair<std::size_t, uint64_t> file_offset;
+          // Source file index and offset, and size.
+          typedef std::pair<file_offset, uint64_t> copy_key;
+
+          std::vector<boost::filesystem::path> sources;
+          // Current source file index, path, stream and size.
+          std::size_t file;
+          boost::filesystem::path source;
+          boost::filesystem::ifstream in;
+          uint64_t fileSize;
+          bool bigEndian;
+          bool bigTIFF;
+          std::vector<Directory> directories;
+          // Directory index by source file and offset.
+          std::map<file_offset, std::size_t> index;
+          // Source file, offset and size of the data to copy, in order.
+          std::vector<copy_key> copies;
+        };
+
+      }
+
+      void
+      writeCloudLayout(const boost::filesystem::path& source,
+                       const boost::filesystem::path& destination)
+      {
+        writeCloudLayout(std::vector<boost::filesystem::path>(1U, source), destination);
+      }
+
+      void
+      writeCloudLayout(const std::vector<boost::filesystem::path>& sources,
+                       const boost::filesystem::path&              destination)
+      {
+        CloudLayout layout(sources);
+        layout.write(destination);
+      }
+
+      void
+      applyCloudLayout(const boost::filesystem::path& filename)
+      {
+        boost::filesystem::path temp(filename);
+        temp += ".layout-%%%%-%%%%";
+        temp = boost::filesystem::unique_path(temp);
+
+        try
+          {
+            writeCloudLayout(filename, temp);
+            boost::filesystem::rename(temp, filename);
+          }
+        catch (const std::exception&)
+          {
+            boost::system::error_code ec;
+            boost::filesystem::remove(temp, ec);
+            throw;
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,124 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_CLOUDLAYOUT_H
+#define OME_FILES_DETAIL_CLOUDLAYOUT_H
+
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Copy a TIFF file with a cloud-optimized layout.
+       *
+       * The header is followed by every IFD (including SubIFDs)
+       * with its tag data, so that all the directories and
+       * metadata may be fetched with a single range request.  The
+       * tile and strip data follows, grouped by pyramid level from
+       * the smallest sub-resolution to the full resolution, then by
+       * plane in IFD order, with the tiles of each plane in
+       * row-major order.  Tiles shared between IFDs remain shared,
+       * and sparse tiles remain sparse.  Unreferenced data, such as
+       * superseded OME-XML text, is not copied.  The tag values and
+       * byte order are otherwise unchanged.
+       *
+       * @param source the TIFF file to copy.
+       * @param destination the file to write.
+       * @throws FormatException if the source is not a valid TIFF
+       * file, or contains EXIF, GPS or other directories which can
+       * not be relocated.
+       * @throws std::runtime_error if reading or writing fails.
+       */
+      void
+      writeCloudLayout(const boost::filesystem::path& source,
+                       const boost::filesystem::path& destination);
+
+      /**
+       * Concatenate TIFF files with a cloud-optimized layout.
+       *
+       * As writeCloudLayout(const boost::filesystem::path&, const
+       * boost::filesystem::path&), but the IFDs of each file are
+       * chained after those of the preceding file, so that the
+       * destination holds all the IFDs of the sources, in order.
+       * The tile and strip data of all the files is grouped
+       * together by pyramid level, and then by plane.  The files
+       * must have the same byte order and offset size.
+       *
+       * @param sources the TIFF files to copy.
+       * @param destination the file to write.
+       * @throws FormatException if a source is not a valid TIFF
+       * file, contains directories which can not be relocated, or
+       * differs in byte order or offset size from the first.
+       * @throws std::runtime_error if reading or writing fails.
+       */
+      void
+      writeCloudLayout(const std::vector<boost::filesystem::path>& sources,
+                       const boost::filesystem::path&              destination);
+
+      /**
+       * Rewrite a TIFF file in place with a cloud-optimized layout.
+       *
+       * The file is copied with writeCloudLayout() to a temporary
+       * file in the same directory, which then replaces it.  The
+       * original file is left unchanged if the copy fails.
+       *
+       * @param filename the TIFF file to rewrite.
+       * @throws FormatException if the file can not be relocated.
+       * @throws std::runtime_error if reading or writing fails.
+       */
+      void
+      applyCloudLayout(const boost::filesystem::path& filename);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_CLOUDLAYOUT_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,632 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define OME_FILES_DOWNSAMPLE_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define OME_FILES_DOWNSAMPLE_NEON 1
+#endif
+
+#include <ome/files/detail/Downsample.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        // Accumulator type for the mean of samples of type T; bit
+        // samples are counted.
+        template<typename T>
+        struct DownsampleSum
+        {
+          typedef typename std::conditional<std::is_integral<T>::value, int64_t, double>::type type;
+        };
+
+        // Accumulator type for the mean of 2×2 blocks, which is
+        // narrower for 8- and 16-bit samples to allow vectorisation.
+        template<typename T>
+        struct DownsampleSum2
+        {
+          typedef typename std::conditional<std::is_integral<T>::value && sizeof(T) <= 2U,
+                                            int32_t,
+                                            typename DownsampleSum<T>::type>::type type;
+        };
+
+        // Mean of integer samples, rounded to nearest.
+        template<typename T, typename S>
+        inline typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, T>::type
+        block_mean(S sum,
+                   S count)
+        {
+          return static_cast<T>((sum + (sum < 0 ? -count : count) / 2) / count);
+        }
+
+        // Mean of bit samples (majority value, rounding up).
+        template<typename T, typename S>
+        inline typename std::enable_if<std::is_same<T, bool>::value, T>::type
+        block_mean(S sum,
+                   S count)
+        {
+          return sum * 2 >= count;
+        }
+
+        // Mean of floating point samples.
+        template<typename T, typename S>
+        inline typename std::enable_if<std::is_floating_point<T>::value, T>::type
+        block_mean(double sum,
+                   S      count)
+        {
+          return static_cast<T>(sum / static_cast<double>(count));
+        }
+
+        // Bitwise OR of integer and bit samples.
+        template<typename T>
+        inline typename std::enable_if<std::is_integral<T>::value, T>::type
+        sample_or(T a,
+                  T b)
+        {
+          return static_cast<T>(a | b);
+        }
+
+        // Not defined for floating point samples; rejected by
+        // check_method().
+        template<typename T>
+        inline typename std::enable_if<!std::is_integral<T>::value, T>::type
+        sample_or(T a,
+                  T /* b */)
+        {
+          return a;
+        }
+
+        // Most frequent of four values in row order; ties are
+        // resolved by the first value.
+        template<typename T>
+        inline T
+        mode4(T v0,
+              T v1,
+              T v2,
+              T v3)
+        {
+          if (v1 == v0 || v2 == v0 || v3 == v0)
+            return v0;
+          if (v2 == v1 || v3 == v1)
+            return v1;
+          if (v3 == v2)
+            return v2;
+          return v0;
+        }
+
+        // Most frequent value of a block of values paired with their
+        // index in row order; ties are resolved by the lowest index.
+        template<typename T>
+        T
+        block_mode(std::vector<std::pair<T, dimension_size_type>>& values)
+        {
+          // Small blocks are counted directly.
+          if (values.size() <= 16U)
+            {
+              T best(values.front().first);
+              dimension_size_type bestcount = 0U;
+              for (dimension_size_type i = 0; i < values.size(); ++i)
+                {
+                  const T v(values[i].first);
+                  bool seen = false;
+                  for (dimension_size_type j = 0; j < i && !seen; ++j)
+                    seen = values[j].first == v;
+                  if (seen)
+                    continue;
+                  dimension_size_type count = 1U;
+                  for (dimension_size_type j = i + 1U; j < values.size(); ++j)
+                    if (values[j].first == v)
+                      ++count;
+                  if (count > bestcount)
+                    {
+                      best = v;
+                      bestcount = count;
+                    }
+                }
+              return best;
+            }
+
+          // Larger blocks are sorted by value and then index, so
+          // each run of equal values starts with its lowest index.
+          std::sort(values.begin(), values.end());
+          T best(values.front().first);
+          dimension_size_type bestcount = 0U;
+          dimension_size_type bestindex = values.front().second;
+          for (dimension_size_type start = 0; start < values.size();)
+            {
+              dimension_size_type end = start + 1U;
+              while (end < values.size() && values[end].first == values[start].first)
+                ++end;
+              const dimension_size_type count = end - start;
+              if (count > bestcount ||
+                  (count == bestcount && values[start].second < bestindex))
+                {
+                  best = values[start].first;
+                  bestcount = count;
+                  bestindex = values[start].second;
+                }
+              start = end;
+            }
+          return best;
+        }
+
+        template<typename T>
+        void
+        check_method(tiff::Downsampling method)
+        {
+          switch (method)
+            {
+            case tiff::DOWNSAMPLE_NEAREST:
+            case tiff::DOWNSAMPLE_MEAN:
+              break;
+            case tiff::DOWNSAMPLE_MODE:
+            case tiff::DOWNSAMPLE_OR:
+              if (!std::is_integral<T>::value)
+                throw std::logic_error("Mode and OR downsampling require integer or bit samples");
+              break;
+            default:
+              throw std::logic_error("Invalid downsampling method");
+            }
+        }
+
+        // Downsample whole 2×2 blocks of a single component with
+        // SIMD instructions, returning the number of destination
+        // values written.  Unspecialised types are not vectorised.
+        template<typename T>
+        dimension_size_type
+        simd_mean2(const T             * /* row0 */,
+                   const T             * /* row1 */,
+                   dimension_size_type   /* count */,
+                   T                   * /* dest */)
+        {
+          return 0U;
+        }
+
+#if defined(OME_FILES_DOWNSAMPLE_SSE2)
+
+        // Pairs are summed in 16-bit lanes, rounded and packed.
+        template<>
+        dimension_size_type
+        simd_mean2<uint8_t>(const uint8_t       *row0,
+                            const uint8_t       *row1,
+                            dimension_size_type  count,
+                            uint8_t             *dest)
+        {
+          const __m128i low = _mm_set1_epi16(0x00FF);
+          const __m128i round = _mm_set1_epi16(2);
+          dimension_size_type i = 0;
+          for (; i + 16U <= count; i += 16U)
+            {
+              __m128i sums[2];
+              for (int h = 0; h < 2; ++h)
+                {
+                  const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + (i * 2U) + (h * 16)));
+                  const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + (i * 2U) + (h * 16)));
+                  __m128i s = _mm_add_epi16(_mm_and_si128(a, low), _mm_srli_epi16(a, 8));
+                  s = _mm_add_epi16(s, _mm_add_epi16(_mm_and_si128(b, low), _mm_srli_epi16(b, 8)));
+                  sums[h] = _mm_srli_epi16(_mm_add_epi16(s, round), 2);
+                }
+              _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_packus_epi16(sums[0], sums[1]));
+            }
+          return i;
+        }
+
+        // Pairs are summed in 32-bit lanes, rounded and packed
+        // (offset to use signed saturation, which is exact here).
+        template<>
+        dimension_size_type
+        simd_mean2<uint16_t>(const uint16_t      *row0,
+                             const uint16_t      *row1,
+                             dimension_size_type  count,
+                             uint16_t            *dest)
+        {
+          const __m128i low = _mm_set1_epi32(0xFFFF);
+          const __m128i round = _mm_set1_epi32(2);
+          const __m128i offset = _mm_set1_epi32(0x8000);
+          const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+          dimension_size_type i = 0;
+          for (; i + 8U <= count; i += 8U)
+            {
+              __m128i sums[2];
+              for (int h = 0; h < 2; ++h)
+                {
+                  const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + (i * 2U) + (h * 8)));
+                  const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + (i * 2U) + (h * 8)));
+                  __m128i s = _mm_add_epi32(_mm_and_si128(a, low), _mm_srli_epi32(a, 16));
+                  s = _mm_add_epi32(s, _mm_add_epi32(_mm_and_si128(b, low), _mm_srli_epi32(b, 16)));
+                  sums[h] = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(s, round), 2), offset);
+                }
+              _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i),
+                               _mm_xor_si128(_mm_packs_epi32(sums[0], sums[1]), flip));
+            }
+          return i;
+        }
+
+        // Round the sums of 2×2 blocks to nearest, with halves away
+        // from zero, and divide by four, truncating (32-bit lanes).
+        inline __m128i
+        mean4_epi32(__m128i sum)
+        {
+          const __m128i sign = _mm_srai_epi32(sum, 31);
+          const __m128i two = _mm_set1_epi32(2);
+          const __m128i three = _mm_set1_epi32(3);
+          const __m128i t = _mm_add_epi32(sum, _mm_sub_epi32(_mm_xor_si128(two, sign), sign));
+          return _mm_srai_epi32(_mm_add_epi32(t, _mm_and_si128(sign, three)), 2);
+        }
+
+        // As mean4_epi32() (16-bit lanes).
+        inline __m128i
+        mean4_epi16(__m128i sum)
+        {
+          const __m128i sign = _mm_srai_epi16(sum, 15);
+          const __m128i two = _mm_set1_epi16(2);
+          const __m128i three = _mm_set1_epi16(3);
+          const __m128i t = _mm_add_epi16(sum, _mm_sub_epi16(_mm_xor_si128(two, sign), sign));
+          return _mm_srai_epi16(_mm_add_epi16(t, _mm_and_si128(sign, three)), 2);
+        }
+
+        // Pairs are sign extended and summed in 16-bit lanes,
+        // rounded and packed.
+        template<>
+        dimension_size_type
+        simd_mean2<int8_t>(const int8_t        *row0,
+                           const int8_t        *row1,
+                           dimension_size_type  count,
+                           int8_t              *dest)
+        {
+          dimension_size_type i = 0;
+          for (; i + 16U <= count; i += 16U)
+            {
+              __m128i sums[2];
+              for (int h = 0; h < 2; ++h)
+                {
+                  const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + (i * 2U) + (h * 16)));
+                  const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + (i * 2U) + (h * 16)));
+                  __m128i s = _mm_add_epi16(_mm_srai_epi16(_mm_slli_epi16(a, 8), 8), _mm_srai_epi16(a, 8));
+                  s = _mm_add_epi16(s, _mm_add_epi16(_mm_srai_epi16(_mm_slli_epi16(b, 8), 8), _mm_srai_epi16(b, 8)));
+                  sums[h] = mean4_epi16(s);
+                }
+              _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_packs_epi16(sums[0], sums[1]));
+            }
+          return i;
+        }
+
+        // Pairs are sign extended and summed in 32-bit lanes,
+        // rounded and packed.
+        template<>
+        dimension_size_type
+        simd_mean2<int16_t>(const int16_t       *row0,
+                            const int16_t       *row1,
+                            dimension_size_type  count,
+                            int16_t             *dest)
+        {
+          dimension_size_type i = 0;
+          for (; i + 8U <= count; i += 8U)
+            {
+              __m128i sums[2];
+              for (int h = 0; h < 2; ++h)
+                {
+                  const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + (i * 2U) + (h * 8)));
+                  const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + (i * 2U) + (h * 8)));
+                  __m128i s = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(a, 16));
+                  s = _mm_add_epi32(s, _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(b, 16), 16), _mm_srai_epi32(b, 16)));
+                  sums[h] = mean4_epi32(s);
+                }
+              _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_packs_epi32(sums[0], sums[1]));
+            }
+          return i;
+        }
+
+#elif defined(OME_FILES_DOWNSAMPLE_NEON)
+
+        // Pairs are deinterleaved on load, summed with widening and
+        // narrowed with rounding.
+        template<>
+        dimension_size_type
+        simd_mean2<uint8_t>(const uint8_t       *row0,
+                            const uint8_t       *row1,
+                            dimension_size_type  count,
+                            uint8_t             *dest)
+        {
+          dimension_size_type i = 0;
+          for (; i + 16U <= count; i += 16U)
+            {
+              const uint8x16x2_t a = vld2q_u8(row0 + (i * 2U));
+              const uint8x16x2_t b = vld2q_u8(row1 + (i * 2U));
+              uint16x8_t lo = vaddl_u8(vget_low_u8(a.val[0]), vget_low_u8(a.val[1]));
+              lo = vaddw_u8(lo, vget_low_u8(b.val[0]));
+              lo = vaddw_u8(lo, vget_low_u8(b.val[1]));
+              uint16x8_t hi = vaddl_u8(vget_high_u8(a.val[0]), vget_high_u8(a.val[1]));
+              hi = vaddw_u8(hi, vget_high_u8(b.val[0]));
+              hi = vaddw_u8(hi, vget_high_u8(b.val[1]));
+              vst1q_u8(dest + i, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+            }
+          return i;
+        }
+
+        template<>
+        dimension_size_type
+        simd_mean2<uint16_t>(const uint16_t      *row0,
+                             const uint16_t      *row1,
+                             dimension_size_type  count,
+                             uint16_t            *dest)
+        {
+          dimension_size_type i = 0;
+          for (; i + 8U <= count; i += 8U)
+            {
+              const uint16x8x2_t a = vld2q_u16(row0 + (i * 2U));
+              const uint16x8x2_t b = vld2q_u16(row1 + (i * 2U));
+              uint32x4_t lo = vaddl_u16(vget_low_u16(a.val[0]), vget_low_u16(a.val[1]));
+              lo = vaddw_u16(lo, vget_low_u16(b.val[0]));
+              lo = vaddw_u16(lo, vget_low_u16(b.val[1]));
+              uint32x4_t hi = vaddl_u16(vget_high_u16(a.val[0]), vget_high_u16(a.val[1]));
+              hi = vaddw_u16(hi, vget_high_u16(b.val[0]));
+              hi = vaddw_u16(hi, vget_high_u16(b.val[1]));
+              vst1q_u16(dest + i, vcombine_u16(vrshrn_n_u32(lo, 2), vrshrn_n_u32(hi, 2)));
+            }
+          return i;
+        }
+
+#endif
+
+        // No switch default to avoid -Wunreachable-code errors.
+        // However, this then makes -Wswitch-default complain.  Disable
+        // temporarily.
+#ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+
+        // Downsample blocks of any size, from destination pixel
+        // first to the end of the row.
+        template<typename T>
+        void
+        downsample_blocks(const T             *src,
+                          std::ptrdiff_t       stride,
+                          dimension_size_type  rows,
+                          dimension_size_type  width,
+                          dimension_size_type  components,
+                          dimension_size_type  factor,
+                          tiff::Downsampling   method,
+                          dimension_size_type  first,
+                          T                   *dest)
+        {
+          typedef typename DownsampleSum<T>::type sum_type;
+
+          std::vector<std::pair<T, dimension_size_type>> block;
+          const dimension_size_type outwidth = (width + factor - 1U) / factor;
+          for (dimension_size_type x = first; x < outwidth; ++x)
+            {
+              const dimension_size_type sx = x * factor;
+              const dimension_size_type sw = std::min(factor, width - sx);
+
+              for (dimension_size_type c = 0; c < components; ++c)
+                {
+                  const T *in = src + (sx * components) + c;
+                  T& out = dest[(x * components) + c];
+
+                  switch (method)
+                    {
+                    case tiff::DOWNSAMPLE_NEAREST:
+                      out = *in;
+                      break;
+                    case tiff::DOWNSAMPLE_MEAN:
+                      {
+                        sum_type sum = 0;
+                        for (dimension_size_type j = 0; j < rows; ++j)
+                          for (dimension_size_type i = 0; i < sw; ++i)
+                            sum += in[(static_cast<std::ptrdiff_t>(j) * stride) + static_cast<std::ptrdiff_t>(i * components)];
+                        out = block_mean<T>(sum, static_cast<int64_t>(rows * sw));
+                      }
+                      break;
+                    case tiff::DOWNSAMPLE_MODE:
+                      block.clear();
+                      for (dimension_size_type j = 0; j < rows; ++j)
+                        for (dimension_size_type i = 0; i < sw; ++i)
+                          block.push_back(std::make_pair(in[(static_cast<std::ptrdiff_t>(j) * stride) + static_cast<std::ptrdiff_t>(i * components)],
+                                                         block.size()));
+                      out = block_mode(block);
+                      break;
+                    case tiff::DOWNSAMPLE_OR:
+                      {
+                        T value = *in;
+                        for (dimension_size_type j = 0; j < rows; ++j)
+                          for (dimension_size_type i = 0; i < sw; ++i)
+                            value = sample_or(value, in[(static_cast<std::ptrdiff_t>(j) * stride) + static_cast<std::ptrdiff_t>(i * components)]);
+                        out = value;
+                      }
+                      break;
+                    }
+                }
+            }
+        }
+
+        // Reduce whole 2×2 blocks from destination pixel first with a
+        // function of the four values in row order.  Single component
+        // pixels have a separate loop, which the compiler may
+        // vectorise.
+        template<typename T, typename F>
+        void
+        reduce_blocks2(const T             *row0,
+                       const T             *row1,
+                       dimension_size_type  first,
+                       dimension_size_type  count,
+                       dimension_size_type  components,
+                       T                   *dest,
+                       F                    reduce)
+        {
+          if (components == 1U)
+            {
+              for (dimension_size_type i = first; i < count; ++i)
+                dest[i] = reduce(row0[i * 2U], row0[(i * 2U) + 1U], row1[i * 2U], row1[(i * 2U) + 1U]);
+              return;
+            }
+
+          for (dimension_size_type x = first; x < count; ++x)
+            {
+              const T *a = row0 + (x * components * 2U);
+              const T *b = row1 + (x * components * 2U);
+              T *out = dest + (x * components);
+              for (dimension_size_type c = 0; c < components; ++c)
+                out[c] = reduce(a[c], a[c + components], b[c], b[c + components]);
+            }
+        }
+
+        // Downsample whole 2×2 blocks, returning the number of
+        // destination pixels written.  The method is selected outside
+        // the loops.
+        template<typename T>
+        dimension_size_type
+        downsample_blocks2(const T             *row0,
+                           const T             *row1,
+                           dimension_size_type  count,
+                           dimension_size_type  components,
+                           tiff::Downsampling   method,
+                           T                   *dest)
+        {
+          typedef typename DownsampleSum2<T>::type sum_type;
+
+          switch (method)
+            {
+            case tiff::DOWNSAMPLE_NEAREST:
+              reduce_blocks2(row0, row1, 0U, count, components, dest,
+                             [](T a0, T /* a1 */, T /* b0 */, T /* b1 */) { return a0; });
+              break;
+            case tiff::DOWNSAMPLE_MEAN:
+              reduce_blocks2(row0, row1,
+                             components == 1U ? simd_mean2(row0, row1, count, dest) : 0U,
+                             count, components, dest,
+                             [](T a0, T a1, T b0, T b1)
+                             {
+                               sum_type sum = 0;
+                               sum += a0;
+                               sum += a1;
+                               sum += b0;
+                               sum += b1;
+                               return block_mean<T>(sum, static_cast<sum_type>(4));
+                             });
+              break;
+            case tiff::DOWNSAMPLE_MODE:
+              reduce_blocks2(row0, row1, 0U, count, components, dest,
+                             [](T a0, T a1, T b0, T b1) { return mode4(a0, a1, b0, b1); });
+              break;
+            case tiff::DOWNSAMPLE_OR:
+              reduce_blocks2(row0, row1, 0U, count, components, dest,
+                             [](T a0, T a1, T b0, T b1) { return sample_or(sample_or(a0, a1), sample_or(b0, b1)); });
+              break;
+            }
+          return count;
+        }
+
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+
+      }
+
+      template<typename T>
+      void
+      downsampleRow(const T             *src,
+                    std::ptrdiff_t       stride,
+                    dimension_size_type  rows,
+                    dimension_size_type  width,
+                    dimension_size_type  components,
+                    dimension_size_type  factor,
+                    tiff::Downsampling   method,
+                    T                   *dest)
+      {
+        check_method<T>(method);
+        if (!factor)
+          throw std::logic_error("Downsampling factor must be nonzero");
+        if (!rows || rows > factor)
+          {
+            boost::format fmt("Invalid number of rows to downsample: %1% (factor %2%)");
+            fmt % rows % factor;
+            throw std::logic_error(fmt.str());
+          }
+
+        dimension_size_type first = 0U;
+        if (factor == 2U && rows == 2U)
+          first = downsample_blocks2(src, src + stride, width / 2U, components, method, dest);
+
+        downsample_blocks(src, stride, rows, width, components, factor, method, first, dest);
+      }
+
+      // Instantiated for the sample type of each pixel type; complex
+      // samples are downsampled as pairs of real components.
+      template void downsampleRow<bool>(const bool *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                        dimension_size_type, dimension_size_type, tiff::Downsampling, bool *);
+      template void downsampleRow<int8_t>(const int8_t *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                          dimension_size_type, dimension_size_type, tiff::Downsampling, int8_t *);
+      template void downsampleRow<int16_t>(const int16_t *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                           dimension_size_type, dimension_size_type, tiff::Downsampling, int16_t *);
+      template void downsampleRow<int32_t>(const int32_t *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                           dimension_size_type, dimension_size_type, tiff::Downsampling, int32_t *);
+      template void downsampleRow<uint8_t>(const uint8_t *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                           dimension_size_type, dimension_size_type, tiff::Downsampling, uint8_t *);
+      template void downsampleRow<uint16_t>(const uint16_t *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                            dimension_size_type, dimension_size_type, tiff::Downsampling, uint16_t *);
+      template void downsampleRow<uint32_t>(const uint32_t *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                            dimension_size_type, dimension_size_type, tiff::Downsampling, uint32_t *);
+      template void downsampleRow<float>(const float *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                         dimension_size_type, dimension_size_type, tiff::Downsampling, float *);
+      template void downsampleRow<double>(const double *, std::ptrdiff_t, dimension_size_type, dimension_size_type,
+                                          dimension_size_type, dimension_size_type, tiff::Downsampling, double *);
+
+    }
+  }
+}
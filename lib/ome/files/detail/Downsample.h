@@ -0,0 +1,113 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_DOWNSAMPLE_H
+#define OME_FILES_DETAIL_DOWNSAMPLE_H
+
+#include <cstddef>
+
+#include <ome/files/Types.h>
+#include <ome/files/tiff/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Downsample a row of pixel blocks.
+       *
+       * Each destination pixel is reduced from a block of up to
+       * @p factor × @p factor source pixels, starting at the
+       * top-left of the source rows.  The @p width source pixels
+       * are reduced to <tt>(width + factor - 1) / factor</tt>
+       * destination pixels.  Blocks at the right edge are narrower
+       * if @p width is not a multiple of @p factor, and all blocks
+       * are shorter if @p rows is less than @p factor (at the
+       * bottom edge).  Each pixel is @p components contiguous
+       * values, which are downsampled separately.
+       *
+       * The mean of integer samples is rounded to nearest, and of
+       * bit samples is the majority value, rounding up.  The mode
+       * is the most frequent value, with ties resolved by the first
+       * value in row order.  The mode and bitwise OR are only
+       * defined for integer and bit (@c bool) samples.
+       *
+       * Blocks of 2×2 are specialised, and the mean of single
+       * component 8- and 16-bit integer samples uses SIMD
+       * instructions where available (SSE2 for signed and unsigned
+       * samples, and NEON for unsigned samples), with results
+       * identical to the scalar implementation.  The data need not
+       * be aligned.
+       *
+       * @param src the first source row.
+       * @param stride the distance between source rows, in values.
+       * @param rows the number of source rows (@c 1 to @p factor).
+       * @param width the source row width, in pixels.
+       * @param components the number of values per pixel.
+       * @param factor the downsampling factor.
+       * @param method the downsampling method.
+       * @param dest the destination row.
+       * @throws std::logic_error if the factor or number of rows
+       * is invalid, or the method is not defined for the sample
+       * type.
+       */
+      template<typename T>
+      void
+      downsampleRow(const T             *src,
+                    std::ptrdiff_t       stride,
+                    dimension_size_type  rows,
+                    dimension_size_type  width,
+                    dimension_size_type  components,
+                    dimension_size_type  factor,
+                    tiff::Downsampling   method,
+                    T                   *dest);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_DOWNSAMPLE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
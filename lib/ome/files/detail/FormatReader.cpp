@@ -35,8 +35,14 @@
  * #L%
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <fstream>
+#include <future>
+#include <map>
+#include <tuple>
+#include <typeinfo>
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
@@ -47,13 +53,25 @@
 
 #include <ome/compat/regex.h>
 
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/FormatException.h>
 #include <ome/files/FormatTools.h>
+#include <ome/files/MemoryBudget.h>
 #include <ome/files/MetadataTools.h>
 #include <ome/files/PixelBuffer.h>
 #include <ome/files/PixelProperties.h>
+#include <ome/files/PixelStatistics.h>
+#include <ome/files/ReadCancelledException.h>
 #include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
+#include <ome/files/detail/ByteSwap.h>
 #include <ome/files/detail/FormatReader.h>
+#include <ome/files/detail/Memo.h>
+#include <ome/files/detail/Normalize.h>
+#include <ome/files/detail/PlaneStack.h>
 
+#include <ome/xml/meta/Convert.h>
 #include <ome/xml/meta/DummyMetadata.h>
 #include <ome/xml/meta/FilterMetadata.h>
 #include <ome/xml/meta/MetadataStore.h>
@@ -63,6 +81,7 @@ using boost::filesystem::path;
 using ome::xml::meta::DummyMetadata;
 using ome::xml::meta::FilterMetadata;
 using ome::files::CoreMetadata;
+using ome::xml::model::enums::PixelType;
 
 namespace ome
 {
@@ -75,8 +94,226 @@ namespace ome
       {
         // Default thumbnail width and height.
         const dimension_size_type THUMBNAIL_DIMENSION = 128;
+
+        // Copy every xstep-th column and ystep-th row of a plane.
+        struct DecimateVisitor
+        {
+          VariantPixelBuffer& dest;
+          dimension_size_type xstep;
+          dimension_size_type ystep;
+
+          DecimateVisitor(VariantPixelBuffer& dest,
+                          dimension_size_type xstep,
+                          dimension_size_type ystep):
+            dest(dest),
+            xstep(xstep),
+            ystep(ystep)
+          {}
+
+          template<typename T>
+          void
+          operator()(const std::shared_ptr<T>& src)
+          {
+            std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+            std::copy(src->shape(), src->shape() + PixelBufferBase::dimensions, shape.begin());
+            const dimension_size_type samples = shape[DIM_SUBCHANNEL];
+            shape[DIM_SPATIAL_X] = (shape[DIM_SPATIAL_X] + xstep - 1U) / xstep;
+            shape[DIM_SPATIAL_Y] = (shape[DIM_SPATIAL_Y] + ystep - 1U) / ystep;
+
+            dest.setBuffer(shape, src->pixelType(), src->storage_order());
+            std::shared_ptr<T>& buf(ome::compat::get<std::shared_ptr<T>>(dest.vbuffer()));
+
+            for (dimension_size_type y = 0; y < shape[DIM_SPATIAL_Y]; ++y)
+              {
+                const auto srow = src->row(static_cast<PixelBufferBase::index>(y * ystep));
+                const auto drow = buf->row(static_cast<PixelBufferBase::index>(y));
+                const PixelBufferBase::index sxstride = srow.xstride * static_cast<PixelBufferBase::index>(xstep);
+
+                for (dimension_size_type s = 0; s < samples; ++s)
+                  {
+                    const typename T::value_type *sp = srow.data + (static_cast<PixelBufferBase::index>(s) * srow.sstride);
+                    typename T::value_type *dp = drow.data + (static_cast<PixelBufferBase::index>(s) * drow.sstride);
+                    for (dimension_size_type x = 0; x < shape[DIM_SPATIAL_X]; ++x, sp += sxstride, dp += drow.xstride)
+                      *dp = *sp;
+                  }
+              }
+          }
+        };
+
+        // Scale floating point pixel values from the range of the
+        // pixel type to [0, 1].  NaN is preserved, and values
+        // outside the range are clamped.
+        struct NormalizeVisitor
+        {
+          template<typename T>
+          void
+          operator()(const std::shared_ptr<T>& /* buffer */)
+          {
+            // Only floating point data is normalized.
+          }
+
+          void
+          operator()(const std::shared_ptr<PixelBuffer<PixelProperties<PixelType::FLOAT>::std_type>>& buffer)
+          {
+            normalize(*buffer, PixelType::FLOAT);
+          }
+
+          void
+          operator()(const std::shared_ptr<PixelBuffer<PixelProperties<PixelType::DOUBLE>::std_type>>& buffer)
+          {
+            normalize(*buffer, PixelType::DOUBLE);
+          }
+
+          template<typename V>
+          static void
+          normalize(PixelBuffer<V>& buffer,
+                    PixelType       type)
+          {
+            const PixelStatistics range(type, 1U);
+            normalizeSamples(buffer.data(), buffer.num_elements(),
+                             static_cast<V>(range.getRangeMin()),
+                             static_cast<V>(1.0 / (range.getRangeMax() - range.getRangeMin())));
+          }
+        };
+
+        // Fill the thumbnail pixels sampled from a decimated band of
+        // plane rows.  Thumbnail pixel (x, y) is taken from plane
+        // pixel (x × sizeX ÷ thumbX, y × sizeY ÷ thumbY), rounded
+        // down to the nearest decimated column and row.
+        struct ThumbnailVisitor
+        {
+          VariantPixelBuffer& dest;
+          dimension_size_type sizeX;
+          dimension_size_type sizeY;
+          dimension_size_type xstep;
+          dimension_size_type ystep;
+          dimension_size_type bandY;
+
+          ThumbnailVisitor(VariantPixelBuffer& dest,
+                           dimension_size_type sizeX,
+                           dimension_size_type sizeY,
+                           dimension_size_type xstep,
+                           dimension_size_type ystep,
+                           dimension_size_type bandY):
+            dest(dest),
+            sizeX(sizeX),
+            sizeY(sizeY),
+            xstep(xstep),
+            ystep(ystep),
+            bandY(bandY)
+          {}
+
+          template<typename T>
+          void
+          operator()(const std::shared_ptr<T>& band)
+          {
+            const VariantPixelBuffer::size_type *bshape = band->shape();
+            const VariantPixelBuffer::size_type *tshape = dest.shape();
+            const dimension_size_type thumbX = tshape[DIM_SPATIAL_X];
+            const dimension_size_type thumbY = tshape[DIM_SPATIAL_Y];
+            const dimension_size_type samples = bshape[DIM_SUBCHANNEL];
+            const dimension_size_type firstRow = bandY / ystep;
+
+            std::shared_ptr<T>& thumb(ome::compat::get<std::shared_ptr<T>>(dest.vbuffer()));
+
+            for (dimension_size_type y = 0; y < thumbY; ++y)
+              {
+                const dimension_size_type row = ((y * sizeY) / thumbY) / ystep;
+                if (row < firstRow || row >= firstRow + bshape[DIM_SPATIAL_Y])
+                  continue;
+
+                const auto srow = band->row(static_cast<PixelBufferBase::index>(row - firstRow));
+                const auto drow = thumb->row(static_cast<PixelBufferBase::index>(y));
+
+                for (dimension_size_type x = 0; x < thumbX; ++x)
+                  {
+                    const PixelBufferBase::index sx = static_cast<PixelBufferBase::index>(((x * sizeX) / thumbX) / xstep);
+                    const typename T::value_type *sp = srow.data + (sx * srow.xstride);
+                    typename T::value_type *dp = drow.data + (static_cast<PixelBufferBase::index>(x) * drow.xstride);
+                    for (dimension_size_type s = 0; s < samples; ++s)
+                      dp[static_cast<PixelBufferBase::index>(s) * drow.sstride] =
+                        sp[static_cast<PixelBufferBase::index>(s) * srow.sstride];
+                  }
+              }
+          }
+        };
       }
 
+      /**
+       * A plane prefetched by a task on the executor.
+       *
+       * The task is run by whichever of the executor and the reader
+       * claims it first, so that the reader never waits for a task
+       * which has not started (and might not start while the
+       * executor is busy), and a discarded task which has not
+       * started is never run.
+       */
+      class FormatReader::PrefetchTask
+      {
+      public:
+        /// Result type.
+        typedef std::shared_ptr<VariantPixelBuffer> result_type;
+
+        /**
+         * Constructor.
+         *
+         * @param read the function to read the plane.
+         * @param reservation the memory reserved for the plane.
+         */
+        PrefetchTask(std::function<result_type ()> read,
+                     MemoryBudget::Reservation&&   reservation):
+          task(std::move(read)),
+          result(task.get_future()),
+          claimed(false),
+          reservation(std::move(reservation))
+        {
+        }
+
+        /// Run the task, unless already claimed.
+        void
+        run()
+        {
+          if (!claimed.exchange(true))
+            task();
+        }
+
+        /**
+         * Get the plane, running the task if not yet started.
+         *
+         * @returns the plane.
+         * @throws the exception thrown by the task, if any.
+         */
+        result_type
+        get()
+        {
+          run();
+          return result.get();
+        }
+
+        /**
+         * Discard the plane.
+         *
+         * The task will not be started, or if already started, is
+         * waited for; any exception it threw is discarded.
+         */
+        void
+        discard()
+        {
+          if (claimed.exchange(true) && result.valid())
+            result.wait();
+        }
+
+      private:
+        /// Task reading the plane.
+        std::packaged_task<result_type ()> task;
+        /// Result of the task.
+        std::future<result_type> result;
+        /// The task has been run or discarded.
+        std::atomic<bool> claimed;
+        /// Memory reserved for the plane, until consumed or discarded.
+        MemoryBudget::Reservation reservation;
+      };
+
       FormatReader::FormatReader(const ReaderProperties& readerProperties):
         readerProperties(readerProperties),
         currentId(boost::none),
@@ -93,19 +330,31 @@ namespace ome
         companionFiles(false),
         datasetDescription("Single file"),
         normalizeData(false),
+        decodeThreads(1U),
+        executor(),
+        prefetchPlanes(0U),
+        prefetched(),
+        prefetchMutex(),
+        thumbnails(),
         filterMetadata(false),
         saveOriginalMetadata(false),
+        lazyOriginalMetadata(false),
+        originalMetadataPending(false),
+        originalMetadataMutex(),
         indexedAsRGB(false),
+        expandIndexed(false),
         group(true),
         domains(),
         metadataStore(std::make_shared<DummyMetadata>()),
-        metadataOptions()
+        metadataOptions(),
+        ioStatistics(std::make_shared<IOStatistics>())
       {
         assertId(currentId, false);
       }
 
       FormatReader::~FormatReader()
       {
+        clearPrefetch();
       }
 
       const std::string&
@@ -132,6 +381,12 @@ namespace ome
         return readerProperties.compression_suffixes;
       }
 
+      std::shared_ptr<IOStatistics>
+      FormatReader::getIOStatistics() const
+      {
+        return ioStatistics;
+      }
+
       const std::set<MetadataOptions::MetadataLevel>&
       FormatReader::getSupportedMetadataLevels()
       {
@@ -161,6 +416,236 @@ namespace ome
         getMetadataStore()->createRoot();
       }
 
+      void
+      FormatReader::readOriginalMetadata() const
+      {
+      }
+
+      bool
+      FormatReader::isMemoizable() const
+      {
+        return false;
+      }
+
+      void
+      FormatReader::saveMemo(MemoWriter& memo) const
+      {
+        assertId(currentId, true);
+
+        if (!isMemoizable())
+          {
+            boost::format fmt("%1% reader state can not be saved");
+            fmt % getFormat();
+            throw FormatException(fmt.str());
+          }
+
+        loadOriginalMetadata();
+
+        // Reader settings affecting initFile().
+        memo.writeString(getFormat());
+        memo.writeBool(flattenedResolutions);
+        memo.writeBool(group);
+        memo.writeBool(expandIndexed);
+        memo.writeBool(indexedAsRGB);
+        memo.writeBool(filterMetadata);
+        memo.writeBool(saveOriginalMetadata);
+        memo.writeUInt(static_cast<uint64_t>(metadataOptions.getMetadataLevel()));
+
+        memo.writeString(currentId->string());
+        memo.writeUInt(core.size());
+        for (const auto& c : core)
+          memo.writeCoreMetadata(*c);
+        memo.writeMetadataMap(metadata);
+
+        // OME-XML metadata are saved as binary OME-XML, which is
+        // restored without parsing or validation.
+        std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> store =
+          std::dynamic_pointer_cast<::ome::xml::meta::OMEXMLMetadata>(metadataStore);
+        memo.writeBool(static_cast<bool>(store));
+        if (store)
+          memo.writeString(getBinaryOMEXML(*store));
+
+        saveMemoState(memo);
+      }
+
+      bool
+      FormatReader::restoreMemo(MemoReader& memo)
+      {
+        close();
+
+        try
+          {
+            if (memo.readString() != getFormat() ||
+                memo.readBool() != flattenedResolutions ||
+                memo.readBool() != group ||
+                memo.readBool() != expandIndexed ||
+                memo.readBool() != indexedAsRGB ||
+                memo.readBool() != filterMetadata ||
+                memo.readBool() != saveOriginalMetadata ||
+                memo.readUInt() != static_cast<uint64_t>(metadataOptions.getMetadataLevel()))
+              return false;
+
+            currentId = path(memo.readString());
+            const uint64_t count = memo.readCount();
+            for (uint64_t i = 0; i < count; ++i)
+              {
+                std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+                memo.readCoreMetadata(*c);
+                core.push_back(c);
+              }
+            if (core.empty())
+              throw FormatException("Invalid memo core metadata count");
+            metadata.clear();
+            memo.readMetadataMap(metadata);
+
+            getMetadataStore()->createRoot();
+            const bool hasStore = memo.readBool();
+            if (hasStore)
+              {
+                std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(createOMEXMLMetadataFromBinary(memo.readString()));
+                ::ome::xml::meta::convert(*meta, *getMetadataStore());
+              }
+            else if (std::dynamic_pointer_cast<::ome::xml::meta::OMEXMLMetadata>(metadataStore))
+              {
+                // Saved without OME-XML metadata.
+                close();
+                return false;
+              }
+
+            if (!restoreMemoState(memo))
+              {
+                close();
+                return false;
+              }
+          }
+        catch (...)
+          {
+            close();
+            throw;
+          }
+
+        shareCoreMetadata();
+        setSeries(0);
+
+        return true;
+      }
+
+      void
+      FormatReader::saveMemoState(MemoWriter& /* memo */) const
+      {
+      }
+
+      bool
+      FormatReader::restoreMemoState(MemoReader& /* memo */)
+      {
+        return true;
+      }
+
+      void
+      FormatReader::loadOriginalMetadata() const
+      {
+        std::lock_guard<std::mutex> lock(originalMetadataMutex);
+        if (originalMetadataPending)
+          {
+            // Series metadata is read separately for each series.
+            unshareCoreMetadata();
+            readOriginalMetadata();
+            if (saveOriginalMetadata)
+              populateOriginalMetadata();
+            originalMetadataPending = false;
+          }
+      }
+
+      void
+      FormatReader::shareCoreMetadata()
+      {
+        typedef std::tuple<dimension_size_type,
+                           dimension_size_type,
+                           dimension_size_type,
+                           dimension_size_type,
+                           dimension_size_type,
+                           dimension_size_type> share_key;
+        std::map<share_key, std::vector<coremetadata_list_type::value_type>> shared;
+
+        for (auto& cm : core)
+          {
+            if (!cm || typeid(*cm) != typeid(CoreMetadata))
+              continue;
+
+            share_key key(cm->sizeX, cm->sizeY, cm->sizeZ, cm->sizeT,
+                          cm->imageCount, cm->seriesMetadata.size());
+            std::vector<coremetadata_list_type::value_type>& candidates(shared[key]);
+
+            bool found = false;
+            for (const auto& candidate : candidates)
+              {
+                if (*candidate == *cm)
+                  {
+                    cm = candidate;
+                    found = true;
+                    break;
+                  }
+              }
+            if (!found)
+              candidates.push_back(cm);
+          }
+      }
+
+      void
+      FormatReader::unshareCoreMetadata(dimension_size_type index) const
+      {
+        coremetadata_list_type::value_type& cm(core.at(index));
+        // Only entries of type CoreMetadata are shared, and may be
+        // copied without slicing.
+        if (cm && cm.use_count() > 1 && typeid(*cm) == typeid(CoreMetadata))
+          cm = std::make_shared<CoreMetadata>(*cm);
+      }
+
+      void
+      FormatReader::unshareCoreMetadata() const
+      {
+        for (dimension_size_type i = 0; i < core.size(); ++i)
+          unshareCoreMetadata(i);
+      }
+
+      void
+      FormatReader::populateOriginalMetadata() const
+      {
+        const std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>& store =
+          std::dynamic_pointer_cast<::ome::xml::meta::OMEXMLMetadata>(metadataStore);
+        if (!store)
+          return;
+
+        MetadataMap allMetadata(metadata);
+
+        for (dimension_size_type series = 0;
+             series < getSeriesCount();
+             ++series)
+          {
+            boost::format fmt("Series %1%");
+            fmt % series;
+            std::string name(fmt.str());
+
+            try
+              {
+                std::string imageName = store->getImageName(series);
+                if (!imageName.empty() && ome::common::trim(imageName).size() != 0)
+                  name = imageName;
+              }
+            catch (const std::exception&)
+              {
+              }
+
+            const MetadataMap& sm(getCoreMetadata(seriesToCoreIndex(series)).seriesMetadata);
+            for (MetadataMap::const_iterator i = sm.begin();
+                 i != sm.end();
+                 ++i)
+              allMetadata.set(name + " " + i->first, i->second);
+          }
+
+        fillOriginalMetadata(*store, allMetadata);
+      }
+
       bool
       FormatReader::isUsedFile(const boost::filesystem::path& file)
       {
@@ -210,6 +695,24 @@ namespace ome
       namespace
       {
 
+        // If the endianness of the data doesn't match the endianness
+        // of the machine, byteswap the buffer.
+        template<typename T>
+        void
+        swapToNative(const FormatReader& reader,
+                     T&                  v)
+        {
+          EndianType endian = reader.isLittleEndian() ? ENDIAN_LITTLE : ENDIAN_BIG;
+
+          if ((endian == ome::files::ENDIAN_BIG &&
+               boost::endian::order::big != boost::endian::order::native) ||
+              (endian == ome::files::ENDIAN_LITTLE &&
+               boost::endian::order::little != boost::endian::order::native))
+            {
+              detail::byteswap(v->data(), v->num_elements());
+            }
+        }
+
         struct PlaneVisitor
         {
           std::istream&       source;
@@ -243,8 +746,6 @@ namespace ome
           void
           operator()(T& v)
           {
-            EndianType endian = reader.isLittleEndian() ? ENDIAN_LITTLE : ENDIAN_BIG;
-
             const uint32_t bpp(bytesPerPixel(reader.getPixelType()));
             const dimension_size_type sizeX(reader.getSizeX());
             const dimension_size_type sizeY(reader.getSizeY());
@@ -325,32 +826,111 @@ namespace ome
             if (!source)
               throw std::runtime_error("readPlane: Error reading bytes from stream");
 
-            // If the endianness of the data doesn't match the
-            // endianness of the machine, byteswap the buffer.
-            if ((endian == ome::files::ENDIAN_BIG &&
-                 boost::endian::order::big != boost::endian::order::native) ||
-                (endian == ome::files::ENDIAN_LITTLE &&
-                 boost::endian::order::little != boost::endian::order::native))
+            swapToNative(reader, v);
+          }
+        };
+
+        struct MemoryPlaneVisitor
+        {
+          const uint8_t       *source;
+          dimension_size_type  size;
+          FormatReader&        reader;
+          dimension_size_type  x;
+          dimension_size_type  y;
+          dimension_size_type  w;
+          dimension_size_type  h;
+          dimension_size_type  samples;
+          dimension_size_type  scanlinePad;
+
+          MemoryPlaneVisitor(const uint8_t       *source,
+                             dimension_size_type  size,
+                             FormatReader&        reader,
+                             dimension_size_type  x,
+                             dimension_size_type  y,
+                             dimension_size_type  w,
+                             dimension_size_type  h,
+                             dimension_size_type  samples,
+                             dimension_size_type  scanlinePad):
+            source(source),
+            size(size),
+            reader(reader),
+            x(x),
+            y(y),
+            w(w),
+            h(h),
+            samples(samples),
+            scanlinePad(scanlinePad)
+          {}
+
+          // Copy h rows of copyBytes, rowBytes apart, starting at
+          // offset, into dest.
+          void
+          copyRows(uint8_t             *dest,
+                   dimension_size_type  offset,
+                   dimension_size_type  rowBytes,
+                   dimension_size_type  copyBytes) const
+          {
+            if (!h || !copyBytes)
+              return;
+
+            if (offset + ((h - 1) * rowBytes) + copyBytes > size)
+              throw std::runtime_error("readPlane: Source too small for plane");
+
+            if (copyBytes == rowBytes)
+              {
+                // Contiguous rows.
+                std::copy(source + offset, source + offset + (h * rowBytes), dest);
+              }
+            else
+              {
+                for (dimension_size_type row = 0; row < h; ++row)
+                  {
+                    const uint8_t *src = source + offset + (row * rowBytes);
+                    std::copy(src, src + copyBytes, dest + (row * copyBytes));
+                  }
+              }
+          }
+
+          template<typename T>
+          void
+          operator()(T& v)
+          {
+            const uint32_t bpp(bytesPerPixel(reader.getPixelType()));
+            const dimension_size_type sizeY(reader.getSizeY());
+            const dimension_size_type scanlineWidth(reader.getSizeX() + scanlinePad);
+            const bool interleaved(reader.isInterleaved());
+
+            uint8_t *dest = reinterpret_cast<uint8_t *>(v->data());
+
+            if (interleaved)
+              {
+                const dimension_size_type pixelBytes = bpp * samples;
+                copyRows(dest,
+                         ((y * scanlineWidth) + x) * pixelBytes,
+                         scanlineWidth * pixelBytes,
+                         w * pixelBytes);
+              }
+            else
               {
-                typename T::element_type::value_type *data = v->data();
-                typename T::element_type::size_type num_elements = v->num_elements();
-                for (typename T::element_type::size_type i = 0; i < num_elements; ++i)
-                  byteswap(data[i]);
+                const dimension_size_type planeBytes = scanlineWidth * sizeY * bpp;
+                for (dimension_size_type sample = 0; sample < samples; ++sample)
+                  copyRows(dest + (sample * w * h * bpp),
+                           (sample * planeBytes) + (((y * scanlineWidth) + x) * bpp),
+                           scanlineWidth * bpp,
+                           w * bpp);
               }
+
+            swapToNative(reader, v);
           }
         };
 
       }
 
       void
-      FormatReader::readPlane(std::istream&       source,
-                              VariantPixelBuffer& dest,
-                              dimension_size_type x,
-                              dimension_size_type y,
-                              dimension_size_type w,
-                              dimension_size_type h,
-                              dimension_size_type scanlinePad,
-                              dimension_size_type samples)
+      FormatReader::preparePlane(VariantPixelBuffer& dest,
+                                 dimension_size_type w,
+                                 dimension_size_type h,
+                                 dimension_size_type samples) const
       {
         std::array<VariantPixelBuffer::size_type, 9> shape, dest_shape;
         shape[DIM_SPATIAL_X] = w;
@@ -374,7 +954,20 @@ namespace ome
         if (type != dest.pixelType() ||
             !(storage_order == dest.storage_order()) ||
             shape != dest_shape)
-          dest.setBuffer(shape, type, storage_order);
+          dest.setBuffer(shape, type, storage_order, dest.allocator());
+      }
+
+      void
+      FormatReader::readPlane(std::istream&       source,
+                              VariantPixelBuffer& dest,
+                              dimension_size_type x,
+                              dimension_size_type y,
+                              dimension_size_type w,
+                              dimension_size_type h,
+                              dimension_size_type scanlinePad,
+                              dimension_size_type samples)
+      {
+        preparePlane(dest, w, h, samples);
 
         // Fill the buffer according to its type.
         PlaneVisitor v(source, *this,
@@ -382,6 +975,38 @@ namespace ome
         ome::compat::visit(v, dest.vbuffer());
       }
 
+      void
+      FormatReader::readPlane(const uint8_t       *source,
+                              dimension_size_type  size,
+                              VariantPixelBuffer&  dest,
+                              dimension_size_type  x,
+                              dimension_size_type  y,
+                              dimension_size_type  w,
+                              dimension_size_type  h,
+                              dimension_size_type  samples)
+      {
+        return readPlane(source, size, dest, x, y, w, h, 0, samples);
+      }
+
+      void
+      FormatReader::readPlane(const uint8_t       *source,
+                              dimension_size_type  size,
+                              VariantPixelBuffer&  dest,
+                              dimension_size_type  x,
+                              dimension_size_type  y,
+                              dimension_size_type  w,
+                              dimension_size_type  h,
+                              dimension_size_type  scanlinePad,
+                              dimension_size_type  samples)
+      {
+        preparePlane(dest, w, h, samples);
+
+        // Fill the buffer according to its type.
+        MemoryPlaneVisitor v(source, size, *this,
+                             x, y, w, h, samples, scanlinePad);
+        ome::compat::visit(v, dest.vbuffer());
+      }
+
       std::shared_ptr<::ome::xml::meta::MetadataStore>
       FormatReader::makeFilterMetadata()
       {
@@ -740,24 +1365,493 @@ namespace ome
                               dimension_size_type h) const
       {
         setPlane(plane);
-        openBytesImpl(plane, buf, x, y, w, h);
+
+        const CancellationToken *cancel(CancellationToken::current());
+        if (cancel)
+          cancel->check();
+
+        if (!prefetchPlanes)
+          {
+            openBytesImpl(plane, buf, x, y, w, h);
+            normalize(buf);
+            return;
+          }
+
+        const dimension_size_type core = getCoreIndex();
+        const prefetch_key key{{core, plane, x, y, w, h}};
+
+        // Discard prefetched planes which are not in the window
+        // following this plane.
+        for (auto i = prefetched.begin(); i != prefetched.end();)
+          {
+            const prefetch_key& k(i->first);
+            if (std::tie(k[0], k[2], k[3], k[4], k[5]) != std::tie(core, x, y, w, h) ||
+                k[1] < plane || k[1] > plane + prefetchPlanes)
+              {
+                i->second->discard();
+                prefetched.erase(i++);
+              }
+            else
+              ++i;
+          }
+
+        std::shared_ptr<VariantPixelBuffer> pixels;
+        auto found = prefetched.find(key);
+        if (found != prefetched.end())
+          {
+            std::shared_ptr<PrefetchTask> task(found->second);
+            prefetched.erase(found);
+
+            try
+              {
+                pixels = task->get();
+              }
+            catch (const ReadCancelledException&)
+              {
+                // Cancelled by the token of an earlier read; read
+                // again below using the token of this read.
+              }
+          }
+
+        if (pixels)
+          {
+            // Copy into an existing buffer of the same layout, which
+            // may reference external memory; otherwise take the
+            // prefetched buffer.
+            if (buf.valid() &&
+                buf.pixelType() == pixels->pixelType() &&
+                std::equal(buf.shape(), buf.shape() + PixelBufferBase::dimensions, pixels->shape()) &&
+                buf.storage_order() == pixels->storage_order())
+              buf = *pixels;
+            else
+              buf.vbuffer() = pixels->vbuffer();
+          }
+        else
+          {
+            std::lock_guard<std::mutex> lock(prefetchMutex);
+            openBytesImpl(plane, buf, x, y, w, h);
+          }
+        normalize(buf);
+
+        // Queue the following planes.  They are read using a copy of
+        // the token of this read, which shares its state.
+        const std::shared_ptr<const CancellationToken> token
+          (cancel ? std::make_shared<const CancellationToken>(*cancel) : nullptr);
+        const dimension_size_type count = getImageCount();
+        for (dimension_size_type p = plane + 1; p <= plane + prefetchPlanes && p < count; ++p)
+          {
+            const prefetch_key next{{core, p, x, y, w, h}};
+            if (prefetched.find(next) != prefetched.end())
+              continue;
+
+            // Stop prefetching while the memory budget is exceeded.
+            const dimension_size_type planesize =
+              w * h * bytesPerPixel(getPixelType()) * getRGBChannelCount(getZCTCoords(p)[1]);
+            MemoryBudget::Reservation reservation
+              (MemoryBudget::global().tryReserve(MemoryBudget::PREFETCH, planesize));
+            if (planesize && !reservation.valid())
+              break;
+
+            std::shared_ptr<PrefetchTask> task
+              (std::make_shared<PrefetchTask>([this, next, token]()
+                                              {
+                                                CancellationToken::Scope scope(token.get());
+                                                if (token)
+                                                  token->check();
+                                                std::shared_ptr<VariantPixelBuffer> pixels(std::make_shared<VariantPixelBuffer>());
+                                                std::lock_guard<std::mutex> lock(prefetchMutex);
+                                                openBytesImpl(next[1], *pixels, next[2], next[3], next[4], next[5]);
+                                                return pixels;
+                                              },
+                                              std::move(reservation)));
+            prefetched.insert(std::make_pair(next, task));
+            getExecutor()->submit([task]() { task->run(); });
+          }
+      }
+
+      void
+      FormatReader::openBytesBatch(dimension_size_type              plane,
+                                   const std::vector<PlaneRegion>&  regions,
+                                   std::vector<VariantPixelBuffer>& bufs) const
+      {
+        setPlane(plane);
+
+        std::lock_guard<std::mutex> lock(prefetchMutex);
+        openBytesBatchImpl(plane, regions, bufs);
+        for (auto& buf : bufs)
+          normalize(buf);
       }
 
       void
-      FormatReader::openThumbBytes(dimension_size_type /* plane */,
-                                   VariantPixelBuffer& /* buf */) const
+      FormatReader::openBytesBatchImpl(dimension_size_type              plane,
+                                       const std::vector<PlaneRegion>&  regions,
+                                       std::vector<VariantPixelBuffer>& bufs) const
+      {
+        bufs.resize(regions.size());
+        for (std::vector<PlaneRegion>::size_type r = 0; r < regions.size(); ++r)
+          openBytesImpl(plane, bufs[r], regions[r].x, regions[r].y, regions[r].w, regions[r].h);
+      }
+
+      void
+      FormatReader::openBytesDecimated(dimension_size_type plane,
+                                       VariantPixelBuffer& buf,
+                                       const PlaneRegion&  region,
+                                       dimension_size_type xstep,
+                                       dimension_size_type ystep) const
+      {
+        if (xstep == 0U || ystep == 0U)
+          {
+            boost::format fmt("Invalid decimation step %1%×%2%");
+            fmt % xstep % ystep;
+            throw std::logic_error(fmt.str());
+          }
+
+        setPlane(plane);
+
+        std::lock_guard<std::mutex> lock(prefetchMutex);
+        openBytesDecimatedImpl(plane, buf, region, xstep, ystep);
+        normalize(buf);
+      }
+
+      void
+      FormatReader::openBytesDecimatedImpl(dimension_size_type plane,
+                                           VariantPixelBuffer& buf,
+                                           const PlaneRegion&  region,
+                                           dimension_size_type xstep,
+                                           dimension_size_type ystep) const
+      {
+        VariantPixelBuffer full;
+        openBytesImpl(plane, full, region.x, region.y, region.w, region.h);
+
+        DecimateVisitor v(buf, xstep, ystep);
+        ome::compat::visit(v, full.vbuffer());
+      }
+
+      void
+      FormatReader::openBytesAt(dimension_size_type series,
+                                dimension_size_type resolution,
+                                dimension_size_type plane,
+                                VariantPixelBuffer& buf,
+                                const PlaneRegion&  region) const
       {
         assertId(currentId, true);
-        /**
-         * @todo Implement openThumbBytes.  This requires implementing
-         * image rescaling/resampling.
-         */
-        throw std::runtime_error("Thumbnail rescaling is not currently implemented");
+
+        const dimension_size_type index = coreIndexAt(series, resolution);
+
+        if (plane >= getCoreMetadata(index).imageCount)
+          {
+            boost::format fmt("Invalid plane: %1%");
+            fmt % plane;
+            throw std::logic_error(fmt.str());
+          }
+
+        openBytesAtImpl(series, resolution, plane, buf, region);
+        normalize(buf);
+      }
+
+      void
+      FormatReader::openBytesAtImpl(dimension_size_type series,
+                                    dimension_size_type resolution,
+                                    dimension_size_type plane,
+                                    VariantPixelBuffer& buf,
+                                    const PlaneRegion&  region) const
+      {
+        std::lock_guard<std::mutex> lock(prefetchMutex);
+
+        // Switch the state directly, rather than with setSeries(),
+        // since clearing the prefetched planes would deadlock and
+        // is not needed; prefetching also holds the lock.
+        const dimension_size_type savedCoreIndex = this->coreIndex;
+        const dimension_size_type savedSeries = this->series;
+        const dimension_size_type savedResolution = this->resolution;
+        const dimension_size_type savedPlane = this->plane;
+
+        auto restore = [&]()
+          {
+            this->coreIndex = savedCoreIndex;
+            this->series = savedSeries;
+            this->resolution = savedResolution;
+            this->plane = savedPlane;
+          };
+
+        this->coreIndex = coreIndexAt(series, resolution);
+        this->series = series;
+        this->resolution = resolution;
+        this->plane = plane;
+
+        try
+          {
+            openBytesImpl(plane, buf, region.x, region.y, region.w, region.h);
+          }
+        catch (...)
+          {
+            restore();
+            throw;
+          }
+        restore();
+      }
+
+      void
+      FormatReader::openBytesInto(dimension_size_type     series,
+                                  dimension_size_type     resolution,
+                                  dimension_size_type     plane,
+                                  VariantPixelBufferView& buf,
+                                  const PlaneRegion&      region) const
+      {
+        assertId(currentId, true);
+
+        const dimension_size_type index = coreIndexAt(series, resolution);
+
+        if (plane >= getCoreMetadata(index).imageCount)
+          {
+            boost::format fmt("Invalid plane: %1%");
+            fmt % plane;
+            throw std::logic_error(fmt.str());
+          }
+
+        const VariantPixelBufferView::size_type *shape = buf.shape();
+        if (buf.pixelType() != getCoreMetadata(index).pixelType ||
+            shape[DIM_SPATIAL_X] != region.w ||
+            shape[DIM_SPATIAL_Y] != region.h)
+          {
+            boost::format fmt("Pixel buffer view (%1%x%2% %3%) does not match region (%4%x%5% %6%)");
+            fmt % shape[DIM_SPATIAL_X] % shape[DIM_SPATIAL_Y] % buf.pixelType();
+            fmt % region.w % region.h % getCoreMetadata(index).pixelType;
+            throw std::logic_error(fmt.str());
+          }
+
+        // Normalization after reading is applied to a pixel buffer,
+        // so is applied to a temporary buffer before copying.
+        if (normalizeData && !isNormalizedOnRead() &&
+            (buf.pixelType() == PixelType::FLOAT || buf.pixelType() == PixelType::DOUBLE))
+          {
+            VariantPixelBuffer tmp;
+            openBytesAtImpl(series, resolution, plane, tmp, region);
+            normalize(tmp);
+            buf.copyFrom(tmp);
+            return;
+          }
+
+        openBytesIntoImpl(series, resolution, plane, buf, region);
+      }
+
+      void
+      FormatReader::openBytesIntoImpl(dimension_size_type     series,
+                                      dimension_size_type     resolution,
+                                      dimension_size_type     plane,
+                                      VariantPixelBufferView& buf,
+                                      const PlaneRegion&      region) const
+      {
+        VariantPixelBuffer tmp;
+        openBytesAtImpl(series, resolution, plane, tmp, region);
+        buf.copyFrom(tmp);
+      }
+
+      void
+      FormatReader::openBytesStack(dimension_size_type series,
+                                   dimension_size_type resolution,
+                                   const plane_range&  zRange,
+                                   const plane_range&  cRange,
+                                   const plane_range&  tRange,
+                                   VariantPixelBuffer& buf,
+                                   const PlaneRegion&  region) const
+      {
+        assertId(currentId, true);
+
+        readPlaneStack(getCoreMetadata(coreIndexAt(series, resolution)),
+                       zRange, cRange, tRange, buf, getDecodeThreads(), *getExecutor(),
+                       [&](dimension_size_type plane,
+                           VariantPixelBuffer& dest)
+                       {
+                         openBytesAt(series, resolution, plane, dest, region);
+                       });
+      }
+
+      dimension_size_type
+      FormatReader::coreIndexAt(dimension_size_type series,
+                                dimension_size_type resolution) const
+      {
+        dimension_size_type index = 0;
+        dimension_size_type count = 1;
+
+        if (hasFlattenedResolutions())
+          {
+            // coreIndex and series are identical
+            if (series >= core.size())
+              {
+                boost::format fmt("Invalid series: %1%");
+                fmt % series;
+                throw std::logic_error(fmt.str());
+              }
+            index = series;
+          }
+        else
+          {
+            for (dimension_size_type idx = 0; ; ++idx)
+              {
+                if (index >= core.size() || !core.at(index))
+                  {
+                    boost::format fmt("Invalid series: %1%");
+                    fmt % series;
+                    throw std::logic_error(fmt.str());
+                  }
+
+                if (idx == series)
+                  break;
+
+                index += core.at(index)->resolutionCount;
+              }
+            count = core.at(index)->resolutionCount;
+          }
+
+        if (resolution >= count)
+          {
+            boost::format fmt("Invalid resolution: %1%");
+            fmt % resolution;
+            throw std::logic_error(fmt.str());
+          }
+
+        return index + resolution;
+      }
+
+      void
+      FormatReader::forEachTile(dimension_size_type  plane,
+                                const tile_callback& callback) const
+      {
+        setPlane(plane);
+
+        // Prefetched planes are not used, and without any pending
+        // prefetches the callback is free to use other readers.
+        clearPrefetch();
+        forEachTileImpl(plane, callback);
+      }
+
+      void
+      FormatReader::forEachTileImpl(dimension_size_type  plane,
+                                    const tile_callback& callback) const
+      {
+        const dimension_size_type sizeX = getSizeX();
+        const dimension_size_type sizeY = getSizeY();
+        const dimension_size_type tileWidth = std::max(getOptimalTileWidth(), dimension_size_type(1U));
+        const dimension_size_type tileHeight = std::max(getOptimalTileHeight(), dimension_size_type(1U));
+
+        VariantPixelBuffer buf;
+        for (dimension_size_type y = 0; y < sizeY; y += tileHeight)
+          for (dimension_size_type x = 0; x < sizeX; x += tileWidth)
+            {
+              const PlaneRegion region(x, y,
+                                       std::min(tileWidth, sizeX - x),
+                                       std::min(tileHeight, sizeY - y));
+              openBytesImpl(plane, buf, region.x, region.y, region.w, region.h);
+              callback(region, buf);
+            }
+      }
+
+      void
+      FormatReader::openThumbBytes(dimension_size_type plane,
+                                   VariantPixelBuffer& buf) const
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+
+        const thumbnail_key key{{getCoreIndex(), plane}};
+        auto found = thumbnails.find(key);
+        if (found == thumbnails.end())
+          {
+            const dimension_size_type thumbX = std::max(getThumbSizeX(), dimension_size_type(1U));
+            const dimension_size_type thumbY = std::max(getThumbSizeY(), dimension_size_type(1U));
+
+            // Use the smallest resolution which is no smaller than
+            // the thumbnail.
+            const dimension_size_type currentResolution = getResolution();
+            const dimension_size_type base = getCoreIndex() - currentResolution;
+            dimension_size_type thumbResolution = currentResolution;
+            for (dimension_size_type r = currentResolution + 1; r < getResolutionCount(); ++r)
+              {
+                const CoreMetadata& level(*core.at(base + r));
+                if (level.sizeX >= thumbX && level.sizeY >= thumbY)
+                  thumbResolution = r;
+              }
+
+            std::shared_ptr<VariantPixelBuffer> thumb(std::make_shared<VariantPixelBuffer>());
+
+            // Switch to the thumbnail resolution for reading, and
+            // switch back afterwards.
+            auto restore = [&]()
+              {
+                if (thumbResolution != currentResolution)
+                  {
+                    setResolution(currentResolution);
+                    setPlane(plane);
+                  }
+              };
+
+            if (thumbResolution != currentResolution)
+              setResolution(thumbResolution);
+            try
+              {
+                const dimension_size_type sizeX = getSizeX();
+                const dimension_size_type sizeY = getSizeY();
+                const dimension_size_type xstep = std::max(sizeX / thumbX, dimension_size_type(1U));
+                const dimension_size_type ystep = std::max(sizeY / thumbY, dimension_size_type(1U));
+
+                // Read whole tile rows at a time, so only one band of
+                // decimated rows is held in memory.
+                dimension_size_type bandHeight = std::max(getOptimalTileHeight(), ystep);
+                bandHeight = ((bandHeight + ystep - 1U) / ystep) * ystep;
+
+                std::lock_guard<std::mutex> lock(prefetchMutex);
+
+                for (dimension_size_type y = 0; y < sizeY; y += bandHeight)
+                  {
+                    const PlaneRegion region(0U, y, sizeX, std::min(bandHeight, sizeY - y));
+                    VariantPixelBuffer band;
+                    openBytesDecimatedImpl(plane, band, region, xstep, ystep);
+
+                    if (y == 0U)
+                      {
+                        std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+                        std::copy(band.shape(), band.shape() + PixelBufferBase::dimensions, shape.begin());
+                        shape[DIM_SPATIAL_X] = thumbX;
+                        shape[DIM_SPATIAL_Y] = thumbY;
+                        thumb->setBuffer(shape, band.pixelType(), band.storage_order());
+                      }
+
+                    ThumbnailVisitor v(*thumb, sizeX, sizeY, xstep, ystep, y);
+                    ome::compat::visit(v, band.vbuffer());
+                  }
+              }
+            catch (...)
+              {
+                restore();
+                throw;
+              }
+            restore();
+
+            found = thumbnails.insert(std::make_pair(key, thumb)).first;
+          }
+
+        const VariantPixelBuffer& cached(*found->second);
+        std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+        std::copy(cached.shape(), cached.shape() + PixelBufferBase::dimensions, shape.begin());
+        buf.setBuffer(shape, cached.pixelType(), cached.storage_order());
+        buf = cached;
+      }
+
+      void
+      FormatReader::openRawTile(dimension_size_type   /* plane */,
+                                dimension_size_type   /* tile */,
+                                std::vector<uint8_t>& /* buf */) const
+      {
+        assertId(currentId, true);
+        throw std::runtime_error("Reader does not implement raw tile access");
       }
 
       void
       FormatReader::close(bool fileOnly)
       {
+        clearPrefetch();
         if (in)
           in = std::shared_ptr<std::istream>(); // set to null.
         if (!fileOnly)
@@ -765,6 +1859,8 @@ namespace ome
             currentId = boost::none;
             coreIndex = series = resolution = plane = 0;
             core.clear();
+            thumbnails.clear();
+            originalMetadataPending = false;
           }
       }
 
@@ -782,6 +1878,7 @@ namespace ome
       void
       FormatReader::setSeries(dimension_size_type series) const
       {
+        clearPrefetch();
         this->coreIndex = seriesToCoreIndex(series);
         this->series = series;
         this->resolution = 0;
@@ -856,6 +1953,81 @@ namespace ome
         return normalizeData;
       }
 
+      void
+      FormatReader::normalize(VariantPixelBuffer& buf) const
+      {
+        if (!normalizeData || isNormalizedOnRead() || !buf.valid())
+          return;
+
+        NormalizeVisitor v;
+        ome::compat::visit(v, buf.vbuffer());
+      }
+
+      bool
+      FormatReader::isNormalizedOnRead() const
+      {
+        return false;
+      }
+
+      void
+      FormatReader::setIndexedExpanded(bool expand)
+      {
+        assertId(currentId, false);
+        expandIndexed = expand;
+      }
+
+      bool
+      FormatReader::isIndexedExpanded() const
+      {
+        return expandIndexed;
+      }
+
+      void
+      FormatReader::setDecodeThreads(unsigned int threads)
+      {
+        decodeThreads = threads ? threads : 1U;
+      }
+
+      unsigned int
+      FormatReader::getDecodeThreads() const
+      {
+        return decodeThreads;
+      }
+
+      void
+      FormatReader::setExecutor(const std::shared_ptr<Executor>& executor)
+      {
+        this->executor = executor;
+      }
+
+      std::shared_ptr<Executor>
+      FormatReader::getExecutor() const
+      {
+        std::shared_ptr<Executor> current(executor);
+        return current ? current : Executor::global();
+      }
+
+      void
+      FormatReader::setPrefetchPlanes(dimension_size_type planes)
+      {
+        clearPrefetch();
+        prefetchPlanes = planes;
+      }
+
+      dimension_size_type
+      FormatReader::getPrefetchPlanes() const
+      {
+        return prefetchPlanes;
+      }
+
+      void
+      FormatReader::clearPrefetch() const
+      {
+        for (auto& p : prefetched)
+          p.second->discard();
+        prefetched.clear();
+      }
+
       void
       FormatReader::setOriginalMetadataPopulated(bool populate)
       {
@@ -869,6 +2041,19 @@ namespace ome
         return saveOriginalMetadata;
       }
 
+      void
+      FormatReader::setOriginalMetadataLazy(bool lazy)
+      {
+        assertId(currentId, false);
+        lazyOriginalMetadata = lazy;
+      }
+
+      bool
+      FormatReader::isOriginalMetadataLazy() const
+      {
+        return lazyOriginalMetadata;
+      }
+
       const std::vector<boost::filesystem::path>
       FormatReader::getUsedFiles(bool noPixels) const
       {
@@ -957,13 +2142,9 @@ namespace ome
                              dimension_size_type c,
                              dimension_size_type t) const
       {
-        assertId(currentId, true);
-        return ome::files::getIndex(getDimensionOrder(),
-                                         getSizeZ(),
-                                         getEffectiveSizeC(),
-                                         getSizeT(),
-                                         getImageCount(),
-                                         z, c, t);
+        const DimensionIndexer indexer(getDimensionIndexer());
+        indexer.checkCoords(z, c, t);
+        return indexer.index(z, c, t);
       }
 
       dimension_size_type
@@ -974,50 +2155,46 @@ namespace ome
                              dimension_size_type moduloC,
                              dimension_size_type moduloT) const
       {
-        assertId(currentId, true);
-        return ome::files::getIndex(getDimensionOrder(),
-                                         getSizeZ(),
-                                         getEffectiveSizeC(),
-                                         getSizeT(),
-                                         getModuloZ().size(),
-                                         getModuloC().size(),
-                                         getModuloT().size(),
-                                         getImageCount(),
-                                         z, c, t,
-                                         moduloZ, moduloC, moduloT);
+        const DimensionIndexer indexer(getDimensionIndexer());
+        indexer.checkCoords(z, c, t, moduloZ, moduloC, moduloT);
+        return indexer.index(z, c, t, moduloZ, moduloC, moduloT);
       }
 
       std::array<dimension_size_type, 3>
       FormatReader::getZCTCoords(dimension_size_type index) const
       {
-        assertId(currentId, true);
-        return ome::files::getZCTCoords(getDimensionOrder(),
-                                             getSizeZ(),
-                                             getEffectiveSizeC(),
-                                             getSizeT(),
-                                             getImageCount(),
-                                             index);
+        const DimensionIndexer indexer(getDimensionIndexer());
+        indexer.checkIndex(index);
+        return indexer.coords(index);
       }
 
       std::array<dimension_size_type, 6>
       FormatReader::getZCTModuloCoords(dimension_size_type index) const
+      {
+        const DimensionIndexer indexer(getDimensionIndexer());
+        indexer.checkIndex(index);
+        return indexer.moduloCoords(index);
+      }
+
+      DimensionIndexer
+      FormatReader::getDimensionIndexer() const
       {
         assertId(currentId, true);
-        return ome::files::getZCTCoords(getDimensionOrder(),
-                                             getSizeZ(),
-                                             getEffectiveSizeC(),
-                                             getSizeT(),
-                                             getModuloZ().size(),
-                                             getModuloC().size(),
-                                             getModuloT().size(),
-                                             getImageCount(),
-                                             index);
+        const CoreMetadata& core(getCoreMetadata(getCoreIndex()));
+        return DimensionIndexer(core.dimensionOrder,
+                                getSizeZ(),
+                                getEffectiveSizeC(),
+                                getSizeT(),
+                                core.moduloZ.size(),
+                                core.moduloC.size(),
+                                core.moduloT.size(),
+                                getImageCount());
       }
 
       const MetadataMap::value_type&
       FormatReader::getMetadataValue(const std::string& field) const
       {
-        return metadata.get<MetadataMap::value_type>(field);
+        return getGlobalMetadata().get<MetadataMap::value_type>(field);
       }
 
       const MetadataMap::value_type&
@@ -1030,6 +2207,7 @@ namespace ome
       const MetadataMap&
       FormatReader::getGlobalMetadata() const
       {
+        loadOriginalMetadata();
         return metadata;
       }
 
@@ -1037,6 +2215,7 @@ namespace ome
       FormatReader::getSeriesMetadata() const
       {
         assertId(currentId, true);
+        loadOriginalMetadata();
         return getCoreMetadata(getCoreIndex()).seriesMetadata;
       }
 
@@ -1044,6 +2223,7 @@ namespace ome
       FormatReader::getCoreMetadataList() const
       {
         assertId(currentId, true);
+        loadOriginalMetadata();
         return core;
       }
 
@@ -1074,12 +2254,14 @@ namespace ome
       const std::shared_ptr<::ome::xml::meta::MetadataStore>&
       FormatReader::getMetadataStore() const
       {
+        loadOriginalMetadata();
         return metadataStore;
       }
 
       std::shared_ptr<::ome::xml::meta::MetadataStore>&
       FormatReader::getMetadataStore()
       {
+        loadOriginalMetadata();
         return metadataStore;
       }
 
@@ -1299,6 +2481,7 @@ namespace ome
             fmt % resolution;
             throw std::logic_error(fmt.str());
           }
+        clearPrefetch();
         this->coreIndex = seriesToCoreIndex(getSeries()) + resolution;
         // this->series unchanged.
         this->resolution = resolution;
@@ -1339,6 +2522,7 @@ namespace ome
             fmt % index;
             throw std::logic_error(fmt.str());
           }
+        clearPrefetch();
         this->series = coreIndexToSeries(index);
         this->coreIndex = index;
         this->resolution = index - seriesToCoreIndex(this->series);
@@ -1362,46 +2546,14 @@ namespace ome
         if (!currentId || canonicalpath != currentId.get())
           {
             initFile(canonicalpath);
+            shareCoreMetadata();
 
             const std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>& store =
               std::dynamic_pointer_cast<::ome::xml::meta::OMEXMLMetadata>(getMetadataStore());
             if(store)
               {
-                if(saveOriginalMetadata)
-                  {
-                    MetadataMap allMetadata(metadata);
-
-                    setSeries(0);
-                    {
-                      SaveSeries(*this);
-                      for (dimension_size_type series = 0;
-                           series < getSeriesCount();
-                           ++series)
-                        {
-                          boost::format fmt("Series %1%");
-                          fmt % series;
-                          std::string name(fmt.str());
-
-                          try
-                            {
-                              std::string imageName = store->getImageName(series);
-                              if (!imageName.empty() && ome::common::trim(imageName).size() != 0)
-                                name = imageName;
-                            }
-                          catch (const std::exception&)
-                            {
-                            }
-                          setSeries(series);
-                          const MetadataMap& sm(getSeriesMetadata());
-                          for (MetadataMap::const_iterator i = sm.begin();
-                               i != sm.end();
-                               ++i)
-                            allMetadata.set(name + " " + i->first, i->second);
-                        }
-                    }
-
-                    fillOriginalMetadata(*store, allMetadata);
-                  }
+                if (saveOriginalMetadata && !lazyOriginalMetadata)
+                  populateOriginalMetadata();
 
                 setSeries(0);
                 {
@@ -1424,6 +2576,9 @@ namespace ome
                     }
                 }
               }
+
+            // Defer reading original metadata until first access.
+            originalMetadataPending = lazyOriginalMetadata;
           }
       }
 
@@ -38,6 +38,9 @@
 #ifndef OME_FILES_DETAIL_FORMATREADER_H
 #define OME_FILES_DETAIL_FORMATREADER_H
 
+#include <array>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <map>
@@ -58,6 +61,9 @@ namespace ome
     namespace detail
     {
 
+      class MemoReader;
+      class MemoWriter;
+
       /**
        * Properties specific to a particular reader.
        */
@@ -120,8 +126,13 @@ namespace ome
         /// Current input.
         std::shared_ptr<std::istream> in;
 
-        /// Mapping of metadata key/value pairs.
-        ::ome::files::MetadataMap metadata;
+        /**
+         * Mapping of metadata key/value pairs.
+         *
+         * Mutable so that it may be filled on first access when
+         * original metadata is read on demand.
+         */
+        mutable ::ome::files::MetadataMap metadata;
 
         /**
          * The number of the current series (flattened).
@@ -147,8 +158,16 @@ namespace ome
          */
         mutable dimension_size_type plane;
 
-        /// Core metadata values.
-        coremetadata_list_type core;
+        /**
+         * Core metadata values.
+         *
+         * Identical entries may share a single CoreMetadata instance
+         * after shareCoreMetadata(); use the non-const
+         * getCoreMetadata(dimension_size_type) or
+         * unshareCoreMetadata() before modifying an entry after
+         * sharing.
+         */
+        mutable coremetadata_list_type core;
 
         /**
          * The number of the current resolution.
@@ -183,15 +202,53 @@ namespace ome
         /// Whether or not to normalize float data.
         bool normalizeData;
 
+        /// Number of threads to use for decoding pixel data.
+        unsigned int decodeThreads;
+
+        /// Executor for parallel reading (null for global).
+        std::shared_ptr<Executor> executor;
+
+        /// Number of planes to prefetch.
+        dimension_size_type prefetchPlanes;
+
+        /// Prefetch key (core index, plane, x, y, w, h).
+        typedef std::array<dimension_size_type, 6> prefetch_key;
+
+        class PrefetchTask;
+
+        /// Prefetched planes.
+        mutable std::map<prefetch_key, std::shared_ptr<PrefetchTask>> prefetched;
+
+        /// Mutex serialising openBytesImpl() with prefetching.
+        mutable std::mutex prefetchMutex;
+
+        /// Thumbnail key (core index, plane).
+        typedef std::array<dimension_size_type, 2> thumbnail_key;
+
+        /// Cached thumbnails.
+        mutable std::map<thumbnail_key, std::shared_ptr<VariantPixelBuffer>> thumbnails;
+
         /// Whether or not to filter out invalid metadata.
         bool filterMetadata;
 
         /// Whether or not to save proprietary metadata in the MetadataStore.
         bool saveOriginalMetadata;
 
+        /// Whether or not to read original metadata on demand.
+        bool lazyOriginalMetadata;
+
+        /// Whether original metadata reading is deferred until first access.
+        mutable bool originalMetadataPending;
+
+        /// Mutex serialising deferred original metadata reading.
+        mutable std::mutex originalMetadataMutex;
+
         /// Whether or not MetadataStore sets C = 3 for indexed color images.
         bool indexedAsRGB;
 
+        /// Whether or not to expand indexed color images to RGB.
+        bool expandIndexed;
+
         /// Whether or not to group multi-file formats.
         bool group;
 
@@ -207,6 +264,9 @@ namespace ome
         /// Metadata parsing options.
         MetadataOptions metadataOptions;
 
+        /// I/O statistics.
+        std::shared_ptr<IOStatistics> ioStatistics;
+
         /// Constructor.
         FormatReader(const ReaderProperties&);
 
@@ -241,6 +301,121 @@ namespace ome
         void
         initFile(const boost::filesystem::path& id);
 
+        /**
+         * Read deferred original metadata.
+         *
+         * Called once, on first access, when original metadata is
+         * read on demand.  Readers which skip reading original
+         * metadata in initFile() when isOriginalMetadataLazy() is
+         * set should override this method to fill @c metadata and
+         * the @c seriesMetadata of each CoreMetadata in @c core.
+         * The default implementation does nothing.
+         */
+        virtual
+        void
+        readOriginalMetadata() const;
+
+      public:
+        /**
+         * Check if the reader state may be saved in a memo.
+         *
+         * Only readers which save and restore all of their state
+         * set by initFile() with saveMemoState() and
+         * restoreMemoState() may be memoized.  The default
+         * implementation returns @c false.
+         *
+         * @returns @c true if saveMemo() is supported, @c false
+         * otherwise.
+         */
+        virtual
+        bool
+        isMemoizable() const;
+
+        /**
+         * Save the initialized reader state in a memo.
+         *
+         * The core metadata, original metadata and MetadataStore
+         * are saved, followed by any reader-specific state saved by
+         * saveMemoState().  Any deferred original metadata is read
+         * first, so that the memo is complete.
+         *
+         * @param memo the memo to write.
+         * @throws FormatException if the current file is not set,
+         * or the reader is not memoizable.
+         */
+        void
+        saveMemo(MemoWriter& memo) const;
+
+        /**
+         * Restore the initialized reader state from a memo.
+         *
+         * This replaces setId() for the file saved in the memo,
+         * without reading the file.  The memo must have been saved
+         * by the same reader type with the same settings, else it
+         * is not used.  The caller is responsible for checking that
+         * the files used are unchanged since the memo was saved.
+         *
+         * @param memo the memo to read.
+         * @returns @c true if the state was restored, or @c false if
+         * the memo was not used (the reader is then closed).
+         * @throws FormatException if the memo is invalid (the reader
+         * is then closed).
+         */
+        bool
+        restoreMemo(MemoReader& memo);
+
+      protected:
+        /**
+         * Save reader-specific state in a memo.
+         *
+         * Called by saveMemo() after the common state is saved.
+         * The default implementation does nothing.
+         *
+         * @param memo the memo to write.
+         */
+        virtual
+        void
+        saveMemoState(MemoWriter& memo) const;
+
+        /**
+         * Restore reader-specific state from a memo.
+         *
+         * Called by restoreMemo() after the common state (@c
+         * currentId, @c core, @c metadata and the MetadataStore) is
+         * restored, to read the state saved by saveMemoState().
+         * The default implementation does nothing.
+         *
+         * @param memo the memo to read.
+         * @returns @c true if the state was restored, or @c false if
+         * the memo was saved with different reader settings.
+         */
+        virtual
+        bool
+        restoreMemoState(MemoReader& memo);
+
+      private:
+        /**
+         * Read deferred original metadata if pending.
+         *
+         * Calls readOriginalMetadata() and then fills the original
+         * metadata annotations if saving original metadata in an
+         * OME-XML MetadataStore.  Does nothing if nothing is
+         * pending.
+         */
+        void
+        loadOriginalMetadata() const;
+
+        /**
+         * Fill the original metadata annotations.
+         *
+         * The global metadata and the series metadata of each series
+         * are stored in the MetadataStore as original metadata
+         * annotations, if it is an OME-XML MetadataStore.
+         */
+        void
+        populateOriginalMetadata() const;
+
+      protected:
         /**
          * Check if a file is in the used files list.
          *
@@ -301,6 +476,75 @@ namespace ome
                   dimension_size_type scanlinePad,
                   dimension_size_type samples);
 
+        /**
+         * Read a raw plane from memory.
+         *
+         * This is equivalent to the stream variant, but the plane is
+         * read from a contiguous block of memory such as a
+         * memory-mapped file.  Row offsets are computed directly,
+         * and contiguous rows are copied in bulk.
+         *
+         * @param source the start of the plane data.
+         * @param size the size of the plane data, in bytes.
+         * @param dest the pixel buffer in which to store the plane.
+         * @param x the left edge of the plane.
+         * @param y the top edge of the plane.
+         * @param w the width of the plane.
+         * @param h the height of the plane.
+         * @param samples the number of samples per pixel.
+         * @throws std::runtime_error if the source is too small.
+         */
+        virtual
+        void
+        readPlane(const uint8_t       *source,
+                  dimension_size_type  size,
+                  VariantPixelBuffer&  dest,
+                  dimension_size_type  x,
+                  dimension_size_type  y,
+                  dimension_size_type  w,
+                  dimension_size_type  h,
+                  dimension_size_type  samples);
+
+        /**
+         * Read a raw plane with scanline padding from memory.
+         *
+         * @param source the start of the plane data.
+         * @param size the size of the plane data, in bytes.
+         * @param dest the pixel buffer in which to store the plane.
+         * @param x the left edge of the plane.
+         * @param y the top edge of the plane.
+         * @param w the width of the plane.
+         * @param h the height of the plane.
+         * @param scanlinePad the scanline padding.
+         * @param samples the number of samples per pixel.
+         * @throws std::runtime_error if the source is too small.
+         */
+        virtual
+        void
+        readPlane(const uint8_t       *source,
+                  dimension_size_type  size,
+                  VariantPixelBuffer&  dest,
+                  dimension_size_type  x,
+                  dimension_size_type  y,
+                  dimension_size_type  w,
+                  dimension_size_type  h,
+                  dimension_size_type  scanlinePad,
+                  dimension_size_type  samples);
+
+        /**
+         * Resize a destination pixel buffer for readPlane(), if needed.
+         *
+         * @param dest the destination pixel buffer.
+         * @param w the width of the plane.
+         * @param h the height of the plane.
+         * @param samples the number of samples per pixel.
+         */
+        void
+        preparePlane(VariantPixelBuffer& dest,
+                     dimension_size_type w,
+                     dimension_size_type h,
+                     dimension_size_type samples) const;
+
         /**
          * Create a configured FilterMetadata instance.
          *
@@ -341,12 +585,47 @@ namespace ome
         CoreMetadata&
         getCoreMetadata(dimension_size_type index)
         {
+          unshareCoreMetadata(index);
           coremetadata_list_type::value_type cm(core.at(index));
           if (!cm)
             throw std::logic_error("CoreMetadata null");
           return *cm;
         }
 
+        /**
+         * Share identical CoreMetadata.
+         *
+         * Entries in @c core which are of type CoreMetadata (not a
+         * derived type) and compare equal to an earlier entry are
+         * replaced by the earlier entry, so that identical series
+         * (for example, the wells and fields of a plate) share a
+         * single instance.  Shared entries are copied on write by
+         * unshareCoreMetadata().
+         *
+         * This is called by setId() after initFile().
+         */
+        void
+        shareCoreMetadata();
+
+        /**
+         * Stop sharing CoreMetadata for a core index.
+         *
+         * If the entry was shared by shareCoreMetadata(), it is
+         * replaced by a copy so that it may be modified without
+         * affecting other entries.
+         *
+         * @param index the core index.
+         * @throws std::range_error if the core index is invalid.
+         */
+        void
+        unshareCoreMetadata(dimension_size_type index) const;
+
+        /**
+         * Stop sharing CoreMetadata for all core indexes.
+         */
+        void
+        unshareCoreMetadata() const;
+
       public:
         // Documented in superclass.
         const std::set<MetadataOptions::MetadataLevel>&
@@ -583,12 +862,195 @@ namespace ome
                       dimension_size_type w,
                       dimension_size_type h) const = 0;
 
+      public:
+        // Documented in superclass.
+        void
+        openBytesBatch(dimension_size_type              plane,
+                       const std::vector<PlaneRegion>&  regions,
+                       std::vector<VariantPixelBuffer>& bufs) const;
+
+      protected:
+        /**
+         * @copydoc ome::files::FormatReader::openBytesBatch(dimension_size_type,const std::vector<PlaneRegion>&,std::vector<VariantPixelBuffer>&)const
+         *
+         * The default implementation calls openBytesImpl() for each
+         * region.
+         */
+        virtual
+        void
+        openBytesBatchImpl(dimension_size_type              plane,
+                           const std::vector<PlaneRegion>&  regions,
+                           std::vector<VariantPixelBuffer>& bufs) const;
+
+      public:
+        // Documented in superclass.
+        void
+        openBytesDecimated(dimension_size_type plane,
+                           VariantPixelBuffer& buf,
+                           const PlaneRegion&  region,
+                           dimension_size_type xstep,
+                           dimension_size_type ystep) const;
+
+      protected:
+        /**
+         * @copydoc ome::files::FormatReader::openBytesDecimated(dimension_size_type,VariantPixelBuffer&,const PlaneRegion&,dimension_size_type,dimension_size_type)const
+         *
+         * The default implementation calls openBytesImpl() for the
+         * whole region and copies the sampled pixels.
+         */
+        virtual
+        void
+        openBytesDecimatedImpl(dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               const PlaneRegion&  region,
+                               dimension_size_type xstep,
+                               dimension_size_type ystep) const;
+
+      public:
+        // Documented in superclass.
+        void
+        openBytesAt(dimension_size_type series,
+                    dimension_size_type resolution,
+                    dimension_size_type plane,
+                    VariantPixelBuffer& buf,
+                    const PlaneRegion&  region) const;
+
+      protected:
+        /**
+         * @copydoc ome::files::FormatReader::openBytesAt(dimension_size_type,dimension_size_type,dimension_size_type,VariantPixelBuffer&,const PlaneRegion&)const
+         *
+         * The series, resolution and plane have been validated.  The
+         * default implementation temporarily switches the current
+         * series, resolution and plane, and calls openBytesImpl().
+         * Requests are serialised with each other, but are not safe
+         * to mix with concurrent use of the current series and plane
+         * from other threads; readers able to read without using the
+         * current state should override this method.
+         */
+        virtual
+        void
+        openBytesAtImpl(dimension_size_type series,
+                        dimension_size_type resolution,
+                        dimension_size_type plane,
+                        VariantPixelBuffer& buf,
+                        const PlaneRegion&  region) const;
+
+      public:
+        // Documented in superclass.
+        void
+        openBytesInto(dimension_size_type     series,
+                      dimension_size_type     resolution,
+                      dimension_size_type     plane,
+                      VariantPixelBufferView& buf,
+                      const PlaneRegion&      region) const;
+
+      protected:
+        /**
+         * @copydoc ome::files::FormatReader::openBytesInto(dimension_size_type,dimension_size_type,dimension_size_type,VariantPixelBufferView&,const PlaneRegion&)const
+         *
+         * The series, resolution and plane have been validated.  The
+         * default implementation reads the region with
+         * openBytesAtImpl() into a temporary buffer, and copies it
+         * into the view; readers able to decode into a view should
+         * override this method.
+         */
+        virtual
+        void
+        openBytesIntoImpl(dimension_size_type     series,
+                          dimension_size_type     resolution,
+                          dimension_size_type     plane,
+                          VariantPixelBufferView& buf,
+                          const PlaneRegion&      region) const;
+
+        /**
+         * Get the core index for a series and resolution.
+         *
+         * Unlike seriesToCoreIndex(), this does not use the current
+         * series, and so is safe to call concurrently.
+         *
+         * @param series the series index.
+         * @param resolution the resolution index within the series.
+         * @returns the core index.
+         * @throws std::logic_error if the series or resolution is
+         * invalid.
+         */
+        dimension_size_type
+        coreIndexAt(dimension_size_type series,
+                    dimension_size_type resolution) const;
+
+        /**
+         * Normalize pixel data, if enabled.
+         *
+         * If normalization is enabled (see setNormalized()) and the
+         * reader does not normalize while reading (see
+         * isNormalizedOnRead()), floating point pixel data is scaled
+         * from the range of the pixel type (see
+         * PixelStatistics::getRangeMin()), which is [0, 1], so that
+         * values outside the range are clamped; other pixel types
+         * are not changed.  The range is fixed, so that every region
+         * of a plane is scaled alike.
+         *
+         * @param buf the pixel buffer to normalize.
+         */
+        void
+        normalize(VariantPixelBuffer& buf) const;
+
+        /**
+         * Check if pixel data is normalized while it is read.
+         *
+         * Readers which scale floating point pixel data as each
+         * tile is read, using a range covering the whole plane,
+         * override this to return @c true, and normalize() then
+         * leaves the data unchanged.
+         *
+         * @returns @c true if normalized while reading, or @c false
+         * (the default) to normalize after reading.
+         */
+        virtual
+        bool
+        isNormalizedOnRead() const;
+
+      public:
+        // Documented in superclass.
+        void
+        openBytesStack(dimension_size_type series,
+                       dimension_size_type resolution,
+                       const plane_range&  zRange,
+                       const plane_range&  cRange,
+                       const plane_range&  tRange,
+                       VariantPixelBuffer& buf,
+                       const PlaneRegion&  region) const;
+
+      public:
+        // Documented in superclass.
+        void
+        forEachTile(dimension_size_type  plane,
+                    const tile_callback& callback) const;
+
+      protected:
+        /**
+         * @copydoc ome::files::FormatReader::forEachTile(dimension_size_type,const tile_callback&)const
+         *
+         * The default implementation calls openBytesImpl() for each
+         * region of the optimal tile size.
+         */
+        virtual
+        void
+        forEachTileImpl(dimension_size_type  plane,
+                        const tile_callback& callback) const;
+
       public:
         // Documented in superclass.
         void
         openThumbBytes(dimension_size_type plane,
                        VariantPixelBuffer& buf) const;
 
+        // Documented in superclass.
+        void
+        openRawTile(dimension_size_type   plane,
+                    dimension_size_type   tile,
+                    std::vector<uint8_t>& buf) const;
+
         // Documented in superclass.
         void
         close(bool fileOnly = false);
@@ -637,6 +1099,53 @@ namespace ome
         bool
         isNormalized() const;
 
+        // Documented in superclass.
+        void
+        setIndexedExpanded(bool expand);
+
+        // Documented in superclass.
+        bool
+        isIndexedExpanded() const;
+
+        // Documented in superclass.
+        virtual
+        void
+        setDecodeThreads(unsigned int threads);
+
+        // Documented in superclass.
+        unsigned int
+        getDecodeThreads() const;
+
+        // Documented in superclass.
+        virtual
+        void
+        setExecutor(const std::shared_ptr<Executor>& executor);
+
+        // Documented in superclass.
+        std::shared_ptr<Executor>
+        getExecutor() const;
+
+        // Documented in superclass.
+        void
+        setPrefetchPlanes(dimension_size_type planes);
+
+        // Documented in superclass.
+        dimension_size_type
+        getPrefetchPlanes() const;
+
+      protected:
+        /**
+         * Discard all prefetched planes.
+         *
+         * Waits for any outstanding prefetch to complete.  This must
+         * be called before changing or releasing any state used by
+         * openBytesImpl(), for example at the start of close().
+         */
+        void
+        clearPrefetch() const;
+
+      public:
+
         // Documented in superclass.
         void
         setOriginalMetadataPopulated(bool populate);
@@ -645,6 +1154,14 @@ namespace ome
         bool
         isOriginalMetadataPopulated() const;
 
+        // Documented in superclass.
+        void
+        setOriginalMetadataLazy(bool lazy);
+
+        // Documented in superclass.
+        bool
+        isOriginalMetadataLazy() const;
+
         // Documented in superclass.
         const std::vector<boost::filesystem::path>
         getUsedFiles(bool noPixels = false) const;
@@ -688,6 +1205,10 @@ namespace ome
         std::array<dimension_size_type, 6>
         getZCTModuloCoords(dimension_size_type index) const;
 
+        // Documented in superclass.
+        DimensionIndexer
+        getDimensionIndexer() const;
+
         // Documented in superclass.
         const std::vector<std::shared_ptr<::ome::files::CoreMetadata>>&
         getCoreMetadataList() const;
@@ -811,6 +1332,10 @@ namespace ome
         // Documented in superclass.
         const std::vector<boost::filesystem::path>&
         getCompressionSuffixes() const;
+
+        // Documented in superclass.
+        std::shared_ptr<IOStatistics>
+        getIOStatistics() const;
       };
 
     }
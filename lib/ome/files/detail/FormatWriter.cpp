@@ -35,11 +35,14 @@
  * #L%
  */
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <stdexcept>
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/format.hpp>
 
 #include <ome/common/filesystem.h>
 #include <ome/common/mstream.h>
@@ -47,10 +50,15 @@
 
 #include <ome/compat/regex.h>
 
+#include <ome/files/DimensionIndexer.h>
+#include <ome/files/Executor.h>
+#include <ome/files/FormatException.h>
 #include <ome/files/FormatTools.h>
 #include <ome/files/PixelBuffer.h>
+#include <ome/files/PixelBufferAllocator.h>
 #include <ome/files/PixelProperties.h>
 #include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
 #include <ome/files/detail/FormatWriter.h>
 
 #include <ome/xml/meta/DummyMetadata.h>
@@ -75,6 +83,19 @@ namespace ome
       {
         // Default thumbnail width and height.
         const dimension_size_type THUMBNAIL_DIMENSION = 128;
+
+        void
+        check_range(const char                       *dimension,
+                    const FormatWriter::plane_range&  range,
+                    dimension_size_type               size)
+        {
+          if (range[0] >= range[1] || range[1] > size)
+            {
+              boost::format fmt("Invalid %1% range: [%2%, %3%)");
+              fmt % dimension % range[0] % range[1];
+              throw std::logic_error(fmt.str());
+            }
+        }
       }
 
       FormatWriter::FormatWriter(const WriterProperties& writerProperties):
@@ -86,10 +107,15 @@ namespace ome
         compression(boost::none),
         interleaved(boost::none),
         sequential(false),
+        writeThreads(1U),
+        executor(),
+        writeQueueDepth(0U),
+        writeBufferPool(),
         framesPerSecond(0),
         tile_size_x(boost::none),
         tile_size_y(boost::none),
-        metadataRetrieve(std::make_shared<DummyMetadata>())
+        metadataRetrieve(std::make_shared<DummyMetadata>()),
+        ioStatistics(std::make_shared<IOStatistics>())
       {
         assertId(currentId, false);
       }
@@ -118,6 +144,12 @@ namespace ome
           {
           }
 
+        setCanonicalId(canonicalpath);
+      }
+
+      void
+      FormatWriter::setCanonicalId(const boost::filesystem::path& canonicalpath)
+      {
         if (!currentId || canonicalpath != currentId.get())
           {
             if (out)
@@ -175,6 +207,155 @@ namespace ome
         saveBytes(plane, buf, 0, 0, width, height);
       }
 
+      void
+      FormatWriter::saveBytes(dimension_size_type  plane,
+                              VariantPixelBuffer&& buf)
+      {
+        assertId(currentId, true);
+
+        dimension_size_type width = metadataRetrieve->getPixelsSizeX(getSeries());
+        dimension_size_type height = metadataRetrieve->getPixelsSizeY(getSeries());
+        saveBytes(plane, std::move(buf), 0, 0, width, height);
+      }
+
+      void
+      FormatWriter::saveBytes(dimension_size_type  plane,
+                              VariantPixelBuffer&& buf,
+                              dimension_size_type  x,
+                              dimension_size_type  y,
+                              dimension_size_type  w,
+                              dimension_size_type  h)
+      {
+        saveBytes(plane, buf, x, y, w, h);
+      }
+
+      void
+      FormatWriter::saveBytes(dimension_size_type            plane,
+                              const VariantPixelBufferView& buf,
+                              dimension_size_type            x,
+                              dimension_size_type            y,
+                              dimension_size_type            w,
+                              dimension_size_type            h)
+      {
+        assertId(currentId, true);
+
+        const boost::optional<bool>& interleaved(getInterleaved());
+        VariantPixelBuffer tmp;
+        buf.copyTo(tmp,
+                   PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC,
+                                                       interleaved && *interleaved));
+        saveBytes(plane, std::move(tmp), x, y, w, h);
+      }
+
+      void
+      FormatWriter::saveBytesStack(dimension_size_type series,
+                                   const plane_range&  zRange,
+                                   const plane_range&  cRange,
+                                   const plane_range&  tRange,
+                                   VariantPixelBuffer& buf)
+      {
+        assertId(currentId, true);
+
+        setSeries(series);
+        const std::vector<stack_plane> planes(stackPlanes(zRange, cRange, tRange, buf));
+        const dimension_size_type width = buf.shape()[DIM_SPATIAL_X];
+        const dimension_size_type height = buf.shape()[DIM_SPATIAL_Y];
+        for (const auto& plane : planes)
+          saveBytes(plane.first, stackPlaneView(buf, plane), 0, 0, width, height);
+      }
+
+      std::vector<FormatWriter::stack_plane>
+      FormatWriter::stackPlanes(const plane_range&        zRange,
+                                const plane_range&        cRange,
+                                const plane_range&        tRange,
+                                const VariantPixelBuffer& buf) const
+      {
+        check_range("Z", zRange, getSizeZ());
+        check_range("C", cRange, getEffectiveSizeC());
+        check_range("T", tRange, getSizeT());
+
+        const dimension_size_type zCount = zRange[1] - zRange[0];
+        const dimension_size_type cCount = cRange[1] - cRange[0];
+        const dimension_size_type tCount = tRange[1] - tRange[0];
+
+        const VariantPixelBuffer::size_type *shape(buf.shape());
+        if (shape[DIM_SPATIAL_X] != getSizeX() || shape[DIM_SPATIAL_Y] != getSizeY() ||
+            shape[DIM_SPATIAL_Z] != zCount || shape[DIM_CHANNEL] != cCount ||
+            shape[DIM_TEMPORAL_T] != tCount)
+          {
+            boost::format fmt("VariantPixelBuffer dimensions incompatible with stack size %1%×%2%×%3%×%4%×%5%");
+            fmt % getSizeX() % getSizeY() % zCount % cCount % tCount;
+            throw FormatException(fmt.str());
+          }
+
+        const DimensionIndexer indexer(metadataRetrieve->getPixelsDimensionOrder(getSeries()),
+                                       getSizeZ(),
+                                       getEffectiveSizeC(),
+                                       getSizeT(),
+                                       getImageCount());
+
+        std::vector<stack_plane> planes;
+        planes.reserve(zCount * cCount * tCount);
+        for (dimension_size_type t = 0U; t < tCount; ++t)
+          for (dimension_size_type c = 0U; c < cCount; ++c)
+            for (dimension_size_type z = 0U; z < zCount; ++z)
+              planes.push_back(stack_plane(indexer.index(zRange[0] + z, cRange[0] + c, tRange[0] + t),
+                                           {{z, c, t}}));
+
+        // Planes are saved in index order, so that writers
+        // requiring sequential writes may write the stack.
+        std::sort(planes.begin(), planes.end(),
+                  [](const stack_plane& lhs, const stack_plane& rhs)
+                  { return lhs.first < rhs.first; });
+
+        return planes;
+      }
+
+      VariantPixelBufferView
+      FormatWriter::stackPlaneView(VariantPixelBuffer& buf,
+                                   const stack_plane&  plane)
+      {
+        typedef VariantPixelBufferView::indices_type::value_type index_type;
+
+        VariantPixelBufferView::indices_type offset;
+        offset.fill(0);
+        offset[DIM_SPATIAL_Z] = static_cast<index_type>(plane.second[0]);
+        offset[DIM_CHANNEL] = static_cast<index_type>(plane.second[1]);
+        offset[DIM_TEMPORAL_T] = static_cast<index_type>(plane.second[2]);
+        VariantPixelBufferView::extents_type extents;
+        std::copy(buf.shape(), buf.shape() + PixelBufferBase::dimensions, extents.begin());
+        extents[DIM_SPATIAL_Z] = extents[DIM_CHANNEL] = extents[DIM_TEMPORAL_T] = 1U;
+
+        return VariantPixelBufferView(buf, offset, extents);
+      }
+
+      void
+      FormatWriter::saveRawTile(dimension_size_type /* plane */,
+                                dimension_size_type /* tile */,
+                                const uint8_t       * /* data */,
+                                dimension_size_type /* size */)
+      {
+        assertId(currentId, true);
+        throw std::runtime_error("Writer does not implement raw tile access");
+      }
+
+      void
+      FormatWriter::saveTile(dimension_size_type       /* plane */,
+                             dimension_size_type       /* tile */,
+                             const VariantPixelBuffer& /* buf */)
+      {
+        assertId(currentId, true);
+        throw std::runtime_error("Writer does not implement native tile access");
+      }
+
+      void
+      FormatWriter::mapBytes(dimension_size_type /* plane */,
+                             VariantPixelBuffer& /* buf */)
+      {
+        assertId(currentId, true);
+        throw std::runtime_error("Writer does not implement memory mapped planes");
+      }
+
       void
       FormatWriter::setSeries(dimension_size_type series) const
       {
@@ -341,6 +522,80 @@ namespace ome
         return sequential;
       }
 
+      void
+      FormatWriter::setWriteThreads(unsigned int threads)
+      {
+        writeThreads = threads ? threads : 1U;
+      }
+
+      unsigned int
+      FormatWriter::getWriteThreads() const
+      {
+        return writeThreads;
+      }
+
+      void
+      FormatWriter::setExecutor(const std::shared_ptr<Executor>& executor)
+      {
+        this->executor = executor;
+      }
+
+      std::shared_ptr<Executor>
+      FormatWriter::getExecutor() const
+      {
+        std::shared_ptr<Executor> current(executor);
+        return current ? current : Executor::global();
+      }
+
+      void
+      FormatWriter::setWriteQueueDepth(dimension_size_type depth)
+      {
+        assertId(currentId, false);
+
+        writeQueueDepth = depth;
+      }
+
+      dimension_size_type
+      FormatWriter::getWriteQueueDepth() const
+      {
+        return writeQueueDepth;
+      }
+
+      void
+      FormatWriter::flush()
+      {
+      }
+
+      std::shared_ptr<VariantPixelBuffer>
+      FormatWriter::copyWriteBuffer(const VariantPixelBuffer& buf)
+      {
+        if (!writeBufferPool)
+          writeBufferPool = PixelBufferPoolAllocator::create();
+
+        std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> extents;
+        std::copy(buf.shape(), buf.shape() + PixelBufferBase::dimensions, extents.begin());
+
+        std::shared_ptr<VariantPixelBuffer> copy(std::make_shared<VariantPixelBuffer>());
+        copy->setBuffer(extents, buf.pixelType(), buf.storage_order(), writeBufferPool);
+        *copy = buf;
+        return copy;
+      }
+
+      std::shared_ptr<VariantPixelBuffer>
+      FormatWriter::copyWriteBuffer(const VariantPixelBufferView& buf)
+      {
+        if (!writeBufferPool)
+          writeBufferPool = PixelBufferPoolAllocator::create();
+
+        std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> extents;
+        std::copy(buf.shape(), buf.shape() + PixelBufferBase::dimensions, extents.begin());
+
+        std::shared_ptr<VariantPixelBuffer> copy(std::make_shared<VariantPixelBuffer>());
+        copy->setBuffer(extents, buf.pixelType(), PixelBufferBase::default_storage_order(), writeBufferPool);
+        buf.copyTo(*copy);
+        return copy;
+      }
+
       void
       FormatWriter::setMetadataRetrieve(std::shared_ptr<::ome::xml::meta::MetadataRetrieve>& retrieve)
       {
@@ -479,24 +734,26 @@ namespace ome
                              dimension_size_type t) const
       {
         assertId(currentId, true);
-        return ome::files::getIndex(getDimensionOrder(),
-                                         getSizeZ(),
-                                         getEffectiveSizeC(),
-                                         getSizeT(),
-                                         getImageCount(),
-                                         z, c, t);
+        const DimensionIndexer indexer(metadataRetrieve->getPixelsDimensionOrder(getSeries()),
+                                       getSizeZ(),
+                                       getEffectiveSizeC(),
+                                       getSizeT(),
+                                       getImageCount());
+        indexer.checkCoords(z, c, t);
+        return indexer.index(z, c, t);
       }
 
       std::array<dimension_size_type, 3>
       FormatWriter::getZCTCoords(dimension_size_type index) const
       {
         assertId(currentId, true);
-        return ome::files::getZCTCoords(getDimensionOrder(),
-                                             getSizeZ(),
-                                             getEffectiveSizeC(),
-                                             getSizeT(),
-                                             getImageCount(),
-                                             index);
+        const DimensionIndexer indexer(metadataRetrieve->getPixelsDimensionOrder(getSeries()),
+                                       getSizeZ(),
+                                       getEffectiveSizeC(),
+                                       getSizeT(),
+                                       getImageCount());
+        indexer.checkIndex(index);
+        return indexer.coords(index);
       }
 
       const std::string&
@@ -523,6 +780,12 @@ namespace ome
         return writerProperties.compression_suffixes;
       }
 
+      std::shared_ptr<IOStatistics>
+      FormatWriter::getIOStatistics() const
+      {
+        return ioStatistics;
+      }
+
       const std::set<std::string>&
       FormatWriter::getCompressionTypes() const
       {
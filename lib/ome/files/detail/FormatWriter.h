@@ -47,6 +47,9 @@ namespace ome
 {
   namespace files
   {
+
+    class PixelBufferPoolAllocator;
+
     namespace detail
     {
 
@@ -133,6 +136,18 @@ namespace ome
         /// Planes are written sequentially.
         bool sequential;
 
+        /// Number of threads for encoding.
+        unsigned int writeThreads;
+
+        /// Executor for parallel encoding (null for global).
+        std::shared_ptr<Executor> executor;
+
+        /// Depth of the write-behind queue.
+        dimension_size_type writeQueueDepth;
+
+        /// Storage pool for buffers copied into the write-behind queue.
+        std::shared_ptr<PixelBufferPoolAllocator> writeBufferPool;
+
         /// The frames per second to use when writing.
         frame_rate_type framesPerSecond;
 
@@ -148,6 +163,9 @@ namespace ome
          */
         std::shared_ptr<::ome::xml::meta::MetadataRetrieve> metadataRetrieve;
 
+        /// I/O statistics.
+        std::shared_ptr<IOStatistics> ioStatistics;
+
         /// Constructor.
         FormatWriter(const WriterProperties&);
 
@@ -192,6 +210,72 @@ namespace ome
         saveBytes(dimension_size_type plane,
                   VariantPixelBuffer& buf);
 
+        // Documented in superclass.
+        void
+        saveBytes(dimension_size_type  plane,
+                  VariantPixelBuffer&& buf);
+
+        /**
+         * @copydoc files::FormatWriter::saveBytes(dimension_size_type,VariantPixelBuffer&&,dimension_size_type,dimension_size_type,dimension_size_type,dimension_size_type)
+         *
+         * The default implementation saves the buffer as for a
+         * buffer which is not given up.  Writers which can avoid
+         * copying the buffer should override this.
+         */
+        void
+        saveBytes(dimension_size_type  plane,
+                  VariantPixelBuffer&& buf,
+                  dimension_size_type  x,
+                  dimension_size_type  y,
+                  dimension_size_type  w,
+                  dimension_size_type  h);
+
+        /**
+         * @copydoc files::FormatWriter::saveBytes(dimension_size_type,const VariantPixelBufferView&,dimension_size_type,dimension_size_type,dimension_size_type,dimension_size_type)
+         *
+         * The default implementation copies the view into a
+         * temporary pixel buffer and saves it.  Writers which can
+         * write a view directly should override this.
+         */
+        void
+        saveBytes(dimension_size_type            plane,
+                  const VariantPixelBufferView& buf,
+                  dimension_size_type            x,
+                  dimension_size_type            y,
+                  dimension_size_type            w,
+                  dimension_size_type            h);
+
+        /**
+         * @copydoc files::FormatWriter::saveBytesStack()
+         *
+         * The default implementation saves a view of each plane in
+         * turn.
+         */
+        void
+        saveBytesStack(dimension_size_type series,
+                       const plane_range&  zRange,
+                       const plane_range&  cRange,
+                       const plane_range&  tRange,
+                       VariantPixelBuffer& buf);
+
+        // Documented in superclass.
+        void
+        saveRawTile(dimension_size_type plane,
+                    dimension_size_type tile,
+                    const uint8_t       *data,
+                    dimension_size_type size);
+
+        // Documented in superclass.
+        void
+        saveTile(dimension_size_type       plane,
+                 dimension_size_type       tile,
+                 const VariantPixelBuffer& buf);
+
+        // Documented in superclass.
+        void
+        mapBytes(dimension_size_type plane,
+                 VariantPixelBuffer& buf);
+
         // Documented in superclass.
         void
         setSeries(dimension_size_type series) const;
@@ -427,6 +511,107 @@ namespace ome
         bool
         getWriteSequentially() const;
 
+        // Documented in superclass.
+        void
+        setWriteThreads(unsigned int threads);
+
+        // Documented in superclass.
+        unsigned int
+        getWriteThreads() const;
+
+        // Documented in superclass.
+        void
+        setExecutor(const std::shared_ptr<Executor>& executor);
+
+        // Documented in superclass.
+        std::shared_ptr<Executor>
+        getExecutor() const;
+
+        // Documented in superclass.
+        void
+        setWriteQueueDepth(dimension_size_type depth);
+
+        // Documented in superclass.
+        dimension_size_type
+        getWriteQueueDepth() const;
+
+        // Documented in superclass.
+        void
+        flush();
+
+      protected:
+        /// A plane of a stack: the plane index and the Z, C and T offsets within the stack.
+        typedef std::pair<dimension_size_type, std::array<dimension_size_type, 3>> stack_plane;
+
+        /**
+         * Get the planes of a stack for saveBytesStack().
+         *
+         * The ranges are checked against the current series, and the
+         * buffer shape against the ranges and image size.
+         *
+         * @param zRange the @c Z coordinates (real size).
+         * @param cRange the @c C coordinates (effective size).
+         * @param tRange the @c T coordinates (real size).
+         * @param buf the stack pixel buffer.
+         * @returns the planes, in plane index order.
+         * @throws FormatException if the buffer shape does not match
+         * the ranges.
+         * @throws std::logic_error if any range is empty or outside
+         * the image.
+         */
+        std::vector<stack_plane>
+        stackPlanes(const plane_range&        zRange,
+                    const plane_range&        cRange,
+                    const plane_range&        tRange,
+                    const VariantPixelBuffer& buf) const;
+
+        /**
+         * Get a view of one plane of a stack.
+         *
+         * @param buf the stack pixel buffer.
+         * @param plane the plane of the stack.
+         * @returns a view of the plane.
+         */
+        static VariantPixelBufferView
+        stackPlaneView(VariantPixelBuffer& buf,
+                       const stack_plane&  plane);
+
+        /**
+         * Copy a pixel buffer for the write-behind queue.
+         *
+         * The copy has the same shape, pixel type and storage order
+         * as the source, and uses pooled storage which is reused
+         * once the queued write is complete.
+         *
+         * @param buf the buffer to copy.
+         * @returns the copy.
+         */
+        std::shared_ptr<VariantPixelBuffer>
+        copyWriteBuffer(const VariantPixelBuffer& buf);
+
+        /**
+         * Copy a pixel buffer view for the write-behind queue.
+         *
+         * @param buf the buffer view to copy.
+         * @returns the copy, using the default storage order.
+         */
+        std::shared_ptr<VariantPixelBuffer>
+        copyWriteBuffer(const VariantPixelBufferView& buf);
+
+        /**
+         * Set the current file from an already canonical path.
+         *
+         * This is setId() without the cost of canonicalizing the
+         * path, for writers which switch between files they have
+         * already opened.
+         *
+         * @param canonicalpath the canonical path of the file.
+         */
+        void
+        setCanonicalId(const boost::filesystem::path& canonicalpath);
+
+      public:
+
         // Documented in superclass.
         void
         setId(const boost::filesystem::path& id);
@@ -451,6 +636,10 @@ namespace ome
         const std::vector<boost::filesystem::path>&
         getCompressionSuffixes() const;
 
+        // Documented in superclass.
+        std::shared_ptr<IOStatistics>
+        getIOStatistics() const;
+
         // Documented in superclass.
         dimension_size_type
         setTileSizeX(boost::optional<dimension_size_type> size);
@@ -0,0 +1,168 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+
+#if defined(__F16C__)
+# include <immintrin.h>
+# define OME_FILES_HALFFLOAT_F16C 1
+#endif
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+# include <arm_neon.h>
+# define OME_FILES_HALFFLOAT_NEON 1
+#endif
+
+#include <ome/files/detail/HalfFloat.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        float
+        as_float(uint32_t bits)
+        {
+          float f;
+          std::memcpy(&f, &bits, sizeof(f));
+          return f;
+        }
+
+        uint32_t
+        as_uint(float f)
+        {
+          uint32_t bits;
+          std::memcpy(&bits, &f, sizeof(bits));
+          return bits;
+        }
+
+        // Exact conversion; subnormals are normalised by a float
+        // subtraction.
+        float
+        half_to_float(uint16_t h)
+        {
+          const uint32_t shifted_exp = 0x7C00U << 13;
+          uint32_t o = static_cast<uint32_t>(h & 0x7FFFU) << 13;
+          const uint32_t exp = shifted_exp & o;
+          o += (127U - 15U) << 23;
+          if (exp == shifted_exp) // Infinity or NaN
+            o += (128U - 16U) << 23;
+          else if (exp == 0U) // Zero or subnormal
+            {
+              o += 1U << 23;
+              o = as_uint(as_float(o) - as_float(113U << 23));
+            }
+          return as_float(o | (static_cast<uint32_t>(h & 0x8000U) << 16));
+        }
+
+        // Round to nearest even; subnormals are rounded by a float
+        // addition, which relies upon the default rounding mode.
+        uint16_t
+        float_to_half(float f)
+        {
+          uint32_t x = as_uint(f);
+          const uint32_t sign = x & 0x80000000U;
+          x ^= sign;
+
+          uint32_t o;
+          if (x >= 0x47800000U) // Infinity or NaN
+            o = (x > 0x7F800000U) ? 0x7E00U : 0x7C00U;
+          else if (x < 0x38800000U) // Zero or subnormal
+            o = as_uint(as_float(x) + as_float(126U << 23)) - (126U << 23);
+          else
+            {
+              const uint32_t odd = (x >> 13) & 1U;
+              x += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFFU + odd;
+              o = x >> 13;
+            }
+          return static_cast<uint16_t>(o | (sign >> 16));
+        }
+
+      }
+
+      void
+      halfToFloat(const uint16_t      *src,
+                  float               *dest,
+                  dimension_size_type  count)
+      {
+        dimension_size_type i = 0;
+
+#if defined(OME_FILES_HALFFLOAT_F16C)
+        for (; i + 8 <= count; i += 8)
+          {
+            __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            _mm256_storeu_ps(dest + i, _mm256_cvtph_ps(h));
+          }
+#elif defined(OME_FILES_HALFFLOAT_NEON)
+        for (; i + 4 <= count; i += 4)
+          vst1q_f32(dest + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+#endif
+
+        for (; i < count; ++i)
+          dest[i] = half_to_float(src[i]);
+      }
+
+      void
+      floatToHalf(const float         *src,
+                  uint16_t            *dest,
+                  dimension_size_type  count)
+      {
+        dimension_size_type i = 0;
+
+#if defined(OME_FILES_HALFFLOAT_F16C)
+        for (; i + 8 <= count; i += 8)
+          {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), h);
+          }
+#elif defined(OME_FILES_HALFFLOAT_NEON)
+        for (; i + 4 <= count; i += 4)
+          vst1_u16(dest + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+#endif
+
+        for (; i < count; ++i)
+          dest[i] = float_to_half(src[i]);
+      }
+
+    }
+  }
+}
@@ -0,0 +1,98 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_HALFFLOAT_H
+#define OME_FILES_DETAIL_HALFFLOAT_H
+
+#include <cstdint>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Convert half-precision (IEEE 754 binary16) values to float.
+       *
+       * The conversion is exact.  F16C or NEON instructions are used
+       * where available.  The data need not be aligned.
+       *
+       * @param src the half-precision values.
+       * @param dest the destination; must have space for @c count
+       * values.
+       * @param count the number of values to convert.
+       */
+      void
+      halfToFloat(const uint16_t      *src,
+                  float               *dest,
+                  dimension_size_type  count);
+
+      /**
+       * Convert float values to half precision (IEEE 754 binary16).
+       *
+       * Values are rounded to the nearest half-precision value, with
+       * ties to even.  Values too large for half precision become
+       * infinities, and values too small become subnormals or zero.
+       * F16C or NEON instructions are used where available.  The
+       * data need not be aligned.
+       *
+       * @param src the float values.
+       * @param dest the destination; must have space for @c count
+       * values.
+       * @param count the number of values to convert.
+       */
+      void
+      floatToHalf(const float         *src,
+                  uint16_t            *dest,
+                  dimension_size_type  count);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_HALFFLOAT_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
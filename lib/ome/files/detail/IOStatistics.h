@@ -0,0 +1,78 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_IOSTATISTICS_H
+#define OME_FILES_DETAIL_IOSTATISTICS_H
+
+#include <ome/files/IOStatistics.h>
+#include <ome/files/config-internal.h>
+
+/**
+ * @def OME_FILES_IO_COUNT(stats, counter, value)
+ * Add @p value to IOStatistics::Counter @p counter of @p stats (if
+ * not null).
+ *
+ * @def OME_FILES_IO_TIME(name, stats, timer)
+ * Time IOStatistics::Timer @p timer of @p stats (if not null) until
+ * the end of the enclosing scope, using a timer variable @p name.
+ *
+ * Both expand to nothing if the library was built without the
+ * @c io-statistics option.
+ */
+#ifdef OME_FILES_IO_STATISTICS
+# define OME_FILES_IO_COUNT(stats, counter, value)                      \
+  do                                                                    \
+    {                                                                   \
+      if (stats)                                                        \
+        (stats)->add(::ome::files::IOStatistics::counter, (value));     \
+    }                                                                   \
+  while (false)
+# define OME_FILES_IO_TIME(name, stats, timer)                          \
+  ::ome::files::IOStatistics::ScopedTimer name((stats), ::ome::files::IOStatistics::timer)
+#else
+# define OME_FILES_IO_COUNT(stats, counter, value) do {} while (false)
+# define OME_FILES_IO_TIME(name, stats, timer) do {} while (false)
+#endif
+
+#endif // OME_FILES_DETAIL_IOSTATISTICS_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
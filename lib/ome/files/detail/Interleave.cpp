@@ -0,0 +1,646 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define OME_FILES_INTERLEAVE_SSE2 1
+#endif
+#if defined(__SSSE3__)
+# include <tmmintrin.h>
+# define OME_FILES_INTERLEAVE_SSSE3 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define OME_FILES_INTERLEAVE_NEON 1
+#endif
+
+#include <ome/files/detail/Interleave.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        // Bytes of each sample plane in a block.
+        const std::size_t block_bytes = 16U;
+
+        // Transpose a block of N samples of S bytes.  Unspecialised
+        // sample counts and sizes are not vectorised.
+        template<std::size_t N, std::size_t S>
+        struct Block
+        {
+          static const bool supported = false;
+
+          static void
+          deinterleave(const uint8_t  * /* src */,
+                       uint8_t *const * /* dest */)
+          {
+          }
+
+          static void
+          interleave(const uint8_t *const * /* src */,
+                     uint8_t              * /* dest */)
+          {
+          }
+        };
+
+#if defined(OME_FILES_INTERLEAVE_SSE2)
+
+        inline __m128i
+        load(const uint8_t *p)
+        {
+          return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        }
+
+        inline void
+        store(uint8_t *p,
+              __m128i  v)
+        {
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+        }
+
+        // Split the values of S bytes of two vectors into the even
+        // and odd values.
+        template<std::size_t S>
+        void
+        split(__m128i  v0,
+              __m128i  v1,
+              __m128i& even,
+              __m128i& odd);
+
+        template<>
+        inline void
+        split<1U>(__m128i  v0,
+                  __m128i  v1,
+                  __m128i& even,
+                  __m128i& odd)
+        {
+          const __m128i low = _mm_set1_epi16(0x00FF);
+          even = _mm_packus_epi16(_mm_and_si128(v0, low), _mm_and_si128(v1, low));
+          odd = _mm_packus_epi16(_mm_srli_epi16(v0, 8), _mm_srli_epi16(v1, 8));
+        }
+
+        // Sign extended, so that signed saturation is exact.
+        template<>
+        inline void
+        split<2U>(__m128i  v0,
+                  __m128i  v1,
+                  __m128i& even,
+                  __m128i& odd)
+        {
+          even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(v0, 16), 16),
+                                 _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16));
+          odd = _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(v1, 16));
+        }
+
+        template<>
+        inline void
+        split<4U>(__m128i  v0,
+                  __m128i  v1,
+                  __m128i& even,
+                  __m128i& odd)
+        {
+          const __m128 f0 = _mm_castsi128_ps(v0);
+          const __m128 f1 = _mm_castsi128_ps(v1);
+          even = _mm_castps_si128(_mm_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0)));
+          odd = _mm_castps_si128(_mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+
+        template<>
+        inline void
+        split<8U>(__m128i  v0,
+                  __m128i  v1,
+                  __m128i& even,
+                  __m128i& odd)
+        {
+          even = _mm_unpacklo_epi64(v0, v1);
+          odd = _mm_unpackhi_epi64(v0, v1);
+        }
+
+        template<>
+        inline void
+        split<16U>(__m128i  v0,
+                   __m128i  v1,
+                   __m128i& even,
+                   __m128i& odd)
+        {
+          even = v0;
+          odd = v1;
+        }
+
+        // Interleave the values of S bytes of two vectors; the
+        // inverse of split().
+        template<std::size_t S>
+        void
+        zip(__m128i  a,
+            __m128i  b,
+            __m128i& lo,
+            __m128i& hi);
+
+        template<>
+        inline void
+        zip<1U>(__m128i  a,
+                __m128i  b,
+                __m128i& lo,
+                __m128i& hi)
+        {
+          lo = _mm_unpacklo_epi8(a, b);
+          hi = _mm_unpackhi_epi8(a, b);
+        }
+
+        template<>
+        inline void
+        zip<2U>(__m128i  a,
+                __m128i  b,
+                __m128i& lo,
+                __m128i& hi)
+        {
+          lo = _mm_unpacklo_epi16(a, b);
+          hi = _mm_unpackhi_epi16(a, b);
+        }
+
+        template<>
+        inline void
+        zip<4U>(__m128i  a,
+                __m128i  b,
+                __m128i& lo,
+                __m128i& hi)
+        {
+          lo = _mm_unpacklo_epi32(a, b);
+          hi = _mm_unpackhi_epi32(a, b);
+        }
+
+        template<>
+        inline void
+        zip<8U>(__m128i  a,
+                __m128i  b,
+                __m128i& lo,
+                __m128i& hi)
+        {
+          lo = _mm_unpacklo_epi64(a, b);
+          hi = _mm_unpackhi_epi64(a, b);
+        }
+
+        template<>
+        inline void
+        zip<16U>(__m128i  a,
+                 __m128i  b,
+                 __m128i& lo,
+                 __m128i& hi)
+        {
+          lo = a;
+          hi = b;
+        }
+
+        template<std::size_t S>
+        struct Block<2U, S>
+        {
+          static const bool supported = true;
+
+          static void
+          deinterleave(const uint8_t  *src,
+                       uint8_t *const *dest)
+          {
+            __m128i a, b;
+            split<S>(load(src), load(src + 16), a, b);
+            store(dest[0], a);
+            store(dest[1], b);
+          }
+
+          static void
+          interleave(const uint8_t *const *src,
+                     uint8_t              *dest)
+          {
+            __m128i lo, hi;
+            zip<S>(load(src[0]), load(src[1]), lo, hi);
+            store(dest, lo);
+            store(dest + 16, hi);
+          }
+        };
+
+        // Four samples are split into pairs of samples, and then
+        // into single samples.
+        template<std::size_t S>
+        struct Block<4U, S>
+        {
+          static const bool supported = true;
+
+          static void
+          deinterleave(const uint8_t  *src,
+                       uint8_t *const *dest)
+          {
+            __m128i ab0, cd0, ab1, cd1, a, b, c, d;
+            split<S * 2U>(load(src), load(src + 16), ab0, cd0);
+            split<S * 2U>(load(src + 32), load(src + 48), ab1, cd1);
+            split<S>(ab0, ab1, a, b);
+            split<S>(cd0, cd1, c, d);
+            store(dest[0], a);
+            store(dest[1], b);
+            store(dest[2], c);
+            store(dest[3], d);
+          }
+
+          static void
+          interleave(const uint8_t *const *src,
+                     uint8_t              *dest)
+          {
+            __m128i ab0, ab1, cd0, cd1, v0, v1, v2, v3;
+            zip<S>(load(src[0]), load(src[1]), ab0, ab1);
+            zip<S>(load(src[2]), load(src[3]), cd0, cd1);
+            zip<S * 2U>(ab0, cd0, v0, v1);
+            zip<S * 2U>(ab1, cd1, v2, v3);
+            store(dest, v0);
+            store(dest + 16, v1);
+            store(dest + 32, v2);
+            store(dest + 48, v3);
+          }
+        };
+
+        template<>
+        struct Block<3U, 4U>
+        {
+          static const bool supported = true;
+
+          static void
+          deinterleave(const uint8_t  *src,
+                       uint8_t *const *dest)
+          {
+            const __m128 v0 = _mm_castsi128_ps(load(src));
+            const __m128 v1 = _mm_castsi128_ps(load(src + 16));
+            const __m128 v2 = _mm_castsi128_ps(load(src + 32));
+            const __m128 a = _mm_shuffle_ps(v0, _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 1, 2, 2)),
+                                            _MM_SHUFFLE(2, 0, 3, 0));
+            const __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 1, 1)),
+                                            _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3)),
+                                            _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 c = _mm_shuffle_ps(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2)), v2,
+                                            _MM_SHUFFLE(3, 0, 2, 0));
+            store(dest[0], _mm_castps_si128(a));
+            store(dest[1], _mm_castps_si128(b));
+            store(dest[2], _mm_castps_si128(c));
+          }
+
+          static void
+          interleave(const uint8_t *const *src,
+                     uint8_t              *dest)
+          {
+            const __m128 a = _mm_castsi128_ps(load(src[0]));
+            const __m128 b = _mm_castsi128_ps(load(src[1]));
+            const __m128 c = _mm_castsi128_ps(load(src[2]));
+            const __m128 v0 = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 0)),
+                                             _mm_shuffle_ps(c, a, _MM_SHUFFLE(1, 1, 0, 0)),
+                                             _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 v1 = _mm_shuffle_ps(_mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 1, 1)),
+                                             _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 2, 2, 2)),
+                                             _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 v2 = _mm_shuffle_ps(_mm_shuffle_ps(c, a, _MM_SHUFFLE(3, 3, 2, 2)),
+                                             _mm_shuffle_ps(b, c, _MM_SHUFFLE(3, 3, 3, 3)),
+                                             _MM_SHUFFLE(2, 0, 2, 0));
+            store(dest, _mm_castps_si128(v0));
+            store(dest + 16, _mm_castps_si128(v1));
+            store(dest + 32, _mm_castps_si128(v2));
+          }
+        };
+
+        template<>
+        struct Block<3U, 8U>
+        {
+          static const bool supported = true;
+
+          static void
+          deinterleave(const uint8_t  *src,
+                       uint8_t *const *dest)
+          {
+            const __m128d v0 = _mm_castsi128_pd(load(src));
+            const __m128d v1 = _mm_castsi128_pd(load(src + 16));
+            const __m128d v2 = _mm_castsi128_pd(load(src + 32));
+            store(dest[0], _mm_castpd_si128(_mm_shuffle_pd(v0, v1, 2)));
+            store(dest[1], _mm_castpd_si128(_mm_shuffle_pd(v0, v2, 1)));
+            store(dest[2], _mm_castpd_si128(_mm_shuffle_pd(v1, v2, 2)));
+          }
+
+          static void
+          interleave(const uint8_t *const *src,
+                     uint8_t              *dest)
+          {
+            const __m128d a = _mm_castsi128_pd(load(src[0]));
+            const __m128d b = _mm_castsi128_pd(load(src[1]));
+            const __m128d c = _mm_castsi128_pd(load(src[2]));
+            store(dest, _mm_castpd_si128(_mm_shuffle_pd(a, b, 0)));
+            store(dest + 16, _mm_castpd_si128(_mm_shuffle_pd(c, a, 2)));
+            store(dest + 32, _mm_castpd_si128(_mm_shuffle_pd(b, c, 3)));
+          }
+        };
+
+# if defined(OME_FILES_INTERLEAVE_SSSE3)
+
+        // Byte shuffles for three samples of S bytes.  Each output
+        // vector is the combination of a shuffle of each input
+        // vector, with bytes from other vectors zeroed.
+        template<std::size_t S>
+        struct Shuffles3
+        {
+          // Plane k from source vector v.
+          uint8_t deinterleave[3][3][16];
+          // Destination vector v from plane k.
+          uint8_t interleave[3][3][16];
+
+          Shuffles3()
+          {
+            for (std::size_t k = 0; k < 3U; ++k)
+              for (std::size_t v = 0; v < 3U; ++v)
+                for (std::size_t q = 0; q < 16U; ++q)
+                  {
+                    const std::size_t p = ((((q / S) * 3U) + k) * S) + (q % S);
+                    deinterleave[k][v][q] = static_cast<uint8_t>(p / 16U == v ? p % 16U : 0x80U);
+
+                    const std::size_t e = ((v * 16U) + q) / S;
+                    interleave[v][k][q] = static_cast<uint8_t>(e % 3U == k ? ((e / 3U) * S) + (q % S) : 0x80U);
+                  }
+          }
+        };
+
+        template<std::size_t S>
+        const Shuffles3<S>&
+        shuffles3()
+        {
+          static const Shuffles3<S> shuffles;
+          return shuffles;
+        }
+
+        template<std::size_t S>
+        struct SSSE3Block3
+        {
+          static const bool supported = true;
+
+          static void
+          deinterleave(const uint8_t  *src,
+                       uint8_t *const *dest)
+          {
+            const Shuffles3<S>& s(shuffles3<S>());
+            const __m128i v[3] = {load(src), load(src + 16), load(src + 32)};
+            for (std::size_t k = 0; k < 3U; ++k)
+              store(dest[k],
+                    _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v[0], load(s.deinterleave[k][0])),
+                                              _mm_shuffle_epi8(v[1], load(s.deinterleave[k][1]))),
+                                 _mm_shuffle_epi8(v[2], load(s.deinterleave[k][2]))));
+          }
+
+          static void
+          interleave(const uint8_t *const *src,
+                     uint8_t              *dest)
+          {
+            const Shuffles3<S>& s(shuffles3<S>());
+            const __m128i p[3] = {load(src[0]), load(src[1]), load(src[2])};
+            for (std::size_t v = 0; v < 3U; ++v)
+              store(dest + (v * 16U),
+                    _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p[0], load(s.interleave[v][0])),
+                                              _mm_shuffle_epi8(p[1], load(s.interleave[v][1]))),
+                                 _mm_shuffle_epi8(p[2], load(s.interleave[v][2]))));
+          }
+        };
+
+        template<>
+        struct Block<3U, 1U> : SSSE3Block3<1U>
+        {
+        };
+
+        template<>
+        struct Block<3U, 2U> : SSSE3Block3<2U>
+        {
+        };
+
+# endif
+
+#elif defined(OME_FILES_INTERLEAVE_NEON)
+
+        // The structure loads and stores transpose N samples
+        // directly.
+# define OME_FILES_INTERLEAVE_NEON_BLOCK(N, S, E, V, SUFFIX)                      \
+        template<>                                                              \
+        struct Block<N, S>                                                      \
+        {                                                                       \
+          static const bool supported = true;                                   \
+                                                                                \
+          static void                                                           \
+          deinterleave(const uint8_t  *src,                                     \
+                       uint8_t *const *dest)                                    \
+          {                                                                     \
+            const V v = vld##N##q_##SUFFIX(reinterpret_cast<const E *>(src));   \
+            for (std::size_t k = 0; k < N; ++k)                                 \
+              vst1q_##SUFFIX(reinterpret_cast<E *>(dest[k]), v.val[k]);         \
+          }                                                                     \
+                                                                                \
+          static void                                                           \
+          interleave(const uint8_t *const *src,                                 \
+                     uint8_t              *dest)                                \
+          {                                                                     \
+            V v;                                                                \
+            for (std::size_t k = 0; k < N; ++k)                                 \
+              v.val[k] = vld1q_##SUFFIX(reinterpret_cast<const E *>(src[k]));   \
+            vst##N##q_##SUFFIX(reinterpret_cast<E *>(dest), v);                 \
+          }                                                                     \
+        }
+
+        OME_FILES_INTERLEAVE_NEON_BLOCK(2, 1, uint8_t, uint8x16x2_t, u8);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(3, 1, uint8_t, uint8x16x3_t, u8);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(4, 1, uint8_t, uint8x16x4_t, u8);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(2, 2, uint16_t, uint16x8x2_t, u16);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(3, 2, uint16_t, uint16x8x3_t, u16);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(4, 2, uint16_t, uint16x8x4_t, u16);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(2, 4, uint32_t, uint32x4x2_t, u32);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(3, 4, uint32_t, uint32x4x3_t, u32);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(4, 4, uint32_t, uint32x4x4_t, u32);
+# if defined(__aarch64__)
+        OME_FILES_INTERLEAVE_NEON_BLOCK(2, 8, uint64_t, uint64x2x2_t, u64);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(3, 8, uint64_t, uint64x2x3_t, u64);
+        OME_FILES_INTERLEAVE_NEON_BLOCK(4, 8, uint64_t, uint64x2x4_t, u64);
+# endif
+
+# undef OME_FILES_INTERLEAVE_NEON_BLOCK
+
+#endif
+
+        template<std::size_t N, std::size_t S>
+        std::size_t
+        deinterleave(const uint8_t *src,
+                     uint8_t       *dest,
+                     std::size_t    destld,
+                     std::size_t    pixels)
+        {
+          if (!Block<N, S>::supported)
+            return 0U;
+
+          const std::size_t step = block_bytes / S;
+          std::size_t i = 0;
+          for (; i + step <= pixels; i += step)
+            {
+              uint8_t *planes[N];
+              for (std::size_t k = 0; k < N; ++k)
+                planes[k] = dest + (((k * destld) + i) * S);
+              Block<N, S>::deinterleave(src + (i * N * S), planes);
+            }
+          return i;
+        }
+
+        template<std::size_t N, std::size_t S>
+        std::size_t
+        interleave(const uint8_t *src,
+                   std::size_t    srcld,
+                   uint8_t       *dest,
+                   std::size_t    pixels)
+        {
+          if (!Block<N, S>::supported)
+            return 0U;
+
+          const std::size_t step = block_bytes / S;
+          std::size_t i = 0;
+          for (; i + step <= pixels; i += step)
+            {
+              const uint8_t *planes[N];
+              for (std::size_t k = 0; k < N; ++k)
+                planes[k] = src + (((k * srcld) + i) * S);
+              Block<N, S>::interleave(planes, dest + (i * N * S));
+            }
+          return i;
+        }
+
+        template<std::size_t N>
+        std::size_t
+        deinterleave_size(const uint8_t *src,
+                          uint8_t       *dest,
+                          std::size_t    destld,
+                          std::size_t    pixels,
+                          std::size_t    size)
+        {
+          switch (size)
+            {
+            case 1U:
+              return deinterleave<N, 1U>(src, dest, destld, pixels);
+            case 2U:
+              return deinterleave<N, 2U>(src, dest, destld, pixels);
+            case 4U:
+              return deinterleave<N, 4U>(src, dest, destld, pixels);
+            case 8U:
+              return deinterleave<N, 8U>(src, dest, destld, pixels);
+            default:
+              return 0U;
+            }
+        }
+
+        template<std::size_t N>
+        std::size_t
+        interleave_size(const uint8_t *src,
+                        std::size_t    srcld,
+                        uint8_t       *dest,
+                        std::size_t    pixels,
+                        std::size_t    size)
+        {
+          switch (size)
+            {
+            case 1U:
+              return interleave<N, 1U>(src, srcld, dest, pixels);
+            case 2U:
+              return interleave<N, 2U>(src, srcld, dest, pixels);
+            case 4U:
+              return interleave<N, 4U>(src, srcld, dest, pixels);
+            case 8U:
+              return interleave<N, 8U>(src, srcld, dest, pixels);
+            default:
+              return 0U;
+            }
+        }
+
+      }
+
+      std::size_t
+      deinterleaveSamples(const void  *src,
+                          void        *dest,
+                          std::size_t  destld,
+                          std::size_t  pixels,
+                          std::size_t  samples,
+                          std::size_t  size)
+      {
+        const uint8_t *s = static_cast<const uint8_t *>(src);
+        uint8_t *d = static_cast<uint8_t *>(dest);
+        switch (samples)
+          {
+          case 2U:
+            return deinterleave_size<2U>(s, d, destld, pixels, size);
+          case 3U:
+            return deinterleave_size<3U>(s, d, destld, pixels, size);
+          case 4U:
+            return deinterleave_size<4U>(s, d, destld, pixels, size);
+          default:
+            return 0U;
+          }
+      }
+
+      std::size_t
+      interleaveSamples(const void  *src,
+                        std::size_t  srcld,
+                        void        *dest,
+                        std::size_t  pixels,
+                        std::size_t  samples,
+                        std::size_t  size)
+      {
+        const uint8_t *s = static_cast<const uint8_t *>(src);
+        uint8_t *d = static_cast<uint8_t *>(dest);
+        switch (samples)
+          {
+          case 2U:
+            return interleave_size<2U>(s, srcld, d, pixels, size);
+          case 3U:
+            return interleave_size<3U>(s, srcld, d, pixels, size);
+          case 4U:
+            return interleave_size<4U>(s, srcld, d, pixels, size);
+          default:
+            return 0U;
+          }
+      }
+
+    }
+  }
+}
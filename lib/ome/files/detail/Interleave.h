@@ -0,0 +1,117 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_INTERLEAVE_H
+#define OME_FILES_DETAIL_INTERLEAVE_H
+
+#include <cstddef>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Deinterleave pixel samples with SIMD instructions.
+       *
+       * Each source pixel of @p samples contiguous samples of @p
+       * size bytes is split into the sample planes, which are @p
+       * destld samples apart.  Whole blocks of pixels are
+       * deinterleaved, and the number of pixels deinterleaved is
+       * returned; the caller deinterleaves the remainder.
+       *
+       * Two and four samples of 1, 2, 4 or 8 bytes use SSE2.
+       * Three samples use SSE2 for 4 and 8 bytes, and SSSE3 for 1
+       * and 2 bytes.  With NEON, two to four samples of 1, 2 and 4
+       * bytes, and of 8 bytes on AArch64, are supported.  Nothing
+       * is deinterleaved for other sample counts and sizes, or
+       * without SIMD instructions.  The data need not be aligned.
+       *
+       * @param src the first source pixel.
+       * @param dest the first sample of the first destination plane.
+       * @param destld the distance between destination planes, in samples.
+       * @param pixels the number of pixels.
+       * @param samples the number of samples per pixel.
+       * @param size the size of each sample, in bytes.
+       * @returns the number of pixels deinterleaved.
+       */
+      std::size_t
+      deinterleaveSamples(const void  *src,
+                          void        *dest,
+                          std::size_t  destld,
+                          std::size_t  pixels,
+                          std::size_t  samples,
+                          std::size_t  size);
+
+      /**
+       * Interleave pixel samples with SIMD instructions.
+       *
+       * The inverse of deinterleaveSamples(): the sample planes,
+       * which are @p srcld samples apart, are combined into pixels
+       * of @p samples contiguous samples.  The same sample counts
+       * and sizes are supported.
+       *
+       * @param src the first sample of the first source plane.
+       * @param srcld the distance between source planes, in samples.
+       * @param dest the first destination pixel.
+       * @param pixels the number of pixels.
+       * @param samples the number of samples per pixel.
+       * @param size the size of each sample, in bytes.
+       * @returns the number of pixels interleaved.
+       */
+      std::size_t
+      interleaveSamples(const void  *src,
+                        std::size_t  srcld,
+                        void        *dest,
+                        std::size_t  pixels,
+                        std::size_t  samples,
+                        std::size_t  size);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_INTERLEAVE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
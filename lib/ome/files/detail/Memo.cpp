@@ -0,0 +1,476 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/detail/Memo.h>
+
+using ome::files::CoreMetadata;
+using ome::files::MetadataMap;
+using ome::files::Modulo;
+using ome::files::FormatException;
+using ome::files::detail::MemoReader;
+using ome::files::detail::MemoWriter;
+
+namespace
+{
+
+  /**
+   * Scalar types storable in a MetadataMap.
+   *
+   * The type of each value is stored as twice its index in this
+   * list, plus one for a vector of the type.
+   */
+  typedef std::tuple<std::string,
+                     bool,
+                     uint8_t,
+                     uint16_t,
+                     uint32_t,
+                     uint64_t,
+                     int8_t,
+                     int16_t,
+                     int32_t,
+                     int64_t,
+                     float,
+                     double,
+                     long double> scalar_types;
+
+  /// Index of a type in a tuple of types.
+  template<typename T, typename Tuple>
+  struct TypeIndex;
+
+  /// Index of a type in a tuple of types (match).
+  template<typename T, typename... Types>
+  struct TypeIndex<T, std::tuple<T, Types...>> :
+    std::integral_constant<std::size_t, 0U>
+  {
+  };
+
+  /// Index of a type in a tuple of types (no match).
+  template<typename T, typename U, typename... Types>
+  struct TypeIndex<T, std::tuple<U, Types...>> :
+    std::integral_constant<std::size_t, 1U + TypeIndex<T, std::tuple<Types...>>::value>
+  {
+  };
+
+  void
+  writeScalar(MemoWriter&        memo,
+              const std::string& value)
+  {
+    memo.writeString(value);
+  }
+
+  void
+  writeScalar(MemoWriter& memo,
+              bool        value)
+  {
+    memo.writeBool(value);
+  }
+
+  template<typename T>
+  void
+  writeScalar(MemoWriter& memo,
+              const T&    value)
+  {
+    memo.writeBytes(&value, sizeof(T));
+  }
+
+  void
+  readScalar(MemoReader&  memo,
+             std::string& value)
+  {
+    value = memo.readString();
+  }
+
+  void
+  readScalar(MemoReader& memo,
+             bool&       value)
+  {
+    value = memo.readBool();
+  }
+
+  template<typename T>
+  void
+  readScalar(MemoReader& memo,
+             T&          value)
+  {
+    memo.readBytes(&value, sizeof(T));
+  }
+
+  /// Write a MetadataMap value with its type.
+  struct ValueWriter
+  {
+    MemoWriter& memo;
+
+    ValueWriter(MemoWriter& memo):
+      memo(memo)
+    {}
+
+    template<typename T>
+    void
+    operator() (const T& value) const
+    {
+      memo.writeUInt(TypeIndex<T, scalar_types>::value * 2U);
+      writeScalar(memo, value);
+    }
+
+    template<typename T>
+    void
+    operator() (const std::vector<T>& value) const
+    {
+      memo.writeUInt((TypeIndex<T, scalar_types>::value * 2U) + 1U);
+      memo.writeUInt(value.size());
+      for (const auto& v : value)
+        writeScalar(memo, static_cast<T>(v));
+    }
+  };
+
+  /// Read a MetadataMap value of the given type (no match).
+  template<std::size_t I>
+  typename std::enable_if<I == std::tuple_size<scalar_types>::value, MetadataMap::value_type>::type
+  readValue(MemoReader&         /* memo */,
+            uint64_t            type)
+  {
+    boost::format fmt("Invalid memo metadata value type %1%");
+    fmt % type;
+    throw FormatException(fmt.str());
+  }
+
+  /// Read a MetadataMap value of the given type.
+  template<std::size_t I>
+  typename std::enable_if<(I < std::tuple_size<scalar_types>::value), MetadataMap::value_type>::type
+  readValue(MemoReader& memo,
+            uint64_t    type)
+  {
+    typedef typename std::tuple_element<I, scalar_types>::type value_type;
+
+    if (type == I * 2U)
+      {
+        value_type value;
+        readScalar(memo, value);
+        return MetadataMap::value_type(value);
+      }
+    else if (type == (I * 2U) + 1U)
+      {
+        std::vector<value_type> values;
+        const uint64_t count = memo.readCount();
+        values.reserve(static_cast<typename std::vector<value_type>::size_type>(count));
+        for (uint64_t i = 0; i < count; ++i)
+          {
+            value_type value;
+            readScalar(memo, value);
+            values.push_back(value);
+          }
+        return MetadataMap::value_type(values);
+      }
+    return readValue<I + 1U>(memo, type);
+  }
+
+  void
+  writeModulo(MemoWriter&   memo,
+              const Modulo& modulo)
+  {
+    memo.writeString(modulo.parentDimension);
+    memo.writeDouble(modulo.start);
+    memo.writeDouble(modulo.step);
+    memo.writeDouble(modulo.end);
+    memo.writeString(modulo.parentType);
+    memo.writeString(modulo.type);
+    memo.writeString(modulo.typeDescription);
+    memo.writeString(modulo.unit);
+    memo.writeUInt(modulo.labels.size());
+    for (const auto& label : modulo.labels)
+      memo.writeString(label);
+  }
+
+  void
+  readModulo(MemoReader& memo,
+             Modulo&     modulo)
+  {
+    modulo.parentDimension = memo.readString();
+    modulo.start = memo.readDouble();
+    modulo.step = memo.readDouble();
+    modulo.end = memo.readDouble();
+    modulo.parentType = memo.readString();
+    modulo.type = memo.readString();
+    modulo.typeDescription = memo.readString();
+    modulo.unit = memo.readString();
+    modulo.labels.clear();
+    const uint64_t count = memo.readCount(sizeof(uint64_t));
+    for (uint64_t i = 0; i < count; ++i)
+      modulo.labels.push_back(memo.readString());
+  }
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      MemoWriter::MemoWriter(std::ostream& stream):
+        stream(stream)
+      {
+      }
+
+      void
+      MemoWriter::writeUInt(uint64_t value)
+      {
+        writeBytes(&value, sizeof(value));
+      }
+
+      void
+      MemoWriter::writeInt(int64_t value)
+      {
+        writeBytes(&value, sizeof(value));
+      }
+
+      void
+      MemoWriter::writeBool(bool value)
+      {
+        const uint8_t byte = value ? 1U : 0U;
+        writeBytes(&byte, sizeof(byte));
+      }
+
+      void
+      MemoWriter::writeDouble(double value)
+      {
+        writeBytes(&value, sizeof(value));
+      }
+
+      void
+      MemoWriter::writeString(const std::string& value)
+      {
+        writeUInt(value.size());
+        writeBytes(value.data(), value.size());
+      }
+
+      void
+      MemoWriter::writeBytes(const void  *data,
+                             std::size_t  size)
+      {
+        if (!stream.write(reinterpret_cast<const char *>(data),
+                          static_cast<std::streamsize>(size)))
+          throw FormatException("Failed to write memo");
+      }
+
+      void
+      MemoWriter::writeCoreMetadata(const CoreMetadata& core)
+      {
+        writeUInt(core.sizeX);
+        writeUInt(core.sizeY);
+        writeUInt(core.sizeZ);
+        writeUInt(core.sizeC.size());
+        for (const auto& samples : core.sizeC)
+          writeUInt(samples);
+        writeUInt(core.sizeT);
+        writeUInt(core.thumbSizeX);
+        writeUInt(core.thumbSizeY);
+        writeString(core.pixelType);
+        writeUInt(core.bitsPerPixel);
+        writeUInt(core.imageCount);
+        writeModulo(*this, core.moduloZ);
+        writeModulo(*this, core.moduloT);
+        writeModulo(*this, core.moduloC);
+        writeString(core.dimensionOrder);
+        writeBool(core.orderCertain);
+        writeBool(core.littleEndian);
+        writeBool(core.interleaved);
+        writeBool(core.indexed);
+        writeBool(core.falseColor);
+        writeBool(core.metadataComplete);
+        writeMetadataMap(core.seriesMetadata);
+        writeBool(core.thumbnail);
+        writeUInt(core.resolutionCount);
+      }
+
+      void
+      MemoWriter::writeMetadataMap(const MetadataMap& map)
+      {
+        writeUInt(map.size());
+        ValueWriter v(*this);
+        for (const auto& item : map)
+          {
+            writeString(item.first);
+            ome::compat::visit(v, item.second);
+          }
+      }
+
+      MemoReader::MemoReader(std::istream& stream):
+        stream(stream),
+        remaining(0U)
+      {
+        const std::streamoff start = stream.tellg();
+        stream.seekg(0, std::ios::end);
+        const std::streamoff end = stream.tellg();
+        stream.seekg(start);
+        if (!stream || start < 0 || end < start)
+          throw FormatException("Failed to determine memo size");
+        remaining = static_cast<uint64_t>(end - start);
+      }
+
+      uint64_t
+      MemoReader::readUInt()
+      {
+        uint64_t value;
+        readBytes(&value, sizeof(value));
+        return value;
+      }
+
+      int64_t
+      MemoReader::readInt()
+      {
+        int64_t value;
+        readBytes(&value, sizeof(value));
+        return value;
+      }
+
+      bool
+      MemoReader::readBool()
+      {
+        uint8_t byte;
+        readBytes(&byte, sizeof(byte));
+        if (byte > 1U)
+          throw FormatException("Invalid memo boolean");
+        return byte != 0U;
+      }
+
+      double
+      MemoReader::readDouble()
+      {
+        double value;
+        readBytes(&value, sizeof(value));
+        return value;
+      }
+
+      std::string
+      MemoReader::readString()
+      {
+        std::string value(static_cast<std::string::size_type>(readCount()), '\0');
+        if (!value.empty())
+          readBytes(&value[0], value.size());
+        return value;
+      }
+
+      void
+      MemoReader::readBytes(void        *data,
+                            std::size_t  size)
+      {
+        if (size > remaining ||
+            !stream.read(reinterpret_cast<char *>(data),
+                         static_cast<std::streamsize>(size)))
+          throw FormatException("Truncated memo");
+        remaining -= size;
+      }
+
+      uint64_t
+      MemoReader::readCount(std::size_t elementSize)
+      {
+        const uint64_t count = readUInt();
+        if (elementSize && count > remaining / elementSize)
+          throw FormatException("Invalid memo element count");
+        return count;
+      }
+
+      void
+      MemoReader::readCoreMetadata(CoreMetadata& core)
+      {
+        core.sizeX = readUInt();
+        core.sizeY = readUInt();
+        core.sizeZ = readUInt();
+        core.sizeC.clear();
+        const uint64_t channels = readCount(sizeof(uint64_t));
+        for (uint64_t i = 0; i < channels; ++i)
+          core.sizeC.push_back(readUInt());
+        core.sizeT = readUInt();
+        core.thumbSizeX = readUInt();
+        core.thumbSizeY = readUInt();
+        const std::string pixelType(readString());
+        core.bitsPerPixel = static_cast<pixel_size_type>(readUInt());
+        core.imageCount = readUInt();
+        readModulo(*this, core.moduloZ);
+        readModulo(*this, core.moduloT);
+        readModulo(*this, core.moduloC);
+        const std::string dimensionOrder(readString());
+        core.orderCertain = readBool();
+        core.littleEndian = readBool();
+        core.interleaved = readBool();
+        core.indexed = readBool();
+        core.falseColor = readBool();
+        core.metadataComplete = readBool();
+        core.seriesMetadata.clear();
+        readMetadataMap(core.seriesMetadata);
+        core.thumbnail = readBool();
+        core.resolutionCount = readUInt();
+
+        try
+          {
+            core.pixelType = ome::xml::model::enums::PixelType(pixelType);
+            core.dimensionOrder = ome::xml::model::enums::DimensionOrder(dimensionOrder);
+          }
+        catch (const std::exception&)
+          {
+            boost::format fmt("Invalid memo pixel type ‘%1%’ or dimension order ‘%2%’");
+            fmt % pixelType % dimensionOrder;
+            throw FormatException(fmt.str());
+          }
+      }
+
+      void
+      MemoReader::readMetadataMap(MetadataMap& map)
+      {
+        const uint64_t count = readCount(sizeof(uint64_t) * 2U);
+        for (uint64_t i = 0; i < count; ++i)
+          {
+            const std::string key(readString());
+            const uint64_t type = readUInt();
+            map.set(key, readValue<0U>(*this, type));
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,274 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_MEMO_H
+#define OME_FILES_DETAIL_MEMO_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/MetadataMap.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Binary memo writer.
+       *
+       * Writes the values making up a saved reader state.  Values
+       * are stored in native byte order without any padding or
+       * alignment; a memo is only readable on the system which
+       * wrote it.
+       */
+      class MemoWriter
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param stream the stream to write to.
+         */
+        MemoWriter(std::ostream& stream);
+
+        /**
+         * Write an unsigned integer.
+         *
+         * @param value the value to write.
+         */
+        void
+        writeUInt(uint64_t value);
+
+        /**
+         * Write a signed integer.
+         *
+         * @param value the value to write.
+         */
+        void
+        writeInt(int64_t value);
+
+        /**
+         * Write a boolean.
+         *
+         * @param value the value to write.
+         */
+        void
+        writeBool(bool value);
+
+        /**
+         * Write a floating point number.
+         *
+         * @param value the value to write.
+         */
+        void
+        writeDouble(double value);
+
+        /**
+         * Write a string.
+         *
+         * @param value the value to write.
+         */
+        void
+        writeString(const std::string& value);
+
+        /**
+         * Write raw bytes.
+         *
+         * @param data the data to write.
+         * @param size the size of the data (bytes).
+         */
+        void
+        writeBytes(const void  *data,
+                   std::size_t  size);
+
+        /**
+         * Write core metadata.
+         *
+         * @param core the core metadata to write.
+         */
+        void
+        writeCoreMetadata(const CoreMetadata& core);
+
+        /**
+         * Write a metadata map.
+         *
+         * @param map the metadata map to write.
+         */
+        void
+        writeMetadataMap(const MetadataMap& map);
+
+      private:
+        /// The stream to write to.
+        std::ostream& stream;
+      };
+
+      /**
+       * Binary memo reader.
+       *
+       * Reads the values written by MemoWriter, in the same order.
+       * Reading past the end of the memo, or a length exceeding the
+       * remaining size of the memo, is an error, so that a truncated
+       * or corrupt memo can not cause excessive allocation.
+       */
+      class MemoReader
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param stream the stream to read from; must be seekable.
+         * @throws FormatException if the stream size can not be
+         * determined.
+         */
+        MemoReader(std::istream& stream);
+
+        /**
+         * Read an unsigned integer.
+         *
+         * @returns the value.
+         * @throws FormatException if the memo is truncated.
+         */
+        uint64_t
+        readUInt();
+
+        /**
+         * Read a signed integer.
+         *
+         * @returns the value.
+         * @throws FormatException if the memo is truncated.
+         */
+        int64_t
+        readInt();
+
+        /**
+         * Read a boolean.
+         *
+         * @returns the value.
+         * @throws FormatException if the memo is truncated.
+         */
+        bool
+        readBool();
+
+        /**
+         * Read a floating point number.
+         *
+         * @returns the value.
+         * @throws FormatException if the memo is truncated.
+         */
+        double
+        readDouble();
+
+        /**
+         * Read a string.
+         *
+         * @returns the value.
+         * @throws FormatException if the memo is truncated.
+         */
+        std::string
+        readString();
+
+        /**
+         * Read raw bytes.
+         *
+         * @param data the buffer to fill.
+         * @param size the size of the data (bytes).
+         * @throws FormatException if the memo is truncated.
+         */
+        void
+        readBytes(void        *data,
+                  std::size_t  size);
+
+        /**
+         * Read an element count.
+         *
+         * The count is checked against the remaining size of the
+         * memo, assuming each element occupies at least @p
+         * elementSize bytes.
+         *
+         * @param elementSize the minimum size of each element (bytes).
+         * @returns the count.
+         * @throws FormatException if the memo is truncated or the
+         * count is too large.
+         */
+        uint64_t
+        readCount(std::size_t elementSize = 1U);
+
+        /**
+         * Read core metadata.
+         *
+         * @param core the core metadata to set.
+         * @throws FormatException if the memo is truncated or
+         * invalid.
+         */
+        void
+        readCoreMetadata(CoreMetadata& core);
+
+        /**
+         * Read a metadata map.
+         *
+         * @param map the metadata map to fill.
+         * @throws FormatException if the memo is truncated or
+         * invalid.
+         */
+        void
+        readMetadataMap(MetadataMap& map);
+
+      private:
+        /// The stream to read from.
+        std::istream& stream;
+        /// Remaining size of the memo (bytes).
+        uint64_t remaining;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_MEMO_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,204 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define OME_FILES_NORMALIZE_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define OME_FILES_NORMALIZE_NEON 1
+#endif
+
+#include <ome/files/detail/Normalize.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        // Apply a block operation to whole 16-byte blocks of the
+        // data, returning the number of values processed.
+        template<typename T, typename Block>
+        inline dimension_size_type
+        blocks(T                   *data,
+               dimension_size_type  count,
+               Block                block)
+        {
+          const dimension_size_type lanes = 16U / sizeof(T);
+          dimension_size_type i = 0;
+          for (; i + lanes <= count; i += lanes)
+            block(data + i);
+          return i;
+        }
+
+        // Normalize with SIMD instructions, returning the number of
+        // values processed.  Unspecialised types are not
+        // vectorised.
+        template<typename T>
+        dimension_size_type
+        simd_normalize(T                   * /* data */,
+                       dimension_size_type   /* count */,
+                       T                     /* min */,
+                       T                     /* scale */)
+        {
+          return 0U;
+        }
+
+#if defined(OME_FILES_NORMALIZE_SSE2)
+
+        // MAXPS and MINPS return the second operand if either is
+        // NaN, so passing the value second keeps NaN, as for the
+        // scalar comparisons.
+
+        template<>
+        dimension_size_type
+        simd_normalize<float>(float               *data,
+                              dimension_size_type  count,
+                              float                min,
+                              float                scale)
+        {
+          const __m128 vmin = _mm_set1_ps(min);
+          const __m128 vscale = _mm_set1_ps(scale);
+          const __m128 zero = _mm_setzero_ps();
+          const __m128 one = _mm_set1_ps(1.0f);
+          return blocks(data, count, [&](float *p)
+                        {
+                          const __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p), vmin), vscale);
+                          _mm_storeu_ps(p, _mm_min_ps(one, _mm_max_ps(zero, v)));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_normalize<double>(double              *data,
+                               dimension_size_type  count,
+                               double               min,
+                               double               scale)
+        {
+          const __m128d vmin = _mm_set1_pd(min);
+          const __m128d vscale = _mm_set1_pd(scale);
+          const __m128d zero = _mm_setzero_pd();
+          const __m128d one = _mm_set1_pd(1.0);
+          return blocks(data, count, [&](double *p)
+                        {
+                          const __m128d v = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(p), vmin), vscale);
+                          _mm_storeu_pd(p, _mm_min_pd(one, _mm_max_pd(zero, v)));
+                        });
+        }
+
+#elif defined(OME_FILES_NORMALIZE_NEON)
+
+        // Clamp by selecting with comparisons, which are false for
+        // NaN, so that NaN is kept, as for the scalar comparisons.
+
+        template<>
+        dimension_size_type
+        simd_normalize<float>(float               *data,
+                              dimension_size_type  count,
+                              float                min,
+                              float                scale)
+        {
+          const float32x4_t vmin = vdupq_n_f32(min);
+          const float32x4_t vscale = vdupq_n_f32(scale);
+          const float32x4_t zero = vdupq_n_f32(0.0f);
+          const float32x4_t one = vdupq_n_f32(1.0f);
+          return blocks(data, count, [&](float *p)
+                        {
+                          float32x4_t v = vmulq_f32(vsubq_f32(vld1q_f32(p), vmin), vscale);
+                          v = vbslq_f32(vcltq_f32(v, zero), zero, v);
+                          vst1q_f32(p, vbslq_f32(vcgtq_f32(v, one), one, v));
+                        });
+        }
+
+# if defined(__aarch64__)
+
+        // Double precision vectors are only available on AArch64.
+
+        template<>
+        dimension_size_type
+        simd_normalize<double>(double              *data,
+                               dimension_size_type  count,
+                               double               min,
+                               double               scale)
+        {
+          const float64x2_t vmin = vdupq_n_f64(min);
+          const float64x2_t vscale = vdupq_n_f64(scale);
+          const float64x2_t zero = vdupq_n_f64(0.0);
+          const float64x2_t one = vdupq_n_f64(1.0);
+          return blocks(data, count, [&](double *p)
+                        {
+                          float64x2_t v = vmulq_f64(vsubq_f64(vld1q_f64(p), vmin), vscale);
+                          v = vbslq_f64(vcltq_f64(v, zero), zero, v);
+                          vst1q_f64(p, vbslq_f64(vcgtq_f64(v, one), one, v));
+                        });
+        }
+
+# endif
+
+#endif
+
+      }
+
+      template<typename T>
+      void
+      normalizeSamples(T                   *data,
+                       dimension_size_type  count,
+                       T                    min,
+                       T                    scale)
+      {
+        for (dimension_size_type i = simd_normalize(data, count, min, scale); i < count; ++i)
+          {
+            const T v = (data[i] - min) * scale;
+            // Comparisons with NaN are false, so NaN is kept.
+            data[i] = v < T(0) ? T(0) : (v > T(1) ? T(1) : v);
+          }
+      }
+
+      // Instantiated for the floating point pixel types.
+      template void normalizeSamples<float>(float *, dimension_size_type, float, float);
+      template void normalizeSamples<double>(double *, dimension_size_type, double, double);
+
+    }
+  }
+}
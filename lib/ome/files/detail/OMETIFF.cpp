@@ -0,0 +1,257 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <ome/files/detail/OMETIFF.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        typedef OMETIFFPlaneTable::Run Run;
+
+        // Find the first run ending after plane.
+        std::vector<Run>::const_iterator
+        find_run(const std::vector<Run>& runs,
+                 dimension_size_type     plane)
+        {
+          return std::upper_bound(runs.begin(), runs.end(), plane,
+                                  [](dimension_size_type pos, const Run& run)
+                                  { return pos < run.first + run.count; });
+        }
+
+        // Check if run b directly continues run a.
+        bool
+        continues(const Run& a,
+                  const Run& b)
+        {
+          return (a.first + a.count == b.first &&
+                  a.plane.file == b.plane.file &&
+                  a.plane.ifd + a.count == b.plane.ifd &&
+                  a.plane.certain == b.plane.certain &&
+                  a.plane.status == b.plane.status);
+        }
+
+      }
+
+      const OMETIFFPlane::file_index_type OMETIFFPlane::no_file;
+
+      OMETIFFFileTable::OMETIFFFileTable():
+        files(),
+        indexes()
+      {
+      }
+
+      OMETIFFPlane::file_index_type
+      OMETIFFFileTable::intern(const boost::filesystem::path& file)
+      {
+        auto i = indexes.find(file);
+        if (i != indexes.end())
+          return i->second;
+
+        if (files.size() >= OMETIFFPlane::no_file)
+          throw std::length_error("Too many OME-TIFF files");
+
+        const OMETIFFPlane::file_index_type index = static_cast<OMETIFFPlane::file_index_type>(files.size());
+        files.push_back(file);
+        indexes.insert(std::make_pair(file, index));
+        return index;
+      }
+
+      const boost::filesystem::path&
+      OMETIFFFileTable::at(OMETIFFPlane::file_index_type index) const
+      {
+        return files.at(index);
+      }
+
+      std::vector<boost::filesystem::path>::size_type
+      OMETIFFFileTable::size() const
+      {
+        return files.size();
+      }
+
+      void
+      OMETIFFFileTable::clear()
+      {
+        files.clear();
+        indexes.clear();
+      }
+
+      OMETIFFPlaneTable::OMETIFFPlaneTable():
+        planes(0U),
+        runs()
+      {
+      }
+
+      void
+      OMETIFFPlaneTable::resize(dimension_size_type planes)
+      {
+        this->planes = planes;
+        runs.clear();
+      }
+
+      dimension_size_type
+      OMETIFFPlaneTable::size() const
+      {
+        return planes;
+      }
+
+      bool
+      OMETIFFPlaneTable::empty() const
+      {
+        return !planes;
+      }
+
+      OMETIFFPlane
+      OMETIFFPlaneTable::at(dimension_size_type plane) const
+      {
+        if (plane >= planes)
+          throw std::out_of_range("Plane index out of range");
+
+        std::vector<Run>::const_iterator run(find_run(runs, plane));
+        if (run == runs.end() || run->first > plane)
+          return OMETIFFPlane();
+
+        OMETIFFPlane found(run->plane);
+        found.ifd += plane - run->first;
+        return found;
+      }
+
+      void
+      OMETIFFPlaneTable::assign(dimension_size_type first,
+                                dimension_size_type count,
+                                const OMETIFFPlane& plane)
+      {
+        if (first > planes || count > planes - first)
+          throw std::out_of_range("Plane range out of range");
+        if (!count)
+          return;
+
+        const dimension_size_type last = first + count;
+
+        // Runs overlapping the range are replaced by the new run,
+        // and the parts of the first and last overlapping runs
+        // outside the range.
+        std::vector<Run>::size_type begin = static_cast<std::vector<Run>::size_type>(find_run(runs, first) - runs.begin());
+        std::vector<Run>::size_type end = begin;
+        while (end < runs.size() && runs[end].first < last)
+          ++end;
+
+        std::vector<Run> replacement;
+        if (begin != end && runs[begin].first < first)
+          {
+            Run head(runs[begin]);
+            head.count = first - head.first;
+            replacement.push_back(head);
+          }
+        const std::vector<Run>::size_type current = begin + replacement.size();
+        replacement.push_back(Run{first, count, plane});
+        if (begin != end && runs[end - 1].first + runs[end - 1].count > last)
+          {
+            Run tail(runs[end - 1]);
+            tail.count = tail.first + tail.count - last;
+            tail.plane.ifd += last - tail.first;
+            tail.first = last;
+            replacement.push_back(tail);
+          }
+
+        runs.erase(runs.begin() + begin, runs.begin() + end);
+        runs.insert(runs.begin() + begin, replacement.begin(), replacement.end());
+
+        // Merge with adjacent runs which continue the new run.
+        if (current + 1 < runs.size() && continues(runs[current], runs[current + 1]))
+          {
+            runs[current].count += runs[current + 1].count;
+            runs.erase(runs.begin() + current + 1);
+          }
+        if (current > 0 && continues(runs[current - 1], runs[current]))
+          {
+            runs[current - 1].count += runs[current].count;
+            runs.erase(runs.begin() + current);
+          }
+      }
+
+      dimension_size_type
+      OMETIFFPlaneTable::fill(dimension_size_type first,
+                              const OMETIFFPlane& plane)
+      {
+        if (first >= planes)
+          return 0U;
+
+        // Stop at the next certain plane.
+        std::vector<Run>::const_iterator run(find_run(runs, first));
+        while (run != runs.end() && !run->plane.certain)
+          ++run;
+        const dimension_size_type last = run != runs.end() ? std::max(first, run->first) : planes;
+
+        OMETIFFPlane filled(plane);
+        filled.certain = false;
+        assign(first, last - first, filled);
+        return last - first;
+      }
+
+      dimension_size_type
+      OMETIFFPlaneTable::firstUnset() const
+      {
+        dimension_size_type next = 0U;
+        for (const auto& run : runs)
+          {
+            if (run.first > next)
+              break;
+            next = run.first + run.count;
+          }
+        return next;
+      }
+
+      const std::vector<Run>&
+      OMETIFFPlaneTable::getRuns() const
+      {
+        return runs;
+      }
+
+    }
+  }
+}
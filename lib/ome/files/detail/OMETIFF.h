@@ -38,6 +38,10 @@
 #ifndef OME_FILES_DETAIL_OMETIFF_H
 #define OME_FILES_DETAIL_OMETIFF_H
 
+#include <cstdint>
+#include <map>
+#include <vector>
+
 #include <boost/filesystem/path.hpp>
 
 #include <ome/files/Types.h>
@@ -51,6 +55,10 @@ namespace ome
 
       /**
        * Metadata for a single plane within an OME-TIFF file set.
+       *
+       * The file containing the plane is stored as an index into an
+       * OMETIFFFileTable, so that the path of each file is only
+       * stored once however many planes it contains.
        */
       class OMETIFFPlane
       {
@@ -63,8 +71,14 @@ namespace ome
             ABSENT   ///< File is missing.
           };
 
+        /// Index of a file in an OMETIFFFileTable.
+        typedef uint32_t file_index_type;
+
+        /// File index of a plane not contained in any file.
+        static const file_index_type no_file = UINT32_MAX;
+
         /// File containing this plane.
-        boost::filesystem::path id;
+        file_index_type file;
         /// IFD index.
         dimension_size_type ifd;
         /// Certainty flag, for dealing with unspecified NumPlanes.
@@ -75,11 +89,11 @@ namespace ome
         /**
          * Default constructor.
          *
-         * File and IFD are default constructed; order is uncertain;
+         * No file; IFD is default constructed; order is uncertain;
          * status is unknown.
          */
         OMETIFFPlane():
-          id(),
+          file(no_file),
           ifd(),
           certain(false),
           status(UNKNOWN)
@@ -87,15 +101,16 @@ namespace ome
         }
 
         /**
-         * Construct with filename.
+         * Construct with file index.
          *
-         * @param id the TIFF file containing this plane.
+         * @param file the index of the TIFF file containing this
+         * plane.
          *
          * IFD is default constructed; order is uncertain; status is
          * unknown.
          */
-        OMETIFFPlane(const boost::filesystem::path& id):
-          id(id),
+        OMETIFFPlane(file_index_type file):
+          file(file),
           ifd(),
           certain(false),
           status(UNKNOWN)
@@ -103,6 +118,175 @@ namespace ome
         }
       };
 
+      /**
+       * Table of the files of an OME-TIFF file set.
+       *
+       * Each file path is interned once, and referred to by its
+       * index.
+       */
+      class OMETIFFFileTable
+      {
+      public:
+        /// Constructor.
+        OMETIFFFileTable();
+
+        /**
+         * Get the index of a file, adding it if not present.
+         *
+         * @param file the file path.
+         * @returns the index of the file.
+         * @throws std::length_error if the table is full.
+         */
+        OMETIFFPlane::file_index_type
+        intern(const boost::filesystem::path& file);
+
+        /**
+         * Get the path of a file.
+         *
+         * @param index the index of the file.
+         * @returns the file path.
+         * @throws std::out_of_range if the index is invalid.
+         */
+        const boost::filesystem::path&
+        at(OMETIFFPlane::file_index_type index) const;
+
+        /**
+         * Get the number of files.
+         *
+         * @returns the number of files.
+         */
+        std::vector<boost::filesystem::path>::size_type
+        size() const;
+
+        /// Remove all files.
+        void
+        clear();
+
+      private:
+        /// File paths, by index.
+        std::vector<boost::filesystem::path> files;
+        /// File indexes, by path.
+        std::map<boost::filesystem::path, OMETIFFPlane::file_index_type> indexes;
+      };
+
+      /**
+       * Run-length encoded table of the planes of an image series.
+       *
+       * Consecutive planes in the same file, at consecutive IFDs and
+       * with the same certainty and status, are stored as a single
+       * run, as described by a TiffData element with a PlaneCount.
+       * The size of the table is proportional to the number of runs
+       * rather than the number of planes, and a plane is found by
+       * binary search of the runs.  Planes not in any run are unset.
+       */
+      class OMETIFFPlaneTable
+      {
+      public:
+        /// A run of consecutive planes.
+        struct Run
+        {
+          /// Index of the first plane.
+          dimension_size_type first;
+          /// Number of planes.
+          dimension_size_type count;
+          /// The first plane; following planes are at following IFDs.
+          OMETIFFPlane plane;
+        };
+
+        /// Constructor.
+        OMETIFFPlaneTable();
+
+        /**
+         * Set the number of planes.
+         *
+         * All planes are unset.
+         *
+         * @param planes the number of planes.
+         */
+        void
+        resize(dimension_size_type planes);
+
+        /**
+         * Get the number of planes.
+         *
+         * @returns the number of planes.
+         */
+        dimension_size_type
+        size() const;
+
+        /**
+         * Check if the table has no planes.
+         *
+         * @returns @c true if empty, @c false otherwise.
+         */
+        bool
+        empty() const;
+
+        /**
+         * Get a plane.
+         *
+         * @param plane the plane index.
+         * @returns the plane; an unset plane has no file.
+         * @throws std::out_of_range if the index is invalid.
+         */
+        OMETIFFPlane
+        at(dimension_size_type plane) const;
+
+        /**
+         * Set a range of planes.
+         *
+         * Any planes previously set in the range are replaced.
+         *
+         * @param first the index of the first plane.
+         * @param count the number of planes.
+         * @param plane the first plane; following planes are at
+         * following IFDs.
+         * @throws std::out_of_range if the range is invalid.
+         */
+        void
+        assign(dimension_size_type first,
+               dimension_size_type count,
+               const OMETIFFPlane& plane);
+
+        /**
+         * Fill down uncertain planes.
+         *
+         * Planes are set from @p first up to the next certain plane
+         * or the end of the table, with the certainty flag cleared.
+         *
+         * @param first the index of the first plane.
+         * @param plane the first plane; following planes are at
+         * following IFDs.
+         * @returns the number of planes filled.
+         */
+        dimension_size_type
+        fill(dimension_size_type first,
+             const OMETIFFPlane& plane);
+
+        /**
+         * Get the first unset plane.
+         *
+         * @returns the index of the first unset plane, or size() if
+         * all planes are set.
+         */
+        dimension_size_type
+        firstUnset() const;
+
+        /**
+         * Get the runs of planes.
+         *
+         * @returns the runs, ordered by first plane.
+         */
+        const std::vector<Run>&
+        getRuns() const;
+
+      private:
+        /// Number of planes.
+        dimension_size_type planes;
+        /// Runs of set planes, ordered by first plane.
+        std::vector<Run> runs;
+      };
+
     }
   }
 }
@@ -0,0 +1,565 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#include <ome/files/detail/OMEXMLScan.h>
+
+namespace
+{
+
+  typedef std::map<std::string, std::string> attribute_map;
+
+  const char *whitespace = " \t\r\n";
+
+  // Strip any namespace prefix.
+  std::string
+  localName(const std::string& qname)
+  {
+    std::string::size_type colon = qname.rfind(':');
+    return colon == std::string::npos ? qname : qname.substr(colon + 1);
+  }
+
+  // Append a code point as UTF-8.
+  void
+  appendUTF8(std::string& str,
+             unsigned long cp)
+  {
+    if (cp < 0x80UL)
+      str += static_cast<char>(cp);
+    else if (cp < 0x800UL)
+      {
+        str += static_cast<char>(0xC0UL | (cp >> 6));
+        str += static_cast<char>(0x80UL | (cp & 0x3FUL));
+      }
+    else if (cp < 0x10000UL)
+      {
+        str += static_cast<char>(0xE0UL | (cp >> 12));
+        str += static_cast<char>(0x80UL | ((cp >> 6) & 0x3FUL));
+        str += static_cast<char>(0x80UL | (cp & 0x3FUL));
+      }
+    else
+      {
+        str += static_cast<char>(0xF0UL | (cp >> 18));
+        str += static_cast<char>(0x80UL | ((cp >> 12) & 0x3FUL));
+        str += static_cast<char>(0x80UL | ((cp >> 6) & 0x3FUL));
+        str += static_cast<char>(0x80UL | (cp & 0x3FUL));
+      }
+  }
+
+  // Replace character and predefined entity references.
+  std::string
+  decode(const std::string& value)
+  {
+    if (value.find('&') == std::string::npos)
+      return value;
+
+    std::string ret;
+    ret.reserve(value.size());
+
+    for (std::string::size_type i = 0; i < value.size(); ++i)
+      {
+        std::string::size_type semi;
+        if (value[i] != '&' ||
+            (semi = value.find(';', i)) == std::string::npos)
+          {
+            ret += value[i];
+            continue;
+          }
+
+        const std::string entity(value.substr(i + 1, semi - i - 1));
+        if (entity == "lt")
+          ret += '<';
+        else if (entity == "gt")
+          ret += '>';
+        else if (entity == "amp")
+          ret += '&';
+        else if (entity == "quot")
+          ret += '"';
+        else if (entity == "apos")
+          ret += '\'';
+        else if (entity.size() > 1 && entity[0] == '#')
+          {
+            bool hex = entity[1] == 'x';
+            appendUTF8(ret, std::strtoul(entity.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10));
+          }
+        else
+          {
+            // Unknown entity; keep as is.
+            ret += value.substr(i, semi - i + 1);
+          }
+        i = semi;
+      }
+
+    return ret;
+  }
+
+  ome::files::dimension_size_type
+  toSize(const std::string& value)
+  {
+    return static_cast<ome::files::dimension_size_type>(std::strtoull(value.c_str(), nullptr, 10));
+  }
+
+  std::string
+  attribute(const attribute_map& attrs,
+            const std::string&   name)
+  {
+    attribute_map::const_iterator i = attrs.find(name);
+    return i == attrs.end() ? std::string() : i->second;
+  }
+
+  // Parse the attributes of a start tag, from pos (following the
+  // element name) to the end of the tag.  Returns the position
+  // following the tag, or npos if malformed.
+  std::string::size_type
+  parseAttributes(const std::string&     text,
+                  std::string::size_type pos,
+                  attribute_map&         attrs,
+                  bool&                  empty)
+  {
+    empty = false;
+
+    while (true)
+      {
+        pos = text.find_first_not_of(whitespace, pos);
+        if (pos == std::string::npos)
+          return pos;
+
+        if (text[pos] == '>')
+          return pos + 1;
+        if (text[pos] == '/')
+          {
+            if (pos + 1 >= text.size() || text[pos + 1] != '>')
+              return std::string::npos;
+            empty = true;
+            return pos + 2;
+          }
+
+        std::string::size_type eq = text.find('=', pos);
+        if (eq == std::string::npos)
+          return eq;
+        std::string::size_type nend = text.find_last_not_of(whitespace, eq - 1);
+        if (nend == std::string::npos || nend < pos)
+          return std::string::npos;
+        const std::string name(text.substr(pos, nend - pos + 1));
+
+        std::string::size_type quote = text.find_first_not_of(whitespace, eq + 1);
+        if (quote == std::string::npos ||
+            (text[quote] != '"' && text[quote] != '\''))
+          return std::string::npos;
+        std::string::size_type vend = text.find(text[quote], quote + 1);
+        if (vend == std::string::npos)
+          return vend;
+
+        attrs[localName(name)] = decode(text.substr(quote + 1, vend - quote - 1));
+        pos = vend + 1;
+      }
+  }
+
+  // Check if markup read up to a '>' is complete.
+  bool
+  markupComplete(const std::string& markup)
+  {
+    if (markup.compare(0, 4, "<!--") == 0)
+      return markup.size() >= 7 && markup.compare(markup.size() - 3, 3, "-->") == 0;
+    if (markup.compare(0, 9, "<![CDATA[") == 0)
+      return markup.size() >= 12 && markup.compare(markup.size() - 3, 3, "]]>") == 0;
+    if (markup.compare(0, 2, "<?") == 0)
+      return markup.size() >= 4 && markup.compare(markup.size() - 2, 2, "?>") == 0;
+    if (markup.compare(0, 2, "<!") == 0)
+      return true;
+
+    // Tags end at the first '>' outside an attribute value.
+    char quote = 0;
+    for (const char c : markup)
+      {
+        if (quote)
+          {
+            if (c == quote)
+              quote = 0;
+          }
+        else if (c == '"' || c == '\'')
+          quote = c;
+      }
+    return !quote;
+  }
+
+  // Find a character in a block.
+  const char *
+  findChar(const char *begin,
+           const char *end,
+           char        c)
+  {
+    return static_cast<const char *>(std::memchr(begin, c, static_cast<std::size_t>(end - begin)));
+  }
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      bool
+      scanOMEXML(const std::string& text,
+                 OMEXMLSummary&     summary)
+      {
+        summary = OMEXMLSummary();
+
+        // Open elements (local names).
+        std::vector<std::string> open;
+        bool root = false;
+
+        std::string::size_type pos = 0;
+        while ((pos = text.find('<', pos)) != std::string::npos)
+          {
+            // Skip comments, CDATA, processing instructions and
+            // declarations.
+            const char *skip = nullptr;
+            std::string::size_type start = 0;
+            if (text.compare(pos, 4, "<!--") == 0)
+              {
+                skip = "-->";
+                start = pos + 4;
+              }
+            else if (text.compare(pos, 9, "<![CDATA[") == 0)
+              {
+                skip = "]]>";
+                start = pos + 9;
+              }
+            else if (text.compare(pos, 2, "<?") == 0)
+              {
+                skip = "?>";
+                start = pos + 2;
+              }
+            else if (text.compare(pos, 2, "<!") == 0)
+              {
+                skip = ">";
+                start = pos + 2;
+              }
+            if (skip)
+              {
+                pos = text.find(skip, start);
+                if (pos == std::string::npos)
+                  return false;
+                pos += std::char_traits<char>::length(skip);
+                continue;
+              }
+
+            // End tag.
+            if (text.compare(pos, 2, "</") == 0)
+              {
+                pos = text.find('>', pos + 2);
+                if (pos == std::string::npos || open.empty())
+                  return false;
+                ++pos;
+                open.pop_back();
+                if (open.empty())
+                  break; // End of root element.
+                continue;
+              }
+
+            // Start tag.
+            std::string::size_type nstart = pos + 1;
+            std::string::size_type nend = text.find_first_of(" \t\r\n/>", nstart);
+            if (nend == std::string::npos || nend == nstart)
+              return false;
+            const std::string name(localName(text.substr(nstart, nend - nstart)));
+
+            attribute_map attrs;
+            bool empty;
+            pos = parseAttributes(text, nend, attrs, empty);
+            if (pos == std::string::npos)
+              return false;
+
+            const std::string parent(open.empty() ? std::string() : open.back());
+
+            if (open.empty())
+              {
+                if (root || name != "OME")
+                  return false;
+                root = true;
+                summary.uuid = attribute(attrs, "UUID");
+              }
+            else if (name == "Image" && parent == "OME")
+              {
+                summary.images.push_back(OMEXMLImageSummary());
+                summary.images.back().id = attribute(attrs, "ID");
+              }
+            else if (name == "BinaryOnly" && parent == "OME")
+              {
+                summary.binaryOnlyMetadataFile = attribute(attrs, "MetadataFile");
+              }
+            else if (name == "Pixels" && parent == "Image" && !summary.images.empty())
+              {
+                OMEXMLImageSummary& image(summary.images.back());
+                image.pixelsID = attribute(attrs, "ID");
+                image.sizeX = toSize(attribute(attrs, "SizeX"));
+                image.sizeY = toSize(attribute(attrs, "SizeY"));
+                image.sizeZ = toSize(attribute(attrs, "SizeZ"));
+                image.sizeC = toSize(attribute(attrs, "SizeC"));
+                image.sizeT = toSize(attribute(attrs, "SizeT"));
+                image.pixelType = attribute(attrs, "Type");
+                image.dimensionOrder = attribute(attrs, "DimensionOrder");
+              }
+            else if (name == "Channel" && parent == "Pixels" && !summary.images.empty())
+              {
+                OMEXMLImageSummary& image(summary.images.back());
+                ++image.channelCount;
+                if (attribute(attrs, "ID").empty())
+                  ++image.channelsWithoutID;
+              }
+            else if (name == "TiffData" && parent == "Pixels" && !summary.images.empty())
+              {
+                ++summary.images.back().tiffDataCount;
+              }
+
+            if (!empty)
+              open.push_back(name);
+            else if (open.empty())
+              break; // Empty root element.
+          }
+
+        return root && open.empty();
+      }
+
+      // No switch default to avoid -Wunreachable-code errors.
+      // However, this then makes -Wswitch-default complain.  Disable
+      // temporarily.
+#ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+
+      bool
+      scanOMEXMLBinData(std::istream&               stream,
+                        std::string&                metadata,
+                        std::vector<OMEXMLBinData>& binData)
+      {
+        metadata.clear();
+        binData.clear();
+
+        enum
+          {
+            TEXT,        // Character data.
+            MARKUP,      // Tag, comment, CDATA, PI or declaration.
+            CONTENT,     // Pixels BinData content.
+            CONTENT_END  // Pixels BinData end tag.
+          } state = TEXT;
+        std::string markup;
+
+        // Open elements (local names).
+        std::vector<std::string> open;
+        bool root = false;
+        dimension_size_type images = 0U;
+
+        // Namespace prefix of the current Pixels element, and
+        // whether its BinData has been replaced.
+        std::string pixelsPrefix;
+        bool replaced = false;
+
+        std::vector<char> block(1U << 20);
+        uint64_t base = 0U;
+
+        while (stream)
+          {
+            stream.read(block.data(), static_cast<std::streamsize>(block.size()));
+            const std::streamsize count = stream.gcount();
+            if (count <= 0)
+              break;
+
+            const char *begin = block.data();
+            const char *end = begin + count;
+            const char *pos = begin;
+
+            while (pos != end)
+              {
+                switch (state)
+                  {
+                  case TEXT:
+                    {
+                      const char *lt = findChar(pos, end, '<');
+                      if (!lt)
+                        {
+                          metadata.append(pos, end);
+                          pos = end;
+                          break;
+                        }
+                      metadata.append(pos, lt);
+                      markup.assign(1, '<');
+                      pos = lt + 1;
+                      state = MARKUP;
+                    }
+                    break;
+
+                  case MARKUP:
+                    {
+                      const char *gt = findChar(pos, end, '>');
+                      if (!gt)
+                        {
+                          markup.append(pos, end);
+                          pos = end;
+                          break;
+                        }
+                      markup.append(pos, gt + 1);
+                      pos = gt + 1;
+                      if (!markupComplete(markup))
+                        break;
+                      state = TEXT;
+
+                      // Comments, CDATA, processing instructions and
+                      // declarations.
+                      if (markup[1] == '!' || markup[1] == '?')
+                        {
+                          metadata += markup;
+                          break;
+                        }
+
+                      // End tag.
+                      if (markup[1] == '/')
+                        {
+                          if (open.empty())
+                            return false;
+                          open.pop_back();
+                          metadata += markup;
+                          break;
+                        }
+
+                      // Start tag.
+                      std::string::size_type nend = markup.find_first_of(" \t\r\n/>", 1);
+                      if (nend == 1)
+                        return false;
+                      const std::string qname(markup.substr(1, nend - 1));
+                      const std::string name(localName(qname));
+
+                      attribute_map attrs;
+                      bool empty;
+                      if (parseAttributes(markup, nend, attrs, empty) == std::string::npos)
+                        return false;
+
+                      const std::string parent(open.empty() ? std::string() : open.back());
+
+                      if (open.empty())
+                        {
+                          if (root || name != "OME")
+                            return false;
+                          root = true;
+                        }
+                      else if (name == "Image" && parent == "OME")
+                        {
+                          ++images;
+                        }
+                      else if (name == "Pixels" && parent == "Image")
+                        {
+                          std::string::size_type colon = qname.rfind(':');
+                          pixelsPrefix = colon == std::string::npos ? std::string() : qname.substr(0, colon + 1);
+                          replaced = false;
+                        }
+                      else if (name == "BinData" && parent == "Pixels" && images)
+                        {
+                          OMEXMLBinData bin;
+                          bin.image = images - 1U;
+                          bin.offset = base + static_cast<uint64_t>(pos - begin);
+                          bin.compression = attribute(attrs, "Compression");
+                          const std::string bigEndian(attribute(attrs, "BigEndian"));
+                          bin.bigEndian = bigEndian == "true" || bigEndian == "1";
+                          binData.push_back(bin);
+
+                          if (!replaced)
+                            {
+                              metadata += "<" + pixelsPrefix + "MetadataOnly/>";
+                              replaced = true;
+                            }
+                          if (!empty)
+                            state = CONTENT;
+                          break;
+                        }
+
+                      if (!empty)
+                        open.push_back(name);
+                      metadata += markup;
+                    }
+                    break;
+
+                  case CONTENT:
+                    {
+                      // Base64 content ends at the end tag.
+                      const char *lt = findChar(pos, end, '<');
+                      if (!lt)
+                        {
+                          pos = end;
+                          break;
+                        }
+                      binData.back().size = base + static_cast<uint64_t>(lt - begin) - binData.back().offset;
+                      pos = lt + 1;
+                      state = CONTENT_END;
+                    }
+                    break;
+
+                  case CONTENT_END:
+                    {
+                      const char *gt = findChar(pos, end, '>');
+                      if (!gt)
+                        {
+                          pos = end;
+                          break;
+                        }
+                      pos = gt + 1;
+                      state = TEXT;
+                    }
+                    break;
+                  }
+              }
+
+            base += static_cast<uint64_t>(count);
+          }
+
+        return !stream.bad() && root && open.empty() && state == TEXT;
+      }
+
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+
+    }
+  }
+}
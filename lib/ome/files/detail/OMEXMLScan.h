@@ -0,0 +1,209 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_OMEXMLSCAN_H
+#define OME_FILES_DETAIL_OMEXMLSCAN_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Summary of the Image elements of an OME-XML document.
+       */
+      struct OMEXMLImageSummary
+      {
+        /// Image ID.
+        std::string id;
+        /// Pixels ID.
+        std::string pixelsID;
+        /// Pixels SizeX.
+        dimension_size_type sizeX;
+        /// Pixels SizeY.
+        dimension_size_type sizeY;
+        /// Pixels SizeZ.
+        dimension_size_type sizeZ;
+        /// Pixels SizeC.
+        dimension_size_type sizeC;
+        /// Pixels SizeT.
+        dimension_size_type sizeT;
+        /// Pixels Type.
+        std::string pixelType;
+        /// Pixels DimensionOrder.
+        std::string dimensionOrder;
+        /// Number of Channel elements.
+        dimension_size_type channelCount;
+        /// Number of Channel elements without an ID.
+        dimension_size_type channelsWithoutID;
+        /// Number of TiffData elements.
+        dimension_size_type tiffDataCount;
+
+        /// Constructor.
+        OMEXMLImageSummary():
+          id(),
+          pixelsID(),
+          sizeX(0U),
+          sizeY(0U),
+          sizeZ(0U),
+          sizeC(0U),
+          sizeT(0U),
+          pixelType(),
+          dimensionOrder(),
+          channelCount(0U),
+          channelsWithoutID(0U),
+          tiffDataCount(0U)
+        {
+        }
+      };
+
+      /**
+       * Summary of an OME-XML document.
+       */
+      struct OMEXMLSummary
+      {
+        /// OME UUID.
+        std::string uuid;
+        /// BinaryOnly MetadataFile (empty if not binary-only).
+        std::string binaryOnlyMetadataFile;
+        /// Images.
+        std::vector<OMEXMLImageSummary> images;
+
+        /// Constructor.
+        OMEXMLSummary():
+          uuid(),
+          binaryOnlyMetadataFile(),
+          images()
+        {
+        }
+      };
+
+      /**
+       * Scan an OME-XML document.
+       *
+       * This is a lightweight single-pass scan of the element tags,
+       * which checks that the root element is @c OME and extracts
+       * the Image, Pixels, Channel and TiffData information needed
+       * to check the type and dimensions of an OME-TIFF file set,
+       * without building a DOM or validating the document.  It is
+       * much faster than creating OME-XML metadata for documents
+       * with large annotations.  Namespace prefixes are ignored.
+       *
+       * @param text the OME-XML document.
+       * @param summary the summary to fill.
+       * @returns @c true if the document has an @c OME root element
+       * and is well formed enough to scan, @c false otherwise.
+       */
+      bool
+      scanOMEXML(const std::string& text,
+                 OMEXMLSummary&     summary);
+
+      /**
+       * Location of the content of a Pixels BinData element.
+       */
+      struct OMEXMLBinData
+      {
+        /// Index of the Image element containing the BinData.
+        dimension_size_type image;
+        /// Offset of the encoded content in the document.
+        uint64_t offset;
+        /// Size of the encoded content.
+        uint64_t size;
+        /// Compression (empty if not set).
+        std::string compression;
+        /// Big endian pixel data.
+        bool bigEndian;
+
+        /// Constructor.
+        OMEXMLBinData():
+          image(0U),
+          offset(0U),
+          size(0U),
+          compression(),
+          bigEndian(false)
+        {
+        }
+      };
+
+      /**
+       * Scan an OME-XML document for Pixels BinData elements.
+       *
+       * The document is read from the stream in blocks, in a single
+       * pass.  The markup is copied to @c metadata, except for the
+       * BinData elements of each Pixels element, which are replaced
+       * by a single MetadataOnly element so that the document
+       * remains valid.  The location of the content of each of
+       * these BinData elements is recorded in @c binData.  The
+       * content is skipped without being copied or decoded, so
+       * the cost of the scan is dominated by reading the document.
+       * Other BinData elements, for example in ROI masks, are
+       * copied unchanged.  Namespace prefixes are ignored.
+       *
+       * @param stream the stream to read the document from; offsets
+       * are relative to its initial position.
+       * @param metadata the document without Pixels BinData.
+       * @param binData the Pixels BinData elements, in document
+       * order.
+       * @returns @c true if the document has an @c OME root element
+       * and is well formed enough to scan, @c false otherwise.
+       */
+      bool
+      scanOMEXMLBinData(std::istream&               stream,
+                        std::string&                metadata,
+                        std::vector<OMEXMLBinData>& binData);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_OMEXMLSCAN_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
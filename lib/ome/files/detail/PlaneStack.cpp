@@ -0,0 +1,175 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/DimensionIndexer.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
+#include <ome/files/detail/PlaneStack.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        void
+        check_range(const char                       *dimension,
+                    const FormatReader::plane_range&  range,
+                    dimension_size_type               size)
+        {
+          if (range[0] >= range[1] || range[1] > size)
+            {
+              boost::format fmt("Invalid %1% range: [%2%, %3%)");
+              fmt % dimension % range[0] % range[1];
+              throw std::logic_error(fmt.str());
+            }
+        }
+
+      }
+
+      void
+      readPlaneStack(const CoreMetadata&              core,
+                     const FormatReader::plane_range& zRange,
+                     const FormatReader::plane_range& cRange,
+                     const FormatReader::plane_range& tRange,
+                     VariantPixelBuffer&              buf,
+                     unsigned int                     threads,
+                     Executor&                        executor,
+                     const stack_read_function&       read)
+      {
+        check_range("Z", zRange, core.sizeZ);
+        check_range("C", cRange, core.sizeC.size());
+        check_range("T", tRange, core.sizeT);
+
+        const DimensionIndexer indexer(core.dimensionOrder,
+                                       core.sizeZ,
+                                       core.sizeC.size(),
+                                       core.sizeT,
+                                       core.imageCount);
+
+        const dimension_size_type zCount = zRange[1] - zRange[0];
+        const dimension_size_type cCount = cRange[1] - cRange[0];
+        const dimension_size_type tCount = tRange[1] - tRange[0];
+        const dimension_size_type count = zCount * cCount * tCount;
+
+        // Offsets of the i-th plane within the ranges, with Z varying
+        // fastest.
+        auto offsets = [&](dimension_size_type i)
+          {
+            return DimensionIndexer::coords_type{{i % zCount,
+                                                  (i / zCount) % cCount,
+                                                  i / (zCount * cCount)}};
+          };
+
+        auto store = [&](dimension_size_type i,
+                         VariantPixelBuffer& plane)
+          {
+            if (const CancellationToken *cancel = CancellationToken::current())
+              cancel->check();
+
+            const DimensionIndexer::coords_type o(offsets(i));
+            read(indexer.index(zRange[0] + o[0], cRange[0] + o[1], tRange[0] + o[2]), plane);
+
+            VariantPixelBufferView::indices_type offset;
+            offset.fill(0);
+            offset[DIM_SPATIAL_Z] = static_cast<VariantPixelBufferView::indices_type::value_type>(o[0]);
+            offset[DIM_CHANNEL] = static_cast<VariantPixelBufferView::indices_type::value_type>(o[1]);
+            offset[DIM_TEMPORAL_T] = static_cast<VariantPixelBufferView::indices_type::value_type>(o[2]);
+            VariantPixelBufferView::extents_type extents;
+            std::copy(buf.shape(), buf.shape() + PixelBufferBase::dimensions, extents.begin());
+            extents[DIM_SPATIAL_Z] = extents[DIM_CHANNEL] = extents[DIM_TEMPORAL_T] = 1U;
+
+            VariantPixelBufferView view(buf, offset, extents);
+            view.copyFrom(plane);
+          };
+
+        // The first plane determines the shape and type of the stack.
+        VariantPixelBuffer first;
+        const DimensionIndexer::coords_type o(offsets(0U));
+        read(indexer.index(zRange[0] + o[0], cRange[0] + o[1], tRange[0] + o[2]), first);
+
+        std::array<VariantPixelBuffer::size_type, PixelBufferBase::dimensions> shape;
+        std::copy(first.shape(), first.shape() + PixelBufferBase::dimensions, shape.begin());
+        shape[DIM_SPATIAL_Z] = zCount;
+        shape[DIM_CHANNEL] = cCount;
+        shape[DIM_TEMPORAL_T] = tCount;
+        buf.setBuffer(shape, first.pixelType(), first.storage_order(), buf.allocator());
+
+        VariantPixelBufferView::extents_type extents;
+        std::copy(first.shape(), first.shape() + PixelBufferBase::dimensions, extents.begin());
+        VariantPixelBufferView::indices_type origin;
+        origin.fill(0);
+        VariantPixelBufferView(buf, origin, extents).copyFrom(first);
+
+        const dimension_size_type nthreads =
+          std::min(static_cast<dimension_size_type>(std::max(threads, 1U)),
+                   count - 1U);
+
+        if (nthreads < 2U)
+          {
+            for (dimension_size_type i = 1U; i < count; ++i)
+              store(i, first);
+            return;
+          }
+
+        // Each task reads every nthreads-th plane into its own
+        // reused buffer, and copies it into a disjoint part of the
+        // stack.
+        executor.parallel(static_cast<unsigned int>(nthreads),
+                          [&](unsigned int t)
+                          {
+                            VariantPixelBuffer plane;
+                            for (dimension_size_type i = 1U + t; i < count; i += nthreads)
+                              store(i, plane);
+                          });
+      }
+
+    }
+  }
+}
@@ -0,0 +1,110 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_PLANESTACK_H
+#define OME_FILES_DETAIL_PLANESTACK_H
+
+#include <functional>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/Executor.h>
+#include <ome/files/FormatReader.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Function to read a single plane of a stack.
+       *
+       * Called with the plane index and a buffer to read the plane
+       * into.  The buffer is reused for successive planes read by
+       * the same thread.
+       */
+      typedef std::function<void (dimension_size_type plane,
+                                  VariantPixelBuffer& buf)> stack_read_function;
+
+      /**
+       * Read several planes into a single buffer.
+       *
+       * This implements FormatReader::openBytesStack() for any
+       * reader, given the core metadata of the series and
+       * resolution and a function to read a single plane.  The
+       * first plane is read by the calling thread, to determine the
+       * pixel type, subchannel count and storage order of the
+       * destination; the remaining planes are read by up to @p
+       * threads tasks run by @p executor, each copying its planes
+       * into their place in the destination.
+       *
+       * @param core the core metadata of the series and resolution.
+       * @param zRange the @c Z coordinates to read (real size).
+       * @param cRange the @c C coordinates to read (effective size).
+       * @param tRange the @c T coordinates to read (real size).
+       * @param buf the destination pixel buffer.
+       * @param threads the maximum number of threads to use.
+       * @param executor the executor to run the tasks.
+       * @param read the function to read a single plane.
+       * @throws std::logic_error if any range is empty or outside
+       * the image, or if the planes differ in shape or pixel type.
+       */
+      void
+      readPlaneStack(const CoreMetadata&              core,
+                     const FormatReader::plane_range& zRange,
+                     const FormatReader::plane_range& cRange,
+                     const FormatReader::plane_range& tRange,
+                     VariantPixelBuffer&              buf,
+                     unsigned int                     threads,
+                     Executor&                        executor,
+                     const stack_read_function&       read);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_PLANESTACK_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,209 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#ifndef _MSC_VER
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+#include <ome/files/detail/PositionalFile.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        void
+        fail(const char                     *what,
+             const boost::filesystem::path& path,
+             int                             error)
+        {
+          boost::format fmt("Failed to %1% %2%: %3%");
+          fmt % what % path.string() % std::strerror(error);
+          throw std::runtime_error(fmt.str());
+        }
+
+      }
+
+#ifdef _MSC_VER
+
+      PositionalFile::PositionalFile(const boost::filesystem::path& path):
+        path(path),
+        mutex(),
+        stream(path.string().c_str(), std::ios::in | std::ios::out | std::ios::binary)
+      {
+        if (!stream)
+          fail("open", path, errno);
+      }
+
+      PositionalFile::~PositionalFile()
+      {
+      }
+
+      void
+      PositionalFile::write(uint64_t     offset,
+                            const void  *data,
+                            std::size_t  size)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stream.seekp(static_cast<std::streamoff>(offset));
+        stream.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        if (!stream)
+          fail("write", path, errno);
+      }
+
+      void *
+      PositionalFile::map(uint64_t    /* offset */,
+                          std::size_t /* size */)
+      {
+        throw std::runtime_error("Memory mapped writing is not supported on this platform");
+      }
+
+      void
+      PositionalFile::close()
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stream.is_open())
+          {
+            stream.close();
+            if (!stream)
+              fail("close", path, errno);
+          }
+      }
+
+#else // ! _MSC_VER
+
+      PositionalFile::PositionalFile(const boost::filesystem::path& path):
+        path(path),
+        mutex(),
+        fd(::open(path.string().c_str(), O_RDWR)),
+        mappings()
+      {
+        if (fd < 0)
+          fail("open", path, errno);
+      }
+
+      PositionalFile::~PositionalFile()
+      {
+        for (const auto& mapping : mappings)
+          ::munmap(mapping.first, mapping.second);
+        if (fd >= 0)
+          ::close(fd);
+      }
+
+      void
+      PositionalFile::write(uint64_t     offset,
+                            const void  *data,
+                            std::size_t  size)
+      {
+        const char *pos = static_cast<const char *>(data);
+        while (size)
+          {
+            ssize_t written = ::pwrite(fd, pos, size, static_cast<off_t>(offset));
+            if (written < 0)
+              {
+                if (errno == EINTR)
+                  continue;
+                fail("write", path, errno);
+              }
+            pos += written;
+            offset += static_cast<uint64_t>(written);
+            size -= static_cast<std::size_t>(written);
+          }
+      }
+
+      void *
+      PositionalFile::map(uint64_t    offset,
+                          std::size_t size)
+      {
+        // The mapping must start on a page boundary.
+        static const uint64_t pagesize = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+        const uint64_t start = offset - (offset % pagesize);
+        const std::size_t length = size + static_cast<std::size_t>(offset - start);
+
+        void *addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                            fd, static_cast<off_t>(start));
+        if (addr == MAP_FAILED)
+          fail("map", path, errno);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        mappings.push_back(std::make_pair(addr, length));
+        return static_cast<char *>(addr) + (offset - start);
+      }
+
+      void
+      PositionalFile::close()
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        int error = 0;
+        for (const auto& mapping : mappings)
+          {
+            if (::msync(mapping.first, mapping.second, MS_SYNC) < 0 && !error)
+              error = errno;
+            ::munmap(mapping.first, mapping.second);
+          }
+        mappings.clear();
+        if (error)
+          fail("synchronise", path, error);
+
+        if (fd >= 0)
+          {
+            int status = ::close(fd);
+            fd = -1;
+            if (status < 0)
+              fail("close", path, errno);
+          }
+      }
+
+#endif // _MSC_VER
+
+    }
+  }
+}
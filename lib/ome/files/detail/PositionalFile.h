@@ -0,0 +1,160 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_POSITIONALFILE_H
+#define OME_FILES_DETAIL_POSITIONALFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * File written at explicit offsets.
+       *
+       * Writes do not share a file position, so they may be made
+       * concurrently from several threads.  Where positional writes
+       * are not available, writes are serialised.  The file must
+       * already exist; it is not truncated.  Regions of the file may
+       * also be mapped into memory and written in place.
+       */
+      class PositionalFile
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param path the file to open for writing.
+         * @throws std::runtime_error if the file can not be opened.
+         */
+        explicit
+        PositionalFile(const boost::filesystem::path& path);
+
+        /**
+         * Destructor.
+         *
+         * The file is closed; any error is discarded.  Call close()
+         * first to check for errors.
+         */
+        ~PositionalFile();
+
+        /// Copy constructor (deleted).
+        PositionalFile(const PositionalFile&) = delete;
+
+        /// Assignment operator (deleted).
+        PositionalFile&
+        operator= (const PositionalFile&) = delete;
+
+        /**
+         * Write data at an offset.
+         *
+         * @param offset the file offset.
+         * @param data the data to write.
+         * @param size the size of @c data in bytes.
+         * @throws std::runtime_error on failure.
+         */
+        void
+        write(uint64_t     offset,
+              const void  *data,
+              std::size_t  size);
+
+        /**
+         * Map a region of the file into memory for writing.
+         *
+         * The mapping remains valid until the file is closed, when
+         * it is synchronised with the file and unmapped.  The region
+         * must lie within the current size of the file.
+         *
+         * @param offset the file offset.
+         * @param size the size of the region in bytes.
+         * @returns the address of @c offset in the mapping.
+         * @throws std::runtime_error on failure, or if memory mapping
+         * is not supported on this platform.
+         */
+        void *
+        map(uint64_t    offset,
+            std::size_t size);
+
+        /**
+         * Close the file.
+         *
+         * Any mappings are synchronised with the file and unmapped.
+         *
+         * @throws std::runtime_error on failure.
+         */
+        void
+        close();
+
+      private:
+        /// Path of the file.
+        boost::filesystem::path path;
+        /// Lock serialising use of the stream and mappings.
+        std::mutex mutex;
+#ifdef _MSC_VER
+        /// File stream.
+        std::fstream stream;
+#else
+        /// File descriptor.
+        int fd;
+        /// Mapped regions (address and size).
+        std::vector<std::pair<void *, std::size_t>> mappings;
+#endif
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_POSITIONALFILE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,671 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <complex>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define OME_FILES_PROJECTION_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define OME_FILES_PROJECTION_NEON 1
+#endif
+
+#include <ome/files/detail/Projection.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        template<typename T>
+        inline T
+        max_value(const T& a,
+                  const T& b)
+        {
+          return a < b ? b : a;
+        }
+
+        template<typename T>
+        inline std::complex<T>
+        max_value(const std::complex<T>& a,
+                  const std::complex<T>& b)
+        {
+          return std::abs(a) < std::abs(b) ? b : a;
+        }
+
+        // Apply a block operation to whole 16-byte blocks of the
+        // source, returning the number of values processed.
+        template<typename S, typename T, typename Block>
+        inline dimension_size_type
+        blocks(S                   *acc,
+               const T             *src,
+               dimension_size_type  count,
+               Block                block)
+        {
+          const dimension_size_type lanes = 16U / sizeof(T);
+          dimension_size_type i = 0;
+          for (; i + lanes <= count; i += lanes)
+            block(acc + i, src + i);
+          return i;
+        }
+
+        // Accumulate with SIMD instructions, returning the number
+        // of values processed.  Unspecialised types are not
+        // vectorised.
+        template<typename T>
+        dimension_size_type
+        simd_max(T                   * /* acc */,
+                 const T             * /* src */,
+                 dimension_size_type   /* count */)
+        {
+          return 0U;
+        }
+
+        template<typename T, typename S>
+        dimension_size_type
+        simd_sum(S                   * /* acc */,
+                 const T             * /* src */,
+                 dimension_size_type   /* count */)
+        {
+          return 0U;
+        }
+
+#if defined(OME_FILES_PROJECTION_SSE2)
+
+        inline __m128i
+        load(const void *p)
+        {
+          return _mm_loadu_si128(static_cast<const __m128i *>(p));
+        }
+
+        inline void
+        store(void    *p,
+              __m128i  v)
+        {
+          _mm_storeu_si128(static_cast<__m128i *>(p), v);
+        }
+
+        // Select b where a is less than b, else a.
+        inline __m128i
+        select_max(__m128i a,
+                   __m128i b,
+                   __m128i less)
+        {
+          return _mm_or_si128(_mm_and_si128(less, b), _mm_andnot_si128(less, a));
+        }
+
+        // SSE2 lacks some of the signed and unsigned comparisons;
+        // flipping the sign bit converts between them.
+
+        template<>
+        dimension_size_type
+        simd_max<uint8_t>(uint8_t             *acc,
+                          const uint8_t       *src,
+                          dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint8_t *a, const uint8_t *s)
+                        { store(a, _mm_max_epu8(load(a), load(s))); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<int8_t>(int8_t              *acc,
+                         const int8_t        *src,
+                         dimension_size_type  count)
+        {
+          const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+          return blocks(acc, src, count, [flip](int8_t *a, const int8_t *s)
+                        {
+                          const __m128i m = _mm_max_epu8(_mm_xor_si128(load(a), flip),
+                                                         _mm_xor_si128(load(s), flip));
+                          store(a, _mm_xor_si128(m, flip));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<uint16_t>(uint16_t            *acc,
+                           const uint16_t      *src,
+                           dimension_size_type  count)
+        {
+          const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+          return blocks(acc, src, count, [flip](uint16_t *a, const uint16_t *s)
+                        {
+                          const __m128i m = _mm_max_epi16(_mm_xor_si128(load(a), flip),
+                                                          _mm_xor_si128(load(s), flip));
+                          store(a, _mm_xor_si128(m, flip));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<int16_t>(int16_t             *acc,
+                          const int16_t       *src,
+                          dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int16_t *a, const int16_t *s)
+                        { store(a, _mm_max_epi16(load(a), load(s))); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<uint32_t>(uint32_t            *acc,
+                           const uint32_t      *src,
+                           dimension_size_type  count)
+        {
+          const __m128i flip = _mm_set1_epi32(static_cast<int>(0x80000000U));
+          return blocks(acc, src, count, [flip](uint32_t *a, const uint32_t *s)
+                        {
+                          const __m128i va = load(a);
+                          const __m128i vs = load(s);
+                          store(a, select_max(va, vs, _mm_cmplt_epi32(_mm_xor_si128(va, flip),
+                                                                      _mm_xor_si128(vs, flip))));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<int32_t>(int32_t             *acc,
+                          const int32_t       *src,
+                          dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int32_t *a, const int32_t *s)
+                        {
+                          const __m128i va = load(a);
+                          const __m128i vs = load(s);
+                          store(a, select_max(va, vs, _mm_cmplt_epi32(va, vs)));
+                        });
+        }
+
+        // The comparison is false for NaN, so that the accumulated
+        // value is kept, as for max_value().
+        template<>
+        dimension_size_type
+        simd_max<float>(float               *acc,
+                        const float         *src,
+                        dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](float *a, const float *s)
+                        {
+                          const __m128 va = _mm_loadu_ps(a);
+                          const __m128 vs = _mm_loadu_ps(s);
+                          const __m128 less = _mm_cmplt_ps(va, vs);
+                          _mm_storeu_ps(a, _mm_or_ps(_mm_and_ps(less, vs), _mm_andnot_ps(less, va)));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<double>(double              *acc,
+                         const double        *src,
+                         dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](double *a, const double *s)
+                        {
+                          const __m128d va = _mm_loadu_pd(a);
+                          const __m128d vs = _mm_loadu_pd(s);
+                          const __m128d less = _mm_cmplt_pd(va, vs);
+                          _mm_storeu_pd(a, _mm_or_pd(_mm_and_pd(less, vs), _mm_andnot_pd(less, va)));
+                        });
+        }
+
+        // Integers are widened to 64-bit lanes by interleaving them
+        // with their sign extension (or zero), and then added.
+
+        template<bool Signed>
+        inline __m128i
+        extension8(__m128i v)
+        {
+          return Signed ? _mm_cmpgt_epi8(_mm_setzero_si128(), v) : _mm_setzero_si128();
+        }
+
+        template<bool Signed>
+        inline __m128i
+        extension16(__m128i v)
+        {
+          return Signed ? _mm_srai_epi16(v, 15) : _mm_setzero_si128();
+        }
+
+        template<bool Signed>
+        inline __m128i
+        extension32(__m128i v)
+        {
+          return Signed ? _mm_srai_epi32(v, 31) : _mm_setzero_si128();
+        }
+
+        template<typename S>
+        inline void
+        add64(S       *acc,
+              __m128i  v)
+        {
+          store(acc, _mm_add_epi64(load(acc), v));
+        }
+
+        template<bool Signed, typename S>
+        inline void
+        add32(S       *acc,
+              __m128i  v)
+        {
+          const __m128i e = extension32<Signed>(v);
+          add64(acc, _mm_unpacklo_epi32(v, e));
+          add64(acc + 2, _mm_unpackhi_epi32(v, e));
+        }
+
+        template<bool Signed, typename S>
+        inline void
+        add16(S       *acc,
+              __m128i  v)
+        {
+          const __m128i e = extension16<Signed>(v);
+          add32<Signed>(acc, _mm_unpacklo_epi16(v, e));
+          add32<Signed>(acc + 4, _mm_unpackhi_epi16(v, e));
+        }
+
+        template<bool Signed, typename S>
+        inline void
+        add8(S       *acc,
+             __m128i  v)
+        {
+          const __m128i e = extension8<Signed>(v);
+          add16<Signed>(acc, _mm_unpacklo_epi8(v, e));
+          add16<Signed>(acc + 8, _mm_unpackhi_epi8(v, e));
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<uint8_t, uint64_t>(uint64_t            *acc,
+                                    const uint8_t       *src,
+                                    dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint64_t *a, const uint8_t *s) { add8<false>(a, load(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<int8_t, int64_t>(int64_t             *acc,
+                                  const int8_t        *src,
+                                  dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int64_t *a, const int8_t *s) { add8<true>(a, load(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<uint16_t, uint64_t>(uint64_t            *acc,
+                                     const uint16_t      *src,
+                                     dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint64_t *a, const uint16_t *s) { add16<false>(a, load(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<int16_t, int64_t>(int64_t             *acc,
+                                   const int16_t       *src,
+                                   dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int64_t *a, const int16_t *s) { add16<true>(a, load(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<uint32_t, uint64_t>(uint64_t            *acc,
+                                     const uint32_t      *src,
+                                     dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint64_t *a, const uint32_t *s) { add32<false>(a, load(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<int32_t, int64_t>(int64_t             *acc,
+                                   const int32_t       *src,
+                                   dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int64_t *a, const int32_t *s) { add32<true>(a, load(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<float, double>(double              *acc,
+                                const float         *src,
+                                dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](double *a, const float *s)
+                        {
+                          const __m128 v = _mm_loadu_ps(s);
+                          _mm_storeu_pd(a, _mm_add_pd(_mm_loadu_pd(a), _mm_cvtps_pd(v)));
+                          _mm_storeu_pd(a + 2, _mm_add_pd(_mm_loadu_pd(a + 2), _mm_cvtps_pd(_mm_movehl_ps(v, v))));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<double, double>(double              *acc,
+                                 const double        *src,
+                                 dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](double *a, const double *s)
+                        { _mm_storeu_pd(a, _mm_add_pd(_mm_loadu_pd(a), _mm_loadu_pd(s))); });
+        }
+
+#elif defined(OME_FILES_PROJECTION_NEON)
+
+        template<>
+        dimension_size_type
+        simd_max<uint8_t>(uint8_t             *acc,
+                          const uint8_t       *src,
+                          dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint8_t *a, const uint8_t *s)
+                        { vst1q_u8(a, vmaxq_u8(vld1q_u8(a), vld1q_u8(s))); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<int8_t>(int8_t              *acc,
+                         const int8_t        *src,
+                         dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int8_t *a, const int8_t *s)
+                        { vst1q_s8(a, vmaxq_s8(vld1q_s8(a), vld1q_s8(s))); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<uint16_t>(uint16_t            *acc,
+                           const uint16_t      *src,
+                           dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint16_t *a, const uint16_t *s)
+                        { vst1q_u16(a, vmaxq_u16(vld1q_u16(a), vld1q_u16(s))); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<int16_t>(int16_t             *acc,
+                          const int16_t       *src,
+                          dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int16_t *a, const int16_t *s)
+                        { vst1q_s16(a, vmaxq_s16(vld1q_s16(a), vld1q_s16(s))); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<uint32_t>(uint32_t            *acc,
+                           const uint32_t      *src,
+                           dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint32_t *a, const uint32_t *s)
+                        { vst1q_u32(a, vmaxq_u32(vld1q_u32(a), vld1q_u32(s))); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_max<int32_t>(int32_t             *acc,
+                          const int32_t       *src,
+                          dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int32_t *a, const int32_t *s)
+                        { vst1q_s32(a, vmaxq_s32(vld1q_s32(a), vld1q_s32(s))); });
+        }
+
+        // vmaxq_f32 returns NaN if either value is NaN, so select
+        // with a comparison instead, as for SSE2.
+        template<>
+        dimension_size_type
+        simd_max<float>(float               *acc,
+                        const float         *src,
+                        dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](float *a, const float *s)
+                        {
+                          const float32x4_t va = vld1q_f32(a);
+                          const float32x4_t vs = vld1q_f32(s);
+                          vst1q_f32(a, vbslq_f32(vcltq_f32(va, vs), vs, va));
+                        });
+        }
+
+        inline void
+        add32(uint64_t   *acc,
+              uint32x4_t  v)
+        {
+          vst1q_u64(acc, vaddw_u32(vld1q_u64(acc), vget_low_u32(v)));
+          vst1q_u64(acc + 2, vaddw_u32(vld1q_u64(acc + 2), vget_high_u32(v)));
+        }
+
+        inline void
+        add32(int64_t   *acc,
+              int32x4_t  v)
+        {
+          vst1q_s64(acc, vaddw_s32(vld1q_s64(acc), vget_low_s32(v)));
+          vst1q_s64(acc + 2, vaddw_s32(vld1q_s64(acc + 2), vget_high_s32(v)));
+        }
+
+        inline void
+        add16(uint64_t   *acc,
+              uint16x8_t  v)
+        {
+          add32(acc, vmovl_u16(vget_low_u16(v)));
+          add32(acc + 4, vmovl_u16(vget_high_u16(v)));
+        }
+
+        inline void
+        add16(int64_t   *acc,
+              int16x8_t  v)
+        {
+          add32(acc, vmovl_s16(vget_low_s16(v)));
+          add32(acc + 4, vmovl_s16(vget_high_s16(v)));
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<uint8_t, uint64_t>(uint64_t            *acc,
+                                    const uint8_t       *src,
+                                    dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint64_t *a, const uint8_t *s)
+                        {
+                          const uint8x16_t v = vld1q_u8(s);
+                          add16(a, vmovl_u8(vget_low_u8(v)));
+                          add16(a + 8, vmovl_u8(vget_high_u8(v)));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<int8_t, int64_t>(int64_t             *acc,
+                                  const int8_t        *src,
+                                  dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int64_t *a, const int8_t *s)
+                        {
+                          const int8x16_t v = vld1q_s8(s);
+                          add16(a, vmovl_s8(vget_low_s8(v)));
+                          add16(a + 8, vmovl_s8(vget_high_s8(v)));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<uint16_t, uint64_t>(uint64_t            *acc,
+                                     const uint16_t      *src,
+                                     dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint64_t *a, const uint16_t *s) { add16(a, vld1q_u16(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<int16_t, int64_t>(int64_t             *acc,
+                                   const int16_t       *src,
+                                   dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int64_t *a, const int16_t *s) { add16(a, vld1q_s16(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<uint32_t, uint64_t>(uint64_t            *acc,
+                                     const uint32_t      *src,
+                                     dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](uint64_t *a, const uint32_t *s) { add32(a, vld1q_u32(s)); });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<int32_t, int64_t>(int64_t             *acc,
+                                   const int32_t       *src,
+                                   dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](int64_t *a, const int32_t *s) { add32(a, vld1q_s32(s)); });
+        }
+
+# if defined(__aarch64__)
+
+        // Double precision vectors are only available on AArch64.
+
+        template<>
+        dimension_size_type
+        simd_max<double>(double              *acc,
+                         const double        *src,
+                         dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](double *a, const double *s)
+                        {
+                          const float64x2_t va = vld1q_f64(a);
+                          const float64x2_t vs = vld1q_f64(s);
+                          vst1q_f64(a, vbslq_f64(vcltq_f64(va, vs), vs, va));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<float, double>(double              *acc,
+                                const float         *src,
+                                dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](double *a, const float *s)
+                        {
+                          const float32x4_t v = vld1q_f32(s);
+                          vst1q_f64(a, vaddq_f64(vld1q_f64(a), vcvt_f64_f32(vget_low_f32(v))));
+                          vst1q_f64(a + 2, vaddq_f64(vld1q_f64(a + 2), vcvt_high_f64_f32(v)));
+                        });
+        }
+
+        template<>
+        dimension_size_type
+        simd_sum<double, double>(double              *acc,
+                                 const double        *src,
+                                 dimension_size_type  count)
+        {
+          return blocks(acc, src, count, [](double *a, const double *s)
+                        { vst1q_f64(a, vaddq_f64(vld1q_f64(a), vld1q_f64(s))); });
+        }
+
+# endif
+
+#endif
+
+      }
+
+      template<typename T>
+      void
+      projectMax(T                   *acc,
+                 const T             *src,
+                 dimension_size_type  count)
+      {
+        for (dimension_size_type i = simd_max(acc, src, count); i < count; ++i)
+          acc[i] = max_value(acc[i], src[i]);
+      }
+
+      template<typename T, typename S>
+      void
+      projectSum(S                   *acc,
+                 const T             *src,
+                 dimension_size_type  count)
+      {
+        for (dimension_size_type i = simd_sum(acc, src, count); i < count; ++i)
+          acc[i] += static_cast<S>(src[i]);
+      }
+
+      // Instantiated for the sample type of each pixel type, with
+      // the sum types used by the projections.
+      template void projectMax<bool>(bool *, const bool *, dimension_size_type);
+      template void projectMax<int8_t>(int8_t *, const int8_t *, dimension_size_type);
+      template void projectMax<int16_t>(int16_t *, const int16_t *, dimension_size_type);
+      template void projectMax<int32_t>(int32_t *, const int32_t *, dimension_size_type);
+      template void projectMax<uint8_t>(uint8_t *, const uint8_t *, dimension_size_type);
+      template void projectMax<uint16_t>(uint16_t *, const uint16_t *, dimension_size_type);
+      template void projectMax<uint32_t>(uint32_t *, const uint32_t *, dimension_size_type);
+      template void projectMax<float>(float *, const float *, dimension_size_type);
+      template void projectMax<double>(double *, const double *, dimension_size_type);
+      template void projectMax<std::complex<float>>(std::complex<float> *, const std::complex<float> *,
+                                                    dimension_size_type);
+      template void projectMax<std::complex<double>>(std::complex<double> *, const std::complex<double> *,
+                                                     dimension_size_type);
+
+      template void projectSum<bool, uint64_t>(uint64_t *, const bool *, dimension_size_type);
+      template void projectSum<int8_t, int64_t>(int64_t *, const int8_t *, dimension_size_type);
+      template void projectSum<int16_t, int64_t>(int64_t *, const int16_t *, dimension_size_type);
+      template void projectSum<int32_t, int64_t>(int64_t *, const int32_t *, dimension_size_type);
+      template void projectSum<uint8_t, uint64_t>(uint64_t *, const uint8_t *, dimension_size_type);
+      template void projectSum<uint16_t, uint64_t>(uint64_t *, const uint16_t *, dimension_size_type);
+      template void projectSum<uint32_t, uint64_t>(uint64_t *, const uint32_t *, dimension_size_type);
+      template void projectSum<float, double>(double *, const float *, dimension_size_type);
+      template void projectSum<double, double>(double *, const double *, dimension_size_type);
+      template void projectSum<std::complex<float>, std::complex<double>>(std::complex<double> *,
+                                                                          const std::complex<float> *,
+                                                                          dimension_size_type);
+      template void projectSum<std::complex<double>, std::complex<double>>(std::complex<double> *,
+                                                                           const std::complex<double> *,
+                                                                           dimension_size_type);
+
+    }
+  }
+}
@@ -0,0 +1,104 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_PROJECTION_H
+#define OME_FILES_DETAIL_PROJECTION_H
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Accumulate the maximum of two arrays of values.
+       *
+       * Each value of @p acc is replaced by the corresponding value
+       * of @p src if it is greater.  Complex values are compared by
+       * magnitude.  A NaN value of @p src never replaces a value of
+       * @p acc, and a NaN value of @p acc is never replaced.
+       *
+       * The maximum of 8-, 16- and 32-bit integer and floating
+       * point values uses SIMD instructions where available (SSE2,
+       * and NEON; double precision only on AArch64), with results
+       * identical to the scalar implementation.  The data need not
+       * be aligned.
+       *
+       * @param acc the maximum values.
+       * @param src the values to accumulate.
+       * @param count the number of values.
+       */
+      template<typename T>
+      void
+      projectMax(T                   *acc,
+                 const T             *src,
+                 dimension_size_type  count);
+
+      /**
+       * Accumulate the sum of two arrays of values.
+       *
+       * Each value of @p src is converted to the sum type @p S and
+       * added to the corresponding value of @p acc.
+       *
+       * The sums of integer and floating point values use SIMD
+       * instructions where available, as for projectMax().
+       *
+       * @param acc the sums.
+       * @param src the values to accumulate.
+       * @param count the number of values.
+       */
+      template<typename T, typename S>
+      void
+      projectSum(S                   *acc,
+                 const T             *src,
+                 dimension_size_type  count);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_PROJECTION_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,253 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define OME_FILES_RENDER_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define OME_FILES_RENDER_NEON 1
+#endif
+
+#include <ome/files/detail/Render.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+#if defined(OME_FILES_RENDER_SSE2)
+
+        // Load two values as doubles.
+        inline __m128d
+        load_pair(const float    *src,
+                  std::ptrdiff_t  stride)
+        {
+          return _mm_set_pd(static_cast<double>(src[stride]), static_cast<double>(src[0]));
+        }
+
+        inline __m128d
+        load_pair(const double   *src,
+                  std::ptrdiff_t  stride)
+        {
+          return stride == 1 ? _mm_loadu_pd(src) : _mm_set_pd(src[stride], src[0]);
+        }
+
+        // The window is computed in double precision, as by
+        // windowIndex().  The maximum with zero is taken first,
+        // which also replaces NaN with zero, and the clamped value
+        // is rounded by truncation after adding one half.
+        template<typename T>
+        dimension_size_type
+        simd_window(const T             *src,
+                    std::ptrdiff_t       stride,
+                    dimension_size_type  count,
+                    double               min,
+                    double               scale,
+                    uint8_t             *dest)
+        {
+          const __m128d vmin = _mm_set1_pd(min);
+          const __m128d vscale = _mm_set1_pd(scale);
+          const __m128d zero = _mm_setzero_pd();
+          const __m128d top = _mm_set1_pd(255.0);
+          const __m128d half = _mm_set1_pd(0.5);
+          dimension_size_type i = 0;
+          for (; i + 8U <= count; i += 8U)
+            {
+              __m128i quads[2];
+              for (int q = 0; q < 2; ++q)
+                {
+                  __m128i pairs[2];
+                  for (int p = 0; p < 2; ++p)
+                    {
+                      const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(i) + (q * 4) + (p * 2);
+                      __m128d d = _mm_mul_pd(_mm_sub_pd(load_pair(src + (n * stride), stride), vmin), vscale);
+                      d = _mm_min_pd(_mm_max_pd(d, zero), top);
+                      pairs[p] = _mm_cvttpd_epi32(_mm_add_pd(d, half));
+                    }
+                  quads[q] = _mm_unpacklo_epi64(pairs[0], pairs[1]);
+                }
+              const __m128i words = _mm_packs_epi32(quads[0], quads[1]);
+              _mm_storel_epi64(reinterpret_cast<__m128i *>(dest + i), _mm_packus_epi16(words, words));
+            }
+          return i;
+        }
+
+#elif defined(OME_FILES_RENDER_NEON) && defined(__aarch64__)
+
+        // Load two values as doubles.
+        inline float64x2_t
+        load_pair(const float    *src,
+                  std::ptrdiff_t  stride)
+        {
+          const double pair[2] = {static_cast<double>(src[0]), static_cast<double>(src[stride])};
+          return vld1q_f64(pair);
+        }
+
+        inline float64x2_t
+        load_pair(const double   *src,
+                  std::ptrdiff_t  stride)
+        {
+          const double pair[2] = {src[0], src[stride]};
+          return stride == 1 ? vld1q_f64(src) : vld1q_f64(pair);
+        }
+
+        // As for SSE2; vmaxnmq_f64 replaces NaN with zero.
+        template<typename T>
+        dimension_size_type
+        simd_window(const T             *src,
+                    std::ptrdiff_t       stride,
+                    dimension_size_type  count,
+                    double               min,
+                    double               scale,
+                    uint8_t             *dest)
+        {
+          const float64x2_t vmin = vdupq_n_f64(min);
+          const float64x2_t vscale = vdupq_n_f64(scale);
+          const float64x2_t zero = vdupq_n_f64(0.0);
+          const float64x2_t top = vdupq_n_f64(255.0);
+          const float64x2_t half = vdupq_n_f64(0.5);
+          dimension_size_type i = 0;
+          for (; i + 8U <= count; i += 8U)
+            {
+              uint16x4_t quads[2];
+              for (int q = 0; q < 2; ++q)
+                {
+                  uint32x2_t pairs[2];
+                  for (int p = 0; p < 2; ++p)
+                    {
+                      const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(i) + (q * 4) + (p * 2);
+                      float64x2_t d = vmulq_f64(vsubq_f64(load_pair(src + (n * stride), stride), vmin), vscale);
+                      d = vminq_f64(vmaxnmq_f64(d, zero), top);
+                      pairs[p] = vmovn_u64(vcvtq_u64_f64(vaddq_f64(d, half)));
+                    }
+                  quads[q] = vmovn_u32(vcombine_u32(pairs[0], pairs[1]));
+                }
+              vst1_u8(dest + i, vmovn_u16(vcombine_u16(quads[0], quads[1])));
+            }
+          return i;
+        }
+
+#else
+
+        template<typename T>
+        dimension_size_type
+        simd_window(const T             * /* src */,
+                    std::ptrdiff_t        /* stride */,
+                    dimension_size_type   /* count */,
+                    double                /* min */,
+                    double                /* scale */,
+                    uint8_t             * /* dest */)
+        {
+          return 0U;
+        }
+
+#endif
+
+        template<typename T>
+        void
+        window(const T             *src,
+               std::ptrdiff_t       stride,
+               dimension_size_type  count,
+               double               min,
+               double               scale,
+               uint8_t             *dest)
+        {
+          dimension_size_type i = simd_window(src, stride, count, min, scale, dest);
+          for (src += static_cast<std::ptrdiff_t>(i) * stride; i < count; ++i, src += stride)
+            dest[i] = windowIndex(static_cast<double>(*src), min, scale);
+        }
+
+      }
+
+      void
+      windowIndices(const float         *src,
+                    std::ptrdiff_t       stride,
+                    dimension_size_type  count,
+                    double               min,
+                    double               scale,
+                    uint8_t             *dest)
+      {
+        window(src, stride, count, min, scale, dest);
+      }
+
+      void
+      windowIndices(const double        *src,
+                    std::ptrdiff_t       stride,
+                    dimension_size_type  count,
+                    double               min,
+                    double               scale,
+                    uint8_t             *dest)
+      {
+        window(src, stride, count, min, scale, dest);
+      }
+
+      void
+      addSaturated(const uint8_t       *src,
+                   dimension_size_type  count,
+                   uint8_t             *dest)
+      {
+        dimension_size_type i = 0;
+
+#if defined(OME_FILES_RENDER_SSE2)
+        for (; i + 16U <= count; i += 16U)
+          {
+            __m128i *p = reinterpret_cast<__m128i *>(dest + i);
+            _mm_storeu_si128(p, _mm_adds_epu8(_mm_loadu_si128(p),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i))));
+          }
+#elif defined(OME_FILES_RENDER_NEON)
+        for (; i + 16U <= count; i += 16U)
+          vst1q_u8(dest + i, vqaddq_u8(vld1q_u8(dest + i), vld1q_u8(src + i)));
+#endif
+
+        for (; i < count; ++i)
+          dest[i] = static_cast<uint8_t>(std::min(static_cast<unsigned int>(dest[i]) + src[i], 255U));
+      }
+
+    }
+  }
+}
@@ -0,0 +1,142 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_RENDER_H
+#define OME_FILES_DETAIL_RENDER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Get the position of a value in a display window.
+       *
+       * The value is offset by @p min and multiplied by @p scale,
+       * then rounded to nearest and clamped to 0–255.  NaN is
+       * placed at the bottom of the window.
+       *
+       * @param value the value.
+       * @param min the bottom of the window.
+       * @param scale the scale from the window to 0–255.
+       * @returns the position in the window.
+       */
+      inline uint8_t
+      windowIndex(double value,
+                  double min,
+                  double scale)
+      {
+        const double d = (value - min) * scale;
+        if (!(d > 0.0))
+          return 0U;
+        if (d >= 255.0)
+          return 255U;
+        return static_cast<uint8_t>(d + 0.5);
+      }
+
+      /**
+       * Get the positions of a row of values in a display window.
+       *
+       * This is the bulk equivalent of calling windowIndex() for
+       * each value.  SIMD instructions are used where available
+       * (SSE2, and NEON on AArch64), with results identical to
+       * windowIndex().  The data need not be aligned.
+       *
+       * @param src the first value.
+       * @param stride the distance between values.
+       * @param count the number of values.
+       * @param min the bottom of the window.
+       * @param scale the scale from the window to 0–255.
+       * @param dest the destination positions.
+       */
+      void
+      windowIndices(const float         *src,
+                    std::ptrdiff_t       stride,
+                    dimension_size_type  count,
+                    double               min,
+                    double               scale,
+                    uint8_t             *dest);
+
+      /**
+       * Get the positions of a row of values in a display window.
+       *
+       * @copydetails windowIndices(const float *, std::ptrdiff_t, dimension_size_type, double, double, uint8_t *)
+       */
+      void
+      windowIndices(const double        *src,
+                    std::ptrdiff_t       stride,
+                    dimension_size_type  count,
+                    double               min,
+                    double               scale,
+                    uint8_t             *dest);
+
+      /**
+       * Add bytes with saturation.
+       *
+       * Each byte of @p dest is replaced by its sum with the
+       * corresponding byte of @p src, clamped to 255.  SIMD
+       * instructions are used where available (SSE2 and NEON).
+       * The data need not be aligned.
+       *
+       * @param src the bytes to add.
+       * @param count the number of bytes.
+       * @param dest the bytes to add to.
+       */
+      void
+      addSaturated(const uint8_t       *src,
+                   dimension_size_type  count,
+                   uint8_t             *dest);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_RENDER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
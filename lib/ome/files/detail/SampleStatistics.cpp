@@ -0,0 +1,742 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define OME_FILES_SAMPLESTATISTICS_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define OME_FILES_SAMPLESTATISTICS_NEON 1
+#endif
+
+#include <ome/files/detail/SampleStatistics.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        template<typename T>
+        inline bool
+        is_nan(const T& /* v */)
+        {
+          return false;
+        }
+
+        inline bool
+        is_nan(float v)
+        {
+          return v != v;
+        }
+
+        inline bool
+        is_nan(double v)
+        {
+          return v != v;
+        }
+
+        // Apply a block operation to whole 16-byte blocks of the
+        // data, returning the number of values processed.
+        template<typename T, typename Block>
+        inline dimension_size_type
+        blocks(const T             *data,
+               dimension_size_type  count,
+               Block                block)
+        {
+          const dimension_size_type lanes = 16U / sizeof(T);
+          dimension_size_type i = 0;
+          for (; i + lanes <= count; i += lanes)
+            block(data + i);
+          return i;
+        }
+
+        // Combine the lanes of the minimum and maximum vectors,
+        // stored as arrays.
+        template<typename T>
+        inline void
+        combine(const T             *vmin,
+                const T             *vmax,
+                dimension_size_type  lanes,
+                T&                   min,
+                T&                   max)
+        {
+          for (dimension_size_type i = 0; i < lanes; ++i)
+            {
+              min = vmin[i] < min ? vmin[i] : min;
+              max = vmax[i] > max ? vmax[i] : max;
+            }
+        }
+
+        // Accumulate with SIMD instructions, returning the number
+        // of values processed, and adding the number of values
+        // accumulated to n.  Unspecialised types are not
+        // vectorised.
+        template<typename T, typename S>
+        dimension_size_type
+        simd_samples(const T             * /* data */,
+                     dimension_size_type   /* count */,
+                     T&                    /* min */,
+                     T&                    /* max */,
+                     S&                    /* sum */,
+                     dimension_size_type&  /* n */)
+        {
+          return 0U;
+        }
+
+#if defined(OME_FILES_SAMPLESTATISTICS_SSE2)
+
+        inline __m128i
+        load(const void *p)
+        {
+          return _mm_loadu_si128(static_cast<const __m128i *>(p));
+        }
+
+        inline void
+        store(void    *p,
+              __m128i  v)
+        {
+          _mm_storeu_si128(static_cast<__m128i *>(p), v);
+        }
+
+        // Select a where mask is set, else b.
+        inline __m128i
+        select(__m128i mask,
+               __m128i a,
+               __m128i b)
+        {
+          return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+        }
+
+        template<typename T>
+        inline void
+        combine(__m128i  vmin,
+                __m128i  vmax,
+                T&       min,
+                T&       max)
+        {
+          const dimension_size_type lanes = 16U / sizeof(T);
+          T amin[lanes];
+          T amax[lanes];
+          store(amin, vmin);
+          store(amax, vmax);
+          combine(amin, amax, lanes, min, max);
+        }
+
+        template<typename S>
+        inline S
+        total(__m128i v)
+        {
+          S a[2];
+          store(a, v);
+          return static_cast<S>(a[0] + a[1]);
+        }
+
+        // Add the 32-bit lanes of v to the 64-bit lanes of sum,
+        // extended with ext (zero or the sign).
+        inline __m128i
+        add32(__m128i sum,
+              __m128i v,
+              __m128i ext)
+        {
+          sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(v, ext));
+          return _mm_add_epi64(sum, _mm_unpackhi_epi32(v, ext));
+        }
+
+        // SSE2 lacks some of the signed and unsigned comparisons;
+        // flipping the sign bit converts between them, and the
+        // flipped values are summed with a correction for the
+        // offset.
+
+        template<>
+        dimension_size_type
+        simd_samples<uint8_t, uint64_t>(const uint8_t        *data,
+                                        dimension_size_type   count,
+                                        uint8_t&              min,
+                                        uint8_t&              max,
+                                        uint64_t&             sum,
+                                        dimension_size_type&  n)
+        {
+          __m128i vmin = _mm_set1_epi8(static_cast<char>(min));
+          __m128i vmax = _mm_set1_epi8(static_cast<char>(max));
+          __m128i vsum = _mm_setzero_si128();
+          const dimension_size_type done =
+            blocks(data, count, [&](const uint8_t *p)
+                   {
+                     const __m128i v = load(p);
+                     vmin = _mm_min_epu8(vmin, v);
+                     vmax = _mm_max_epu8(vmax, v);
+                     vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, _mm_setzero_si128()));
+                   });
+          combine(vmin, vmax, min, max);
+          sum += total<uint64_t>(vsum);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<int8_t, int64_t>(const int8_t         *data,
+                                      dimension_size_type   count,
+                                      int8_t&               min,
+                                      int8_t&               max,
+                                      int64_t&              sum,
+                                      dimension_size_type&  n)
+        {
+          const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+          __m128i vmin = _mm_xor_si128(_mm_set1_epi8(min), flip);
+          __m128i vmax = _mm_xor_si128(_mm_set1_epi8(max), flip);
+          __m128i vsum = _mm_setzero_si128();
+          const dimension_size_type done =
+            blocks(data, count, [&](const int8_t *p)
+                   {
+                     const __m128i v = _mm_xor_si128(load(p), flip);
+                     vmin = _mm_min_epu8(vmin, v);
+                     vmax = _mm_max_epu8(vmax, v);
+                     vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, _mm_setzero_si128()));
+                   });
+          combine<int8_t>(_mm_xor_si128(vmin, flip), _mm_xor_si128(vmax, flip), min, max);
+          sum += total<int64_t>(vsum) - (static_cast<int64_t>(done) * 128);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<uint16_t, uint64_t>(const uint16_t       *data,
+                                         dimension_size_type   count,
+                                         uint16_t&             min,
+                                         uint16_t&             max,
+                                         uint64_t&             sum,
+                                         dimension_size_type&  n)
+        {
+          const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+          const __m128i ones = _mm_set1_epi16(1);
+          __m128i vmin = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(min)), flip);
+          __m128i vmax = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(max)), flip);
+          __m128i vsum = _mm_setzero_si128();
+          const dimension_size_type done =
+            blocks(data, count, [&](const uint16_t *p)
+                   {
+                     const __m128i v = _mm_xor_si128(load(p), flip);
+                     vmin = _mm_min_epi16(vmin, v);
+                     vmax = _mm_max_epi16(vmax, v);
+                     const __m128i pairs = _mm_madd_epi16(v, ones);
+                     vsum = add32(vsum, pairs, _mm_srai_epi32(pairs, 31));
+                   });
+          combine<uint16_t>(_mm_xor_si128(vmin, flip), _mm_xor_si128(vmax, flip), min, max);
+          sum += static_cast<uint64_t>(total<int64_t>(vsum) + (static_cast<int64_t>(done) * 32768));
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<int16_t, int64_t>(const int16_t        *data,
+                                       dimension_size_type   count,
+                                       int16_t&              min,
+                                       int16_t&              max,
+                                       int64_t&              sum,
+                                       dimension_size_type&  n)
+        {
+          const __m128i ones = _mm_set1_epi16(1);
+          __m128i vmin = _mm_set1_epi16(min);
+          __m128i vmax = _mm_set1_epi16(max);
+          __m128i vsum = _mm_setzero_si128();
+          const dimension_size_type done =
+            blocks(data, count, [&](const int16_t *p)
+                   {
+                     const __m128i v = load(p);
+                     vmin = _mm_min_epi16(vmin, v);
+                     vmax = _mm_max_epi16(vmax, v);
+                     const __m128i pairs = _mm_madd_epi16(v, ones);
+                     vsum = add32(vsum, pairs, _mm_srai_epi32(pairs, 31));
+                   });
+          combine<int16_t>(vmin, vmax, min, max);
+          sum += total<int64_t>(vsum);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<uint32_t, uint64_t>(const uint32_t       *data,
+                                         dimension_size_type   count,
+                                         uint32_t&             min,
+                                         uint32_t&             max,
+                                         uint64_t&             sum,
+                                         dimension_size_type&  n)
+        {
+          const __m128i flip = _mm_set1_epi32(static_cast<int>(0x80000000U));
+          __m128i vmin = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(min)), flip);
+          __m128i vmax = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(max)), flip);
+          __m128i vsum = _mm_setzero_si128();
+          const dimension_size_type done =
+            blocks(data, count, [&](const uint32_t *p)
+                   {
+                     const __m128i u = load(p);
+                     const __m128i v = _mm_xor_si128(u, flip);
+                     vmin = select(_mm_cmplt_epi32(v, vmin), v, vmin);
+                     vmax = select(_mm_cmpgt_epi32(v, vmax), v, vmax);
+                     vsum = add32(vsum, u, _mm_setzero_si128());
+                   });
+          combine<uint32_t>(_mm_xor_si128(vmin, flip), _mm_xor_si128(vmax, flip), min, max);
+          sum += total<uint64_t>(vsum);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<int32_t, int64_t>(const int32_t        *data,
+                                       dimension_size_type   count,
+                                       int32_t&              min,
+                                       int32_t&              max,
+                                       int64_t&              sum,
+                                       dimension_size_type&  n)
+        {
+          __m128i vmin = _mm_set1_epi32(min);
+          __m128i vmax = _mm_set1_epi32(max);
+          __m128i vsum = _mm_setzero_si128();
+          const dimension_size_type done =
+            blocks(data, count, [&](const int32_t *p)
+                   {
+                     const __m128i v = load(p);
+                     vmin = select(_mm_cmplt_epi32(v, vmin), v, vmin);
+                     vmax = select(_mm_cmpgt_epi32(v, vmax), v, vmax);
+                     vsum = add32(vsum, v, _mm_srai_epi32(v, 31));
+                   });
+          combine<int32_t>(vmin, vmax, min, max);
+          sum += total<int64_t>(vsum);
+          n += done;
+          return done;
+        }
+
+        // MINPS and MAXPS return the second operand if either is
+        // NaN, so that NaN values are skipped.  NaN values are
+        // masked to zero for the sum, and only ordered values are
+        // counted.
+
+        template<>
+        dimension_size_type
+        simd_samples<float, double>(const float          *data,
+                                    dimension_size_type   count,
+                                    float&                min,
+                                    float&                max,
+                                    double&               sum,
+                                    dimension_size_type&  n)
+        {
+          __m128 vmin = _mm_set1_ps(min);
+          __m128 vmax = _mm_set1_ps(max);
+          __m128d vsum0 = _mm_setzero_pd();
+          __m128d vsum1 = _mm_setzero_pd();
+          __m128i vcount = _mm_setzero_si128();
+          const dimension_size_type done =
+            blocks(data, count, [&](const float *p)
+                   {
+                     const __m128 v = _mm_loadu_ps(p);
+                     vmin = _mm_min_ps(v, vmin);
+                     vmax = _mm_max_ps(v, vmax);
+                     const __m128 ordered = _mm_cmpord_ps(v, v);
+                     const __m128 m = _mm_and_ps(v, ordered);
+                     vsum0 = _mm_add_pd(vsum0, _mm_cvtps_pd(m));
+                     vsum1 = _mm_add_pd(vsum1, _mm_cvtps_pd(_mm_movehl_ps(m, m)));
+                     vcount = _mm_add_epi64(vcount, _mm_sad_epu8(_mm_srli_epi32(_mm_castps_si128(ordered), 31),
+                                                                 _mm_setzero_si128()));
+                   });
+          combine<float>(_mm_castps_si128(vmin), _mm_castps_si128(vmax), min, max);
+          double asum[2];
+          _mm_storeu_pd(asum, _mm_add_pd(vsum0, vsum1));
+          sum += asum[0] + asum[1];
+          n += static_cast<dimension_size_type>(total<uint64_t>(vcount));
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<double, double>(const double         *data,
+                                     dimension_size_type   count,
+                                     double&               min,
+                                     double&               max,
+                                     double&               sum,
+                                     dimension_size_type&  n)
+        {
+          __m128d vmin = _mm_set1_pd(min);
+          __m128d vmax = _mm_set1_pd(max);
+          __m128d vsum = _mm_setzero_pd();
+          __m128i vcount = _mm_setzero_si128();
+          const dimension_size_type done =
+            blocks(data, count, [&](const double *p)
+                   {
+                     const __m128d v = _mm_loadu_pd(p);
+                     vmin = _mm_min_pd(v, vmin);
+                     vmax = _mm_max_pd(v, vmax);
+                     const __m128d ordered = _mm_cmpord_pd(v, v);
+                     vsum = _mm_add_pd(vsum, _mm_and_pd(v, ordered));
+                     vcount = _mm_sub_epi64(vcount, _mm_castpd_si128(ordered));
+                   });
+          combine<double>(_mm_castpd_si128(vmin), _mm_castpd_si128(vmax), min, max);
+          double asum[2];
+          _mm_storeu_pd(asum, vsum);
+          sum += asum[0] + asum[1];
+          n += static_cast<dimension_size_type>(total<uint64_t>(vcount));
+          return done;
+        }
+
+#elif defined(OME_FILES_SAMPLESTATISTICS_NEON)
+
+        // Integer sums are widened with pairwise additions into
+        // 64-bit lanes.
+
+        template<>
+        dimension_size_type
+        simd_samples<uint8_t, uint64_t>(const uint8_t        *data,
+                                        dimension_size_type   count,
+                                        uint8_t&              min,
+                                        uint8_t&              max,
+                                        uint64_t&             sum,
+                                        dimension_size_type&  n)
+        {
+          uint8x16_t vmin = vdupq_n_u8(min);
+          uint8x16_t vmax = vdupq_n_u8(max);
+          uint64x2_t vsum = vdupq_n_u64(0U);
+          const dimension_size_type done =
+            blocks(data, count, [&](const uint8_t *p)
+                   {
+                     const uint8x16_t v = vld1q_u8(p);
+                     vmin = vminq_u8(vmin, v);
+                     vmax = vmaxq_u8(vmax, v);
+                     vsum = vpadalq_u32(vsum, vpaddlq_u16(vpaddlq_u8(v)));
+                   });
+          uint8_t amin[16];
+          uint8_t amax[16];
+          vst1q_u8(amin, vmin);
+          vst1q_u8(amax, vmax);
+          combine(amin, amax, 16U, min, max);
+          sum += vgetq_lane_u64(vsum, 0) + vgetq_lane_u64(vsum, 1);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<int8_t, int64_t>(const int8_t         *data,
+                                      dimension_size_type   count,
+                                      int8_t&               min,
+                                      int8_t&               max,
+                                      int64_t&              sum,
+                                      dimension_size_type&  n)
+        {
+          int8x16_t vmin = vdupq_n_s8(min);
+          int8x16_t vmax = vdupq_n_s8(max);
+          int64x2_t vsum = vdupq_n_s64(0);
+          const dimension_size_type done =
+            blocks(data, count, [&](const int8_t *p)
+                   {
+                     const int8x16_t v = vld1q_s8(p);
+                     vmin = vminq_s8(vmin, v);
+                     vmax = vmaxq_s8(vmax, v);
+                     vsum = vpadalq_s32(vsum, vpaddlq_s16(vpaddlq_s8(v)));
+                   });
+          int8_t amin[16];
+          int8_t amax[16];
+          vst1q_s8(amin, vmin);
+          vst1q_s8(amax, vmax);
+          combine(amin, amax, 16U, min, max);
+          sum += vgetq_lane_s64(vsum, 0) + vgetq_lane_s64(vsum, 1);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<uint16_t, uint64_t>(const uint16_t       *data,
+                                         dimension_size_type   count,
+                                         uint16_t&             min,
+                                         uint16_t&             max,
+                                         uint64_t&             sum,
+                                         dimension_size_type&  n)
+        {
+          uint16x8_t vmin = vdupq_n_u16(min);
+          uint16x8_t vmax = vdupq_n_u16(max);
+          uint64x2_t vsum = vdupq_n_u64(0U);
+          const dimension_size_type done =
+            blocks(data, count, [&](const uint16_t *p)
+                   {
+                     const uint16x8_t v = vld1q_u16(p);
+                     vmin = vminq_u16(vmin, v);
+                     vmax = vmaxq_u16(vmax, v);
+                     vsum = vpadalq_u32(vsum, vpaddlq_u16(v));
+                   });
+          uint16_t amin[8];
+          uint16_t amax[8];
+          vst1q_u16(amin, vmin);
+          vst1q_u16(amax, vmax);
+          combine(amin, amax, 8U, min, max);
+          sum += vgetq_lane_u64(vsum, 0) + vgetq_lane_u64(vsum, 1);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<int16_t, int64_t>(const int16_t        *data,
+                                       dimension_size_type   count,
+                                       int16_t&              min,
+                                       int16_t&              max,
+                                       int64_t&              sum,
+                                       dimension_size_type&  n)
+        {
+          int16x8_t vmin = vdupq_n_s16(min);
+          int16x8_t vmax = vdupq_n_s16(max);
+          int64x2_t vsum = vdupq_n_s64(0);
+          const dimension_size_type done =
+            blocks(data, count, [&](const int16_t *p)
+                   {
+                     const int16x8_t v = vld1q_s16(p);
+                     vmin = vminq_s16(vmin, v);
+                     vmax = vmaxq_s16(vmax, v);
+                     vsum = vpadalq_s32(vsum, vpaddlq_s16(v));
+                   });
+          int16_t amin[8];
+          int16_t amax[8];
+          vst1q_s16(amin, vmin);
+          vst1q_s16(amax, vmax);
+          combine(amin, amax, 8U, min, max);
+          sum += vgetq_lane_s64(vsum, 0) + vgetq_lane_s64(vsum, 1);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<uint32_t, uint64_t>(const uint32_t       *data,
+                                         dimension_size_type   count,
+                                         uint32_t&             min,
+                                         uint32_t&             max,
+                                         uint64_t&             sum,
+                                         dimension_size_type&  n)
+        {
+          uint32x4_t vmin = vdupq_n_u32(min);
+          uint32x4_t vmax = vdupq_n_u32(max);
+          uint64x2_t vsum = vdupq_n_u64(0U);
+          const dimension_size_type done =
+            blocks(data, count, [&](const uint32_t *p)
+                   {
+                     const uint32x4_t v = vld1q_u32(p);
+                     vmin = vminq_u32(vmin, v);
+                     vmax = vmaxq_u32(vmax, v);
+                     vsum = vpadalq_u32(vsum, v);
+                   });
+          uint32_t amin[4];
+          uint32_t amax[4];
+          vst1q_u32(amin, vmin);
+          vst1q_u32(amax, vmax);
+          combine(amin, amax, 4U, min, max);
+          sum += vgetq_lane_u64(vsum, 0) + vgetq_lane_u64(vsum, 1);
+          n += done;
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<int32_t, int64_t>(const int32_t        *data,
+                                       dimension_size_type   count,
+                                       int32_t&              min,
+                                       int32_t&              max,
+                                       int64_t&              sum,
+                                       dimension_size_type&  n)
+        {
+          int32x4_t vmin = vdupq_n_s32(min);
+          int32x4_t vmax = vdupq_n_s32(max);
+          int64x2_t vsum = vdupq_n_s64(0);
+          const dimension_size_type done =
+            blocks(data, count, [&](const int32_t *p)
+                   {
+                     const int32x4_t v = vld1q_s32(p);
+                     vmin = vminq_s32(vmin, v);
+                     vmax = vmaxq_s32(vmax, v);
+                     vsum = vpadalq_s32(vsum, v);
+                   });
+          int32_t amin[4];
+          int32_t amax[4];
+          vst1q_s32(amin, vmin);
+          vst1q_s32(amax, vmax);
+          combine(amin, amax, 4U, min, max);
+          sum += vgetq_lane_s64(vsum, 0) + vgetq_lane_s64(vsum, 1);
+          n += done;
+          return done;
+        }
+
+# if defined(__aarch64__)
+
+        // Floating point values are summed in double precision,
+        // which is only available on AArch64.  vminq_f32 returns
+        // NaN if either value is NaN, so select with a comparison
+        // instead, which is false for NaN.  NaN values are masked
+        // to zero for the sum, and only ordered values are counted.
+
+        template<>
+        dimension_size_type
+        simd_samples<float, double>(const float          *data,
+                                    dimension_size_type   count,
+                                    float&                min,
+                                    float&                max,
+                                    double&               sum,
+                                    dimension_size_type&  n)
+        {
+          float32x4_t vmin = vdupq_n_f32(min);
+          float32x4_t vmax = vdupq_n_f32(max);
+          float64x2_t vsum0 = vdupq_n_f64(0.0);
+          float64x2_t vsum1 = vdupq_n_f64(0.0);
+          uint64x2_t vcount = vdupq_n_u64(0U);
+          const dimension_size_type done =
+            blocks(data, count, [&](const float *p)
+                   {
+                     const float32x4_t v = vld1q_f32(p);
+                     vmin = vbslq_f32(vcltq_f32(v, vmin), v, vmin);
+                     vmax = vbslq_f32(vcgtq_f32(v, vmax), v, vmax);
+                     const uint32x4_t ordered = vceqq_f32(v, v);
+                     const float32x4_t m = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), ordered));
+                     vsum0 = vaddq_f64(vsum0, vcvt_f64_f32(vget_low_f32(m)));
+                     vsum1 = vaddq_f64(vsum1, vcvt_high_f64_f32(m));
+                     vcount = vpadalq_u32(vcount, vshrq_n_u32(ordered, 31));
+                   });
+          float amin[4];
+          float amax[4];
+          vst1q_f32(amin, vmin);
+          vst1q_f32(amax, vmax);
+          combine(amin, amax, 4U, min, max);
+          const float64x2_t vsum = vaddq_f64(vsum0, vsum1);
+          sum += vgetq_lane_f64(vsum, 0) + vgetq_lane_f64(vsum, 1);
+          n += static_cast<dimension_size_type>(vgetq_lane_u64(vcount, 0) + vgetq_lane_u64(vcount, 1));
+          return done;
+        }
+
+        template<>
+        dimension_size_type
+        simd_samples<double, double>(const double         *data,
+                                     dimension_size_type   count,
+                                     double&               min,
+                                     double&               max,
+                                     double&               sum,
+                                     dimension_size_type&  n)
+        {
+          float64x2_t vmin = vdupq_n_f64(min);
+          float64x2_t vmax = vdupq_n_f64(max);
+          float64x2_t vsum = vdupq_n_f64(0.0);
+          uint64x2_t vcount = vdupq_n_u64(0U);
+          const dimension_size_type done =
+            blocks(data, count, [&](const double *p)
+                   {
+                     const float64x2_t v = vld1q_f64(p);
+                     vmin = vbslq_f64(vcltq_f64(v, vmin), v, vmin);
+                     vmax = vbslq_f64(vcgtq_f64(v, vmax), v, vmax);
+                     const uint64x2_t ordered = vceqq_f64(v, v);
+                     vsum = vaddq_f64(vsum, vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(v), ordered)));
+                     vcount = vsubq_u64(vcount, ordered);
+                   });
+          double amin[2];
+          double amax[2];
+          vst1q_f64(amin, vmin);
+          vst1q_f64(amax, vmax);
+          combine(amin, amax, 2U, min, max);
+          sum += vgetq_lane_f64(vsum, 0) + vgetq_lane_f64(vsum, 1);
+          n += static_cast<dimension_size_type>(vgetq_lane_u64(vcount, 0) + vgetq_lane_u64(vcount, 1));
+          return done;
+        }
+
+# endif
+
+#endif
+
+      }
+
+      template<typename T, typename S>
+      dimension_size_type
+      accumulateSamples(const T             *data,
+                        dimension_size_type  count,
+                        T&                   min,
+                        T&                   max,
+                        S&                   sum)
+      {
+        dimension_size_type n = 0U;
+        for (dimension_size_type i = simd_samples(data, count, min, max, sum, n); i < count; ++i)
+          {
+            const T v = data[i];
+            if (is_nan(v))
+              continue;
+            min = v < min ? v : min;
+            max = v > max ? v : max;
+            sum += static_cast<S>(v);
+            ++n;
+          }
+        return n;
+      }
+
+      // Instantiated for the sample type of each real pixel type,
+      // with the sum types used by PixelStatistics.
+      template dimension_size_type accumulateSamples<bool, uint64_t>(const bool *, dimension_size_type,
+                                                                     bool&, bool&, uint64_t&);
+      template dimension_size_type accumulateSamples<int8_t, int64_t>(const int8_t *, dimension_size_type,
+                                                                      int8_t&, int8_t&, int64_t&);
+      template dimension_size_type accumulateSamples<int16_t, int64_t>(const int16_t *, dimension_size_type,
+                                                                       int16_t&, int16_t&, int64_t&);
+      template dimension_size_type accumulateSamples<int32_t, int64_t>(const int32_t *, dimension_size_type,
+                                                                       int32_t&, int32_t&, int64_t&);
+      template dimension_size_type accumulateSamples<uint8_t, uint64_t>(const uint8_t *, dimension_size_type,
+                                                                        uint8_t&, uint8_t&, uint64_t&);
+      template dimension_size_type accumulateSamples<uint16_t, uint64_t>(const uint16_t *, dimension_size_type,
+                                                                         uint16_t&, uint16_t&, uint64_t&);
+      template dimension_size_type accumulateSamples<uint32_t, uint64_t>(const uint32_t *, dimension_size_type,
+                                                                         uint32_t&, uint32_t&, uint64_t&);
+      template dimension_size_type accumulateSamples<float, double>(const float *, dimension_size_type,
+                                                                    float&, float&, double&);
+      template dimension_size_type accumulateSamples<double, double>(const double *, dimension_size_type,
+                                                                     double&, double&, double&);
+
+    }
+  }
+}
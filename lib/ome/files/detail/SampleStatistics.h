@@ -0,0 +1,90 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_SAMPLESTATISTICS_H
+#define OME_FILES_DETAIL_SAMPLESTATISTICS_H
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Accumulate the minimum, maximum and sum of an array of values.
+       *
+       * @p min, @p max and @p sum are updated with the values of
+       * @p data, and should be initialised by the caller.  NaN
+       * values are skipped.
+       *
+       * The 8-, 16- and 32-bit integer and floating point values
+       * use SIMD instructions where available (SSE2, and NEON;
+       * floating point only on AArch64).  The minimum, maximum and
+       * integer sums are identical to the scalar implementation;
+       * floating point sums are accumulated in a different order, so
+       * may differ by rounding.  The data need not be aligned.
+       *
+       * @param data the values.
+       * @param count the number of values.
+       * @param min the minimum value.
+       * @param max the maximum value.
+       * @param sum the sum of the values.
+       * @returns the number of values accumulated, excluding NaN.
+       */
+      template<typename T, typename S>
+      dimension_size_type
+      accumulateSamples(const T             *data,
+                        dimension_size_type  count,
+                        T&                   min,
+                        T&                   max,
+                        S&                   sum);
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_SAMPLESTATISTICS_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,157 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <memory>
+
+#include <ome/files/MemoryBudget.h>
+#include <ome/files/detail/TaskQueue.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      TaskQueue::TaskQueue(std::size_t depth):
+        depth(depth ? depth : 1U),
+        tasks(),
+        busy(false),
+        stop(false),
+        error(),
+        mutex(),
+        submitted(),
+        completed(),
+        worker([this]() { run(); })
+      {
+      }
+
+      TaskQueue::~TaskQueue()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          stop = true;
+        }
+        submitted.notify_one();
+        worker.join();
+      }
+
+      void
+      TaskQueue::submit(task_type   task,
+                        std::size_t bytes)
+      {
+        if (bytes)
+          {
+            // Released when the task is destroyed, after it has run
+            // or been discarded.
+            std::shared_ptr<MemoryBudget::Reservation> reservation
+              (std::make_shared<MemoryBudget::Reservation>
+               (MemoryBudget::global().reserve(MemoryBudget::WRITE_QUEUE, bytes)));
+            task_type inner(std::move(task));
+            task = [inner, reservation]() { inner(); };
+          }
+
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          completed.wait(lock, [this]() { return error || tasks.size() < depth; });
+          rethrow();
+          tasks.push_back(std::move(task));
+        }
+        submitted.notify_one();
+      }
+
+      void
+      TaskQueue::wait()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        completed.wait(lock, [this]() { return error || (tasks.empty() && !busy); });
+        rethrow();
+      }
+
+      void
+      TaskQueue::run()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+          {
+            submitted.wait(lock, [this]() { return stop || !tasks.empty(); });
+            if (tasks.empty())
+              break;
+
+            task_type task(std::move(tasks.front()));
+            tasks.pop_front();
+            busy = true;
+            lock.unlock();
+
+            std::exception_ptr taskerror;
+            try
+              {
+                task();
+              }
+            catch (...)
+              {
+                taskerror = std::current_exception();
+              }
+
+            lock.lock();
+            busy = false;
+            if (taskerror)
+              {
+                // Later tasks may depend upon this one; drop them.
+                if (!error)
+                  error = taskerror;
+                tasks.clear();
+              }
+            completed.notify_all();
+          }
+      }
+
+      void
+      TaskQueue::rethrow()
+      {
+        if (error)
+          {
+            std::exception_ptr e(error);
+            error = nullptr;
+            std::rethrow_exception(e);
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,160 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+#ifndef OME_FILES_DETAIL_TASKQUEUE_H
+#define OME_FILES_DETAIL_TASKQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Queue of tasks run in order by a single worker thread.
+       *
+       * Tasks are run in the order submitted.  The queue is bounded;
+       * submit() blocks while the queue is full, to limit the memory
+       * held by pending tasks.  If a task throws, the exception is
+       * stored and the remaining tasks are discarded; it is rethrown
+       * by the next call to submit() or wait().
+       */
+      class TaskQueue
+      {
+      public:
+        /// Task type.
+        typedef std::function<void ()> task_type;
+
+        /**
+         * Constructor.
+         *
+         * The worker thread is started on construction.
+         *
+         * @param depth the maximum number of pending tasks.
+         */
+        explicit
+        TaskQueue(std::size_t depth);
+
+        /**
+         * Destructor.
+         *
+         * Pending tasks are completed before the worker thread is
+         * joined.  Any stored exception is discarded; call wait()
+         * first to check for errors.
+         */
+        ~TaskQueue();
+
+        /// Copy constructor (deleted).
+        TaskQueue(const TaskQueue&) = delete;
+
+        /// Assignment operator (deleted).
+        TaskQueue&
+        operator= (const TaskQueue&) = delete;
+
+        /**
+         * Submit a task.
+         *
+         * If the task holds data to write, its size is reserved from
+         * the global MemoryBudget until the task has completed, and
+         * this blocks while the budget is exceeded by the data held
+         * by earlier tasks.
+         *
+         * @param task the task to run.
+         * @param bytes the size of the data held by the task (bytes).
+         * @throws the exception thrown by an earlier task, if any.
+         */
+        void
+        submit(task_type   task,
+               std::size_t bytes = 0U);
+
+        /**
+         * Wait for all submitted tasks to complete.
+         *
+         * @throws the exception thrown by an earlier task, if any.
+         */
+        void
+        wait();
+
+      private:
+        /// Run tasks until stopped.
+        void
+        run();
+
+        /// Rethrow and clear any stored exception (lock must be held).
+        void
+        rethrow();
+
+        /// Maximum number of pending tasks.
+        std::size_t depth;
+        /// Pending tasks.
+        std::deque<task_type> tasks;
+        /// The worker thread is running a task.
+        bool busy;
+        /// Stop the worker when the queue is empty.
+        bool stop;
+        /// Exception thrown by a task.
+        std::exception_ptr error;
+        /// Lock for all members above.
+        std::mutex mutex;
+        /// Signalled when a task is submitted or stop is set.
+        std::condition_variable submitted;
+        /// Signalled when a task completes.
+        std::condition_variable completed;
+        /// Worker thread.
+        std::thread worker;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_TASKQUEUE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,124 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+#include <iterator>
+
+#include <ome/files/detail/TileDedup.h>
+#include <ome/files/tiff/Util.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      TileDedup::TileDedup(std::size_t limit):
+        entries(),
+        index(),
+        limit(limit),
+        used(0U)
+      {
+      }
+
+      std::size_t
+      TileDedup::getLimit() const
+      {
+        return limit;
+      }
+
+      std::size_t
+      TileDedup::size() const
+      {
+        return used;
+      }
+
+      bool
+      TileDedup::find(const uint8_t *data,
+                      std::size_t    size,
+                      uint64_t&      offset)
+      {
+        const uint64_t hash = ome::files::tiff::tileHash(data, size);
+        auto range = index.equal_range(hash);
+        for (auto i = range.first; i != range.second; ++i)
+          {
+            const Entry& entry(*i->second);
+            if (entry.data.size() == size &&
+                (!size || !std::memcmp(entry.data.data(), data, size)))
+              {
+                offset = entry.offset;
+                entries.splice(entries.begin(), entries, i->second);
+                return true;
+              }
+          }
+        return false;
+      }
+
+      void
+      TileDedup::insert(const uint8_t *data,
+                        std::size_t    size,
+                        uint64_t       offset)
+      {
+        if (size > limit)
+          return;
+
+        while (!entries.empty() && used + size > limit)
+          {
+            const Entry& last(entries.back());
+            auto range = index.equal_range(last.hash);
+            for (auto i = range.first; i != range.second; ++i)
+              {
+                if (i->second == std::prev(entries.end()))
+                  {
+                    index.erase(i);
+                    break;
+                  }
+              }
+            used -= last.data.size();
+            entries.pop_back();
+          }
+
+        entries.push_front(Entry{ome::files::tiff::tileHash(data, size), offset, std::vector<uint8_t>(data, data + size)});
+        index.insert(std::make_pair(entries.front().hash, entries.begin()));
+        used += size;
+      }
+
+    }
+  }
+}
@@ -0,0 +1,169 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_TILEDEDUP_H
+#define OME_FILES_DETAIL_TILEDEDUP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Index of tile data already written to a file.
+       *
+       * Each entry records the encoded data of a tile and the file
+       * offset it was written at, so that later tiles with identical
+       * data may refer to the existing data rather than writing it
+       * again.  Entries are found by a hash of the data, and the
+       * data is compared in full, so that a hash collision can never
+       * produce a wrong match.  The total size of the data held is
+       * bounded; the least recently used entries are discarded to
+       * keep within the limit.  Empty and repetitive tiles typically
+       * compress to a few hundred bytes, so a small limit suffices to
+       * hold the tiles worth deduplicating.
+       *
+       * This class is not thread-safe.
+       */
+      class TileDedup
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param limit the maximum total size of the data held, in
+         * bytes.
+         */
+        explicit
+        TileDedup(std::size_t limit);
+
+        /// Copy constructor (deleted).
+        TileDedup(const TileDedup&) = delete;
+
+        /// Assignment operator (deleted).
+        TileDedup&
+        operator= (const TileDedup&) = delete;
+
+        /**
+         * Get the size limit.
+         *
+         * @returns the maximum total size of the data held, in bytes.
+         */
+        std::size_t
+        getLimit() const;
+
+        /**
+         * Get the total size of the data held.
+         *
+         * @returns the size in bytes.
+         */
+        std::size_t
+        size() const;
+
+        /**
+         * Find identical data.
+         *
+         * @param data the data to find.
+         * @param size the size of @p data in bytes.
+         * @param offset set to the file offset of the identical data
+         * if found.
+         * @returns @c true if found, @c false otherwise.
+         */
+        bool
+        find(const uint8_t *data,
+             std::size_t    size,
+             uint64_t&      offset);
+
+        /**
+         * Add written data.
+         *
+         * Data larger than the limit is not added.
+         *
+         * @param data the data written.
+         * @param size the size of @p data in bytes.
+         * @param offset the file offset the data was written at.
+         */
+        void
+        insert(const uint8_t *data,
+               std::size_t    size,
+               uint64_t       offset);
+
+      private:
+        /// An entry.
+        struct Entry
+        {
+          /// Hash of the data.
+          uint64_t             hash;
+          /// File offset of the data.
+          uint64_t             offset;
+          /// The data.
+          std::vector<uint8_t> data;
+        };
+
+        /// Entry list type.
+        typedef std::list<Entry> list_type;
+
+        /// Entries, most recently used first.
+        list_type entries;
+        /// Entries by hash.
+        std::unordered_multimap<uint64_t, list_type::iterator> index;
+        /// Size limit.
+        std::size_t limit;
+        /// Total size of the data held.
+        std::size_t used;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_TILEDEDUP_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,175 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/config-internal.h>
+#include <ome/files/detail/WriteBehind.h>
+
+#ifndef _MSC_VER
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      namespace
+      {
+
+        /// Window granularity.
+        const uint64_t window_granularity = 1024U * 1024U;
+
+#ifndef _MSC_VER
+
+        // Check if an error indicates that the file does not
+        // support writeback control, rather than a failed write.
+        bool
+        unsupported(int error)
+        {
+          return error == EINVAL || error == ENOSYS || error == ESPIPE ||
+            error == EOPNOTSUPP;
+        }
+
+        void
+        check(int result)
+        {
+          if (result != 0 && !unsupported(errno))
+            {
+              boost::format fmt("Failed to write back file data: %1%");
+              fmt % std::strerror(errno);
+              throw std::runtime_error(fmt.str());
+            }
+        }
+
+#endif // ! _MSC_VER
+
+      }
+
+      WriteBehind::WriteBehind(int      fd,
+                               uint64_t window):
+        fd(fd),
+        window(((window ? window : 1U) + window_granularity - 1U) / window_granularity * window_granularity),
+        submitted(0U),
+        released(0U),
+        enabled(fd >= 0)
+      {
+#ifdef _MSC_VER
+        enabled = false;
+#endif
+      }
+
+      uint64_t
+      WriteBehind::getWindow() const
+      {
+        return window;
+      }
+
+      void
+      WriteBehind::written(uint64_t end)
+      {
+        while (enabled && end >= submitted + window)
+          {
+#ifdef OME_FILES_HAVE_SYNC_FILE_RANGE
+            int result;
+            do
+              result = ::sync_file_range(fd, static_cast<off64_t>(submitted), static_cast<off64_t>(window),
+                                         SYNC_FILE_RANGE_WRITE);
+            while (result != 0 && errno == EINTR);
+            if (result != 0 && unsupported(errno))
+              {
+                enabled = false;
+                break;
+              }
+            check(result);
+#endif // OME_FILES_HAVE_SYNC_FILE_RANGE
+            submitted += window;
+
+            // Keep the most recently submitted window in flight.
+            if (submitted - released > window)
+              release(released, submitted - window - released);
+          }
+      }
+
+      void
+      WriteBehind::finish(uint64_t end)
+      {
+        if (enabled && end > released)
+          release(released, end - released);
+        submitted = released = end;
+      }
+
+      void
+      WriteBehind::release(uint64_t offset,
+                           uint64_t size)
+      {
+#ifndef _MSC_VER
+        int result;
+#  ifdef OME_FILES_HAVE_SYNC_FILE_RANGE
+        do
+          result = ::sync_file_range(fd, static_cast<off64_t>(offset), static_cast<off64_t>(size),
+                                     SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                     SYNC_FILE_RANGE_WAIT_AFTER);
+        while (result != 0 && errno == EINTR);
+#  else
+        do
+          result = ::fdatasync(fd);
+        while (result != 0 && errno == EINTR);
+#  endif
+        check(result);
+
+#  ifdef POSIX_FADV_DONTNEED
+        // Only clean pages are dropped, so this is safe even if
+        // part of the range has been rewritten since.
+        ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_DONTNEED);
+#  endif
+#endif // ! _MSC_VER
+        released = offset + size;
+      }
+
+    }
+  }
+}
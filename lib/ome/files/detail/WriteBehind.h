@@ -0,0 +1,155 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_WRITEBEHIND_H
+#define OME_FILES_DETAIL_WRITEBEHIND_H
+
+#include <cstdint>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace detail
+    {
+
+      /**
+       * Release sequentially written data from the page cache.
+       *
+       * Data written to a file normally remains in the page cache
+       * after it has been written back, so writing a file much
+       * larger than memory evicts other cached data, and the dirty
+       * pages accumulate until writeback stalls the writer.  As each
+       * window of the file is completed, its writeback is started,
+       * and once the window before it has been written back, its
+       * pages are dropped from the cache.  At most two windows are
+       * therefore held in the cache at any time, and the writeback
+       * of one window overlaps the writing of the next.
+       *
+       * This is only advisory; data rewritten behind the current
+       * window (such as a TIFF header) is simply cached again.  On
+       * Linux, writeback is started with sync_file_range.  On other
+       * POSIX systems, each window is synchronised with fdatasync
+       * before it is dropped.  On Windows, nothing is done.
+       */
+      class WriteBehind
+      {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param fd the file descriptor being written.  It is not
+         * owned, and must remain open while in use.
+         * @param window the window size in bytes (rounded up to a
+         * multiple of 1 MiB).
+         */
+        WriteBehind(int      fd,
+                    uint64_t window);
+
+        /// Copy constructor (deleted).
+        WriteBehind(const WriteBehind&) = delete;
+
+        /// Assignment operator (deleted).
+        WriteBehind&
+        operator= (const WriteBehind&) = delete;
+
+        /**
+         * Get the window size.
+         *
+         * @returns the window size in bytes.
+         */
+        uint64_t
+        getWindow() const;
+
+        /**
+         * Record that the file has been written up to an offset.
+         *
+         * Writeback is started for each window completed since the
+         * last call, and the windows preceding them are dropped.
+         *
+         * @param end the end of the written data (normally the file
+         * size).
+         * @throws std::runtime_error if writeback fails.
+         */
+        void
+        written(uint64_t end);
+
+        /**
+         * Write back and drop all the data written.
+         *
+         * @param end the end of the written data (normally the file
+         * size).
+         * @throws std::runtime_error if writeback fails.
+         */
+        void
+        finish(uint64_t end);
+
+      private:
+        /**
+         * Write back and drop a range.
+         *
+         * @param offset the start of the range.
+         * @param size the size of the range.
+         */
+        void
+        release(uint64_t offset,
+                uint64_t size);
+
+        /// File descriptor.
+        int fd;
+        /// Window size.
+        uint64_t window;
+        /// End of the data submitted for writeback.
+        uint64_t submitted;
+        /// End of the data dropped from the cache.
+        uint64_t released;
+        /// Advice is supported for this file.
+        bool enabled;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_WRITEBEHIND_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
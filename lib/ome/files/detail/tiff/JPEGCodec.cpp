@@ -0,0 +1,277 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <ome/files/detail/tiff/JPEGCodec.h>
+#include <ome/files/tiff/Exception.h>
+
+#ifdef OME_FILES_HAVE_JPEG
+extern "C"
+{
+#  include <jpeglib.h>
+}
+#endif // OME_FILES_HAVE_JPEG
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+      namespace detail
+      {
+
+        void
+        setRGBColorMode(::TIFF *tiff)
+        {
+          uint16_t compression = 0U;
+          uint16_t photometric = 0U;
+
+          if (TIFFGetMode(tiff) == O_RDONLY &&
+              TIFFIsCODECConfigured(COMPRESSION_JPEG) &&
+              TIFFGetField(tiff, TIFFTAG_COMPRESSION, &compression) &&
+              compression == COMPRESSION_JPEG &&
+              TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric) &&
+              photometric == PHOTOMETRIC_YCBCR)
+            TIFFSetField(tiff, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+        }
+
+#ifdef OME_FILES_HAVE_JPEG
+
+        namespace
+        {
+
+          /// libjpeg error manager returning to the decoder on error.
+          struct ErrorManager
+          {
+            /// libjpeg error manager (must be first).
+            jpeg_error_mgr pub;
+            /// Return point for errors.
+            std::jmp_buf jump;
+            /// Error message.
+            char message[JMSG_LENGTH_MAX];
+          };
+
+          void
+          error_exit(j_common_ptr cinfo)
+          {
+            ErrorManager *err = reinterpret_cast<ErrorManager *>(cinfo->err);
+            (*cinfo->err->format_message)(cinfo, err->message);
+            std::longjmp(err->jump, 1);
+          }
+
+          void
+          output_message(j_common_ptr /* cinfo */)
+          {
+            // Discard warnings; libtiff reports them as warnings
+            // only, and corrupt data is still decoded.
+          }
+
+          /// Per-thread JPEG decompressor.
+          struct Decompressor
+          {
+            /// Error manager.
+            ErrorManager error;
+            /// Decompressor state.
+            jpeg_decompress_struct cinfo;
+            /// The tables last loaded into the decompressor.
+            std::shared_ptr<const std::vector<uint8_t>> tables;
+
+            /// Constructor.
+            Decompressor():
+              error(),
+              cinfo(),
+              tables()
+            {
+              cinfo.err = jpeg_std_error(&error.pub);
+              error.pub.error_exit = error_exit;
+              error.pub.output_message = output_message;
+              jpeg_create_decompress(&cinfo);
+            }
+
+            /// Destructor.
+            ~Decompressor()
+            {
+              jpeg_destroy_decompress(&cinfo);
+            }
+
+            Decompressor(const Decompressor&) = delete;
+            Decompressor& operator=(const Decompressor&) = delete;
+          };
+
+          // Decode a tile.  libjpeg errors return here by longjmp,
+          // so no objects with destructors may be created in this
+          // function; the error message is left in the error
+          // manager.
+          bool
+          decode_jpeg(Decompressor&        d,
+                      const CodecTile&     tile,
+                      bool                 loadtables,
+                      const uint8_t       *encoded,
+                      dimension_size_type  encodedsize,
+                      uint8_t             *decoded,
+                      dimension_size_type  decodedsize)
+          {
+            jpeg_decompress_struct& cinfo(d.cinfo);
+
+            if (setjmp(d.error.jump))
+              {
+                jpeg_abort_decompress(&cinfo);
+                return false;
+              }
+
+            // Abbreviated table specification; the tables are
+            // retained by the decompressor for subsequent images.
+            if (loadtables && tile.tables && !tile.tables->empty())
+              {
+                jpeg_mem_src(&cinfo,
+                             const_cast<uint8_t *>(tile.tables->data()),
+                             static_cast<unsigned long>(tile.tables->size()));
+                jpeg_read_header(&cinfo, FALSE);
+              }
+
+            jpeg_mem_src(&cinfo,
+                         const_cast<uint8_t *>(encoded),
+                         static_cast<unsigned long>(encodedsize));
+            if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK)
+              {
+                std::strcpy(d.error.message, "No image in JPEG data");
+                jpeg_abort_decompress(&cinfo);
+                return false;
+              }
+
+            if (cinfo.image_width != tile.width ||
+                cinfo.image_height < tile.length ||
+                cinfo.num_components != tile.samples ||
+                cinfo.data_precision != 8)
+              {
+                std::strcpy(d.error.message, "JPEG image does not match tile dimensions");
+                jpeg_abort_decompress(&cinfo);
+                return false;
+              }
+
+            // As for libtiff, components are not converted unless
+            // YCbCr, since TIFF does not use JFIF color spaces.
+            if (tile.photometric == YCBCR)
+              {
+                cinfo.jpeg_color_space = JCS_YCbCr;
+                cinfo.out_color_space = JCS_RGB;
+              }
+            else
+              {
+                cinfo.jpeg_color_space = JCS_UNKNOWN;
+                cinfo.out_color_space = JCS_UNKNOWN;
+              }
+
+            jpeg_start_decompress(&cinfo);
+
+            const dimension_size_type rowbytes =
+              static_cast<dimension_size_type>(cinfo.output_width) * cinfo.output_components;
+            const dimension_size_type rows = std::min(static_cast<dimension_size_type>(tile.length),
+                                                      decodedsize / rowbytes);
+
+            JSAMPROW rowptrs[16];
+            while (cinfo.output_scanline < rows)
+              {
+                JDIMENSION count = 0U;
+                for (; count < 16U && cinfo.output_scanline + count < rows; ++count)
+                  rowptrs[count] = decoded + ((cinfo.output_scanline + count) * rowbytes);
+                jpeg_read_scanlines(&cinfo, rowptrs, count);
+              }
+
+            std::fill(decoded + (rows * rowbytes), decoded + decodedsize, uint8_t(0U));
+
+            // Skip the rest of the image, keeping the tables.
+            jpeg_abort_decompress(&cinfo);
+
+            return true;
+          }
+
+          bool
+          supports_jpeg(const CodecTile& tile)
+          {
+            return tile.bits == 8U &&
+              tile.sampleformat == UNSIGNED_INT &&
+              (tile.samples == 1U || tile.samples == 3U || tile.samples == 4U) &&
+              (tile.photometric != YCBCR || tile.samples == 3U);
+          }
+
+          void
+          decode(const CodecTile&     tile,
+                 const uint8_t       *encoded,
+                 dimension_size_type  encodedsize,
+                 uint8_t             *decoded,
+                 dimension_size_type  decodedsize)
+          {
+            thread_local Decompressor d;
+
+            if (!decode_jpeg(d, tile, d.tables != tile.tables,
+                             encoded, encodedsize, decoded, decodedsize))
+              {
+                // The tables may be incomplete; reload for the next
+                // tile.
+                d.tables.reset();
+                throw Exception(std::string("JPEG decoding failed: ") + d.error.message);
+              }
+            d.tables = tile.tables;
+          }
+
+        }
+
+        CodecPlugin
+        jpegCodecPlugin()
+        {
+          CodecPlugin plugin;
+          plugin.name = "JPEG";
+          plugin.scheme = static_cast<Compression>(COMPRESSION_JPEG);
+          plugin.decode = decode;
+          plugin.supports = supports_jpeg;
+          return plugin;
+        }
+
+#endif // OME_FILES_HAVE_JPEG
+
+      }
+    }
+  }
+}
@@ -0,0 +1,99 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_DETAIL_TIFF_JPEGCODEC_H
+#define OME_FILES_DETAIL_TIFF_JPEGCODEC_H
+
+#include <ome/files/config-internal.h>
+#include <ome/files/tiff/Codec.h>
+
+#include <tiffio.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+      namespace detail
+      {
+
+        /**
+         * Read JPEG-compressed YCbCr images as RGB.
+         *
+         * If the current directory of a TIFF opened for reading is
+         * JPEG-compressed YCbCr, set the JPEG color mode so that
+         * tiles are upsampled and converted to RGB, whether decoded
+         * by libtiff or by the JPEG codec plugin.  This must be
+         * repeated whenever the directory is changed.
+         *
+         * @param tiff the TIFF handle.
+         */
+        void
+        setRGBColorMode(::TIFF *tiff);
+
+#ifdef OME_FILES_HAVE_JPEG
+        /**
+         * Get the libjpeg codec plugin.
+         *
+         * The plugin decodes tiles and strips of 8-bit samples
+         * directly with libjpeg.  Each thread keeps a decompressor
+         * with the JPEGTables of the last directory loaded, so the
+         * tables are only parsed again when a different directory is
+         * read.  YCbCr is converted to RGB by libjpeg, which uses
+         * SIMD color conversion and upsampling with libjpeg-turbo.
+         * Encoding is left to libtiff.
+         *
+         * @returns the plugin.
+         */
+        CodecPlugin
+        jpegCodecPlugin();
+#endif // OME_FILES_HAVE_JPEG
+
+      }
+    }
+  }
+}
+
+#endif // OME_FILES_DETAIL_TIFF_JPEGCODEC_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
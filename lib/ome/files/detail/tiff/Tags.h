@@ -40,6 +40,9 @@
 
 #define TIFFTAG_IMAGEJ_META_DATA_BYTE_COUNTS 50838 /* ImageJMetaDataByteCounts */
 #define TIFFTAG_IMAGEJ_META_DATA             50839 /* ImageJMetaData */
+#define TIFFTAG_OME_TILE_HASHES_ENCODED      65420 /* OMETileHashesEncoded (private) */
+#define TIFFTAG_OME_TILE_HASHES_DECODED      65421 /* OMETileHashesDecoded (private) */
+#define TIFFTAG_OME_TILE_SUMMARIES           65422 /* OMETileSummaries (private) */
 
 #endif // OME_FILES_DETAIL_TIFF_TAGS_H
 
@@ -35,15 +35,21 @@
  * #L%
  */
 
+#include <algorithm>
 #include <cassert>
 
 #include <boost/format.hpp>
+#include <boost/optional.hpp>
 #include <boost/range/size.hpp>
 
 #include <ome/files/FormatException.h>
 #include <ome/files/FormatTools.h>
 #include <ome/files/MetadataTools.h>
+#include <ome/files/detail/Memo.h>
 #include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/tiff/DecodedTileCache.h>
+#include <ome/files/tiff/DirectoryParser.h>
+#include <ome/files/tiff/Exception.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/TIFF.h>
 #include <ome/files/tiff/Util.h>
@@ -80,16 +86,27 @@ namespace ome
           return p;
         }
 
-        const ReaderProperties props(tiff_properties());
+        const ReaderProperties&
+        props()
+        {
+          static const ReaderProperties p(tiff_properties());
+          return p;
+        }
 
         const std::vector<std::string> companion_suffixes{"txt", "xml"};
 
       }
 
       MinimalTIFFReader::MinimalTIFFReader():
-        ::ome::files::detail::FormatReader(props),
+        ::ome::files::detail::FormatReader(props()),
         tiff(),
-        seriesIFDRange()
+        seriesIFDRange(),
+        tileCache(std::make_shared<tiff::DecodedTileCache>()),
+        statistics(),
+        indexSidecar(false),
+        readHandles(0U),
+        lazyDirectories(false),
+        lazyKey()
       {
         domains.push_back(getDomain(GRAPHICS_DOMAIN));
       }
@@ -97,7 +114,13 @@ namespace ome
       MinimalTIFFReader::MinimalTIFFReader(const ReaderProperties& readerProperties):
         ::ome::files::detail::FormatReader(readerProperties),
         tiff(),
-        seriesIFDRange()
+        seriesIFDRange(),
+        tileCache(std::make_shared<tiff::DecodedTileCache>()),
+        statistics(),
+        indexSidecar(false),
+        readHandles(0U),
+        lazyDirectories(false),
+        lazyKey()
       {
         domains.push_back(getDomain(GRAPHICS_DOMAIN));
       }
@@ -116,14 +139,53 @@ namespace ome
       bool
       MinimalTIFFReader::isFilenameThisTypeImpl(const boost::filesystem::path& name) const
       {
-        return static_cast<bool>(TIFF::open(name, "r"));
+        // Parse the first IFD natively, without opening with libtiff.
+        try
+          {
+            tiff::DirectoryParser parser(name);
+            return !parser.directory(0).entries.empty();
+          }
+        catch (const tiff::Exception&)
+          {
+            return false;
+          }
+      }
+
+      bool
+      MinimalTIFFReader::isStreamThisTypeImpl(std::istream& stream) const
+      {
+        uint8_t header[4];
+        if (!stream.read(reinterpret_cast<char *>(header), sizeof(header)))
+          return false;
+
+        return tiff::isTIFFHeader(header, header + sizeof(header));
       }
 
       const std::shared_ptr<const tiff::IFD>
       MinimalTIFFReader::ifdAtIndex(dimension_size_type plane) const
       {
-        dimension_size_type ifdidx = tiff::ifdIndex(seriesIFDRange, getSeries(), plane);
-        const std::shared_ptr<const IFD>& ifd(tiff->getDirectoryByIndex(static_cast<tiff::directory_index_type>(ifdidx)));
+        return ifdAt(getSeries(), getResolution(), plane);
+      }
+
+      const std::shared_ptr<const IFD>
+      MinimalTIFFReader::ifdAt(dimension_size_type series,
+                               dimension_size_type resolution,
+                               dimension_size_type plane) const
+      {
+        dimension_size_type ifdidx = tiff::ifdIndex(seriesIFDRange, series, plane);
+        std::shared_ptr<const IFD> ifd(tiff->getDirectoryByIndex(static_cast<tiff::directory_index_type>(ifdidx)));
+
+        // IFDs read lazily were assumed to match the first IFD.
+        if (lazyKey && !(SeriesKey(*ifd) == *lazyKey))
+          {
+            boost::format fmt("IFD %1% does not match the shape of the first IFD; "
+                              "disable lazy directory reading to read it as a separate series");
+            fmt % ifdidx;
+            throw FormatException(fmt.str());
+          }
+
+        if (resolution > 0U)
+          ifd = tiff::subResolutionIFD(*ifd, resolution);
 
         return ifd;
       }
@@ -131,18 +193,121 @@ namespace ome
       void
       MinimalTIFFReader::close(bool fileOnly)
       {
+        clearPrefetch();
+
         // Drop shared reference to open TIFF.
         tiff.reset();
+        lazyKey.reset();
 
         ::ome::files::detail::FormatReader::close(fileOnly);
       }
 
+      void
+      MinimalTIFFReader::setDecodeThreads(unsigned int threads)
+      {
+        ::ome::files::detail::FormatReader::setDecodeThreads(threads);
+
+        if (tiff)
+          tiff->setDecodeThreads(getDecodeThreads());
+      }
+
+      void
+      MinimalTIFFReader::setExecutor(const std::shared_ptr<Executor>& executor)
+      {
+        ::ome::files::detail::FormatReader::setExecutor(executor);
+
+        if (tiff)
+          tiff->setExecutor(executor);
+      }
+
+      void
+      MinimalTIFFReader::setTileCache(std::shared_ptr<tiff::DecodedTileCache> cache)
+      {
+        tileCache = cache;
+
+        if (tiff)
+          tiff->setTileCache(tileCache);
+      }
+
+      const std::shared_ptr<tiff::DecodedTileCache>&
+      MinimalTIFFReader::getTileCache() const
+      {
+        return tileCache;
+      }
+
+      void
+      MinimalTIFFReader::setStatistics(std::shared_ptr<PixelStatistics> sink)
+      {
+        statistics = sink;
+
+        if (tiff)
+          tiff->setStatistics(statistics);
+      }
+
+      const std::shared_ptr<PixelStatistics>&
+      MinimalTIFFReader::getStatistics() const
+      {
+        return statistics;
+      }
+
+      void
+      MinimalTIFFReader::setIndexSidecar(bool sidecar)
+      {
+        indexSidecar = sidecar;
+      }
+
+      bool
+      MinimalTIFFReader::getIndexSidecar() const
+      {
+        return indexSidecar;
+      }
+
+      void
+      MinimalTIFFReader::setReadHandles(unsigned int handles)
+      {
+        readHandles = handles;
+
+        if (tiff)
+          tiff->setReadHandles(readHandles);
+      }
+
+      unsigned int
+      MinimalTIFFReader::getReadHandles() const
+      {
+        return readHandles;
+      }
+
+      void
+      MinimalTIFFReader::setLazyDirectories(bool lazy)
+      {
+        lazyDirectories = lazy;
+      }
+
+      bool
+      MinimalTIFFReader::getLazyDirectories() const
+      {
+        return lazyDirectories;
+      }
+
       void
       MinimalTIFFReader::initFile(const boost::filesystem::path& id)
       {
         ::ome::files::detail::FormatReader::initFile(id);
 
-        tiff = TIFF::open(id, "r");
+        openTIFF(id);
+
+        readIFDs();
+
+        if (isIndexedExpanded())
+          expandIndexedCore();
+
+        fillMetadata(*getMetadataStore(), *this);
+      }
+
+      void
+      MinimalTIFFReader::openTIFF(const boost::filesystem::path& id)
+      {
+        tiff = TIFF::open(id, "r", ioStatistics);
 
         if (!tiff)
           {
@@ -151,36 +316,104 @@ namespace ome
             throw FormatException(fmt.str());
           }
 
-        readIFDs();
-
-        fillMetadata(*getMetadataStore(), *this);
+        tiff->setDecodeThreads(getDecodeThreads());
+        tiff->setExecutor(executor);
+        tiff->setTileCache(tileCache);
+        tiff->setStatistics(statistics);
+        tiff->setIndexSidecar(indexSidecar);
+        tiff->setReadHandles(readHandles);
+        tiff->setNormalized(isNormalized());
       }
 
-      namespace
+      /**
+       * Properties deciding whether IFDs belong to the same series.
+       *
+       * Only the dimensions, pixel type, samples, planar
+       * configuration and photometric interpretation are used.
+       * These are all in the tag snapshot loaded when the IFD is
+       * opened, so no further tags are read to group IFDs.
+       */
+      struct MinimalTIFFReader::SeriesKey
       {
+        /// Image width.
+        uint32_t width;
+        /// Image height.
+        uint32_t height;
+        /// Pixel type.
+        ome::xml::model::enums::PixelType pixeltype;
+        /// Samples per pixel.
+        uint16_t samples;
+        /// Planar configuration.
+        tiff::PlanarConfiguration planarconfig;
+        /// Photometric interpretation.
+        tiff::PhotometricInterpretation photometric;
+
+        /**
+         * Constructor.
+         *
+         * @param ifd the IFD to use.
+         */
+        SeriesKey(const tiff::IFD& ifd):
+          width(ifd.getImageWidth()),
+          height(ifd.getImageHeight()),
+          pixeltype(ifd.getPixelType()),
+          samples(ifd.getSamplesPerPixel()),
+          planarconfig(ifd.getPlanarConfiguration()),
+          photometric(ifd.getPhotometricInterpretation())
+        {
+        }
 
-        // Compare IFDs for equal dimensions, pixel type, photometric
-        // interpretation.
+        /**
+         * Compare for equality.
+         *
+         * @param rhs the key to compare with.
+         * @returns @c true if equal, @c false otherwise.
+         */
         bool
-        compare_ifd(const tiff::IFD& lhs,
-                    const tiff::IFD& rhs)
+        operator== (const SeriesKey& rhs) const
         {
-          return (lhs.getImageWidth() == rhs.getImageWidth() &&
-                  lhs.getImageHeight() == rhs.getImageHeight() &&
-                  lhs.getPixelType() == rhs.getPixelType() &&
-                  lhs.getSamplesPerPixel() == rhs.getSamplesPerPixel() &&
-                  lhs.getPlanarConfiguration() == rhs.getPlanarConfiguration() &&
-                  lhs.getPhotometricInterpretation() == rhs.getPhotometricInterpretation());
+          return (width == rhs.width &&
+                  height == rhs.height &&
+                  pixeltype == rhs.pixeltype &&
+                  samples == rhs.samples &&
+                  planarconfig == rhs.planarconfig &&
+                  photometric == rhs.photometric);
         }
-
-      }
+      };
 
       void
       MinimalTIFFReader::readIFDs()
       {
         core.clear();
+        seriesIFDRange.clear();
+
+        if (lazyDirectories)
+          {
+            // Only the first IFD is read; the remaining IFDs are
+            // assumed to be further timepoints of the same shape,
+            // and are checked by ifdAt() when read.
+            std::shared_ptr<IFD> first(tiff->getDirectoryByIndex(0U));
+            const dimension_size_type count = tiff->directoryCount();
+
+            std::shared_ptr<CoreMetadata> c(makeCoreMetadata(*first, !isOriginalMetadataLazy()));
+            c->sizeT = count;
+            c->imageCount = c->sizeT;
+            core.push_back(c);
+
+            tiff::IFDRange range;
+            range.filename = *currentId;
+            range.begin = 0U;
+            range.end = count;
+            seriesIFDRange.push_back(range);
+
+            lazyKey = std::make_shared<const SeriesKey>(*first);
+
+            if (!hasFlattenedResolutions())
+              addSubResolutions();
+            return;
+          }
 
-        std::shared_ptr<const tiff::IFD> prev_ifd;
+        boost::optional<SeriesKey> prev_key;
         std::shared_ptr<CoreMetadata> prev_core;
 
         dimension_size_type current_ifd = 0U;
@@ -193,8 +426,10 @@ namespace ome
             // the pixel data is of the same format as the pixel data
             // in the preceding IFD, then this is a following
             // timepoint in a series.  Otherwise, a new series is
-            // started.
-            if (prev_core && prev_ifd && compare_ifd(*prev_ifd, **i))
+            // started, and the full core metadata is read from its
+            // first IFD only.
+            SeriesKey key(**i);
+            if (prev_core && prev_key && key == *prev_key)
               {
                 ++prev_core->sizeT;
                 prev_core->imageCount = prev_core->sizeT;
@@ -202,7 +437,7 @@ namespace ome
               }
             else
               {
-                prev_core = makeCoreMetadata(**i);
+                prev_core = makeCoreMetadata(**i, !isOriginalMetadataLazy());
                 core.push_back(prev_core);
 
                 tiff::IFDRange range;
@@ -212,10 +447,149 @@ namespace ome
 
                 seriesIFDRange.push_back(range);
               }
-            prev_ifd = *i;
+            prev_key = key;
+          }
+
+        if (!hasFlattenedResolutions())
+          addSubResolutions();
+      }
+
+      bool
+      MinimalTIFFReader::isMemoizable() const
+      {
+        return true;
+      }
+
+      void
+      MinimalTIFFReader::saveMemoState(::ome::files::detail::MemoWriter& memo) const
+      {
+        memo.writeBool(lazyDirectories);
+
+        memo.writeUInt(seriesIFDRange.size());
+        for (const auto& range : seriesIFDRange)
+          {
+            memo.writeString(range.filename.string());
+            memo.writeUInt(range.begin);
+            memo.writeUInt(range.end);
+          }
+
+        const std::vector<tiff::offset_type> offsets(tiff->getDirectoryOffsets());
+        memo.writeUInt(offsets.size());
+        memo.writeBytes(offsets.data(), offsets.size() * sizeof(tiff::offset_type));
+      }
+
+      bool
+      MinimalTIFFReader::restoreMemoState(::ome::files::detail::MemoReader& memo)
+      {
+        if (memo.readBool() != lazyDirectories)
+          return false;
+
+        seriesIFDRange.clear();
+        const uint64_t ranges = memo.readCount(sizeof(uint64_t) * 3U);
+        for (uint64_t i = 0; i < ranges; ++i)
+          {
+            tiff::IFDRange range;
+            range.filename = memo.readString();
+            range.begin = memo.readUInt();
+            range.end = memo.readUInt();
+            seriesIFDRange.push_back(range);
+          }
+
+        std::vector<tiff::offset_type> offsets(memo.readCount(sizeof(tiff::offset_type)));
+        memo.readBytes(offsets.data(), offsets.size() * sizeof(tiff::offset_type));
+
+        // The directory chain is not walked if the saved offsets
+        // are usable.
+        openTIFF(*currentId);
+        tiff->setDirectoryOffsets(offsets);
+
+        if (lazyDirectories)
+          lazyKey = std::make_shared<const SeriesKey>(*tiff->getDirectoryByIndex(0U));
+
+        return true;
+      }
+
+      void
+      MinimalTIFFReader::readOriginalMetadata() const
+      {
+        // Sub-resolutions share the series metadata of the full
+        // resolution image, as when read by readIFDs().  Derived
+        // readers which do not fill seriesIFDRange read their
+        // metadata from the first IFD.
+        for (dimension_size_type i = 0; i < core.size(); ++i)
+          {
+            dimension_size_type series = coreIndexToSeries(i);
+            std::shared_ptr<const IFD> ifd;
+            if (series < seriesIFDRange.size())
+              ifd = ifdAt(series, 0U, 0U);
+            else
+              ifd = tiff->getDirectoryByIndex(0U);
+            tiff::getSeriesMetadata(*ifd, core.at(i)->seriesMetadata);
+          }
+      }
+
+      void
+      MinimalTIFFReader::addSubResolutions()
+      {
+        coremetadata_list_type series;
+        series.swap(core);
+
+        for (coremetadata_list_type::size_type s = 0; s < series.size(); ++s)
+          {
+            const std::shared_ptr<CoreMetadata>& full(series.at(s));
+            const tiff::IFDRange& range(seriesIFDRange.at(s));
+
+            std::shared_ptr<const IFD> ifd(tiff->getDirectoryByIndex(static_cast<tiff::directory_index_type>(range.begin)));
+            dimension_size_type levels = tiff::subResolutionCount(*ifd);
+
+            full->resolutionCount = 1U + levels;
+            core.push_back(full);
+
+            for (dimension_size_type r = 1U; r <= levels; ++r)
+              {
+                std::shared_ptr<const IFD> sub(tiff::subResolutionIFD(*ifd, r));
+                std::shared_ptr<CoreMetadata> subcore(std::make_shared<CoreMetadata>(*full));
+                subcore->sizeX = sub->getImageWidth();
+                subcore->sizeY = sub->getImageHeight();
+                subcore->resolutionCount = 1U;
+                core.push_back(subcore);
+              }
+          }
+      }
+
+      void
+      MinimalTIFFReader::expandIndexedCore()
+      {
+        for (dimension_size_type i = 0; i < core.size(); ++i)
+          {
+            CoreMetadata& c(*core.at(i));
+            if (!c.indexed)
+              continue;
+
+            dimension_size_type series = coreIndexToSeries(i);
+            std::shared_ptr<const IFD> ifd;
+            if (series < seriesIFDRange.size())
+              ifd = ifdAt(series, 0U, 0U);
+            else
+              ifd = tiff->getDirectoryByIndex(0U);
+            if (!ifd->isExpandable())
+              continue;
+
+            c.pixelType = ::ome::xml::model::enums::PixelType::UINT16;
+            c.bitsPerPixel = 16U;
+            std::fill(c.sizeC.begin(), c.sizeC.end(), 3U);
+            c.interleaved = true;
+            c.indexed = false;
+            c.falseColor = false;
           }
       }
 
+      bool
+      MinimalTIFFReader::expanded(const tiff::IFD& ifd) const
+      {
+        return isIndexedExpanded() && ifd.isExpandable();
+      }
+
       void
       MinimalTIFFReader::getLookupTable(dimension_size_type plane,
                                         VariantPixelBuffer& buf) const
@@ -236,6 +610,13 @@ namespace ome
           }
       }
 
+      bool
+      MinimalTIFFReader::isNormalizedOnRead() const
+      {
+        // Normalized per tile by IFD::readImage(); see openTIFF().
+        return true;
+      }
+
       void
       MinimalTIFFReader::openBytesImpl(dimension_size_type plane,
                                        VariantPixelBuffer& buf,
@@ -248,7 +629,173 @@ namespace ome
 
         const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
 
-        ifd->readImage(buf, x, y, w, h);
+        if (expanded(*ifd))
+          ifd->readImageExpanded(buf, PlaneRegion(x, y, w, h));
+        else
+          ifd->readImage(buf, x, y, w, h);
+      }
+
+      void
+      MinimalTIFFReader::openBytesBatchImpl(dimension_size_type              plane,
+                                            const std::vector<PlaneRegion>&  regions,
+                                            std::vector<VariantPixelBuffer>& bufs) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        if (expanded(*ifd))
+          {
+            bufs.resize(regions.size());
+            for (std::vector<PlaneRegion>::size_type i = 0; i < regions.size(); ++i)
+              ifd->readImageExpanded(bufs[i], regions[i]);
+          }
+        else
+          ifd->readImages(bufs, regions);
+      }
+
+      void
+      MinimalTIFFReader::openBytesDecimatedImpl(dimension_size_type plane,
+                                                VariantPixelBuffer& buf,
+                                                const PlaneRegion&  region,
+                                                dimension_size_type xstep,
+                                                dimension_size_type ystep) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        if (expanded(*ifd))
+          ifd->readImageExpanded(buf, region, xstep, ystep);
+        else
+          ifd->readImage(buf, region, xstep, ystep);
+      }
+
+      void
+      MinimalTIFFReader::openBytesAtImpl(dimension_size_type series,
+                                         dimension_size_type resolution,
+                                         dimension_size_type plane,
+                                         VariantPixelBuffer& buf,
+                                         const PlaneRegion&  region) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAt(series, resolution, plane));
+
+        if (expanded(*ifd))
+          ifd->readImageExpanded(buf, region);
+        else
+          ifd->readImage(buf, region.x, region.y, region.w, region.h);
+      }
+
+      void
+      MinimalTIFFReader::openBytesIntoImpl(dimension_size_type     series,
+                                           dimension_size_type     resolution,
+                                           dimension_size_type     plane,
+                                           VariantPixelBufferView& buf,
+                                           const PlaneRegion&      region) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAt(series, resolution, plane));
+
+        if (expanded(*ifd))
+          ::ome::files::detail::FormatReader::openBytesIntoImpl(series, resolution, plane, buf, region);
+        else
+          ifd->readImage(buf, region);
+      }
+
+      void
+      MinimalTIFFReader::forEachTileImpl(dimension_size_type  plane,
+                                         const tile_callback& callback) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->forEachTile(callback, expanded(*ifd));
+      }
+
+      void
+      MinimalTIFFReader::openRawTile(dimension_size_type   plane,
+                                     dimension_size_type   tile,
+                                     std::vector<uint8_t>& buf) const
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->readRawTile(tile, buf);
+      }
+
+      void
+      MinimalTIFFReader::forEachTileInRange(dimension_size_type  plane,
+                                            double               low,
+                                            double               high,
+                                            const tile_callback& callback) const
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+        clearPrefetch();
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->forEachTileInRange(low, high, callback, expanded(*ifd));
+      }
+
+      dimension_size_type
+      MinimalTIFFReader::getOptimalTileWidth(dimension_size_type channel) const
+      {
+        assertId(currentId, true);
+
+        return ifdAtIndex(getIndex(0U, channel, 0U))->getTileInfo().tileWidth();
+      }
+
+      dimension_size_type
+      MinimalTIFFReader::getOptimalTileHeight(dimension_size_type channel) const
+      {
+        assertId(currentId, true);
+
+        const tiff::TileInfo tinfo(ifdAtIndex(getIndex(0U, channel, 0U))->getTileInfo());
+        if (tinfo.tileType() == tiff::TILE)
+          return tinfo.tileHeight();
+
+        // Strips are often a single row, so use as many whole strips
+        // as fit in the default band height.
+        const dimension_size_type strip = std::max(tinfo.tileHeight(), dimension_size_type(1U));
+        const dimension_size_type band = detail::FormatReader::getOptimalTileHeight(channel);
+        return std::min(std::max(strip, (band / strip) * strip), getSizeY());
+      }
+
+      tiff::TileGrid
+      MinimalTIFFReader::getTileGrid(dimension_size_type resolution) const
+      {
+        assertId(currentId, true);
+
+        if (resolution >= getResolutionCount())
+          {
+            boost::format fmt("Invalid resolution: %1%");
+            fmt % resolution;
+            throw std::logic_error(fmt.str());
+          }
+
+        return ifdAt(getSeries(), resolution, 0U)->getTileInfo().tileGrid();
+      }
+
+      std::vector<tiff::TileGrid>
+      MinimalTIFFReader::getTileGrids() const
+      {
+        assertId(currentId, true);
+
+        std::vector<tiff::TileGrid> grids;
+        const dimension_size_type count = getResolutionCount();
+        grids.reserve(count);
+        for (dimension_size_type r = 0; r < count; ++r)
+          grids.push_back(getTileGrid(r));
+        return grids;
       }
 
       std::shared_ptr<ome::files::tiff::TIFF>
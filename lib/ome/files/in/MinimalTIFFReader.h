@@ -48,9 +48,13 @@ namespace ome
 {
   namespace files
   {
+
+    class PixelStatistics;
+
     namespace tiff
     {
 
+      class DecodedTileCache;
       class TIFF;
       class IFD;
 
@@ -68,6 +72,9 @@ namespace ome
        */
       class MinimalTIFFReader : public ::ome::files::detail::FormatReader
       {
+        using ::ome::files::FormatReader::getOptimalTileWidth;
+        using ::ome::files::FormatReader::getOptimalTileHeight;
+
       protected:
         /// Underlying TIFF file.
         std::shared_ptr<ome::files::tiff::TIFF> tiff;
@@ -75,6 +82,27 @@ namespace ome
         /// Mapping between series index and start and end IFD as a half-open range.
         tiff::SeriesIFDRange seriesIFDRange;
 
+        /// Decoded tile cache.
+        std::shared_ptr<ome::files::tiff::DecodedTileCache> tileCache;
+
+        /// Pixel statistics sink.
+        std::shared_ptr<PixelStatistics> statistics;
+
+        /// Use a sidecar directory index.
+        bool indexSidecar;
+
+        /// Number of pooled read handles per TIFF file.
+        unsigned int readHandles;
+
+        /// Read IFDs lazily.
+        bool lazyDirectories;
+
+        /// Properties deciding whether IFDs belong to the same series.
+        struct SeriesKey;
+
+        /// Expected properties of every IFD, when read lazily.
+        std::shared_ptr<const SeriesKey> lazyKey;
+
       public:
         /// Constructor.
         MinimalTIFFReader();
@@ -95,6 +123,26 @@ namespace ome
         void
         initFile(const boost::filesystem::path& id);
 
+        /**
+         * Open the TIFF file.
+         *
+         * The decode threads, tile cache, statistics and sidecar
+         * settings of the reader are applied to the opened file.
+         *
+         * @param id the filename to open.
+         * @throws FormatException if the file could not be opened.
+         */
+        void
+        openTIFF(const boost::filesystem::path& id);
+
+        // Documented in superclass.
+        void
+        saveMemoState(::ome::files::detail::MemoWriter& memo) const;
+
+        // Documented in superclass.
+        bool
+        restoreMemoState(::ome::files::detail::MemoReader& memo);
+
         /**
          * Read metadata from IFDs.
          */
@@ -102,10 +150,58 @@ namespace ome
         void
         readIFDs();
 
+        /**
+         * Add sub-resolutions from SubIFDs.
+         *
+         * Each series is followed by a CoreMetadata entry for each
+         * sub-resolution of the first IFD in the series.  Only used
+         * when resolutions are not flattened.
+         */
+        void
+        addSubResolutions();
+
+        /**
+         * Describe indexed color series as RGB.
+         *
+         * Used when indexed color expansion is enabled.  The core
+         * metadata of each series of palette color images is changed
+         * to three interleaved @c UINT16 subchannels which are not
+         * indexed, matching the pixel data read with
+         * tiff::IFD::readImageExpanded().
+         */
+        void
+        expandIndexedCore();
+
+        /**
+         * Check if an IFD is expanded to RGB when read.
+         *
+         * @param ifd the IFD to check.
+         * @returns @c true if indexed color expansion is enabled and
+         * the IFD is palette color, @c false otherwise.
+         */
+        bool
+        expanded(const tiff::IFD& ifd) const;
+
+        // Documented in superclass.
+        void
+        readOriginalMetadata() const;
+
         // Documented in superclass.
         bool
         isFilenameThisTypeImpl(const boost::filesystem::path& name) const;
 
+        /**
+         * isThisType stream implementation for readers.
+         *
+         * The stream is valid if it starts with a classic TIFF or
+         * BigTIFF header.
+         *
+         * @param stream the input stream to check.
+         * @returns @c true if the stream is valid, @c false otherwise.
+         */
+        bool
+        isStreamThisTypeImpl(std::istream& stream) const;
+
         /**
          * Get the IFD index for a plane in the current series.
          *
@@ -116,17 +212,264 @@ namespace ome
         const std::shared_ptr<const tiff::IFD>
         ifdAtIndex(dimension_size_type plane) const;
 
+        /**
+         * Get the IFD for a plane of any series and resolution.
+         *
+         * The current series and resolution are not used.
+         *
+         * @param series the series index.
+         * @param resolution the resolution index within the series.
+         * @param plane the plane index within the series.
+         * @returns the IFD.
+         * @throws FormatException if out of range.
+         */
+        const std::shared_ptr<const tiff::IFD>
+        ifdAt(dimension_size_type series,
+              dimension_size_type resolution,
+              dimension_size_type plane) const;
+
       public:
         // Documented in superclass.
         void
         close(bool fileOnly = false);
 
+        // Documented in superclass.
+        bool
+        isMemoizable() const;
+
+        // Documented in superclass.
+        void
+        setDecodeThreads(unsigned int threads);
+
+        // Documented in superclass.
+        void
+        setExecutor(const std::shared_ptr<Executor>& executor);
+
+        /**
+         * Set the decoded tile cache.
+         *
+         * Decoded tiles are cached to avoid decoding the same tiles
+         * repeatedly when reading overlapping regions.  The cache
+         * may be shared with other readers.  By default, each reader
+         * has its own cache with a budget of zero, which disables
+         * caching; use getTileCache()->setBudget() to enable it.
+         * To share decoded tiles with other processes, use
+         * getTileCache()->setSharedCache().
+         *
+         * @param cache the tile cache, or null to disable caching.
+         */
+        void
+        setTileCache(std::shared_ptr<ome::files::tiff::DecodedTileCache> cache);
+
+        /**
+         * Get the decoded tile cache.
+         *
+         * The cache may be used to adjust the budget and to obtain
+         * hit and miss statistics.
+         *
+         * @returns the tile cache, or null if caching is disabled.
+         */
+        const std::shared_ptr<ome::files::tiff::DecodedTileCache>&
+        getTileCache() const;
+
+        /**
+         * Set the pixel statistics sink.
+         *
+         * When set, statistics are accumulated for the pixels of
+         * each tile as it is read by openBytes(), without a second
+         * pass over the pixel data.  Use PixelStatistics::reset()
+         * between planes to obtain per-plane statistics.
+         *
+         * @param sink the statistics sink, or null to disable
+         * statistics.
+         * @see tiff::TIFF::setStatistics()
+         */
+        void
+        setStatistics(std::shared_ptr<PixelStatistics> sink);
+
+        /**
+         * Get the pixel statistics sink.
+         *
+         * @returns the statistics sink, or null if disabled.
+         */
+        const std::shared_ptr<PixelStatistics>&
+        getStatistics() const;
+
+        /**
+         * Enable or disable the sidecar directory index.
+         *
+         * When enabled, the directory offsets of each TIFF file are
+         * loaded from a sidecar index if it is up to date, avoiding
+         * a walk of all the directories on opening.  The index is
+         * written if missing or out of date.  This only has an
+         * effect on files opened after it is set.  Disabled by
+         * default.
+         *
+         * @param sidecar @c true to use a sidecar index, @c false
+         * otherwise.
+         * @see tiff::TIFF::setIndexSidecar()
+         */
+        void
+        setIndexSidecar(bool sidecar);
+
+        /**
+         * Check if the sidecar directory index is enabled.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getIndexSidecar() const;
+
+        /**
+         * Set the number of pooled read handles for each TIFF file.
+         *
+         * When non-zero, each read of pixel data borrows an
+         * independent libtiff handle from a pool kept for its file,
+         * so that planes of the same file may be read concurrently,
+         * for example with openBytesAt() from several threads.  Up
+         * to this number of idle handles are kept open per file.
+         * Zero (the default) disables the pool, serialising reads of
+         * each file.
+         *
+         * @param handles the maximum number of idle handles to keep
+         * open per file.
+         * @see tiff::TIFF::setReadHandles()
+         */
+        void
+        setReadHandles(unsigned int handles);
+
+        /**
+         * Get the number of pooled read handles for each TIFF file.
+         *
+         * @returns the maximum number of idle handles kept open per
+         * file.
+         */
+        unsigned int
+        getReadHandles() const;
+
+        /**
+         * Enable or disable lazy reading of IFDs.
+         *
+         * By default, every IFD is read on opening in order to group
+         * the IFDs into series.  For files with many IFDs, this may
+         * take much longer than reading the planes which are needed.
+         * When enabled, only the first IFD is read on opening, and
+         * all the IFDs are assumed to be planes of a single series of
+         * the same shape.  Each IFD is checked when its plane is
+         * read, and a FormatException is thrown if it does not match
+         * the first IFD; such files must be opened with lazy reading
+         * disabled to group their IFDs into separate series.  This
+         * only has an effect on files opened after it is set.
+         * Disabled by default.
+         *
+         * @param lazy @c true to read IFDs lazily, @c false
+         * otherwise.
+         */
+        void
+        setLazyDirectories(bool lazy);
+
+        /**
+         * Check if lazy reading of IFDs is enabled.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getLazyDirectories() const;
+
         // Documented in superclass.
         void
         getLookupTable(dimension_size_type plane,
                        VariantPixelBuffer& buf) const;
 
+        // Documented in superclass.
+        void
+        openRawTile(dimension_size_type   plane,
+                    dimension_size_type   tile,
+                    std::vector<uint8_t>& buf) const;
+
+        /**
+         * Read the chunks of an image plane which may contain values
+         * in a range.
+         *
+         * As forEachTile(), but tiles whose summary, recorded when
+         * the file was written (see
+         * ome::files::tiff::TIFF::setTileSummaries()), shows that
+         * they contain no value in the closed range [@p low,
+         * @p high] are skipped without being read or decoded.  This
+         * permits threshold searches of sparse images to read only
+         * the tiles containing signal.  Files written without
+         * summaries are read in full.
+         *
+         * @param plane the plane index within the series.
+         * @param low the lowest value of interest.
+         * @param high the highest value of interest.
+         * @param callback the function to call for each chunk.
+         * @see ome::files::tiff::IFD::forEachTileInRange()
+         */
+        void
+        forEachTileInRange(dimension_size_type  plane,
+                           double               low,
+                           double               high,
+                           const tile_callback& callback) const;
+
+        /**
+         * Get the optimal sub-image width for use with openBytes().
+         *
+         * This is the native tile width of the current series and
+         * resolution, or the image width for strips.
+         *
+         * @param channel the channel to check.
+         * @returns the optimal width.
+         */
+        dimension_size_type
+        getOptimalTileWidth(dimension_size_type channel) const;
+
+        /**
+         * Get the optimal sub-image height for use with openBytes().
+         *
+         * This is the native tile height of the current series and
+         * resolution.  For strips, this is the largest whole number
+         * of strips within the default band height (see
+         * detail::FormatReader::getOptimalTileHeight()), and at
+         * least one strip.
+         *
+         * @param channel the channel to check.
+         * @returns the optimal height.
+         */
+        dimension_size_type
+        getOptimalTileHeight(dimension_size_type channel) const;
+
+        /**
+         * Get the native tile grid of a resolution.
+         *
+         * The grid is that of the first plane of the current
+         * series.  Reads of the regions of the grid each decode a
+         * single tile, so clients may use the grid to schedule
+         * reads aligned with the tiles of the file.
+         *
+         * @param resolution the resolution index within the current
+         * series.
+         * @returns the tile grid.
+         * @throws std::logic_error if the resolution is invalid.
+         */
+        tiff::TileGrid
+        getTileGrid(dimension_size_type resolution) const;
+
+        /**
+         * Get the native tile grids of all resolutions.
+         *
+         * @returns the tile grid of each resolution of the current
+         * series, in resolution order.
+         * @see getTileGrid()
+         */
+        std::vector<tiff::TileGrid>
+        getTileGrids() const;
+
       protected:
+        // Documented in superclass.
+        bool
+        isNormalizedOnRead() const;
+
         // Documented in superclass.
         void
         openBytesImpl(dimension_size_type plane,
@@ -136,6 +479,41 @@ namespace ome
                       dimension_size_type w,
                       dimension_size_type h) const;
 
+        // Documented in superclass.
+        void
+        openBytesBatchImpl(dimension_size_type              plane,
+                           const std::vector<PlaneRegion>&  regions,
+                           std::vector<VariantPixelBuffer>& bufs) const;
+
+        // Documented in superclass.
+        void
+        openBytesDecimatedImpl(dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               const PlaneRegion&  region,
+                               dimension_size_type xstep,
+                               dimension_size_type ystep) const;
+
+        // Documented in superclass.
+        void
+        openBytesAtImpl(dimension_size_type series,
+                        dimension_size_type resolution,
+                        dimension_size_type plane,
+                        VariantPixelBuffer& buf,
+                        const PlaneRegion&  region) const;
+
+        // Documented in superclass.
+        void
+        openBytesIntoImpl(dimension_size_type     series,
+                          dimension_size_type     resolution,
+                          dimension_size_type     plane,
+                          VariantPixelBufferView& buf,
+                          const PlaneRegion&      region) const;
+
+        // Documented in superclass.
+        void
+        forEachTileImpl(dimension_size_type  plane,
+                        const tile_callback& callback) const;
+
       public:
         /**
          * Get open TIFF file.
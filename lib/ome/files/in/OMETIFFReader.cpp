@@ -36,25 +36,34 @@
  */
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 #include <map>
 #include <set>
 
+#include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/range/size.hpp>
 
 #include <ome/common/filesystem.h>
 
+#include <ome/files/DimensionIndexer.h>
+#include <ome/files/Executor.h>
 #include <ome/files/FormatException.h>
 #include <ome/files/FormatTools.h>
 #include <ome/files/MetadataTools.h>
-#include <ome/files/detail/OMETIFF.h>
+#include <ome/files/detail/IOStatistics.h>
+#include <ome/files/detail/Memo.h>
+#include <ome/files/detail/Trace.h>
 #include <ome/files/in/OMETIFFReader.h>
+#include <ome/files/tiff/DecodedTileCache.h>
+#include <ome/files/tiff/DirectoryParser.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/TIFF.h>
 #include <ome/files/tiff/Tags.h>
 #include <ome/files/tiff/Field.h>
+#include <ome/files/tiff/Util.h>
 
 #include <ome/xml/meta/OMEXMLMetadata.h>
 #include <ome/xml/meta/BaseMetadata.h>
@@ -114,22 +123,33 @@ namespace ome
           return p;
         }
 
-        const ReaderProperties props(tiff_properties());
+        const ReaderProperties&
+        props()
+        {
+          static const ReaderProperties p(tiff_properties());
+          return p;
+        }
 
         const std::vector<path> companion_suffixes{"companion.ome"};
 
-        std::string
-        getImageDescription(const TIFF& tiff)
+        // The maximum number of files opened at once when validating
+        // strictly.  Opening is mostly latency-bound, so this is not
+        // limited by the number of decode threads.
+        const dimension_size_type open_threads = 16U;
+
+        // Get the ImageDescription of the first IFD without copying.
+        // The text is owned by libtiff, and is only valid until
+        // another IFD of the TIFF is made current.
+        void
+        viewImageDescription(const TIFF&   tiff,
+                             const char *& text,
+                             std::size_t&  length)
         {
           try
             {
               std::shared_ptr<tiff::IFD> ifd (tiff.getDirectoryByIndex(0));
               if (ifd)
-                {
-                  std::string omexml;
-                  ifd->getField(ome::files::tiff::IMAGEDESCRIPTION).get(omexml);
-                  return omexml;
-                }
+                ifd->getField(ome::files::tiff::IMAGEDESCRIPTION).view(text, length);
               else
                 throw tiff::Exception("No TIFF IFDs found");
             }
@@ -150,7 +170,7 @@ namespace ome
           /// Tile width.
           std::vector<dimension_size_type> tileHeight;
           /// Per-plane data.
-          std::vector<OMETIFFPlane> tiffPlanes;
+          ome::files::detail::OMETIFFPlaneTable tiffPlanes;
 
           OMETIFFMetadata():
             CoreMetadata(),
@@ -166,21 +186,39 @@ namespace ome
             tiffPlanes(copy.tiffPlanes)
           {}
 
+          OMETIFFMetadata(const CoreMetadata& copy):
+            CoreMetadata(copy),
+            tileWidth(),
+            tileHeight(),
+            tiffPlanes()
+          {}
+
         };
 
       }
 
       OMETIFFReader::OMETIFFReader():
-        detail::FormatReader(props),
+        detail::FormatReader(props()),
         logger(ome::common::createLogger("OMETIFFReader")),
         files(),
         invalidFiles(),
         tiffs(),
+        tiffsMutex(),
+        tileCache(std::make_shared<tiff::DecodedTileCache>()),
+        statistics(),
+        indexSidecar(false),
+        readHandles(0U),
+        strictValidation(true),
+        handleCache(tiff::HandleCache::global()),
         metadataFile(),
         usedFiles(),
+        planeFiles(),
         hasSPW(false),
         cachedMetadata(),
-        cachedMetadataFile()
+        cachedMetadataFile(),
+        cachedSummary(),
+        cachedSummaryFile(),
+        memoOffsets()
       {
         this->suffixNecessary = false;
         this->suffixSufficient = false;
@@ -203,17 +241,25 @@ namespace ome
       void
       OMETIFFReader::close(bool fileOnly)
       {
+        clearPrefetch();
+
         if (!fileOnly)
           {
             files.clear();
             invalidFiles.clear();
             cachedMetadataFile.clear();
             cachedMetadata.reset();
+            cachedSummaryFile.clear();
+            cachedSummary = detail::OMEXMLSummary();
             hasSPW = false;
             usedFiles.clear();
+            planeFiles.clear();
             metadataFile.clear();
+            memoOffsets.clear();
           }
         tiffs.clear(); // Closes all open TIFFs.
+        if (handleCache)
+          handleCache->close(this);
 
         detail::FormatReader::close(fileOnly);
       }
@@ -226,32 +272,25 @@ namespace ome
 
         try
           {
-            std::shared_ptr<::ome::xml::meta::Metadata> test_meta(cacheMetadata(id));
+            const detail::OMEXMLSummary& summary(cacheSummary(id));
 
             dimension_size_type nImages = 0U;
-            for (dimension_size_type i = 0U;
-                 i < test_meta->getImageCount();
-                 ++i)
+            for (const auto& image : summary.images)
               {
-                dimension_size_type nChannels = test_meta->getChannelCount(i);
+                dimension_size_type nChannels = image.channelCount;
                 if (!nChannels)
                   nChannels = 1;
-                ome::xml::model::primitives::PositiveInteger z(test_meta->getPixelsSizeZ(i));
-                ome::xml::model::primitives::PositiveInteger t(test_meta->getPixelsSizeT(i));
-
-                nImages += static_cast<dimension_size_type>(z) * static_cast<dimension_size_type>(t) * nChannels;
-              }
-
-            std::shared_ptr<tiff::TIFF> tiff = TIFF::open(id, "r");
+                if (!image.sizeZ || !image.sizeT)
+                  {
+                    boost::format fmt("Invalid Pixels dimensions for Image ‘%1%’");
+                    fmt % image.id;
+                    throw FormatException(fmt.str());
+                  }
 
-            if (!tiff)
-              {
-                boost::format fmt("Failed to open ‘%1%’");
-                fmt % id.string();
-                throw FormatException(fmt.str());
+                nImages += image.sizeZ * image.sizeT * nChannels;
               }
 
-            dimension_size_type nIFD = tiff->directoryCount();
+            dimension_size_type nIFD = tiff::DirectoryParser(id).directoryCount();
 
             return nImages > 0 && nImages <= nIFD;
           }
@@ -271,14 +310,33 @@ namespace ome
         return detail::FormatReader::isThisType(name, open);
       }
 
+      bool
+      OMETIFFReader::isStreamThisTypeImpl(std::istream& stream) const
+      {
+        const std::string header((std::istreambuf_iterator<char>(stream)),
+                                 std::istreambuf_iterator<char>());
+        const uint8_t *begin = reinterpret_cast<const uint8_t *>(header.data());
+        const uint8_t *end = begin + header.size();
+
+        if (!tiff::isTIFFHeader(begin, end))
+          return false;
+
+        boost::optional<std::string> description;
+        if (!tiff::headerDescription(begin, end, description))
+          return true; // Not determinable from the header.
+
+        detail::OMEXMLSummary summary;
+        return description && detail::scanOMEXML(*description, summary);
+      }
+
       bool
       OMETIFFReader::isFilenameThisTypeImpl(const boost::filesystem::path& name) const
       {
         bool valid = true;
         try
           {
-            std::shared_ptr<::ome::xml::meta::Metadata> test_meta(cacheMetadata(name));
-            std::string metadataFile = test_meta->getBinaryOnlyMetadataFile();
+            const detail::OMEXMLSummary *summary = &cacheSummary(name);
+            const std::string& metadataFile = summary->binaryOnlyMetadataFile;
             if (!metadataFile.empty())
               {
                 // check the suffix to make sure that the MetadataFile is
@@ -289,18 +347,23 @@ namespace ome
                   }
                 else
                   {
-                    test_meta = cacheMetadata(metadataFile);
+                    summary = &cacheSummary(name.parent_path() / metadataFile);
                   }
               }
             if (valid)
               {
-                for (::ome::xml::meta::Metadata::index_type i = 0;
-                     i < test_meta->getImageCount();
-                     ++i)
+                // Equivalent to verifyMinimum() for each image.
+                for (const auto& image : summary->images)
                   {
-                    verifyMinimum(*test_meta, i);
+                    if (image.id.empty() ||
+                        image.pixelsID.empty() ||
+                        image.channelsWithoutID)
+                      {
+                        valid = false;
+                        break;
+                      }
                   }
-                if (test_meta->getImageCount() == 0)
+                if (summary->images.empty())
                   valid = false;
               }
           }
@@ -326,17 +389,27 @@ namespace ome
 
       const std::shared_ptr<const tiff::IFD>
       OMETIFFReader::ifdAtIndex(dimension_size_type plane) const
+      {
+        return ifdAt(getSeries(), getResolution(), plane);
+      }
+
+      const std::shared_ptr<const IFD>
+      OMETIFFReader::ifdAt(dimension_size_type series,
+                           dimension_size_type resolution,
+                           dimension_size_type plane) const
       {
         std::shared_ptr<const IFD> ifd;
 
-        const OMETIFFMetadata& ometa(dynamic_cast<const OMETIFFMetadata&>(getCoreMetadata(getCoreIndex())));
+        const OMETIFFMetadata& ometa(dynamic_cast<const OMETIFFMetadata&>(getCoreMetadata(coreIndexAt(series, resolution))));
 
         if (plane < ometa.tiffPlanes.size())
           {
-            const OMETIFFPlane& tiffplane(ometa.tiffPlanes.at(plane));
-            const std::shared_ptr<const TIFF> tiff(getTIFF(tiffplane.id));
+            const OMETIFFPlane tiffplane(ometa.tiffPlanes.at(plane));
+            const std::shared_ptr<const TIFF> tiff(getTIFF(planeFiles.at(tiffplane.file)));
             if (tiff)
               ifd = std::shared_ptr<const IFD>(tiff->getDirectoryByIndex(tiffplane.ifd));
+            if (ifd && resolution > 0U)
+              ifd = tiff::subResolutionIFD(*ifd, resolution);
           }
 
         if (!ifd)
@@ -349,6 +422,52 @@ namespace ome
         return ifd;
       }
 
+      void
+      OMETIFFReader::addSubResolutions()
+      {
+        coremetadata_list_type series;
+        series.swap(core);
+
+        for (const auto& full : series)
+          {
+            std::shared_ptr<OMETIFFMetadata> ometa(std::dynamic_pointer_cast<OMETIFFMetadata>(full));
+            if (!ometa)
+              continue;
+
+            core.push_back(ometa);
+
+            if (ometa->tiffPlanes.empty())
+              continue;
+
+            const OMETIFFPlane tiffplane(ometa->tiffPlanes.at(0));
+            const path& tiffpath(planeFiles.at(tiffplane.file));
+
+            // Don't open other files without strict validation.
+            if (!strictValidation && tiffpath != *currentId)
+              continue;
+
+            const std::shared_ptr<const TIFF> ptiff(getTIFF(tiffpath));
+            const std::shared_ptr<const IFD> ifd(ptiff->getDirectoryByIndex(tiffplane.ifd));
+            dimension_size_type levels = tiff::subResolutionCount(*ifd);
+
+            ometa->resolutionCount = 1U + levels;
+
+            for (dimension_size_type r = 1U; r <= levels; ++r)
+              {
+                std::shared_ptr<const IFD> sub(tiff::subResolutionIFD(*ifd, r));
+                const tiff::TileInfo tinfo(sub->getTileInfo());
+
+                std::shared_ptr<OMETIFFMetadata> subcore(std::make_shared<OMETIFFMetadata>(*ometa));
+                subcore->sizeX = sub->getImageWidth();
+                subcore->sizeY = sub->getImageHeight();
+                subcore->resolutionCount = 1U;
+                std::fill(subcore->tileWidth.begin(), subcore->tileWidth.end(), tinfo.tileWidth());
+                std::fill(subcore->tileHeight.begin(), subcore->tileHeight.end(), tinfo.tileHeight());
+                core.push_back(subcore);
+              }
+          }
+      }
+
       const std::vector<std::string>&
       OMETIFFReader::getDomains() const
       {
@@ -370,11 +489,8 @@ namespace ome
 
             const OMETIFFMetadata& ometa(dynamic_cast<const OMETIFFMetadata&>(getCoreMetadata(getCoreIndex())));
 
-            for(const auto& plane : ometa.tiffPlanes)
-              {
-                if (!plane.id.empty())
-                  fileSet.insert(plane.id);
-              }
+            for(const auto& run : ometa.tiffPlanes.getRuns())
+              fileSet.insert(planeFiles.at(run.plane.file));
           }
 
         return std::vector<boost::filesystem::path>(fileSet.begin(), fileSet.end());
@@ -420,6 +536,8 @@ namespace ome
       void
       OMETIFFReader::initFile(const boost::filesystem::path& id)
       {
+        OME_FILES_TRACE(trace, "ometiff", "init_file");
+
         detail::FormatReader::initFile(id);
         // Note: Use canonical currentId rather than non-canonical id after this point.
         path dir((*currentId).parent_path());
@@ -429,7 +547,12 @@ namespace ome
             // This is a companion file.  Read the metadata, get the
             // TIFF for the TiffData for the first image, and then
             // recurse with this file as the id.
-            std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(createOMEXMLMetadata(*currentId));
+            std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta;
+            {
+              OME_FILES_IO_TIME(timer, ioStatistics.get(), METADATA_PARSE);
+              OME_FILES_IO_COUNT(ioStatistics, METADATA_PARSED, 1U);
+              meta = createOMEXMLMetadata(*currentId);
+            }
             path firstTIFF(path(meta->getUUIDFileName(0, 0)));
             close(false); // To force clearing of currentId.
             initFile(canonical(firstTIFF, dir));
@@ -503,6 +626,13 @@ namespace ome
         // UUID → file mapping and used files.
         findUsedFiles(*meta, *currentId, dir, currentUUID);
 
+        // Each file is opened to validate it strictly.  Open the files
+        // concurrently up front, since each open may be a round trip
+        // on a network filesystem.
+        std::set<path> opened;
+        if (strictValidation)
+          opened = openTIFFs(usedFiles);
+
         // Process TiffData elements.
         for (index_type series = 0; series < seriesCount; ++series)
           {
@@ -550,6 +680,7 @@ namespace ome
             PositiveInteger num = effSizeC * sizeT * sizeZ;
 
             coreMeta->tiffPlanes.resize(num);
+            const DimensionIndexer indexer(order, sizeZ, effSizeC, sizeT, num);
             index_type tiffDataCount = meta->getTiffDataCount(series);
             boost::optional<NonNegativeInteger> zIndexStart;
             boost::optional<NonNegativeInteger> tIndexStart;
@@ -594,10 +725,8 @@ namespace ome
                     break;
                   }
 
-                dimension_size_type index = ome::files::getIndex(order,
-                                                                      sizeZ, effSizeC, sizeT,
-                                                                      num,
-                                                                      firstZ, firstC, firstT);
+                // Coordinates were checked above.
+                dimension_size_type index = indexer.index(firstZ, firstC, firstT);
 
                 // get reader object for this filename.
                 boost::optional<path> filename;
@@ -661,7 +790,7 @@ namespace ome
                 addTIFF(*filename);
 
                 bool exists = true;
-                if (!fs::exists(*filename))
+                if (opened.find(*filename) == opened.end() && !fs::exists(*filename))
                   {
                     // If an absolute filename, try using a relative
                     // name.  Old versions of the Java OMETiffWriter
@@ -679,99 +808,57 @@ namespace ome
                         exists = usedFiles.size() == 1;
                       }
                   }
-                if (exists) // check it's really a valid TIFF
+                // Check it's really a valid TIFF (deferred until
+                // first use unless validating strictly).
+                if (exists && (strictValidation || *filename == *currentId))
                   exists = validTIFF(*filename);
 
-                // Fill plane index → IFD mapping
-                for (dimension_size_type q = 0;
-                     q < static_cast<dimension_size_type>(numPlanes);
-                     ++q)
-                  {
-                    dimension_size_type no = index + q;
-                    OMETIFFPlane& plane(coreMeta->tiffPlanes.at(no));
-                    plane.id = *filename;
-                    plane.ifd = static_cast<dimension_size_type>(*tdIFD) + q;
-                    plane.certain = true;
-                    plane.status = exists ? OMETIFFPlane::PRESENT : OMETIFFPlane::ABSENT;
+                // Fill plane index → IFD mapping; the planes of the
+                // TiffData are stored as a single run.
+                OMETIFFPlane plane(planeFiles.intern(*filename));
+                plane.ifd = static_cast<dimension_size_type>(*tdIFD);
+                plane.certain = true;
+                plane.status = exists ? OMETIFFPlane::PRESENT : OMETIFFPlane::ABSENT;
+                coreMeta->tiffPlanes.assign(index, static_cast<dimension_size_type>(numPlanes), plane);
+
+                BOOST_LOG_SEV(logger, ome::logging::trivial::debug)
+                  << "    Plane[" << index
+                  << "]: file=" << filename->string()
+                  << ", IFD=" << plane.ifd
+                  << ", count=" << numPlanes;
 
-                    BOOST_LOG_SEV(logger, ome::logging::trivial::debug)
-                      << "    Plane[" << no
-                      << "]: file=" << plane.id.string()
-                      << ", IFD=" << plane.ifd;
-                  }
                 if (numPlanes == 0)
                   {
                     // Unknown number of planes (default value); fill down
-                    for (dimension_size_type no = index + 1;
-                         no < static_cast<dimension_size_type>(num);
-                         ++no)
-                      {
-                        OMETIFFPlane& plane(coreMeta->tiffPlanes.at(no));
-                        if (plane.certain)
-                          break;
-                        OMETIFFPlane& previousPlane(coreMeta->tiffPlanes.at(no - 1));
-                        plane.id = *filename;
-                        plane.ifd = previousPlane.ifd + 1;
-                        plane.status = exists ? OMETIFFPlane::PRESENT : OMETIFFPlane::ABSENT;
-
-                        BOOST_LOG_SEV(logger, ome::logging::trivial::debug)
-                          << "    Plane[" << no
-                          << "]: FILLED";
-                      }
+                    const OMETIFFPlane previousPlane(coreMeta->tiffPlanes.at(index));
+                    plane.ifd = previousPlane.ifd + 1;
+                    dimension_size_type filled = coreMeta->tiffPlanes.fill(index + 1, plane);
+
+                    BOOST_LOG_SEV(logger, ome::logging::trivial::debug)
+                      << "    Plane[" << index + 1
+                      << "]: FILLED " << filled;
                   }
                 BOOST_LOG_SEV(logger, ome::logging::trivial::debug)
                   << "  }";
               }
 
-            // Clear any unset planes.
-            for (std::vector<OMETIFFPlane>::iterator plane = coreMeta->tiffPlanes.begin();
-                 plane != coreMeta->tiffPlanes.end();
-                 ++plane)
-              {
-                if (plane->status != OMETIFFPlane::UNKNOWN)
-                  continue;
-                plane->id.clear();
-                plane->ifd = 0;
-
-                BOOST_LOG_SEV(logger, ome::logging::trivial::debug)
-                  << "    Plane[" << plane - coreMeta->tiffPlanes.begin()
-                  << "]: CLEARED";
-              }
-
             if (!core.at(series))
               continue;
 
-            // Verify all planes are available.
-            for (dimension_size_type no = 0;
-                 no < static_cast<dimension_size_type>(num);
-                 ++no)
+            // Verify all planes are available.  Planes not set by
+            // any TiffData have no file.
+            dimension_size_type missing = coreMeta->tiffPlanes.firstUnset();
+            if (missing < static_cast<dimension_size_type>(num))
               {
-                OMETIFFPlane& plane(coreMeta->tiffPlanes.at(no));
+                BOOST_LOG_SEV(logger, ome::logging::trivial::warning)
+                  << "Image ID: " << meta->getImageID(series)
+                  << " missing plane #" << missing;
 
-                BOOST_LOG_SEV(logger, ome::logging::trivial::debug)
-                  << "  Verify Plane[" << no
-                  << "]: file=" << plane.id.string()
-                  << ", IFD=" << plane.ifd;
-
-                if (plane.id.empty())
-                  {
-                    BOOST_LOG_SEV(logger, ome::logging::trivial::warning)
-                      << "Image ID: " << meta->getImageID(series)
-                      << " missing plane #" << no;
-
-                    // Fallback if broken.
-                    dimension_size_type nIFD = tiff->directoryCount();
+                // Fallback if broken.
+                dimension_size_type nIFD = tiff->directoryCount();
 
-                    coreMeta->tiffPlanes.clear();
-                    coreMeta->tiffPlanes.resize(nIFD);
-                    for (dimension_size_type p = 0; p < nIFD; ++p)
-                      {
-                        OMETIFFPlane& plane(coreMeta->tiffPlanes.at(p));
-                        plane.id = *currentId;
-                        plane.ifd = p;
-                      }
-                    break;
-                  }
+                coreMeta->tiffPlanes.resize(nIFD);
+                coreMeta->tiffPlanes.assign(0, nIFD, OMETIFFPlane(planeFiles.intern(*currentId)));
               }
 
             BOOST_LOG_SEV(logger, ome::logging::trivial::debug)
@@ -780,9 +867,24 @@ namespace ome
             // Fill CoreMetadata.
             try
               {
-                const OMETIFFPlane& plane(coreMeta->tiffPlanes.at(0));
-                const std::shared_ptr<const tiff::TIFF> ptiff(getTIFF(plane.id));
-                const std::shared_ptr<const tiff::IFD> pifd(ptiff->getDirectoryByIndex(plane.ifd));
+                // Without strict validation, series in other files
+                // are not opened, and the first IFD of this file is
+                // used in place of their IFDs.
+                bool assumed = false;
+                auto planeIFD = [&](const OMETIFFPlane& plane)
+                  {
+                    const path& planepath(planeFiles.at(plane.file));
+                    if (!strictValidation && planepath != *currentId)
+                      {
+                        assumed = true;
+                        return std::shared_ptr<const tiff::IFD>(tiff->getDirectoryByIndex(0));
+                      }
+                    const std::shared_ptr<const tiff::TIFF> ptiff(getTIFF(planepath));
+                    return std::shared_ptr<const tiff::IFD>(ptiff->getDirectoryByIndex(plane.ifd));
+                  };
+
+                const OMETIFFPlane plane(coreMeta->tiffPlanes.at(0));
+                const std::shared_ptr<const tiff::IFD> pifd(planeIFD(plane));
 
                 uint32_t tiffWidth = pifd->getImageWidth();
                 uint32_t tiffHeight = pifd->getImageHeight();
@@ -857,13 +959,12 @@ namespace ome
                                                 channel,
                                                 0);
 
-                    const OMETIFFPlane& plane(coreMeta->tiffPlanes.at(planeIndex));
-                    const std::shared_ptr<const tiff::TIFF> ctiff(getTIFF(plane.id));
-                    const std::shared_ptr<const tiff::IFD> cifd(ctiff->getDirectoryByIndex(plane.ifd));
+                    const OMETIFFPlane plane(coreMeta->tiffPlanes.at(planeIndex));
+                    const std::shared_ptr<const tiff::IFD> cifd(planeIFD(plane));
                     const tiff::TileInfo tinfo(cifd->getTileInfo());
                     const dimension_size_type tiffSamples = cifd->getSamplesPerPixel();
 
-                    if (coreMeta->sizeC.at(channel) != tiffSamples)
+                    if (!assumed && coreMeta->sizeC.at(channel) != tiffSamples)
                       {
                         boost::format fmt("SamplesPerPixel mismatch: OME=%1%, TIFF=%2%");
                         fmt % coreMeta->sizeC.at(channel) % tiffSamples;
@@ -876,14 +977,14 @@ namespace ome
                     coreMeta->tileHeight.push_back(tinfo.tileHeight());
                   }
 
-                if (coreMeta->sizeX != tiffWidth)
+                if (!assumed && coreMeta->sizeX != tiffWidth)
                   {
                     boost::format fmt("SizeX mismatch: OME=%1%, TIFF=%2%");
                     fmt % coreMeta->sizeX % tiffWidth;
 
                     BOOST_LOG_SEV(logger, ome::logging::trivial::warning) << fmt.str();
                   }
-                if (coreMeta->sizeY != tiffHeight)
+                if (!assumed && coreMeta->sizeY != tiffHeight)
                   {
                     boost::format fmt("SizeY mismatch: OME=%1%, TIFF=%2%");
                     fmt % coreMeta->sizeY % tiffHeight;
@@ -898,7 +999,7 @@ namespace ome
 
                     BOOST_LOG_SEV(logger, ome::logging::trivial::warning) << fmt.str();
                   }
-                if (coreMeta->pixelType != tiffPixelType)
+                if (!assumed && coreMeta->pixelType != tiffPixelType)
                   {
                     boost::format fmt("PixelType mismatch: OME=%1%, TIFF=%2%");
                     fmt % coreMeta->pixelType % tiffPixelType;
@@ -963,6 +1064,9 @@ namespace ome
             ms0->sizeT = 1U;
           }
 
+        if (!hasFlattenedResolutions())
+          addSubResolutions();
+
         fillMetadata(*metadataStore, *this, false, false);
         seriesCount = meta->getImageCount();
         for (index_type series = 0; series < seriesCount; ++series)
@@ -1053,6 +1157,178 @@ namespace ome
           }
       }
 
+      bool
+      OMETIFFReader::isMemoizable() const
+      {
+        return true;
+      }
+
+      void
+      OMETIFFReader::saveMemoState(::ome::files::detail::MemoWriter& memo) const
+      {
+        memo.writeBool(strictValidation);
+
+        memo.writeUInt(files.size());
+        for (const auto& file : files)
+          {
+            memo.writeString(file.first);
+            memo.writeString(file.second.string());
+          }
+
+        memo.writeUInt(invalidFiles.size());
+        for (const auto& file : invalidFiles)
+          {
+            memo.writeString(file.first.string());
+            memo.writeString(file.second.string());
+          }
+
+        memo.writeString(metadataFile.string());
+
+        memo.writeUInt(usedFiles.size());
+        for (const auto& file : usedFiles)
+          memo.writeString(file.string());
+
+        memo.writeBool(hasSPW);
+
+        memo.writeUInt(planeFiles.size());
+        for (OMETIFFPlane::file_index_type i = 0; i < planeFiles.size(); ++i)
+          memo.writeString(planeFiles.at(i).string());
+
+        for (const auto& c : core)
+          {
+            const OMETIFFMetadata& ometa(dynamic_cast<const OMETIFFMetadata&>(*c));
+
+            memo.writeUInt(ometa.tileWidth.size());
+            for (const auto& width : ometa.tileWidth)
+              memo.writeUInt(width);
+            memo.writeUInt(ometa.tileHeight.size());
+            for (const auto& height : ometa.tileHeight)
+              memo.writeUInt(height);
+            memo.writeUInt(ometa.tiffPlanes.size());
+            memo.writeUInt(ometa.tiffPlanes.getRuns().size());
+            for (const auto& run : ometa.tiffPlanes.getRuns())
+              {
+                memo.writeUInt(run.first);
+                memo.writeUInt(run.count);
+                memo.writeUInt(run.plane.file);
+                memo.writeUInt(run.plane.ifd);
+                memo.writeBool(run.plane.certain);
+                memo.writeUInt(static_cast<uint64_t>(run.plane.status));
+              }
+          }
+
+        // The directory offsets of each TIFF which may be opened.
+        // TIFFs which can not be opened have no offsets.
+        std::vector<path> paths;
+        {
+          std::lock_guard<std::mutex> lock(tiffsMutex);
+          for (const auto& t : tiffs)
+            paths.push_back(t.first);
+        }
+        memo.writeUInt(paths.size());
+        for (const auto& tiffpath : paths)
+          {
+            std::vector<tiff::offset_type> offsets;
+            try
+              {
+                offsets = getTIFF(tiffpath)->getDirectoryOffsets();
+              }
+            catch (const std::exception&)
+              {
+              }
+            memo.writeString(tiffpath.string());
+            memo.writeUInt(offsets.size());
+            memo.writeBytes(offsets.data(), offsets.size() * sizeof(tiff::offset_type));
+          }
+      }
+
+      bool
+      OMETIFFReader::restoreMemoState(::ome::files::detail::MemoReader& memo)
+      {
+        if (memo.readBool() != strictValidation)
+          return false;
+
+        const uint64_t nfiles = memo.readCount(sizeof(uint64_t) * 2U);
+        for (uint64_t i = 0; i < nfiles; ++i)
+          {
+            const std::string uuid(memo.readString());
+            files.insert(std::make_pair(uuid, path(memo.readString())));
+          }
+
+        const uint64_t ninvalid = memo.readCount(sizeof(uint64_t) * 2U);
+        for (uint64_t i = 0; i < ninvalid; ++i)
+          {
+            const path invalid(memo.readString());
+            invalidFiles.insert(std::make_pair(invalid, path(memo.readString())));
+          }
+
+        metadataFile = memo.readString();
+
+        const uint64_t nused = memo.readCount(sizeof(uint64_t));
+        for (uint64_t i = 0; i < nused; ++i)
+          usedFiles.push_back(path(memo.readString()));
+
+        hasSPW = memo.readBool();
+
+        const uint64_t nplanefiles = memo.readCount(sizeof(uint64_t));
+        for (uint64_t i = 0; i < nplanefiles; ++i)
+          planeFiles.intern(path(memo.readString()));
+
+        for (auto& c : core)
+          {
+            std::shared_ptr<OMETIFFMetadata> ometa(std::make_shared<OMETIFFMetadata>(*c));
+
+            const uint64_t nwidth = memo.readCount(sizeof(uint64_t));
+            for (uint64_t i = 0; i < nwidth; ++i)
+              ometa->tileWidth.push_back(memo.readUInt());
+            const uint64_t nheight = memo.readCount(sizeof(uint64_t));
+            for (uint64_t i = 0; i < nheight; ++i)
+              ometa->tileHeight.push_back(memo.readUInt());
+            ometa->tiffPlanes.resize(memo.readUInt());
+            const uint64_t nruns = memo.readCount(sizeof(uint64_t) * 5U);
+            for (uint64_t i = 0; i < nruns; ++i)
+              {
+                const dimension_size_type first = memo.readUInt();
+                const dimension_size_type count = memo.readUInt();
+                const uint64_t file = memo.readUInt();
+                if (file >= planeFiles.size())
+                  throw FormatException("Invalid memo TIFF plane file");
+                OMETIFFPlane plane(static_cast<OMETIFFPlane::file_index_type>(file));
+                plane.ifd = memo.readUInt();
+                plane.certain = memo.readBool();
+                const uint64_t status = memo.readUInt();
+                if (status > OMETIFFPlane::ABSENT)
+                  throw FormatException("Invalid memo TIFF plane status");
+                plane.status = static_cast<OMETIFFPlane::Status>(status);
+                try
+                  {
+                    ometa->tiffPlanes.assign(first, count, plane);
+                  }
+                catch (const std::out_of_range&)
+                  {
+                    throw FormatException("Invalid memo TIFF plane range");
+                  }
+              }
+
+            c = ometa;
+          }
+
+        // TIFFs are opened on first use, using the saved directory
+        // offsets.
+        const uint64_t ntiffs = memo.readCount(sizeof(uint64_t) * 2U);
+        for (uint64_t i = 0; i < ntiffs; ++i)
+          {
+            const path tiffpath(memo.readString());
+            std::vector<tiff::offset_type> offsets(memo.readCount(sizeof(tiff::offset_type)));
+            memo.readBytes(offsets.data(), offsets.size() * sizeof(tiff::offset_type));
+            addTIFF(tiffpath);
+            if (!offsets.empty())
+              memoOffsets.insert(std::make_pair(tiffpath, offsets));
+          }
+
+        return true;
+      }
+
       void
       OMETIFFReader::findUsedFiles(const ome::xml::meta::OMEXMLMetadata& meta,
                                    const boost::filesystem::path&        currentId,
@@ -1386,6 +1662,13 @@ namespace ome
           }
       }
 
+      bool
+      OMETIFFReader::isNormalizedOnRead() const
+      {
+        // Normalized per tile by IFD::readImage(); see openTIFF().
+        return true;
+      }
+
       void
       OMETIFFReader::openBytesImpl(dimension_size_type plane,
                                    VariantPixelBuffer& buf,
@@ -1401,6 +1684,231 @@ namespace ome
         ifd->readImage(buf, x, y, w, h);
       }
 
+      void
+      OMETIFFReader::openBytesBatchImpl(dimension_size_type              plane,
+                                        const std::vector<PlaneRegion>&  regions,
+                                        std::vector<VariantPixelBuffer>& bufs) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->readImages(bufs, regions);
+      }
+
+      void
+      OMETIFFReader::openBytesDecimatedImpl(dimension_size_type plane,
+                                            VariantPixelBuffer& buf,
+                                            const PlaneRegion&  region,
+                                            dimension_size_type xstep,
+                                            dimension_size_type ystep) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->readImage(buf, region, xstep, ystep);
+      }
+
+      void
+      OMETIFFReader::openBytesAtImpl(dimension_size_type series,
+                                     dimension_size_type resolution,
+                                     dimension_size_type plane,
+                                     VariantPixelBuffer& buf,
+                                     const PlaneRegion&  region) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAt(series, resolution, plane));
+
+        ifd->readImage(buf, region.x, region.y, region.w, region.h);
+      }
+
+      void
+      OMETIFFReader::openBytesIntoImpl(dimension_size_type     series,
+                                       dimension_size_type     resolution,
+                                       dimension_size_type     plane,
+                                       VariantPixelBufferView& buf,
+                                       const PlaneRegion&      region) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAt(series, resolution, plane));
+
+        ifd->readImage(buf, region);
+      }
+
+      void
+      OMETIFFReader::forEachTileImpl(dimension_size_type  plane,
+                                     const tile_callback& callback) const
+      {
+        assertId(currentId, true);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->forEachTile(callback);
+      }
+
+      void
+      OMETIFFReader::openRawTile(dimension_size_type   plane,
+                                 dimension_size_type   tile,
+                                 std::vector<uint8_t>& buf) const
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->readRawTile(tile, buf);
+      }
+
+      void
+      OMETIFFReader::forEachTileInRange(dimension_size_type  plane,
+                                        double               low,
+                                        double               high,
+                                        const tile_callback& callback) const
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+        clearPrefetch();
+
+        const std::shared_ptr<const IFD>& ifd(ifdAtIndex(plane));
+
+        ifd->forEachTileInRange(low, high, callback);
+      }
+
+      void
+      OMETIFFReader::setDecodeThreads(unsigned int threads)
+      {
+        ::ome::files::detail::FormatReader::setDecodeThreads(threads);
+
+        for (auto& t : tiffs)
+          if (t.second)
+            t.second->setDecodeThreads(getDecodeThreads());
+        if (handleCache)
+          handleCache->forEach(this, [this](tiff::TIFF& t)
+                                     { t.setDecodeThreads(getDecodeThreads()); });
+      }
+
+      void
+      OMETIFFReader::setExecutor(const std::shared_ptr<Executor>& executor)
+      {
+        ::ome::files::detail::FormatReader::setExecutor(executor);
+
+        for (auto& t : tiffs)
+          if (t.second)
+            t.second->setExecutor(executor);
+        if (handleCache)
+          handleCache->forEach(this, [&executor](tiff::TIFF& t)
+                                     { t.setExecutor(executor); });
+      }
+
+      void
+      OMETIFFReader::setTileCache(std::shared_ptr<tiff::DecodedTileCache> cache)
+      {
+        tileCache = cache;
+
+        for (auto& t : tiffs)
+          if (t.second)
+            t.second->setTileCache(tileCache);
+        if (handleCache)
+          handleCache->forEach(this, [this](tiff::TIFF& t)
+                                     { t.setTileCache(tileCache); });
+      }
+
+      const std::shared_ptr<tiff::DecodedTileCache>&
+      OMETIFFReader::getTileCache() const
+      {
+        return tileCache;
+      }
+
+      void
+      OMETIFFReader::setStatistics(std::shared_ptr<PixelStatistics> sink)
+      {
+        statistics = sink;
+
+        for (auto& t : tiffs)
+          if (t.second)
+            t.second->setStatistics(statistics);
+        if (handleCache)
+          handleCache->forEach(this, [this](tiff::TIFF& t)
+                                     { t.setStatistics(statistics); });
+      }
+
+      const std::shared_ptr<PixelStatistics>&
+      OMETIFFReader::getStatistics() const
+      {
+        return statistics;
+      }
+
+      void
+      OMETIFFReader::setIndexSidecar(bool sidecar)
+      {
+        indexSidecar = sidecar;
+      }
+
+      bool
+      OMETIFFReader::getIndexSidecar() const
+      {
+        return indexSidecar;
+      }
+
+      void
+      OMETIFFReader::setReadHandles(unsigned int handles)
+      {
+        readHandles = handles;
+
+        for (auto& t : tiffs)
+          if (t.second)
+            t.second->setReadHandles(readHandles);
+        if (handleCache)
+          handleCache->forEach(this, [this](tiff::TIFF& t)
+                                     { t.setReadHandles(readHandles); });
+      }
+
+      unsigned int
+      OMETIFFReader::getReadHandles() const
+      {
+        return readHandles;
+      }
+
+      void
+      OMETIFFReader::setStrictValidation(bool strict)
+      {
+        strictValidation = strict;
+      }
+
+      bool
+      OMETIFFReader::getStrictValidation() const
+      {
+        return strictValidation;
+      }
+
+      void
+      OMETIFFReader::setHandleCache(std::shared_ptr<tiff::HandleCache> cache)
+      {
+        std::lock_guard<std::mutex> lock(tiffsMutex);
+
+        for (auto& t : tiffs)
+          if (t.second)
+            {
+              t.second->close();
+              t.second.reset();
+            }
+        if (handleCache)
+          handleCache->close(this);
+
+        handleCache = cache;
+      }
+
+      const std::shared_ptr<tiff::HandleCache>&
+      OMETIFFReader::getHandleCache() const
+      {
+        return handleCache;
+      }
+
       void
       OMETIFFReader::addTIFF(const boost::filesystem::path& tiff)
       {
@@ -1410,6 +1918,10 @@ namespace ome
       const std::shared_ptr<const ome::files::tiff::TIFF>
       OMETIFFReader::getTIFF(const boost::filesystem::path& tiff) const
       {
+        // TIFFs are opened on first use, possibly from several
+        // threads using openBytesAt().
+        std::lock_guard<std::mutex> lock(tiffsMutex);
+
         tiff_map::iterator i = tiffs.find(tiff);
 
         if (i == tiffs.end())
@@ -1421,22 +1933,25 @@ namespace ome
             throw FormatException(fmt.str());
           }
 
-        // second.second is the validity if the TIFF is null.  false
-        // is uninitialised; true is invalid.  Used to prevent
-        // repeated initialisation when the file is broken or
-        // nonexistent.
-        if (!i->second)
+        std::shared_ptr<tiff::TIFF> ret;
+
+        if (handleCache)
           {
-            try
-              {
-                i->second = tiff::TIFF::open(i->first, "r");
-              }
-            catch (const ome::files::tiff::Exception&)
-              {
-              }
+            // The handle may have been closed by the cache since last
+            // use, in which case it is reopened.
+            const boost::filesystem::path& filename(i->first);
+            ret = handleCache->get(tiff::HandleCache::key_type(this, filename),
+                                   [this, &filename]()
+                                   { return openTIFF(filename); });
+          }
+        else
+          {
+            if (!i->second)
+              i->second = openTIFF(i->first);
+            ret = i->second;
           }
 
-        if (!i->second)
+        if (!ret)
           {
             BOOST_LOG_SEV(logger, ome::logging::trivial::warning)
               << "Failed to open TIFF " << i->first.string();
@@ -1445,7 +1960,95 @@ namespace ome
             throw FormatException(fmt.str());
           }
 
-        return i->second;
+        return ret;
+      }
+
+      std::shared_ptr<tiff::TIFF>
+      OMETIFFReader::openTIFF(const boost::filesystem::path& tiff) const
+      {
+        std::shared_ptr<tiff::TIFF> ret;
+
+        try
+          {
+            ret = tiff::TIFF::open(tiff, "r", ioStatistics);
+            if (ret)
+              {
+                ret->setDecodeThreads(getDecodeThreads());
+                ret->setExecutor(executor);
+                ret->setTileCache(tileCache);
+                ret->setStatistics(statistics);
+                ret->setIndexSidecar(indexSidecar);
+                ret->setReadHandles(readHandles);
+                ret->setNormalized(isNormalized());
+
+                const auto offsets = memoOffsets.find(tiff);
+                if (offsets != memoOffsets.end())
+                  ret->setDirectoryOffsets(offsets->second);
+              }
+          }
+        catch (const ome::files::tiff::Exception&)
+          {
+          }
+
+        return ret;
+      }
+
+      std::set<path>
+      OMETIFFReader::openTIFFs(const std::vector<path>& files)
+      {
+        std::vector<std::shared_ptr<tiff::TIFF>> handles(files.size());
+        const dimension_size_type nthreads = std::min(open_threads, static_cast<dimension_size_type>(files.size()));
+
+        auto open = [&](dimension_size_type i)
+          {
+            if (files[i] == *currentId)
+              return;
+            try
+              {
+                if (fs::exists(files[i]))
+                  handles[i] = openTIFF(files[i]);
+              }
+            catch (const std::exception&)
+              {
+                // Reported when first used.
+              }
+          };
+
+        if (nthreads < 2U)
+          {
+            for (dimension_size_type i = 0; i < files.size(); ++i)
+              open(i);
+          }
+        else
+          {
+            getExecutor()->parallel(static_cast<unsigned int>(nthreads),
+                                    [&](unsigned int t)
+                                    {
+                                      for (dimension_size_type i = t; i < files.size(); i += nthreads)
+                                        open(i);
+                                    });
+          }
+
+        // Cache the open files in a fixed order.
+        std::set<path> opened;
+        std::lock_guard<std::mutex> lock(tiffsMutex);
+        for (dimension_size_type i = 0; i < files.size(); ++i)
+          {
+            std::shared_ptr<tiff::TIFF> handle(handles[i]);
+            if (!handle)
+              continue;
+
+            std::shared_ptr<tiff::TIFF>& cached(tiffs[files[i]]);
+            if (handleCache)
+              handleCache->get(tiff::HandleCache::key_type(this, files[i]),
+                               [&handle]()
+                               { return handle; });
+            else if (!cached)
+              cached = handle;
+            opened.insert(files[i]);
+          }
+
+        return opened;
       }
 
       bool
@@ -1464,12 +2067,19 @@ namespace ome
             i->second->close();
             i->second = std::shared_ptr<ome::files::tiff::TIFF>();
           }
+        if (handleCache)
+          handleCache->close(tiff::HandleCache::key_type(this, tiff));
       }
 
       std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
       OMETIFFReader::readMetadata(const ome::files::tiff::TIFF& tiff)
       {
-        return createOMEXMLMetadata(getImageDescription(tiff));
+        const char *text;
+        std::size_t length;
+        viewImageDescription(tiff, text, length);
+        OME_FILES_IO_TIME(timer, ioStatistics.get(), METADATA_PARSE);
+        OME_FILES_IO_COUNT(ioStatistics, METADATA_PARSED, 1U);
+        return createOMEXMLMetadata(text, length);
       }
 
       std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
@@ -1479,10 +2089,17 @@ namespace ome
           {
             addTIFF(id);
             const std::shared_ptr<const TIFF> tiff(getTIFF(id));
-            return createOMEXMLMetadata(getImageDescription(*tiff));
+            const char *text;
+            std::size_t length;
+            viewImageDescription(*tiff, text, length);
+            OME_FILES_IO_TIME(timer, ioStatistics.get(), METADATA_PARSE);
+            OME_FILES_IO_COUNT(ioStatistics, METADATA_PARSED, 1U);
+            return createOMEXMLMetadata(text, length);
           }
         else
           {
+            OME_FILES_IO_TIME(timer, ioStatistics.get(), METADATA_PARSE);
+            OME_FILES_IO_COUNT(ioStatistics, METADATA_PARSED, 1U);
             return createOMEXMLMetadata(id);
           }
       }
@@ -1507,21 +2124,29 @@ namespace ome
                 throw FormatException(fmt.str());
               }
 
-            std::string omexml(getImageDescription(*tiff));
+            // The TIFF is private to this call, so the text remains
+            // valid while it is parsed.
+            const char *omexml;
+            std::size_t length;
+            viewImageDescription(*tiff, omexml, length);
 
             // Basic sanity check before parsing.
-            std::string::size_type lpos = omexml.find_last_not_of(" \r\n\t\f\v");
-            if (omexml.size() == 0 ||
+            while (length && std::strchr(" \r\n\t\f\v", omexml[length - 1]))
+              --length;
+            if (length == 0 ||
                 omexml[0] != '<' ||
-                lpos == std::string::npos ||
-                omexml[lpos] != '>')
+                omexml[length - 1] != '>')
               {
                 boost::format fmt("Badly formed or invalid XML document in ‘%1%’");
                 fmt % id.string();
                 throw FormatException(fmt.str());
               }
 
-            meta = createOMEXMLMetadata(omexml);
+            {
+              OME_FILES_IO_TIME(timer, ioStatistics.get(), METADATA_PARSE);
+              OME_FILES_IO_COUNT(ioStatistics, METADATA_PARSED, 1U);
+              meta = createOMEXMLMetadata(omexml, length);
+            }
 
             // Don't overwrite state for open readers
             cachedMetadata = meta;
@@ -1531,6 +2156,61 @@ namespace ome
         return meta;
       }
 
+      const detail::OMEXMLSummary&
+      OMETIFFReader::cacheSummary(const boost::filesystem::path& id) const
+      {
+        path dir(id.parent_path());
+        path cid(canonical(id, dir));
+        if (cid == cachedSummaryFile)
+          return cachedSummary; // reuse cached summary
+
+        std::string omexml;
+        if (checkSuffix(id, companion_suffixes))
+          {
+            boost::filesystem::ifstream in(id);
+            if (!in)
+              {
+                boost::format fmt("Failed to open ‘%1%’");
+                fmt % id.string();
+                throw FormatException(fmt.str());
+              }
+            omexml.assign(std::istreambuf_iterator<char>(in),
+                          std::istreambuf_iterator<char>());
+          }
+        else
+          {
+            // Only the description is needed, so parse the first
+            // IFD natively rather than opening with libtiff.
+            boost::optional<std::string> description;
+            try
+              {
+                description = tiff::DirectoryParser(id).summary(0).description;
+              }
+            catch (const tiff::Exception&)
+              {
+                boost::format fmt("Failed to open ‘%1%’");
+                fmt % id.string();
+                throw FormatException(fmt.str());
+              }
+            if (!description)
+              throw FormatException("No TIFF ImageDescription found");
+            omexml = *description;
+          }
+
+        detail::OMEXMLSummary summary;
+        if (!detail::scanOMEXML(omexml, summary))
+          {
+            boost::format fmt("Badly formed or invalid XML document in ‘%1%’");
+            fmt % id.string();
+            throw FormatException(fmt.str());
+          }
+
+        cachedSummary = summary;
+        cachedSummaryFile = cid;
+
+        return cachedSummary;
+      }
+
       std::shared_ptr<ome::xml::meta::MetadataStore>
       OMETIFFReader::getMetadataStoreForConversion()
       {
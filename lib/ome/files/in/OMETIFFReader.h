@@ -38,7 +38,13 @@
 #ifndef OME_FILES_IN_OMETIFFREADER_H
 #define OME_FILES_IN_OMETIFFREADER_H
 
+#include <mutex>
+#include <set>
+
+#include <ome/files/detail/OMETIFF.h>
+#include <ome/files/detail/OMEXMLScan.h>
 #include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/tiff/HandleCache.h>
 #include <ome/files/tiff/TIFF.h>
 
 #include <ome/common/log.h>
@@ -90,15 +96,39 @@ namespace ome
         invalid_file_map invalidFiles;
 
         // Mutable to allow opening TIFFs when const.
-        /// Open TIFF files
+        /// Open TIFF files (null if held by @c handleCache).
         mutable tiff_map tiffs;
 
+        /// Mutex serialising the opening of TIFF files in @c tiffs.
+        mutable std::mutex tiffsMutex;
+
+        /// Decoded tile cache (shared by all open TIFF files).
+        std::shared_ptr<ome::files::tiff::DecodedTileCache> tileCache;
+
+        /// Pixel statistics sink (shared by all open TIFF files).
+        std::shared_ptr<PixelStatistics> statistics;
+
+        /// Use a sidecar directory index.
+        bool indexSidecar;
+
+        /// Number of pooled read handles per TIFF file.
+        unsigned int readHandles;
+
+        /// Validate all referenced TIFF files when opening.
+        bool strictValidation;
+
+        /// Open TIFF handle cache (null to keep all TIFFs open).
+        std::shared_ptr<ome::files::tiff::HandleCache> handleCache;
+
         /// Metadata file.
         boost::filesystem::path metadataFile;
 
         /// Used files.
         std::vector<boost::filesystem::path> usedFiles;
 
+        /// Files containing the planes of all series.
+        ome::files::detail::OMETIFFFileTable planeFiles;
+
         /// Has screen-plate-well metadata.
         bool hasSPW;
 
@@ -111,6 +141,15 @@ namespace ome
          */
         mutable boost::filesystem::path cachedMetadataFile;
 
+        /// Cached metadata summary (for type detection).
+        mutable ome::files::detail::OMEXMLSummary cachedSummary;
+
+        /// Cached metadata summary file location.
+        mutable boost::filesystem::path cachedSummaryFile;
+
+        /// Directory offsets of TIFF files, restored from a memo.
+        std::map<boost::filesystem::path, std::vector<ome::files::tiff::offset_type>> memoOffsets;
+
       public:
         /// Constructor.
         OMETIFFReader();
@@ -128,16 +167,50 @@ namespace ome
         isThisType(const boost::filesystem::path& name,
                    bool                           open) const;
 
+        // Documented in superclass.
+        void
+        openRawTile(dimension_size_type   plane,
+                    dimension_size_type   tile,
+                    std::vector<uint8_t>& buf) const;
+
+        /**
+         * @copydoc MinimalTIFFReader::forEachTileInRange(dimension_size_type,double,double,const tile_callback&)const
+         */
+        void
+        forEachTileInRange(dimension_size_type  plane,
+                           double               low,
+                           double               high,
+                           const tile_callback& callback) const;
+
       protected:
         // Documented in superclass.
         bool
         isFilenameThisTypeImpl(const boost::filesystem::path& name) const;
 
+        /**
+         * isThisType stream implementation for readers.
+         *
+         * The stream is valid if it starts with a TIFF header.  If
+         * the first IFD and its ImageDescription are contained in
+         * the stream, the description must also be an OME-XML
+         * document.  Otherwise, the stream can not be distinguished
+         * from a plain TIFF, and is considered valid.
+         *
+         * @param stream the input stream to check.
+         * @returns @c true if the stream is valid, @c false otherwise.
+         */
+        bool
+        isStreamThisTypeImpl(std::istream& stream) const;
+
         // Documented in superclass.
         void
         getLookupTable(dimension_size_type plane,
                        VariantPixelBuffer& buf) const;
 
+        // Documented in superclass.
+        bool
+        isNormalizedOnRead() const;
+
         // Documented in superclass.
         void
         openBytesImpl(dimension_size_type plane,
@@ -147,6 +220,41 @@ namespace ome
                       dimension_size_type w,
                       dimension_size_type h) const;
 
+        // Documented in superclass.
+        void
+        openBytesBatchImpl(dimension_size_type              plane,
+                           const std::vector<PlaneRegion>&  regions,
+                           std::vector<VariantPixelBuffer>& bufs) const;
+
+        // Documented in superclass.
+        void
+        openBytesDecimatedImpl(dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               const PlaneRegion&  region,
+                               dimension_size_type xstep,
+                               dimension_size_type ystep) const;
+
+        // Documented in superclass.
+        void
+        openBytesAtImpl(dimension_size_type series,
+                        dimension_size_type resolution,
+                        dimension_size_type plane,
+                        VariantPixelBuffer& buf,
+                        const PlaneRegion&  region) const;
+
+        // Documented in superclass.
+        void
+        openBytesIntoImpl(dimension_size_type     series,
+                          dimension_size_type     resolution,
+                          dimension_size_type     plane,
+                          VariantPixelBufferView& buf,
+                          const PlaneRegion&      region) const;
+
+        // Documented in superclass.
+        void
+        forEachTileImpl(dimension_size_type  plane,
+                        const tile_callback& callback) const;
+
         /**
          * Get the IFD index for a plane in the current series.
          *
@@ -157,6 +265,32 @@ namespace ome
         const std::shared_ptr<const tiff::IFD>
         ifdAtIndex(dimension_size_type plane) const;
 
+        /**
+         * Get the IFD for a plane of any series and resolution.
+         *
+         * The current series and resolution are not used.
+         *
+         * @param series the series index.
+         * @param resolution the resolution index within the series.
+         * @param plane the plane index within the series.
+         * @returns the IFD.
+         * @throws FormatException if out of range.
+         */
+        const std::shared_ptr<const tiff::IFD>
+        ifdAt(dimension_size_type series,
+              dimension_size_type resolution,
+              dimension_size_type plane) const;
+
+        /**
+         * Add sub-resolutions from SubIFDs.
+         *
+         * Each series is followed by a CoreMetadata entry for each
+         * sub-resolution of the first IFD in the series.  Only used
+         * when resolutions are not flattened.
+         */
+        void
+        addSubResolutions();
+
         /**
          * Add a TIFF file to the internal TIFF map.
          *
@@ -198,6 +332,34 @@ namespace ome
         void
         closeTIFF(const boost::filesystem::path& tiff);
 
+        /**
+         * Open a TIFF file.
+         *
+         * The reader's decode thread, tile cache and sidecar
+         * settings are applied to the opened file.
+         *
+         * @param tiff the TIFF filename.
+         * @returns the open TIFF, or null if it could not be opened.
+         */
+        std::shared_ptr<ome::files::tiff::TIFF>
+        openTIFF(const boost::filesystem::path& tiff) const;
+
+        /**
+         * Open a number of TIFF files concurrently.
+         *
+         * The files are opened on the executor, with a bounded number
+         * of files open at once, and the open files are then cached
+         * in the order given, as if opened by getTIFF().  Files which
+         * do not exist or could not be opened are skipped, to be
+         * reported when first used.  The current file is not
+         * reopened.
+         *
+         * @param files the TIFF filenames.
+         * @returns the files opened.
+         */
+        std::set<boost::filesystem::path>
+        openTIFFs(const std::vector<boost::filesystem::path>& files);
+
         /**
          * Read metadata into metadata store from an open TIFF.
          *
@@ -232,11 +394,200 @@ namespace ome
         std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>
         cacheMetadata(const boost::filesystem::path& id) const;
 
+        /**
+         * Read and cache a metadata summary.
+         *
+         * The OME-XML is scanned without building a DOM, which is
+         * much cheaper than cacheMetadata() when only the image
+         * counts and identifiers are needed, for example when
+         * checking the file type.  If previously cached, the cached
+         * copy will be returned.
+         *
+         * @param id the TIFF or companion file from which to read
+         * the metadata.
+         * @returns the metadata summary.
+         * @throws FormatException if the metadata could not be read
+         * or is not well formed.
+         */
+        const ome::files::detail::OMEXMLSummary&
+        cacheSummary(const boost::filesystem::path& id) const;
+
         public:
         // Documented in superclass.
         void
         close(bool fileOnly = false);
 
+        // Documented in superclass.
+        void
+        setDecodeThreads(unsigned int threads);
+
+        // Documented in superclass.
+        void
+        setExecutor(const std::shared_ptr<Executor>& executor);
+
+        /**
+         * Set the decoded tile cache.
+         *
+         * Decoded tiles are cached to avoid decoding the same tiles
+         * repeatedly when reading overlapping regions.  The cache is
+         * shared by all the TIFF files in the dataset, and may also
+         * be shared with other readers.  By default, each reader has
+         * its own cache with a budget of zero, which disables
+         * caching; use getTileCache()->setBudget() to enable it.
+         * To share decoded tiles with other processes, use
+         * getTileCache()->setSharedCache().
+         *
+         * @param cache the tile cache, or null to disable caching.
+         */
+        void
+        setTileCache(std::shared_ptr<ome::files::tiff::DecodedTileCache> cache);
+
+        /**
+         * Get the decoded tile cache.
+         *
+         * The cache may be used to adjust the budget and to obtain
+         * hit and miss statistics.
+         *
+         * @returns the tile cache, or null if caching is disabled.
+         */
+        const std::shared_ptr<ome::files::tiff::DecodedTileCache>&
+        getTileCache() const;
+
+        /**
+         * Set the pixel statistics sink.
+         *
+         * When set, statistics are accumulated for the pixels of
+         * each tile as it is read by openBytes(), without a second
+         * pass over the pixel data.  Use PixelStatistics::reset()
+         * between planes to obtain per-plane statistics.
+         *
+         * @param sink the statistics sink, or null to disable
+         * statistics.
+         * @see tiff::TIFF::setStatistics()
+         */
+        void
+        setStatistics(std::shared_ptr<PixelStatistics> sink);
+
+        /**
+         * Get the pixel statistics sink.
+         *
+         * @returns the statistics sink, or null if disabled.
+         */
+        const std::shared_ptr<PixelStatistics>&
+        getStatistics() const;
+
+        /**
+         * Enable or disable the sidecar directory index.
+         *
+         * When enabled, the directory offsets of each TIFF file are
+         * loaded from a sidecar index if it is up to date, avoiding
+         * a walk of all the directories on opening.  The index is
+         * written if missing or out of date.  This only has an
+         * effect on files opened after it is set.  Disabled by
+         * default.
+         *
+         * @param sidecar @c true to use a sidecar index, @c false
+         * otherwise.
+         * @see tiff::TIFF::setIndexSidecar()
+         */
+        void
+        setIndexSidecar(bool sidecar);
+
+        /**
+         * Check if the sidecar directory index is enabled.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getIndexSidecar() const;
+
+        /**
+         * Set the number of pooled read handles for each TIFF file.
+         *
+         * When non-zero, each read of pixel data borrows an
+         * independent libtiff handle from a pool kept for its file,
+         * so that planes of the same file may be read concurrently,
+         * for example with openBytesAt() from several threads.  Up
+         * to this number of idle handles are kept open per file.
+         * Zero (the default) disables the pool, serialising reads of
+         * each file.
+         *
+         * @param handles the maximum number of idle handles to keep
+         * open per file.
+         * @see tiff::TIFF::setReadHandles()
+         */
+        void
+        setReadHandles(unsigned int handles);
+
+        /**
+         * Get the number of pooled read handles for each TIFF file.
+         *
+         * @returns the maximum number of idle handles kept open per
+         * file.
+         */
+        unsigned int
+        getReadHandles() const;
+
+        /**
+         * Enable or disable strict validation of multi-file datasets.
+         *
+         * With strict validation, every TIFF file referenced by the
+         * OME-XML metadata is opened and checked when the dataset is
+         * opened, and the core metadata of each series is checked
+         * against its TIFF files.  Without it, only the file being
+         * opened is read; the other files are only opened the first
+         * time one of their planes is read, and an invalid file
+         * results in an exception at that time.  The OME-XML
+         * metadata is assumed to be correct for series in other
+         * files, with the optimal tile size and sample layout taken
+         * from the first IFD of the opened file, and sub-resolutions
+         * are only found for series in the opened file.  This makes
+         * opening large multi-file datasets, such as plates, far
+         * faster.  This only has an effect on datasets opened after
+         * it is set.  Enabled by default.
+         *
+         * @param strict @c true to validate all files when opening,
+         * @c false to validate files on first use.
+         */
+        void
+        setStrictValidation(bool strict);
+
+        /**
+         * Check if strict validation is enabled.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getStrictValidation() const;
+
+        /**
+         * Set the open TIFF handle cache.
+         *
+         * When set, the TIFF files of the dataset are held open by
+         * the cache, which bounds the number of open files by
+         * closing idle files and reopening them transparently on
+         * next access.  By default, the process-wide cache
+         * (tiff::HandleCache::global()) is used, which has no limit
+         * unless one is set.  Any TIFF files currently open are
+         * closed.
+         *
+         * @param cache the handle cache, or null to keep all TIFF
+         * files open until the reader is closed.
+         */
+        void
+        setHandleCache(std::shared_ptr<ome::files::tiff::HandleCache> cache);
+
+        /**
+         * Get the open TIFF handle cache.
+         *
+         * The cache may be used to adjust the limit and to obtain
+         * statistics.
+         *
+         * @returns the handle cache, or null if not used.
+         */
+        const std::shared_ptr<ome::files::tiff::HandleCache>&
+        getHandleCache() const;
+
         const std::vector<std::string>&
         getDomains() const;
 
@@ -260,6 +611,19 @@ namespace ome
         void
         initFile(const boost::filesystem::path& id);
 
+        // Documented in superclass.
+        bool
+        isMemoizable() const;
+
+      protected:
+        // Documented in superclass.
+        void
+        saveMemoState(::ome::files::detail::MemoWriter& memo) const;
+
+        // Documented in superclass.
+        bool
+        restoreMemoState(::ome::files::detail::MemoReader& memo);
+
       private:
         /**
          * Get UUID to file associations and used files.
@@ -0,0 +1,436 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/format.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/read.hpp>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/FormatTools.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/detail/Base64.h>
+#include <ome/files/detail/ByteSwap.h>
+#include <ome/files/detail/OMEXMLScan.h>
+#include <ome/files/in/OMEXMLReader.h>
+#include <ome/files/tiff/ByteSource.h>
+
+#include <ome/xml/meta/Convert.h>
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+using ome::files::detail::ReaderProperties;
+using ome::xml::meta::OMEXMLMetadata;
+
+typedef ome::xml::meta::BaseMetadata::index_type index_type;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace in
+    {
+
+      namespace
+      {
+
+        ReaderProperties
+        omexml_properties()
+        {
+          ReaderProperties p("OME-XML",
+                             "Open Microscopy Environment XML");
+
+          p.suffixes = {"ome", "ome.xml"};
+          p.metadata_levels.insert(MetadataOptions::METADATA_MINIMUM);
+          p.metadata_levels.insert(MetadataOptions::METADATA_NO_OVERLAYS);
+          p.metadata_levels.insert(MetadataOptions::METADATA_ALL);
+
+          return p;
+        }
+
+        const ReaderProperties&
+        props()
+        {
+          static const ReaderProperties p(omexml_properties());
+          return p;
+        }
+
+        // Size of the header checked by isFilenameThisTypeImpl().
+        const std::streamsize header_size = 4096;
+
+        // Swap pixel data not matching the endianness of the series.
+        struct SwapVisitor
+        {
+          template<typename T>
+          void
+          operator()(T& v)
+          {
+            detail::byteswap(v->data(), v->num_elements());
+          }
+        };
+
+      }
+
+      OMEXMLReader::OMEXMLReader():
+        ::ome::files::detail::FormatReader(props()),
+        binData(),
+        source()
+      {
+        this->suffixNecessary = false;
+        this->suffixSufficient = false;
+        this->domains = getDomainCollection(NON_GRAPHICS_DOMAINS);
+        this->datasetDescription = "A single .ome or .ome.xml file";
+      }
+
+      OMEXMLReader::~OMEXMLReader()
+      {
+        try
+          {
+            close();
+          }
+        catch (...)
+          {
+          }
+      }
+
+      bool
+      OMEXMLReader::isFilenameThisTypeImpl(const boost::filesystem::path& name) const
+      {
+        boost::filesystem::ifstream in(name, std::ios::in | std::ios::binary);
+        if (!in)
+          return false;
+
+        std::string header(static_cast<std::string::size_type>(header_size), '\0');
+        in.read(&header[0], header_size);
+        header.resize(static_cast<std::string::size_type>(in.gcount()));
+
+        std::istringstream stream(header);
+        return isStreamThisTypeImpl(stream);
+      }
+
+      bool
+      OMEXMLReader::isStreamThisTypeImpl(std::istream& stream) const
+      {
+        const std::string header((std::istreambuf_iterator<char>(stream)),
+                                 std::istreambuf_iterator<char>());
+
+        // Skip the XML declaration, comments and processing
+        // instructions preceding the root element.
+        std::string::size_type pos = 0;
+        while ((pos = header.find('<', pos)) != std::string::npos)
+          {
+            const char *skip = nullptr;
+            if (header.compare(pos, 4, "<!--") == 0)
+              skip = "-->";
+            else if (header.compare(pos, 2, "<?") == 0)
+              skip = "?>";
+            else if (header.compare(pos, 2, "<!") == 0)
+              skip = ">";
+            if (skip)
+              {
+                pos = header.find(skip, pos + 2);
+                if (pos == std::string::npos)
+                  return false;
+                pos += std::char_traits<char>::length(skip);
+                continue;
+              }
+
+            std::string::size_type nend = header.find_first_of(" \t\r\n/>", pos + 1);
+            if (nend == std::string::npos)
+              return false;
+            std::string name(header.substr(pos + 1, nend - pos - 1));
+            std::string::size_type colon = name.rfind(':');
+            if (colon != std::string::npos)
+              name.erase(0, colon + 1);
+            return name == "OME";
+          }
+
+        return false;
+      }
+
+      void
+      OMEXMLReader::initFile(const boost::filesystem::path& id)
+      {
+        ::ome::files::detail::FormatReader::initFile(id);
+
+        // Index the BinData elements, and read the remaining
+        // metadata, in a single pass.
+        std::string text;
+        std::vector<detail::OMEXMLBinData> bins;
+        {
+          boost::filesystem::ifstream in(id, std::ios::in | std::ios::binary);
+          if (!in)
+            {
+              boost::format fmt("Failed to open ‘%1%’");
+              fmt % id.string();
+              throw FormatException(fmt.str());
+            }
+
+          if (!detail::scanOMEXMLBinData(in, text, bins))
+            {
+              boost::format fmt("Invalid OME-XML document ‘%1%’");
+              fmt % id.string();
+              throw FormatException(fmt.str());
+            }
+        }
+
+        std::shared_ptr<OMEXMLMetadata> meta(createOMEXMLMetadata(text));
+        text.clear();
+
+        // Transfer OME-XML metadata to metadata store for reader.
+        convert(*meta, *metadataStore, true);
+
+        index_type seriesCount = meta->getImageCount();
+        binData.assign(seriesCount, std::vector<BinData>());
+        for (const auto& bin : bins)
+          {
+            if (bin.image >= seriesCount)
+              continue;
+
+            BinData b;
+            b.offset = bin.offset;
+            b.size = bin.size;
+            b.bigEndian = bin.bigEndian;
+            if (bin.compression.empty() || bin.compression == "none")
+              b.compression = BinData::NONE;
+            else if (bin.compression == "zlib")
+              b.compression = BinData::ZLIB;
+            else if (bin.compression == "bzip2")
+              b.compression = BinData::BZIP2;
+            else
+              {
+                boost::format fmt("Unsupported BinData compression ‘%1%’");
+                fmt % bin.compression;
+                throw FormatException(fmt.str());
+              }
+            binData.at(bin.image).push_back(b);
+          }
+
+        // Create CoreMetadata for each image.
+        core.clear();
+        core.reserve(seriesCount);
+        for (index_type series = 0; series < seriesCount; ++series)
+          {
+            std::shared_ptr<CoreMetadata> coreMeta(std::make_shared<CoreMetadata>());
+
+            dimension_size_type channelCount = meta->getChannelCount(series);
+            coreMeta->sizeC.clear();
+            if (channelCount > 0)
+              {
+                for (dimension_size_type channel = 0; channel < channelCount; ++channel)
+                  {
+                    dimension_size_type samplesPerPixel = 1U;
+                    try
+                      {
+                        samplesPerPixel = static_cast<dimension_size_type>(meta->getChannelSamplesPerPixel(series, channel));
+                      }
+                    catch (const std::exception&)
+                      {
+                      }
+                    coreMeta->sizeC.push_back(samplesPerPixel);
+                  }
+              }
+            else // No Channels specified
+              {
+                dimension_size_type channels = meta->getPixelsSizeC(series);
+                for (dimension_size_type channel = 0; channel < channels; ++channel)
+                  coreMeta->sizeC.push_back(1U);
+              }
+
+            coreMeta->sizeX = meta->getPixelsSizeX(series);
+            coreMeta->sizeY = meta->getPixelsSizeY(series);
+            coreMeta->sizeZ = meta->getPixelsSizeZ(series);
+            coreMeta->sizeT = meta->getPixelsSizeT(series);
+            coreMeta->pixelType = meta->getPixelsType(series);
+            coreMeta->imageCount = coreMeta->sizeZ * coreMeta->sizeC.size() * coreMeta->sizeT;
+            coreMeta->dimensionOrder = meta->getPixelsDimensionOrder(series);
+            coreMeta->orderCertain = true;
+            coreMeta->interleaved = false;
+            coreMeta->indexed = false;
+            coreMeta->metadataComplete = true;
+
+            const std::vector<BinData>& planes(binData.at(series));
+            if (planes.size() < coreMeta->imageCount)
+              {
+                boost::format fmt("Image %1% has %2% BinData elements for %3% planes");
+                fmt % series % planes.size() % coreMeta->imageCount;
+                throw FormatException(fmt.str());
+              }
+            // Planes with a different endianness are swapped when read.
+            coreMeta->littleEndian = !planes.empty() && !planes.front().bigEndian;
+
+            coreMeta->bitsPerPixel = bitsPerPixel(coreMeta->pixelType);
+            try
+              {
+                pixel_size_type bpp =
+                  static_cast<pixel_size_type>(meta->getPixelsSignificantBits(series));
+                if (bpp <= coreMeta->bitsPerPixel)
+                  coreMeta->bitsPerPixel = bpp;
+              }
+            catch (const std::exception&)
+              {
+              }
+
+            try
+              {
+                coreMeta->moduloZ = getModuloAlongZ(*meta, series);
+              }
+            catch (const std::exception&)
+              {
+              }
+            try
+              {
+                coreMeta->moduloT = getModuloAlongT(*meta, series);
+              }
+            catch (const std::exception&)
+              {
+              }
+            try
+              {
+                coreMeta->moduloC = getModuloAlongC(*meta, series);
+              }
+            catch (const std::exception&)
+              {
+              }
+
+            core.push_back(coreMeta);
+          }
+
+        fillMetadata(*metadataStore, *this, false, false);
+
+        source = std::make_shared<tiff::FileByteSource>(id);
+      }
+
+      void
+      OMEXMLReader::close(bool fileOnly)
+      {
+        clearPrefetch();
+
+        source.reset();
+        if (!fileOnly)
+          binData.clear();
+
+        ::ome::files::detail::FormatReader::close(fileOnly);
+      }
+
+      void
+      OMEXMLReader::openBytesImpl(dimension_size_type plane,
+                                  VariantPixelBuffer& buf,
+                                  dimension_size_type x,
+                                  dimension_size_type y,
+                                  dimension_size_type w,
+                                  dimension_size_type h) const
+      {
+        assertId(currentId, true);
+
+        if (!source)
+          throw FormatException("OME-XML file is closed");
+
+        const BinData& bin(binData.at(getCoreIndex()).at(plane));
+        const dimension_size_type samples = getRGBChannelCount(getZCTCoords(plane)[1]);
+        const dimension_size_type planeSize =
+          getSizeX() * getSizeY() * samples * bytesPerPixel(getPixelType());
+
+        // Read and decode only the BinData for this plane.
+        std::vector<uint8_t> data;
+        {
+          std::vector<char> encoded(static_cast<std::vector<char>::size_type>(bin.size));
+          if (!encoded.empty())
+            source->read(bin.offset, encoded.data(), encoded.size());
+          if (!detail::base64Decode(encoded.data(), encoded.size(), data))
+            {
+              boost::format fmt("Invalid base64 BinData for plane %1%");
+              fmt % plane;
+              throw FormatException(fmt.str());
+            }
+        }
+
+        if (bin.compression != BinData::NONE)
+          {
+            std::vector<uint8_t> expanded(static_cast<std::vector<uint8_t>::size_type>(planeSize));
+            std::streamsize count = 0;
+            try
+              {
+                boost::iostreams::filtering_istreambuf in;
+                if (bin.compression == BinData::ZLIB)
+                  in.push(boost::iostreams::zlib_decompressor());
+                else
+                  in.push(boost::iostreams::bzip2_decompressor());
+                in.push(boost::iostreams::array_source(reinterpret_cast<const char *>(data.data()),
+                                                       data.size()));
+                if (!expanded.empty())
+                  count = boost::iostreams::read(in, reinterpret_cast<char *>(expanded.data()),
+                                                 static_cast<std::streamsize>(expanded.size()));
+              }
+            catch (const std::ios_base::failure& e)
+              {
+                boost::format fmt("Failed to decompress BinData for plane %1%: %2%");
+                fmt % plane % e.what();
+                throw FormatException(fmt.str());
+              }
+            expanded.resize(static_cast<std::vector<uint8_t>::size_type>(std::max(count, std::streamsize(0))));
+            data.swap(expanded);
+          }
+
+        if (data.size() < planeSize)
+          {
+            boost::format fmt("BinData for plane %1% is %2% bytes; expected %3%");
+            fmt % plane % data.size() % planeSize;
+            throw FormatException(fmt.str());
+          }
+
+        // readPlane() swaps to native order for the series.
+        const_cast<OMEXMLReader&>(*this).readPlane(data.data(), data.size(), buf,
+                                                   x, y, w, h, samples);
+        if (bin.bigEndian == isLittleEndian())
+          {
+            SwapVisitor v;
+            ome::compat::visit(v, buf.vbuffer());
+          }
+      }
+
+    }
+  }
+}
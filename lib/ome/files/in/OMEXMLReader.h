@@ -0,0 +1,157 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_IN_OMEXMLREADER_H
+#define OME_FILES_IN_OMEXMLREADER_H
+
+#include <memory>
+#include <vector>
+
+#include <ome/files/detail/FormatReader.h>
+#include <ome/files/tiff/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+      class ByteSource;
+    }
+
+    namespace in
+    {
+
+      /**
+       * OME-XML reader.
+       *
+       * Reads pixel data embedded as base64-encoded BinData elements
+       * in plain OME-XML files.  When the file is opened, it is
+       * scanned once in a streaming pass which records the location
+       * of each BinData element; the pixel data is neither copied
+       * nor parsed, and only the remaining metadata is parsed as
+       * OME-XML.  Each plane is then read and decoded only when
+       * requested, so planes may be read in any order without
+       * decoding the whole file.  Uncompressed, zlib and bzip2
+       * compressed BinData is supported.
+       */
+      class OMEXMLReader : public ::ome::files::detail::FormatReader
+      {
+      protected:
+        /// Location and encoding of the BinData for a plane.
+        struct BinData
+        {
+          /// Compression types.
+          enum compression_type
+            {
+              NONE,  ///< Uncompressed.
+              ZLIB,  ///< zlib.
+              BZIP2  ///< bzip2.
+            };
+
+          /// Offset of the encoded content in the file.
+          tiff::offset_type offset;
+          /// Size of the encoded content.
+          dimension_size_type size;
+          /// Compression.
+          compression_type compression;
+          /// Big endian pixel data.
+          bool bigEndian;
+        };
+
+        /// BinData for each plane of each series.
+        std::vector<std::vector<BinData>> binData;
+
+        /// Source to read BinData from.
+        std::shared_ptr<tiff::ByteSource> source;
+
+      public:
+        /// Constructor.
+        OMEXMLReader();
+
+        /// Destructor.
+        virtual
+        ~OMEXMLReader();
+
+      protected:
+        // Documented in superclass.
+        bool
+        isFilenameThisTypeImpl(const boost::filesystem::path& name) const;
+
+        /**
+         * isThisType stream implementation for readers.
+         *
+         * The stream is valid if its root element is @c OME.
+         *
+         * @param stream the input stream to check.
+         * @returns @c true if the stream is valid, @c false otherwise.
+         */
+        bool
+        isStreamThisTypeImpl(std::istream& stream) const;
+
+        // Documented in superclass.
+        void
+        initFile(const boost::filesystem::path& id);
+
+      public:
+        // Documented in superclass.
+        void
+        close(bool fileOnly = false);
+
+      protected:
+        // Documented in superclass.
+        void
+        openBytesImpl(dimension_size_type plane,
+                      VariantPixelBuffer& buf,
+                      dimension_size_type x,
+                      dimension_size_type y,
+                      dimension_size_type w,
+                      dimension_size_type h) const;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_IN_OMEXMLREADER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
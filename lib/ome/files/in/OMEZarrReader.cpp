@@ -0,0 +1,971 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/read.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/FormatException.h>
+#include <ome/files/FormatTools.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/in/OMEZarrReader.h>
+#include <ome/files/tiff/Codec.h>
+
+#include <ome/xml/meta/Convert.h>
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+using ome::files::detail::ReaderProperties;
+using ome::xml::meta::OMEXMLMetadata;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+typedef ome::xml::meta::BaseMetadata::index_type index_type;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace in
+    {
+
+      namespace
+      {
+
+        typedef boost::property_tree::ptree json_tree;
+
+        ReaderProperties
+        zarr_properties()
+        {
+          ReaderProperties p("OME-Zarr",
+                             "OME Next-Generation File Format (Zarr)");
+
+          p.suffixes = {"ome.zarr", "zarr"};
+          p.metadata_levels.insert(MetadataOptions::METADATA_MINIMUM);
+          p.metadata_levels.insert(MetadataOptions::METADATA_NO_OVERLAYS);
+          p.metadata_levels.insert(MetadataOptions::METADATA_ALL);
+
+          return p;
+        }
+
+        const ReaderProperties&
+        props()
+        {
+          static const ReaderProperties p(zarr_properties());
+          return p;
+        }
+
+        // Join a key to the key of its group.
+        std::string
+        joinKey(const std::string& group,
+                const std::string& key)
+        {
+          return group.empty() ? key : group + '/' + key;
+        }
+
+        json_tree
+        parseJSON(const std::string& text,
+                  const std::string& key)
+        {
+          json_tree tree;
+          try
+            {
+              std::istringstream in(text);
+              boost::property_tree::read_json(in, tree);
+            }
+          catch (const boost::property_tree::json_parser_error& e)
+            {
+              boost::format fmt("Invalid JSON in Zarr key ‘%1%’: %2%");
+              fmt % key % e.message();
+              throw FormatException(fmt.str());
+            }
+          return tree;
+        }
+
+        // Get a JSON array of sizes.
+        std::vector<dimension_size_type>
+        jsonSizes(const json_tree&   tree,
+                  const std::string& name,
+                  const std::string& key)
+        {
+          std::vector<dimension_size_type> sizes;
+          boost::optional<const json_tree&> child(tree.get_child_optional(name));
+          if (!child)
+            {
+              boost::format fmt("Zarr array ‘%1%’ has no %2%");
+              fmt % key % name;
+              throw FormatException(fmt.str());
+            }
+          try
+            {
+              for (const auto& value : *child)
+                sizes.push_back(value.second.get_value<dimension_size_type>());
+            }
+          catch (const boost::property_tree::ptree_error&)
+            {
+              boost::format fmt("Zarr array ‘%1%’ has invalid %2%");
+              fmt % key % name;
+              throw FormatException(fmt.str());
+            }
+          return sizes;
+        }
+
+        // Pixel type of a Zarr data type, without byte order.
+        PixelType
+        zarrPixelType(const std::string& dtype)
+        {
+          if (dtype == "i1")
+            return PixelType::INT8;
+          if (dtype == "u1")
+            return PixelType::UINT8;
+          if (dtype == "b1")
+            return PixelType::BIT;
+          if (dtype == "i2")
+            return PixelType::INT16;
+          if (dtype == "u2")
+            return PixelType::UINT16;
+          if (dtype == "i4")
+            return PixelType::INT32;
+          if (dtype == "u4")
+            return PixelType::UINT32;
+          if (dtype == "f4")
+            return PixelType::FLOAT;
+          if (dtype == "f8")
+            return PixelType::DOUBLE;
+          if (dtype == "c8")
+            return PixelType::COMPLEXFLOAT;
+          if (dtype == "c16")
+            return PixelType::COMPLEXDOUBLE;
+
+          boost::format fmt("Unsupported Zarr data type ‘%1%’");
+          fmt % dtype;
+          throw FormatException(fmt.str());
+        }
+
+        // Fill value of a Zarr array.  Fill values which are not
+        // numbers (such as those of complex arrays) are zero.
+        double
+        zarrFillValue(const std::string& value)
+        {
+          if (value == "NaN")
+            return std::numeric_limits<double>::quiet_NaN();
+          if (value == "Infinity")
+            return std::numeric_limits<double>::infinity();
+          if (value == "-Infinity")
+            return -std::numeric_limits<double>::infinity();
+          if (value == "true")
+            return 1.0;
+          try
+            {
+              return std::stod(value);
+            }
+          catch (const std::exception&)
+            {
+            }
+          return 0.0;
+        }
+
+        // Set the first pixel of the visited buffer to a fill value.
+        struct FillVisitor
+        {
+          double value;
+
+          FillVisitor(double value):
+            value(value)
+          {}
+
+          template<typename T>
+          void
+          operator()(T& v)
+          {
+            typedef typename T::element_type::value_type value_type;
+
+            // NaN and infinity have no integer representation.
+            if (std::numeric_limits<value_type>::is_integer && !std::isfinite(value))
+              *v->data() = value_type();
+            else
+              *v->data() = static_cast<value_type>(value);
+          }
+        };
+
+        // Swap the byte order of each sample.  Complex samples are
+        // swapped as two separate values.
+        void
+        swapSamples(uint8_t             *data,
+                    dimension_size_type  size,
+                    dimension_size_type  samplesize)
+        {
+          for (uint8_t *sample = data;
+               sample + samplesize <= data + size;
+               sample += samplesize)
+            std::reverse(sample, sample + samplesize);
+        }
+
+      }
+
+      OMEZarrReader::OMEZarrReader():
+        ::ome::files::detail::FormatReader(props()),
+        store(),
+        userStore(),
+        arrays()
+      {
+        // A dataset is a directory, which is not identified by its
+        // name alone.
+        this->suffixNecessary = false;
+        this->suffixSufficient = false;
+        this->domains = getDomainCollection(NON_GRAPHICS_DOMAINS);
+        this->datasetDescription = "A directory containing an OME-Zarr dataset (.zattrs, .zgroup and chunked Zarr arrays)";
+      }
+
+      OMEZarrReader::~OMEZarrReader()
+      {
+        try
+          {
+            close();
+          }
+        catch (...)
+          {
+          }
+      }
+
+      void
+      OMEZarrReader::setStore(const store_type& store)
+      {
+        userStore = store;
+      }
+
+      const OMEZarrReader::store_type&
+      OMEZarrReader::getStore() const
+      {
+        return userStore;
+      }
+
+      OMEZarrReader::store_type
+      OMEZarrReader::makeDirectoryStore(const boost::filesystem::path& root)
+      {
+        return [root](const std::string& key) -> std::shared_ptr<tiff::ByteSource>
+          {
+            const boost::filesystem::path file(root / key);
+            if (!boost::filesystem::is_regular_file(file))
+              return std::shared_ptr<tiff::ByteSource>();
+            return std::make_shared<tiff::FileByteSource>(file);
+          };
+      }
+
+      bool
+      OMEZarrReader::isFilenameThisTypeImpl(const boost::filesystem::path& name) const
+      {
+        const boost::filesystem::path attrs(name / ".zattrs");
+        if (!boost::filesystem::is_directory(name) ||
+            !boost::filesystem::is_regular_file(attrs))
+          return false;
+
+        try
+          {
+            const tiff::FileByteSource source(attrs);
+            std::string text(static_cast<std::string::size_type>(source.size()), '\0');
+            source.read(0U, &text[0], text.size());
+            const json_tree tree(parseJSON(text, ".zattrs"));
+            return tree.find("bioformats2raw.layout") != tree.not_found() ||
+              tree.find("multiscales") != tree.not_found();
+          }
+        catch (const std::exception&)
+          {
+          }
+        return false;
+      }
+
+      void
+      OMEZarrReader::initFile(const boost::filesystem::path& id)
+      {
+        ::ome::files::detail::FormatReader::initFile(id);
+
+        store = userStore ? userStore : makeDirectoryStore(id);
+
+        auto attributes = [this](const std::string& group)
+          {
+            const std::string key(joinKey(group, ".zattrs"));
+            const std::string text(readKey(key, false));
+            return text.empty() ? json_tree() : parseJSON(text, key);
+          };
+
+        // Series groups, and OME-XML metadata if present.
+        std::vector<std::string> groups;
+        std::shared_ptr<OMEXMLMetadata> meta;
+        const json_tree rootAttrs(attributes(""));
+        if (rootAttrs.find("bioformats2raw.layout") != rootAttrs.not_found())
+          {
+            const std::string xml(readKey("OME/METADATA.ome.xml", false));
+            if (!xml.empty())
+              meta = createOMEXMLMetadata(xml);
+
+            const json_tree omeAttrs(attributes("OME"));
+            boost::optional<const json_tree&> series(omeAttrs.get_child_optional("series"));
+            if (series)
+              {
+                for (const auto& group : *series)
+                  groups.push_back(group.second.data());
+              }
+            else
+              {
+                // Series are numbered consecutively from zero.
+                for (dimension_size_type s = 0U;
+                     store(joinKey(std::to_string(s), ".zattrs"));
+                     ++s)
+                  groups.push_back(std::to_string(s));
+              }
+          }
+        else if (rootAttrs.find("multiscales") != rootAttrs.not_found())
+          {
+            groups.push_back(std::string());
+          }
+
+        if (groups.empty())
+          {
+            boost::format fmt("No OME-Zarr multiscales found in ‘%1%’");
+            fmt % id.string();
+            throw FormatException(fmt.str());
+          }
+
+        // Transfer OME-XML metadata to metadata store for reader.
+        if (meta)
+          convert(*meta, *metadataStore, true);
+
+        const bool nativeLittleEndian =
+          boost::endian::order::native == boost::endian::order::little;
+        const index_type imageCount = meta ? meta->getImageCount() : 0U;
+
+        core.clear();
+        arrays.clear();
+        std::vector<std::string> names;
+        for (dimension_size_type series = 0U; series < groups.size(); ++series)
+          {
+            const std::string& group(groups[series]);
+            const json_tree attrs(attributes(group));
+
+            boost::optional<const json_tree&> multiscales(attrs.get_child_optional("multiscales"));
+            if (!multiscales || multiscales->empty())
+              {
+                boost::format fmt("Zarr group ‘%1%’ has no multiscales");
+                fmt % group;
+                throw FormatException(fmt.str());
+              }
+            const json_tree& multiscale(multiscales->front().second);
+
+            // Axes are objects since version 0.4, and names before.
+            std::vector<std::string> axes;
+            boost::optional<const json_tree&> axisList(multiscale.get_child_optional("axes"));
+            if (axisList)
+              {
+                for (const auto& axis : *axisList)
+                  axes.push_back(axis.second.empty() ?
+                                 axis.second.data() :
+                                 axis.second.get<std::string>("name", ""));
+              }
+
+            std::vector<std::string> paths;
+            boost::optional<const json_tree&> datasets(multiscale.get_child_optional("datasets"));
+            if (datasets)
+              {
+                for (const auto& dataset : *datasets)
+                  paths.push_back(dataset.second.get<std::string>("path", ""));
+              }
+            if (paths.empty())
+              {
+                boost::format fmt("Zarr group ‘%1%’ has no datasets");
+                fmt % group;
+                throw FormatException(fmt.str());
+              }
+
+            names.push_back(multiscale.get<std::string>("name", ""));
+
+            const ZarrArray full(readArray(joinKey(group, paths.front()), axes));
+
+            std::shared_ptr<CoreMetadata> coreMeta(std::make_shared<CoreMetadata>());
+
+            // The C axis contains all samples of all channels;
+            // SamplesPerPixel groups them into channels if it is
+            // consistent with the array.
+            const dimension_size_type samples = full.size(AXIS_C);
+            coreMeta->sizeC.clear();
+            if (series < imageCount)
+              {
+                std::vector<dimension_size_type> sizeC;
+                dimension_size_type total = 0U;
+                for (index_type channel = 0; channel < meta->getChannelCount(series); ++channel)
+                  {
+                    dimension_size_type samplesPerPixel = 1U;
+                    try
+                      {
+                        samplesPerPixel = static_cast<dimension_size_type>(meta->getChannelSamplesPerPixel(series, channel));
+                      }
+                    catch (const std::exception&)
+                      {
+                      }
+                    sizeC.push_back(samplesPerPixel);
+                    total += samplesPerPixel;
+                  }
+                if (total == samples)
+                  coreMeta->sizeC = sizeC;
+              }
+            if (coreMeta->sizeC.empty())
+              coreMeta->sizeC.assign(samples, 1U);
+
+            coreMeta->sizeX = full.size(AXIS_X);
+            coreMeta->sizeY = full.size(AXIS_Y);
+            coreMeta->sizeZ = full.size(AXIS_Z);
+            coreMeta->sizeT = full.size(AXIS_T);
+            coreMeta->pixelType = zarrPixelType(full.dtype);
+            coreMeta->imageCount = coreMeta->sizeZ * coreMeta->sizeC.size() * coreMeta->sizeT;
+            coreMeta->dimensionOrder = DimensionOrder::XYZCT;
+            coreMeta->orderCertain = true;
+            coreMeta->indexed = false;
+            coreMeta->metadataComplete = true;
+            // Chunks are planar, and swapped to native byte order.
+            coreMeta->interleaved = false;
+            coreMeta->littleEndian = nativeLittleEndian;
+            coreMeta->bitsPerPixel = bitsPerPixel(coreMeta->pixelType);
+
+            if (series < imageCount)
+              {
+                try
+                  {
+                    coreMeta->dimensionOrder = meta->getPixelsDimensionOrder(series);
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+                try
+                  {
+                    pixel_size_type bpp =
+                      static_cast<pixel_size_type>(meta->getPixelsSignificantBits(series));
+                    if (bpp <= coreMeta->bitsPerPixel)
+                      coreMeta->bitsPerPixel = bpp;
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+                try
+                  {
+                    coreMeta->moduloZ = getModuloAlongZ(*meta, series);
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+                try
+                  {
+                    coreMeta->moduloT = getModuloAlongT(*meta, series);
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+                try
+                  {
+                    coreMeta->moduloC = getModuloAlongC(*meta, series);
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+              }
+
+            coreMeta->resolutionCount = paths.size();
+            core.push_back(coreMeta);
+            arrays.push_back(full);
+
+            // Each further dataset is a sub-resolution.
+            for (dimension_size_type r = 1U; r < paths.size(); ++r)
+              {
+                const ZarrArray sub(readArray(joinKey(group, paths[r]), axes));
+                if (sub.dtype != full.dtype ||
+                    sub.size(AXIS_C) != full.size(AXIS_C) ||
+                    sub.size(AXIS_Z) != full.size(AXIS_Z) ||
+                    sub.size(AXIS_T) != full.size(AXIS_T))
+                  {
+                    boost::format fmt("Zarr array ‘%1%’ does not match full resolution array ‘%2%’");
+                    fmt % sub.path % full.path;
+                    throw FormatException(fmt.str());
+                  }
+
+                std::shared_ptr<CoreMetadata> subcore(std::make_shared<CoreMetadata>(*coreMeta));
+                subcore->sizeX = sub.size(AXIS_X);
+                subcore->sizeY = sub.size(AXIS_Y);
+                subcore->resolutionCount = 1U;
+                core.push_back(subcore);
+                arrays.push_back(sub);
+              }
+          }
+
+        if (meta)
+          fillMetadata(*metadataStore, *this, false, false);
+        else
+          {
+            fillMetadata(*metadataStore, *this, false, true);
+            for (index_type series = 0U; series < names.size(); ++series)
+              {
+                if (!names[series].empty())
+                  metadataStore->setImageName(names[series], series);
+              }
+          }
+      }
+
+      void
+      OMEZarrReader::close(bool fileOnly)
+      {
+        clearPrefetch();
+
+        if (!fileOnly)
+          {
+            store = store_type();
+            arrays.clear();
+          }
+
+        ::ome::files::detail::FormatReader::close(fileOnly);
+      }
+
+      const std::vector<boost::filesystem::path>
+      OMEZarrReader::getSeriesUsedFiles(bool /* noPixels */) const
+      {
+        assertId(currentId, true);
+
+        // The dataset directory; its keys are not listed
+        // individually, since there may be many chunks.
+        std::vector<boost::filesystem::path> files;
+        if (currentId)
+          files.push_back(*currentId);
+        return files;
+      }
+
+      dimension_size_type
+      OMEZarrReader::getOptimalTileWidth(dimension_size_type /* channel */) const
+      {
+        assertId(currentId, true);
+        return std::min(arrays.at(getCoreIndex()).chunkSize(AXIS_X), getSizeX());
+      }
+
+      dimension_size_type
+      OMEZarrReader::getOptimalTileHeight(dimension_size_type /* channel */) const
+      {
+        assertId(currentId, true);
+        return std::min(arrays.at(getCoreIndex()).chunkSize(AXIS_Y), getSizeY());
+      }
+
+      void
+      OMEZarrReader::openBytesImpl(dimension_size_type plane,
+                                   VariantPixelBuffer& buf,
+                                   dimension_size_type x,
+                                   dimension_size_type y,
+                                   dimension_size_type w,
+                                   dimension_size_type h) const
+      {
+        assertId(currentId, true);
+
+        if (!store)
+          throw FormatException("OME-Zarr dataset is closed");
+
+        const ZarrArray& array(arrays.at(getCoreIndex()));
+        const std::array<dimension_size_type, 3> coords(getZCTCoords(plane));
+        const dimension_size_type samples = getRGBChannelCount(coords[1]);
+
+        // Index of the first sample of the channel along the C axis.
+        dimension_size_type sampleStart = 0U;
+        for (dimension_size_type c = 0U; c < coords[1]; ++c)
+          sampleStart += getRGBChannelCount(c);
+
+        preparePlane(buf, w, h, samples);
+
+        const PixelType type(getPixelType());
+        const dimension_size_type bpp = bytesPerPixel(type);
+        uint8_t *dest = reinterpret_cast<uint8_t *>(buf.data());
+
+        // Fill value, as a single native pixel.
+        std::vector<uint8_t> fill(bpp);
+        {
+          std::array<VariantPixelBuffer::size_type, 9> unit;
+          unit.fill(1);
+          VariantPixelBuffer fillbuf(unit, type);
+          FillVisitor v(array.fillValue);
+          ome::compat::visit(v, fillbuf.vbuffer());
+          std::memcpy(fill.data(), fillbuf.data(), bpp);
+        }
+
+        // Element strides of each dimension within a chunk (C order).
+        const dimension_size_type ndims = array.shape.size();
+        std::vector<dimension_size_type> strides(ndims, 1U);
+        for (dimension_size_type d = ndims - 1U; d > 0U; --d)
+          strides[d - 1U] = strides[d] * array.chunks[d];
+        const dimension_size_type chunkBytes = strides[0] * array.chunks[0] * bpp;
+        auto stride = [&](axis_type axis)
+          {
+            return array.axes[axis] < 0 ? 0U : strides[static_cast<dimension_size_type>(array.axes[axis])];
+          };
+        const dimension_size_type strideX = stride(AXIS_X);
+        const dimension_size_type strideY = stride(AXIS_Y);
+        const dimension_size_type chunkX = array.chunkSize(AXIS_X);
+        const dimension_size_type chunkY = array.chunkSize(AXIS_Y);
+
+        const bool nativeBigEndian =
+          boost::endian::order::native == boost::endian::order::big;
+        const dimension_size_type swapSize =
+          (type == PixelType::COMPLEXFLOAT || type == PixelType::COMPLEXDOUBLE) ? bpp / 2U : bpp;
+        const bool swap = swapSize > 1U && array.bigEndian != nativeBigEndian;
+
+        std::shared_ptr<const tiff::CodecPlugin> plugin;
+        if (array.compressor == ZLIB)
+          plugin = tiff::getCodecPlugin(tiff::COMPRESSION_ADOBE_DEFLATE);
+
+        // Each chunk overlapping the region, for each sample.
+        struct ChunkTask
+        {
+          dimension_size_type sample;
+          dimension_size_type cy;
+          dimension_size_type cx;
+        };
+        std::vector<ChunkTask> tasks;
+        for (dimension_size_type s = 0U; s < samples; ++s)
+          for (dimension_size_type cy = y / chunkY; cy * chunkY < y + h; ++cy)
+            for (dimension_size_type cx = x / chunkX; cx * chunkX < x + w; ++cx)
+              tasks.push_back(ChunkTask{s, cy, cx});
+
+        auto readChunk = [&](const ChunkTask& task)
+          {
+            // Chunk index, and element offset of the plane within
+            // the chunk.
+            std::vector<dimension_size_type> index(ndims, 0U);
+            dimension_size_type base = 0U;
+            auto locate = [&](axis_type axis, dimension_size_type coord)
+              {
+                if (array.axes[axis] < 0)
+                  return;
+                const dimension_size_type d = static_cast<dimension_size_type>(array.axes[axis]);
+                index[d] = coord / array.chunks[d];
+                base += (coord % array.chunks[d]) * strides[d];
+              };
+            locate(AXIS_T, coords[2]);
+            locate(AXIS_C, sampleStart + task.sample);
+            locate(AXIS_Z, coords[0]);
+            if (array.axes[AXIS_Y] >= 0)
+              index[static_cast<dimension_size_type>(array.axes[AXIS_Y])] = task.cy;
+            if (array.axes[AXIS_X] >= 0)
+              index[static_cast<dimension_size_type>(array.axes[AXIS_X])] = task.cx;
+
+            // Part of the region within the chunk.
+            const dimension_size_type x0 = std::max(x, task.cx * chunkX);
+            const dimension_size_type x1 = std::min(x + w, (task.cx + 1U) * chunkX);
+            const dimension_size_type y0 = std::max(y, task.cy * chunkY);
+            const dimension_size_type y1 = std::min(y + h, (task.cy + 1U) * chunkY);
+
+            auto destPixel = [&](dimension_size_type row, dimension_size_type col)
+              {
+                return dest + ((((task.sample * h) + (row - y)) * w) + (col - x)) * bpp;
+              };
+
+            const std::string key(joinKey(array.path, chunkKey(array, index)));
+            const std::shared_ptr<tiff::ByteSource> source(store(key));
+            if (!source)
+              {
+                // Missing chunks contain only the fill value.
+                for (dimension_size_type row = y0; row < y1; ++row)
+                  for (dimension_size_type col = x0; col < x1; ++col)
+                    std::memcpy(destPixel(row, col), fill.data(), bpp);
+                return;
+              }
+
+            std::vector<uint8_t> encoded(static_cast<std::vector<uint8_t>::size_type>(source->size()));
+            if (!encoded.empty())
+              source->read(0U, encoded.data(), encoded.size());
+
+            std::vector<uint8_t> decoded;
+            if (array.compressor == NONE)
+              decoded.swap(encoded);
+            else
+              {
+                decoded.resize(chunkBytes);
+                dimension_size_type count = 0U;
+                try
+                  {
+                    // Zarr zlib chunks are the same as TIFF deflate
+                    // strips, so a deflate codec plugin may be used.
+                    tiff::CodecTile tile;
+                    tile.scheme = tiff::COMPRESSION_ADOBE_DEFLATE;
+                    tile.width = static_cast<uint32_t>(chunkBytes);
+                    tile.length = 1U;
+                    tile.bits = 8U;
+                    tile.samples = 1U;
+                    tile.bigendian = nativeBigEndian;
+                    if (plugin && plugin->decode && (!plugin->supports || plugin->supports(tile)))
+                      {
+                        plugin->decode(tile, encoded.data(), encoded.size(),
+                                       decoded.data(), decoded.size());
+                        count = decoded.size();
+                      }
+                    else
+                      {
+                        boost::iostreams::filtering_istreambuf in;
+                        if (array.compressor == ZLIB)
+                          in.push(boost::iostreams::zlib_decompressor());
+                        else if (array.compressor == GZIP)
+                          in.push(boost::iostreams::gzip_decompressor());
+                        else
+                          in.push(boost::iostreams::bzip2_decompressor());
+                        in.push(boost::iostreams::array_source(reinterpret_cast<const char *>(encoded.data()),
+                                                               encoded.size()));
+                        const std::streamsize read =
+                          boost::iostreams::read(in, reinterpret_cast<char *>(decoded.data()),
+                                                 static_cast<std::streamsize>(decoded.size()));
+                        count = static_cast<dimension_size_type>(std::max(read, std::streamsize(0)));
+                      }
+                  }
+                catch (const std::exception& e)
+                  {
+                    boost::format fmt("Failed to decompress Zarr chunk ‘%1%’: %2%");
+                    fmt % key % e.what();
+                    throw FormatException(fmt.str());
+                  }
+                decoded.resize(count);
+              }
+
+            if (decoded.size() < chunkBytes)
+              {
+                boost::format fmt("Zarr chunk ‘%1%’ is %2% bytes; expected %3%");
+                fmt % key % decoded.size() % chunkBytes;
+                throw FormatException(fmt.str());
+              }
+
+            if (swap)
+              swapSamples(decoded.data(), chunkBytes, swapSize);
+
+            const dimension_size_type cx0 = task.cx * chunkX;
+            const dimension_size_type cy0 = task.cy * chunkY;
+            for (dimension_size_type row = y0; row < y1; ++row)
+              {
+                const dimension_size_type rowStart = base + ((row - cy0) * strideY);
+                if (strideX == 1U)
+                  std::memcpy(destPixel(row, x0),
+                              decoded.data() + (rowStart + (x0 - cx0)) * bpp,
+                              (x1 - x0) * bpp);
+                else
+                  for (dimension_size_type col = x0; col < x1; ++col)
+                    std::memcpy(destPixel(row, col),
+                                decoded.data() + (rowStart + ((col - cx0) * strideX)) * bpp,
+                                bpp);
+              }
+          };
+
+        const CancellationToken *cancel = CancellationToken::current();
+        const dimension_size_type nthreads =
+          std::min(static_cast<dimension_size_type>(getDecodeThreads()),
+                   static_cast<dimension_size_type>(tasks.size()));
+        if (nthreads < 2U)
+          {
+            for (const auto& task : tasks)
+              {
+                if (cancel)
+                  cancel->check();
+                readChunk(task);
+              }
+          }
+        else
+          {
+            getExecutor()->parallel(static_cast<unsigned int>(nthreads),
+                                    [&](unsigned int t)
+                                    {
+                                      for (dimension_size_type i = t; i < tasks.size(); i += nthreads)
+                                        {
+                                          if (cancel)
+                                            cancel->check();
+                                          readChunk(tasks[i]);
+                                        }
+                                    });
+          }
+      }
+
+      std::string
+      OMEZarrReader::readKey(const std::string& key,
+                             bool               required) const
+      {
+        const std::shared_ptr<tiff::ByteSource> source(store ? store(key) : std::shared_ptr<tiff::ByteSource>());
+        if (!source)
+          {
+            if (required)
+              {
+                boost::format fmt("Zarr key ‘%1%’ does not exist");
+                fmt % key;
+                throw FormatException(fmt.str());
+              }
+            return std::string();
+          }
+
+        std::string text(static_cast<std::string::size_type>(source->size()), '\0');
+        if (!text.empty())
+          source->read(0U, &text[0], text.size());
+        return text;
+      }
+
+      OMEZarrReader::ZarrArray
+      OMEZarrReader::readArray(const std::string&              path,
+                               const std::vector<std::string>& axes) const
+      {
+        const std::string key(joinKey(path, ".zarray"));
+        const json_tree meta(parseJSON(readKey(key), key));
+
+        if (meta.get<std::string>("zarr_format", "") != "2")
+          {
+            boost::format fmt("Zarr array ‘%1%’ is not Zarr format 2");
+            fmt % key;
+            throw FormatException(fmt.str());
+          }
+
+        ZarrArray array;
+        array.path = path;
+        array.shape = jsonSizes(meta, "shape", key);
+        array.chunks = jsonSizes(meta, "chunks", key);
+        if (array.shape.empty() ||
+            array.shape.size() != array.chunks.size() ||
+            std::find(array.chunks.begin(), array.chunks.end(), 0U) != array.chunks.end())
+          {
+            boost::format fmt("Zarr array ‘%1%’ has invalid shape or chunks");
+            fmt % key;
+            throw FormatException(fmt.str());
+          }
+
+        static const std::vector<std::string> default_axes{"t", "c", "z", "y", "x"};
+        const std::vector<std::string>& names(axes.empty() ? default_axes : axes);
+        if (names.size() != array.shape.size())
+          {
+            boost::format fmt("Zarr array ‘%1%’ has %2% dimensions; expected %3%");
+            fmt % key % array.shape.size() % names.size();
+            throw FormatException(fmt.str());
+          }
+        for (dimension_size_type d = 0U; d < names.size(); ++d)
+          {
+            static const std::string axis_names("xyzct");
+            const std::string::size_type axis = names[d].size() == 1U ?
+              axis_names.find(names[d][0]) : std::string::npos;
+            if (axis == std::string::npos || array.axes[axis] >= 0)
+              {
+                boost::format fmt("Zarr array ‘%1%’ has unsupported axis ‘%2%’");
+                fmt % key % names[d];
+                throw FormatException(fmt.str());
+              }
+            array.axes[axis] = static_cast<int>(d);
+          }
+
+        const std::string dtype(meta.get<std::string>("dtype", ""));
+        if (dtype.size() < 3U ||
+            (dtype[0] != '<' && dtype[0] != '>' && dtype[0] != '|'))
+          {
+            boost::format fmt("Zarr array ‘%1%’ has unsupported data type ‘%2%’");
+            fmt % key % dtype;
+            throw FormatException(fmt.str());
+          }
+        array.bigEndian = dtype[0] == '>';
+        array.dtype = dtype.substr(1);
+        zarrPixelType(array.dtype);
+
+        // A null compressor has no members.
+        boost::optional<const json_tree&> compressor(meta.get_child_optional("compressor"));
+        if (compressor && !compressor->empty())
+          {
+            const std::string id(compressor->get<std::string>("id", ""));
+            if (id == "zlib")
+              array.compressor = ZLIB;
+            else if (id == "gzip")
+              array.compressor = GZIP;
+            else if (id == "bz2")
+              array.compressor = BZIP2;
+            else
+              {
+                boost::format fmt("Zarr array ‘%1%’ has unsupported compressor ‘%2%’");
+                fmt % key % id;
+                throw FormatException(fmt.str());
+              }
+          }
+
+        boost::optional<const json_tree&> filters(meta.get_child_optional("filters"));
+        if (filters && !filters->empty())
+          {
+            boost::format fmt("Zarr array ‘%1%’ has unsupported filters");
+            fmt % key;
+            throw FormatException(fmt.str());
+          }
+
+        if (meta.get<std::string>("order", "C") != "C")
+          {
+            boost::format fmt("Zarr array ‘%1%’ is not in C order");
+            fmt % key;
+            throw FormatException(fmt.str());
+          }
+
+        array.fillValue = zarrFillValue(meta.get<std::string>("fill_value", ""));
+        array.separator = meta.get<std::string>("dimension_separator", ".");
+
+        return array;
+      }
+
+      std::string
+      OMEZarrReader::chunkKey(const ZarrArray&                        array,
+                              const std::vector<dimension_size_type>& index)
+      {
+        std::string key;
+        for (dimension_size_type d = 0U; d < index.size(); ++d)
+          {
+            if (d)
+              key += array.separator;
+            key += std::to_string(index[d]);
+          }
+        return key;
+      }
+
+    }
+  }
+}
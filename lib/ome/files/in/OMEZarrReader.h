@@ -0,0 +1,314 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+#ifndef OME_FILES_IN_OMEZARRREADER_H
+#define OME_FILES_IN_OMEZARRREADER_H
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/detail/FormatReader.h>
+#include <ome/files/tiff/ByteSource.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace in
+    {
+
+      /**
+       * OME-Zarr (OME-NGFF) reader.
+       *
+       * Reads version 2 Zarr arrays of the OME-NGFF multiscales
+       * specification.  Both the bioformats2raw layout (as written by
+       * OMEZarrWriter), with an OME-XML description of all series in
+       * @c OME/METADATA.ome.xml, and a single multiscales group at
+       * the root of the dataset are supported.  Each series is a
+       * multiscales group, and its datasets after the first are
+       * exposed as sub-resolutions with getResolutionCount() and
+       * setResolution().
+       *
+       * All keys are read through a store, which returns a byte
+       * source for each key (a path relative to the root of the
+       * dataset, such as @c 0/0/.zarray).  The default store reads
+       * files below the dataset directory; setStore() may be used to
+       * read from another location, such as an object store.
+       *
+       * openBytes() reads only the chunks overlapping the requested
+       * region.  Chunks are fetched and decoded in parallel, using
+       * up to getDecodeThreads() threads.  Uncompressed, zlib, gzip
+       * and bzip2 compressed chunks are supported.  Chunk filters and
+       * Fortran order are not supported.
+       */
+      class OMEZarrReader : public ::ome::files::detail::FormatReader
+      {
+        using ::ome::files::FormatReader::getOptimalTileWidth;
+        using ::ome::files::FormatReader::getOptimalTileHeight;
+
+      public:
+        /**
+         * Store type.
+         *
+         * Returns a byte source for the content of a key, or null if
+         * the key does not exist.  It may be called concurrently.
+         */
+        typedef std::function<std::shared_ptr<tiff::ByteSource> (const std::string& key)> store_type;
+
+      protected:
+        /// Chunk compressors.
+        enum compressor_type
+          {
+            NONE,  ///< Uncompressed.
+            ZLIB,  ///< zlib.
+            GZIP,  ///< gzip.
+            BZIP2  ///< bzip2.
+          };
+
+        /// Axes of an array.
+        enum axis_type
+          {
+            AXIS_X,  ///< X.
+            AXIS_Y,  ///< Y.
+            AXIS_Z,  ///< Z.
+            AXIS_C,  ///< Channel (all samples of all channels).
+            AXIS_T   ///< T.
+          };
+
+        /// Zarr array of a series at a resolution level.
+        struct ZarrArray
+        {
+          /// Key of the array group.
+          std::string path;
+          /// Size of each dimension.
+          std::vector<dimension_size_type> shape;
+          /// Chunk size of each dimension.
+          std::vector<dimension_size_type> chunks;
+          /// Dimension of each axis, or -1 if absent.
+          std::array<int, 5> axes;
+          /// Data type, without byte order (e.g. @c u2).
+          std::string dtype;
+          /// Chunk compressor.
+          compressor_type compressor;
+          /// @c true if the data type is big-endian.
+          bool bigEndian;
+          /// Value of missing chunks.
+          double fillValue;
+          /// Chunk key separator.
+          std::string separator;
+
+          /// Constructor.
+          ZarrArray():
+            path(),
+            shape(),
+            chunks(),
+            axes(),
+            dtype(),
+            compressor(NONE),
+            bigEndian(false),
+            fillValue(0.0),
+            separator(".")
+          {
+            axes.fill(-1);
+          }
+
+          /**
+           * Get the size of an axis.
+           *
+           * @param axis the axis.
+           * @returns the size, or 1 if the axis is absent.
+           */
+          dimension_size_type
+          size(axis_type axis) const
+          {
+            return axes[axis] < 0 ? 1U : shape[static_cast<std::size_t>(axes[axis])];
+          }
+
+          /**
+           * Get the chunk size of an axis.
+           *
+           * @param axis the axis.
+           * @returns the chunk size, or 1 if the axis is absent.
+           */
+          dimension_size_type
+          chunkSize(axis_type axis) const
+          {
+            return axes[axis] < 0 ? 1U : chunks[static_cast<std::size_t>(axes[axis])];
+          }
+        };
+
+        /// Store for the current dataset.
+        store_type store;
+
+        /// Store set by the user, if any.
+        store_type userStore;
+
+        /// Array for each core metadata index.
+        std::vector<ZarrArray> arrays;
+
+      public:
+        /// Constructor.
+        OMEZarrReader();
+
+        /// Destructor.
+        virtual
+        ~OMEZarrReader();
+
+        /**
+         * Set the store to read keys from.
+         *
+         * This must be set before setId() to take effect.  The id
+         * is still used to name the dataset.  If not set, or set to
+         * an empty store, keys are read from files below the dataset
+         * directory.
+         *
+         * @param store the store to use.
+         */
+        void
+        setStore(const store_type& store);
+
+        /**
+         * Get the store set with setStore().
+         *
+         * @returns the store, which is empty if not set.
+         */
+        const store_type&
+        getStore() const;
+
+        /**
+         * Create a store reading files below a directory.
+         *
+         * @param root the root directory of the dataset.
+         * @returns the store.
+         */
+        static
+        store_type
+        makeDirectoryStore(const boost::filesystem::path& root);
+
+      protected:
+        // Documented in superclass.
+        bool
+        isFilenameThisTypeImpl(const boost::filesystem::path& name) const;
+
+        // Documented in superclass.
+        void
+        initFile(const boost::filesystem::path& id);
+
+      public:
+        // Documented in superclass.
+        void
+        close(bool fileOnly = false);
+
+        // Documented in superclass.
+        const std::vector<boost::filesystem::path>
+        getSeriesUsedFiles(bool noPixels = false) const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getOptimalTileWidth(dimension_size_type channel) const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getOptimalTileHeight(dimension_size_type channel) const;
+
+      protected:
+        // Documented in superclass.
+        void
+        openBytesImpl(dimension_size_type plane,
+                      VariantPixelBuffer& buf,
+                      dimension_size_type x,
+                      dimension_size_type y,
+                      dimension_size_type w,
+                      dimension_size_type h) const;
+
+        /**
+         * Read the content of a key.
+         *
+         * @param key the key to read.
+         * @param required @c true to throw if the key does not exist.
+         * @returns the content, or an empty string if the key does
+         * not exist.
+         * @throws FormatException if the key is required and does not
+         * exist.
+         */
+        std::string
+        readKey(const std::string& key,
+                bool               required = true) const;
+
+        /**
+         * Read the metadata of an array.
+         *
+         * @param path the key of the array group.
+         * @param axes the axis names of the array, or empty to use
+         * the default NGFF axes (@c t, @c c, @c z, @c y, @c x).
+         * @returns the array.
+         * @throws FormatException if the array is invalid or not
+         * supported.
+         */
+        ZarrArray
+        readArray(const std::string&              path,
+                  const std::vector<std::string>& axes) const;
+
+        /**
+         * Get the key of a chunk.
+         *
+         * @param array the array.
+         * @param index the chunk index of each dimension.
+         * @returns the key.
+         */
+        static
+        std::string
+        chunkKey(const ZarrArray&                        array,
+                 const std::vector<dimension_size_type>& index);
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_IN_OMEZARRREADER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,485 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <cstdint>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/FormatTools.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/in/RawReader.h>
+
+#include <ome/xml/meta/Convert.h>
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+using ome::files::detail::ReaderProperties;
+using ome::xml::meta::OMEXMLMetadata;
+using ome::xml::model::enums::PixelType;
+
+typedef ome::xml::meta::BaseMetadata::index_type index_type;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace in
+    {
+
+      namespace
+      {
+
+        ReaderProperties
+        raw_properties()
+        {
+          ReaderProperties p("Raw",
+                             "Raw binary stack with OME-XML sidecar");
+
+          p.suffixes = {"raw"};
+          p.metadata_levels.insert(MetadataOptions::METADATA_MINIMUM);
+          p.metadata_levels.insert(MetadataOptions::METADATA_NO_OVERLAYS);
+          p.metadata_levels.insert(MetadataOptions::METADATA_ALL);
+
+          return p;
+        }
+
+        const ReaderProperties&
+        props()
+        {
+          static const ReaderProperties p(raw_properties());
+          return p;
+        }
+
+        // Sidecar suffixes, in order of preference.
+        const std::array<const char *, 3> sidecar_suffixes =
+          {{".raw.ome.xml", ".ome.xml", ".companion.ome"}};
+
+        // Reference mapped pixel data with a buffer of the same type
+        // as the visited buffer.
+        struct MapVisitor
+        {
+          uint8_t                                             *data;
+          const std::array<VariantPixelBuffer::size_type, 9>&  shape;
+          PixelType                                            type;
+          const VariantPixelBuffer::storage_order_type&        order;
+          VariantPixelBuffer::variant_buffer_type&             result;
+
+          MapVisitor(uint8_t                                             *data,
+                     const std::array<VariantPixelBuffer::size_type, 9>&  shape,
+                     PixelType                                            type,
+                     const VariantPixelBuffer::storage_order_type&        order,
+                     VariantPixelBuffer::variant_buffer_type&             result):
+            data(data),
+            shape(shape),
+            type(type),
+            order(order),
+            result(result)
+          {}
+
+          template<typename T>
+          void
+          operator()(const T& /* v */)
+          {
+            typedef typename T::element_type buffer_type;
+            typedef typename buffer_type::value_type value_type;
+
+            result = std::shared_ptr<buffer_type>
+              (new buffer_type(reinterpret_cast<value_type *>(data),
+                               shape, type, ENDIAN_NATIVE, order));
+          }
+        };
+
+      }
+
+      RawReader::RawReader():
+        ::ome::files::detail::FormatReader(props()),
+        metadataFile(),
+        mapping(),
+        seriesOffsets()
+      {
+        this->companionFiles = true;
+        this->domains = getDomainCollection(NON_GRAPHICS_DOMAINS);
+        this->datasetDescription = "A .raw file with an OME-XML sidecar (.raw.ome.xml, .ome.xml or .companion.ome)";
+      }
+
+      RawReader::~RawReader()
+      {
+        try
+          {
+            close();
+          }
+        catch (...)
+          {
+          }
+      }
+
+      boost::filesystem::path
+      RawReader::findMetadataFile(const boost::filesystem::path& name)
+      {
+        const boost::filesystem::path stem(boost::filesystem::path(name).replace_extension());
+        for (const auto& suffix : sidecar_suffixes)
+          {
+            boost::filesystem::path sidecar(stem);
+            sidecar += suffix;
+            if (boost::filesystem::exists(sidecar))
+              return sidecar;
+          }
+        return boost::filesystem::path();
+      }
+
+      void
+      RawReader::initFile(const boost::filesystem::path& id)
+      {
+        ::ome::files::detail::FormatReader::initFile(id);
+
+        metadataFile = findMetadataFile(id);
+        if (metadataFile.empty())
+          {
+            boost::format fmt("No OME-XML sidecar found for ‘%1%’");
+            fmt % id.string();
+            throw FormatException(fmt.str());
+          }
+
+        std::shared_ptr<OMEXMLMetadata> meta(createOMEXMLMetadata(metadataFile));
+
+        // Transfer OME-XML metadata to metadata store for reader.
+        convert(*meta, *metadataStore, true);
+
+        const bool nativeLittleEndian =
+          boost::endian::order::native == boost::endian::order::little;
+
+        // Create CoreMetadata for each image, and compute the size of
+        // its pixel data.
+        index_type seriesCount = meta->getImageCount();
+        core.clear();
+        core.reserve(seriesCount);
+        seriesOffsets.clear();
+        seriesOffsets.reserve(seriesCount);
+        dimension_size_type dataSize = 0;
+        for (index_type series = 0; series < seriesCount; ++series)
+          {
+            std::shared_ptr<CoreMetadata> coreMeta(std::make_shared<CoreMetadata>());
+
+            dimension_size_type channelCount = meta->getChannelCount(series);
+            coreMeta->sizeC.clear();
+            if (channelCount > 0)
+              {
+                for (dimension_size_type channel = 0; channel < channelCount; ++channel)
+                  {
+                    dimension_size_type samplesPerPixel = 1U;
+                    try
+                      {
+                        samplesPerPixel = static_cast<dimension_size_type>(meta->getChannelSamplesPerPixel(series, channel));
+                      }
+                    catch (const std::exception&)
+                      {
+                      }
+                    coreMeta->sizeC.push_back(samplesPerPixel);
+                  }
+              }
+            else // No Channels specified
+              {
+                dimension_size_type channels = meta->getPixelsSizeC(series);
+                for (dimension_size_type channel = 0; channel < channels; ++channel)
+                  coreMeta->sizeC.push_back(1U);
+              }
+
+            // Planes are located by index, so all must be the same size.
+            for (const auto& samples : coreMeta->sizeC)
+              {
+                if (samples != coreMeta->sizeC.front())
+                  {
+                    boost::format fmt("Image %1% has channels with differing SamplesPerPixel");
+                    fmt % series;
+                    throw FormatException(fmt.str());
+                  }
+              }
+
+            coreMeta->sizeX = meta->getPixelsSizeX(series);
+            coreMeta->sizeY = meta->getPixelsSizeY(series);
+            coreMeta->sizeZ = meta->getPixelsSizeZ(series);
+            coreMeta->sizeT = meta->getPixelsSizeT(series);
+            coreMeta->pixelType = meta->getPixelsType(series);
+            coreMeta->imageCount = coreMeta->sizeZ * coreMeta->sizeC.size() * coreMeta->sizeT;
+            coreMeta->dimensionOrder = meta->getPixelsDimensionOrder(series);
+            coreMeta->orderCertain = true;
+            coreMeta->indexed = false;
+            coreMeta->metadataComplete = true;
+
+            coreMeta->interleaved = false;
+            try
+              {
+                coreMeta->interleaved = meta->getPixelsInterleaved(series);
+              }
+            catch (const std::exception&)
+              {
+              }
+            coreMeta->littleEndian = nativeLittleEndian;
+            try
+              {
+                coreMeta->littleEndian = !meta->getPixelsBigEndian(series);
+              }
+            catch (const std::exception&)
+              {
+              }
+
+            coreMeta->bitsPerPixel = bitsPerPixel(coreMeta->pixelType);
+            try
+              {
+                pixel_size_type bpp =
+                  static_cast<pixel_size_type>(meta->getPixelsSignificantBits(series));
+                if (bpp <= coreMeta->bitsPerPixel)
+                  coreMeta->bitsPerPixel = bpp;
+              }
+            catch (const std::exception&)
+              {
+              }
+
+            try
+              {
+                coreMeta->moduloZ = getModuloAlongZ(*meta, series);
+              }
+            catch (const std::exception&)
+              {
+              }
+            try
+              {
+                coreMeta->moduloT = getModuloAlongT(*meta, series);
+              }
+            catch (const std::exception&)
+              {
+              }
+            try
+              {
+                coreMeta->moduloC = getModuloAlongC(*meta, series);
+              }
+            catch (const std::exception&)
+              {
+              }
+
+            seriesOffsets.push_back(dataSize);
+            dataSize += coreMeta->imageCount * coreMeta->sizeX * coreMeta->sizeY *
+              (coreMeta->sizeC.empty() ? 1U : coreMeta->sizeC.front()) *
+              bytesPerPixel(coreMeta->pixelType);
+
+            core.push_back(coreMeta);
+          }
+
+        fillMetadata(*metadataStore, *this, false, false);
+
+        const dimension_size_type fileSize = boost::filesystem::file_size(id);
+        if (fileSize < dataSize)
+          {
+            boost::format fmt("Raw file ‘%1%’ is %2% bytes; expected at least %3%");
+            fmt % id.string() % fileSize % dataSize;
+            throw FormatException(fmt.str());
+          }
+
+        // Skip any header preceding the pixel data.
+        const dimension_size_type headerSize = fileSize - dataSize;
+        for (auto& offset : seriesOffsets)
+          offset += headerSize;
+
+        // A private mapping permits zero-copy buffers to be modified
+        // without modifying the file.
+        if (fileSize)
+          {
+            try
+              {
+                mapping = std::make_shared<boost::iostreams::mapped_file>
+                  (id.string(), boost::iostreams::mapped_file::priv);
+              }
+            catch (const std::exception& e)
+              {
+                boost::format fmt("Failed to map raw file ‘%1%’: %2%");
+                fmt % id.string() % e.what();
+                throw FormatException(fmt.str());
+              }
+          }
+      }
+
+      void
+      RawReader::close(bool fileOnly)
+      {
+        clearPrefetch();
+
+        mapping.reset();
+        if (!fileOnly)
+          {
+            metadataFile.clear();
+            seriesOffsets.clear();
+          }
+
+        ::ome::files::detail::FormatReader::close(fileOnly);
+      }
+
+      const std::vector<boost::filesystem::path>
+      RawReader::getSeriesUsedFiles(bool noPixels) const
+      {
+        assertId(currentId, true);
+
+        std::vector<boost::filesystem::path> files;
+        files.push_back(metadataFile);
+        if (!noPixels && currentId)
+          files.push_back(*currentId);
+        return files;
+      }
+
+      bool
+      RawReader::openBytesMapped(dimension_size_type plane,
+                                 VariantPixelBuffer& buf) const
+      {
+        return openBytesMapped(plane, buf, 0, 0, getSizeX(), getSizeY());
+      }
+
+      bool
+      RawReader::openBytesMapped(dimension_size_type plane,
+                                 VariantPixelBuffer& buf,
+                                 dimension_size_type x,
+                                 dimension_size_type y,
+                                 dimension_size_type w,
+                                 dimension_size_type h) const
+      {
+        assertId(currentId, true);
+
+        const dimension_size_type sizeX = getSizeX();
+        const dimension_size_type sizeY = getSizeY();
+        if (plane >= getImageCount() ||
+            x + w > sizeX || y + h > sizeY)
+          throw FormatException("Invalid plane or region");
+
+        const PixelType type(getPixelType());
+        const dimension_size_type samples = getRGBChannelCount(getZCTCoords(plane)[1]);
+        const dimension_size_type bpp = bytesPerPixel(type);
+        const bool interleaved = isInterleaved();
+        const bool nativeLittleEndian =
+          boost::endian::order::native == boost::endian::order::little;
+
+        // The region must be a contiguous, native-endian run of
+        // pixels in the mapping.
+        const bool fullRows = (x == 0 && w == sizeX) || h == 1;
+        const bool contiguous = interleaved || samples == 1 ?
+          fullRows :
+          (x == 0 && y == 0 && w == sizeX && h == sizeY);
+
+        uint8_t *data = nullptr;
+        if (mapping &&
+            contiguous &&
+            !isNormalized() &&
+            type != PixelType::BIT &&
+            isLittleEndian() == nativeLittleEndian)
+          {
+            data = planeData(plane) + (((y * sizeX) + x) * samples * bpp);
+            if (reinterpret_cast<std::uintptr_t>(data) % bpp)
+              data = nullptr;
+          }
+
+        if (!data)
+          {
+            openBytes(plane, buf, x, y, w, h);
+            return false;
+          }
+
+        std::array<VariantPixelBuffer::size_type, 9> shape;
+        shape[DIM_SPATIAL_X] = w;
+        shape[DIM_SPATIAL_Y] = h;
+        shape[DIM_SUBCHANNEL] = samples;
+        shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+          shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+
+        const VariantPixelBuffer::storage_order_type order
+          (PixelBufferBase::make_storage_order(getDimensionOrder(), interleaved));
+
+        // A single-pixel buffer of the required type selects the
+        // buffer type to create.
+        std::array<VariantPixelBuffer::size_type, 9> unit;
+        unit.fill(1);
+        VariantPixelBuffer proto(unit, type);
+
+        VariantPixelBuffer::variant_buffer_type result(buf.vbuffer());
+        MapVisitor v(data, shape, type, order, result);
+        ome::compat::visit(v, proto.vbuffer());
+        buf.vbuffer() = result;
+
+        return true;
+      }
+
+      void
+      RawReader::openBytesImpl(dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               dimension_size_type x,
+                               dimension_size_type y,
+                               dimension_size_type w,
+                               dimension_size_type h) const
+      {
+        assertId(currentId, true);
+
+        const dimension_size_type samples = getRGBChannelCount(getZCTCoords(plane)[1]);
+        const dimension_size_type size = planeSize();
+        const uint8_t *data = size ? planeData(plane) : nullptr;
+
+        // readPlane() swaps to native order for the series.
+        const_cast<RawReader&>(*this).readPlane(data, size, buf,
+                                                x, y, w, h, samples);
+      }
+
+      uint8_t *
+      RawReader::planeData(dimension_size_type plane) const
+      {
+        if (!mapping)
+          throw FormatException("Raw file is closed");
+
+        return reinterpret_cast<uint8_t *>(mapping->data()) +
+          seriesOffsets.at(getCoreIndex()) + (plane * planeSize());
+      }
+
+      dimension_size_type
+      RawReader::planeSize() const
+      {
+        return getSizeX() * getSizeY() * getRGBChannelCount(0) *
+          bytesPerPixel(getPixelType());
+      }
+
+    }
+  }
+}
@@ -0,0 +1,214 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_IN_RAWREADER_H
+#define OME_FILES_IN_RAWREADER_H
+
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/detail/FormatReader.h>
+
+namespace boost
+{
+  namespace iostreams
+  {
+    class mapped_file;
+  }
+}
+
+namespace ome
+{
+  namespace files
+  {
+    namespace in
+    {
+
+      /**
+       * Raw binary stack reader.
+       *
+       * Reads uncompressed pixel data stored without any structure,
+       * such as acquisition dumps, with the image dimensions taken
+       * from an OME-XML sidecar file.  For a file @c stack.raw, the
+       * sidecar is the first of @c stack.raw.ome.xml,
+       * @c stack.ome.xml and @c stack.companion.ome which exists.
+       *
+       * The planes of each Image are stored consecutively in
+       * dimension order, each Image following the last, using the
+       * Pixels Type, DimensionOrder, Interleaved and BigEndian
+       * (native endianness if not set) of each Image.  Any bytes
+       * before the pixel data, for example a simple file header,
+       * are skipped: the pixel data is assumed to fill the end of
+       * the file.
+       *
+       * The file is memory-mapped, and planes are read by copying
+       * directly from the mapping.  openBytesMapped() may be used to
+       * reference the mapping without copying.
+       */
+      class RawReader : public ::ome::files::detail::FormatReader
+      {
+      protected:
+        /// OME-XML sidecar.
+        boost::filesystem::path metadataFile;
+
+        /// Mapped file.
+        std::shared_ptr<boost::iostreams::mapped_file> mapping;
+
+        /// Offset of the pixel data of each series in the file.
+        std::vector<dimension_size_type> seriesOffsets;
+
+      public:
+        /// Constructor.
+        RawReader();
+
+        /// Destructor.
+        virtual
+        ~RawReader();
+
+        /**
+         * Find the OME-XML sidecar for a raw file.
+         *
+         * @param name the raw file.
+         * @returns the sidecar, or an empty path if none exists.
+         */
+        static
+        boost::filesystem::path
+        findMetadataFile(const boost::filesystem::path& name);
+
+      protected:
+        // Documented in superclass.
+        void
+        initFile(const boost::filesystem::path& id);
+
+      public:
+        // Documented in superclass.
+        void
+        close(bool fileOnly = false);
+
+        // Documented in superclass.
+        const std::vector<boost::filesystem::path>
+        getSeriesUsedFiles(bool noPixels = false) const;
+
+        /**
+         * Obtain an image plane without copying.
+         *
+         * This is equivalent to openBytesMapped() for the whole
+         * plane.
+         *
+         * @param plane the plane index within the series.
+         * @param buf the destination pixel buffer.
+         * @returns @c true if @c buf references the mapped file, or
+         * @c false if the pixel data was copied.
+         * @throws FormatException if the plane is invalid.
+         */
+        bool
+        openBytesMapped(dimension_size_type plane,
+                        VariantPixelBuffer& buf) const;
+
+        /**
+         * Obtain a sub-image of an image plane without copying.
+         *
+         * Where the region is contiguous in the file (whole rows,
+         * and all samples of each row when not interleaved), the
+         * pixel data is in native byte order and suitably aligned,
+         * @c buf is replaced by a buffer referencing the mapped file.
+         * Otherwise the pixel data is copied into @c buf as for
+         * openBytes().  The mapping is private, so modifying the
+         * buffer does not modify the file.  A buffer referencing the
+         * mapping is only valid until the reader is closed.
+         *
+         * @param plane the plane index within the series.
+         * @param buf the destination pixel buffer.
+         * @param x the @c X coordinate of the upper-left corner of the sub-image.
+         * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+         * @param w the width of the sub-image.
+         * @param h the height of the sub-image.
+         * @returns @c true if @c buf references the mapped file, or
+         * @c false if the pixel data was copied.
+         * @throws FormatException if any of the parameters are
+         * invalid.
+         */
+        bool
+        openBytesMapped(dimension_size_type plane,
+                        VariantPixelBuffer& buf,
+                        dimension_size_type x,
+                        dimension_size_type y,
+                        dimension_size_type w,
+                        dimension_size_type h) const;
+
+      protected:
+        // Documented in superclass.
+        void
+        openBytesImpl(dimension_size_type plane,
+                      VariantPixelBuffer& buf,
+                      dimension_size_type x,
+                      dimension_size_type y,
+                      dimension_size_type w,
+                      dimension_size_type h) const;
+
+        /**
+         * Get the mapped pixel data of a plane.
+         *
+         * @param plane the plane index within the series.
+         * @returns the start of the plane in the mapping.
+         */
+        uint8_t *
+        planeData(dimension_size_type plane) const;
+
+        /**
+         * Get the size of a plane.
+         *
+         * @returns the size (bytes).
+         */
+        dimension_size_type
+        planeSize() const;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_IN_RAWREADER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,163 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/UnknownFormatException.h>
+#include <ome/files/in/OMETIFFReader.h>
+#include <ome/files/in/OMEXMLReader.h>
+#include <ome/files/in/OMEZarrReader.h>
+#include <ome/files/in/RawReader.h>
+#include <ome/files/in/ReaderRegistry.h>
+#include <ome/files/in/TIFFReader.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace in
+    {
+
+      const std::size_t ReaderRegistry::default_header_size;
+
+      ReaderRegistry::ReaderRegistry(std::size_t headerSize):
+        readers(),
+        headerSize(headerSize)
+      {
+        add([]() { return std::make_shared<OMETIFFReader>(); });
+        add([]() { return std::make_shared<TIFFReader>(); });
+        add([]() { return std::make_shared<OMEXMLReader>(); });
+        add([]() { return std::make_shared<OMEZarrReader>(); });
+        add([]() { return std::make_shared<RawReader>(); });
+      }
+
+      ReaderRegistry::~ReaderRegistry()
+      {
+      }
+
+      void
+      ReaderRegistry::add(const factory_type& factory)
+      {
+        Entry entry;
+        entry.factory = factory;
+        entry.detector = factory();
+        readers.push_back(entry);
+      }
+
+      std::size_t
+      ReaderRegistry::getHeaderSize() const
+      {
+        return headerSize;
+      }
+
+      std::shared_ptr<FormatReader>
+      ReaderRegistry::getReader(const boost::filesystem::path& name) const
+      {
+        // Directory datasets, such as OME-Zarr, have no header to
+        // check, so are identified by their content.
+        if (boost::filesystem::is_directory(name))
+          {
+            for (const auto& entry : readers)
+              {
+                if (entry.detector->isThisType(name, true))
+                  return entry.factory();
+              }
+
+            boost::format fmt("No reader supports directory ‘%1%’");
+            fmt % name.string();
+            throw UnknownFormatException(fmt.str());
+          }
+
+        boost::filesystem::ifstream in(name, std::ios::in | std::ios::binary);
+        if (!in)
+          {
+            boost::format fmt("Failed to open ‘%1%’");
+            fmt % name.string();
+            throw FormatException(fmt.str());
+          }
+
+        std::vector<uint8_t> header(headerSize);
+        in.read(reinterpret_cast<char *>(header.data()),
+                static_cast<std::streamsize>(header.size()));
+        if (in.bad())
+          {
+            boost::format fmt("Failed to read ‘%1%’");
+            fmt % name.string();
+            throw FormatException(fmt.str());
+          }
+        header.resize(static_cast<std::vector<uint8_t>::size_type>(in.gcount()));
+
+        return getReader(name, header.data(), header.data() + header.size());
+      }
+
+      std::shared_ptr<FormatReader>
+      ReaderRegistry::getReader(const boost::filesystem::path& name,
+                                const uint8_t                 *begin,
+                                const uint8_t                 *end) const
+      {
+        const Entry *last = nullptr;
+        for (const auto& entry : readers)
+          {
+            if (!entry.detector->isThisType(begin, end))
+              continue;
+            if (FormatHandler::checkSuffix(name,
+                                           entry.detector->getSuffixes(),
+                                           entry.detector->getCompressionSuffixes()))
+              return entry.factory();
+            last = &entry;
+          }
+        if (last)
+          return last->factory();
+
+        for (const auto& entry : readers)
+          {
+            if (entry.detector->isThisType(name, false))
+              return entry.factory();
+          }
+
+        boost::format fmt("No reader supports ‘%1%’");
+        fmt % name.string();
+        throw UnknownFormatException(fmt.str());
+      }
+
+    }
+  }
+}
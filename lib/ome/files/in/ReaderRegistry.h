@@ -0,0 +1,194 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_IN_READERREGISTRY_H
+#define OME_FILES_IN_READERREGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/FormatReader.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace in
+    {
+
+      /**
+       * Registry of readers for format detection.
+       *
+       * A reader is chosen for a file by reading its header once,
+       * and checking the same header with each registered reader
+       * using FormatReader::isThisType(const uint8_t *, const uint8_t *).
+       * Only the chosen reader opens the file, when its id is set.
+       *
+       * Readers are registered from the most to the least specific
+       * format, and are chosen as follows:
+       *
+       * - the first reader accepting the header whose suffixes
+       *   match the filename;
+       * - otherwise, the last reader accepting the header, since
+       *   the least specific format makes the fewest assumptions
+       *   about the content;
+       * - otherwise, the first reader identifying the file from its
+       *   name alone (FormatReader::isThisType() without opening),
+       *   for example OME-TIFF companion files.
+       *
+       * The headers of some formats are not conclusive.  For
+       * example, an OME-TIFF header is only distinguishable from a
+       * plain TIFF if its OME-XML is within the header, so
+       * otherwise the file suffix decides.
+       *
+       * Detection is thread-safe; the readers used for detection
+       * are not returned, and are only used for checking headers.
+       */
+      class ReaderRegistry
+      {
+      public:
+        /// Reader factory.
+        typedef std::function<std::shared_ptr<FormatReader>()> factory_type;
+
+        /// Default header size (bytes).
+        static const std::size_t default_header_size = 4096U;
+
+      private:
+        /// A registered reader.
+        struct Entry
+        {
+          /// Factory to create the reader.
+          factory_type factory;
+          /// Reader instance used for format detection.
+          std::shared_ptr<const FormatReader> detector;
+        };
+
+        /// Registered readers, most specific first.
+        std::vector<Entry> readers;
+        /// Header size.
+        std::size_t headerSize;
+
+      public:
+        /**
+         * Constructor.
+         *
+         * All the readers provided by this library are registered.
+         *
+         * @param headerSize the number of bytes to read from the
+         * start of each file.
+         */
+        explicit
+        ReaderRegistry(std::size_t headerSize = default_header_size);
+
+        /// Destructor.
+        ~ReaderRegistry();
+
+        /// @cond SKIP
+        ReaderRegistry (const ReaderRegistry&) = delete;
+
+        ReaderRegistry&
+        operator= (const ReaderRegistry&) = delete;
+        /// @endcond SKIP
+
+        /**
+         * Register a reader.
+         *
+         * The reader is less specific than all the readers already
+         * registered.
+         *
+         * @param factory the factory to create the reader.
+         */
+        void
+        add(const factory_type& factory);
+
+        /**
+         * Get the header size.
+         *
+         * @returns the number of bytes read from the start of each
+         * file.
+         */
+        std::size_t
+        getHeaderSize() const;
+
+        /**
+         * Get a reader for a file.
+         *
+         * The header of the file is read once and checked with each
+         * registered reader.  A directory has no header, and is
+         * checked by each registered reader opening it.
+         *
+         * @param name the file to check.
+         * @returns a new reader for the file; its id is not set.
+         * @throws FormatException if the file could not be read, or
+         * UnknownFormatException if no reader supports the file.
+         */
+        std::shared_ptr<FormatReader>
+        getReader(const boost::filesystem::path& name) const;
+
+        /**
+         * Get a reader for a file from its header.
+         *
+         * @param name the file name, used for suffix matching only.
+         * @param begin the start of the header.
+         * @param end one past the end of the header.
+         * @returns a new reader for the file; its id is not set.
+         * @throws UnknownFormatException if no reader supports the
+         * file.
+         */
+        std::shared_ptr<FormatReader>
+        getReader(const boost::filesystem::path& name,
+                  const uint8_t                 *begin,
+                  const uint8_t                 *end) const;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_IN_READERREGISTRY_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
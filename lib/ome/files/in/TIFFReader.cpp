@@ -35,10 +35,15 @@
  * #L%
  */
 
+#include <boost/endian/conversion.hpp>
+#include <boost/format.hpp>
 #include <boost/range/size.hpp>
 
 #include <ome/files/FormatException.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/detail/ByteSwap.h>
 #include <ome/files/in/TIFFReader.h>
+#include <ome/files/tiff/ByteSource.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/TIFF.h>
 #include <ome/files/tiff/Tags.h>
@@ -48,6 +53,8 @@
 using ome::files::detail::ReaderProperties;
 using ome::files::tiff::TIFF;
 using ome::files::tiff::IFD;
+using ome::files::PixelBufferBase;
+using ome::files::PixelRow;
 
 namespace ome
 {
@@ -71,14 +78,24 @@ namespace ome
           return p;
         }
 
-        const ReaderProperties props(tiff_properties());
+        // Built on first use rather than during static
+        // initialisation, so that loading the library does no work
+        // and there is no dependency on the initialisation order of
+        // other translation units.  The property tables of the other
+        // readers and writers are built in the same way.
+        const ReaderProperties&
+        props()
+        {
+          static const ReaderProperties p(tiff_properties());
+          return p;
+        }
 
         const std::vector<boost::filesystem::path> companion_suffixes = {"txt", "xml"};
 
       }
 
       TIFFReader::TIFFReader():
-        MinimalTIFFReader(props)
+        MinimalTIFFReader(props())
       {
       }
 
@@ -97,10 +114,17 @@ namespace ome
       TIFFReader::close(bool fileOnly)
       {
         ijmeta = boost::none;
+        ijraw = boost::none;
 
         MinimalTIFFReader::close(fileOnly);
       }
 
+      bool
+      TIFFReader::isMemoizable() const
+      {
+        return !ijraw && MinimalTIFFReader::isMemoizable();
+      }
+
       void
       TIFFReader::readIFDs()
       {
@@ -114,13 +138,20 @@ namespace ome
               {
                 tiff::ImageJMetadata ijmeta(*ifd0);
 
-                std::shared_ptr<CoreMetadata> ijm(tiff::makeCoreMetadata(*ifd0));
+                // The ImageJ metadata fields are optional, so
+                // require the ImageJ key in their absence.
+                if (ijmeta.counts.empty() &&
+                    ijmeta.map.find("ImageJ") == ijmeta.map.end())
+                  throw FormatException("Not an ImageJ TIFF");
+
+                std::shared_ptr<CoreMetadata> ijm(tiff::makeCoreMetadata(*ifd0, !isOriginalMetadataLazy()));
 
                 ijm->sizeZ = ijmeta.slices;
                 ijm->sizeT = ijmeta.frames;
                 ijm->sizeC.clear();
                 for (dimension_size_type c = 0; c < ijmeta.channels; ++c)
                   ijm->sizeC.push_back(1U);
+                ijm->imageCount = ijmeta.images;
 
                 core.clear();
                 core.push_back(ijm);
@@ -136,9 +167,10 @@ namespace ome
 
                         std::string desc;
                         (*i)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(desc);
-                        std::map<std::string,std::string> imap(tiff::ImageJMetadata::parse_imagedescription(desc));
 
-                        if (imap != ijmeta.map)
+                        // Identical descriptions need not be parsed.
+                        if (desc != ijmeta.description &&
+                            tiff::ImageJMetadata::parse_imagedescription(desc) != ijmeta.map)
                           {
                             std::cerr << "ImageJ TIFF metadata is inconsistent; treating as a plain TIFF";
                             imagej_metadata = false;
@@ -147,21 +179,39 @@ namespace ome
                       }
                   }
 
-                if (images != ijmeta.images)
+                // A single IFD may be followed by the remaining
+                // planes stored contiguously.
+                if (imagej_metadata && images != ijmeta.images &&
+                    !(images == 1U && readRawLayout(*ifd0, *ijm, ijmeta.images)))
                   {
                     std::cerr << "ImageJ TIFF metadata is inconsistent with TIFF image count; treating as a plain TIFF";
                     imagej_metadata = false;
                   }
+
+                if (imagej_metadata)
+                  {
+                    tiff::IFDRange range;
+                    range.filename = *currentId;
+                    range.begin = 0U;
+                    range.end = images;
+
+                    seriesIFDRange.clear();
+                    seriesIFDRange.push_back(range);
+
+                    this->ijmeta = ijmeta;
+                  }
               }
             catch (const std::exception& e)
               {
                 // Catch all TIFF exceptions and parse failures.
                 imagej_metadata = false;
-                core.clear();
               }
 
-            if (imagej_metadata)
-              this->ijmeta = ijmeta;
+            if (!imagej_metadata)
+              {
+                core.clear();
+                ijraw = boost::none;
+              }
           }
 
         // If a plain TIFF, read metadata from IFDs.
@@ -169,6 +219,284 @@ namespace ome
           MinimalTIFFReader::readIFDs();
       }
 
+      bool
+      TIFFReader::readRawLayout(const tiff::IFD&    ifd,
+                                const CoreMetadata& coremeta,
+                                dimension_size_type images)
+      {
+        // Uncompressed strips of whole bytes, without separate
+        // sample planes, and read without conversion.
+        if (ifd.getTileType() != tiff::STRIP ||
+            ifd.getCompression() != tiff::COMPRESSION_NONE ||
+            ifd.getPixelType() == ::ome::xml::model::enums::PixelType::BIT ||
+            ifd.getBitsPerSample() != bitsPerPixel(ifd.getPixelType()) ||
+            (ifd.getSamplesPerPixel() > 1U &&
+             ifd.getPlanarConfiguration() != tiff::CONTIG) ||
+            (isIndexedExpanded() && ifd.isExpandable()))
+          return false;
+
+        std::vector<uint64_t> offsets;
+        std::vector<uint64_t> sizes;
+        ifd.getField(tiff::STRIPOFFSETS).get(offsets);
+        ifd.getField(tiff::STRIPBYTECOUNTS).get(sizes);
+        if (offsets.empty() || offsets.size() != sizes.size())
+          return false;
+
+        const dimension_size_type planesize = (static_cast<dimension_size_type>(ifd.getImageWidth()) *
+                                               static_cast<dimension_size_type>(ifd.getImageHeight()) *
+                                               ifd.getSamplesPerPixel() *
+                                               bytesPerPixel(ifd.getPixelType()));
+
+        // The strips must be contiguous and contain the whole plane.
+        RawLayout layout;
+        layout.offset = offsets.front();
+        layout.planesize = planesize;
+        layout.planes = images;
+        dimension_size_type end = layout.offset;
+        for (std::vector<uint64_t>::size_type i = 0; i < offsets.size(); ++i)
+          {
+            if (offsets[i] != end)
+              return false;
+            layout.strips.push_back(offsets[i] - layout.offset);
+            layout.stripsizes.push_back(sizes[i]);
+            end += sizes[i];
+          }
+        if (end - layout.offset != planesize)
+          return false;
+
+        layout.source = std::make_shared<tiff::FileByteSource>(*currentId);
+        if (layout.source->size() < layout.offset + (planesize * images))
+          return false;
+
+        layout.swap = (coremeta.littleEndian != (boost::endian::order::native == boost::endian::order::little));
+
+        ijraw = layout;
+        return true;
+      }
+
+      tiff::offset_type
+      TIFFReader::rawPlaneOffset(dimension_size_type plane) const
+      {
+        if (plane >= ijraw->planes)
+          {
+            boost::format fmt("Invalid plane number ‘%1%’");
+            fmt % plane;
+            throw FormatException(fmt.str());
+          }
+
+        return ijraw->offset + (plane * ijraw->planesize);
+      }
+
+      namespace
+      {
+
+        // Read rows of a raw plane directly into the buffer.
+        struct RawPlaneVisitor
+        {
+          const tiff::ByteSource& source;
+          tiff::offset_type       offset;
+          dimension_size_type     sizeX;
+          const PlaneRegion&      region;
+          dimension_size_type     samples;
+          bool                    swap;
+
+          RawPlaneVisitor(const tiff::ByteSource& source,
+                          tiff::offset_type       offset,
+                          dimension_size_type     sizeX,
+                          const PlaneRegion&      region,
+                          dimension_size_type     samples,
+                          bool                    swap):
+            source(source),
+            offset(offset),
+            sizeX(sizeX),
+            region(region),
+            samples(samples),
+            swap(swap)
+          {}
+
+          template<typename T>
+          void
+          operator()(T& v)
+          {
+            typedef typename T::element_type::value_type value_type;
+
+            const dimension_size_type rowsize = region.w * samples * sizeof(value_type);
+            const dimension_size_type stride = sizeX * samples * sizeof(value_type);
+            const tiff::offset_type start = offset + (region.y * stride) +
+              (region.x * samples * sizeof(value_type));
+
+            PixelRow<value_type> first(v->row(0));
+            if (region.x == 0U && region.w == sizeX &&
+                first.contiguous(samples) &&
+                static_cast<dimension_size_type>(first.ystride) == region.w * samples)
+              {
+                // Whole rows are contiguous in the file and buffer.
+                source.read(start, first.data, rowsize * region.h);
+              }
+            else
+              {
+                for (dimension_size_type y = 0; y < region.h; ++y)
+                  {
+                    PixelRow<value_type> row(v->row(static_cast<PixelBufferBase::index>(y)));
+                    if (!row.contiguous(samples))
+                      throw FormatException("Raw plane buffer samples are not contiguous");
+                    source.read(start + (y * stride), row.data, rowsize);
+                  }
+              }
+
+            if (swap)
+              detail::byteswap(v->data(), v->num_elements());
+          }
+        };
+
+      }
+
+      void
+      TIFFReader::readRawPlane(dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               const PlaneRegion&  region) const
+      {
+        const tiff::offset_type offset = rawPlaneOffset(plane);
+        const dimension_size_type samples = getRGBChannelCount(0U);
+
+        preparePlane(buf, region.w, region.h, samples);
+
+        RawPlaneVisitor v(*ijraw->source, offset, getSizeX(), region, samples, ijraw->swap);
+        ome::compat::visit(v, buf.vbuffer());
+      }
+
+      void
+      TIFFReader::getLookupTable(dimension_size_type plane,
+                                 VariantPixelBuffer& buf) const
+      {
+        // All raw planes share the lookup table of the first IFD.
+        MinimalTIFFReader::getLookupTable(ijraw ? 0U : plane, buf);
+      }
+
+      void
+      TIFFReader::openRawTile(dimension_size_type   plane,
+                              dimension_size_type   tile,
+                              std::vector<uint8_t>& buf) const
+      {
+        if (!ijraw)
+          {
+            MinimalTIFFReader::openRawTile(plane, tile, buf);
+            return;
+          }
+
+        assertId(currentId, true);
+
+        const tiff::offset_type offset = rawPlaneOffset(plane);
+
+        setPlane(plane);
+
+        if (tile >= ijraw->strips.size())
+          {
+            boost::format fmt("Invalid tile index %1%: plane contains %2% tiles");
+            fmt % tile % ijraw->strips.size();
+            throw FormatException(fmt.str());
+          }
+
+        // Uncompressed, so the raw strip is the pixel data.
+        buf.resize(static_cast<std::vector<uint8_t>::size_type>(ijraw->stripsizes[tile]));
+        if (!buf.empty())
+          ijraw->source->read(offset + ijraw->strips[tile], buf.data(), buf.size());
+      }
+
+      bool
+      TIFFReader::isNormalizedOnRead() const
+      {
+        // Raw ImageJ planes are not read with IFD::readImage().
+        return !ijraw && MinimalTIFFReader::isNormalizedOnRead();
+      }
+
+      void
+      TIFFReader::openBytesImpl(dimension_size_type plane,
+                                VariantPixelBuffer& buf,
+                                dimension_size_type x,
+                                dimension_size_type y,
+                                dimension_size_type w,
+                                dimension_size_type h) const
+      {
+        if (!ijraw)
+          {
+            MinimalTIFFReader::openBytesImpl(plane, buf, x, y, w, h);
+            return;
+          }
+
+        assertId(currentId, true);
+
+        readRawPlane(plane, buf, PlaneRegion(x, y, w, h));
+      }
+
+      void
+      TIFFReader::openBytesBatchImpl(dimension_size_type              plane,
+                                     const std::vector<PlaneRegion>&  regions,
+                                     std::vector<VariantPixelBuffer>& bufs) const
+      {
+        if (ijraw)
+          ::ome::files::detail::FormatReader::openBytesBatchImpl(plane, regions, bufs);
+        else
+          MinimalTIFFReader::openBytesBatchImpl(plane, regions, bufs);
+      }
+
+      void
+      TIFFReader::openBytesDecimatedImpl(dimension_size_type plane,
+                                         VariantPixelBuffer& buf,
+                                         const PlaneRegion&  region,
+                                         dimension_size_type xstep,
+                                         dimension_size_type ystep) const
+      {
+        if (ijraw)
+          ::ome::files::detail::FormatReader::openBytesDecimatedImpl(plane, buf, region, xstep, ystep);
+        else
+          MinimalTIFFReader::openBytesDecimatedImpl(plane, buf, region, xstep, ystep);
+      }
+
+      void
+      TIFFReader::openBytesAtImpl(dimension_size_type series,
+                                  dimension_size_type resolution,
+                                  dimension_size_type plane,
+                                  VariantPixelBuffer& buf,
+                                  const PlaneRegion&  region) const
+      {
+        if (!ijraw)
+          {
+            MinimalTIFFReader::openBytesAtImpl(series, resolution, plane, buf, region);
+            return;
+          }
+
+        assertId(currentId, true);
+
+        // There is a single series and resolution, so the current
+        // series is not used to read the plane.
+        readRawPlane(plane, buf, region);
+      }
+
+      void
+      TIFFReader::openBytesIntoImpl(dimension_size_type     series,
+                                    dimension_size_type     resolution,
+                                    dimension_size_type     plane,
+                                    VariantPixelBufferView& buf,
+                                    const PlaneRegion&      region) const
+      {
+        // Raw ImageJ planes are read with openBytesAtImpl() and copied.
+        if (ijraw)
+          ::ome::files::detail::FormatReader::openBytesIntoImpl(series, resolution, plane, buf, region);
+        else
+          MinimalTIFFReader::openBytesIntoImpl(series, resolution, plane, buf, region);
+      }
+
+      void
+      TIFFReader::forEachTileImpl(dimension_size_type  plane,
+                                  const tile_callback& callback) const
+      {
+        if (ijraw)
+          ::ome::files::detail::FormatReader::forEachTileImpl(plane, callback);
+        else
+          MinimalTIFFReader::forEachTileImpl(plane, callback);
+      }
+
     }
   }
 }
@@ -38,18 +38,34 @@
 #ifndef OME_FILES_IN_TIFFREADER_H
 #define OME_FILES_IN_TIFFREADER_H
 
+#include <memory>
+#include <vector>
+
 #include <ome/files/in/MinimalTIFFReader.h>
 #include <ome/files/tiff/ImageJMetadata.h>
+#include <ome/files/tiff/Types.h>
 
 namespace ome
 {
   namespace files
   {
+    namespace tiff
+    {
+      class ByteSource;
+    }
+
     namespace in
     {
 
       /**
        * TIFF reader with support for ImageJ extensions.
+       *
+       * ImageJ files larger than 4 GiB, and some smaller files,
+       * contain a single IFD describing the first plane, with the
+       * remaining planes stored contiguously and uncompressed after
+       * it.  These planes are read directly at their computed
+       * offsets, so that all planes are reachable and any plane may
+       * be read without reference to the others.
        */
       class TIFFReader : public MinimalTIFFReader
       {
@@ -57,6 +73,28 @@ namespace ome
         /// ImageJ metadata.
         boost::optional<tiff::ImageJMetadata> ijmeta;
 
+        /// Raw plane layout of ImageJ files with a single IFD.
+        struct RawLayout
+        {
+          /// Source to read the planes from.
+          std::shared_ptr<tiff::ByteSource> source;
+          /// Offset of the first plane.
+          tiff::offset_type offset;
+          /// Size of each plane (bytes).
+          dimension_size_type planesize;
+          /// Number of planes.
+          dimension_size_type planes;
+          /// Strip offsets relative to the start of each plane.
+          std::vector<uint64_t> strips;
+          /// Strip sizes (bytes).
+          std::vector<uint64_t> stripsizes;
+          /// Byteswap the pixel data to native endianness.
+          bool swap;
+        };
+
+        /// Raw plane layout, if all planes are read directly.
+        boost::optional<RawLayout> ijraw;
+
       public:
         /// Constructor.
         TIFFReader();
@@ -70,10 +108,126 @@ namespace ome
         void
         readIFDs();
 
+        /**
+         * Check for an ImageJ raw plane layout.
+         *
+         * The first IFD must be uncompressed and contain the
+         * whole of the first plane in contiguous strips, and the
+         * file must be large enough to contain all of the planes
+         * following it.  If so, @c ijraw is set.
+         *
+         * @param ifd the first IFD.
+         * @param coremeta the core metadata for the image.
+         * @param images the total number of planes.
+         * @returns @c true if the planes may be read directly, @c
+         * false otherwise.
+         */
+        bool
+        readRawLayout(const tiff::IFD&    ifd,
+                      const CoreMetadata& coremeta,
+                      dimension_size_type images);
+
+        /**
+         * Get the file offset of a raw plane.
+         *
+         * @param plane the plane index.
+         * @returns the offset of the start of the plane.
+         * @throws FormatException if the plane is out of range.
+         */
+        tiff::offset_type
+        rawPlaneOffset(dimension_size_type plane) const;
+
+        /**
+         * Read a region of a raw plane.
+         *
+         * Each run of whole rows is read with a single positional
+         * read, directly into the destination buffer.
+         *
+         * @param plane the plane index.
+         * @param buf the destination pixel buffer.
+         * @param region the region to read.
+         */
+        void
+        readRawPlane(dimension_size_type plane,
+                     VariantPixelBuffer& buf,
+                     const PlaneRegion&  region) const;
+
       public:
         // Documented in superclass.
         void
         close(bool fileOnly = false);
+
+        /**
+         * Check if the reader state may be saved in a memo.
+         *
+         * ImageJ files read with a raw plane layout are not
+         * memoizable, since the layout is not saved.
+         *
+         * @returns @c true if saveMemo() is supported, @c false
+         * otherwise.
+         */
+        bool
+        isMemoizable() const;
+
+        // Documented in superclass.
+        void
+        getLookupTable(dimension_size_type plane,
+                       VariantPixelBuffer& buf) const;
+
+        // Documented in superclass.
+        void
+        openRawTile(dimension_size_type   plane,
+                    dimension_size_type   tile,
+                    std::vector<uint8_t>& buf) const;
+
+      protected:
+        // Documented in superclass.
+        bool
+        isNormalizedOnRead() const;
+
+        // Documented in superclass.
+        void
+        openBytesImpl(dimension_size_type plane,
+                      VariantPixelBuffer& buf,
+                      dimension_size_type x,
+                      dimension_size_type y,
+                      dimension_size_type w,
+                      dimension_size_type h) const;
+
+        // Documented in superclass.
+        void
+        openBytesBatchImpl(dimension_size_type              plane,
+                           const std::vector<PlaneRegion>&  regions,
+                           std::vector<VariantPixelBuffer>& bufs) const;
+
+        // Documented in superclass.
+        void
+        openBytesDecimatedImpl(dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               const PlaneRegion&  region,
+                               dimension_size_type xstep,
+                               dimension_size_type ystep) const;
+
+        // Documented in superclass.
+        void
+        openBytesAtImpl(dimension_size_type series,
+                        dimension_size_type resolution,
+                        dimension_size_type plane,
+                        VariantPixelBuffer& buf,
+                        const PlaneRegion&  region) const;
+
+        // Documented in superclass.
+        void
+        openBytesIntoImpl(dimension_size_type     series,
+                          dimension_size_type     resolution,
+                          dimension_size_type     plane,
+                          VariantPixelBufferView& buf,
+                          const PlaneRegion&      region) const;
+
+        // Documented in superclass.
+        void
+        forEachTileImpl(dimension_size_type  plane,
+                        const tile_callback& callback) const;
       };
 
     }
@@ -38,6 +38,8 @@
 
 #include <ome/files/config-internal.h>
 
+#include <mutex>
+
 #define OME_COMMON_MODULE_INTROSPECTION 1
 #include <ome/common/module.h>
 #include <ome/xml/module.h>
@@ -85,16 +87,6 @@ namespace
        module_path);
   }
 
-  struct AutoRegister
-  {
-    AutoRegister()
-    {
-      register_paths();
-    }
-  };
-
-  AutoRegister path_register;
-
 }
 
 namespace ome
@@ -105,9 +97,14 @@ namespace ome
     void
     register_module_paths()
     {
-      ome::common::register_module_paths();
-      ome::xml::register_module_paths();
-      register_paths();
+      // Registered on first call rather than by a static object, so
+      // that loading the library does not resolve any paths.
+      static std::once_flag registered;
+      std::call_once(registered, []() {
+          ome::common::register_module_paths();
+          ome::xml::register_module_paths();
+          register_paths();
+        });
     }
 
   }
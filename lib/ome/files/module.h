@@ -49,16 +49,11 @@ namespace ome
     /**
      * Register the OME-Files module paths with OME-Common.
      *
-     * This function forces path registration.
-     *
-     * @note This is a hack to allow static linking to work on
-     * Windows; without this, the module object is omitted and the
-     * paths aren't automatically registered.  This will no longer be
-     * required once it is built as a DLL.  Its only purpose is to
-     * force object inclusion when static linking, and ensure that the
-     * registration happens independently of object static
-     * construction order to allow use prior to main() entry.  You
-     * should not use this.
+     * Paths are not registered when the library is loaded; they
+     * are registered by the first call to this function, and later
+     * calls do nothing.  This is thread-safe.  Call it before using
+     * @c ome::common::module_runtime_path() to look up any of the
+     * OME-Files module paths.
      */
     void
     register_module_paths();
@@ -43,6 +43,7 @@
 #include <ome/files/FormatException.h>
 #include <ome/files/FormatTools.h>
 #include <ome/files/MetadataTools.h>
+#include <ome/files/PixelStatistics.h>
 #include <ome/files/out/MinimalTIFFWriter.h>
 #include <ome/files/tiff/Codec.h>
 #include <ome/files/tiff/IFD.h>
@@ -93,18 +94,34 @@ namespace ome
           return p;
         }
 
-        const WriterProperties props(tiff_properties());
+        // Built on first use rather than during static
+        // initialisation, since the codec list is queried.
+        const WriterProperties&
+        props()
+        {
+          static const WriterProperties p(tiff_properties());
+          return p;
+        }
 
       }
 
       MinimalTIFFWriter::MinimalTIFFWriter():
-        ::ome::files::detail::FormatWriter(props),
+        ::ome::files::detail::FormatWriter(props()),
         logger(ome::common::createLogger("MinimalTIFFWriter")),
         tiff(),
         ifd(),
         ifdIndex(0),
         seriesIFDRange(),
-        bigTIFF(boost::none)
+        bigTIFF(boost::none),
+        writeCacheLimit(0U),
+        streamingWrites(0U),
+        sparseTiles(false),
+        tileDeduplication(0U),
+        statistics(),
+        tileSummaries(false),
+        tilingPolicy(tiff::TILING_DEFAULT),
+        tilingChunkSize(0U),
+        codecParameters()
       {
       }
 
@@ -115,7 +132,16 @@ namespace ome
         ifd(),
         ifdIndex(0),
         seriesIFDRange(),
-        bigTIFF(boost::none)
+        bigTIFF(boost::none),
+        writeCacheLimit(0U),
+        streamingWrites(0U),
+        sparseTiles(false),
+        tileDeduplication(0U),
+        statistics(),
+        tileSummaries(false),
+        tilingPolicy(tiff::TILING_DEFAULT),
+        tilingChunkSize(0U),
+        codecParameters()
       {
       }
 
@@ -145,7 +171,13 @@ namespace ome
           flags += '8';
 
 
-        tiff = TIFF::open(id, flags);
+        tiff = TIFF::open(id, flags, ioStatistics);
+        tiff->setWriteCacheLimit(writeCacheLimit);
+        tiff->setStreamingWrites(streamingWrites);
+        tiff->setSparseTiles(sparseTiles);
+        tiff->setTileDeduplication(tileDeduplication);
+        tiff->setStatistics(statistics);
+        tiff->setTileSummaries(tileSummaries);
         ifd = tiff->getCurrentDirectory();
         setupIFD();
 
@@ -249,7 +281,11 @@ namespace ome
       void
       MinimalTIFFWriter::nextIFD() const
       {
+        if (statistics)
+          tiff::setSampleValueRange(*ifd, *statistics);
         tiff->writeCurrentDirectory();
+        if (statistics)
+          statistics->reset();
         ifd = tiff->getCurrentDirectory();
         ++ifdIndex;
       }
@@ -260,10 +296,11 @@ namespace ome
         ifd->setImageWidth(getSizeX());
         ifd->setImageHeight(getSizeY());
 
-        // Default strip or tile size.  We base this upon a default
-        // chunk size of 64KiB for greyscale images, which will
-        // increase to 192KiB for 3 sample RGB images.  We use strips
-        // up to a width of 2048 after which tiles are used.
+        // Explicit strip or tile size, or else the default geometry
+        // for the tiling policy.  The default policy uses a chunk
+        // size of 64KiB for greyscale images, which will increase to
+        // 192KiB for 3 sample RGB images, and uses strips up to a
+        // width of 2048 after which tiles are used.
         if(getSizeX() == 0)
           {
             throw FormatException("Can't set strip or tile size: SizeX is 0");
@@ -304,23 +341,22 @@ namespace ome
                 ifd->setTileHeight(1U);
               }
           }
-        else if(getSizeX() < 2048)
-          {
-            // Default to strips, mainly for compatibility with
-            // readers which don't support tiles.
-            ifd->setTileType(tiff::STRIP);
-            ifd->setTileWidth(getSizeX());
-            uint32_t height = 65536U / getSizeX();
-            if (height == 0)
-              height = 1;
-            ifd->setTileHeight(height);
-          }
         else
           {
-            // Default to tiles.
-            ifd->setTileType(tiff::TILE);
-            ifd->setTileWidth(256U);
-            ifd->setTileHeight(256U);
+            // Default geometry from the tiling policy.
+            const boost::optional<bool> interleaved(getInterleaved());
+            const dimension_size_type samples =
+              (interleaved && *interleaved) ? getRGBChannelCount(getZCTCoords(getPlane())[1]) : 1U;
+            const boost::optional<std::string> compression(getCompression());
+            const tiff::TileGeometry geometry
+              (tiff::defaultTileGeometry(tilingPolicy,
+                                         getSizeX(), getSizeY(),
+                                         getPixelType(), samples,
+                                         compression ? tiff::getCodecScheme(*compression) : tiff::COMPRESSION_NONE,
+                                         tilingChunkSize));
+            ifd->setTileType(geometry.type);
+            ifd->setTileWidth(static_cast<uint32_t>(geometry.width));
+            ifd->setTileHeight(static_cast<uint32_t>(geometry.height));
           }
 
         std::array<dimension_size_type, 3> coords = getZCTCoords(getPlane());
@@ -347,7 +383,10 @@ namespace ome
 
         const boost::optional<std::string> compression(getCompression());
         if(compression)
-          ifd->setCompression(tiff::getCodecScheme(*compression));
+          {
+            ifd->setCompression(tiff::getCodecScheme(*compression));
+            ifd->setCodecParameters(codecParameters);
+          }
       }
 
       void
@@ -372,9 +411,110 @@ namespace ome
             throw FormatException(fmt.str());
           }
 
+        tiff->setEncodeThreads(getWriteThreads());
+        tiff->setExecutor(executor);
+        ifd->writeImage(buf, x, y, w, h);
+      }
+
+      void
+      MinimalTIFFWriter::saveBytes(dimension_size_type  plane,
+                                   VariantPixelBuffer&& buf,
+                                   dimension_size_type  x,
+                                   dimension_size_type  y,
+                                   dimension_size_type  w,
+                                   dimension_size_type  h)
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+
+        dimension_size_type expectedIndex =
+          tiff::ifdIndex(seriesIFDRange, getSeries(), plane);
+
+        if (ifdIndex != expectedIndex)
+          {
+            boost::format fmt("IFD index mismatch: actual is %1% but %2% expected");
+            fmt % ifdIndex % expectedIndex;
+            throw FormatException(fmt.str());
+          }
+
+        tiff->setEncodeThreads(getWriteThreads());
+        tiff->setExecutor(executor);
+        ifd->writeImage(std::move(buf), x, y, w, h);
+      }
+
+      void
+      MinimalTIFFWriter::saveBytes(dimension_size_type            plane,
+                                   const VariantPixelBufferView& buf,
+                                   dimension_size_type            x,
+                                   dimension_size_type            y,
+                                   dimension_size_type            w,
+                                   dimension_size_type            h)
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+
+        dimension_size_type expectedIndex =
+          tiff::ifdIndex(seriesIFDRange, getSeries(), plane);
+
+        if (ifdIndex != expectedIndex)
+          {
+            boost::format fmt("IFD index mismatch: actual is %1% but %2% expected");
+            fmt % ifdIndex % expectedIndex;
+            throw FormatException(fmt.str());
+          }
+
+        tiff->setEncodeThreads(getWriteThreads());
+        tiff->setExecutor(executor);
         ifd->writeImage(buf, x, y, w, h);
       }
 
+      void
+      MinimalTIFFWriter::saveRawTile(dimension_size_type plane,
+                                     dimension_size_type tile,
+                                     const uint8_t       *data,
+                                     dimension_size_type size)
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+
+        dimension_size_type expectedIndex =
+          tiff::ifdIndex(seriesIFDRange, getSeries(), plane);
+
+        if (ifdIndex != expectedIndex)
+          {
+            boost::format fmt("IFD index mismatch: actual is %1% but %2% expected");
+            fmt % ifdIndex % expectedIndex;
+            throw FormatException(fmt.str());
+          }
+
+        ifd->writeRawTile(tile, data, size);
+      }
+
+      void
+      MinimalTIFFWriter::saveTile(dimension_size_type       plane,
+                                  dimension_size_type       tile,
+                                  const VariantPixelBuffer& buf)
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+
+        dimension_size_type expectedIndex =
+          tiff::ifdIndex(seriesIFDRange, getSeries(), plane);
+
+        if (ifdIndex != expectedIndex)
+          {
+            boost::format fmt("IFD index mismatch: actual is %1% but %2% expected");
+            fmt % ifdIndex % expectedIndex;
+            throw FormatException(fmt.str());
+          }
+
+        ifd->writeTile(tile, buf);
+      }
+
       void
       MinimalTIFFWriter::setBigTIFF(boost::optional<bool> big)
       {
@@ -387,6 +527,122 @@ namespace ome
         return bigTIFF;
       }
 
+      void
+      MinimalTIFFWriter::setWriteCacheLimit(dimension_size_type limit)
+      {
+        writeCacheLimit = limit;
+        if (tiff)
+          tiff->setWriteCacheLimit(limit);
+      }
+
+      dimension_size_type
+      MinimalTIFFWriter::getWriteCacheLimit() const
+      {
+        return writeCacheLimit;
+      }
+
+      void
+      MinimalTIFFWriter::setStreamingWrites(dimension_size_type window)
+      {
+        streamingWrites = window;
+        if (tiff)
+          tiff->setStreamingWrites(window);
+      }
+
+      dimension_size_type
+      MinimalTIFFWriter::getStreamingWrites() const
+      {
+        return streamingWrites;
+      }
+
+      void
+      MinimalTIFFWriter::setSparseTiles(bool sparse)
+      {
+        sparseTiles = sparse;
+        if (tiff)
+          tiff->setSparseTiles(sparse);
+      }
+
+      bool
+      MinimalTIFFWriter::getSparseTiles() const
+      {
+        return sparseTiles;
+      }
+
+      void
+      MinimalTIFFWriter::setTileDeduplication(dimension_size_type limit)
+      {
+        tileDeduplication = limit;
+        if (tiff)
+          tiff->setTileDeduplication(limit);
+      }
+
+      dimension_size_type
+      MinimalTIFFWriter::getTileDeduplication() const
+      {
+        return tileDeduplication;
+      }
+
+      void
+      MinimalTIFFWriter::setStatistics(std::shared_ptr<PixelStatistics> sink)
+      {
+        statistics = sink;
+        if (tiff)
+          tiff->setStatistics(statistics);
+      }
+
+      const std::shared_ptr<PixelStatistics>&
+      MinimalTIFFWriter::getStatistics() const
+      {
+        return statistics;
+      }
+
+      void
+      MinimalTIFFWriter::setTileSummaries(bool summaries)
+      {
+        tileSummaries = summaries;
+        if (tiff)
+          tiff->setTileSummaries(tileSummaries);
+      }
+
+      bool
+      MinimalTIFFWriter::getTileSummaries() const
+      {
+        return tileSummaries;
+      }
+
+      void
+      MinimalTIFFWriter::setTilingPolicy(tiff::TilingPolicy  policy,
+                                       dimension_size_type chunkSize)
+      {
+        tilingPolicy = policy;
+        tilingChunkSize = chunkSize;
+      }
+
+      tiff::TilingPolicy
+      MinimalTIFFWriter::getTilingPolicy() const
+      {
+        return tilingPolicy;
+      }
+
+      dimension_size_type
+      MinimalTIFFWriter::getTilingChunkSize() const
+      {
+        return tilingChunkSize;
+      }
+
+      void
+      MinimalTIFFWriter::setCodecParameters(const tiff::CodecParameters& params)
+      {
+        codecParameters = params;
+      }
+
+      const tiff::CodecParameters&
+      MinimalTIFFWriter::getCodecParameters() const
+      {
+        return codecParameters;
+      }
+
     }
   }
 }
@@ -39,6 +39,7 @@
 #define OME_FILES_OUT_MINIMALTIFFWRITER_H
 
 #include <ome/files/detail/FormatWriter.h>
+#include <ome/files/tiff/Codec.h>
 #include <ome/files/tiff/Util.h>
 
 #include <ome/common/log.h>
@@ -88,6 +89,33 @@ namespace ome
         /// Write a Big TIFF
         boost::optional<bool> bigTIFF;
 
+        /// Write tile cache limit.
+        dimension_size_type writeCacheLimit;
+
+        /// Streaming write window.
+        dimension_size_type streamingWrites;
+
+        /// Leave empty tiles out of the file.
+        bool sparseTiles;
+
+        /// Tile deduplication limit.
+        dimension_size_type tileDeduplication;
+
+        /// Pixel statistics sink.
+        std::shared_ptr<PixelStatistics> statistics;
+
+        /// Record tile summaries.
+        bool tileSummaries;
+
+        /// Default strip or tile geometry policy.
+        tiff::TilingPolicy tilingPolicy;
+
+        /// Target compressed chunk size for the tiling policy.
+        dimension_size_type tilingChunkSize;
+
+        /// Codec parameters.
+        tiff::CodecParameters codecParameters;
+
       public:
         /// Constructor.
         MinimalTIFFWriter();
@@ -149,6 +177,37 @@ namespace ome
                   dimension_size_type w,
                   dimension_size_type h);
 
+        // Documented in superclass.
+        void
+        saveBytes(dimension_size_type  plane,
+                  VariantPixelBuffer&& buf,
+                  dimension_size_type  x,
+                  dimension_size_type  y,
+                  dimension_size_type  w,
+                  dimension_size_type  h);
+
+        // Documented in superclass.
+        void
+        saveBytes(dimension_size_type            plane,
+                  const VariantPixelBufferView& buf,
+                  dimension_size_type            x,
+                  dimension_size_type            y,
+                  dimension_size_type            w,
+                  dimension_size_type            h);
+
+        // Documented in superclass.
+        void
+        saveRawTile(dimension_size_type plane,
+                    dimension_size_type tile,
+                    const uint8_t       *data,
+                    dimension_size_type size);
+
+        // Documented in superclass.
+        void
+        saveTile(dimension_size_type       plane,
+                 dimension_size_type       tile,
+                 const VariantPixelBuffer& buf);
+
         /**
          * Set use of BigTIFF support.
          *
@@ -178,6 +237,224 @@ namespace ome
          */
         boost::optional<bool>
         getBigTIFF() const;
+
+        /**
+         * Set the write tile cache limit.
+         *
+         * If set, completed tiles are written out of order when the
+         * tiles cached while writing a plane exceed this size,
+         * so that planes written in any order use bounded memory.
+         *
+         * @see ome::files::tiff::TIFF::setWriteCacheLimit()
+         *
+         * @param limit the limit in bytes, or @c 0 for no limit (the
+         * default).
+         */
+        void
+        setWriteCacheLimit(dimension_size_type limit);
+
+        /**
+         * Get the write tile cache limit.
+         *
+         * @returns the limit in bytes, or @c 0 for no limit.
+         */
+        dimension_size_type
+        getWriteCacheLimit() const;
+
+        /**
+         * Set the streaming write window.
+         *
+         * If set, the data written is released from the page cache
+         * as each window of the file is completed, so that writing
+         * files much larger than memory does not evict data cached
+         * for other processes, or stall when the dirty pages are
+         * written back.  Use this for large acquisitions which will
+         * not be read back on the same host.
+         *
+         * @see ome::files::tiff::TIFF::setStreamingWrites()
+         *
+         * @param window the window size in bytes, or @c 0 to leave
+         * written data cached (the default).
+         */
+        void
+        setStreamingWrites(dimension_size_type window);
+
+        /**
+         * Get the streaming write window.
+         *
+         * @returns the window size in bytes, or @c 0 if disabled.
+         */
+        dimension_size_type
+        getStreamingWrites() const;
+
+        /**
+         * Set whether sparse tiles are written.
+         *
+         * If enabled, tiles and strips containing only zeros are left
+         * out of the file, which greatly reduces the size of mostly
+         * empty images such as labels and masks.  Sparse tiles are
+         * read as zero by this library and by GDAL, but may not be
+         * supported by other TIFF readers.
+         *
+         * @see ome::files::tiff::TIFF::setSparseTiles()
+         *
+         * @param sparse @c true to leave out empty tiles, @c false to
+         * write every tile (the default).
+         */
+        void
+        setSparseTiles(bool sparse);
+
+        /**
+         * Check if sparse tiles are written.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getSparseTiles() const;
+
+        /**
+         * Set the tile deduplication limit.
+         *
+         * If set, tiles whose encoded data is identical to a tile
+         * already written to the file refer to the existing data
+         * rather than being written again.  The data of recently
+         * written tiles is held for comparison, up to the specified
+         * size.
+         *
+         * @see ome::files::tiff::TIFF::setTileDeduplication()
+         *
+         * @param limit the maximum size of the tile data held for
+         * comparison, in bytes, or @c 0 to disable deduplication
+         * (the default).
+         */
+        void
+        setTileDeduplication(dimension_size_type limit);
+
+        /**
+         * Get the tile deduplication limit.
+         *
+         * @returns the limit in bytes, or @c 0 if disabled.
+         */
+        dimension_size_type
+        getTileDeduplication() const;
+
+        /**
+         * Set the pixel statistics sink.
+         *
+         * When set, statistics are accumulated for the pixels of
+         * each tile as it is written by saveBytes(), without a
+         * separate pass over the pixel data.  When each plane is
+         * completed, the MINSAMPLEVALUE and MAXSAMPLEVALUE tags are
+         * set from the statistics for pixel types which permit
+         * them, and the statistics are then reset for the next
+         * plane.  The statistics for a plane are hence available
+         * until the next plane is started.
+         *
+         * @see ome::files::tiff::TIFF::setStatistics()
+         * @see ome::files::tiff::setSampleValueRange()
+         *
+         * @param sink the statistics sink, or null to disable
+         * statistics (the default).
+         */
+        void
+        setStatistics(std::shared_ptr<PixelStatistics> sink);
+
+        /**
+         * Get the pixel statistics sink.
+         *
+         * @returns the statistics sink, or null if disabled.
+         */
+        const std::shared_ptr<PixelStatistics>&
+        getStatistics() const;
+
+        /**
+         * Set whether tile summaries are recorded.
+         *
+         * When enabled, the minimum, maximum and number of nonzero
+         * values of each tile are recorded as it is written, and
+         * stored in a private tag of each IFD, so that readers may
+         * skip tiles which can not contain any value in a range
+         * (see MinimalTIFFReader::forEachTileInRange()).
+         *
+         * @see ome::files::tiff::TIFF::setTileSummaries()
+         *
+         * @param summaries @c true to record summaries, @c false to
+         * record none (the default).
+         */
+        void
+        setTileSummaries(bool summaries);
+
+        /**
+         * Get whether tile summaries are recorded.
+         *
+         * @returns @c true if summaries are recorded, @c false
+         * otherwise.
+         */
+        bool
+        getTileSummaries() const;
+
+        /**
+         * Set the default strip or tile geometry policy.
+         *
+         * The policy is used when the tile sizes have not been set
+         * explicitly with setTileSizeX() and setTileSizeY(); explicit
+         * tile sizes always take precedence.  The geometry is chosen
+         * from the image size, pixel type, samples per pixel and
+         * compression of each plane.  The default is
+         * tiff::TILING_DEFAULT.
+         *
+         * @see ome::files::tiff::defaultTileGeometry()
+         *
+         * @param policy the tiling policy.
+         * @param chunkSize the target compressed chunk size in
+         * bytes, or @c 0 for the policy default.
+         */
+        void
+        setTilingPolicy(tiff::TilingPolicy  policy,
+                        dimension_size_type chunkSize = 0U);
+
+        /**
+         * Get the default strip or tile geometry policy.
+         *
+         * @returns the tiling policy.
+         */
+        tiff::TilingPolicy
+        getTilingPolicy() const;
+
+        /**
+         * Get the target compressed chunk size.
+         *
+         * @returns the chunk size in bytes, or @c 0 for the policy
+         * default.
+         */
+        dimension_size_type
+        getTilingChunkSize() const;
+
+        /**
+         * Set the codec parameters.
+         *
+         * The parameters are applied to each IFD with the compression
+         * set with setCompression(), to set the compression level,
+         * predictor and lossy precision.  Parameters which are not
+         * applicable to the codec in use are ignored.  By default,
+         * all parameters are unset and the codec defaults are used.
+         * Set @c automaticPredictor to choose the predictor for
+         * each pixel type with tiff::defaultPredictor().
+         *
+         * @see ome::files::tiff::IFD::setCodecParameters()
+         *
+         * @param params the codec parameters.
+         */
+        void
+        setCodecParameters(const tiff::CodecParameters& params);
+
+        /**
+         * Get the codec parameters.
+         *
+         * @returns the codec parameters.
+         */
+        const tiff::CodecParameters&
+        getCodecParameters() const;
       };
 
     }
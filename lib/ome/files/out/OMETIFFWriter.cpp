@@ -35,12 +35,15 @@
  * #L%
  */
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 
 // Include first due to side effect of MPL vector limit setting which can change the default
 // and break multi_index with Boost 1.67
 #include <ome/xml/meta/Convert.h>
 
+#include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/format.hpp>
@@ -51,11 +54,20 @@
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 
+#include <ome/files/CancellationToken.h>
+#include <ome/files/DimensionIndexer.h>
+#include <ome/files/Executor.h>
 #include <ome/files/FormatException.h>
 #include <ome/files/FormatTools.h>
 #include <ome/files/MetadataTools.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PixelStatistics.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/detail/CloudLayout.h>
+#include <ome/files/detail/Trace.h>
 #include <ome/files/out/OMETIFFWriter.h>
 #include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/Exception.h>
 #include <ome/files/tiff/Field.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/Tags.h>
@@ -117,12 +129,170 @@ namespace ome
           return p;
         }
 
-        const WriterProperties props(tiff_properties());
+        const WriterProperties&
+        props()
+        {
+          static const WriterProperties p(tiff_properties());
+          return p;
+        }
 
         const std::vector<path> companion_suffixes{"companion.ome"};
 
         const std::string default_description("OME-TIFF");
 
+        // Maximum number of pending writes for each file when writing
+        // files in parallel.  Each pending write holds a copy of its
+        // pixel data.
+        const std::size_t file_queue_depth = 4U;
+
+        // Size of the pixel data held by a queued write, reserved
+        // from the global memory budget.
+        std::size_t
+        queued_size(const VariantPixelBuffer& buf)
+        {
+          return static_cast<std::size_t>(buf.num_elements() * bytesPerPixel(buf.pixelType()));
+        }
+
+        /**
+         * Replace the UUID attribute of the root element.
+         *
+         * The OME-XML documents embedded in each TIFF of a dataset
+         * differ only in the root UUID, so the serialised (and
+         * validated) document may be reused for every file once its
+         * UUID has been replaced.  Only the attributes of the root
+         * start tag are searched, so the same UUID text elsewhere in
+         * the document (e.g. in TiffData UUID elements) is never
+         * modified.
+         *
+         * @param xml the OME-XML text to modify.
+         * @param from the current root UUID.
+         * @param to the replacement root UUID.
+         * @returns @c true if replaced, or @c false if the root UUID
+         * attribute was not found, in which case @c xml is unchanged.
+         */
+        bool
+        replace_root_uuid(std::string&       xml,
+                          const std::string& from,
+                          const std::string& to)
+        {
+          // Skip the XML declaration, comments and processing
+          // instructions to find the root start tag.
+          std::string::size_type root = xml.find('<');
+          while (root != std::string::npos && root + 1 < xml.size() &&
+                 (xml[root + 1] == '?' || xml[root + 1] == '!'))
+            root = xml.find('<', root + 1);
+          if (root == std::string::npos)
+            return false;
+
+          const std::string::size_type end = xml.find('>', root);
+          const std::string attr(" UUID=\"" + from + "\"");
+          const std::string::size_type pos = xml.find(attr, root);
+          if (end == std::string::npos || pos == std::string::npos || pos > end)
+            return false;
+
+          xml.replace(pos + 7U, from.size(), to);
+          return true;
+        }
+
+        /**
+         * Get the ImageDescription of the first IFD of a TIFF file.
+         *
+         * @param tiff the TIFF to read.
+         * @param id the name of the TIFF file (for error messages).
+         * @returns the description.
+         * @throws FormatException if there is no description.
+         */
+        std::string
+        firstDescription(const TIFF&                    tiff,
+                         const boost::filesystem::path& id)
+        {
+          std::string description;
+          try
+            {
+              tiff.getDirectoryByIndex(0)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(description);
+            }
+          catch (const tiff::Exception&)
+            {
+              boost::format fmt("No TIFF ImageDescription found in %1%");
+              fmt % id;
+              throw FormatException(fmt.str());
+            }
+          return description;
+        }
+
+        /**
+         * Copy the TiffData elements of an image.
+         *
+         * Unset attributes are left unset, other than FirstZ, which is
+         * always set so that every element is created.
+         *
+         * @param src the metadata to copy from.
+         * @param dest the metadata to copy to.
+         * @param series the image index.
+         */
+        void
+        copyTiffData(const OMEXMLMetadata& src,
+                     OMEXMLMetadata&       dest,
+                     dimension_size_type   series)
+        {
+          const dimension_size_type tiffDataCount = src.getTiffDataCount(series);
+          for (dimension_size_type td = 0U; td < tiffDataCount; ++td)
+            {
+              dimension_size_type firstZ = 0U;
+              try
+                {
+                  firstZ = src.getTiffDataFirstZ(series, td);
+                }
+              catch (const std::exception&)
+                {
+                }
+              dest.setTiffDataFirstZ(firstZ, series, td);
+
+              try
+                {
+                  dest.setTiffDataFirstC(src.getTiffDataFirstC(series, td), series, td);
+                }
+              catch (const std::exception&)
+                {
+                }
+              try
+                {
+                  dest.setTiffDataFirstT(src.getTiffDataFirstT(series, td), series, td);
+                }
+              catch (const std::exception&)
+                {
+                }
+              try
+                {
+                  dest.setTiffDataIFD(src.getTiffDataIFD(series, td), series, td);
+                }
+              catch (const std::exception&)
+                {
+                }
+              try
+                {
+                  dest.setTiffDataPlaneCount(src.getTiffDataPlaneCount(series, td), series, td);
+                }
+              catch (const std::exception&)
+                {
+                }
+              try
+                {
+                  dest.setUUIDValue(src.getUUIDValue(series, td), series, td);
+                }
+              catch (const std::exception&)
+                {
+                }
+              try
+                {
+                  dest.setUUIDFileName(src.getUUIDFileName(series, td), series, td);
+                }
+              catch (const std::exception&)
+                {
+                }
+            }
+        }
+
         /**
          * @todo Move these stream helpers to a proper location,
          * i.e. to replicate the equivalent Java helpers.
@@ -408,7 +578,11 @@ namespace ome
       OMETIFFWriter::TIFFState::TIFFState(std::shared_ptr<ome::files::tiff::TIFF>& tiff):
         uuid(boost::uuids::to_string(boost::uuids::random_generator()())),
         tiff(tiff),
-        ifdCount(0U)
+        ifdCount(0U),
+        ifdReady(false),
+        queue(),
+        staging(false),
+        plane(0U)
       {
       }
 
@@ -416,17 +590,62 @@ namespace ome
       {
       }
 
+      OMETIFFWriter::PlaneLayout::PlaneLayout():
+        offsets(),
+        pixeltype(PixelType::UINT8),
+        planarconfig(tiff::CONTIG),
+        width(0U),
+        height(0U),
+        tileWidth(0U),
+        tileHeight(0U),
+        samples(0U)
+      {
+      }
+
       OMETIFFWriter::OMETIFFWriter():
-        ome::files::detail::FormatWriter(props),
+        ome::files::detail::FormatWriter(props()),
         logger(ome::common::createLogger("OMETIFFWriter")),
         files(),
         tiffs(),
         currentTIFF(tiffs.end()),
+        canonicalIds(),
+        fileHandles(),
         flags(),
         seriesState(),
+        planeFiles(),
         originalMetadataRetrieve(),
         omeMeta(),
-        bigTIFF(boost::none)
+        omeMetaShared(false),
+        bigTIFF(boost::none),
+        writeCacheLimit(0U),
+        streamingWrites(0U),
+        sparseTiles(false),
+        tileDeduplication(0U),
+        statistics(),
+        tileSummaries(false),
+        reserveOMEXML(false),
+        subResolutions(0U),
+        downsampling(tiff::DOWNSAMPLE_MEAN),
+        tilingPolicy(tiff::TILING_DEFAULT),
+        tilingChunkSize(0U),
+        codecParameters(),
+        omexmlValidation(OMEXML_VALIDATE_ALL),
+        parallelFiles(false),
+        parallelSeries(false),
+        seriesFiles(),
+        writeQueue(),
+        preallocate(false),
+        layout(),
+        layoutFile(),
+        compactDirectories(false),
+        cloudOptimized(false),
+        companionFile(),
+        companionUUID(),
+        append(false),
+        packedSamples(false),
+        halfFloat(false),
+        shareMetadata(false),
+        ifdParameters()
       {
       }
 
@@ -444,14 +663,20 @@ namespace ome
       void
       OMETIFFWriter::setId(const boost::filesystem::path& id)
       {
-        // Attempt to canonicalize the path.
+        // Attempt to canonicalize the path, unless already known.
         path canonicalpath = id;
-        try
-          {
-            canonicalpath = ome::common::canonical(id);
-          }
-        catch (const std::exception&)
+        std::map<path, path>::const_iterator known = canonicalIds.find(id);
+        if (known != canonicalIds.end())
+          canonicalpath = known->second;
+        else
           {
+            try
+              {
+                canonicalpath = ome::common::canonical(id);
+              }
+            catch (const std::exception&)
+              {
+              }
           }
 
         if (currentId && *currentId == canonicalpath)
@@ -461,17 +686,23 @@ namespace ome
           {
             baseDir = (canonicalpath.parent_path());
 
-            // Create OME-XML metadata.
+            // Create OME-XML metadata.  OME-XML metadata are used
+            // directly, and only copied when first modified.
             originalMetadataRetrieve = metadataRetrieve;
-            omeMeta = std::make_shared<OMEXMLMetadata>();
-            convert(*metadataRetrieve, *omeMeta);
+            omeMeta = std::dynamic_pointer_cast<OMEXMLMetadata>(metadataRetrieve);
+            omeMetaShared = omeMeta && !shareMetadata;
+            if (!omeMeta)
+              {
+                omeMeta = std::make_shared<OMEXMLMetadata>();
+                convert(*metadataRetrieve, *omeMeta);
+              }
             omeMeta->resolveReferences();
             metadataRetrieve = omeMeta;
 
             // Try to fix up OME-XML metadata if inconsistent.
             if (!validateModel(*omeMeta, false))
               {
-                validateModel(*omeMeta, true);
+                validateModel(writableMetadata(), true);
                 if (validateModel(*omeMeta, false))
                   {
                     BOOST_LOG_SEV(logger, ome::logging::trivial::warning)
@@ -521,25 +752,108 @@ namespace ome
         tiff_map::iterator i = tiffs.find(canonicalpath);
         if (i == tiffs.end())
           {
+            if (parallelFiles && statistics)
+              throw std::logic_error("Pixel statistics are not supported when writing files in parallel");
+            if (parallelSeries)
+              {
+                if (!tiffs.empty())
+                  throw FormatException("Series written in parallel must be written to a single file");
+                if (statistics || preallocate || append)
+                  throw std::logic_error("Pixel statistics, preallocated layouts and appending are not supported when writing series in parallel");
+              }
+            if ((packedSamples || halfFloat) && subResolutions)
+              throw std::logic_error("Sub-resolutions are not supported with packed or half precision samples");
+
+            if (preallocate)
+              {
+                if (!tiffs.empty())
+                  throw FormatException("A preallocated layout must be written to a single file");
+                const boost::optional<std::string> compression(getCompression());
+                if (compression && tiff::getCodecScheme(*compression) != tiff::COMPRESSION_NONE)
+                  throw std::logic_error("Compression is not supported with a preallocated layout");
+                if (statistics || tileSummaries || subResolutions || parallelFiles)
+                  throw std::logic_error("Pixel statistics, tile summaries, sub-resolutions and parallel files are not supported with a preallocated layout");
+                if (packedSamples || halfFloat)
+                  throw std::logic_error("Packed and half precision samples are not supported with a preallocated layout");
+              }
+
+            std::shared_ptr<ome::files::tiff::TIFF> tiff;
+            std::string existingUUID;
+            dimension_size_type existingIFDs = 0U;
+            if (append && boost::filesystem::exists(canonicalpath))
+              tiff = openAppend(canonicalpath, existingUUID, existingIFDs);
+            else
+              tiff = ome::files::tiff::TIFF::open(canonicalpath, flags, ioStatistics);
             detail::FormatWriter::setId(canonicalpath);
-            std::shared_ptr<ome::files::tiff::TIFF> tiff(ome::files::tiff::TIFF::open(canonicalpath, flags));
-            std::pair<tiff_map::iterator,bool> result =
-              tiffs.insert(tiff_map::value_type(*currentId, TIFFState(tiff)));
-            if (result.second) // should always be true
-              currentTIFF = result.first;
+            currentTIFF = addTIFF(*currentId, tiff);
+            if (!existingUUID.empty())
+              {
+                // Keep the identity of the existing file, and add IFDs
+                // after the existing IFDs.
+                currentTIFF->second.uuid = existingUUID;
+                currentTIFF->second.ifdCount = existingIFDs;
+              }
             detail::FormatWriter::setId(id);
-            setupIFD();
+            if (preallocate)
+              {
+                preallocateLayout();
+                layoutFile = std::make_shared<detail::PositionalFile>(canonicalpath);
+              }
+            canonicalIds[id] = currentTIFF->first;
           }
         else
           {
-            detail::FormatWriter::setId(i->first);
+            setCanonicalId(i->first);
+            currentTIFF = i;
+            canonicalIds[id] = i->first;
+          }
+      }
+
+      dimension_size_type
+      OMETIFFWriter::getFileHandle(const boost::filesystem::path& id)
+      {
+        setId(id);
+
+        std::vector<tiff_map::iterator>::const_iterator handle =
+          std::find(fileHandles.begin(), fileHandles.end(), currentTIFF);
+        if (handle != fileHandles.end())
+          return static_cast<dimension_size_type>(handle - fileHandles.begin());
+
+        fileHandles.push_back(currentTIFF);
+        return fileHandles.size() - 1;
+      }
+
+      void
+      OMETIFFWriter::setCurrentFile(dimension_size_type handle,
+                                    dimension_size_type series,
+                                    dimension_size_type plane)
+      {
+        assertId(currentId, true);
+
+        if (handle >= fileHandles.size())
+          {
+            boost::format fmt("Invalid file handle %1%");
+            fmt % handle;
+            throw FormatException(fmt.str());
+          }
+
+        // With series written in parallel, the file is selected by
+        // the series.
+        tiff_map::iterator i = fileHandles[handle];
+        if (i != currentTIFF && !parallelSeries)
+          {
+            setCanonicalId(i->first);
             currentTIFF = i;
           }
+        setSeries(series);
+        setPlane(plane);
       }
 
       void
       OMETIFFWriter::close(bool fileOnly)
       {
+        OME_FILES_TRACE(trace, "ometiff", "close");
+
         try
           {
             if (currentId)
@@ -547,25 +861,79 @@ namespace ome
                 // Flush last IFD if unwritten.
                 if(currentTIFF != tiffs.end())
                   {
-                    nextIFD();
+                    // All IFDs were written up front if preallocated.
+                    if (layout.empty())
+                      {
+                        for (tiff_map::iterator i = tiffs.begin(); i != tiffs.end(); ++i)
+                          {
+                            currentTIFF = i;
+                            // Every file needs an IFD to hold the
+                            // OME-XML, but staging files are only
+                            // merged if written to.
+                            if (i->second.ifdCount == 0 && !i->second.staging)
+                              prepareIFD();
+                            nextIFD();
+                          }
+                      }
                     currentTIFF = tiffs.end();
                   }
 
+                // Complete all queued writes and stop the writer
+                // threads before the files are closed.
+                waitQueues(true);
+
+                // Concatenate the series written in parallel.
+                if (!seriesFiles.empty())
+                  mergeSeriesFiles();
+
+                if (layoutFile)
+                  {
+                    layoutFile->close();
+                    layoutFile.reset();
+                  }
+
                 // Remove any BinData and old TiffData elements.
-                removeBinData(*omeMeta);
+                removeBinData(writableMetadata());
                 removeTiffData(*omeMeta);
                 // Create UUID and TiffData elements for each series.
                 fillMetadata();
 
+                // Save the complete metadata once, if not embedded.
+                if (!companionFile.empty())
+                  saveCompanion();
+
+                // Serialise and validate the OME-XML once, and then
+                // only replace the root UUID for each following TIFF.
+                // The root UUID of the metadata is updated to match
+                // the file being written, so the model and the text
+                // never disagree.  The companion file keeps its own
+                // UUID.
+                std::string xml;
+                std::string xmluuid;
                 for (auto& tiff : tiffs)
                   {
                     // Get OME-XML for this TIFF file.
-                    std::string xml = getOMEXML(tiff.first);
+                    std::string uuid("urn:uuid:");
+                    uuid += tiff.second.uuid;
+                    if (xml.empty())
+                      xml = getOMEXML(tiff.first);
+                    else if (replace_root_uuid(xml, xmluuid, uuid))
+                      {
+                        if (companionFile.empty())
+                          omeMeta->setUUID(uuid);
+                      }
+                    else
+                      xml = getOMEXML(tiff.first, false);
+                    xmluuid = uuid;
                     // Make sure file is closed before we modify it outside libtiff.
                     tiff.second.tiff->close();
 
                     // Save OME-XML in the TIFF.
                     saveComment(tiff.first, xml);
+
+                    // Move the IFDs and OME-XML ahead of the pixel data.
+                    if (cloudOptimized)
+                      detail::applyCloudLayout(tiff.first);
                   }
               }
 
@@ -578,8 +946,16 @@ namespace ome
             currentTIFF = tiffs.end();
             flags.clear();
             seriesState.clear();
+            planeFiles.clear();
+            companionUUID.clear();
+            canonicalIds.clear();
+            fileHandles.clear();
+            ifdParameters.clear();
+            layout.clear();
+            layoutFile.reset();
             originalMetadataRetrieve.reset();
             omeMeta.reset();
+            omeMetaShared = false;
             bigTIFF = boost::none;
 
             ome::files::detail::FormatWriter::close(fileOnly);
@@ -587,6 +963,21 @@ namespace ome
         catch (const std::exception&)
           {
             currentTIFF = tiffs.end(); // Ensure we only flush the last IFD once.
+            // Stop the writer threads; the first error is already
+            // being reported.
+            try
+              {
+                waitQueues(true);
+              }
+            catch (...)
+              {
+              }
+            removeSeriesFiles();
+            canonicalIds.clear();
+            fileHandles.clear();
+            ifdParameters.clear();
+            layout.clear();
+            layoutFile.reset();
             ome::files::detail::FormatWriter::close(fileOnly);
             throw;
           }
@@ -595,14 +986,32 @@ namespace ome
       void
       OMETIFFWriter::setSeries(dimension_size_type series) const
       {
+        if (parallelSeries)
+          {
+            // Each series has its own file, so series may be set in
+            // any order, leaving the current IFD of each file to be
+            // resumed at its current plane.
+            assertId(currentId, true);
+            if (series >= getSeriesCount())
+              {
+                boost::format fmt("Invalid series: %1%");
+                fmt % series;
+                throw std::logic_error(fmt.str());
+              }
+
+            currentTIFF->second.plane = getPlane();
+            this->series = series;
+            selectSeriesFile();
+            this->plane = currentTIFF->second.plane;
+            return;
+          }
+
         const dimension_size_type currentSeries = getSeries();
         detail::FormatWriter::setSeries(series);
 
-        if (currentSeries != series)
-          {
-            nextIFD();
-            setupIFD();
-          }
+        // IFDs are only written here if not preallocated.
+        if (currentSeries != series && layout.empty())
+          nextIFD();
       }
 
       void
@@ -611,11 +1020,8 @@ namespace ome
         const dimension_size_type currentPlane = getPlane();
         detail::FormatWriter::setPlane(plane);
 
-        if (currentPlane != plane)
-          {
-            nextIFD();
-            setupIFD();
-          }
+        if (currentPlane != plane && layout.empty())
+          nextIFD();
       }
 
       dimension_size_type
@@ -626,6 +1032,14 @@ namespace ome
         if (currentId && (!this->tile_size_x ||
                           (this->tile_size_x && *this->tile_size_x)))
           {
+            // The IFDs were written up front if preallocated.
+            if (!layout.empty())
+              return getLayout(getPlane()).tileWidth;
+
+            // Queued tasks may not have set up the IFD yet.
+            prepareIFD();
+            if (currentTIFF->second.queue)
+              currentTIFF->second.queue->wait();
             std::shared_ptr<tiff::IFD> ifd (currentTIFF->second.tiff->getCurrentDirectory());
             return ifd->getTileWidth();
           }
@@ -641,6 +1055,14 @@ namespace ome
         if (currentId && (!this->tile_size_y ||
                           (this->tile_size_y && *this->tile_size_y)))
           {
+            // The IFDs were written up front if preallocated.
+            if (!layout.empty())
+              return getLayout(getPlane()).tileHeight;
+
+            // Queued tasks may not have set up the IFD yet.
+            prepareIFD();
+            if (currentTIFF->second.queue)
+              currentTIFF->second.queue->wait();
             std::shared_ptr<tiff::IFD> ifd (currentTIFF->second.tiff->getCurrentDirectory());
             return ifd->getTileWidth();
           }
@@ -648,27 +1070,222 @@ namespace ome
           return detail::FormatWriter::getTileSizeY();
       }
 
+      OMETIFFWriter::tiff_map::iterator
+      OMETIFFWriter::addTIFF(const boost::filesystem::path&           id,
+                             std::shared_ptr<ome::files::tiff::TIFF>& tiff) const
+      {
+        tiff->setWriteCacheLimit(writeCacheLimit);
+        tiff->setStreamingWrites(streamingWrites);
+        tiff->setSparseTiles(sparseTiles);
+        tiff->setTileDeduplication(tileDeduplication);
+        tiff->setCompactDirectories(compactDirectories);
+        tiff->setStatistics(statistics);
+        tiff->setTileSummaries(tileSummaries);
+        tiff->setSubResolutions(subResolutions, downsampling);
+
+        tiff_map::iterator i = tiffs.insert(tiff_map::value_type(id, TIFFState(tiff))).first;
+        if (parallelFiles || parallelSeries)
+          {
+            const dimension_size_type depth(getWriteQueueDepth());
+            i->second.queue = std::make_shared<detail::TaskQueue>(depth ? depth : file_queue_depth);
+          }
+        else if (getWriteQueueDepth() && !preallocate)
+          {
+            // Pixel data are written directly if preallocated.
+            // All files share a single writer thread, so the
+            // writes are completed in the order submitted.
+            if (!writeQueue)
+              writeQueue = std::make_shared<detail::TaskQueue>(getWriteQueueDepth());
+            i->second.queue = writeQueue;
+          }
+        return i;
+      }
+
       void
-      OMETIFFWriter::nextIFD() const
+      OMETIFFWriter::selectSeriesFile() const
       {
-        currentTIFF->second.tiff->writeCurrentDirectory();
-        ++currentTIFF->second.ifdCount;
+        const dimension_size_type series = getSeries();
+        if (series == 0U)
+          {
+            for (tiff_map::iterator i = tiffs.begin(); i != tiffs.end(); ++i)
+              if (!i->second.staging)
+                currentTIFF = i;
+            return;
+          }
+
+        std::map<dimension_size_type, tiff_map::iterator>::const_iterator found = seriesFiles.find(series);
+        if (found == seriesFiles.end())
+          {
+            path staging(*currentId);
+            staging += ".series-" + std::to_string(series) + "-%%%%-%%%%";
+            staging = boost::filesystem::unique_path(staging);
+
+            std::shared_ptr<ome::files::tiff::TIFF> tiff(ome::files::tiff::TIFF::open(staging, flags, ioStatistics));
+            tiff_map::iterator i = addTIFF(staging, tiff);
+            i->second.staging = true;
+            found = seriesFiles.insert(std::make_pair(series, i)).first;
+          }
+        currentTIFF = found->second;
       }
 
       void
-      OMETIFFWriter::setupIFD() const
+      OMETIFFWriter::mergeSeriesFiles()
+      {
+        tiff_map::iterator dataset = tiffs.begin();
+        while (dataset != tiffs.end() && dataset->second.staging)
+          ++dataset;
+        if (dataset == tiffs.end())
+          throw std::logic_error("Inconsistent writer state: no dataset file for the staged series");
+
+        // The IFDs of each staging file follow those of the dataset
+        // file and the preceding staging files.
+        std::vector<path> sources(1U, dataset->first);
+        std::map<path, dimension_size_type> firstIFD;
+        dimension_size_type ifdCount = dataset->second.ifdCount;
+        dataset->second.tiff->close();
+        for (const auto& staged : seriesFiles)
+          {
+            TIFFState& state(staged.second->second);
+            state.tiff->close();
+            if (!state.ifdCount)
+              continue;
+            sources.push_back(staged.second->first);
+            firstIFD.insert(std::make_pair(staged.second->first, ifdCount));
+            ifdCount += state.ifdCount;
+          }
+
+        path merged(dataset->first);
+        merged += ".merge-%%%%-%%%%";
+        merged = boost::filesystem::unique_path(merged);
+        try
+          {
+            detail::writeCloudLayout(sources, merged);
+            boost::filesystem::rename(merged, dataset->first);
+          }
+        catch (const std::exception&)
+          {
+            boost::system::error_code ec;
+            boost::filesystem::remove(merged, ec);
+            throw;
+          }
+        dataset->second.ifdCount = ifdCount;
+
+        const detail::OMETIFFPlane::file_index_type file(planeFiles.intern(dataset->first));
+        for (auto& state : seriesState)
+          for (auto& planeMeta : state.planes)
+            {
+              if (planeMeta.status != detail::OMETIFFPlane::PRESENT)
+                continue;
+              std::map<path, dimension_size_type>::const_iterator first = firstIFD.find(planeFiles.at(planeMeta.file));
+              if (first != firstIFD.end())
+                {
+                  planeMeta.file = file;
+                  planeMeta.ifd += first->second;
+                }
+            }
+
+        removeSeriesFiles();
+        currentTIFF = tiffs.end();
+      }
+
+      void
+      OMETIFFWriter::removeSeriesFiles()
+      {
+        for (const auto& staged : seriesFiles)
+          {
+            try
+              {
+                staged.second->second.tiff->close();
+              }
+            catch (...)
+              {
+              }
+            boost::system::error_code ec;
+            boost::filesystem::remove(staged.second->first, ec);
+            tiffs.erase(staged.second);
+          }
+        seriesFiles.clear();
+      }
+
+      void
+      OMETIFFWriter::submit(TIFFState&                          state,
+                            const detail::TaskQueue::task_type& task) const
+      {
+        if (state.queue)
+          state.queue->submit(task);
+        else
+          task();
+      }
+
+      void
+      OMETIFFWriter::waitQueues(bool stop) const
+      {
+        std::exception_ptr error;
+        for (auto& tiff : tiffs)
+          {
+            if (tiff.second.queue)
+              {
+                try
+                  {
+                    tiff.second.queue->wait();
+                  }
+                catch (...)
+                  {
+                    if (!error)
+                      error = std::current_exception();
+                  }
+                if (stop)
+                  tiff.second.queue.reset();
+              }
+          }
+        if (stop)
+          writeQueue.reset();
+        if (error)
+          std::rethrow_exception(error);
+      }
+
+      void
+      OMETIFFWriter::flush()
+      {
+        waitQueues(false);
+      }
+
+      void
+      OMETIFFWriter::nextIFD() const
       {
-        // Get current IFD.
-        std::shared_ptr<tiff::IFD> ifd (currentTIFF->second.tiff->getCurrentDirectory());
+        TIFFState& state(currentTIFF->second);
+        // Nothing was written to the current IFD.
+        if (!state.ifdReady)
+          return;
 
-        ifd->setImageWidth(getSizeX());
-        ifd->setImageHeight(getSizeY());
+        std::shared_ptr<tiff::TIFF> handle(state.tiff);
+        std::shared_ptr<PixelStatistics> stats(statistics);
+
+        submit(state, [handle, stats]()
+               {
+                 if (stats)
+                   tiff::setSampleValueRange(*handle->getCurrentDirectory(), *stats);
+                 handle->writeCurrentDirectory();
+                 if (stats)
+                   stats->reset();
+               });
+        ++state.ifdCount;
+        state.ifdReady = false;
+      }
 
-        // Default strip or tile size.  We base this upon a default
-        // chunk size of 64KiB for greyscale images, which will
-        // increase to 192KiB for 3 sample RGB images.  We use strips
-        // up to a width of 2048 after which tiles are used.
-        if(getSizeX() == 0)
+      OMETIFFWriter::IFDParameters
+      OMETIFFWriter::getIFDParameters() const
+      {
+        const dimension_size_type sizeX = getSizeX();
+        const dimension_size_type sizeY = getSizeY();
+
+        // Explicit strip or tile size, or else the default geometry
+        // for the tiling policy.  The default policy uses a chunk
+        // size of 64KiB for greyscale images, which will increase to
+        // 192KiB for 3 sample RGB images, and uses strips up to a
+        // width of 2048 after which tiles are used.
+        tiff::TileGeometry geometry;
+        if(sizeX == 0)
           {
             throw FormatException("Can't set strip or tile size: SizeX is 0");
           }
@@ -677,18 +1294,9 @@ namespace ome
             // Manually set strip size if the size is positive.  Or
             // else set strips of size 1 as a fallback for
             // compatibility with Bio-Formats.
-            if(*this->tile_size_y)
-              {
-                ifd->setTileType(tiff::STRIP);
-                ifd->setTileWidth(getSizeX());
-                ifd->setTileHeight(*this->tile_size_y);
-              }
-            else
-              {
-                ifd->setTileType(tiff::STRIP);
-                ifd->setTileWidth(getSizeX());
-                ifd->setTileHeight(1U);
-              }
+            geometry.type = tiff::STRIP;
+            geometry.width = sizeX;
+            geometry.height = *this->tile_size_y ? *this->tile_size_y : 1U;
           }
         else if(this->tile_size_x && this->tile_size_y)
           {
@@ -697,180 +1305,1110 @@ namespace ome
             // compatibility with Bio-Formats.
             if(*this->tile_size_x && *this->tile_size_y)
               {
-                ifd->setTileType(tiff::TILE);
-                ifd->setTileWidth(*this->tile_size_x);
-                ifd->setTileHeight(*this->tile_size_y);
+                geometry.type = tiff::TILE;
+                geometry.width = *this->tile_size_x;
+                geometry.height = *this->tile_size_y;
               }
             else
               {
-                ifd->setTileType(tiff::STRIP);
-                ifd->setTileWidth(getSizeX());
-                ifd->setTileHeight(1U);
+                geometry.type = tiff::STRIP;
+                geometry.width = sizeX;
+                geometry.height = 1U;
               }
           }
-        else if(getSizeX() < 2048)
-          {
-            // Default to strips, mainly for compatibility with
-            // readers which don't support tiles.
-            ifd->setTileType(tiff::STRIP);
-            ifd->setTileWidth(getSizeX());
-            uint32_t height = 65536U / getSizeX();
-            if (height == 0)
-              height = 1;
-            ifd->setTileHeight(height);
-          }
         else
           {
-            // Default to tiles.
-            ifd->setTileType(tiff::TILE);
-            ifd->setTileWidth(256U);
-            ifd->setTileHeight(256U);
+            // Default geometry from the tiling policy.
+            const boost::optional<bool> interleaved(getInterleaved());
+            const dimension_size_type samples =
+              (interleaved && *interleaved) ? getRGBChannelCount(getZCTCoords(getPlane())[1]) : 1U;
+            const boost::optional<std::string> compression(getCompression());
+            geometry = tiff::defaultTileGeometry(tilingPolicy,
+                                                 sizeX, sizeY,
+                                                 getPixelType(), samples,
+                                                 compression ? tiff::getCodecScheme(*compression) : tiff::COMPRESSION_NONE,
+                                                 tilingChunkSize);
           }
 
         std::array<dimension_size_type, 3> coords = getZCTCoords(getPlane());
 
         dimension_size_type channel = coords[1];
 
-        ifd->setPixelType(getPixelType());
-        ifd->setBitsPerSample(bitsPerPixel(getPixelType()));
-        ifd->setSamplesPerPixel(getRGBChannelCount(channel));
+        const PixelType pixeltype(getPixelType());
+        const dimension_size_type samples = getRGBChannelCount(channel);
 
         const boost::optional<bool> interleaved(getInterleaved());
-        if (interleaved && *interleaved)
-          ifd->setPlanarConfiguration(tiff::CONTIG);
-        else
-          ifd->setPlanarConfiguration(tiff::SEPARATE);
+        const tiff::PlanarConfiguration planarconfig =
+          (interleaved && *interleaved) ? tiff::CONTIG : tiff::SEPARATE;
 
         // This isn't necessarily always true; we might want to use a
         // photometric interpretation other than RGB with three
         // subchannels.
-        if (isRGB(channel) && getRGBChannelCount(channel) == 3)
-          ifd->setPhotometricInterpretation(tiff::RGB);
-        else
-          ifd->setPhotometricInterpretation(tiff::MIN_IS_BLACK);
-
-        const boost::optional<std::string> compression(getCompression());
-        if(compression)
-          ifd->setCompression(tiff::getCodecScheme(*compression));
-
-        if (currentTIFF->second.ifdCount == 0)
-          ifd->getField(ome::files::tiff::IMAGEDESCRIPTION).set(default_description);
+        const tiff::PhotometricInterpretation photometric =
+          (isRGB(channel) && samples == 3) ? tiff::RGB : tiff::MIN_IS_BLACK;
+
+        boost::optional<tiff::Compression> compression;
+        if (getCompression())
+          compression = tiff::getCodecScheme(*getCompression());
+
+        // Samples are packed into their significant bits if these
+        // still require the same pixel type when read.
+        uint16_t bits = static_cast<uint16_t>(bitsPerPixel(pixeltype));
+        if (packedSamples &&
+            (pixeltype == PixelType::UINT8 || pixeltype == PixelType::UINT16))
+          {
+            pixel_size_type significant = bits;
+            try
+              {
+                significant = getBitsPerPixel();
+              }
+            catch (const std::exception&)
+              {
+                // SignificantBits not set; store unpacked.
+              }
+            if ((pixeltype == PixelType::UINT8 && significant >= 2U && significant < 8U) ||
+                (pixeltype == PixelType::UINT16 && significant >= 9U && significant < 16U))
+              bits = static_cast<uint16_t>(significant);
+          }
+        if (halfFloat && pixeltype == PixelType::FLOAT)
+          bits = 16U;
+
+        IFDParameters params;
+        params.sizeX = sizeX;
+        params.sizeY = sizeY;
+        params.geometry = geometry;
+        params.pixeltype = pixeltype;
+        params.bits = bits;
+        params.samples = samples;
+        params.planarconfig = planarconfig;
+        params.photometric = photometric;
+        params.compression = compression;
+        params.codec = codecParameters;
+        return params;
       }
 
       void
-      OMETIFFWriter::saveBytes(dimension_size_type plane,
-                               VariantPixelBuffer& buf,
-                               dimension_size_type x,
-                               dimension_size_type y,
-                               dimension_size_type w,
-                               dimension_size_type h)
+      OMETIFFWriter::setupIFD() const
       {
-        assertId(currentId, true);
+        // All IFD parameters are determined here rather than in the
+        // submitted task, since the current series and plane may
+        // change before a queued task is run.  With compact
+        // directories, they are only determined once for each series
+        // and channel.
+        IFDParameters params;
+        if (compactDirectories)
+          {
+            const std::pair<dimension_size_type, dimension_size_type>
+              key(getSeries(), getZCTCoords(getPlane())[1]);
+            ifd_parameters_map::const_iterator known = ifdParameters.find(key);
+            if (known == ifdParameters.end())
+              known = ifdParameters.insert(ifd_parameters_map::value_type(key, getIFDParameters())).first;
+            params = known->second;
+          }
+        else
+          params = getIFDParameters();
 
-        setPlane(plane);
+        TIFFState& state(currentTIFF->second);
 
-        // Get current IFD.
-        std::shared_ptr<tiff::IFD> ifd (currentTIFF->second.tiff->getCurrentDirectory());
+        // Only the dataset file holds the OME-XML.
+        boost::optional<std::string> description;
+        if (state.ifdCount == 0 && !state.staging)
+          {
+            description = default_description;
+            // Pad the placeholder to leave room for the OME-XML text.
+            if (reserveOMEXML)
+              {
+                const dimension_size_type reserve(estimateOMEXMLSize());
+                if (reserve > description->size())
+                  description->resize(reserve, ' ');
+              }
+          }
 
-        // Get plane metadata.
-        detail::OMETIFFPlane& planeMeta(seriesState.at(getSeries()).planes.at(plane));
+        std::shared_ptr<tiff::TIFF> handle(state.tiff);
 
-        ifd->writeImage(buf, x, y, w, h);
+        submit(state, [=]()
+               {
+                 // Get current IFD.
+                 std::shared_ptr<tiff::IFD> ifd (handle->getCurrentDirectory());
 
-        // Set plane metadata.
-        planeMeta.id = currentTIFF->first;
-        planeMeta.ifd = currentTIFF->second.ifdCount;
-        planeMeta.certain = true;
-        planeMeta.status = detail::OMETIFFPlane::PRESENT; // Plane now written.
+                 ifd->setImageWidth(params.sizeX);
+                 ifd->setImageHeight(params.sizeY);
+
+                 ifd->setTileType(params.geometry.type);
+                 ifd->setTileWidth(static_cast<uint32_t>(params.geometry.width));
+                 ifd->setTileHeight(static_cast<uint32_t>(params.geometry.height));
+
+                 ifd->setPixelType(params.pixeltype);
+                 ifd->setBitsPerSample(params.bits);
+                 ifd->setSamplesPerPixel(params.samples);
+                 ifd->setPlanarConfiguration(params.planarconfig);
+                 ifd->setPhotometricInterpretation(params.photometric);
+
+                 if(params.compression)
+                   {
+                     ifd->setCompression(*params.compression);
+                     ifd->setCodecParameters(params.codec);
+                   }
+
+                 if (description)
+                   ifd->getField(ome::files::tiff::IMAGEDESCRIPTION).set(*description);
+               });
+        state.ifdReady = true;
       }
 
       void
-      OMETIFFWriter::fillMetadata()
+      OMETIFFWriter::prepareIFD() const
       {
-        if (!omeMeta)
-          throw std::logic_error("OMEXMLMetadata null");
-
-        dimension_size_type badPlanes = 0U;
-        for (const auto& series : seriesState)
-          for (const auto& plane : series.planes)
-            if (plane.status != detail::OMETIFFPlane::PRESENT) // Plane not written.
-              ++badPlanes;
-
-        if (badPlanes)
-          {
-            boost::format fmt
-              ("Inconsistent writer state: %1% planes have not been written");
-            fmt % badPlanes;
-            throw FormatException(fmt.str());
-          }
+        if (!currentTIFF->second.ifdReady)
+          setupIFD();
+      }
 
-        dimension_size_type seriesCount = getSeriesCount();
+      void
+      OMETIFFWriter::preallocateLayout()
+      {
+        TIFFState& state(currentTIFF->second);
+        std::vector<uint8_t> zeros;
 
-        for (dimension_size_type series = 0U; series < seriesCount; ++series)
+        layout.clear();
+        layout.resize(seriesState.size());
+        for (dimension_size_type series = 0U; series < seriesState.size(); ++series)
           {
-            DimensionOrder dimOrder = metadataRetrieve->getPixelsDimensionOrder(series);
-            dimension_size_type sizeZ = metadataRetrieve->getPixelsSizeZ(series);
-            dimension_size_type sizeT = metadataRetrieve->getPixelsSizeT(series);
-            dimension_size_type effC = metadataRetrieve->getChannelCount(series);
-            dimension_size_type imageCount = sizeZ * sizeT * effC;
+            detail::FormatWriter::setSeries(series);
 
-            if (imageCount == 0)
+            for (dimension_size_type plane = 0U; plane < seriesState[series].planes.size(); ++plane)
               {
-                omeMeta->setTiffDataPlaneCount(0, series, 0);
-              }
+                detail::FormatWriter::setPlane(plane);
+
+                setupIFD();
+
+                std::shared_ptr<tiff::IFD> ifd(state.tiff->getCurrentDirectory());
+                const tiff::TileInfo info(ifd->getTileInfo());
+
+                PlaneLayout planeLayout;
+                planeLayout.pixeltype = ifd->getPixelType();
+                planeLayout.planarconfig = ifd->getPlanarConfiguration();
+                planeLayout.width = ifd->getImageWidth();
+                planeLayout.height = ifd->getImageHeight();
+                planeLayout.tileWidth = info.tileWidth();
+                planeLayout.tileHeight = info.tileHeight();
+                planeLayout.samples = ifd->getSamplesPerPixel();
+
+                if (planeLayout.pixeltype == PixelType::BIT)
+                  throw std::logic_error("BIT pixels are not supported with a preallocated layout");
+
+                // Write every tile or strip, so that libtiff places
+                // each in turn and records its offset.  Strips at the
+                // bottom edge are only as high as the image.
+                const dimension_size_type copysamples =
+                  (planeLayout.planarconfig == tiff::CONTIG) ? planeLayout.samples : 1U;
+                const dimension_size_type rowsize =
+                  planeLayout.tileWidth * copysamples * bytesPerPixel(planeLayout.pixeltype);
+                const PlaneRegion full(0, 0, planeLayout.width, planeLayout.height);
+                for (dimension_size_type tile = 0U; tile < info.tileCount(); ++tile)
+                  {
+                    const dimension_size_type rows = (info.tileType() == tiff::TILE) ?
+                      planeLayout.tileHeight : (info.tileRegion(tile) & full).h;
+                    const dimension_size_type size = rows * rowsize;
+                    if (zeros.size() < size)
+                      zeros.resize(size, 0U);
+                    ifd->writeRawTile(tile, zeros.data(), size);
+                  }
+                ifd->getField(info.tileType() == tiff::TILE ? tiff::TILEOFFSETS : tiff::STRIPOFFSETS).get(planeLayout.offsets);
 
-            for (dimension_size_type plane = 0U; plane < imageCount; ++plane)
-              {
-                std::array<dimension_size_type, 3> coords =
-                  ome::files::getZCTCoords(dimOrder, sizeZ, effC, sizeT, imageCount, plane);
-                const detail::OMETIFFPlane& planeState(seriesState.at(series).planes.at(plane));
+                detail::OMETIFFPlane& planeMeta(seriesState[series].planes[plane]);
+                planeMeta.file = planeFiles.intern(currentTIFF->first);
+                planeMeta.ifd = state.ifdCount;
+                planeMeta.certain = true;
+                planeMeta.status = detail::OMETIFFPlane::PRESENT;
 
-                tiff_map::const_iterator t = tiffs.find(planeState.id);
-                if (t != tiffs.end())
-                  {
-                    path relative(make_relative(baseDir, planeState.id));
-                    std::string uuid("urn:uuid:");
-                    uuid += t->second.uuid;
-                    omeMeta->setUUIDFileName(relative.generic_string(), series, plane);
-                    omeMeta->setUUIDValue(uuid, series, plane);
+                layout[series].push_back(planeLayout);
 
-                    // Fill in non-default TiffData attributes.
-                    omeMeta->setTiffDataFirstZ(coords[0], series, plane);
-                    omeMeta->setTiffDataFirstT(coords[2], series, plane);
-                    omeMeta->setTiffDataFirstC(coords[1], series, plane);
-                    omeMeta->setTiffDataIFD(planeState.ifd, series, plane);
-                    omeMeta->setTiffDataPlaneCount(1, series, plane);
-                  }
-                else
-                  {
-                    boost::format fmt
-                      ("Inconsistent writer state: TIFF file %1% not registered with a UUID");
-                    fmt % planeState.id;
-                    throw FormatException(fmt.str());
-                  }
+                nextIFD();
               }
           }
+
+        detail::FormatWriter::setSeries(0U);
+        detail::FormatWriter::setPlane(0U);
       }
 
-      std::string
-      OMETIFFWriter::getOMEXML(const boost::filesystem::path& id)
+      const OMETIFFWriter::PlaneLayout&
+      OMETIFFWriter::getLayout(dimension_size_type plane) const
       {
-        tiff_map::const_iterator t = tiffs.find(id);
+        const std::vector<PlaneLayout>& seriesLayout(layout.at(getSeries()));
+        if (plane >= seriesLayout.size())
+          {
+            boost::format fmt("Invalid plane index %1%: series contains %2% planes");
+            fmt % plane % seriesLayout.size();
+            throw FormatException(fmt.str());
+          }
+        return seriesLayout[plane];
+      }
+
+      void
+      OMETIFFWriter::saveLayoutBytes(dimension_size_type       plane,
+                                     const VariantPixelBuffer& buf,
+                                     dimension_size_type       x,
+                                     dimension_size_type       y,
+                                     dimension_size_type       w,
+                                     dimension_size_type       h)
+      {
+        const PlaneLayout& planeLayout(getLayout(plane));
+        const bool contig = (planeLayout.planarconfig == tiff::CONTIG);
+        const dimension_size_type copysamples = contig ? planeLayout.samples : 1U;
+
+        const VariantPixelBuffer::size_type *shape(buf.shape());
+        if (buf.pixelType() != planeLayout.pixeltype)
+          {
+            boost::format fmt("VariantPixelBuffer %1% pixel type is incompatible with TIFF %2% pixel type");
+            fmt % buf.pixelType() % planeLayout.pixeltype;
+            throw FormatException(fmt.str());
+          }
+        if (shape[DIM_SPATIAL_X] != w || shape[DIM_SPATIAL_Y] != h ||
+            shape[DIM_SUBCHANNEL] != planeLayout.samples)
+          throw FormatException("VariantPixelBuffer dimensions incompatible with region size");
+        if (x + w > planeLayout.width || y + h > planeLayout.height)
+          throw FormatException("Region is outside the image");
+        if (!(buf.storage_order() == PixelBufferBase::make_storage_order(DimensionOrder::XYZTC, contig)))
+          throw FormatException("VariantPixelBuffer storage order incompatible with TIFF planar configuration");
+        if (!w || !h)
+          return;
+
+        const dimension_size_type tw = planeLayout.tileWidth;
+        const dimension_size_type th = planeLayout.tileHeight;
+        const dimension_size_type across = (planeLayout.width + tw - 1) / tw;
+        const dimension_size_type down = (planeLayout.height + th - 1) / th;
+        const dimension_size_type pixelsize = copysamples * bytesPerPixel(planeLayout.pixeltype);
+        const VariantPixelBuffer::raw_type *data = buf.data();
+        const PlaneRegion region(x, y, w, h);
+
+        for (dimension_size_type sample = 0U; sample < (contig ? 1U : planeLayout.samples); ++sample)
+          for (dimension_size_type row = y / th; row <= (y + h - 1) / th; ++row)
+            for (dimension_size_type col = x / tw; col <= (x + w - 1) / tw; ++col)
+              {
+                const dimension_size_type tile = (sample * down + row) * across + col;
+                const PlaneRegion rtile(col * tw, row * th, tw, th);
+                const PlaneRegion rclip(rtile & region);
+
+                // Rows are contiguous in both the file and the buffer
+                // if the region spans the full tile width.
+                const bool whole = (rclip.w == tw && rclip.w == w);
+                const dimension_size_type nrows = whole ? rclip.h : 1U;
+
+                for (dimension_size_type r = rclip.y; r < rclip.y + rclip.h; r += nrows)
+                  {
+                    const uint64_t fileoffset = planeLayout.offsets.at(tile) +
+                      (((r - rtile.y) * tw) + (rclip.x - rtile.x)) * pixelsize;
+                    const dimension_size_type bufoffset =
+                      (((sample * h) + (r - y)) * w + (rclip.x - x)) * pixelsize;
+                    layoutFile->write(fileoffset, data + bufoffset, rclip.w * nrows * pixelsize);
+                  }
+              }
+      }
+
+      void
+      OMETIFFWriter::saveLayoutTile(dimension_size_type plane,
+                                    dimension_size_type tile,
+                                    const uint8_t       *data,
+                                    dimension_size_type size)
+      {
+        const PlaneLayout& planeLayout(getLayout(plane));
+
+        if (tile >= planeLayout.offsets.size())
+          {
+            boost::format fmt("Invalid tile index %1%: IFD contains %2% tiles");
+            fmt % tile % planeLayout.offsets.size();
+            throw FormatException(fmt.str());
+          }
+
+        // Strips at the bottom edge are only as high as the image.
+        const dimension_size_type copysamples =
+          (planeLayout.planarconfig == tiff::CONTIG) ? planeLayout.samples : 1U;
+        const dimension_size_type across = (planeLayout.width + planeLayout.tileWidth - 1) / planeLayout.tileWidth;
+        const dimension_size_type down = (planeLayout.height + planeLayout.tileHeight - 1) / planeLayout.tileHeight;
+        const dimension_size_type row = (tile % (across * down)) / across;
+        dimension_size_type rows = planeLayout.tileHeight;
+        if (planeLayout.tileWidth == planeLayout.width)
+          rows = std::min(rows, planeLayout.height - (row * planeLayout.tileHeight));
+        const dimension_size_type expected =
+          planeLayout.tileWidth * rows * copysamples * bytesPerPixel(planeLayout.pixeltype);
+
+        if (size < expected)
+          {
+            boost::format fmt("Tile size %1% is smaller than the preallocated tile size %2%");
+            fmt % size % expected;
+            throw FormatException(fmt.str());
+          }
+
+        layoutFile->write(planeLayout.offsets[tile], data, expected);
+      }
+
+      namespace
+      {
+
+        // Create a buffer referring to external storage.
+        template<typename T, class ExtentList>
+        void
+        referBuffer(void                                      *data,
+                    const ExtentList&                          extents,
+                    PixelType                                  pixeltype,
+                    const PixelBufferBase::storage_order_type& storage,
+                    VariantPixelBuffer&                        buf)
+        {
+          std::shared_ptr<PixelBuffer<T>> pb(std::make_shared<PixelBuffer<T>>(static_cast<T *>(data), extents,
+                                                                              pixeltype, ENDIAN_NATIVE, storage));
+          buf.vbuffer() = VariantPixelBuffer::variant_buffer_type(pb);
+        }
+
+      }
+
+      void
+      OMETIFFWriter::mapBytes(dimension_size_type plane,
+                              VariantPixelBuffer& buf)
+      {
+        assertId(currentId, true);
+
+        if (layout.empty())
+          throw std::runtime_error("Mapping planes requires a preallocated layout");
+
+        const PlaneLayout& planeLayout(getLayout(plane));
+        if (planeLayout.tileWidth != planeLayout.width)
+          throw FormatException("Only stripped planes may be mapped; tiles are not stored contiguously");
+
+        // Strips are preallocated in order, so the plane should be
+        // contiguous, but check rather than assume.
+        const bool contig = (planeLayout.planarconfig == tiff::CONTIG);
+        const dimension_size_type rowsize = planeLayout.width * (contig ? planeLayout.samples : 1U) *
+          bytesPerPixel(planeLayout.pixeltype);
+        const dimension_size_type down = (planeLayout.height + planeLayout.tileHeight - 1) / planeLayout.tileHeight;
+        uint64_t end = planeLayout.offsets.at(0);
+        for (dimension_size_type strip = 0U; strip < planeLayout.offsets.size(); ++strip)
+          {
+            if (planeLayout.offsets[strip] != end)
+              throw FormatException("Plane is not stored contiguously");
+            const dimension_size_type row = (strip % down) * planeLayout.tileHeight;
+            end += std::min(planeLayout.tileHeight, planeLayout.height - row) * rowsize;
+          }
+
+        void *data = layoutFile->map(planeLayout.offsets[0],
+                                     static_cast<std::size_t>(end - planeLayout.offsets[0]));
+
+        std::array<VariantPixelBuffer::size_type, 9> shape;
+        shape[DIM_SPATIAL_X] = planeLayout.width;
+        shape[DIM_SPATIAL_Y] = planeLayout.height;
+        shape[DIM_SUBCHANNEL] = planeLayout.samples;
+        shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+          shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+        const PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(DimensionOrder::XYZTC, contig));
+
+        // No switch default to avoid -Wunreachable-code errors.
+#ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+
+#define OME_FILES_OMETIFFWRITER_MAP_CASE(maR, maProperty, maType)       \
+          case PixelType::maType:                                       \
+            referBuffer<PixelProperties<PixelType::maType>::std_type>(data, shape, planeLayout.pixeltype, order, buf); \
+            break;
+
+        switch(planeLayout.pixeltype)
+          {
+            BOOST_PP_SEQ_FOR_EACH(OME_FILES_OMETIFFWRITER_MAP_CASE, _, OME_XML_MODEL_ENUMS_PIXELTYPE_VALUES);
+          }
+
+#undef OME_FILES_OMETIFFWRITER_MAP_CASE
+
+#ifdef __GNUC__
+#  pragma GCC diagnostic pop
+#endif
+      }
+
+      void
+      OMETIFFWriter::saveBytes(dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               dimension_size_type x,
+                               dimension_size_type y,
+                               dimension_size_type w,
+                               dimension_size_type h)
+      {
+        assertId(currentId, true);
+
+        if (!layout.empty())
+          {
+            saveLayoutBytes(plane, buf, x, y, w, h);
+            return;
+          }
+
+        setPlane(plane);
+        prepareIFD();
+
+        // Get plane metadata.
+        detail::OMETIFFPlane& planeMeta(seriesState.at(getSeries()).planes.at(plane));
+
+        std::shared_ptr<tiff::TIFF> handle(currentTIFF->second.tiff);
+        const unsigned int threads(getWriteThreads());
+        const std::shared_ptr<Executor> encodeExecutor(executor);
+
+        if (currentTIFF->second.queue)
+          {
+            // Copy the pixel data; the caller may reuse the buffer
+            // before the queued write is complete.
+            std::shared_ptr<VariantPixelBuffer> copy(copyWriteBuffer(buf));
+
+            currentTIFF->second.queue->submit([handle, threads, encodeExecutor, copy, x, y, w, h]()
+                                              {
+                                                handle->setEncodeThreads(threads);
+                                                handle->setExecutor(encodeExecutor);
+                                                handle->getCurrentDirectory()->writeImage(std::move(*copy), x, y, w, h);
+                                              },
+                                              queued_size(*copy));
+          }
+        else
+          {
+            handle->setEncodeThreads(threads);
+            handle->setExecutor(encodeExecutor);
+            handle->getCurrentDirectory()->writeImage(buf, x, y, w, h);
+          }
+
+        // Set plane metadata.
+        planeMeta.file = planeFiles.intern(currentTIFF->first);
+        planeMeta.ifd = currentTIFF->second.ifdCount;
+        planeMeta.certain = true;
+        planeMeta.status = detail::OMETIFFPlane::PRESENT; // Plane now written.
+      }
+
+      void
+      OMETIFFWriter::saveBytes(dimension_size_type  plane,
+                               VariantPixelBuffer&& buf,
+                               dimension_size_type  x,
+                               dimension_size_type  y,
+                               dimension_size_type  w,
+                               dimension_size_type  h)
+      {
+        assertId(currentId, true);
+
+        if (!layout.empty())
+          {
+            saveLayoutBytes(plane, buf, x, y, w, h);
+            return;
+          }
+
+        setPlane(plane);
+        prepareIFD();
+
+        // Get plane metadata.
+        detail::OMETIFFPlane& planeMeta(seriesState.at(getSeries()).planes.at(plane));
+
+        std::shared_ptr<tiff::TIFF> handle(currentTIFF->second.tiff);
+        const unsigned int threads(getWriteThreads());
+        const std::shared_ptr<Executor> encodeExecutor(executor);
+
+        if (currentTIFF->second.queue)
+          {
+            // Adopt the pixel data (shallow copy); the caller has
+            // given up the buffer, so it need not be copied.
+            std::shared_ptr<VariantPixelBuffer> adopted(std::make_shared<VariantPixelBuffer>(buf));
+
+            currentTIFF->second.queue->submit([handle, threads, encodeExecutor, adopted, x, y, w, h]()
+                                              {
+                                                handle->setEncodeThreads(threads);
+                                                handle->setExecutor(encodeExecutor);
+                                                handle->getCurrentDirectory()->writeImage(std::move(*adopted), x, y, w, h);
+                                              },
+                                              queued_size(*adopted));
+          }
+        else
+          {
+            handle->setEncodeThreads(threads);
+            handle->setExecutor(encodeExecutor);
+            handle->getCurrentDirectory()->writeImage(std::move(buf), x, y, w, h);
+          }
+
+        // Set plane metadata.
+        planeMeta.file = planeFiles.intern(currentTIFF->first);
+        planeMeta.ifd = currentTIFF->second.ifdCount;
+        planeMeta.certain = true;
+        planeMeta.status = detail::OMETIFFPlane::PRESENT; // Plane now written.
+      }
+
+      void
+      OMETIFFWriter::saveBytes(dimension_size_type            plane,
+                               const VariantPixelBufferView& buf,
+                               dimension_size_type            x,
+                               dimension_size_type            y,
+                               dimension_size_type            w,
+                               dimension_size_type            h)
+      {
+        assertId(currentId, true);
+
+        if (!layout.empty())
+          {
+            const PlaneLayout& planeLayout(getLayout(plane));
+            VariantPixelBuffer tmp;
+            buf.copyTo(tmp,
+                       PixelBufferBase::make_storage_order(DimensionOrder::XYZTC,
+                                                           planeLayout.planarconfig == tiff::CONTIG));
+            saveLayoutBytes(plane, tmp, x, y, w, h);
+            return;
+          }
+
+        setPlane(plane);
+        prepareIFD();
+
+        // Get plane metadata.
+        detail::OMETIFFPlane& planeMeta(seriesState.at(getSeries()).planes.at(plane));
+
+        std::shared_ptr<tiff::TIFF> handle(currentTIFF->second.tiff);
+        const unsigned int threads(getWriteThreads());
+        const std::shared_ptr<Executor> encodeExecutor(executor);
+
+        if (currentTIFF->second.queue)
+          {
+            // Copy the viewed pixel data; the viewed buffer may be
+            // reused before the queued write is complete.
+            std::shared_ptr<VariantPixelBuffer> copy(copyWriteBuffer(buf));
+
+            currentTIFF->second.queue->submit([handle, threads, encodeExecutor, copy, x, y, w, h]()
+                                              {
+                                                handle->setEncodeThreads(threads);
+                                                handle->setExecutor(encodeExecutor);
+                                                handle->getCurrentDirectory()->writeImage(VariantPixelBufferView(*copy), x, y, w, h);
+                                              },
+                                              queued_size(*copy));
+          }
+        else
+          {
+            handle->setEncodeThreads(threads);
+            handle->setExecutor(encodeExecutor);
+            handle->getCurrentDirectory()->writeImage(buf, x, y, w, h);
+          }
+
+        // Set plane metadata.
+        planeMeta.file = planeFiles.intern(currentTIFF->first);
+        planeMeta.ifd = currentTIFF->second.ifdCount;
+        planeMeta.certain = true;
+        planeMeta.status = detail::OMETIFFPlane::PRESENT; // Plane now written.
+      }
+
+      void
+      OMETIFFWriter::saveBytesStack(dimension_size_type series,
+                                    const plane_range&  zRange,
+                                    const plane_range&  cRange,
+                                    const plane_range&  tRange,
+                                    VariantPixelBuffer& buf)
+      {
+        assertId(currentId, true);
+
+        if (layout.empty() || getWriteThreads() < 2U)
+          {
+            detail::FormatWriter::saveBytesStack(series, zRange, cRange, tRange, buf);
+            return;
+          }
+
+        setSeries(series);
+        const std::vector<stack_plane> planes(stackPlanes(zRange, cRange, tRange, buf));
+        const dimension_size_type width = buf.shape()[DIM_SPATIAL_X];
+        const dimension_size_type height = buf.shape()[DIM_SPATIAL_Y];
+        const dimension_size_type nthreads =
+          std::min(static_cast<dimension_size_type>(getWriteThreads()),
+                   static_cast<dimension_size_type>(planes.size()));
+
+        // Each task writes every nthreads-th plane to its fixed
+        // place in the file, using its own reused buffer to hold
+        // the plane in the storage order of the layout.
+        getExecutor()->parallel(static_cast<unsigned int>(nthreads),
+                                [&](unsigned int t)
+                                {
+                                  VariantPixelBuffer tmp;
+                                  for (dimension_size_type i = t; i < planes.size(); i += nthreads)
+                                    {
+                                      if (const CancellationToken *cancel = CancellationToken::current())
+                                        cancel->check();
+
+                                      const PlaneLayout& planeLayout(getLayout(planes[i].first));
+                                      stackPlaneView(buf, planes[i]).copyTo
+                                        (tmp,
+                                         PixelBufferBase::make_storage_order(DimensionOrder::XYZTC,
+                                                                             planeLayout.planarconfig == tiff::CONTIG));
+                                      saveLayoutBytes(planes[i].first, tmp, 0, 0, width, height);
+                                    }
+                                });
+      }
+
+      void
+      OMETIFFWriter::saveRawTile(dimension_size_type plane,
+                                 dimension_size_type tile,
+                                 const uint8_t       *data,
+                                 dimension_size_type size)
+      {
+        assertId(currentId, true);
+
+        if (!layout.empty())
+          {
+            saveLayoutTile(plane, tile, data, size);
+            return;
+          }
+
+        setPlane(plane);
+        prepareIFD();
+
+        // Get plane metadata.
+        detail::OMETIFFPlane& planeMeta(seriesState.at(getSeries()).planes.at(plane));
+
+        std::shared_ptr<tiff::TIFF> handle(currentTIFF->second.tiff);
+
+        if (currentTIFF->second.queue)
+          {
+            // Copy the tile data; the caller may reuse it before the
+            // queued write is complete.
+            std::shared_ptr<std::vector<uint8_t>> copy(std::make_shared<std::vector<uint8_t>>(data, data + size));
+
+            currentTIFF->second.queue->submit([handle, tile, copy]()
+                                              {
+                                                handle->getCurrentDirectory()->writeRawTile(tile, copy->data(), copy->size());
+                                              },
+                                              copy->size());
+          }
+        else
+          handle->getCurrentDirectory()->writeRawTile(tile, data, size);
+
+        // Set plane metadata.
+        planeMeta.file = planeFiles.intern(currentTIFF->first);
+        planeMeta.ifd = currentTIFF->second.ifdCount;
+        planeMeta.certain = true;
+        planeMeta.status = detail::OMETIFFPlane::PRESENT; // Plane now written.
+      }
+
+      void
+      OMETIFFWriter::saveTile(dimension_size_type       plane,
+                              dimension_size_type       tile,
+                              const VariantPixelBuffer& buf)
+      {
+        assertId(currentId, true);
+
+        if (!layout.empty())
+          {
+            const PlaneLayout& planeLayout(getLayout(plane));
+            const dimension_size_type copysamples =
+              (planeLayout.planarconfig == tiff::CONTIG) ? planeLayout.samples : 1U;
+            const VariantPixelBuffer::size_type *shape(buf.shape());
+            if (buf.pixelType() != planeLayout.pixeltype ||
+                shape[DIM_SPATIAL_X] != planeLayout.tileWidth ||
+                shape[DIM_SPATIAL_Y] != planeLayout.tileHeight ||
+                shape[DIM_SUBCHANNEL] != copysamples ||
+                !(buf.storage_order() == PixelBufferBase::make_storage_order(DimensionOrder::XYZTC,
+                                                                             planeLayout.planarconfig == tiff::CONTIG)))
+              throw FormatException("Pixel buffer is incompatible with the native tile size, pixel type or storage order");
+            saveLayoutTile(plane, tile, buf.data(),
+                           planeLayout.tileWidth * planeLayout.tileHeight * copysamples *
+                           bytesPerPixel(planeLayout.pixeltype));
+            return;
+          }
+
+        setPlane(plane);
+        prepareIFD();
+
+        // Get plane metadata.
+        detail::OMETIFFPlane& planeMeta(seriesState.at(getSeries()).planes.at(plane));
+
+        std::shared_ptr<tiff::TIFF> handle(currentTIFF->second.tiff);
+
+        if (currentTIFF->second.queue)
+          {
+            // Copy the pixel data; the caller may reuse the buffer
+            // before the queued write is complete.
+            std::shared_ptr<VariantPixelBuffer> copy(copyWriteBuffer(buf));
+
+            currentTIFF->second.queue->submit([handle, tile, copy]()
+                                              {
+                                                handle->getCurrentDirectory()->writeTile(tile, *copy);
+                                              },
+                                              queued_size(*copy));
+          }
+        else
+          handle->getCurrentDirectory()->writeTile(tile, buf);
+
+        // Set plane metadata.
+        planeMeta.file = planeFiles.intern(currentTIFF->first);
+        planeMeta.ifd = currentTIFF->second.ifdCount;
+        planeMeta.certain = true;
+        planeMeta.status = detail::OMETIFFPlane::PRESENT; // Plane now written.
+      }
+
+      void
+      OMETIFFWriter::fillMetadata()
+      {
+        if (!omeMeta)
+          throw std::logic_error("OMEXMLMetadata null");
+
+        dimension_size_type badPlanes = 0U;
+        for (const auto& series : seriesState)
+          for (const auto& plane : series.planes)
+            if (plane.status != detail::OMETIFFPlane::PRESENT) // Plane not written.
+              ++badPlanes;
+
+        if (badPlanes)
+          {
+            boost::format fmt
+              ("Inconsistent writer state: %1% planes have not been written");
+            fmt % badPlanes;
+            throw FormatException(fmt.str());
+          }
+
+        dimension_size_type seriesCount = getSeriesCount();
+
+        for (dimension_size_type series = 0U; series < seriesCount; ++series)
+          {
+            DimensionOrder dimOrder = metadataRetrieve->getPixelsDimensionOrder(series);
+            dimension_size_type sizeZ = metadataRetrieve->getPixelsSizeZ(series);
+            dimension_size_type sizeT = metadataRetrieve->getPixelsSizeT(series);
+            dimension_size_type effC = metadataRetrieve->getChannelCount(series);
+            dimension_size_type imageCount = sizeZ * sizeT * effC;
+
+            if (imageCount == 0)
+              {
+                omeMeta->setTiffDataPlaneCount(0, series, 0);
+                continue;
+              }
+
+            // Each run of planes stored in consecutive IFDs of the same
+            // file is described by a single TiffData element, whose
+            // planes follow the first in dimension order, so that the
+            // size of the metadata depends upon the number of files
+            // rather than the number of planes.
+            const DimensionIndexer indexer(dimOrder, sizeZ, effC, sizeT, imageCount);
+            const std::vector<detail::OMETIFFPlane>& planes(seriesState.at(series).planes);
+            dimension_size_type tiffData = 0U;
+            for (dimension_size_type plane = 0U; plane < imageCount; ++tiffData)
+              {
+                const detail::OMETIFFPlane& planeState(planes.at(plane));
+                const path& planeFile(planeFiles.at(planeState.file));
+
+                dimension_size_type count = 1U;
+                while (plane + count < imageCount &&
+                       planes.at(plane + count).file == planeState.file &&
+                       planes.at(plane + count).ifd == planeState.ifd + count)
+                  ++count;
+
+                tiff_map::const_iterator t = tiffs.find(planeFile);
+                if (t != tiffs.end())
+                  {
+                    std::array<dimension_size_type, 3> coords(indexer.coords(plane));
+                    path relative(make_relative(baseDir, planeFile));
+                    std::string uuid("urn:uuid:");
+                    uuid += t->second.uuid;
+                    omeMeta->setUUIDFileName(relative.generic_string(), series, tiffData);
+                    omeMeta->setUUIDValue(uuid, series, tiffData);
+
+                    // Fill in non-default TiffData attributes.
+                    omeMeta->setTiffDataFirstZ(coords[0], series, tiffData);
+                    omeMeta->setTiffDataFirstT(coords[2], series, tiffData);
+                    omeMeta->setTiffDataFirstC(coords[1], series, tiffData);
+                    omeMeta->setTiffDataIFD(planeState.ifd, series, tiffData);
+                    omeMeta->setTiffDataPlaneCount(count, series, tiffData);
+                  }
+                else
+                  {
+                    boost::format fmt
+                      ("Inconsistent writer state: TIFF file %1% not registered with a UUID");
+                    fmt % planeFile;
+                    throw FormatException(fmt.str());
+                  }
+
+                plane += count;
+              }
+          }
+      }
+
+      dimension_size_type
+      OMETIFFWriter::estimateOMEXMLSize() const
+      {
+        // Only a BinaryOnly stub is embedded with a companion file.
+        if (!companionFile.empty())
+          return 1024U + (companionFile.string().size() * 2U);
+
+        // Only the size is needed, so skip validation.
+        dimension_size_type size = omeMeta ? files::getOMEXML(*omeMeta, false).size() : 0U;
+
+        // Each plane gains at most one TiffData element with UUID and
+        // filename; contiguous planes share one.
+        dimension_size_type planes = 0U;
+        for (const auto& series : seriesState)
+          planes += series.planes.size();
+        size += planes * (160U + (currentTIFF->first.string().size() * 2U));
+
+        // Allow for the metadata changing before close.
+        return size + (size / 4U) + 4096U;
+      }
+
+      std::string
+      OMETIFFWriter::getOMEXML(const boost::filesystem::path& id,
+                               bool                           first)
+      {
+        tiff_map::const_iterator t = tiffs.find(id);
 
         if (t == tiffs.end())
           {
-            boost::format fmt
-              ("Inconsistent writer state: TIFF file %1% not registered with a UUID");
+            boost::format fmt
+              ("Inconsistent writer state: TIFF file %1% not registered with a UUID");
+            fmt % id;
+            throw FormatException(fmt.str());
+          }
+
+        std::string uuid("urn:uuid:");
+        uuid += t->second.uuid;
+
+        OMEXMLValidationPolicy policy = omexmlValidation;
+        if (!first && policy == OMEXML_VALIDATE_FIRST)
+          policy = OMEXML_VALIDATE_NONE;
+
+        if (!companionFile.empty())
+          {
+            // Embed a stub referring to the companion file.
+            OMEXMLMetadata stub;
+            stub.setUUID(uuid);
+            stub.setBinaryOnlyMetadataFile(make_relative(baseDir, ome::common::canonical(companionFile)).generic_string());
+            stub.setBinaryOnlyUUID(companionUUID);
+            return files::getOMEXML(stub, policy);
+          }
+
+        omeMeta->setUUID(uuid);
+        return files::getOMEXML(*omeMeta, policy);
+      }
+
+      OMEXMLMetadata&
+      OMETIFFWriter::writableMetadata()
+      {
+        if (omeMetaShared)
+          {
+            std::shared_ptr<OMEXMLMetadata> copy(std::make_shared<OMEXMLMetadata>());
+            convert(*omeMeta, *copy);
+            copy->resolveReferences();
+            omeMeta = copy;
+            metadataRetrieve = omeMeta;
+            omeMetaShared = false;
+          }
+        return *omeMeta;
+      }
+
+      void
+      OMETIFFWriter::saveCompanion()
+      {
+        companionUUID = "urn:uuid:";
+        companionUUID += boost::uuids::to_string(boost::uuids::random_generator()());
+        omeMeta->setUUID(companionUUID);
+
+        const std::string xml(files::getOMEXML(*omeMeta, omexmlValidation));
+
+        boost::filesystem::ofstream out(companionFile,
+                                        std::ios::out | std::ios::binary | std::ios::trunc);
+        out << xml;
+        out.close();
+        if (!out)
+          {
+            boost::format fmt("Failed to write companion file ‘%1%’");
+            fmt % companionFile.string();
+            throw FormatException(fmt.str());
+          }
+      }
+
+      std::shared_ptr<ome::files::tiff::TIFF>
+      OMETIFFWriter::openAppend(const boost::filesystem::path& id,
+                                std::string&                   uuid,
+                                dimension_size_type&           ifdCount)
+      {
+        if (preallocate || !companionFile.empty())
+          throw std::logic_error("Appending is not supported with a preallocated layout or a companion file");
+
+        // Read the existing OME-XML and directory count.
+        std::string description;
+        bool bigOffsets;
+        {
+          std::shared_ptr<TIFF> existing(TIFF::open(id, "r", ioStatistics));
+          ifdCount = existing->directoryCount();
+          description = firstDescription(*existing, id);
+          bigOffsets = TIFFIsBigTIFF(reinterpret_cast<::TIFF *>(existing->getWrapped())) != 0;
+          existing->close();
+        }
+
+        // libtiff can only append directories using the existing
+        // offset size.
+        if (!bigOffsets && flags.find('8') != std::string::npos)
+          {
+            boost::format fmt("Can not append to %1%: BigTIFF is required, and an existing TIFF file can not be converted to BigTIFF");
+            fmt % id;
+            throw FormatException(fmt.str());
+          }
+
+        std::shared_ptr<OMEXMLMetadata> existingMeta(createOMEXMLMetadata(description));
+        std::string rootUUID;
+        try
+          {
+            rootUUID = existingMeta->getUUID();
+          }
+        catch (const std::exception&)
+          {
+          }
+        if (rootUUID.empty())
+          {
+            boost::format fmt("Can not append to %1%: The OME-XML metadata has no UUID");
             fmt % id;
             throw FormatException(fmt.str());
           }
 
-        path relative(make_relative(baseDir, id));
-        std::string uuid("urn:uuid:");
-        uuid += t->second.uuid;
-        omeMeta->setUUID(uuid);
+        const dimension_size_type seriesCount = existingMeta->getImageCount();
+        if (seriesCount > seriesState.size())
+          {
+            boost::format fmt("Can not append to %1%: The file contains %2% images, but only %3% are to be written");
+            fmt % id % seriesCount % seriesState.size();
+            throw FormatException(fmt.str());
+          }
+
+        // Mark the existing planes as written.  The existing planes
+        // are mapped to the new image dimensions by their Z, C and T
+        // coordinates, since the plane indices change if the sizes
+        // differ.
+        const detail::OMETIFFPlane::file_index_type file = planeFiles.intern(id);
+        for (dimension_size_type series = 0U; series < seriesCount; ++series)
+          {
+            const dimension_size_type sizeZ = existingMeta->getPixelsSizeZ(series);
+            const dimension_size_type sizeT = existingMeta->getPixelsSizeT(series);
+            const dimension_size_type effC = existingMeta->getChannelCount(series);
+            const dimension_size_type imageCount = sizeZ * sizeT * effC;
+
+            const dimension_size_type newSizeZ = metadataRetrieve->getPixelsSizeZ(series);
+            const dimension_size_type newSizeT = metadataRetrieve->getPixelsSizeT(series);
+            const dimension_size_type newEffC = metadataRetrieve->getChannelCount(series);
+
+            if (static_cast<dimension_size_type>(existingMeta->getPixelsSizeX(series)) !=
+                static_cast<dimension_size_type>(metadataRetrieve->getPixelsSizeX(series)) ||
+                static_cast<dimension_size_type>(existingMeta->getPixelsSizeY(series)) !=
+                static_cast<dimension_size_type>(metadataRetrieve->getPixelsSizeY(series)) ||
+                existingMeta->getPixelsType(series) != metadataRetrieve->getPixelsType(series) ||
+                effC != newEffC)
+              {
+                boost::format fmt("Can not append to %1%: The size, pixel type or channels of image %2% differ");
+                fmt % id % series;
+                throw FormatException(fmt.str());
+              }
+
+            if (imageCount == 0)
+              continue;
+
+            const DimensionIndexer indexer(existingMeta->getPixelsDimensionOrder(series),
+                                           sizeZ, effC, sizeT, imageCount);
+            const DimensionIndexer newIndexer(metadataRetrieve->getPixelsDimensionOrder(series),
+                                              newSizeZ, newEffC, newSizeT,
+                                              newSizeZ * newEffC * newSizeT);
+            std::vector<detail::OMETIFFPlane>& planes(seriesState.at(series).planes);
+
+            const dimension_size_type tiffDataCount = existingMeta->getTiffDataCount(series);
+            for (dimension_size_type td = 0U; td < tiffDataCount; ++td)
+              {
+                std::string tdUUID;
+                try
+                  {
+                    tdUUID = existingMeta->getUUIDValue(series, td);
+                  }
+                catch (const std::exception&)
+                  {
+                    // null UUID; this file.
+                  }
+                if (!tdUUID.empty() && tdUUID != rootUUID)
+                  {
+                    boost::format fmt("Can not append to %1%: Only files containing a complete single-file dataset may be appended to");
+                    fmt % id;
+                    throw FormatException(fmt.str());
+                  }
+
+                boost::optional<dimension_size_type> tdIFD;
+                dimension_size_type count = imageCount;
+                dimension_size_type firstZ = 0U;
+                dimension_size_type firstC = 0U;
+                dimension_size_type firstT = 0U;
+                try
+                  {
+                    tdIFD = static_cast<dimension_size_type>(existingMeta->getTiffDataIFD(series, td));
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+                try
+                  {
+                    count = existingMeta->getTiffDataPlaneCount(series, td);
+                  }
+                catch (const std::exception&)
+                  {
+                    if (tdIFD)
+                      count = 1U;
+                  }
+                try
+                  {
+                    firstZ = existingMeta->getTiffDataFirstZ(series, td);
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+                try
+                  {
+                    firstC = existingMeta->getTiffDataFirstC(series, td);
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+                try
+                  {
+                    firstT = existingMeta->getTiffDataFirstT(series, td);
+                  }
+                catch (const std::exception&)
+                  {
+                  }
+
+                if (firstZ >= sizeZ || firstC >= effC || firstT >= sizeT)
+                  {
+                    boost::format fmt("Can not append to %1%: Invalid TiffData: Z=%2%, C=%3%, T=%4%");
+                    fmt % id % firstZ % firstC % firstT;
+                    throw FormatException(fmt.str());
+                  }
+
+                const dimension_size_type first = indexer.index(firstZ, firstC, firstT);
+                const dimension_size_type ifd = tdIFD ? *tdIFD : 0U;
+                for (dimension_size_type i = 0U; i < count; ++i)
+                  {
+                    if (first + i >= imageCount || ifd + i >= ifdCount)
+                      {
+                        boost::format fmt("Can not append to %1%: TiffData %2% of image %3% refers to missing planes or IFDs");
+                        fmt % id % td % series;
+                        throw FormatException(fmt.str());
+                      }
+
+                    const std::array<dimension_size_type, 3> coords(indexer.coords(first + i));
+                    if (coords[0] >= newSizeZ || coords[2] >= newSizeT)
+                      {
+                        boost::format fmt("Can not append to %1%: Plane Z=%2%, C=%3%, T=%4% of image %5% is outside the new image dimensions");
+                        fmt % id % coords[0] % coords[1] % coords[2] % series;
+                        throw FormatException(fmt.str());
+                      }
+
+                    detail::OMETIFFPlane& planeMeta(planes.at(newIndexer.index(coords[0], coords[1], coords[2])));
+                    planeMeta.file = file;
+                    planeMeta.ifd = ifd + i;
+                    planeMeta.certain = true;
+                    planeMeta.status = detail::OMETIFFPlane::PRESENT;
+                  }
+              }
+          }
 
-        return files::getOMEXML(*omeMeta, true);
+        // Keep the existing UUID, so that references to the file from
+        // other datasets remain valid.
+        uuid = rootUUID;
+        const std::string prefix("urn:uuid:");
+        if (uuid.compare(0, prefix.size(), prefix) == 0)
+          uuid.erase(0, prefix.size());
+
+        // Directories written in append mode follow the last
+        // existing directory.
+        return TIFF::open(id, "a", ioStatistics);
       }
 
       void
@@ -927,11 +2465,6 @@ namespace ome
         // Get offset of IFD 0 for later use.
         uint64_t ifd0Offset = bigOffsets ? read_raw_uint64(in, 8, endian) : read_raw_uint32(in, 4, endian);
 
-        // Append XML text with a NUL terminator at end of file, noting the offset.
-        in.seekp(0, std::ios::end);
-        uint64_t descOffset = in.tellp();
-        in << xml << '\0';
-
         // Get number of directory entries for IFD 0.
         uint64_t entries = bigOffsets ? read_raw_uint64(in, ifd0Offset, endian) : read_raw_uint16(in, ifd0Offset, endian);
 
@@ -957,9 +2490,27 @@ namespace ome
             }
 
             uint64_t count = bigOffsets ? read_raw_uint64(in, tagOff + 4, endian) : read_raw_uint32(in, tagOff + 4, endian);
-            if (count != default_description.size() + 1)
+            if (count < default_description.size() + 1)
               throw FormatException("TIFF ImageDescription size is incorrect");
 
+            uint64_t descOffset;
+            if (count > default_description.size() + 1 && count > xml.size())
+              {
+                // Overwrite the reserved placeholder in place, NUL
+                // padding the remainder.
+                descOffset = bigOffsets ? read_raw_uint64(in, tagOff + 12, endian) : read_raw_uint32(in, tagOff + 8, endian);
+                in.seekp(static_cast<std::streamoff>(descOffset));
+                in << xml << std::string(count - xml.size(), '\0');
+              }
+            else
+              {
+                // Append XML text with a NUL terminator at end of
+                // file, noting the offset.
+                in.seekp(0, std::ios::end);
+                descOffset = in.tellp();
+                in << xml << '\0';
+              }
+
             // Overwrite count and offset for the ImageDescription text.
             if (bigOffsets)
               {
@@ -981,6 +2532,70 @@ namespace ome
         in.close();
       }
 
+      void
+      OMETIFFWriter::updateMetadata(const boost::filesystem::path& id,
+                                    const MetadataRetrieve&        retrieve)
+      {
+        if (currentId)
+          throw std::logic_error("Metadata can not be updated while a file is open for writing");
+
+        std::string description;
+        {
+          std::shared_ptr<TIFF> existing(TIFF::open(id, "r", ioStatistics));
+          description = firstDescription(*existing, id);
+          existing->close();
+        }
+        std::shared_ptr<OMEXMLMetadata> existingMeta(createOMEXMLMetadata(description));
+
+        std::shared_ptr<OMEXMLMetadata> meta(std::make_shared<OMEXMLMetadata>());
+        convert(retrieve, *meta);
+        meta->resolveReferences();
+
+        // The pixel data are not rewritten, so the images must be
+        // unchanged.
+        const dimension_size_type seriesCount = existingMeta->getImageCount();
+        if (seriesCount == 0 || meta->getImageCount() != seriesCount)
+          {
+            boost::format fmt("Can not update metadata of %1%: The file contains %2% images, but the metadata contains %3%");
+            fmt % id % seriesCount % meta->getImageCount();
+            throw FormatException(fmt.str());
+          }
+        for (dimension_size_type series = 0U; series < seriesCount; ++series)
+          {
+            if (static_cast<dimension_size_type>(existingMeta->getPixelsSizeX(series)) !=
+                static_cast<dimension_size_type>(meta->getPixelsSizeX(series)) ||
+                static_cast<dimension_size_type>(existingMeta->getPixelsSizeY(series)) !=
+                static_cast<dimension_size_type>(meta->getPixelsSizeY(series)) ||
+                static_cast<dimension_size_type>(existingMeta->getPixelsSizeZ(series)) !=
+                static_cast<dimension_size_type>(meta->getPixelsSizeZ(series)) ||
+                static_cast<dimension_size_type>(existingMeta->getPixelsSizeT(series)) !=
+                static_cast<dimension_size_type>(meta->getPixelsSizeT(series)) ||
+                existingMeta->getChannelCount(series) != meta->getChannelCount(series) ||
+                existingMeta->getPixelsDimensionOrder(series) != meta->getPixelsDimensionOrder(series) ||
+                existingMeta->getPixelsType(series) != meta->getPixelsType(series))
+              {
+                boost::format fmt("Can not update metadata of %1%: The dimensions or pixel type of image %2% differ");
+                fmt % id % series;
+                throw FormatException(fmt.str());
+              }
+          }
+
+        // Keep the existing UUID and plane layout.
+        removeBinData(*meta);
+        removeTiffData(*meta);
+        for (dimension_size_type series = 0U; series < seriesCount; ++series)
+          copyTiffData(*existingMeta, *meta, series);
+        try
+          {
+            meta->setUUID(existingMeta->getUUID());
+          }
+        catch (const std::exception&)
+          {
+          }
+
+        saveComment(id, files::getOMEXML(*meta, omexmlValidation));
+      }
+
       void
       OMETIFFWriter::setBigTIFF(boost::optional<bool> big)
       {
@@ -993,6 +2608,297 @@ namespace ome
         return bigTIFF;
       }
 
+      void
+      OMETIFFWriter::setWriteCacheLimit(dimension_size_type limit)
+      {
+        writeCacheLimit = limit;
+        for (auto& t : tiffs)
+          t.second.tiff->setWriteCacheLimit(limit);
+      }
+
+      dimension_size_type
+      OMETIFFWriter::getWriteCacheLimit() const
+      {
+        return writeCacheLimit;
+      }
+
+      void
+      OMETIFFWriter::setStreamingWrites(dimension_size_type window)
+      {
+        streamingWrites = window;
+        for (auto& t : tiffs)
+          t.second.tiff->setStreamingWrites(window);
+      }
+
+      dimension_size_type
+      OMETIFFWriter::getStreamingWrites() const
+      {
+        return streamingWrites;
+      }
+
+      void
+      OMETIFFWriter::setSparseTiles(bool sparse)
+      {
+        sparseTiles = sparse;
+        for (auto& t : tiffs)
+          t.second.tiff->setSparseTiles(sparse);
+      }
+
+      bool
+      OMETIFFWriter::getSparseTiles() const
+      {
+        return sparseTiles;
+      }
+
+      void
+      OMETIFFWriter::setTileDeduplication(dimension_size_type limit)
+      {
+        tileDeduplication = limit;
+        for (auto& t : tiffs)
+          t.second.tiff->setTileDeduplication(limit);
+      }
+
+      dimension_size_type
+      OMETIFFWriter::getTileDeduplication() const
+      {
+        return tileDeduplication;
+      }
+
+      void
+      OMETIFFWriter::setStatistics(std::shared_ptr<PixelStatistics> sink)
+      {
+        statistics = sink;
+        for (auto& t : tiffs)
+          t.second.tiff->setStatistics(statistics);
+      }
+
+      const std::shared_ptr<PixelStatistics>&
+      OMETIFFWriter::getStatistics() const
+      {
+        return statistics;
+      }
+
+      void
+      OMETIFFWriter::setTileSummaries(bool summaries)
+      {
+        tileSummaries = summaries;
+        for (auto& t : tiffs)
+          t.second.tiff->setTileSummaries(tileSummaries);
+      }
+
+      bool
+      OMETIFFWriter::getTileSummaries() const
+      {
+        return tileSummaries;
+      }
+
+      void
+      OMETIFFWriter::setTilingPolicy(tiff::TilingPolicy  policy,
+                                   dimension_size_type chunkSize)
+      {
+        tilingPolicy = policy;
+        tilingChunkSize = chunkSize;
+      }
+
+      tiff::TilingPolicy
+      OMETIFFWriter::getTilingPolicy() const
+      {
+        return tilingPolicy;
+      }
+
+      dimension_size_type
+      OMETIFFWriter::getTilingChunkSize() const
+      {
+        return tilingChunkSize;
+      }
+
+      void
+      OMETIFFWriter::setCodecParameters(const tiff::CodecParameters& params)
+      {
+        codecParameters = params;
+      }
+
+      const tiff::CodecParameters&
+      OMETIFFWriter::getCodecParameters() const
+      {
+        return codecParameters;
+      }
+
+      void
+      OMETIFFWriter::setReserveOMEXML(bool reserve)
+      {
+        reserveOMEXML = reserve;
+      }
+
+      bool
+      OMETIFFWriter::getReserveOMEXML() const
+      {
+        return reserveOMEXML;
+      }
+
+      void
+      OMETIFFWriter::setSubResolutions(dimension_size_type levels,
+                                       tiff::Downsampling  method)
+      {
+        subResolutions = levels;
+        downsampling = method;
+        for (auto& t : tiffs)
+          t.second.tiff->setSubResolutions(levels, method);
+      }
+
+      dimension_size_type
+      OMETIFFWriter::getSubResolutions() const
+      {
+        return subResolutions;
+      }
+
+      tiff::Downsampling
+      OMETIFFWriter::getDownsampling() const
+      {
+        return downsampling;
+      }
+
+      void
+      OMETIFFWriter::setOMEXMLValidation(OMEXMLValidationPolicy policy)
+      {
+        omexmlValidation = policy;
+      }
+
+      OMEXMLValidationPolicy
+      OMETIFFWriter::getOMEXMLValidation() const
+      {
+        return omexmlValidation;
+      }
+
+      void
+      OMETIFFWriter::setParallelFiles(bool parallel)
+      {
+        parallelFiles = parallel;
+      }
+
+      bool
+      OMETIFFWriter::getParallelFiles() const
+      {
+        return parallelFiles;
+      }
+
+      void
+      OMETIFFWriter::setParallelSeries(bool parallel)
+      {
+        if (currentId)
+          throw std::logic_error("Parallel series writing can not be changed while a file is open");
+        parallelSeries = parallel;
+      }
+
+      bool
+      OMETIFFWriter::getParallelSeries() const
+      {
+        return parallelSeries;
+      }
+
+      void
+      OMETIFFWriter::setPreallocatedLayout(bool preallocate)
+      {
+        this->preallocate = preallocate;
+      }
+
+      bool
+      OMETIFFWriter::getPreallocatedLayout() const
+      {
+        return preallocate;
+      }
+
+      void
+      OMETIFFWriter::setCloudOptimized(bool cloud)
+      {
+        cloudOptimized = cloud;
+      }
+
+      bool
+      OMETIFFWriter::getCloudOptimized() const
+      {
+        return cloudOptimized;
+      }
+
+      void
+      OMETIFFWriter::setCompactDirectories(bool compact)
+      {
+        compactDirectories = compact;
+      }
+
+      bool
+      OMETIFFWriter::getCompactDirectories() const
+      {
+        return compactDirectories;
+      }
+
+      void
+      OMETIFFWriter::setCompanionFile(const boost::filesystem::path& companion)
+      {
+        if (!companion.empty() && !checkSuffix(companion, companion_suffixes))
+          {
+            boost::format fmt("Companion file ‘%1%’ does not have a .companion.ome suffix");
+            fmt % companion.string();
+            throw FormatException(fmt.str());
+          }
+
+        companionFile = companion;
+      }
+
+      const boost::filesystem::path&
+      OMETIFFWriter::getCompanionFile() const
+      {
+        return companionFile;
+      }
+
+      void
+      OMETIFFWriter::setAppend(bool append)
+      {
+        this->append = append;
+      }
+
+      bool
+      OMETIFFWriter::getAppend() const
+      {
+        return append;
+      }
+
+      void
+      OMETIFFWriter::setPackedSamples(bool packed)
+      {
+        packedSamples = packed;
+      }
+
+      bool
+      OMETIFFWriter::getPackedSamples() const
+      {
+        return packedSamples;
+      }
+
+      void
+      OMETIFFWriter::setHalfFloat(bool half)
+      {
+        halfFloat = half;
+      }
+
+      bool
+      OMETIFFWriter::getHalfFloat() const
+      {
+        return halfFloat;
+      }
+
+      void
+      OMETIFFWriter::setShareMetadata(bool share)
+      {
+        shareMetadata = share;
+      }
+
+      bool
+      OMETIFFWriter::getShareMetadata() const
+      {
+        return shareMetadata;
+      }
+
     }
   }
 }
@@ -40,8 +40,14 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <ome/files/MetadataTools.h>
 #include <ome/files/detail/FormatWriter.h>
 #include <ome/files/detail/OMETIFF.h>
+#include <ome/files/detail/PositionalFile.h>
+#include <ome/files/detail/TaskQueue.h>
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/Types.h>
+#include <ome/files/tiff/Util.h>
 
 #include <ome/common/log.h>
 
@@ -51,6 +57,9 @@ namespace ome
 {
   namespace files
   {
+
+    class PixelStatistics;
+
     namespace tiff
     {
 
@@ -84,6 +93,17 @@ namespace ome
           std::shared_ptr<ome::files::tiff::TIFF> tiff;
           /// Number of IFDs written.
           dimension_size_type ifdCount;
+          /// Current IFD set up (and not yet written).
+          bool ifdReady;
+          /// Writer thread queue (if writing files in parallel or
+          /// asynchronously).
+          std::shared_ptr<detail::TaskQueue> queue;
+          /// Staging file holding a single series, to be merged into
+          /// the dataset file on close.
+          bool staging;
+          /// Current plane of the series written to this file (if
+          /// writing series in parallel).
+          dimension_size_type plane;
 
           /**
            * Constructor.
@@ -110,6 +130,58 @@ namespace ome
         /// Vector of SeriesState objects.
         typedef std::vector<SeriesState> series_list;
 
+        /// Layout of a plane in a preallocated file.
+        struct PlaneLayout
+        {
+          /// File offset of each tile or strip.
+          std::vector<uint64_t> offsets;
+          /// Pixel type.
+          ::ome::xml::model::enums::PixelType pixeltype;
+          /// Planar configuration.
+          tiff::PlanarConfiguration planarconfig;
+          /// Image width.
+          dimension_size_type width;
+          /// Image height.
+          dimension_size_type height;
+          /// Tile width (image width for strips).
+          dimension_size_type tileWidth;
+          /// Tile height (rows per strip for strips).
+          dimension_size_type tileHeight;
+          /// Samples per pixel.
+          dimension_size_type samples;
+
+          /// Constructor.
+          PlaneLayout();
+        };
+
+        /// Parameters of an IFD, determined from the metadata.
+        struct IFDParameters
+        {
+          /// Image width.
+          dimension_size_type sizeX;
+          /// Image height.
+          dimension_size_type sizeY;
+          /// Strip or tile geometry.
+          tiff::TileGeometry geometry;
+          /// Pixel type.
+          ::ome::xml::model::enums::PixelType pixeltype;
+          /// Bits per sample.
+          uint16_t bits;
+          /// Samples per pixel.
+          dimension_size_type samples;
+          /// Planar configuration.
+          tiff::PlanarConfiguration planarconfig;
+          /// Photometric interpretation.
+          tiff::PhotometricInterpretation photometric;
+          /// Compression scheme (if set).
+          boost::optional<tiff::Compression> compression;
+          /// Codec parameters.
+          tiff::CodecParameters codec;
+        };
+
+        /// Map series and channel to IFD parameters.
+        typedef std::map<std::pair<dimension_size_type, dimension_size_type>, IFDParameters> ifd_parameters_map;
+
         /// Base path for computing relative paths in the OME-XML.
         boost::filesystem::path baseDir;
 
@@ -120,8 +192,15 @@ namespace ome
         /// Open TIFF files
         mutable tiff_map tiffs;
 
-        /// Current TIFF file.
-        tiff_map::iterator currentTIFF;
+        /// Current TIFF file (mutable to follow the series when
+        /// writing series in parallel).
+        mutable tiff_map::iterator currentTIFF;
+
+        /// Canonical path of each path passed to setId().
+        std::map<boost::filesystem::path, boost::filesystem::path> canonicalIds;
+
+        /// Open TIFF files, indexed by file handle.
+        std::vector<tiff_map::iterator> fileHandles;
 
         /// TIFF flags.
         std::string flags;
@@ -129,6 +208,9 @@ namespace ome
         /// State of each series.
         series_list seriesState;
 
+        /// Files containing the planes written.
+        detail::OMETIFFFileTable planeFiles;
+
         /**
          * Original MetadataRetrieve.
          *
@@ -143,10 +225,102 @@ namespace ome
         /// OME-XML metadata for embedding in the TIFF.
         std::shared_ptr<ome::xml::meta::OMEXMLMetadata> omeMeta;
 
+        /// omeMeta is the caller's metadata, to be copied before modification.
+        bool omeMetaShared;
+
       private:
         /// Write a Big TIFF
         boost::optional<bool> bigTIFF;
 
+        /// Write tile cache limit.
+        dimension_size_type writeCacheLimit;
+
+        /// Streaming write window.
+        dimension_size_type streamingWrites;
+
+        /// Leave empty tiles out of the file.
+        bool sparseTiles;
+
+        /// Tile deduplication limit.
+        dimension_size_type tileDeduplication;
+
+        /// Pixel statistics sink.
+        std::shared_ptr<PixelStatistics> statistics;
+
+        /// Record tile summaries.
+        bool tileSummaries;
+
+        /// Reserve space for OME-XML in the first IFD.
+        bool reserveOMEXML;
+
+        /// Number of sub-resolutions to write.
+        dimension_size_type subResolutions;
+
+        /// Sub-resolution downsampling method.
+        tiff::Downsampling downsampling;
+
+        /// Default strip or tile geometry policy.
+        tiff::TilingPolicy tilingPolicy;
+
+        /// Target compressed chunk size for the tiling policy.
+        dimension_size_type tilingChunkSize;
+
+        /// Codec parameters.
+        tiff::CodecParameters codecParameters;
+
+        /// OME-XML validation policy.
+        OMEXMLValidationPolicy omexmlValidation;
+
+        /// Write each TIFF file from a separate thread.
+        bool parallelFiles;
+
+        /// Write each series to a separate staging file and thread.
+        bool parallelSeries;
+
+        /// Staging file of each series after the first (if writing
+        /// series in parallel).
+        mutable std::map<dimension_size_type, tiff_map::iterator> seriesFiles;
+
+        /// Writer thread queue shared by all files (if writing
+        /// asynchronously but not in parallel).
+        mutable std::shared_ptr<detail::TaskQueue> writeQueue;
+
+        /// Preallocate the file layout.
+        bool preallocate;
+
+        /// Layout of each plane of each series (if preallocated).
+        std::vector<std::vector<PlaneLayout>> layout;
+
+        /// File for writing pixel data (if preallocated).
+        std::shared_ptr<detail::PositionalFile> layoutFile;
+
+        /// Write compact directories.
+        bool compactDirectories;
+
+        /// Rewrite each file with a cloud-optimized layout on close.
+        bool cloudOptimized;
+
+        /// Companion metadata file (empty if metadata are embedded).
+        boost::filesystem::path companionFile;
+
+        /// UUID of the companion metadata file (if written).
+        std::string companionUUID;
+
+        /// Append to existing files.
+        bool append;
+
+        /// Pack samples into their significant bits.
+        bool packedSamples;
+
+        /// Store FLOAT samples as half precision.
+        bool halfFloat;
+
+        /// Modify the caller's OME-XML metadata in place.
+        bool shareMetadata;
+
+        /// IFD parameters for each series and channel (if compact).
+        mutable ifd_parameters_map ifdParameters;
+
       public:
         /// Constructor.
         OMETIFFWriter();
@@ -181,15 +355,156 @@ namespace ome
         dimension_size_type
         getTileSizeY() const;
 
+        // Documented in superclass.
+        void
+        flush();
+
       protected:
-        /// Flush current IFD and create new IFD.
+        /**
+         * Register an open TIFF file.
+         *
+         * The write options are applied to the file, and its writer
+         * queue is set up.
+         *
+         * @param id the canonical path of the file.
+         * @param tiff the open TIFF file.
+         * @returns the state of the file.
+         */
+        tiff_map::iterator
+        addTIFF(const boost::filesystem::path&           id,
+                std::shared_ptr<ome::files::tiff::TIFF>& tiff) const;
+
+        /**
+         * Make the file of the current series the current file.
+         *
+         * When writing series in parallel, the first series is
+         * written to the dataset file, and each following series to
+         * a staging file, created when the series is first set.
+         */
+        void
+        selectSeriesFile() const;
+
+        /**
+         * Concatenate the staging files into the dataset file.
+         *
+         * The IFDs of each staging file are chained after those of
+         * the dataset file in series order, copying the tile and
+         * strip data without decoding it, and the plane state is
+         * updated to refer to the IFDs in the dataset file.  The
+         * staging files are then removed.
+         */
+        void
+        mergeSeriesFiles();
+
+        /**
+         * Close and remove the staging files.
+         */
+        void
+        removeSeriesFiles();
+
+        /**
+         * Run a task using the TIFF file of the specified state.
+         *
+         * The task is queued if writing files in parallel or
+         * asynchronously, or else run immediately.
+         *
+         * @param state the TIFF state.
+         * @param task the task to run.
+         */
+        void
+        submit(TIFFState&                          state,
+               const detail::TaskQueue::task_type& task) const;
+
+        /**
+         * Wait for all queued writes to complete.
+         *
+         * @param stop @c true to also stop the writer threads.
+         * @throws the exception thrown by the first failed write, if
+         * any.
+         */
+        void
+        waitQueues(bool stop) const;
+
+        /// Flush current IFD (if set up) and create new IFD.
         void
         nextIFD() const;
 
+        /**
+         * Determine the IFD parameters for the current series and
+         * plane.
+         *
+         * @returns the parameters.
+         */
+        IFDParameters
+        getIFDParameters() const;
+
         /// Set IFD parameters for the current series.
         void
         setupIFD() const;
 
+        /**
+         * Set IFD parameters for the current series, unless already
+         * set.
+         *
+         * The current IFD is only set up when pixel data are first
+         * written to it, so that changing the current file, series or
+         * plane does not leave empty IFDs behind.
+         */
+        void
+        prepareIFD() const;
+
+        /**
+         * Write all IFDs of a preallocated file.
+         *
+         * Every plane of every series is laid out in turn with
+         * zero-filled pixel data, and the offsets of its tiles or
+         * strips are recorded for saving pixel data directly.
+         */
+        void
+        preallocateLayout();
+
+        /**
+         * Save a region of a plane to a preallocated file.
+         *
+         * @param plane the plane index within the current series.
+         * @param buf the source pixel buffer.
+         * @param x the @c X coordinate of the upper-left corner of the sub-image.
+         * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+         * @param w the width of the sub-image.
+         * @param h the height of the sub-image.
+         */
+        void
+        saveLayoutBytes(dimension_size_type       plane,
+                        const VariantPixelBuffer& buf,
+                        dimension_size_type       x,
+                        dimension_size_type       y,
+                        dimension_size_type       w,
+                        dimension_size_type       h);
+
+        /**
+         * Save a tile or strip to a preallocated file.
+         *
+         * @param plane the plane index within the current series.
+         * @param tile the tile index within the plane.
+         * @param data the tile data.
+         * @param size the size of @c data in bytes.
+         */
+        void
+        saveLayoutTile(dimension_size_type plane,
+                       dimension_size_type tile,
+                       const uint8_t       *data,
+                       dimension_size_type size);
+
+        /**
+         * Get the layout of a plane in a preallocated file.
+         *
+         * @param plane the plane index within the current series.
+         * @returns the plane layout.
+         * @throws FormatException if the plane index is invalid.
+         */
+        const PlaneLayout&
+        getLayout(dimension_size_type plane) const;
+
       public:
         // Documented in superclass.
         void
@@ -200,6 +515,132 @@ namespace ome
                   dimension_size_type w,
                   dimension_size_type h);
 
+        // Documented in superclass.
+        void
+        saveBytes(dimension_size_type  plane,
+                  VariantPixelBuffer&& buf,
+                  dimension_size_type  x,
+                  dimension_size_type  y,
+                  dimension_size_type  w,
+                  dimension_size_type  h);
+
+        // Documented in superclass.
+        void
+        saveBytes(dimension_size_type            plane,
+                  const VariantPixelBufferView& buf,
+                  dimension_size_type            x,
+                  dimension_size_type            y,
+                  dimension_size_type            w,
+                  dimension_size_type            h);
+
+        /**
+         * @copydoc files::FormatWriter::saveBytesStack()
+         *
+         * With a preallocated layout (see setPreallocatedLayout()), the
+         * position of every plane in the file is fixed, so the
+         * planes of the stack are written concurrently using up to
+         * getWriteThreads() threads.  Otherwise each plane is saved
+         * in turn, with its tiles encoded in parallel.
+         */
+        void
+        saveBytesStack(dimension_size_type series,
+                       const plane_range&  zRange,
+                       const plane_range&  cRange,
+                       const plane_range&  tRange,
+                       VariantPixelBuffer& buf);
+
+        // Documented in superclass.
+        void
+        saveRawTile(dimension_size_type plane,
+                    dimension_size_type tile,
+                    const uint8_t       *data,
+                    dimension_size_type size);
+
+        // Documented in superclass.
+        void
+        saveTile(dimension_size_type       plane,
+                 dimension_size_type       tile,
+                 const VariantPixelBuffer& buf);
+
+        /**
+         * Get a handle for a file.
+         *
+         * The file is opened as if by setId() if not already open,
+         * and becomes the current file.  The handle may then be
+         * passed to setCurrentFile() to switch between files without
+         * the path handling performed by setId().  Handles are valid
+         * until close().
+         *
+         * @param id the file to open.
+         * @returns the handle.
+         */
+        dimension_size_type
+        getFileHandle(const boost::filesystem::path& id);
+
+        /**
+         * Set the current file, series and plane.
+         *
+         * This is equivalent to setId(), setSeries() and setPlane(),
+         * but addresses the file by a handle from getFileHandle().
+         *
+         * @param handle the file handle.
+         * @param series the series to activate.
+         * @param plane the plane to activate.
+         * @throws FormatException if the handle is invalid.
+         */
+        void
+        setCurrentFile(dimension_size_type handle,
+                       dimension_size_type series,
+                       dimension_size_type plane);
+
+        /**
+         * Write compact directories.
+         *
+         * Intended for files containing many small planes, where the
+         * directories are a large part of the file and of the time
+         * taken to write it.  When enabled, the IFD parameters are
+         * determined from the metadata once for each series and
+         * channel and reused for every plane, rather than for every
+         * plane, so later changes to the tile size, compression or
+         * codec parameters have no effect on series already started.
+         * The Software tag is only written to the first directory of
+         * each file.  This only has an effect on files opened after
+         * it is set.  Disabled by default.
+         *
+         * @param compact @c true to write compact directories, @c
+         * false to write complete directories.
+         */
+        void
+        setCompactDirectories(bool compact);
+
+        /**
+         * Check if compact directories are written.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getCompactDirectories() const;
+
+        /**
+         * Map an image plane for writing in place.
+         *
+         * This requires a preallocated layout (see
+         * setPreallocatedLayout()) and a stripped plane, since the
+         * strips of a plane are stored contiguously in the file
+         * while tiles are not.  The buffer uses the native byte
+         * order of the file, and is only valid until close().
+         *
+         * @param plane the plane index within the series.
+         * @param buf the buffer to refer to the plane.
+         * @throws std::runtime_error if the layout is not
+         * preallocated.
+         * @throws FormatException if the plane is tiled or is not
+         * stored contiguously.
+         */
+        void
+        mapBytes(dimension_size_type plane,
+                 VariantPixelBuffer& buf);
+
       private:
         /**
          * Fill MetadataStore with cached metadata.
@@ -209,14 +650,32 @@ namespace ome
         void
         fillMetadata();
 
+        /**
+         * Estimate the size of the OME-XML text to be embedded.
+         *
+         * The estimate is deliberately generous, to allow for the
+         * TiffData elements added when the writer is closed.
+         *
+         * @returns the estimated size, in bytes.
+         */
+        dimension_size_type
+        estimateOMEXMLSize() const;
+
         /**
          * Get OME-XML for embedding into the specified TIFF file.
          *
+         * The OME-XML is validated according to the OME-XML
+         * validation policy.  Unless a companion file is used, the
+         * root UUID of the metadata is set to the UUID of the TIFF.
+         *
          * @param id the TIFF in which to embed the OME-XML.
+         * @param first @c true if this is the first TIFF of the
+         * dataset, @c false otherwise.
          * @returns the OME-XML text for embedding.
          */
         std::string
-        getOMEXML(const boost::filesystem::path& id);
+        getOMEXML(const boost::filesystem::path& id,
+                  bool                           first = true);
 
         /**
          * Save OME-XML text in the first IFD of the specified TIFF file.
@@ -228,6 +687,48 @@ namespace ome
         saveComment(const boost::filesystem::path& id,
                     const std::string&             xml);
 
+        /**
+         * Save the complete OME-XML metadata in the companion file.
+         *
+         * A new UUID is generated for the companion file, to be
+         * referenced by the BinaryOnly element embedded in each TIFF
+         * file.
+         */
+        void
+        saveCompanion();
+
+        /**
+         * Get the OME-XML metadata for modification.
+         *
+         * Metadata shared with the caller are copied the first time
+         * they are modified, unless they may be modified in place.
+         *
+         * @returns the OME-XML metadata.
+         */
+        ::ome::xml::meta::OMEXMLMetadata&
+        writableMetadata();
+
+        /**
+         * Open an existing TIFF file for appending.
+         *
+         * The OME-XML embedded in the first IFD is parsed to mark the
+         * planes already stored in the file as written, so that they
+         * are retained in the TiffData elements saved on close.  New
+         * IFDs are added following the existing IFDs.
+         *
+         * @param id the TIFF file to append to.
+         * @param uuid the UUID of the existing file (without the
+         * @c urn:uuid: prefix).
+         * @param ifdCount the number of existing IFDs.
+         * @returns the TIFF, opened for appending.
+         * @throws FormatException if the existing file can not be
+         * appended to using the current metadata.
+         */
+        std::shared_ptr<ome::files::tiff::TIFF>
+        openAppend(const boost::filesystem::path& id,
+                   std::string&                   uuid,
+                   dimension_size_type&           ifdCount);
+
         // Java getUUID unimplemented; see uuid member of TIFFState.
 
         // Java planeCount() unimplemented; use getImageCount()
@@ -247,6 +748,538 @@ namespace ome
          */
         boost::optional<bool>
         getBigTIFF() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::setWriteCacheLimit(dimension_size_type)
+         */
+        void
+        setWriteCacheLimit(dimension_size_type limit);
+
+        /**
+         * @copydoc MinimalTIFFWriter::getWriteCacheLimit() const
+         */
+        dimension_size_type
+        getWriteCacheLimit() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::setStreamingWrites(dimension_size_type)
+         *
+         * @note Pixel data written in place with a preallocated
+         * layout (see setPreallocatedLayout()) is not released.
+         */
+        void
+        setStreamingWrites(dimension_size_type window);
+
+        /**
+         * @copydoc MinimalTIFFWriter::getStreamingWrites() const
+         */
+        dimension_size_type
+        getStreamingWrites() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::setSparseTiles(bool)
+         *
+         * @note Tiles are always written with a preallocated layout
+         * (see setPreallocatedLayout()).
+         */
+        void
+        setSparseTiles(bool sparse);
+
+        /**
+         * @copydoc MinimalTIFFWriter::getSparseTiles() const
+         */
+        bool
+        getSparseTiles() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::setTileDeduplication(dimension_size_type)
+         *
+         * @note Tiles are not deduplicated with a preallocated
+         * layout (see setPreallocatedLayout()).  Each file has a
+         * separate index.
+         */
+        void
+        setTileDeduplication(dimension_size_type limit);
+
+        /**
+         * @copydoc MinimalTIFFWriter::getTileDeduplication() const
+         */
+        dimension_size_type
+        getTileDeduplication() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::setStatistics(std::shared_ptr<PixelStatistics>)
+         */
+        void
+        setStatistics(std::shared_ptr<PixelStatistics> sink);
+
+        /**
+         * @copydoc MinimalTIFFWriter::getStatistics() const
+         */
+        const std::shared_ptr<PixelStatistics>&
+        getStatistics() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::setTileSummaries(bool)
+         */
+        void
+        setTileSummaries(bool summaries);
+
+        /**
+         * @copydoc MinimalTIFFWriter::getTileSummaries() const
+         */
+        bool
+        getTileSummaries() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::setTilingPolicy(tiff::TilingPolicy, dimension_size_type)
+         */
+        void
+        setTilingPolicy(tiff::TilingPolicy  policy,
+                        dimension_size_type chunkSize = 0U);
+
+        /**
+         * @copydoc MinimalTIFFWriter::getTilingPolicy() const
+         */
+        tiff::TilingPolicy
+        getTilingPolicy() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::getTilingChunkSize() const
+         */
+        dimension_size_type
+        getTilingChunkSize() const;
+
+        /**
+         * @copydoc MinimalTIFFWriter::setCodecParameters(const tiff::CodecParameters&)
+         */
+        void
+        setCodecParameters(const tiff::CodecParameters& params);
+
+        /**
+         * @copydoc MinimalTIFFWriter::getCodecParameters() const
+         */
+        const tiff::CodecParameters&
+        getCodecParameters() const;
+
+        /**
+         * Reserve space for the OME-XML text in the first IFD.
+         *
+         * By default, the OME-XML text is appended to the end of
+         * each TIFF file on close, and the first IFD is patched to
+         * refer to it.  If reservation is enabled, a padded
+         * placeholder ImageDescription is written with the first
+         * IFD, and the OME-XML text is written in its place on
+         * close if it fits, keeping the text ahead of the pixel
+         * data.  If the text does not fit, it is appended as usual.
+         *
+         * @param reserve @c true to reserve space, @c false to
+         * append on close.
+         */
+        void
+        setReserveOMEXML(bool reserve = true);
+
+        /**
+         * Get whether space is reserved for the OME-XML text.
+         *
+         * @returns @c true if space is reserved, @c false otherwise.
+         */
+        bool
+        getReserveOMEXML() const;
+
+        /**
+         * Set the number of sub-resolutions to write.
+         *
+         * If set, each plane is written as a pyramid: the
+         * full-resolution image is followed by the specified number
+         * of sub-resolutions, each downsampled by a factor of two
+         * from the preceding resolution, and stored as SubIFDs of
+         * the plane's IFD.  The sub-resolutions are generated
+         * incrementally as the full-resolution tiles are written,
+         * so only a few rows of tiles are held in memory for each
+         * level.  Strips, if used, must contain an even number of
+         * rows.
+         *
+         * @see ome::files::tiff::TIFF::setSubResolutions()
+         *
+         * @param levels the number of sub-resolutions, or @c 0 for
+         * none (the default).
+         * @param method the downsampling method.
+         */
+        void
+        setSubResolutions(dimension_size_type levels,
+                          tiff::Downsampling  method = tiff::DOWNSAMPLE_MEAN);
+
+        /**
+         * Get the number of sub-resolutions to write.
+         *
+         * @returns the number of sub-resolutions, or @c 0 for none.
+         */
+        dimension_size_type
+        getSubResolutions() const;
+
+        /**
+         * Get the sub-resolution downsampling method.
+         *
+         * @returns the downsampling method.
+         */
+        tiff::Downsampling
+        getDownsampling() const;
+
+        /**
+         * Set the OME-XML validation policy.
+         *
+         * The OME-XML text is validated when the writer is closed,
+         * before it is embedded in each TIFF.  Full schema
+         * validation of large documents may take much of the time
+         * spent in close().  @c OMEXML_VALIDATE_FIRST validates
+         * only the document for the first TIFF of a multi-file
+         * dataset, @c OMEXML_VALIDATE_STRUCTURE only checks the
+         * Image, Pixels, Channel and TiffData structure, and @c
+         * OMEXML_VALIDATE_NONE disables validation.  The default is
+         * @c OMEXML_VALIDATE_ALL.
+         *
+         * @param policy the validation policy.
+         */
+        void
+        setOMEXMLValidation(OMEXMLValidationPolicy policy);
+
+        /**
+         * Get the OME-XML validation policy.
+         *
+         * @returns the validation policy.
+         */
+        OMEXMLValidationPolicy
+        getOMEXMLValidation() const;
+
+        /**
+         * Write each TIFF file from a separate thread.
+         *
+         * When enabled, each TIFF file of a dataset split across
+         * several files is written by its own thread, fed from a
+         * bounded queue, so that writing to several files is not
+         * serialised.  The pixel data passed to saveBytes(),
+         * saveTile() and saveRawTile() is copied, and the write is
+         * completed asynchronously; errors are reported by a later
+         * call writing to the same file, or by close().  The OME-XML
+         * metadata and UUIDs are written by close() once all the
+         * writer threads are done.  Pixel statistics are not
+         * supported.  The queue for each file holds up to
+         * getWriteQueueDepth() pending writes, or a small default
+         * number if unset.  This only has an effect on files opened
+         * after it is set.  Disabled by default.
+         *
+         * @param parallel @c true to write files in parallel, @c
+         * false to write them from the calling thread.
+         */
+        void
+        setParallelFiles(bool parallel);
+
+        /**
+         * Check if TIFF files are written in parallel.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getParallelFiles() const;
+
+        /**
+         * Write the series of a single file in parallel.
+         *
+         * A TIFF file is written sequentially, so the series of a
+         * multi-series dataset written to a single file are normally
+         * encoded and written one after another.  When enabled, the
+         * first series is written to the dataset file and each
+         * following series to its own staging file in the same
+         * directory, each by its own thread fed from a bounded queue
+         * as for setParallelFiles(), so that series are encoded
+         * concurrently.  Series may also be set in any order, and
+         * each resumes at its current plane, so that the planes,
+         * regions and tiles of several series may be interleaved,
+         * for example as the wells of a plate are acquired.  The
+         * writer is not thread-safe: threads producing different
+         * series must serialise their calls.  On close(), the IFDs of
+         * the staging files are concatenated after those of the
+         * dataset file, copying the compressed tile and strip data
+         * without decoding it, and the staging files are removed.
+         * The resulting file has the layout described for
+         * setCloudOptimized(), and needs space for a second copy of
+         * the pixel data while it is made.  All series must be
+         * written to a single file.  Pixel statistics, a
+         * preallocated layout and appending are not supported.  This
+         * may not be changed while a file is open.  Disabled by
+         * default.
+         *
+         * @param parallel @c true to write series in parallel, @c
+         * false to write them to the dataset file in turn.
+         * @throws std::logic_error if a file is open.
+         */
+        void
+        setParallelSeries(bool parallel);
+
+        /**
+         * Check if series are written in parallel.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getParallelSeries() const;
+
+        /**
+         * Preallocate the file layout.
+         *
+         * For uncompressed data, the size and position of every tile
+         * or strip is known in advance.  When enabled, all the IFDs
+         * of every series are written when the file is opened with
+         * setId(), with zero-filled pixel data, so the file is
+         * allocated in full.  saveBytes(), saveTile() and
+         * saveRawTile() then write the pixel data directly to its
+         * final position in the file.  Planes and regions may be
+         * written in any order, and concurrently from several
+         * threads provided that the current series is not changed
+         * at the same time.  setSeries() and setPlane() do not
+         * write any IFDs in this mode.
+         *
+         * All series must be written to a single file.  Compression,
+         * BIT pixels, pixel statistics, tile summaries,
+         * sub-resolutions and writing files in parallel are not
+         * supported, and the write queue is not used.  Stripped
+         * planes may also be mapped into memory with mapBytes().
+         * This only has an effect on files opened after it is set.
+         * Disabled by default.
+         *
+         * @param preallocate @c true to preallocate the layout, @c
+         * false to write each IFD as it is completed.
+         */
+        void
+        setPreallocatedLayout(bool preallocate);
+
+        /**
+         * Check if the file layout is preallocated.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getPreallocatedLayout() const;
+
+        /**
+         * Write a cloud-optimized layout.
+         *
+         * By default, the IFDs are spread through each TIFF file,
+         * each following the pixel data of its plane, and the
+         * OME-XML text is usually appended to the end of the file on
+         * close.  A reader of a remote file must then make many
+         * small range requests before it can decode any pixel data.
+         * When enabled, each TIFF file is rewritten on close with
+         * all the IFDs, SubIFDs and tag data, including the OME-XML
+         * text, at the start of the file, followed by the tile and
+         * strip data grouped by resolution, from the smallest
+         * sub-resolution to the full resolution, and then by plane,
+         * with the tiles of each plane in row-major order.  Opening
+         * the file then needs one or two range requests.  The
+         * rewrite copies the pixel data without decoding it, but
+         * needs space for a second copy of each file while it is
+         * made.  EXIF and GPS directories are not supported.  This
+         * only has an effect if set before the writer is closed.
+         * Disabled by default.
+         *
+         * @param cloud @c true to rewrite each file with a
+         * cloud-optimized layout, @c false to leave the layout as
+         * written.
+         */
+        void
+        setCloudOptimized(bool cloud);
+
+        /**
+         * Check if a cloud-optimized layout is written.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getCloudOptimized() const;
+
+        /**
+         * Set the companion metadata file.
+         *
+         * By default, the complete OME-XML metadata are embedded in
+         * every TIFF file written.  When a companion file is set,
+         * the metadata are instead written once to the companion
+         * file when the writer is closed, and each TIFF file only
+         * embeds a small OME-XML document with a BinaryOnly element
+         * referring to the companion file.  This avoids repeating
+         * the metadata for datasets split across many files.  The
+         * companion file must have a @c .companion.ome suffix, and
+         * should be in the same directory as the TIFF files, since
+         * the TIFF file names in the metadata are relative to it.
+         * This only has an effect if set before the writer is
+         * closed.  Unset by default.
+         *
+         * @param companion the companion file, or an empty path to
+         * embed the metadata in every TIFF file.
+         * @throws FormatException if the suffix is not valid.
+         */
+        void
+        setCompanionFile(const boost::filesystem::path& companion);
+
+        /**
+         * Get the companion metadata file.
+         *
+         * @returns the companion file, or an empty path if the
+         * metadata are embedded in every TIFF file.
+         */
+        const boost::filesystem::path&
+        getCompanionFile() const;
+
+        /**
+         * Replace the OME-XML metadata of an existing OME-TIFF file.
+         *
+         * The pixel data are not read or rewritten.  The new OME-XML
+         * text overwrites the existing text in the first IFD if it
+         * fits, or else is appended to the end of the file and the
+         * ImageDescription tag is updated to refer to it, so the cost
+         * is independent of the size of the file.  The UUID and
+         * TiffData elements of the existing file are kept, so the
+         * metadata may be used to change channel names, annotations,
+         * physical sizes and the like, but must describe the same
+         * images with the same dimensions and pixel types.  The
+         * OME-XML is validated according to the OME-XML validation
+         * policy.  The writer must not have a file open.
+         *
+         * @param id the OME-TIFF file to update.
+         * @param retrieve the replacement metadata.
+         * @throws std::logic_error if a file is open for writing.
+         * @throws FormatException if the file is not a valid OME-TIFF
+         * file or the images in the metadata differ.
+         */
+        void
+        updateMetadata(const boost::filesystem::path&            id,
+                       const ::ome::xml::meta::MetadataRetrieve& retrieve);
+
+        /**
+         * Append to existing files.
+         *
+         * When enabled, a file which already exists is not replaced.
+         * Its planes are kept, new planes are written to IFDs added
+         * after the existing IFDs, and only the OME-XML text in the
+         * first IFD is rewritten when the writer is closed, so the
+         * cost of extending a file is proportional to the data added
+         * rather than the size of the file.  The metadata set for
+         * writing must describe the complete image, for example with
+         * a larger SizeT to add timepoints, and the existing planes
+         * must have the same size and pixel type and lie within it.
+         * Only files holding a complete single-file dataset may be
+         * appended to.  An existing TIFF file can not be converted
+         * to BigTIFF, so appending fails if BigTIFF would be needed
+         * and the file is not already a BigTIFF file.  Appending is
+         * not supported with a preallocated layout or a companion
+         * file.  This only has an effect on files opened after it is
+         * set.  Disabled by default.
+         *
+         * @param append @c true to append to existing files, @c
+         * false to replace them.
+         */
+        void
+        setAppend(bool append);
+
+        /**
+         * Check if existing files are appended to.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getAppend() const;
+
+        /**
+         * Pack samples into their significant bits.
+         *
+         * When enabled, UINT8 and UINT16 samples are stored with a
+         * TIFF BitsPerSample of the Pixels SignificantBits in the
+         * metadata, for example 12 bits for a 12-bit camera, packed
+         * with no padding between samples.  This reduces the size of
+         * the pixel data (before any compression) in proportion to
+         * the unused bits.  Samples are packed when written and
+         * unpacked when read, so the pixel type of the data is
+         * unchanged.  Other pixel types, and significant bits which
+         * would not fit the next smaller pixel type (fewer than 9
+         * for UINT16, or fewer than 2 for UINT8), are stored
+         * unpacked.  Packing is not supported with sub-resolutions
+         * or a preallocated layout.  Disabled by default.
+         *
+         * @param packed @c true to pack samples, @c false to store
+         * them in whole bytes.
+         */
+        void
+        setPackedSamples(bool packed);
+
+        /**
+         * Check if samples are packed into their significant bits.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getPackedSamples() const;
+
+        /**
+         * Store FLOAT samples as half precision.
+         *
+         * When enabled, FLOAT samples are stored as 16-bit IEEE 754
+         * half precision floating point values (TIFF SampleFormat
+         * IEEEFP with a BitsPerSample of 16), halving the size of
+         * the pixel data.  Samples are converted when written and
+         * converted back to FLOAT when read, so the pixel type of
+         * the data is unchanged.  Conversion is lossy: values are
+         * rounded to 11 significant bits, and values of magnitude
+         * above 65504 become infinities.  Other pixel types are not
+         * affected.  Half precision is not supported with
+         * sub-resolutions or a preallocated layout.  Disabled by
+         * default.
+         *
+         * @param half @c true to store half precision samples, @c
+         * false to store FLOAT samples unchanged.
+         */
+        void
+        setHalfFloat(bool half);
+
+        /**
+         * Check if FLOAT samples are stored as half precision.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getHalfFloat() const;
+
+        /**
+         * Modify the caller's OME-XML metadata in place.
+         *
+         * If the metadata set with setMetadataRetrieve() are an
+         * OMEXMLMetadata instance, the writer uses them directly
+         * rather than converting them into a new OMEXMLMetadata
+         * instance in setId(), so that the cost of setting up the
+         * writer does not depend upon the size of the metadata.  When
+         * the files are closed, the writer removes any BinData and
+         * TiffData elements and adds its own TiffData and UUID
+         * elements; by default the metadata are copied at this point
+         * (or earlier, if inconsistent metadata must be corrected),
+         * leaving the caller's metadata unchanged.  When enabled, the
+         * caller's metadata are modified in place and never copied,
+         * which avoids doubling the memory used for very large
+         * metadata; they should not be used by other writers at the
+         * same time.  Other MetadataRetrieve implementations are
+         * always converted.  Disabled by default.
+         *
+         * @param share @c true to modify the caller's metadata, @c
+         * false to copy them before modification.
+         */
+        void
+        setShareMetadata(bool share);
+
+        /**
+         * Check if the caller's OME-XML metadata are modified in place.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getShareMetadata() const;
       };
 
     }
@@ -0,0 +1,772 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/FormatException.h>
+#include <ome/files/FormatTools.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/VariantPixelBufferView.h>
+#include <ome/files/out/OMEZarrWriter.h>
+
+#include <ome/xml/meta/Convert.h>
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+using ome::files::detail::WriterProperties;
+using ome::xml::meta::MetadataRetrieve;
+using ome::xml::meta::OMEXMLMetadata;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace out
+    {
+
+      namespace
+      {
+
+        WriterProperties
+        zarr_properties()
+        {
+          WriterProperties p("OME-Zarr",
+                             "OME Next-Generation File Format (Zarr)");
+
+          p.suffixes = {"ome.zarr", "zarr"};
+
+          const std::set<std::string> codecset = {"default", "zlib", "bz2"};
+          p.compression_types = codecset;
+          const PixelType::value_map_type& pv = PixelType::values();
+          for (PixelType::value_map_type::const_iterator i = pv.begin();
+               i != pv.end();
+               ++i)
+            p.pixel_compression_types.insert(WriterProperties::pixel_compression_type_map::value_type(i->first, codecset));
+
+          return p;
+        }
+
+        const WriterProperties&
+        props()
+        {
+          static const WriterProperties p(zarr_properties());
+          return p;
+        }
+
+        // Default compression levels.
+        const int default_zlib_level = 6;
+        const int default_bz2_level = 9;
+
+        // Zarr data type of a pixel type, in native byte order.
+        std::string
+        zarrDataType(PixelType pixeltype)
+        {
+          const char endian =
+            boost::endian::order::native == boost::endian::order::little ? '<' : '>';
+          std::string type;
+
+          switch(pixeltype)
+            {
+            case PixelType::INT8:
+              return "|i1";
+            case PixelType::UINT8:
+              return "|u1";
+            case PixelType::BIT:
+              return "|b1";
+            case PixelType::INT16:
+              type = "i2";
+              break;
+            case PixelType::INT32:
+              type = "i4";
+              break;
+            case PixelType::UINT16:
+              type = "u2";
+              break;
+            case PixelType::UINT32:
+              type = "u4";
+              break;
+            case PixelType::FLOAT:
+              type = "f4";
+              break;
+            case PixelType::DOUBLE:
+              type = "f8";
+              break;
+            case PixelType::COMPLEXFLOAT:
+              type = "c8";
+              break;
+            case PixelType::COMPLEXDOUBLE:
+              type = "c16";
+              break;
+            default:
+              {
+                boost::format fmt("Unsupported pixel type ‘%1%’");
+                fmt % pixeltype;
+                throw FormatException(fmt.str());
+              }
+            }
+
+          return endian + type;
+        }
+
+        // Quote a string for JSON.
+        std::string
+        jsonString(const std::string& text)
+        {
+          std::string quoted("\"");
+          for (const char c : text)
+            {
+              switch (c)
+                {
+                case '"':
+                  quoted += "\\\"";
+                  break;
+                case '\\':
+                  quoted += "\\\\";
+                  break;
+                case '\n':
+                  quoted += "\\n";
+                  break;
+                case '\r':
+                  quoted += "\\r";
+                  break;
+                case '\t':
+                  quoted += "\\t";
+                  break;
+                default:
+                  if (static_cast<unsigned char>(c) < 0x20U)
+                    {
+                      boost::format fmt("\\u%04x");
+                      fmt % static_cast<unsigned int>(c);
+                      quoted += fmt.str();
+                    }
+                  else
+                    quoted += c;
+                }
+            }
+          quoted += '"';
+          return quoted;
+        }
+
+        void
+        writeFile(const boost::filesystem::path& path,
+                  const char                    *data,
+                  std::size_t                    size)
+        {
+          boost::filesystem::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+          if (out)
+            out.write(data, static_cast<std::streamsize>(size));
+          if (out)
+            out.close();
+          if (!out)
+            {
+              boost::format fmt("Failed to write ‘%1%’");
+              fmt % path.string();
+              throw FormatException(fmt.str());
+            }
+        }
+
+        void
+        writeFile(const boost::filesystem::path& path,
+                  const std::string&             text)
+        {
+          writeFile(path, text.data(), text.size());
+        }
+
+        void
+        createGroup(const boost::filesystem::path& path,
+                    const std::string&             attributes)
+        {
+          boost::system::error_code ec;
+          boost::filesystem::create_directories(path, ec);
+          if (!boost::filesystem::is_directory(path))
+            {
+              boost::format fmt("Failed to create Zarr group ‘%1%’");
+              fmt % path.string();
+              throw FormatException(fmt.str());
+            }
+          writeFile(path / ".zgroup", "{\n  \"zarr_format\": 2\n}\n");
+          writeFile(path / ".zattrs", attributes);
+        }
+
+        // Samples of all channels of a series.
+        dimension_size_type
+        seriesSamples(const MetadataRetrieve& meta,
+                      dimension_size_type     series)
+        {
+          dimension_size_type samples = 0U;
+          const dimension_size_type channels = meta.getChannelCount(series);
+          for (dimension_size_type c = 0U; c < channels; ++c)
+            {
+              dimension_size_type count = 1U;
+              try
+                {
+                  count = meta.getChannelSamplesPerPixel(series, c);
+                }
+              catch (const std::exception&)
+                {
+                }
+              samples += count;
+            }
+          return std::max(samples, dimension_size_type(1U));
+        }
+
+        dimension_size_type
+        nonzero(dimension_size_type size)
+        {
+          return size ? size : 1U;
+        }
+
+      }
+
+      OMEZarrWriter::OMEZarrWriter():
+        ::ome::files::detail::FormatWriter(props()),
+        chunkGeometry(),
+        pendingChunks(),
+        tilingPolicy(tiff::TILING_DEFAULT),
+        tilingChunkSize(0U),
+        codecParameters()
+      {
+      }
+
+      OMEZarrWriter::~OMEZarrWriter()
+      {
+        try
+          {
+            close();
+          }
+        catch (...)
+          {
+          }
+      }
+
+      void
+      OMEZarrWriter::setId(const boost::filesystem::path& id)
+      {
+        const boost::optional<boost::filesystem::path> previousId(currentId);
+        FormatWriter::setId(id);
+        if (previousId && previousId == currentId && !chunkGeometry.empty())
+          return;
+
+        // Complete the chunks of any previous dataset.
+        flushPendingChunks();
+
+        const boost::filesystem::path root(*currentId);
+        const boost::optional<std::string> compression(getCompression());
+        if (compression && !writerProperties.compression_types.count(*compression))
+          {
+            boost::format fmt("Unsupported compression ‘%1%’");
+            fmt % *compression;
+            throw FormatException(fmt.str());
+          }
+        const bool compressed = compression && *compression != "default";
+
+        const MetadataRetrieve& meta(*getMetadataRetrieve());
+        const dimension_size_type seriesCount = meta.getImageCount();
+        if (!seriesCount)
+          throw FormatException("No images to write");
+
+        // Root group and OME-XML metadata.
+        createGroup(root, "{\n  \"bioformats2raw.layout\": 3\n}\n");
+        {
+          std::ostringstream attrs;
+          attrs << "{\n  \"series\": [";
+          for (dimension_size_type series = 0U; series < seriesCount; ++series)
+            attrs << (series ? ", " : "") << '"' << series << '"';
+          attrs << "]\n}\n";
+          createGroup(root / "OME", attrs.str());
+
+          OMEXMLMetadata omexml;
+          convert(meta, omexml);
+          removeBinData(omexml);
+          removeTiffData(omexml);
+          omexml.resolveReferences();
+          for (dimension_size_type series = 0U; series < seriesCount; ++series)
+            addMetadataOnly(omexml, series, false);
+          writeFile(root / "OME" / "METADATA.ome.xml", getOMEXML(omexml));
+        }
+
+        // A multiscales group containing a single array per series.
+        chunkGeometry.clear();
+        for (dimension_size_type series = 0U; series < seriesCount; ++series)
+          {
+            const dimension_size_type sizeX = nonzero(meta.getPixelsSizeX(series));
+            const dimension_size_type sizeY = nonzero(meta.getPixelsSizeY(series));
+            const dimension_size_type sizeZ = nonzero(meta.getPixelsSizeZ(series));
+            const dimension_size_type sizeT = nonzero(meta.getPixelsSizeT(series));
+            const dimension_size_type sizeC = seriesSamples(meta, series);
+            const PixelType pixeltype(meta.getPixelsType(series));
+
+            // Explicit chunk size, or else the default geometry for
+            // the tiling policy.
+            tiff::TileGeometry geometry;
+            if (tile_size_x || tile_size_y)
+              {
+                geometry.type = tiff::TILE;
+                geometry.width = (tile_size_x && *tile_size_x) ? *tile_size_x : sizeX;
+                geometry.height = (tile_size_y && *tile_size_y) ? *tile_size_y : sizeY;
+              }
+            else
+              geometry = tiff::defaultTileGeometry(tilingPolicy, sizeX, sizeY, pixeltype, 1U,
+                                                   compressed ? tiff::COMPRESSION_ADOBE_DEFLATE : tiff::COMPRESSION_NONE,
+                                                   tilingChunkSize);
+            geometry.width = std::min(geometry.width, sizeX);
+            geometry.height = std::min(geometry.height, sizeY);
+            chunkGeometry.push_back(geometry);
+
+            std::string name;
+            try
+              {
+                name = meta.getImageName(series);
+              }
+            catch (const std::exception&)
+              {
+              }
+
+            const boost::filesystem::path group(root / std::to_string(series));
+            std::ostringstream attrs;
+            attrs << "{\n"
+                  << "  \"multiscales\": [\n"
+                  << "    {\n"
+                  << "      \"version\": \"0.4\",\n"
+                  << "      \"name\": " << jsonString(name) << ",\n"
+                  << "      \"axes\": [\n"
+                  << "        {\"name\": \"t\", \"type\": \"time\"},\n"
+                  << "        {\"name\": \"c\", \"type\": \"channel\"},\n"
+                  << "        {\"name\": \"z\", \"type\": \"space\"},\n"
+                  << "        {\"name\": \"y\", \"type\": \"space\"},\n"
+                  << "        {\"name\": \"x\", \"type\": \"space\"}\n"
+                  << "      ],\n"
+                  << "      \"datasets\": [\n"
+                  << "        {\n"
+                  << "          \"path\": \"0\",\n"
+                  << "          \"coordinateTransformations\": [\n"
+                  << "            {\"type\": \"scale\", \"scale\": [1.0, 1.0, 1.0, 1.0, 1.0]}\n"
+                  << "          ]\n"
+                  << "        }\n"
+                  << "      ]\n"
+                  << "    }\n"
+                  << "  ]\n"
+                  << "}\n";
+            createGroup(group, attrs.str());
+
+            std::ostringstream compressor;
+            if (!compressed)
+              compressor << "null";
+            else if (*compression == "zlib")
+              compressor << "{\"id\": \"zlib\", \"level\": "
+                         << (codecParameters.level ? *codecParameters.level : default_zlib_level) << "}";
+            else
+              compressor << "{\"id\": \"bz2\", \"level\": "
+                         << (codecParameters.level ? *codecParameters.level : default_bz2_level) << "}";
+
+            std::ostringstream array;
+            array << "{\n"
+                  << "  \"zarr_format\": 2,\n"
+                  << "  \"shape\": [" << sizeT << ", " << sizeC << ", " << sizeZ << ", "
+                  << sizeY << ", " << sizeX << "],\n"
+                  << "  \"chunks\": [1, 1, 1, " << geometry.height << ", " << geometry.width << "],\n"
+                  << "  \"dtype\": \"" << zarrDataType(pixeltype) << "\",\n"
+                  << "  \"compressor\": " << compressor.str() << ",\n"
+                  << "  \"fill_value\": " << (pixeltype == PixelType::BIT ? "false" : "0") << ",\n"
+                  << "  \"order\": \"C\",\n"
+                  << "  \"filters\": null,\n"
+                  << "  \"dimension_separator\": \"/\"\n"
+                  << "}\n";
+            boost::system::error_code ec;
+            boost::filesystem::create_directories(group / "0", ec);
+            writeFile(group / "0" / ".zarray", array.str());
+          }
+      }
+
+      void
+      OMEZarrWriter::close(bool fileOnly)
+      {
+        try
+          {
+            if (currentId)
+              flushPendingChunks();
+
+            pendingChunks.clear();
+            chunkGeometry.clear();
+
+            detail::FormatWriter::close(fileOnly);
+          }
+        catch (const std::exception&)
+          {
+            pendingChunks.clear();
+            chunkGeometry.clear();
+            detail::FormatWriter::close(fileOnly);
+            throw;
+          }
+      }
+
+      void
+      OMEZarrWriter::setSeries(dimension_size_type series) const
+      {
+        assertId(currentId, true);
+
+        if (series >= getSeriesCount())
+          {
+            boost::format fmt("Invalid series: %1%");
+            fmt % series;
+            throw std::logic_error(fmt.str());
+          }
+
+        this->series = series;
+        this->plane = 0U;
+      }
+
+      void
+      OMEZarrWriter::setPlane(dimension_size_type plane) const
+      {
+        assertId(currentId, true);
+
+        if (plane >= getImageCount())
+          {
+            boost::format fmt("Invalid plane: %1%");
+            fmt % plane;
+            throw std::logic_error(fmt.str());
+          }
+
+        this->plane = plane;
+      }
+
+      dimension_size_type
+      OMEZarrWriter::getTileSizeX() const
+      {
+        if (currentId && getSeries() < chunkGeometry.size())
+          return chunkGeometry[getSeries()].width;
+        return detail::FormatWriter::getTileSizeX();
+      }
+
+      dimension_size_type
+      OMEZarrWriter::getTileSizeY() const
+      {
+        if (currentId && getSeries() < chunkGeometry.size())
+          return chunkGeometry[getSeries()].height;
+        return detail::FormatWriter::getTileSizeY();
+      }
+
+      void
+      OMEZarrWriter::saveBytes(dimension_size_type plane,
+                               VariantPixelBuffer& buf,
+                               dimension_size_type x,
+                               dimension_size_type y,
+                               dimension_size_type w,
+                               dimension_size_type h)
+      {
+        assertId(currentId, true);
+
+        setPlane(plane);
+
+        const dimension_size_type sizeX = getSizeX();
+        const dimension_size_type sizeY = getSizeY();
+        const std::array<dimension_size_type, 3> coords(getZCTCoords(plane));
+        const dimension_size_type samples = getRGBChannelCount(coords[1]);
+        if (!w || !h || x + w > sizeX || y + h > sizeY)
+          {
+            boost::format fmt("Invalid region %1%×%2%+%3%+%4% for %5%×%6% plane");
+            fmt % w % h % x % y % sizeX % sizeY;
+            throw FormatException(fmt.str());
+          }
+        if (buf.pixelType() != getPixelType() ||
+            buf.shape()[DIM_SPATIAL_X] != w ||
+            buf.shape()[DIM_SPATIAL_Y] != h ||
+            buf.shape()[DIM_SUBCHANNEL] != samples ||
+            buf.num_elements() != w * h * samples)
+          throw FormatException("Pixel buffer type or shape does not match the region");
+
+        // Samples are stored as separate chunks, so use a planar
+        // copy of the buffer if it is interleaved.
+        const PixelBufferBase::storage_order_type planar
+          (PixelBufferBase::make_storage_order(DimensionOrder::XYZTC, false));
+        VariantPixelBuffer tmp;
+        const VariantPixelBuffer *source = &buf;
+        if (samples > 1U && !(buf.storage_order() == planar))
+          {
+            VariantPixelBufferView(buf).copyTo(tmp, planar);
+            source = &tmp;
+          }
+        const uint8_t *data = source->data();
+
+        const tiff::TileGeometry& geometry(chunkGeometry.at(getSeries()));
+        const dimension_size_type cw = geometry.width;
+        const dimension_size_type ch = geometry.height;
+        const dimension_size_type bpp = bytesPerPixel(getPixelType());
+
+        // Copy the part of the region within a chunk into the chunk.
+        auto copyToChunk = [&](std::vector<uint8_t>& chunk,
+                               dimension_size_type   sample,
+                               dimension_size_type   chunkX,
+                               dimension_size_type   chunkY)
+          {
+            const dimension_size_type x0 = std::max(x, chunkX * cw);
+            const dimension_size_type x1 = std::min(x + w, (chunkX + 1U) * cw);
+            const dimension_size_type y0 = std::max(y, chunkY * ch);
+            const dimension_size_type y1 = std::min(y + h, (chunkY + 1U) * ch);
+            const dimension_size_type rowBytes = (x1 - x0) * bpp;
+            for (dimension_size_type row = y0; row < y1; ++row)
+              std::memcpy(chunk.data() + ((((row - (chunkY * ch)) * cw) + (x0 - (chunkX * cw))) * bpp),
+                          data + (((((sample * h) + (row - y)) * w) + (x0 - x)) * bpp),
+                          static_cast<std::size_t>(rowBytes));
+            return (x1 - x0) * (y1 - y0);
+          };
+
+        // Chunks wholly within the region are filled and written
+        // directly; the region is added to other chunks, which are
+        // written once complete.
+        struct Chunk
+        {
+          boost::filesystem::path path;
+          dimension_size_type sample;
+          dimension_size_type chunkX;
+          dimension_size_type chunkY;
+          std::vector<uint8_t> data;
+        };
+        std::vector<Chunk> chunks;
+
+        for (dimension_size_type sample = 0U; sample < samples; ++sample)
+          for (dimension_size_type chunkY = y / ch; chunkY <= (y + h - 1U) / ch; ++chunkY)
+            for (dimension_size_type chunkX = x / cw; chunkX <= (x + w - 1U) / cw; ++chunkX)
+              {
+                const dimension_size_type chunkPixels =
+                  (std::min(sizeX, (chunkX + 1U) * cw) - (chunkX * cw)) *
+                  (std::min(sizeY, (chunkY + 1U) * ch) - (chunkY * ch));
+                const dimension_size_type regionPixels =
+                  (std::min(x + w, (chunkX + 1U) * cw) - std::max(x, chunkX * cw)) *
+                  (std::min(y + h, (chunkY + 1U) * ch) - std::max(y, chunkY * ch));
+
+                Chunk chunk;
+                chunk.path = chunkPath(plane, sample, chunkX, chunkY);
+                chunk.sample = sample;
+                chunk.chunkX = chunkX;
+                chunk.chunkY = chunkY;
+
+                if (regionPixels < chunkPixels)
+                  {
+                    const dimension_size_type chunksX = ((sizeX - 1U) / cw) + 1U;
+                    const chunk_key key = {{getSeries(), plane, sample, (chunkY * chunksX) + chunkX}};
+                    auto pending = pendingChunks.find(key);
+                    if (pending == pendingChunks.end())
+                      {
+                        PendingChunk p;
+                        p.path = chunk.path;
+                        p.data.assign(static_cast<std::vector<uint8_t>::size_type>(cw * ch * bpp), 0U);
+                        p.saved = 0U;
+                        pending = pendingChunks.insert(std::make_pair(key, std::move(p))).first;
+                      }
+                    pending->second.saved += copyToChunk(pending->second.data, sample, chunkX, chunkY);
+                    if (pending->second.saved < chunkPixels)
+                      continue;
+                    chunk.data.swap(pending->second.data);
+                    pendingChunks.erase(pending);
+                  }
+
+                chunks.push_back(std::move(chunk));
+              }
+
+        // Each chunk is an independent file, so chunks may be filled,
+        // compressed and written in parallel.
+        auto write = [&](Chunk& chunk)
+          {
+            if (chunk.data.empty())
+              {
+                chunk.data.assign(static_cast<std::vector<uint8_t>::size_type>(cw * ch * bpp), 0U);
+                copyToChunk(chunk.data, chunk.sample, chunk.chunkX, chunk.chunkY);
+              }
+            writeChunk(chunk.path, chunk.data);
+            std::vector<uint8_t>().swap(chunk.data);
+          };
+
+        const dimension_size_type nthreads =
+          std::min(static_cast<dimension_size_type>(getWriteThreads()),
+                   static_cast<dimension_size_type>(chunks.size()));
+        if (nthreads < 2U)
+          {
+            for (auto& chunk : chunks)
+              write(chunk);
+          }
+        else
+          {
+            getExecutor()->parallel(static_cast<unsigned int>(nthreads),
+                                    [&](unsigned int t)
+                                    {
+                                      for (dimension_size_type i = t; i < chunks.size(); i += nthreads)
+                                        {
+                                          if (const CancellationToken *cancel = CancellationToken::current())
+                                            cancel->check();
+                                          write(chunks[i]);
+                                        }
+                                    });
+          }
+      }
+
+      void
+      OMEZarrWriter::setTilingPolicy(tiff::TilingPolicy  policy,
+                                     dimension_size_type chunkSize)
+      {
+        tilingPolicy = policy;
+        tilingChunkSize = chunkSize;
+      }
+
+      tiff::TilingPolicy
+      OMEZarrWriter::getTilingPolicy() const
+      {
+        return tilingPolicy;
+      }
+
+      dimension_size_type
+      OMEZarrWriter::getTilingChunkSize() const
+      {
+        return tilingChunkSize;
+      }
+
+      void
+      OMEZarrWriter::setCodecParameters(const tiff::CodecParameters& params)
+      {
+        codecParameters = params;
+      }
+
+      const tiff::CodecParameters&
+      OMEZarrWriter::getCodecParameters() const
+      {
+        return codecParameters;
+      }
+
+      boost::filesystem::path
+      OMEZarrWriter::chunkPath(dimension_size_type plane,
+                               dimension_size_type sample,
+                               dimension_size_type chunkX,
+                               dimension_size_type chunkY) const
+      {
+        const std::array<dimension_size_type, 3> coords(getZCTCoords(plane));
+
+        // Subchannels of preceding channels are separate channels.
+        dimension_size_type channel = sample;
+        for (dimension_size_type c = 0U; c < coords[1]; ++c)
+          channel += getRGBChannelCount(c);
+
+        boost::filesystem::path path(*currentId / std::to_string(getSeries()) / "0");
+        path /= std::to_string(coords[2]);
+        path /= std::to_string(channel);
+        path /= std::to_string(coords[0]);
+        path /= std::to_string(chunkY);
+        path /= std::to_string(chunkX);
+        return path;
+      }
+
+      void
+      OMEZarrWriter::writeChunk(const boost::filesystem::path& path,
+                                const std::vector<uint8_t>&    data) const
+      {
+        const boost::optional<std::string> compression(getCompression());
+
+        std::vector<uint8_t> encoded;
+        const std::vector<uint8_t> *output = &data;
+        if (compression && *compression == "zlib")
+          {
+            // Zarr zlib chunks are the same as TIFF deflate strips,
+            // so a deflate codec plugin may be used.
+            std::shared_ptr<const tiff::CodecPlugin> plugin
+              (tiff::getCodecPlugin(tiff::COMPRESSION_ADOBE_DEFLATE));
+            tiff::CodecTile tile;
+            tile.scheme = tiff::COMPRESSION_ADOBE_DEFLATE;
+            tile.width = static_cast<uint32_t>(data.size());
+            tile.length = 1U;
+            tile.bits = 8U;
+            tile.samples = 1U;
+            tile.bigendian = boost::endian::order::native == boost::endian::order::big;
+            tile.parameters = codecParameters;
+            tile.parameters.predictor = boost::none;
+            if (plugin && plugin->encode && (!plugin->supports || plugin->supports(tile)))
+              plugin->encode(tile, data.data(), data.size(), encoded);
+            else
+              {
+                boost::iostreams::filtering_ostream out;
+                out.push(boost::iostreams::zlib_compressor
+                         (boost::iostreams::zlib_params(codecParameters.level ? *codecParameters.level : default_zlib_level)));
+                out.push(boost::iostreams::back_inserter(encoded));
+                out.write(reinterpret_cast<const char *>(data.data()),
+                          static_cast<std::streamsize>(data.size()));
+                out.reset();
+              }
+            output = &encoded;
+          }
+        else if (compression && *compression == "bz2")
+          {
+            boost::iostreams::filtering_ostream out;
+            out.push(boost::iostreams::bzip2_compressor
+                     (boost::iostreams::bzip2_params(codecParameters.level ? *codecParameters.level : default_bz2_level)));
+            out.push(boost::iostreams::back_inserter(encoded));
+            out.write(reinterpret_cast<const char *>(data.data()),
+                      static_cast<std::streamsize>(data.size()));
+            out.reset();
+            output = &encoded;
+          }
+
+        boost::system::error_code ec;
+        boost::filesystem::create_directories(path.parent_path(), ec);
+        writeFile(path, reinterpret_cast<const char *>(output->data()), output->size());
+      }
+
+      void
+      OMEZarrWriter::flushPendingChunks()
+      {
+        for (const auto& pending : pendingChunks)
+          writeChunk(pending.second.path, pending.second.data);
+        pendingChunks.clear();
+      }
+
+    }
+  }
+}
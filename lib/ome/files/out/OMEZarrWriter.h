@@ -0,0 +1,280 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_OUT_OMEZARRWRITER_H
+#define OME_FILES_OUT_OMEZARRWRITER_H
+
+#include <array>
+#include <map>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/detail/FormatWriter.h>
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/Util.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace out
+    {
+
+      /**
+       * OME-Zarr (OME-NGFF 0.4) writer.
+       *
+       * The dataset is a directory using the bioformats2raw layout:
+       * the OME-XML metadata for all series is stored in
+       * @c OME/METADATA.ome.xml, and each series is a multiscales
+       * group (@c 0, @c 1, …) holding a single full-resolution Zarr
+       * v2 array (@c 0/0).  Arrays have the NGFF @c TCZYX axes;
+       * subchannels are stored as separate channels, so that the C
+       * extent of the array is the real size of the C dimension.
+       * Physical sizes are not written to the coordinate
+       * transformations, which use a scale of 1; the OME-XML
+       * metadata remains authoritative.
+       *
+       * Each chunk is a single Y×X tile of one sample of one plane,
+       * stored as an independent file.  Chunks hence share no file
+       * state, and may be written in any order, in parallel by
+       * several threads (see setWriteThreads()), or by several
+       * processes each writing different planes or regions of the
+       * same dataset.  Unlike the TIFF writers, planes and series
+       * may be written in any order.  A chunk is written once all
+       * of its pixels have been saved; chunks which are only
+       * partly saved are held in memory and written, padded with
+       * zeros, when the writer is closed.  The regions saved must
+       * not overlap.
+       *
+       * The chunk size is set with setTileSizeX() and
+       * setTileSizeY(), or else chosen by the tiling policy as for
+       * TIFF strips and tiles.  Chunks may be uncompressed
+       * ("default"), or compressed with @c zlib or @c bz2.  A codec
+       * plugin registered for deflate compression (see
+       * tiff::registerCodecPlugin()) is used for @c zlib if present.
+       */
+      class OMEZarrWriter : public ::ome::files::detail::FormatWriter
+      {
+      protected:
+        /// A chunk awaiting the rest of its pixels.
+        struct PendingChunk
+        {
+          /// Chunk file.
+          boost::filesystem::path path;
+          /// Chunk pixel data.
+          std::vector<uint8_t> data;
+          /// Number of pixels saved.
+          dimension_size_type saved;
+        };
+
+        /// Pending chunk key: series, plane, sample and chunk index.
+        typedef std::array<dimension_size_type, 4> chunk_key;
+
+        /// Chunk size of each series.
+        std::vector<tiff::TileGeometry> chunkGeometry;
+
+        /// Chunks partly saved.
+        std::map<chunk_key, PendingChunk> pendingChunks;
+
+      private:
+        /// Default chunk geometry policy.
+        tiff::TilingPolicy tilingPolicy;
+
+        /// Target compressed chunk size for the tiling policy.
+        dimension_size_type tilingChunkSize;
+
+        /// Codec parameters.
+        tiff::CodecParameters codecParameters;
+
+      public:
+        /// Constructor.
+        OMEZarrWriter();
+
+        /// Destructor.
+        virtual
+        ~OMEZarrWriter();
+
+        // Documented in superclass.
+        void
+        setId(const boost::filesystem::path& id);
+
+        // Documented in superclass.
+        void
+        close(bool fileOnly = false);
+
+        /**
+         * Set the current series.
+         *
+         * Series may be set in any order.
+         *
+         * @param series the series to use.
+         * @throws std::logic_error if the series is invalid.
+         */
+        void
+        setSeries(dimension_size_type series) const;
+
+        /**
+         * Set the current plane.
+         *
+         * Planes may be set in any order.
+         *
+         * @param plane the plane to use.
+         * @throws std::logic_error if the plane is invalid.
+         */
+        void
+        setPlane(dimension_size_type plane) const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getTileSizeX() const;
+
+        // Documented in superclass.
+        dimension_size_type
+        getTileSizeY() const;
+
+        using FormatWriter::saveBytes;
+
+        // Documented in superclass.
+        void
+        saveBytes(dimension_size_type plane,
+                  VariantPixelBuffer& buf,
+                  dimension_size_type x,
+                  dimension_size_type y,
+                  dimension_size_type w,
+                  dimension_size_type h);
+
+        /**
+         * Set the default chunk geometry policy.
+         *
+         * The policy is used when the tile sizes have not been set
+         * explicitly with setTileSizeX() and setTileSizeY(); explicit
+         * tile sizes always take precedence.  The default is
+         * tiff::TILING_DEFAULT.
+         *
+         * @see ome::files::tiff::defaultTileGeometry()
+         *
+         * @param policy the tiling policy.
+         * @param chunkSize the target compressed chunk size in
+         * bytes, or @c 0 for the policy default.
+         */
+        void
+        setTilingPolicy(tiff::TilingPolicy  policy,
+                        dimension_size_type chunkSize = 0U);
+
+        /**
+         * Get the default chunk geometry policy.
+         *
+         * @returns the tiling policy.
+         */
+        tiff::TilingPolicy
+        getTilingPolicy() const;
+
+        /**
+         * Get the target compressed chunk size.
+         *
+         * @returns the chunk size in bytes, or @c 0 for the policy
+         * default.
+         */
+        dimension_size_type
+        getTilingChunkSize() const;
+
+        /**
+         * Set the codec parameters.
+         *
+         * Only the compression level is used: 1–9 for @c zlib and
+         * @c bz2 (the block size, in units of 100KiB).
+         *
+         * @param params the codec parameters.
+         */
+        void
+        setCodecParameters(const tiff::CodecParameters& params);
+
+        /**
+         * Get the codec parameters.
+         *
+         * @returns the codec parameters.
+         */
+        const tiff::CodecParameters&
+        getCodecParameters() const;
+
+      protected:
+        /**
+         * Get the path of a chunk of the current series.
+         *
+         * @param plane the plane index within the series.
+         * @param sample the sample (subchannel) of the plane.
+         * @param chunkX the chunk column.
+         * @param chunkY the chunk row.
+         * @returns the path of the chunk file.
+         */
+        boost::filesystem::path
+        chunkPath(dimension_size_type plane,
+                  dimension_size_type sample,
+                  dimension_size_type chunkX,
+                  dimension_size_type chunkY) const;
+
+        /**
+         * Compress and write a chunk.
+         *
+         * This is thread-safe, so that chunks may be written in
+         * parallel.
+         *
+         * @param path the path of the chunk file.
+         * @param data the chunk pixel data.
+         */
+        void
+        writeChunk(const boost::filesystem::path& path,
+                   const std::vector<uint8_t>&    data) const;
+
+        /// Write the pending chunks, padded with zeros.
+        void
+        flushPendingChunks();
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_OUT_OMEZARRWRITER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,601 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#include <ome/files/tiff/ByteSource.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/Util.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      namespace
+      {
+
+        void
+        checkRange(const ByteSource&   source,
+                   offset_type         sourcesize,
+                   offset_type         offset,
+                   dimension_size_type size)
+        {
+          if (offset > sourcesize || size > sourcesize - offset)
+            {
+              boost::format fmt("Read of %1% bytes at offset %2% is beyond the end of ‘%3%’ (%4% bytes)");
+              fmt % size % offset % source.name() % sourcesize;
+              throw Exception(fmt.str());
+            }
+        }
+
+      }
+
+      ByteSource::ByteSource()
+      {
+      }
+
+      ByteSource::~ByteSource()
+      {
+      }
+
+      FileByteSource::FileByteSource(const boost::filesystem::path& filename):
+        ByteSource(),
+        mutex(),
+        filename(filename),
+        stream(filename, std::ios::in | std::ios::binary),
+        filesize(0U)
+      {
+        boost::system::error_code ec;
+        boost::uintmax_t size = boost::filesystem::file_size(filename, ec);
+        if (!stream || ec)
+          {
+            boost::format fmt("Failed to open ‘%1%’");
+            fmt % filename.string();
+            throw Exception(fmt.str());
+          }
+        filesize = static_cast<offset_type>(size);
+      }
+
+      FileByteSource::~FileByteSource()
+      {
+      }
+
+      std::string
+      FileByteSource::name() const
+      {
+        return filename.string();
+      }
+
+      offset_type
+      FileByteSource::size() const
+      {
+        return filesize;
+      }
+
+      void
+      FileByteSource::read(offset_type         offset,
+                           void               *buf,
+                           dimension_size_type size) const
+      {
+        checkRange(*this, filesize, offset, size);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        stream.clear();
+        if (!stream.seekg(static_cast<std::streamoff>(offset)) ||
+            !stream.read(static_cast<char *>(buf), static_cast<std::streamsize>(size)))
+          {
+            boost::format fmt("Failed to read %1% bytes at offset %2% from ‘%3%’");
+            fmt % size % offset % filename.string();
+            throw Exception(fmt.str());
+          }
+      }
+
+      BufferByteSource::BufferByteSource(const void         *data,
+                                         dimension_size_type size,
+                                         const std::string&  name):
+        ByteSource(),
+        data(static_cast<const uint8_t *>(data)),
+        buffersize(size),
+        sourcename(name)
+      {
+        if (!data && size)
+          throw Exception("Null ByteSource buffer");
+      }
+
+      BufferByteSource::~BufferByteSource()
+      {
+      }
+
+      std::string
+      BufferByteSource::name() const
+      {
+        return sourcename;
+      }
+
+      offset_type
+      BufferByteSource::size() const
+      {
+        return buffersize;
+      }
+
+      void
+      BufferByteSource::read(offset_type         offset,
+                             void               *buf,
+                             dimension_size_type size) const
+      {
+        checkRange(*this, buffersize, offset, size);
+
+        if (size)
+          std::memcpy(buf, data + offset, size);
+      }
+
+      CachedByteSource::CachedByteSource(std::shared_ptr<ByteSource> source,
+                                         dimension_size_type         blocksize,
+                                         dimension_size_type         blockcount):
+        ByteSource(),
+        mutex(),
+        source(source),
+        sourcesize(source ? source->size() : 0U),
+        blocksize(blocksize),
+        blockcount(blockcount),
+        lru(),
+        blocks(),
+        requestcount(0U)
+      {
+        if (!source)
+          throw Exception("Null ByteSource");
+        if (!blocksize || !blockcount)
+          throw Exception("ByteSource cache block size and count must be non-zero");
+      }
+
+      CachedByteSource::~CachedByteSource()
+      {
+      }
+
+      std::string
+      CachedByteSource::name() const
+      {
+        return source->name();
+      }
+
+      offset_type
+      CachedByteSource::size() const
+      {
+        return sourcesize;
+      }
+
+      void
+      CachedByteSource::read(offset_type         offset,
+                             void               *buf,
+                             dimension_size_type size) const
+      {
+        checkRange(*this, sourcesize, offset, size);
+
+        if (!size)
+          return;
+
+        std::vector<block_type> range;
+
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+
+          const block_index_type first = offset / blocksize;
+          const block_index_type last = (offset + size - 1U) / blocksize;
+          range.reserve(static_cast<std::vector<block_type>::size_type>(last - first + 1U));
+
+          for (block_index_type b = first; b <= last;)
+            {
+              auto i = blocks.find(b);
+              if (i != blocks.end())
+                {
+                  // Make most recently used.
+                  lru.splice(lru.begin(), lru, i->second.second);
+                  range.push_back(i->second.first);
+                  ++b;
+                }
+              else
+                {
+                  // Fetch the whole run of missing blocks at once.
+                  block_index_type run = 1U;
+                  while (b + run <= last && blocks.find(b + run) == blocks.end())
+                    ++run;
+                  fetch(b, run, range);
+                  b += run;
+                }
+            }
+        }
+
+        // Copy without holding the lock; the blocks are immutable
+        // and kept alive by range even if evicted.
+        uint8_t *dest = static_cast<uint8_t *>(buf);
+        dimension_size_type within = static_cast<dimension_size_type>(offset % blocksize);
+        for (const auto& block : range)
+          {
+            dimension_size_type n = std::min(size, static_cast<dimension_size_type>(block->size()) - within);
+            std::memcpy(dest, block->data() + within, n);
+            dest += n;
+            size -= n;
+            within = 0U;
+          }
+      }
+
+      uint64_t
+      CachedByteSource::requests() const
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        return requestcount;
+      }
+
+      dimension_size_type
+      CachedByteSource::count() const
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        return blocks.size();
+      }
+
+      void
+      CachedByteSource::clear()
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks.clear();
+        lru.clear();
+      }
+
+      void
+      CachedByteSource::fetch(block_index_type         first,
+                              block_index_type         count,
+                              std::vector<block_type>& result) const
+      {
+        const offset_type start = first * blocksize;
+        const offset_type end = std::min(static_cast<offset_type>((first + count) * blocksize), sourcesize);
+
+        std::vector<uint8_t> data(static_cast<std::vector<uint8_t>::size_type>(end - start));
+        source->read(start, data.data(), data.size());
+        ++requestcount;
+
+        for (block_index_type b = 0; b < count; ++b)
+          {
+            const offset_type bstart = b * blocksize;
+            const offset_type bend = std::min(static_cast<offset_type>(bstart + blocksize), end - start);
+            block_type block(std::make_shared<const std::vector<uint8_t>>(data.begin() + static_cast<std::ptrdiff_t>(bstart),
+                                                                          data.begin() + static_cast<std::ptrdiff_t>(bend)));
+            insert(first + b, block);
+            result.push_back(block);
+          }
+      }
+
+      void
+      CachedByteSource::insert(block_index_type  index,
+                               const block_type& block) const
+      {
+        lru.push_front(index);
+        blocks.insert(std::make_pair(index, entry_type(block, lru.begin())));
+
+        while (blocks.size() > blockcount)
+          {
+            blocks.erase(lru.back());
+            lru.pop_back();
+          }
+      }
+
+      DiskCachedByteSource::DiskCachedByteSource(std::shared_ptr<ByteSource>    source,
+                                                 const boost::filesystem::path& directory,
+                                                 uint64_t                       maxbytes,
+                                                 dimension_size_type            blocksize):
+        ByteSource(),
+        mutex(),
+        source(source),
+        sourcesize(source ? source->size() : 0U),
+        directory(directory),
+        prefix(),
+        blocksize(blocksize),
+        maxbytes(maxbytes),
+        totalbytes(0U),
+        lru(),
+        blocks(),
+        requestcount(0U)
+      {
+        if (!source)
+          throw Exception("Null ByteSource");
+        if (!blocksize || !maxbytes)
+          throw Exception("ByteSource disk cache block size and maximum size must be non-zero");
+
+        boost::system::error_code ec;
+        boost::filesystem::create_directories(directory, ec);
+        if (ec || !boost::filesystem::is_directory(directory))
+          {
+            boost::format fmt("Failed to create cache directory ‘%1%’");
+            fmt % directory.string();
+            throw Exception(fmt.str());
+          }
+
+        // Identify the source by its name and size; the block size
+        // is included so that caches with differing block sizes
+        // may share a directory.
+        std::ostringstream key;
+        key << source->name() << '\n' << sourcesize << '\n' << blocksize;
+        const std::string keystr(key.str());
+        std::ostringstream pfx;
+        pfx << std::hex << std::setw(16) << std::setfill('0')
+            << tileHash(reinterpret_cast<const uint8_t *>(keystr.data()), keystr.size())
+            << '-';
+        prefix = pfx.str();
+
+        // Index the existing blocks of all sources, oldest first.
+        std::vector<std::tuple<std::time_t, std::string, dimension_size_type>> existing;
+        for (boost::filesystem::directory_iterator i(directory, ec), end;
+             !ec && i != end;
+             i.increment(ec))
+          {
+            const boost::filesystem::path& path(i->path());
+            if (path.extension() != ".blk")
+              continue;
+            boost::system::error_code fec;
+            const boost::uintmax_t fsize = boost::filesystem::file_size(path, fec);
+            if (fec)
+              continue;
+            const std::time_t mtime = boost::filesystem::last_write_time(path, fec);
+            if (fec)
+              continue;
+            existing.emplace_back(mtime, path.filename().string(), static_cast<dimension_size_type>(fsize));
+          }
+        std::sort(existing.begin(), existing.end());
+        for (const auto& e : existing)
+          insert(std::get<1>(e), std::get<2>(e));
+      }
+
+      DiskCachedByteSource::~DiskCachedByteSource()
+      {
+      }
+
+      std::string
+      DiskCachedByteSource::name() const
+      {
+        return source->name();
+      }
+
+      offset_type
+      DiskCachedByteSource::size() const
+      {
+        return sourcesize;
+      }
+
+      void
+      DiskCachedByteSource::read(offset_type         offset,
+                                 void               *buf,
+                                 dimension_size_type size) const
+      {
+        checkRange(*this, sourcesize, offset, size);
+
+        if (!size)
+          return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const block_index_type first = offset / blocksize;
+        const block_index_type last = (offset + size - 1U) / blocksize;
+
+        uint8_t *dest = static_cast<uint8_t *>(buf);
+        dimension_size_type within = static_cast<dimension_size_type>(offset % blocksize);
+        auto copy = [&](const uint8_t *data, dimension_size_type length)
+          {
+            dimension_size_type n = std::min(size, length - within);
+            std::memcpy(dest, data + within, n);
+            dest += n;
+            size -= n;
+            within = 0U;
+          };
+
+        std::vector<uint8_t> data;
+        for (block_index_type b = first; b <= last;)
+          {
+            if (load(b, data))
+              {
+                copy(data.data(), data.size());
+                ++b;
+              }
+            else
+              {
+                // Fetch the whole run of missing blocks at once.
+                block_index_type run = 1U;
+                while (b + run <= last && blocks.find(blockName(b + run)) == blocks.end())
+                  ++run;
+                fetch(b, run, data);
+                for (block_index_type r = 0; r < run; ++r)
+                  {
+                    const dimension_size_type bstart = static_cast<dimension_size_type>(r * blocksize);
+                    copy(data.data() + bstart, std::min(blocksize, data.size() - bstart));
+                  }
+                b += run;
+              }
+          }
+      }
+
+      uint64_t
+      DiskCachedByteSource::requests() const
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        return requestcount;
+      }
+
+      uint64_t
+      DiskCachedByteSource::bytes() const
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        return totalbytes;
+      }
+
+      std::string
+      DiskCachedByteSource::blockName(block_index_type index) const
+      {
+        std::ostringstream os;
+        os << prefix << index << ".blk";
+        return os.str();
+      }
+
+      bool
+      DiskCachedByteSource::load(block_index_type      index,
+                                 std::vector<uint8_t>& block) const
+      {
+        const std::string filename(blockName(index));
+        auto i = blocks.find(filename);
+        if (i == blocks.end())
+          return false;
+
+        const offset_type bstart = index * blocksize;
+        const dimension_size_type expected =
+          static_cast<dimension_size_type>(std::min(static_cast<offset_type>(blocksize), sourcesize - bstart));
+
+        block.resize(expected);
+        boost::filesystem::ifstream stream(directory / filename, std::ios::in | std::ios::binary);
+        if (i->second.first != expected ||
+            !stream ||
+            !stream.read(reinterpret_cast<char *>(block.data()), static_cast<std::streamsize>(expected)) ||
+            stream.peek() != std::char_traits<char>::eof())
+          {
+            // Truncated, removed or otherwise invalid; refetch.
+            remove(filename);
+            return false;
+          }
+
+        // Make most recently used, here and for future restarts.
+        lru.splice(lru.begin(), lru, i->second.second);
+        boost::system::error_code ec;
+        boost::filesystem::last_write_time(directory / filename, std::time(nullptr), ec);
+        return true;
+      }
+
+      void
+      DiskCachedByteSource::fetch(block_index_type      first,
+                                  block_index_type      count,
+                                  std::vector<uint8_t>& data) const
+      {
+        const offset_type start = first * blocksize;
+        const offset_type end = std::min(static_cast<offset_type>((first + count) * blocksize), sourcesize);
+
+        data.resize(static_cast<std::vector<uint8_t>::size_type>(end - start));
+        source->read(start, data.data(), data.size());
+        ++requestcount;
+
+        for (block_index_type b = 0; b < count; ++b)
+          {
+            const offset_type bstart = b * blocksize;
+            const offset_type bend = std::min(static_cast<offset_type>(bstart + blocksize), end - start);
+            const std::string filename(blockName(first + b));
+
+            // Write to a temporary file and rename, so that a block
+            // file is never seen partially written.
+            boost::system::error_code ec;
+            const boost::filesystem::path temp(directory / boost::filesystem::unique_path(filename + ".%%%%-%%%%.tmp", ec));
+            if (ec)
+              continue;
+            {
+              boost::filesystem::ofstream stream(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+              if (!stream ||
+                  !stream.write(reinterpret_cast<const char *>(data.data() + bstart),
+                                static_cast<std::streamsize>(bend - bstart)) ||
+                  !stream.flush())
+                {
+                  stream.close();
+                  boost::filesystem::remove(temp, ec);
+                  continue;
+                }
+            }
+            boost::filesystem::rename(temp, directory / filename, ec);
+            if (ec)
+              {
+                boost::filesystem::remove(temp, ec);
+                continue;
+              }
+            insert(filename, static_cast<dimension_size_type>(bend - bstart));
+          }
+      }
+
+      void
+      DiskCachedByteSource::insert(const std::string&  filename,
+                                   dimension_size_type size) const
+      {
+        auto i = blocks.find(filename);
+        if (i != blocks.end())
+          {
+            totalbytes -= i->second.first;
+            lru.erase(i->second.second);
+            blocks.erase(i);
+          }
+
+        lru.push_front(filename);
+        blocks.insert(std::make_pair(filename, entry_type(size, lru.begin())));
+        totalbytes += size;
+
+        while (totalbytes > maxbytes && !lru.empty())
+          {
+            const std::string oldest(lru.back());
+            remove(oldest);
+          }
+      }
+
+      void
+      DiskCachedByteSource::remove(const std::string& filename) const
+      {
+        auto i = blocks.find(filename);
+        if (i != blocks.end())
+          {
+            totalbytes -= i->second.first;
+            lru.erase(i->second.second);
+            blocks.erase(i);
+          }
+
+        boost::system::error_code ec;
+        boost::filesystem::remove(directory / filename, ec);
+      }
+
+    }
+  }
+}
@@ -0,0 +1,549 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TIFF_BYTESOURCE_H
+#define OME_FILES_TIFF_BYTESOURCE_H
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/Types.h>
+#include <ome/files/tiff/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      /**
+       * Source of bytes for reading a TIFF file.
+       *
+       * This is an interface for random access to the content of a
+       * file which is not necessarily on the local filesystem, for
+       * example an object in an object store accessed with HTTP
+       * range requests.  TIFF::open() may open a ByteSource for
+       * reading in place of a filename.
+       *
+       * Implementations must be thread-safe, since independent
+       * libtiff handles (see TIFF::openReadHandle()) may read from
+       * the same source concurrently.
+       */
+      class ByteSource
+      {
+      public:
+        /// Constructor.
+        ByteSource();
+
+        /// Destructor.
+        virtual
+        ~ByteSource();
+
+        /// @cond SKIP
+        ByteSource (const ByteSource&) = delete;
+
+        ByteSource&
+        operator= (const ByteSource&) = delete;
+        /// @endcond SKIP
+
+        /**
+         * Get the name of the source.
+         *
+         * This is used to identify the source in log and error
+         * messages.
+         *
+         * @returns the name.
+         */
+        virtual
+        std::string
+        name() const = 0;
+
+        /**
+         * Get the size of the source.
+         *
+         * @returns the size (bytes).
+         */
+        virtual
+        offset_type
+        size() const = 0;
+
+        /**
+         * Read a range of bytes.
+         *
+         * @param offset the offset to read from.
+         * @param buf the buffer to read into.
+         * @param size the number of bytes to read.
+         * @throws an Exception if the range could not be read in
+         * full.
+         */
+        virtual
+        void
+        read(offset_type         offset,
+             void               *buf,
+             dimension_size_type size) const = 0;
+      };
+
+      /**
+       * ByteSource reading from a local file.
+       */
+      class FileByteSource : public ByteSource
+      {
+      private:
+        /// Mutex serialising access to the file stream.
+        mutable std::mutex mutex;
+        /// Filename.
+        boost::filesystem::path filename;
+        /// File stream.
+        mutable boost::filesystem::ifstream stream;
+        /// File size.
+        offset_type filesize;
+
+      public:
+        /**
+         * Constructor.
+         *
+         * @param filename the file to read.
+         * @throws an Exception if the file could not be opened.
+         */
+        explicit
+        FileByteSource(const boost::filesystem::path& filename);
+
+        /// Destructor.
+        virtual
+        ~FileByteSource();
+
+        // Documented in superclass.
+        std::string
+        name() const;
+
+        // Documented in superclass.
+        offset_type
+        size() const;
+
+        // Documented in superclass.
+        void
+        read(offset_type         offset,
+             void               *buf,
+             dimension_size_type size) const;
+      };
+
+      /**
+       * ByteSource reading from memory.
+       *
+       * The memory is not copied, so that a memory-mapped file or
+       * an already-fetched buffer may be read in place; it must
+       * remain valid and unmodified for the lifetime of the source.
+       */
+      class BufferByteSource : public ByteSource
+      {
+      private:
+        /// Start of the buffer.
+        const uint8_t *data;
+        /// Buffer size.
+        offset_type buffersize;
+        /// Name.
+        std::string sourcename;
+
+      public:
+        /**
+         * Constructor.
+         *
+         * @param data the start of the buffer.
+         * @param size the buffer size (bytes).
+         * @param name the name of the source.
+         * @throws an Exception if @p data is null and @p size is
+         * non-zero.
+         */
+        BufferByteSource(const void         *data,
+                         dimension_size_type size,
+                         const std::string&  name = "buffer");
+
+        /// Destructor.
+        virtual
+        ~BufferByteSource();
+
+        // Documented in superclass.
+        std::string
+        name() const;
+
+        // Documented in superclass.
+        offset_type
+        size() const;
+
+        // Documented in superclass.
+        void
+        read(offset_type         offset,
+             void               *buf,
+             dimension_size_type size) const;
+      };
+
+      /**
+       * ByteSource with a block cache.
+       *
+       * This wraps another ByteSource, typically one with a high
+       * latency per request, and caches its content in fixed-size
+       * blocks.  Reads are served from the cache where possible.
+       * Where blocks are missing, each run of consecutive missing
+       * blocks is fetched from the underlying source with a single
+       * request, so that small reads (such as the directory walk
+       * and tag reads libtiff performs on opening and selecting a
+       * directory) are coalesced into a small number of larger
+       * requests.  The least recently used blocks are evicted once
+       * the block limit is reached.
+       */
+      class CachedByteSource : public ByteSource
+      {
+      public:
+        /// The default block size (64 KiB).
+        static const dimension_size_type default_block_size = 64U * 1024U;
+        /// The default block limit (16 MiB of default blocks).
+        static const dimension_size_type default_block_count = 256U;
+
+      private:
+        /// Block type.
+        typedef std::shared_ptr<const std::vector<uint8_t>> block_type;
+        /// Block index type.
+        typedef uint64_t block_index_type;
+        /// Least recently used block list, most recent first.
+        typedef std::list<block_index_type> lru_type;
+        /// Cached block and its position in the LRU list.
+        typedef std::pair<block_type, lru_type::iterator> entry_type;
+
+        /// Mutex serialising access to the cache.
+        mutable std::mutex mutex;
+        /// Underlying source.
+        std::shared_ptr<ByteSource> source;
+        /// Size of the underlying source.
+        offset_type sourcesize;
+        /// Block size.
+        dimension_size_type blocksize;
+        /// Maximum number of cached blocks.
+        dimension_size_type blockcount;
+        /// Least recently used blocks.
+        mutable lru_type lru;
+        /// Cached blocks.
+        mutable std::map<block_index_type, entry_type> blocks;
+        /// Number of requests made to the underlying source.
+        mutable uint64_t requestcount;
+
+      public:
+        /**
+         * Constructor.
+         *
+         * @param source the underlying source.
+         * @param blocksize the block size (bytes).
+         * @param blockcount the maximum number of cached blocks.
+         * @throws an Exception if the block size or count are zero.
+         */
+        CachedByteSource(std::shared_ptr<ByteSource> source,
+                         dimension_size_type         blocksize = default_block_size,
+                         dimension_size_type         blockcount = default_block_count);
+
+        /// Destructor.
+        virtual
+        ~CachedByteSource();
+
+        // Documented in superclass.
+        std::string
+        name() const;
+
+        // Documented in superclass.
+        offset_type
+        size() const;
+
+        // Documented in superclass.
+        void
+        read(offset_type         offset,
+             void               *buf,
+             dimension_size_type size) const;
+
+        /**
+         * Get the number of requests made to the underlying source.
+         *
+         * @returns the request count.
+         */
+        uint64_t
+        requests() const;
+
+        /**
+         * Get the number of cached blocks.
+         *
+         * @returns the block count.
+         */
+        dimension_size_type
+        count() const;
+
+        /**
+         * Discard all cached blocks.
+         */
+        void
+        clear();
+
+      private:
+        /**
+         * Fetch a run of blocks from the underlying source.
+         *
+         * @note The caller must hold the mutex.
+         *
+         * @param first the first block to fetch.
+         * @param count the number of blocks to fetch.
+         * @param result the fetched blocks are appended to this list.
+         */
+        void
+        fetch(block_index_type         first,
+              block_index_type         count,
+              std::vector<block_type>& result) const;
+
+        /**
+         * Insert a block into the cache, evicting older blocks.
+         *
+         * @note The caller must hold the mutex.
+         *
+         * @param index the block index.
+         * @param block the block.
+         */
+        void
+        insert(block_index_type  index,
+               const block_type& block) const;
+      };
+
+      /**
+       * ByteSource with a persistent block cache on local disk.
+       *
+       * This wraps another ByteSource, typically a remote object
+       * store, and caches its content in fixed-size blocks stored
+       * as files in a local directory (ideally on fast local
+       * storage such as NVMe).  It is intended as a second cache
+       * tier beneath an in-memory CachedByteSource, for working
+       * sets too large to hold in memory:
+       *
+       * \code{.cpp}
+       * std::shared_ptr<ByteSource> source
+       *   (std::make_shared<CachedByteSource>
+       *    (std::make_shared<DiskCachedByteSource>(remote, "/var/cache/tiles", 64ULL << 30)));
+       * \endcode
+       *
+       * Blocks hold the data as stored in the source, so compressed
+       * tiles are cached compressed.  Runs of consecutive missing
+       * blocks are fetched with a single request, as for
+       * CachedByteSource.  The files of the cache are named from a
+       * hash of the name and size of the source, so the cache
+       * survives restarts, and a directory may be shared by several
+       * sources; the name of the source should therefore identify
+       * immutable content (for example by including an object
+       * version).  The least recently used blocks of the directory
+       * are removed once its total size exceeds the limit; recency
+       * is the modification time of each file, which is updated on
+       * use.  Blocks added by other processes sharing the directory
+       * are only counted towards the limit once the cache is
+       * reopened.  Failure to write to the cache is not an error.
+       */
+      class DiskCachedByteSource : public ByteSource
+      {
+      public:
+        /// The default block size (1 MiB).
+        static const dimension_size_type default_block_size = 1024U * 1024U;
+
+      private:
+        /// Block index type.
+        typedef uint64_t block_index_type;
+        /// Least recently used block files, most recent first.
+        typedef std::list<std::string> lru_type;
+        /// Size of a cached block file and its position in the LRU list.
+        typedef std::pair<dimension_size_type, lru_type::iterator> entry_type;
+
+        /// Mutex serialising access to the cache.
+        mutable std::mutex mutex;
+        /// Underlying source.
+        std::shared_ptr<ByteSource> source;
+        /// Size of the underlying source.
+        offset_type sourcesize;
+        /// Cache directory.
+        boost::filesystem::path directory;
+        /// Prefix of the block files of this source.
+        std::string prefix;
+        /// Block size.
+        dimension_size_type blocksize;
+        /// Maximum total size of the cached blocks (bytes).
+        uint64_t maxbytes;
+        /// Total size of the cached blocks (bytes).
+        mutable uint64_t totalbytes;
+        /// Least recently used block files.
+        mutable lru_type lru;
+        /// Cached block files, by filename.
+        mutable std::map<std::string, entry_type> blocks;
+        /// Number of requests made to the underlying source.
+        mutable uint64_t requestcount;
+
+      public:
+        /**
+         * Constructor.
+         *
+         * The cache directory is created if it does not exist, and
+         * the blocks already present are indexed.
+         *
+         * @param source the underlying source.
+         * @param directory the cache directory.
+         * @param maxbytes the maximum total size of the cached
+         * blocks in the directory (bytes).
+         * @param blocksize the block size (bytes).
+         * @throws an Exception if the block size or maximum size
+         * are zero, or the directory could not be created.
+         */
+        DiskCachedByteSource(std::shared_ptr<ByteSource>    source,
+                             const boost::filesystem::path& directory,
+                             uint64_t                       maxbytes,
+                             dimension_size_type            blocksize = default_block_size);
+
+        /// Destructor.
+        virtual
+        ~DiskCachedByteSource();
+
+        // Documented in superclass.
+        std::string
+        name() const;
+
+        // Documented in superclass.
+        offset_type
+        size() const;
+
+        // Documented in superclass.
+        void
+        read(offset_type         offset,
+             void               *buf,
+             dimension_size_type size) const;
+
+        /**
+         * Get the number of requests made to the underlying source.
+         *
+         * @returns the request count.
+         */
+        uint64_t
+        requests() const;
+
+        /**
+         * Get the total size of the cached blocks in the directory.
+         *
+         * @returns the size (bytes).
+         */
+        uint64_t
+        bytes() const;
+
+      private:
+        /**
+         * Get the filename of a block.
+         *
+         * @param index the block index.
+         * @returns the filename.
+         */
+        std::string
+        blockName(block_index_type index) const;
+
+        /**
+         * Read a cached block.
+         *
+         * @note The caller must hold the mutex.
+         *
+         * @param index the block index.
+         * @param block the block data; resized to fit.
+         * @returns @c true if the block was read, or @c false if it
+         * is not cached or could not be read.
+         */
+        bool
+        load(block_index_type      index,
+             std::vector<uint8_t>& block) const;
+
+        /**
+         * Fetch a run of blocks from the underlying source and
+         * cache them.
+         *
+         * @note The caller must hold the mutex.
+         *
+         * @param first the first block to fetch.
+         * @param count the number of blocks to fetch.
+         * @param data the fetched data.
+         */
+        void
+        fetch(block_index_type      first,
+              block_index_type      count,
+              std::vector<uint8_t>& data) const;
+
+        /**
+         * Add a block file to the index, evicting older blocks.
+         *
+         * @note The caller must hold the mutex.
+         *
+         * @param filename the block filename.
+         * @param size the size of the block.
+         */
+        void
+        insert(const std::string&  filename,
+               dimension_size_type size) const;
+
+        /**
+         * Remove a block file from the index and the directory.
+         *
+         * @note The caller must hold the mutex.
+         *
+         * @param filename the block filename.
+         */
+        void
+        remove(const std::string& filename) const;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_TIFF_BYTESOURCE_H
+
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
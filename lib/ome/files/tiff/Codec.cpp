@@ -37,13 +37,53 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 
+#include <ome/files/config-internal.h>
+#include <ome/files/detail/tiff/JPEGCodec.h>
 #include <ome/files/tiff/Codec.h>
 
 #include <tiffio.h>
 
 using ome::xml::model::enums::PixelType;
 
+namespace
+{
+
+  using ome::files::tiff::CodecPlugin;
+  using ome::files::tiff::Compression;
+
+  /// Registered codec plugins, by compression scheme.
+  typedef std::map<Compression, std::shared_ptr<const CodecPlugin>> plugin_map;
+
+  std::mutex&
+  plugin_mutex()
+  {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  // Plugins registered by default.
+  plugin_map
+  builtin_plugins()
+  {
+    plugin_map map;
+#ifdef OME_FILES_HAVE_JPEG
+    std::shared_ptr<const CodecPlugin> jpeg(std::make_shared<const CodecPlugin>(ome::files::tiff::detail::jpegCodecPlugin()));
+    map[jpeg->scheme] = jpeg;
+#endif // OME_FILES_HAVE_JPEG
+    return map;
+  }
+
+  plugin_map&
+  plugins()
+  {
+    static plugin_map map(builtin_plugins());
+    return map;
+  }
+
+}
+
 namespace ome
 {
   namespace files
@@ -51,6 +91,42 @@ namespace ome
     namespace tiff
     {
 
+      void
+      registerCodecPlugin(const CodecPlugin& plugin)
+      {
+        std::lock_guard<std::mutex> guard(plugin_mutex());
+        plugins()[plugin.scheme] = std::make_shared<const CodecPlugin>(plugin);
+      }
+
+      bool
+      unregisterCodecPlugin(Compression scheme)
+      {
+        std::lock_guard<std::mutex> guard(plugin_mutex());
+        return plugins().erase(scheme) != 0U;
+      }
+
+      std::shared_ptr<const CodecPlugin>
+      getCodecPlugin(Compression scheme)
+      {
+        std::lock_guard<std::mutex> guard(plugin_mutex());
+        if (plugins().empty())
+          return std::shared_ptr<const CodecPlugin>();
+
+        plugin_map::const_iterator found = plugins().find(scheme);
+        return found != plugins().end() ? found->second : std::shared_ptr<const CodecPlugin>();
+      }
+
+      std::vector<CodecPlugin>
+      getCodecPlugins()
+      {
+        std::lock_guard<std::mutex> guard(plugin_mutex());
+
+        std::vector<CodecPlugin> ret;
+        for (const auto& plugin : plugins())
+          ret.push_back(*plugin.second);
+        return ret;
+      }
+
       const std::vector<Codec>&
       getCodecs()
       {
@@ -133,10 +209,27 @@ namespace ome
                   case COMPRESSION_ADOBE_DEFLATE:
                   case COMPRESSION_DEFLATE:
                   case COMPRESSION_LZMA:
+                  case COMPRESSION_ZSTD:
+                  case COMPRESSION_LERC:
                   case COMPRESSION_JP2000:
                     ptcodecs.push_back(i->name);
                     break;
 
+                    // WebP compression of 8-bit data.
+                  case COMPRESSION_WEBP:
+                    if (pixeltype == PixelType::UINT8)
+                      ptcodecs.push_back(i->name);
+                    break;
+
+                    // JPEG XL compression of 8- and 16-bit integer
+                    // and 32-bit floating point data.
+                  case COMPRESSION_JXL:
+                    if (pixeltype == PixelType::UINT8 ||
+                        pixeltype == PixelType::UINT16 ||
+                        pixeltype == PixelType::FLOAT)
+                      ptcodecs.push_back(i->name);
+                    break;
+
                     // JPEG compression of 8-bit data (12-bit not
                     // supported by default, and this interface does
                     // not cater for samples per pixel or bits per
@@ -180,6 +273,36 @@ namespace ome
         return found->second;
       }
 
+      Predictor
+      defaultPredictor(PixelType pixeltype)
+      {
+        Predictor predictor = NONE;
+
+        switch(pixeltype)
+          {
+          case PixelType::INT8:
+          case PixelType::INT16:
+          case PixelType::INT32:
+          case PixelType::UINT8:
+          case PixelType::UINT16:
+          case PixelType::UINT32:
+            predictor = HORIZONTAL;
+            break;
+
+          case PixelType::FLOAT:
+          case PixelType::DOUBLE:
+            predictor = FLOATING_POINT;
+            break;
+
+            // Sub-byte and complex samples are not supported by
+            // either predictor.
+          default:
+            break;
+          }
+
+        return predictor;
+      }
+
       Compression
       getCodecScheme(const std::string& name)
       {
@@ -199,6 +322,18 @@ namespace ome
 
         if (found != cmap.end())
           ret = found->second.scheme;
+        else
+          {
+            std::lock_guard<std::mutex> guard(plugin_mutex());
+            for (const auto& plugin : plugins())
+              {
+                if (plugin.second->name == name)
+                  {
+                    ret = plugin.first;
+                    break;
+                  }
+              }
+          }
 
         return ret;
       }
@@ -38,9 +38,15 @@
 #ifndef OME_FILES_TIFF_CODEC_H
 #define OME_FILES_TIFF_CODEC_H
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <boost/optional.hpp>
+
+#include <ome/files/Types.h>
 #include <ome/files/tiff/Types.h>
 
 #include <ome/xml/model/enums/PixelType.h>
@@ -63,6 +69,225 @@ namespace ome
         Compression scheme;
       };
 
+      /**
+       * Codec parameters for writing.
+       *
+       * Unset parameters use the codec defaults.  Parameters which
+       * are not applicable to the codec in use are ignored.
+       */
+      struct CodecParameters
+      {
+        /**
+         * Compression level.
+         *
+         * This is the level for the deflate (1–9, or 1–12 with
+         * libdeflate), zstd (1–22) and LZMA (0–9) codecs, and the
+         * quality for the JPEG and WebP codecs (1–100).
+         */
+        boost::optional<int> level;
+        /**
+         * Predictor.
+         *
+         * Only used with the LZW, deflate, LZMA and zstd codecs.
+         * Use HORIZONTAL for integer pixel types and FLOATING_POINT
+         * for floating point pixel types.  If unset and
+         * automaticPredictor is @c true, the predictor is chosen
+         * from the pixel type with defaultPredictor().
+         */
+        boost::optional<Predictor> predictor;
+        /**
+         * Choose the predictor from the pixel type if unset.
+         */
+        bool automaticPredictor;
+        /**
+         * Maximum error for lossy compression.
+         *
+         * Only used with the LERC codec, where it is the maximum
+         * absolute error of each sample value; unset or zero for
+         * lossless compression.
+         */
+        boost::optional<double> maxError;
+
+        /// Constructor.
+        CodecParameters():
+          level(),
+          predictor(),
+          automaticPredictor(false),
+          maxError()
+        {}
+      };
+
+      /**
+       * Description of a tile or strip passed to a codec plugin.
+       */
+      struct CodecTile
+      {
+        /// Compression scheme.
+        Compression scheme;
+        /// Width of the tile or strip (pixels).
+        uint32_t width;
+        /// Length of the tile, or rows in the strip (pixels).
+        uint32_t length;
+        /// Bits per sample.
+        uint16_t bits;
+        /// Samples per pixel in the tile (1 for separate planes).
+        uint16_t samples;
+        /// Sample format.
+        SampleFormat sampleformat;
+        /// Photometric interpretation.
+        PhotometricInterpretation photometric;
+        /// @c true if the file is big-endian.
+        bool bigendian;
+        /// Codec parameters (only set when encoding).
+        CodecParameters parameters;
+        /**
+         * Tables shared by all tiles of the directory, or null.
+         *
+         * Only set when decoding; for JPEG compression this is the
+         * content of the JPEGTables tag.  The same tables are passed
+         * for every tile of a directory, so a codec may retain state
+         * derived from them while the pointer is unchanged.
+         */
+        std::shared_ptr<const std::vector<uint8_t>> tables;
+
+        /// Constructor.
+        CodecTile():
+          scheme(COMPRESSION_NONE),
+          width(0U),
+          length(0U),
+          bits(0U),
+          samples(0U),
+          sampleformat(UNSIGNED_INT),
+          photometric(MIN_IS_BLACK),
+          bigendian(false),
+          parameters(),
+          tables()
+        {}
+      };
+
+      /**
+       * Codec plugin decode function.
+       *
+       * Decode the raw data of a tile or strip into @c decoded,
+       * which must be filled completely.  The decoded samples are in
+       * the byte order of the file (as for a libtiff codec); they
+       * are swapped to native byte order by the caller.  Errors are
+       * reported by throwing an exception.
+       *
+       * @param tile the tile description.
+       * @param encoded the raw tile data.
+       * @param encodedsize the size of the raw tile data (bytes).
+       * @param decoded the buffer to decode into.
+       * @param decodedsize the decoded size (bytes).
+       */
+      typedef std::function<void (const CodecTile&   tile,
+                                  const uint8_t       *encoded,
+                                  dimension_size_type  encodedsize,
+                                  uint8_t             *decoded,
+                                  dimension_size_type  decodedsize)> CodecDecodeFunction;
+
+      /**
+       * Codec plugin encode function.
+       *
+       * Encode the pixel data of a tile or strip into @c encoded,
+       * replacing its contents.  The samples are in the byte order
+       * of the file.  Errors are reported by throwing an exception.
+       *
+       * @param tile the tile description.
+       * @param decoded the pixel data.
+       * @param decodedsize the size of the pixel data (bytes).
+       * @param encoded the raw tile data to set.
+       */
+      typedef std::function<void (const CodecTile&      tile,
+                                  const uint8_t          *decoded,
+                                  dimension_size_type     decodedsize,
+                                  std::vector<uint8_t>&   encoded)> CodecEncodeFunction;
+
+      /**
+       * Codec plugin support function.
+       *
+       * @param tile the tile description.
+       * @returns @c true if the plugin can decode or encode tiles of
+       * this description, or @c false to use the libtiff codec.
+       */
+      typedef std::function<bool (const CodecTile& tile)> CodecSupportFunction;
+
+      /**
+       * A codec plugin.
+       *
+       * A plugin provides an implementation of a compression scheme
+       * outside libtiff, for example an accelerated implementation
+       * of a scheme also supported by libtiff, or a scheme libtiff
+       * was built without.  When reading and writing image data,
+       * IFD uses the plugin registered for the compression scheme
+       * of the directory in place of the libtiff codec, passing it
+       * the raw tile data.  Plugins are not used for directories
+       * with a predictor, since libtiff applies predictors within
+       * its own codecs.  Either function may be empty, in which
+       * case libtiff is used for that direction.  If the support
+       * function is set, libtiff is also used for directories it
+       * does not accept.
+       *
+       * When built with libjpeg, a plugin decoding JPEG compression
+       * is registered by default.  It loads the JPEGTables of each
+       * directory once rather than for every tile, and converts
+       * YCbCr to RGB within libjpeg.  It may be unregistered to use
+       * the libtiff JPEG codec.
+       */
+      struct CodecPlugin
+      {
+        /// Codec name.
+        std::string name;
+        /// Compression scheme.
+        Compression scheme;
+        /// Decode function.
+        CodecDecodeFunction decode;
+        /// Encode function.
+        CodecEncodeFunction encode;
+        /// Support function (optional).
+        CodecSupportFunction supports;
+      };
+
+      /**
+       * Register a codec plugin.
+       *
+       * Any plugin already registered for the same compression
+       * scheme is replaced.  Registration is thread-safe, but
+       * images being read or written concurrently may continue to
+       * use the previous codec.
+       *
+       * @param plugin the plugin to register.
+       */
+      void
+      registerCodecPlugin(const CodecPlugin& plugin);
+
+      /**
+       * Unregister a codec plugin.
+       *
+       * @param scheme the compression scheme of the plugin.
+       * @returns @c true if a plugin was unregistered, or @c false
+       * if no plugin was registered for the scheme.
+       */
+      bool
+      unregisterCodecPlugin(Compression scheme);
+
+      /**
+       * Get the codec plugin for a compression scheme.
+       *
+       * @param scheme the compression scheme.
+       * @returns the plugin, or null if no plugin is registered.
+       */
+      std::shared_ptr<const CodecPlugin>
+      getCodecPlugin(Compression scheme);
+
+      /**
+       * Get all registered codec plugins.
+       *
+       * @returns a list of the registered plugins.
+       */
+      std::vector<CodecPlugin>
+      getCodecPlugins();
+
       /**
        * Get codecs registered with the TIFF library.
        *
@@ -89,9 +314,25 @@ namespace ome
       const std::vector<std::string>&
       getCodecNames(ome::xml::model::enums::PixelType pixeltype);
 
+      /**
+       * Get the default predictor for a pixel type.
+       *
+       * This is HORIZONTAL for integer pixel types, FLOATING_POINT
+       * for floating point pixel types, and NONE for bit and
+       * complex pixel types, which no predictor supports.
+       *
+       * @param pixeltype the pixel type to compress.
+       * @returns the predictor.
+       */
+      Predictor
+      defaultPredictor(ome::xml::model::enums::PixelType pixeltype);
+
       /**
        * Get the compression scheme enumeration for a codec name.
        *
+       * Names of codecs registered with the TIFF library are used
+       * first, followed by the names of codec plugins.
+       *
        * @param name the codec name
        * @returns the compression scheme for the name, or
        * COMPRESSION_NONE if invalid.
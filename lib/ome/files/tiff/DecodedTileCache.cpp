@@ -0,0 +1,298 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <utility>
+
+#include <ome/files/MemoryBudget.h>
+#include <ome/files/tiff/DecodedTileCache.h>
+#include <ome/files/tiff/SharedTileCache.h>
+#include <ome/files/tiff/TIFF.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      DecodedTileCache::DecodedTileCache(dimension_size_type budget):
+        mutex(),
+        budget(budget),
+        bytes(0U),
+        hitcount(0U),
+        misscount(0U),
+        lru(),
+        index(),
+        shared(),
+        reclaimer(MemoryBudget::global().addReclaimer
+                  (MemoryBudget::DECODED_TILE_CACHE,
+                   [this](dimension_size_type size) { return reclaim(size); }))
+      {
+      }
+
+      DecodedTileCache::~DecodedTileCache()
+      {
+        MemoryBudget::global().removeReclaimer(reclaimer);
+        MemoryBudget::global().remove(MemoryBudget::DECODED_TILE_CACHE, bytes);
+      }
+
+      DecodedTileCache::value_type
+      DecodedTileCache::find(const key_type& key)
+      {
+        std::shared_ptr<SharedTileCache> sharedcache;
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+
+          auto i = index.find(key);
+          if (i != index.end())
+            {
+              ++hitcount;
+              // Move to front (most recently used).
+              lru.splice(lru.begin(), lru, i->second);
+              return i->second->second;
+            }
+          sharedcache = shared;
+        }
+
+        // The shared lookup copies the tile, so is made unlocked.
+        value_type tilebuffer;
+        if (sharedcache)
+          {
+            SharedTileCache::key_type sharedkey{key.tiff->getFileIdentity(), key.offset, key.tile};
+            tilebuffer = sharedcache->find(sharedkey);
+          }
+
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+          if (tilebuffer)
+            {
+              ++hitcount;
+              insertLocal(key, tilebuffer);
+            }
+          else
+            ++misscount;
+        }
+        MemoryBudget::global().reclaim();
+        return tilebuffer;
+      }
+
+      void
+      DecodedTileCache::insert(const key_type& key,
+                               value_type      tilebuffer)
+      {
+        if (!tilebuffer)
+          return;
+
+        std::shared_ptr<SharedTileCache> sharedcache;
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+
+          insertLocal(key, tilebuffer);
+          sharedcache = shared;
+        }
+        MemoryBudget::global().reclaim();
+
+        if (sharedcache)
+          {
+            SharedTileCache::key_type sharedkey{key.tiff->getFileIdentity(), key.offset, key.tile};
+            sharedcache->insert(sharedkey, *tilebuffer);
+          }
+      }
+
+      void
+      DecodedTileCache::insertLocal(const key_type& key,
+                                    value_type      tilebuffer)
+      {
+        if (tilebuffer->size() > budget)
+          return;
+
+        auto i = index.find(key);
+        if (i != index.end())
+          {
+            bytes -= i->second->second->size();
+            MemoryBudget::global().remove(MemoryBudget::DECODED_TILE_CACHE, i->second->second->size());
+            lru.erase(i->second);
+            index.erase(i);
+          }
+
+        lru.push_front(std::make_pair(key, tilebuffer));
+        index.insert(std::make_pair(key, lru.begin()));
+        bytes += tilebuffer->size();
+        MemoryBudget::global().add(MemoryBudget::DECODED_TILE_CACHE, tilebuffer->size());
+
+        evict(budget);
+      }
+
+      void
+      DecodedTileCache::erase(const TIFF *tiff)
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        for (auto i = lru.begin(); i != lru.end();)
+          {
+            if (i->first.tiff == tiff)
+              {
+                bytes -= i->second->size();
+                MemoryBudget::global().remove(MemoryBudget::DECODED_TILE_CACHE, i->second->size());
+                index.erase(i->first);
+                i = lru.erase(i);
+              }
+            else
+              ++i;
+          }
+      }
+
+      void
+      DecodedTileCache::clear()
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        lru.clear();
+        index.clear();
+        MemoryBudget::global().remove(MemoryBudget::DECODED_TILE_CACHE, bytes);
+        bytes = 0U;
+      }
+
+      void
+      DecodedTileCache::setBudget(dimension_size_type budget)
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        this->budget = budget;
+        evict(budget);
+      }
+
+      dimension_size_type
+      DecodedTileCache::getBudget() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return budget;
+      }
+
+      void
+      DecodedTileCache::setSharedCache(std::shared_ptr<SharedTileCache> cache)
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        shared = cache;
+      }
+
+      std::shared_ptr<SharedTileCache>
+      DecodedTileCache::getSharedCache() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return shared;
+      }
+
+      bool
+      DecodedTileCache::enabled() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return budget || shared;
+      }
+
+      dimension_size_type
+      DecodedTileCache::size() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return bytes;
+      }
+
+      dimension_size_type
+      DecodedTileCache::count() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return lru.size();
+      }
+
+      dimension_size_type
+      DecodedTileCache::hits() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return hitcount;
+      }
+
+      dimension_size_type
+      DecodedTileCache::misses() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return misscount;
+      }
+
+      void
+      DecodedTileCache::resetStatistics()
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        hitcount = misscount = 0U;
+      }
+
+      dimension_size_type
+      DecodedTileCache::reclaim(dimension_size_type size)
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return evict(bytes > size ? bytes - size : 0U);
+      }
+
+      dimension_size_type
+      DecodedTileCache::evict(dimension_size_type limit)
+      {
+        dimension_size_type freed = 0U;
+        while (bytes > limit && !lru.empty())
+          {
+            const dimension_size_type size = lru.back().second->size();
+            bytes -= size;
+            freed += size;
+            index.erase(lru.back().first);
+            lru.pop_back();
+          }
+        MemoryBudget::global().remove(MemoryBudget::DECODED_TILE_CACHE, freed);
+        return freed;
+      }
+
+    }
+  }
+}
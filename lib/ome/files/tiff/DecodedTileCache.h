@@ -0,0 +1,333 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TIFF_DECODEDTILECACHE_H
+#define OME_FILES_TIFF_DECODEDTILECACHE_H
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <ome/files/MemoryBudget.h>
+#include <ome/files/TileBuffer.h>
+#include <ome/files/Types.h>
+#include <ome/files/tiff/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      class SharedTileCache;
+      class TIFF;
+
+      /**
+       * Cache of decoded tiles.
+       *
+       * This is a collection of decoded TileBuffer objects indexed
+       * by TIFF, IFD offset and tile number, used on the read path
+       * to avoid repeatedly decoding the same tiles when reading
+       * overlapping regions.  The total size of the cached tiles is
+       * bounded by a byte budget; when the budget is exceeded, the
+       * least recently used tiles are evicted.  A budget of zero
+       * disables caching.  Cached tiles are also counted by the
+       * global MemoryBudget, which may evict them when its limit is
+       * exceeded.
+       *
+       * A single cache may be shared between several TIFF instances
+       * (see TIFF::setTileCache()).  Tiles may additionally be
+       * shared with other processes through a SharedTileCache (see
+       * setSharedCache()).  All methods are thread-safe.
+       */
+      class DecodedTileCache
+      {
+      public:
+        /// Cache key.
+        struct key_type
+        {
+          /// The TIFF the tile belongs to.
+          const TIFF *tiff;
+          /// The offset of the IFD the tile belongs to.
+          offset_type offset;
+          /// The tile index.
+          dimension_size_type tile;
+
+          /**
+           * Compare keys.
+           *
+           * @param rhs the key to compare with.
+           * @returns @c true if this key orders before @c rhs.
+           */
+          bool
+          operator< (const key_type& rhs) const
+          {
+            if (tiff != rhs.tiff)
+              return std::less<const TIFF *>()(tiff, rhs.tiff);
+            if (offset != rhs.offset)
+              return offset < rhs.offset;
+            return tile < rhs.tile;
+          }
+        };
+
+        /// Tile buffer type.
+        typedef std::shared_ptr<const TileBuffer> value_type;
+
+        /**
+         * Constructor.
+         *
+         * @param budget the maximum total size of cached tiles (bytes).
+         */
+        explicit
+        DecodedTileCache(dimension_size_type budget = 0U);
+
+        /// Destructor.
+        virtual ~DecodedTileCache();
+
+        /// @cond SKIP
+        DecodedTileCache (const DecodedTileCache&) = delete;
+
+        DecodedTileCache&
+        operator= (const DecodedTileCache&) = delete;
+        /// @endcond SKIP
+
+        /**
+         * Find a tile in the cache.
+         *
+         * If found, the tile becomes the most recently used tile.
+         * If not found, and a shared cache is set, the tile is
+         * looked up in the shared cache and, if found there, added
+         * to this cache.  The hit or miss counter is incremented.
+         *
+         * @param key the tile to find.
+         * @returns the tile buffer corresponding to the specified
+         * key.  If the key was not found, this will be null.
+         */
+        value_type
+        find(const key_type& key);
+
+        /**
+         * Insert a tile into the cache.
+         *
+         * The tile becomes the most recently used tile, replacing
+         * any existing tile with the same key, and the least
+         * recently used tiles are evicted until the cache fits
+         * within its budget.  Tiles larger than the budget are not
+         * cached.  The tile is also inserted into the shared cache,
+         * if set.
+         *
+         * @param key the key of the tile buffer.
+         * @param tilebuffer the decoded tile pixel data.
+         */
+        void
+        insert(const key_type& key,
+               value_type      tilebuffer);
+
+        /**
+         * Remove all tiles belonging to a TIFF from the cache.
+         *
+         * @param tiff the TIFF to remove.
+         */
+        void
+        erase(const TIFF *tiff);
+
+        /**
+         * Remove all tiles from the cache.
+         *
+         * The hit and miss counters are not reset.
+         */
+        void
+        clear();
+
+        /**
+         * Set the cache budget.
+         *
+         * If the cache exceeds the new budget, the least recently
+         * used tiles are evicted.
+         *
+         * @param budget the maximum total size of cached tiles (bytes).
+         */
+        void
+        setBudget(dimension_size_type budget);
+
+        /**
+         * Get the cache budget.
+         *
+         * @returns the maximum total size of cached tiles (bytes).
+         */
+        dimension_size_type
+        getBudget() const;
+
+        /**
+         * Set the shared cache.
+         *
+         * Tiles not found in this cache are looked up in the shared
+         * cache, and newly decoded tiles are added to it, so that
+         * tiles decoded by one process are available to all other
+         * processes using the same shared cache.  Only tiles of
+         * TIFFs with a file identity (see TIFF::getFileIdentity())
+         * are shared.
+         *
+         * @param cache the shared cache, or null to disable sharing.
+         */
+        void
+        setSharedCache(std::shared_ptr<SharedTileCache> cache);
+
+        /**
+         * Get the shared cache.
+         *
+         * @returns the shared cache, or null if sharing is disabled.
+         */
+        std::shared_ptr<SharedTileCache>
+        getSharedCache() const;
+
+        /**
+         * Check if the cache is enabled.
+         *
+         * @returns @c true if the budget is nonzero or a shared cache
+         * is set, otherwise @c false.
+         */
+        bool
+        enabled() const;
+
+        /**
+         * Get the total size of all cached tiles.
+         *
+         * @returns the cache size (bytes).
+         */
+        dimension_size_type
+        size() const;
+
+        /**
+         * Get the number of cached tiles.
+         *
+         * @returns the tile count.
+         */
+        dimension_size_type
+        count() const;
+
+        /**
+         * Get the number of successful lookups.
+         *
+         * @returns the hit count.
+         */
+        dimension_size_type
+        hits() const;
+
+        /**
+         * Get the number of unsuccessful lookups.
+         *
+         * @returns the miss count.
+         */
+        dimension_size_type
+        misses() const;
+
+        /**
+         * Reset the hit and miss counters to zero.
+         */
+        void
+        resetStatistics();
+
+      private:
+        /// Tiles in order of use (most recently used first).
+        typedef std::list<std::pair<key_type, value_type>> lru_type;
+
+        /**
+         * Insert a tile into this cache only.
+         *
+         * The caller must hold the mutex.
+         *
+         * @param key the key of the tile buffer.
+         * @param tilebuffer the decoded tile pixel data.
+         */
+        void
+        insertLocal(const key_type& key,
+                    value_type      tilebuffer);
+
+        /**
+         * Evict least recently used tiles to fit within a limit.
+         *
+         * @param limit the maximum total size of cached tiles.
+         * @returns the size of the tiles evicted.
+         */
+        dimension_size_type
+        evict(dimension_size_type limit);
+
+        /**
+         * Evict tiles for the global memory budget.
+         *
+         * @param size the size to free.
+         * @returns the size of the tiles evicted.
+         */
+        dimension_size_type
+        reclaim(dimension_size_type size);
+
+        /// Mutex serialising access to the cache.
+        mutable std::mutex mutex;
+        /// Maximum total size of cached tiles.
+        dimension_size_type budget;
+        /// Total size of cached tiles.
+        dimension_size_type bytes;
+        /// Successful lookups.
+        dimension_size_type hitcount;
+        /// Unsuccessful lookups.
+        dimension_size_type misscount;
+        /// Tiles in order of use.
+        lru_type lru;
+        /// Mapping of key to tile.
+        std::map<key_type, lru_type::iterator> index;
+        /// Shared cache.
+        std::shared_ptr<SharedTileCache> shared;
+        /// Registration with the global memory budget.
+        MemoryBudget::reclaimer_id reclaimer;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_TIFF_DECODEDTILECACHE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,209 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#include <ome/files/tiff/DirectoryIndex.h>
+#include <ome/files/tiff/Exception.h>
+
+namespace
+{
+
+  /// Sidecar file magic.
+  const char magic[8] = { 'O', 'M', 'E', 'I', 'F', 'D', 'X', '1' };
+
+  /// Byte order mark (the sidecar is stored in native byte order).
+  const uint64_t byteorder = 0x0102030405060708ULL;
+
+  /**
+   * Sidecar file header.
+   */
+  struct Header
+  {
+    /// Magic.
+    char magic[8];
+    /// Byte order mark.
+    uint64_t byteorder;
+    /// TIFF file size.
+    uint64_t filesize;
+    /// TIFF file modification time.
+    int64_t mtime;
+    /// Number of directory offsets following the header.
+    uint64_t count;
+  };
+
+  /**
+   * Get the size and modification time of a file.
+   *
+   * @param filename the file to check.
+   * @param filesize the file size to set.
+   * @param mtime the modification time to set.
+   * @returns @c true on success, @c false on failure.
+   */
+  bool
+  fileStamp(const boost::filesystem::path& filename,
+            uint64_t&                      filesize,
+            int64_t&                       mtime)
+  {
+    boost::system::error_code ec;
+    boost::uintmax_t size = boost::filesystem::file_size(filename, ec);
+    if (ec)
+      return false;
+    std::time_t time = boost::filesystem::last_write_time(filename, ec);
+    if (ec)
+      return false;
+
+    filesize = static_cast<uint64_t>(size);
+    mtime = static_cast<int64_t>(time);
+    return true;
+  }
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      boost::filesystem::path
+      directoryIndexPath(const boost::filesystem::path& filename)
+      {
+        boost::filesystem::path ret(filename);
+        ret += ".ifdx";
+        return ret;
+      }
+
+      bool
+      readDirectoryIndex(const boost::filesystem::path& filename,
+                         std::vector<offset_type>&      offsets)
+      {
+        uint64_t filesize;
+        int64_t mtime;
+        if (!fileStamp(filename, filesize, mtime))
+          return false;
+
+        boost::filesystem::ifstream in(directoryIndexPath(filename),
+                                       std::ios::in | std::ios::binary);
+        if (!in)
+          return false;
+
+        Header header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+            header.byteorder != byteorder ||
+            header.filesize != filesize ||
+            header.mtime != mtime ||
+            header.count == 0U ||
+            header.count > (filesize / 2U))
+          return false;
+
+        std::vector<offset_type> index(static_cast<std::vector<offset_type>::size_type>(header.count));
+        if (!in.read(reinterpret_cast<char *>(index.data()),
+                     static_cast<std::streamsize>(index.size() * sizeof(offset_type))))
+          return false;
+
+        // Reject offsets which can't be valid for this file.
+        for (const auto& offset : index)
+          if (offset == 0U || offset >= filesize)
+            return false;
+
+        offsets.swap(index);
+        return true;
+      }
+
+      void
+      writeDirectoryIndex(const boost::filesystem::path&  filename,
+                          const std::vector<offset_type>& offsets)
+      {
+        Header header;
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.byteorder = byteorder;
+        header.count = offsets.size();
+        if (!fileStamp(filename, header.filesize, header.mtime))
+          {
+            boost::format fmt("Failed to get size and modification time of ‘%1%’");
+            fmt % filename.string();
+            throw Exception(fmt.str());
+          }
+
+        boost::filesystem::path sidecar(directoryIndexPath(filename));
+        boost::filesystem::path tmp(sidecar);
+        tmp += boost::filesystem::unique_path(".%%%%-%%%%-%%%%.tmp");
+
+        {
+          boost::filesystem::ofstream out(tmp,
+                                          std::ios::out | std::ios::binary | std::ios::trunc);
+          if (out)
+            {
+              out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+              out.write(reinterpret_cast<const char *>(offsets.data()),
+                        static_cast<std::streamsize>(offsets.size() * sizeof(offset_type)));
+              out.close();
+            }
+          if (!out)
+            {
+              boost::system::error_code ec;
+              boost::filesystem::remove(tmp, ec);
+              boost::format fmt("Failed to write directory index ‘%1%’");
+              fmt % sidecar.string();
+              throw Exception(fmt.str());
+            }
+        }
+
+        boost::system::error_code ec;
+        boost::filesystem::rename(tmp, sidecar, ec);
+        if (ec)
+          {
+            boost::filesystem::remove(tmp, ec);
+            boost::format fmt("Failed to write directory index ‘%1%’");
+            fmt % sidecar.string();
+            throw Exception(fmt.str());
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,109 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TIFF_DIRECTORYINDEX_H
+#define OME_FILES_TIFF_DIRECTORYINDEX_H
+
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/tiff/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      /**
+       * Get the sidecar directory index filename for a TIFF file.
+       *
+       * The sidecar is placed alongside the TIFF file, with an
+       * additional @c .ifdx extension.
+       *
+       * @param filename the TIFF filename.
+       * @returns the sidecar filename.
+       */
+      boost::filesystem::path
+      directoryIndexPath(const boost::filesystem::path& filename);
+
+      /**
+       * Read a sidecar directory index.
+       *
+       * The sidecar records the size and modification time of the
+       * TIFF file it was created from.  If these no longer match,
+       * or the sidecar is missing, unreadable or corrupt, the
+       * sidecar is ignored.
+       *
+       * @param filename the TIFF filename.
+       * @param offsets the directory offsets to set.
+       * @returns @c true if the offsets were read, or @c false if
+       * the sidecar could not be used.
+       */
+      bool
+      readDirectoryIndex(const boost::filesystem::path& filename,
+                         std::vector<offset_type>&      offsets);
+
+      /**
+       * Write a sidecar directory index.
+       *
+       * The sidecar is written to a temporary file and renamed into
+       * place, so that concurrent readers never see a partial index.
+       *
+       * @param filename the TIFF filename.
+       * @param offsets the directory offsets to store.
+       * @throws an Exception if the sidecar could not be written.
+       */
+      void
+      writeDirectoryIndex(const boost::filesystem::path&  filename,
+                          const std::vector<offset_type>& offsets);
+
+    }
+  }
+}
+
+#endif // OME_FILES_TIFF_DIRECTORYINDEX_H
+
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,481 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/format.hpp>
+
+#include <ome/files/tiff/ByteSource.h>
+#include <ome/files/tiff/DirectoryParser.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/Util.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      namespace
+      {
+
+        // Tag numbers used for core metadata.
+        const tag_type tag_new_subfile_type = 254U;
+        const tag_type tag_image_width = 256U;
+        const tag_type tag_image_length = 257U;
+        const tag_type tag_bits_per_sample = 258U;
+        const tag_type tag_compression = 259U;
+        const tag_type tag_image_description = 270U;
+        const tag_type tag_samples_per_pixel = 277U;
+        const tag_type tag_rows_per_strip = 278U;
+        const tag_type tag_planar_configuration = 284U;
+        const tag_type tag_tile_width = 322U;
+        const tag_type tag_tile_length = 323U;
+        const tag_type tag_sample_format = 339U;
+
+        // Size of a value of the given type, or zero if unknown.
+        unsigned int
+        typeSize(Type type)
+        {
+          switch (type)
+            {
+            case TYPE_BYTE:
+            case TYPE_ASCII:
+            case TYPE_SBYTE:
+            case TYPE_UNDEFINED:
+              return 1U;
+            case TYPE_SHORT:
+            case TYPE_SSHORT:
+              return 2U;
+            case TYPE_LONG:
+            case TYPE_SLONG:
+            case TYPE_FLOAT:
+            case TYPE_IFD:
+              return 4U;
+            case TYPE_RATIONAL:
+            case TYPE_SRATIONAL:
+            case TYPE_DOUBLE:
+            case TYPE_LONG8:
+            case TYPE_SLONG8:
+            case TYPE_IFD8:
+              return 8U;
+            default:
+              return 0U;
+            }
+        }
+
+      }
+
+      const DirectoryParser::Entry *
+      DirectoryParser::Directory::find(tag_type tag) const
+      {
+        auto i = std::lower_bound(entries.begin(), entries.end(), tag,
+                                  [](const Entry& e, tag_type t) { return e.tag < t; });
+        if (i != entries.end() && i->tag == tag)
+          return &*i;
+        return nullptr;
+      }
+
+      DirectoryParser::DirectoryParser(std::shared_ptr<ByteSource> source):
+        source(source),
+        sourcesize(source ? source->size() : 0U),
+        bigendian(false),
+        bigtiff(false),
+        mutex(),
+        offsets(),
+        seen(),
+        complete(false)
+      {
+        if (!source)
+          throw Exception("Null ByteSource");
+
+        uint8_t header[16];
+        const dimension_size_type headersize = static_cast<dimension_size_type>(std::min(offset_type(16U), sourcesize));
+        source->read(0U, header, headersize);
+        if (!isTIFFHeader(header, header + headersize))
+          {
+            boost::format fmt("‘%1%’ is not a TIFF");
+            fmt % source->name();
+            throw Exception(fmt.str());
+          }
+
+        bigendian = header[0] == 'M';
+        bigtiff = decode(header + 2, 2U) == 43U;
+
+        // BigTIFF offsets must be 8 bytes.
+        if (bigtiff && (headersize < 16U || decode(header + 4, 2U) != 8U))
+          {
+            boost::format fmt("‘%1%’ has an invalid BigTIFF header");
+            fmt % source->name();
+            throw Exception(fmt.str());
+          }
+        if (!bigtiff && headersize < 8U)
+          {
+            boost::format fmt("‘%1%’ has a truncated TIFF header");
+            fmt % source->name();
+            throw Exception(fmt.str());
+          }
+
+        const offset_type first = bigtiff ? decode(header + 8, 8U) : decode(header + 4, 4U);
+        if (first)
+          {
+            offsets.push_back(first);
+            seen.insert(first);
+          }
+        else
+          complete = true;
+      }
+
+      DirectoryParser::DirectoryParser(const boost::filesystem::path& filename):
+        DirectoryParser(std::make_shared<FileByteSource>(filename))
+      {
+      }
+
+      DirectoryParser::~DirectoryParser()
+      {
+      }
+
+      bool
+      DirectoryParser::isBigEndian() const
+      {
+        return bigendian;
+      }
+
+      bool
+      DirectoryParser::isBigTIFF() const
+      {
+        return bigtiff;
+      }
+
+      dimension_size_type
+      DirectoryParser::directoryCount() const
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        walk(std::numeric_limits<dimension_size_type>::max());
+        return offsets.size();
+      }
+
+      offset_type
+      DirectoryParser::directoryOffset(dimension_size_type index) const
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        walk(index);
+        if (index >= offsets.size())
+          {
+            boost::format fmt("IFD index %1% out of range in ‘%2%’ (%3% IFDs)");
+            fmt % index % source->name() % offsets.size();
+            throw Exception(fmt.str());
+          }
+
+        return offsets[index];
+      }
+
+      DirectoryParser::Directory
+      DirectoryParser::directory(dimension_size_type index) const
+      {
+        return directoryAt(directoryOffset(index));
+      }
+
+      DirectoryParser::Directory
+      DirectoryParser::directoryAt(offset_type offset) const
+      {
+        const unsigned int countsize = bigtiff ? 8U : 2U;
+        const unsigned int entrysize = bigtiff ? 20U : 12U;
+        const unsigned int offsetsize = bigtiff ? 8U : 4U;
+
+        uint8_t countbuf[8];
+        read(offset, countbuf, countsize);
+        const uint64_t count = decode(countbuf, countsize);
+        if (count > (sourcesize - offset - countsize) / entrysize)
+          {
+            boost::format fmt("IFD at offset %1% in ‘%2%’ has too many entries (%3%)");
+            fmt % offset % source->name() % count;
+            throw Exception(fmt.str());
+          }
+
+        std::vector<uint8_t> data(static_cast<std::vector<uint8_t>::size_type>(count * entrysize + offsetsize));
+        read(offset + countsize, data.data(), data.size());
+
+        Directory dir;
+        dir.offset = offset;
+        dir.next = decode(data.data() + count * entrysize, offsetsize);
+        dir.entries.reserve(static_cast<std::vector<Entry>::size_type>(count));
+
+        for (uint64_t i = 0; i < count; ++i)
+          {
+            const uint8_t *e = data.data() + (i * entrysize);
+            Entry entry;
+            entry.tag = static_cast<tag_type>(decode(e, 2U));
+            entry.type = static_cast<Type>(decode(e + 2, 2U));
+            entry.count = decode(e + 4, offsetsize);
+            entry.offset = 0U;
+            entry.value.fill(0U);
+
+            const uint8_t *value = e + 4 + offsetsize;
+            const unsigned int size = typeSize(entry.type);
+            entry.inlined = !size || entry.count <= offsetsize / size;
+            if (entry.inlined)
+              std::copy(value, value + offsetsize, entry.value.begin());
+            else
+              entry.offset = decode(value, offsetsize);
+
+            dir.entries.push_back(entry);
+          }
+
+        // Entries should be sorted, but this is not always the case.
+        std::stable_sort(dir.entries.begin(), dir.entries.end(),
+                         [](const Entry& lhs, const Entry& rhs) { return lhs.tag < rhs.tag; });
+
+        return dir;
+      }
+
+      std::vector<uint64_t>
+      DirectoryParser::getUnsigned(const Entry& entry) const
+      {
+        switch (entry.type)
+          {
+          case TYPE_BYTE:
+          case TYPE_SHORT:
+          case TYPE_LONG:
+          case TYPE_IFD:
+          case TYPE_LONG8:
+          case TYPE_IFD8:
+            break;
+          default:
+            {
+              boost::format fmt("Tag %1% of type %2% is not an unsigned integer");
+              fmt % entry.tag % entry.type;
+              throw Exception(fmt.str());
+            }
+          }
+
+        const unsigned int size = typeSize(entry.type);
+        std::vector<uint8_t> buf;
+        const uint8_t *data = entry.value.data();
+        if (!entry.inlined)
+          {
+            if (entry.count > sourcesize / size)
+              {
+                boost::format fmt("Tag %1% values are beyond the end of ‘%2%’");
+                fmt % entry.tag % source->name();
+                throw Exception(fmt.str());
+              }
+            buf.resize(static_cast<std::vector<uint8_t>::size_type>(entry.count * size));
+            read(entry.offset, buf.data(), buf.size());
+            data = buf.data();
+          }
+
+        std::vector<uint64_t> values(static_cast<std::vector<uint64_t>::size_type>(entry.count));
+        for (std::vector<uint64_t>::size_type i = 0; i < values.size(); ++i)
+          values[i] = decode(data + (i * size), size);
+        return values;
+      }
+
+      std::string
+      DirectoryParser::getString(const Entry& entry) const
+      {
+        switch (entry.type)
+          {
+          case TYPE_ASCII:
+          case TYPE_BYTE:
+          case TYPE_UNDEFINED:
+            break;
+          default:
+            {
+              boost::format fmt("Tag %1% of type %2% is not a string");
+              fmt % entry.tag % entry.type;
+              throw Exception(fmt.str());
+            }
+          }
+
+        std::string value;
+        if (entry.inlined)
+          value.assign(reinterpret_cast<const char *>(entry.value.data()),
+                       static_cast<std::string::size_type>(entry.count));
+        else
+          {
+            if (entry.count > sourcesize)
+              {
+                boost::format fmt("Tag %1% value is beyond the end of ‘%2%’");
+                fmt % entry.tag % source->name();
+                throw Exception(fmt.str());
+              }
+            value.resize(static_cast<std::string::size_type>(entry.count));
+            read(entry.offset, &value[0], value.size());
+          }
+
+        // Drop the terminating NUL.
+        const std::string::size_type nul = value.find('\0');
+        if (nul != std::string::npos)
+          value.resize(nul);
+        return value;
+      }
+
+      DirectoryParser::Summary
+      DirectoryParser::summary(dimension_size_type index) const
+      {
+        const Directory dir(directory(index));
+
+        // The first value of a tag, or the default if not present.
+        auto first = [&](tag_type tag, uint64_t def) -> uint64_t
+          {
+            const Entry *entry = dir.find(tag);
+            if (!entry || !entry->count)
+              return def;
+            return getUnsigned(*entry).front();
+          };
+
+        Summary s;
+        if (!dir.find(tag_image_width) || !dir.find(tag_image_length))
+          {
+            boost::format fmt("IFD %1% in ‘%2%’ has no image dimensions");
+            fmt % index % source->name();
+            throw Exception(fmt.str());
+          }
+        s.width = first(tag_image_width, 0U);
+        s.height = first(tag_image_length, 0U);
+        s.samplesPerPixel = first(tag_samples_per_pixel, 1U);
+        s.bitsPerSample = static_cast<uint16_t>(first(tag_bits_per_sample, 1U));
+        s.sampleFormat = static_cast<SampleFormat>(first(tag_sample_format, UNSIGNED_INT));
+        s.planarConfiguration = static_cast<PlanarConfiguration>(first(tag_planar_configuration, CONTIG));
+        s.compression = static_cast<Compression>(first(tag_compression, COMPRESSION_NONE));
+        s.subfileType = first(tag_new_subfile_type, 0U);
+
+        if (dir.find(tag_tile_width))
+          {
+            s.tileType = TILE;
+            s.tileWidth = first(tag_tile_width, 0U);
+            s.tileHeight = first(tag_tile_length, 0U);
+          }
+        else
+          {
+            s.tileType = STRIP;
+            s.tileWidth = s.width;
+            s.tileHeight = std::min(first(tag_rows_per_strip, std::numeric_limits<uint32_t>::max()), s.height);
+          }
+
+        try
+          {
+            s.pixelType = pixelTypeFromSampleFormat(s.sampleFormat, s.bitsPerSample);
+          }
+        catch (const Exception&)
+          {
+            // Not supported by the OME data model.
+          }
+
+        const Entry *description = dir.find(tag_image_description);
+        if (description)
+          s.description = getString(*description);
+
+        return s;
+      }
+
+      void
+      DirectoryParser::read(offset_type         offset,
+                            void               *buf,
+                            dimension_size_type size) const
+      {
+        if (offset > sourcesize || size > sourcesize - offset)
+          {
+            boost::format fmt("Read of %1% bytes at offset %2% is beyond the end of ‘%3%’ (%4% bytes)");
+            fmt % size % offset % source->name() % sourcesize;
+            throw Exception(fmt.str());
+          }
+        source->read(offset, buf, size);
+      }
+
+      uint64_t
+      DirectoryParser::decode(const uint8_t *data,
+                              unsigned int   size) const
+      {
+        uint64_t value = 0U;
+        for (unsigned int i = 0; i < size; ++i)
+          {
+            const unsigned int shift = 8U * (bigendian ? (size - 1U - i) : i);
+            value |= static_cast<uint64_t>(data[i]) << shift;
+          }
+        return value;
+      }
+
+      offset_type
+      DirectoryParser::nextOffset(offset_type offset) const
+      {
+        const unsigned int countsize = bigtiff ? 8U : 2U;
+        const unsigned int entrysize = bigtiff ? 20U : 12U;
+        const unsigned int offsetsize = bigtiff ? 8U : 4U;
+
+        uint8_t buf[8];
+        read(offset, buf, countsize);
+        const uint64_t count = decode(buf, countsize);
+        if (count > (sourcesize - offset - countsize) / entrysize)
+          {
+            boost::format fmt("IFD at offset %1% in ‘%2%’ has too many entries (%3%)");
+            fmt % offset % source->name() % count;
+            throw Exception(fmt.str());
+          }
+
+        read(offset + countsize + (count * entrysize), buf, offsetsize);
+        return decode(buf, offsetsize);
+      }
+
+      void
+      DirectoryParser::walk(dimension_size_type index) const
+      {
+        while (index >= offsets.size() && !complete)
+          {
+            const offset_type next = nextOffset(offsets.back());
+            if (!next)
+              complete = true;
+            else if (!seen.insert(next).second)
+              {
+                boost::format fmt("IFD loop detected at offset %1% in ‘%2%’");
+                fmt % next % source->name();
+                throw Exception(fmt.str());
+              }
+            else
+              offsets.push_back(next);
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,370 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TIFF_DIRECTORYPARSER_H
+#define OME_FILES_TIFF_DIRECTORYPARSER_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <ome/files/Types.h>
+#include <ome/files/tiff/Types.h>
+
+#include <ome/xml/model/enums/PixelType.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      class ByteSource;
+
+      /**
+       * Lightweight TIFF directory parser.
+       *
+       * This reads the IFD structure of classic TIFF and BigTIFF
+       * files directly from a ByteSource, without using libtiff.
+       * It is intended for metadata-only operations such as format
+       * detection, counting IFDs and reading core metadata (the
+       * image dimensions, pixel type and ImageDescription), where
+       * opening the file with TIFF::open() would set up a full
+       * directory, initialise codecs and serialise on the libtiff
+       * Sentry lock.  Pixel data can not be read.
+       *
+       * Only the bytes needed are read: the header on construction,
+       * and the entries of each directory used.  Tag values stored
+       * out of line are read only when requested.  There is no
+       * global state; a parser may be used by several threads
+       * concurrently, provided that its ByteSource is thread-safe.
+       */
+      class DirectoryParser
+      {
+      public:
+        /// A directory entry.
+        struct Entry
+        {
+          /// Tag number.
+          tag_type tag;
+          /// Value type.
+          Type type;
+          /// Number of values.
+          uint64_t count;
+          /// Offset of the values, if not stored in the entry.
+          offset_type offset;
+          /// Values stored in the entry, in file byte order.
+          std::array<uint8_t, 8> value;
+          /// @c true if the values are stored in the entry.
+          bool inlined;
+        };
+
+        /// A directory.
+        struct Directory
+        {
+          /// Offset of the directory.
+          offset_type offset;
+          /// Offset of the next directory, or zero if the last.
+          offset_type next;
+          /// Entries, in tag order.
+          std::vector<Entry> entries;
+
+          /**
+           * Find an entry.
+           *
+           * @param tag the tag number.
+           * @returns the entry, or null if not present.
+           */
+          const Entry *
+          find(tag_type tag) const;
+        };
+
+        /// Core metadata for a directory.
+        struct Summary
+        {
+          /// Image width (pixels).
+          uint64_t width;
+          /// Image height (pixels).
+          uint64_t height;
+          /// Samples per pixel.
+          uint64_t samplesPerPixel;
+          /// Bits per sample.
+          uint16_t bitsPerSample;
+          /// Sample format.
+          SampleFormat sampleFormat;
+          /// Planar configuration.
+          PlanarConfiguration planarConfiguration;
+          /// Compression.
+          Compression compression;
+          /// Strips or tiles.
+          TileType tileType;
+          /// Tile or strip width (pixels).
+          uint64_t tileWidth;
+          /// Tile or strip height (pixels).
+          uint64_t tileHeight;
+          /// Subfile type (zero if not set).
+          uint64_t subfileType;
+          /// Pixel type, if supported.
+          boost::optional<::ome::xml::model::enums::PixelType> pixelType;
+          /// ImageDescription, if present.
+          boost::optional<std::string> description;
+        };
+
+      private:
+        /// Source to parse.
+        std::shared_ptr<ByteSource> source;
+        /// Source size.
+        offset_type sourcesize;
+        /// Big-endian byte order.
+        bool bigendian;
+        /// BigTIFF.
+        bool bigtiff;
+        /// Mutex protecting the directory offsets.
+        mutable std::mutex mutex;
+        /// Offsets of the directories found so far.
+        mutable std::vector<offset_type> offsets;
+        /// Offsets of the directories found so far, for loop detection.
+        mutable std::set<offset_type> seen;
+        /// @c true if all directory offsets have been found.
+        mutable bool complete;
+
+      public:
+        /**
+         * Constructor.
+         *
+         * The TIFF header is read and checked.
+         *
+         * @param source the source to parse.
+         * @throws an Exception if the source is null or is not a
+         * TIFF.
+         */
+        explicit
+        DirectoryParser(std::shared_ptr<ByteSource> source);
+
+        /**
+         * Constructor.
+         *
+         * @param filename the file to parse.
+         * @throws an Exception if the file could not be opened or
+         * is not a TIFF.
+         */
+        explicit
+        DirectoryParser(const boost::filesystem::path& filename);
+
+        /// Destructor.
+        ~DirectoryParser();
+
+        /// @cond SKIP
+        DirectoryParser (const DirectoryParser&) = delete;
+
+        DirectoryParser&
+        operator= (const DirectoryParser&) = delete;
+        /// @endcond SKIP
+
+        /**
+         * Check if the TIFF is big-endian.
+         *
+         * @returns @c true if big-endian, @c false if little-endian.
+         */
+        bool
+        isBigEndian() const;
+
+        /**
+         * Check if the TIFF is a BigTIFF.
+         *
+         * @returns @c true if BigTIFF, @c false if classic TIFF.
+         */
+        bool
+        isBigTIFF() const;
+
+        /**
+         * Get the total number of IFDs.
+         *
+         * This walks the chain of IFDs, reading only the entry count
+         * and next IFD offset of each.  SubIFDs are not included.
+         *
+         * @returns the IFD count.
+         * @throws an Exception if the IFD chain is invalid.
+         */
+        dimension_size_type
+        directoryCount() const;
+
+        /**
+         * Get the offset of an IFD.
+         *
+         * @param index the directory index.
+         * @returns the offset.
+         * @throws an Exception if the index is invalid.
+         */
+        offset_type
+        directoryOffset(dimension_size_type index) const;
+
+        /**
+         * Parse an IFD.
+         *
+         * @param index the directory index.
+         * @returns the directory.
+         * @throws an Exception if the index is invalid or the
+         * directory could not be parsed.
+         */
+        Directory
+        directory(dimension_size_type index) const;
+
+        /**
+         * Parse an IFD at a given offset.
+         *
+         * This may be used for SubIFDs.
+         *
+         * @param offset the directory offset.
+         * @returns the directory.
+         * @throws an Exception if the directory could not be
+         * parsed.
+         */
+        Directory
+        directoryAt(offset_type offset) const;
+
+        /**
+         * Get the values of an entry as unsigned integers.
+         *
+         * Entries of type BYTE, SHORT, LONG, LONG8, IFD and IFD8 are
+         * supported.
+         *
+         * @param entry the entry.
+         * @returns the values.
+         * @throws an Exception if the entry type is not an unsigned
+         * integer type, or the values could not be read.
+         */
+        std::vector<uint64_t>
+        getUnsigned(const Entry& entry) const;
+
+        /**
+         * Get the value of an entry as a string.
+         *
+         * Entries of type ASCII, BYTE and UNDEFINED are supported.
+         * The string ends at the first NUL.
+         *
+         * @param entry the entry.
+         * @returns the value.
+         * @throws an Exception if the entry type is not supported, or
+         * the value could not be read.
+         */
+        std::string
+        getString(const Entry& entry) const;
+
+        /**
+         * Get the core metadata of an IFD.
+         *
+         * Tags which are not present take their TIFF default values.
+         *
+         * @param index the directory index.
+         * @returns the core metadata.
+         * @throws an Exception if the directory could not be parsed,
+         * or the image dimensions are not present.
+         */
+        Summary
+        summary(dimension_size_type index) const;
+
+      private:
+        /**
+         * Read from the source.
+         *
+         * @param offset the offset to read from.
+         * @param buf the buffer to read into.
+         * @param size the number of bytes to read.
+         * @throws an Exception if the range is beyond the end of the
+         * source.
+         */
+        void
+        read(offset_type         offset,
+             void               *buf,
+             dimension_size_type size) const;
+
+        /**
+         * Decode an unsigned integer in file byte order.
+         *
+         * @param data the data to decode.
+         * @param size the size of the integer (bytes).
+         * @returns the value.
+         */
+        uint64_t
+        decode(const uint8_t *data,
+               unsigned int   size) const;
+
+        /**
+         * Read the offset of the IFD following an IFD.
+         *
+         * @param offset the IFD offset.
+         * @returns the next IFD offset, or zero if the last.
+         */
+        offset_type
+        nextOffset(offset_type offset) const;
+
+        /**
+         * Walk the IFD chain to find the offset of an IFD.
+         *
+         * This stops once the offset of the IFD is known, or the
+         * last IFD is reached.
+         *
+         * @note The caller must hold the mutex.
+         *
+         * @param index the directory index.
+         * @throws an Exception if the IFD chain is invalid.
+         */
+        void
+        walk(dimension_size_type index) const;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_TIFF_DIRECTORYPARSER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
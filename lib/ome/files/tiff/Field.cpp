@@ -131,7 +131,7 @@ namespace ome
         {
           if (!fieldinfo)
             {
-              Sentry sentry;
+              Sentry sentry(*getIFD()->getTIFF(), IOStatistics::LOCK_TAG);
 
               fieldinfo = TIFFFindField(getTIFF(), tag, TIFF_ANY);
               // The returned tag is sometimes incorrect (all libtiff versions)
@@ -201,7 +201,7 @@ namespace ome
       {
         std::string ret("Unknown");
 
-        Sentry sentry;
+        Sentry sentry(*impl->getIFD()->getTIFF(), IOStatistics::LOCK_TAG);
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -223,7 +223,7 @@ namespace ome
       {
         Type ret = TYPE_UNDEFINED;
 
-        Sentry sentry;
+        Sentry sentry(*impl->getIFD()->getTIFF(), IOStatistics::LOCK_TAG);
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -237,7 +237,7 @@ namespace ome
       {
         bool ret = false;
 
-        Sentry sentry;
+        Sentry sentry(*impl->getIFD()->getTIFF(), IOStatistics::LOCK_TAG);
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -251,7 +251,7 @@ namespace ome
       {
         int ret = 1;
 
-        Sentry sentry;
+        Sentry sentry(*impl->getIFD()->getTIFF(), IOStatistics::LOCK_TAG);
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -265,7 +265,7 @@ namespace ome
       {
         int ret = 1;
 
-        Sentry sentry;
+        Sentry sentry(*impl->getIFD()->getTIFF(), IOStatistics::LOCK_TAG);
 
         const ::TIFFField *field = impl->getFieldInfo();
         if (field)
@@ -715,6 +715,27 @@ namespace ome
           }
       }
 
+      /// @copydoc Field::view()
+      template<>
+      void
+      Field<StringTag1>::view(const char *& text,
+                              std::size_t&  length) const
+      {
+        if (type() != TYPE_ASCII &&
+            passCount() != false)
+          throw Exception("FieldInfo mismatch with Field handler");
+
+        int rc = readCount();
+
+        if (rc != TIFF_VARIABLE && rc != TIFF_VARIABLE2)
+          throw Exception("Field value with fixed count can not be viewed");
+
+        char *value;
+        getIFD()->getRawField(impl->tag, &value);
+        text = value;
+        length = std::char_traits<char>::length(value);
+      }
+
       /// @copydoc Field::set()
       template<>
       void
@@ -38,6 +38,7 @@
 #ifndef OME_FILES_TIFF_FIELD_H
 #define OME_FILES_TIFF_FIELD_H
 
+#include <cstddef>
 #include <memory>
 #include <string>
 
@@ -191,6 +192,25 @@ namespace ome
         void
         get(value_type& value) const;
 
+        /**
+         * Get the value for this field without copying.
+         *
+         * This is only available for ASCII fields with a variable
+         * count, such as ImageDescription, which may be very large.
+         * The text is owned by libtiff, and is valid only while the
+         * IFD remains the current directory of its TIFF, and the
+         * field is not set.  Use get() for a copy which is not
+         * subject to these restrictions.
+         *
+         * @param text set to the start of the field value.
+         * @param length set to the length of the field value,
+         * excluding the terminating null.
+         * @throws Exception if the field value can not be viewed.
+         */
+        void
+        view(const char *& text,
+             std::size_t&  length) const;
+
         /**
          * Set the value for this field.
          *
@@ -0,0 +1,264 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <ome/files/tiff/HandleCache.h>
+#include <ome/files/tiff/TIFF.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      HandleCache::HandleCache(dimension_size_type limit):
+        mutex(),
+        limit(limit),
+        hitcount(0U),
+        misscount(0U),
+        reopencount(0U),
+        evictcount(0U),
+        lru(),
+        index(),
+        evicted()
+      {
+      }
+
+      HandleCache::~HandleCache()
+      {
+      }
+
+      const std::shared_ptr<HandleCache>&
+      HandleCache::global()
+      {
+        static std::shared_ptr<HandleCache> cache(std::make_shared<HandleCache>());
+        return cache;
+      }
+
+      std::shared_ptr<TIFF>
+      HandleCache::get(const key_type&      key,
+                       const open_function& open)
+      {
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+
+          auto i = index.find(key);
+          if (i != index.end())
+            {
+              ++hitcount;
+              // Move to front (most recently used).
+              lru.splice(lru.begin(), lru, i->second);
+              return i->second->second;
+            }
+        }
+
+        // Open without holding the lock, since opening may be slow.
+        std::shared_ptr<TIFF> tiff(open());
+        if (!tiff)
+          return tiff;
+
+        std::lock_guard<std::mutex> guard(mutex);
+
+        // Another thread may have opened the same handle meanwhile;
+        // if so, use it and discard this one.
+        auto i = index.find(key);
+        if (i != index.end())
+          {
+            ++hitcount;
+            lru.splice(lru.begin(), lru, i->second);
+            tiff->close();
+            return i->second->second;
+          }
+
+        ++misscount;
+        if (evicted.erase(key))
+          ++reopencount;
+
+        lru.push_front(std::make_pair(key, tiff));
+        index.insert(std::make_pair(key, lru.begin()));
+
+        evict();
+
+        return tiff;
+      }
+
+      void
+      HandleCache::close(const key_type& key)
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        evicted.erase(key);
+
+        auto i = index.find(key);
+        if (i != index.end())
+          {
+            i->second->second->close();
+            lru.erase(i->second);
+            index.erase(i);
+          }
+      }
+
+      void
+      HandleCache::close(const void *owner)
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        for (auto i = lru.begin(); i != lru.end();)
+          {
+            if (i->first.first == owner)
+              {
+                i->second->close();
+                index.erase(i->first);
+                i = lru.erase(i);
+              }
+            else
+              ++i;
+          }
+
+        for (auto i = evicted.begin(); i != evicted.end();)
+          {
+            if (i->first == owner)
+              i = evicted.erase(i);
+            else
+              ++i;
+          }
+      }
+
+      void
+      HandleCache::forEach(const void                        *owner,
+                           const std::function<void (TIFF&)>& func)
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        for (auto& entry : lru)
+          if (entry.first.first == owner)
+            func(*entry.second);
+      }
+
+      void
+      HandleCache::setLimit(dimension_size_type limit)
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        this->limit = limit;
+        evict();
+      }
+
+      dimension_size_type
+      HandleCache::getLimit() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return limit;
+      }
+
+      dimension_size_type
+      HandleCache::count() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return lru.size();
+      }
+
+      dimension_size_type
+      HandleCache::hits() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return hitcount;
+      }
+
+      dimension_size_type
+      HandleCache::misses() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return misscount;
+      }
+
+      dimension_size_type
+      HandleCache::reopens() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return reopencount;
+      }
+
+      dimension_size_type
+      HandleCache::evictions() const
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        return evictcount;
+      }
+
+      void
+      HandleCache::resetStatistics()
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+
+        hitcount = misscount = reopencount = evictcount = 0U;
+      }
+
+      void
+      HandleCache::evict()
+      {
+        if (!limit)
+          return;
+
+        // Handles referenced outside the cache are in use, and are
+        // skipped.  Since references are only obtained from the
+        // cache while locked, an idle handle can not be acquired
+        // while it is being closed.
+        for (auto i = lru.end(); lru.size() > limit && i != lru.begin();)
+          {
+            --i;
+            if (i->second.use_count() == 1)
+              {
+                i->second->close();
+                evicted.insert(i->first);
+                index.erase(i->first);
+                i = lru.erase(i);
+                ++evictcount;
+              }
+          }
+      }
+
+    }
+  }
+}
@@ -0,0 +1,275 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TIFF_HANDLECACHE_H
+#define OME_FILES_TIFF_HANDLECACHE_H
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      class TIFF;
+
+      /**
+       * Cache of open TIFF handles.
+       *
+       * This bounds the number of TIFF files held open by readers
+       * which reference many files, such as OMETIFFReader.  Handles
+       * are indexed by owner (an opaque pointer, typically the
+       * reader) and filename, so that handles are never shared
+       * between owners.  When the number of open handles exceeds the
+       * limit, the least recently used idle handles are closed; a
+       * handle is idle when it is not referenced outside the cache.
+       * Closed handles are transparently reopened on next access.
+       * Handles in use are never closed, so the limit may be
+       * exceeded temporarily.  A limit of zero disables closing.
+       *
+       * A single process-wide cache is available with global().
+       * All methods are thread-safe.
+       */
+      class HandleCache
+      {
+      public:
+        /// Cache key (owner and filename).
+        typedef std::pair<const void *, boost::filesystem::path> key_type;
+
+        /// Function to open a TIFF (may return null on failure).
+        typedef std::function<std::shared_ptr<TIFF> ()> open_function;
+
+        /**
+         * Constructor.
+         *
+         * @param limit the maximum number of open handles.
+         */
+        explicit
+        HandleCache(dimension_size_type limit = 0U);
+
+        /// Destructor.
+        virtual ~HandleCache();
+
+        /// @cond SKIP
+        HandleCache (const HandleCache&) = delete;
+
+        HandleCache&
+        operator= (const HandleCache&) = delete;
+        /// @endcond SKIP
+
+        /**
+         * Get the process-wide handle cache.
+         *
+         * The limit is initially zero (unlimited).
+         *
+         * @returns the process-wide cache.
+         */
+        static
+        const std::shared_ptr<HandleCache>&
+        global();
+
+        /**
+         * Get an open handle.
+         *
+         * If the handle is open, it becomes the most recently used
+         * handle and the hit counter is incremented.  Otherwise, it
+         * is opened with @p open and the miss counter (and also the
+         * reopen counter, if it was previously closed by the cache)
+         * is incremented, and the least recently used idle handles
+         * are closed until the cache fits within its limit.  The
+         * cache is not locked while opening.
+         *
+         * @param key the handle to get.
+         * @param open the function to open the handle if needed.
+         * @returns the open handle, or null if it could not be
+         * opened.
+         */
+        std::shared_ptr<TIFF>
+        get(const key_type&      key,
+            const open_function& open);
+
+        /**
+         * Close and remove a handle.
+         *
+         * The handle is closed even if in use.
+         *
+         * @param key the handle to close.
+         */
+        void
+        close(const key_type& key);
+
+        /**
+         * Close and remove all handles belonging to an owner.
+         *
+         * The handles are closed even if in use.
+         *
+         * @param owner the owner of the handles to close.
+         */
+        void
+        close(const void *owner);
+
+        /**
+         * Call a function for each open handle belonging to an owner.
+         *
+         * This may be used to apply settings to the open handles.
+         * The cache is locked while calling the function.
+         *
+         * @param owner the owner of the handles.
+         * @param func the function to call.
+         */
+        void
+        forEach(const void                        *owner,
+                const std::function<void (TIFF&)>& func);
+
+        /**
+         * Set the open handle limit.
+         *
+         * If the cache exceeds the new limit, the least recently
+         * used idle handles are closed.
+         *
+         * @param limit the maximum number of open handles.
+         */
+        void
+        setLimit(dimension_size_type limit);
+
+        /**
+         * Get the open handle limit.
+         *
+         * @returns the maximum number of open handles.
+         */
+        dimension_size_type
+        getLimit() const;
+
+        /**
+         * Get the number of open handles.
+         *
+         * @returns the open handle count.
+         */
+        dimension_size_type
+        count() const;
+
+        /**
+         * Get the number of lookups of open handles.
+         *
+         * @returns the hit count.
+         */
+        dimension_size_type
+        hits() const;
+
+        /**
+         * Get the number of lookups requiring a handle to be opened.
+         *
+         * @returns the miss count.
+         */
+        dimension_size_type
+        misses() const;
+
+        /**
+         * Get the number of handles reopened after being closed by
+         * the cache.
+         *
+         * @returns the reopen count.
+         */
+        dimension_size_type
+        reopens() const;
+
+        /**
+         * Get the number of idle handles closed by the cache.
+         *
+         * @returns the eviction count.
+         */
+        dimension_size_type
+        evictions() const;
+
+        /**
+         * Reset the hit, miss, reopen and eviction counters to zero.
+         */
+        void
+        resetStatistics();
+
+      private:
+        /// Handles in order of use (most recently used first).
+        typedef std::list<std::pair<key_type, std::shared_ptr<TIFF>>> lru_type;
+
+        /// Close least recently used idle handles to fit within the limit.
+        void
+        evict();
+
+        /// Mutex serialising access to the cache.
+        mutable std::mutex mutex;
+        /// Maximum number of open handles.
+        dimension_size_type limit;
+        /// Lookups of open handles.
+        dimension_size_type hitcount;
+        /// Lookups requiring a handle to be opened.
+        dimension_size_type misscount;
+        /// Handles reopened after eviction.
+        dimension_size_type reopencount;
+        /// Handles closed by eviction.
+        dimension_size_type evictcount;
+        /// Handles in order of use.
+        lru_type lru;
+        /// Mapping of key to handle.
+        std::map<key_type, lru_type::iterator> index;
+        /// Handles closed by eviction, which have not been reopened.
+        std::set<key_type> evicted;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_TIFF_HANDLECACHE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
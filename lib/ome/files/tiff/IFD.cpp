@@ -37,20 +37,51 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <cstdarg>
 #include <cassert>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h> // For O_RDONLY on Unix and Windows
 
 #include <boost/format.hpp>
 
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PixelStatistics.h>
 #include <ome/files/PlaneRegion.h>
 #include <ome/files/TileBuffer.h>
+#include <ome/files/TileBufferPool.h>
 #include <ome/files/TileCache.h>
+#include <ome/files/config-internal.h>
+#include <ome/files/detail/BatchRead.h>
+#include <ome/files/detail/BitPack.h>
+#include <ome/files/detail/ByteSwap.h>
+#include <ome/files/detail/HalfFloat.h>
+#include <ome/files/detail/IOStatistics.h>
+#include <ome/files/detail/Normalize.h>
+#include <ome/files/detail/Trace.h>
+#include <ome/files/detail/tiff/JPEGCodec.h>
+#include <ome/files/tiff/Codec.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/Tags.h>
+#include <ome/files/tiff/DecodedTileCache.h>
 #include <ome/files/tiff/Field.h>
 #include <ome/files/tiff/TIFF.h>
 #include <ome/files/tiff/Sentry.h>
+#include <ome/files/tiff/SubResolutionWriter.h>
 #include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/Util.h>
+#include <ome/files/detail/tiff/Tags.h>
 
 #include <ome/common/string.h>
 
@@ -63,8 +94,12 @@ namespace
 
   using namespace ::ome::files::tiff;
   using ::ome::files::dimension_size_type;
+  using ::ome::files::IOStatistics;
   using ::ome::files::PixelBuffer;
   using ::ome::files::PixelProperties;
+  using ::ome::files::PixelBufferBase;
+  using ::ome::files::PixelBufferView;
+  using ::ome::files::PixelStatistics;
   using ::ome::files::PlaneRegion;
   using ::ome::files::TileBuffer;
   using ::ome::files::TileCache;
@@ -118,202 +153,2340 @@ namespace
   // chunks where the tile widths are compatible, or individual
   // scanlines where they are not compatible.
 
+  // Get the row of a pixel buffer or pixel buffer view containing
+  // the pixel at idx, starting at column zero; subsequent rows are
+  // stepped with the row stride rather than recomputing the index.
+  template<typename B>
+  inline auto
+  index_row(B&                                   buffer,
+            const PixelBufferBase::indices_type& idx) -> decltype(buffer.row(0))
+  {
+    return buffer.row(idx[ome::files::DIM_SPATIAL_Y],
+                      idx[ome::files::DIM_SPATIAL_Z],
+                      idx[ome::files::DIM_TEMPORAL_T],
+                      idx[ome::files::DIM_CHANNEL],
+                      idx[ome::files::DIM_SUBCHANNEL]);
+  }
+
+  // Accumulate statistics for a w×h block of a pixel buffer or
+  // pixel buffer view, starting at idx, for nsamples subchannels.
+  // Statistics for the subchannel at idx are recorded as sample.
+  template<typename B>
+  void
+  accumulate_statistics(PixelStatistics&                     stats,
+                        const B&                             buffer,
+                        const PixelBufferBase::indices_type& idx,
+                        dimension_size_type                  w,
+                        dimension_size_type                  h,
+                        uint16_t                             nsamples,
+                        dimension_size_type                  sample)
+  {
+    if (!w || !h)
+      return;
+
+    const auto first = index_row(buffer, idx);
+    const auto *origin = first.data + (idx[ome::files::DIM_SPATIAL_X] * first.xstride);
+
+    PixelStatistics::Accumulator acc(stats);
+    for (dimension_size_type row = 0; row < h; ++row)
+      for (uint16_t s = 0; s < nsamples; ++s)
+        acc.add(sample + s,
+                origin + (static_cast<PixelBufferBase::index>(row) * first.ystride) +
+                (static_cast<PixelBufferBase::index>(s) * first.sstride),
+                w, first.xstride);
+    stats.merge(acc);
+  }
+
+  // Linear scaling of floating point samples to [0, 1], for
+  // TIFF::setNormalized().
+  struct SampleScaling
+  {
+    bool   enabled;
+    double min;
+    double scale;
+  };
+
+  // Get the scaling for reading an IFD, using the range of the
+  // whole image so that all tiles are scaled alike.
+  SampleScaling
+  sample_scaling(const IFD& ifd)
+  {
+    SampleScaling scaling = {false, 0.0, 1.0};
+    if (ifd.getTIFF()->getNormalized())
+      {
+        const PixelType type = ifd.getPixelType();
+        if (type == PixelType::FLOAT || type == PixelType::DOUBLE)
+          {
+            const std::pair<double, double> range(ifd.getNormalizationRange());
+            scaling.enabled = true;
+            scaling.min = range.first;
+            scaling.scale = 1.0 / (range.second - range.first);
+          }
+      }
+    return scaling;
+  }
+
+  // Normalize a w×h block of a pixel buffer or pixel buffer view,
+  // starting at idx, for nsamples subchannels.  Contiguous rows
+  // are normalized as a single run.
+  template<typename B>
+  void
+  normalize_block(const SampleScaling&                 scaling,
+                  B&                                   buffer,
+                  const PixelBufferBase::indices_type& idx,
+                  dimension_size_type                  w,
+                  dimension_size_type                  h,
+                  uint16_t                             nsamples)
+  {
+    typedef typename B::value_type value_type;
+
+    if (!w || !h)
+      return;
+
+    const auto first = index_row(buffer, idx);
+    auto *origin = first.data + (idx[ome::files::DIM_SPATIAL_X] * first.xstride);
+    const value_type min = static_cast<value_type>(scaling.min);
+    const value_type scale = static_cast<value_type>(scaling.scale);
+
+    for (dimension_size_type row = 0; row < h; ++row)
+      {
+        auto *rowdata = origin + (static_cast<PixelBufferBase::index>(row) * first.ystride);
+        if (first.contiguous(nsamples))
+          {
+            ome::files::detail::normalizeSamples(rowdata, w * nsamples, min, scale);
+            continue;
+          }
+        for (uint16_t s = 0; s < nsamples; ++s)
+          {
+            auto *p = rowdata + (static_cast<PixelBufferBase::index>(s) * first.sstride);
+            if (first.xstride == 1)
+              ome::files::detail::normalizeSamples(p, w, min, scale);
+            else
+              for (dimension_size_type x = 0; x < w; ++x, p += first.xstride)
+                ome::files::detail::normalizeSamples(p, 1U, min, scale);
+          }
+      }
+  }
+
+  // Summarise a w×h block of a pixel buffer or pixel buffer view,
+  // starting at idx, for nsamples subchannels.
+  template<typename B>
+  TileSummary
+  summarise_block(const B&                             buffer,
+                  const PixelBufferBase::indices_type& idx,
+                  dimension_size_type                  w,
+                  dimension_size_type                  h,
+                  uint16_t                             nsamples)
+  {
+    TileSummary summary;
+    if (!w || !h)
+      return summary;
+
+    const auto first = index_row(buffer, idx);
+    const auto *origin = first.data + (idx[ome::files::DIM_SPATIAL_X] * first.xstride);
+
+    for (dimension_size_type row = 0; row < h; ++row)
+      for (uint16_t s = 0; s < nsamples; ++s)
+        {
+          const auto *p = origin + (static_cast<PixelBufferBase::index>(row) * first.ystride) +
+            (static_cast<PixelBufferBase::index>(s) * first.sstride);
+          for (dimension_size_type x = 0; x < w; ++x, p += first.xstride)
+            {
+              const auto v = ome::files::detail::statistic_value(*p);
+              if (v != decltype(v)())
+                ++summary.nonzero;
+              if (ome::files::detail::statistic_skip(v))
+                continue;
+              const double d = static_cast<double>(v);
+              summary.min = std::min(summary.min, d);
+              summary.max = std::max(summary.max, d);
+            }
+        }
+    summary.count = w * h * nsamples;
+    return summary;
+  }
+
+  // The number of samples copied for each pixel is the same for
+  // every tile of an IFD, so the transfer kernels are selected once
+  // per read or write, with the common cases of 1 and 3 samples
+  // fixed at compile time.  Samples is 0 for the general case,
+  // where the count is only known at run time.
+  template<uint16_t Samples>
+  inline uint16_t
+  fixed_samples(uint16_t copysamples)
+  {
+    return Samples ? Samples : copysamples;
+  }
+
+  // Copy rows of width pixels, with the given row strides in
+  // elements.  If both source and destination rows are packed, the
+  // rows are copied as a single block.
+  template<uint16_t Samples, typename V>
+  inline void
+  copy_rows(const V             *src,
+            std::size_t          srcstride,
+            V                   *dest,
+            std::size_t          deststride,
+            dimension_size_type  width,
+            dimension_size_type  rows,
+            uint16_t             copysamples)
+  {
+    const std::size_t count = static_cast<std::size_t>(width) * fixed_samples<Samples>(copysamples);
+    if (count == srcstride && count == deststride)
+      {
+        std::copy(src, src + (count * rows), dest);
+        return;
+      }
+    for (dimension_size_type row = 0;
+         row < rows;
+         ++row, src += srcstride, dest += deststride)
+      std::copy(src, src + count, dest);
+  }
+
+  // Check if the native byte order is big-endian.
+  bool
+  native_bigendian()
+  {
+    const uint16_t value = 1U;
+    return *reinterpret_cast<const uint8_t *>(&value) == 0U;
+  }
+
+  // Get the tables shared by the tiles of a directory, which are
+  // read once and cached by the TIFF, or null if there are none.
+  std::shared_ptr<const std::vector<uint8_t>>
+  codec_tables(const IFD& ifd)
+  {
+    if (ifd.getCompression() != COMPRESSION_JPEG)
+      return std::shared_ptr<const std::vector<uint8_t>>();
+
+    auto& tiff = ifd.getTIFF();
+    std::shared_ptr<const std::vector<uint8_t>> tables(tiff->getCachedCodecTables(ifd.getOffset()));
+    if (!tables)
+      {
+        std::shared_ptr<std::vector<uint8_t>> jpegtables(std::make_shared<std::vector<uint8_t>>());
+        try
+          {
+            ifd.getField(JPEGTABLES).get(*jpegtables);
+          }
+        catch (const Exception&)
+          {
+            jpegtables->clear();
+          }
+        tables = jpegtables;
+        tiff->cacheCodecTables(ifd.getOffset(), tables);
+      }
+
+    return tables->empty() ? std::shared_ptr<const std::vector<uint8_t>>() : tables;
+  }
+
+  // Get the codec plugin to decode or encode the tiles of a
+  // directory, and describe its tiles, or null if the libtiff codec
+  // is used.  Plugins are not used with a predictor, since libtiff
+  // applies predictors within its own codecs.
+  std::shared_ptr<const CodecPlugin>
+  codec_plugin(const IFD&      ifd,
+               const TileInfo& tileinfo,
+               bool            encode,
+               CodecTile&      desc)
+  {
+    std::shared_ptr<const CodecPlugin> plugin(getCodecPlugin(ifd.getCompression()));
+    if (!plugin || !(encode ? static_cast<bool>(plugin->encode) : static_cast<bool>(plugin->decode)))
+      return std::shared_ptr<const CodecPlugin>();
+
+    CodecParameters params(ifd.getCodecParameters());
+    if (params.predictor && *params.predictor != NONE)
+      return std::shared_ptr<const CodecPlugin>();
+
+    desc.scheme = ifd.getCompression();
+    desc.width = static_cast<uint32_t>(tileinfo.tileWidth());
+    desc.length = static_cast<uint32_t>(tileinfo.tileHeight());
+    desc.bits = ifd.getBitsPerSample();
+    desc.samples = ifd.getPlanarConfiguration() == SEPARATE ? 1U : ifd.getSamplesPerPixel();
+    try
+      {
+        ifd.getField(SAMPLEFORMAT).get(desc.sampleformat);
+      }
+    catch (const Exception&)
+      {
+        desc.sampleformat = UNSIGNED_INT;
+      }
+    desc.photometric = ifd.getPhotometricInterpretation();
+    desc.bigendian = TIFFIsBigEndian(reinterpret_cast<::TIFF *>(ifd.getTIFF()->getWrapped())) != 0;
+    if (encode)
+      desc.parameters = params;
+    else
+      desc.tables = codec_tables(ifd);
+
+    if (plugin->supports && !plugin->supports(desc))
+      return std::shared_ptr<const CodecPlugin>();
+
+    return plugin;
+  }
+
+  // Describe a single tile or strip for a codec plugin, and get its
+  // decoded size.  Strips at the bottom of the image only contain
+  // the remaining rows.
+  dimension_size_type
+  codec_tile(const TileInfo&      tileinfo,
+             const PlaneRegion&   rimage,
+             tstrile_t            tile,
+             CodecTile&           desc)
+  {
+    if (tileinfo.tileType() == STRIP)
+      desc.length = static_cast<uint32_t>((tileinfo.tileRegion(tile) & rimage).h);
+
+    const dimension_size_type rowbytes =
+      ((static_cast<dimension_size_type>(desc.width) * desc.samples * desc.bits) + 7U) / 8U;
+    return std::min(rowbytes * desc.length, tileinfo.bufferSize());
+  }
+
+  // Swap samples between native and file byte order.  The
+  // components of complex samples are swapped separately.
+  void
+  swap_samples(const CodecTile&     desc,
+               void                *data,
+               dimension_size_type  size)
+  {
+    if (desc.bigendian == native_bigendian())
+      return;
+
+    dimension_size_type word = desc.bits / 8U;
+    if (desc.sampleformat == COMPLEX_INT || desc.sampleformat == COMPLEX_FLOAT)
+      word /= 2U;
+
+    switch (word)
+      {
+      case 2U:
+        ::ome::files::detail::byteswap16(data, size / 2U);
+        break;
+      case 4U:
+        ::ome::files::detail::byteswap32(data, size / 4U);
+        break;
+      case 8U:
+        ::ome::files::detail::byteswap64(data, size / 8U);
+        break;
+      default:
+        break;
+      }
+  }
+
+  // Encode a tile or strip with a codec plugin.  The tile buffer is
+  // swapped in place to the byte order of the file, as libtiff does
+  // for its own codecs, so may not be used afterward.
+  void
+  plugin_encode(const CodecPlugin&     plugin,
+                CodecTile              desc,
+                const TileInfo&        tileinfo,
+                const PlaneRegion&     rimage,
+                tstrile_t              tile,
+                TileBuffer&            tilebuf,
+                std::vector<uint8_t>&  raw)
+  {
+    const dimension_size_type size = codec_tile(tileinfo, rimage, tile, desc);
+    swap_samples(desc, tilebuf.data(), size);
+    raw.clear();
+    plugin.encode(desc, tilebuf.data(), size, raw);
+  }
+
+  // Tiles whose data is separated by no more than this many bytes
+  // are read together when reading a region.
+  const uint64_t coalesce_gap = 64U * 1024U;
+
+  // Maximum size of a single read of the data of several tiles.
+  const uint64_t coalesce_size = 16U * 1024U * 1024U;
+
+  // Maximum size of the tile data read as a single batch.
+  const uint64_t coalesce_window = 64U * 1024U * 1024U;
+
+  // Check if a tile is sparse.  Sparse tiles have no data in the
+  // file (a byte count of zero), and are read as zero.
+  bool
+  sparse_tile(::TIFF    *tiffraw,
+              tstrile_t  tile,
+              TileType   type)
+  {
+    uint64_t *bytecounts = nullptr;
+    return TIFFGetField(tiffraw,
+                        type == TILE ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS,
+                        &bytecounts) && bytecounts && !bytecounts[tile];
+  }
+
+  // Check if a tile contains only zeros, and may be left out of the
+  // file if sparse tiles are enabled.
+  bool
+  zero_tile(const TileBuffer& tilebuf)
+  {
+    const uint8_t *data = tilebuf.data();
+    const dimension_size_type size = tilebuf.size();
+    return !size || (!data[0] && !std::memcmp(data, data + 1, size - 1));
+  }
+
+  // Refer a tile of the directory being written to data already
+  // written to the file.  TIFFGetField returns the offset and byte
+  // count arrays held by libtiff, which are written out with the
+  // directory.
+  void
+  point_tile(::TIFF        *tiffraw,
+             TileType       type,
+             tstrile_t      tile,
+             uint64_t       offset,
+             uint64_t       size,
+             const Sentry&  sentry)
+  {
+    uint64_t *offsets = nullptr;
+    uint64_t *bytecounts = nullptr;
+    if (!TIFFWriteCheck(tiffraw, type == TILE, "point_tile") ||
+        !TIFFGetField(tiffraw,
+                      type == TILE ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS,
+                      &offsets) || !offsets ||
+        !TIFFGetField(tiffraw,
+                      type == TILE ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS,
+                      &bytecounts) || !bytecounts)
+      sentry.error("Failed to get tile offsets");
+
+    offsets[tile] = offset;
+    bytecounts[tile] = size;
+  }
+
+  // Check if the tiles of a directory are stored uncompressed, so
+  // that any of their rows may be read directly from the file, and
+  // describe their samples.  Samples must occupy whole bytes, and
+  // may not be subsampled YCbCr.
+  bool
+  uncompressed_tile(const IFD&  ifd,
+                    CodecTile&  desc)
+  {
+    if (ifd.getCompression() != COMPRESSION_NONE ||
+        ifd.getPhotometricInterpretation() == YCBCR ||
+        ifd.getBitsPerSample() % 8U)
+      return false;
+
+    desc.bits = ifd.getBitsPerSample();
+    try
+      {
+        ifd.getField(SAMPLEFORMAT).get(desc.sampleformat);
+      }
+    catch (const Exception&)
+      {
+        desc.sampleformat = UNSIGNED_INT;
+      }
+    desc.bigendian = TIFFIsBigEndian(reinterpret_cast<::TIFF *>(ifd.getTIFF()->getWrapped())) != 0;
+    return true;
+  }
+
+  // Row layout of tiles of packed samples.  Unsigned integer
+  // samples of fewer bits than their pixel type (for example 12-bit
+  // samples of a UINT16 image) are stored packed with no padding
+  // between them, each row starting on a byte boundary; libtiff
+  // neither packs nor unpacks them.  16-bit floating point samples
+  // are stored as half precision, and converted to and from FLOAT.
+  // Tiles are cached, transferred and downsampled unpacked, and
+  // packed only when decoded or encoded.
+  struct PackedTile
+  {
+    // Bits per sample, or zero if the samples are not packed.
+    uint16_t            bits;
+    // Samples are half precision floating point.
+    bool                half;
+    // Samples in a row.
+    dimension_size_type rowsamples;
+    // Packed row size (bytes).
+    dimension_size_type packedrow;
+    // Unpacked row size (bytes).
+    dimension_size_type unpackedrow;
+    // Unpacked tile size (bytes).
+    dimension_size_type unpackedsize;
+
+    PackedTile(const IFD&      ifd,
+               const TileInfo& tileinfo):
+      bits(0U),
+      half(false),
+      rowsamples(0U),
+      packedrow(0U),
+      unpackedrow(0U),
+      unpackedsize(tileinfo.bufferSize())
+    {
+      const PixelType type = ifd.getPixelType();
+      const uint16_t sbits = ifd.getBitsPerSample();
+      if ((type != PixelType::UINT8 && type != PixelType::UINT16 &&
+           type != PixelType::FLOAT) ||
+          sbits >= bitsPerPixel(type))
+        return;
+
+      bits = sbits;
+      half = type == PixelType::FLOAT;
+      rowsamples = tileinfo.tileWidth() *
+        (ifd.getPlanarConfiguration() == SEPARATE ? 1U : ifd.getSamplesPerPixel());
+      packedrow = ((rowsamples * bits) + 7U) / 8U;
+      unpackedrow = rowsamples * bytesPerPixel(type);
+      unpackedsize = tileinfo.tileHeight() * unpackedrow;
+    }
+
+    // Unpack the whole rows of src into dest.
+    void
+    unpack(const uint8_t       *src,
+           dimension_size_type  srcsize,
+           uint8_t             *dest,
+           dimension_size_type  destsize) const
+    {
+      const dimension_size_type rows = std::min(srcsize / packedrow, destsize / unpackedrow);
+      for (dimension_size_type r = 0; r < rows; ++r)
+        {
+          if (half)
+            ome::files::detail::halfToFloat(reinterpret_cast<const uint16_t *>(src + (r * packedrow)),
+                                            reinterpret_cast<float *>(dest + (r * unpackedrow)),
+                                            rowsamples);
+          else if (bits > 8U)
+            ome::files::detail::unpackSamples(src + (r * packedrow),
+                                              reinterpret_cast<uint16_t *>(dest + (r * unpackedrow)),
+                                              rowsamples, bits);
+          else
+            ome::files::detail::unpackSamples(src + (r * packedrow),
+                                              dest + (r * unpackedrow),
+                                              rowsamples, bits);
+        }
+    }
+
+    // Pack the whole rows of src into dest.
+    void
+    pack(const uint8_t       *src,
+         dimension_size_type  srcsize,
+         uint8_t             *dest,
+         dimension_size_type  destsize) const
+    {
+      const dimension_size_type rows = std::min(srcsize / unpackedrow, destsize / packedrow);
+      for (dimension_size_type r = 0; r < rows; ++r)
+        {
+          if (half)
+            ome::files::detail::floatToHalf(reinterpret_cast<const float *>(src + (r * unpackedrow)),
+                                            reinterpret_cast<uint16_t *>(dest + (r * packedrow)),
+                                            rowsamples);
+          else if (bits > 8U)
+            ome::files::detail::packSamples(reinterpret_cast<const uint16_t *>(src + (r * unpackedrow)),
+                                            dest + (r * packedrow),
+                                            rowsamples, bits);
+          else
+            ome::files::detail::packSamples(src + (r * unpackedrow),
+                                            dest + (r * packedrow),
+                                            rowsamples, bits);
+        }
+    }
+  };
+
+  // Raw (encoded) data of a tile, already read from the file.
+  struct RawTile
+  {
+    // The data; libtiff may modify it temporarily while decoding.
+    uint8_t             *data;
+    // The size of the data (bytes).
+    dimension_size_type  size;
+  };
+
+  // Read a range of bytes from the file of a libtiff handle.
+  void
+  read_raw(::TIFF               *tiffraw,
+           uint64_t              offset,
+           uint8_t              *data,
+           dimension_size_type   size,
+           const Sentry&         sentry)
+  {
+    thandle_t fd = TIFFClientdata(tiffraw);
+    TIFFSeekProc seekproc = TIFFGetSeekProc(tiffraw);
+    TIFFReadWriteProc readproc = TIFFGetReadProc(tiffraw);
+
+    if (seekproc(fd, static_cast<toff_t>(offset), SEEK_SET) != static_cast<toff_t>(offset))
+      sentry.error("Failed to seek to tile data");
+
+    dimension_size_type pos = 0U;
+    while (pos < size)
+      {
+        tmsize_t count = readproc(fd, data + pos, static_cast<tmsize_t>(size - pos));
+        if (count <= 0)
+          sentry.error("Failed to read tile data");
+        pos += static_cast<dimension_size_type>(count);
+      }
+  }
+
+  // Call read with a libtiff handle at the directory of ifd, and a
+  // Sentry capturing its errors.  If the TIFF has a read handle
+  // pool, a handle is borrowed for the duration of the read, so
+  // that other threads may read other directories concurrently.
+  // Otherwise the shared handle is used with the TIFF locked,
+  // switching it to the directory first if current is set.
+  template<typename F>
+  void
+  with_read_handle(const IFD& ifd,
+                   bool       current,
+                   F          read)
+  {
+    const std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
+    ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+
+    if (tiff->getReadHandles() && TIFFGetMode(tiffraw) == O_RDONLY)
+      {
+        std::shared_ptr<::ome::files::tiff::TIFF::wrapped_type> handle(tiff->borrowReadHandle(ifd.getOffset()));
+
+        // Independent handle; only error capture is needed.
+        Sentry sentry;
+
+        read(reinterpret_cast<::TIFF *>(handle.get()), sentry);
+      }
+    else
+      {
+        Sentry sentry(*tiff, IOStatistics::LOCK_DECODE);
+
+        if (current)
+          ifd.makeCurrent();
+        read(tiffraw, sentry);
+      }
+  }
+
   struct ReadVisitor
   {
     const IFD&                              ifd;
     const TileInfo&                         tileinfo;
     const PlaneRegion&                      region;
-    const std::vector<dimension_size_type>& tiles;
-    TileBuffer                              tilebuf;
+    const TileRange&                        tiles;
+    std::shared_ptr<DecodedTileCache>       cache;
+    std::shared_ptr<PixelStatistics>        statistics;
+    // Scaling of floating point samples, if normalizing.
+    SampleScaling                           scaling;
+    IOStatistics                           *iostats;
+    dimension_size_type                     xstep;
+    dimension_size_type                     ystep;
+    // Read only the single subchannel subC.
+    bool                                    subchannel;
+    dimension_size_type                     subC;
+    // Expand indexes to RGB with this interleaved lookup table.
+    std::shared_ptr<const std::vector<uint16_t>> lut;
+    // Codec plugin tile description.
+    CodecTile                               plugintile;
+    // Codec plugin used in place of libtiff, if any.
+    std::shared_ptr<const CodecPlugin>      plugin;
+    // Sample layout of uncompressed tiles.
+    CodecTile                               uncompressedtile;
+    // Tiles are uncompressed, and may be read in part.
+    bool                                    uncompressed;
+    // Row layout of packed samples.
+    PackedTile                              packed;
+    // Cancellation token of the reading thread, if any.
+    const CancellationToken                *cancel;
 
     ReadVisitor(const IFD&                              ifd,
                 const TileInfo&                         tileinfo,
                 const PlaneRegion&                      region,
-                const std::vector<dimension_size_type>& tiles):
+                const TileRange&                        tiles,
+                dimension_size_type                     xstep = 1U,
+                dimension_size_type                     ystep = 1U):
       ifd(ifd),
       tileinfo(tileinfo),
       region(region),
       tiles(tiles),
-      tilebuf(tileinfo.bufferSize())
+      cache(),
+      statistics(),
+      scaling(),
+      iostats(ifd.getTIFF()->getIOStatistics().get()),
+      xstep(xstep),
+      ystep(ystep),
+      subchannel(false),
+      subC(0U),
+      lut(),
+      plugintile(),
+      plugin(codec_plugin(ifd, tileinfo, false, plugintile)),
+      uncompressedtile(),
+      uncompressed(!plugin && uncompressed_tile(ifd, uncompressedtile)),
+      packed(ifd, tileinfo),
+      cancel(CancellationToken::current())
     {}
 
     ~ReadVisitor()
     {
     }
 
+    // Size of a decoded tile buffer; packed samples are unpacked.
+    dimension_size_type
+    buffer_size() const
+    {
+      return packed.unpackedsize;
+    }
+
+    // Check if only every xstep-th column and ystep-th row of the
+    // region is read.
+    bool
+    decimated() const
+    {
+      return xstep > 1U || ystep > 1U;
+    }
+
+    // First sampled coordinate at or after pos, for samples taken
+    // every step from start.
+    static dimension_size_type
+    first_sample(dimension_size_type pos,
+                 dimension_size_type start,
+                 dimension_size_type step)
+    {
+      return start + (((pos - start + step - 1U) / step) * step);
+    }
+
+    // Check if a clipped tile contains any sampled pixels.
+    bool
+    sampled(const PlaneRegion& rclip) const
+    {
+      return (rclip.w && rclip.h &&
+              first_sample(rclip.x, region.x, xstep) < rclip.x + rclip.w &&
+              first_sample(rclip.y, region.y, ystep) < rclip.y + rclip.h);
+    }
+
+    // Accumulate statistics for the pixels of a tile transferred
+    // to the destination, if a statistics sink is set.
+    template<typename T>
+    void
+    accumulate(const std::shared_ptr<T>&       buffer,
+               const typename T::indices_type& destidx,
+               const PlaneRegion&              rclip,
+               uint16_t                        nsamples)
+    {
+      if (!statistics || !rclip.area())
+        return;
+
+      const dimension_size_type x0 = first_sample(rclip.x, region.x, xstep);
+      const dimension_size_type y0 = first_sample(rclip.y, region.y, ystep);
+      if (x0 >= rclip.x + rclip.w || y0 >= rclip.y + rclip.h)
+        return;
+
+      typename T::indices_type idx(destidx);
+      idx[ome::files::DIM_SPATIAL_X] = (x0 - region.x) / xstep;
+      idx[ome::files::DIM_SPATIAL_Y] = (y0 - region.y) / ystep;
+
+      accumulate_statistics(*statistics, *buffer, idx,
+                            (rclip.x + rclip.w - x0 + xstep - 1U) / xstep,
+                            (rclip.y + rclip.h - y0 + ystep - 1U) / ystep,
+                            nsamples,
+                            subchannel ? subC : static_cast<dimension_size_type>(destidx[ome::files::DIM_SUBCHANNEL]));
+    }
+
+    // Normalize the floating point samples of a tile transferred
+    // to the destination, if normalizing.  This follows the
+    // transfer of each tile (and any statistics), while the
+    // transferred pixels are still cached, rather than making a
+    // separate pass over the whole destination.
+    template<typename T>
+    void
+    normalize(const std::shared_ptr<T>&       buffer,
+              const typename T::indices_type& destidx,
+              const PlaneRegion&              rclip,
+              uint16_t                        nsamples)
+    {
+      normalize(buffer, destidx, rclip, nsamples,
+                std::is_floating_point<typename T::value_type>());
+    }
+
+    // Only floating point samples are normalized.
+    template<typename T>
+    void
+    normalize(const std::shared_ptr<T>&       /* buffer */,
+              const typename T::indices_type& /* destidx */,
+              const PlaneRegion&              /* rclip */,
+              uint16_t                        /* nsamples */,
+              std::false_type)
+    {
+    }
+
+    template<typename T>
+    void
+    normalize(const std::shared_ptr<T>&       buffer,
+              const typename T::indices_type& destidx,
+              const PlaneRegion&              rclip,
+              uint16_t                        nsamples,
+              std::true_type)
+    {
+      if (!scaling.enabled || !rclip.area())
+        return;
+
+      const dimension_size_type x0 = first_sample(rclip.x, region.x, xstep);
+      const dimension_size_type y0 = first_sample(rclip.y, region.y, ystep);
+      if (x0 >= rclip.x + rclip.w || y0 >= rclip.y + rclip.h)
+        return;
+
+      typename T::indices_type idx(destidx);
+      idx[ome::files::DIM_SPATIAL_X] = (x0 - region.x) / xstep;
+      idx[ome::files::DIM_SPATIAL_Y] = (y0 - region.y) / ystep;
+
+      normalize_block(scaling, *buffer, idx,
+                      (rclip.x + rclip.w - x0 + xstep - 1U) / xstep,
+                      (rclip.y + rclip.h - y0 + ystep - 1U) / ystep,
+                      nsamples);
+    }
+
+    // Transfer the sampled pixels of a tile.
+    template<typename T>
+    void
+    transfer_decimated(std::shared_ptr<T>&       buffer,
+                       typename T::indices_type& destidx,
+                       const uint8_t            *tiledata,
+                       PlaneRegion&              rfull,
+                       PlaneRegion&              rclip,
+                       uint16_t                  copysamples)
+    {
+      const dimension_size_type x0 = first_sample(rclip.x, region.x, xstep);
+      const dimension_size_type y0 = first_sample(rclip.y, region.y, ystep);
+      const typename T::value_type *src = reinterpret_cast<const typename T::value_type *>(tiledata);
+
+      // Strides permit both interleaved and planar destinations.
+      destidx[ome::files::DIM_SPATIAL_Y] = 0;
+      const PixelRow<typename T::value_type> first = index_row(*buffer, destidx);
+      const PixelBufferBase::index xoffset = static_cast<PixelBufferBase::index>((x0 - region.x) / xstep) * first.xstride;
+
+      for (dimension_size_type row = y0;
+           row < rclip.y + rclip.h;
+           row += ystep)
+        {
+          dimension_size_type yoffset = (row - rfull.y) * (rfull.w * copysamples);
+
+          typename T::value_type *dest = first.data + xoffset +
+            (static_cast<PixelBufferBase::index>((row - region.y) / ystep) * first.ystride);
+          for (dimension_size_type col = x0;
+               col < rclip.x + rclip.w;
+               col += xstep, dest += first.xstride)
+            {
+              const typename T::value_type *pixel = src + yoffset + ((col - rfull.x) * copysamples);
+              for (uint16_t s = 0; s < copysamples; ++s)
+                dest[s * first.sstride] = pixel[s];
+            }
+        }
+    }
+
+    // Special case for BIT
+    void
+    transfer_decimated(std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& buffer,
+                       PixelBuffer<PixelProperties<PixelType::BIT>::std_type>::indices_type&    destidx,
+                       const uint8_t                                                           *tiledata,
+                       PlaneRegion&                                                             rfull,
+                       PlaneRegion&                                                             rclip,
+                       uint16_t                                                                 copysamples)
+    {
+      typedef PixelBuffer<PixelProperties<PixelType::BIT>::std_type> T;
+
+      const dimension_size_type x0 = first_sample(rclip.x, region.x, xstep);
+      const dimension_size_type y0 = first_sample(rclip.y, region.y, ystep);
+      const uint8_t *src = tiledata;
+
+      destidx[ome::files::DIM_SPATIAL_Y] = 0;
+      const PixelRow<T::value_type> first = index_row(*buffer, destidx);
+      const PixelBufferBase::index xoffset = static_cast<PixelBufferBase::index>((x0 - region.x) / xstep) * first.xstride;
+
+      for (dimension_size_type row = y0;
+           row < rclip.y + rclip.h;
+           row += ystep)
+        {
+          dimension_size_type yoffset = (row - rfull.y) * (rfull.w * copysamples);
+
+          T::value_type *dest = first.data + xoffset +
+            (static_cast<PixelBufferBase::index>((row - region.y) / ystep) * first.ystride);
+          for (dimension_size_type col = x0;
+               col < rclip.x + rclip.w;
+               col += xstep, dest += copysamples)
+            ome::files::detail::unpackBits(src, yoffset + ((col - rfull.x) * copysamples), dest, copysamples);
+        }
+    }
+
+    // Check if contiguous samples are transferred to a destination
+    // with planar storage order, requiring deinterleaving.
     template<typename T>
+    static bool
+    planar_destination(const std::shared_ptr<T>& buffer,
+                       uint16_t                  copysamples)
+    {
+      return copysamples > 1U && buffer->strides()[ome::files::DIM_SUBCHANNEL] != 1;
+    }
+
+    template<uint16_t Samples, typename T>
     void
     transfer(std::shared_ptr<T>&       buffer,
              typename T::indices_type& destidx,
-             const TileBuffer&         tilebuf,
+             const uint8_t            *tiledata,
              PlaneRegion&              rfull,
              PlaneRegion&              rclip,
              uint16_t                  copysamples)
     {
-      if (rclip.w == rfull.w &&
-          rclip.x == region.x &&
-          rclip.w == region.w)
+      if (decimated())
         {
-          // Transfer contiguous block since the tile spans the
-          // whole region width for both source and destination
-          // buffers.
-
-          destidx[ome::files::DIM_SPATIAL_X] = rclip.x - region.x;
-          destidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
-
-          typename T::value_type *dest = &buffer->at(destidx);
-          const typename T::value_type *src = reinterpret_cast<const typename T::value_type *>(tilebuf.data());
-          std::copy(src,
-                    src + (rclip.w * rclip.h * copysamples),
-                    dest);
+          transfer_decimated(buffer, destidx, tiledata, rfull, rclip, copysamples);
+          return;
         }
-      else
-        {
-          // Transfer discontiguous block.
 
-          dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
+      const uint16_t nsamples = fixed_samples<Samples>(copysamples);
+      const typename T::value_type *src = reinterpret_cast<const typename T::value_type *>(tiledata) +
+        ((rclip.y - rfull.y) * rfull.w + (rclip.x - rfull.x)) * nsamples;
+      const std::size_t srcstride = rfull.w * nsamples;
 
-          for (dimension_size_type row = rclip.y;
-               row != rclip.y + rclip.h;
-               ++row)
-            {
-              dimension_size_type yoffset = (row - rfull.y) * (rfull.w * copysamples);
+      destidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
 
-              destidx[ome::files::DIM_SPATIAL_X] = rclip.x - region.x;
-              destidx[ome::files::DIM_SPATIAL_Y] = row - region.y;
+      // Rows are stepped by the destination row stride; the
+      // destination row is only computed for the first row.
+      const PixelRow<typename T::value_type> first = index_row(*buffer, destidx);
+      typename T::value_type *dest = first.data +
+        (static_cast<PixelBufferBase::index>(rclip.x - region.x) * first.xstride);
+      const std::size_t deststride = static_cast<std::size_t>(first.ystride);
 
-              typename T::value_type *dest = &buffer->at(destidx);
-              const typename T::value_type *src = reinterpret_cast<const typename T::value_type *>(tilebuf.data());
-              std::copy(src + yoffset + xoffset,
-                        src + yoffset + xoffset + (rclip.w * copysamples),
-                        dest);
-            }
+      if (planar_destination(buffer, nsamples))
+        {
+          // Deinterleave each row of pixels into the sample planes.
+          const std::size_t sstride = static_cast<std::size_t>(first.sstride);
+
+          for (dimension_size_type row = 0;
+               row != rclip.h;
+               ++row, src += srcstride, dest += deststride)
+            ome::files::detail::transpose(src, nsamples, dest, sstride, rclip.w, nsamples);
+        }
+      else
+        {
+          // Rows of the tile spanning the whole region width for
+          // both source and destination buffers are contiguous, and
+          // are transferred as a single block.
+          copy_rows<Samples>(src, srcstride, dest, deststride, rclip.w, rclip.h, copysamples);
         }
     }
 
     // Special case for BIT
+    template<uint16_t Samples>
     void
     transfer(std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& buffer,
              PixelBuffer<PixelProperties<PixelType::BIT>::std_type>::indices_type&    destidx,
-             const TileBuffer&                                                        tilebuf,
+             const uint8_t                                                           *tiledata,
              PlaneRegion&                                                             rfull,
              PlaneRegion&                                                             rclip,
              uint16_t                                                                 copysamples)
     {
+      if (decimated())
+        {
+          transfer_decimated(buffer, destidx, tiledata, rfull, rclip, copysamples);
+          return;
+        }
+
       // Unpack bits from buffer.
 
       typedef PixelBuffer<PixelProperties<PixelType::BIT>::std_type> T;
 
       dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
 
+      destidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
+      const PixelRow<T::value_type> first = index_row(*buffer, destidx);
+      T::value_type *dest = first.data +
+        (static_cast<PixelBufferBase::index>(rclip.x - region.x) * first.xstride);
+
       for (dimension_size_type row = rclip.y;
            row != rclip.y + rclip.h;
-           ++row)
+           ++row, dest += first.ystride)
         {
           const dimension_size_type full_row_width = rfull.w * copysamples;
           dimension_size_type yoffset = (row - rfull.y) * full_row_width;
 
-          destidx[ome::files::DIM_SPATIAL_X] = rclip.x - region.x;
-          destidx[ome::files::DIM_SPATIAL_Y] = row - region.y;
-
-          T::value_type *dest = &buffer->at(destidx);
-          const uint8_t *src = reinterpret_cast<const uint8_t *>(tilebuf.data());
+          const uint8_t *src = tiledata;
 
-          for (dimension_size_type sampleoffset = 0U;
-               sampleoffset < (rclip.w * copysamples);
-               ++sampleoffset)
-            {
-              dimension_size_type src_bit = yoffset + xoffset + sampleoffset;
-              const uint8_t *src_byte = src + (src_bit / 8U);
-              const uint8_t bit_offset = 7U - (src_bit % 8U);
-              const uint8_t mask = static_cast<uint8_t>(1U << bit_offset);
-              assert(src_byte >= src && src_byte < src + tilebuf.size());
-              *(dest+sampleoffset) = static_cast<T::value_type>(*src_byte & mask);
-            }
+          ome::files::detail::unpackBits(src, yoffset + xoffset, dest, rclip.w * copysamples);
         }
     }
 
+    // Transfer the sampled pixels of subchannel subC from a
+    // contiguous tile containing samples subchannels.
     template<typename T>
-    dimension_size_type
-    expected_read(const std::shared_ptr<T>& /* buffer */,
-                  const PlaneRegion&        rclip,
-                  uint16_t                  copysamples) const
-    {
-      return rclip.w * rclip.h * copysamples * sizeof(typename T::value_type);
-    }
-
-    // Special case for BIT
-    dimension_size_type
-    expected_read(const std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& /* buffer */,
-                  const PlaneRegion&                                                             rclip,
-                  uint16_t                                                                       copysamples) const
+    void
+    transfer_sample(std::shared_ptr<T>&       buffer,
+                    typename T::indices_type& destidx,
+                    const uint8_t            *tiledata,
+                    PlaneRegion&              rfull,
+                    PlaneRegion&              rclip,
+                    uint16_t                  samples)
     {
-      dimension_size_type expectedread = rclip.w;
+      const dimension_size_type x0 = first_sample(rclip.x, region.x, xstep);
+      const dimension_size_type y0 = first_sample(rclip.y, region.y, ystep);
+      const typename T::value_type *src = reinterpret_cast<const typename T::value_type *>(tiledata) + subC;
 
-      if (expectedread % 8)
-        ++expectedread;
-      expectedread *= rclip.h * copysamples;
-      expectedread /= 8;
+      destidx[ome::files::DIM_SPATIAL_Y] = 0;
+      const PixelRow<typename T::value_type> first = index_row(*buffer, destidx);
+      const PixelBufferBase::index xoffset = static_cast<PixelBufferBase::index>((x0 - region.x) / xstep) * first.xstride;
 
-      return expectedread;
+      for (dimension_size_type row = y0;
+           row < rclip.y + rclip.h;
+           row += ystep)
+        {
+          dimension_size_type yoffset = (row - rfull.y) * (rfull.w * samples);
+
+          typename T::value_type *dest = first.data + xoffset +
+            (static_cast<PixelBufferBase::index>((row - region.y) / ystep) * first.ystride);
+          for (dimension_size_type col = x0;
+               col < rclip.x + rclip.w;
+               col += xstep, dest += first.xstride)
+            *dest = src[yoffset + ((col - rfull.x) * samples)];
+        }
     }
 
-    template<typename T>
+    // Special case for BIT
     void
-    operator()(std::shared_ptr<T>& buffer)
+    transfer_sample(std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& buffer,
+                    PixelBuffer<PixelProperties<PixelType::BIT>::std_type>::indices_type&    destidx,
+                    const uint8_t                                                           *tiledata,
+                    PlaneRegion&                                                             rfull,
+                    PlaneRegion&                                                             rclip,
+                    uint16_t                                                                 samples)
     {
-      std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
-      ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
-      TileType type = tileinfo.tileType();
+      typedef PixelBuffer<PixelProperties<PixelType::BIT>::std_type> T;
 
-      uint16_t samples = ifd.getSamplesPerPixel();
-      PlanarConfiguration planarconfig = ifd.getPlanarConfiguration();
+      const dimension_size_type x0 = first_sample(rclip.x, region.x, xstep);
+      const dimension_size_type y0 = first_sample(rclip.y, region.y, ystep);
+      const uint8_t *src = tiledata;
 
-      Sentry sentry;
+      destidx[ome::files::DIM_SPATIAL_Y] = 0;
+      const PixelRow<T::value_type> first = index_row(*buffer, destidx);
+      const PixelBufferBase::index xoffset = static_cast<PixelBufferBase::index>((x0 - region.x) / xstep) * first.xstride;
 
-      for(const auto i : tiles)
+      for (dimension_size_type row = y0;
+           row < rclip.y + rclip.h;
+           row += ystep)
         {
-          tstrile_t tile = static_cast<tstrile_t>(i);
-          PlaneRegion rfull = tileinfo.tileRegion(tile);
-          PlaneRegion rclip = tileinfo.tileRegion(tile, region);
-          dimension_size_type sample = tileinfo.tileSample(tile);
+          dimension_size_type yoffset = (row - rfull.y) * (rfull.w * samples);
+
+          T::value_type *dest = first.data + xoffset +
+            (static_cast<PixelBufferBase::index>((row - region.y) / ystep) * first.ystride);
+          for (dimension_size_type col = x0;
+               col < rclip.x + rclip.w;
+               col += xstep, dest += first.xstride)
+            ome::files::detail::unpackBits(src, yoffset + ((col - rfull.x) * samples) + subC, dest, 1U);
+        }
+    }
+
+    // Transfer the sampled pixels of a tile of indexes of type I,
+    // replacing each index with its RGB lookup table entry.  The
+    // three subchannels of each entry are adjacent in the table, so
+    // each pixel needs a single table lookup.
+    template<typename I>
+    void
+    transfer_expanded(std::shared_ptr<PixelBuffer<uint16_t>>& buffer,
+                      const TileBuffer&                       tilebuf,
+                      PlaneRegion&                            rfull,
+                      PlaneRegion&                            rclip)
+    {
+      const dimension_size_type x0 = first_sample(rclip.x, region.x, xstep);
+      const dimension_size_type y0 = first_sample(rclip.y, region.y, ystep);
+      const I *src = reinterpret_cast<const I *>(tilebuf.data());
+      const uint16_t *table = lut->data();
+      const std::size_t last = (lut->size() / 3U) - 1U;
+
+      const PixelRow<uint16_t> first = buffer->row(0);
+      const PixelBufferBase::index xoffset = static_cast<PixelBufferBase::index>((x0 - region.x) / xstep) * first.xstride;
+      const PixelBufferBase::index sstride = first.sstride;
+
+      for (dimension_size_type row = y0;
+           row < rclip.y + rclip.h;
+           row += ystep)
+        {
+          const I *indexes = src + ((row - rfull.y) * rfull.w) - rfull.x;
+          uint16_t *dest = first.data + xoffset +
+            (static_cast<PixelBufferBase::index>((row - region.y) / ystep) * first.ystride);
+          for (dimension_size_type col = x0;
+               col < rclip.x + rclip.w;
+               col += xstep, dest += first.xstride)
+            {
+              const uint16_t *rgb = table + (std::min(static_cast<std::size_t>(indexes[col]), last) * 3U);
+              dest[0] = rgb[0];
+              dest[sstride] = rgb[1];
+              dest[sstride * 2] = rgb[2];
+            }
+        }
+    }
+
+    // Read and expand a single tile of indexes of type I.
+    template<typename I>
+    void
+    read_expanded_tile(::TIFF                                  *tiffraw,
+                       tstrile_t                                tile,
+                       TileBuffer&                              tilebuf,
+                       std::shared_ptr<PixelBuffer<uint16_t>>&  buffer,
+                       TileType                                 type,
+                       const Sentry&                            sentry)
+    {
+      PlaneRegion rfull = tileinfo.tileRegion(tile);
+      PlaneRegion rclip = rfull & region;
+
+      if (!sampled(rclip))
+        return;
+
+      // Only the index type is used, for the expected strip size.
+      const std::shared_ptr<PixelBuffer<I>> indexes;
+
+      DecodedTileCache::value_type cached;
+      if (cache)
+        cached = cached_tile(tiffraw, tile, indexes, type, rclip, 1U, sentry);
+      else
+        decode_tile(tiffraw, tile, tilebuf.data(), tilebuf.size(),
+                    indexes, type, rclip, 1U, sentry);
+
+      {
+        OME_FILES_IO_TIME(timer, iostats, COPY);
+        OME_FILES_TRACE(trace, "tiff", "copy");
+        transfer_expanded<I>(buffer, cached ? *cached : tilebuf, rfull, rclip);
+      }
+
+      uint16_t copysamples;
+      PixelBuffer<uint16_t>::indices_type destidx(tile_index<PixelBuffer<uint16_t>>(tile, 1U, CONTIG, copysamples));
+      accumulate(buffer, destidx, rclip, 3U);
+    }
+
+    // Expanding requires a UINT16 destination.
+    template<typename T>
+    void
+    read_expanded(std::shared_ptr<T>& /* buffer */,
+                  TileType            /* type */)
+    {
+      throw Exception("Expanded indexed color pixel data requires a UINT16 destination");
+    }
+
+    // Read and expand all tiles of indexes.
+    void
+    read_expanded(std::shared_ptr<PixelBuffer<uint16_t>>& buffer,
+                  TileType                                type)
+    {
+      std::shared_ptr<TileBuffer> tilebuf(TileBufferPool::global()->acquire(buffer_size(), false));
+      const PixelType indextype = ifd.getPixelType();
+
+      with_read_handle(ifd, false,
+                       [&](::TIFF *tiffraw, const Sentry& sentry)
+                       {
+                         for(const auto i : tiles)
+                           {
+                             if (indextype == PixelType::UINT8)
+                               read_expanded_tile<uint8_t>(tiffraw, static_cast<tstrile_t>(i), *tilebuf, buffer, type, sentry);
+                             else
+                               read_expanded_tile<uint16_t>(tiffraw, static_cast<tstrile_t>(i), *tilebuf, buffer, type, sentry);
+                           }
+                       });
+    }
+
+    template<typename T>
+    dimension_size_type
+    expected_read(const std::shared_ptr<T>& /* buffer */,
+                  const PlaneRegion&        rclip,
+                  uint16_t                  copysamples) const
+    {
+      return rclip.w * rclip.h * copysamples * sizeof(typename T::value_type);
+    }
+
+    // Special case for BIT
+    dimension_size_type
+    expected_read(const std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& /* buffer */,
+                  const PlaneRegion&                                                             rclip,
+                  uint16_t                                                                       copysamples) const
+    {
+      dimension_size_type expectedread = rclip.w;
+
+      if (expectedread % 8)
+        ++expectedread;
+      expectedread *= rclip.h * copysamples;
+      expectedread /= 8;
+
+      return expectedread;
+    }
+
+    // Decode a single tile, from its raw data if already read.
+    template<typename T>
+    void
+    decode_tile(::TIFF                    *tiffraw,
+                tstrile_t                  tile,
+                void                      *data,
+                dimension_size_type        size,
+                const std::shared_ptr<T>&  buffer,
+                TileType                   type,
+                const PlaneRegion&         rclip,
+                uint16_t                   copysamples,
+                const Sentry&              sentry,
+                RawTile                   *raw = nullptr)
+    {
+      // Sparse tiles are filled rather than decoded.
+      if (!raw && sparse_tile(tiffraw, tile, type))
+        {
+          std::memset(data, 0, size);
+          return;
+        }
+
+      OME_FILES_IO_TIME(timer, iostats, DECODE);
+      OME_FILES_TRACE(trace, "tiff", "decode");
+
+      // Packed samples are decoded into a separate buffer, and then
+      // unpacked into the tile.
+      std::shared_ptr<TileBuffer> packedbuf;
+      uint8_t *tiledata = static_cast<uint8_t *>(data);
+      dimension_size_type tilesize = size;
+      if (packed.bits)
+        {
+          packedbuf = TileBufferPool::global()->acquire(tileinfo.bufferSize(), false);
+          data = packedbuf->data();
+          size = packedbuf->size();
+        }
+
+      tmsize_t bytesread;
+      if (type == TILE)
+        {
+          bytesread = plugin ?
+            plugin_decode(tiffraw, tile, data, size, type, sentry, raw) :
+            raw ? raw_decode(tiffraw, tile, data, size, type, *raw) :
+            TIFFReadEncodedTile(tiffraw, tile, data, static_cast<tsize_t>(size));
+          if (bytesread < 0)
+            sentry.error("Failed to read encoded tile");
+          else if (static_cast<dimension_size_type>(bytesread) != size)
+            sentry.error("Failed to read encoded tile fully");
+        }
+      else
+        {
+          bytesread = plugin ?
+            plugin_decode(tiffraw, tile, data, size, type, sentry, raw) :
+            raw ? raw_decode(tiffraw, tile, data, size, type, *raw) :
+            TIFFReadEncodedStrip(tiffraw, tile, data, static_cast<tsize_t>(size));
+          dimension_size_type expectedread = packed.bits ?
+            (((rclip.w * copysamples * packed.bits) + 7U) / 8U) * rclip.h :
+            expected_read(buffer, rclip, copysamples);
+          if (bytesread < 0)
+            sentry.error("Failed to read encoded strip");
+          else if (static_cast<dimension_size_type>(bytesread) < expectedread)
+            sentry.error("Failed to read encoded strip fully");
+        }
+
+      if (packed.bits)
+        packed.unpack(packedbuf->data(), static_cast<dimension_size_type>(bytesread), tiledata, tilesize);
+
+      OME_FILES_IO_COUNT(iostats, TILES_DECODED, 1U);
+      OME_FILES_IO_COUNT(iostats, BYTES_READ, static_cast<uint64_t>(bytesread));
+    }
+
+    // Decode a single tile from raw data already read with libtiff.
+    // Strips at the bottom of the image are limited to the rows they
+    // contain, as for TIFFReadEncodedStrip.
+    tmsize_t
+    raw_decode(::TIFF              *tiffraw,
+               tstrile_t            tile,
+               void                *data,
+               dimension_size_type  size,
+               TileType             type,
+               RawTile&             raw)
+    {
+#ifdef OME_FILES_HAVE_TIFFREADFROMUSERBUFFER
+      tmsize_t decodesize = static_cast<tmsize_t>(size);
+      if (type == STRIP)
+        {
+          const PlaneRegion rimage(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
+          const uint32_t rows = static_cast<uint32_t>((tileinfo.tileRegion(tile) & rimage).h);
+          decodesize = std::min(decodesize, TIFFVStripSize(tiffraw, rows));
+        }
+      return TIFFReadFromUserBuffer(tiffraw, tile, raw.data, static_cast<tmsize_t>(raw.size),
+                                    data, decodesize) ? decodesize : -1;
+#else
+      // Not used; raw data is only read when it can be decoded.
+      static_cast<void>(tiffraw);
+      static_cast<void>(tile);
+      static_cast<void>(data);
+      static_cast<void>(size);
+      static_cast<void>(type);
+      static_cast<void>(raw);
+      return -1;
+#endif
+    }
+
+    // Decode a single tile with the codec plugin, from its raw data
+    // if already read.  If the buffer is smaller than the decoded
+    // tile, only the start of the tile is copied into it, as for
+    // TIFFReadEncodedStrip.
+    tmsize_t
+    plugin_decode(::TIFF              *tiffraw,
+                  tstrile_t            tile,
+                  void                *data,
+                  dimension_size_type  size,
+                  TileType             type,
+                  const Sentry&        sentry,
+                  RawTile             *raw)
+    {
+      std::vector<uint8_t> rawbuf;
+      RawTile rawtile{nullptr, 0U};
+      if (raw)
+        rawtile = *raw;
+      else
+        {
+          uint64_t *bytecounts = nullptr;
+          if (!TIFFGetField(tiffraw,
+                            type == TILE ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS,
+                            &bytecounts) || !bytecounts)
+            sentry.error("Failed to get raw tile size");
+
+          rawbuf.resize(static_cast<std::vector<uint8_t>::size_type>(bytecounts[tile]));
+          tmsize_t rawread = type == TILE ?
+            TIFFReadRawTile(tiffraw, tile, rawbuf.data(), static_cast<tmsize_t>(rawbuf.size())) :
+            TIFFReadRawStrip(tiffraw, tile, rawbuf.data(), static_cast<tmsize_t>(rawbuf.size()));
+          if (rawread < 0)
+            sentry.error(type == TILE ? "Failed to read raw tile" : "Failed to read raw strip");
+          rawtile.data = rawbuf.data();
+          rawtile.size = static_cast<dimension_size_type>(rawread);
+        }
+
+      CodecTile desc(plugintile);
+      const PlaneRegion rimage(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
+      const dimension_size_type decodedsize = codec_tile(tileinfo, rimage, tile, desc);
+      if (decodedsize <= size)
+        {
+          plugin->decode(desc, rawtile.data, rawtile.size,
+                         static_cast<uint8_t *>(data), decodedsize);
+          size = decodedsize;
+        }
+      else
+        {
+          std::shared_ptr<TileBuffer> decoded(TileBufferPool::global()->acquire(decodedsize, false));
+          plugin->decode(desc, rawtile.data, rawtile.size,
+                         decoded->data(), decodedsize);
+          std::copy(decoded->data(), decoded->data() + size, static_cast<uint8_t *>(data));
+        }
+      swap_samples(desc, data, size);
+
+      return static_cast<tmsize_t>(size);
+    }
+
+    // Check if a tile may be decoded directly into the destination
+    // buffer.  This requires the region not to be decimated, and the
+    // tile to start at the left edge of the region and span its
+    // whole width (the contiguous block case in transfer()), and to
+    // start within the region.  Tiles must also lie within the
+    // region vertically, while strips may be read partially since
+    // the decoded size may be limited to whole rows.  Packed samples
+    // are always unpacked from a separate buffer.
+    template<typename T>
+    bool
+    direct_read(const std::shared_ptr<T>& /* buffer */,
+                TileType                  type,
+                const PlaneRegion&        rfull,
+                const PlaneRegion&        rclip) const
+    {
+      return (!packed.bits &&
+              !decimated() &&
+              rclip.w == rfull.w &&
+              rclip.x == region.x &&
+              rclip.w == region.w &&
+              rclip.y == rfull.y &&
+              (type == STRIP || rclip.h == rfull.h));
+    }
+
+    // Special case for BIT; packed tile data never matches.
+    bool
+    direct_read(const std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& /* buffer */,
+                TileType                                                                       /* type */,
+                const PlaneRegion&                                                             /* rfull */,
+                const PlaneRegion&                                                             /* rclip */) const
+    {
+      return false;
+    }
+
+    // Special case for views, which may have padded rows; the rows
+    // of the view must also be contiguous.
+    template<typename T>
+    bool
+    direct_read(const std::shared_ptr<PixelBufferView<T>>& buffer,
+                TileType                                   type,
+                const PlaneRegion&                         rfull,
+                const PlaneRegion&                         rclip) const
+    {
+      const PixelBufferBase::index *strides = buffer->strides();
+      return (strides[ome::files::DIM_SPATIAL_Y] ==
+              strides[ome::files::DIM_SPATIAL_X] * static_cast<PixelBufferBase::index>(region.w) &&
+              direct_read(std::shared_ptr<PixelBuffer<T>>(), type, rfull, rclip));
+    }
+
+    // Check if only the rows of a tile within the region need be
+    // read.  The rows of uncompressed tiles and strips lie at fixed
+    // offsets within the tile data, so when the region covers only
+    // part of a tile vertically, its rows may be read directly from
+    // the file rather than reading the whole tile.  The samples must
+    // be stored as the pixel type, and the rows must lie within the
+    // tile data, which excludes sparse and truncated tiles.
+    template<typename T>
+    bool
+    partial_read(::TIFF                    *tiffraw,
+                 tstrile_t                  tile,
+                 const std::shared_ptr<T>& /* buffer */,
+                 TileType                   type,
+                 const PlaneRegion&         rfull,
+                 const PlaneRegion&         rclip,
+                 uint16_t                   copysamples) const
+    {
+      if (!uncompressed || rclip.h >= rfull.h ||
+          uncompressedtile.bits != sizeof(typename T::value_type) * 8U)
+        return false;
+
+      uint64_t *bytecounts = nullptr;
+      return (TIFFGetField(tiffraw,
+                           type == TILE ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS,
+                           &bytecounts) && bytecounts &&
+              (rclip.y - rfull.y + rclip.h) * row_bytes(rfull, copysamples) <= bytecounts[tile]);
+    }
+
+    // Special case for BIT; packed rows are always decoded.
+    bool
+    partial_read(::TIFF                                                                         * /* tiffraw */,
+                 tstrile_t                                                                        /* tile */,
+                 const std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& /* buffer */,
+                 TileType                                                                         /* type */,
+                 const PlaneRegion&                                                               /* rfull */,
+                 const PlaneRegion&                                                               /* rclip */,
+                 uint16_t                                                                         /* copysamples */) const
+    {
+      return false;
+    }
+
+    // Size of a row of an uncompressed tile (bytes).
+    dimension_size_type
+    row_bytes(const PlaneRegion& rfull,
+              uint16_t           copysamples) const
+    {
+      return rfull.w * copysamples * (uncompressedtile.bits / 8U);
+    }
+
+    // Read the rows of an uncompressed tile within the region (see
+    // partial_read()).  If the file is mapped, and the rows are in
+    // native byte order and suitably aligned, they are used in place
+    // in the mapping without copying.  Otherwise they are copied or
+    // read into tilebuf, and swapped to native byte order.
+    const uint8_t *
+    read_rows(::TIFF              *tiffraw,
+              tstrile_t            tile,
+              TileBuffer&          tilebuf,
+              TileType             type,
+              const PlaneRegion&   rfull,
+              const PlaneRegion&   rclip,
+              uint16_t             copysamples,
+              const Sentry&        sentry)
+    {
+      uint64_t *offsets = nullptr;
+      if (!TIFFGetField(tiffraw,
+                        type == TILE ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS,
+                        &offsets) || !offsets)
+        sentry.error("Failed to get tile offsets");
+
+      const dimension_size_type rowbytes = row_bytes(rfull, copysamples);
+      const uint64_t offset = offsets[tile] + ((rclip.y - rfull.y) * rowbytes);
+      const dimension_size_type size = rclip.h * rowbytes;
+
+      OME_FILES_IO_TIME(timer, iostats, DECODE);
+      OME_FILES_TRACE(trace, "tiff", "read_rows");
+      OME_FILES_IO_COUNT(iostats, TILES_DECODED, 1U);
+      OME_FILES_IO_COUNT(iostats, BYTES_READ, static_cast<uint64_t>(size));
+
+      uint64_t mapsize = 0U;
+      const uint8_t *map = ifd.getTIFF()->getMappedData(mapsize);
+      if (map && offset + size <= mapsize)
+        {
+          const uint8_t *rows = map + offset;
+          if (uncompressedtile.bigendian == native_bigendian() &&
+              !(reinterpret_cast<std::uintptr_t>(rows) % (uncompressedtile.bits / 8U)))
+            return rows;
+          std::copy(rows, rows + size, tilebuf.data());
+        }
+      else
+        read_raw(tiffraw, offset, tilebuf.data(), size, sentry);
+
+      swap_samples(uncompressedtile, tilebuf.data(), size);
+      return tilebuf.data();
+    }
+
+    // Read and transfer a single tile.  If a tile cache is in use,
+    // the decoded tile is obtained from or added to the cache.  If
+    // the tile layout matches the destination, the tile is decoded
+    // directly into the destination.  Otherwise the tile is decoded
+    // into tilebuf and then copied.  When reading a single
+    // subchannel of a contiguous tile, only that sample is copied,
+    // and when reading into a planar destination, the samples are
+    // deinterleaved.  If the raw tile data has already been read, it
+    // is decoded from memory.
+    template<uint16_t Samples, typename T>
+    void
+    read_tile(::TIFF                *tiffraw,
+              tstrile_t              tile,
+              TileBuffer&            tilebuf,
+              std::shared_ptr<T>&    buffer,
+              TileType               type,
+              uint16_t               samples,
+              PlanarConfiguration    planarconfig,
+              const Sentry&          sentry,
+              RawTile               *raw = nullptr)
+    {
+      if (cancel)
+        cancel->check();
+
+      PlaneRegion rfull = tileinfo.tileRegion(tile);
+      PlaneRegion rclip = rfull & region;
+
+      // Skip tiles and strips with no sampled rows or columns.
+      if (decimated() && !sampled(rclip))
+        return;
+
+      uint16_t copysamples;
+      typename T::indices_type destidx(tile_index<T>(tile, samples, planarconfig, copysamples));
+      const bool extract = subchannel && copysamples > 1U;
+
+      DecodedTileCache::value_type cached;
+      const uint8_t *tiledata = tilebuf.data();
+      if (cache)
+        {
+          cached = cached_tile(tiffraw, tile, buffer, type, rclip, copysamples, sentry, raw);
+          tiledata = cached->data();
+        }
+      else if (!extract && !planar_destination(buffer, copysamples) &&
+               direct_read(buffer, type, rfull, rclip))
+        {
+          // Decode straight into the destination; no transfer needed.
+          destidx[ome::files::DIM_SPATIAL_X] = rclip.x - region.x;
+          destidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
+
+          decode_tile(tiffraw, tile, &buffer->at(destidx),
+                      rclip.w * rclip.h * copysamples * sizeof(typename T::value_type),
+                      buffer, type, rclip, copysamples, sentry, raw);
+          accumulate(buffer, destidx, rclip, copysamples);
+          normalize(buffer, destidx, rclip, copysamples);
+          return;
+        }
+      else if (!raw && partial_read(tiffraw, tile, buffer, type, rfull, rclip, copysamples))
+        {
+          // Only the rows within the region are read, so the tile
+          // is limited to them for the transfer.
+          tiledata = read_rows(tiffraw, tile, tilebuf, type, rfull, rclip, copysamples, sentry);
+          rfull.y = rclip.y;
+          rfull.h = rclip.h;
+        }
+      else
+        decode_tile(tiffraw, tile, tilebuf.data(), tilebuf.size(),
+                    buffer, type, rclip, copysamples, sentry, raw);
+
+      {
+        OME_FILES_IO_TIME(timer, iostats, COPY);
+        OME_FILES_TRACE(trace, "tiff", "copy");
+        if (extract)
+          transfer_sample(buffer, destidx, tiledata, rfull, rclip, copysamples);
+        else
+          transfer<Samples>(buffer, destidx, tiledata, rfull, rclip, copysamples);
+      }
+      accumulate(buffer, destidx, rclip, extract ? 1U : copysamples);
+      normalize(buffer, destidx, rclip, extract ? 1U : copysamples);
+    }
+
+    // Get the destination index for a tile, and the number of
+    // samples to copy for it.  When reading a single subchannel,
+    // the destination has only one subchannel.
+    template<typename T>
+    typename T::indices_type
+    tile_index(tstrile_t           tile,
+               uint16_t            samples,
+               PlanarConfiguration planarconfig,
+               uint16_t&           copysamples) const
+    {
+      copysamples = samples;
+      dimension_size_type dest_subchannel = 0;
+      if (planarconfig == SEPARATE)
+        {
+          copysamples = 1;
+          if (!subchannel)
+            dest_subchannel = tileinfo.tileSample(tile);
+        }
+
+      typename T::indices_type destidx;
+      destidx[ome::files::DIM_SPATIAL_X] = 0;
+      destidx[ome::files::DIM_SPATIAL_Y] = 0;
+      destidx[ome::files::DIM_SUBCHANNEL] = dest_subchannel;
+      destidx[ome::files::DIM_SPATIAL_Z] = destidx[ome::files::DIM_TEMPORAL_T] =
+        destidx[ome::files::DIM_CHANNEL] = destidx[ome::files::DIM_MODULO_Z] =
+        destidx[ome::files::DIM_MODULO_T] = destidx[ome::files::DIM_MODULO_C] = 0;
+      return destidx;
+    }
+
+    // Get a decoded tile from the tile cache, decoding and adding it
+    // to the cache if not present.
+    template<typename T>
+    DecodedTileCache::value_type
+    cached_tile(::TIFF                   *tiffraw,
+                tstrile_t                 tile,
+                const std::shared_ptr<T>& buffer,
+                TileType                  type,
+                const PlaneRegion&        rclip,
+                uint16_t                  copysamples,
+                const Sentry&             sentry,
+                RawTile                  *raw = nullptr)
+    {
+      DecodedTileCache::key_type key{ifd.getTIFF().get(), ifd.getOffset(), tile};
+      DecodedTileCache::value_type cached(cache->find(key));
+      if (cached)
+        OME_FILES_IO_COUNT(iostats, TILE_CACHE_HITS, 1U);
+      else
+        {
+          OME_FILES_IO_COUNT(iostats, TILE_CACHE_MISSES, 1U);
+          std::shared_ptr<TileBuffer> decoded(TileBufferPool::global()->acquire(buffer_size(), false));
+          decode_tile(tiffraw, tile, decoded->data(), decoded->size(),
+                      buffer, type, rclip, copysamples, sentry, raw);
+          cache->insert(key, decoded);
+          cached = decoded;
+        }
+      return cached;
+    }
+
+    // Transfer an already decoded tile to the destination.
+    template<typename T>
+    void
+    transfer_tile(std::shared_ptr<T>& buffer,
+                  tstrile_t           tile,
+                  const TileBuffer&   tilebuf,
+                  uint16_t            samples,
+                  PlanarConfiguration planarconfig)
+    {
+      PlaneRegion rfull = tileinfo.tileRegion(tile);
+      PlaneRegion rclip = rfull & region;
+
+      uint16_t copysamples;
+      typename T::indices_type destidx(tile_index<T>(tile, samples, planarconfig, copysamples));
+
+      {
+        OME_FILES_IO_TIME(timer, iostats, COPY);
+        OME_FILES_TRACE(trace, "tiff", "copy");
+        transfer<0U>(buffer, destidx, tilebuf.data(), rfull, rclip, copysamples);
+      }
+      accumulate(buffer, destidx, rclip, copysamples);
+      normalize(buffer, destidx, rclip, copysamples);
+    }
+
+    // Read tiles in parallel.  Each thread uses a separate libtiff
+    // handle, so decoding is not serialised by the TIFF lock, and
+    // transfers into a distinct region of the destination buffer.
+    template<uint16_t Samples, typename T>
+    void
+    parallel_read(std::shared_ptr<T>&    buffer,
+                  TileType               type,
+                  uint16_t               samples,
+                  PlanarConfiguration    planarconfig,
+                  dimension_size_type    nthreads)
+    {
+      const std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
+      const offset_type offset = ifd.getOffset();
+
+      tiff->getExecutor()->parallel
+        (static_cast<unsigned int>(nthreads),
+         [&](unsigned int t)
+         {
+           // Independent handle; only error capture is needed.
+           std::shared_ptr<::ome::files::tiff::TIFF::wrapped_type> handle(tiff->borrowReadHandle(offset));
+           ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(handle.get());
+
+           Sentry sentry;
+
+           std::shared_ptr<TileBuffer> threadbuf(TileBufferPool::global()->acquire(buffer_size(), false));
+
+           for (dimension_size_type i = t; i < tiles.size(); i += nthreads)
+             read_tile<Samples>(tiffraw, static_cast<tstrile_t>(tiles[i]), *threadbuf,
+                                buffer, type, samples, planarconfig, sentry);
+         });
+    }
+
+    template<typename T>
+    void
+    operator()(std::shared_ptr<T>& buffer)
+    {
+      std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
+      ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+      TileType type = tileinfo.tileType();
+
+      uint16_t samples = ifd.getSamplesPerPixel();
+      PlanarConfiguration planarconfig = ifd.getPlanarConfiguration();
+
+      dimension_size_type nthreads = std::min(static_cast<dimension_size_type>(tiff->getDecodeThreads()),
+                                              static_cast<dimension_size_type>(tiles.size()));
+      bool readonly = TIFFGetMode(tiffraw) == O_RDONLY;
+
+      // Decoded tiles are only cached when reading, since writing
+      // may alter a tile after it has been cached.
+      if (readonly && tiff->getTileCache() && tiff->getTileCache()->enabled())
+        cache = tiff->getTileCache();
+      statistics = tiff->getStatistics();
+      scaling = sample_scaling(ifd);
+
+      if (lut)
+        {
+          read_expanded(buffer, type);
+          return;
+        }
+
+      switch (planarconfig == SEPARATE ? 1U : samples)
+        {
+        case 1U:
+          read_tiles<1U>(buffer, type, samples, planarconfig, nthreads, readonly);
+          break;
+        case 3U:
+          read_tiles<3U>(buffer, type, samples, planarconfig, nthreads, readonly);
+          break;
+        default:
+          read_tiles<0U>(buffer, type, samples, planarconfig, nthreads, readonly);
+          break;
+        }
+    }
+
+    // Read all tiles, with the transfer kernel for Samples.
+    template<uint16_t Samples, typename T>
+    void
+    read_tiles(std::shared_ptr<T>&    buffer,
+               TileType               type,
+               uint16_t               samples,
+               PlanarConfiguration    planarconfig,
+               dimension_size_type    nthreads,
+               bool                   readonly)
+    {
+      if (nthreads > 1 && readonly)
+        {
+          parallel_read<Samples>(buffer, type, samples, planarconfig, nthreads);
+        }
+      else
+        {
+          std::shared_ptr<TileBuffer> tilebuf(TileBufferPool::global()->acquire(buffer_size(), false));
+
+          with_read_handle(ifd, false,
+                           [&](::TIFF *tiffraw, const Sentry& sentry)
+                           {
+                             if (readonly && coalesce())
+                               read_coalesced<Samples>(tiffraw, *tilebuf, buffer, type, samples, planarconfig, sentry);
+                             else
+                               for(const auto i : tiles)
+                                 read_tile<Samples>(tiffraw, static_cast<tstrile_t>(i), *tilebuf,
+                                                    buffer, type, samples, planarconfig, sentry);
+                           });
+        }
+    }
+
+    // Check if the raw data of the tiles may be read together and
+    // decoded from memory.  This requires a codec plugin, or libtiff
+    // support for decoding from memory; old-style JPEG can not be
+    // decoded from memory.
+    bool
+    coalesce() const
+    {
+#ifdef OME_FILES_HAVE_TIFFREADFROMUSERBUFFER
+      const bool userbuffer = ifd.getCompression() != COMPRESSION_OJPEG;
+#else
+      const bool userbuffer = false;
+#endif
+      return tiles.size() > 1U && (plugin || userbuffer);
+    }
+
+    // Read all tiles, reading their raw data in a few large reads
+    // rather than one read per tile.  The byte ranges of the tiles
+    // are sorted by offset and merged when close together, and the
+    // tiles of each merged range are decoded from memory once it
+    // has been read.  On Linux, the merged ranges of a file are
+    // read as a batch with io_uring, so they are decoded in order
+    // of completion.  Tiles in the tile cache, and tiles without
+    // data, are read individually.
+    template<uint16_t Samples, typename T>
+    void
+    read_coalesced(::TIFF                *tiffraw,
+                   TileBuffer&            tilebuf,
+                   std::shared_ptr<T>&    buffer,
+                   TileType               type,
+                   uint16_t               samples,
+                   PlanarConfiguration    planarconfig,
+                   const Sentry&          sentry)
+    {
+      uint64_t *offsets = nullptr;
+      uint64_t *bytecounts = nullptr;
+      if (!TIFFGetField(tiffraw,
+                        type == TILE ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS,
+                        &offsets) || !offsets ||
+          !TIFFGetField(tiffraw,
+                        type == TILE ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS,
+                        &bytecounts) || !bytecounts)
+        sentry.error("Failed to get tile offsets");
+
+      // File offset and index of each tile to read from memory.
+      std::vector<std::pair<uint64_t, tstrile_t>> ranges;
+      ranges.reserve(tiles.size());
+      for (const auto i : tiles)
+        {
+          const tstrile_t tile = static_cast<tstrile_t>(i);
+          if (decimated() && !sampled(tileinfo.tileRegion(tile) & region))
+            continue;
+
+          if (!bytecounts[tile] ||
+              (cache && cache->find(DecodedTileCache::key_type{ifd.getTIFF().get(), ifd.getOffset(), tile})))
+            read_tile<Samples>(tiffraw, tile, tilebuf, buffer, type, samples, planarconfig, sentry);
+          else
+            ranges.push_back(std::make_pair(offsets[tile], tile));
+        }
+      std::sort(ranges.begin(), ranges.end());
+
+      // Merge the ranges into runs, each read with a single call.
+      typedef std::vector<std::pair<uint64_t, tstrile_t>>::const_iterator range_iterator;
+      struct Run
+      {
+        uint64_t       start;
+        uint64_t       end;
+        range_iterator first;
+        range_iterator last;
+      };
+      std::vector<Run> runs;
+      for (auto first = ranges.cbegin(); first != ranges.cend();)
+        {
+          const uint64_t start = first->first;
+          uint64_t end = start + bytecounts[first->second];
+          auto last = first + 1;
+          for (; last != ranges.cend(); ++last)
+            {
+              const uint64_t next = std::max(end, last->first + bytecounts[last->second]);
+              if (last->first > end + coalesce_gap || next - start > coalesce_size)
+                break;
+              end = next;
+            }
+          runs.push_back(Run{start, end, first, last});
+          first = last;
+        }
+
+      // Decode the tiles of a run from memory.
+      auto decode_run = [&](const Run& run, std::vector<uint8_t>& data)
+        {
+          for (auto r = run.first; r != run.last; ++r)
+            {
+              RawTile raw{data.data() + (r->first - run.start), bytecounts[r->second]};
+              read_tile<Samples>(tiffraw, r->second, tilebuf, buffer, type, samples, planarconfig, sentry, &raw);
+            }
+        };
+
+      // Runs are read in windows of up to coalesce_window bytes.
+      // Where possible, all the runs of a window are read as a
+      // batch, decoding each run as soon as it has been read.
+      const int fd = TIFFFileno(tiffraw);
+      std::vector<std::vector<uint8_t>> data;
+      for (std::vector<Run>::size_type first = 0; first < runs.size();)
+        {
+          std::vector<Run>::size_type last = first;
+          uint64_t window = 0U;
+          do
+            window += runs[last].end - runs[last].start;
+          while (++last < runs.size() &&
+                 window + (runs[last].end - runs[last].start) <= coalesce_window);
+
+          data.resize(last - first);
+          std::vector<::ome::files::detail::BatchReadRequest> requests;
+          for (std::vector<Run>::size_type r = first; r < last; ++r)
+            {
+              std::vector<uint8_t>& rdata(data[r - first]);
+              rdata.resize(static_cast<std::vector<uint8_t>::size_type>(runs[r].end - runs[r].start));
+              requests.push_back(::ome::files::detail::BatchReadRequest{runs[r].start, rdata.data(), rdata.size()});
+            }
+
+          if (fd < 0 || requests.size() < 2U ||
+              !::ome::files::detail::readBatch(fd, requests,
+                                               [&](std::size_t r) { decode_run(runs[first + r], data[r]); }))
+            {
+              for (std::vector<Run>::size_type r = first; r < last; ++r)
+                {
+                  read_raw(tiffraw, runs[r].start, data[r - first].data(), data[r - first].size(), sentry);
+                  decode_run(runs[r], data[r - first]);
+                }
+            }
+          first = last;
+        }
+    }
+  };
+
+  // Read into a pixel buffer view.  The transfer kernels step
+  // through rows and subchannels with the view strides, but expect
+  // the samples of each pixel to be adjacent (interleaved), or the
+  // pixels of each row to be adjacent (planar), so views of other
+  // layouts, and packed BIT samples, are not read directly.
+  struct ReadViewVisitor
+  {
+    ReadVisitor&        reader;
+    uint16_t            samples;
+    PlanarConfiguration planarconfig;
+    bool                done;
+
+    ReadViewVisitor(ReadVisitor&        reader,
+                    uint16_t            samples,
+                    PlanarConfiguration planarconfig):
+      reader(reader),
+      samples(samples),
+      planarconfig(planarconfig),
+      done(false)
+    {}
+
+    template<typename T>
+    void
+    operator()(std::shared_ptr<PixelBufferView<T>>& buffer)
+    {
+      const PixelBufferBase::index *strides = buffer->strides();
+      const bool planar = strides[ome::files::DIM_SPATIAL_X] == 1;
+      const bool interleaved = (strides[ome::files::DIM_SUBCHANNEL] == 1 &&
+                                strides[ome::files::DIM_SPATIAL_X] == samples);
+      if (planar || (planarconfig == CONTIG && interleaved))
+        {
+          reader(buffer);
+          done = true;
+        }
+    }
+
+    void
+    operator()(std::shared_ptr<PixelBufferView<PixelProperties<PixelType::BIT>::std_type>>& /* buffer */)
+    {
+    }
+  };
+
+  // Read several regions of the same plane.  Each tile covered by
+  // any of the regions is decoded once, into a tile buffer (or the
+  // tile cache), and then transferred to every destination buffer
+  // covering it.  All the destination buffers have the same pixel
+  // type; the visitor is applied to the first, and the others are
+  // obtained with the same type.
+  struct BatchReadVisitor
+  {
+    /// Tiles to decode, and the indexes of the regions covering them.
+    typedef std::map<dimension_size_type, std::vector<dimension_size_type>> tile_map;
+
+    const IFD&                       ifd;
+    const TileInfo&                  tileinfo;
+    const std::vector<PlaneRegion>&  regions;
+    std::vector<VariantPixelBuffer>& dests;
+    const tile_map&                  tiles;
+    // Scaling of floating point samples, shared by all regions.
+    const SampleScaling              scaling;
+
+    BatchReadVisitor(const IFD&                       ifd,
+                     const TileInfo&                  tileinfo,
+                     const std::vector<PlaneRegion>&  regions,
+                     std::vector<VariantPixelBuffer>& dests,
+                     const tile_map&                  tiles):
+      ifd(ifd),
+      tileinfo(tileinfo),
+      regions(regions),
+      dests(dests),
+      tiles(tiles),
+      scaling(sample_scaling(ifd))
+    {}
+
+    // Decode and transfer every nthreads-th tile, starting at start.
+    template<typename T>
+    void
+    read_tiles(::TIFF              *tiffraw,
+               const Sentry&        sentry,
+               dimension_size_type  start,
+               dimension_size_type  nthreads)
+    {
+      const TileRange notiles;
+      const PlaneRegion rimage(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
+      TileType type = tileinfo.tileType();
+      uint16_t samples = ifd.getSamplesPerPixel();
+      PlanarConfiguration planarconfig = ifd.getPlanarConfiguration();
+
+      std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
+      ReadVisitor decoder(ifd, tileinfo, rimage, notiles);
+      if (TIFFGetMode(tiffraw) == O_RDONLY && tiff->getTileCache() && tiff->getTileCache()->enabled())
+        decoder.cache = tiff->getTileCache();
+
+      std::vector<std::shared_ptr<T>> buffers;
+      for (auto& dest : dests)
+        buffers.push_back(ome::compat::get<std::shared_ptr<T>>(dest.vbuffer()));
+
+      std::shared_ptr<TileBuffer> tilebuf(TileBufferPool::global()->acquire(decoder.buffer_size(), false));
+
+      dimension_size_type n = 0;
+      for (const auto& t : tiles)
+        {
+          if ((n++ % nthreads) != start)
+            continue;
+
+          if (decoder.cancel)
+            decoder.cancel->check();
+
+          tstrile_t tile = static_cast<tstrile_t>(t.first);
+          PlaneRegion rclip = tileinfo.tileRegion(tile, rimage);
+          uint16_t copysamples = planarconfig == SEPARATE ? 1 : samples;
+
+          DecodedTileCache::value_type cached;
+          if (decoder.cache)
+            cached = decoder.cached_tile(tiffraw, tile, buffers.front(), type, rclip, copysamples, sentry);
+          else
+            decoder.decode_tile(tiffraw, tile, tilebuf->data(), tilebuf->size(),
+                                buffers.front(), type, rclip, copysamples, sentry);
+
+          for (const auto r : t.second)
+            {
+              ReadVisitor v(ifd, tileinfo, regions.at(r), notiles);
+              v.statistics = tiff->getStatistics();
+              v.scaling = scaling;
+              v.transfer_tile(buffers.at(r), tile, cached ? *cached : *tilebuf, samples, planarconfig);
+            }
+        }
+    }
+
+    template<typename T>
+    void
+    operator()(std::shared_ptr<T>& /* buffer */)
+    {
+      std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
+      ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+
+      dimension_size_type nthreads = std::min(static_cast<dimension_size_type>(tiff->getDecodeThreads()),
+                                              static_cast<dimension_size_type>(tiles.size()));
+
+      if (nthreads > 1 && TIFFGetMode(tiffraw) == O_RDONLY)
+        {
+          // Tiles are distinct, so each thread writes to distinct
+          // parts of the destination buffers.
+          const offset_type offset = ifd.getOffset();
+
+          tiff->getExecutor()->parallel
+            (static_cast<unsigned int>(nthreads),
+             [&](unsigned int t)
+             {
+               std::shared_ptr<::ome::files::tiff::TIFF::wrapped_type> handle(tiff->borrowReadHandle(offset));
+               ::TIFF *threadraw = reinterpret_cast<::TIFF *>(handle.get());
+
+               Sentry sentry;
+
+               read_tiles<T>(threadraw, sentry, t, nthreads);
+             });
+        }
+      else
+        {
+          with_read_handle(ifd, true,
+                           [&](::TIFF *handleraw, const Sentry& sentry)
+                           {
+                             read_tiles<T>(handleraw, sentry, 0U, 1U);
+                           });
+        }
+    }
+  };
 
-          uint16_t copysamples = samples;
-          dimension_size_type dest_subchannel = 0;
-          if (planarconfig == SEPARATE)
-            {
-              copysamples = 1;
-              dest_subchannel = sample;
-            }
+  // Codec level pseudo-tag for a compression scheme, or zero if the
+  // codec has no level or the TIFF library does not support it.
+  ttag_t
+  codec_level_tag(uint16_t compression)
+  {
+    switch (compression)
+      {
+      case COMPRESSION_JPEG:
+        return TIFFTAG_JPEGQUALITY;
+#ifdef TIFFTAG_ZIPQUALITY
+      case COMPRESSION_ADOBE_DEFLATE:
+      case COMPRESSION_DEFLATE:
+        return TIFFTAG_ZIPQUALITY;
+#endif
+#if defined(COMPRESSION_LZMA) && defined(TIFFTAG_LZMAPRESET)
+      case COMPRESSION_LZMA:
+        return TIFFTAG_LZMAPRESET;
+#endif
+#if defined(COMPRESSION_ZSTD) && defined(TIFFTAG_ZSTD_LEVEL)
+      case COMPRESSION_ZSTD:
+        return TIFFTAG_ZSTD_LEVEL;
+#endif
+#if defined(COMPRESSION_WEBP) && defined(TIFFTAG_WEBP_LEVEL)
+      case COMPRESSION_WEBP:
+        return TIFFTAG_WEBP_LEVEL;
+#endif
+      default:
+        return 0;
+      }
+  }
 
-          if (type == TILE)
-            {
-              tmsize_t bytesread = TIFFReadEncodedTile(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
-              if (bytesread < 0)
-                sentry.error("Failed to read encoded tile");
-              else if (static_cast<dimension_size_type>(bytesread) != tilebuf.size())
-                sentry.error("Failed to read encoded tile fully");
-            }
-          else
-            {
-              tmsize_t bytesread = TIFFReadEncodedStrip(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
-              dimension_size_type expectedread = expected_read(buffer, rclip, copysamples);
-              if (bytesread < 0)
-                sentry.error("Failed to read encoded strip");
-              else if (static_cast<dimension_size_type>(bytesread) < expectedread)
-                sentry.error("Failed to read encoded strip fully");
-            }
+  // Does a compression scheme support a predictor?
+  bool
+  codec_predictor(uint16_t compression)
+  {
+    switch (compression)
+      {
+      case COMPRESSION_LZW:
+      case COMPRESSION_ADOBE_DEFLATE:
+      case COMPRESSION_DEFLATE:
+#ifdef COMPRESSION_LZMA
+      case COMPRESSION_LZMA:
+#endif
+#ifdef COMPRESSION_ZSTD
+      case COMPRESSION_ZSTD:
+#endif
+        return true;
+      default:
+        return false;
+      }
+  }
+
+  // Tags required to encode tiles identically to a directory.
+  struct EncodeTags
+  {
+    TileType type;
+    uint32_t width;
+    uint32_t length;
+    uint32_t tilewidth;
+    uint32_t tilelength;
+    uint32_t rowsperstrip;
+    uint16_t bits;
+    uint16_t samples;
+    uint16_t planarconfig;
+    uint16_t photometric;
+    uint16_t compression;
+    uint16_t sampleformat;
+    uint16_t predictor;
+    bool     predicted;
+    int      level;
+    bool     levelled;
+    double   maxzerror;
+    bool     lossy;
+    bool     bigendian;
+
+    // Get the tags from the current directory.  Needs wrapping in a
+    // sentry by the caller.
+    EncodeTags(::TIFF   *tiffraw,
+               TileType  type):
+      type(type),
+      width(),
+      length(),
+      tilewidth(),
+      tilelength(),
+      rowsperstrip(),
+      bits(),
+      samples(),
+      planarconfig(),
+      photometric(),
+      compression(),
+      sampleformat(),
+      predictor(),
+      predicted(false),
+      level(),
+      levelled(false),
+      maxzerror(),
+      lossy(false),
+      bigendian(TIFFIsBigEndian(tiffraw) != 0)
+    {
+      TIFFGetField(tiffraw, TIFFTAG_IMAGEWIDTH, &width);
+      TIFFGetField(tiffraw, TIFFTAG_IMAGELENGTH, &length);
+      if (type == TILE)
+        {
+          TIFFGetField(tiffraw, TIFFTAG_TILEWIDTH, &tilewidth);
+          TIFFGetField(tiffraw, TIFFTAG_TILELENGTH, &tilelength);
+        }
+      else
+        TIFFGetFieldDefaulted(tiffraw, TIFFTAG_ROWSPERSTRIP, &rowsperstrip);
+      TIFFGetFieldDefaulted(tiffraw, TIFFTAG_BITSPERSAMPLE, &bits);
+      TIFFGetFieldDefaulted(tiffraw, TIFFTAG_SAMPLESPERPIXEL, &samples);
+      TIFFGetFieldDefaulted(tiffraw, TIFFTAG_PLANARCONFIG, &planarconfig);
+      TIFFGetField(tiffraw, TIFFTAG_PHOTOMETRIC, &photometric);
+      TIFFGetFieldDefaulted(tiffraw, TIFFTAG_COMPRESSION, &compression);
+      TIFFGetFieldDefaulted(tiffraw, TIFFTAG_SAMPLEFORMAT, &sampleformat);
+      predicted = TIFFGetField(tiffraw, TIFFTAG_PREDICTOR, &predictor) != 0;
+      const ttag_t leveltag = codec_level_tag(compression);
+      if (leveltag)
+        levelled = TIFFGetField(tiffraw, leveltag, &level) != 0;
+#if defined(COMPRESSION_LERC) && defined(TIFFTAG_LERC_MAXZERROR)
+      if (compression == COMPRESSION_LERC)
+        lossy = TIFFGetField(tiffraw, TIFFTAG_LERC_MAXZERROR, &maxzerror) != 0;
+#endif
+    }
+
+    // Can tiles be encoded independently of the directory they will
+    // be written to?  This is not the case for JPEG, which shares
+    // tables between tiles.
+    bool
+    independent() const
+    {
+      switch (compression)
+        {
+        case COMPRESSION_NONE:
+        case COMPRESSION_PACKBITS:
+        case COMPRESSION_LZW:
+        case COMPRESSION_ADOBE_DEFLATE:
+        case COMPRESSION_DEFLATE:
+#ifdef COMPRESSION_LZMA
+        case COMPRESSION_LZMA:
+#endif
+#ifdef COMPRESSION_ZSTD
+        case COMPRESSION_ZSTD:
+#endif
+#ifdef COMPRESSION_LERC
+        case COMPRESSION_LERC:
+#endif
+#ifdef COMPRESSION_WEBP
+        case COMPRESSION_WEBP:
+#endif
+          return true;
+        default:
+          return false;
+        }
+    }
+  };
+
+  // Encode tiles into memory using a private libtiff handle with the
+  // same byte order, image and compression tags as the destination
+  // directory.
+  // The encoded tiles may then be written to the destination with
+  // TIFFWriteRawTile or TIFFWriteRawStrip.  Each tile may only be
+  // encoded once with a given encoder.
+  class TileEncoder
+  {
+  public:
+    TileEncoder(const EncodeTags& tags,
+                const Sentry&     sentry):
+      tags(tags),
+      data(),
+      pos(0),
+      tiff(TIFFClientOpen("TileEncoder", tags.bigendian ? "wb" : "wl",
+                          static_cast<thandle_t>(this),
+                          clientRead, clientWrite, clientSeek, clientClose,
+                          clientSize, clientMap, clientUnmap))
+    {
+      if (!tiff)
+        sentry.error("Failed to open tile encoder");
+
+      TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, tags.width);
+      TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, tags.length);
+      if (tags.type == TILE)
+        {
+          TIFFSetField(tiff, TIFFTAG_TILEWIDTH, tags.tilewidth);
+          TIFFSetField(tiff, TIFFTAG_TILELENGTH, tags.tilelength);
+        }
+      else
+        TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, tags.rowsperstrip);
+      TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, tags.bits);
+      TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, tags.samples);
+      TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, tags.planarconfig);
+      TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, tags.photometric);
+      TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, tags.sampleformat);
+      if (!TIFFSetField(tiff, TIFFTAG_COMPRESSION, tags.compression))
+        {
+          TIFFClose(tiff);
+          sentry.error("Failed to set tile encoder compression");
+        }
+      if (tags.predicted)
+        TIFFSetField(tiff, TIFFTAG_PREDICTOR, tags.predictor);
+      if (tags.levelled)
+        TIFFSetField(tiff, codec_level_tag(tags.compression), tags.level);
+#if defined(COMPRESSION_LERC) && defined(TIFFTAG_LERC_MAXZERROR)
+      if (tags.lossy)
+        TIFFSetField(tiff, TIFFTAG_LERC_MAXZERROR, tags.maxzerror);
+#endif
+    }
+
+    ~TileEncoder()
+    {
+      // Discards the encoded image.
+      TIFFClose(tiff);
+    }
+
+    TileEncoder(const TileEncoder&) = delete;
+    TileEncoder& operator=(const TileEncoder&) = delete;
 
-          typename T::indices_type destidx;
-          destidx[ome::files::DIM_SPATIAL_X] = 0;
-          destidx[ome::files::DIM_SPATIAL_Y] = 0;
-          destidx[ome::files::DIM_SUBCHANNEL] = dest_subchannel;
-          destidx[ome::files::DIM_SPATIAL_Z] = destidx[ome::files::DIM_TEMPORAL_T] =
-            destidx[ome::files::DIM_CHANNEL] = destidx[ome::files::DIM_MODULO_Z] =
-            destidx[ome::files::DIM_MODULO_T] = destidx[ome::files::DIM_MODULO_C] = 0;
+    // Encode a tile, returning the encoded data.
+    void
+    encode(tstrile_t             tile,
+           TileBuffer&           tilebuf,
+           std::vector<uint8_t>& raw,
+           const Sentry&         sentry)
+    {
+      // libtiff appends each newly written tile to the end of the
+      // file, so the encoded data is all the data written.
+      toff_t start = static_cast<toff_t>(data.size());
+
+      tsize_t byteswritten;
+      if (tags.type == TILE)
+        byteswritten = TIFFWriteEncodedTile(tiff, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+      else
+        byteswritten = TIFFWriteEncodedStrip(tiff, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+      if (byteswritten < 0)
+        sentry.error(tags.type == TILE ? "Failed to encode tile" : "Failed to encode strip");
+
+      raw.assign(data.begin() + static_cast<std::ptrdiff_t>(start), data.end());
+
+      // The encoded data is no longer needed.
+      data.resize(start);
+      pos = start;
+    }
+
+  private:
+    const EncodeTags&    tags;
+    std::vector<uint8_t> data;
+    toff_t               pos;
+    ::TIFF              *tiff;
 
-          transfer(buffer, destidx, tilebuf, rfull, rclip, copysamples);
+    static tmsize_t
+    clientRead(thandle_t handle,
+               void     *buf,
+               tmsize_t  size)
+    {
+      TileEncoder *e = static_cast<TileEncoder *>(handle);
+      if (e->pos >= e->data.size())
+        return 0;
+      tmsize_t n = std::min(size, static_cast<tmsize_t>(e->data.size() - e->pos));
+      std::copy(e->data.begin() + static_cast<std::ptrdiff_t>(e->pos),
+                e->data.begin() + static_cast<std::ptrdiff_t>(e->pos + n),
+                static_cast<uint8_t *>(buf));
+      e->pos += n;
+      return n;
+    }
+
+    static tmsize_t
+    clientWrite(thandle_t handle,
+                void     *buf,
+                tmsize_t  size)
+    {
+      TileEncoder *e = static_cast<TileEncoder *>(handle);
+      if (e->pos + size > e->data.size())
+        e->data.resize(e->pos + size);
+      const uint8_t *src = static_cast<const uint8_t *>(buf);
+      std::copy(src, src + size, e->data.begin() + static_cast<std::ptrdiff_t>(e->pos));
+      e->pos += size;
+      return size;
+    }
+
+    static toff_t
+    clientSeek(thandle_t handle,
+               toff_t    offset,
+               int       whence)
+    {
+      TileEncoder *e = static_cast<TileEncoder *>(handle);
+      switch (whence)
+        {
+        case SEEK_SET:
+          e->pos = offset;
+          break;
+        case SEEK_CUR:
+          e->pos += offset;
+          break;
+        case SEEK_END:
+          e->pos = e->data.size() + offset;
+          break;
+        default:
+          return static_cast<toff_t>(-1);
         }
+      return e->pos;
+    }
+
+    static int
+    clientClose(thandle_t /* handle */)
+    {
+      return 0;
+    }
+
+    static toff_t
+    clientSize(thandle_t handle)
+    {
+      return static_cast<TileEncoder *>(handle)->data.size();
+    }
+
+    static int
+    clientMap(thandle_t /* handle */,
+              void **   /* base */,
+              toff_t *  /* size */)
+    {
+      return 0;
+    }
+
+    static void
+    clientUnmap(thandle_t /* handle */,
+                void *    /* base */,
+                toff_t    /* size */)
+    {
     }
   };
 
@@ -322,24 +2495,229 @@ namespace
     IFD&                                    ifd;
     std::vector<TileCoverage>&              tilecoverage;
     TileCache&                              tilecache;
+    std::set<dimension_size_type>&          completed;
+    std::vector<bool>&                      written;
     const TileInfo&                         tileinfo;
     const PlaneRegion&                      region;
-    const std::vector<dimension_size_type>& tiles;
+    const TileRange&                        tiles;
+    std::shared_ptr<PixelStatistics>        statistics;
+    bool                                    summaries;
+    IOStatistics                           *iostats;
+    // Row layout of packed samples.
+    PackedTile                              packed;
 
     WriteVisitor(IFD&                                    ifd,
                  std::vector<TileCoverage>&              tilecoverage,
                  TileCache&                              tilecache,
+                 std::set<dimension_size_type>&          completed,
+                 std::vector<bool>&                      written,
                  const TileInfo&                         tileinfo,
                  const PlaneRegion&                      region,
-                 const std::vector<dimension_size_type>& tiles):
+                 const TileRange&                        tiles):
       ifd(ifd),
       tilecoverage(tilecoverage),
       tilecache(tilecache),
+      completed(completed),
+      written(written),
       tileinfo(tileinfo),
       region(region),
-      tiles(tiles)
+      tiles(tiles),
+      statistics(ifd.getTIFF()->getStatistics()),
+      summaries(ifd.getTIFF()->getTileSummaries()),
+      iostats(ifd.getTIFF()->getIOStatistics().get()),
+      packed(ifd, tileinfo)
     {}
 
+    // Write a cached tile and remove it from the cache.
+    void
+    write_tile(::TIFF            *tiffraw,
+               TileType           type,
+               tstrile_t          tile,
+               const CodecPlugin *plugin,
+               const CodecTile&   plugintile,
+               const Sentry&      sentry)
+    {
+      assert(tilecache.find(tile));
+      TileBuffer& tilebuf = *tilecache.find(tile);
+      std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
+      const unsigned int hashes = tiff->getTileHashes();
+      // Encoding may modify the tile, so it is hashed first.
+      if (hashes & TILE_HASH_DECODED)
+        tiff->addTileHash(TILE_HASH_DECODED, tile, tileHash(tilebuf.data(), tilebuf.size()));
+      if (plugin)
+        {
+          std::vector<uint8_t> raw;
+          {
+            OME_FILES_IO_TIME(timer, iostats, ENCODE);
+            OME_FILES_TRACE(trace, "tiff", "encode");
+            const PlaneRegion rimage(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
+            plugin_encode(*plugin, plugintile, tileinfo, rimage, tile, tilebuf, raw);
+            if (hashes & TILE_HASH_ENCODED)
+              tiff->addTileHash(TILE_HASH_ENCODED, tile, tileHash(raw.data(), raw.size()));
+          }
+          OME_FILES_IO_COUNT(iostats, TILES_ENCODED, 1U);
+          write_raw_tile(tiffraw, type, tile, raw, sentry);
+          return;
+        }
+      {
+        OME_FILES_IO_TIME(timer, iostats, ENCODE);
+        OME_FILES_TRACE(trace, "tiff", "encode");
+        if (type == TILE)
+          {
+            tsize_t byteswritten = TIFFWriteEncodedTile(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+            if (byteswritten < 0)
+              sentry.error("Failed to write encoded tile");
+            else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
+              sentry.error("Failed to write encoded tile fully");
+          }
+        else
+          {
+            tsize_t byteswritten = TIFFWriteEncodedStrip(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+            if (byteswritten < 0)
+              sentry.error("Failed to write encoded strip");
+            else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
+              sentry.error("Failed to write encoded strip fully");
+          }
+      }
+      OME_FILES_IO_COUNT(iostats, TILES_ENCODED, 1U);
+      OME_FILES_IO_COUNT(iostats, BYTES_WRITTEN, tilebuf.size());
+      tilecache.erase(tile);
+      completed.erase(tile);
+    }
+
+    // Write a tile which has already been encoded.  If identical
+    // data has already been written to the file, the tile refers to
+    // it instead.
+    void
+    write_raw_tile(::TIFF                     *tiffraw,
+                   TileType                    type,
+                   tstrile_t                   tile,
+                   const std::vector<uint8_t>& raw,
+                   const Sentry&               sentry)
+    {
+      std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
+      const bool dedup = !raw.empty() && tiff->getTileDeduplication();
+      offset_type existing;
+      if (dedup && tiff->findDuplicateTile(raw, existing))
+        {
+          point_tile(tiffraw, type, tile, existing, raw.size(), sentry);
+          tilecache.erase(tile);
+          completed.erase(tile);
+          return;
+        }
+
+      // libtiff requires a non-const buffer, but does not modify it.
+      void *rawdata = const_cast<uint8_t *>(raw.data());
+      tsize_t rsize = static_cast<tsize_t>(raw.size());
+      if (type == TILE)
+        {
+          tsize_t byteswritten = TIFFWriteRawTile(tiffraw, tile, rawdata, rsize);
+          if (byteswritten < 0)
+            sentry.error("Failed to write encoded tile");
+          else if (byteswritten != rsize)
+            sentry.error("Failed to write encoded tile fully");
+        }
+      else
+        {
+          tsize_t byteswritten = TIFFWriteRawStrip(tiffraw, tile, rawdata, rsize);
+          if (byteswritten < 0)
+            sentry.error("Failed to write encoded strip");
+          else if (byteswritten != rsize)
+            sentry.error("Failed to write encoded strip fully");
+        }
+      OME_FILES_IO_COUNT(iostats, BYTES_WRITTEN, raw.size());
+      if (dedup)
+        {
+          uint64_t *offsets = nullptr;
+          if (TIFFGetField(tiffraw,
+                           type == TILE ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS,
+                           &offsets) && offsets)
+            tiff->addWrittenTile(raw, offsets[tile]);
+        }
+      tilecache.erase(tile);
+      completed.erase(tile);
+    }
+
+    // Remove a sparse tile from the cache without writing it.
+    void
+    skip_tile(tstrile_t tile)
+    {
+      tilecache.erase(tile);
+      completed.erase(tile);
+    }
+
+    // Encode tiles in parallel, and then write them in order.  Each
+    // thread uses a separate encoder, so encoding is not serialised
+    // by the TIFF lock; only the writing of the encoded data is.
+    void
+    parallel_write(const std::vector<tstrile_t>& flushtiles,
+                   const std::vector<bool>&      sparse,
+                   const EncodeTags&             tags,
+                   const CodecPlugin            *plugin,
+                   const CodecTile&              plugintile,
+                   dimension_size_type           nthreads)
+    {
+      const PlaneRegion rimage(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
+      std::vector<std::vector<uint8_t>> raw(flushtiles.size());
+      std::shared_ptr<::ome::files::tiff::TIFF>& tiff(ifd.getTIFF());
+      // Tiles are hashed by the encoding threads.
+      const unsigned int hashes = tiff->getTileHashes();
+      std::vector<uint64_t> encodedhashes(hashes & TILE_HASH_ENCODED ? flushtiles.size() : 0U);
+      std::vector<uint64_t> decodedhashes(hashes & TILE_HASH_DECODED ? flushtiles.size() : 0U);
+
+      // A single encoder (used for deduplication) is run by the
+      // calling thread.
+      tiff->getExecutor()->parallel
+        (static_cast<unsigned int>(nthreads),
+         [&](unsigned int t)
+         {
+           // Independent handle; only error capture is needed.
+           // A codec plugin needs no handle.
+           Sentry sentry;
+           std::unique_ptr<TileEncoder> encoder;
+           if (!plugin)
+             encoder = std::unique_ptr<TileEncoder>(new TileEncoder(tags, sentry));
+
+           for (dimension_size_type i = t; i < flushtiles.size(); i += nthreads)
+             {
+               if (sparse[i])
+                 continue;
+
+               OME_FILES_IO_TIME(timer, iostats, ENCODE);
+               OME_FILES_TRACE(trace, "tiff", "encode");
+               TileBuffer& tilebuf(*tilecache.find(flushtiles[i]));
+               if (!decodedhashes.empty())
+                 decodedhashes[i] = tileHash(tilebuf.data(), tilebuf.size());
+               if (plugin)
+                 plugin_encode(*plugin, plugintile, tileinfo, rimage, flushtiles[i],
+                               tilebuf, raw[i]);
+               else
+                 encoder->encode(flushtiles[i], tilebuf, raw[i], sentry);
+               if (!encodedhashes.empty())
+                 encodedhashes[i] = tileHash(raw[i].data(), raw[i].size());
+               OME_FILES_IO_COUNT(iostats, TILES_ENCODED, 1U);
+             }
+         });
+
+      ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+
+      Sentry sentry(*tiff, IOStatistics::LOCK_ENCODE);
+
+      for (std::vector<tstrile_t>::size_type i = 0; i < flushtiles.size(); ++i)
+        {
+          if (sparse[i])
+            {
+              skip_tile(flushtiles[i]);
+              continue;
+            }
+          if (!encodedhashes.empty())
+            tiff->addTileHash(TILE_HASH_ENCODED, flushtiles[i], encodedhashes[i]);
+          if (!decodedhashes.empty())
+            tiff->addTileHash(TILE_HASH_DECODED, flushtiles[i], decodedhashes[i]);
+          write_raw_tile(tiffraw, tags.type, flushtiles[i], raw[i], sentry);
+        }
+    }
+
     // Flush covered tiles.
     void
     flush()
@@ -350,9 +2728,20 @@ namespace
       PlaneRegion rimage(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
       tstrile_t tile = static_cast<tstrile_t>(ifd.getCurrentTile());
 
-      Sentry sentry;
+      // Tiles to write, in the order in which they will be written.
+      std::vector<tstrile_t> flushtiles;
+      std::set<dimension_size_type> flushed;
+
+      // Completed tiles in order, skipping any already written out
+      // of order.
       while(tile < tileinfo.tileCount())
         {
+          if (tile < written.size() && written[tile])
+            {
+              ++tile;
+              continue;
+            }
+
           dimension_size_type tile_subchannel = tileinfo.tileSample(tile);
 
           PlaneRegion validarea = tileinfo.tileRegion(tile) & rimage;
@@ -362,84 +2751,147 @@ namespace
           if (!tilecoverage.at(tile_subchannel).covered(validarea))
             break;
 
-          assert(tilecache.find(tile));
-          TileBuffer& tilebuf = *tilecache.find(tile);
-          if (type == TILE)
-            {
-              tsize_t byteswritten = TIFFWriteEncodedTile(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
-              if (byteswritten < 0)
-                sentry.error("Failed to write encoded tile");
-              else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
-                sentry.error("Failed to write encoded tile fully");
-            }
-          else
+          flushtiles.push_back(tile);
+          flushed.insert(tile);
+          ++tile;
+        }
+      dimension_size_type ordered = flushtiles.size();
+
+      // Completed tiles out of order while the cache would exceed
+      // its limit.
+      dimension_size_type limit = tiff->getWriteCacheLimit();
+      dimension_size_type cached = tilecache.size() - flushtiles.size();
+      for (auto i = completed.begin();
+           limit && i != completed.end() && cached * packed.unpackedsize > limit;
+           ++i)
+        {
+          if (flushed.find(*i) == flushed.end())
             {
-              tsize_t byteswritten = TIFFWriteEncodedStrip(tiffraw, tile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
-              if (byteswritten < 0)
-                sentry.error("Failed to write encoded strip");
-              else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
-                sentry.error("Failed to write encoded strip fully");
+              flushtiles.push_back(static_cast<tstrile_t>(*i));
+              --cached;
             }
-          tilecache.erase(tile);
-          ifd.setCurrentTile(++tile);
         }
-    }
 
-    template<typename T>
-    void
-    transfer(const std::shared_ptr<T>& buffer,
-             typename T::indices_type& srcidx,
-             TileBuffer&               tilebuf,
-             PlaneRegion&              rfull,
-             PlaneRegion&              rclip,
-             uint16_t                  copysamples)
-    {
-      if (rclip.w == rfull.w &&
-          rclip.x == region.x &&
-          rclip.w == region.w)
+      if (flushtiles.empty())
         {
-          // Transfer contiguous block since the tile spans the
-          // whole region width for both source and destination
-          // buffers.
+          ifd.setCurrentTile(tile);
+          return;
+        }
 
-          srcidx[ome::files::DIM_SPATIAL_X] = rclip.x - region.x;
-          srcidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
+      // Downsample the completed tiles into any sub-resolutions
+      // before they are encoded and released.
+      std::shared_ptr<SubResolutionWriter> subresolutions(tiff->getSubResolutionWriter(ifd));
+      if (subresolutions)
+        {
+          if (packed.bits)
+            throw Exception("Sub-resolutions are not supported for packed samples");
+          for (const auto t : flushtiles)
+            subresolutions->addTile(tileinfo, t, *tilecache.find(t));
+        }
 
-          typename T::value_type *dest = reinterpret_cast<typename T::value_type *>(tilebuf.data());
-          const typename T::value_type *src = &buffer->at(srcidx);
+      // Tiles containing only zeros are not written if sparse; this
+      // is checked before encoding, which may modify the tiles.
+      std::vector<bool> sparse(flushtiles.size(), false);
+      if (tiff->getSparseTiles())
+        {
+          for (std::vector<tstrile_t>::size_type i = 0; i < flushtiles.size(); ++i)
+            sparse[i] = zero_tile(*tilecache.find(flushtiles[i]));
+        }
 
-          assert(dest + (rclip.w * rclip.h * copysamples) <= dest + tilebuf.size());
-          std::copy(src,
-                    src + (rclip.w * rclip.h * copysamples),
-                    dest);
+      // Packed samples replace the unpacked tiles in the cache.
+      if (packed.bits)
+        {
+          for (std::vector<tstrile_t>::size_type i = 0; i < flushtiles.size(); ++i)
+            {
+              if (sparse[i])
+                continue;
+              const TileBuffer& unpacked(*tilecache.find(flushtiles[i]));
+              std::shared_ptr<TileBuffer> packedbuf(TileBufferPool::global()->acquire(tileinfo.bufferSize(), false));
+              packed.pack(unpacked.data(), unpacked.size(), packedbuf->data(), packedbuf->size());
+              tilecache.erase(flushtiles[i]);
+              tilecache.insert(flushtiles[i], packedbuf);
+            }
         }
-      else
+
+      // Tiles encoded by a codec plugin are always independent.
+      CodecTile plugintile;
+      std::shared_ptr<const CodecPlugin> plugin(codec_plugin(ifd, tileinfo, true, plugintile));
+
+      dimension_size_type nthreads = std::min(static_cast<dimension_size_type>(tiff->getEncodeThreads()),
+                                              static_cast<dimension_size_type>(flushtiles.size()));
+      // Tiles are encoded in memory for deduplication and hashing,
+      // so that the encoded data may be compared or hashed before it
+      // is written.
+      std::shared_ptr<EncodeTags> tags;
+      if (nthreads > 1 || tiff->getTileDeduplication() ||
+          (tiff->getTileHashes() & TILE_HASH_ENCODED))
         {
-          // Transfer discontiguous block.
+          Sentry sentry(*tiff, IOStatistics::LOCK_ENCODE);
+          tags = std::make_shared<EncodeTags>(tiffraw, type);
+          if (!plugin && !tags->independent())
+            tags.reset();
+        }
 
-          dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
+      if (tags)
+        {
+          parallel_write(flushtiles, sparse, *tags, plugin.get(), plugintile, nthreads);
+        }
+      else
+        {
+          Sentry sentry(*tiff, IOStatistics::LOCK_ENCODE);
 
-          for (dimension_size_type row = rclip.y;
-               row < rclip.y + rclip.h;
-               ++row)
+          for (std::vector<tstrile_t>::size_type i = 0; i < flushtiles.size(); ++i)
             {
-              dimension_size_type yoffset = (row - rfull.y) * (rfull.w * copysamples);
-
-              srcidx[ome::files::DIM_SPATIAL_X] = rclip.x - region.x;
-              srcidx[ome::files::DIM_SPATIAL_Y] = row - region.y;
+              if (sparse[i])
+                skip_tile(flushtiles[i]);
+              else
+                write_tile(tiffraw, type, flushtiles[i], plugin.get(), plugintile, sentry);
+            }
+        }
 
-              typename T::value_type *dest = reinterpret_cast<typename T::value_type *>(tilebuf.data());
-              const typename T::value_type *src = &buffer->at(srcidx);
+      tiff->streamWritten();
 
-              assert(dest + yoffset + xoffset + (rclip.w * copysamples) <= dest + tilebuf.size());
-              std::copy(src,
-                        src + (rclip.w * copysamples),
-                        dest + yoffset + xoffset);
-            }
+      ifd.setCurrentTile(tile);
+      for (auto i = flushtiles.begin() + static_cast<std::ptrdiff_t>(ordered); i != flushtiles.end(); ++i)
+        {
+          if (written.size() < tileinfo.tileCount())
+            written.resize(tileinfo.tileCount(), false);
+          written[*i] = true;
         }
     }
 
+    template<uint16_t Samples, typename T>
+    void
+    transfer(const std::shared_ptr<T>& buffer,
+             typename T::indices_type& srcidx,
+             TileBuffer&               tilebuf,
+             PlaneRegion&              rfull,
+             PlaneRegion&              rclip,
+             uint16_t                  copysamples)
+    {
+      const uint16_t nsamples = fixed_samples<Samples>(copysamples);
+
+      srcidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
+
+      // Rows are stepped by the source row stride; the source row
+      // is only computed for the first row.  Rows of a tile
+      // spanning the whole region width for both source and
+      // destination buffers are contiguous, and are transferred as
+      // a single block.
+      const PixelRow<const typename T::value_type> first = index_row(static_cast<const T&>(*buffer), srcidx);
+      const typename T::value_type *src = first.data +
+        (static_cast<PixelBufferBase::index>(rclip.x - region.x) * first.xstride);
+      const std::size_t srcstride = static_cast<std::size_t>(first.ystride);
+      typename T::value_type *dest = reinterpret_cast<typename T::value_type *>(tilebuf.data()) +
+        ((rclip.y - rfull.y) * rfull.w + (rclip.x - rfull.x)) * nsamples;
+
+      assert(((rclip.y - rfull.y + rclip.h - 1U) * rfull.w + (rclip.x - rfull.x) + rclip.w) * nsamples *
+             sizeof(typename T::value_type) <= tilebuf.size());
+      copy_rows<Samples>(src, srcstride, dest, rfull.w * nsamples, rclip.w, rclip.h, copysamples);
+    }
+
     // Special case for BIT
+    template<uint16_t Samples>
     void
     transfer(const std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& buffer,
              PixelBuffer<PixelProperties<PixelType::BIT>::std_type>::indices_type&          srcidx,
@@ -454,32 +2906,112 @@ namespace
 
       dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
 
+      srcidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
+      const PixelRow<const T::value_type> first = index_row(static_cast<const T&>(*buffer), srcidx);
+      const T::value_type *src = first.data +
+        (static_cast<PixelBufferBase::index>(rclip.x - region.x) * first.xstride);
+
       for (dimension_size_type row = rclip.y;
            row != rclip.y + rclip.h;
-           ++row)
+           ++row, src += first.ystride)
         {
           const dimension_size_type full_row_width = rfull.w * copysamples;
           dimension_size_type yoffset = (row - rfull.y) * full_row_width;
 
-          srcidx[ome::files::DIM_SPATIAL_X] = rclip.x - region.x;
-          srcidx[ome::files::DIM_SPATIAL_Y] = row - region.y;
-
           uint8_t *dest = reinterpret_cast<uint8_t *>(tilebuf.data());
-          const T::value_type *src = &buffer->at(srcidx);
 
-          for (dimension_size_type sampleoffset = 0;
-               sampleoffset < (rclip.w * copysamples);
-               ++sampleoffset)
+          assert((yoffset + xoffset + (rclip.w * copysamples) + 7U) / 8U <= tilebuf.size());
+          // Partial bytes are combined with existing bits; this is
+          // safe since the tile will only be written once.
+          ome::files::detail::packBits(src, dest, yoffset + xoffset, rclip.w * copysamples);
+        }
+    }
+
+    // Transfer from a pixel buffer view.  Rows are copied directly
+    // if the samples of each row are contiguous in the view, or
+    // gathered using the view strides otherwise.
+    template<uint16_t Samples, typename T>
+    void
+    transfer(const std::shared_ptr<PixelBufferView<T>>& buffer,
+             PixelBufferBase::indices_type&             srcidx,
+             TileBuffer&                                tilebuf,
+             PlaneRegion&                               rfull,
+             PlaneRegion&                               rclip,
+             uint16_t                                   copysamples)
+    {
+      copysamples = fixed_samples<Samples>(copysamples);
+
+      srcidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
+      const PixelRow<T> first = index_row(*buffer, srcidx);
+      const PixelBufferBase::index xstride = first.xstride;
+      const PixelBufferBase::index sstride = first.sstride;
+      const bool contiguous = first.contiguous(copysamples);
+      const T *src = first.data + (static_cast<PixelBufferBase::index>(rclip.x - region.x) * xstride);
+
+      dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
+
+      for (dimension_size_type row = rclip.y;
+           row < rclip.y + rclip.h;
+           ++row, src += first.ystride)
+        {
+          dimension_size_type yoffset = (row - rfull.y) * (rfull.w * copysamples);
+
+          T *dest = reinterpret_cast<T *>(tilebuf.data()) + yoffset + xoffset;
+
+          assert(yoffset + xoffset + (rclip.w * copysamples) <= tilebuf.size() / sizeof(T));
+          if (contiguous)
             {
-              const T::value_type *srcsample = src + sampleoffset;
-              dimension_size_type dest_bit = yoffset + xoffset + sampleoffset;
-              uint8_t *dest_byte = dest + (dest_bit / 8);
-              const uint8_t bit_offset = 7 - (dest_bit % 8);
-
-              assert(dest_byte >= dest && dest_byte < dest + tilebuf.size());
-              // Don't clear the bit since the tile will only be written once.
-              *dest_byte |= static_cast<uint8_t>(*srcsample << bit_offset);
+              std::copy(src, src + (rclip.w * copysamples), dest);
             }
+          else
+            {
+              for (dimension_size_type col = 0; col < rclip.w; ++col)
+                for (uint16_t s = 0; s < copysamples; ++s)
+                  *dest++ = src[(static_cast<PixelBufferBase::index>(col) * xstride) +
+                                (static_cast<PixelBufferBase::index>(s) * sstride)];
+            }
+        }
+    }
+
+    // Special case for BIT
+    template<uint16_t Samples>
+    void
+    transfer(const std::shared_ptr<PixelBufferView<PixelProperties<PixelType::BIT>::std_type>>& buffer,
+             PixelBufferBase::indices_type&                                                     srcidx,
+             TileBuffer&                                                                        tilebuf,
+             PlaneRegion&                                                                       rfull,
+             PlaneRegion&                                                                       rclip,
+             uint16_t                                                                           copysamples)
+    {
+      // Gather each row, then pack bits into buffer.
+
+      typedef PixelProperties<PixelType::BIT>::std_type value_type;
+
+      srcidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
+      const PixelRow<value_type> first = index_row(*buffer, srcidx);
+      const PixelBufferBase::index xstride = first.xstride;
+      const PixelBufferBase::index sstride = first.sstride;
+      const value_type *src = first.data + (static_cast<PixelBufferBase::index>(rclip.x - region.x) * xstride);
+
+      dimension_size_type xoffset = (rclip.x - rfull.x) * copysamples;
+      std::unique_ptr<value_type[]> rowbuf(new value_type[rclip.w * copysamples]);
+
+      for (dimension_size_type row = rclip.y;
+           row != rclip.y + rclip.h;
+           ++row, src += first.ystride)
+        {
+          const dimension_size_type full_row_width = rfull.w * copysamples;
+          dimension_size_type yoffset = (row - rfull.y) * full_row_width;
+
+          value_type *gathered = rowbuf.get();
+          for (dimension_size_type col = 0; col < rclip.w; ++col)
+            for (uint16_t s = 0; s < copysamples; ++s)
+              *gathered++ = src[(static_cast<PixelBufferBase::index>(col) * xstride) +
+                                (static_cast<PixelBufferBase::index>(s) * sstride)];
+
+          uint8_t *dest = reinterpret_cast<uint8_t *>(tilebuf.data());
+          assert((yoffset + xoffset + (rclip.w * copysamples) + 7U) / 8U <= tilebuf.size());
+          ome::files::detail::packBits(rowbuf.get(), dest, yoffset + xoffset, rclip.w * copysamples);
         }
     }
 
@@ -490,14 +3022,47 @@ namespace
       uint16_t samples = ifd.getSamplesPerPixel();
       PlanarConfiguration planarconfig = ifd.getPlanarConfiguration();
 
+      // Row-aligned writes within each tile are tracked as tile row
+      // intervals.
       if (tilecoverage.size() != (planarconfig == CONTIG ? 1 : samples))
-        tilecoverage.resize(planarconfig == CONTIG ? 1 : samples);
+        {
+          tilecoverage.clear();
+          for (uint16_t s = 0; s < (planarconfig == CONTIG ? 1 : samples); ++s)
+            tilecoverage.push_back(TileCoverage(tileinfo.tileWidth(), tileinfo.tileHeight()));
+        }
+
+      switch (planarconfig == SEPARATE ? 1U : samples)
+        {
+        case 1U:
+          transfer_tiles<1U>(buffer, samples, planarconfig);
+          break;
+        case 3U:
+          transfer_tiles<3U>(buffer, samples, planarconfig);
+          break;
+        default:
+          transfer_tiles<0U>(buffer, samples, planarconfig);
+          break;
+        }
+
+      // Flush covered tiles
+      flush();
+    }
+
+    // Transfer the pixel buffer to all tiles, with the transfer
+    // kernel for Samples.
+    template<uint16_t Samples, typename T>
+    void
+    transfer_tiles(const std::shared_ptr<T>& buffer,
+                   uint16_t                  samples,
+                   PlanarConfiguration       planarconfig)
+    {
+      PlaneRegion rimage(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
 
       for(const auto i : tiles)
         {
           tstrile_t tile = static_cast<tstrile_t>(i);
           PlaneRegion rfull = tileinfo.tileRegion(tile);
-          PlaneRegion rclip = tileinfo.tileRegion(tile, region);
+          PlaneRegion rclip = rfull & region;
           dimension_size_type sample = tileinfo.tileSample(tile);
 
           uint16_t copysamples = samples;
@@ -508,12 +3073,7 @@ namespace
               dest_subchannel = sample;
             }
 
-          // Note boost::make_shared makes arguments const, so can't use
-          // here.
-          if (!tilecache.find(tile))
-            tilecache.insert(tile, std::shared_ptr<TileBuffer>(new TileBuffer(tileinfo.bufferSize())));
-          assert(tilecache.find(tile));
-          TileBuffer& tilebuf = *tilecache.find(tile);
+          TileBuffer& tilebuf = tilecache.acquire(tile, packed.unpackedsize);
 
           typename T::indices_type srcidx;
           srcidx[ome::files::DIM_SPATIAL_X] = 0;
@@ -523,15 +3083,131 @@ namespace
             srcidx[ome::files::DIM_CHANNEL] = srcidx[ome::files::DIM_MODULO_Z] =
             srcidx[ome::files::DIM_MODULO_T] = srcidx[ome::files::DIM_MODULO_C] = 0;
 
-          transfer(buffer, srcidx, tilebuf, rfull, rclip, copysamples);
-          tilecoverage.at(dest_subchannel).insert(rclip);
-        }
+          transfer<Samples>(buffer, srcidx, tilebuf, rfull, rclip, copysamples);
+          if (statistics || summaries)
+            {
+              srcidx[ome::files::DIM_SPATIAL_X] = rclip.x - region.x;
+              srcidx[ome::files::DIM_SPATIAL_Y] = rclip.y - region.y;
+              if (statistics)
+                accumulate_statistics(*statistics, *buffer, srcidx, rclip.w, rclip.h,
+                                      copysamples, dest_subchannel);
+              if (summaries)
+                ifd.getTIFF()->addTileSummary(tile, summarise_block(*buffer, srcidx, rclip.w, rclip.h,
+                                                                    copysamples));
+            }
+          tilecoverage.at(dest_subchannel).insert(rclip);
+          if (tilecoverage.at(dest_subchannel).covered(rfull & rimage))
+            completed.insert(tile);
+        }
+    }
+  };
+
+  // Copy a native-size tile into a tile buffer.
+  struct NativeTileVisitor
+  {
+    TileBuffer&         tilebuf;
+    dimension_size_type count;
+
+    NativeTileVisitor(TileBuffer&         tilebuf,
+                      dimension_size_type count):
+      tilebuf(tilebuf),
+      count(count)
+    {}
+
+    template<typename T>
+    void
+    operator()(const std::shared_ptr<T>& buffer)
+    {
+      typename T::value_type *dest = reinterpret_cast<typename T::value_type *>(tilebuf.data());
+      const typename T::value_type *src = buffer->data();
+
+      assert(count * sizeof(typename T::value_type) <= tilebuf.size());
+      std::copy(src, src + count, dest);
+    }
+
+    // Special case for BIT
+    void
+    operator()(const std::shared_ptr<PixelBuffer<PixelProperties<PixelType::BIT>::std_type>>& buffer)
+    {
+      assert((count + 7U) / 8U <= tilebuf.size());
+      ome::files::detail::packBits(buffer->data(), tilebuf.data(), 0U, count);
+    }
+  };
+
+  // Summarise the w×h block at the origin of a native-size tile.
+  struct TileSummaryVisitor
+  {
+    dimension_size_type w;
+    dimension_size_type h;
+    uint16_t            nsamples;
+    TileSummary         summary;
+
+    TileSummaryVisitor(dimension_size_type w,
+                       dimension_size_type h,
+                       uint16_t            nsamples):
+      w(w),
+      h(h),
+      nsamples(nsamples),
+      summary()
+    {}
 
-      // Flush covered tiles
-      flush();
+    template<typename T>
+    void
+    operator()(const std::shared_ptr<T>& buffer)
+    {
+      PixelBufferBase::indices_type idx;
+      idx.fill(0);
+      summary = summarise_block(*buffer, idx, w, h, nsamples);
     }
   };
 
+  // Read each tile of an IFD in file order, skipping spatial tiles
+  // which are not set in visit (if not empty).
+  void
+  for_each_tile(const IFD&                ifd,
+                const IFD::tile_callback& callback,
+                bool                      expand,
+                const std::vector<bool>&  visit)
+  {
+    TileInfo info = ifd.getTileInfo();
+    const PlaneRegion full(0, 0, ifd.getImageWidth(), ifd.getImageHeight());
+
+    // Spatial tiles; for planar images these are the tiles of the
+    // first sample, which are read along with the other samples.
+    const dimension_size_type ntiles = info.tileRowCount() * info.tileColumnCount();
+    std::vector<dimension_size_type> order;
+    order.reserve(ntiles);
+    for (dimension_size_type tile = 0; tile < ntiles; ++tile)
+      if (visit.empty() || visit[tile])
+        order.push_back(tile);
+
+    std::vector<uint64_t> offsets;
+    try
+      {
+        ifd.getField(info.tileType() == TILE ? TILEOFFSETS : STRIPOFFSETS).get(offsets);
+      }
+    catch (const std::exception&)
+      {
+      }
+    if (offsets.size() >= ntiles)
+      std::stable_sort(order.begin(), order.end(),
+                       [&offsets](dimension_size_type lhs, dimension_size_type rhs)
+                       { return offsets[lhs] < offsets[rhs]; });
+
+    VariantPixelBuffer buf;
+    for (const auto tile : order)
+      {
+        PlaneRegion region(info.tileRegion(tile, full));
+        if (!region.area())
+          continue;
+        if (expand)
+          ifd.readImageExpanded(buf, region);
+        else
+          ifd.readImage(buf, region.x, region.y, region.w, region.h);
+        callback(region, buf);
+      }
+  }
+
 }
 
 namespace ome
@@ -580,6 +3256,10 @@ namespace ome
         std::vector<TileCoverage> coverage;
         /// Tile cache (used when writing).
         TileCache tilecache;
+        /// Completed tiles pending writing (used when writing).
+        std::set<dimension_size_type> completed;
+        /// Tiles written out of order (used when writing).
+        std::vector<bool> written;
         /// Tile type.
         boost::optional<TileType> tiletype;
         /// Image width.
@@ -604,6 +3284,10 @@ namespace ome
         boost::optional<Compression> compression;
         /// Current tile (for writing).
         tstrile_t ctile;
+        /// Tag snapshot loaded (or loading skipped for writable files).
+        std::atomic<bool> loaded;
+        /// Cached tile information (read-only files only).
+        std::shared_ptr<TileInfo> tileinfo;
 
         /**
          * Constructor.
@@ -617,6 +3301,8 @@ namespace ome
           offset(offset),
           coverage(),
           tilecache(),
+          completed(),
+          written(),
           imagewidth(),
           imageheight(),
           tilewidth(),
@@ -624,8 +3310,66 @@ namespace ome
           pixeltype(),
           samples(),
           planarconfig(),
-          ctile(0)
+          ctile(0),
+          loaded(false),
+          tileinfo()
+        {
+        }
+
+        /**
+         * Load a snapshot of the core tags.
+         *
+         * For files opened read-only, the directory is made current
+         * once and all the core tags are read under a single lock.
+         * The values are immutable for the lifetime of the IFD, so
+         * the accessors may then be used without locking, switching
+         * directory or calling TIFFGetField again.  Writable files
+         * are not snapshotted, since their tags may be changed by
+         * the setters; the accessors cache individual values as
+         * before.
+         *
+         * Loading stops at the first missing or invalid tag; the
+         * remaining values are read by their accessors on demand, so
+         * that the error is reported where the tag is used.
+         *
+         * @param ifd the IFD to load.
+         */
+        void
+        load(const IFD& ifd)
         {
+          if (loaded)
+            return;
+
+          Sentry sentry(*tiff, IOStatistics::LOCK_TAG);
+
+          if (loaded)
+            return;
+          loaded = true;
+
+          ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+          if (TIFFGetMode(tiffraw) != O_RDONLY)
+            return;
+
+          ifd.makeCurrent();
+
+          try
+            {
+              ifd.getTileType();
+              ifd.getImageWidth();
+              ifd.getImageHeight();
+              ifd.getTileWidth();
+              ifd.getTileHeight();
+              ifd.getSamplesPerPixel();
+              ifd.getPlanarConfiguration();
+              ifd.getBitsPerSample();
+              ifd.getPixelType();
+              ifd.getCompression();
+              ifd.getPhotometricInterpretation();
+            }
+          catch (const Exception&)
+            {
+              // Remaining tags are read by their accessors on demand.
+            }
         }
 
         /// Destructor.
@@ -666,7 +3410,11 @@ namespace ome
       {
         ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        // Use the directory offset index when reading.
+        if (TIFFGetMode(tiffraw) == O_RDONLY)
+          return tiff->getDirectoryByIndex(index);
+
+        Sentry sentry(*tiff, IOStatistics::LOCK_DIRECTORY);
 
         if (!TIFFSetDirectory(tiffraw, index))
           sentry.error();
@@ -699,12 +3447,13 @@ namespace ome
         std::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(*tiff, IOStatistics::LOCK_DIRECTORY);
 
         if (static_cast<offset_type>(TIFFCurrentDirOffset(tiffraw)) != impl->offset)
           {
             if (!TIFFSetSubDirectory(tiffraw, impl->offset))
               sentry.error();
+            detail::setRGBColorMode(tiffraw);
           }
       }
 
@@ -727,7 +3476,7 @@ namespace ome
         std::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(*tiff, IOStatistics::LOCK_TAG);
 
         makeCurrent();
 
@@ -756,7 +3505,7 @@ namespace ome
         std::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(*tiff, IOStatistics::LOCK_TAG);
 
         makeCurrent();
 
@@ -785,7 +3534,7 @@ namespace ome
         std::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(*tiff, IOStatistics::LOCK_TAG);
 
         makeCurrent();
 
@@ -806,6 +3555,8 @@ namespace ome
       TileType
       IFD::getTileType() const
       {
+        impl->load(*this);
+
         if (!impl->tiletype)
           {
             uint32_t w, h;
@@ -846,12 +3597,26 @@ namespace ome
       TileInfo
       IFD::getTileInfo()
       {
-        return TileInfo(this->shared_from_this());
+        const IFD& self(*this);
+        return self.getTileInfo();
       }
 
       const TileInfo
       IFD::getTileInfo() const
       {
+        std::shared_ptr<TIFF>& tiff = getTIFF();
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+
+        Sentry sentry(*tiff, IOStatistics::LOCK_TAG);
+
+        // Tile layout is fixed for read-only files, so compute once.
+        if (TIFFGetMode(tiffraw) == O_RDONLY)
+          {
+            if (!impl->tileinfo)
+              impl->tileinfo = std::make_shared<TileInfo>(const_cast<IFD *>(this)->shared_from_this());
+            return *impl->tileinfo;
+          }
+
         return TileInfo(const_cast<IFD *>(this)->shared_from_this());
       }
 
@@ -870,6 +3635,8 @@ namespace ome
       uint32_t
       IFD::getImageWidth() const
       {
+        impl->load(*this);
+
         if (!impl->imagewidth)
           {
             uint32_t width;
@@ -889,6 +3656,8 @@ namespace ome
       uint32_t
       IFD::getImageHeight() const
       {
+        impl->load(*this);
+
         if (!impl->imageheight)
           {
             uint32_t height;
@@ -908,6 +3677,8 @@ namespace ome
       uint32_t
       IFD::getTileWidth() const
       {
+        impl->load(*this);
+
         if (!impl->tilewidth)
           {
             if (getTileType() == TILE)
@@ -941,6 +3712,8 @@ namespace ome
       uint32_t
       IFD::getTileHeight() const
       {
+        impl->load(*this);
+
         if (!impl->tileheight)
           {
             if (getTileType() == TILE)
@@ -976,6 +3749,8 @@ namespace ome
       ::ome::xml::model::enums::PixelType
       IFD::getPixelType() const
       {
+        impl->load(*this);
+
         PixelType pt = PixelType::UINT8;
 
         if (impl->pixeltype)
@@ -995,80 +3770,8 @@ namespace ome
                 sampleformat = UNSIGNED_INT;
               }
 
-            uint16_t bits = getBitsPerSample();
-
-            switch(sampleformat)
-              {
-              case UNSIGNED_INT:
-                {
-                  if (bits == 1)
-                    pt = PixelType::BIT;
-                  else if (bits == 8)
-                    pt = PixelType::UINT8;
-                  else if (bits == 16)
-                    pt = PixelType::UINT16;
-                  else if (bits == 32)
-                    pt = PixelType::UINT32;
-                  else
-                    {
-                      boost::format fmt("Bit depth %1% unsupported for unsigned integer pixel type");
-                      fmt % bits;
-                      throw Exception(fmt.str());
-                    }
-                }
-                break;
-              case SIGNED_INT:
-                {
-                  if (bits == 8)
-                    pt = PixelType::INT8;
-                  else if (bits == 16)
-                    pt = PixelType::INT16;
-                  else if (bits == 32)
-                pt = PixelType::INT32;
-                  else
-                    {
-                      boost::format fmt("Bit depth %1% unsupported for signed integer pixel type");
-                      fmt % bits;
-                      throw Exception(fmt.str());
-                    }
-                }
-                break;
-              case FLOAT:
-                {
-                  if (bits == 32)
-                    pt = PixelType::FLOAT;
-                  else if (bits == 64)
-                    pt = PixelType::DOUBLE;
-                  else
-                    {
-                      boost::format fmt("Bit depth %1% unsupported for floating point pixel type");
-                      fmt % bits;
-                      throw Exception(fmt.str());
-                    }
-                }
-                break;
-              case COMPLEX_FLOAT:
-                {
-                  if (bits == 64)
-                    pt = PixelType::COMPLEXFLOAT;
-                  else if (bits == 128)
-                    pt = PixelType::COMPLEXDOUBLE;
-                  else
-                    {
-                      boost::format fmt("Bit depth %1% unsupported for complex floating point pixel type");
-                      fmt % bits;
-                      throw Exception(fmt.str());
-                    }
-                }
-                break;
-              default:
-                {
-                  boost::format fmt("TIFF SampleFormat %1% unsupported by OME data model PixelType");
-                  fmt % sampleformat;
-                  throw Exception(fmt.str());
-                }
-                break;
-              }
+            pt = pixelTypeFromSampleFormat(sampleformat, getBitsPerSample());
+            impl->pixeltype = pt;
           }
         return pt;
       }
@@ -1119,6 +3822,8 @@ namespace ome
       uint16_t
       IFD::getBitsPerSample() const
       {
+        impl->load(*this);
+
         if (!impl->bits)
           {
             uint16_t bits;
@@ -1142,6 +3847,8 @@ namespace ome
       uint16_t
       IFD::getSamplesPerPixel() const
       {
+        impl->load(*this);
+
         if (!impl->samples)
           {
             uint16_t samples;
@@ -1161,6 +3868,8 @@ namespace ome
       PlanarConfiguration
       IFD::getPlanarConfiguration() const
       {
+        impl->load(*this);
+
         if (!impl->planarconfig)
           {
             PlanarConfiguration config;
@@ -1180,6 +3889,8 @@ namespace ome
       PhotometricInterpretation
       IFD::getPhotometricInterpretation() const
       {
+        impl->load(*this);
+
         if (!impl->photometric)
           {
             PhotometricInterpretation photometric;
@@ -1199,6 +3910,8 @@ namespace ome
       Compression
       IFD::getCompression() const
       {
+        impl->load(*this);
+
         if (!impl->compression)
           {
             Compression compression;
@@ -1215,6 +3928,99 @@ namespace ome
         impl->compression = compression;
       }
 
+      void
+      IFD::setCodecParameters(const CodecParameters& params)
+      {
+        const uint16_t compression = static_cast<uint16_t>(getCompression());
+
+        boost::optional<Predictor> predictor(params.predictor);
+        if (!predictor && params.automaticPredictor)
+          predictor = defaultPredictor(getPixelType());
+
+        if (predictor && codec_predictor(compression))
+          {
+            // libtiff only reports an incompatible predictor when
+            // the first strip or tile is written; fail early.
+            if (*predictor == FLOATING_POINT)
+              {
+                PixelType pt = getPixelType();
+                if (pt != PixelType::FLOAT && pt != PixelType::DOUBLE)
+                  {
+                    boost::format fmt("Floating point predictor not supported with PixelType %1%");
+                    fmt % pt;
+                    throw Exception(fmt.str());
+                  }
+              }
+            getField(PREDICTOR).set(*predictor);
+          }
+
+        if (params.level)
+          {
+            const ttag_t leveltag = codec_level_tag(compression);
+            if (leveltag)
+              setRawField(leveltag, *params.level);
+          }
+
+#if defined(COMPRESSION_LERC) && defined(TIFFTAG_LERC_MAXZERROR)
+        if (params.maxError && compression == COMPRESSION_LERC)
+          setRawField(TIFFTAG_LERC_MAXZERROR, *params.maxError);
+#endif
+      }
+
+      CodecParameters
+      IFD::getCodecParameters() const
+      {
+        CodecParameters params;
+        const uint16_t compression = static_cast<uint16_t>(getCompression());
+
+        if (codec_predictor(compression))
+          {
+            try
+              {
+                Predictor predictor;
+                getField(PREDICTOR).get(predictor);
+                params.predictor = predictor;
+              }
+            catch (const Exception&)
+              {
+                // No predictor.
+              }
+          }
+
+        const ttag_t leveltag = codec_level_tag(compression);
+        if (leveltag)
+          {
+            try
+              {
+                int level;
+                getRawField(leveltag, &level);
+                params.level = level;
+              }
+            catch (const Exception&)
+              {
+                // Codec default.
+              }
+          }
+
+#if defined(COMPRESSION_LERC) && defined(TIFFTAG_LERC_MAXZERROR)
+        if (compression == COMPRESSION_LERC)
+          {
+            try
+              {
+                double maxError;
+                getRawField(TIFFTAG_LERC_MAXZERROR, &maxError);
+                params.maxError = maxError;
+              }
+            catch (const Exception&)
+              {
+                // Lossless.
+              }
+          }
+#endif
+
+        return params;
+      }
+
       void
       IFD::readImage(VariantPixelBuffer& buf) const
       {
@@ -1234,10 +4040,184 @@ namespace ome
                      dimension_size_type y,
                      dimension_size_type w,
                      dimension_size_type h) const
+      {
+        OME_FILES_TRACE(trace, "tiff", "read_image");
+
+        prepareBuffer(dest, w, h);
+
+        TileInfo info = getTileInfo();
+
+        PlaneRegion region(x, y, w, h);
+        TileRange tiles(info.tileRange(region));
+
+        ReadVisitor v(*this, info, region, tiles);
+        ome::compat::visit(v, dest.vbuffer());
+      }
+
+      void
+      IFD::readImage(VariantPixelBuffer& dest,
+                     const PlaneRegion&  region,
+                     dimension_size_type xstep,
+                     dimension_size_type ystep) const
+      {
+        OME_FILES_TRACE(trace, "tiff", "read_image");
+
+        if (xstep == 0U || ystep == 0U)
+          {
+            boost::format fmt("Invalid decimation step %1%×%2%");
+            fmt % xstep % ystep;
+            throw Exception(fmt.str());
+          }
+
+        prepareBuffer(dest,
+                      (region.w + xstep - 1U) / xstep,
+                      (region.h + ystep - 1U) / ystep);
+
+        TileInfo info = getTileInfo();
+
+        TileRange tiles(info.tileRange(region));
+
+        ReadVisitor v(*this, info, region, tiles, xstep, ystep);
+        ome::compat::visit(v, dest.vbuffer());
+      }
+
+      void
+      IFD::readImageExpanded(VariantPixelBuffer& dest,
+                             const PlaneRegion&  region,
+                             dimension_size_type xstep,
+                             dimension_size_type ystep) const
+      {
+        OME_FILES_TRACE(trace, "tiff", "read_image");
+
+        if (!isExpandable())
+          throw Exception("Image is not palette color with 8 or 16 bit indexes");
+
+        if (xstep == 0U || ystep == 0U)
+          {
+            boost::format fmt("Invalid decimation step %1%×%2%");
+            fmt % xstep % ystep;
+            throw Exception(fmt.str());
+          }
+
+        std::array<VariantPixelBuffer::size_type, 9> shape, dest_shape;
+        shape[DIM_SPATIAL_X] = (region.w + xstep - 1U) / xstep;
+        shape[DIM_SPATIAL_Y] = (region.h + ystep - 1U) / ystep;
+        shape[DIM_SUBCHANNEL] = 3U;
+        shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+          shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+
+        const VariantPixelBuffer::size_type *dest_shape_ptr(dest.shape());
+        std::copy(dest_shape_ptr, dest_shape_ptr + PixelBufferBase::dimensions,
+                  dest_shape.begin());
+
+        // Interleaved unless the destination is already planar.
+        PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+        PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, false));
+        if (planar == dest.storage_order())
+          order = planar;
+
+        if (dest.pixelType() != PixelType::UINT16 ||
+            shape != dest_shape ||
+            !(order == dest.storage_order()))
+          dest.setBuffer(shape, PixelType::UINT16, order, dest.allocator());
+
+        TileInfo info = getTileInfo();
+
+        TileRange tiles(info.tileRange(region));
+
+        ReadVisitor v(*this, info, region, tiles, xstep, ystep);
+        v.lut = getLookupTable();
+        ome::compat::visit(v, dest.vbuffer());
+      }
+
+      bool
+      IFD::isExpandable() const
+      {
+        if (getSamplesPerPixel() != 1U ||
+            getPhotometricInterpretation() != PALETTE)
+          return false;
+
+        PixelType type = getPixelType();
+        if (type != PixelType::UINT8 && type != PixelType::UINT16)
+          return false;
+
+        try
+          {
+            getLookupTable();
+          }
+        catch (const Exception&)
+          {
+            return false;
+          }
+        return true;
+      }
+
+      void
+      IFD::readImages(std::vector<VariantPixelBuffer>& dest,
+                      const std::vector<PlaneRegion>&  regions) const
+      {
+        OME_FILES_TRACE(trace, "tiff", "read_images");
+
+        dest.resize(regions.size());
+        if (regions.empty())
+          return;
+
+        for (std::vector<PlaneRegion>::size_type r = 0; r < regions.size(); ++r)
+          prepareBuffer(dest[r], regions[r].w, regions[r].h);
+
+        TileInfo info = getTileInfo();
+
+        // Union of the tiles covered by all regions.
+        BatchReadVisitor::tile_map tiles;
+        for (std::vector<PlaneRegion>::size_type r = 0; r < regions.size(); ++r)
+          for (const auto tile : info.tileRange(regions[r]))
+            tiles[tile].push_back(r);
+
+        BatchReadVisitor v(*this, info, regions, dest, tiles);
+        ome::compat::visit(v, dest.front().vbuffer());
+      }
+
+      void
+      IFD::forEachTile(const tile_callback& callback,
+                       bool                 expand) const
+      {
+        for_each_tile(*this, callback, expand, std::vector<bool>());
+      }
+
+      void
+      IFD::forEachTileInRange(double               low,
+                              double               high,
+                              const tile_callback& callback,
+                              bool                 expand) const
+      {
+        TileInfo info = getTileInfo();
+        const dimension_size_type ntiles = info.tileRowCount() * info.tileColumnCount();
+        const std::vector<TileSummary> summaries(getTileSummaries());
+
+        // Expanded tiles do not contain the summarised values, so
+        // are all visited, as are tiles without a summary.  For
+        // planar images, a tile is visited if any sample may match.
+        std::vector<bool> visit;
+        if (!expand && summaries.size() == info.tileCount())
+          {
+            visit.resize(static_cast<std::vector<bool>::size_type>(ntiles), false);
+            for (dimension_size_type tile = 0; tile < summaries.size(); ++tile)
+              if (summaries[tile].overlaps(low, high))
+                visit[tile % ntiles] = true;
+          }
+
+        for_each_tile(*this, callback, expand, visit);
+      }
+
+      void
+      IFD::prepareBuffer(VariantPixelBuffer& dest,
+                         dimension_size_type w,
+                         dimension_size_type h,
+                         bool                subchannel) const
       {
         PixelType type = getPixelType();
         PlanarConfiguration planarconfig = getPlanarConfiguration();
-        uint16_t subC = getSamplesPerPixel();
+        uint16_t subC = subchannel ? 1U : getSamplesPerPixel();
 
         std::array<VariantPixelBuffer::size_type, 9> shape, dest_shape;
         shape[DIM_SPATIAL_X] = w;
@@ -1250,48 +4230,127 @@ namespace ome
         std::copy(dest_shape_ptr, dest_shape_ptr + PixelBufferBase::dimensions,
                   dest_shape.begin());
 
-        PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, planarconfig == SEPARATE ? false : true));
+        PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, (planarconfig == SEPARATE || subchannel) ? false : true));
+
+        // A planar destination is retained for contiguous samples,
+        // which are then deinterleaved as they are read.  Packed BIT
+        // samples are always read interleaved.
+        if (planarconfig == CONTIG && !subchannel && subC > 1U && type != PixelType::BIT)
+          {
+            PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, false));
+            if (planar == dest.storage_order())
+              order = planar;
+          }
 
         if (type != dest.pixelType() ||
             shape != dest_shape ||
             !(order == dest.storage_order()))
-          dest.setBuffer(shape, type, order);
+          dest.setBuffer(shape, type, order, dest.allocator());
+      }
+
+      void
+      IFD::readImage(VariantPixelBuffer& dest,
+                     dimension_size_type x,
+                     dimension_size_type y,
+                     dimension_size_type w,
+                     dimension_size_type h,
+                     dimension_size_type subC) const
+      {
+        OME_FILES_TRACE(trace, "tiff", "read_image");
+
+        if (subC >= getSamplesPerPixel())
+          {
+            boost::format fmt("Subchannel %1% out of range (%2% samples)");
+            fmt % subC % getSamplesPerPixel();
+            throw Exception(fmt.str());
+          }
+
+        prepareBuffer(dest, w, h, true);
+
+        TileInfo info = getTileInfo();
+
+        // Only the tiles of the desired subchannel are decoded if
+        // planar; if contiguous, the subchannel is extracted while
+        // copying out of each tile.
+        PlaneRegion region(x, y, w, h);
+        TileRange tiles(info.tileRange(region, subC));
+
+        ReadVisitor v(*this, info, region, tiles);
+        v.subchannel = true;
+        v.subC = subC;
+        ome::compat::visit(v, dest.vbuffer());
+      }
+
+      void
+      IFD::readImage(VariantPixelBufferView& dest,
+                     const PlaneRegion&      region) const
+      {
+        OME_FILES_TRACE(trace, "tiff", "read_image");
+
+        const uint16_t samples = getSamplesPerPixel();
+        const VariantPixelBufferView::size_type *shape = dest.shape();
+        if (dest.pixelType() != getPixelType() ||
+            shape[DIM_SPATIAL_X] != region.w ||
+            shape[DIM_SPATIAL_Y] != region.h ||
+            shape[DIM_SUBCHANNEL] != samples)
+          {
+            boost::format fmt("Destination view (%1%x%2%x%3% %4%) does not match region (%5%x%6%x%7% %8%)");
+            fmt % shape[DIM_SPATIAL_X] % shape[DIM_SPATIAL_Y] % shape[DIM_SUBCHANNEL] % dest.pixelType();
+            fmt % region.w % region.h % samples % getPixelType();
+            throw Exception(fmt.str());
+          }
 
         TileInfo info = getTileInfo();
+        TileRange tiles(info.tileRange(region));
+
+        ReadVisitor v(*this, info, region, tiles);
+        ReadViewVisitor vv(v, samples, getPlanarConfiguration());
+        ome::compat::visit(vv, dest.vbuffer());
+
+        if (!vv.done)
+          {
+            VariantPixelBuffer buf;
+            readImage(buf, region.x, region.y, region.w, region.h);
+            dest.copyFrom(buf);
+          }
+      }
+
+      std::shared_ptr<const std::vector<uint16_t>>
+      IFD::getLookupTable() const
+      {
+        std::shared_ptr<TIFF>& tiff = getTIFF();
+        std::shared_ptr<const std::vector<uint16_t>> table(tiff->getCachedLookupTable(impl->offset));
+
+        if (!table)
+          {
+            std::array<std::vector<uint16_t>, 3> cmap;
+            getField(COLORMAP).get(cmap);
 
-        PlaneRegion region(x, y, w, h);
-        std::vector<dimension_size_type> tiles(info.tileCoverage(region));
+            const std::vector<uint16_t>::size_type entries = cmap.at(0).size();
+            if (!entries || cmap.at(1).size() != entries || cmap.at(2).size() != entries)
+              throw Exception("Invalid lookup table");
 
-        ReadVisitor v(*this, info, region, tiles);
-        ome::compat::visit(v, dest.vbuffer());
-      }
+            std::shared_ptr<std::vector<uint16_t>> rgb(std::make_shared<std::vector<uint16_t>>(entries * 3U));
+            for (std::vector<uint16_t>::size_type i = 0; i < entries; ++i)
+              for (std::vector<uint16_t>::size_type s = 0; s < 3U; ++s)
+                (*rgb)[(i * 3U) + s] = cmap[s][i];
 
-      void
-      IFD::readImage(VariantPixelBuffer& dest,
-                     dimension_size_type x,
-                     dimension_size_type y,
-                     dimension_size_type w,
-                     dimension_size_type h,
-                     dimension_size_type subC) const
-      {
-        // Copy the desired subchannel into the destination buffer.
-        VariantPixelBuffer tmp;
-        readImage(tmp, x, y, w, h);
+            table = rgb;
+            tiff->cacheLookupTable(impl->offset, table);
+          }
 
-        detail::CopySubchannelVisitor v(dest, subC);
-        ome::compat::visit(v, tmp.vbuffer());
+        return table;
       }
 
       void
       IFD::readLookupTable(VariantPixelBuffer& buf) const
       {
-        std::array<std::vector<uint16_t>, 3> cmap;
-        getField(tiff::COLORMAP).get(cmap);
+        std::shared_ptr<const std::vector<uint16_t>> table(getLookupTable());
 
         std::array<VariantPixelBuffer::size_type, 9> shape;
-        shape[DIM_SPATIAL_X] = cmap.at(0).size();
+        shape[DIM_SPATIAL_X] = table->size() / 3U;
         shape[DIM_SPATIAL_Y] = 1;
-        shape[DIM_SUBCHANNEL] = cmap.size();
+        shape[DIM_SUBCHANNEL] = 3U;
         shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
           shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
 
@@ -1305,18 +4364,9 @@ namespace ome
 
         for (VariantPixelBuffer::size_type s = 0U; s < shape[DIM_SUBCHANNEL]; ++s)
           {
-            const std::vector<uint16_t>& channel(cmap.at(s));
-
-            VariantPixelBuffer::indices_type coord;
-            coord[DIM_SPATIAL_X] = 0;
-            coord[DIM_SPATIAL_Y] = 0;
-            coord[DIM_SUBCHANNEL] = s;
-            coord[DIM_SPATIAL_Z] = coord[DIM_TEMPORAL_T] =
-              coord[DIM_CHANNEL] = coord[DIM_MODULO_Z] =
-              coord[DIM_MODULO_T] = coord[DIM_MODULO_C] = 0;
-
-            std::copy(channel.begin(), channel.end(),
-                      &uint16_buffer->at(coord));
+            const PixelRow<uint16_t> channel(uint16_buffer->row(0, 0, 0, 0, static_cast<PixelBufferBase::index>(s)));
+            for (VariantPixelBuffer::size_type i = 0U; i < shape[DIM_SPATIAL_X]; ++i)
+              channel.data[static_cast<PixelBufferBase::index>(i) * channel.xstride] = (*table)[(i * 3U) + s];
           }
 
       }
@@ -1335,14 +4385,12 @@ namespace ome
       }
 
       void
-      IFD::writeImage(const VariantPixelBuffer& source,
-                      dimension_size_type       x,
-                      dimension_size_type       y,
-                      dimension_size_type       w,
-                      dimension_size_type       h)
+      IFD::checkWriteSource(::ome::xml::model::enums::PixelType  sourcetype,
+                            const VariantPixelBuffer::size_type *source_shape_ptr,
+                            dimension_size_type                  w,
+                            dimension_size_type                  h) const
       {
         PixelType type = getPixelType();
-        PlanarConfiguration planarconfig = getPlanarConfiguration();
         uint16_t subC = getSamplesPerPixel();
 
         std::array<VariantPixelBuffer::size_type, 9> shape, source_shape;
@@ -1352,17 +4400,13 @@ namespace ome
         shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
           shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
 
-        const VariantPixelBuffer::size_type *source_shape_ptr(source.shape());
         std::copy(source_shape_ptr, source_shape_ptr + PixelBufferBase::dimensions,
                   source_shape.begin());
 
-        PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, planarconfig == SEPARATE ? false : true));
-        PixelBufferBase::storage_order_type source_order(source.storage_order());
-
-        if (type != source.pixelType())
+        if (type != sourcetype)
           {
             boost::format fmt("VariantPixelBuffer %1% pixel type is incompatible with TIFF %2% sample format and bit depth");
-            fmt % source.pixelType() % type;
+            fmt % sourcetype % type;
             throw Exception(fmt.str());
           }
 
@@ -1387,6 +4431,23 @@ namespace ome
                 throw Exception(fmt.str());
               }
           }
+      }
+
+      void
+      IFD::writeImage(const VariantPixelBuffer& source,
+                      dimension_size_type       x,
+                      dimension_size_type       y,
+                      dimension_size_type       w,
+                      dimension_size_type       h)
+      {
+        OME_FILES_TRACE(trace, "tiff", "write_image");
+
+        PlanarConfiguration planarconfig = getPlanarConfiguration();
+
+        checkWriteSource(source.pixelType(), source.shape(), w, h);
+
+        PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, planarconfig == SEPARATE ? false : true));
+        PixelBufferBase::storage_order_type source_order(source.storage_order());
 
         if (!(order == source_order))
           {
@@ -1404,12 +4465,156 @@ namespace ome
         TileInfo info = getTileInfo();
 
         PlaneRegion region(x, y, w, h);
-        std::vector<dimension_size_type> tiles(info.tileCoverage(region));
+        TileRange tiles(info.tileRange(region));
+
+        impl->tilecache.reserve(info.tileCount());
+        impl->tilecache.setFreeLimit(info.tileColumnCount());
+
+        WriteVisitor v(*this, impl->coverage, impl->tilecache,
+                       impl->completed, impl->written, info, region, tiles);
+        ome::compat::visit(v, source.vbuffer());
+      }
+
+      void
+      IFD::writeImage(const VariantPixelBufferView& source,
+                      dimension_size_type           x,
+                      dimension_size_type           y,
+                      dimension_size_type           w,
+                      dimension_size_type           h)
+      {
+        OME_FILES_TRACE(trace, "tiff", "write_image");
+
+        checkWriteSource(source.pixelType(), source.shape(), w, h);
+
+        TileInfo info = getTileInfo();
+
+        PlaneRegion region(x, y, w, h);
+        TileRange tiles(info.tileRange(region));
 
-        WriteVisitor v(*this, impl->coverage, impl->tilecache, info, region, tiles);
+        impl->tilecache.reserve(info.tileCount());
+        impl->tilecache.setFreeLimit(info.tileColumnCount());
+
+        WriteVisitor v(*this, impl->coverage, impl->tilecache,
+                       impl->completed, impl->written, info, region, tiles);
         ome::compat::visit(v, source.vbuffer());
       }
 
+      bool
+      IFD::writeImage(VariantPixelBuffer&& source)
+      {
+        return writeImage(std::move(source), 0, 0, getImageWidth(), getImageHeight());
+      }
+
+      bool
+      IFD::writeImage(VariantPixelBuffer&& source,
+                      dimension_size_type  x,
+                      dimension_size_type  y,
+                      dimension_size_type  w,
+                      dimension_size_type  h)
+      {
+        if (writeStrips(source, x, y, w, h))
+          return true;
+
+        writeImage(static_cast<const VariantPixelBuffer&>(source), x, y, w, h);
+        return false;
+      }
+
+      bool
+      IFD::writeStrips(VariantPixelBuffer& source,
+                       dimension_size_type x,
+                       dimension_size_type y,
+                       dimension_size_type w,
+                       dimension_size_type h)
+      {
+        checkWriteSource(source.pixelType(), source.shape(), w, h);
+
+        std::shared_ptr<TIFF>& tiff = getTIFF();
+        PlanarConfiguration planarconfig = getPlanarConfiguration();
+        PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, planarconfig == SEPARATE ? false : true));
+
+        // The strips must be written by libtiff in full, so any
+        // processing of the cached tiles, packing of samples, or
+        // encoding with a codec plugin, rules out a direct write.
+        if (source.pixelType() == PixelType::BIT ||
+            getBitsPerSample() != bitsPerPixel(source.pixelType()) ||
+            !(order == source.storage_order()) ||
+            getCodecPlugin(getCompression()) ||
+            tiff->getStatistics() ||
+            tiff->getTileHashes() ||
+            tiff->getTileSummaries() ||
+            tiff->getEncodeThreads() > 1U ||
+            tiff->getSubResolutionWriter(*this))
+          return false;
+
+        TileInfo info = getTileInfo();
+        const dimension_size_type width = getImageWidth();
+        const dimension_size_type height = getImageHeight();
+
+        if (info.tileType() != STRIP || x != 0 || w != width ||
+            y + h > height || !h)
+          return false;
+
+        // The region must start and end on strip boundaries (or the
+        // end of the image).
+        const dimension_size_type rows = info.tileHeight();
+        if (y % rows || ((y + h) % rows && y + h != height))
+          return false;
+
+        PlaneRegion region(x, y, w, h);
+        TileRange tiles(info.tileRange(region));
+        std::vector<tstrile_t> strips;
+        for (const auto i : tiles)
+          strips.push_back(static_cast<tstrile_t>(i));
+        std::sort(strips.begin(), strips.end());
+
+        // The strips must follow on from the last strip written, and
+        // must not be cached or written already.
+        for (std::vector<tstrile_t>::size_type i = 0; i < strips.size(); ++i)
+          {
+            const tstrile_t strip = strips[i];
+            if (strip != impl->ctile + i ||
+                impl->tilecache.find(strip) ||
+                (strip < impl->written.size() && impl->written[strip]))
+              return false;
+          }
+
+        const uint16_t samples = getSamplesPerPixel();
+        const dimension_size_type copysamples = (planarconfig == SEPARATE) ? 1U : samples;
+        const dimension_size_type rowsize = w * copysamples * bytesPerPixel(source.pixelType());
+        VariantPixelBuffer::raw_type *data = source.data();
+
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+
+        {
+          Sentry sentry(*tiff, IOStatistics::LOCK_ENCODE);
+
+          for (const auto strip : strips)
+            {
+              PlaneRegion rstrip = info.tileRegion(strip) & region;
+              dimension_size_type offset = (rstrip.y - y) * rowsize;
+              if (planarconfig == SEPARATE)
+                offset += info.tileSample(strip) * h * rowsize;
+
+              // libtiff may modify the data while encoding; this is
+              // permitted since the caller has given up the buffer.
+              const tsize_t size = static_cast<tsize_t>(rstrip.h * rowsize);
+              tsize_t byteswritten = TIFFWriteEncodedStrip(tiffraw, strip, data + offset, size);
+              if (byteswritten < 0)
+                sentry.error("Failed to write encoded strip");
+              else if (byteswritten != size)
+                sentry.error("Failed to write encoded strip fully");
+            }
+        }
+
+        tiff->streamWritten();
+
+        impl->ctile = strips.back() + 1;
+        while (impl->ctile < impl->written.size() && impl->written[impl->ctile])
+          ++impl->ctile;
+
+        return true;
+      }
+
       void
       IFD::writeImage(const VariantPixelBuffer& /* source*/,
                       dimension_size_type       /* x*/,
@@ -1421,6 +4626,359 @@ namespace ome
         throw Exception("Writing subchannels separately is not yet implemented (requires TileCache and WriteVisitor to handle writing and caching of interleaved and non-interleaved subchannels; currently it handles writing all subchannels in one call only and can not combine separate subchannels from separate calls");
       }
 
+      void
+      IFD::readRawTile(dimension_size_type   tile,
+                       std::vector<uint8_t>& buf) const
+      {
+        std::shared_ptr<TIFF>& tiff = getTIFF();
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+        TileType type = getTileType();
+        TileInfo info = getTileInfo();
+
+        if (tile >= info.tileCount())
+          {
+            boost::format fmt("Invalid tile index %1%: IFD contains %2% tiles");
+            fmt % tile % info.tileCount();
+            throw Exception(fmt.str());
+          }
+
+        Sentry sentry(*tiff, IOStatistics::LOCK_DECODE);
+
+        makeCurrent();
+
+        uint64_t *bytecounts = nullptr;
+        if (!TIFFGetField(tiffraw,
+                          type == TILE ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS,
+                          &bytecounts) || !bytecounts)
+          sentry.error("Failed to get raw tile size");
+
+        buf.resize(static_cast<std::vector<uint8_t>::size_type>(bytecounts[tile]));
+        if (buf.empty())
+          return;
+
+        tstrile_t rtile = static_cast<tstrile_t>(tile);
+        tmsize_t size = static_cast<tmsize_t>(buf.size());
+        tmsize_t bytesread;
+        if (type == TILE)
+          {
+            bytesread = TIFFReadRawTile(tiffraw, rtile, buf.data(), size);
+            if (bytesread < 0)
+              sentry.error("Failed to read raw tile");
+          }
+        else
+          {
+            bytesread = TIFFReadRawStrip(tiffraw, rtile, buf.data(), size);
+            if (bytesread < 0)
+              sentry.error("Failed to read raw strip");
+          }
+        OME_FILES_IO_COUNT(tiff->getIOStatistics(), BYTES_READ, static_cast<uint64_t>(bytesread));
+        buf.resize(static_cast<std::vector<uint8_t>::size_type>(bytesread));
+      }
+
+      void
+      IFD::writeRawTile(dimension_size_type tile,
+                        const uint8_t       *data,
+                        dimension_size_type size)
+      {
+        std::shared_ptr<TIFF>& tiff = getTIFF();
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+        TileType type = getTileType();
+        TileInfo info = getTileInfo();
+
+        if (tile >= info.tileCount())
+          {
+            boost::format fmt("Invalid tile index %1%: IFD contains %2% tiles");
+            fmt % tile % info.tileCount();
+            throw Exception(fmt.str());
+          }
+
+        Sentry sentry(*tiff, IOStatistics::LOCK_ENCODE);
+
+        // libtiff requires a non-const buffer, but does not modify it.
+        void *rawdata = const_cast<uint8_t *>(data);
+        tstrile_t rtile = static_cast<tstrile_t>(tile);
+        tmsize_t rsize = static_cast<tmsize_t>(size);
+        tmsize_t byteswritten;
+        if (type == TILE)
+          {
+            byteswritten = TIFFWriteRawTile(tiffraw, rtile, rawdata, rsize);
+            if (byteswritten < 0)
+              sentry.error("Failed to write raw tile");
+            else if (byteswritten != rsize)
+              sentry.error("Failed to write raw tile fully");
+          }
+        else
+          {
+            byteswritten = TIFFWriteRawStrip(tiffraw, rtile, rawdata, rsize);
+            if (byteswritten < 0)
+              sentry.error("Failed to write raw strip");
+            else if (byteswritten != rsize)
+              sentry.error("Failed to write raw strip fully");
+          }
+        OME_FILES_IO_COUNT(tiff->getIOStatistics(), BYTES_WRITTEN, size);
+
+        if (tiff->getTileHashes() & TILE_HASH_ENCODED)
+          tiff->addTileHash(TILE_HASH_ENCODED, tile, tileHash(data, size));
+
+        tiff->streamWritten();
+
+        // Keep the current tile in step for sequential raw writes.
+        if (rtile == impl->ctile)
+          impl->ctile = rtile + 1;
+      }
+
+      std::vector<uint64_t>
+      IFD::getTileHashes(TileHash type) const
+      {
+        std::shared_ptr<TIFF>& tiff = getTIFF();
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+
+        Sentry sentry(*tiff, IOStatistics::LOCK_TAG);
+
+        makeCurrent();
+
+        // Each hash is stored as two LONGs, low word first.
+        std::vector<uint64_t> hashes;
+        uint32_t count = 0U;
+        void *data = nullptr;
+        if (TIFFGetField(tiffraw,
+                         type == TILE_HASH_ENCODED ?
+                         TIFFTAG_OME_TILE_HASHES_ENCODED : TIFFTAG_OME_TILE_HASHES_DECODED,
+                         &count, &data) && data)
+          {
+            const uint32_t *words = static_cast<const uint32_t *>(data);
+            hashes.reserve(count / 2U);
+            for (uint32_t i = 0U; i + 1U < count; i += 2U)
+              hashes.push_back(static_cast<uint64_t>(words[i]) |
+                               (static_cast<uint64_t>(words[i + 1U]) << 32));
+          }
+        return hashes;
+      }
+
+      std::vector<TileSummary>
+      IFD::getTileSummaries() const
+      {
+        std::shared_ptr<TIFF>& tiff = getTIFF();
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+
+        Sentry sentry(*tiff, IOStatistics::LOCK_TAG);
+
+        makeCurrent();
+
+        // Each summary is stored as three DOUBLEs: minimum, maximum
+        // and nonzero count.
+        std::vector<TileSummary> summaries;
+        uint32_t count = 0U;
+        void *data = nullptr;
+        if (TIFFGetField(tiffraw, TIFFTAG_OME_TILE_SUMMARIES, &count, &data) && data)
+          {
+            const double *values = static_cast<const double *>(data);
+            summaries.reserve(count / 3U);
+            for (uint32_t i = 0U; i + 2U < count; i += 3U)
+              {
+                TileSummary summary;
+                summary.min = values[i];
+                summary.max = values[i + 1U];
+                summary.nonzero = static_cast<uint64_t>(values[i + 2U]);
+                summaries.push_back(summary);
+              }
+          }
+        return summaries;
+      }
+
+      std::pair<double, double>
+      IFD::getNormalizationRange() const
+      {
+        const std::vector<TileSummary> summaries(getTileSummaries());
+        if (!summaries.empty() && summaries.size() == getTileInfo().tileCount())
+          {
+            TileSummary range;
+            bool known = true;
+            for (const auto& summary : summaries)
+              {
+                if (!summary.known())
+                  {
+                    known = false;
+                    break;
+                  }
+                range.merge(summary);
+              }
+            if (known && range.min < range.max && std::isfinite(range.max - range.min))
+              return std::make_pair(range.min, range.max);
+          }
+
+        const PixelStatistics typerange(getPixelType(), 1U);
+        return std::make_pair(typerange.getRangeMin(), typerange.getRangeMax());
+      }
+
+      void
+      IFD::writeTile(dimension_size_type       tile,
+                     const VariantPixelBuffer& source)
+      {
+        std::shared_ptr<TIFF>& tiff = getTIFF();
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+        PixelType type = getPixelType();
+        PlanarConfiguration planarconfig = getPlanarConfiguration();
+        TileInfo info = getTileInfo();
+
+        if (tile >= info.tileCount())
+          {
+            boost::format fmt("Invalid tile index %1%: IFD contains %2% tiles");
+            fmt % tile % info.tileCount();
+            throw Exception(fmt.str());
+          }
+
+        if (type != source.pixelType())
+          {
+            boost::format fmt("VariantPixelBuffer %1% pixel type is incompatible with TIFF %2% sample format and bit depth");
+            fmt % source.pixelType() % type;
+            throw Exception(fmt.str());
+          }
+
+        uint16_t copysamples = (planarconfig == SEPARATE) ? static_cast<uint16_t>(1U) : getSamplesPerPixel();
+
+        std::array<VariantPixelBuffer::size_type, 9> shape, source_shape;
+        shape[DIM_SPATIAL_X] = info.tileWidth();
+        shape[DIM_SPATIAL_Y] = info.tileHeight();
+        shape[DIM_SUBCHANNEL] = copysamples;
+        shape[DIM_SPATIAL_Z] = shape[DIM_TEMPORAL_T] = shape[DIM_CHANNEL] =
+          shape[DIM_MODULO_Z] = shape[DIM_MODULO_T] = shape[DIM_MODULO_C] = 1;
+
+        const VariantPixelBuffer::size_type *source_shape_ptr(source.shape());
+        std::copy(source_shape_ptr, source_shape_ptr + PixelBufferBase::dimensions,
+                  source_shape.begin());
+
+        PixelBufferBase::storage_order_type order(PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, planarconfig == SEPARATE ? false : true));
+
+        if (shape != source_shape || !(order == source.storage_order()))
+          {
+            boost::format fmt("VariantPixelBuffer dimensions (%1%×%2%, %3% samples) or storage order incompatible with native TIFF tile size (%4%×%5%, %6% samples)");
+            fmt % source_shape[DIM_SPATIAL_X] % source_shape[DIM_SPATIAL_Y] % source_shape[DIM_SUBCHANNEL];
+            fmt % shape[DIM_SPATIAL_X] % shape[DIM_SPATIAL_Y] % shape[DIM_SUBCHANNEL];
+            throw Exception(fmt.str());
+          }
+
+        if (tiff->getTileSummaries())
+          {
+            const PlaneRegion rclip(info.tileRegion(tile, PlaneRegion(0, 0, getImageWidth(), getImageHeight())));
+            TileSummaryVisitor v(rclip.w, rclip.h, copysamples);
+            ome::compat::visit(v, source.vbuffer());
+            tiff->addTileSummary(tile, v.summary);
+          }
+
+        // libtiff may modify the buffer while encoding, so the
+        // source is copied (or packed) rather than passed directly.
+        const PackedTile packed(*this, info);
+        TileBuffer tilebuf(info.bufferSize());
+        if (packed.bits)
+          {
+            TileBuffer unpacked(packed.unpackedsize);
+            NativeTileVisitor v(unpacked, info.tileWidth() * info.tileHeight() * copysamples);
+            ome::compat::visit(v, source.vbuffer());
+            packed.pack(unpacked.data(), unpacked.size(), tilebuf.data(), tilebuf.size());
+          }
+        else
+          {
+            NativeTileVisitor v(tilebuf, info.tileWidth() * info.tileHeight() * copysamples);
+            ome::compat::visit(v, source.vbuffer());
+          }
+
+        std::shared_ptr<SubResolutionWriter> subresolutions(tiff->getSubResolutionWriter(*this));
+        if (subresolutions)
+          {
+            if (packed.bits)
+              throw Exception("Sub-resolutions are not supported for packed samples");
+            subresolutions->addTile(info, tile, tilebuf);
+          }
+
+        tstrile_t rtile = static_cast<tstrile_t>(tile);
+
+        // A tile containing only zeros is not written if sparse.
+        const bool sparse = tiff->getSparseTiles() && zero_tile(tilebuf);
+
+        // Encoding may modify the tile, so it is hashed first.
+        const unsigned int hashes = sparse ? 0U : tiff->getTileHashes();
+        if (hashes & TILE_HASH_DECODED)
+          tiff->addTileHash(TILE_HASH_DECODED, tile, tileHash(tilebuf.data(), tilebuf.size()));
+
+        CodecTile plugintile;
+        std::shared_ptr<const CodecPlugin> plugin(codec_plugin(*this, info, true, plugintile));
+        std::vector<uint8_t> raw;
+        bool encoded = false;
+        if (plugin && !sparse)
+          {
+            const PlaneRegion rimage(0, 0, getImageWidth(), getImageHeight());
+            plugin_encode(*plugin, plugintile, info, rimage, rtile, tilebuf, raw);
+            encoded = true;
+          }
+        else if (hashes & TILE_HASH_ENCODED)
+          {
+            // Encode in memory so that the encoded data may be
+            // hashed, where the tile may be encoded independently.
+            Sentry sentry(*tiff, IOStatistics::LOCK_ENCODE);
+            EncodeTags tags(tiffraw, info.tileType());
+            if (tags.independent())
+              {
+                TileEncoder encoder(tags, sentry);
+                encoder.encode(rtile, tilebuf, raw, sentry);
+                encoded = true;
+              }
+          }
+        if (encoded && (hashes & TILE_HASH_ENCODED))
+          tiff->addTileHash(TILE_HASH_ENCODED, tile, tileHash(raw.data(), raw.size()));
+
+        if (!sparse)
+          {
+            Sentry sentry(*tiff, IOStatistics::LOCK_ENCODE);
+
+            if (encoded)
+              {
+                tsize_t rsize = static_cast<tsize_t>(raw.size());
+                tsize_t byteswritten = info.tileType() == TILE ?
+                  TIFFWriteRawTile(tiffraw, rtile, raw.data(), rsize) :
+                  TIFFWriteRawStrip(tiffraw, rtile, raw.data(), rsize);
+                if (byteswritten < 0)
+                  sentry.error("Failed to write encoded tile");
+                else if (byteswritten != rsize)
+                  sentry.error("Failed to write encoded tile fully");
+              }
+            else if (info.tileType() == TILE)
+              {
+                tsize_t byteswritten = TIFFWriteEncodedTile(tiffraw, rtile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+                if (byteswritten < 0)
+                  sentry.error("Failed to write encoded tile");
+                else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
+                  sentry.error("Failed to write encoded tile fully");
+              }
+            else
+              {
+                tsize_t byteswritten = TIFFWriteEncodedStrip(tiffraw, rtile, tilebuf.data(), static_cast<tsize_t>(tilebuf.size()));
+                if (byteswritten < 0)
+                  sentry.error("Failed to write encoded strip");
+                else if (static_cast<dimension_size_type>(byteswritten) != tilebuf.size())
+                  sentry.error("Failed to write encoded strip fully");
+              }
+          }
+
+        tiff->streamWritten();
+
+        // Keep the current tile in step for sequential writes, and
+        // record out of order writes so they are not written again
+        // by writeImage().
+        if (rtile == impl->ctile)
+          {
+            impl->ctile = rtile + 1;
+            while (impl->ctile < impl->written.size() && impl->written[impl->ctile])
+              ++impl->ctile;
+          }
+        else
+          {
+            if (impl->written.size() < info.tileCount())
+              impl->written.resize(info.tileCount(), false);
+            impl->written[rtile] = true;
+          }
+      }
+
       std::shared_ptr<IFD>
       IFD::next() const
       {
@@ -1429,7 +4987,19 @@ namespace ome
         std::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        // Use the directory offset index when reading.
+        if (TIFFGetMode(tiffraw) == O_RDONLY)
+          {
+            boost::optional<directory_index_type> index(tiff->getDirectoryIndex(impl->offset));
+            if (index)
+              {
+                if (*index + 1 < tiff->directoryCount())
+                  ret = tiff->getDirectoryByIndex(*index + 1);
+                return ret;
+              }
+          }
+
+        Sentry sentry(*tiff, IOStatistics::LOCK_DIRECTORY);
 
         makeCurrent();
 
@@ -1448,7 +5018,15 @@ namespace ome
         std::shared_ptr<TIFF>& tiff = getTIFF();
         ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
 
-        Sentry sentry;
+        // Use the directory offset index when reading.
+        if (TIFFGetMode(tiffraw) == O_RDONLY)
+          {
+            boost::optional<directory_index_type> index(tiff->getDirectoryIndex(impl->offset));
+            if (index)
+              return *index + 1 >= tiff->directoryCount();
+          }
+
+        Sentry sentry(*tiff, IOStatistics::LOCK_DIRECTORY);
 
         makeCurrent();
 
@@ -38,14 +38,20 @@
 #ifndef OME_FILES_TIFF_IFD_H
 #define OME_FILES_TIFF_IFD_H
 
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <ome/files/CoreMetadata.h>
+#include <ome/files/PlaneRegion.h>
 #include <ome/files/TileCoverage.h>
 #include <ome/files/tiff/TileInfo.h>
 #include <ome/files/tiff/Types.h>
 #include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
 
 #include <ome/xml/model/enums/PixelType.h>
 
@@ -57,6 +63,7 @@ namespace ome
     {
 
       class TIFF;
+      struct CodecParameters;
 
       /// Forward declaration of Field<Tag>.
       template<typename Tag>
@@ -99,6 +106,15 @@ namespace ome
         /// @endcond SKIP
 
       public:
+        /**
+         * Tile callback.
+         *
+         * Called with the region of a tile or strip and the pixel
+         * buffer containing it.
+         */
+        typedef std::function<void (const PlaneRegion&        region,
+                                    const VariantPixelBuffer& buf)> tile_callback;
+
         /// Destructor.
         virtual ~IFD();
 
@@ -473,6 +489,34 @@ namespace ome
         void
         setCompression(Compression compression);
 
+        /**
+         * Set codec parameters.
+         *
+         * The compression scheme must be set first, since the codec
+         * parameters are specific to the codec in use.  Parameters
+         * which are not applicable to the codec, or which are not
+         * supported by the TIFF library, are ignored.  The pixel
+         * type must also be set first if the predictor is chosen
+         * automatically.
+         *
+         * @param params the codec parameters.
+         * @throws Exception if the floating point predictor is used
+         * with a non-floating point pixel type.
+         */
+        void
+        setCodecParameters(const CodecParameters& params);
+
+        /**
+         * Get codec parameters.
+         *
+         * Only the parameters applicable to the codec in use are
+         * set.
+         *
+         * @returns the codec parameters.
+         */
+        CodecParameters
+        getCodecParameters() const;
+
         /**
          * Read a whole image plane into a pixel buffer.
          *
@@ -513,6 +557,12 @@ namespace ome
         /**
          * @copydoc IFD::readImage(VariantPixelBuffer&,dimension_size_type,dimension_size_type,dimension_size_type,dimension_size_type) const
          * @param subC the subchannel to read.
+         *
+         * Only the tiles or strips containing the subchannel are
+         * decoded, and the destination pixel buffer contains a single
+         * subchannel.
+         *
+         * @throws Exception if the subchannel is out of range.
          */
         void
         readImage(VariantPixelBuffer& dest,
@@ -522,6 +572,148 @@ namespace ome
                   dimension_size_type h,
                   dimension_size_type subC) const;
 
+        /**
+         * Read a region of an image plane into a pixel buffer view.
+         *
+         * Unlike readImage(VariantPixelBuffer&,dimension_size_type,dimension_size_type,dimension_size_type,dimension_size_type) const,
+         * the destination is never resized; it must already have
+         * the pixel type of the image, the size of the region and
+         * all the samples of the image.  The view may refer to
+         * memory which is not owned by a pixel buffer, with padded
+         * rows.  Where the samples of each pixel, or the pixels of
+         * each row, are adjacent in the view, decoded tiles are
+         * copied (or decoded) straight into the viewed memory.
+         * Otherwise, and for @c BIT pixels, the region is read into
+         * a temporary buffer and then copied into the view.
+         *
+         * @param dest the destination pixel buffer view.
+         * @param region the region to read.
+         * @throws Exception if the view does not match the region.
+         */
+        void
+        readImage(VariantPixelBufferView& dest,
+                  const PlaneRegion&      region) const;
+
+        /**
+         * Read a decimated region of an image plane into a pixel buffer.
+         *
+         * Only every @p xstep th column and @p ystep th row of the
+         * region, starting from its upper-left corner, are read, so
+         * the destination is ⌈w/xstep⌉ × ⌈h/ystep⌉ pixels.  Sampled
+         * pixels are copied directly from each decoded tile into the
+         * destination, and tiles or strips containing no sampled
+         * pixels are not decoded.  The destination pixel buffer is
+         * resized as for readImage().
+         *
+         * @param dest the destination pixel buffer.
+         * @param region the region to read.
+         * @param xstep the column step (1 to read every column).
+         * @param ystep the row step (1 to read every row).
+         * @throws Exception if either step is zero.
+         */
+        void
+        readImage(VariantPixelBuffer& dest,
+                  const PlaneRegion&  region,
+                  dimension_size_type xstep,
+                  dimension_size_type ystep) const;
+
+        /**
+         * Read a region of an indexed color image plane, expanding
+         * it to RGB.
+         *
+         * Each 8 or 16 bit index of a single sample palette color
+         * image is replaced by the red, green and blue values of the
+         * lookup table while copying out of each decoded tile, so
+         * no separate expansion pass is needed.  The destination
+         * pixel buffer is resized to a @c UINT16 buffer with three
+         * subchannels if needed, and is interleaved unless it is
+         * already planar.  Indexes beyond the end of the lookup table
+         * use its last entry.  Decimation is as for readImage().
+         *
+         * @param dest the destination pixel buffer.
+         * @param region the region to read.
+         * @param xstep the column step (1 to read every column).
+         * @param ystep the row step (1 to read every row).
+         * @throws Exception if the image is not palette color, or if
+         * either step is zero.
+         */
+        void
+        readImageExpanded(VariantPixelBuffer& dest,
+                          const PlaneRegion&  region,
+                          dimension_size_type xstep = 1U,
+                          dimension_size_type ystep = 1U) const;
+
+        /**
+         * Check if the image is palette color with a lookup table
+         * which may be expanded with readImageExpanded().
+         *
+         * @returns @c true if expandable, @c false otherwise.
+         */
+        bool
+        isExpandable() const;
+
+        /**
+         * Read several regions of an image plane into pixel buffers.
+         *
+         * This is equivalent to calling readImage() for each region,
+         * but each tile covered by any of the regions is decoded only
+         * once and then copied into every destination buffer which
+         * covers it, so that overlapping or neighbouring regions do
+         * not repeatedly decode the same tiles.  Destination buffers
+         * are resized as for readImage().
+         *
+         * @param dest the destination pixel buffers; resized to the
+         * number of regions, with one buffer per region.
+         * @param regions the regions to read.
+         */
+        void
+        readImages(std::vector<VariantPixelBuffer>& dest,
+                   const std::vector<PlaneRegion>&  regions) const;
+
+        /**
+         * Read an image plane one tile or strip at a time.
+         *
+         * Each tile or strip (clipped to the image) is read into a
+         * single reused pixel buffer and passed to the callback,
+         * so that a whole plane may be processed with memory use
+         * proportional to the tile size rather than the plane size.
+         * Tiles are visited in file order (the order of their
+         * offsets), to keep reads sequential.  For planar images,
+         * each callback covers all samples of the tile.  The buffer
+         * is only valid for the duration of the callback.
+         *
+         * @param callback the function to call for each tile.
+         * @param expand @c true to expand indexed color tiles to RGB
+         * with readImageExpanded(), @c false to read the indexes.
+         */
+        void
+        forEachTile(const tile_callback& callback,
+                    bool                 expand = false) const;
+
+        /**
+         * Read the tiles of an image plane which may contain values
+         * in a range.
+         *
+         * As forEachTile(), but tiles whose recorded summary (see
+         * getTileSummaries()) shows that they contain no value in the
+         * closed range [@p low, @p high] are skipped without being
+         * read or decoded.  Tiles without a summary are always read.
+         * For planar images, a tile is read if the tile of any sample
+         * may contain a value in the range.  The summaries are of the
+         * stored values, so no tiles are skipped if @p expand is set.
+         *
+         * @param low the lowest value of interest.
+         * @param high the highest value of interest.
+         * @param callback the function to call for each tile.
+         * @param expand @c true to expand indexed color tiles to RGB
+         * with readImageExpanded(), @c false to read the indexes.
+         */
+        void
+        forEachTileInRange(double               low,
+                           double               high,
+                           const tile_callback& callback,
+                           bool                 expand = false) const;
+
         /**
          * Read a lookup table into a pixel buffer.
          *
@@ -530,6 +722,19 @@ namespace ome
         void
         readLookupTable(VariantPixelBuffer& buf) const;
 
+        /**
+         * Get the lookup table.
+         *
+         * The COLORMAP tag is read once for each directory of the
+         * TIFF, and the table is then cached by the TIFF.
+         *
+         * @returns the lookup table, with the red, green and blue
+         * values of each entry interleaved.
+         * @throws Exception if there is no valid lookup table.
+         */
+        std::shared_ptr<const std::vector<uint16_t>>
+        getLookupTable() const;
+
         /**
          * Write a whole image plane from a pixel buffer.
          *
@@ -566,6 +771,67 @@ namespace ome
                    dimension_size_type       w,
                    dimension_size_type       h);
 
+        /**
+         * Write a region of an image plane from a pixel buffer view.
+         *
+         * This is equivalent to writing from a pixel buffer, but the
+         * view may refer to a crop or subchannel subset of a larger
+         * buffer, which is copied directly into the tile buffers.
+         * The view must match the size of the region being written,
+         * and must have the same pixel type as the TIFF image; its
+         * storage order does not matter.
+         *
+         * @param source the source pixel buffer view.
+         * @param x the @c X coordinate of the upper-left corner of the sub-image.
+         * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+         * @param w the width of the sub-image.
+         * @param h the height of the sub-image.
+         */
+        void
+        writeImage(const VariantPixelBufferView& source,
+                   dimension_size_type           x,
+                   dimension_size_type           y,
+                   dimension_size_type           w,
+                   dimension_size_type           h);
+
+        /**
+         * Write a whole image plane, taking ownership of a pixel buffer.
+         *
+         * @param source the source pixel buffer.
+         * @returns @c true if the strips were encoded directly from
+         * the buffer, or @c false if written via the tile cache.
+         */
+        bool
+        writeImage(VariantPixelBuffer&& source);
+
+        /**
+         * Write a region of an image plane, taking ownership of a
+         * pixel buffer.
+         *
+         * This is equivalent to writing from a const pixel buffer,
+         * but the buffer contents may be used as scratch space by
+         * the encoder, and are unspecified after the call.  If the
+         * region consists of whole strips following the last strip
+         * written, the strips are encoded directly from the buffer
+         * storage rather than being copied into the tile cache.
+         * This is not done when pixel statistics, sub-resolutions or
+         * parallel encoding are enabled, or for BIT pixels.
+         *
+         * @param source the source pixel buffer.
+         * @param x the @c X coordinate of the upper-left corner of the sub-image.
+         * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+         * @param w the width of the sub-image.
+         * @param h the height of the sub-image.
+         * @returns @c true if the strips were encoded directly from
+         * the buffer, or @c false if written via the tile cache.
+         */
+        bool
+        writeImage(VariantPixelBuffer&& source,
+                   dimension_size_type  x,
+                   dimension_size_type  y,
+                   dimension_size_type  w,
+                   dimension_size_type  h);
+
         /**
          * @copydoc IFD::writeImage(const VariantPixelBuffer&,dimension_size_type,dimension_size_type,dimension_size_type,dimension_size_type)
          * @param subC the subchannel to write.
@@ -578,6 +844,104 @@ namespace ome
                    dimension_size_type       h,
                    dimension_size_type       subC);
 
+        /**
+         * Read a raw (still compressed) tile or strip.
+         *
+         * The data are read exactly as stored in the file, without
+         * decompression or any other processing.  This is intended
+         * for copying image data between files without decoding and
+         * re-encoding it; the destination IFD must use the same
+         * compression scheme, tiling, pixel type and sample layout.
+         *
+         * @param tile the tile (or strip) index.
+         * @param buf the destination buffer; resized to fit the tile.
+         */
+        void
+        readRawTile(dimension_size_type   tile,
+                    std::vector<uint8_t>& buf) const;
+
+        /**
+         * Write a raw (already compressed) tile or strip.
+         *
+         * The data are written exactly as provided, without
+         * compression or any other processing.  Raw tiles and tiles
+         * written with writeImage() must not be mixed within the
+         * same IFD.
+         *
+         * @param tile the tile (or strip) index.
+         * @param data the raw tile data.
+         * @param size the size of @c data in bytes.
+         */
+        void
+        writeRawTile(dimension_size_type tile,
+                     const uint8_t       *data,
+                     dimension_size_type size);
+
+        /**
+         * Write a native-size tile or strip.
+         *
+         * The pixel data are encoded and written directly, without
+         * the tile caching and coverage tracking used by
+         * writeImage().  This is intended for callers which already
+         * produce whole tiles of the native tile size.  The source
+         * buffer must be of the IFD pixel type, with the native tile
+         * width and height, and all samples for contiguous planar
+         * configuration or a single sample for separate planar
+         * configuration; edge tiles must be padded to the full tile
+         * size.
+         *
+         * @param tile the tile (or strip) index.
+         * @param source the source pixel data.
+         * @throws Exception if the tile index is invalid or the
+         * buffer is incompatible with the native tile.
+         */
+        void
+        writeTile(dimension_size_type       tile,
+                  const VariantPixelBuffer& source);
+
+        /**
+         * Get the tile hashes recorded when the IFD was written.
+         *
+         * See TIFF::setTileHashes().  A hash of zero is not
+         * recorded.  The hashes of the encoded tiles may be compared
+         * with tileHash() of the data returned by readRawTile().
+         *
+         * @param type the type of hash.
+         * @returns the hash of each tile (or strip), or an empty
+         * list if no hashes of this type were recorded.
+         */
+        std::vector<uint64_t>
+        getTileHashes(TileHash type) const;
+
+        /**
+         * Get the tile summaries recorded when the IFD was written.
+         *
+         * See TIFF::setTileSummaries().  The @c count of each
+         * summary is not stored, and is zero.
+         *
+         * @returns the summary of each tile (or strip), or an empty
+         * list if no summaries were recorded.
+         */
+        std::vector<TileSummary>
+        getTileSummaries() const;
+
+        /**
+         * Get the range used to normalize floating point samples.
+         *
+         * See TIFF::setNormalized().  The range is the minimum and
+         * maximum of the tile summaries (see getTileSummaries()), so
+         * that every tile of the image is scaled alike.  If any
+         * summary is missing or unknown, or the summaries do not
+         * give a finite non-empty range, the range of the pixel type
+         * (see PixelStatistics::getRangeMin()) is used instead; this
+         * is [0, 1] for floating point types, so that data which is
+         * already normalized is unchanged.
+         *
+         * @returns the minimum and maximum of the range.
+         */
+        std::pair<double, double>
+        getNormalizationRange() const;
+
         /**
          * Get next directory.
          *
@@ -593,6 +957,55 @@ namespace ome
          */
         bool
         last() const;
+
+      private:
+        /**
+         * Write whole strips directly from a pixel buffer.
+         *
+         * @param source the source pixel buffer.
+         * @param x the @c X coordinate of the upper-left corner of the sub-image.
+         * @param y the @c Y coordinate of the upper-left corner of the sub-image.
+         * @param w the width of the sub-image.
+         * @param h the height of the sub-image.
+         * @returns @c true if written, or @c false if the source or
+         * region are unsuitable and nothing was written.
+         */
+        bool
+        writeStrips(VariantPixelBuffer& source,
+                    dimension_size_type x,
+                    dimension_size_type y,
+                    dimension_size_type w,
+                    dimension_size_type h);
+
+        /**
+         * Check a source pixel buffer is compatible with a region.
+         *
+         * @param sourcetype the source pixel type.
+         * @param source_shape the source shape.
+         * @param w the width of the region.
+         * @param h the height of the region.
+         * @throws Exception if the pixel type or shape differ.
+         */
+        void
+        checkWriteSource(::ome::xml::model::enums::PixelType  sourcetype,
+                         const VariantPixelBuffer::size_type *source_shape,
+                         dimension_size_type                  w,
+                         dimension_size_type                  h) const;
+
+        /**
+         * Resize a destination pixel buffer for a region, if needed.
+         *
+         * @param dest the destination pixel buffer.
+         * @param w the width of the region.
+         * @param h the height of the region.
+         * @param subchannel @c true if only a single subchannel is
+         * read, @c false for all subchannels.
+         */
+        void
+        prepareBuffer(VariantPixelBuffer& dest,
+                      dimension_size_type w,
+                      dimension_size_type h,
+                      bool                subchannel = false) const;
       };
 
     }
@@ -44,6 +44,10 @@
 #include <ome/files/tiff/TIFF.h>
 #include <ome/files/tiff/Exception.h>
 
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <locale>
 #include <sstream>
 
 namespace ome
@@ -60,27 +64,245 @@ namespace ome
 	const int LABELS =       0x6c61626c;  // "labl" (slice labels)
 	const int RANGES =       0x72616e67;  // "rang" (display ranges)
 	const int LUTS =         0x6c757473;  // "luts" (channel LUTs)
+
+        // Split an ImageDescription into lines, and each line on the
+        // first = into a key-value pair.  Lines without a = are
+        // skipped.  The callback is called with the start and end
+        // of the key and value.
+        template<typename F>
+        void
+        split_description(const std::string& description,
+                          F                  callback)
+        {
+          const std::string::size_type size = description.size();
+          std::string::size_type start = 0;
+
+          while (start < size)
+            {
+              std::string::size_type end = description.find('\n', start);
+              if (end == std::string::npos)
+                end = size;
+
+              std::string::size_type sep = description.find('=', start);
+              if (sep < end)
+                callback(start, sep, sep + 1, end);
+
+              start = end + 1;
+            }
+        }
+
+        // Skip leading whitespace, as for formatted stream input.
+        std::string::size_type
+        skip_space(const std::string& value)
+        {
+          std::string::size_type pos = 0;
+          while (pos < value.size() &&
+                 std::isspace(static_cast<unsigned char>(value[pos])))
+            ++pos;
+          return pos;
+        }
+
+        // Parse an unsigned integer.  Trailing characters are
+        // ignored, as for formatted stream input.
+        bool
+        parse_number(const std::string&   value,
+                     dimension_size_type& result)
+        {
+          std::string::size_type pos = skip_space(value);
+          if (pos < value.size() && value[pos] == '+')
+            ++pos;
+
+          const std::string::size_type begin = pos;
+          dimension_size_type v = 0;
+          for (; pos < value.size() && value[pos] >= '0' && value[pos] <= '9'; ++pos)
+            {
+              const dimension_size_type digit = static_cast<dimension_size_type>(value[pos] - '0');
+              if (v > (std::numeric_limits<dimension_size_type>::max() - digit) / 10U)
+                return false;
+              v = (v * 10U) + digit;
+            }
+
+          if (pos == begin)
+            return false;
+
+          result = v;
+          return true;
+        }
+
+        // Parse a real number using stream input in the classic
+        // locale.
+        bool
+        parse_number_stream(const std::string& value,
+                            double&            result)
+        {
+          std::istringstream is(value);
+          is.imbue(std::locale::classic());
+          double v;
+          if (!(is >> v))
+            return false;
+          result = v;
+          return true;
+        }
+
+        // Parse a real number.  Numbers with up to 15 significant
+        // digits and a small decimal exponent, which covers the
+        // values written by ImageJ, are converted exactly with a
+        // single multiplication or division by an exact power of
+        // ten.  Anything else falls back to stream input.  Trailing
+        // characters are ignored, as for formatted stream input.
+        bool
+        parse_number(const std::string& value,
+                     double&            result)
+        {
+          static const double powers[] =
+            {
+              1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+              1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+              1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+
+          std::string::size_type pos = skip_space(value);
+          bool negative = false;
+          if (pos < value.size() && (value[pos] == '+' || value[pos] == '-'))
+            negative = (value[pos++] == '-');
+
+          uint64_t mantissa = 0U;
+          int digits = 0;
+          int exponent = 0;
+          bool seen = false;
+
+          for (; pos < value.size() && value[pos] >= '0' && value[pos] <= '9'; ++pos)
+            {
+              seen = true;
+              if (mantissa || value[pos] != '0')
+                ++digits;
+              mantissa = (mantissa * 10U) + static_cast<uint64_t>(value[pos] - '0');
+              if (digits > 15)
+                return parse_number_stream(value, result);
+            }
+          if (pos < value.size() && value[pos] == '.')
+            {
+              for (++pos; pos < value.size() && value[pos] >= '0' && value[pos] <= '9'; ++pos)
+                {
+                  seen = true;
+                  if (mantissa || value[pos] != '0')
+                    ++digits;
+                  mantissa = (mantissa * 10U) + static_cast<uint64_t>(value[pos] - '0');
+                  --exponent;
+                  if (digits > 15)
+                    return parse_number_stream(value, result);
+                }
+            }
+          if (!seen)
+            return false;
+
+          if (pos < value.size() && (value[pos] == 'e' || value[pos] == 'E'))
+            {
+              std::string::size_type epos = pos + 1;
+              bool eneg = false;
+              if (epos < value.size() && (value[epos] == '+' || value[epos] == '-'))
+                eneg = (value[epos++] == '-');
+              if (epos < value.size() && value[epos] >= '0' && value[epos] <= '9')
+                {
+                  int e = 0;
+                  for (; epos < value.size() && value[epos] >= '0' && value[epos] <= '9'; ++epos)
+                    {
+                      if (e > 1000)
+                        return parse_number_stream(value, result);
+                      e = (e * 10) + (value[epos] - '0');
+                    }
+                  exponent += eneg ? -e : e;
+                }
+            }
+
+          if (exponent < -22 || exponent > 22)
+            return parse_number_stream(value, result);
+
+          double v = static_cast<double>(mantissa);
+          if (exponent < 0)
+            v /= powers[-exponent];
+          else
+            v *= powers[exponent];
+
+          result = negative ? -v : v;
+          return true;
+        }
+
+        // Parse a boolean.
+        bool
+        parse_number(const std::string& value,
+                     bool&              result)
+        {
+          if (value == "true" || value == "yes" || value == "1")
+            result = true;
+          else if (value == "false" || value == "no" || value == "0")
+            result = false;
+          else
+            return false;
+          return true;
+        }
+
       }
 
-      ImageJMetadata::ImageJMetadata(const IFD& ifd)
+      ImageJMetadata::ImageJMetadata():
+        description(),
+        map(),
+        counts(),
+        data(),
+        images(1U),
+        slices(1U),
+        frames(1U),
+        channels(1U),
+        unit(),
+        spacing(1.0),
+        finterval(0.0),
+        xorigin(0U),
+        yorigin(0U),
+        mode(),
+        loop(false)
       {
-        ifd.getField(IMAGEJ_META_DATA_BYTE_COUNTS).get(counts);
-        ifd.getField(IMAGEJ_META_DATA).get(data);
+      }
+
+      ImageJMetadata::ImageJMetadata(const IFD& ifd):
+        ImageJMetadata()
+      {
+        // ImageJ only writes these fields for overlays, ROIs and
+        // lookup tables, so they are optional.
+        try
+          {
+            ifd.getField(IMAGEJ_META_DATA_BYTE_COUNTS).get(counts);
+            ifd.getField(IMAGEJ_META_DATA).get(data);
+          }
+        catch (const Exception&)
+          {
+            counts.clear();
+            data.clear();
+          }
         std::string desc;
         ifd.getField(IMAGEDESCRIPTION).get(desc);
-        map = parse_imagedescription(desc);
-
-        parse_value("images", images);
-        parse_value("channels", channels);
-        parse_value("slices", slices);
-        parse_value("frames", frames);
-        parse_value("unit", unit);
-        parse_value("spacing", spacing);
-        parse_value("finterval", finterval);
-        parse_value("xorigin", xorigin);
-        parse_value("yorigin", yorigin);
-        parse_value("mode", mode);
-        parse_value("loop", loop);
+        parse(desc);
+      }
+
+      void
+      ImageJMetadata::parse(const std::string& description)
+      {
+        this->description = description;
+        map.clear();
+
+        split_description
+          (description,
+           [&](std::string::size_type keystart,
+               std::string::size_type keyend,
+               std::string::size_type valuestart,
+               std::string::size_type valueend)
+           {
+             std::pair<std::map<std::string,std::string>::iterator, bool> result =
+               map.emplace(description.substr(keystart, keyend - keystart),
+                           description.substr(valuestart, valueend - valuestart));
+             // Use the first value of repeated keys.
+             if (result.second)
+               parse_value(result.first->first, result.first->second);
+           });
       }
 
       std::map<std::string,std::string>
@@ -88,47 +310,16 @@ namespace ome
       {
         std::map<std::string,std::string> ret;
 
-        std::string::size_type start = 0;
-        std::string::size_type end = 0;
-        std::string::size_type sep = 0;
-
-        const std::string::size_type size = description.size();
-
-        while (start != std::string::npos && start < size)
-          {
-            std::string::size_type next = start;
-            if (start)
-              ++next; // skip last found newline
-            if (next < size)
-              {
-                end = description.find_first_of('\n', next);
-                sep = description.find_first_of('=', next);
-
-                if (sep != std::string::npos &&
-                    (end == std::string::npos || sep < end))
-                  {
-                    std::string key(description.substr(start, sep - start));
-                    std::string value;
-                    ++sep;
-
-                    if (sep < size)
-                      {
-                        if (end != std::string::npos)
-                          value = description.substr(sep, end - sep);
-                        else
-                          value = description.substr(sep);
-                      }
-
-                    ret.insert(std::make_pair(key, value));
-                  }
-              }
-            else
-              end = sep = std::string::npos;
-
-            start = end;
-            if (start != std::string::npos)
-              ++start;
-          }
+        split_description
+          (description,
+           [&](std::string::size_type keystart,
+               std::string::size_type keyend,
+               std::string::size_type valuestart,
+               std::string::size_type valueend)
+           {
+             ret.emplace(description.substr(keystart, keyend - keystart),
+                         description.substr(valuestart, valueend - valuestart));
+           });
 
         return ret;
       }
@@ -144,27 +335,35 @@ namespace ome
 
       void
       ImageJMetadata::parse_value(const std::string& key,
-                                  bool&              value)
+                                  const std::string& value)
       {
-        std::map<std::string,std::string>::const_iterator i = map.find(key);
-        if (i != map.end())
-          {
-            if (i->second == "true" || i->second == "yes" || i->second == "1")
-              value = true;
-            else if (i->second == "false" || i->second == "no" || i->second == "0")
-              value = false;
-            else
-              parse_value_error(key, i->second);
-          }
-      }
+        bool valid = true;
 
-      void
-      ImageJMetadata::parse_value(const std::string& key,
-                                  std::string&       value)
-      {
-        std::map<std::string,std::string>::const_iterator i = map.find(key);
-        if (i != map.end())
-          value = i->second;
+        if (key == "images")
+          valid = parse_number(value, images);
+        else if (key == "channels")
+          valid = parse_number(value, channels);
+        else if (key == "slices")
+          valid = parse_number(value, slices);
+        else if (key == "frames")
+          valid = parse_number(value, frames);
+        else if (key == "unit")
+          unit = value;
+        else if (key == "spacing")
+          valid = parse_number(value, spacing);
+        else if (key == "finterval")
+          valid = parse_number(value, finterval);
+        else if (key == "xorigin")
+          valid = parse_number(value, xorigin);
+        else if (key == "yorigin")
+          valid = parse_number(value, yorigin);
+        else if (key == "mode")
+          mode = value;
+        else if (key == "loop")
+          valid = parse_number(value, loop);
+
+        if (!valid)
+          parse_value_error(key, value);
       }
 
     }
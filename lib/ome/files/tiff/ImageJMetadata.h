@@ -39,9 +39,8 @@
 #define OME_FILES_TIFF_IMAGEJMETADATA_H
 
 #include <map>
-#include <vector>
-#include <sstream>
 #include <string>
+#include <vector>
 
 #include <ome/files/Types.h>
 
@@ -59,6 +58,8 @@ namespace ome
        */
       struct ImageJMetadata
       {
+        /// Content of ImageDescription field.
+        std::string description;
         /// Map of key-value pairs from ImageDescription field.
         std::map<std::string, std::string> map;
         /// Content of ImageJMetaDataByteCounts field.
@@ -88,6 +89,14 @@ namespace ome
         /// Loop animation(?).
         bool loop;
 
+        /**
+         * Default constructor.
+         *
+         * The fields are set to the ImageJ defaults for a single
+         * image.
+         */
+        ImageJMetadata();
+
         /**
          * Construct from an IFD.
          *
@@ -96,6 +105,21 @@ namespace ome
          */
         ImageJMetadata(const IFD& ifd);
 
+        /**
+         * Parse the TIFF ImageDescription field content.
+         *
+         * The description is split into key-value pairs as for
+         * parse_imagedescription(), and stored in @c description and
+         * @c map.  The values of the known keys are converted and
+         * stored directly in the corresponding fields in the same
+         * pass.  If a key is repeated, the first value is used.
+         *
+         * @param description the TIFF ImageDescription field content.
+         * @throws std::runtime_error on parse errors.
+         */
+        void
+        parse(const std::string& description);
+
         /**
          * Parse the TIFF ImageDescription field content.
          *
@@ -123,65 +147,19 @@ namespace ome
                           const std::string& value);
 
         /**
-         * Parse a key's value into a given type.
-         *
-         * The string value of the given key will be parsed into the
-         * corresponding value type.
-         *
-         * @param key the key name.
-         * @param value the value to store the key's parsed string value.
-         * @throws std::runtime_error on parse errors.
-         */
-        template<typename T>
-        void
-        parse_value(const std::string& key,
-                    T&                 value)
-        {
-          std::map<std::string,std::string>::const_iterator i = map.find(key);
-          if (i != map.end())
-            {
-              try
-                {
-                  std::istringstream is(i->second);
-                  is.imbue(std::locale::classic());
-                  is.exceptions(std::ios::failbit);
-                  is >> value;
-                }
-              catch (const std::ios_base::failure&)
-                {
-                  parse_value_error(key, i->second);
-                }
-            }
-        }
-
-        /**
-         * Parse a key's value into a bool.
+         * Parse a known key's value.
          *
-         * The string value of the given key will be parsed into a
-         * bool type.
+         * The string value of the given key will be converted and
+         * stored in the corresponding field.  Unknown keys are
+         * ignored.
          *
          * @param key the key name.
-         * @param value the value to store the key's parsed string value.
+         * @param value the key's string value.
          * @throws std::runtime_error on parse errors.
          */
         void
         parse_value(const std::string& key,
-                    bool&              value);
-
-        /**
-         * Parse a key's value into a string.
-         *
-         * The string value of the given key will be parsed into a
-         * string type.
-         *
-         * @param key the key name.
-         * @param value the value to store the key's parsed string value.
-         * @throws std::runtime_error on parse errors.
-         */
-        void
-        parse_value(const std::string& key,
-                    std::string&       value);
-
+                    const std::string& value);
       };
 
     }
@@ -44,8 +44,10 @@
 #endif
 #include <cstdlib>
 
+#include <ome/files/detail/IOStatistics.h>
 #include <ome/files/tiff/Sentry.h>
 #include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/TIFF.h>
 
 #include <tiffio.h>
 
@@ -60,33 +62,22 @@ namespace ome
       {
 
         /// Saved libtiff global error handler.
-        TIFFErrorHandler oldErrorHandler;
-
-        /// Sentry currently holding the tiff_lock mutex.
-        Sentry *currentSentry = 0;
-
-        /**
-         * Set the libtiff error handler.
-         *
-         * @param sentry the current Sentry.
-         * @param handler the handler function to set.
-         * @returns the old handler to allow later restoration.
-         */
-        TIFFErrorHandler
-        setHandler(Sentry           *sentry,
-                   TIFFErrorHandler  handler)
-        {
-          if (sentry)
-            currentSentry = sentry;
-          TIFFErrorHandler old = TIFFSetErrorHandler(handler);
-          if (!sentry)
-            currentSentry = sentry;
-          return old;
-        }
+        TIFFErrorHandler oldErrorHandler = 0;
+
+        /// Guard for one-time installation of the error handler.
+        std::once_flag handlerInstalled;
+
+        /// Sentry currently active in this thread.
+        thread_local Sentry *currentSentry = 0;
 
       }
 
-      std::recursive_mutex Sentry::tiff_mutex;
+      void
+      Sentry::installHandler()
+      {
+        std::call_once(handlerInstalled,
+                       [](){ oldErrorHandler = TIFFSetErrorHandler(&Sentry::errorHandler); });
+      }
 
       // Visual Studio 12 and earlier don't have va_copy.
 #if _MSC_VER &&_MSC_VER < 1800
@@ -138,6 +129,11 @@ namespace ome
 
             if (currentSentry)
               currentSentry->setMessage(message);
+            else if (oldErrorHandler)
+              {
+                va_copy(ap2, ap);
+                oldErrorHandler(module, fmt, ap2);
+              }
           }
         catch (...)
           {
@@ -151,15 +147,66 @@ namespace ome
 #endif
 
       Sentry::Sentry():
-        lock(tiff_mutex),
-        message()
+        lock(),
+        message(),
+        previous(currentSentry),
+        iostats(),
+        site(IOStatistics::LOCK_OTHER),
+        wait(),
+        acquired()
       {
-        oldErrorHandler = setHandler(this, &Sentry::errorHandler);
+        installHandler();
+        currentSentry = this;
+      }
+
+      Sentry::Sentry(const TIFF&            tiff,
+                     IOStatistics::LockSite site):
+        lock(tiff.getMutex(), std::try_to_lock),
+        message(),
+        previous(currentSentry),
+        iostats(),
+        site(site),
+        wait(),
+        acquired()
+      {
+#ifdef OME_FILES_IO_STATISTICS
+        iostats = tiff.getIOStatistics().get();
+
+        // Nested locks are accounted to the outermost Sentry.
+        for (const Sentry *s = previous; iostats && s; s = s->previous)
+          if (s->lock.mutex() == lock.mutex())
+            iostats = nullptr;
+#endif // OME_FILES_IO_STATISTICS
+
+        // Only time the wait if the lock is held by another thread.
+        if (!lock.owns_lock())
+          {
+            OME_FILES_IO_TIME(timer, tiff.getIOStatistics().get(), LOCK_WAIT);
+            std::chrono::steady_clock::time_point start;
+            if (iostats)
+              start = std::chrono::steady_clock::now();
+            lock.lock();
+            if (iostats)
+              {
+                acquired = std::chrono::steady_clock::now();
+                wait = acquired - start;
+              }
+          }
+        else if (iostats)
+          acquired = std::chrono::steady_clock::now();
+
+        installHandler();
+        currentSentry = this;
       }
 
       Sentry::~Sentry()
       {
-        setHandler(0, oldErrorHandler);
+        currentSentry = previous;
+
+        // Recorded before the lock is released, so that updates for
+        // a single file are serialised by its lock.
+        if (iostats)
+          iostats->recordLock(site, wait, std::chrono::steady_clock::now() - acquired);
       }
 
       void
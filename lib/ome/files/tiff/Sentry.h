@@ -38,12 +38,14 @@
 #ifndef OME_FILES_TIFF_SENTRY_H
 #define OME_FILES_TIFF_SENTRY_H
 
+#include <chrono>
 #include <cstdarg>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
 
+#include <ome/files/IOStatistics.h>
 
 namespace ome
 {
@@ -52,19 +54,32 @@ namespace ome
     namespace tiff
     {
 
+      class TIFF;
+
       /**
-       * Sentry for saving and restoring libtiff state.
+       * Sentry for serialising libtiff access and capturing errors.
        *
-       * This acts primarily to save the state of the global error and
-       * warning handlers, which are configured to work with the
-       * currently active TIFF/IFD.  The original state is restored
-       * when destroyed.  Note that this exclusively locks all TIFF
-       * and IFD methods calling into libtiff, so will potentially
-       * block other threads.
+       * When constructed with a TIFF, this exclusively locks the
+       * mutex belonging to that TIFF, so that all TIFF and IFD
+       * methods calling into libtiff for the same file are
+       * serialised.  Other files are not affected, so separate files
+       * may be used concurrently by separate threads.  The lock is
+       * recursive, allowing nested use within the same thread.
        *
        * This class also hooks into the global libtiff error handling
        * to capture any errors which occur.  The latest error will be
-       * available using getMessage().
+       * available using getMessage().  Errors are captured by the
+       * innermost Sentry of the calling thread; the active Sentry is
+       * tracked in thread-local storage, and the previously active
+       * Sentry is restored when destroyed.  If no Sentry is active in
+       * the calling thread, errors are passed to the original libtiff
+       * error handler.
+       *
+       * When the library is built with the @c io-statistics option,
+       * the time spent waiting for and holding the lock is recorded
+       * in the IOStatistics of the TIFF, categorised by call site.
+       * Only the outermost lock of a thread is recorded, so that
+       * nested use is not counted twice.
        *
        * This class should be used at block scope so that instances
        * will only exist transiently until the block ends.
@@ -72,9 +87,29 @@ namespace ome
       class Sentry
       {
       public:
-        /// Constructor.
+        /**
+         * Constructor.
+         *
+         * Errors will be captured, but no lock will be held.  This is
+         * suitable only for libtiff calls which do not use a TIFF
+         * handle shared with other threads, for example when opening
+         * a file.
+         */
         Sentry();
 
+        /**
+         * Constructor.
+         *
+         * Errors will be captured, and the lock for the specified
+         * TIFF will be held until destroyed.
+         *
+         * @param tiff the TIFF to lock.
+         * @param site the call site category, for lock statistics.
+         */
+        explicit
+        Sentry(const TIFF&            tiff,
+               IOStatistics::LockSite site = IOStatistics::LOCK_OTHER);
+
         /// Destructor.
         ~Sentry();
 
@@ -125,21 +160,37 @@ namespace ome
         error() const;
 
       private:
-        /// Mutex to lock libtiff access.
-        static std::recursive_mutex tiff_mutex;
-
-        /// Acquired lock on tiff_lock.
-        std::lock_guard<std::recursive_mutex> lock;
+        /// Acquired lock on the TIFF mutex (if any).
+        std::unique_lock<std::recursive_mutex> lock;
 
         /// Last error message.
         std::string message;
 
+        /// Sentry active in this thread prior to construction.
+        Sentry *previous;
+
+        /// Statistics to record lock use in (null if not recorded).
+        IOStatistics *iostats;
+
+        /// Lock call site category.
+        IOStatistics::LockSite site;
+
+        /// Time spent waiting to acquire the lock.
+        std::chrono::nanoseconds wait;
+
+        /// Time the lock was acquired.
+        std::chrono::steady_clock::time_point acquired;
+
+        /// Install errorHandler() as the libtiff error handler.
+        static void
+        installHandler();
+
         /**
          * libtiff error handler.
          *
          * The error message received will be converted to a string
-         * and saved in the current Sentry for later retrieval with
-         * getMessage().
+         * and saved in the current Sentry of the calling thread for
+         * later retrieval with getMessage().
          *
          * @param module the module or file emitting the error.
          * @param fmt the format string for the error.
@@ -0,0 +1,499 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#ifndef _MSC_VER
+#  include <fcntl.h>
+#  include <sys/file.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <ome/common/filesystem.h>
+
+#include <ome/files/TileBufferPool.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/SharedTileCache.h>
+
+namespace
+{
+
+  /// Magic number at the start of the cache file.
+  const char magic[8] = {'O', 'M', 'E', 'T', 'I', 'L', 'E', '1'};
+
+  /// Byte order mark.
+  const uint32_t byteorder = 0x01020304U;
+
+  /// Alignment of the header, slots and tile data (bytes).
+  const uint64_t alignment = 64U;
+
+  uint64_t
+  align(uint64_t size)
+  {
+    return (size + alignment - 1U) & ~(alignment - 1U);
+  }
+
+  // Mix the bits of a 64-bit value (SplitMix64 finaliser).
+  uint64_t
+  mix(uint64_t value)
+  {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ULL;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBULL;
+    value ^= value >> 31;
+    return value;
+  }
+
+#ifndef _MSC_VER
+
+  void
+  fail(const char                     *what,
+       const boost::filesystem::path& path,
+       int                             error)
+  {
+    boost::format fmt("Failed to %1% shared tile cache %2%: %3%");
+    fmt % what % path.string() % std::strerror(error);
+    throw ome::files::tiff::Exception(fmt.str());
+  }
+
+#endif // ! _MSC_VER
+
+}
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      /**
+       * Cache file header.
+       *
+       * The atomic members are placed in the shared mapping, which
+       * requires them to be lock-free and of the same size as the
+       * underlying type.
+       */
+      struct SharedTileCache::Header
+      {
+        /// Magic number.
+        char magic[8];
+        /// Byte order mark.
+        uint32_t byteorder;
+        /// Size of this header (bytes).
+        uint32_t headersize;
+        /// Number of slots.
+        uint64_t slots;
+        /// Maximum tile size (bytes).
+        uint64_t slotsize;
+        /// Use counter, for least recently used replacement.
+        std::atomic<uint64_t> clock;
+      };
+
+      /**
+       * Tile slot.
+       *
+       * The tile data follow the slot, aligned to 64 bytes.  The
+       * key is atomic so that it may be compared while the slot is
+       * being written; the comparison is only trusted if the
+       * sequence number is unchanged afterward.
+       */
+      struct SharedTileCache::Slot
+      {
+        /// Sequence number (odd while being written).
+        std::atomic<uint64_t> sequence;
+        /// Last use (from Header::clock).
+        std::atomic<uint64_t> used;
+        /// File identity (zero if empty).
+        std::atomic<uint64_t> file;
+        /// IFD offset.
+        std::atomic<uint64_t> offset;
+        /// Tile index.
+        std::atomic<uint64_t> tile;
+        /// Tile size (bytes).
+        std::atomic<uint64_t> size;
+
+        /**
+         * Get the tile data.
+         *
+         * @returns a pointer to the tile data.
+         */
+        uint8_t *
+        data()
+        {
+          return reinterpret_cast<uint8_t *>(this) + align(sizeof(Slot));
+        }
+      };
+
+      const dimension_size_type SharedTileCache::ways;
+
+#ifdef _MSC_VER
+
+      SharedTileCache::SharedTileCache(const boost::filesystem::path& path,
+                                       dimension_size_type            /* slots */,
+                                       dimension_size_type            /* slotsize */):
+        path(path),
+        mapping(nullptr),
+        length(0U),
+        header(nullptr),
+        slots(0U),
+        slotsize(0U),
+        stride(0U),
+        hitcount(0U),
+        misscount(0U)
+      {
+        throw Exception("Shared tile caches are not supported on this platform");
+      }
+
+      SharedTileCache::~SharedTileCache()
+      {
+      }
+
+#else // ! _MSC_VER
+
+      SharedTileCache::SharedTileCache(const boost::filesystem::path& path,
+                                       dimension_size_type            slots,
+                                       dimension_size_type            slotsize):
+        path(path),
+        mapping(nullptr),
+        length(0U),
+        header(nullptr),
+        slots(((slots ? slots : 1U) + ways - 1U) / ways * ways),
+        slotsize(align(slotsize)),
+        stride(0U),
+        hitcount(0U),
+        misscount(0U)
+      {
+        static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+                      "Shared atomic size must match the underlying type");
+        static_assert(sizeof(Header) <= alignment, "Header exceeds alignment");
+
+        std::atomic<uint64_t> probe(0U);
+        if (!probe.is_lock_free())
+          throw Exception("Shared tile caches require lock-free 64-bit atomics");
+
+        int fd = ::open(path.string().c_str(), O_RDWR | O_CREAT, 0666);
+        if (fd < 0)
+          fail("open", path, errno);
+
+        // Serialise creation of the file with other processes.
+        if (::flock(fd, LOCK_EX) < 0)
+          {
+            int error = errno;
+            ::close(fd);
+            fail("lock", path, error);
+          }
+
+        try
+          {
+            struct stat st;
+            if (::fstat(fd, &st) < 0)
+              fail("examine", path, errno);
+
+            const bool created = st.st_size == 0;
+            if (!created)
+              {
+                Header existing;
+                if (::pread(fd, &existing, sizeof(Header), 0) != static_cast<ssize_t>(sizeof(Header)) ||
+                    std::memcmp(existing.magic, magic, sizeof(magic)) != 0 ||
+                    existing.byteorder != byteorder ||
+                    existing.headersize != sizeof(Header) ||
+                    existing.slots == 0U ||
+                    existing.slots % ways != 0U ||
+                    existing.slotsize != align(existing.slotsize))
+                  throw Exception(std::string("Invalid shared tile cache ") + path.string());
+                this->slots = existing.slots;
+                this->slotsize = existing.slotsize;
+              }
+
+            stride = align(sizeof(Slot)) + this->slotsize;
+            const uint64_t total = alignment + this->slots * stride;
+            length = static_cast<std::size_t>(total);
+
+            if (created)
+              {
+                if (::ftruncate(fd, static_cast<off_t>(total)) < 0)
+                  fail("resize", path, errno);
+              }
+            else if (static_cast<uint64_t>(st.st_size) < total)
+              throw Exception(std::string("Truncated shared tile cache ") + path.string());
+
+            mapping = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mapping == MAP_FAILED)
+              {
+                mapping = nullptr;
+                fail("map", path, errno);
+              }
+            header = static_cast<Header *>(mapping);
+
+            // The new file is zero-filled, so all slots are empty.
+            if (created)
+              {
+                header->byteorder = byteorder;
+                header->headersize = sizeof(Header);
+                header->slots = this->slots;
+                header->slotsize = this->slotsize;
+                std::atomic_thread_fence(std::memory_order_release);
+                std::memcpy(header->magic, magic, sizeof(magic));
+              }
+          }
+        catch (...)
+          {
+            if (mapping)
+              ::munmap(mapping, length);
+            ::flock(fd, LOCK_UN);
+            ::close(fd);
+            throw;
+          }
+
+        ::flock(fd, LOCK_UN);
+        ::close(fd);
+      }
+
+      SharedTileCache::~SharedTileCache()
+      {
+        if (mapping)
+          ::munmap(mapping, length);
+      }
+
+#endif // _MSC_VER
+
+      SharedTileCache::value_type
+      SharedTileCache::find(const key_type& key)
+      {
+        if (key.file)
+          {
+            const dimension_size_type first = set(key);
+            for (dimension_size_type w = 0; w < ways; ++w)
+              {
+                Slot& s(slot(first + w));
+
+                const uint64_t sequence = s.sequence.load(std::memory_order_acquire);
+                if (sequence & 1U ||
+                    s.file.load(std::memory_order_relaxed) != key.file ||
+                    s.offset.load(std::memory_order_relaxed) != key.offset ||
+                    s.tile.load(std::memory_order_relaxed) != key.tile)
+                  continue;
+
+                const uint64_t size = s.size.load(std::memory_order_relaxed);
+                if (size > slotsize)
+                  continue;
+
+                std::shared_ptr<TileBuffer> tilebuffer(TileBufferPool::global()->acquire(size, false));
+                std::memcpy(tilebuffer->data(), s.data(), static_cast<std::size_t>(size));
+
+                // Discard the copy if the slot was rewritten meanwhile.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.sequence.load(std::memory_order_relaxed) != sequence)
+                  continue;
+
+                s.used.store(header->clock.fetch_add(1U, std::memory_order_relaxed) + 1U,
+                             std::memory_order_relaxed);
+                ++hitcount;
+                return tilebuffer;
+              }
+          }
+
+        ++misscount;
+        return value_type();
+      }
+
+      bool
+      SharedTileCache::insert(const key_type&   key,
+                              const TileBuffer& tilebuffer)
+      {
+        if (!key.file || tilebuffer.size() > slotsize)
+          return false;
+
+        // Replace the same key, else an empty slot, else the least
+        // recently used slot in the set.
+        const dimension_size_type first = set(key);
+        Slot *victim = nullptr;
+        uint64_t oldest = 0U;
+        for (dimension_size_type w = 0; w < ways; ++w)
+          {
+            Slot& s(slot(first + w));
+            const uint64_t file = s.file.load(std::memory_order_relaxed);
+            if (file == key.file &&
+                s.offset.load(std::memory_order_relaxed) == key.offset &&
+                s.tile.load(std::memory_order_relaxed) == key.tile)
+              {
+                victim = &s;
+                break;
+              }
+            const uint64_t used = file ? s.used.load(std::memory_order_relaxed) : 0U;
+            if (!victim || used < oldest)
+              {
+                victim = &s;
+                oldest = used;
+              }
+          }
+
+        uint64_t sequence = victim->sequence.load(std::memory_order_relaxed);
+        if (sequence & 1U ||
+            !victim->sequence.compare_exchange_strong(sequence, sequence + 1U,
+                                                      std::memory_order_acquire,
+                                                      std::memory_order_relaxed))
+          return false;
+        std::atomic_thread_fence(std::memory_order_release);
+
+        victim->file.store(key.file, std::memory_order_relaxed);
+        victim->offset.store(key.offset, std::memory_order_relaxed);
+        victim->tile.store(key.tile, std::memory_order_relaxed);
+        victim->size.store(tilebuffer.size(), std::memory_order_relaxed);
+        std::memcpy(victim->data(), tilebuffer.data(), static_cast<std::size_t>(tilebuffer.size()));
+        victim->used.store(header->clock.fetch_add(1U, std::memory_order_relaxed) + 1U,
+                           std::memory_order_relaxed);
+
+        victim->sequence.store(sequence + 2U, std::memory_order_release);
+        return true;
+      }
+
+      void
+      SharedTileCache::clear()
+      {
+        for (dimension_size_type i = 0; i < slots; ++i)
+          {
+            Slot& s(slot(i));
+            uint64_t sequence = s.sequence.load(std::memory_order_relaxed);
+            // Slots being written are left to their writer.
+            if (sequence & 1U ||
+                !s.sequence.compare_exchange_strong(sequence, sequence + 1U,
+                                                    std::memory_order_acquire,
+                                                    std::memory_order_relaxed))
+              continue;
+            s.file.store(0U, std::memory_order_relaxed);
+            s.size.store(0U, std::memory_order_relaxed);
+            s.used.store(0U, std::memory_order_relaxed);
+            s.sequence.store(sequence + 2U, std::memory_order_release);
+          }
+      }
+
+      const boost::filesystem::path&
+      SharedTileCache::getPath() const
+      {
+        return path;
+      }
+
+      dimension_size_type
+      SharedTileCache::getSlots() const
+      {
+        return slots;
+      }
+
+      dimension_size_type
+      SharedTileCache::getSlotSize() const
+      {
+        return slotsize;
+      }
+
+      dimension_size_type
+      SharedTileCache::hits() const
+      {
+        return hitcount;
+      }
+
+      dimension_size_type
+      SharedTileCache::misses() const
+      {
+        return misscount;
+      }
+
+      void
+      SharedTileCache::resetStatistics()
+      {
+        hitcount = 0U;
+        misscount = 0U;
+      }
+
+      uint64_t
+      SharedTileCache::fileIdentity(const boost::filesystem::path& path)
+      {
+        boost::system::error_code ec;
+        const boost::uintmax_t size = boost::filesystem::file_size(path, ec);
+        if (ec)
+          return 0U;
+        const std::time_t mtime = boost::filesystem::last_write_time(path, ec);
+        if (ec)
+          return 0U;
+
+        std::string name;
+        try
+          {
+            name = ome::common::canonical(path).string();
+          }
+        catch (const std::exception&)
+          {
+            return 0U;
+          }
+
+        // FNV-1a, which unlike std::hash is the same in every build.
+        uint64_t identity = 0xCBF29CE484222325ULL;
+        for (const auto c : name)
+          {
+            identity ^= static_cast<uint8_t>(c);
+            identity *= 0x100000001B3ULL;
+          }
+        identity = mix(identity ^ mix(static_cast<uint64_t>(size)) ^
+                       mix(static_cast<uint64_t>(mtime) + 0x9E3779B97F4A7C15ULL));
+        return identity ? identity : 1U;
+      }
+
+      SharedTileCache::Slot&
+      SharedTileCache::slot(dimension_size_type index) const
+      {
+        return *reinterpret_cast<Slot *>(static_cast<uint8_t *>(mapping) + alignment + index * stride);
+      }
+
+      dimension_size_type
+      SharedTileCache::set(const key_type& key) const
+      {
+        const uint64_t hash = mix(key.file ^ mix(key.offset) ^ mix(key.tile + 0x9E3779B97F4A7C15ULL));
+        return (hash % (slots / ways)) * ways;
+      }
+
+    }
+  }
+}
@@ -0,0 +1,285 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TIFF_SHAREDTILECACHE_H
+#define OME_FILES_TIFF_SHAREDTILECACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/TileBuffer.h>
+#include <ome/files/Types.h>
+#include <ome/files/tiff/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      /**
+       * Cache of decoded tiles shared between processes.
+       *
+       * The cache is a memory-mapped file holding a fixed number of
+       * fixed-size tile slots.  Every process mapping the same file
+       * shares the same tiles, so a tile decoded by one reader
+       * process is available to all other processes on the host.
+       * On Linux, placing the file under @c /dev/shm keeps it in
+       * POSIX shared memory.
+       *
+       * Tiles are keyed by file identity (see fileIdentity()), IFD
+       * offset and tile index.  Each key maps to a small set of
+       * slots; when all slots in the set are in use, the least
+       * recently used slot is replaced.  Lookups take no locks: each
+       * slot has a sequence number which is odd while the slot is
+       * being written, and a lookup is discarded if the sequence
+       * number changed while the tile was copied.  Insertion into a
+       * slot being written by another thread or process is skipped.
+       * The file is native-endian and must not be shared between
+       * hosts.
+       *
+       * This cache is normally used as the second level of a
+       * DecodedTileCache (see DecodedTileCache::setSharedCache()).
+       * All methods are thread-safe.
+       */
+      class SharedTileCache
+      {
+      public:
+        /// Cache key.
+        struct key_type
+        {
+          /// The identity of the file the tile belongs to.
+          uint64_t file;
+          /// The offset of the IFD the tile belongs to.
+          offset_type offset;
+          /// The tile index.
+          dimension_size_type tile;
+        };
+
+        /// Tile buffer type.
+        typedef std::shared_ptr<const TileBuffer> value_type;
+
+        /// Number of slots in each set.
+        static const dimension_size_type ways = 4U;
+
+        /**
+         * Constructor.
+         *
+         * Open the cache file, creating it if it does not exist.  If
+         * the file already exists, its slot count and slot size are
+         * used in place of those specified.
+         *
+         * @param path the cache file.
+         * @param slots the number of tile slots.
+         * @param slotsize the maximum size of a cached tile (bytes).
+         * @throws Exception if the file could not be opened or
+         * mapped, is not a tile cache, or if memory-mapped caches
+         * are not supported on this platform.
+         */
+        SharedTileCache(const boost::filesystem::path& path,
+                        dimension_size_type            slots,
+                        dimension_size_type            slotsize);
+
+        /// Destructor.
+        virtual ~SharedTileCache();
+
+        /// @cond SKIP
+        SharedTileCache (const SharedTileCache&) = delete;
+
+        SharedTileCache&
+        operator= (const SharedTileCache&) = delete;
+        /// @endcond SKIP
+
+        /**
+         * Find a tile in the cache.
+         *
+         * The tile is copied out of the cache, so it remains valid if
+         * the slot is later replaced.  The hit or miss counter is
+         * incremented.
+         *
+         * @param key the tile to find.
+         * @returns the tile buffer corresponding to the specified
+         * key.  If the key was not found, this will be null.
+         */
+        value_type
+        find(const key_type& key);
+
+        /**
+         * Insert a tile into the cache.
+         *
+         * The tile replaces any existing tile with the same key, or
+         * else an empty or the least recently used slot in its set.
+         * Tiles larger than the slot size, and tiles with a file
+         * identity of zero, are not cached.
+         *
+         * @param key the key of the tile buffer.
+         * @param tilebuffer the decoded tile pixel data.
+         * @returns @c true if the tile was cached, or @c false if it
+         * was too large or its slot was being written concurrently.
+         */
+        bool
+        insert(const key_type&   key,
+               const TileBuffer& tilebuffer);
+
+        /**
+         * Remove all tiles from the cache.
+         *
+         * Tiles are removed for all processes sharing the cache.
+         * The hit and miss counters are not reset.
+         */
+        void
+        clear();
+
+        /**
+         * Get the cache file.
+         *
+         * @returns the cache file path.
+         */
+        const boost::filesystem::path&
+        getPath() const;
+
+        /**
+         * Get the number of tile slots.
+         *
+         * @returns the slot count.
+         */
+        dimension_size_type
+        getSlots() const;
+
+        /**
+         * Get the maximum size of a cached tile.
+         *
+         * @returns the slot size (bytes).
+         */
+        dimension_size_type
+        getSlotSize() const;
+
+        /**
+         * Get the number of successful lookups by this process.
+         *
+         * @returns the hit count.
+         */
+        dimension_size_type
+        hits() const;
+
+        /**
+         * Get the number of unsuccessful lookups by this process.
+         *
+         * @returns the miss count.
+         */
+        dimension_size_type
+        misses() const;
+
+        /**
+         * Reset the hit and miss counters to zero.
+         */
+        void
+        resetStatistics();
+
+        /**
+         * Get the identity of a file for use in cache keys.
+         *
+         * The identity is derived from the canonical path, size and
+         * modification time of the file, so that it is the same in
+         * every process and changes if the file is replaced or
+         * modified.
+         *
+         * @param path the file.
+         * @returns the file identity, or zero if the file could not
+         * be examined.
+         */
+        static uint64_t
+        fileIdentity(const boost::filesystem::path& path);
+
+      private:
+        struct Header;
+        struct Slot;
+
+        /**
+         * Get a slot.
+         *
+         * @param index the slot index.
+         * @returns the slot.
+         */
+        Slot&
+        slot(dimension_size_type index) const;
+
+        /**
+         * Get the first slot of the set for a key.
+         *
+         * @param key the key.
+         * @returns the slot index.
+         */
+        dimension_size_type
+        set(const key_type& key) const;
+
+        /// Cache file.
+        boost::filesystem::path path;
+        /// Mapped cache file.
+        void *mapping;
+        /// Size of the mapping (bytes).
+        std::size_t length;
+        /// Mapped header.
+        Header *header;
+        /// Number of slots.
+        dimension_size_type slots;
+        /// Maximum tile size (bytes).
+        dimension_size_type slotsize;
+        /// Distance between slots (bytes).
+        dimension_size_type stride;
+        /// Successful lookups.
+        std::atomic<dimension_size_type> hitcount;
+        /// Unsuccessful lookups.
+        std::atomic<dimension_size_type> misscount;
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_TIFF_SHAREDTILECACHE_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,585 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+
+#include <ome/files/Downsample.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/detail/BitPack.h>
+#include <ome/files/detail/Downsample.h>
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/Field.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/Sentry.h>
+#include <ome/files/tiff/SubResolutionWriter.h>
+#include <ome/files/tiff/Tags.h>
+#include <ome/files/tiff/TIFF.h>
+#include <ome/files/tiff/TileInfo.h>
+
+#include <tiffio.h>
+
+using ome::xml::model::enums::PixelType;
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      /**
+       * Internal implementation details of SubResolutionWriter.
+       */
+      class SubResolutionWriter::Impl
+      {
+      public:
+        /// A partially filled sub-resolution tile.
+        struct Pending
+        {
+          /// Tile pixel data.
+          std::shared_ptr<TileBuffer> buffer;
+          /// Number of source tiles still to be downsampled into it.
+          dimension_size_type remaining;
+        };
+
+        /// A sub-resolution.
+        struct Level
+        {
+          /// Image width.
+          uint32_t width;
+          /// Image height.
+          uint32_t height;
+          /// Temporary file.
+          boost::filesystem::path filename;
+          /// Temporary TIFF.
+          std::shared_ptr<TIFF> tiff;
+          /// Temporary TIFF directory.
+          std::shared_ptr<IFD> ifd;
+          /// Tile information.
+          std::shared_ptr<TileInfo> info;
+          /// Partially filled tiles.
+          std::map<dimension_size_type, Pending> pending;
+        };
+
+        /// Full-resolution image width.
+        uint32_t width;
+        /// Full-resolution image height.
+        uint32_t height;
+        /// Tile type.
+        TileType type;
+        /// Tile width.
+        uint32_t tilewidth;
+        /// Tile height (or rows per strip).
+        uint32_t tileheight;
+        /// Pixel type.
+        PixelType pixeltype;
+        /// Bits per sample.
+        uint16_t bits;
+        /// Samples per pixel.
+        uint16_t samples;
+        /// Planar configuration.
+        PlanarConfiguration planarconfig;
+        /// Photometric interpretation.
+        PhotometricInterpretation photometric;
+        /// Compression scheme.
+        Compression compression;
+        /// Codec parameters, including the predictor (if set).
+        CodecParameters codec;
+        /// Downsampling method.
+        Downsampling method;
+        /// Sub-resolutions, largest first.
+        std::vector<Level> levels;
+
+        /**
+         * Constructor.
+         *
+         * @param ifd the full-resolution directory.
+         * @param nlevels the number of sub-resolutions to write.
+         * @param method the downsampling method.
+         * @param dir the directory in which to create temporary files.
+         */
+        Impl(const IFD&                     ifd,
+             dimension_size_type            nlevels,
+             Downsampling                   method,
+             const boost::filesystem::path& dir):
+          width(ifd.getImageWidth()),
+          height(ifd.getImageHeight()),
+          type(ifd.getTileType()),
+          tilewidth(ifd.getTileWidth()),
+          tileheight(ifd.getTileHeight()),
+          pixeltype(ifd.getPixelType()),
+          bits(ifd.getBitsPerSample()),
+          samples(ifd.getSamplesPerPixel()),
+          planarconfig(ifd.getPlanarConfiguration()),
+          photometric(ifd.getPhotometricInterpretation()),
+          compression(ifd.getCompression()),
+          codec(ifd.getCodecParameters()),
+          method(method),
+          levels()
+        {
+          if (!downsamplingSupported(pixeltype, method))
+            {
+              boost::format fmt("Downsampling method not supported for %1% pixel type");
+              fmt % pixeltype;
+              throw Exception(fmt.str());
+            }
+
+          // Source rows must pair up across strip boundaries.
+          if (type == STRIP && tileheight % 2 && tileheight < height)
+            {
+              boost::format fmt("Sub-resolutions require an even number of rows per strip (%1% rows per strip)");
+              fmt % tileheight;
+              throw Exception(fmt.str());
+            }
+
+          std::string mode("w");
+          bool bigendian;
+          {
+            std::shared_ptr<TIFF>& tiff = ifd.getTIFF();
+            ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(tiff->getWrapped());
+
+            Sentry sentry(*tiff, IOStatistics::LOCK_TAG);
+            if (TIFFIsBigTIFF(tiffraw))
+              mode += '8';
+            bigendian = TIFFIsBigEndian(tiffraw) != 0;
+          }
+          // The encoded tiles are copied as they are, so must match
+          // the byte order of the destination.
+          mode += bigendian ? 'b' : 'l';
+
+          uint32_t lwidth = width;
+          uint32_t lheight = height;
+          for (dimension_size_type i = 0; i < nlevels && (lwidth > 1 || lheight > 1); ++i)
+            {
+              lwidth = (lwidth + 1U) / 2U;
+              lheight = (lheight + 1U) / 2U;
+
+              Level level;
+              level.width = lwidth;
+              level.height = lheight;
+              level.filename = boost::filesystem::unique_path(dir / ".ome-files-subresolution-%%%%-%%%%-%%%%-%%%%.tiff");
+              level.tiff = TIFF::open(level.filename, mode);
+              level.ifd = level.tiff->getCurrentDirectory();
+              setup(*level.ifd, lwidth, lheight);
+              level.info = std::make_shared<TileInfo>(level.ifd->getTileInfo());
+              levels.push_back(level);
+            }
+        }
+
+        /// Destructor.
+        ~Impl()
+        {
+          for (auto& level : levels)
+            {
+              try
+                {
+                  if (level.tiff)
+                    level.tiff->close();
+                  boost::filesystem::remove(level.filename);
+                }
+              catch (...)
+                {
+                }
+            }
+        }
+
+        /**
+         * Set up the tags of a sub-resolution directory.
+         *
+         * @param ifd the directory to set up.
+         * @param lwidth the image width.
+         * @param lheight the image height.
+         */
+        void
+        setup(IFD&     ifd,
+              uint32_t lwidth,
+              uint32_t lheight)
+        {
+          ifd.setImageWidth(lwidth);
+          ifd.setImageHeight(lheight);
+          ifd.setTileType(type);
+          ifd.setTileWidth(tilewidth);
+          ifd.setTileHeight(tileheight);
+          ifd.setPixelType(pixeltype);
+          ifd.setBitsPerSample(bits);
+          ifd.setSamplesPerPixel(samples);
+          ifd.setPlanarConfiguration(planarconfig);
+          ifd.setPhotometricInterpretation(photometric);
+          ifd.setCompression(compression);
+          ifd.setCodecParameters(codec);
+        }
+
+        /**
+         * Downsample a pixel block of a source tile.
+         *
+         * @param src the source tile data.
+         * @param rsrcfull the source tile region.
+         * @param rsrc the valid source tile region.
+         * @param dest the destination tile data.
+         * @param rdestfull the destination tile region.
+         * @param rclip the destination region to fill.
+         * @param components the number of components per pixel.
+         */
+        template<typename T>
+        void
+        downsample(const uint8_t       *src,
+                   const PlaneRegion&   rsrcfull,
+                   const PlaneRegion&   rsrc,
+                   uint8_t             *dest,
+                   const PlaneRegion&   rdestfull,
+                   const PlaneRegion&   rclip,
+                   dimension_size_type  components)
+        {
+          const T *srcdata = reinterpret_cast<const T *>(src);
+          T *destdata = reinterpret_cast<T *>(dest);
+          const dimension_size_type sx = rclip.x * 2U;
+          const dimension_size_type srcwidth = std::min<dimension_size_type>(rclip.w * 2U, rsrc.x + rsrc.w - sx);
+
+          for (dimension_size_type y = rclip.y; y < rclip.y + rclip.h; ++y)
+            {
+              const dimension_size_type sy = y * 2U;
+              const dimension_size_type sh = std::min<dimension_size_type>(2U, rsrc.y + rsrc.h - sy);
+
+              ome::files::detail::downsampleRow(srcdata + ((((sy - rsrcfull.y) * rsrcfull.w) + (sx - rsrcfull.x)) * components),
+                                                static_cast<std::ptrdiff_t>(rsrcfull.w * components),
+                                                sh, srcwidth, components, 2U, method,
+                                                destdata + ((((y - rdestfull.y) * rdestfull.w) + (rclip.x - rdestfull.x)) * components));
+            }
+        }
+
+        /**
+         * Downsample a pixel block of a source tile (bit samples).
+         *
+         * The rows are unpacked, downsampled as @c bool values, and
+         * packed again.
+         *
+         * @param src the source tile data.
+         * @param rsrcfull the source tile region.
+         * @param rsrc the valid source tile region.
+         * @param dest the destination tile data.
+         * @param rdestfull the destination tile region.
+         * @param rclip the destination region to fill.
+         * @param components the number of components per pixel.
+         */
+        void
+        downsampleBits(const uint8_t       *src,
+                       const PlaneRegion&   rsrcfull,
+                       const PlaneRegion&   rsrc,
+                       uint8_t             *dest,
+                       const PlaneRegion&   rdestfull,
+                       const PlaneRegion&   rclip,
+                       dimension_size_type  components)
+        {
+          const dimension_size_type srcwidth = std::min<dimension_size_type>(rclip.w * 2U, rsrc.x + rsrc.w - (rclip.x * 2U)) * components;
+          std::unique_ptr<bool[]> rows(new bool[srcwidth * 2U]);
+          std::unique_ptr<bool[]> out(new bool[rclip.w * components]);
+
+          for (dimension_size_type y = rclip.y; y < rclip.y + rclip.h; ++y)
+            {
+              const dimension_size_type sy = y * 2U;
+              const dimension_size_type sh = std::min<dimension_size_type>(2U, rsrc.y + rsrc.h - sy);
+
+              for (dimension_size_type j = 0; j < sh; ++j)
+                ome::files::detail::unpackBits(src,
+                                               ((((sy + j - rsrcfull.y) * rsrcfull.w) + ((rclip.x * 2U) - rsrcfull.x)) * components),
+                                               rows.get() + (j * srcwidth),
+                                               srcwidth);
+
+              ome::files::detail::downsampleRow(rows.get(), static_cast<std::ptrdiff_t>(srcwidth),
+                                                sh, srcwidth / components, components, 2U, method,
+                                                out.get());
+
+              ome::files::detail::packBits(out.get(),
+                                           dest,
+                                           (((y - rdestfull.y) * rdestfull.w) + (rclip.x - rdestfull.x)) * components,
+                                           rclip.w * components);
+            }
+        }
+
+        /**
+         * Downsample a pixel block of a source tile of any pixel type.
+         *
+         * @param src the source tile data.
+         * @param rsrcfull the source tile region.
+         * @param rsrc the valid source tile region.
+         * @param dest the destination tile data.
+         * @param rdestfull the destination tile region.
+         * @param rclip the destination region to fill.
+         */
+        void
+        downsample(const uint8_t       *src,
+                   const PlaneRegion&   rsrcfull,
+                   const PlaneRegion&   rsrc,
+                   uint8_t             *dest,
+                   const PlaneRegion&   rdestfull,
+                   const PlaneRegion&   rclip)
+        {
+          dimension_size_type components = planarconfig == CONTIG ? samples : 1U;
+
+          switch(pixeltype)
+            {
+            case PixelType::BIT:
+              downsampleBits(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            case PixelType::INT8:
+              downsample<int8_t>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            case PixelType::INT16:
+              downsample<int16_t>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            case PixelType::INT32:
+              downsample<int32_t>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            case PixelType::UINT8:
+              downsample<uint8_t>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            case PixelType::UINT16:
+              downsample<uint16_t>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            case PixelType::UINT32:
+              downsample<uint32_t>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            case PixelType::FLOAT:
+              downsample<float>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            case PixelType::DOUBLE:
+              downsample<double>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components);
+              break;
+            // Real and imaginary parts are downsampled separately.
+            case PixelType::COMPLEXFLOAT:
+              downsample<float>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components * 2U);
+              break;
+            case PixelType::COMPLEXDOUBLE:
+              downsample<double>(src, rsrcfull, rsrc, dest, rdestfull, rclip, components * 2U);
+              break;
+            default:
+              {
+                boost::format fmt("Invalid %1% pixel type for sub-resolution downsampling");
+                fmt % pixeltype;
+                throw Exception(fmt.str());
+              }
+            }
+        }
+
+        /**
+         * Downsample a completed tile into a sub-resolution.
+         *
+         * @param level the sub-resolution to downsample into.
+         * @param srcinfo the source tile information.
+         * @param srcimage the source image region.
+         * @param tile the source tile index.
+         * @param src the source tile data.
+         */
+        void
+        add(dimension_size_type  level,
+            const TileInfo&      srcinfo,
+            const PlaneRegion&   srcimage,
+            dimension_size_type  tile,
+            const uint8_t       *src)
+        {
+          if (level >= levels.size())
+            return;
+
+          Level& dest(levels[level]);
+          const PlaneRegion rsrcfull(srcinfo.tileRegion(tile));
+          const PlaneRegion rsrc(rsrcfull & srcimage);
+          const dimension_size_type sample = srcinfo.tileSample(tile);
+
+          if (!rsrc.area())
+            return;
+
+          // Source tiles start on even rows and columns, other than
+          // at the image edge.
+          const PlaneRegion rdown(rsrc.x / 2U, rsrc.y / 2U,
+                                  ((rsrc.x + rsrc.w + 1U) / 2U) - (rsrc.x / 2U),
+                                  ((rsrc.y + rsrc.h + 1U) / 2U) - (rsrc.y / 2U));
+          const PlaneRegion destimage(0, 0, dest.width, dest.height);
+
+          for (const auto t : dest.info->tileRange(rdown))
+            {
+              if (dest.info->tileSample(t) != sample)
+                continue;
+
+              const PlaneRegion rdestfull(dest.info->tileRegion(t));
+              const PlaneRegion rclip(rdestfull & rdown);
+              if (!rclip.area())
+                continue;
+
+              auto pending = dest.pending.find(t);
+              if (pending == dest.pending.end())
+                {
+                  // Count the source tiles covering the destination tile.
+                  const PlaneRegion rvalid(rdestfull & destimage);
+                  const PlaneRegion rup(PlaneRegion(rvalid.x * 2U, rvalid.y * 2U, rvalid.w * 2U, rvalid.h * 2U) & srcimage);
+                  dimension_size_type count = 0;
+                  for (const auto s : srcinfo.tileRange(rup))
+                    if (srcinfo.tileSample(s) == sample)
+                      ++count;
+
+                  Pending p;
+                  p.buffer = std::make_shared<TileBuffer>(dest.info->bufferSize());
+                  p.remaining = count;
+                  pending = dest.pending.insert(std::make_pair(t, p)).first;
+                }
+
+              downsample(src, rsrcfull, rsrc, pending->second.buffer->data(), rdestfull, rclip);
+
+              if (--pending->second.remaining == 0)
+                complete(level, t);
+            }
+        }
+
+        /**
+         * Write a sub-resolution tile, and downsample it into the
+         * next sub-resolution.
+         *
+         * @param level the sub-resolution of the tile.
+         * @param tile the tile index.
+         */
+        void
+        complete(dimension_size_type level,
+                 dimension_size_type tile)
+        {
+          Level& current(levels[level]);
+          auto pending = current.pending.find(tile);
+          std::shared_ptr<TileBuffer> buffer(pending->second.buffer);
+          current.pending.erase(pending);
+
+          // Downsample first, since encoding may modify the buffer.
+          add(level + 1, *current.info, PlaneRegion(0, 0, current.width, current.height),
+              tile, buffer->data());
+
+          ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(current.tiff->getWrapped());
+          Sentry sentry(*current.tiff, IOStatistics::LOCK_ENCODE);
+
+          tstrile_t rtile = static_cast<tstrile_t>(tile);
+          tsize_t size = static_cast<tsize_t>(buffer->size());
+          if (type == TILE)
+            {
+              tsize_t byteswritten = TIFFWriteEncodedTile(tiffraw, rtile, buffer->data(), size);
+              if (byteswritten < 0)
+                sentry.error("Failed to write encoded sub-resolution tile");
+            }
+          else
+            {
+              tsize_t byteswritten = TIFFWriteEncodedStrip(tiffraw, rtile, buffer->data(), size);
+              if (byteswritten < 0)
+                sentry.error("Failed to write encoded sub-resolution strip");
+            }
+        }
+      };
+
+      SubResolutionWriter::SubResolutionWriter(const IFD&                     ifd,
+                                               dimension_size_type            levels,
+                                               Downsampling                   method,
+                                               const boost::filesystem::path& dir):
+        impl(std::make_shared<Impl>(ifd, levels, method, dir))
+      {
+      }
+
+      SubResolutionWriter::~SubResolutionWriter()
+      {
+      }
+
+      dimension_size_type
+      SubResolutionWriter::getLevels() const
+      {
+        return impl->levels.size();
+      }
+
+      void
+      SubResolutionWriter::addTile(const TileInfo&     info,
+                                   dimension_size_type tile,
+                                   const TileBuffer&   buffer)
+      {
+        impl->add(0, info, PlaneRegion(0, 0, impl->width, impl->height), tile, buffer.data());
+      }
+
+      void
+      SubResolutionWriter::write(TIFF& tiff)
+      {
+        std::vector<uint8_t> raw;
+
+        for (dimension_size_type i = 0; i < impl->levels.size(); ++i)
+          {
+            Impl::Level& level(impl->levels[i]);
+
+            // Write any incomplete tiles, in order.
+            while (!level.pending.empty())
+              impl->complete(i, level.pending.begin()->first);
+
+            level.tiff->writeCurrentDirectory();
+            level.tiff->close();
+            level.ifd.reset();
+
+            // Copy the encoded tiles into a SubIFD.
+            std::shared_ptr<TIFF> src(TIFF::open(level.filename, "r"));
+            std::shared_ptr<IFD> srcifd(src->getDirectoryByIndex(0));
+            std::shared_ptr<IFD> destifd(tiff.getCurrentDirectory());
+
+            impl->setup(*destifd, level.width, level.height);
+            destifd->getField(SUBFILETYPE).set(static_cast<uint32_t>(FILETYPE_REDUCEDIMAGE));
+
+            for (dimension_size_type tile = 0; tile < level.info->tileCount(); ++tile)
+              {
+                srcifd->readRawTile(tile, raw);
+                if (!raw.empty())
+                  destifd->writeRawTile(tile, raw.data(), raw.size());
+              }
+
+            tiff.writeCurrentDirectory();
+
+            src->close();
+            level.tiff.reset();
+            boost::filesystem::remove(level.filename);
+          }
+      }
+
+    }
+  }
+}
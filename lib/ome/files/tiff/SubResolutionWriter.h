@@ -0,0 +1,164 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef OME_FILES_TIFF_SUBRESOLUTIONWRITER_H
+#define OME_FILES_TIFF_SUBRESOLUTIONWRITER_H
+
+#include <memory>
+
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/TileBuffer.h>
+#include <ome/files/Types.h>
+#include <ome/files/tiff/Types.h>
+
+namespace ome
+{
+  namespace files
+  {
+    namespace tiff
+    {
+
+      class IFD;
+      class TIFF;
+      class TileInfo;
+
+      /**
+       * Writer of downsampled sub-resolutions for a TIFF directory.
+       *
+       * Each full-resolution tile is downsampled by a factor of two
+       * into the first sub-resolution as it is written, and each
+       * completed sub-resolution tile is in turn downsampled into
+       * the next.  Only partially filled sub-resolution tiles are
+       * held in memory, so when the full-resolution tiles are
+       * written in order, no more than a row of tiles is held for
+       * each level.  Completed tiles are encoded into a temporary
+       * TIFF file for each level.
+       *
+       * Once the full-resolution directory has been written, the
+       * encoded tiles are copied into SubIFDs of the directory,
+       * and the temporary files are removed.
+       *
+       * All sub-resolutions use the same tile or strip size,
+       * compression and sample layout as the full-resolution
+       * image.  Strips must contain an even number of rows.  The
+       * pixels are downsampled with the same kernels as
+       * ome::files::downsample().
+       */
+      class SubResolutionWriter
+      {
+      private:
+        class Impl;
+        /// Private implementation details.
+        std::shared_ptr<Impl> impl;
+
+      public:
+        /**
+         * Constructor.
+         *
+         * The sub-resolutions are set up using the tags of the
+         * full-resolution directory, which must be set before
+         * construction.  The number of levels is limited to the
+         * number needed to reduce the image to a single pixel.
+         *
+         * @param ifd the full-resolution directory.
+         * @param levels the number of sub-resolutions to write.
+         * @param method the downsampling method.
+         * @param dir the directory in which to create temporary files.
+         * @throws Exception if the image can not be downsampled.
+         */
+        SubResolutionWriter(const IFD&                     ifd,
+                            dimension_size_type            levels,
+                            Downsampling                   method,
+                            const boost::filesystem::path& dir);
+
+        /// Destructor.  Any remaining temporary files are removed.
+        ~SubResolutionWriter();
+
+        /// @cond SKIP
+        SubResolutionWriter (const SubResolutionWriter&) = delete;
+
+        SubResolutionWriter&
+        operator= (const SubResolutionWriter&) = delete;
+        /// @endcond SKIP
+
+        /**
+         * Get the number of sub-resolutions.
+         *
+         * @returns the number of levels.
+         */
+        dimension_size_type
+        getLevels() const;
+
+        /**
+         * Downsample a completed full-resolution tile.
+         *
+         * @param info the full-resolution tile information.
+         * @param tile the tile index.
+         * @param buffer the tile pixel data.
+         */
+        void
+        addTile(const TileInfo&     info,
+                dimension_size_type tile,
+                const TileBuffer&   buffer);
+
+        /**
+         * Write the sub-resolutions.
+         *
+         * The full-resolution directory must have been written with
+         * a SubIFD tag of getLevels() entries.  Each sub-resolution
+         * is written as the current directory of the TIFF, in turn.
+         * Any incomplete tiles are written as they are.
+         *
+         * @param tiff the TIFF to write to.
+         */
+        void
+        write(TIFF& tiff);
+      };
+
+    }
+  }
+}
+
+#endif // OME_FILES_TIFF_SUBRESOLUTIONWRITER_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -36,8 +36,13 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdarg>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <set>
 #include <vector>
 
 #include <fcntl.h> // For O_RDONLY on Unix and Windows
@@ -45,14 +50,26 @@
 // Include before boost headers to ensure the MPL limits get defined.
 #include <ome/common/config.h>
 
+#include <boost/filesystem/operations.hpp>
 #include <boost/range/size.hpp>
 
+#include <ome/files/Executor.h>
 #include <ome/files/Version.h>
+#include <ome/files/detail/IOStatistics.h>
+#include <ome/files/detail/TileDedup.h>
+#include <ome/files/detail/Trace.h>
+#include <ome/files/detail/WriteBehind.h>
+#include <ome/files/detail/tiff/JPEGCodec.h>
+#include <ome/files/tiff/ByteSource.h>
+#include <ome/files/tiff/DecodedTileCache.h>
+#include <ome/files/tiff/DirectoryIndex.h>
 #include <ome/files/tiff/Field.h>
 #include <ome/files/tiff/Tags.h>
 #include <ome/files/tiff/TIFF.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/Sentry.h>
+#include <ome/files/tiff/SharedTileCache.h>
+#include <ome/files/tiff/SubResolutionWriter.h>
 #include <ome/files/tiff/Exception.h>
 #include <ome/files/detail/tiff/Tags.h>
 
@@ -95,12 +112,241 @@ namespace ome
           {
           }
 
+          TIFFConcrete(std::shared_ptr<ByteSource> source,
+                       const std::string&          mode):
+            TIFF(source, mode)
+          {
+          }
+
           virtual
           ~TIFFConcrete()
           {
           }
         };
 
+        /**
+         * libtiff client I/O state for a ByteSource.
+         *
+         * Each libtiff handle has its own position, so several
+         * handles may share the same source.
+         */
+        struct ClientIO
+        {
+          /// The source to read from.
+          std::shared_ptr<ByteSource> source;
+          /// The current position.
+          offset_type pos;
+        };
+
+        tmsize_t
+        clientRead(thandle_t handle,
+                   void     *buf,
+                   tmsize_t  size)
+        {
+          ClientIO *io = static_cast<ClientIO *>(handle);
+          const offset_type total = io->source->size();
+          if (size < 0)
+            return -1;
+          if (io->pos >= total)
+            return 0;
+
+          dimension_size_type n = std::min(static_cast<dimension_size_type>(size),
+                                           static_cast<dimension_size_type>(total - io->pos));
+          try
+            {
+              io->source->read(io->pos, buf, n);
+            }
+          catch (const std::exception& e)
+            {
+              TIFFErrorExt(handle, io->source->name().c_str(), "%s", e.what());
+              return -1;
+            }
+          io->pos += n;
+          return static_cast<tmsize_t>(n);
+        }
+
+        tmsize_t
+        clientWrite(thandle_t /* handle */,
+                    void *    /* buf */,
+                    tmsize_t  /* size */)
+        {
+          // Sources are read-only.
+          return -1;
+        }
+
+        toff_t
+        clientSeek(thandle_t handle,
+                   toff_t    offset,
+                   int       whence)
+        {
+          ClientIO *io = static_cast<ClientIO *>(handle);
+          switch (whence)
+            {
+            case SEEK_SET:
+              io->pos = offset;
+              break;
+            case SEEK_CUR:
+              io->pos += offset;
+              break;
+            case SEEK_END:
+              io->pos = io->source->size() + offset;
+              break;
+            default:
+              return static_cast<toff_t>(-1);
+            }
+          return io->pos;
+        }
+
+        int
+        clientClose(thandle_t /* handle */)
+        {
+          // The ClientIO is owned by the caller of TIFFClientOpen.
+          return 0;
+        }
+
+        toff_t
+        clientSize(thandle_t handle)
+        {
+          return static_cast<ClientIO *>(handle)->source->size();
+        }
+
+        int
+        clientMap(thandle_t /* handle */,
+                  void **   /* base */,
+                  toff_t *  /* size */)
+        {
+          // Mapping is not supported; libtiff falls back to reading.
+          return 0;
+        }
+
+        void
+        clientUnmap(thandle_t /* handle */,
+                    void *    /* base */,
+                    toff_t    /* size */)
+        {
+        }
+
+        /**
+         * Open a libtiff handle reading from a ByteSource.
+         *
+         * @note Needs wrapping in a sentry by the caller.
+         *
+         * @param io the client I/O state; must outlive the handle.
+         * @param mode the file open mode.
+         * @returns the libtiff handle, or null on failure.
+         */
+        ::TIFF *
+        clientOpen(ClientIO&          io,
+                   const std::string& mode)
+        {
+          return TIFFClientOpen(io.source->name().c_str(), mode.c_str(),
+                                static_cast<thandle_t>(&io),
+                                clientRead, clientWrite, clientSeek, clientClose,
+                                clientSize, clientMap, clientUnmap);
+        }
+
+        /**
+         * Read a value from a TIFF file without decoding a directory.
+         *
+         * @param tiff the libtiff file handle.
+         * @param offset the file offset to read from.
+         * @param value the value to read.
+         * @returns @c true on success, @c false if the read failed.
+         */
+        template<typename T>
+        bool
+        readValue(::TIFF      *tiff,
+                  offset_type  offset,
+                  T&           value)
+        {
+          thandle_t fd = TIFFClientdata(tiff);
+          TIFFSeekProc seekproc = TIFFGetSeekProc(tiff);
+          TIFFReadWriteProc readproc = TIFFGetReadProc(tiff);
+
+          if (seekproc(fd, static_cast<toff_t>(offset), SEEK_SET) != static_cast<toff_t>(offset))
+            return false;
+          return readproc(fd, &value, static_cast<tmsize_t>(sizeof(T))) == static_cast<tmsize_t>(sizeof(T));
+        }
+
+        /**
+         * Walk the chain of directory offsets.
+         *
+         * Only the entry count and next directory offset of each IFD
+         * are read; the directories themselves are not decoded, so
+         * this is much cheaper than TIFFReadDirectory for files with
+         * many directories.  The walk stops at the end of the chain,
+         * at a truncated or out of range directory, or on detecting a
+         * loop.
+         *
+         * @param tiff the libtiff file handle.
+         * @param first the offset of the first directory.
+         * @param offsets the directory offsets to fill.
+         */
+        void
+        walkDirectoryOffsets(::TIFF                   *tiff,
+                             offset_type               first,
+                             std::vector<offset_type>& offsets)
+        {
+          const bool bigtiff = TIFFIsBigTIFF(tiff) != 0;
+          const bool swab = TIFFIsByteSwapped(tiff) != 0;
+          const offset_type filesize = static_cast<offset_type>(TIFFGetSizeProc(tiff)(TIFFClientdata(tiff)));
+          // Sizes of the entry count, a directory entry and the
+          // next directory offset.
+          const offset_type countsize = bigtiff ? 8U : 2U;
+          const offset_type entrysize = bigtiff ? 20U : 12U;
+          const offset_type nextsize = bigtiff ? 8U : 4U;
+
+          std::set<offset_type> seen;
+          offset_type offset = first;
+          while (offset && offset < filesize && seen.insert(offset).second)
+            {
+              offset_type count;
+              if (bigtiff)
+                {
+                  uint64 count64;
+                  if (!readValue(tiff, offset, count64))
+                    break;
+                  if (swab)
+                    TIFFSwabLong8(&count64);
+                  count = count64;
+                }
+              else
+                {
+                  uint16 count16;
+                  if (!readValue(tiff, offset, count16))
+                    break;
+                  if (swab)
+                    TIFFSwabShort(&count16);
+                  count = count16;
+                }
+
+              offset_type nextpos = offset + countsize + (count * entrysize);
+              if (!count || nextpos + nextsize > filesize)
+                break;
+
+              offsets.push_back(offset);
+
+              if (bigtiff)
+                {
+                  uint64 next64;
+                  if (!readValue(tiff, nextpos, next64))
+                    break;
+                  if (swab)
+                    TIFFSwabLong8(&next64);
+                  offset = next64;
+                }
+              else
+                {
+                  uint32 next32;
+                  if (!readValue(tiff, nextpos, next32))
+                    break;
+                  if (swab)
+                    TIFFSwabLong(&next32);
+                  offset = next32;
+                }
+            }
+        }
+
       }
 
       /**
@@ -111,8 +357,90 @@ namespace ome
       public:
         /// The libtiff file handle.
         ::TIFF *tiff;
-        /// Directory offsets
+        /// Directory offsets (built on first use when reading).
         std::vector<offset_type> offsets;
+        /// Directory indexes by offset.
+        std::map<offset_type, directory_index_type> indexes;
+        /// Offset of the first directory (when reading).
+        offset_type firstoffset;
+        /// Directory offsets have been indexed.
+        std::atomic<bool> indexed;
+        /// Use a sidecar file to persist the directory index.
+        bool sidecar;
+        /// Mutex serialising access to the libtiff file handle.
+        std::recursive_mutex mutex;
+        /// Filename.
+        boost::filesystem::path filename;
+        /// File open mode.
+        std::string mode;
+        /// Number of threads for tile decoding.
+        unsigned int decodethreads;
+        /// Number of threads for tile encoding.
+        unsigned int encodethreads;
+        /// Executor for parallel decoding and encoding (null for global).
+        std::shared_ptr<Executor> executor;
+        /// Decoded tile cache.
+        std::shared_ptr<DecodedTileCache> tilecache;
+        /// File identity for shared tile caching.
+        uint64_t fileidentity;
+        /// File identity computed on first use.
+        std::once_flag fileidentityonce;
+        /// Lookup tables by directory offset.
+        std::map<offset_type, std::shared_ptr<const std::vector<uint16_t>>> lookuptables;
+        /// Codec tables by directory offset.
+        std::map<offset_type, std::shared_ptr<const std::vector<uint8_t>>> codectables;
+        /// Mutex serialising access to the lookup and codec tables.
+        std::mutex lookupmutex;
+        /// Pixel statistics sink.
+        std::shared_ptr<PixelStatistics> statistics;
+        /// Normalize floating point samples when reading.
+        bool normalized;
+        /// I/O statistics.
+        std::shared_ptr<IOStatistics> iostatistics;
+        /// Write tile cache limit.
+        dimension_size_type writecachelimit;
+        /// Number of sub-resolutions to write.
+        dimension_size_type subresolutions;
+        /// Sub-resolution downsampling method.
+        Downsampling downsampling;
+        /// Sub-resolution writer for the current directory.
+        std::shared_ptr<SubResolutionWriter> subresolutionwriter;
+        /// Write compact directories.
+        bool compact;
+        /// Leave empty tiles out of the file.
+        bool sparse;
+        /// Index of written tile data (if deduplicating).
+        std::unique_ptr<ome::files::detail::TileDedup> dedup;
+        /// Tile hashes to record.
+        unsigned int tilehashes;
+        /// Encoded tile hashes of the current directory.
+        std::vector<uint64_t> encodedhashes;
+        /// Decoded tile hashes of the current directory.
+        std::vector<uint64_t> decodedhashes;
+        /// Record tile summaries?
+        bool tilesummaries;
+        /// Tile summaries of the current directory.
+        std::vector<TileSummary> summaries;
+        /// Streaming write window state (if enabled).
+        std::unique_ptr<ome::files::detail::WriteBehind> writebehind;
+        /// Number of directories written.
+        dimension_size_type written;
+        /// Byte source (if not opened by filename).
+        std::shared_ptr<ByteSource> source;
+        /// Client I/O state for the byte source.
+        std::unique_ptr<ClientIO> io;
+        /// Maximum number of idle read handles to keep open.
+        unsigned int readhandles;
+        /// Idle read handles.
+        std::vector<std::shared_ptr<wrapped_type>> readpool;
+        /// Mutex serialising access to the read handle pool.
+        std::mutex readpoolmutex;
+        /// Start of the file mapping (if mapped).
+        void *mapbase;
+        /// Size of the file mapping.
+        uint64_t mapsize;
+        /// File mapped on first use.
+        std::once_flag maponce;
 
         /**
          * The constructor.
@@ -125,8 +453,50 @@ namespace ome
         Impl(const boost::filesystem::path& filename,
              const std::string&             mode):
           tiff(),
-          offsets()
+          offsets(),
+          indexes(),
+          firstoffset(0U),
+          indexed(false),
+          sidecar(false),
+          mutex(),
+          filename(filename),
+          mode(mode),
+          decodethreads(1U),
+          encodethreads(1U),
+          executor(),
+          tilecache(),
+          fileidentity(0U),
+          fileidentityonce(),
+          lookuptables(),
+          codectables(),
+          lookupmutex(),
+          statistics(),
+          normalized(false),
+          iostatistics(),
+          writecachelimit(0U),
+          subresolutions(0U),
+          downsampling(DOWNSAMPLE_MEAN),
+          subresolutionwriter(),
+          compact(false),
+          sparse(false),
+          dedup(),
+          tilehashes(0U),
+          encodedhashes(),
+          decodedhashes(),
+          tilesummaries(false),
+          summaries(),
+          writebehind(),
+          written(0U),
+          source(),
+          io(),
+          readhandles(0U),
+          readpool(),
+          readpoolmutex(),
+          mapbase(nullptr),
+          mapsize(0U),
+          maponce()
         {
+          // No lock required; the handle is not yet shared.
           Sentry sentry;
 
 #ifdef _MSC_VER
@@ -136,6 +506,80 @@ namespace ome
 #endif
           if (!tiff)
             sentry.error();
+
+          if(TIFFGetMode(tiff) == O_RDONLY)
+            firstoffset = static_cast<offset_type>(TIFFCurrentDirOffset(tiff));
+        }
+
+        /**
+         * The constructor.
+         *
+         * Opens the TIFF from a ByteSource using TIFFClientOpen().
+         *
+         * @param source the source to read.
+         * @param mode the file open mode.
+         */
+        Impl(std::shared_ptr<ByteSource> source,
+             const std::string&          mode):
+          tiff(),
+          offsets(),
+          indexes(),
+          firstoffset(0U),
+          indexed(false),
+          sidecar(false),
+          mutex(),
+          filename(source ? source->name() : std::string()),
+          mode(mode),
+          decodethreads(1U),
+          encodethreads(1U),
+          executor(),
+          tilecache(),
+          fileidentity(0U),
+          fileidentityonce(),
+          lookuptables(),
+          codectables(),
+          lookupmutex(),
+          statistics(),
+          normalized(false),
+          iostatistics(),
+          writecachelimit(0U),
+          subresolutions(0U),
+          downsampling(DOWNSAMPLE_MEAN),
+          subresolutionwriter(),
+          compact(false),
+          sparse(false),
+          dedup(),
+          tilehashes(0U),
+          encodedhashes(),
+          decodedhashes(),
+          tilesummaries(false),
+          summaries(),
+          writebehind(),
+          written(0U),
+          source(source),
+          io(),
+          readhandles(0U),
+          readpool(),
+          readpoolmutex(),
+          mapbase(nullptr),
+          mapsize(0U),
+          maponce()
+        {
+          if (!source)
+            throw Exception("Null ByteSource");
+          if (mode.empty() || mode[0] != 'r')
+            throw Exception("A ByteSource may only be opened for reading");
+
+          io = std::unique_ptr<ClientIO>(new ClientIO{source, 0U});
+
+          // No lock required; the handle is not yet shared.
+          Sentry sentry;
+
+          tiff = clientOpen(*io, mode);
+          if (!tiff)
+            sentry.error();
+
+          firstoffset = static_cast<offset_type>(TIFFCurrentDirOffset(tiff));
         }
 
         /**
@@ -166,6 +610,94 @@ namespace ome
         operator= (const Impl&) = delete;
         /// @endcond SKIP
 
+        /**
+         * Build the directory offset index.
+         *
+         * When reading, the offsets of all directories are indexed
+         * on first use, so that any directory may then be accessed
+         * directly by offset in constant time rather than by
+         * walking the directory chain.  When writing, we don't have
+         * any offsets until we write a directory, so the index is
+         * left empty.
+         */
+        void
+        index()
+        {
+          if (indexed)
+            return;
+
+          std::lock_guard<std::recursive_mutex> guard(mutex);
+
+          if (indexed || !tiff)
+            return;
+
+          if(TIFFGetMode(tiff) == O_RDONLY)
+            {
+              Sentry sentry;
+
+              // Use the sidecar index if it is current, and its
+              // first directory matches the file.
+              if (sidecar && !source &&
+                  readDirectoryIndex(filename, offsets) &&
+                  offsets.front() != firstoffset)
+                offsets.clear();
+
+              bool loaded = !offsets.empty();
+
+              if (!loaded)
+                walkDirectoryOffsets(tiff, firstoffset, offsets);
+
+              // Fall back to reading each directory in turn if the
+              // directory chain could not be walked directly.
+              if (offsets.empty())
+                {
+                  if (TIFFSetSubDirectory(tiff, firstoffset))
+                    {
+                      do
+                        {
+                          offset_type offset = static_cast<offset_type>(TIFFCurrentDirOffset(tiff));
+                          offsets.push_back(offset);
+                        }
+                      while (TIFFReadDirectory(tiff) == 1);
+                    }
+                }
+
+              for (std::vector<offset_type>::size_type i = 0; i < offsets.size(); ++i)
+                indexes.insert(std::make_pair(offsets[i], static_cast<directory_index_type>(i)));
+
+              if (sidecar && !source && !loaded && !offsets.empty())
+                {
+                  try
+                    {
+                      writeDirectoryIndex(filename, offsets);
+                    }
+                  catch (const Exception&)
+                    {
+                      // The sidecar is optional; the directory may
+                      // not be writable.
+                    }
+                }
+            }
+
+          indexed = true;
+        }
+
+        /**
+         * Return a borrowed read handle to the pool.
+         *
+         * The handle is closed instead, when the last reference to it
+         * is released, if the pool is full or the file is closed.
+         *
+         * @param handle the handle to return.
+         */
+        void
+        release(const std::shared_ptr<wrapped_type>& handle)
+        {
+          std::lock_guard<std::mutex> lock(readpoolmutex);
+          if (tiff && readpool.size() < readhandles)
+            readpool.push_back(handle);
+        }
+
         /**
          * Close the libtiff file handle.
          *
@@ -174,10 +706,38 @@ namespace ome
         void
         close()
         {
+          {
+            std::lock_guard<std::mutex> lock(readpoolmutex);
+            readpool.clear();
+          }
+
           if (tiff)
             {
+              std::lock_guard<std::recursive_mutex> guard(mutex);
               Sentry sentry;
 
+              // Release the remaining data once the final directory
+              // has been written.
+              if (writebehind && TIFFFlush(tiff))
+                {
+                  try
+                    {
+                      writebehind->finish(static_cast<uint64_t>(TIFFGetSizeProc(tiff)(TIFFClientdata(tiff))));
+                    }
+                  catch (const std::runtime_error&)
+                    {
+                      // The data is written; it is only left cached.
+                    }
+                }
+              writebehind.reset();
+
+              if (mapbase)
+                {
+                  TIFFGetUnmapFileProc(tiff)(TIFFClientdata(tiff), mapbase, static_cast<toff_t>(mapsize));
+                  mapbase = nullptr;
+                  mapsize = 0U;
+                }
+
               TIFFClose(tiff);
               if (!sentry.getMessage().empty())
                 sentry.error();
@@ -192,23 +752,22 @@ namespace ome
         impl(std::shared_ptr<Impl>(new Impl(filename, mode)))
       {
         registerImageJTags();
+        registerTileHashTags();
+      }
 
-        // When reading, cache all directory offsets.  When writing,
-        // we don't have any offsets until we write a directory, so
-        // ignore caching entirely.
-        if(TIFFGetMode(impl->tiff) == O_RDONLY)
-          {
-            do
-              {
-                offset_type offset = static_cast<offset_type>(TIFFCurrentDirOffset(impl->tiff));
-                impl->offsets.push_back(offset);
-              }
-            while (TIFFReadDirectory(impl->tiff) == 1);
-          }
+      // Note boost::make_shared can't be used here.
+      TIFF::TIFF(std::shared_ptr<ByteSource> source,
+                 const std::string&          mode):
+        impl(std::shared_ptr<Impl>(new Impl(source, mode)))
+      {
+        registerImageJTags();
+        registerTileHashTags();
       }
 
       TIFF::~TIFF()
       {
+        if (impl->tilecache)
+          impl->tilecache->erase(this);
       }
 
       TIFF::wrapped_type *
@@ -217,15 +776,571 @@ namespace ome
         return reinterpret_cast<wrapped_type *>(impl->tiff);
       }
 
+      std::recursive_mutex&
+      TIFF::getMutex() const
+      {
+        return impl->mutex;
+      }
+
+      void
+      TIFF::setDecodeThreads(unsigned int threads)
+      {
+        impl->decodethreads = threads ? threads : 1U;
+      }
+
+      unsigned int
+      TIFF::getDecodeThreads() const
+      {
+        return impl->decodethreads;
+      }
+
+      void
+      TIFF::setEncodeThreads(unsigned int threads)
+      {
+        impl->encodethreads = threads ? threads : 1U;
+      }
+
+      unsigned int
+      TIFF::getEncodeThreads() const
+      {
+        return impl->encodethreads;
+      }
+
+      void
+      TIFF::setExecutor(const std::shared_ptr<Executor>& executor)
+      {
+        impl->executor = executor;
+      }
+
+      std::shared_ptr<Executor>
+      TIFF::getExecutor() const
+      {
+        std::shared_ptr<Executor> executor(impl->executor);
+        return executor ? executor : Executor::global();
+      }
+
+      std::shared_ptr<TIFF::wrapped_type>
+      TIFF::openReadHandle() const
+      {
+        if (impl->mode.empty() || impl->mode[0] != 'r')
+          throw Exception("Independent TIFF handles may only be opened for files opened for reading");
+
+        Sentry sentry;
+
+        if (impl->source)
+          {
+            std::shared_ptr<ClientIO> io(std::make_shared<ClientIO>(ClientIO{impl->source, 0U}));
+            ::TIFF *tiffraw = clientOpen(*io, impl->mode);
+            if (!tiffraw)
+              sentry.error();
+
+            // The deleter keeps the client I/O state alive.
+            return std::shared_ptr<wrapped_type>(reinterpret_cast<wrapped_type *>(tiffraw),
+                                                 [io](wrapped_type *handle)
+                                                 {
+                                                   Sentry sentry;
+                                                   TIFFClose(reinterpret_cast<::TIFF *>(handle));
+                                                 });
+          }
+
+#ifdef _MSC_VER
+        ::TIFF *tiffraw = TIFFOpenW(impl->filename.wstring().c_str(), impl->mode.c_str());
+#else
+        ::TIFF *tiffraw = TIFFOpen(impl->filename.string().c_str(), impl->mode.c_str());
+#endif
+        if (!tiffraw)
+          sentry.error();
+
+        return std::shared_ptr<wrapped_type>(reinterpret_cast<wrapped_type *>(tiffraw),
+                                             [](wrapped_type *handle)
+                                             {
+                                               Sentry sentry;
+                                               TIFFClose(reinterpret_cast<::TIFF *>(handle));
+                                             });
+      }
+
+      void
+      TIFF::setReadHandles(unsigned int handles)
+      {
+        std::lock_guard<std::mutex> lock(impl->readpoolmutex);
+        impl->readhandles = handles;
+        if (impl->readpool.size() > handles)
+          impl->readpool.resize(handles);
+      }
+
+      unsigned int
+      TIFF::getReadHandles() const
+      {
+        std::lock_guard<std::mutex> lock(impl->readpoolmutex);
+        return impl->readhandles;
+      }
+
+      std::shared_ptr<TIFF::wrapped_type>
+      TIFF::borrowReadHandle(offset_type offset) const
+      {
+        std::shared_ptr<wrapped_type> handle;
+
+        {
+          std::lock_guard<std::mutex> lock(impl->readpoolmutex);
+
+          // Prefer a handle already at the directory, to avoid
+          // rereading it.
+          auto found = std::find_if(impl->readpool.begin(), impl->readpool.end(),
+                                    [offset](const std::shared_ptr<wrapped_type>& idle)
+                                    {
+                                      return static_cast<offset_type>(TIFFCurrentDirOffset(reinterpret_cast<::TIFF *>(idle.get()))) == offset;
+                                    });
+          if (found == impl->readpool.end() && !impl->readpool.empty())
+            found = impl->readpool.end() - 1;
+          if (found != impl->readpool.end())
+            {
+              handle = *found;
+              impl->readpool.erase(found);
+            }
+        }
+
+        const bool opened = !handle;
+        if (opened)
+          handle = openReadHandle();
+
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(handle.get());
+
+        {
+          // Independent handle; only error capture is needed.
+          Sentry sentry;
+
+          if (static_cast<offset_type>(TIFFCurrentDirOffset(tiffraw)) != offset)
+            {
+              if (!TIFFSetSubDirectory(tiffraw, offset))
+                sentry.error();
+              detail::setRGBColorMode(tiffraw);
+            }
+          else if (opened)
+            detail::setRGBColorMode(tiffraw);
+        }
+
+        // The borrowed reference returns the handle to the pool when
+        // released; the pool holds the owning reference.
+        std::weak_ptr<Impl> pool(impl);
+        return std::shared_ptr<wrapped_type>(handle.get(),
+                                             [handle, pool](wrapped_type *)
+                                             {
+                                               std::shared_ptr<Impl> owner(pool.lock());
+                                               if (owner)
+                                                 owner->release(handle);
+                                             });
+      }
+
+      const uint8_t *
+      TIFF::getMappedData(uint64_t& size) const
+      {
+        // Mapping is deferred until pixel data are read in place.
+        // The lock is not needed (and may be held by another thread
+        // waiting on this one); the mapping procedures of the handle
+        // do not change once opened.
+        std::call_once(impl->maponce, [this]() {
+            if (impl->tiff && !impl->source &&
+                TIFFGetMode(impl->tiff) == O_RDONLY && TIFFIsMapped(impl->tiff))
+              {
+                void *base = nullptr;
+                toff_t size = 0U;
+                if (TIFFGetMapFileProc(impl->tiff)(TIFFClientdata(impl->tiff), &base, &size))
+                  {
+                    impl->mapbase = base;
+                    impl->mapsize = static_cast<uint64_t>(size);
+                  }
+              }
+          });
+        size = impl->mapsize;
+        return static_cast<const uint8_t *>(impl->mapbase);
+      }
+
+      void
+      TIFF::setIndexSidecar(bool sidecar)
+      {
+        impl->sidecar = sidecar;
+      }
+
+      bool
+      TIFF::getIndexSidecar() const
+      {
+        return impl->sidecar;
+      }
+
+      std::vector<offset_type>
+      TIFF::getDirectoryOffsets() const
+      {
+        impl->index();
+        return impl->offsets;
+      }
+
+      bool
+      TIFF::setDirectoryOffsets(const std::vector<offset_type>& offsets)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        if (impl->indexed || !impl->tiff ||
+            TIFFGetMode(impl->tiff) != O_RDONLY ||
+            offsets.empty() || offsets.front() != impl->firstoffset)
+          return false;
+
+        impl->offsets = offsets;
+        for (std::vector<offset_type>::size_type i = 0; i < offsets.size(); ++i)
+          impl->indexes.insert(std::make_pair(offsets[i], static_cast<directory_index_type>(i)));
+        impl->indexed = true;
+
+        return true;
+      }
+
+      void
+      TIFF::setTileCache(std::shared_ptr<DecodedTileCache> cache)
+      {
+        if (impl->tilecache && impl->tilecache != cache)
+          impl->tilecache->erase(this);
+        impl->tilecache = cache;
+      }
+
+      const std::shared_ptr<DecodedTileCache>&
+      TIFF::getTileCache() const
+      {
+        return impl->tilecache;
+      }
+
+      uint64_t
+      TIFF::getFileIdentity() const
+      {
+        // Examining the file is deferred until tiles are shared.
+        std::call_once(impl->fileidentityonce, [this]() {
+            if (!impl->source && !impl->mode.empty() && impl->mode[0] == 'r')
+              impl->fileidentity = SharedTileCache::fileIdentity(impl->filename);
+          });
+        return impl->fileidentity;
+      }
+
+      std::shared_ptr<const std::vector<uint16_t>>
+      TIFF::getCachedLookupTable(offset_type offset) const
+      {
+        std::lock_guard<std::mutex> lock(impl->lookupmutex);
+        auto i = impl->lookuptables.find(offset);
+        return i != impl->lookuptables.end() ? i->second : std::shared_ptr<const std::vector<uint16_t>>();
+      }
+
+      void
+      TIFF::cacheLookupTable(offset_type                                  offset,
+                             std::shared_ptr<const std::vector<uint16_t>> table) const
+      {
+        std::lock_guard<std::mutex> lock(impl->lookupmutex);
+        impl->lookuptables[offset] = table;
+      }
+
+      std::shared_ptr<const std::vector<uint8_t>>
+      TIFF::getCachedCodecTables(offset_type offset) const
+      {
+        std::lock_guard<std::mutex> lock(impl->lookupmutex);
+        auto i = impl->codectables.find(offset);
+        return i != impl->codectables.end() ? i->second : std::shared_ptr<const std::vector<uint8_t>>();
+      }
+
+      void
+      TIFF::cacheCodecTables(offset_type                                 offset,
+                             std::shared_ptr<const std::vector<uint8_t>> tables) const
+      {
+        std::lock_guard<std::mutex> lock(impl->lookupmutex);
+        impl->codectables[offset] = tables;
+      }
+
+      void
+      TIFF::setStatistics(std::shared_ptr<PixelStatistics> statistics)
+      {
+        impl->statistics = statistics;
+      }
+
+      const std::shared_ptr<PixelStatistics>&
+      TIFF::getStatistics() const
+      {
+        return impl->statistics;
+      }
+
+      void
+      TIFF::setNormalized(bool normalized)
+      {
+        impl->normalized = normalized;
+      }
+
+      bool
+      TIFF::getNormalized() const
+      {
+        return impl->normalized;
+      }
+
+      void
+      TIFF::setIOStatistics(std::shared_ptr<IOStatistics> statistics)
+      {
+        impl->iostatistics = statistics;
+      }
+
+      const std::shared_ptr<IOStatistics>&
+      TIFF::getIOStatistics() const
+      {
+        return impl->iostatistics;
+      }
+
+      void
+      TIFF::setWriteCacheLimit(dimension_size_type limit)
+      {
+        impl->writecachelimit = limit;
+      }
+
+      dimension_size_type
+      TIFF::getWriteCacheLimit() const
+      {
+        return impl->writecachelimit;
+      }
+
+      void
+      TIFF::setStreamingWrites(dimension_size_type window)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        if (!window || !impl->tiff || impl->source ||
+            TIFFGetMode(impl->tiff) == O_RDONLY)
+          {
+            impl->writebehind.reset();
+            return;
+          }
+
+        impl->writebehind = std::unique_ptr<ome::files::detail::WriteBehind>
+          (new ome::files::detail::WriteBehind(TIFFFileno(impl->tiff), window));
+      }
+
+      dimension_size_type
+      TIFF::getStreamingWrites() const
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        return impl->writebehind ? impl->writebehind->getWindow() : 0U;
+      }
+
+      void
+      TIFF::streamWritten()
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        if (!impl->writebehind)
+          return;
+
+        try
+          {
+            impl->writebehind->written(static_cast<uint64_t>(TIFFGetSizeProc(impl->tiff)(TIFFClientdata(impl->tiff))));
+          }
+        catch (const std::runtime_error& e)
+          {
+            throw Exception(e.what());
+          }
+      }
+
+      void
+      TIFF::setSparseTiles(bool sparse)
+      {
+        impl->sparse = sparse;
+      }
+
+      bool
+      TIFF::getSparseTiles() const
+      {
+        return impl->sparse;
+      }
+
+      void
+      TIFF::setTileDeduplication(dimension_size_type limit)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        if (limit)
+          impl->dedup = std::unique_ptr<ome::files::detail::TileDedup>
+            (new ome::files::detail::TileDedup(static_cast<std::size_t>(limit)));
+        else
+          impl->dedup.reset();
+      }
+
+      dimension_size_type
+      TIFF::getTileDeduplication() const
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        return impl->dedup ? impl->dedup->getLimit() : 0U;
+      }
+
+      bool
+      TIFF::findDuplicateTile(const std::vector<uint8_t>& data,
+                              offset_type&                offset)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        uint64_t found;
+        if (!impl->dedup || !impl->dedup->find(data.data(), data.size(), found))
+          return false;
+        offset = static_cast<offset_type>(found);
+        return true;
+      }
+
+      void
+      TIFF::addWrittenTile(const std::vector<uint8_t>& data,
+                           offset_type                 offset)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        if (impl->dedup)
+          impl->dedup->insert(data.data(), data.size(), static_cast<uint64_t>(offset));
+      }
+
+      void
+      TIFF::setTileHashes(unsigned int hashes)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        impl->tilehashes = hashes;
+      }
+
+      unsigned int
+      TIFF::getTileHashes() const
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        return impl->tilehashes;
+      }
+
+      void
+      TIFF::addTileHash(TileHash            type,
+                        dimension_size_type tile,
+                        uint64_t            hash)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        if (!(impl->tilehashes & type))
+          return;
+
+        std::vector<uint64_t>& hashes(type == TILE_HASH_ENCODED ?
+                                      impl->encodedhashes : impl->decodedhashes);
+        if (hashes.size() <= tile)
+          hashes.resize(static_cast<std::vector<uint64_t>::size_type>(tile + 1U), 0U);
+        hashes[tile] = hash;
+      }
+
+      void
+      TIFF::setTileSummaries(bool summaries)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        impl->tilesummaries = summaries;
+      }
+
+      bool
+      TIFF::getTileSummaries() const
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        return impl->tilesummaries;
+      }
+
+      void
+      TIFF::addTileSummary(dimension_size_type tile,
+                           const TileSummary&  summary)
+      {
+        std::lock_guard<std::recursive_mutex> guard(impl->mutex);
+
+        if (!impl->tilesummaries)
+          return;
+
+        if (impl->summaries.size() <= tile)
+          impl->summaries.resize(static_cast<std::vector<TileSummary>::size_type>(tile + 1U));
+        impl->summaries[tile].merge(summary);
+      }
+
+      void
+      TIFF::setCompactDirectories(bool compact)
+      {
+        impl->compact = compact;
+      }
+
+      bool
+      TIFF::getCompactDirectories() const
+      {
+        return impl->compact;
+      }
+
+      void
+      TIFF::setSubResolutions(dimension_size_type levels,
+                              Downsampling        method)
+      {
+        impl->subresolutions = levels;
+        impl->downsampling = method;
+      }
+
+      dimension_size_type
+      TIFF::getSubResolutions() const
+      {
+        return impl->subresolutions;
+      }
+
+      Downsampling
+      TIFF::getDownsampling() const
+      {
+        return impl->downsampling;
+      }
+
+      std::shared_ptr<SubResolutionWriter>
+      TIFF::getSubResolutionWriter(const IFD& ifd)
+      {
+        if (impl->subresolutions && !impl->subresolutionwriter)
+          {
+            // Spool next to the file being written, if known.
+            boost::filesystem::path dir(impl->filename.parent_path());
+            if (impl->filename.empty())
+              dir = boost::filesystem::temp_directory_path();
+            else if (dir.empty())
+              dir = ".";
+            impl->subresolutionwriter = std::make_shared<SubResolutionWriter>(ifd, impl->subresolutions,
+                                                                               impl->downsampling, dir);
+          }
+        return impl->subresolutionwriter;
+      }
+
       std::shared_ptr<TIFF>
       TIFF::open(const boost::filesystem::path& filename,
-                 const std::string& mode)
+                 const std::string&             mode,
+                 std::shared_ptr<IOStatistics>  statistics)
       {
         std::shared_ptr<TIFF> ret;
         try
           {
+            OME_FILES_IO_TIME(timer, statistics.get(), OPEN);
             // Note boost::make_shared can't be used here.
             ret = std::shared_ptr<TIFF>(new TIFFConcrete(filename, mode));
+            ret->setIOStatistics(statistics);
+            OME_FILES_IO_COUNT(statistics, FILES_OPENED, 1U);
+          }
+        catch (const std::exception& e)
+          {
+            // All exception types are propagated as an Exception.
+            throw Exception(e.what());
+          }
+        return ret;
+      }
+
+      std::shared_ptr<TIFF>
+      TIFF::open(std::shared_ptr<ByteSource>   source,
+                 const std::string&            mode,
+                 std::shared_ptr<IOStatistics> statistics)
+      {
+        std::shared_ptr<TIFF> ret;
+        try
+          {
+            OME_FILES_IO_TIME(timer, statistics.get(), OPEN);
+            // Note boost::make_shared can't be used here.
+            ret = std::shared_ptr<TIFF>(new TIFFConcrete(source, mode));
+            ret->setIOStatistics(statistics);
+            OME_FILES_IO_COUNT(statistics, FILES_OPENED, 1U);
           }
         catch (const std::exception& e)
           {
@@ -238,6 +1353,10 @@ namespace ome
       void
       TIFF::close()
       {
+        if (impl->tilecache)
+          impl->tilecache->erase(this);
+        // Discard sub-resolutions of an unwritten directory.
+        impl->subresolutionwriter.reset();
         impl->close();
       }
 
@@ -246,15 +1365,24 @@ namespace ome
         return impl && impl->tiff;
       }
 
+      bool
+      TIFF::isMapped() const
+      {
+        return impl->tiff && TIFFIsMapped(impl->tiff);
+      }
+
       directory_index_type
       TIFF::directoryCount() const
       {
+        impl->index();
         return impl->offsets.size();
       }
 
       std::shared_ptr<IFD>
       TIFF::getDirectoryByIndex(directory_index_type index) const
       {
+        impl->index();
+
         offset_type offset;
         try
           {
@@ -268,10 +1396,28 @@ namespace ome
         return getDirectoryByOffset(offset);
       }
 
+      boost::optional<directory_index_type>
+      TIFF::getDirectoryIndex(offset_type offset) const
+      {
+        boost::optional<directory_index_type> ret;
+
+        impl->index();
+
+        auto i = impl->indexes.find(offset);
+        if (i != impl->indexes.end())
+          ret = i->second;
+
+        return ret;
+      }
+
       std::shared_ptr<IFD>
       TIFF::getDirectoryByOffset(offset_type offset) const
       {
-        Sentry sentry;
+        OME_FILES_IO_TIME(timer, impl->iostatistics.get(), DIRECTORY);
+        OME_FILES_TRACE(trace, "tiff", "read_directory");
+        OME_FILES_IO_COUNT(impl->iostatistics, DIRECTORIES_READ, 1U);
+
+        Sentry sentry(*this, IOStatistics::LOCK_DIRECTORY);
 
         std::shared_ptr<TIFF> t(std::const_pointer_cast<TIFF>(shared_from_this()));
         std::shared_ptr<IFD> ifd = IFD::openOffset(t, offset);
@@ -289,13 +1435,95 @@ namespace ome
       void
       TIFF::writeCurrentDirectory()
       {
-        Sentry sentry;
+        OME_FILES_TRACE(trace, "tiff", "write_directory");
+
+        Sentry sentry(*this, IOStatistics::LOCK_DIRECTORY);
 
         static const std::string software("OME Files (C++) " OME_FILES_VERSION_MAJOR_S "." OME_FILES_VERSION_MINOR_S "." OME_FILES_VERSION_PATCH_S);
-        getCurrentDirectory()->getField(SOFTWARE).set(software);
+        if (!impl->compact || !impl->written)
+          getCurrentDirectory()->getField(SOFTWARE).set(software);
+
+        // Sub-resolutions are written as SubIFDs following the
+        // directory.
+        std::shared_ptr<SubResolutionWriter> subresolutionwriter;
+        std::swap(subresolutionwriter, impl->subresolutionwriter);
+        if (subresolutionwriter && subresolutionwriter->getLevels())
+          getCurrentDirectory()->getField(SUBIFD).set(std::vector<uint64_t>(subresolutionwriter->getLevels(), 0U));
+
+        // Each 64-bit tile hash is stored as two LONGs (low word
+        // first), since LONG8 is only permitted in BigTIFF.
+        std::vector<uint64_t> encodedhashes;
+        std::vector<uint64_t> decodedhashes;
+        std::swap(encodedhashes, impl->encodedhashes);
+        std::swap(decodedhashes, impl->decodedhashes);
+        if (impl->tilehashes)
+          {
+            const dimension_size_type tiles = getCurrentDirectory()->getTileInfo().tileCount();
+            auto setHashes = [&](uint32_t tag, TileHash type, std::vector<uint64_t>& hashes)
+              {
+                if (!(impl->tilehashes & type))
+                  return;
+                hashes.resize(static_cast<std::vector<uint64_t>::size_type>(tiles), 0U);
+                std::vector<uint32_t> words;
+                words.reserve(hashes.size() * 2U);
+                for (const auto hash : hashes)
+                  {
+                    words.push_back(static_cast<uint32_t>(hash & 0xFFFFFFFFU));
+                    words.push_back(static_cast<uint32_t>(hash >> 32));
+                  }
+                if (!TIFFSetField(impl->tiff, tag, static_cast<uint32_t>(words.size()), words.data()))
+                  sentry.error("Failed to set tile hashes");
+              };
+            setHashes(TIFFTAG_OME_TILE_HASHES_ENCODED, TILE_HASH_ENCODED, encodedhashes);
+            setHashes(TIFFTAG_OME_TILE_HASHES_DECODED, TILE_HASH_DECODED, decodedhashes);
+          }
+
+        // Each summary is stored as three DOUBLEs: minimum, maximum
+        // and nonzero count.  Pixels of a tile which were never
+        // written are zero-filled, so zero is included for partly
+        // written tiles, and tiles whose values were not seen (such
+        // as those written raw) are stored as unknown (NaN).
+        std::vector<TileSummary> summaries;
+        std::swap(summaries, impl->summaries);
+        if (impl->tilesummaries)
+          {
+            std::shared_ptr<IFD> ifd(getCurrentDirectory());
+            const TileInfo info(ifd->getTileInfo());
+            const dimension_size_type tiles = info.tileCount();
+            const PlaneRegion image(0U, 0U, ifd->getImageWidth(), ifd->getImageHeight());
+            const dimension_size_type samples = ifd->getPlanarConfiguration() == CONTIG ?
+              ifd->getSamplesPerPixel() : 1U;
+            summaries.resize(static_cast<std::vector<TileSummary>::size_type>(tiles));
+
+            std::vector<double> values;
+            values.reserve(summaries.size() * 3U);
+            for (dimension_size_type tile = 0U; tile < tiles; ++tile)
+              {
+                TileSummary& summary(summaries[tile]);
+                if (!summary.count)
+                  {
+                    summary.min = summary.max = std::numeric_limits<double>::quiet_NaN();
+                  }
+                else if (summary.count < info.tileRegion(tile, image).area() * samples)
+                  {
+                    summary.min = std::min(summary.min, 0.0);
+                    summary.max = std::max(summary.max, 0.0);
+                  }
+                values.push_back(summary.min);
+                values.push_back(summary.max);
+                values.push_back(static_cast<double>(summary.nonzero));
+              }
+            if (!TIFFSetField(impl->tiff, TIFFTAG_OME_TILE_SUMMARIES, static_cast<uint32_t>(values.size()), values.data()))
+              sentry.error("Failed to set tile summaries");
+          }
 
         if (!TIFFWriteDirectory(impl->tiff))
           sentry.error("Failed to write current directory");
+        ++impl->written;
+        streamWritten();
+
+        if (subresolutionwriter)
+          subresolutionwriter->write(*this);
       }
 
       TIFF::iterator
@@ -355,13 +1583,49 @@ namespace ome
 
         ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(getWrapped());
 
-        Sentry sentry;
+        Sentry sentry(*this, IOStatistics::LOCK_TAG);
 
         int e = TIFFMergeFieldInfo(tiffraw, ImageJFieldInfo.data(), ImageJFieldInfo.size());
         if (e)
           sentry.error();
       }
 
+      void
+      TIFF::registerTileHashTags()
+      {
+        // As for the ImageJ tags, the names must outlive the
+        // registered field info.
+        static std::string encoded("OMETileHashesEncoded");
+        static std::string decoded("OMETileHashesDecoded");
+        static std::string summaries("OMETileSummaries");
+        static const std::array<TIFFFieldInfo, 3> TileHashFieldInfo
+          {{
+              {
+                TIFFTAG_OME_TILE_HASHES_ENCODED,
+                TIFF_VARIABLE2, TIFF_VARIABLE2, TIFF_LONG, FIELD_CUSTOM,
+                true, true, const_cast<char *>(encoded.c_str())
+              },
+              {
+                TIFFTAG_OME_TILE_HASHES_DECODED,
+                TIFF_VARIABLE2, TIFF_VARIABLE2, TIFF_LONG, FIELD_CUSTOM,
+                true, true, const_cast<char *>(decoded.c_str())
+              },
+              {
+                TIFFTAG_OME_TILE_SUMMARIES,
+                TIFF_VARIABLE2, TIFF_VARIABLE2, TIFF_DOUBLE, FIELD_CUSTOM,
+                true, true, const_cast<char *>(summaries.c_str())
+              }
+          }};
+
+        ::TIFF *tiffraw = reinterpret_cast<::TIFF *>(getWrapped());
+
+        Sentry sentry(*this, IOStatistics::LOCK_TAG);
+
+        int e = TIFFMergeFieldInfo(tiffraw, TileHashFieldInfo.data(), TileHashFieldInfo.size());
+        if (e)
+          sentry.error();
+      }
+
     }
   }
 }
@@ -40,10 +40,13 @@
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/iterator/iterator_facade.hpp>
+#include <boost/optional.hpp>
 
 #include <ome/files/tiff/Types.h>
 
@@ -51,13 +54,21 @@ namespace ome
 {
   namespace files
   {
+
+    class Executor;
+    class IOStatistics;
+    class PixelStatistics;
+
     /**
      * TIFF file format (libtiff wrapper).
      */
     namespace tiff
     {
 
+      class ByteSource;
+      class DecodedTileCache;
       class IFD;
+      class SubResolutionWriter;
 
       /**
        * Iterator for IFDs contained within a TIFF.
@@ -173,6 +184,16 @@ namespace ome
         TIFF(const boost::filesystem::path& filename,
              const std::string&             mode);
 
+        /**
+         * Constructor (non-public).
+         *
+         * @param source the source to read.
+         * @param mode the file open mode (must be @c r to read).
+         * @throws an Exception on failure.
+         */
+        TIFF(std::shared_ptr<ByteSource> source,
+             const std::string&          mode);
+
         /// @cond SKIP
         TIFF (const TIFF&) = delete;
 
@@ -188,17 +209,47 @@ namespace ome
          * Open a TIFF file for reading or writing.
          *
          * @note There are additional open flags, documented in
-         * TIFFOpen(3).
+         * TIFFOpen(3).  Files opened for reading are memory-mapped
+         * read-only by default, so strips and tiles are read from the
+         * mapping (and the page cache is shared between all handles
+         * open on the same file) rather than with a separate read
+         * call for each; use @c rm to disable mapping.
          *
          * @param filename the file to open.
          * @param mode the file open mode (@c r to read, @c w to write
          * or @c a to append).
+         * @param statistics the I/O statistics to record the open
+         * in and to set for the TIFF, or null.
          * @returns the the open TIFF.
          * @throws an Exception on failure.
          */
         static std::shared_ptr<TIFF>
         open(const boost::filesystem::path& filename,
-             const std::string&             mode);
+             const std::string&             mode,
+             std::shared_ptr<IOStatistics>  statistics = std::shared_ptr<IOStatistics>());
+
+        /**
+         * Open a TIFF for reading from a ByteSource.
+         *
+         * The TIFF is read through the source using libtiff client
+         * I/O, so that files which are not on the local filesystem
+         * may be read without first copying them in full.  For a
+         * source with a high latency per request, wrap it in a
+         * CachedByteSource, optionally over a DiskCachedByteSource
+         * to keep a larger working set on local disk.  The sidecar
+         * directory index is not available for sources.
+         *
+         * @param source the source to read.
+         * @param mode the file open mode (must be @c r to read).
+         * @param statistics the I/O statistics to record the open
+         * in and to set for the TIFF, or null.
+         * @returns the the open TIFF.
+         * @throws an Exception on failure.
+         */
+        static std::shared_ptr<TIFF>
+        open(std::shared_ptr<ByteSource>   source,
+             const std::string&            mode,
+             std::shared_ptr<IOStatistics> statistics = std::shared_ptr<IOStatistics>());
 
         /**
          * Close the TIFF file.
@@ -218,6 +269,16 @@ namespace ome
          */
         operator bool ();
 
+        /**
+         * Check if the TIFF file is memory-mapped.
+         *
+         * @returns @c true if the file contents are accessed through
+         * a read-only memory mapping, or @c false if accessed using
+         * file I/O.
+         */
+        bool
+        isMapped() const;
+
         /**
          * Get the total number of IFDs.
          *
@@ -237,6 +298,21 @@ namespace ome
         std::shared_ptr<IFD>
         getDirectoryByIndex(directory_index_type index) const;
 
+        /**
+         * Get the index of an IFD from its offset in the file.
+         *
+         * The directory offsets are indexed when first needed, so
+         * this is a map lookup rather than a walk of the directory
+         * chain.
+         *
+         * @param offset the directory offset.
+         * @returns the directory index, or none if the offset is not
+         * the offset of a directory, or the file is not open for
+         * reading.
+         */
+        boost::optional<directory_index_type>
+        getDirectoryIndex(offset_type offset) const;
+
         /**
          * Get an IFD by its offset in the file.
          *
@@ -290,6 +366,725 @@ namespace ome
         wrapped_type *
         getWrapped() const;
 
+        /**
+         * Get the mutex serialising access to the underlying libtiff
+         * @c \::TIFF instance.
+         *
+         * libtiff handles are not safe for concurrent use, but
+         * separate handles may be used concurrently.  All access to
+         * the wrapped handle must hold this lock, typically by using
+         * a Sentry constructed with this TIFF.  The mutex is
+         * recursive, so may be locked repeatedly by the same thread.
+         *
+         * @returns the mutex for this TIFF.
+         */
+        std::recursive_mutex&
+        getMutex() const;
+
+        /**
+         * Set the number of threads to use for decoding tiles.
+         *
+         * When reading an image region covering more than one tile
+         * or strip, IFD::readImage() will distribute the tiles
+         * between this number of tasks, run by the executor (see
+         * setExecutor()).  Each task decodes its tiles using an
+         * independent libtiff handle (see openReadHandle()), and
+         * copies the decoded pixel data directly into its part of
+         * the destination pixel buffer.
+         * The default of @c 1 reads all tiles serially using the
+         * shared handle.  Parallel decoding is only used for files
+         * opened for reading.
+         *
+         * @param threads the number of threads; @c 0 is treated as
+         * @c 1.
+         */
+        void
+        setDecodeThreads(unsigned int threads);
+
+        /**
+         * Get the number of threads to use for decoding tiles.
+         *
+         * @returns the number of threads.
+         */
+        unsigned int
+        getDecodeThreads() const;
+
+        /**
+         * Set the number of threads to use for encoding tiles.
+         *
+         * When writing an image, IFD::writeImage() will compress the
+         * tiles or strips completed by each write using this number
+         * of tasks, run by the executor (see setExecutor()).  Each
+         * task encodes its tiles into memory using a private libtiff
+         * handle, and the encoded tiles are then written in order
+         * with TIFFWriteRawTile() or TIFFWriteRawStrip().  The
+         * default of @c 1 encodes all tiles serially using the
+         * shared handle.  Parallel encoding is only used for
+         * compression schemes without state shared between tiles
+         * (JPEG compression is always serial).
+         *
+         * @param threads the number of threads; @c 0 is treated as
+         * @c 1.
+         */
+        void
+        setEncodeThreads(unsigned int threads);
+
+        /**
+         * Get the number of threads to use for encoding tiles.
+         *
+         * @returns the number of threads.
+         */
+        unsigned int
+        getEncodeThreads() const;
+
+        /**
+         * Set the executor for parallel decoding and encoding.
+         *
+         * The tiles decoded by setDecodeThreads() threads and
+         * encoded by setEncodeThreads() threads are run as tasks on
+         * this executor, so the threads actually used are bounded by
+         * the executor.  Not thread-safe; set before reading or
+         * writing.
+         *
+         * @param executor the executor to use, or null to use the
+         * global executor.
+         */
+        void
+        setExecutor(const std::shared_ptr<Executor>& executor);
+
+        /**
+         * Get the executor for parallel decoding and encoding.
+         *
+         * @returns the executor set with setExecutor(), or else the
+         * global executor.
+         */
+        std::shared_ptr<Executor>
+        getExecutor() const;
+
+        /**
+         * Open an independent libtiff handle for this file.
+         *
+         * The new handle is opened for reading with the same mode as
+         * this TIFF, but shares no state with it, and so may be used
+         * by another thread without holding the lock returned by
+         * getMutex().  The handle will initially refer to the first
+         * directory, and will be closed when the last reference to it
+         * is released.
+         *
+         * @returns an opaque pointer to the new wrapped @c \::TIFF
+         * instance.
+         * @throws an Exception if the file was not opened for
+         * reading, or could not be reopened.
+         */
+        std::shared_ptr<wrapped_type>
+        openReadHandle() const;
+
+        /**
+         * Set the number of pooled read handles.
+         *
+         * Pixel data are normally read by IFD::readImage() and
+         * related methods using the handle returned by getWrapped(),
+         * holding the lock returned by getMutex(), so that reads of
+         * different planes of the same file are serialised.  When
+         * this is non-zero, each read instead borrows an independent
+         * handle for its duration (see borrowReadHandle()), so that
+         * reads of different planes by separate threads run
+         * concurrently.  Up to this number of idle handles are kept
+         * open for reuse; concurrent reads open more handles as
+         * needed, which are closed once returned if the pool is
+         * full.  This only has an effect for files opened for
+         * reading.  Zero (the default) disables the pool.
+         *
+         * @param handles the maximum number of idle handles to keep
+         * open.
+         */
+        void
+        setReadHandles(unsigned int handles);
+
+        /**
+         * Get the number of pooled read handles.
+         *
+         * @returns the maximum number of idle handles kept open.
+         */
+        unsigned int
+        getReadHandles() const;
+
+        /**
+         * Borrow an independent libtiff handle for reading a
+         * directory.
+         *
+         * An idle handle from the pool is reused if available,
+         * preferring a handle already at the directory; otherwise a
+         * new handle is opened with openReadHandle().  The handle is
+         * switched directly to the directory at @p offset, as found
+         * in the directory index of this TIFF, without walking the
+         * directory chain.  As for openReadHandle(), the handle may
+         * be used by one thread without holding the lock returned by
+         * getMutex().  When the last reference to it is released,
+         * the handle is returned to the pool if this TIFF is still
+         * open and the pool is not full, and is closed otherwise.
+         *
+         * @param offset the offset of the directory to read.
+         * @returns an opaque pointer to the wrapped @c \::TIFF
+         * instance.
+         * @throws an Exception if the file was not opened for
+         * reading, or could not be reopened, or if the directory
+         * could not be read.
+         */
+        std::shared_ptr<wrapped_type>
+        borrowReadHandle(offset_type offset) const;
+
+        /**
+         * Get the content of the file mapped into memory.
+         *
+         * If libtiff mapped the file when it was opened for reading
+         * (the default for mode "r"; mode "rm" disables mapping), the
+         * whole file is mapped again on first use, and the mapping
+         * kept until the file is closed.  Uncompressed pixel data may
+         * then be used in place without reading it.
+         *
+         * @param size the size of the mapping (bytes), or zero if the
+         * file is not mapped.
+         * @returns the start of the mapping, or null if the file is
+         * not mapped, was opened for writing, or was opened from a
+         * ByteSource.
+         */
+        const uint8_t *
+        getMappedData(uint64_t& size) const;
+
+        /**
+         * Enable or disable the sidecar directory index.
+         *
+         * When enabled, the directory offsets are loaded from a
+         * sidecar file alongside the TIFF file (see
+         * directoryIndexPath()) instead of walking the directory
+         * chain, provided that the size and modification time of the
+         * TIFF file are unchanged since it was written.  If the
+         * sidecar is missing or out of date, the directories are
+         * walked and a new sidecar is written if possible.  This only
+         * has an effect if set before the directories are first
+         * accessed.  Disabled by default.
+         *
+         * @param sidecar @c true to use a sidecar index, @c false
+         * otherwise.
+         */
+        void
+        setIndexSidecar(bool sidecar);
+
+        /**
+         * Check if the sidecar directory index is enabled.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getIndexSidecar() const;
+
+        /**
+         * Get the directory offsets.
+         *
+         * The offsets are indexed first if not already indexed.
+         *
+         * @returns the offset of each directory, in directory order.
+         */
+        std::vector<offset_type>
+        getDirectoryOffsets() const;
+
+        /**
+         * Set the directory offsets.
+         *
+         * Use directory offsets previously obtained with
+         * getDirectoryOffsets() instead of walking the directory
+         * chain.  The offsets are only used if the file is open for
+         * reading, the directories have not yet been indexed, and
+         * the first offset is the offset of the first directory of
+         * the file; otherwise they are ignored.
+         *
+         * @param offsets the directory offsets.
+         * @returns @c true if the offsets were used, @c false if
+         * ignored.
+         */
+        bool
+        setDirectoryOffsets(const std::vector<offset_type>& offsets);
+
+        /**
+         * Set the decoded tile cache.
+         *
+         * When reading an image region, IFD::readImage() will look
+         * up each tile in this cache before decoding it, and insert
+         * newly decoded tiles into the cache.  The cache may be
+         * shared between several TIFF instances.  Any tiles
+         * belonging to this TIFF are removed from the cache when it
+         * is closed.  The cache is only used for files opened for
+         * reading.
+         *
+         * @param cache the tile cache, or null to disable caching.
+         */
+        void
+        setTileCache(std::shared_ptr<DecodedTileCache> cache);
+
+        /**
+         * Get the decoded tile cache.
+         *
+         * @returns the tile cache, or null if caching is disabled.
+         */
+        const std::shared_ptr<DecodedTileCache>&
+        getTileCache() const;
+
+        /**
+         * Get the file identity.
+         *
+         * The identity of a file opened for reading by filename is
+         * derived from its canonical path, size and modification
+         * time (see SharedTileCache::fileIdentity()), and is used to
+         * share decoded tiles between processes.
+         *
+         * @returns the file identity, or zero if the TIFF was opened
+         * for writing, opened from a ByteSource, or the file could
+         * not be examined.
+         */
+        uint64_t
+        getFileIdentity() const;
+
+        /**
+         * Get a cached lookup table.
+         *
+         * IFD::getLookupTable() caches the lookup table of each
+         * directory here, so that the COLORMAP tag is only read once
+         * however many IFD instances are used for the directory.
+         *
+         * @param offset the directory offset.
+         * @returns the lookup table, or null if not cached.
+         */
+        std::shared_ptr<const std::vector<uint16_t>>
+        getCachedLookupTable(offset_type offset) const;
+
+        /**
+         * Cache a lookup table.
+         *
+         * @param offset the directory offset.
+         * @param table the lookup table.
+         */
+        void
+        cacheLookupTable(offset_type                                  offset,
+                         std::shared_ptr<const std::vector<uint16_t>> table) const;
+
+        /**
+         * Get cached codec tables.
+         *
+         * The tables shared by the tiles of each directory (such as
+         * JPEGTables) are cached here when decoding with a codec
+         * plugin, so that they are only read once, and so that the
+         * plugin is passed the same tables for every tile.
+         *
+         * @param offset the directory offset.
+         * @returns the tables (empty if the directory has none), or
+         * null if not cached.
+         */
+        std::shared_ptr<const std::vector<uint8_t>>
+        getCachedCodecTables(offset_type offset) const;
+
+        /**
+         * Cache codec tables.
+         *
+         * @param offset the directory offset.
+         * @param tables the tables.
+         */
+        void
+        cacheCodecTables(offset_type                                 offset,
+                         std::shared_ptr<const std::vector<uint8_t>> tables) const;
+
+        /**
+         * Set the pixel statistics sink.
+         *
+         * When set, IFD::readImage() and IFD::writeImage() accumulate
+         * statistics for the pixels of each tile as it is
+         * transferred to or from the pixel buffer, avoiding a
+         * separate pass over the pixel data.  Statistics are
+         * accumulated per sample (subchannel) for every pixel
+         * transferred, so overlapping regions are counted each time
+         * they are read or written; use PixelStatistics::reset() to
+         * start accumulating for a new plane.  The sink may be
+         * shared between several TIFF instances.
+         *
+         * @param statistics the statistics sink, or null to disable
+         * statistics.
+         */
+        void
+        setStatistics(std::shared_ptr<PixelStatistics> statistics);
+
+        /**
+         * Get the pixel statistics sink.
+         *
+         * @returns the statistics sink, or null if disabled.
+         */
+        const std::shared_ptr<PixelStatistics>&
+        getStatistics() const;
+
+        /**
+         * Enable or disable normalization of floating point samples.
+         *
+         * When enabled, IFD::readImage() scales @c float and @c
+         * double samples to the range [0, 1] as each tile is
+         * transferred to the pixel buffer, avoiding a separate pass
+         * over the pixel data.  Every tile of a directory is scaled
+         * with the same range, from IFD::getNormalizationRange(), so
+         * that the values do not depend on the region read.  Values
+         * outside the range are clamped, and NaN is kept.  Disabled
+         * by default.
+         *
+         * @param normalized @c true to normalize, @c false otherwise.
+         */
+        void
+        setNormalized(bool normalized);
+
+        /**
+         * Check if floating point samples are normalized.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getNormalized() const;
+
+        /**
+         * Set the I/O statistics.
+         *
+         * When set, directory reads, tile decoding and encoding,
+         * tile cache use, pixel copying and lock waits for this file
+         * are recorded.  The statistics may be shared between
+         * several TIFF instances.
+         *
+         * @param statistics the I/O statistics, or null to disable
+         * recording.
+         */
+        void
+        setIOStatistics(std::shared_ptr<IOStatistics> statistics);
+
+        /**
+         * Get the I/O statistics.
+         *
+         * @returns the I/O statistics, or null if disabled.
+         */
+        const std::shared_ptr<IOStatistics>&
+        getIOStatistics() const;
+
+        /**
+         * Set the write tile cache limit.
+         *
+         * When writing an image, IFD::writeImage() caches each tile
+         * until it is completely covered, and then writes out the
+         * completed tiles in order.  If tiles are completed out of
+         * order, the completed tiles wait in the cache until all the
+         * preceding tiles are complete, which may require caching
+         * most of the image.  If a limit is set, completed tiles are
+         * also written out of order, lowest index first, whenever the
+         * cached tiles exceed this size.  Tiles which are only
+         * partially covered are not written, and so the cache may
+         * still exceed the limit if many tiles are incomplete.
+         *
+         * @param limit the limit in bytes, or @c 0 for no limit (the
+         * default; tiles are always written in order).
+         */
+        void
+        setWriteCacheLimit(dimension_size_type limit);
+
+        /**
+         * Get the write tile cache limit.
+         *
+         * @returns the limit in bytes, or @c 0 for no limit.
+         */
+        dimension_size_type
+        getWriteCacheLimit() const;
+
+        /**
+         * Set the streaming write window.
+         *
+         * When writing a file much larger than memory, the written
+         * data fills the page cache, evicting data used by other
+         * processes, and writes stall whenever the kernel writes
+         * back the accumulated dirty pages.  If a window is set,
+         * writeback of each completed window of the file is started
+         * as soon as the window is written, and the preceding
+         * window is dropped from the page cache once it has been
+         * written back.  This keeps the cached data for the file to
+         * about two windows, and keeps the write rate steady.  The
+         * data is only released after pixel data or a directory is
+         * written; see streamWritten().  This has no effect for
+         * files opened for reading, or on Windows.
+         *
+         * @param window the window size in bytes (rounded up to a
+         * multiple of 1 MiB), or @c 0 to leave written data cached
+         * (the default).
+         */
+        void
+        setStreamingWrites(dimension_size_type window);
+
+        /**
+         * Get the streaming write window.
+         *
+         * @returns the window size in bytes, or @c 0 if disabled.
+         */
+        dimension_size_type
+        getStreamingWrites() const;
+
+        /**
+         * Release written data from the page cache.
+         *
+         * If a streaming write window is set, start writeback of any
+         * newly completed windows, and drop the preceding windows
+         * from the page cache.  This is called by IFD after writing
+         * pixel data, and after writing each directory; it does
+         * nothing if streaming writes are disabled.
+         *
+         * @throws an Exception if writeback fails.
+         */
+        void
+        streamWritten();
+
+        /**
+         * Set whether compact directories are written.
+         *
+         * If enabled, tags which are the same for every directory
+         * and are not needed to read the image, such as Software,
+         * are only written to the first directory.  This reduces the
+         * size of files containing many small images.
+         *
+         * @param compact @c true to write compact directories, @c
+         * false to write complete directories (the default).
+         */
+        void
+        setCompactDirectories(bool compact);
+
+        /**
+         * Check if compact directories are written.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getCompactDirectories() const;
+
+        /**
+         * Set whether sparse tiles are written.
+         *
+         * If enabled, tiles and strips written with IFD::writeImage()
+         * or IFD::writeTile() which contain only zeros are left out
+         * of the file, with a byte count and offset of zero, as for
+         * GDAL's SPARSE_OK option.  This greatly reduces the size of
+         * mostly empty images such as labels and masks.  Sparse
+         * tiles are always read as zero, whether or not this is
+         * enabled; other TIFF readers may not support them.
+         *
+         * @param sparse @c true to leave out empty tiles, @c false to
+         * write every tile (the default).
+         */
+        void
+        setSparseTiles(bool sparse);
+
+        /**
+         * Check if sparse tiles are written.
+         *
+         * @returns @c true if enabled, @c false otherwise.
+         */
+        bool
+        getSparseTiles() const;
+
+        /**
+         * Set the tile deduplication limit.
+         *
+         * If set, the encoded data of each tile and strip written
+         * with IFD::writeImage() is compared with the tiles already
+         * written to the file, and if identical data has already
+         * been written (in any directory), the tile refers to the
+         * existing data rather than writing it again.  This reduces
+         * the size of images with many identical tiles, such as the
+         * background of stitched mosaics.  The data of recently
+         * written tiles is held in memory for comparison, up to the
+         * specified limit.  Tiles encoded by libtiff are only
+         * deduplicated if they may be encoded independently (see
+         * setEncodeThreads()); tiles written with
+         * IFD::writeRawTile() are never deduplicated.
+         *
+         * @param limit the maximum size of the tile data held for
+         * comparison, in bytes, or @c 0 to disable deduplication
+         * (the default).
+         */
+        void
+        setTileDeduplication(dimension_size_type limit);
+
+        /**
+         * Get the tile deduplication limit.
+         *
+         * @returns the limit in bytes, or @c 0 if disabled.
+         */
+        dimension_size_type
+        getTileDeduplication() const;
+
+        /**
+         * Find identical tile data already written.
+         *
+         * @param data the encoded tile data.
+         * @param offset set to the file offset of the identical data
+         * if found.
+         * @returns @c true if found, or @c false if not found or
+         * deduplication is disabled.
+         */
+        bool
+        findDuplicateTile(const std::vector<uint8_t>& data,
+                          offset_type&                offset);
+
+        /**
+         * Record tile data written.
+         *
+         * Does nothing if deduplication is disabled.
+         *
+         * @param data the encoded tile data.
+         * @param offset the file offset the data was written at.
+         */
+        void
+        addWrittenTile(const std::vector<uint8_t>& data,
+                       offset_type                 offset);
+
+        /**
+         * Set the tile hashes to record.
+         *
+         * If set, a hash (see tileHash()) of each tile and strip
+         * written with IFD::writeImage(), IFD::writeTile() or
+         * IFD::writeRawTile() is recorded, and stored in private
+         * tags of the directory when it is written; they may be read
+         * with IFD::getTileHashes().  Encoded hashes are of the data
+         * as stored in the file, and are computed from the encoded
+         * tiles in memory as they are written, so that checking
+         * the integrity of a file or finding the tiles which differ
+         * between two files (to copy only those with
+         * IFD::readRawTile() and IFD::writeRawTile()) requires no
+         * decoding.  Decoded hashes are of the uncompressed tile
+         * data, and so do not depend upon the compression scheme.
+         *
+         * The hash of a tile which is not recorded is zero.  This is
+         * the case for sparse tiles, for tiles written raw (decoded
+         * hashes only), and for tiles encoded by libtiff which can
+         * not be encoded separately from their directory, such as
+         * JPEG without a codec plugin (encoded hashes only).
+         *
+         * @param hashes a combination of TileHash values, or @c 0 to
+         * record none (the default).
+         */
+        void
+        setTileHashes(unsigned int hashes);
+
+        /**
+         * Get the tile hashes to record.
+         *
+         * @returns a combination of TileHash values, or @c 0 if
+         * none are recorded.
+         */
+        unsigned int
+        getTileHashes() const;
+
+        /**
+         * Record the hash of a tile of the current directory.
+         *
+         * Does nothing if hashes of this type are not recorded.
+         *
+         * @param type the type of hash.
+         * @param tile the tile (or strip) index.
+         * @param hash the hash.
+         */
+        void
+        addTileHash(TileHash            type,
+                    dimension_size_type tile,
+                    uint64_t            hash);
+
+        /**
+         * Set whether tile summaries are recorded.
+         *
+         * If enabled, the minimum, maximum and number of nonzero
+         * values (see TileSummary) of each tile and strip written
+         * with IFD::writeImage() or IFD::writeTile() are recorded as
+         * the pixels are transferred into the tiles, and stored in a
+         * private tag of the directory when it is written.  They may
+         * be read with IFD::getTileSummaries(), and are used by
+         * IFD::forEachTileInRange() to skip tiles which can not
+         * contain any value of interest without decoding them.
+         * Tiles written with IFD::writeRawTile() are recorded as
+         * unknown, and so are never skipped.
+         *
+         * @param summaries @c true to record summaries, @c false to
+         * record none (the default).
+         */
+        void
+        setTileSummaries(bool summaries);
+
+        /**
+         * Get whether tile summaries are recorded.
+         *
+         * @returns @c true if summaries are recorded, @c false
+         * otherwise.
+         */
+        bool
+        getTileSummaries() const;
+
+        /**
+         * Record a summary of part of a tile of the current directory.
+         *
+         * The summary is merged with any previously recorded for the
+         * tile.  Does nothing if summaries are not recorded.
+         *
+         * @param tile the tile (or strip) index.
+         * @param summary the summary.
+         */
+        void
+        addTileSummary(dimension_size_type tile,
+                       const TileSummary&  summary);
+
+        /**
+         * Set the number of sub-resolutions to write.
+         *
+         * If set, each directory written using IFD::writeImage() is
+         * followed by the specified number of sub-resolutions, each
+         * downsampled by a factor of two from the preceding
+         * resolution, and stored as SubIFDs of the directory.  The
+         * sub-resolutions are generated as the full-resolution tiles
+         * are written; see SubResolutionWriter.  Tiles written with
+         * IFD::writeRawTile() are not downsampled.
+         *
+         * @param levels the number of sub-resolutions, or @c 0 for
+         * none (the default).
+         * @param method the downsampling method.
+         */
+        void
+        setSubResolutions(dimension_size_type levels,
+                          Downsampling        method = DOWNSAMPLE_MEAN);
+
+        /**
+         * Get the number of sub-resolutions to write.
+         *
+         * @returns the number of sub-resolutions, or @c 0 for none.
+         */
+        dimension_size_type
+        getSubResolutions() const;
+
+        /**
+         * Get the sub-resolution downsampling method.
+         *
+         * @returns the downsampling method.
+         */
+        Downsampling
+        getDownsampling() const;
+
+        /**
+         * Get the sub-resolution writer for the current directory.
+         *
+         * The writer is created on first use, from the tags of the
+         * specified directory, and is used to write the
+         * sub-resolutions when the directory is written.
+         *
+         * @param ifd the current directory.
+         * @returns the writer, or null if sub-resolutions are not
+         * enabled.
+         */
+        std::shared_ptr<SubResolutionWriter>
+        getSubResolutionWriter(const IFD& ifd);
+
         /// IFD uses internal TIFF state.
         friend class IFD;
 
@@ -334,6 +1129,10 @@ namespace ome
         /// Register ImageJ tags with libtiff for this image.
         void
         registerImageJTags();
+
+        /// Register tile hash and summary tags with libtiff for this image.
+        void
+        registerTileHashTags();
       };
 
     }
@@ -35,6 +35,10 @@
  * #L%
  */
 
+#include <algorithm>
+#include <stdexcept>
+
+#include <ome/files/detail/tiff/JPEGCodec.h>
 #include <ome/files/tiff/Field.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/Tags.h>
@@ -47,6 +51,7 @@
 #include <tiffio.h>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
 
 namespace ome
 {
@@ -83,6 +88,8 @@ namespace ome
         dimension_size_type ntiles;
         /// Buffer size for a tile.
         tsize_t buffersize;
+        /// Region covered by each tile of a sample.
+        std::vector<PlaneRegion> regions;
 
         /**
          * Constructor.
@@ -99,9 +106,10 @@ namespace ome
           nrows(),
           ncols(),
           ntiles(),
-          buffersize()
+          buffersize(),
+          regions()
         {
-          Sentry sentry;
+          Sentry sentry(*ifd->getTIFF(), IOStatistics::LOCK_TAG);
           ::TIFF *tiff = getTIFF();
 
           // Get basic image metadata.
@@ -113,6 +121,11 @@ namespace ome
           tileheight = ifd->getTileHeight();
           type = ifd->getTileType();
 
+          // JPEG-compressed YCbCr tiles are read as RGB, so their
+          // size is that of the upsampled tile.  The directory of
+          // a newly opened TIFF has not been set by makeCurrent().
+          detail::setRGBColorMode(tiff);
+
           // Get tile-specific metadata, falling back to
           // strip-specific metadata if not present.
           if (type == TILE)
@@ -134,6 +147,14 @@ namespace ome
           if (imagewidth % tilewidth)
             ++ncols;
           ntiles = nrows * ncols;
+
+          // Precompute the tile regions, which are the same for all
+          // samples.
+          regions.reserve(ntiles);
+          for (dimension_size_type row = 0; row < nrows; ++row)
+            for (dimension_size_type col = 0; col < ncols; ++col)
+              regions.push_back(PlaneRegion(col * tilewidth, row * tileheight,
+                                            tilewidth, tileheight));
         }
 
         /// Destructor.
@@ -172,6 +193,38 @@ namespace ome
         }
       };
 
+      dimension_size_type
+      TileGrid::count() const
+      {
+        return rows * columns;
+      }
+
+      PlaneRegion
+      TileGrid::region(dimension_size_type row,
+                       dimension_size_type column) const
+      {
+        if (row >= rows || column >= columns)
+          {
+            boost::format fmt("Tile row %1% column %2% out of range (%3%×%4% tiles)");
+            fmt % row % column % rows % columns;
+            throw std::logic_error(fmt.str());
+          }
+
+        return PlaneRegion(column * tileWidth, row * tileHeight, tileWidth, tileHeight) &
+          PlaneRegion(0U, 0U, imageWidth, imageHeight);
+      }
+
+      std::vector<PlaneRegion>
+      TileGrid::regions() const
+      {
+        std::vector<PlaneRegion> ret;
+        ret.reserve(count());
+        for (dimension_size_type row = 0; row < rows; ++row)
+          for (dimension_size_type column = 0; column < columns; ++column)
+            ret.push_back(region(row, column));
+        return ret;
+      }
+
       TileInfo::TileInfo(std::shared_ptr<IFD> ifd):
         impl(std::shared_ptr<Impl>(new Impl(ifd)))
       {
@@ -217,6 +270,22 @@ namespace ome
         return impl->ncols;
       }
 
+      TileGrid
+      TileInfo::tileGrid() const
+      {
+        std::shared_ptr<IFD> ifd(impl->getIFD());
+
+        TileGrid grid;
+        grid.type = impl->type;
+        grid.imageWidth = ifd->getImageWidth();
+        grid.imageHeight = ifd->getImageHeight();
+        grid.tileWidth = impl->tilewidth;
+        grid.tileHeight = impl->tileheight;
+        grid.rows = impl->nrows;
+        grid.columns = impl->ncols;
+        return grid;
+      }
+
       dimension_size_type
       TileInfo::bufferSize() const
       {
@@ -228,7 +297,7 @@ namespace ome
                           dimension_size_type y,
                           dimension_size_type s) const
       {
-        Sentry sentry;
+        Sentry sentry(*impl->getIFD()->getTIFF(), IOStatistics::LOCK_TAG);
         ::TIFF *tiff = impl->getTIFF();
 
         return TIFFComputeTile(tiff, x, y, 0, s);
@@ -263,14 +332,7 @@ namespace ome
       PlaneRegion
       TileInfo::tileRegion(dimension_size_type index) const
       {
-        // Compute origin of tile from its row and column
-        dimension_size_type row = tileRow(index);
-        dimension_size_type col = tileColumn(index);
-
-        dimension_size_type x = col * impl->tilewidth;
-        dimension_size_type y = row * impl->tileheight;
-
-        return PlaneRegion(x, y, impl->tilewidth, impl->tileheight);
+        return impl->regions[index % impl->ntiles]; // zeroth sample
       }
 
       PlaneRegion
@@ -284,36 +346,53 @@ namespace ome
       std::vector<dimension_size_type>
       TileInfo::tileCoverage(PlaneRegion region) const
       {
-        std::vector<dimension_size_type> ret;
+        TileRange range(tileRange(region));
 
+        return std::vector<dimension_size_type>(range.begin(), range.end());
+      }
+
+      TileRange
+      TileInfo::tileRange(const PlaneRegion& region) const
+      {
         dimension_size_type samplelimit = 1;
         if (impl->planarconfig == SEPARATE) // planar
           samplelimit = impl->samples;
 
-        // Iterate over all samples
-        for (dimension_size_type sample = 0; sample < samplelimit; ++sample)
-          {
-            // Compute row and column subrange for the covered region
-            dimension_size_type tile1 = tileIndex(region.x,                region.y,                sample);
-            dimension_size_type tile2 = tileIndex(region.x + region.w - 1, region.y,                sample);
-            dimension_size_type tile3 = tileIndex(region.x,                region.y + region.h - 1, sample);
-
-            dimension_size_type colstart = tileColumn(tile1);
-            dimension_size_type collimit = tileColumn(tile2) + 1;
-            dimension_size_type rowstart = tileRow(tile1);
-            dimension_size_type rowlimit = tileRow(tile3) + 1;
-
-            // Iterate over row and column subranges
-            for (dimension_size_type row = rowstart; row < rowlimit; ++row)
-              for (dimension_size_type col = colstart; col < collimit; ++col)
-                {
-                  // Compute tile index for the row/column/sample indexes
-                  dimension_size_type index = (sample * impl->ntiles) + (row * impl->ncols) + col;
-                  ret.push_back(index);
-                }
-          }
+        return sampleRange(region, 0, samplelimit);
+      }
 
-        return ret;
+      TileRange
+      TileInfo::tileRange(const PlaneRegion& region,
+                          dimension_size_type sample) const
+      {
+        if (impl->planarconfig != SEPARATE) // contiguous
+          return sampleRange(region, 0, 1);
+
+        if (sample >= impl->samples)
+          return TileRange();
+
+        return sampleRange(region, sample, sample + 1);
+      }
+
+      TileRange
+      TileInfo::sampleRange(const PlaneRegion& region,
+                            dimension_size_type samplestart,
+                            dimension_size_type samplelimit) const
+      {
+        if (!region.valid() || !impl->ntiles)
+          return TileRange();
+
+        // Compute row and column subrange for the covered region,
+        // clamped to the image (as for TIFFComputeTile).
+        dimension_size_type colstart = std::min(region.x / impl->tilewidth, impl->ncols - 1);
+        dimension_size_type collimit = std::min((region.x + region.w - 1) / impl->tilewidth, impl->ncols - 1) + 1;
+        dimension_size_type rowstart = std::min(region.y / impl->tileheight, impl->nrows - 1);
+        dimension_size_type rowlimit = std::min((region.y + region.h - 1) / impl->tileheight, impl->nrows - 1) + 1;
+
+        return TileRange(impl->ntiles, impl->ncols,
+                         samplestart, samplelimit,
+                         rowstart, rowlimit,
+                         colstart, collimit);
       }
 
     }
@@ -38,7 +38,10 @@
 #ifndef OME_FILES_TIFF_TILEINFO_H
 #define OME_FILES_TIFF_TILEINFO_H
 
+#include <cstddef>
+#include <iterator>
 #include <memory>
+#include <vector>
 
 #include <ome/files/PlaneRegion.h>
 #include <ome/files/tiff/Types.h>
@@ -52,6 +55,321 @@ namespace ome
 
       class IFD;
 
+      /**
+       * Range of the tiles covering an image region.
+       *
+       * The tile indexes are ordered by sample, row and column, and
+       * are computed from the covered sample, row and column bounds
+       * as the range is iterated, so no list of tile indexes needs to
+       * be stored.
+       */
+      class TileRange
+      {
+      public:
+        /// Forward iterator over the tile indexes.
+        class const_iterator
+        {
+        public:
+          /// Iterator category.
+          typedef std::forward_iterator_tag iterator_category;
+          /// Value type.
+          typedef dimension_size_type value_type;
+          /// Difference type.
+          typedef std::ptrdiff_t difference_type;
+          /// Pointer type.
+          typedef const dimension_size_type *pointer;
+          /// Reference type.
+          typedef dimension_size_type reference;
+
+          /**
+           * Constructor.
+           *
+           * @param range the range to iterate over.
+           * @param sample the current sample.
+           * @param row the current row.
+           * @param col the current column.
+           */
+          const_iterator(const TileRange&    range,
+                         dimension_size_type sample,
+                         dimension_size_type row,
+                         dimension_size_type col):
+            range(&range),
+            sample(sample),
+            row(row),
+            col(col)
+          {}
+
+          /**
+           * Get the current tile index.
+           *
+           * @returns the tile index.
+           */
+          dimension_size_type
+          operator*() const
+          {
+            return (sample * range->ntiles) + (row * range->ncols) + col;
+          }
+
+          /**
+           * Advance to the next tile.
+           *
+           * @returns the iterator.
+           */
+          const_iterator&
+          operator++()
+          {
+            if (++col == range->collimit)
+              {
+                col = range->colstart;
+                if (++row == range->rowlimit)
+                  {
+                    row = range->rowstart;
+                    ++sample;
+                  }
+              }
+            return *this;
+          }
+
+          /**
+           * Advance to the next tile.
+           *
+           * @returns the iterator prior to being advanced.
+           */
+          const_iterator
+          operator++(int)
+          {
+            const_iterator ret(*this);
+            ++*this;
+            return ret;
+          }
+
+          /**
+           * Compare iterators for equality.
+           *
+           * @param rhs the iterator to compare with.
+           * @returns @c true if equal, @c false otherwise.
+           */
+          bool
+          operator==(const const_iterator& rhs) const
+          {
+            return sample == rhs.sample && row == rhs.row && col == rhs.col;
+          }
+
+          /**
+           * Compare iterators for inequality.
+           *
+           * @param rhs the iterator to compare with.
+           * @returns @c true if not equal, @c false otherwise.
+           */
+          bool
+          operator!=(const const_iterator& rhs) const
+          {
+            return !(*this == rhs);
+          }
+
+        private:
+          /// The range being iterated over.
+          const TileRange *range;
+          /// Current sample.
+          dimension_size_type sample;
+          /// Current row.
+          dimension_size_type row;
+          /// Current column.
+          dimension_size_type col;
+        };
+
+        /**
+         * Construct an empty range.
+         */
+        TileRange():
+          ntiles(0),
+          ncols(0),
+          samplestart(0),
+          samplelimit(0),
+          rowstart(0),
+          rowlimit(0),
+          colstart(0),
+          collimit(0)
+        {}
+
+        /**
+         * Constructor.
+         *
+         * If any of the sample, row or column subranges are empty,
+         * the range will be empty.
+         *
+         * @param ntiles the number of tiles per sample.
+         * @param ncols the number of tiles per row.
+         * @param samplestart the first sample.
+         * @param samplelimit the sample limit (one past the last sample).
+         * @param rowstart the first row.
+         * @param rowlimit the row limit (one past the last row).
+         * @param colstart the first column.
+         * @param collimit the column limit (one past the last column).
+         */
+        TileRange(dimension_size_type ntiles,
+                  dimension_size_type ncols,
+                  dimension_size_type samplestart,
+                  dimension_size_type samplelimit,
+                  dimension_size_type rowstart,
+                  dimension_size_type rowlimit,
+                  dimension_size_type colstart,
+                  dimension_size_type collimit):
+          ntiles(ntiles),
+          ncols(ncols),
+          samplestart(samplestart),
+          samplelimit(samplelimit),
+          rowstart(rowstart),
+          rowlimit(rowlimit),
+          colstart(colstart),
+          collimit(collimit)
+        {
+          if (samplestart >= samplelimit ||
+              rowstart >= rowlimit ||
+              colstart >= collimit)
+            *this = TileRange();
+        }
+
+        /**
+         * Get an iterator to the first tile.
+         *
+         * @returns the iterator.
+         */
+        const_iterator
+        begin() const
+        {
+          return const_iterator(*this, samplestart, rowstart, colstart);
+        }
+
+        /**
+         * Get an iterator past the last tile.
+         *
+         * @returns the iterator.
+         */
+        const_iterator
+        end() const
+        {
+          return const_iterator(*this, samplelimit, rowstart, colstart);
+        }
+
+        /**
+         * Get the number of tiles in the range.
+         *
+         * @returns the tile count.
+         */
+        dimension_size_type
+        size() const
+        {
+          return (samplelimit - samplestart) * (rowlimit - rowstart) * (collimit - colstart);
+        }
+
+        /**
+         * Check if the range is empty.
+         *
+         * @returns @c true if empty, @c false otherwise.
+         */
+        bool
+        empty() const
+        {
+          return size() == 0;
+        }
+
+        /**
+         * Get a tile index by its position in the range.
+         *
+         * @param i the position in the range; must be less than size().
+         * @returns the tile index.
+         */
+        dimension_size_type
+        operator[](dimension_size_type i) const
+        {
+          dimension_size_type cols = collimit - colstart;
+          dimension_size_type perplane = (rowlimit - rowstart) * cols;
+          dimension_size_type sample = samplestart + (i / perplane);
+          i %= perplane;
+          dimension_size_type row = rowstart + (i / cols);
+          dimension_size_type col = colstart + (i % cols);
+          return (sample * ntiles) + (row * ncols) + col;
+        }
+
+      private:
+        /// Tiles per sample.
+        dimension_size_type ntiles;
+        /// Tiles per row.
+        dimension_size_type ncols;
+        /// First sample.
+        dimension_size_type samplestart;
+        /// Sample limit.
+        dimension_size_type samplelimit;
+        /// First row.
+        dimension_size_type rowstart;
+        /// Row limit.
+        dimension_size_type rowlimit;
+        /// First column.
+        dimension_size_type colstart;
+        /// Column limit.
+        dimension_size_type collimit;
+      };
+
+      /**
+       * Native tile grid of an image.
+       *
+       * This describes the layout of the tiles (or strips) of an
+       * image, so that reads may be scheduled to align with them.
+       * Tiles are numbered in row-major order, as for the tiles of
+       * the zeroth sample in TileInfo.  Unlike TileInfo, this is a
+       * plain value which does not refer to its IFD.
+       */
+      struct TileGrid
+      {
+        /// Tiles or strips.
+        TileType type;
+        /// Image width.
+        dimension_size_type imageWidth;
+        /// Image height.
+        dimension_size_type imageHeight;
+        /// Tile width (the image width for strips).
+        dimension_size_type tileWidth;
+        /// Tile height (the rows per strip for strips).
+        dimension_size_type tileHeight;
+        /// Number of rows of tiles.
+        dimension_size_type rows;
+        /// Number of columns of tiles.
+        dimension_size_type columns;
+
+        /**
+         * Get the number of tiles.
+         *
+         * @returns the tile count (per sample).
+         */
+        dimension_size_type
+        count() const;
+
+        /**
+         * Get the region covered by a tile.
+         *
+         * The region is clipped to the image, so tiles in the last
+         * row and column may be smaller than the tile size.
+         *
+         * @param row the tile row.
+         * @param column the tile column.
+         * @returns the region.
+         * @throws std::logic_error if the row or column is out of
+         * range.
+         */
+        PlaneRegion
+        region(dimension_size_type row,
+               dimension_size_type column) const;
+
+        /**
+         * Get the regions covered by all tiles.
+         *
+         * @returns the clipped regions, in row-major order.
+         */
+        std::vector<PlaneRegion>
+        regions() const;
+      };
+
       /**
        * Tile information for an IFD.
        *
@@ -123,6 +441,14 @@ namespace ome
         dimension_size_type
         tileColumnCount() const;
 
+        /**
+         * Get the tile grid.
+         *
+         * @returns the tile grid.
+         */
+        TileGrid
+        tileGrid() const;
+
         /**
          * Get the buffer size needed to contain a single tile.
          *
@@ -225,6 +551,55 @@ namespace ome
         std::vector<dimension_size_type>
         tileCoverage(PlaneRegion region) const;
 
+        /**
+         * Get the range of the tiles covering an image region.
+         *
+         * This is equivalent to tileCoverage(), but the tile indexes
+         * are computed as the range is iterated rather than being
+         * stored, which avoids a large allocation for regions
+         * covering many tiles.
+         *
+         * @note The tiles may extend outside the specified region,
+         * and the same area may be covered by multiple tiles if the
+         * samples are planar.
+         *
+         * @param region the image region to cover.
+         * @returns the range of tile indexes.
+         */
+        TileRange
+        tileRange(const PlaneRegion& region) const;
+
+        /**
+         * Get the range of the tiles covering an image region for a
+         * single sample.
+         *
+         * For planar images, only the tiles of the specified sample
+         * are included.  For contiguous images, the tiles contain all
+         * samples, and the range is the same as for tileRange().
+         *
+         * @param region the image region to cover.
+         * @param sample the sample to cover.
+         * @returns the range of tile indexes.
+         */
+        TileRange
+        tileRange(const PlaneRegion& region,
+                  dimension_size_type sample) const;
+
+      private:
+        /**
+         * Get the range of the tiles covering an image region for a
+         * range of samples.
+         *
+         * @param region the image region to cover.
+         * @param samplestart the first sample.
+         * @param samplelimit the sample limit (one past the last sample).
+         * @returns the range of tile indexes.
+         */
+        TileRange
+        sampleRange(const PlaneRegion& region,
+                    dimension_size_type samplestart,
+                    dimension_size_type samplelimit) const;
+
       protected:
         class Impl;
         /// Private implementation details.
@@ -38,7 +38,10 @@
 #ifndef OME_FILES_TIFF_TYPES_H
 #define OME_FILES_TIFF_TYPES_H
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <limits>
 
 #include <ome/files/Types.h>
 
@@ -123,7 +126,11 @@ namespace ome
           COMPRESSION_SGILOG = 34676,      ///< SGI Log Luminance RLE.
           COMPRESSION_SGILOG24 = 34677,    ///< SGI Log 24-bit packed.
           COMPRESSION_JP2000 = 34712,      ///< Leadtools JPEG2000.
-          COMPRESSION_LZMA = 34925         ///< LZMA2.
+          COMPRESSION_LERC = 34887,        ///< ESRI Lerc.
+          COMPRESSION_LZMA = 34925,        ///< LZMA2.
+          COMPRESSION_ZSTD = 50000,        ///< Zstandard.
+          COMPRESSION_WEBP = 50001,        ///< WebP.
+          COMPRESSION_JXL = 50002          ///< JPEG XL.
         };
 
       /// Extra components description.
@@ -220,6 +227,101 @@ namespace ome
           TILE   ///< Tiles.
         };
 
+      /// Method of downsampling sub-resolutions.
+      enum Downsampling
+        {
+          DOWNSAMPLE_NEAREST, ///< Nearest neighbour (top-left pixel of each 2×2 block).
+          DOWNSAMPLE_MEAN,    ///< Mean of each 2×2 block.
+          DOWNSAMPLE_MODE,    ///< Most frequent value of each 2×2 block, for label images (integer and bit samples only).
+          DOWNSAMPLE_OR       ///< Bitwise OR of each 2×2 block, for masks (integer and bit samples only).
+        };
+
+      /// Tile hashes recorded when writing.
+      enum TileHash
+        {
+          TILE_HASH_ENCODED = 1U << 0, ///< Hash of the encoded data of each tile, as stored.
+          TILE_HASH_DECODED = 1U << 1  ///< Hash of the decoded data of each tile.
+        };
+
+      /**
+       * Summary of the pixel values of a tile.
+       *
+       * Recorded for each tile when writing (see
+       * TIFF::setTileSummaries()), so that tiles which can not
+       * contain any value in a range may be skipped when reading.
+       * The summary covers every sample of the tile.  NaN values
+       * are not included in the minimum and maximum, and the
+       * magnitude is used for complex values.
+       */
+      struct TileSummary
+      {
+        /// Minimum value; NaN if unknown.
+        double min;
+        /// Maximum value; NaN if unknown.
+        double max;
+        /// Number of nonzero values.
+        uint64_t nonzero;
+        /// Number of values summarised.
+        uint64_t count;
+
+        /// Constructor (no values).
+        TileSummary():
+          min(std::numeric_limits<double>::infinity()),
+          max(-std::numeric_limits<double>::infinity()),
+          nonzero(0U),
+          count(0U)
+        {}
+
+        /**
+         * Check if the summary is known.
+         *
+         * @returns @c false if the values of the tile were not
+         * recorded, @c true otherwise.
+         */
+        bool
+        known() const
+        {
+          return !std::isnan(min) && !std::isnan(max);
+        }
+
+        /**
+         * Check if the tile may contain a value in a range.
+         *
+         * @param low the lowest value of the range.
+         * @param high the highest value of the range.
+         * @returns @c true if the summary is unknown or overlaps the
+         * closed range [@p low, @p high], @c false otherwise.
+         */
+        bool
+        overlaps(double low,
+                 double high) const
+        {
+          return !known() || (min <= high && max >= low);
+        }
+
+        /**
+         * Merge another summary of the same tile.
+         *
+         * @param other the summary to merge.
+         */
+        void
+        merge(const TileSummary& other)
+        {
+          min = std::min(min, other.min);
+          max = std::max(max, other.max);
+          nonzero += other.nonzero;
+          count += other.count;
+        }
+      };
+
+      /// Default strip or tile geometry for writing.
+      enum TilingPolicy
+        {
+          TILING_DEFAULT,      ///< Fixed 64KiB strips, or 256×256 tiles for widths of 2048 or more.
+          TILING_THROUGHPUT,   ///< Large strips for sequential whole-plane access.
+          TILING_RANDOM_ACCESS ///< Square tiles for region access.
+        };
+
     }
   }
 }
@@ -35,8 +35,15 @@
  * #L%
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 #include <ome/files/CoreMetadata.h>
 #include <ome/files/FormatException.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PixelStatistics.h>
+#include <ome/files/tiff/Exception.h>
 #include <ome/files/tiff/Field.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/Tags.h>
@@ -57,17 +64,17 @@ namespace ome
         // Scalar
         template<typename T>
         void
-        setMetadata(CoreMetadata&      core,
+        setMetadata(MetadataMap&       metadata,
                     const std::string& key,
                     const T&           value)
         {
-          core.seriesMetadata.set(key, value);
+          metadata.set(key, value);
         }
 
         // Vector
         template <typename T>
         void
-        setMetadata(CoreMetadata&         core,
+        setMetadata(MetadataMap&          metadata,
                     const std::string&    key,
                     const std::vector<T>& value)
         {
@@ -80,7 +87,7 @@ namespace ome
               if (i + 1 != value.end())
                 os << ", ";
             }
-          core.seriesMetadata.set(key, os.str());
+          metadata.set(key, os.str());
         }
 
         // Array
@@ -88,7 +95,7 @@ namespace ome
                   typename T,
                   std::size_t S>
         void
-        setMetadata(CoreMetadata&      core,
+        setMetadata(MetadataMap&       metadata,
                     const std::string& key,
                     const C<T, S>&     value)
         {
@@ -101,13 +108,13 @@ namespace ome
               if (i + 1 != value.end())
                 os << ", ";
             }
-          core.seriesMetadata.set(key, os.str());
+          metadata.set(key, os.str());
         }
 
         template<typename TagCategory>
         bool
         setMetadata(const IFD&         ifd,
-                    CoreMetadata&      core,
+                    MetadataMap&       metadata,
                     const std::string& key,
                     TagCategory        tag)
         {
@@ -119,7 +126,7 @@ namespace ome
             {
               value_type v;
               ifd.getField(tag).get(v);
-              setMetadata(core, key, v);
+              setMetadata(metadata, key, v);
               set = true;
             }
           catch (...)
@@ -129,19 +136,36 @@ namespace ome
           return set;
         }
 
+        std::vector<uint64_t>
+        subIFDOffsets(const IFD& ifd)
+        {
+          std::vector<uint64_t> offsets;
+          try
+            {
+              ifd.getField(SUBIFD).get(offsets);
+            }
+          catch (const std::exception&)
+            {
+              // No SubIFDs.
+            }
+          return offsets;
+        }
+
       }
 
       std::shared_ptr<CoreMetadata>
-      makeCoreMetadata(const IFD& ifd)
+      makeCoreMetadata(const IFD& ifd,
+                       bool       seriesMetadata)
       {
         std::shared_ptr<CoreMetadata> m(std::make_shared<CoreMetadata>());
-        getCoreMetadata(ifd, *m);
+        getCoreMetadata(ifd, *m, seriesMetadata);
         return m;
       }
 
       void
       getCoreMetadata(const IFD&    ifd,
-                      CoreMetadata& core)
+                      CoreMetadata& core,
+                      bool          seriesMetadata)
       {
         core.dimensionOrder = ome::xml::model::enums::DimensionOrder::XYCZT;
         core.sizeX = ifd.getImageWidth();
@@ -204,131 +228,139 @@ namespace ome
               }
           }
 
+        if (seriesMetadata)
+          getSeriesMetadata(ifd, core.seriesMetadata);
+      }
+
+      void
+      getSeriesMetadata(const IFD&   ifd,
+                        MetadataMap& metadata)
+      {
         // Add series metadata from tags.
-        setMetadata(ifd, core, "PageName #", PAGENAME);
-        setMetadata(ifd, core, "ImageWidth", IMAGEWIDTH);
-        setMetadata(ifd, core, "ImageLength", IMAGELENGTH);
-        setMetadata(ifd, core, "BitsPerSample", BITSPERSAMPLE);
+        setMetadata(ifd, metadata, "PageName #", PAGENAME);
+        setMetadata(ifd, metadata, "ImageWidth", IMAGEWIDTH);
+        setMetadata(ifd, metadata, "ImageLength", IMAGELENGTH);
+        setMetadata(ifd, metadata, "BitsPerSample", BITSPERSAMPLE);
 
         /// @todo EXIF IFDs
 
-        setMetadata(ifd, core, "PhotometricInterpretation", PHOTOMETRIC);
+        setMetadata(ifd, metadata, "PhotometricInterpretation", PHOTOMETRIC);
 
         /// @todo Text stream output for Tag enums.
         /// @todo Metadata type for PhotometricInterpretation.
 
         try
           {
-            setMetadata(ifd, core, "Artist", ARTIST);
+            setMetadata(ifd, metadata, "Artist", ARTIST);
             Threshholding th;
             ifd.getField(THRESHHOLDING).get(th);
-            core.seriesMetadata.set("Threshholding", th);
+            metadata.set("Threshholding", th);
             if (th == HALFTONE)
               {
-                setMetadata(ifd, core, "CellWidth", CELLWIDTH);
-                setMetadata(ifd, core, "CellLength", CELLLENGTH);
+                setMetadata(ifd, metadata, "CellWidth", CELLWIDTH);
+                setMetadata(ifd, metadata, "CellLength", CELLLENGTH);
               }
           }
         catch (...)
           {
           }
 
-        setMetadata(ifd, core, "Orientation", ORIENTATION);
+        setMetadata(ifd, metadata, "Orientation", ORIENTATION);
 
         /// @todo Image orientation (storage order and direction) from
         /// ORIENTATION; fix up width and length from orientation.
 
-        setMetadata(ifd, core, "SamplesPerPixel", SAMPLESPERPIXEL);
-        setMetadata(ifd, core, "Software", SOFTWARE);
-        setMetadata(ifd, core, "Instrument Make", MAKE);
-        setMetadata(ifd, core, "Instrument Model", MODEL);
-        setMetadata(ifd, core, "Make", MAKE);
-        setMetadata(ifd, core, "Model", MODEL);
-        setMetadata(ifd, core, "Document Name", DOCUMENTNAME);
-        setMetadata(ifd, core, "Date Time", DATETIME);
-        setMetadata(ifd, core, "Artist", ARTIST);
+        setMetadata(ifd, metadata, "SamplesPerPixel", SAMPLESPERPIXEL);
+        setMetadata(ifd, metadata, "Software", SOFTWARE);
+        setMetadata(ifd, metadata, "Instrument Make", MAKE);
+        setMetadata(ifd, metadata, "Instrument Model", MODEL);
+        setMetadata(ifd, metadata, "Make", MAKE);
+        setMetadata(ifd, metadata, "Model", MODEL);
+        setMetadata(ifd, metadata, "Document Name", DOCUMENTNAME);
+        setMetadata(ifd, metadata, "Date Time", DATETIME);
+        setMetadata(ifd, metadata, "Artist", ARTIST);
 
-        setMetadata(ifd, core, "Host Computer", HOSTCOMPUTER);
-        setMetadata(ifd, core, "Copyright", COPYRIGHT);
+        setMetadata(ifd, metadata, "Host Computer", HOSTCOMPUTER);
+        setMetadata(ifd, metadata, "Copyright", COPYRIGHT);
 
-        setMetadata(ifd, core, "Subfile Type", SUBFILETYPE);
-        setMetadata(ifd, core, "Fill Order", FILLORDER);
+        setMetadata(ifd, metadata, "Subfile Type", SUBFILETYPE);
+        setMetadata(ifd, metadata, "Fill Order", FILLORDER);
 
-        setMetadata(ifd, core, "Min Sample Value", MINSAMPLEVALUE);
-        setMetadata(ifd, core, "Max Sample Value", MAXSAMPLEVALUE);
+        setMetadata(ifd, metadata, "Min Sample Value", MINSAMPLEVALUE);
+        setMetadata(ifd, metadata, "Max Sample Value", MAXSAMPLEVALUE);
 
-        setMetadata(ifd, core, "XResolution", XRESOLUTION);
-        setMetadata(ifd, core, "YResolution", YRESOLUTION);
+        setMetadata(ifd, metadata, "XResolution", XRESOLUTION);
+        setMetadata(ifd, metadata, "YResolution", YRESOLUTION);
 
-        setMetadata(ifd, core, "Planar Configuration", PLANARCONFIG);
+        setMetadata(ifd, metadata, "Planar Configuration", PLANARCONFIG);
 
-        setMetadata(ifd, core, "XPosition", XPOSITION);
-        setMetadata(ifd, core, "YPosition", YPOSITION);
+        setMetadata(ifd, metadata, "XPosition", XPOSITION);
+        setMetadata(ifd, metadata, "YPosition", YPOSITION);
 
         /// @todo Only set if debugging/verbose.
-        // setMetadata(ifd, core, "FreeOffsets", FREEOFFSETS);
-        // setMetadata(ifd, core, "FreeByteCounts", FREEBYTECOUNTS);
+        // setMetadata(ifd, metadata, "FreeOffsets", FREEOFFSETS);
+        // setMetadata(ifd, metadata, "FreeByteCounts", FREEBYTECOUNTS);
 
-        setMetadata(ifd, core, "GrayResponseUnit", GRAYRESPONSEUNIT);
-        setMetadata(ifd, core, "GrayResponseCurve", GRAYRESPONSECURVE);
+        setMetadata(ifd, metadata, "GrayResponseUnit", GRAYRESPONSEUNIT);
+        setMetadata(ifd, metadata, "GrayResponseCurve", GRAYRESPONSECURVE);
 
         try
           {
             Compression cmpr;
             ifd.getField(COMPRESSION).get(cmpr);
-            core.seriesMetadata.set("Compression", cmpr);
+            metadata.set("Compression", cmpr);
             if (cmpr == COMPRESSION_CCITT_T4)
-              setMetadata(ifd, core, "T4Options", T4OPTIONS);
+              setMetadata(ifd, metadata, "T4Options", T4OPTIONS);
             else if (cmpr == COMPRESSION_CCITT_T6)
-              setMetadata(ifd, core, "T6Options", T6OPTIONS);
+              setMetadata(ifd, metadata, "T6Options", T6OPTIONS);
             else if (cmpr == COMPRESSION_LZW)
-              setMetadata(ifd, core, "Predictor", PREDICTOR);
+              setMetadata(ifd, metadata, "Predictor", PREDICTOR);
           }
         catch (...)
           {
           }
 
-        setMetadata(ifd, core, "ResolutionUnit", RESOLUTIONUNIT);
+        setMetadata(ifd, metadata, "ResolutionUnit", RESOLUTIONUNIT);
 
-        setMetadata(ifd, core, "PageNumber", PAGENUMBER);
+        setMetadata(ifd, metadata, "PageNumber", PAGENUMBER);
 
         // TransferRange only valid if TransferFunction set.
-        if (setMetadata(ifd, core, "TransferFunction", TRANSFERFUNCTION))
-          setMetadata(ifd, core, "TransferRange", TRANSFERRANGE);
+        if (setMetadata(ifd, metadata, "TransferFunction", TRANSFERFUNCTION))
+          setMetadata(ifd, metadata, "TransferRange", TRANSFERRANGE);
 
-        setMetadata(ifd, core, "WhitePoint", WHITEPOINT);
-        setMetadata(ifd, core, "PrimaryChromacities", PRIMARYCHROMATICITIES);
-        setMetadata(ifd, core, "HalftoneHints", HALFTONEHINTS);
+        setMetadata(ifd, metadata, "WhitePoint", WHITEPOINT);
+        setMetadata(ifd, metadata, "PrimaryChromacities", PRIMARYCHROMATICITIES);
+        setMetadata(ifd, metadata, "HalftoneHints", HALFTONEHINTS);
 
-        setMetadata(ifd, core, "TileWidth", TILEWIDTH);
-        setMetadata(ifd, core, "TileLength", TILELENGTH);
+        setMetadata(ifd, metadata, "TileWidth", TILEWIDTH);
+        setMetadata(ifd, metadata, "TileLength", TILELENGTH);
 
         /// @todo Only set if debugging/verbose.
-        // setMetadata(ifd, core, "TileOffsets", TILEOFFSETS);
-        // setMetadata(ifd, core, "TileByteCounts", TILEBYTECOUNTS);
+        // setMetadata(ifd, metadata, "TileOffsets", TILEOFFSETS);
+        // setMetadata(ifd, metadata, "TileByteCounts", TILEBYTECOUNTS);
 
-        setMetadata(ifd, core, "InkSet", INKSET);
-        setMetadata(ifd, core, "InkNames", INKNAMES);
-        setMetadata(ifd, core, "NumberOfInks", NUMBEROFINKS);
-        setMetadata(ifd, core, "DotRange", DOTRANGE);
-        setMetadata(ifd, core, "TargetPrinter", TARGETPRINTER);
-        setMetadata(ifd, core, "ExtraSamples", EXTRASAMPLES);
+        setMetadata(ifd, metadata, "InkSet", INKSET);
+        setMetadata(ifd, metadata, "InkNames", INKNAMES);
+        setMetadata(ifd, metadata, "NumberOfInks", NUMBEROFINKS);
+        setMetadata(ifd, metadata, "DotRange", DOTRANGE);
+        setMetadata(ifd, metadata, "TargetPrinter", TARGETPRINTER);
+        setMetadata(ifd, metadata, "ExtraSamples", EXTRASAMPLES);
 
-        setMetadata(ifd, core, "SampleFormat", SAMPLEFORMAT);
+        setMetadata(ifd, metadata, "SampleFormat", SAMPLEFORMAT);
 
         /// @todo sminsamplevalue
         /// @todo smaxsamplevalue
 
         /// @todo Only set if debugging/verbose.
-        // setMetadata(ifd, core, "StripOffsets", STRIPOFFSETS);
-        // setMetadata(ifd, core, "StripByteCounts", STRIPBYTECOUNTS);
+        // setMetadata(ifd, metadata, "StripOffsets", STRIPOFFSETS);
+        // setMetadata(ifd, metadata, "StripByteCounts", STRIPBYTECOUNTS);
 
         /// @todo JPEG tags
 
-        setMetadata(ifd, core, "YCbCrCoefficients", YCBCRCOEFFICIENTS);
-        setMetadata(ifd, core, "YCbCrSubSampling", YCBCRSUBSAMPLING);
-        setMetadata(ifd, core, "YCbCrPositioning", YCBCRPOSITIONING);
-        setMetadata(ifd, core, "ReferenceBlackWhite", REFERENCEBLACKWHITE);
+        setMetadata(ifd, metadata, "YCbCrCoefficients", YCBCRCOEFFICIENTS);
+        setMetadata(ifd, metadata, "YCbCrSubSampling", YCBCRSUBSAMPLING);
+        setMetadata(ifd, metadata, "YCbCrPositioning", YCBCRPOSITIONING);
+        setMetadata(ifd, metadata, "ReferenceBlackWhite", REFERENCEBLACKWHITE);
 
         try
           {
@@ -350,13 +382,13 @@ namespace ome
               {
               }
 
-            core.seriesMetadata.set("NumberOfChannels", samples);
+            metadata.set("NumberOfChannels", samples);
           }
         catch (...)
           {
           }
 
-        core.seriesMetadata.set("BitsPerSample", bitsPerPixel(ifd.getPixelType()));
+        metadata.set("BitsPerSample", bitsPerPixel(ifd.getPixelType()));
       }
 
       dimension_size_type
@@ -386,6 +418,76 @@ namespace ome
         return ifdidx;
       }
 
+      dimension_size_type
+      subResolutionCount(const IFD& ifd)
+      {
+        const std::vector<uint64_t> offsets(subIFDOffsets(ifd));
+
+        dimension_size_type count = 0U;
+        uint32_t width = ifd.getImageWidth();
+        uint32_t height = ifd.getImageHeight();
+
+        for (const auto& offset : offsets)
+          {
+            try
+              {
+                std::shared_ptr<IFD> sub(ifd.getTIFF()->getDirectoryByOffset(offset));
+                if (sub->getPixelType() != ifd.getPixelType() ||
+                    sub->getSamplesPerPixel() != ifd.getSamplesPerPixel() ||
+                    sub->getPlanarConfiguration() != ifd.getPlanarConfiguration() ||
+                    sub->getImageWidth() > width ||
+                    sub->getImageHeight() > height)
+                  break;
+                width = sub->getImageWidth();
+                height = sub->getImageHeight();
+              }
+            catch (const std::exception&)
+              {
+                break;
+              }
+            ++count;
+          }
+
+        return count;
+      }
+
+      std::shared_ptr<IFD>
+      subResolutionIFD(const IFD&          ifd,
+                       dimension_size_type resolution)
+      {
+        const std::vector<uint64_t> offsets(subIFDOffsets(ifd));
+
+        if (resolution == 0U || resolution > offsets.size())
+          {
+            boost::format fmt("Invalid sub-resolution ‘%1%’");
+            fmt % resolution;
+            throw FormatException(fmt.str());
+          }
+
+        return ifd.getTIFF()->getDirectoryByOffset(offsets.at(resolution - 1U));
+      }
+
+      uint64_t
+      tileHash(const uint8_t       *data,
+               dimension_size_type  size)
+      {
+        const uint64_t prime = 0x100000001b3ULL;
+        uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+
+        dimension_size_type i = 0;
+        for (; i + 8U <= size; i += 8U)
+          {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 29;
+          }
+        for (; i < size; ++i)
+          hash = (hash ^ data[i]) * prime;
+
+        return hash;
+      }
+
       bool
       enableBigTIFF(const boost::optional<bool>&   wantBig,
                     storage_size_type              pixelSize,
@@ -439,6 +541,312 @@ namespace ome
         return enable;
       }
 
+      namespace
+      {
+
+        /**
+         * Nominal compression ratio of a codec.
+         *
+         * Used to estimate the uncompressed chunk size for a target
+         * compressed chunk size.  These are deliberately
+         * conservative for microscopy data.
+         *
+         * @param compression the compression scheme.
+         * @returns the ratio.
+         */
+        dimension_size_type
+        nominal_compression_ratio(Compression compression)
+        {
+          switch(compression)
+            {
+            case COMPRESSION_NONE:
+              return 1U;
+            case COMPRESSION_JPEG:
+            case COMPRESSION_OJPEG:
+            case COMPRESSION_JP2000:
+              return 8U;
+            default:
+              return 2U;
+            }
+        }
+
+        /**
+         * Round a tile size down to a multiple of 16.
+         *
+         * @param size the size to round.
+         * @returns the rounded size (at least 16).
+         */
+        dimension_size_type
+        round_tile_size(dimension_size_type size)
+        {
+          return std::max(dimension_size_type(16U), size - (size % 16U));
+        }
+
+      }
+
+      TileGeometry
+      defaultTileGeometry(TilingPolicy                        policy,
+                          dimension_size_type                 sizeX,
+                          dimension_size_type                 sizeY,
+                          ::ome::xml::model::enums::PixelType pixeltype,
+                          dimension_size_type                 samples,
+                          Compression                         compression,
+                          dimension_size_type                 chunkSize)
+      {
+        if (sizeX == 0)
+          throw FormatException("Can't set strip or tile size: SizeX is 0");
+
+        TileGeometry geometry;
+
+        if (policy == TILING_DEFAULT)
+          {
+            if (sizeX < 2048)
+              {
+                // Default to strips, mainly for compatibility with
+                // readers which don't support tiles.
+                geometry.type = STRIP;
+                geometry.width = sizeX;
+                geometry.height = std::max(dimension_size_type(1U), 65536U / sizeX);
+              }
+            else
+              {
+                geometry.type = TILE;
+                geometry.width = 256U;
+                geometry.height = 256U;
+              }
+            return geometry;
+          }
+
+        if (!chunkSize)
+          chunkSize = (policy == TILING_THROUGHPUT) ? 1024U * 1024U : 64U * 1024U;
+
+        const dimension_size_type pixelBits =
+          std::max(dimension_size_type(1U), samples) * bitsPerPixel(pixeltype);
+        const dimension_size_type chunkBits =
+          chunkSize * nominal_compression_ratio(compression) * 8U;
+        const dimension_size_type rowBits = sizeX * pixelBits;
+
+        if (policy == TILING_THROUGHPUT && rowBits <= chunkBits)
+          {
+            geometry.type = STRIP;
+            geometry.width = sizeX;
+            geometry.height = std::max(dimension_size_type(1U),
+                                       std::min(std::max(sizeY, dimension_size_type(1U)),
+                                                chunkBits / rowBits));
+            // Keep partial-height strips aligned with sub-resolution
+            // tile rows.
+            if (geometry.height >= 16U && geometry.height < sizeY)
+              geometry.height = round_tile_size(geometry.height);
+            return geometry;
+          }
+
+        const dimension_size_type side =
+          round_tile_size(static_cast<dimension_size_type>
+                          (std::sqrt(static_cast<double>(chunkBits / pixelBits))));
+        geometry.type = TILE;
+        geometry.width = std::min(side, round_tile_size(sizeX + 15U));
+        geometry.height = std::min(side, round_tile_size(sizeY + 15U));
+        return geometry;
+      }
+
+      bool
+      setSampleValueRange(IFD&                   ifd,
+                          const PixelStatistics& statistics)
+      {
+        const ::ome::xml::model::enums::PixelType pixeltype(ifd.getPixelType());
+        if (pixeltype != ::ome::xml::model::enums::PixelType::BIT &&
+            pixeltype != ::ome::xml::model::enums::PixelType::UINT8 &&
+            pixeltype != ::ome::xml::model::enums::PixelType::UINT16)
+          return false;
+
+        const PixelStatistics::Sample stats(statistics.combined());
+        if (!stats.count)
+          return false;
+
+        ifd.getField(MINSAMPLEVALUE).set(static_cast<uint16_t>(stats.min));
+        ifd.getField(MAXSAMPLEVALUE).set(static_cast<uint16_t>(stats.max));
+
+        return true;
+      }
+
+      namespace
+      {
+
+        // Read an unsigned integer of the file byte order from a header.
+        uint64_t
+        headerValue(const uint8_t *data,
+                    unsigned int   size,
+                    bool           bigendian)
+        {
+          uint64_t value = 0U;
+          for (unsigned int i = 0; i < size; ++i)
+            {
+              const unsigned int shift = 8U * (bigendian ? (size - 1U - i) : i);
+              value |= static_cast<uint64_t>(data[i]) << shift;
+            }
+          return value;
+        }
+
+      }
+
+      ::ome::xml::model::enums::PixelType
+      pixelTypeFromSampleFormat(SampleFormat sampleformat,
+                                uint16_t     bits)
+      {
+        typedef ::ome::xml::model::enums::PixelType PixelType;
+
+        PixelType pt = PixelType::UINT8;
+
+        switch(sampleformat)
+          {
+          case UNSIGNED_INT:
+            {
+              // Samples of other sizes up to 16 bits are
+              // packed, and unpacked into the next larger type.
+              if (bits == 1)
+                pt = PixelType::BIT;
+              else if (bits >= 2 && bits <= 8)
+                pt = PixelType::UINT8;
+              else if (bits >= 9 && bits <= 16)
+                pt = PixelType::UINT16;
+              else if (bits == 32)
+                pt = PixelType::UINT32;
+              else
+                {
+                  boost::format fmt("Bit depth %1% unsupported for unsigned integer pixel type");
+                  fmt % bits;
+                  throw Exception(fmt.str());
+                }
+            }
+            break;
+          case SIGNED_INT:
+            {
+              if (bits == 8)
+                pt = PixelType::INT8;
+              else if (bits == 16)
+                pt = PixelType::INT16;
+              else if (bits == 32)
+                pt = PixelType::INT32;
+              else
+                {
+                  boost::format fmt("Bit depth %1% unsupported for signed integer pixel type");
+                  fmt % bits;
+                  throw Exception(fmt.str());
+                }
+            }
+            break;
+          case FLOAT:
+            {
+              // Half precision samples are converted to FLOAT.
+              if (bits == 16 || bits == 32)
+                pt = PixelType::FLOAT;
+              else if (bits == 64)
+                pt = PixelType::DOUBLE;
+              else
+                {
+                  boost::format fmt("Bit depth %1% unsupported for floating point pixel type");
+                  fmt % bits;
+                  throw Exception(fmt.str());
+                }
+            }
+            break;
+          case COMPLEX_FLOAT:
+            {
+              if (bits == 64)
+                pt = PixelType::COMPLEXFLOAT;
+              else if (bits == 128)
+                pt = PixelType::COMPLEXDOUBLE;
+              else
+                {
+                  boost::format fmt("Bit depth %1% unsupported for complex floating point pixel type");
+                  fmt % bits;
+                  throw Exception(fmt.str());
+                }
+            }
+            break;
+          default:
+            {
+              boost::format fmt("TIFF SampleFormat %1% unsupported by OME data model PixelType");
+              fmt % sampleformat;
+              throw Exception(fmt.str());
+            }
+            break;
+          }
+        return pt;
+      }
+
+      bool
+      isTIFFHeader(const uint8_t *begin,
+                   const uint8_t *end)
+      {
+        if (end - begin < 4)
+          return false;
+
+        if (begin[0] == 'I' && begin[1] == 'I')
+          return (begin[2] == 42U || begin[2] == 43U) && begin[3] == 0U;
+        if (begin[0] == 'M' && begin[1] == 'M')
+          return begin[2] == 0U && (begin[3] == 42U || begin[3] == 43U);
+        return false;
+      }
+
+      bool
+      headerDescription(const uint8_t                *begin,
+                        const uint8_t                *end,
+                        boost::optional<std::string>& description)
+      {
+        description = boost::none;
+
+        if (!isTIFFHeader(begin, end))
+          return false;
+
+        const uint64_t size = static_cast<uint64_t>(end - begin);
+        const bool bigendian = begin[0] == 'M';
+        const bool bigtiff = headerValue(begin + 2, 2U, bigendian) == 43U;
+
+        // Sizes of the first IFD offset, entry count, entry and
+        // entry value.
+        const unsigned int offsetsize = bigtiff ? 8U : 4U;
+        const unsigned int countsize = bigtiff ? 8U : 2U;
+        const unsigned int entrysize = bigtiff ? 20U : 12U;
+        const uint64_t start = bigtiff ? 8U : 4U;
+
+        if (size < start + offsetsize)
+          return false;
+        const uint64_t ifd = headerValue(begin + start, offsetsize, bigendian);
+        if (ifd > size || size - ifd < countsize)
+          return false;
+
+        const uint64_t count = headerValue(begin + ifd, countsize, bigendian);
+        if (count > (size - ifd - countsize) / entrysize)
+          return false;
+
+        for (uint64_t i = 0; i < count; ++i)
+          {
+            const uint8_t *entry = begin + ifd + countsize + (i * entrysize);
+            if (headerValue(entry, 2U, bigendian) != 270U) // ImageDescription
+              continue;
+
+            const uint64_t length = headerValue(entry + 4, offsetsize, bigendian);
+            const uint8_t *value = entry + 4 + offsetsize;
+            if (length > offsetsize)
+              {
+                const uint64_t offset = headerValue(value, offsetsize, bigendian);
+                if (offset > size || size - offset < length)
+                  return false;
+                value = begin + offset;
+              }
+
+            // Drop the terminating NUL.
+            const uint8_t *valueend = value + length;
+            valueend = std::find(value, valueend, 0U);
+            description = std::string(reinterpret_cast<const char *>(value),
+                                      reinterpret_cast<const char *>(valueend));
+            break;
+          }
+
+        return true;
+      }
+
     }
   }
 }
@@ -43,6 +43,7 @@
 #include <vector>
 
 #include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
 
 #include <ome/files/CoreMetadata.h>
 #include <ome/files/TileCoverage.h>
@@ -58,6 +59,9 @@ namespace ome
 {
   namespace files
   {
+
+    class PixelStatistics;
+
     namespace tiff
     {
 
@@ -68,20 +72,36 @@ namespace ome
        * Create CoreMetadata from an IFD.
        *
        * @param ifd the IFD to use.
+       * @param seriesMetadata @c true to also set the series
+       * metadata from the IFD tags, @c false to leave it empty.
        * @returns the CoreMetadata.
        */
       std::shared_ptr<CoreMetadata>
-      makeCoreMetadata(const IFD& ifd);
+      makeCoreMetadata(const IFD& ifd,
+                       bool       seriesMetadata = true);
 
       /**
        * Get CoreMetadata from an IFD.
        *
        * @param ifd the IFD to use.
        * @param core the CoreMetadata to set.
+       * @param seriesMetadata @c true to also set the series
+       * metadata from the IFD tags, @c false to leave it unchanged.
        */
       void
       getCoreMetadata(const IFD&    ifd,
-                      CoreMetadata& core);
+                      CoreMetadata& core,
+                      bool          seriesMetadata = true);
+
+      /**
+       * Get series metadata from IFD tags.
+       *
+       * @param ifd the IFD to use.
+       * @param metadata the metadata map to add the tag values to.
+       */
+      void
+      getSeriesMetadata(const IFD&   ifd,
+                        MetadataMap& metadata);
 
       /**
        * Range of IFDs for an image series.
@@ -115,6 +135,52 @@ namespace ome
                dimension_size_type   series,
                dimension_size_type   plane);
 
+      /**
+       * Count the sub-resolutions of an IFD.
+       *
+       * The SubIFDs of the IFD are counted as sub-resolutions while
+       * they have the same pixel type, samples per pixel and planar
+       * configuration as the IFD, and are no larger than the
+       * preceding resolution.  Counting stops at the first SubIFD
+       * which does not meet these requirements.
+       *
+       * @param ifd the full-resolution IFD.
+       * @returns the number of sub-resolutions (zero if the IFD has
+       * no SubIFDs).
+       */
+      dimension_size_type
+      subResolutionCount(const IFD& ifd);
+
+      /**
+       * Open a sub-resolution of an IFD.
+       *
+       * @param ifd the full-resolution IFD.
+       * @param resolution the resolution to open (1 is the first
+       * sub-resolution).
+       * @returns the SubIFD for the resolution.
+       * @throws FormatException if the resolution is not present.
+       */
+      std::shared_ptr<IFD>
+      subResolutionIFD(const IFD&          ifd,
+                       dimension_size_type resolution);
+
+      /**
+       * Compute the hash of tile data.
+       *
+       * This is the 64-bit hash recorded for each tile when tile
+       * hashes are enabled (see TIFF::setTileHashes()), and may be
+       * used to compare tiles with the recorded hashes.  It is a
+       * variant of FNV-1a processing eight bytes at a time; it is
+       * fast, but is not a cryptographic hash.
+       *
+       * @param data the tile data.
+       * @param size the size of @p data in bytes.
+       * @returns the hash.
+       */
+      uint64_t
+      tileHash(const uint8_t       *data,
+               dimension_size_type  size);
+
       /**
        * Check if BigTIFF should be enabled.
        *
@@ -143,6 +209,124 @@ namespace ome
                     const boost::filesystem::path& filename,
                     ome::common::Logger&           logger);
 
+      /// Strip or tile geometry.
+      struct TileGeometry
+      {
+        /// Strips or tiles.
+        TileType            type;
+        /// Tile width (image width for strips).
+        dimension_size_type width;
+        /// Tile height (rows per strip for strips).
+        dimension_size_type height;
+      };
+
+      /**
+       * Compute the default strip or tile geometry for an image.
+       *
+       * For TILING_DEFAULT, the geometry is independent of the pixel
+       * size and compression: strips of 64KiB pixels are used for
+       * widths below 2048, and 256×256 tiles otherwise.
+       *
+       * For the other policies, the chunk size in bytes before
+       * compression is estimated from the target compressed chunk
+       * size and a nominal compression ratio for the codec.
+       * TILING_THROUGHPUT uses strips of this size, falling back to
+       * square tiles when a single row exceeds it.
+       * TILING_RANDOM_ACCESS always uses square tiles of this size.
+       * Tile sizes are multiples of 16, as required by TIFF, and are
+       * no larger than the image rounded up to a multiple of 16.
+       *
+       * @param policy the tiling policy.
+       * @param sizeX the image width.
+       * @param sizeY the image height.
+       * @param pixeltype the pixel type.
+       * @param samples the number of samples per pixel in each chunk
+       * (@c 1 for separate planar configuration).
+       * @param compression the compression scheme.
+       * @param chunkSize the target compressed chunk size in bytes,
+       * or @c 0 for the policy default (1MiB for
+       * TILING_THROUGHPUT and 64KiB for TILING_RANDOM_ACCESS).
+       * @returns the geometry.
+       * @throws FormatException if @c sizeX is zero.
+       */
+      TileGeometry
+      defaultTileGeometry(TilingPolicy                        policy,
+                          dimension_size_type                 sizeX,
+                          dimension_size_type                 sizeY,
+                          ::ome::xml::model::enums::PixelType pixeltype,
+                          dimension_size_type                 samples,
+                          Compression                         compression,
+                          dimension_size_type                 chunkSize = 0U);
+
+      /**
+       * Set the sample value range of an IFD from pixel statistics.
+       *
+       * The MINSAMPLEVALUE and MAXSAMPLEVALUE tags are set to the
+       * minimum and maximum values over all samples.  These tags are
+       * unsigned 16-bit values, so are only set for the @c bit,
+       * @c uint8 and @c uint16 pixel types; the tags are not set
+       * for other pixel types, or if no values have been
+       * accumulated.
+       *
+       * @param ifd the IFD to modify.
+       * @param statistics the statistics for the pixel data of the IFD.
+       * @returns @c true if the tags were set, @c false otherwise.
+       */
+      bool
+      setSampleValueRange(IFD&                   ifd,
+                          const PixelStatistics& statistics);
+
+      /**
+       * Get the pixel type for a TIFF sample format and bit depth.
+       *
+       * Packed unsigned integer samples are unpacked into the next
+       * larger type, and half precision samples into FLOAT.
+       *
+       * @param sampleformat the sample format.
+       * @param bits the number of bits per sample.
+       * @returns the pixel type.
+       * @throws an Exception if the sample format and bit depth
+       * are not supported.
+       */
+      ::ome::xml::model::enums::PixelType
+      pixelTypeFromSampleFormat(SampleFormat sampleformat,
+                                uint16_t     bits);
+
+      /**
+       * Check if a file header is a TIFF header.
+       *
+       * The byte order mark and version of classic TIFF and BigTIFF
+       * are recognised.
+       *
+       * @param begin the start of the header.
+       * @param end one past the end of the header.
+       * @returns @c true if a TIFF header, @c false otherwise.
+       */
+      bool
+      isTIFFHeader(const uint8_t *begin,
+                   const uint8_t *end);
+
+      /**
+       * Get the ImageDescription of the first IFD from a file header.
+       *
+       * Only the given bytes are examined; the file is not read.
+       * This is intended for format detection using the start of a
+       * file, where the first IFD and its description may or may
+       * not be contained within the header.
+       *
+       * @param begin the start of the header.
+       * @param end one past the end of the header.
+       * @param description set to the description, or none if the
+       * first IFD has no description.
+       * @returns @c true if the first IFD and its description are
+       * contained within the header, or @c false if they are not, or
+       * if the header is not a TIFF header.
+       */
+      bool
+      headerDescription(const uint8_t                *begin,
+                        const uint8_t                *end,
+                        boost::optional<std::string>& description);
+
     }
   }
 }
@@ -0,0 +1,481 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/ReaderRegistry.h>
+#include <ome/files/out/OMETIFFWriter.h>
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+#include <ome/files/tiff/Util.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include <convert/Converter.h>
+
+using namespace ome::files;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  // Target size of each band of decoded pixel data.
+  const dimension_size_type band_bytes = 16U * 1024U * 1024U;
+
+  // Writes queued by the writer while the next band or tile is read.
+  const dimension_size_type queue_depth = 4U;
+
+  // Storage of the pixel data in the source TIFF files.
+  struct SourceLayout
+  {
+    tiff::Compression         compression;
+    tiff::CodecParameters     codec;
+    tiff::TileType            type;
+    dimension_size_type       tileWidth;
+    dimension_size_type       tileHeight;
+    tiff::PlanarConfiguration planarconfig;
+    uint16_t                  bits;
+  };
+
+  // Codecs whose compressed tiles are self-contained, and so may be
+  // copied between files without any other tags.
+  bool
+  copyable(tiff::Compression compression)
+  {
+    switch (compression)
+      {
+      case tiff::COMPRESSION_NONE:
+      case tiff::COMPRESSION_LZW:
+      case tiff::COMPRESSION_ADOBE_DEFLATE:
+      case tiff::COMPRESSION_PACKBITS:
+      case tiff::COMPRESSION_DEFLATE:
+      case tiff::COMPRESSION_LZMA:
+      case tiff::COMPRESSION_ZSTD:
+        return true;
+      default:
+        return false;
+      }
+  }
+
+  // Get the source layout if every IFD of every pixel data file
+  // stores its pixel data identically; only the main IFDs are
+  // checked, so existing sub-resolutions are not considered.
+  boost::optional<SourceLayout>
+  sourceLayout(const FormatReader& reader)
+  {
+    boost::optional<SourceLayout> layout;
+
+    const std::vector<boost::filesystem::path> all(reader.getUsedFiles(false));
+    const std::vector<boost::filesystem::path> meta(reader.getUsedFiles(true));
+    const std::set<boost::filesystem::path> metaset(meta.begin(), meta.end());
+
+    try
+      {
+        for (const auto& file : all)
+          {
+            if (metaset.find(file) != metaset.end())
+              continue;
+
+            std::shared_ptr<tiff::TIFF> tiff(tiff::TIFF::open(file, "r"));
+            for (const auto& ifd : *tiff)
+              {
+                SourceLayout current;
+                current.compression = ifd->getCompression();
+                current.codec = ifd->getCodecParameters();
+                current.type = ifd->getTileType();
+                current.tileWidth = (current.type == tiff::TILE) ? ifd->getTileWidth() : 0U;
+                current.tileHeight = ifd->getTileHeight();
+                current.planarconfig = ifd->getPlanarConfiguration();
+                current.bits = ifd->getBitsPerSample();
+
+                if (!layout)
+                  layout = current;
+                else if (current.compression != layout->compression ||
+                         current.codec.predictor != layout->codec.predictor ||
+                         current.type != layout->type ||
+                         current.tileWidth != layout->tileWidth ||
+                         current.tileHeight != layout->tileHeight ||
+                         current.planarconfig != layout->planarconfig ||
+                         current.bits != layout->bits)
+                  return boost::none;
+              }
+          }
+      }
+    catch (const std::exception&)
+      {
+        // Not TIFF, or unreadable; decode instead.
+        return boost::none;
+      }
+
+    return layout;
+  }
+
+  // Get the codec name for a compression scheme.
+  boost::optional<std::string>
+  codecName(tiff::Compression compression)
+  {
+    for (const auto& codec : tiff::getCodecs())
+      if (codec.scheme == compression)
+        return codec.name;
+    return boost::none;
+  }
+
+  // A band of whole output tile rows to read and write.
+  struct Band
+  {
+    dimension_size_type series;
+    dimension_size_type plane;
+    PlaneRegion region;
+    VariantPixelBuffer buf;
+    bool ready;
+  };
+
+}
+
+namespace convert
+{
+
+  Converter::Converter (const options& opts):
+    opts(opts)
+  {
+  }
+
+  Converter::~Converter ()
+  {
+  }
+
+  void
+  Converter::run(std::ostream& stream)
+  {
+    const std::string& input(opts.files.at(0));
+    const std::string& output(opts.files.at(1));
+
+    std::shared_ptr<FormatReader> reader(in::ReaderRegistry().getReader(input));
+
+    std::shared_ptr<::ome::xml::meta::MetadataStore> store(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+    reader->setMetadataStore(store);
+    reader->setGroupFiles(true);
+    reader->setFlattenedResolutions(false);
+    reader->setId(input);
+
+    unsigned int nthreads = opts.threads ? opts.threads : std::thread::hardware_concurrency();
+    nthreads = std::max(1U, nthreads);
+
+    std::shared_ptr<out::OMETIFFWriter> writer(std::make_shared<out::OMETIFFWriter>());
+    std::shared_ptr<::ome::xml::meta::MetadataRetrieve> retrieve(std::dynamic_pointer_cast<::ome::xml::meta::MetadataRetrieve>(store));
+    writer->setMetadataRetrieve(retrieve);
+    writer->setInterleaved(reader->isInterleaved());
+    writer->setWriteThreads(nthreads);
+    writer->setWriteQueueDepth(queue_depth);
+    if (opts.pyramid)
+      writer->setSubResolutions(opts.pyramid, opts.downsampling);
+
+    // Compressed tiles may only be copied if the output codec and
+    // strip or tile size are the same as the source, and no
+    // sub-resolutions need generating from the pixel data.
+    boost::optional<SourceLayout> layout(sourceLayout(*reader));
+    boost::optional<std::string> sourceCodec;
+    if (layout)
+      sourceCodec = codecName(layout->compression);
+
+    boost::optional<std::string> compression(opts.compression);
+    if (!compression && layout && layout->compression != tiff::COMPRESSION_NONE)
+      compression = sourceCodec;
+
+    // Strip or tile geometry of each series.
+    std::vector<tiff::TileGeometry> geometry;
+    for (dimension_size_type s = 0; s < reader->getSeriesCount(); ++s)
+      {
+        reader->setSeries(s);
+        tiff::TileGeometry g;
+        if (opts.tileHeight)
+          {
+            g.type = opts.tileWidth ? tiff::TILE : tiff::STRIP;
+            g.width = opts.tileWidth ? *opts.tileWidth : reader->getSizeX();
+            g.height = *opts.tileHeight;
+          }
+        else if (layout)
+          {
+            g.type = layout->type;
+            g.width = layout->type == tiff::TILE ? layout->tileWidth : reader->getSizeX();
+            g.height = layout->tileHeight;
+          }
+        else
+          g = tiff::defaultTileGeometry(tiff::TILING_DEFAULT,
+                                        reader->getSizeX(), reader->getSizeY(),
+                                        reader->getPixelType(),
+                                        reader->isInterleaved() ? reader->getRGBChannelCount(0) : 1U,
+                                        compression ? tiff::getCodecScheme(*compression) : tiff::COMPRESSION_NONE);
+        geometry.push_back(g);
+      }
+
+    bool raw = opts.raw && layout && !opts.pyramid &&
+      copyable(layout->compression) &&
+      (layout->compression == tiff::COMPRESSION_NONE ?
+       (!compression || *compression == "None") : compression == sourceCodec) &&
+      (layout->planarconfig == tiff::CONTIG) == reader->isInterleaved();
+
+    for (dimension_size_type s = 0; s < reader->getSeriesCount() && raw; ++s)
+      {
+        reader->setSeries(s);
+        const PixelType pixeltype(reader->getPixelType());
+        const tiff::TileGeometry& g(geometry.at(s));
+        if (g.type != layout->type ||
+            g.height != layout->tileHeight ||
+            (g.type == tiff::TILE && g.width != layout->tileWidth) ||
+            layout->bits != (pixeltype == PixelType::BIT ? 1U : bytesPerPixel(pixeltype) * 8U))
+          raw = false;
+      }
+
+    if (compression && *compression != "None")
+      writer->setCompression(*compression);
+    tiff::CodecParameters codec;
+    if (raw)
+      codec = layout->codec;
+    else
+      codec.automaticPredictor = true;
+    writer->setCodecParameters(codec);
+
+    auto setGeometry = [&](dimension_size_type series)
+      {
+        const tiff::TileGeometry& g(geometry.at(series));
+        if (g.type == tiff::TILE)
+          writer->setTileSizeX(g.width);
+        else
+          writer->setTileSizeX(boost::none);
+        writer->setTileSizeY(g.height);
+      };
+
+    setGeometry(0);
+    writer->setId(output);
+
+    dimension_size_type planes = 0U;
+    dimension_size_type tiles = 0U;
+    uint64_t bytes = 0U;
+
+    std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+    if (raw)
+      {
+        // Tiles are read serially, since reading without decoding
+        // is cheap, while the writer completes the previous writes
+        // in the background.
+        std::vector<uint8_t> buf;
+        for (dimension_size_type s = 0; s < reader->getSeriesCount(); ++s)
+          {
+            reader->setSeries(s);
+            setGeometry(s);
+            writer->setSeries(s);
+
+            const tiff::TileGeometry& g(geometry.at(s));
+            const dimension_size_type across = (reader->getSizeX() + g.width - 1U) / g.width;
+            const dimension_size_type down = (reader->getSizeY() + g.height - 1U) / g.height;
+            const dimension_size_type ntiles = across * down *
+              (reader->isInterleaved() ? 1U : reader->getRGBChannelCount(0));
+
+            for (dimension_size_type p = 0; p < reader->getImageCount(); ++p)
+              {
+                for (dimension_size_type t = 0; t < ntiles; ++t)
+                  {
+                    reader->openRawTile(p, t, buf);
+                    writer->saveRawTile(p, t, buf.data(), buf.size());
+                    bytes += buf.size();
+                  }
+                tiles += ntiles;
+                ++planes;
+              }
+          }
+      }
+    else
+      {
+        std::vector<Band> bands;
+        for (dimension_size_type s = 0; s < reader->getSeriesCount(); ++s)
+          {
+            reader->setSeries(s);
+            const dimension_size_type sizeX = reader->getSizeX();
+            const dimension_size_type sizeY = reader->getSizeY();
+            const tiff::TileGeometry& g(geometry.at(s));
+            const dimension_size_type rowBytes = sizeX * g.height *
+              reader->getRGBChannelCount(0) * bytesPerPixel(reader->getPixelType());
+            const dimension_size_type height =
+              g.height * std::max(dimension_size_type(1U), band_bytes / std::max(dimension_size_type(1U), rowBytes));
+
+            for (dimension_size_type p = 0; p < reader->getImageCount(); ++p)
+              {
+                for (dimension_size_type y = 0; y < sizeY; y += height)
+                  bands.push_back(Band{s, p, PlaneRegion(0, y, sizeX, std::min(height, sizeY - y)),
+                                       VariantPixelBuffer(), false});
+                tiles += ((sizeX + g.width - 1U) / g.width) * ((sizeY + g.height - 1U) / g.height) *
+                  (reader->isInterleaved() ? 1U : reader->getRGBChannelCount(0));
+                ++planes;
+              }
+          }
+
+        // Bands are read ahead by several threads, but no more than
+        // a few bands ahead of the writer, to bound memory use.
+        const std::size_t depth = static_cast<std::size_t>(nthreads) * 2U;
+        std::mutex mutex;
+        std::condition_variable readyCond;
+        std::condition_variable spaceCond;
+        std::size_t next = 0U;
+        std::size_t written = 0U;
+        bool failed = false;
+        std::exception_ptr error;
+
+        auto fail = [&]()
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+              error = std::current_exception();
+            failed = true;
+            readyCond.notify_all();
+            spaceCond.notify_all();
+          };
+
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < std::min(static_cast<std::size_t>(nthreads), bands.size()); ++t)
+          threads.emplace_back([&]()
+            {
+              try
+                {
+                  while (true)
+                    {
+                      std::size_t j;
+                      {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        spaceCond.wait(lock, [&]()
+                                       { return failed || next >= bands.size() || next < written + depth; });
+                        if (failed || next >= bands.size())
+                          return;
+                        j = next++;
+                      }
+
+                      Band& band(bands[j]);
+                      reader->openBytesAt(band.series, 0U, band.plane, band.buf, band.region);
+
+                      {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        band.ready = true;
+                      }
+                      readyCond.notify_all();
+                    }
+                }
+              catch (...)
+                {
+                  fail();
+                }
+            });
+
+        try
+          {
+            dimension_size_type series = 0U;
+            for (std::size_t j = 0; j < bands.size(); ++j)
+              {
+                {
+                  std::unique_lock<std::mutex> lock(mutex);
+                  readyCond.wait(lock, [&]() { return failed || bands[j].ready; });
+                  if (failed)
+                    break;
+                }
+
+                Band& band(bands[j]);
+                if (band.series != series)
+                  {
+                    series = band.series;
+                    setGeometry(series);
+                    writer->setSeries(series);
+                  }
+                bytes += band.buf.num_elements() * bytesPerPixel(band.buf.pixelType());
+                writer->saveBytes(band.plane, std::move(band.buf),
+                                  band.region.x, band.region.y, band.region.w, band.region.h);
+                band.buf = VariantPixelBuffer();
+
+                {
+                  std::lock_guard<std::mutex> lock(mutex);
+                  ++written;
+                }
+                spaceCond.notify_all();
+              }
+          }
+        catch (...)
+          {
+            fail();
+          }
+
+        for (auto& thread : threads)
+          thread.join();
+        if (error)
+          std::rethrow_exception(error);
+      }
+
+    writer->close();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    reader->close();
+
+    const double mib = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    stream << boost::format("Wrote %1% series, %2% planes, %3% tiles (%4%)\n")
+      % geometry.size() % planes % tiles
+      % (raw ? "copied without decoding" : "decoded and encoded");
+    if (opts.pyramid)
+      stream << boost::format("Generated %1% sub-resolutions\n") % opts.pyramid;
+    stream << boost::format("Transferred %1$.1f MiB in %2$.3f s with %3% threads: %4$.1f MiB/s\n")
+      % mib % seconds % nthreads % (seconds > 0.0 ? mib / seconds : 0.0);
+  }
+
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,93 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef CONVERT_CONVERTER_H
+#define CONVERT_CONVERTER_H
+
+#include <ostream>
+
+#include <convert/options.h>
+
+namespace convert
+{
+
+  /**
+   * Image conversion to OME-TIFF.
+   *
+   * The pixel data is streamed from the source in bands of whole
+   * output tile rows, and never as whole planes.  If the source
+   * TIFF files all use the same codec, predictor, planar
+   * configuration and tile or strip size, and the output is
+   * configured identically, the compressed tiles are copied
+   * without decoding.  Otherwise the bands are read by several
+   * threads using the thread-safe FormatReader::openBytesAt() and
+   * written in order, with the tiles of each band encoded in
+   * parallel by the writer.  Sub-resolutions, if requested, are
+   * generated while writing, and always require decoding.
+   */
+  class Converter
+  {
+  public:
+    /// The constructor.
+    Converter (const options& opts);
+
+    /// The destructor.
+    virtual ~Converter ();
+
+    /**
+     * Convert the input file, and print a summary.
+     *
+     * @param stream the stream to print to.
+     */
+    void
+    run(std::ostream& stream);
+
+  private:
+    /// Command-line options.
+    options opts;
+  };
+
+}
+
+#endif /* CONVERT_CONVERTER_H */
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,241 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <convert/options.h>
+
+namespace opt = boost::program_options;
+
+namespace convert
+{
+
+  options::options ():
+    action(ACTION_CONVERT),
+    verbosity(MSG_NORMAL),
+    raw(true),
+    threads(0),
+    pyramid(0),
+    downsampling(ome::files::tiff::DOWNSAMPLE_MEAN),
+    tileWidth(),
+    tileHeight(),
+    compression(),
+    downsamplingString(),
+    files(),
+    actions("Actions"),
+    general("General options"),
+    writer("Writer options"),
+    hidden("Hidden options"),
+    positional(),
+    visible(),
+    global(),
+    vm()
+  {
+  }
+
+  options::~options ()
+  {
+  }
+
+  boost::program_options::options_description const&
+  options::get_visible_options() const
+  {
+    return this->visible;
+  }
+
+  void
+  options::parse (int   argc,
+                  char *argv[])
+  {
+    add_options();
+    add_option_groups();
+
+    opt::store(opt::command_line_parser(argc, argv).
+               options(global).positional(positional).run(), vm);
+    opt::notify(vm);
+
+    check_options();
+    check_actions();
+  }
+
+  void
+  options::add_options ()
+  {
+    actions.add_options()
+      ("usage,u",
+       "Show command usage")
+      ("help,h",
+       "Display manual for this command")
+      ("version,V",
+       "Print version information");
+
+    general.add_options()
+      ("debug",
+       "Show debug output")
+      ("quiet,q",
+       "Show less output")
+      ("verbose,v",
+       "Show more output");
+
+    writer.add_options()
+      ("tile-width", opt::value<ome::files::dimension_size_type>(),
+       "Tile width (default: source tile width)")
+      ("tile-height", opt::value<ome::files::dimension_size_type>(),
+       "Tile height, or strip height if no tile width is set (default: source tile height)")
+      ("compression", opt::value<std::string>(),
+       "Compression codec (default: source codec)")
+      ("pyramid", opt::value<ome::files::dimension_size_type>(&this->pyramid),
+       "Number of sub-resolutions to generate (default 0)")
+      ("downsample", opt::value<std::string>(&this->downsamplingString),
+       "Sub-resolution downsampling method: mean, nearest, mode or or (default mean)")
+      ("threads", opt::value<unsigned int>(&this->threads),
+       "Number of decode and encode threads (default: number of CPUs)")
+      ("raw", "Copy compressed tiles without decoding where possible (default)")
+      ("no-raw", "Always decode and re-encode tiles");
+
+    hidden.add_options()
+      ("files", opt::value<std::vector<std::string>>(&this->files),
+       "Input and output files");
+
+    positional.add("files", -1);
+  }
+
+  void
+  options::add_option_groups ()
+  {
+#ifndef BOOST_PROGRAM_OPTIONS_DESCRIPTION_OLD
+    if (!actions.options().empty())
+#else
+      if (!actions.primary_keys().empty())
+#endif
+        {
+          global.add(actions);
+          visible.add(actions);
+        }
+#ifndef BOOST_PROGRAM_OPTIONS_DESCRIPTION_OLD
+    if (!general.options().empty())
+#else
+      if (!general.primary_keys().empty())
+#endif
+        {
+          global.add(general);
+          visible.add(general);
+        }
+#ifndef BOOST_PROGRAM_OPTIONS_DESCRIPTION_OLD
+    if (!writer.options().empty())
+#else
+      if (!writer.primary_keys().empty())
+#endif
+        {
+          global.add(writer);
+          visible.add(writer);
+        }
+#ifndef BOOST_PROGRAM_OPTIONS_DESCRIPTION_OLD
+    if (!hidden.options().empty())
+#else
+      if (!hidden.primary_keys().empty())
+#endif
+        global.add(hidden);
+  }
+
+  void
+  options::check_options ()
+  {
+    if (vm.count("usage"))
+      this->action = ACTION_USAGE;
+
+    if (vm.count("help"))
+      this->action = ACTION_HELP;
+
+    if (vm.count("version"))
+      this->action = ACTION_VERSION;
+
+    if (this->action == ACTION_CONVERT && this->files.empty())
+      this->action = ACTION_USAGE;
+
+    if (vm.count("quiet"))
+      this->verbosity = MSG_QUIET;
+    if (vm.count("verbose"))
+      this->verbosity = MSG_VERBOSE;
+    if (vm.count("debug"))
+      this->verbosity = MSG_DEBUG;
+
+    if (vm.count("raw"))
+      this->raw = true;
+    if (vm.count("no-raw"))
+      this->raw = false;
+
+    if (vm.count("tile-width"))
+      this->tileWidth = vm["tile-width"].as<ome::files::dimension_size_type>();
+    if (vm.count("tile-height"))
+      this->tileHeight = vm["tile-height"].as<ome::files::dimension_size_type>();
+    if (vm.count("compression"))
+      this->compression = vm["compression"].as<std::string>();
+
+    if (this->downsamplingString == "nearest")
+      this->downsampling = ome::files::tiff::DOWNSAMPLE_NEAREST;
+    else if (this->downsamplingString.empty() || this->downsamplingString == "mean")
+      this->downsampling = ome::files::tiff::DOWNSAMPLE_MEAN;
+    else if (this->downsamplingString == "mode")
+      this->downsampling = ome::files::tiff::DOWNSAMPLE_MODE;
+    else if (this->downsamplingString == "or")
+      this->downsampling = ome::files::tiff::DOWNSAMPLE_OR;
+    else
+      throw std::runtime_error("--downsample must be mean, nearest, mode or or");
+  }
+
+  void
+  options::check_actions ()
+  {
+    if (this->action != ACTION_CONVERT)
+      return;
+
+    if (this->files.size() != 2)
+      throw std::runtime_error("An input and an output file must be specified");
+    if (this->tileWidth && !this->tileHeight)
+      throw std::runtime_error("--tile-width requires --tile-height");
+    if ((this->tileWidth && *this->tileWidth % 16) ||
+        (this->tileWidth && this->tileHeight && *this->tileHeight % 16))
+      throw std::runtime_error("Tile sizes must be multiples of 16");
+  }
+
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
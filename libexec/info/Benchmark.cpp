@@ -0,0 +1,251 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+#include <ome/files/IOStatistics.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/OMETIFFReader.h>
+
+#include <info/Benchmark.h>
+
+using namespace ome::files;
+using ome::files::dimension_size_type;
+
+namespace
+{
+
+  typedef std::chrono::steady_clock clock_type;
+
+  // Bytes of pixel data in a buffer.
+  uint64_t
+  buffer_bytes(const VariantPixelBuffer& buf)
+  {
+    return static_cast<uint64_t>(buf.num_elements()) * bytesPerPixel(buf.pixelType());
+  }
+
+  // Nearest-rank percentile of sorted durations.
+  std::chrono::nanoseconds
+  percentile(const std::vector<std::chrono::nanoseconds>& sorted,
+             double                                       p)
+  {
+    std::vector<std::chrono::nanoseconds>::size_type rank =
+      static_cast<std::vector<std::chrono::nanoseconds>::size_type>(p / 100.0 * static_cast<double>(sorted.size()) + 0.5);
+    rank = std::max(rank, std::vector<std::chrono::nanoseconds>::size_type(1U));
+    rank = std::min(rank, sorted.size());
+    return sorted[rank - 1U];
+  }
+
+  double
+  milliseconds(std::chrono::nanoseconds duration)
+  {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  }
+
+}
+
+namespace info
+{
+
+  Benchmark::Benchmark (const std::string &file,
+                        const options&     opts):
+    file(file),
+    opts(opts)
+  {
+  }
+
+  Benchmark::~Benchmark ()
+  {
+  }
+
+  std::shared_ptr<FormatReader>
+  Benchmark::open(Timings& init)
+  {
+    std::shared_ptr<FormatReader> reader(std::make_shared<in::OMETIFFReader>());
+    reader->setGroupFiles(opts.group);
+    reader->setFlattenedResolutions(opts.flat);
+
+    clock_type::time_point start(clock_type::now());
+    reader->setId(file);
+    init.durations.push_back(clock_type::now() - start);
+
+    if (opts.series >= reader->getSeriesCount())
+      {
+        boost::format fmt("Series %1% out of range (%2% series)");
+        fmt % opts.series % reader->getSeriesCount();
+        throw std::logic_error(fmt.str());
+      }
+    reader->setSeries(opts.series);
+
+    if (opts.resolution)
+      {
+        if (opts.resolution >= reader->getResolutionCount())
+          {
+            boost::format fmt("Resolution %1% out of range (%2% resolutions)");
+            fmt % opts.resolution % reader->getResolutionCount();
+            throw std::logic_error(fmt.str());
+          }
+        reader->setResolution(opts.resolution);
+      }
+
+    return reader;
+  }
+
+  void
+  Benchmark::run(std::ostream& stream)
+  {
+    Timings init{"init", {}, 0U};
+    Timings parse{"metadata parse", {}, 0U};
+    Timings plane{"plane read", {}, 0U};
+    Timings tile{"tile read", {}, 0U};
+    Timings thumb{"thumbnail read", {}, 0U};
+
+    std::mt19937_64 rng(opts.seed);
+    VariantPixelBuffer buf;
+
+    for (unsigned int i = 0; i < opts.iterations; ++i)
+      {
+        // A new reader each iteration, so that initialisation and
+        // first reads are measured without warm caches in the reader.
+        std::shared_ptr<FormatReader> reader(open(init));
+        std::shared_ptr<IOStatistics> iostats(reader->getIOStatistics());
+        if (iostats && iostats->getHistogram(IOStatistics::METADATA_PARSE).count)
+          parse.durations.push_back(std::chrono::nanoseconds(iostats->getHistogram(IOStatistics::METADATA_PARSE).total));
+
+        const dimension_size_type sizeX = reader->getSizeX();
+        const dimension_size_type sizeY = reader->getSizeY();
+        const dimension_size_type planes = reader->getImageCount();
+
+        // Full plane.
+        {
+          const dimension_size_type p = i % planes;
+          clock_type::time_point start(clock_type::now());
+          reader->openBytes(p, buf);
+          plane.durations.push_back(clock_type::now() - start);
+          plane.bytes += buffer_bytes(buf);
+        }
+
+        // Random tiles on the optimal tile grid.
+        {
+          const dimension_size_type tw = std::max(dimension_size_type(1U), std::min(reader->getOptimalTileWidth(), sizeX));
+          const dimension_size_type th = std::max(dimension_size_type(1U), std::min(reader->getOptimalTileHeight(), sizeY));
+          std::uniform_int_distribution<dimension_size_type> pdist(0U, planes - 1U);
+          std::uniform_int_distribution<dimension_size_type> xdist(0U, (sizeX - 1U) / tw);
+          std::uniform_int_distribution<dimension_size_type> ydist(0U, (sizeY - 1U) / th);
+          for (unsigned int t = 0; t < opts.tiles; ++t)
+            {
+              const dimension_size_type p = pdist(rng);
+              const dimension_size_type x = xdist(rng) * tw;
+              const dimension_size_type y = ydist(rng) * th;
+              clock_type::time_point start(clock_type::now());
+              reader->openBytes(p, buf, x, y,
+                                std::min(tw, sizeX - x), std::min(th, sizeY - y));
+              tile.durations.push_back(clock_type::now() - start);
+              tile.bytes += buffer_bytes(buf);
+            }
+        }
+
+        // Thumbnail, by decimation of the full plane.
+        {
+          const dimension_size_type p = i % planes;
+          const dimension_size_type xstep = std::max(dimension_size_type(1U), sizeX / std::max(dimension_size_type(1U), reader->getThumbSizeX()));
+          const dimension_size_type ystep = std::max(dimension_size_type(1U), sizeY / std::max(dimension_size_type(1U), reader->getThumbSizeY()));
+          clock_type::time_point start(clock_type::now());
+          reader->openBytesDecimated(p, buf, PlaneRegion(0, 0, sizeX, sizeY), xstep, ystep);
+          thumb.durations.push_back(clock_type::now() - start);
+          thumb.bytes += buffer_bytes(buf);
+        }
+
+        reader->close();
+      }
+
+    stream << boost::format("%1% iterations, %2% tiles per iteration, seed %3%\n\n")
+      % opts.iterations % opts.tiles % opts.seed;
+    stream << boost::format("%-16s %8s %10s %10s %10s %10s %10s %12s\n")
+      % "operation" % "count" % "mean ms" % "p50 ms" % "p90 ms" % "p99 ms" % "max ms" % "MiB/s";
+    print(stream, init);
+    if (!parse.durations.empty())
+      print(stream, parse);
+    print(stream, plane);
+    print(stream, tile);
+    print(stream, thumb);
+  }
+
+  void
+  Benchmark::print(std::ostream&  stream,
+                   const Timings& timings)
+  {
+    if (timings.durations.empty())
+      return;
+
+    std::vector<std::chrono::nanoseconds> sorted(timings.durations);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::chrono::nanoseconds total(0);
+    for (const auto& d : sorted)
+      total += d;
+
+    const double seconds = std::chrono::duration<double>(total).count();
+    const double mean = milliseconds(total) / static_cast<double>(sorted.size());
+
+    boost::format fmt("%-16s %8d %10.3f %10.3f %10.3f %10.3f %10.3f %12s\n");
+    fmt % timings.name % sorted.size() % mean
+      % milliseconds(percentile(sorted, 50.0))
+      % milliseconds(percentile(sorted, 90.0))
+      % milliseconds(percentile(sorted, 99.0))
+      % milliseconds(sorted.back());
+    if (timings.bytes && seconds > 0.0)
+      fmt % (boost::format("%.1f") % (static_cast<double>(timings.bytes) / seconds / (1024.0 * 1024.0))).str();
+    else
+      fmt % "-";
+    stream << fmt;
+  }
+
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
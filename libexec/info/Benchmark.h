@@ -0,0 +1,128 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef SHOWINF_BENCHMARK_H
+#define SHOWINF_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <ome/files/FormatReader.h>
+#include <ome/files/Types.h>
+
+#include <info/options.h>
+
+namespace info
+{
+
+  /**
+   * Reader timing benchmark.
+   *
+   * Times reader initialisation, full-plane reads, random tile
+   * reads and thumbnail reads of a file over a number of
+   * iterations, and reports the throughput and latency
+   * percentiles of each.
+   */
+  class Benchmark
+  {
+  public:
+    /// The constructor.
+    Benchmark (const std::string &file,
+               const options&     opts);
+
+    /// The destructor.
+    virtual ~Benchmark ();
+
+    /**
+     * Run the benchmark and print the results.
+     *
+     * @param stream the stream to print to.
+     */
+    void
+    run(std::ostream& stream);
+
+  private:
+    /// Timings of one operation.
+    struct Timings
+    {
+      /// Operation name.
+      std::string name;
+      /// Duration of each operation.
+      std::vector<std::chrono::nanoseconds> durations;
+      /// Total bytes read (zero if not applicable).
+      uint64_t bytes;
+    };
+
+    /**
+     * Create and configure a reader, and open the file.
+     *
+     * @param init the timings to record initialisation in.
+     * @returns the reader.
+     */
+    std::shared_ptr<ome::files::FormatReader>
+    open(Timings& init);
+
+    /**
+     * Print the timings of an operation.
+     *
+     * @param stream the stream to print to.
+     * @param timings the timings to print.
+     */
+    static void
+    print(std::ostream&  stream,
+          const Timings& timings);
+
+    /// File to open with FormatReader::setId.
+    std::string file;
+    /// Command-line options.
+    options opts;
+  };
+
+}
+
+#endif /* SHOWINF_BENCHMARK_H */
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
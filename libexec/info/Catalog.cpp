@@ -0,0 +1,302 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+
+#include <ome/files/FormatHandler.h>
+#include <ome/files/detail/OMEXMLScan.h>
+#include <ome/files/in/OMETIFFReader.h>
+#include <ome/files/in/TIFFReader.h>
+#include <ome/files/tiff/DirectoryParser.h>
+
+#include <info/Catalog.h>
+
+using namespace ome::files;
+using ome::files::dimension_size_type;
+
+namespace
+{
+
+  std::string
+  json_escape(const std::string& text)
+  {
+    std::string ret;
+    ret.reserve(text.size());
+    for (const char c : text)
+      {
+        switch (c)
+          {
+          case '"':  ret += "\\\""; break;
+          case '\\': ret += "\\\\"; break;
+          case '\n': ret += "\\n"; break;
+          case '\r': ret += "\\r"; break;
+          case '\t': ret += "\\t"; break;
+          default:
+            if (static_cast<unsigned char>(c) < 0x20)
+              ret += (boost::format("\\u%04x") % static_cast<unsigned int>(c)).str();
+            else
+              ret += c;
+            break;
+          }
+      }
+    return ret;
+  }
+
+  bool
+  has_suffix(const std::string& name,
+             const std::string& suffix)
+  {
+    return name.size() >= suffix.size() &&
+      name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
+  // Summarise an OME-XML document.
+  void
+  write_omexml(std::ostream&      os,
+               const std::string& omexml)
+  {
+    detail::OMEXMLSummary summary;
+    if (!detail::scanOMEXML(omexml, summary))
+      throw std::runtime_error("Invalid OME-XML document");
+
+    os << ",\"series\":" << summary.images.size() << ",\"images\":[";
+    for (std::vector<detail::OMEXMLImageSummary>::size_type i = 0; i < summary.images.size(); ++i)
+      {
+        const detail::OMEXMLImageSummary& image(summary.images[i]);
+        os << (i ? "," : "")
+           << "{\"id\":\"" << json_escape(image.id)
+           << "\",\"sizeX\":" << image.sizeX
+           << ",\"sizeY\":" << image.sizeY
+           << ",\"sizeZ\":" << image.sizeZ
+           << ",\"sizeC\":" << image.sizeC
+           << ",\"sizeT\":" << image.sizeT
+           << ",\"type\":\"" << json_escape(image.pixelType)
+           << "\",\"order\":\"" << json_escape(image.dimensionOrder) << "\"}";
+      }
+    os << ']';
+  }
+
+  // Summarise a TIFF from its first directory.  The directories
+  // are parsed natively, since opening with libtiff is not needed
+  // for metadata only.
+  void
+  write_tiff(std::ostream&                  os,
+             const boost::filesystem::path& file,
+             bool                           ome)
+  {
+    tiff::DirectoryParser parser(file);
+    const tiff::DirectoryParser::Summary summary(parser.summary(0));
+
+    if (ome)
+      {
+        if (!summary.description)
+          throw std::runtime_error("No TIFF ImageDescription found");
+        write_omexml(os, *summary.description);
+      }
+    else
+      {
+        if (!summary.pixelType)
+          throw std::runtime_error("Unsupported TIFF pixel type");
+        os << ",\"directories\":" << parser.directoryCount()
+           << ",\"images\":[{\"sizeX\":" << summary.width
+           << ",\"sizeY\":" << summary.height
+           << ",\"samples\":" << summary.samplesPerPixel
+           << ",\"type\":\"" << *summary.pixelType << "\"}]";
+      }
+  }
+
+  // Reader instances reused by one thread for format detection.
+  struct Detectors
+  {
+    in::OMETIFFReader ometiff;
+    in::TIFFReader tiff;
+  };
+
+  // Summarise one file as a JSON object.
+  std::string
+  summarise(const boost::filesystem::path& file,
+            Detectors&                     detectors)
+  {
+    std::ostringstream os;
+    os << "{\"file\":\"" << json_escape(file.string()) << '"';
+
+    try
+      {
+        // OME-TIFF is only detected by isThisType() if the file may
+        // be opened, so its suffixes are matched directly.
+        if (has_suffix(file.string(), ".companion.ome"))
+          {
+            boost::filesystem::ifstream in(file);
+            if (!in)
+              throw std::runtime_error("Failed to open file");
+            std::string omexml((std::istreambuf_iterator<char>(in)),
+                               std::istreambuf_iterator<char>());
+            os << ",\"format\":\"" << detectors.ometiff.getFormat() << '"';
+            write_omexml(os, omexml);
+          }
+        else if (FormatHandler::checkSuffix(file,
+                                            detectors.ometiff.getSuffixes(),
+                                            detectors.ometiff.getCompressionSuffixes()))
+          {
+            os << ",\"format\":\"" << detectors.ometiff.getFormat() << '"';
+            write_tiff(os, file, true);
+          }
+        else if (detectors.tiff.isThisType(file, false))
+          {
+            os << ",\"format\":\"" << detectors.tiff.getFormat() << '"';
+            write_tiff(os, file, false);
+          }
+        else
+          {
+            return std::string();
+          }
+      }
+    catch (const std::exception& e)
+      {
+        os << ",\"error\":\"" << json_escape(e.what()) << '"';
+      }
+
+    os << '}';
+    return os.str();
+  }
+
+}
+
+namespace info
+{
+
+  Catalog::Catalog (const options& opts):
+    opts(opts)
+  {
+  }
+
+  Catalog::~Catalog ()
+  {
+  }
+
+  std::vector<boost::filesystem::path>
+  Catalog::collect() const
+  {
+    std::vector<boost::filesystem::path> files;
+
+    if (!opts.fileList.empty())
+      {
+        std::ifstream list;
+        if (opts.fileList != "-")
+          {
+            list.open(opts.fileList.c_str());
+            if (!list)
+              {
+                boost::format fmt("Failed to open file list ‘%1%’");
+                fmt % opts.fileList;
+                throw std::runtime_error(fmt.str());
+              }
+          }
+        std::istream& in(opts.fileList == "-" ? std::cin : list);
+        std::string line;
+        while (std::getline(in, line))
+          if (!line.empty())
+            files.push_back(line);
+      }
+
+    for (const auto& name : opts.files)
+      {
+        boost::filesystem::path path(name);
+        if (boost::filesystem::is_directory(path))
+          {
+            for (boost::filesystem::recursive_directory_iterator i(path), end; i != end; ++i)
+              if (boost::filesystem::is_regular_file(i->status()))
+                files.push_back(i->path());
+          }
+        else
+          files.push_back(path);
+      }
+
+    return files;
+  }
+
+  void
+  Catalog::run(std::ostream& stream)
+  {
+    const std::vector<boost::filesystem::path> files(collect());
+
+    unsigned int nthreads = opts.threads ? opts.threads : std::thread::hardware_concurrency();
+    nthreads = std::max(1U, std::min(nthreads, static_cast<unsigned int>(files.size())));
+
+    std::atomic<std::size_t> next(0U);
+    std::mutex output;
+    std::vector<std::thread> threads;
+
+    for (unsigned int t = 0; t < nthreads; ++t)
+      threads.emplace_back([&]()
+        {
+          Detectors detectors;
+          for (std::size_t i = next++; i < files.size(); i = next++)
+            {
+              const std::string line(summarise(files[i], detectors));
+              if (line.empty())
+                continue;
+              std::lock_guard<std::mutex> guard(output);
+              stream << line << '\n';
+            }
+        });
+    for (auto& thread : threads)
+      thread.join();
+
+    stream << std::flush;
+  }
+
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,104 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef SHOWINF_CATALOG_H
+#define SHOWINF_CATALOG_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include <info/options.h>
+
+namespace info
+{
+
+  /**
+   * Fast metadata catalog of many files.
+   *
+   * Each file is summarised using the lightweight TIFF directory
+   * and OME-XML scanning paths rather than full reader
+   * initialisation, so no OME-XML DOM is built.  Files are
+   * processed in parallel, reusing one set of reader instances per
+   * thread for format detection, and one compact JSON object is
+   * printed per line for each file, in completion order.
+   */
+  class Catalog
+  {
+  public:
+    /// The constructor.
+    Catalog (const options& opts);
+
+    /// The destructor.
+    virtual ~Catalog ();
+
+    /**
+     * Summarise all files and print the results.
+     *
+     * @param stream the stream to print to.
+     */
+    void
+    run(std::ostream& stream);
+
+  private:
+    /**
+     * Get the files to summarise.
+     *
+     * Directories are walked recursively, and the file list (if
+     * any) is read.
+     *
+     * @returns the files.
+     */
+    std::vector<boost::filesystem::path>
+    collect() const;
+
+    /// Command-line options.
+    options opts;
+  };
+
+}
+
+#endif /* SHOWINF_CATALOG_H */
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
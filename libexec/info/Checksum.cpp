@@ -0,0 +1,201 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include <ome/files/PixelProperties.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/OMETIFFReader.h>
+
+#include <info/Checksum.h>
+
+using namespace ome::files;
+using ome::files::dimension_size_type;
+
+namespace
+{
+
+  const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+
+  inline uint64_t
+  mix(uint64_t h,
+      uint64_t word)
+  {
+    h ^= word;
+    h *= multiplier;
+    h ^= h >> 32U;
+    return h;
+  }
+
+  // A plane to read.
+  struct Job
+  {
+    dimension_size_type series;
+    dimension_size_type plane;
+    PlaneRegion region;
+    uint64_t hash;
+  };
+
+}
+
+namespace info
+{
+
+  Checksum::Checksum (const std::string &file,
+                      const options&     opts):
+    file(file),
+    opts(opts)
+  {
+  }
+
+  Checksum::~Checksum ()
+  {
+  }
+
+  uint64_t
+  Checksum::hash(const void  *data,
+                 std::size_t  size,
+                 uint64_t     seed)
+  {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t h = mix(seed, static_cast<uint64_t>(size));
+
+    std::size_t i = 0U;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+      {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        h = mix(h, word);
+      }
+    if (i < size)
+      {
+        uint64_t word = 0U;
+        std::memcpy(&word, bytes + i, size - i);
+        h = mix(h, word);
+      }
+
+    return mix(h, multiplier);
+  }
+
+  void
+  Checksum::run(std::ostream& stream)
+  {
+    std::shared_ptr<FormatReader> reader(std::make_shared<in::OMETIFFReader>());
+    reader->setGroupFiles(opts.group);
+    reader->setFlattenedResolutions(opts.flat);
+    reader->setId(file);
+
+    std::vector<Job> jobs;
+    for (dimension_size_type s = 0; s < reader->getSeriesCount(); ++s)
+      {
+        reader->setSeries(s);
+        const PlaneRegion full(0, 0, reader->getSizeX(), reader->getSizeY());
+        for (dimension_size_type p = 0; p < reader->getImageCount(); ++p)
+          jobs.push_back(Job{s, p, full, 0U});
+      }
+
+    unsigned int nthreads = opts.threads ? opts.threads : std::thread::hardware_concurrency();
+    nthreads = std::max(1U, std::min(nthreads, static_cast<unsigned int>(jobs.size())));
+
+    std::atomic<std::size_t> next(0U);
+    std::atomic<uint64_t> bytes(0U);
+    std::vector<std::exception_ptr> errors(nthreads);
+    std::vector<std::thread> threads;
+
+    std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+    for (unsigned int t = 0; t < nthreads; ++t)
+      threads.emplace_back([&, t]()
+        {
+          try
+            {
+              VariantPixelBuffer buf;
+              for (std::size_t j = next++; j < jobs.size(); j = next++)
+                {
+                  Job& job(jobs[j]);
+                  reader->openBytesAt(job.series, 0U, job.plane, buf, job.region);
+                  const std::size_t size = buf.num_elements() * bytesPerPixel(buf.pixelType());
+                  job.hash = hash(buf.data(), size);
+                  bytes += size;
+                }
+            }
+          catch (...)
+            {
+              errors[t] = std::current_exception();
+              next = jobs.size();
+            }
+        });
+    for (auto& thread : threads)
+      thread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const auto& error : errors)
+      if (error)
+        std::rethrow_exception(error);
+
+    reader->close();
+
+    uint64_t aggregate = 0U;
+    for (const auto& job : jobs)
+      {
+        stream << boost::format("Series %1% Plane %2%: %3$016x\n")
+          % job.series % job.plane % job.hash;
+        aggregate = mix(aggregate, job.hash);
+      }
+
+    const double mib = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    stream << boost::format("Aggregate: %1$016x\n") % aggregate
+           << boost::format("Read %1% planes (%2$.1f MiB) in %3$.3f s with %4% threads: %5$.1f MiB/s\n")
+      % jobs.size() % mib % seconds % nthreads % (seconds > 0.0 ? mib / seconds : 0.0);
+  }
+
+}
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -0,0 +1,112 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef SHOWINF_CHECKSUM_H
+#define SHOWINF_CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include <info/options.h>
+
+namespace info
+{
+
+  /**
+   * Pixel data checksums.
+   *
+   * Reads every plane of every series of a file, in parallel
+   * using the thread-safe FormatReader::openBytesAt(), and prints a
+   * hash of each plane, an aggregate hash of all planes, and the
+   * read throughput.  Comparing the hashes with those of an earlier
+   * run detects corruption of the pixel data.
+   */
+  class Checksum
+  {
+  public:
+    /// The constructor.
+    Checksum (const std::string &file,
+              const options&     opts);
+
+    /// The destructor.
+    virtual ~Checksum ();
+
+    /**
+     * Read and checksum all planes, and print the results.
+     *
+     * @param stream the stream to print to.
+     */
+    void
+    run(std::ostream& stream);
+
+    /**
+     * Hash a block of memory.
+     *
+     * This is a 64-bit multiply and xor-shift hash over 8-byte
+     * words, which is several times faster than a byte-wise hash.
+     * Since pixel data is hashed in native byte order, hashes are
+     * only comparable between hosts of the same endianness.
+     *
+     * @param data the data to hash.
+     * @param size the size of the data, in bytes.
+     * @param seed the initial hash value.
+     * @returns the hash.
+     */
+    static uint64_t
+    hash(const void  *data,
+         std::size_t  size,
+         uint64_t     seed = 0U);
+
+  private:
+    /// File to open with FormatReader::setId.
+    std::string file;
+    /// Command-line options.
+    options opts;
+  };
+
+}
+
+#endif /* SHOWINF_CHECKSUM_H */
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
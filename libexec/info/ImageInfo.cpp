@@ -35,8 +35,12 @@
  * #L%
  */
 
-#include <ome/files/in/TIFFReader.h>
-#include <ome/files/in/OMETIFFReader.h>
+#include <ome/files/ChannelMerger.h>
+#include <ome/files/ChannelSeparator.h>
+#include <ome/files/DimensionSwapper.h>
+#include <ome/files/FilePattern.h>
+#include <ome/files/FileStitcher.h>
+#include <ome/files/in/ReaderRegistry.h>
 
 #include <ome/common/xml/Platform.h>
 #include <ome/common/xml/dom/Document.h>
@@ -59,6 +63,15 @@ namespace
 
   const char * const stars = "************";
 
+  // The pattern of a file, or the file itself if a pattern.
+  FilePattern
+  file_pattern(const std::string& file)
+  {
+    if (file.find('<') != std::string::npos)
+      return FilePattern(file);
+    return FilePattern::findPattern(file);
+  }
+
 }
 
 namespace info
@@ -87,7 +100,9 @@ namespace info
   ImageInfo::testRead(std::ostream& stream)
   {
     if (!reader)
-      reader = std::make_shared<in::OMETIFFReader>();
+      reader = in::ReaderRegistry().getReader(opts.stitch ?
+                                              file_pattern(file).getFile(0) :
+                                              boost::filesystem::path(file));
 
     preInit(stream);
 
@@ -131,28 +146,29 @@ namespace info
         reader->setMetadataStore(store);
       }
 
-    /// @todo ImageReader format detection.
-    std::shared_ptr<ome::files::detail::FormatReader> detail = std::dynamic_pointer_cast<ome::files::detail::FormatReader>(reader);
-    if (detail)
-      stream << "Using reader: " << detail->getFormat()
-             << " (" << detail->getFormatDescription() << ")\n";
-    else
-      stream << "Unknown reader\n";
+    stream << "Using reader: " << reader->getFormat()
+           << " (" << reader->getFormatDescription() << ")\n";
 
     if (opts.stitch)
       {
-        /// @todo Stitching
-        stream << "Stiching not implemented\n";
+        const boost::filesystem::path first(file_pattern(file).getFile(0));
+        std::shared_ptr<in::ReaderRegistry> registry(std::make_shared<in::ReaderRegistry>());
+        reader = std::make_shared<FileStitcher>(reader,
+                                                [registry, first]() { return registry->getReader(first); });
       }
-    /// @todo ChannelFiller
-    /// @todo ChannelSeparator
-    /// @todo ChannelMerger
+    if (opts.separate)
+      reader = std::make_shared<ChannelSeparator>(reader);
+    if (opts.merge)
+      reader = std::make_shared<ChannelMerger>(reader);
+    if (opts.inputOrder || opts.outputOrder)
+      reader = std::make_shared<DimensionSwapper>(reader);
     /// @todo MinMaxCalc
     /// @todo BufferedImageReader
 
     reader->close();
     reader->setMetadataFiltered(opts.filter);
     reader->setGroupFiles(opts.group);
+    reader->setIndexedExpanded(opts.expand);
     MetadataOptions mopts(opts.showcore ? MetadataOptions::METADATA_ALL : MetadataOptions::METADATA_MINIMUM);
     reader->setMetadataOptions(mopts);
     reader->setFlattenedResolutions(opts.flat);
@@ -161,6 +177,20 @@ namespace info
   void
   ImageInfo::postInit(std::ostream& /* stream */)
   {
+    std::shared_ptr<DimensionSwapper> swapper(std::dynamic_pointer_cast<DimensionSwapper>(reader));
+    if (!swapper)
+      return;
+
+    const dimension_size_type series = reader->getSeries();
+    for (dimension_size_type s = 0; s < reader->getSeriesCount(); ++s)
+      {
+        reader->setSeries(s);
+        if (opts.inputOrder)
+          swapper->swapDimensions(*opts.inputOrder);
+        if (opts.outputOrder)
+          swapper->setOutputOrder(*opts.outputOrder);
+      }
+    reader->setSeries(series);
   }
 
   void
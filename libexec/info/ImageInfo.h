@@ -82,9 +82,6 @@ namespace info
 
     /**
      * Set up DimensionSwapper after setId.
-     *
-     * @note Dimension swapping is not yet implemented.
-     * @todo Implement dimension swapping.
      */
     void
     postInit(std::ostream& stream);
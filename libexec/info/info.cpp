@@ -52,6 +52,9 @@
 #include <ome/common/module.h>
 
 #include <info/options.h>
+#include <info/Benchmark.h>
+#include <info/Catalog.h>
+#include <info/Checksum.h>
 #include <info/ImageInfo.h>
 
 #ifdef _MSC_VER
@@ -130,6 +133,36 @@ namespace
       }
   }
 
+  void
+  run_benchmark(std::ostream& stream,
+                const options& opts)
+  {
+    for (std::vector<std::string>::const_iterator i = opts.files.begin();
+         i != opts.files.end();
+         ++i)
+      {
+        stream << "Image: " << *i << '\n';
+        Benchmark benchmark(*i, opts);
+        benchmark.run(stream);
+        stream << '\n';
+      }
+  }
+
+  void
+  run_checksum(std::ostream& stream,
+               const options& opts)
+  {
+    for (std::vector<std::string>::const_iterator i = opts.files.begin();
+         i != opts.files.end();
+         ++i)
+      {
+        stream << "Image: " << *i << '\n';
+        Checksum checksum(*i, opts);
+        checksum.run(stream);
+        stream << '\n';
+      }
+  }
+
 }
 
 int
@@ -180,6 +213,18 @@ main(int argc, char *argv[])
         case options::ACTION_METADATA:
           print_metadata(std::cout, opts);
           break;
+        case options::ACTION_BENCHMARK:
+          run_benchmark(std::cout, opts);
+          break;
+        case options::ACTION_CHECKSUM:
+          run_checksum(std::cout, opts);
+          break;
+        case options::ACTION_CATALOG:
+          {
+            Catalog catalog(opts);
+            catalog.run(std::cout);
+          }
+          break;
         default:
           print_help(std::cout, opts);
           break;
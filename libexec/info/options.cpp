@@ -56,11 +56,17 @@ namespace info
     group(false),
     stitch(false),
     separate(false),
+    expand(false),
     flat(false),
     series(0),
     resolution(0),
+    iterations(10),
+    tiles(100),
+    seed(0),
+    threads(0),
     format(),
     files(),
+    fileList(),
     inputOrderString(),
     outputOrderString(),
     inputOrder(),
@@ -69,6 +75,7 @@ namespace info
     general("General options"),
     reader("Reader options"),
     metadata("Metadata filtering and display options"),
+    benchmark("Benchmark and checksum options"),
     hidden("Hidden options"),
     positional(),
     visible(),
@@ -112,6 +119,12 @@ namespace info
        "Display manual for this command")
       ("metadata",
        "Display image metadata (default)")
+      ("benchmark",
+       "Time reader initialisation and pixel data reads")
+      ("checksum",
+       "Read all planes and display a checksum of each")
+      ("catalog",
+       "Summarise many files or directories as JSON lines")
       ("version,V",
        "Print version information");
 
@@ -136,6 +149,8 @@ namespace info
       ("no-stitch", "Do not group files with similar names (default)")
       ("separate", "Separate RGB image into separate channels")
       ("no-separate", "Do not separate RGB image into separate channels (default)")
+      ("expand", "Expand indexed color images to RGB")
+      ("no-expand", "Do not expand indexed color images to RGB (default)")
       ("series", opt::value<ome::files::dimension_size_type>(&this->series),
        "Use the specified series")
       ("resolution", opt::value<ome::files::dimension_size_type>(&this->resolution),
@@ -163,6 +178,18 @@ namespace info
       ("used", "Display used files (default)")
       ("no-used", "Do not display used files");
 
+    benchmark.add_options()
+      ("iterations", opt::value<unsigned int>(&this->iterations),
+       "Number of benchmark iterations (default 10)")
+      ("tiles", opt::value<unsigned int>(&this->tiles),
+       "Number of random tile reads per iteration (default 100)")
+      ("seed", opt::value<unsigned int>(&this->seed),
+       "Random seed for tile selection (default 0)")
+      ("threads", opt::value<unsigned int>(&this->threads),
+       "Number of threads for checksum and catalog (default: number of CPUs)")
+      ("file-list", opt::value<std::string>(&this->fileList),
+       "Read catalog file names from a file, one per line (- for stdin)");
+
     hidden.add_options()
       ("files", opt::value<std::vector<std::string>>(&this->files),
        "Files to read");
@@ -209,6 +236,15 @@ namespace info
           global.add(metadata);
           visible.add(metadata);
         }
+#ifndef BOOST_PROGRAM_OPTIONS_DESCRIPTION_OLD
+    if (!benchmark.options().empty())
+#else
+      if (!benchmark.primary_keys().empty())
+#endif
+        {
+          global.add(benchmark);
+          visible.add(benchmark);
+        }
 #ifndef BOOST_PROGRAM_OPTIONS_DESCRIPTION_OLD
     if (!hidden.options().empty())
 #else
@@ -229,6 +265,15 @@ namespace info
     if (vm.count("version"))
       this->action = ACTION_VERSION;
 
+    if (vm.count("benchmark"))
+      this->action = ACTION_BENCHMARK;
+
+    if (vm.count("checksum"))
+      this->action = ACTION_CHECKSUM;
+
+    if (vm.count("catalog"))
+      this->action = ACTION_CATALOG;
+
     if (vm.count("quiet"))
       this->verbosity = MSG_QUIET;
     if (vm.count("verbose"))
@@ -261,6 +306,11 @@ namespace info
     if (vm.count("no-separate"))
       this->separate = false;
 
+    if (vm.count("expand"))
+      this->expand = true;
+    if (vm.count("no-expand"))
+      this->expand = false;
+
     if(!this->inputOrderString.empty())
       this->inputOrder = ome::xml::model::enums::DimensionOrder(inputOrderString);
     if(!this->outputOrderString.empty())
@@ -305,6 +355,8 @@ namespace info
   void
   options::check_actions ()
   {
+    if (this->action == ACTION_BENCHMARK && this->iterations == 0)
+      throw std::runtime_error("--iterations must be at least 1");
   }
 
 }
@@ -78,7 +78,10 @@ namespace info
         ACTION_USAGE,
         ACTION_HELP,
         ACTION_VERSION,
-        ACTION_METADATA
+        ACTION_METADATA,
+        ACTION_BENCHMARK,
+        ACTION_CHECKSUM,
+        ACTION_CATALOG
       };
 
     enum messageVerbosity
@@ -106,12 +109,18 @@ namespace info
     bool group;
     bool stitch;
     bool separate;
+    bool expand;
     bool flat;
     ome::files::dimension_size_type series;
     ome::files::dimension_size_type resolution;
+    unsigned int iterations;
+    unsigned int tiles;
+    unsigned int seed;
+    unsigned int threads;
 
     std::string format;
     std::vector<std::string> files;
+    std::string fileList;
     std::string inputOrderString;
     std::string outputOrderString;
     boost::optional<ome::xml::model::enums::DimensionOrder> inputOrder;
@@ -159,6 +168,8 @@ namespace info
     boost::program_options::options_description            reader;
     /// Metadata options group.
     boost::program_options::options_description            metadata;
+    /// Benchmark and checksum options group.
+    boost::program_options::options_description            benchmark;
     /// Hidden options group.
     boost::program_options::options_description            hidden;
     /// Positional options group.
@@ -0,0 +1,127 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+#include <string>
+
+#include <ome/files/AllocationStatistics.h>
+#include <ome/files/MetadataMap.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/TileBuffer.h>
+
+#include <ome/test/test.h>
+
+using ome::files::AllocationStatistics;
+using ome::files::MetadataMap;
+using ome::files::PixelBuffer;
+using ome::files::TileBuffer;
+
+class AllocationStatisticsTest : public ::testing::Test
+{
+public:
+  virtual void
+  SetUp()
+  {
+    AllocationStatistics::reset();
+    AllocationStatistics::setEnabled(true);
+  }
+
+  virtual void
+  TearDown()
+  {
+    AllocationStatistics::setEnabled(false);
+    AllocationStatistics::reset();
+  }
+};
+
+TEST_F(AllocationStatisticsTest, Disabled)
+{
+  AllocationStatistics::setEnabled(false);
+  EXPECT_FALSE(AllocationStatistics::getEnabled());
+
+  TileBuffer tile(1024U);
+  PixelBuffer<uint16_t> buf(boost::extents[8][8][1][1][1][1][1][1][1]);
+
+  for (std::size_t i = 0; i < AllocationStatistics::kind_count; ++i)
+    {
+      AllocationStatistics::Counts c(AllocationStatistics::get(static_cast<AllocationStatistics::Kind>(i)));
+      EXPECT_EQ(0U, c.allocations);
+      EXPECT_EQ(0U, c.bytes);
+    }
+}
+
+TEST_F(AllocationStatisticsTest, TileBuffer)
+{
+  TileBuffer tile1(1024U);
+  TileBuffer tile2(4096U);
+
+  AllocationStatistics::Counts c(AllocationStatistics::get(AllocationStatistics::TILE_BUFFER));
+  EXPECT_EQ(2U, c.allocations);
+  EXPECT_LE(5120U, c.bytes);
+}
+
+TEST_F(AllocationStatisticsTest, PixelBuffer)
+{
+  PixelBuffer<uint16_t> buf(boost::extents[8][8][1][1][1][3][1][1][1]);
+
+  AllocationStatistics::Counts c(AllocationStatistics::get(AllocationStatistics::PIXEL_BUFFER));
+  EXPECT_EQ(1U, c.allocations);
+  EXPECT_EQ(8U * 8U * 3U * sizeof(uint16_t), c.bytes);
+}
+
+TEST_F(AllocationStatisticsTest, MetadataMap)
+{
+  MetadataMap map;
+  map.set("key1", std::string("value1"));
+  map.set("key2", int32_t(42));
+  // Replacing an existing value does not add an entry.
+  map.set("key1", std::string("value2"));
+
+  AllocationStatistics::Counts c(AllocationStatistics::get(AllocationStatistics::METADATA_MAP));
+  EXPECT_EQ(2U, c.allocations);
+  EXPECT_LT(0U, c.bytes);
+}
+
+TEST_F(AllocationStatisticsTest, Reset)
+{
+  TileBuffer tile(1024U);
+  EXPECT_EQ(1U, AllocationStatistics::get(AllocationStatistics::TILE_BUFFER).allocations);
+
+  AllocationStatistics::reset();
+  EXPECT_EQ(0U, AllocationStatistics::get(AllocationStatistics::TILE_BUFFER).allocations);
+}
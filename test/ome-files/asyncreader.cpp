@@ -0,0 +1,282 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/files/AsyncReader.h>
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/ReadCancelledException.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+
+#include <ome/test/test.h>
+
+using ome::files::AsyncReader;
+using ome::files::CancellationToken;
+using ome::files::CoreMetadata;
+using ome::files::PlaneRegion;
+using ome::files::ReadCancelledException;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("AsyncTestReader", "Reader for asynchronous read testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  const dimension_size_type sizeX = 32U;
+  const dimension_size_type sizeY = 24U;
+
+  uint16_t
+  pixel_value(dimension_size_type series,
+              dimension_size_type plane,
+              dimension_size_type x,
+              dimension_size_type y)
+  {
+    return static_cast<uint16_t>(x + (y * 100U) + (plane * 5000U) + (series * 20000U));
+  }
+
+  void
+  check_region(const VariantPixelBuffer& buf,
+               dimension_size_type       series,
+               dimension_size_type       plane,
+               const PlaneRegion&        region)
+  {
+    ASSERT_EQ(region.w, buf.shape()[ome::files::DIM_SPATIAL_X]);
+    ASSERT_EQ(region.h, buf.shape()[ome::files::DIM_SPATIAL_Y]);
+    for (dimension_size_type y = 0; y < region.h; ++y)
+      for (dimension_size_type x = 0; x < region.w; ++x)
+        ASSERT_EQ(pixel_value(series, plane, region.x + x, region.y + y),
+                  (buf.array<uint16_t>()[x][y][0][0][0][0][0][0][0]));
+  }
+
+}
+
+// Reader generating two series of two UINT16 planes with values
+// from pixel_value().  Reads wait until the gate is opened.
+class AsyncTestReader : public ome::files::detail::FormatReader
+{
+public:
+  mutable std::mutex              mutex;
+  mutable std::condition_variable changed;
+  bool                            open;
+
+  AsyncTestReader():
+    ome::files::detail::FormatReader(props),
+    mutex(),
+    changed(),
+    open(true)
+  {
+  }
+
+  void
+  setGate(bool open)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->open = open;
+    changed.notify_all();
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    core.clear();
+    for (dimension_size_type s = 0; s < 2U; ++s)
+      {
+        std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+        c->sizeX = sizeX;
+        c->sizeY = sizeY;
+        c->sizeZ = 2;
+        c->sizeT = 1;
+        c->sizeC.clear();
+        c->sizeC.push_back(1);
+        c->pixelType = PixelType::UINT16;
+        c->imageCount = 2;
+        c->dimensionOrder = DimensionOrder::XYZCT;
+        c->orderCertain = true;
+        c->interleaved = false;
+        c->indexed = false;
+        c->resolutionCount = 1;
+        core.push_back(c);
+      }
+  }
+
+  void
+  openBytesImpl(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [this]() { return open; });
+    }
+
+    const dimension_size_type s = getSeries();
+    preparePlane(buf, w, h, 1U);
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        buf.array<uint16_t>()[i][j][0][0][0][0][0][0][0] = pixel_value(s, plane, x + i, y + j);
+  }
+};
+
+TEST(AsyncReader, Futures)
+{
+  std::shared_ptr<AsyncTestReader> reader(std::make_shared<AsyncTestReader>());
+  reader->setId("test");
+  reader->setExecutor(std::make_shared<ome::files::ThreadPoolExecutor>(3U));
+
+  AsyncReader async(reader, 2U);
+  EXPECT_EQ(reader, async.getReader());
+
+  // Requests are queued without blocking while reads can not
+  // progress.
+  reader->setGate(false);
+  std::vector<std::future<AsyncReader::result_type>> results;
+  std::vector<std::array<dimension_size_type, 2>> requests;
+  std::vector<PlaneRegion> regions;
+  for (dimension_size_type i = 0; i < 200U; ++i)
+    {
+      const dimension_size_type series = i % 2U;
+      const dimension_size_type plane = (i / 2U) % 2U;
+      const PlaneRegion region(i % 20U, i % 17U, 1U + (i % 12U), 1U + (i % 7U));
+      results.push_back(async.openBytesAsync(series, 0U, plane, region));
+      requests.push_back({{series, plane}});
+      regions.push_back(region);
+    }
+  EXPECT_EQ(200U, async.pending());
+
+  reader->setGate(true);
+  for (std::size_t i = 0; i < results.size(); ++i)
+    {
+      AsyncReader::result_type buf;
+      ASSERT_NO_THROW(buf = results[i].get());
+      ASSERT_TRUE(static_cast<bool>(buf));
+      check_region(*buf, requests[i][0], requests[i][1], regions[i]);
+    }
+  async.wait();
+  EXPECT_EQ(0U, async.pending());
+
+  // The current series of the reader is unchanged.
+  EXPECT_EQ(0U, reader->getSeries());
+}
+
+TEST(AsyncReader, Callbacks)
+{
+  std::shared_ptr<AsyncTestReader> reader(std::make_shared<AsyncTestReader>());
+  reader->setId("test");
+
+  std::atomic<unsigned int> completed(0U);
+  std::atomic<unsigned int> failed(0U);
+  {
+    AsyncReader async(reader);
+    for (dimension_size_type i = 0; i < 50U; ++i)
+      async.openBytesAsync(1U, 0U, 1U, PlaneRegion(2U, 3U, 4U, 5U),
+                           [&](AsyncReader::result_type buf,
+                               std::exception_ptr       error)
+                           {
+                             if (error || !buf)
+                               ++failed;
+                             else
+                               {
+                                 check_region(*buf, 1U, 1U, PlaneRegion(2U, 3U, 4U, 5U));
+                                 ++completed;
+                               }
+                           });
+
+    // Errors are passed to the callback.
+    async.openBytesAsync(0U, 0U, 2U, PlaneRegion(0U, 0U, 1U, 1U),
+                         [&](AsyncReader::result_type buf,
+                             std::exception_ptr       error)
+                         {
+                           EXPECT_FALSE(static_cast<bool>(buf));
+                           EXPECT_THROW(std::rethrow_exception(error), std::logic_error);
+                           ++failed;
+                         });
+
+    // Destruction waits for all requests.
+  }
+  EXPECT_EQ(50U, completed.load());
+  EXPECT_EQ(1U, failed.load());
+}
+
+TEST(AsyncReader, Cancel)
+{
+  std::shared_ptr<AsyncTestReader> reader(std::make_shared<AsyncTestReader>());
+  reader->setId("test");
+
+  AsyncReader async(reader);
+
+  // The token of the requesting thread applies to the request.
+  CancellationToken token;
+  token.cancel();
+  std::future<AsyncReader::result_type> cancelled;
+  {
+    CancellationToken::Scope scope(token);
+    cancelled = async.openBytesAsync(0U, 0U, 0U, PlaneRegion(0U, 0U, 8U, 8U));
+  }
+  std::future<AsyncReader::result_type> uncancelled(async.openBytesAsync(0U, 0U, 0U, PlaneRegion(0U, 0U, 8U, 8U)));
+
+  EXPECT_THROW(cancelled.get(), ReadCancelledException);
+  EXPECT_NO_THROW(uncancelled.get());
+}
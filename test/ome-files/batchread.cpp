@@ -0,0 +1,158 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#ifndef _MSC_VER
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <ome/files/detail/BatchRead.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::detail::BatchReadRequest;
+using ome::files::detail::asyncBatchRead;
+using ome::files::detail::readBatch;
+
+#ifndef _MSC_VER
+
+namespace
+{
+
+  class BatchReadTest : public ::testing::Test
+  {
+  public:
+    std::vector<uint8_t> data;
+    int fd;
+
+    BatchReadTest():
+      data(1024U * 1024U),
+      fd(-1)
+    {
+    }
+
+    void
+    SetUp()
+    {
+      boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+      if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+        throw std::runtime_error("Data directory unavailable and could not be created");
+      boost::filesystem::path filename(dir / "batchread.bin");
+
+      for (std::vector<uint8_t>::size_type i = 0; i < data.size(); ++i)
+        data[i] = static_cast<uint8_t>(((i * 131U) + 7U) % 251U);
+
+      {
+        std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+      }
+
+      fd = ::open(filename.string().c_str(), O_RDONLY);
+      ASSERT_LE(0, fd);
+    }
+
+    void
+    TearDown()
+    {
+      if (fd >= 0)
+        ::close(fd);
+    }
+  };
+
+}
+
+TEST_F(BatchReadTest, Read)
+{
+  std::cout << "Asynchronous: " << asyncBatchRead() << '\n';
+
+  // More requests than the queue depth, including an empty read.
+  std::vector<std::vector<uint8_t>> bufs(300U);
+  std::vector<BatchReadRequest> requests;
+  for (std::size_t i = 0; i < bufs.size(); ++i)
+    {
+      bufs[i].resize((i * 37U) % 3000U);
+      requests.push_back(BatchReadRequest{(i * 7919U) % (data.size() - 3000U), bufs[i].data(), bufs[i].size()});
+    }
+
+  std::vector<unsigned int> completed(requests.size(), 0U);
+  ASSERT_TRUE(readBatch(fd, requests, [&](std::size_t i) { ++completed[i]; }));
+
+  for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+      EXPECT_EQ(1U, completed[i]);
+      EXPECT_TRUE(std::equal(bufs[i].begin(), bufs[i].end(),
+                             data.begin() + static_cast<std::ptrdiff_t>(requests[i].offset)));
+    }
+}
+
+TEST_F(BatchReadTest, CompletionError)
+{
+  std::vector<std::vector<uint8_t>> bufs(100U, std::vector<uint8_t>(1000U));
+  std::vector<BatchReadRequest> requests;
+  for (std::size_t i = 0; i < bufs.size(); ++i)
+    requests.push_back(BatchReadRequest{i * 1000U, bufs[i].data(), bufs[i].size()});
+
+  EXPECT_THROW(readBatch(fd, requests,
+                         [](std::size_t i) { if (i == 50U) throw std::logic_error("Completion failed"); }),
+               std::logic_error);
+
+  // Usable after an error.
+  std::size_t count = 0U;
+  ASSERT_TRUE(readBatch(fd, requests, [&](std::size_t) { ++count; }));
+  EXPECT_EQ(requests.size(), count);
+}
+
+TEST_F(BatchReadTest, EndOfFile)
+{
+  std::vector<uint8_t> buf(100U);
+  std::vector<BatchReadRequest> requests{BatchReadRequest{data.size() - 10U, buf.data(), buf.size()}};
+
+  EXPECT_THROW(readBatch(fd, requests, [](std::size_t) {}), std::runtime_error);
+}
+
+#endif // ! _MSC_VER
@@ -0,0 +1,229 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <ome/files/detail/BitPack.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::detail::packBits;
+using ome::files::detail::packSamples;
+using ome::files::detail::unpackBits;
+using ome::files::detail::unpackSamples;
+
+namespace
+{
+
+  std::vector<uint8_t>
+  random_bytes(dimension_size_type size)
+  {
+    std::mt19937 gen(42U);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::vector<uint8_t> bytes(size);
+    for (auto& b : bytes)
+      b = static_cast<uint8_t>(dist(gen));
+    return bytes;
+  }
+
+  bool
+  reference_bit(const std::vector<uint8_t>& bytes,
+                dimension_size_type         bit)
+  {
+    return (bytes.at(bit / 8U) & (0x80U >> (bit % 8U))) != 0;
+  }
+
+  uint16_t
+  reference_sample(const std::vector<uint8_t>& bytes,
+                   dimension_size_type         index,
+                   uint16_t                    bits)
+  {
+    uint16_t value = 0U;
+    for (dimension_size_type b = 0; b < bits; ++b)
+      value = static_cast<uint16_t>((value << 1) | (reference_bit(bytes, (index * bits) + b) ? 1U : 0U));
+    return value;
+  }
+
+}
+
+TEST(BitPack, Unpack)
+{
+  const std::vector<uint8_t> src(random_bytes(256U));
+
+  // Cover unaligned heads and tails, and spans shorter and longer
+  // than the SIMD block sizes.
+  for (dimension_size_type offset = 0; offset < 19; ++offset)
+    for (dimension_size_type count = 0; count < 1500; count += 7)
+      {
+        std::vector<uint8_t> dest(count + 1, 2U);
+        unpackBits(src.data(), offset, reinterpret_cast<bool *>(dest.data()), count);
+        for (dimension_size_type i = 0; i < count; ++i)
+          ASSERT_EQ(reference_bit(src, offset + i) ? 1U : 0U, dest[i]);
+        // Not overrun.
+        ASSERT_EQ(2U, dest[count]);
+      }
+}
+
+TEST(BitPack, Pack)
+{
+  const std::vector<uint8_t> bits(random_bytes(256U));
+
+  for (dimension_size_type offset = 0; offset < 19; ++offset)
+    for (dimension_size_type count = 0; count < 1500; count += 7)
+      {
+        std::vector<uint8_t> values(count);
+        for (dimension_size_type i = 0; i < count; ++i)
+          values[i] = reference_bit(bits, i) ? 1U : 0U;
+
+        std::vector<uint8_t> dest(256U, 0U);
+        packBits(reinterpret_cast<const bool *>(values.data()), dest.data(), offset, count);
+        for (dimension_size_type i = 0; i < dest.size() * 8U; ++i)
+          {
+            bool expected = (i >= offset && i < offset + count) ? values[i - offset] != 0 : false;
+            ASSERT_EQ(expected, reference_bit(dest, i));
+          }
+      }
+}
+
+TEST(BitPack, PackCombine)
+{
+  // Partial bytes are combined with existing content.
+  std::vector<uint8_t> dest{0x81U, 0x00U, 0x01U};
+  std::vector<uint8_t> values(14U, 1U);
+  packBits(reinterpret_cast<const bool *>(values.data()), dest.data(), 3U, values.size());
+  EXPECT_EQ(0x9FU, dest[0]);
+  EXPECT_EQ(0xFFU, dest[1]);
+  EXPECT_EQ(0x81U, dest[2]);
+}
+
+TEST(BitPack, RoundTrip)
+{
+  const std::vector<uint8_t> src(random_bytes(4096U));
+  std::vector<uint8_t> values(src.size() * 8U);
+  std::vector<uint8_t> dest(src.size(), 0U);
+
+  unpackBits(src.data(), 0U, reinterpret_cast<bool *>(values.data()), values.size());
+  packBits(reinterpret_cast<const bool *>(values.data()), dest.data(), 0U, values.size());
+  EXPECT_EQ(src, dest);
+}
+
+TEST(BitPack, UnpackSamples)
+{
+  const std::vector<uint8_t> src(random_bytes(4096U));
+
+  // Cover every sample size, and counts shorter and longer than the
+  // SIMD block sizes.
+  for (uint16_t bits = 1U; bits <= 16U; ++bits)
+    for (dimension_size_type count = 0; count < 200; count += 3)
+      {
+        std::vector<uint16_t> dest(count + 1, 0xFFFFU);
+        unpackSamples(src.data(), dest.data(), count, bits);
+        for (dimension_size_type i = 0; i < count; ++i)
+          ASSERT_EQ(reference_sample(src, i, bits), dest[i]);
+        // Not overrun.
+        ASSERT_EQ(0xFFFFU, dest[count]);
+
+        if (bits <= 8U)
+          {
+            std::vector<uint8_t> dest8(count + 1, 0xFFU);
+            unpackSamples(src.data(), dest8.data(), count, bits);
+            for (dimension_size_type i = 0; i < count; ++i)
+              ASSERT_EQ(reference_sample(src, i, bits), dest8[i]);
+            ASSERT_EQ(0xFFU, dest8[count]);
+          }
+      }
+}
+
+TEST(BitPack, PackSamples)
+{
+  const std::vector<uint8_t> src(random_bytes(4096U));
+
+  for (uint16_t bits = 1U; bits <= 16U; ++bits)
+    for (dimension_size_type count = 0; count < 200; count += 3)
+      {
+        // Unused high bits are discarded.
+        std::vector<uint16_t> values(count);
+        for (dimension_size_type i = 0; i < count; ++i)
+          values[i] = static_cast<uint16_t>(reference_sample(src, i, 16U) | (1U << (bits - 1U)));
+
+        const dimension_size_type size = ((count * bits) + 7U) / 8U;
+        std::vector<uint8_t> dest(size + 1, 0xAAU);
+        packSamples(values.data(), dest.data(), count, bits);
+        for (dimension_size_type i = 0; i < size * 8U; ++i)
+          {
+            bool expected = i < count * bits ?
+              (values[i / bits] & (1U << (bits - 1U - (i % bits)))) != 0 : false;
+            ASSERT_EQ(expected, reference_bit(dest, i));
+          }
+        // Not overrun.
+        ASSERT_EQ(0xAAU, dest[size]);
+      }
+}
+
+TEST(BitPack, SampleRoundTrip)
+{
+  const std::vector<uint8_t> src(random_bytes(4096U));
+
+  for (uint16_t bits : {10U, 12U, 14U})
+    {
+      const dimension_size_type count = (src.size() * 8U) / bits;
+      std::vector<uint16_t> values(count);
+      std::vector<uint8_t> dest(src.size(), 0U);
+
+      unpackSamples(src.data(), values.data(), count, bits);
+      packSamples(values.data(), dest.data(), count, bits);
+      const dimension_size_type size = (count * bits) / 8U;
+      EXPECT_TRUE(std::equal(src.begin(), src.begin() + size, dest.begin()));
+    }
+
+  for (uint16_t bits : {2U, 4U, 6U})
+    {
+      const dimension_size_type count = (src.size() * 8U) / bits;
+      std::vector<uint8_t> values(count);
+      std::vector<uint8_t> dest(src.size(), 0U);
+
+      unpackSamples(src.data(), values.data(), count, bits);
+      packSamples(values.data(), dest.data(), count, bits);
+      const dimension_size_type size = (count * bits) / 8U;
+      EXPECT_TRUE(std::equal(src.begin(), src.begin() + size, dest.begin()));
+    }
+}
@@ -0,0 +1,496 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/ByteSource.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::VariantPixelBuffer;
+using ome::files::tiff::ByteSource;
+using ome::files::tiff::CachedByteSource;
+using ome::files::tiff::DiskCachedByteSource;
+using ome::files::tiff::FileByteSource;
+using ome::files::tiff::IFD;
+using ome::files::tiff::offset_type;
+using ome::files::tiff::TIFF;
+
+namespace
+{
+
+  // In-memory source recording the requests made.
+  class MemoryByteSource : public ByteSource
+  {
+  public:
+    std::vector<uint8_t> data;
+    mutable std::vector<std::pair<offset_type, dimension_size_type>> requests;
+
+    explicit
+    MemoryByteSource(dimension_size_type size):
+      data(size),
+      requests()
+    {
+      for (dimension_size_type i = 0; i < size; ++i)
+        data[i] = static_cast<uint8_t>((i * 13U) % 251U);
+    }
+
+    std::string
+    name() const
+    {
+      return "memory";
+    }
+
+    offset_type
+    size() const
+    {
+      return data.size();
+    }
+
+    void
+    read(offset_type         offset,
+         void               *buf,
+         dimension_size_type size) const
+    {
+      if (offset + size > data.size())
+        throw ome::files::tiff::Exception("Out of range");
+      requests.push_back(std::make_pair(offset, size));
+      std::copy(data.begin() + offset, data.begin() + offset + size,
+                static_cast<uint8_t *>(buf));
+    }
+  };
+
+  std::vector<uint8_t>
+  read(const ByteSource&   source,
+       offset_type         offset,
+       dimension_size_type size)
+  {
+    std::vector<uint8_t> buf(size);
+    source.read(offset, buf.data(), size);
+    return buf;
+  }
+
+  std::vector<uint8_t>
+  expected(const MemoryByteSource& source,
+           offset_type             offset,
+           dimension_size_type     size)
+  {
+    return std::vector<uint8_t>(source.data.begin() + offset,
+                                source.data.begin() + offset + size);
+  }
+
+}
+
+TEST(FileByteSource, Read)
+{
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  boost::filesystem::path filename(dir / "bytesource.bin");
+
+  {
+    std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    for (unsigned int i = 0; i < 1000U; ++i)
+      out.put(static_cast<char>(i % 256U));
+  }
+
+  {
+    FileByteSource source(filename);
+    ASSERT_EQ(1000U, source.size());
+    ASSERT_EQ(filename.string(), source.name());
+
+    std::vector<uint8_t> buf(read(source, 250U, 10U));
+    for (unsigned int i = 0; i < 10U; ++i)
+      ASSERT_EQ((250U + i) % 256U, buf[i]);
+
+    ASSERT_NO_THROW(read(source, 990U, 10U));
+    ASSERT_THROW(read(source, 995U, 10U), ome::files::tiff::Exception);
+  }
+
+  boost::filesystem::remove(filename);
+  ASSERT_THROW(FileByteSource source(filename), ome::files::tiff::Exception);
+}
+
+TEST(CachedByteSource, Construct)
+{
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(1000U));
+  ASSERT_THROW(CachedByteSource(std::shared_ptr<ByteSource>()), ome::files::tiff::Exception);
+  ASSERT_THROW(CachedByteSource(mem, 0U), ome::files::tiff::Exception);
+  ASSERT_THROW(CachedByteSource(mem, 16U, 0U), ome::files::tiff::Exception);
+
+  CachedByteSource cache(mem, 16U, 4U);
+  ASSERT_EQ(1000U, cache.size());
+  ASSERT_EQ("memory", cache.name());
+}
+
+TEST(CachedByteSource, Hit)
+{
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(1000U));
+  CachedByteSource cache(mem, 100U, 8U);
+
+  ASSERT_EQ(expected(*mem, 10U, 20U), read(cache, 10U, 20U));
+  ASSERT_EQ(1U, cache.requests());
+  ASSERT_EQ(expected(*mem, 50U, 40U), read(cache, 50U, 40U));
+  ASSERT_EQ(1U, cache.requests());
+  ASSERT_EQ(1U, cache.count());
+  ASSERT_EQ(0U, mem->requests.front().first);
+  ASSERT_EQ(100U, mem->requests.front().second);
+}
+
+TEST(CachedByteSource, Coalesce)
+{
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(1000U));
+  CachedByteSource cache(mem, 100U, 16U);
+
+  // Cache block 3 only.
+  read(cache, 310U, 10U);
+  ASSERT_EQ(1U, cache.requests());
+
+  // Blocks 1-2 and 4-6 are fetched as two runs.
+  ASSERT_EQ(expected(*mem, 150U, 500U), read(cache, 150U, 500U));
+  ASSERT_EQ(3U, cache.requests());
+  ASSERT_EQ(100U, mem->requests.at(1).first);
+  ASSERT_EQ(200U, mem->requests.at(1).second);
+  ASSERT_EQ(400U, mem->requests.at(2).first);
+  ASSERT_EQ(300U, mem->requests.at(2).second);
+  ASSERT_EQ(6U, cache.count());
+}
+
+TEST(CachedByteSource, End)
+{
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(1000U));
+  CachedByteSource cache(mem, 128U, 16U);
+
+  // The last block is short.
+  ASSERT_EQ(expected(*mem, 900U, 100U), read(cache, 900U, 100U));
+  ASSERT_EQ(896U, mem->requests.back().first);
+  ASSERT_EQ(104U, mem->requests.back().second);
+  ASSERT_THROW(read(cache, 990U, 20U), ome::files::tiff::Exception);
+  ASSERT_NO_THROW(read(cache, 1000U, 0U));
+}
+
+TEST(CachedByteSource, Evict)
+{
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(1000U));
+  CachedByteSource cache(mem, 100U, 2U);
+
+  // A read larger than the cache is still complete.
+  ASSERT_EQ(expected(*mem, 0U, 1000U), read(cache, 0U, 1000U));
+  ASSERT_EQ(2U, cache.count());
+
+  // Blocks 8 and 9 remain; use 8 so that 9 is evicted next.
+  read(cache, 800U, 1U);
+  ASSERT_EQ(1U, cache.requests());
+  read(cache, 0U, 1U);
+  ASSERT_EQ(2U, cache.requests());
+  read(cache, 850U, 1U);
+  ASSERT_EQ(2U, cache.requests());
+  read(cache, 950U, 1U);
+  ASSERT_EQ(3U, cache.requests());
+
+  cache.clear();
+  ASSERT_EQ(0U, cache.count());
+}
+
+namespace
+{
+
+  boost::filesystem::path
+  cacheDirectory(const std::string& name)
+  {
+    boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+    dir /= name;
+    boost::filesystem::remove_all(dir);
+    return dir;
+  }
+
+}
+
+TEST(DiskCachedByteSource, Construct)
+{
+  boost::filesystem::path dir(cacheDirectory("bytesource-disk-construct"));
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(100U));
+  ASSERT_THROW(DiskCachedByteSource(std::shared_ptr<ByteSource>(), dir, 1000U), ome::files::tiff::Exception);
+  ASSERT_THROW(DiskCachedByteSource(mem, dir, 0U), ome::files::tiff::Exception);
+  ASSERT_THROW(DiskCachedByteSource(mem, dir, 1000U, 0U), ome::files::tiff::Exception);
+
+  DiskCachedByteSource cache(mem, dir, 1000U, 16U);
+  ASSERT_TRUE(boost::filesystem::is_directory(dir));
+  ASSERT_EQ(100U, cache.size());
+  ASSERT_EQ(std::string("memory"), cache.name());
+  ASSERT_EQ(0U, cache.bytes());
+}
+
+TEST(DiskCachedByteSource, Persist)
+{
+  boost::filesystem::path dir(cacheDirectory("bytesource-disk-persist"));
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(1000U));
+
+  {
+    DiskCachedByteSource cache(mem, dir, 100000U, 128U);
+    read(cache, 300U, 10U);
+    // Blocks 0-1 and 3-6 are fetched as two runs.
+    ASSERT_EQ(expected(*mem, 0U, 890U), read(cache, 0U, 890U));
+    ASSERT_EQ(3U, cache.requests());
+    ASSERT_EQ(0U, mem->requests.at(1).first);
+    ASSERT_EQ(256U, mem->requests.at(1).second);
+    ASSERT_EQ(384U, mem->requests.at(2).first);
+    ASSERT_EQ(512U, mem->requests.at(2).second);
+    ASSERT_EQ(expected(*mem, 0U, 890U), read(cache, 0U, 890U));
+    ASSERT_EQ(3U, cache.requests());
+    ASSERT_EQ(896U, cache.bytes());
+  }
+
+  // A new cache over the same directory reuses the blocks; the
+  // short last block is fetched.
+  {
+    DiskCachedByteSource cache(mem, dir, 100000U, 128U);
+    ASSERT_EQ(896U, cache.bytes());
+    ASSERT_EQ(expected(*mem, 100U, 700U), read(cache, 100U, 700U));
+    ASSERT_EQ(0U, cache.requests());
+    ASSERT_EQ(expected(*mem, 900U, 100U), read(cache, 900U, 100U));
+    ASSERT_EQ(1U, cache.requests());
+    ASSERT_EQ(1000U, cache.bytes());
+  }
+
+  // Corrupt blocks are refetched.
+  for (boost::filesystem::directory_iterator i(dir), end; i != end; ++i)
+    {
+      std::ofstream out(i->path().string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      out.put('x');
+    }
+  {
+    DiskCachedByteSource cache(mem, dir, 100000U, 128U);
+    ASSERT_EQ(8U, cache.bytes());
+    ASSERT_EQ(expected(*mem, 0U, 1000U), read(cache, 0U, 1000U));
+    ASSERT_EQ(8U, cache.requests());
+    ASSERT_EQ(1000U, cache.bytes());
+  }
+
+  // A different source does not share blocks.
+  {
+    std::shared_ptr<MemoryByteSource> other(std::make_shared<MemoryByteSource>(500U));
+    DiskCachedByteSource cache(other, dir, 100000U, 128U);
+    ASSERT_EQ(expected(*other, 0U, 500U), read(cache, 0U, 500U));
+    ASSERT_EQ(1U, cache.requests());
+    ASSERT_EQ(1500U, cache.bytes());
+  }
+}
+
+TEST(DiskCachedByteSource, Evict)
+{
+  boost::filesystem::path dir(cacheDirectory("bytesource-disk-evict"));
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(1000U));
+
+  {
+    DiskCachedByteSource cache(mem, dir, 250U, 100U);
+
+    // A read larger than the cache is still complete.
+    ASSERT_EQ(expected(*mem, 0U, 1000U), read(cache, 0U, 1000U));
+    ASSERT_EQ(200U, cache.bytes());
+
+    // Blocks 8 and 9 remain; use 8 so that 9 is evicted next.
+    read(cache, 800U, 1U);
+    ASSERT_EQ(1U, cache.requests());
+    read(cache, 0U, 1U);
+    ASSERT_EQ(2U, cache.requests());
+    read(cache, 850U, 1U);
+    ASSERT_EQ(2U, cache.requests());
+    read(cache, 950U, 1U);
+    ASSERT_EQ(3U, cache.requests());
+    ASSERT_EQ(200U, cache.bytes());
+  }
+
+  dimension_size_type files = 0U;
+  for (boost::filesystem::directory_iterator i(dir), end; i != end; ++i)
+    ++files;
+  ASSERT_EQ(2U, files);
+
+  // A smaller limit evicts on reopening.
+  {
+    DiskCachedByteSource cache(mem, dir, 150U, 100U);
+    ASSERT_EQ(100U, cache.bytes());
+  }
+}
+
+TEST(DiskCachedByteSource, Tiered)
+{
+  boost::filesystem::path dir(cacheDirectory("bytesource-disk-tiered"));
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(1000U));
+
+  {
+    std::shared_ptr<DiskCachedByteSource> disk(std::make_shared<DiskCachedByteSource>(mem, dir, 100000U, 100U));
+    CachedByteSource cache(disk, 100U, 2U);
+    ASSERT_EQ(expected(*mem, 0U, 1000U), read(cache, 0U, 1000U));
+    ASSERT_EQ(expected(*mem, 0U, 1000U), read(cache, 0U, 1000U));
+    ASSERT_EQ(1U, disk->requests());
+  }
+
+  {
+    std::shared_ptr<DiskCachedByteSource> disk(std::make_shared<DiskCachedByteSource>(mem, dir, 100000U, 100U));
+    CachedByteSource cache(disk, 100U, 16U);
+    ASSERT_EQ(expected(*mem, 0U, 1000U), read(cache, 0U, 1000U));
+    ASSERT_EQ(0U, disk->requests());
+  }
+}
+
+TEST(ByteSourceTIFF, CoalescedStrips)
+{
+  using namespace ome::files::tiff;
+  typedef ome::xml::model::enums::PixelType PT;
+
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  boost::filesystem::path filename(dir / "bytesource-strips.tiff");
+
+  std::array<ome::files::VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = 64;
+  shape[ome::files::DIM_SPATIAL_Y] = 200;
+  shape[ome::files::DIM_SUBCHANNEL] = 1;
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+
+  ome::files::VariantPixelBuffer pixels(shape, PT::UINT16);
+  std::shared_ptr<ome::files::PixelBuffer<uint16_t>> pbuf(ome::compat::get<std::shared_ptr<ome::files::PixelBuffer<uint16_t>>>(pixels.vbuffer()));
+  for (dimension_size_type i = 0; i < pbuf->num_elements(); ++i)
+    pbuf->data()[i] = static_cast<uint16_t>((i * 37U) % 65536U);
+
+  // One row per strip.
+  {
+    std::shared_ptr<TIFF> wtiff(TIFF::open(filename, "w"));
+    std::shared_ptr<IFD> wifd(wtiff->getCurrentDirectory());
+    wifd->setImageWidth(64);
+    wifd->setImageHeight(200);
+    wifd->setTileType(STRIP);
+    wifd->setTileHeight(1);
+    wifd->setPixelType(PT::UINT16);
+    wifd->setBitsPerSample(16);
+    wifd->setSamplesPerPixel(1);
+    wifd->setPlanarConfiguration(CONTIG);
+    wifd->setPhotometricInterpretation(MIN_IS_BLACK);
+    wifd->setCompression(COMPRESSION_ADOBE_DEFLATE);
+    wifd->writeImage(pixels);
+    wtiff->writeCurrentDirectory();
+    wtiff->close();
+  }
+
+  std::shared_ptr<MemoryByteSource> mem(std::make_shared<MemoryByteSource>(0U));
+  {
+    std::ifstream in(filename.string().c_str(), std::ios::in | std::ios::binary);
+    mem->data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  std::shared_ptr<TIFF> tiff(TIFF::open(mem, "r"));
+  std::shared_ptr<IFD> ifd(tiff->getDirectoryByIndex(0));
+
+  mem->requests.clear();
+  ome::files::VariantPixelBuffer full;
+  ASSERT_NO_THROW(ifd->readImage(full));
+  EXPECT_EQ(pixels, full);
+  // Never more than one read per strip.
+  EXPECT_GE(200U, mem->requests.size());
+
+  std::shared_ptr<TIFF> filetiff(TIFF::open(filename, "r"));
+  for (dimension_size_type y = 0; y < 200U; y += 37U)
+    {
+      const dimension_size_type h = std::min(dimension_size_type(50U), 200U - y);
+      ome::files::VariantPixelBuffer expected;
+      ome::files::VariantPixelBuffer region;
+      filetiff->getDirectoryByIndex(0)->readImage(expected, 5, y, 40, h);
+      ASSERT_NO_THROW(ifd->readImage(region, 5, y, 40, h));
+      EXPECT_EQ(expected, region);
+    }
+}
+
+class ByteSourceTIFFTest : public TIFFPixelsTest
+{
+public:
+  ByteSourceTIFFTest():
+    TIFFPixelsTest("bytesource")
+  {
+  }
+};
+
+TEST_F(ByteSourceTIFFTest, RangeRequests)
+{
+  std::shared_ptr<ome::files::tiff::CachedByteSource> source
+    (std::make_shared<ome::files::tiff::CachedByteSource>
+     (std::make_shared<ome::files::tiff::FileByteSource>(filenames.at(0))));
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(source, "r");
+  ASSERT_EQ(1U, tiff->directoryCount());
+  EXPECT_FALSE(tiff->isMapped());
+  ASSERT_THROW(TIFF::open(source, "w"), ome::files::tiff::Exception);
+
+  // A small region needs only a few range requests, not the whole file.
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  VariantPixelBuffer region;
+  ASSERT_NO_THROW(ifd->readImage(region, 0U, 0U, tile_size, tile_size));
+  const uint16_pixel_type *data = expected.at(0).data<uint16_pixel_type>();
+  const uint16_pixel_type *rdata = region.data<uint16_pixel_type>();
+  for (dimension_size_type y = 0; y < tile_size; ++y)
+    for (dimension_size_type x = 0; x < tile_size; ++x)
+      ASSERT_EQ(data[(y * image_size) + x], rdata[(y * tile_size) + x]);
+  EXPECT_LT(source->requests(), 8U);
+
+  // Parallel decoding uses independent handles on the same source.
+  tiff->setDecodeThreads(4U);
+  VariantPixelBuffer plane;
+  ASSERT_NO_THROW(ifd->readImage(plane));
+  EXPECT_TRUE(expected.at(0) == plane);
+
+  tiff->close();
+}
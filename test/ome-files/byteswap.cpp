@@ -0,0 +1,143 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <ome/files/detail/ByteSwap.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::detail::byteswap;
+
+namespace
+{
+
+  // Fill with distinct byte values.
+  template<typename T>
+  std::vector<T>
+  make_values(dimension_size_type count)
+  {
+    std::vector<T> values(count);
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(values.data());
+    for (dimension_size_type i = 0; i < count * sizeof(T); ++i)
+      bytes[i] = static_cast<uint8_t>((i * 7U) + 3U);
+    return values;
+  }
+
+  // Reverse each component byte by byte.
+  template<typename T>
+  std::vector<T>
+  reference_swap(const std::vector<T>& values,
+                 dimension_size_type   componentsize)
+  {
+    std::vector<T> swapped(values);
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(swapped.data());
+    for (dimension_size_type i = 0; i < values.size() * sizeof(T); i += componentsize)
+      std::reverse(bytes + i, bytes + i + componentsize);
+    return swapped;
+  }
+
+  template<typename T>
+  void
+  check_swap(dimension_size_type componentsize)
+  {
+    // Cover lengths shorter and longer than the SIMD block sizes,
+    // and unaligned starts.
+    for (dimension_size_type count = 0; count < 41; ++count)
+      for (dimension_size_type offset = 0; offset < 3; ++offset)
+        {
+          std::vector<T> values(make_values<T>(count + offset));
+          std::vector<T> expected(reference_swap(values, componentsize));
+          for (dimension_size_type i = 0; i < offset; ++i)
+            expected[i] = values[i];
+
+          byteswap(values.data() + offset, count);
+          ASSERT_EQ(0, std::memcmp(expected.data(), values.data(), values.size() * sizeof(T)))
+            << "count=" << count << " offset=" << offset;
+        }
+  }
+
+}
+
+TEST(ByteSwap, Int8)
+{
+  check_swap<int8_t>(1U);
+  check_swap<uint8_t>(1U);
+}
+
+TEST(ByteSwap, Int16)
+{
+  check_swap<int16_t>(2U);
+  check_swap<uint16_t>(2U);
+}
+
+TEST(ByteSwap, Int32)
+{
+  check_swap<int32_t>(4U);
+  check_swap<uint32_t>(4U);
+}
+
+TEST(ByteSwap, Int64)
+{
+  check_swap<uint64_t>(8U);
+}
+
+TEST(ByteSwap, Float)
+{
+  check_swap<float>(4U);
+  check_swap<double>(8U);
+}
+
+TEST(ByteSwap, Complex)
+{
+  check_swap<std::complex<float>>(4U);
+  check_swap<std::complex<double>>(8U);
+}
+
+TEST(ByteSwap, Scalar)
+{
+  std::vector<uint32_t> values{0x01020304U, 0xA0B0C0D0U};
+  byteswap(values.data(), values.size());
+  EXPECT_EQ(0x04030201U, values[0]);
+  EXPECT_EQ(0xD0C0B0A0U, values[1]);
+}
@@ -0,0 +1,185 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/ReadCancelledException.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::CancellationToken;
+using ome::files::ReadCancelledException;
+using ome::files::ThreadPoolExecutor;
+using ome::files::VariantPixelBuffer;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+
+TEST(CancellationToken, Cancel)
+{
+  CancellationToken token;
+  EXPECT_FALSE(token.cancelled());
+  EXPECT_NO_THROW(token.check());
+  EXPECT_EQ(CancellationToken::time_point::max(), token.getDeadline());
+
+  // Copies share the cancellation state.
+  const CancellationToken copy(token);
+  copy.cancel();
+  EXPECT_TRUE(token.cancelled());
+  EXPECT_THROW(token.check(), ReadCancelledException);
+}
+
+TEST(CancellationToken, Deadline)
+{
+  CancellationToken past(CancellationToken::clock_type::now() - std::chrono::seconds(1));
+  EXPECT_TRUE(past.cancelled());
+  EXPECT_THROW(past.check(), ReadCancelledException);
+
+  CancellationToken future(std::chrono::hours(1));
+  EXPECT_FALSE(future.cancelled());
+  EXPECT_NO_THROW(future.check());
+
+  CancellationToken timeout(std::chrono::milliseconds(10));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_TRUE(timeout.cancelled());
+}
+
+TEST(CancellationToken, Scope)
+{
+  EXPECT_EQ(nullptr, CancellationToken::current());
+
+  CancellationToken outer;
+  CancellationToken inner;
+  {
+    CancellationToken::Scope s1(outer);
+    EXPECT_EQ(&outer, CancellationToken::current());
+    {
+      CancellationToken::Scope s2(inner);
+      EXPECT_EQ(&inner, CancellationToken::current());
+      {
+        CancellationToken::Scope s3(nullptr);
+        EXPECT_EQ(nullptr, CancellationToken::current());
+      }
+      EXPECT_EQ(&inner, CancellationToken::current());
+    }
+    EXPECT_EQ(&outer, CancellationToken::current());
+  }
+  EXPECT_EQ(nullptr, CancellationToken::current());
+}
+
+TEST(CancellationToken, Parallel)
+{
+  ThreadPoolExecutor pool(4U);
+  std::atomic<int> count(0);
+
+  CancellationToken token;
+  CancellationToken::Scope scope(token);
+
+  // The token applies to the tasks run by the pool.
+  pool.parallel(8U,
+                [&](unsigned int)
+                {
+                  EXPECT_NE(nullptr, CancellationToken::current());
+                  ++count;
+                });
+  EXPECT_EQ(8, count.load());
+
+  // Tasks not yet started when cancelled are not run.
+  count = 0;
+  EXPECT_THROW(pool.parallel(100U,
+                             [&](unsigned int i)
+                             {
+                               ++count;
+                               if (i == 0U)
+                                 token.cancel();
+                             }),
+               ReadCancelledException);
+  EXPECT_GT(100, count.load());
+}
+
+class CancellationTIFFTest : public TIFFPixelsTest
+{
+public:
+  CancellationTIFFTest():
+    TIFFPixelsTest("cancellation")
+  {
+  }
+};
+
+TEST_F(CancellationTIFFTest, Read)
+{
+  for (auto thread_count : {1U, 4U})
+    {
+      std::shared_ptr<TIFF> tiff = TIFF::open(filenames.at(0), "r");
+      tiff->setDecodeThreads(thread_count);
+      std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+
+      CancellationToken token;
+      token.cancel();
+      VariantPixelBuffer plane;
+      {
+        CancellationToken::Scope scope(token);
+        EXPECT_THROW(ifd->readImage(plane), ReadCancelledException);
+      }
+
+      // Reads outside the scope are not cancelled.
+      ASSERT_NO_THROW(ifd->readImage(plane));
+      EXPECT_TRUE(expected.at(0) == plane);
+
+      ome::files::in::MinimalTIFFReader reader;
+      reader.setDecodeThreads(thread_count);
+      reader.setPrefetchPlanes(2U);
+      reader.setId(filenames.at(0));
+      CancellationToken expired(CancellationToken::clock_type::now());
+      {
+        CancellationToken::Scope scope(expired);
+        EXPECT_THROW(reader.openBytes(0U, plane), ReadCancelledException);
+      }
+      ASSERT_NO_THROW(reader.openBytes(0U, plane));
+      EXPECT_TRUE(expected.at(0) == plane);
+    }
+}
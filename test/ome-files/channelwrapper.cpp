@@ -0,0 +1,344 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/files/ChannelMerger.h>
+#include <ome/files/ChannelSeparator.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+
+#include <ome/test/test.h>
+
+using ome::files::ChannelMerger;
+using ome::files::ChannelSeparator;
+using ome::files::CoreMetadata;
+using ome::files::FormatReader;
+using ome::files::PlaneRegion;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("ChannelTestReader", "Reader for channel wrapper testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  // Pixel value of a sample of a wrapped reader plane.
+  uint16_t
+  pixel(dimension_size_type plane,
+        dimension_size_type sample,
+        dimension_size_type x,
+        dimension_size_type y)
+  {
+    return static_cast<uint16_t>((plane * 1000U) + (sample * 100U) + (y * 10U) + x);
+  }
+
+  uint16_t
+  value(const VariantPixelBuffer& buf,
+        dimension_size_type       x,
+        dimension_size_type       y,
+        dimension_size_type       sample = 0U)
+  {
+    return buf.array<uint16_t>()[x][y][0][0][0][sample][0][0][0];
+  }
+
+}
+
+// Reader generating 4×3 UINT16 planes with two Z sections, and
+// recording how the planes were read.
+class ChannelTestReader : public ome::files::detail::FormatReader
+{
+private:
+  std::vector<dimension_size_type> channels;
+  DimensionOrder order;
+  bool interleaved;
+
+public:
+  /// Number of plane reads.
+  mutable unsigned int reads;
+  /// Number of plane reads into the storage of the buffer provided.
+  mutable unsigned int inplace;
+
+  ChannelTestReader(const std::vector<dimension_size_type>& channels,
+                    DimensionOrder                          order,
+                    bool                                    interleaved):
+    ome::files::detail::FormatReader(props),
+    channels(channels),
+    order(order),
+    interleaved(interleaved),
+    reads(0U),
+    inplace(0U)
+  {
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+    c->sizeX = 4;
+    c->sizeY = 3;
+    c->sizeZ = 2;
+    c->sizeT = 1;
+    c->sizeC = channels;
+    c->pixelType = PixelType::UINT16;
+    c->imageCount = c->sizeZ * c->sizeT * c->sizeC.size();
+    c->dimensionOrder = order;
+    c->orderCertain = true;
+    c->interleaved = interleaved;
+    c->indexed = false;
+    c->resolutionCount = 1;
+
+    core.clear();
+    core.push_back(c);
+  }
+
+  void
+  openBytesImpl(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    ++reads;
+
+    const dimension_size_type samples = getRGBChannelCount(getZCTCoords(plane)[1]);
+    const void *storage = buf.pixelType() == PixelType::UINT16 ? buf.data<uint16_t>() : nullptr;
+    preparePlane(buf, w, h, samples);
+    if (buf.data<uint16_t>() == storage)
+      ++inplace;
+
+    for (dimension_size_type s = 0; s < samples; ++s)
+      for (dimension_size_type j = 0; j < h; ++j)
+        for (dimension_size_type i = 0; i < w; ++i)
+          buf.array<uint16_t>()[i][j][0][0][0][s][0][0][0] = pixel(plane, s, x + i, y + j);
+  }
+};
+
+TEST(ChannelMerger, Metadata)
+{
+  std::shared_ptr<ChannelTestReader> reader
+    (std::make_shared<ChannelTestReader>(std::vector<dimension_size_type>{1, 1, 1},
+                                         DimensionOrder::XYZTC, false));
+  ChannelMerger merger(reader);
+  ASSERT_NO_THROW(merger.setId("test"));
+
+  EXPECT_EQ(3U, merger.getSizeC());
+  EXPECT_EQ(1U, merger.getEffectiveSizeC());
+  EXPECT_EQ(3U, merger.getRGBChannelCount(0));
+  EXPECT_TRUE(merger.isRGB(0));
+  EXPECT_FALSE(merger.isInterleaved());
+  EXPECT_EQ(2U, merger.getImageCount());
+  EXPECT_EQ(1U, merger.getIndex(1, 0, 0));
+  EXPECT_EQ(3U, merger.getCoreMetadataList().front()->sizeC.front());
+  EXPECT_THROW(merger.setPlane(2), std::logic_error);
+
+  // The wrapped reader is unchanged.
+  EXPECT_EQ(3U, reader->getEffectiveSizeC());
+  EXPECT_EQ(6U, reader->getImageCount());
+
+  std::vector<uint8_t> raw;
+  EXPECT_THROW(merger.openRawTile(0, 0, raw), std::runtime_error);
+}
+
+TEST(ChannelMerger, Unchanged)
+{
+  std::shared_ptr<ChannelTestReader> reader
+    (std::make_shared<ChannelTestReader>(std::vector<dimension_size_type>{1, 3},
+                                         DimensionOrder::XYZTC, false));
+  ChannelMerger merger(reader);
+  ASSERT_NO_THROW(merger.setId("test"));
+
+  EXPECT_EQ(2U, merger.getEffectiveSizeC());
+  EXPECT_EQ(4U, merger.getImageCount());
+
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(merger.openBytes(3, buf));
+  EXPECT_EQ(pixel(3, 2, 1, 2), value(buf, 1, 2, 2));
+}
+
+TEST(ChannelMerger, OpenBytes)
+{
+  std::shared_ptr<ChannelTestReader> reader
+    (std::make_shared<ChannelTestReader>(std::vector<dimension_size_type>{1, 1, 1},
+                                         DimensionOrder::XYZTC, false));
+  ChannelMerger merger(reader);
+  ASSERT_NO_THROW(merger.setId("test"));
+
+  for (dimension_size_type p = 0; p < merger.getImageCount(); ++p)
+    {
+      reader->inplace = 0U;
+
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(merger.openBytes(p, buf));
+      ASSERT_EQ(4U * 3U * 3U, buf.num_elements());
+
+      // Each channel was read directly into the merged plane.
+      EXPECT_EQ(3U, reader->inplace);
+
+      for (dimension_size_type s = 0; s < 3U; ++s)
+        {
+          const dimension_size_type rplane = reader->getIndex(p, s, 0);
+          for (dimension_size_type y = 0; y < 3U; ++y)
+            for (dimension_size_type x = 0; x < 4U; ++x)
+              EXPECT_EQ(pixel(rplane, 0, x, y), value(buf, x, y, s));
+        }
+    }
+
+  VariantPixelBuffer region;
+  ASSERT_NO_THROW(merger.openBytes(1, region, 1, 1, 2, 2));
+  EXPECT_EQ(2U * 2U * 3U, region.num_elements());
+  EXPECT_EQ(pixel(reader->getIndex(1, 2, 0), 0, 2, 2), value(region, 1, 1, 2));
+
+  std::vector<PlaneRegion> regions{PlaneRegion(0, 0, 2, 1), PlaneRegion(2, 1, 2, 2)};
+  std::vector<VariantPixelBuffer> bufs;
+  ASSERT_NO_THROW(merger.openBytesBatch(0, regions, bufs));
+  ASSERT_EQ(2U, bufs.size());
+  EXPECT_EQ(pixel(reader->getIndex(0, 1, 0), 0, 1, 0), value(bufs[0], 1, 0, 1));
+  EXPECT_EQ(pixel(reader->getIndex(0, 2, 0), 0, 3, 2), value(bufs[1], 1, 1, 2));
+
+  VariantPixelBuffer at;
+  ASSERT_NO_THROW(merger.openBytesAt(0, 0, 1, at, PlaneRegion(0, 0, 4, 3)));
+  EXPECT_EQ(pixel(reader->getIndex(1, 1, 0), 0, 3, 1), value(at, 3, 1, 1));
+}
+
+TEST(ChannelMerger, OpenBytesCopy)
+{
+  // The wrapped reader replaces the slices since its storage order
+  // differs, so the channels are copied instead.
+  std::shared_ptr<ChannelTestReader> reader
+    (std::make_shared<ChannelTestReader>(std::vector<dimension_size_type>{1, 1},
+                                         DimensionOrder::XYZCT, false));
+  ChannelMerger merger(reader);
+  ASSERT_NO_THROW(merger.setId("test"));
+  ASSERT_EQ(2U, merger.getImageCount());
+
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(merger.openBytes(1, buf));
+  EXPECT_EQ(0U, reader->inplace);
+
+  for (dimension_size_type s = 0; s < 2U; ++s)
+    EXPECT_EQ(pixel(reader->getIndex(1, s, 0), 0, 2, 1), value(buf, 2, 1, s));
+}
+
+TEST(ChannelSeparator, Metadata)
+{
+  std::shared_ptr<ChannelTestReader> reader
+    (std::make_shared<ChannelTestReader>(std::vector<dimension_size_type>{3},
+                                         DimensionOrder::XYZCT, true));
+  ChannelSeparator separator(reader);
+  ASSERT_NO_THROW(separator.setId("test"));
+
+  EXPECT_EQ(3U, separator.getSizeC());
+  EXPECT_EQ(3U, separator.getEffectiveSizeC());
+  EXPECT_EQ(1U, separator.getRGBChannelCount(2));
+  EXPECT_FALSE(separator.isRGB(0));
+  EXPECT_FALSE(separator.isInterleaved());
+  EXPECT_EQ(6U, separator.getImageCount());
+  EXPECT_EQ(5U, separator.getIndex(1, 2, 0));
+
+  EXPECT_EQ(1U, reader->getEffectiveSizeC());
+  EXPECT_EQ(2U, reader->getImageCount());
+}
+
+TEST(ChannelSeparator, OpenBytes)
+{
+  std::shared_ptr<ChannelTestReader> reader
+    (std::make_shared<ChannelTestReader>(std::vector<dimension_size_type>{3},
+                                         DimensionOrder::XYZCT, true));
+  ChannelSeparator separator(reader);
+  ASSERT_NO_THROW(separator.setId("test"));
+
+  for (dimension_size_type z = 0; z < separator.getSizeZ(); ++z)
+    for (dimension_size_type c = 0; c < separator.getEffectiveSizeC(); ++c)
+      {
+        const dimension_size_type p = separator.getIndex(z, c, 0);
+        const dimension_size_type rplane = reader->getIndex(z, 0, 0);
+
+        VariantPixelBuffer buf;
+        ASSERT_NO_THROW(separator.openBytes(p, buf));
+        ASSERT_EQ(4U * 3U, buf.num_elements());
+        for (dimension_size_type y = 0; y < 3U; ++y)
+          for (dimension_size_type x = 0; x < 4U; ++x)
+            EXPECT_EQ(pixel(rplane, c, x, y), value(buf, x, y));
+      }
+
+  // Each plane of the wrapped reader was decoded once for all its
+  // channels.
+  EXPECT_EQ(2U, reader->reads);
+
+  // A contained region of the cached plane is not read again.
+  VariantPixelBuffer region;
+  ASSERT_NO_THROW(separator.openBytes(5, region, 1, 1, 2, 2));
+  EXPECT_EQ(2U, reader->reads);
+  EXPECT_EQ(pixel(1, 2, 2, 2), value(region, 1, 1));
+
+  std::vector<PlaneRegion> regions{PlaneRegion(0, 0, 2, 1), PlaneRegion(2, 1, 2, 2)};
+  std::vector<VariantPixelBuffer> bufs;
+  ASSERT_NO_THROW(separator.openBytesBatch(1, regions, bufs));
+  ASSERT_EQ(2U, bufs.size());
+  EXPECT_EQ(2U * 1U, bufs[0].num_elements());
+  EXPECT_EQ(pixel(1, 0, 3, 2), value(bufs[1], 1, 1));
+
+  std::vector<PlaneRegion> tiles;
+  ASSERT_NO_THROW(separator.forEachTile(2, [&](const PlaneRegion&        tile,
+                                               const VariantPixelBuffer& chunk)
+    {
+      tiles.push_back(tile);
+      EXPECT_EQ(tile.w * tile.h, chunk.num_elements());
+      EXPECT_EQ(pixel(0, 1, tile.x, tile.y), value(chunk, 0, 0));
+    }));
+  EXPECT_FALSE(tiles.empty());
+}
@@ -0,0 +1,318 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/OMETIFFReader.h>
+#include <ome/files/out/OMETIFFWriter.h>
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include <convert/Converter.h>
+#include <convert/options.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::CoreMetadata;
+using ome::files::VariantPixelBuffer;
+using ome::files::in::OMETIFFReader;
+using ome::files::out::OMETIFFWriter;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  // Number of planes in the source image.
+  const dimension_size_type plane_count = 3U;
+
+}
+
+class ConverterTest : public TIFFPixelsTest
+{
+public:
+  boost::filesystem::path source;
+  std::vector<boost::filesystem::path> outputs;
+
+  ConverterTest():
+    TIFFPixelsTest("converter"),
+    source(),
+    outputs()
+  {
+  }
+
+  // Write a tiled Deflate OME-TIFF with a predictor, using the
+  // fixture pixels for each plane.
+  void
+  SetUp()
+  {
+    TIFFPixelsTest::SetUp();
+
+    std::shared_ptr<CoreMetadata> core(std::make_shared<CoreMetadata>());
+    core->sizeX = image_size;
+    core->sizeY = image_size;
+    core->sizeZ = plane_count;
+    core->sizeT = 1U;
+    core->sizeC.clear();
+    core->sizeC.push_back(1U);
+    core->pixelType = PixelType::UINT16;
+    core->imageCount = plane_count;
+    core->dimensionOrder = DimensionOrder::XYZCT;
+    core->interleaved = true;
+
+    std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+    seriesList.push_back(core);
+
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+    ome::files::fillMetadata(*meta, seriesList);
+    meta->setImageName("converter source", 0);
+
+    ome::files::tiff::CodecParameters codec;
+    codec.predictor = ome::files::tiff::HORIZONTAL;
+
+    source = datafile("source.ome.tiff");
+    OMETIFFWriter writer;
+    writer.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+    writer.setInterleaved(true);
+    writer.setCompression("Deflate");
+    writer.setCodecParameters(codec);
+    writer.setTileSizeX(tile_size);
+    writer.setTileSizeY(tile_size);
+    writer.setId(source);
+    for (dimension_size_type p = 0; p < plane_count; ++p)
+      writer.saveBytes(p, expected.at(p));
+    writer.close();
+  }
+
+  void
+  TearDown()
+  {
+    outputs.push_back(source);
+    for (const auto& f : outputs)
+      if (boost::filesystem::exists(f))
+        boost::filesystem::remove(f);
+    TIFFPixelsTest::TearDown();
+  }
+
+  // Convert the source, and return the summary.
+  std::string
+  convert(const boost::filesystem::path& output,
+          convert::options&              opts)
+  {
+    outputs.push_back(output);
+    opts.files.clear();
+    opts.files.push_back(source.string());
+    opts.files.push_back(output.string());
+
+    std::ostringstream summary;
+    convert::Converter(opts).run(summary);
+    return summary.str();
+  }
+
+  // Check the metadata and pixels of a converted file match the
+  // source.
+  void
+  check(const boost::filesystem::path& output)
+  {
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> sourceMeta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+    OMETIFFReader sourceReader;
+    sourceReader.setMetadataStore(sourceMeta);
+    sourceReader.setId(source);
+
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> outputMeta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+    OMETIFFReader reader;
+    reader.setMetadataStore(outputMeta);
+    reader.setId(output);
+
+    ASSERT_EQ(sourceReader.getSeriesCount(), reader.getSeriesCount());
+    EXPECT_EQ(sourceReader.getSizeX(), reader.getSizeX());
+    EXPECT_EQ(sourceReader.getSizeY(), reader.getSizeY());
+    EXPECT_EQ(sourceReader.getSizeZ(), reader.getSizeZ());
+    EXPECT_EQ(sourceReader.getSizeT(), reader.getSizeT());
+    EXPECT_EQ(sourceReader.getSizeC(), reader.getSizeC());
+    EXPECT_EQ(sourceReader.getPixelType(), reader.getPixelType());
+    EXPECT_EQ(sourceReader.getDimensionOrder(), reader.getDimensionOrder());
+    EXPECT_EQ(sourceReader.isInterleaved(), reader.isInterleaved());
+    ASSERT_EQ(plane_count, reader.getImageCount());
+    EXPECT_EQ(sourceMeta->getImageName(0), outputMeta->getImageName(0));
+
+    for (dimension_size_type p = 0; p < plane_count; ++p)
+      {
+        VariantPixelBuffer buf;
+        reader.openBytes(p, buf);
+        EXPECT_TRUE(expected.at(p) == buf);
+      }
+
+    reader.close();
+    sourceReader.close();
+  }
+
+  // Get the first directory of a converted file.
+  std::shared_ptr<IFD>
+  directory(const boost::filesystem::path& output)
+  {
+    std::shared_ptr<TIFF> tiff(TIFF::open(output, "r"));
+    return tiff->getDirectoryByIndex(0);
+  }
+};
+
+TEST_F(ConverterTest, RawCopy)
+{
+  convert::options opts;
+  const boost::filesystem::path output(datafile("raw.ome.tiff"));
+  const std::string summary(convert(output, opts));
+  EXPECT_NE(std::string::npos, summary.find("copied without decoding"));
+  check(output);
+
+  std::shared_ptr<IFD> ifd(directory(output));
+  EXPECT_EQ(ome::files::tiff::getCodecScheme("Deflate"), ifd->getCompression());
+  EXPECT_EQ(ome::files::tiff::TILE, ifd->getTileType());
+  EXPECT_EQ(tile_size, ifd->getTileWidth());
+  EXPECT_EQ(tile_size, ifd->getTileHeight());
+  ASSERT_TRUE(!!ifd->getCodecParameters().predictor);
+  EXPECT_EQ(ome::files::tiff::HORIZONTAL, *ifd->getCodecParameters().predictor);
+}
+
+TEST_F(ConverterTest, Decode)
+{
+  convert::options opts;
+  opts.raw = false;
+  opts.threads = 2U;
+  const boost::filesystem::path output(datafile("decode.ome.tiff"));
+  const std::string summary(convert(output, opts));
+  EXPECT_NE(std::string::npos, summary.find("decoded and encoded"));
+  check(output);
+
+  std::shared_ptr<IFD> ifd(directory(output));
+  EXPECT_EQ(ome::files::tiff::getCodecScheme("Deflate"), ifd->getCompression());
+  EXPECT_EQ(tile_size, ifd->getTileWidth());
+  EXPECT_EQ(tile_size, ifd->getTileHeight());
+}
+
+TEST_F(ConverterTest, RawMatchesDecode)
+{
+  convert::options rawOpts;
+  const boost::filesystem::path rawOutput(datafile("match-raw.ome.tiff"));
+  convert(rawOutput, rawOpts);
+
+  convert::options decodeOpts;
+  decodeOpts.raw = false;
+  const boost::filesystem::path decodeOutput(datafile("match-decode.ome.tiff"));
+  convert(decodeOutput, decodeOpts);
+
+  OMETIFFReader rawReader;
+  rawReader.setId(rawOutput);
+  OMETIFFReader decodeReader;
+  decodeReader.setId(decodeOutput);
+
+  ASSERT_EQ(rawReader.getImageCount(), decodeReader.getImageCount());
+  for (dimension_size_type p = 0; p < rawReader.getImageCount(); ++p)
+    {
+      VariantPixelBuffer rawBuf;
+      VariantPixelBuffer decodeBuf;
+      rawReader.openBytes(p, rawBuf);
+      decodeReader.openBytes(p, decodeBuf);
+      EXPECT_TRUE(rawBuf == decodeBuf);
+    }
+}
+
+TEST_F(ConverterTest, RefuseTileSizeMismatch)
+{
+  // A different output tile size can't reuse the source tiles.
+  convert::options opts;
+  opts.tileWidth = tile_size / 2U;
+  opts.tileHeight = tile_size / 2U;
+  const boost::filesystem::path output(datafile("tilesize.ome.tiff"));
+  const std::string summary(convert(output, opts));
+  EXPECT_NE(std::string::npos, summary.find("decoded and encoded"));
+  check(output);
+
+  std::shared_ptr<IFD> ifd(directory(output));
+  EXPECT_EQ(tile_size / 2U, ifd->getTileWidth());
+  EXPECT_EQ(tile_size / 2U, ifd->getTileHeight());
+}
+
+TEST_F(ConverterTest, RefuseStripMismatch)
+{
+  // Strips can't be made from tiles either.
+  convert::options opts;
+  opts.tileHeight = tile_size;
+  const boost::filesystem::path output(datafile("strips.ome.tiff"));
+  const std::string summary(convert(output, opts));
+  EXPECT_NE(std::string::npos, summary.find("decoded and encoded"));
+  check(output);
+
+  EXPECT_EQ(ome::files::tiff::STRIP, directory(output)->getTileType());
+}
+
+TEST_F(ConverterTest, RefuseCodecMismatch)
+{
+  convert::options opts;
+  opts.compression = std::string("LZW");
+  const boost::filesystem::path output(datafile("lzw.ome.tiff"));
+  const std::string summary(convert(output, opts));
+  EXPECT_NE(std::string::npos, summary.find("decoded and encoded"));
+  check(output);
+
+  EXPECT_EQ(ome::files::tiff::getCodecScheme("LZW"), directory(output)->getCompression());
+}
+
+TEST_F(ConverterTest, RefusePyramid)
+{
+  // Sub-resolutions are generated from decoded pixel data.
+  convert::options opts;
+  opts.pyramid = 2U;
+  const boost::filesystem::path output(datafile("pyramid.ome.tiff"));
+  const std::string summary(convert(output, opts));
+  EXPECT_NE(std::string::npos, summary.find("decoded and encoded"));
+  EXPECT_NE(std::string::npos, summary.find("Generated 2 sub-resolutions"));
+  check(output);
+}
@@ -0,0 +1,258 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <vector>
+
+#include <ome/files/Types.h>
+#include <ome/files/TileBuffer.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/DecodedTileCache.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::TileBuffer;
+using ome::files::VariantPixelBuffer;
+using ome::files::tiff::DecodedTileCache;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+
+namespace
+{
+
+  // Fake TIFF identities; the cache never dereferences them.
+  const TIFF *tiff1 = reinterpret_cast<const TIFF *>(0x1000);
+  const TIFF *tiff2 = reinterpret_cast<const TIFF *>(0x2000);
+
+  DecodedTileCache::key_type
+  key(const TIFF *tiff, dimension_size_type tile)
+  {
+    DecodedTileCache::key_type k{tiff, 8U, tile};
+    return k;
+  }
+
+  std::shared_ptr<TileBuffer>
+  tile(dimension_size_type size = 1024U)
+  {
+    return std::shared_ptr<TileBuffer>(new TileBuffer(size));
+  }
+
+}
+
+TEST(DecodedTileCache, Construct)
+{
+  DecodedTileCache c;
+  ASSERT_EQ(0U, c.getBudget());
+
+  DecodedTileCache c2(8192U);
+  ASSERT_EQ(8192U, c2.getBudget());
+}
+
+TEST(DecodedTileCache, Insert)
+{
+  DecodedTileCache c(16U * 1024U);
+
+  for (dimension_size_type i = 0; i < 16; ++i)
+    c.insert(key(tiff1, i), tile());
+
+  ASSERT_EQ(16U, c.count());
+  ASSERT_EQ(16U * 1024U, c.size());
+
+  for (dimension_size_type i = 0; i < 16; ++i)
+    ASSERT_TRUE(static_cast<bool>(c.find(key(tiff1, i))));
+  ASSERT_FALSE(static_cast<bool>(c.find(key(tiff2, 0))));
+
+  ASSERT_EQ(16U, c.hits());
+  ASSERT_EQ(1U, c.misses());
+
+  c.resetStatistics();
+  ASSERT_EQ(0U, c.hits());
+  ASSERT_EQ(0U, c.misses());
+}
+
+TEST(DecodedTileCache, Replace)
+{
+  DecodedTileCache c(16U * 1024U);
+
+  c.insert(key(tiff1, 0), tile());
+  c.insert(key(tiff1, 0), tile(2048U));
+
+  ASSERT_EQ(1U, c.count());
+  ASSERT_EQ(2048U, c.size());
+  ASSERT_EQ(2048U, c.find(key(tiff1, 0))->size());
+}
+
+TEST(DecodedTileCache, DisabledBudget)
+{
+  DecodedTileCache c;
+
+  c.insert(key(tiff1, 0), tile());
+  ASSERT_EQ(0U, c.count());
+  ASSERT_FALSE(static_cast<bool>(c.find(key(tiff1, 0))));
+}
+
+TEST(DecodedTileCache, OversizeTile)
+{
+  DecodedTileCache c(1024U);
+
+  c.insert(key(tiff1, 0), tile(1025U));
+  ASSERT_EQ(0U, c.count());
+  c.insert(key(tiff1, 0), tile(1024U));
+  ASSERT_EQ(1U, c.count());
+}
+
+TEST(DecodedTileCache, EvictLeastRecentlyUsed)
+{
+  DecodedTileCache c(4U * 1024U);
+
+  for (dimension_size_type i = 0; i < 4; ++i)
+    c.insert(key(tiff1, i), tile());
+
+  // Use tile 0, making tile 1 the least recently used.
+  ASSERT_TRUE(static_cast<bool>(c.find(key(tiff1, 0))));
+
+  c.insert(key(tiff1, 4), tile());
+  ASSERT_EQ(4U, c.count());
+  ASSERT_TRUE(static_cast<bool>(c.find(key(tiff1, 0))));
+  ASSERT_FALSE(static_cast<bool>(c.find(key(tiff1, 1))));
+  ASSERT_TRUE(static_cast<bool>(c.find(key(tiff1, 2))));
+  ASSERT_TRUE(static_cast<bool>(c.find(key(tiff1, 3))));
+  ASSERT_TRUE(static_cast<bool>(c.find(key(tiff1, 4))));
+
+  // Shrinking the budget evicts the oldest tiles.
+  c.setBudget(2U * 1024U);
+  ASSERT_EQ(2U, c.count());
+  ASSERT_TRUE(static_cast<bool>(c.find(key(tiff1, 3))));
+  ASSERT_TRUE(static_cast<bool>(c.find(key(tiff1, 4))));
+}
+
+TEST(DecodedTileCache, EraseTIFF)
+{
+  DecodedTileCache c(16U * 1024U);
+
+  for (dimension_size_type i = 0; i < 4; ++i)
+    {
+      c.insert(key(tiff1, i), tile());
+      c.insert(key(tiff2, i), tile());
+    }
+  ASSERT_EQ(8U, c.count());
+
+  c.erase(tiff1);
+  ASSERT_EQ(4U, c.count());
+  ASSERT_EQ(4U * 1024U, c.size());
+  for (dimension_size_type i = 0; i < 4; ++i)
+    {
+      ASSERT_FALSE(static_cast<bool>(c.find(key(tiff1, i))));
+      ASSERT_TRUE(static_cast<bool>(c.find(key(tiff2, i))));
+    }
+}
+
+TEST(DecodedTileCache, Clear)
+{
+  DecodedTileCache c(16U * 1024U);
+
+  for (dimension_size_type i = 0; i < 16; ++i)
+    c.insert(key(tiff1, i), tile());
+  ASSERT_EQ(16U, c.count());
+
+  c.clear();
+  ASSERT_EQ(0U, c.count());
+  ASSERT_EQ(0U, c.size());
+}
+
+class DecodedTileCacheTIFFTest : public TIFFPixelsTest
+{
+public:
+  DecodedTileCacheTIFFTest():
+    TIFFPixelsTest("decodedtilecache")
+  {
+  }
+};
+
+TEST_F(DecodedTileCacheTIFFTest, Read)
+{
+  const std::vector<unsigned int> thread_counts{1U, 4U};
+  // 64×64 uint16 tiles; allow 16 tiles.
+  const dimension_size_type tile_bytes = tile_size * tile_size * sizeof(uint16_pixel_type);
+
+  for (auto thread_count : thread_counts)
+    {
+      std::shared_ptr<ome::files::tiff::DecodedTileCache> cache
+        (std::make_shared<ome::files::tiff::DecodedTileCache>(16U * tile_bytes));
+
+      std::shared_ptr<TIFF> tiff = TIFF::open(filenames.at(0), "r");
+      tiff->setDecodeThreads(thread_count);
+      tiff->setTileCache(cache);
+      std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+
+      VariantPixelBuffer uncached;
+      {
+        std::shared_ptr<TIFF> reference = TIFF::open(filenames.at(0), "r");
+        reference->getDirectoryByIndex(0)->readImage(uncached, 60U, 60U, 100U, 100U);
+      }
+
+      // 3×3 tiles, all misses.
+      VariantPixelBuffer region;
+      ASSERT_NO_THROW(ifd->readImage(region, 60U, 60U, 100U, 100U));
+      EXPECT_TRUE(uncached == region);
+      EXPECT_EQ(0U, cache->hits());
+      EXPECT_EQ(9U, cache->misses());
+      EXPECT_EQ(9U, cache->count());
+
+      // Same tiles, all hits.
+      VariantPixelBuffer region2;
+      ASSERT_NO_THROW(ifd->readImage(region2, 60U, 60U, 100U, 100U));
+      EXPECT_TRUE(uncached == region2);
+      EXPECT_EQ(9U, cache->hits());
+      EXPECT_EQ(9U, cache->misses());
+
+      // Whole plane exceeds the budget; correct but evicting.
+      VariantPixelBuffer plane;
+      ASSERT_NO_THROW(ifd->readImage(plane));
+      EXPECT_TRUE(expected.at(0) == plane);
+      EXPECT_EQ(16U, cache->count());
+      EXPECT_LE(cache->size(), cache->getBudget());
+
+      tiff->close();
+      EXPECT_EQ(0U, cache->count());
+    }
+}
@@ -0,0 +1,285 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <ome/files/DimensionSwapper.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+
+#include <ome/test/test.h>
+
+using ome::files::CoreMetadata;
+using ome::files::DimensionSwapper;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("SwapTestReader", "Reader for dimension swapper testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  // Pixel value of a sample of a wrapped reader plane.
+  uint16_t
+  pixel(dimension_size_type plane,
+        dimension_size_type sample)
+  {
+    return static_cast<uint16_t>((plane * 10U) + sample);
+  }
+
+  uint16_t
+  value(const VariantPixelBuffer& buf,
+        dimension_size_type       sample = 0U)
+  {
+    return buf.array<uint16_t>()[1][1][0][0][0][sample][0][0][0];
+  }
+
+}
+
+// Reader generating 2×2 UINT16 planes, and recording how the planes
+// were read.
+class SwapTestReader : public ome::files::detail::FormatReader
+{
+private:
+  dimension_size_type sizeZ;
+  std::vector<dimension_size_type> channels;
+  dimension_size_type sizeT;
+  DimensionOrder order;
+
+public:
+  /// Number of plane reads.
+  mutable unsigned int reads;
+  /// Number of plane reads into the storage of the buffer provided.
+  mutable unsigned int inplace;
+  /// The last plane read.
+  mutable dimension_size_type last;
+
+  SwapTestReader(dimension_size_type                     sizeZ,
+                 const std::vector<dimension_size_type>& channels,
+                 dimension_size_type                     sizeT,
+                 DimensionOrder                          order):
+    ome::files::detail::FormatReader(props),
+    sizeZ(sizeZ),
+    channels(channels),
+    sizeT(sizeT),
+    order(order),
+    reads(0U),
+    inplace(0U),
+    last(0U)
+  {
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+    c->sizeX = 2;
+    c->sizeY = 2;
+    c->sizeZ = sizeZ;
+    c->sizeT = sizeT;
+    c->sizeC = channels;
+    c->pixelType = PixelType::UINT16;
+    c->imageCount = c->sizeZ * c->sizeT * c->sizeC.size();
+    c->dimensionOrder = order;
+    c->orderCertain = true;
+    c->interleaved = false;
+    c->indexed = false;
+    c->resolutionCount = 1;
+
+    core.clear();
+    core.push_back(c);
+  }
+
+  void
+  openBytesImpl(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type /* x */,
+                dimension_size_type /* y */,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    ++reads;
+    last = plane;
+
+    const dimension_size_type samples = getRGBChannelCount(getZCTCoords(plane)[1]);
+    const void *storage = buf.pixelType() == PixelType::UINT16 ? buf.data<uint16_t>() : nullptr;
+    preparePlane(buf, w, h, samples);
+    if (buf.data<uint16_t>() == storage)
+      ++inplace;
+
+    for (dimension_size_type s = 0; s < samples; ++s)
+      for (dimension_size_type j = 0; j < h; ++j)
+        for (dimension_size_type i = 0; i < w; ++i)
+          buf.array<uint16_t>()[i][j][0][0][0][s][0][0][0] = pixel(plane, s);
+  }
+};
+
+TEST(DimensionSwapper, Unchanged)
+{
+  std::shared_ptr<SwapTestReader> reader
+    (std::make_shared<SwapTestReader>(3U, std::vector<dimension_size_type>{1, 1}, 2U,
+                                      DimensionOrder::XYZCT));
+  DimensionSwapper swapper(reader);
+  EXPECT_THROW(swapper.setOutputOrder(DimensionOrder::XYCZT), std::logic_error);
+  ASSERT_NO_THROW(swapper.setId("test"));
+
+  EXPECT_EQ(DimensionOrder(DimensionOrder::XYZCT), swapper.getInputOrder());
+  EXPECT_EQ(DimensionOrder(DimensionOrder::XYZCT), swapper.getOutputOrder());
+  EXPECT_EQ(std::string("XYZCT"), swapper.getDimensionOrder());
+  EXPECT_EQ(reader->getIndex(2, 1, 1), swapper.getIndex(2, 1, 1));
+
+  VariantPixelBuffer buf;
+  swapper.openBytes(4, buf);
+  EXPECT_EQ(4U, reader->last);
+  EXPECT_EQ(pixel(4, 0), value(buf));
+}
+
+TEST(DimensionSwapper, OutputOrder)
+{
+  std::shared_ptr<SwapTestReader> reader
+    (std::make_shared<SwapTestReader>(3U, std::vector<dimension_size_type>{1, 1}, 2U,
+                                      DimensionOrder::XYZCT));
+  DimensionSwapper swapper(reader);
+  ASSERT_NO_THROW(swapper.setId("test"));
+  ASSERT_NO_THROW(swapper.setOutputOrder(DimensionOrder::XYCZT));
+
+  EXPECT_EQ(std::string("XYCZT"), swapper.getDimensionOrder());
+  EXPECT_EQ(DimensionOrder(DimensionOrder::XYZCT), swapper.getInputOrder());
+  EXPECT_EQ(3U, swapper.getSizeZ());
+  EXPECT_EQ(2U, swapper.getEffectiveSizeC());
+  EXPECT_EQ(2U, swapper.getSizeT());
+  EXPECT_EQ(12U, swapper.getImageCount());
+
+  // The wrapped reader is unchanged.
+  EXPECT_EQ(std::string("XYZCT"), reader->getDimensionOrder());
+
+  VariantPixelBuffer buf;
+  swapper.openBytes(0, buf);
+  const void *storage = buf.data<uint16_t>();
+
+  for (dimension_size_type t = 0; t < 2U; ++t)
+    for (dimension_size_type z = 0; z < 3U; ++z)
+      for (dimension_size_type c = 0; c < 2U; ++c)
+        {
+          const dimension_size_type plane = swapper.getIndex(z, c, t);
+          EXPECT_EQ(c + (z * 2U) + (t * 6U), plane);
+          EXPECT_EQ((std::array<dimension_size_type, 3>{{z, c, t}}), swapper.getZCTCoords(plane));
+
+          swapper.openBytes(plane, buf);
+          EXPECT_EQ(plane, swapper.getPlane());
+          EXPECT_EQ(reader->getIndex(z, c, t), reader->last);
+          EXPECT_EQ(pixel(reader->getIndex(z, c, t), 0), value(buf));
+        }
+
+  // Every plane was read directly into the buffer provided.
+  EXPECT_EQ(13U, reader->reads);
+  EXPECT_EQ(12U, reader->inplace);
+  EXPECT_EQ(storage, buf.data<uint16_t>());
+
+  EXPECT_THROW(swapper.setPlane(12), std::logic_error);
+}
+
+TEST(DimensionSwapper, InputOrder)
+{
+  std::shared_ptr<SwapTestReader> reader
+    (std::make_shared<SwapTestReader>(3U, std::vector<dimension_size_type>{3, 3}, 1U,
+                                      DimensionOrder::XYZCT));
+  DimensionSwapper swapper(reader);
+  ASSERT_NO_THROW(swapper.setId("test"));
+  ASSERT_NO_THROW(swapper.swapDimensions(DimensionOrder::XYCZT));
+
+  // The Z and C sizes are relabelled.
+  EXPECT_EQ(std::string("XYCZT"), swapper.getDimensionOrder());
+  EXPECT_EQ(2U, swapper.getSizeZ());
+  EXPECT_EQ(3U, swapper.getEffectiveSizeC());
+  EXPECT_EQ(9U, swapper.getSizeC());
+  EXPECT_EQ(3U, swapper.getRGBChannelCount(2));
+  EXPECT_TRUE(swapper.isRGB(2));
+  EXPECT_EQ(1U, swapper.getSizeT());
+  EXPECT_EQ(std::string("C"), swapper.getModuloC().parentDimension);
+
+  // Plane order is unchanged.
+  VariantPixelBuffer buf;
+  for (dimension_size_type plane = 0; plane < swapper.getImageCount(); ++plane)
+    {
+      swapper.openBytes(plane, buf);
+      EXPECT_EQ(plane, reader->last);
+      EXPECT_EQ(pixel(plane, 2), value(buf, 2));
+    }
+
+  ASSERT_NO_THROW(swapper.setOutputOrder(DimensionOrder::XYZCT));
+  EXPECT_EQ(DimensionOrder(DimensionOrder::XYCZT), swapper.getInputOrder());
+  EXPECT_EQ(1U, swapper.getIndex(1, 0, 0));
+  swapper.openBytes(1, buf);
+  EXPECT_EQ(3U, reader->last);
+}
+
+TEST(DimensionSwapper, InputOrderSamples)
+{
+  std::shared_ptr<SwapTestReader> reader
+    (std::make_shared<SwapTestReader>(3U, std::vector<dimension_size_type>{1, 3}, 1U,
+                                      DimensionOrder::XYZCT));
+  DimensionSwapper swapper(reader);
+  ASSERT_NO_THROW(swapper.setId("test"));
+
+  // The channel count can not change with differing sample counts.
+  EXPECT_THROW(swapper.swapDimensions(DimensionOrder::XYCZT), std::logic_error);
+  // Swapping T with Z leaves the channels unchanged.
+  ASSERT_NO_THROW(swapper.swapDimensions(DimensionOrder::XYTCZ));
+  EXPECT_EQ(1U, swapper.getSizeZ());
+  EXPECT_EQ(3U, swapper.getSizeT());
+  EXPECT_EQ(3U, swapper.getRGBChannelCount(1));
+}
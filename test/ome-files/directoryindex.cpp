@@ -0,0 +1,245 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/DirectoryIndex.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::VariantPixelBuffer;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+using ome::files::tiff::directoryIndexPath;
+using ome::files::tiff::offset_type;
+using ome::files::tiff::readDirectoryIndex;
+using ome::files::tiff::writeDirectoryIndex;
+
+class DirectoryIndexTest : public ::testing::Test
+{
+public:
+  boost::filesystem::path filename;
+  std::vector<offset_type> offsets;
+
+  virtual void SetUp()
+  {
+    boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+    if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+      throw std::runtime_error("Image directory unavailable and could not be created");
+
+    // The index only inspects the file size and modification time.
+    filename = dir / "directoryindex.tiff";
+    std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    out << std::string(4096U, 'x');
+
+    offsets = std::vector<offset_type>{8U, 1024U, 2048U, 4000U};
+  }
+
+  virtual void TearDown()
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove(filename, ec);
+    boost::filesystem::remove(directoryIndexPath(filename), ec);
+  }
+};
+
+TEST_F(DirectoryIndexTest, Path)
+{
+  ASSERT_EQ(filename.string() + ".ifdx", directoryIndexPath(filename).string());
+}
+
+TEST_F(DirectoryIndexTest, Missing)
+{
+  std::vector<offset_type> read;
+  ASSERT_FALSE(readDirectoryIndex(filename, read));
+  ASSERT_TRUE(read.empty());
+}
+
+TEST_F(DirectoryIndexTest, RoundTrip)
+{
+  ASSERT_NO_THROW(writeDirectoryIndex(filename, offsets));
+  ASSERT_TRUE(boost::filesystem::exists(directoryIndexPath(filename)));
+
+  std::vector<offset_type> read;
+  ASSERT_TRUE(readDirectoryIndex(filename, read));
+  ASSERT_EQ(offsets, read);
+}
+
+TEST_F(DirectoryIndexTest, StaleSize)
+{
+  ASSERT_NO_THROW(writeDirectoryIndex(filename, offsets));
+
+  {
+    std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::app);
+    out << 'y';
+  }
+
+  std::vector<offset_type> read;
+  ASSERT_FALSE(readDirectoryIndex(filename, read));
+}
+
+TEST_F(DirectoryIndexTest, StaleTime)
+{
+  ASSERT_NO_THROW(writeDirectoryIndex(filename, offsets));
+
+  boost::filesystem::last_write_time(filename, boost::filesystem::last_write_time(filename) + 10);
+
+  std::vector<offset_type> read;
+  ASSERT_FALSE(readDirectoryIndex(filename, read));
+}
+
+TEST_F(DirectoryIndexTest, Truncated)
+{
+  ASSERT_NO_THROW(writeDirectoryIndex(filename, offsets));
+  boost::filesystem::resize_file(directoryIndexPath(filename),
+                                 boost::filesystem::file_size(directoryIndexPath(filename)) - 1U);
+
+  std::vector<offset_type> read;
+  ASSERT_FALSE(readDirectoryIndex(filename, read));
+}
+
+TEST_F(DirectoryIndexTest, InvalidOffset)
+{
+  offsets.push_back(8192U);
+  ASSERT_NO_THROW(writeDirectoryIndex(filename, offsets));
+
+  std::vector<offset_type> read;
+  ASSERT_FALSE(readDirectoryIndex(filename, read));
+}
+
+class DirectoryIndexTIFFTest : public TIFFPixelsTest
+{
+public:
+  DirectoryIndexTIFFTest():
+    TIFFPixelsTest("directoryindex")
+  {
+  }
+};
+
+TEST_F(DirectoryIndexTIFFTest, Navigation)
+{
+  boost::filesystem::path multiname(datafile("index.tiff"));
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(multiname, "w");
+    for (dimension_size_type p = 0; p < file_count; ++p)
+      {
+        std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+        setup_ifd(ifd);
+        ifd->writeImage(expected.at(p));
+        tiff->writeCurrentDirectory();
+      }
+    EXPECT_FALSE(tiff->getDirectoryIndex(0U));
+    tiff->close();
+  }
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(multiname, "r");
+  ASSERT_EQ(file_count, tiff->directoryCount());
+  EXPECT_FALSE(tiff->getDirectoryIndex(1U));
+  ASSERT_THROW(tiff->getDirectoryByIndex(file_count), ome::files::tiff::Exception);
+
+  // Iteration follows the index.
+  dimension_size_type count = 0;
+  for (auto i = tiff->begin(); i != tiff->end(); ++i, ++count)
+    {
+      boost::optional<ome::files::tiff::directory_index_type> index(tiff->getDirectoryIndex((*i)->getOffset()));
+      ASSERT_TRUE(!!index);
+      EXPECT_EQ(count, *index);
+      EXPECT_EQ(count + 1 == file_count, (*i)->last());
+    }
+  EXPECT_EQ(file_count, count);
+
+  // Random access in reverse order.
+  for (dimension_size_type p = file_count; p > 0; --p)
+    {
+      VariantPixelBuffer plane;
+      ASSERT_NO_THROW(tiff->getDirectoryByIndex(p - 1)->readImage(plane));
+      EXPECT_TRUE(expected.at(p - 1) == plane);
+    }
+
+  tiff->close();
+  boost::filesystem::remove(multiname);
+}
+
+TEST_F(DirectoryIndexTIFFTest, Sidecar)
+{
+  boost::filesystem::path multiname(datafile("sidecar.tiff"));
+  boost::filesystem::path sidecar(ome::files::tiff::directoryIndexPath(multiname));
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(multiname, "w");
+    for (dimension_size_type p = 0; p < file_count; ++p)
+      {
+        std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+        setup_ifd(ifd);
+        ifd->writeImage(expected.at(p));
+        tiff->writeCurrentDirectory();
+      }
+    tiff->close();
+  }
+
+  // First open writes the sidecar; the second reads it.
+  for (dimension_size_type r = 0; r < 2U; ++r)
+    {
+      std::shared_ptr<TIFF> tiff = TIFF::open(multiname, "r");
+      tiff->setIndexSidecar(true);
+      ASSERT_EQ(file_count, tiff->directoryCount());
+      EXPECT_TRUE(boost::filesystem::exists(sidecar));
+
+      VariantPixelBuffer plane;
+      ASSERT_NO_THROW(tiff->getDirectoryByIndex(file_count - 1)->readImage(plane));
+      EXPECT_TRUE(expected.at(file_count - 1) == plane);
+      tiff->close();
+    }
+
+  boost::filesystem::remove(multiname);
+  boost::filesystem::remove(sidecar);
+}
@@ -0,0 +1,428 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/ByteSource.h>
+#include <ome/files/tiff/DirectoryParser.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::tiff::BufferByteSource;
+using ome::files::tiff::DirectoryParser;
+using ome::files::tiff::offset_type;
+typedef ome::xml::model::enums::PixelType PT;
+
+namespace
+{
+
+  // Minimal TIFF image builder; each IFD has its entries (which
+  // must be added in tag order) followed by any out of line values.
+  class TIFFBuilder
+  {
+  public:
+    std::vector<uint8_t> data;
+    bool bigendian;
+    bool bigtiff;
+
+    struct Value
+    {
+      uint16_t tag;
+      uint16_t type;
+      uint64_t count;
+      std::vector<uint8_t> bytes;
+    };
+
+    TIFFBuilder(bool bigendian,
+                bool bigtiff):
+      data(),
+      bigendian(bigendian),
+      bigtiff(bigtiff)
+    {
+      put(bigendian ? 0x4D4DU : 0x4949U, 2U);
+      put(bigtiff ? 43U : 42U, 2U);
+      if (bigtiff)
+        {
+          put(8U, 2U);
+          put(0U, 2U);
+        }
+      put(0U, offsetSize()); // First IFD offset.
+    }
+
+    unsigned int
+    offsetSize() const
+    {
+      return bigtiff ? 8U : 4U;
+    }
+
+    void
+    put(uint64_t     value,
+        unsigned int size)
+    {
+      for (unsigned int i = 0; i < size; ++i)
+        {
+          const unsigned int shift = 8U * (bigendian ? (size - 1U - i) : i);
+          data.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    void
+    set(std::size_t  offset,
+        uint64_t     value,
+        unsigned int size)
+    {
+      for (unsigned int i = 0; i < size; ++i)
+        {
+          const unsigned int shift = 8U * (bigendian ? (size - 1U - i) : i);
+          data[offset + i] = static_cast<uint8_t>(value >> shift);
+        }
+    }
+
+    Value
+    shorts(uint16_t                     tag,
+           const std::vector<uint64_t>& values)
+    {
+      Value v{tag, 3U, values.size(), std::vector<uint8_t>()};
+      encode(v, values, 2U);
+      return v;
+    }
+
+    Value
+    longs(uint16_t                     tag,
+          const std::vector<uint64_t>& values)
+    {
+      Value v{tag, 4U, values.size(), std::vector<uint8_t>()};
+      encode(v, values, 4U);
+      return v;
+    }
+
+    Value
+    ascii(uint16_t           tag,
+          const std::string& text)
+    {
+      Value v{tag, 2U, text.size() + 1U, std::vector<uint8_t>(text.begin(), text.end())};
+      v.bytes.push_back(0U);
+      return v;
+    }
+
+    // Append an IFD, linking it from the previous IFD (or header).
+    // Returns the offset of the next IFD offset field.
+    std::size_t
+    addIFD(std::size_t               link,
+           const std::vector<Value>& values)
+    {
+      if (data.size() % 2U)
+        data.push_back(0U);
+      set(link, data.size(), offsetSize());
+
+      const unsigned int entrysize = bigtiff ? 20U : 12U;
+      const std::size_t start = data.size();
+      put(values.size(), bigtiff ? 8U : 2U);
+      std::size_t extra = start + (bigtiff ? 8U : 2U) + values.size() * entrysize + offsetSize();
+      std::vector<uint8_t> tail;
+      for (const auto& v : values)
+        {
+          put(v.tag, 2U);
+          put(v.type, 2U);
+          put(v.count, offsetSize());
+          if (v.bytes.size() <= offsetSize())
+            {
+              std::vector<uint8_t> field(v.bytes);
+              field.resize(offsetSize());
+              data.insert(data.end(), field.begin(), field.end());
+            }
+          else
+            {
+              put(extra + tail.size(), offsetSize());
+              tail.insert(tail.end(), v.bytes.begin(), v.bytes.end());
+            }
+        }
+      const std::size_t next = data.size();
+      put(0U, offsetSize());
+      data.insert(data.end(), tail.begin(), tail.end());
+      return next;
+    }
+
+  private:
+    void
+    encode(Value&                       v,
+           const std::vector<uint64_t>& values,
+           unsigned int                 size)
+    {
+      for (const auto value : values)
+        for (unsigned int i = 0; i < size; ++i)
+          {
+            const unsigned int shift = 8U * (bigendian ? (size - 1U - i) : i);
+            v.bytes.push_back(static_cast<uint8_t>(value >> shift));
+          }
+    }
+  };
+
+  // Two IFDs: a 3-sample 16-bit stripped image with a long
+  // description, and a tiled 32-bit float image with a short
+  // description.
+  TIFFBuilder
+  build(bool bigendian,
+        bool bigtiff)
+  {
+    TIFFBuilder b(bigendian, bigtiff);
+    std::size_t link = bigtiff ? 8U : 4U;
+    link = b.addIFD(link,
+                    {b.longs(256U, {640U}),
+                     b.longs(257U, {480U}),
+                     b.shorts(258U, {16U, 16U, 16U}),
+                     b.shorts(259U, {8U}),
+                     b.ascii(270U, "A description stored out of line"),
+                     b.shorts(277U, {3U}),
+                     b.longs(278U, {32U}),
+                     b.shorts(284U, {2U})});
+    b.addIFD(link,
+             {b.longs(254U, {1U}),
+              b.shorts(256U, {320U}),
+              b.shorts(257U, {240U}),
+              b.shorts(258U, {32U}),
+              b.ascii(270U, "ab"),
+              b.shorts(322U, {256U}),
+              b.shorts(323U, {128U}),
+              b.shorts(339U, {3U})});
+    return b;
+  }
+
+}
+
+class DirectoryParserTest : public ::testing::TestWithParam<std::pair<bool, bool>>
+{
+};
+
+TEST_P(DirectoryParserTest, Parse)
+{
+  const TIFFBuilder b(build(GetParam().first, GetParam().second));
+  DirectoryParser parser(std::make_shared<BufferByteSource>(b.data.data(), b.data.size()));
+
+  ASSERT_EQ(GetParam().first, parser.isBigEndian());
+  ASSERT_EQ(GetParam().second, parser.isBigTIFF());
+  ASSERT_EQ(2U, parser.directoryCount());
+  ASSERT_THROW(parser.directory(2), ome::files::tiff::Exception);
+
+  DirectoryParser::Summary s0(parser.summary(0));
+  EXPECT_EQ(640U, s0.width);
+  EXPECT_EQ(480U, s0.height);
+  EXPECT_EQ(3U, s0.samplesPerPixel);
+  EXPECT_EQ(16U, s0.bitsPerSample);
+  EXPECT_EQ(ome::files::tiff::UNSIGNED_INT, s0.sampleFormat);
+  EXPECT_EQ(ome::files::tiff::SEPARATE, s0.planarConfiguration);
+  EXPECT_EQ(ome::files::tiff::COMPRESSION_ADOBE_DEFLATE, s0.compression);
+  EXPECT_EQ(ome::files::tiff::STRIP, s0.tileType);
+  EXPECT_EQ(640U, s0.tileWidth);
+  EXPECT_EQ(32U, s0.tileHeight);
+  EXPECT_EQ(0U, s0.subfileType);
+  ASSERT_TRUE(static_cast<bool>(s0.pixelType));
+  EXPECT_EQ(PT::UINT16, *s0.pixelType);
+  ASSERT_TRUE(static_cast<bool>(s0.description));
+  EXPECT_EQ(std::string("A description stored out of line"), *s0.description);
+
+  DirectoryParser::Summary s1(parser.summary(1));
+  EXPECT_EQ(320U, s1.width);
+  EXPECT_EQ(240U, s1.height);
+  EXPECT_EQ(1U, s1.samplesPerPixel);
+  EXPECT_EQ(ome::files::tiff::CONTIG, s1.planarConfiguration);
+  EXPECT_EQ(ome::files::tiff::COMPRESSION_NONE, s1.compression);
+  EXPECT_EQ(ome::files::tiff::TILE, s1.tileType);
+  EXPECT_EQ(256U, s1.tileWidth);
+  EXPECT_EQ(128U, s1.tileHeight);
+  EXPECT_EQ(1U, s1.subfileType);
+  ASSERT_TRUE(static_cast<bool>(s1.pixelType));
+  EXPECT_EQ(PT::FLOAT, *s1.pixelType);
+  ASSERT_TRUE(static_cast<bool>(s1.description));
+  EXPECT_EQ(std::string("ab"), *s1.description);
+
+  DirectoryParser::Directory d0(parser.directory(0));
+  EXPECT_EQ(parser.directoryOffset(0), d0.offset);
+  EXPECT_EQ(parser.directoryOffset(1), d0.next);
+  const DirectoryParser::Entry *bps(d0.find(258U));
+  ASSERT_TRUE(bps != nullptr);
+  EXPECT_EQ(std::vector<uint64_t>({16U, 16U, 16U}), parser.getUnsigned(*bps));
+  EXPECT_THROW(parser.getString(*bps), ome::files::tiff::Exception);
+  EXPECT_TRUE(d0.find(339U) == nullptr);
+}
+
+TEST_P(DirectoryParserTest, Concurrent)
+{
+  const TIFFBuilder b(build(GetParam().first, GetParam().second));
+  DirectoryParser parser(std::make_shared<BufferByteSource>(b.data.data(), b.data.size()));
+
+  std::vector<std::thread> threads;
+  std::vector<int> ok(8U, 0);
+  for (std::vector<int>::size_type t = 0; t < ok.size(); ++t)
+    threads.emplace_back([&parser, &ok, t]()
+                         {
+                           bool valid = true;
+                           for (int i = 0; i < 100; ++i)
+                             valid = valid &&
+                               parser.directoryCount() == 2U &&
+                               parser.summary(t % 2U).width == (t % 2U ? 320U : 640U);
+                           ok[t] = valid;
+                         });
+  for (auto& thread : threads)
+    thread.join();
+  for (const auto valid : ok)
+    EXPECT_TRUE(valid);
+}
+
+INSTANTIATE_TEST_CASE_P(DirectoryParserVariants, DirectoryParserTest,
+                        ::testing::Values(std::make_pair(false, false),
+                                          std::make_pair(true, false),
+                                          std::make_pair(false, true),
+                                          std::make_pair(true, true)));
+
+TEST(DirectoryParser, Invalid)
+{
+  const std::string text("This is not a TIFF file");
+  ASSERT_THROW(DirectoryParser(std::make_shared<BufferByteSource>(text.data(), text.size())),
+               ome::files::tiff::Exception);
+  ASSERT_THROW(DirectoryParser(std::shared_ptr<ome::files::tiff::ByteSource>()),
+               ome::files::tiff::Exception);
+  ASSERT_THROW(DirectoryParser(boost::filesystem::path(PROJECT_BINARY_DIR "/test/ome-files/data/nonexistent.tiff")),
+               ome::files::tiff::Exception);
+
+  // Truncated directory.
+  {
+    TIFFBuilder b(build(false, false));
+    b.data.resize(b.data.size() - 40U);
+    DirectoryParser parser(std::make_shared<BufferByteSource>(b.data.data(), b.data.size()));
+    ASSERT_THROW(parser.directoryCount(), ome::files::tiff::Exception);
+  }
+
+  // Loop.
+  {
+    TIFFBuilder b(false, false);
+    const std::size_t next = b.addIFD(4U, {b.longs(256U, {1U}), b.longs(257U, {1U})});
+    b.set(next, 8U, 4U);
+    DirectoryParser parser(std::make_shared<BufferByteSource>(b.data.data(), b.data.size()));
+    ASSERT_THROW(parser.directoryCount(), ome::files::tiff::Exception);
+    ASSERT_NO_THROW(parser.directory(0));
+  }
+
+  // No dimensions.
+  {
+    TIFFBuilder b(false, false);
+    b.addIFD(4U, {b.shorts(258U, {8U})});
+    DirectoryParser parser(std::make_shared<BufferByteSource>(b.data.data(), b.data.size()));
+    ASSERT_EQ(1U, parser.directoryCount());
+    ASSERT_THROW(parser.summary(0), ome::files::tiff::Exception);
+  }
+}
+
+TEST(DirectoryParser, MatchesLibTIFF)
+{
+  using namespace ome::files::tiff;
+
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+
+  for (const bool big : {false, true})
+    {
+      boost::filesystem::path filename(dir / (big ? "directoryparser.tf8" : "directoryparser.tiff"));
+
+      {
+        std::shared_ptr<TIFF> tiff(TIFF::open(filename, big ? "w8" : "w"));
+        for (dimension_size_type i = 0; i < 3U; ++i)
+          {
+            std::shared_ptr<IFD> ifd(tiff->getCurrentDirectory());
+            ifd->setImageWidth(100U + i);
+            ifd->setImageHeight(50U + i);
+            ifd->setTileType(i == 1U ? TILE : STRIP);
+            ifd->setTileWidth(i == 1U ? 32U : 100U + i);
+            ifd->setTileHeight(i == 1U ? 16U : 8U);
+            ifd->setPixelType(i == 2U ? PT::INT16 : PT::UINT8);
+            ifd->setBitsPerSample(i == 2U ? 16U : 8U);
+            ifd->setSamplesPerPixel(1U);
+            ifd->setPlanarConfiguration(CONTIG);
+            ifd->setPhotometricInterpretation(MIN_IS_BLACK);
+            ifd->getField(IMAGEDESCRIPTION).set(std::string("Plane ") + std::to_string(i));
+
+            std::array<ome::files::VariantPixelBuffer::size_type, 9> shape;
+            shape[ome::files::DIM_SPATIAL_X] = 100U + i;
+            shape[ome::files::DIM_SPATIAL_Y] = 50U + i;
+            shape[ome::files::DIM_SUBCHANNEL] = shape[ome::files::DIM_SPATIAL_Z] =
+              shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+              shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] =
+              shape[ome::files::DIM_MODULO_C] = 1;
+            ome::files::VariantPixelBuffer buf(shape, i == 2U ? PT::INT16 : PT::UINT8);
+            ifd->writeImage(buf);
+            tiff->writeCurrentDirectory();
+          }
+        tiff->close();
+      }
+
+      std::shared_ptr<TIFF> tiff(TIFF::open(filename, "r"));
+      DirectoryParser parser(filename);
+      ASSERT_EQ(big, parser.isBigTIFF());
+      ASSERT_EQ(tiff->directoryCount(), parser.directoryCount());
+      for (directory_index_type i = 0; i < tiff->directoryCount(); ++i)
+        {
+          std::shared_ptr<IFD> ifd(tiff->getDirectoryByIndex(i));
+          DirectoryParser::Summary s(parser.summary(i));
+          EXPECT_EQ(ifd->getImageWidth(), s.width);
+          EXPECT_EQ(ifd->getImageHeight(), s.height);
+          EXPECT_EQ(ifd->getSamplesPerPixel(), s.samplesPerPixel);
+          EXPECT_EQ(ifd->getBitsPerSample(), s.bitsPerSample);
+          EXPECT_EQ(ifd->getTileType(), s.tileType);
+          ASSERT_TRUE(static_cast<bool>(s.pixelType));
+          EXPECT_EQ(ifd->getPixelType(), *s.pixelType);
+          std::string description;
+          ifd->getField(IMAGEDESCRIPTION).get(description);
+          ASSERT_TRUE(static_cast<bool>(s.description));
+          EXPECT_EQ(description, *s.description);
+        }
+    }
+}
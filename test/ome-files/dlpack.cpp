@@ -0,0 +1,180 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+
+#include <ome/files/DLPack.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+#ifdef OME_FILES_HAVE_DLPACK
+#include <dlpack/dlpack.h>
+#endif // OME_FILES_HAVE_DLPACK
+
+#include <ome/test/test.h>
+
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::VariantPixelBuffer;
+typedef ome::xml::model::enums::PixelType PT;
+
+namespace
+{
+
+  VariantPixelBuffer
+  make_buffer(bool interleaved)
+  {
+    std::array<VariantPixelBuffer::size_type, 9> shape;
+    shape.fill(1U);
+    shape[::ome::files::DIM_SPATIAL_X] = 4U;
+    shape[::ome::files::DIM_SPATIAL_Y] = 3U;
+    shape[::ome::files::DIM_SUBCHANNEL] = 2U;
+
+    PixelBufferBase::storage_order_type order
+      (PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, interleaved));
+
+    VariantPixelBuffer buf(shape, PT::UINT16, order);
+    uint16_t *data = buf.data<uint16_t>();
+    for (VariantPixelBuffer::size_type i = 0; i < buf.num_elements(); ++i)
+      data[i] = static_cast<uint16_t>(i);
+    return buf;
+  }
+
+}
+
+TEST(DLPack, Unavailable)
+{
+  if (ome::files::haveDLPack())
+    return;
+
+  VariantPixelBuffer buf(make_buffer(true));
+  EXPECT_THROW(ome::files::toDLPack(buf), std::runtime_error);
+}
+
+#ifdef OME_FILES_HAVE_DLPACK
+
+TEST(DLPack, Interleaved)
+{
+  ASSERT_TRUE(ome::files::haveDLPack());
+
+  VariantPixelBuffer buf(make_buffer(true));
+  DLManagedTensor *tensor = ome::files::toDLPack(buf);
+  ASSERT_TRUE(tensor != nullptr);
+
+  const DLTensor& t(tensor->dl_tensor);
+  EXPECT_EQ(kDLCPU, t.device.device_type);
+  EXPECT_EQ(static_cast<int32_t>(PixelBufferBase::dimensions), t.ndim);
+  EXPECT_EQ(static_cast<uint8_t>(kDLUInt), t.dtype.code);
+  EXPECT_EQ(16U, t.dtype.bits);
+  EXPECT_EQ(1U, t.dtype.lanes);
+  EXPECT_EQ(0U, t.byte_offset);
+  EXPECT_EQ(static_cast<void *>(buf.data<uint16_t>()), t.data);
+
+  EXPECT_EQ(4, t.shape[::ome::files::DIM_SPATIAL_X]);
+  EXPECT_EQ(3, t.shape[::ome::files::DIM_SPATIAL_Y]);
+  EXPECT_EQ(2, t.shape[::ome::files::DIM_SUBCHANNEL]);
+  EXPECT_EQ(1, t.strides[::ome::files::DIM_SUBCHANNEL]);
+  EXPECT_EQ(2, t.strides[::ome::files::DIM_SPATIAL_X]);
+  EXPECT_EQ(8, t.strides[::ome::files::DIM_SPATIAL_Y]);
+
+  tensor->deleter(tensor);
+}
+
+TEST(DLPack, Planar)
+{
+  VariantPixelBuffer buf(make_buffer(false));
+  DLManagedTensor *tensor = ome::files::toDLPack(buf);
+
+  const DLTensor& t(tensor->dl_tensor);
+  EXPECT_EQ(1, t.strides[::ome::files::DIM_SPATIAL_X]);
+  EXPECT_EQ(4, t.strides[::ome::files::DIM_SPATIAL_Y]);
+  EXPECT_EQ(12, t.strides[::ome::files::DIM_SUBCHANNEL]);
+
+  tensor->deleter(tensor);
+}
+
+TEST(DLPack, SharedOwnership)
+{
+  DLManagedTensor *tensor;
+  {
+    VariantPixelBuffer buf(make_buffer(true));
+    tensor = ome::files::toDLPack(buf);
+
+    // Writes through the tensor are visible in the buffer.
+    static_cast<uint16_t *>(tensor->dl_tensor.data)[1] = 1000U;
+    EXPECT_EQ(1000U, buf.data<uint16_t>()[1]);
+  }
+
+  // The pixel data outlives the buffer.
+  const uint16_t *data = static_cast<const uint16_t *>(tensor->dl_tensor.data);
+  EXPECT_EQ(0U, data[0]);
+  EXPECT_EQ(1000U, data[1]);
+  EXPECT_EQ(23U, data[23]);
+
+  tensor->deleter(tensor);
+}
+
+TEST(DLPack, NonNativeEndian)
+{
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape.fill(1U);
+  std::shared_ptr<PixelBuffer<uint16_t>> big
+    (std::make_shared<PixelBuffer<uint16_t>>(shape, PT::UINT16, ome::files::ENDIAN_BIG));
+  std::shared_ptr<PixelBuffer<uint16_t>> little
+    (std::make_shared<PixelBuffer<uint16_t>>(shape, PT::UINT16, ome::files::ENDIAN_LITTLE));
+  VariantPixelBuffer bigbuf(big);
+  VariantPixelBuffer littlebuf(little);
+
+  // One of these is not native.
+  DLManagedTensor *tensor = nullptr;
+  try
+    {
+      tensor = ome::files::toDLPack(bigbuf);
+      EXPECT_THROW(ome::files::toDLPack(littlebuf), std::logic_error);
+    }
+  catch (const std::logic_error&)
+    {
+      tensor = ome::files::toDLPack(littlebuf);
+    }
+  ASSERT_TRUE(tensor != nullptr);
+  tensor->deleter(tensor);
+}
+
+#endif // OME_FILES_HAVE_DLPACK
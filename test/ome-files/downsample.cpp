@@ -0,0 +1,329 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/files/Downsample.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/Downsample.h>
+
+#include <ome/test/test.h>
+
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::VariantPixelBuffer;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+namespace tiff = ome::files::tiff;
+
+namespace
+{
+
+  // Reference mean of a block of integer samples, rounded to
+  // nearest with halves away from zero.
+  template<typename T>
+  T
+  reference_mean(const std::vector<T>& block)
+  {
+    int64_t sum = 0;
+    for (const auto v : block)
+      sum += v;
+    const int64_t count = static_cast<int64_t>(block.size());
+    return static_cast<T>((sum + (sum < 0 ? -count : count) / 2) / count);
+  }
+
+  // Downsample rows of every width up to 70 pixels by two, and
+  // compare with the reference mean of each block.
+  template<typename T>
+  void
+  check_mean2(int64_t min,
+              int64_t max)
+  {
+    std::vector<T> src(2U * 70U);
+    for (dimension_size_type width = 1U; width <= 70U; ++width)
+      {
+        for (dimension_size_type i = 0; i < src.size(); ++i)
+          src[i] = static_cast<T>(min + static_cast<int64_t>((i * 7919U + width * 104729U) % static_cast<uint64_t>(max - min + 1)));
+        // Include the extremes.
+        src[0] = static_cast<T>(min);
+        src[src.size() - 1U] = static_cast<T>(max);
+
+        std::vector<T> dest(35U);
+        ome::files::detail::downsampleRow(src.data(), 70, 2U, width, 1U, 2U, tiff::DOWNSAMPLE_MEAN, dest.data());
+
+        for (dimension_size_type x = 0; x < (width + 1U) / 2U; ++x)
+          {
+            std::vector<T> block;
+            for (dimension_size_type j = 0; j < 2U; ++j)
+              for (dimension_size_type i = x * 2U; i < std::min(width, (x * 2U) + 2U); ++i)
+                block.push_back(src[(j * 70U) + i]);
+            EXPECT_EQ(reference_mean(block), dest[x]) << "width " << width << ", x " << x;
+          }
+      }
+  }
+
+  // Create a buffer with values from a function of x, y and the
+  // subchannel.
+  template<typename T, typename F>
+  void
+  make_buffer(VariantPixelBuffer& buf,
+              dimension_size_type width,
+              dimension_size_type height,
+              dimension_size_type subchannels,
+              PixelType           pixeltype,
+              bool                interleaved,
+              F                   value)
+  {
+    std::array<VariantPixelBuffer::size_type, 9> shape;
+    shape.fill(1U);
+    shape[ome::files::DIM_SPATIAL_X] = width;
+    shape[ome::files::DIM_SPATIAL_Y] = height;
+    shape[ome::files::DIM_SUBCHANNEL] = subchannels;
+    buf.setBuffer(shape, pixeltype,
+                  PixelBufferBase::make_storage_order(DimensionOrder::XYZTC, interleaved));
+
+    PixelBuffer<T>& pb(*ome::compat::get<std::shared_ptr<PixelBuffer<T>>>(buf.vbuffer()));
+    typename PixelBuffer<T>::indices_type idx;
+    idx.fill(0);
+    for (dimension_size_type s = 0; s < subchannels; ++s)
+      for (dimension_size_type y = 0; y < height; ++y)
+        for (dimension_size_type x = 0; x < width; ++x)
+          {
+            idx[ome::files::DIM_SPATIAL_X] = static_cast<typename PixelBuffer<T>::indices_type::value_type>(x);
+            idx[ome::files::DIM_SPATIAL_Y] = static_cast<typename PixelBuffer<T>::indices_type::value_type>(y);
+            idx[ome::files::DIM_SUBCHANNEL] = static_cast<typename PixelBuffer<T>::indices_type::value_type>(s);
+            pb.at(idx) = value(x, y, s);
+          }
+  }
+
+  template<typename T>
+  T
+  pixel(const VariantPixelBuffer& buf,
+        dimension_size_type       x,
+        dimension_size_type       y,
+        dimension_size_type       s = 0U)
+  {
+    const PixelBuffer<T>& pb(*ome::compat::get<std::shared_ptr<PixelBuffer<T>>>(buf.vbuffer()));
+    typename PixelBuffer<T>::indices_type idx;
+    idx.fill(0);
+    idx[ome::files::DIM_SPATIAL_X] = static_cast<typename PixelBuffer<T>::indices_type::value_type>(x);
+    idx[ome::files::DIM_SPATIAL_Y] = static_cast<typename PixelBuffer<T>::indices_type::value_type>(y);
+    idx[ome::files::DIM_SUBCHANNEL] = static_cast<typename PixelBuffer<T>::indices_type::value_type>(s);
+    return pb.at(idx);
+  }
+
+}
+
+TEST(Downsample, DownsampledSize)
+{
+  EXPECT_EQ(0U, ome::files::downsampledSize(0U, 2U));
+  EXPECT_EQ(1U, ome::files::downsampledSize(1U, 2U));
+  EXPECT_EQ(2U, ome::files::downsampledSize(4U, 2U));
+  EXPECT_EQ(3U, ome::files::downsampledSize(5U, 2U));
+  EXPECT_EQ(2U, ome::files::downsampledSize(5U, 4U));
+  EXPECT_EQ(5U, ome::files::downsampledSize(5U, 1U));
+  EXPECT_THROW(ome::files::downsampledSize(5U, 0U), std::logic_error);
+}
+
+TEST(Downsample, Supported)
+{
+  EXPECT_TRUE(ome::files::downsamplingSupported(PixelType::FLOAT, tiff::DOWNSAMPLE_MEAN));
+  EXPECT_TRUE(ome::files::downsamplingSupported(PixelType::COMPLEXDOUBLE, tiff::DOWNSAMPLE_NEAREST));
+  EXPECT_TRUE(ome::files::downsamplingSupported(PixelType::UINT16, tiff::DOWNSAMPLE_MODE));
+  EXPECT_TRUE(ome::files::downsamplingSupported(PixelType::BIT, tiff::DOWNSAMPLE_OR));
+  EXPECT_FALSE(ome::files::downsamplingSupported(PixelType::FLOAT, tiff::DOWNSAMPLE_MODE));
+  EXPECT_FALSE(ome::files::downsamplingSupported(PixelType::COMPLEXFLOAT, tiff::DOWNSAMPLE_OR));
+}
+
+TEST(Downsample, RowMean2)
+{
+  // Every width, so that both the SIMD and scalar paths and the
+  // partial block at the edge are used.
+  check_mean2<uint8_t>(0, 255);
+  check_mean2<int8_t>(-128, 127);
+  check_mean2<uint16_t>(0, 65535);
+  check_mean2<int16_t>(-32768, 32767);
+  check_mean2<uint32_t>(0, 4294967295LL);
+  check_mean2<int32_t>(-2147483648LL, 2147483647LL);
+}
+
+TEST(Downsample, RowMeanRounding)
+{
+  // Halves round away from zero.
+  const int16_t src[] = {1, 0, -1, 0, 2, 0, -2, 0,
+                         0, 1, 0, -1, 0, 0, 0, 0};
+  int16_t dest[4];
+  ome::files::detail::downsampleRow(src, 8, 2U, 8U, 1U, 2U, tiff::DOWNSAMPLE_MEAN, dest);
+  EXPECT_EQ(1, dest[0]);
+  EXPECT_EQ(-1, dest[1]);
+  EXPECT_EQ(1, dest[2]);
+  EXPECT_EQ(-1, dest[3]);
+}
+
+TEST(Downsample, RowMode)
+{
+  // 2×2 blocks: majority, pair against two singles, two pairs (tie,
+  // first wins), all different (first wins).
+  const uint8_t src[] = {5, 7, 1, 2, 4, 9, 3, 6,
+                         7, 7, 3, 3, 9, 4, 8, 2};
+  uint8_t dest[4];
+  ome::files::detail::downsampleRow(src, 8, 2U, 8U, 1U, 2U, tiff::DOWNSAMPLE_MODE, dest);
+  EXPECT_EQ(7, dest[0]);
+  EXPECT_EQ(3, dest[1]);
+  EXPECT_EQ(4, dest[2]);
+  EXPECT_EQ(3, dest[3]);
+
+  // A 5×5 block, large enough to be sorted.
+  std::vector<uint16_t> big(25U);
+  for (dimension_size_type i = 0; i < big.size(); ++i)
+    big[i] = static_cast<uint16_t>(i % 4U == 3U ? 42U : i);
+  big[24] = 42U;
+  uint16_t mode;
+  ome::files::detail::downsampleRow(big.data(), 5, 5U, 5U, 1U, 5U, tiff::DOWNSAMPLE_MODE, &mode);
+  EXPECT_EQ(42U, mode);
+}
+
+TEST(Downsample, RowOr)
+{
+  const uint8_t src[] = {0x01, 0x02, 0x00, 0x00, 0x80,
+                         0x04, 0x08, 0x00, 0x10, 0x00};
+  uint8_t dest[3];
+  ome::files::detail::downsampleRow(src, 5, 2U, 5U, 1U, 2U, tiff::DOWNSAMPLE_OR, dest);
+  EXPECT_EQ(0x0F, dest[0]);
+  EXPECT_EQ(0x10, dest[1]);
+  EXPECT_EQ(0x80, dest[2]);
+
+  const bool bits[] = {false, false, true, false,
+                       false, false, false, false};
+  bool bdest[2];
+  ome::files::detail::downsampleRow(bits, 4, 2U, 4U, 1U, 2U, tiff::DOWNSAMPLE_OR, bdest);
+  EXPECT_FALSE(bdest[0]);
+  EXPECT_TRUE(bdest[1]);
+}
+
+TEST(Downsample, RowBitMean)
+{
+  // The majority value, rounding up.
+  const bool bits[] = {true, false, true, true, false, false,
+                       false, false, true, false, true, false};
+  bool dest[3];
+  ome::files::detail::downsampleRow(bits, 6, 2U, 6U, 1U, 2U, tiff::DOWNSAMPLE_MEAN, dest);
+  EXPECT_FALSE(dest[0]);
+  EXPECT_TRUE(dest[1]);
+  EXPECT_FALSE(dest[2]);
+}
+
+TEST(Downsample, RowInvalid)
+{
+  const float src[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+  float dest[2];
+  EXPECT_THROW(ome::files::detail::downsampleRow(src, 2, 2U, 2U, 1U, 2U, tiff::DOWNSAMPLE_MODE, dest), std::logic_error);
+  EXPECT_THROW(ome::files::detail::downsampleRow(src, 2, 2U, 2U, 1U, 2U, tiff::DOWNSAMPLE_OR, dest), std::logic_error);
+  EXPECT_THROW(ome::files::detail::downsampleRow(src, 2, 2U, 2U, 1U, 0U, tiff::DOWNSAMPLE_MEAN, dest), std::logic_error);
+  EXPECT_THROW(ome::files::detail::downsampleRow(src, 2, 3U, 2U, 1U, 2U, tiff::DOWNSAMPLE_MEAN, dest), std::logic_error);
+}
+
+TEST(Downsample, Buffer)
+{
+  auto value = [](dimension_size_type x, dimension_size_type y, dimension_size_type s)
+    { return static_cast<uint16_t>((x * 100U) + (y * 10U) + s); };
+
+  for (const bool interleaved : {true, false})
+    {
+      VariantPixelBuffer src;
+      make_buffer<uint16_t>(src, 7U, 5U, 3U, PixelType::UINT16, interleaved, value);
+
+      VariantPixelBuffer dest;
+      ome::files::downsample(src, dest);
+      ASSERT_EQ(4U, dest.shape()[ome::files::DIM_SPATIAL_X]);
+      ASSERT_EQ(3U, dest.shape()[ome::files::DIM_SPATIAL_Y]);
+      ASSERT_EQ(3U, dest.shape()[ome::files::DIM_SUBCHANNEL]);
+      EXPECT_EQ(PixelType::UINT16, dest.pixelType());
+      EXPECT_TRUE(src.storage_order() == dest.storage_order());
+
+      for (dimension_size_type s = 0; s < 3U; ++s)
+        {
+          // Whole block: mean of x 0..1, y 0..1.
+          EXPECT_EQ(value(0U, 0U, s) + 55U, pixel<uint16_t>(dest, 0U, 0U, s));
+          // Partial block at the right edge (x 6).
+          EXPECT_EQ(value(6U, 2U, s) + 5U, pixel<uint16_t>(dest, 3U, 1U, s));
+          // Partial block at the bottom right corner.
+          EXPECT_EQ(value(6U, 4U, s), pixel<uint16_t>(dest, 3U, 2U, s));
+        }
+
+      ome::files::downsample(src, dest, 3U, tiff::DOWNSAMPLE_NEAREST);
+      ASSERT_EQ(3U, dest.shape()[ome::files::DIM_SPATIAL_X]);
+      ASSERT_EQ(2U, dest.shape()[ome::files::DIM_SPATIAL_Y]);
+      for (dimension_size_type s = 0; s < 3U; ++s)
+        for (dimension_size_type y = 0; y < 2U; ++y)
+          for (dimension_size_type x = 0; x < 3U; ++x)
+            EXPECT_EQ(value(x * 3U, y * 3U, s), pixel<uint16_t>(dest, x, y, s));
+    }
+}
+
+TEST(Downsample, BufferComplex)
+{
+  VariantPixelBuffer src;
+  make_buffer<std::complex<float>>(src, 2U, 2U, 1U, PixelType::COMPLEXFLOAT, true,
+                                   [](dimension_size_type x, dimension_size_type y, dimension_size_type)
+                                   { return std::complex<float>(static_cast<float>(x), static_cast<float>(y * 2U)); });
+
+  VariantPixelBuffer dest;
+  ome::files::downsample(src, dest);
+  EXPECT_EQ(std::complex<float>(0.5f, 1.0f), pixel<std::complex<float>>(dest, 0U, 0U));
+}
+
+TEST(Downsample, BufferInvalid)
+{
+  VariantPixelBuffer src;
+  make_buffer<float>(src, 4U, 4U, 1U, PixelType::FLOAT, true,
+                     [](dimension_size_type x, dimension_size_type, dimension_size_type)
+                     { return static_cast<float>(x); });
+  VariantPixelBuffer dest;
+  EXPECT_THROW(ome::files::downsample(src, dest, 0U), std::logic_error);
+  EXPECT_THROW(ome::files::downsample(src, dest, 2U, tiff::DOWNSAMPLE_MODE), std::logic_error);
+  EXPECT_THROW(ome::files::downsample(src, src), std::logic_error);
+}
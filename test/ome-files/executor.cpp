@@ -0,0 +1,319 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/Executor.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/in/OMETIFFReader.h>
+#include <ome/files/out/OMETIFFWriter.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::CoreMetadata;
+using ome::files::Executor;
+using ome::files::ThreadPoolExecutor;
+using ome::files::VariantPixelBuffer;
+using ome::files::in::OMETIFFReader;
+using ome::files::out::OMETIFFWriter;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  // Executor counting the tasks submitted to a thread pool.
+  class CountingExecutor : public Executor
+  {
+  public:
+    CountingExecutor(unsigned int threads):
+      Executor(),
+      pool(threads),
+      submitted(0U)
+    {
+    }
+
+    void
+    submit(task_type task)
+    {
+      ++submitted;
+      pool.submit(std::move(task));
+    }
+
+    unsigned int
+    concurrency() const
+    {
+      return pool.concurrency();
+    }
+
+    ThreadPoolExecutor pool;
+    std::atomic<unsigned int> submitted;
+  };
+
+}
+
+TEST(Executor, Concurrency)
+{
+  ThreadPoolExecutor pool(3U);
+  EXPECT_EQ(3U, pool.concurrency());
+
+  ThreadPoolExecutor defaultpool;
+  EXPECT_LE(1U, defaultpool.concurrency());
+}
+
+TEST(Executor, CompleteOnDestruction)
+{
+  std::atomic<int> count(0);
+  {
+    ThreadPoolExecutor pool(4U);
+    for (int i = 0; i < 1000; ++i)
+      pool.submit([&count]() { ++count; });
+  }
+  EXPECT_EQ(1000, count.load());
+}
+
+TEST(Executor, Parallel)
+{
+  ThreadPoolExecutor pool(4U);
+
+  for (unsigned int count : {0U, 1U, 2U, 4U, 17U, 100U})
+    {
+      std::vector<std::atomic<int>> runs(count);
+      for (auto& r : runs)
+        r = 0;
+
+      pool.parallel(count, [&runs](unsigned int i) { ++runs.at(i); });
+
+      for (const auto& r : runs)
+        EXPECT_EQ(1, r.load());
+    }
+}
+
+TEST(Executor, ParallelError)
+{
+  ThreadPoolExecutor pool(4U);
+  std::atomic<int> count(0);
+
+  EXPECT_THROW(pool.parallel(8U,
+                             [&count](unsigned int i)
+                             {
+                               ++count;
+                               if (i == 5U)
+                                 throw std::runtime_error("Task failed");
+                             }),
+               std::runtime_error);
+
+  // All other tasks are still run.
+  EXPECT_EQ(8, count.load());
+}
+
+TEST(Executor, NestedParallel)
+{
+  // Every pool thread waits on nested work; the waiting threads
+  // must run it themselves.
+  ThreadPoolExecutor pool(1U);
+  std::atomic<int> count(0);
+
+  pool.parallel(4U,
+                [&](unsigned int)
+                {
+                  pool.parallel(4U,
+                                [&](unsigned int)
+                                {
+                                  pool.parallel(4U, [&](unsigned int) { ++count; });
+                                });
+                });
+
+  EXPECT_EQ(64, count.load());
+}
+
+TEST(Executor, Global)
+{
+  std::shared_ptr<Executor> initial(Executor::global());
+  ASSERT_TRUE(static_cast<bool>(initial));
+  EXPECT_EQ(initial, Executor::global());
+
+  std::shared_ptr<CountingExecutor> counting(std::make_shared<CountingExecutor>(2U));
+  Executor::setGlobal(counting);
+  EXPECT_EQ(counting, Executor::global());
+
+  std::atomic<int> count(0);
+  Executor::global()->parallel(4U, [&count](unsigned int) { ++count; });
+  EXPECT_EQ(4, count.load());
+  EXPECT_LT(0U, counting->submitted.load());
+
+  // Null restores a default pool.
+  Executor::setGlobal(std::shared_ptr<Executor>());
+  std::shared_ptr<Executor> restored(Executor::global());
+  ASSERT_TRUE(static_cast<bool>(restored));
+  EXPECT_NE(std::static_pointer_cast<Executor>(counting), restored);
+}
+
+class ExecutorTIFFTest : public TIFFPixelsTest
+{
+public:
+  ExecutorTIFFTest():
+    TIFFPixelsTest("executor")
+  {
+  }
+};
+
+TEST_F(ExecutorTIFFTest, ParallelDecode)
+{
+  std::shared_ptr<CountingExecutor> executor(std::make_shared<CountingExecutor>(2U));
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(filenames.at(0), "r");
+  EXPECT_EQ(Executor::global(), tiff->getExecutor());
+  tiff->setExecutor(executor);
+  EXPECT_EQ(std::static_pointer_cast<Executor>(executor), tiff->getExecutor());
+  tiff->setDecodeThreads(8U);
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  VariantPixelBuffer plane;
+  ASSERT_NO_THROW(ifd->readImage(plane));
+  EXPECT_TRUE(expected.at(0) == plane);
+  EXPECT_LT(0U, executor->submitted.load());
+
+  // The reader passes its executor to the TIFF.
+  const unsigned int submitted = executor->submitted.load();
+  ome::files::in::MinimalTIFFReader reader;
+  reader.setExecutor(executor);
+  reader.setDecodeThreads(8U);
+  reader.setId(filenames.at(0));
+  VariantPixelBuffer readerplane;
+  ASSERT_NO_THROW(reader.openBytes(0U, readerplane));
+  EXPECT_TRUE(expected.at(0) == readerplane);
+  EXPECT_LT(submitted, executor->submitted.load());
+}
+
+TEST_F(ExecutorTIFFTest, OpenDatasetFiles)
+{
+  // A dataset of one series per file.
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  for (dimension_size_type f = 0; f < file_count; ++f)
+    {
+      std::shared_ptr<CoreMetadata> core(std::make_shared<CoreMetadata>());
+      core->sizeX = image_size;
+      core->sizeY = image_size;
+      core->sizeZ = 1U;
+      core->sizeT = 1U;
+      core->sizeC.clear();
+      core->sizeC.push_back(1U);
+      core->pixelType = PixelType::UINT16;
+      core->imageCount = 1U;
+      core->dimensionOrder = DimensionOrder::XYZCT;
+      core->interleaved = true;
+      seriesList.push_back(core);
+    }
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList);
+
+  std::vector<boost::filesystem::path> dataset;
+  {
+    OMETIFFWriter writer;
+    writer.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+    writer.setInterleaved(true);
+    for (dimension_size_type f = 0; f < file_count; ++f)
+      {
+        std::ostringstream name;
+        name << "dataset-" << f << ".ome.tiff";
+        dataset.push_back(datafile(name.str()));
+        if (f)
+          writer.setSeries(f);
+        writer.setId(dataset.back());
+        writer.saveBytes(0U, expected.at(f));
+      }
+    writer.close();
+  }
+
+  // With strict validation, the other files are opened on the
+  // executor.
+  {
+    std::shared_ptr<CountingExecutor> executor(std::make_shared<CountingExecutor>(2U));
+    OMETIFFReader reader;
+    reader.setExecutor(executor);
+    ASSERT_TRUE(reader.getStrictValidation());
+    ASSERT_NO_THROW(reader.setId(dataset.at(0)));
+    EXPECT_LT(0U, executor->submitted.load());
+
+    ASSERT_EQ(file_count, reader.getSeriesCount());
+    for (dimension_size_type s = 0; s < reader.getSeriesCount(); ++s)
+      {
+        reader.setSeries(s);
+        VariantPixelBuffer plane;
+        ASSERT_NO_THROW(reader.openBytes(0U, plane));
+        EXPECT_TRUE(expected.at(s) == plane);
+      }
+    reader.close();
+  }
+
+  // A missing file doesn't prevent opening the dataset.
+  boost::filesystem::remove(dataset.at(3));
+  {
+    OMETIFFReader reader;
+    reader.setExecutor(std::make_shared<CountingExecutor>(2U));
+    ASSERT_NO_THROW(reader.setId(dataset.at(0)));
+    VariantPixelBuffer plane;
+    ASSERT_NO_THROW(reader.openBytes(0U, plane));
+    EXPECT_TRUE(expected.at(0) == plane);
+    reader.close();
+  }
+
+  for (const auto& file : dataset)
+    if (boost::filesystem::exists(file))
+      boost::filesystem::remove(file);
+}
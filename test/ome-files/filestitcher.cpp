@@ -0,0 +1,298 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/FilePattern.h>
+#include <ome/files/FileStitcher.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::CoreMetadata;
+using ome::files::FilePattern;
+using ome::files::FileStitcher;
+using ome::files::FormatReader;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("StitchTestReader", "Reader for file stitcher testing");
+    p.suffixes.push_back("tst");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  /// Number of files opened by all StitchTestReaders.
+  std::atomic<unsigned int> opened(0U);
+
+  uint16_t
+  value(const VariantPixelBuffer& buf)
+  {
+    return buf.array<uint16_t>()[1][1][0][0][0][0][0][0][0];
+  }
+
+}
+
+// Reader of single-plane 2×2 UINT16 files named img_zN_cN.tst,
+// with each pixel set to the Z and C of the filename (as 10Z+C).
+class StitchTestReader : public ome::files::detail::FormatReader
+{
+private:
+  uint16_t pixel;
+
+public:
+  StitchTestReader():
+    ome::files::detail::FormatReader(props),
+    pixel(0U)
+  {
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+    ++opened;
+
+    const std::string name(id.filename().string());
+    pixel = static_cast<uint16_t>(((name.at(5) - '0') * 10) + (name.at(8) - '0'));
+
+    std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+    c->sizeX = 2;
+    c->sizeY = 2;
+    c->sizeZ = 1;
+    c->sizeT = 1;
+    c->sizeC.assign(1U, 1U);
+    c->pixelType = PixelType::UINT16;
+    c->imageCount = 1;
+    c->dimensionOrder = DimensionOrder::XYZCT;
+    c->orderCertain = true;
+    c->interleaved = false;
+    c->indexed = false;
+    c->resolutionCount = 1;
+
+    core.clear();
+    core.push_back(c);
+  }
+
+  void
+  openBytesImpl(dimension_size_type /* plane */,
+                VariantPixelBuffer& buf,
+                dimension_size_type /* x */,
+                dimension_size_type /* y */,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    preparePlane(buf, w, h, 1U);
+    std::fill(buf.data<uint16_t>(), buf.data<uint16_t>() + buf.num_elements(), pixel);
+  }
+};
+
+class FileStitcherTest : public ::testing::Test
+{
+public:
+  boost::filesystem::path dir;
+
+  virtual void SetUp()
+  {
+    dir = PROJECT_BINARY_DIR "/test/ome-files/data/filestitcher";
+    if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+      throw std::runtime_error("Image directory unavailable and could not be created");
+
+    for (unsigned int z = 0; z < 3U; ++z)
+      for (unsigned int c = 0; c < 2U; ++c)
+        {
+          const boost::filesystem::path file(dir / ("img_z" + std::to_string(z) + "_c" + std::to_string(c) + ".tst"));
+          std::ofstream out(file.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        }
+    std::ofstream out((dir / "img_z0_c0.txt").string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    opened = 0U;
+  }
+
+  virtual void TearDown()
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(dir, ec);
+  }
+
+  std::shared_ptr<FileStitcher>
+  stitcher()
+  {
+    return std::make_shared<FileStitcher>(std::make_shared<StitchTestReader>(),
+                                          []() { return std::make_shared<StitchTestReader>(); });
+  }
+};
+
+TEST(FilePattern, Parse)
+{
+  FilePattern fp("a<1-3>_<x,y>.tst");
+  EXPECT_EQ(std::string("a<1-3>_<x,y>.tst"), fp.getPattern());
+  ASSERT_EQ(2U, fp.getBlockCount());
+  EXPECT_EQ(std::string("a"), fp.getPrefix(0));
+  EXPECT_EQ(std::string("_"), fp.getPrefix(1));
+  EXPECT_EQ(6U, fp.getFileCount());
+  EXPECT_EQ(boost::filesystem::path("a1_x.tst"), fp.getFile(0));
+  EXPECT_EQ(boost::filesystem::path("a1_y.tst"), fp.getFile(1));
+  EXPECT_EQ(boost::filesystem::path("a3_y.tst"), fp.getFile(5));
+  EXPECT_THROW(fp.getFile(6), std::logic_error);
+
+  FilePattern padded("t<08-10>.tst");
+  EXPECT_EQ((std::vector<std::string>{"08", "09", "10"}), padded.getBlock(0));
+
+  FilePattern single("plain.tst");
+  EXPECT_EQ(0U, single.getBlockCount());
+  EXPECT_EQ(1U, single.getFileCount());
+  EXPECT_EQ(boost::filesystem::path("plain.tst"), single.getFile(0));
+
+  EXPECT_THROW(FilePattern("t<3-1>.tst"), std::logic_error);
+  EXPECT_THROW(FilePattern("t<1-3.tst"), std::logic_error);
+  EXPECT_THROW(FilePattern("t<1,,3>.tst"), std::logic_error);
+}
+
+TEST_F(FileStitcherTest, FindPattern)
+{
+  const FilePattern fp(FilePattern::findPattern(dir / "img_z1_c0.tst"));
+  EXPECT_EQ((dir / "img_z<0-2>_c<0-1>.tst").string(), fp.getPattern());
+  EXPECT_EQ(6U, fp.getFileCount());
+  EXPECT_EQ(dir / "img_z2_c1.tst", fp.getFile(5));
+
+  // With a combination missing, only the last varying block is kept.
+  boost::filesystem::remove(dir / "img_z2_c1.tst");
+  const FilePattern partial(FilePattern::findPattern(dir / "img_z1_c0.tst"));
+  EXPECT_EQ((dir / "img_z1_c<0-1>.tst").string(), partial.getPattern());
+}
+
+TEST_F(FileStitcherTest, Stitch)
+{
+  std::shared_ptr<FileStitcher> reader(stitcher());
+  ASSERT_NO_THROW(reader->setId(dir / "img_z0_c0.tst"));
+
+  // Only the first file is opened.
+  EXPECT_EQ(1U, opened.load());
+  EXPECT_EQ((std::vector<char>{'Z', 'C'}), reader->getAxisTypes());
+  EXPECT_EQ(3U, reader->getSizeZ());
+  EXPECT_EQ(2U, reader->getEffectiveSizeC());
+  EXPECT_EQ(2U, reader->getSizeC());
+  EXPECT_EQ(1U, reader->getSizeT());
+  EXPECT_EQ(6U, reader->getImageCount());
+  EXPECT_EQ(6U, reader->getUsedFiles().size());
+
+  VariantPixelBuffer buf;
+  for (dimension_size_type z = 0; z < 3U; ++z)
+    for (dimension_size_type c = 0; c < 2U; ++c)
+      {
+        const dimension_size_type plane = reader->getIndex(z, c, 0);
+        reader->openBytes(plane, buf);
+        EXPECT_EQ(plane, reader->getPlane());
+        EXPECT_EQ((z * 10U) + c, value(buf));
+      }
+
+  // Each other file is opened once, when read.
+  EXPECT_EQ(6U, opened.load());
+  EXPECT_EQ(5U, reader->getOpenFileCount());
+
+  EXPECT_THROW(reader->setPlane(6), std::logic_error);
+}
+
+TEST_F(FileStitcherTest, Pattern)
+{
+  std::shared_ptr<FileStitcher> reader(stitcher());
+  ASSERT_NO_THROW(reader->setId((dir / "img_z<1-2>_c0.tst").string()));
+
+  EXPECT_EQ(2U, reader->getSizeZ());
+  EXPECT_EQ(1U, reader->getEffectiveSizeC());
+
+  VariantPixelBuffer buf;
+  reader->openBytes(1, buf);
+  EXPECT_EQ(20U, value(buf));
+}
+
+TEST_F(FileStitcherTest, OpenPlanes)
+{
+  std::shared_ptr<FileStitcher> reader(stitcher());
+  ASSERT_NO_THROW(reader->setId(dir / "img_z0_c0.tst"));
+  reader->setDecodeThreads(3U);
+
+  const std::vector<dimension_size_type> planes{5, 4, 3, 2, 1, 0};
+  std::vector<VariantPixelBuffer> bufs;
+  ASSERT_NO_THROW(reader->openPlanes(planes, bufs));
+  ASSERT_EQ(planes.size(), bufs.size());
+
+  for (std::vector<dimension_size_type>::size_type i = 0; i < planes.size(); ++i)
+    {
+      const std::array<dimension_size_type, 3> coords(reader->getZCTCoords(planes[i]));
+      EXPECT_EQ((coords[0] * 10U) + coords[1], value(bufs[i]));
+    }
+
+  // Idle readers beyond the limit are closed.
+  EXPECT_EQ(5U, reader->getOpenFileCount());
+  reader->setOpenFileLimit(2U);
+  EXPECT_EQ(2U, reader->getOpenFileLimit());
+  EXPECT_EQ(2U, reader->getOpenFileCount());
+
+  // Closed readers are reopened when needed.
+  VariantPixelBuffer buf;
+  reader->openBytes(reader->getIndex(0, 1, 0), buf);
+  EXPECT_EQ(1U, value(buf));
+  EXPECT_EQ(2U, reader->getOpenFileCount());
+
+  std::vector<dimension_size_type> invalid{0, 6};
+  EXPECT_THROW(reader->openPlanes(invalid, bufs), std::logic_error);
+}
@@ -41,6 +41,7 @@
 #include <ome/common/module.h>
 
 #include <ome/files/FormatReader.h>
+#include <ome/files/MetadataTools.h>
 #include <ome/files/VariantPixelBuffer.h>
 #include <ome/files/PixelProperties.h>
 #include <ome/files/detail/FormatReader.h>
@@ -121,9 +122,13 @@ private:
   const FormatReaderTestParameters& test_params;
 
 public:
+  /// Number of deferred original metadata reads.
+  mutable unsigned int originalMetadataReads;
+
   FormatReaderCustom(const FormatReaderTestParameters& test_params):
     ::ome::files::detail::FormatReader(props),
-    test_params(test_params)
+    test_params(test_params),
+    originalMetadataReads(0U)
   {
     domains.push_back("Test domain");
   }
@@ -179,14 +184,18 @@ protected:
 protected:
   void
   openBytesImpl(dimension_size_type /* no */,
-                VariantPixelBuffer& /* buf */,
+                VariantPixelBuffer& buf,
                 dimension_size_type /* x */,
                 dimension_size_type /* y */,
-                dimension_size_type /* w */,
-                dimension_size_type /* h */) const
+                dimension_size_type w,
+                dimension_size_type h) const
   {
     assertId(currentId, true);
-    return;
+
+    // No pixel data, but size the buffer to match the region.
+    if (buf.shape()[ome::files::DIM_SPATIAL_X] != w ||
+        buf.shape()[ome::files::DIM_SPATIAL_Y] != h)
+      buf.setBuffer(boost::extents[w][h][1][1][1][1][1][1][1], getPixelType());
   }
 
   void
@@ -196,15 +205,15 @@ protected:
 
     if (id == "test" || id == "flat")
       {
-        metadata["Institution"] = "University of Dundee";
-
         // 4 series
         core.clear();
         core.push_back(makeCore());
-        core.back()->seriesMetadata["Organism"] = "Mus musculus";
         core.push_back(makeCore());
         core.push_back(makeCore());
         core.push_back(makeCore());
+
+        if (!isOriginalMetadataLazy())
+          setOriginalMetadata();
       }
     else if (id == "subres")
       {
@@ -237,7 +246,28 @@ protected:
       }
   }
 
+  void
+  readOriginalMetadata() const
+  {
+    ++originalMetadataReads;
+    if (*getCurrentFile() == "test" || *getCurrentFile() == "flat")
+      setOriginalMetadata();
+  }
+
+  void
+  setOriginalMetadata() const
+  {
+    metadata["Institution"] = "University of Dundee";
+    core.front()->seriesMetadata["Organism"] = "Mus musculus";
+  }
+
 public:
+  CoreMetadata&
+  modifyCoreMetadata(dimension_size_type index)
+  {
+    return getCoreMetadata(index);
+  }
+
   bool
   isUsedFile(const boost::filesystem::path& file)
   {
@@ -269,6 +299,33 @@ public:
     ::ome::files::detail::FormatReader::readPlane(source, dest, x, y, w, h, scanlinePad, samples);
   }
 
+  void
+  readPlane(const uint8_t       *source,
+            dimension_size_type  size,
+            VariantPixelBuffer&  dest,
+            dimension_size_type  x,
+            dimension_size_type  y,
+            dimension_size_type  w,
+            dimension_size_type  h,
+            dimension_size_type  samples)
+  {
+    ::ome::files::detail::FormatReader::readPlane(source, size, dest, x, y, w, h, samples);
+  }
+
+  void
+  readPlane(const uint8_t       *source,
+            dimension_size_type  size,
+            VariantPixelBuffer&  dest,
+            dimension_size_type  x,
+            dimension_size_type  y,
+            dimension_size_type  w,
+            dimension_size_type  h,
+            dimension_size_type  scanlinePad,
+            dimension_size_type  samples)
+  {
+    ::ome::files::detail::FormatReader::readPlane(source, size, dest, x, y, w, h, scanlinePad, samples);
+  }
+
 };
 
 class FormatReaderTest : public ::testing::TestWithParam<FormatReaderTestParameters>
@@ -816,6 +873,10 @@ TEST_P(FormatReaderTest, DefaultProperties)
   EXPECT_NO_THROW(r.setNormalized(true));
   EXPECT_TRUE(r.isNormalized());
 
+  EXPECT_FALSE(r.isIndexedExpanded());
+  EXPECT_NO_THROW(r.setIndexedExpanded(true));
+  EXPECT_TRUE(r.isIndexedExpanded());
+
   EXPECT_FALSE(r.isOriginalMetadataPopulated());
   EXPECT_NO_THROW(r.setOriginalMetadataPopulated(true));
   EXPECT_TRUE(r.isOriginalMetadataPopulated());
@@ -841,6 +902,10 @@ TEST_P(FormatReaderTest, FlatProperties)
   EXPECT_THROW(r.setNormalized(true), std::logic_error);
   EXPECT_FALSE(r.isNormalized());
 
+  EXPECT_FALSE(r.isIndexedExpanded());
+  EXPECT_THROW(r.setIndexedExpanded(true), std::logic_error);
+  EXPECT_FALSE(r.isIndexedExpanded());
+
   EXPECT_FALSE(r.isOriginalMetadataPopulated());
   EXPECT_THROW(r.setOriginalMetadataPopulated(true), std::logic_error);
   EXPECT_FALSE(r.isOriginalMetadataPopulated());
@@ -980,6 +1045,94 @@ TEST_P(FormatReaderTest, FlatMetadata)
   EXPECT_TRUE(r.isMetadataFiltered());
 }
 
+TEST_P(FormatReaderTest, LazyMetadata)
+{
+  EXPECT_FALSE(r.isOriginalMetadataLazy());
+  EXPECT_NO_THROW(r.setOriginalMetadataLazy(true));
+  EXPECT_TRUE(r.isOriginalMetadataLazy());
+  r.setId("flat");
+
+  EXPECT_THROW(r.setOriginalMetadataLazy(false), std::logic_error);
+  EXPECT_EQ(0U, r.originalMetadataReads);
+
+  EXPECT_EQ(r.getSeriesMetadataValue("Organism"), MetadataMap::value_type("Mus musculus"));
+  EXPECT_EQ(1U, r.originalMetadataReads);
+  EXPECT_EQ(r.getMetadataValue("Institution"), MetadataMap::value_type("University of Dundee"));
+  EXPECT_EQ(1U, r.getGlobalMetadata().size());
+  EXPECT_EQ(1U, r.getSeriesMetadata().size());
+  EXPECT_EQ(1U, r.originalMetadataReads);
+
+  // Reopening defers reading again.
+  r.close();
+  r.setId("test");
+  EXPECT_EQ(1U, r.originalMetadataReads);
+  EXPECT_EQ(1U, r.getGlobalMetadata().size());
+  EXPECT_EQ(2U, r.originalMetadataReads);
+}
+
+TEST_P(FormatReaderTest, SharedCoreMetadata)
+{
+  r.setId("flat");
+
+  const std::vector<std::shared_ptr<CoreMetadata>>& list(r.getCoreMetadataList());
+  ASSERT_EQ(4U, list.size());
+
+  // Series 0 differs by its series metadata.
+  EXPECT_NE(list.at(0), list.at(1));
+  EXPECT_EQ(list.at(1), list.at(2));
+  EXPECT_EQ(list.at(1), list.at(3));
+  EXPECT_TRUE(*list.at(2) == *list.at(3));
+
+  // Modification copies on write.
+  r.modifyCoreMetadata(2).sizeX = 256;
+  EXPECT_NE(list.at(2), list.at(3));
+  EXPECT_EQ(list.at(1), list.at(3));
+  EXPECT_EQ(256U, list.at(2)->sizeX);
+  EXPECT_EQ(512U, list.at(3)->sizeX);
+  EXPECT_TRUE(*list.at(2) != *list.at(3));
+
+  r.setSeries(2);
+  EXPECT_EQ(256U, r.getSizeX());
+  r.setSeries(3);
+  EXPECT_EQ(512U, r.getSizeX());
+}
+
+TEST_P(FormatReaderTest, SharedCoreMetadataLazy)
+{
+  EXPECT_NO_THROW(r.setOriginalMetadataLazy(true));
+  r.setId("flat");
+
+  // Series metadata is only set for series 0 when read.
+  r.setSeries(1);
+  EXPECT_EQ(0U, r.getSeriesMetadata().size());
+  r.setSeries(0);
+  EXPECT_EQ(1U, r.getSeriesMetadata().size());
+  r.setSeries(2);
+  EXPECT_EQ(0U, r.getSeriesMetadata().size());
+}
+
+TEST_P(FormatReaderTest, LazyMetadataStore)
+{
+  std::shared_ptr<MetadataStore> store(std::make_shared<OMEXMLMetadata>());
+
+  EXPECT_NO_THROW(r.setMetadataStore(store));
+  EXPECT_NO_THROW(r.setOriginalMetadataPopulated(true));
+  EXPECT_NO_THROW(r.setOriginalMetadataLazy(true));
+  r.setId("flat");
+  EXPECT_EQ(0U, r.originalMetadataReads);
+
+  std::shared_ptr<OMEXMLMetadata> omexml(std::dynamic_pointer_cast<OMEXMLMetadata>(r.getMetadataStore()));
+  ASSERT_TRUE(!!omexml);
+  EXPECT_EQ(1U, r.originalMetadataReads);
+
+  MetadataMap original(ome::files::getOriginalMetadata(*omexml));
+  EXPECT_EQ(MetadataMap::value_type("University of Dundee"), original.get<MetadataMap::value_type>("Institution"));
+  EXPECT_EQ(MetadataMap::value_type("Mus musculus"), original.get<MetadataMap::value_type>("Series 0 Organism"));
+
+  EXPECT_EQ(1U, r.getGlobalMetadata().size());
+  EXPECT_EQ(1U, r.originalMetadataReads);
+}
+
 TEST_P(FormatReaderTest, DefaultMetadataStore)
 {
   std::shared_ptr<MetadataStore> store(std::make_shared<OMEXMLMetadata>());
@@ -1012,6 +1165,8 @@ TEST_P(FormatReaderTest, DefaultPixels)
 
   EXPECT_THROW(r.readPlane(is, buf, 0, 0, 512, 512, 1), std::logic_error);
   EXPECT_THROW(r.readPlane(is, buf, 0, 0, 512, 512, 0, 1), std::logic_error);
+  const uint8_t mem[1] = {0};
+  EXPECT_THROW(r.readPlane(mem, 0, buf, 0, 0, 512, 512, 1), std::logic_error);
 
   EXPECT_THROW(r.openBytes(0, buf), std::logic_error);
   EXPECT_THROW(r.openBytes(0, buf, 0, 0, 512, 512), std::logic_error);
@@ -1069,9 +1224,26 @@ namespace
       for (uint32_t i = 0; i < expected.size(); ++i)
         ASSERT_EQ(expected.at(i), *(buf.data<value_type>()+i));
 
+      // Reading from memory must match reading from the stream.
+      const std::string raw(ss.str());
+      const uint8_t *mem = reinterpret_cast<const uint8_t *>(raw.data());
+      VariantPixelBuffer mbuf;
+      EXPECT_NO_THROW(reader.readPlane(mem, raw.size(), mbuf, 0, 0, 512, 512, 1));
+      EXPECT_TRUE(buf == mbuf);
+
+      VariantPixelBuffer column;
+      ss.clear();
+      ss.seekg(0, std::ios::beg);
+      EXPECT_NO_THROW(reader.readPlane(ss, column, 3, 7, 1, 500, 1));
+      EXPECT_NO_THROW(reader.readPlane(mem, raw.size(), mbuf, 3, 7, 1, 500, 1));
+      EXPECT_TRUE(column == mbuf);
+
+      EXPECT_THROW(reader.readPlane(mem, raw.size() - 1, mbuf, 0, 0, 512, 512, 1), std::runtime_error);
+
       EXPECT_NO_THROW(reader.openBytes(0, buf));
       EXPECT_NO_THROW(reader.openBytes(0, buf, 0, 0, 512, 512));
-      EXPECT_THROW(reader.openThumbBytes(0, buf), std::runtime_error);
+      EXPECT_NO_THROW(reader.openThumbBytes(0, buf));
+      EXPECT_EQ(reader.getThumbSizeX() * reader.getThumbSizeY(), buf.num_elements());
     }
   };
 
@@ -39,12 +39,14 @@
 #include <stdexcept>
 #include <vector>
 
+#include <ome/files/DimensionIndexer.h>
 #include <ome/files/FormatTools.h>
 
 #include <ome/xml/model/enums/DimensionOrder.h>
 
 #include <ome/test/test.h>
 
+using ome::files::DimensionIndexer;
 using ome::files::dimension_size_type;
 using ome::files::getIndex;
 using ome::files::getZCTCoords;
@@ -187,6 +189,95 @@ TEST_P(DimensionTest, GetModuloIndex)
                      params.modcoords[5]));
 }
 
+TEST_P(DimensionTest, IndexerCoords)
+{
+  const DimensionTestParameters& params = GetParam();
+
+  DimensionIndexer indexer(DimensionOrder(params.order),
+                           params.sizes[0],
+                           params.sizes[1],
+                           params.sizes[2],
+                           params.modsizes[3],
+                           params.modsizes[4],
+                           params.modsizes[5],
+                           params.totalsize);
+
+  ASSERT_EQ(params.coords, indexer.coords(params.index));
+  ASSERT_EQ(params.modcoords, indexer.moduloCoords(params.index));
+  EXPECT_NO_THROW(indexer.checkIndex(params.index));
+  EXPECT_THROW(indexer.checkIndex(params.totalsize), std::out_of_range);
+}
+
+TEST_P(DimensionTest, IndexerIndex)
+{
+  const DimensionTestParameters& params = GetParam();
+
+  DimensionIndexer indexer(DimensionOrder(params.order),
+                           params.sizes[0],
+                           params.sizes[1],
+                           params.sizes[2],
+                           params.modsizes[3],
+                           params.modsizes[4],
+                           params.modsizes[5],
+                           params.totalsize);
+
+  ASSERT_EQ(params.index,
+            indexer.index(params.coords[0],
+                          params.coords[1],
+                          params.coords[2]));
+  ASSERT_EQ(params.index,
+            indexer.index(params.modcoords[0],
+                          params.modcoords[1],
+                          params.modcoords[2],
+                          params.modcoords[3],
+                          params.modcoords[4],
+                          params.modcoords[5]));
+  EXPECT_NO_THROW(indexer.checkCoords(params.coords[0],
+                                      params.coords[1],
+                                      params.coords[2]));
+  EXPECT_THROW(indexer.checkCoords(params.sizes[0],
+                                   params.coords[1],
+                                   params.coords[2]), std::out_of_range);
+}
+
+TEST_P(DimensionTest, IndexerBatch)
+{
+  const DimensionTestParameters& params = GetParam();
+
+  DimensionIndexer indexer(DimensionOrder(params.order),
+                           params.sizes[0],
+                           params.sizes[1],
+                           params.sizes[2],
+                           params.totalsize);
+
+  std::vector<dimension_size_type> indexes(params.totalsize);
+  for (dimension_size_type i = 0; i < params.totalsize; ++i)
+    indexes[i] = i;
+
+  std::vector<dims> coords(params.totalsize);
+  indexer.batchCoords(indexes.begin(), indexes.end(), coords.begin());
+  for (dimension_size_type i = 0; i < params.totalsize; ++i)
+    ASSERT_EQ(getZCTCoords(params.order,
+                           params.sizes[0],
+                           params.sizes[1],
+                           params.sizes[2],
+                           params.totalsize,
+                           i), coords[i]);
+
+  std::vector<dimension_size_type> roundtrip(params.totalsize);
+  indexer.batchIndex(coords.begin(), coords.end(), roundtrip.begin());
+  ASSERT_EQ(indexes, roundtrip);
+}
+
+TEST(DimensionIndexer, InvalidSizes)
+{
+  EXPECT_THROW(DimensionIndexer(DimensionOrder::XYZCT, 0U, 1U, 1U, 0U), std::out_of_range);
+  EXPECT_THROW(DimensionIndexer(DimensionOrder::XYZCT, 1U, 1U, 1U, 0U), std::logic_error);
+  EXPECT_THROW(DimensionIndexer(DimensionOrder::XYZCT, 2U, 3U, 4U, 25U), std::logic_error);
+  EXPECT_THROW(DimensionIndexer(DimensionOrder::XYZCT, 2U, 3U, 4U, 0U, 1U, 1U, 24U), std::out_of_range);
+  EXPECT_NO_THROW(DimensionIndexer(DimensionOrder::XYZCT, 2U, 3U, 4U, 24U));
+}
+
 namespace
 {
 
@@ -553,6 +553,15 @@ TEST_P(FormatWriterTest, OutputSequential)
   EXPECT_TRUE(w.getWriteSequentially());
 }
 
+TEST_P(FormatWriterTest, DefaultWriteThreads)
+{
+  EXPECT_EQ(1U, w.getWriteThreads());
+  EXPECT_NO_THROW(w.setWriteThreads(4U));
+  EXPECT_EQ(4U, w.getWriteThreads());
+  EXPECT_NO_THROW(w.setWriteThreads(0U));
+  EXPECT_EQ(1U, w.getWriteThreads());
+}
+
 TEST_P(FormatWriterTest, CompressionTypes)
 {
   const std::set<std::string>& ctypes = w.getCompressionTypes();
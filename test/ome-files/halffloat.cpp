@@ -0,0 +1,130 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <ome/files/detail/HalfFloat.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::detail::floatToHalf;
+using ome::files::detail::halfToFloat;
+
+namespace
+{
+
+  uint16_t
+  to_half(float value)
+  {
+    uint16_t h;
+    floatToHalf(&value, &h, 1U);
+    return h;
+  }
+
+  float
+  to_float(uint16_t value)
+  {
+    float f;
+    halfToFloat(&value, &f, 1U);
+    return f;
+  }
+
+}
+
+TEST(HalfFloat, Values)
+{
+  EXPECT_EQ(0x0000U, to_half(0.0f));
+  EXPECT_EQ(0x8000U, to_half(-0.0f));
+  EXPECT_EQ(0x3C00U, to_half(1.0f));
+  EXPECT_EQ(0xC000U, to_half(-2.0f));
+  EXPECT_EQ(0x7BFFU, to_half(65504.0f));
+  EXPECT_EQ(0x0001U, to_half(std::ldexp(1.0f, -24)));
+  EXPECT_EQ(0x0400U, to_half(std::ldexp(1.0f, -14)));
+  EXPECT_EQ(0x7C00U, to_half(std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(0xFC00U, to_half(-std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(0x7C00U, to_half(1.0e6f));
+  EXPECT_EQ(0x7C00U, to_half(65520.0f));
+  EXPECT_EQ(0x7E00U, to_half(std::numeric_limits<float>::quiet_NaN()) & 0x7E00U);
+
+  EXPECT_EQ(1.0f, to_float(0x3C00U));
+  EXPECT_EQ(65504.0f, to_float(0x7BFFU));
+  EXPECT_EQ(std::ldexp(1.0f, -24), to_float(0x0001U));
+  EXPECT_TRUE(std::isinf(to_float(0x7C00U)));
+  EXPECT_TRUE(std::isnan(to_float(0x7E00U)));
+  EXPECT_TRUE(std::signbit(to_float(0x8000U)));
+}
+
+TEST(HalfFloat, Rounding)
+{
+  // Ties round to even.
+  EXPECT_EQ(0x3C00U, to_half(1.0f + std::ldexp(1.0f, -11)));
+  EXPECT_EQ(0x3C02U, to_half(1.0f + std::ldexp(3.0f, -11)));
+  EXPECT_EQ(0x3C01U, to_half(1.0f + std::ldexp(1.0f, -11) + std::ldexp(1.0f, -20)));
+  EXPECT_EQ(0x0000U, to_half(std::ldexp(1.0f, -25)));
+  EXPECT_EQ(0x0002U, to_half(std::ldexp(3.0f, -25)));
+  EXPECT_EQ(0x0001U, to_half(std::ldexp(3.0f, -26)));
+}
+
+TEST(HalfFloat, RoundTrip)
+{
+  // Every half-precision value converts exactly, for counts which
+  // are not multiples of the SIMD block sizes.
+  std::vector<uint16_t> halves;
+  for (uint32_t h = 0; h < 0x10000U; ++h)
+    if ((h & 0x7C00U) != 0x7C00U || !(h & 0x03FFU)) // Not NaN
+      halves.push_back(static_cast<uint16_t>(h));
+  halves.push_back(0x3C00U);
+
+  std::vector<float> floats(halves.size());
+  halfToFloat(halves.data(), floats.data(), halves.size());
+
+  std::vector<uint16_t> result(halves.size() + 1, 0xFFFFU);
+  floatToHalf(floats.data(), result.data(), halves.size());
+  for (dimension_size_type i = 0; i < halves.size(); ++i)
+    {
+      ASSERT_EQ(halves[i], result[i]);
+      ASSERT_EQ(floats[i], to_float(halves[i]));
+    }
+  // Not overrun.
+  EXPECT_EQ(0xFFFFU, result[halves.size()]);
+}
@@ -0,0 +1,139 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/compat/variant.h>
+
+#include <ome/files/HaloRegion.h>
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/tiff/DecodedTileCache.h>
+
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::PixelBuffer;
+using ome::files::VariantPixelBuffer;
+
+class HaloRegionTest : public TIFFPixelsTest
+{
+public:
+  HaloRegionTest():
+    TIFFPixelsTest("haloregion")
+  {
+  }
+};
+
+TEST_F(HaloRegionTest, Borders)
+{
+  const dimension_size_type tile_bytes = tile_size * tile_size * sizeof(uint16_pixel_type);
+  std::shared_ptr<ome::files::tiff::DecodedTileCache> cache
+    (std::make_shared<ome::files::tiff::DecodedTileCache>(64U * tile_bytes));
+
+  ome::files::in::MinimalTIFFReader reader;
+  reader.setTileCache(cache);
+  ASSERT_NO_THROW(reader.setId(filenames.at(0)));
+
+  const uint16_pixel_type *data = expected.at(0).data<uint16_pixel_type>();
+  const dimension_size_type halo = 16U;
+
+  // Reference border mapping.
+  auto source = [](int64_t i, ome::files::BorderMode mode) -> int64_t
+    {
+      const int64_t size = static_cast<int64_t>(image_size);
+      if (i >= 0 && i < size)
+        return i;
+      if (mode == ome::files::BORDER_ZERO)
+        return -1;
+      if (mode == ome::files::BORDER_REPLICATE)
+        return i < 0 ? 0 : size - 1;
+      return i < 0 ? -i - 1 : (size * 2) - i - 1;
+    };
+
+  const std::vector<ome::files::PlaneRegion> chunks
+    {
+      ome::files::PlaneRegion(0U, 0U, 64U, 64U),
+      ome::files::PlaneRegion(64U, 0U, 64U, 64U),
+      ome::files::PlaneRegion(200U, 200U, 64U, 64U),
+      ome::files::PlaneRegion(448U, 448U, 64U, 64U)
+    };
+
+  for (const auto mode : {ome::files::BORDER_ZERO,
+                          ome::files::BORDER_REPLICATE,
+                          ome::files::BORDER_REFLECT})
+    {
+      for (const auto& chunk : chunks)
+        {
+          VariantPixelBuffer buf;
+          ASSERT_NO_THROW(ome::files::openBytesHalo(reader, 0U, 0U, 0U, buf, chunk, halo, mode));
+          ASSERT_EQ(chunk.w + (halo * 2U), buf.shape()[::ome::files::DIM_SPATIAL_X]);
+          ASSERT_EQ(chunk.h + (halo * 2U), buf.shape()[::ome::files::DIM_SPATIAL_Y]);
+
+          const auto& pixels = *ome::compat::get<std::shared_ptr<PixelBuffer<uint16_pixel_type>>>(buf.vbuffer());
+          PixelBuffer<uint16_pixel_type>::indices_type idx;
+          idx.fill(0);
+          for (dimension_size_type y = 0; y < chunk.h + (halo * 2U); ++y)
+            for (dimension_size_type x = 0; x < chunk.w + (halo * 2U); ++x)
+              {
+                const int64_t sx = source(static_cast<int64_t>(chunk.x + x) - static_cast<int64_t>(halo), mode);
+                const int64_t sy = source(static_cast<int64_t>(chunk.y + y) - static_cast<int64_t>(halo), mode);
+                const uint16_pixel_type value = (sx < 0 || sy < 0) ?
+                  0U : data[(static_cast<dimension_size_type>(sy) * image_size) + static_cast<dimension_size_type>(sx)];
+                idx[::ome::files::DIM_SPATIAL_X] = static_cast<PixelBuffer<uint16_pixel_type>::indices_type::value_type>(x);
+                idx[::ome::files::DIM_SPATIAL_Y] = static_cast<PixelBuffer<uint16_pixel_type>::indices_type::value_type>(y);
+                ASSERT_EQ(value, pixels.at(idx));
+              }
+        }
+    }
+
+  // Neighbouring chunks share the tiles of their overlapping halos.
+  EXPECT_GT(cache->hits(), 0U);
+
+  VariantPixelBuffer buf;
+  ASSERT_THROW(ome::files::openBytesHalo(reader, 0U, 0U, 0U, buf,
+                                         ome::files::PlaneRegion(500U, 0U, 64U, 64U), halo),
+               std::logic_error);
+}
@@ -0,0 +1,124 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <memory>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/HandleCache.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::VariantPixelBuffer;
+using ome::files::tiff::TIFF;
+
+class HandleCacheTest : public TIFFPixelsTest
+{
+public:
+  HandleCacheTest():
+    TIFFPixelsTest("handlecache")
+  {
+  }
+};
+
+TEST_F(HandleCacheTest, HandleCache)
+{
+  ome::files::tiff::HandleCache cache(2U);
+  EXPECT_EQ(2U, cache.getLimit());
+  const int owner = 0;
+
+  auto get = [&](dimension_size_type f)
+    {
+      const boost::filesystem::path& filename(filenames.at(f));
+      return cache.get(ome::files::tiff::HandleCache::key_type(&owner, filename),
+                       [&filename]() { return TIFF::open(filename, "r"); });
+    };
+
+  // Only the two most recently used idle handles are kept open.
+  for (dimension_size_type r = 0; r < 2U; ++r)
+    for (dimension_size_type f = 0; f < filenames.size(); ++f)
+      {
+        std::shared_ptr<TIFF> tiff = get(f);
+        ASSERT_TRUE(static_cast<bool>(tiff));
+        VariantPixelBuffer plane;
+        ASSERT_NO_THROW(tiff->getDirectoryByIndex(0)->readImage(plane));
+        EXPECT_TRUE(expected.at(f) == plane);
+        EXPECT_GE(2U, cache.count());
+      }
+  EXPECT_EQ(0U, cache.hits());
+  EXPECT_EQ(filenames.size() * 2U, cache.misses());
+  EXPECT_EQ(filenames.size(), cache.reopens());
+  EXPECT_EQ((filenames.size() * 2U) - 2U, cache.evictions());
+
+  std::shared_ptr<TIFF> last = get(filenames.size() - 1U);
+  EXPECT_EQ(1U, cache.hits());
+
+  // Handles in use are not closed.
+  std::shared_ptr<TIFF> first = get(0U);
+  std::shared_ptr<TIFF> second = get(1U);
+  EXPECT_EQ(3U, cache.count());
+  last.reset();
+  cache.setLimit(1U);
+  EXPECT_EQ(2U, cache.count());
+  VariantPixelBuffer plane;
+  ASSERT_NO_THROW(first->getDirectoryByIndex(0)->readImage(plane));
+  EXPECT_TRUE(expected.at(0) == plane);
+
+  cache.resetStatistics();
+  EXPECT_EQ(0U, cache.hits());
+  EXPECT_EQ(0U, cache.misses());
+  EXPECT_EQ(0U, cache.reopens());
+  EXPECT_EQ(0U, cache.evictions());
+
+  first.reset();
+  second.reset();
+  cache.close(&owner);
+  EXPECT_EQ(0U, cache.count());
+
+  // Failure to open is not cached.
+  EXPECT_FALSE(static_cast<bool>(cache.get(ome::files::tiff::HandleCache::key_type(&owner, "invalid"),
+                                           []() { return std::shared_ptr<TIFF>(); })));
+  EXPECT_EQ(0U, cache.count());
+}
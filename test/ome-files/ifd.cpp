@@ -0,0 +1,658 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/Field.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/Tags.h>
+#include <ome/files/tiff/TIFF.h>
+#include <ome/files/tiff/TileInfo.h>
+#include <ome/files/tiff/Types.h>
+
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::VariantPixelBuffer;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+typedef ome::xml::model::enums::PixelType PT;
+
+class IFDTest : public TIFFPixelsTest
+{
+public:
+  IFDTest():
+    TIFFPixelsTest("ifd")
+  {
+  }
+};
+
+TEST_F(IFDTest, RawTileCopy)
+{
+  boost::filesystem::path copyname(datafile("rawcopy.tiff"));
+
+  {
+    std::shared_ptr<TIFF> src = TIFF::open(filenames.at(0), "r");
+    std::shared_ptr<IFD> srcifd = src->getDirectoryByIndex(0);
+
+    std::shared_ptr<TIFF> dest = TIFF::open(copyname, "w");
+    std::shared_ptr<IFD> destifd = dest->getCurrentDirectory();
+    setup_ifd(destifd);
+
+    dimension_size_type tiles = srcifd->getTileInfo().tileCount();
+    ASSERT_EQ(tiles, destifd->getTileInfo().tileCount());
+
+    std::vector<uint8_t> raw;
+    for (dimension_size_type tile = 0; tile < tiles; ++tile)
+      {
+        ASSERT_NO_THROW(srcifd->readRawTile(tile, raw));
+        EXPECT_FALSE(raw.empty());
+        EXPECT_LT(raw.size(), tile_size * tile_size * sizeof(uint16_pixel_type));
+        ASSERT_NO_THROW(destifd->writeRawTile(tile, raw.data(), raw.size()));
+      }
+
+    ASSERT_THROW(srcifd->readRawTile(tiles, raw), ome::files::tiff::Exception);
+
+    dest->writeCurrentDirectory();
+    dest->close();
+  }
+
+  std::shared_ptr<TIFF> copy = TIFF::open(copyname, "r");
+  std::shared_ptr<IFD> copyifd = copy->getDirectoryByIndex(0);
+  VariantPixelBuffer plane;
+  ASSERT_NO_THROW(copyifd->readImage(plane));
+  EXPECT_TRUE(expected.at(0) == plane);
+  copy->close();
+
+  boost::filesystem::remove(copyname);
+}
+
+TEST_F(IFDTest, DirectDecodeStrips)
+{
+  boost::filesystem::path stripname(datafile("strips.tiff"));
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(stripname, "w");
+    std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+    setup_ifd(ifd);
+    ifd->setTileType(ome::files::tiff::STRIP);
+    // Not a divisor of the image height, so the last strip is short.
+    ifd->setTileHeight(7U);
+    ifd->writeImage(expected.at(0));
+    tiff->writeCurrentDirectory();
+    tiff->close();
+  }
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(stripname, "r");
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+
+  // Whole plane: every strip is decoded in place.
+  VariantPixelBuffer plane;
+  ASSERT_NO_THROW(ifd->readImage(plane));
+  EXPECT_TRUE(expected.at(0) == plane);
+
+  // Full-width regions with unaligned starts and heights, partially
+  // covering strips at both ends.
+  const uint16_pixel_type *data = expected.at(0).data<uint16_pixel_type>();
+  const std::vector<std::array<dimension_size_type, 2>> rows{{0U, 1U}, {0U, 7U}, {3U, 30U}, {7U, 14U}, {500U, 12U}};
+  for (const auto& r : rows)
+    {
+      VariantPixelBuffer region;
+      ASSERT_NO_THROW(ifd->readImage(region, 0U, r[0], image_size, r[1]));
+      const uint16_pixel_type *rdata = region.data<uint16_pixel_type>();
+      for (dimension_size_type i = 0; i < image_size * r[1]; ++i)
+        ASSERT_EQ(data[(r[0] * image_size) + i], rdata[i]);
+    }
+
+  tiff->close();
+  boost::filesystem::remove(stripname);
+}
+
+TEST_F(IFDTest, TagSnapshot)
+{
+  boost::filesystem::path multiname(datafile("multi.tiff"));
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(multiname, "w");
+    for (dimension_size_type p = 0; p < 2U; ++p)
+      {
+        std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+        setup_ifd(ifd);
+        if (p == 1U)
+          {
+            ifd->setTileType(ome::files::tiff::STRIP);
+            ifd->setTileHeight(16U);
+          }
+        ifd->writeImage(expected.at(p));
+        tiff->writeCurrentDirectory();
+      }
+    tiff->close();
+  }
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(multiname, "r");
+  std::shared_ptr<IFD> ifd0 = tiff->getDirectoryByIndex(0);
+  std::shared_ptr<IFD> ifd1 = tiff->getDirectoryByIndex(1);
+
+  // Interleave access to both directories; each must report its own
+  // tags and tile layout, whichever directory is current.
+  for (dimension_size_type r = 0; r < 2U; ++r)
+    {
+      EXPECT_EQ(ome::files::tiff::TILE, ifd0->getTileType());
+      EXPECT_EQ(ome::files::tiff::STRIP, ifd1->getTileType());
+      EXPECT_EQ(tile_size, ifd0->getTileHeight());
+      EXPECT_EQ(16U, ifd1->getTileHeight());
+      EXPECT_EQ(PT::UINT16, ifd0->getPixelType());
+      EXPECT_EQ(PT::UINT16, ifd1->getPixelType());
+      EXPECT_EQ(1U, ifd1->getSamplesPerPixel());
+      EXPECT_EQ(ome::files::tiff::CONTIG, ifd0->getPlanarConfiguration());
+
+      EXPECT_EQ(64U, ifd0->getTileInfo().tileCount());
+      EXPECT_EQ(32U, ifd1->getTileInfo().tileCount());
+
+      VariantPixelBuffer plane0, plane1;
+      ASSERT_NO_THROW(ifd1->readImage(plane1));
+      ASSERT_NO_THROW(ifd0->readImage(plane0));
+      EXPECT_TRUE(expected.at(0) == plane0);
+      EXPECT_TRUE(expected.at(1) == plane1);
+    }
+
+  tiff->close();
+  boost::filesystem::remove(multiname);
+}
+
+TEST_F(IFDTest, BatchRead)
+{
+  const std::vector<unsigned int> thread_counts{1U, 4U};
+  std::vector<ome::files::PlaneRegion> regions;
+  regions.push_back(ome::files::PlaneRegion(0U, 0U, image_size, image_size));
+  regions.push_back(ome::files::PlaneRegion(10U, 27U, 300U, 141U));
+  regions.push_back(ome::files::PlaneRegion(20U, 30U, 40U, 50U));
+  regions.push_back(ome::files::PlaneRegion(300U, 400U, 212U, 112U));
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(filenames.at(0), "r");
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+
+  std::vector<VariantPixelBuffer> serial(regions.size());
+  for (std::vector<ome::files::PlaneRegion>::size_type r = 0; r < regions.size(); ++r)
+    ifd->readImage(serial[r], regions[r].x, regions[r].y, regions[r].w, regions[r].h);
+
+  for (auto thread_count : thread_counts)
+    {
+      tiff->setDecodeThreads(thread_count);
+
+      std::vector<VariantPixelBuffer> batch;
+      ASSERT_NO_THROW(ifd->readImages(batch, regions));
+      ASSERT_EQ(regions.size(), batch.size());
+      EXPECT_TRUE(expected.at(0) == batch.at(0));
+      for (std::vector<ome::files::PlaneRegion>::size_type r = 0; r < regions.size(); ++r)
+        EXPECT_TRUE(serial.at(r) == batch.at(r));
+    }
+
+  std::vector<VariantPixelBuffer> empty;
+  ASSERT_NO_THROW(ifd->readImages(empty, std::vector<ome::files::PlaneRegion>()));
+  EXPECT_TRUE(empty.empty());
+
+  tiff->close();
+}
+
+TEST_F(IFDTest, OutOfOrderWrite)
+{
+  boost::filesystem::path name(datafile("outoforder.tiff"));
+  const dimension_size_type tile_bytes = tile_size * tile_size * sizeof(uint16_pixel_type);
+  const std::vector<dimension_size_type> limits{0U, 2U * tile_bytes};
+
+  std::shared_ptr<TIFF> src = TIFF::open(filenames.at(0), "r");
+  std::shared_ptr<IFD> srcifd = src->getDirectoryByIndex(0);
+
+  std::vector<boost::uintmax_t> sizes;
+  for (auto limit : limits)
+    {
+      {
+        std::shared_ptr<TIFF> tiff = TIFF::open(name, "w");
+        tiff->setWriteCacheLimit(limit);
+        EXPECT_EQ(limit, tiff->getWriteCacheLimit());
+        std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+        setup_ifd(ifd);
+
+        // Write the tiles in column-major order.
+        for (dimension_size_type x = 0; x < image_size; x += tile_size)
+          for (dimension_size_type y = 0; y < image_size; y += tile_size)
+            {
+              VariantPixelBuffer tile;
+              srcifd->readImage(tile, x, y, tile_size, tile_size);
+              ASSERT_NO_THROW(ifd->writeImage(tile, x, y, tile_size, tile_size));
+              if (x == 0 && y + tile_size == image_size)
+                sizes.push_back(boost::filesystem::file_size(name));
+            }
+
+        tiff->writeCurrentDirectory();
+        tiff->close();
+      }
+
+      std::shared_ptr<TIFF> tiff = TIFF::open(name, "r");
+      VariantPixelBuffer plane;
+      ASSERT_NO_THROW(tiff->getDirectoryByIndex(0)->readImage(plane));
+      EXPECT_TRUE(expected.at(0) == plane);
+      tiff->close();
+      boost::filesystem::remove(name);
+    }
+
+  // Without a limit, only the first tile of the first column can be
+  // written in order; with a limit, the other completed tiles of the
+  // column are written out of order.
+  ASSERT_EQ(2U, sizes.size());
+  EXPECT_LT(sizes.at(0), sizes.at(1));
+
+  src->close();
+}
+
+TEST_F(IFDTest, SubResolutions)
+{
+  boost::filesystem::path name(datafile("subresolutions.tiff"));
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(name, "w");
+    tiff->setSubResolutions(3U, ome::files::tiff::DOWNSAMPLE_MEAN);
+    EXPECT_EQ(3U, tiff->getSubResolutions());
+    EXPECT_EQ(ome::files::tiff::DOWNSAMPLE_MEAN, tiff->getDownsampling());
+    std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+    setup_ifd(ifd);
+
+    // Write in bands of tile rows.
+    std::shared_ptr<TIFF> src = TIFF::open(filenames.at(0), "r");
+    for (dimension_size_type y = 0; y < image_size; y += tile_size)
+      {
+        VariantPixelBuffer band;
+        src->getDirectoryByIndex(0)->readImage(band, 0U, y, image_size, tile_size);
+        ASSERT_NO_THROW(ifd->writeImage(band, 0U, y, image_size, tile_size));
+      }
+    src->close();
+    tiff->writeCurrentDirectory();
+    tiff->close();
+  }
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(name, "r");
+  ASSERT_EQ(1U, tiff->directoryCount());
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  std::vector<uint64_t> offsets;
+  ASSERT_NO_THROW(ifd->getField(ome::files::tiff::SUBIFD).get(offsets));
+  ASSERT_EQ(3U, offsets.size());
+
+  // Each level is the rounded mean of 2×2 blocks of the last.
+  dimension_size_type size = image_size;
+  const uint16_pixel_type *full = expected.at(0).data<uint16_pixel_type>();
+  std::vector<uint16_pixel_type> previous(full, full + (image_size * image_size));
+  for (const auto offset : offsets)
+    {
+      size /= 2U;
+      std::vector<uint16_pixel_type> level(size * size);
+      for (dimension_size_type y = 0; y < size; ++y)
+        for (dimension_size_type x = 0; x < size; ++x)
+          {
+            dimension_size_type sum = 0;
+            for (dimension_size_type j = 0; j < 2U; ++j)
+              for (dimension_size_type i = 0; i < 2U; ++i)
+                sum += previous[(((y * 2U) + j) * size * 2U) + (x * 2U) + i];
+            level[(y * size) + x] = static_cast<uint16_pixel_type>((sum + 2U) / 4U);
+          }
+
+      std::shared_ptr<IFD> sub;
+      ASSERT_NO_THROW(sub = tiff->getDirectoryByOffset(offset));
+      EXPECT_EQ(size, sub->getImageWidth());
+      EXPECT_EQ(size, sub->getImageHeight());
+      uint32_t subfiletype = 0U;
+      ASSERT_NO_THROW(sub->getField(ome::files::tiff::SUBFILETYPE).get(subfiletype));
+      EXPECT_EQ(1U, subfiletype);
+
+      VariantPixelBuffer plane;
+      ASSERT_NO_THROW(sub->readImage(plane));
+      ASSERT_EQ(level.size(), plane.num_elements());
+      EXPECT_TRUE(std::equal(level.begin(), level.end(), plane.data<uint16_pixel_type>()));
+
+      previous.swap(level);
+    }
+  tiff->close();
+
+  boost::filesystem::remove(name);
+}
+
+TEST_F(IFDTest, NativeTileWrite)
+{
+  boost::filesystem::path name(datafile("nativetile.tiff"));
+
+  {
+    std::shared_ptr<TIFF> src = TIFF::open(filenames.at(0), "r");
+    std::shared_ptr<IFD> srcifd = src->getDirectoryByIndex(0);
+
+    std::shared_ptr<TIFF> dest = TIFF::open(name, "w");
+    std::shared_ptr<IFD> destifd = dest->getCurrentDirectory();
+    setup_ifd(destifd);
+
+    ome::files::tiff::TileInfo info = destifd->getTileInfo();
+    dimension_size_type tiles = info.tileCount();
+
+    VariantPixelBuffer partial;
+    srcifd->readImage(partial, 0U, 0U, tile_size / 2U, tile_size);
+    ASSERT_THROW(destifd->writeTile(0U, partial), ome::files::tiff::Exception);
+
+    // Write the tiles in reverse order.
+    for (dimension_size_type tile = tiles; tile-- > 0;)
+      {
+        ome::files::PlaneRegion region = info.tileRegion(tile);
+        VariantPixelBuffer buf;
+        srcifd->readImage(buf, region.x, region.y, region.w, region.h);
+        ASSERT_NO_THROW(destifd->writeTile(tile, buf));
+      }
+    EXPECT_EQ(tiles, destifd->getCurrentTile());
+
+    VariantPixelBuffer buf;
+    srcifd->readImage(buf, 0U, 0U, tile_size, tile_size);
+    ASSERT_THROW(destifd->writeTile(tiles, buf), ome::files::tiff::Exception);
+
+    dest->writeCurrentDirectory();
+    dest->close();
+    src->close();
+  }
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(name, "r");
+  VariantPixelBuffer plane;
+  ASSERT_NO_THROW(tiff->getDirectoryByIndex(0)->readImage(plane));
+  EXPECT_TRUE(expected.at(0) == plane);
+  tiff->close();
+
+  boost::filesystem::remove(name);
+}
+
+TEST_F(IFDTest, PartialRows)
+{
+  boost::filesystem::path rawname(datafile("uncompressed.tiff"));
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(rawname, "w");
+    for (dimension_size_type p = 0; p < 2U; ++p)
+      {
+        std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+        setup_ifd(ifd);
+        ifd->setCompression(ome::files::tiff::COMPRESSION_NONE);
+        if (p == 1U)
+          {
+            ifd->setTileType(ome::files::tiff::STRIP);
+            ifd->setTileHeight(100U);
+          }
+        ifd->writeImage(expected.at(p));
+        tiff->writeCurrentDirectory();
+      }
+    tiff->close();
+  }
+
+  // Regions covering part of the tiles and strips vertically, read
+  // in place from the mapping and read from the file.
+  const std::vector<std::array<dimension_size_type, 4>> regions{{0U, 0U, 1U, 1U}, {5U, 9U, 100U, 20U}, {70U, 99U, 200U, 3U}, {0U, 450U, 512U, 62U}};
+  for (const auto& mode : {"r", "rm"})
+    {
+      std::shared_ptr<TIFF> tiff = TIFF::open(rawname, mode);
+      uint64_t mapsize = 0U;
+      const uint8_t *map = tiff->getMappedData(mapsize);
+      EXPECT_EQ(tiff->isMapped(), map != nullptr);
+      EXPECT_EQ(tiff->isMapped(), mapsize != 0U);
+
+      for (dimension_size_type p = 0; p < 2U; ++p)
+        {
+          std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(static_cast<ome::files::tiff::directory_index_type>(p));
+          const uint16_pixel_type *data = expected.at(p).data<uint16_pixel_type>();
+          for (const auto& r : regions)
+            {
+              VariantPixelBuffer region;
+              ASSERT_NO_THROW(ifd->readImage(region, r[0], r[1], r[2], r[3]));
+              const uint16_pixel_type *rdata = region.data<uint16_pixel_type>();
+              for (dimension_size_type y = 0; y < r[3]; ++y)
+                for (dimension_size_type x = 0; x < r[2]; ++x)
+                  ASSERT_EQ(data[((r[1] + y) * image_size) + r[0] + x], rdata[(y * r[2]) + x]);
+            }
+        }
+      tiff->close();
+    }
+
+  boost::filesystem::remove(rawname);
+}
+
+TEST_F(IFDTest, TransferSamples)
+{
+  // Sizes which aren't a multiple of the tile size, so that edge
+  // tiles are partly filled.
+  const dimension_size_type width = 100U;
+  const dimension_size_type height = 70U;
+
+  boost::filesystem::path samplesname(datafile("samples.tiff"));
+
+  // One, three and other sample counts use different transfer
+  // kernels, both when reading and writing.
+  for (uint16_t samples = 1U; samples <= 4U; ++samples)
+    for (const auto planarconfig : {ome::files::tiff::CONTIG, ome::files::tiff::SEPARATE})
+      for (const auto tiletype : {ome::files::tiff::TILE, ome::files::tiff::STRIP})
+        {
+          std::array<VariantPixelBuffer::size_type, 9> shape;
+          shape.fill(1U);
+          shape[::ome::files::DIM_SPATIAL_X] = width;
+          shape[::ome::files::DIM_SPATIAL_Y] = height;
+          shape[::ome::files::DIM_SUBCHANNEL] = samples;
+
+          VariantPixelBuffer pixels(shape, PT::UINT16,
+                                    ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC,
+                                                                                    planarconfig == ome::files::tiff::CONTIG));
+          auto& pa(pixels.array<uint16_pixel_type>());
+          for (dimension_size_type y = 0; y < height; ++y)
+            for (dimension_size_type x = 0; x < width; ++x)
+              for (dimension_size_type s = 0; s < samples; ++s)
+                pa[x][y][0][0][0][s][0][0][0] = static_cast<uint16_pixel_type>((s * 10000U) + (y * width) + x);
+
+          {
+            std::shared_ptr<TIFF> tiff = TIFF::open(samplesname, "w");
+            std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+            ifd->setImageWidth(width);
+            ifd->setImageHeight(height);
+            ifd->setTileType(tiletype);
+            ifd->setTileWidth(tiletype == ome::files::tiff::TILE ? 32U : width);
+            ifd->setTileHeight(tiletype == ome::files::tiff::TILE ? 16U : 12U);
+            ifd->setPixelType(PT::UINT16);
+            ifd->setBitsPerSample(16U);
+            ifd->setSamplesPerPixel(samples);
+            ifd->setPlanarConfiguration(planarconfig);
+            ifd->setPhotometricInterpretation(samples == 3U ? ome::files::tiff::RGB : ome::files::tiff::MIN_IS_BLACK);
+            ifd->setCompression(ome::files::tiff::COMPRESSION_NONE);
+            ASSERT_NO_THROW(ifd->writeImage(pixels));
+            tiff->writeCurrentDirectory();
+            tiff->close();
+          }
+
+          std::shared_ptr<TIFF> tiff = TIFF::open(samplesname, "r");
+          std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+
+          // The whole image, whole rows, and a region inside the
+          // tiles or strips.
+          const std::vector<std::array<dimension_size_type, 4>> regions{{0U, 0U, width, height}, {0U, 13U, width, 30U}, {7U, 5U, 61U, 40U}};
+          for (const auto& r : regions)
+            {
+              VariantPixelBuffer region;
+              ASSERT_NO_THROW(ifd->readImage(region, r[0], r[1], r[2], r[3]));
+              ASSERT_EQ(r[2], region.shape()[::ome::files::DIM_SPATIAL_X]);
+              ASSERT_EQ(r[3], region.shape()[::ome::files::DIM_SPATIAL_Y]);
+              ASSERT_EQ(samples, region.shape()[::ome::files::DIM_SUBCHANNEL]);
+
+              const auto& ra(region.array<uint16_pixel_type>());
+              for (dimension_size_type y = 0; y < r[3]; ++y)
+                for (dimension_size_type x = 0; x < r[2]; ++x)
+                  for (dimension_size_type s = 0; s < samples; ++s)
+                    ASSERT_EQ(pa[r[0] + x][r[1] + y][0][0][0][s][0][0][0], ra[x][y][0][0][0][s][0][0][0])
+                      << "samples=" << samples << " planarconfig=" << planarconfig
+                      << " tiletype=" << tiletype << " x=" << x << " y=" << y << " s=" << s;
+            }
+          tiff->close();
+        }
+
+  boost::filesystem::remove(samplesname);
+}
+
+TEST_F(IFDTest, WriteImageRvalue)
+{
+  boost::filesystem::path name(datafile("rvalue.tiff"));
+
+  std::shared_ptr<TIFF> src = TIFF::open(filenames.at(0), "r");
+  std::shared_ptr<IFD> srcifd = src->getDirectoryByIndex(0);
+
+  struct WriteCase
+  {
+    ome::files::tiff::TileType    tiletype;
+    ome::files::tiff::Compression compression;
+    dimension_size_type           band;
+    bool                          direct;
+  };
+
+  // Whole strips written in order are encoded directly from the
+  // buffer; tiles and regions not on strip boundaries are written
+  // via the tile cache.
+  const std::vector<WriteCase> cases
+    {
+      {ome::files::tiff::STRIP, ome::files::tiff::COMPRESSION_NONE, image_size, true},
+      {ome::files::tiff::STRIP, ome::files::tiff::getCodecScheme("Deflate"), 64U, true},
+      {ome::files::tiff::STRIP, ome::files::tiff::COMPRESSION_NONE, 8U, false},
+      {ome::files::tiff::TILE, ome::files::tiff::getCodecScheme("Deflate"), tile_size, false}
+    };
+
+  for (const auto& c : cases)
+    {
+      {
+        std::shared_ptr<TIFF> tiff = TIFF::open(name, "w");
+        std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+        setup_ifd(ifd);
+        ifd->setTileType(c.tiletype);
+        if (c.tiletype == ome::files::tiff::STRIP)
+          {
+            ifd->setTileWidth(image_size);
+            ifd->setTileHeight(16U);
+          }
+        ifd->setCompression(c.compression);
+
+        const dimension_size_type w = (c.tiletype == ome::files::tiff::TILE) ? tile_size : image_size;
+        for (dimension_size_type y = 0; y < image_size; y += c.band)
+          for (dimension_size_type x = 0; x < image_size; x += w)
+            {
+              VariantPixelBuffer band;
+              srcifd->readImage(band, x, y, w, c.band);
+              bool direct = !c.direct;
+              if (c.band == image_size)
+                {
+                  ASSERT_NO_THROW(direct = ifd->writeImage(std::move(band)));
+                }
+              else
+                {
+                  ASSERT_NO_THROW(direct = ifd->writeImage(std::move(band), x, y, w, c.band));
+                }
+              EXPECT_EQ(c.direct, direct)
+                << "tiletype=" << c.tiletype << " band=" << c.band << " x=" << x << " y=" << y;
+            }
+
+        tiff->writeCurrentDirectory();
+        tiff->close();
+      }
+
+      std::shared_ptr<TIFF> tiff = TIFF::open(name, "r");
+      VariantPixelBuffer plane;
+      ASSERT_NO_THROW(tiff->getDirectoryByIndex(0)->readImage(plane));
+      EXPECT_TRUE(expected.at(0) == plane)
+        << "tiletype=" << c.tiletype << " band=" << c.band;
+      tiff->close();
+      boost::filesystem::remove(name);
+    }
+
+  src->close();
+
+  // BIT samples must be packed, so are always written via the tile
+  // cache.
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape.fill(1U);
+  shape[::ome::files::DIM_SPATIAL_X] = image_size;
+  shape[::ome::files::DIM_SPATIAL_Y] = image_size;
+
+  VariantPixelBuffer bits(shape, PT::BIT,
+                          ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+  auto& ba(bits.array<ome::files::PixelProperties<PT::BIT>::std_type>());
+  for (dimension_size_type y = 0; y < image_size; ++y)
+    for (dimension_size_type x = 0; x < image_size; ++x)
+      ba[x][y][0][0][0][0][0][0][0] = ((x * 3U + y) % 5U) == 0U;
+  VariantPixelBuffer bitsexpected(shape, PT::BIT);
+  bitsexpected = bits;
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(name, "w");
+    std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+    setup_ifd(ifd);
+    ifd->setTileType(ome::files::tiff::STRIP);
+    ifd->setTileWidth(image_size);
+    ifd->setTileHeight(16U);
+    ifd->setPixelType(PT::BIT);
+    ifd->setBitsPerSample(1U);
+    ifd->setCompression(ome::files::tiff::COMPRESSION_NONE);
+
+    bool direct = true;
+    ASSERT_NO_THROW(direct = ifd->writeImage(std::move(bits)));
+    EXPECT_FALSE(direct);
+
+    tiff->writeCurrentDirectory();
+    tiff->close();
+  }
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(name, "r");
+  VariantPixelBuffer plane;
+  ASSERT_NO_THROW(tiff->getDirectoryByIndex(0)->readImage(plane));
+  EXPECT_TRUE(bitsexpected == plane);
+  tiff->close();
+  boost::filesystem::remove(name);
+}
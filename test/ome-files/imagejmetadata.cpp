@@ -0,0 +1,141 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <stdexcept>
+#include <string>
+
+#include <ome/files/tiff/ImageJMetadata.h>
+
+#include <ome/test/test.h>
+
+using ome::files::tiff::ImageJMetadata;
+
+namespace
+{
+
+  const std::string description
+  ("ImageJ=1.50i\n"
+   "images=60\n"
+   "channels=3\n"
+   "slices=5\n"
+   "frames=4\n"
+   "hyperstack=true\n"
+   "mode=composite\n"
+   "unit=micron\n"
+   "spacing=0.25\n"
+   "finterval=1.5E-3\n"
+   "loop=false\n"
+   "xorigin=12\n"
+   "yorigin=34\n"
+   "no separator\n"
+   "min=0.0\n"
+   "max=255.0\n"
+   "channels=7\n"
+   "empty=\n");
+
+}
+
+TEST(ImageJMetadata, Defaults)
+{
+  ImageJMetadata m;
+
+  EXPECT_TRUE(m.description.empty());
+  EXPECT_TRUE(m.map.empty());
+  EXPECT_EQ(1U, m.images);
+  EXPECT_EQ(1U, m.slices);
+  EXPECT_EQ(1U, m.frames);
+  EXPECT_EQ(1U, m.channels);
+  EXPECT_FALSE(m.loop);
+}
+
+TEST(ImageJMetadata, ParseDescription)
+{
+  std::map<std::string,std::string> map(ImageJMetadata::parse_imagedescription(description));
+
+  EXPECT_EQ(16U, map.size());
+  EXPECT_EQ(std::string("1.50i"), map.at("ImageJ"));
+  EXPECT_EQ(std::string("3"), map.at("channels"));
+  EXPECT_EQ(std::string(""), map.at("empty"));
+  EXPECT_TRUE(map.find("no separator") == map.end());
+}
+
+TEST(ImageJMetadata, ParseFields)
+{
+  ImageJMetadata m;
+  m.parse(description);
+
+  EXPECT_EQ(description, m.description);
+  EXPECT_EQ(ImageJMetadata::parse_imagedescription(description), m.map);
+  EXPECT_EQ(60U, m.images);
+  EXPECT_EQ(3U, m.channels);
+  EXPECT_EQ(5U, m.slices);
+  EXPECT_EQ(4U, m.frames);
+  EXPECT_EQ(std::string("micron"), m.unit);
+  EXPECT_EQ(0.25, m.spacing);
+  EXPECT_EQ(1.5E-3, m.finterval);
+  EXPECT_EQ(12U, m.xorigin);
+  EXPECT_EQ(34U, m.yorigin);
+  EXPECT_EQ(std::string("composite"), m.mode);
+  EXPECT_FALSE(m.loop);
+}
+
+TEST(ImageJMetadata, ParseNumbers)
+{
+  const char *values[] =
+    {
+      "0", "1", "-2.5", "+3.75", "0.1", "123456.789", "1e10", "2.5E-7",
+      "0.000000000000000000000000001", "12345678901234567890", "1e300"
+    };
+
+  for (const auto& value : values)
+    {
+      ImageJMetadata m;
+      m.parse(std::string("spacing=") + value);
+      EXPECT_EQ(std::stod(value), m.spacing) << value;
+    }
+}
+
+TEST(ImageJMetadata, ParseErrors)
+{
+  ImageJMetadata m;
+
+  EXPECT_THROW(m.parse("slices=many\n"), std::runtime_error);
+  EXPECT_THROW(m.parse("spacing=.\n"), std::runtime_error);
+  EXPECT_THROW(m.parse("loop=maybe\n"), std::runtime_error);
+  EXPECT_NO_THROW(m.parse("unknown=value\n"));
+}
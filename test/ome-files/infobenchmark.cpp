@@ -0,0 +1,126 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <info/Benchmark.h>
+#include <info/options.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+namespace
+{
+
+  const std::string image(PROJECT_SOURCE_DIR "/test/ome-files/data/2010-06-18x24y5z1t2c8b-text.ome.tiff");
+
+  // Get the operation count from a line of benchmark output, or
+  // zero if the operation is not present.
+  unsigned int
+  count(const std::string& output,
+        const std::string& operation)
+  {
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line))
+      {
+        // Operation names are padded to 16 characters.
+        if (line.size() > 16U && line.compare(0U, operation.size(), operation) == 0 &&
+            line.find_first_not_of(' ', operation.size()) >= 16U)
+          {
+            std::istringstream fields(line.substr(16U));
+            unsigned int n = 0U;
+            fields >> n;
+            return n;
+          }
+      }
+    return 0U;
+  }
+
+  std::string
+  run(const info::options& opts)
+  {
+    std::ostringstream output;
+    info::Benchmark(image, opts).run(output);
+    return output.str();
+  }
+
+}
+
+TEST(InfoBenchmark, Counts)
+{
+  info::options opts;
+  opts.iterations = 3U;
+  opts.tiles = 5U;
+  opts.seed = 7U;
+
+  const std::string output(run(opts));
+  EXPECT_NE(std::string::npos, output.find("3 iterations, 5 tiles per iteration, seed 7"));
+  EXPECT_EQ(3U, count(output, "init"));
+  EXPECT_EQ(3U, count(output, "plane read"));
+  EXPECT_EQ(15U, count(output, "tile read"));
+  EXPECT_EQ(3U, count(output, "thumbnail read"));
+}
+
+TEST(InfoBenchmark, NoTiles)
+{
+  info::options opts;
+  opts.iterations = 1U;
+  opts.tiles = 0U;
+
+  const std::string output(run(opts));
+  EXPECT_EQ(1U, count(output, "plane read"));
+  EXPECT_EQ(0U, count(output, "tile read"));
+  EXPECT_EQ(1U, count(output, "thumbnail read"));
+}
+
+TEST(InfoBenchmark, Series)
+{
+  info::options opts;
+  opts.iterations = 1U;
+  opts.tiles = 1U;
+
+  opts.series = 1000U;
+  EXPECT_THROW(run(opts), std::logic_error);
+
+  opts.series = 0U;
+  opts.resolution = 1U;
+  EXPECT_THROW(run(opts), std::logic_error);
+}
@@ -0,0 +1,225 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <info/Catalog.h>
+#include <info/options.h>
+
+#include "tiffpixels.h"
+
+namespace
+{
+
+  const boost::filesystem::path image(PROJECT_SOURCE_DIR "/test/ome-files/data/2010-06-18x24y5z1t2c8b-text.ome.tiff");
+
+  const std::string companion
+  ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+   "<OME xmlns=\"http://www.openmicroscopy.org/Schemas/OME/2016-06\">\n"
+   "  <Image ID=\"Image:0\">\n"
+   "    <Pixels ID=\"Pixels:0\" DimensionOrder=\"XYZCT\" Type=\"uint16\"\n"
+   "            SizeX=\"512\" SizeY=\"256\" SizeZ=\"3\" SizeC=\"2\" SizeT=\"4\">\n"
+   "      <Channel ID=\"Channel:0:0\" SamplesPerPixel=\"1\"/>\n"
+   "      <Channel ID=\"Channel:0:1\" SamplesPerPixel=\"1\"/>\n"
+   "    </Pixels>\n"
+   "  </Image>\n"
+   "</OME>\n");
+
+  void
+  write(const boost::filesystem::path& file,
+        const std::string&             content)
+  {
+    boost::filesystem::ofstream out(file, std::ios::out | std::ios::binary);
+    out << content;
+  }
+
+}
+
+class InfoCatalogTest : public TIFFPixelsTest
+{
+public:
+  boost::filesystem::path dir;
+
+  InfoCatalogTest():
+    TIFFPixelsTest("infocatalog"),
+    dir()
+  {
+  }
+
+  // A directory tree of files of each format, and some which are
+  // ignored or invalid.
+  void
+  SetUp()
+  {
+    TIFFPixelsTest::SetUp();
+
+    dir = datafile("tree");
+    if (boost::filesystem::exists(dir))
+      boost::filesystem::remove_all(dir);
+    boost::filesystem::create_directories(dir / "sub");
+
+    boost::filesystem::copy_file(image, dir / "image.ome.tiff");
+    boost::filesystem::copy_file(filenames.at(0), dir / "plain.tiff");
+    boost::filesystem::copy_file(filenames.at(1), dir / "sub" / "nested.tiff");
+    write(dir / "sub" / "dataset.companion.ome", companion);
+    write(dir / "broken.tiff", std::string("II*\0not a TIFF", 14U));
+    write(dir / "notes.txt", "Not an image\n");
+  }
+
+  void
+  TearDown()
+  {
+    if (boost::filesystem::exists(dir))
+      boost::filesystem::remove_all(dir);
+    TIFFPixelsTest::TearDown();
+  }
+
+  // Run a catalog, and get the sorted output lines.
+  std::vector<std::string>
+  run(info::options& opts)
+  {
+    std::ostringstream output;
+    info::Catalog(opts).run(output);
+
+    std::vector<std::string> lines;
+    std::istringstream in(output.str());
+    std::string line;
+    while (std::getline(in, line))
+      lines.push_back(line);
+    std::sort(lines.begin(), lines.end());
+    return lines;
+  }
+
+  // Find the output line for a file.
+  static std::string
+  find(const std::vector<std::string>& lines,
+       const boost::filesystem::path&  file)
+  {
+    const std::string key(std::string("{\"file\":\"") + file.string() + "\"");
+    for (const auto& line : lines)
+      if (line.compare(0U, key.size(), key) == 0)
+        return line;
+    return std::string();
+  }
+
+  static bool
+  contains(const std::string& line,
+           const std::string& text)
+  {
+    return line.find(text) != std::string::npos;
+  }
+};
+
+TEST_F(InfoCatalogTest, Directory)
+{
+  info::options opts;
+  opts.files.push_back(dir.string());
+  opts.threads = 3U;
+  const std::vector<std::string> lines(run(opts));
+
+  // notes.txt is not an image, and is skipped.
+  EXPECT_EQ(5U, lines.size());
+
+  const std::string ometiff(find(lines, dir / "image.ome.tiff"));
+  EXPECT_TRUE(contains(ometiff, "\"format\":\"OME-TIFF\""));
+  EXPECT_TRUE(contains(ometiff, "\"series\":1"));
+  EXPECT_TRUE(contains(ometiff, "\"sizeX\":18,\"sizeY\":24,\"sizeZ\":5,\"sizeC\":2,\"sizeT\":1"));
+  EXPECT_TRUE(contains(ometiff, "\"type\":\"uint8\""));
+
+  for (const auto& file : {dir / "plain.tiff", dir / "sub" / "nested.tiff"})
+    {
+      const std::string tiff(find(lines, file));
+      EXPECT_TRUE(contains(tiff, "\"format\":\"TIFF\""));
+      EXPECT_TRUE(contains(tiff, "\"directories\":1"));
+      EXPECT_TRUE(contains(tiff, "\"sizeX\":512,\"sizeY\":512,\"samples\":1,\"type\":\"uint16\""));
+    }
+
+  const std::string omexml(find(lines, dir / "sub" / "dataset.companion.ome"));
+  EXPECT_TRUE(contains(omexml, "\"format\":\"OME-TIFF\""));
+  EXPECT_TRUE(contains(omexml, "\"id\":\"Image:0\""));
+  EXPECT_TRUE(contains(omexml, "\"sizeZ\":3,\"sizeC\":2,\"sizeT\":4"));
+  EXPECT_TRUE(contains(omexml, "\"order\":\"XYZCT\""));
+
+  // Errors are reported for the file, without stopping the run.
+  const std::string broken(find(lines, dir / "broken.tiff"));
+  EXPECT_TRUE(contains(broken, "\"error\":"));
+  EXPECT_FALSE(contains(broken, "\"images\":"));
+}
+
+TEST_F(InfoCatalogTest, FileList)
+{
+  const boost::filesystem::path list(datafile("list.txt"));
+  write(list, (dir / "plain.tiff").string() + "\n\n" + image.string() + "\n");
+
+  info::options opts;
+  opts.fileList = list.string();
+  const std::vector<std::string> lines(run(opts));
+  boost::filesystem::remove(list);
+
+  ASSERT_EQ(2U, lines.size());
+  EXPECT_FALSE(find(lines, dir / "plain.tiff").empty());
+  EXPECT_FALSE(find(lines, image).empty());
+}
+
+TEST_F(InfoCatalogTest, Threads)
+{
+  // Only the order of the lines depends upon the thread count.
+  info::options serial;
+  serial.files.push_back(dir.string());
+  serial.threads = 1U;
+
+  info::options parallel;
+  parallel.files.push_back(dir.string());
+  parallel.threads = 8U;
+
+  EXPECT_EQ(run(serial), run(parallel));
+}
+
+TEST_F(InfoCatalogTest, MissingFileList)
+{
+  info::options opts;
+  opts.fileList = datafile("missing.txt").string();
+  EXPECT_THROW(run(opts), std::runtime_error);
+}
@@ -0,0 +1,146 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include <ome/files/PixelProperties.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/OMETIFFReader.h>
+
+#include <info/Checksum.h>
+#include <info/options.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::VariantPixelBuffer;
+using ome::files::in::OMETIFFReader;
+using info::Checksum;
+
+namespace
+{
+
+  const std::string image(PROJECT_SOURCE_DIR "/test/ome-files/data/2010-06-18x24y5z1t2c8b-text.ome.tiff");
+
+  // Run a checksum, and get the output without the timing line.
+  std::vector<std::string>
+  run(unsigned int threads)
+  {
+    info::options opts;
+    opts.threads = threads;
+
+    std::ostringstream output;
+    Checksum(image, opts).run(output);
+
+    std::vector<std::string> ret;
+    std::istringstream lines(output.str());
+    std::string line;
+    while (std::getline(lines, line))
+      if (line.compare(0U, 5U, "Read ") != 0)
+        ret.push_back(line);
+    return ret;
+  }
+
+}
+
+TEST(InfoChecksum, Hash)
+{
+  std::vector<unsigned char> data(37U);
+  for (std::vector<unsigned char>::size_type i = 0; i < data.size(); ++i)
+    data[i] = static_cast<unsigned char>(i * 13U);
+
+  const uint64_t h = Checksum::hash(data.data(), data.size());
+  EXPECT_EQ(h, Checksum::hash(data.data(), data.size()));
+  EXPECT_NE(h, Checksum::hash(data.data(), data.size(), 1U));
+
+  // Every byte contributes, including the partial last word.
+  for (std::vector<unsigned char>::size_type i = 0; i < data.size(); ++i)
+    {
+      std::vector<unsigned char> changed(data);
+      changed[i] ^= 1U;
+      EXPECT_NE(h, Checksum::hash(changed.data(), changed.size()));
+    }
+
+  // Zero padding of the last word is distinguished by the size.
+  const std::vector<unsigned char> zeros(16U, 0U);
+  EXPECT_NE(Checksum::hash(zeros.data(), 3U), Checksum::hash(zeros.data(), 4U));
+  EXPECT_NE(Checksum::hash(zeros.data(), 8U), Checksum::hash(zeros.data(), 16U));
+  EXPECT_NE(Checksum::hash(zeros.data(), 0U), Checksum::hash(zeros.data(), 1U));
+}
+
+TEST(InfoChecksum, Planes)
+{
+  const std::vector<std::string> lines(run(2U));
+
+  // The hash of each plane is that of its pixel data.
+  OMETIFFReader reader;
+  reader.setId(image);
+  std::vector<std::string> expected;
+  for (dimension_size_type s = 0; s < reader.getSeriesCount(); ++s)
+    {
+      reader.setSeries(s);
+      for (dimension_size_type p = 0; p < reader.getImageCount(); ++p)
+        {
+          VariantPixelBuffer buf;
+          reader.openBytes(p, buf);
+          const uint64_t h = Checksum::hash(buf.data(),
+                                            buf.num_elements() * ome::files::bytesPerPixel(buf.pixelType()));
+          expected.push_back((boost::format("Series %1% Plane %2%: %3$016x") % s % p % h).str());
+        }
+    }
+  reader.close();
+
+  ASSERT_EQ(expected.size() + 1U, lines.size());
+  for (std::vector<std::string>::size_type i = 0; i < expected.size(); ++i)
+    EXPECT_EQ(expected[i], lines[i]);
+  EXPECT_EQ(0U, lines.back().find("Aggregate: "));
+}
+
+TEST(InfoChecksum, Threads)
+{
+  // The results don't depend upon the order the planes are read.
+  const std::vector<std::string> serial(run(1U));
+  EXPECT_EQ(serial, run(3U));
+  EXPECT_EQ(serial, run(16U));
+}
@@ -0,0 +1,141 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <ome/files/detail/Interleave.h>
+
+#include <ome/test/test.h>
+
+using ome::files::detail::deinterleaveSamples;
+using ome::files::detail::interleaveSamples;
+
+namespace
+{
+
+  // Fill with distinct byte values.
+  std::vector<uint8_t>
+  make_bytes(std::size_t count)
+  {
+    std::vector<uint8_t> bytes(count);
+    for (std::size_t i = 0; i < count; ++i)
+      bytes[i] = static_cast<uint8_t>((i * 7U) + 3U);
+    return bytes;
+  }
+
+  // Deinterleave and interleave, checking the pixels transposed
+  // against a byte by byte transpose, and that nothing else is
+  // written.  Returns the number of pixels transposed.
+  std::size_t
+  check_transpose(std::size_t samples,
+                  std::size_t size,
+                  std::size_t pixels,
+                  std::size_t ld)
+  {
+    const std::vector<uint8_t> chunky(make_bytes(pixels * samples * size));
+    std::vector<uint8_t> planar(ld * samples * size, 0xEEU);
+    std::vector<uint8_t> expected(planar);
+
+    const std::size_t done = deinterleaveSamples(chunky.data(), planar.data(), ld, pixels, samples, size);
+    EXPECT_GE(pixels, done);
+    for (std::size_t p = 0; p < done; ++p)
+      for (std::size_t k = 0; k < samples; ++k)
+        std::memcpy(&expected[((k * ld) + p) * size], &chunky[((p * samples) + k) * size], size);
+    EXPECT_EQ(expected, planar);
+
+    std::vector<uint8_t> roundtrip(chunky.size(), 0xEEU);
+    std::vector<uint8_t> expected_roundtrip(roundtrip);
+    std::memcpy(expected_roundtrip.data(), chunky.data(), done * samples * size);
+    EXPECT_EQ(done, interleaveSamples(planar.data(), ld, roundtrip.data(), done, samples, size));
+    EXPECT_EQ(expected_roundtrip, roundtrip);
+
+    return done;
+  }
+
+  void
+  check_samples(std::size_t samples,
+                std::size_t size)
+  {
+    // Cover lengths shorter and longer than the SIMD block sizes,
+    // with contiguous and padded planes.
+    for (std::size_t pixels = 0; pixels < 70U; ++pixels)
+      for (std::size_t pad = 0; pad < 6U; pad += 5U)
+        {
+          SCOPED_TRACE(::testing::Message() << "samples=" << samples << " size=" << size
+                       << " pixels=" << pixels << " pad=" << pad);
+          const std::size_t done = check_transpose(samples, size, pixels, pixels + pad);
+          // Whole blocks are transposed, if the sample count and
+          // size are vectorised on this platform.
+          EXPECT_EQ(0U, done % (16U / size));
+          if (done)
+            {
+              EXPECT_GT(16U / size, pixels - done);
+            }
+        }
+  }
+
+}
+
+TEST(Interleave, TwoSamples)
+{
+  for (std::size_t size : {1U, 2U, 4U, 8U})
+    check_samples(2U, size);
+}
+
+TEST(Interleave, ThreeSamples)
+{
+  for (std::size_t size : {1U, 2U, 4U, 8U})
+    check_samples(3U, size);
+}
+
+TEST(Interleave, FourSamples)
+{
+  for (std::size_t size : {1U, 2U, 4U, 8U})
+    check_samples(4U, size);
+}
+
+TEST(Interleave, Unsupported)
+{
+  // Left to the caller.
+  EXPECT_EQ(0U, check_transpose(1U, 1U, 64U, 64U));
+  EXPECT_EQ(0U, check_transpose(5U, 1U, 64U, 64U));
+  EXPECT_EQ(0U, check_transpose(2U, 16U, 64U, 64U));
+  EXPECT_EQ(0U, check_transpose(2U, 3U, 64U, 64U));
+}
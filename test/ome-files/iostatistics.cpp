@@ -0,0 +1,238 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <chrono>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/IOStatistics.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/out/MinimalTIFFWriter.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::CoreMetadata;
+using ome::files::IOStatistics;
+using ome::files::VariantPixelBuffer;
+using ome::files::in::MinimalTIFFReader;
+using ome::files::out::MinimalTIFFWriter;
+using ome::xml::model::enums::PixelType;
+
+TEST(IOStatistics, Construct)
+{
+  IOStatistics stats;
+
+  for (std::size_t i = 0; i < IOStatistics::counter_count; ++i)
+    EXPECT_EQ(0U, stats.getCounter(static_cast<IOStatistics::Counter>(i)));
+  for (std::size_t i = 0; i < IOStatistics::timer_count; ++i)
+    {
+      IOStatistics::Histogram h(stats.getHistogram(static_cast<IOStatistics::Timer>(i)));
+      EXPECT_EQ(0U, h.count);
+      EXPECT_EQ(0U, h.total);
+    }
+}
+
+TEST(IOStatistics, Count)
+{
+  IOStatistics stats;
+
+  stats.add(IOStatistics::BYTES_READ, 100U);
+  stats.add(IOStatistics::BYTES_READ, 28U);
+  stats.add(IOStatistics::TILES_DECODED);
+
+  EXPECT_EQ(128U, stats.getCounter(IOStatistics::BYTES_READ));
+  EXPECT_EQ(1U, stats.getCounter(IOStatistics::TILES_DECODED));
+  EXPECT_EQ(0U, stats.getCounter(IOStatistics::BYTES_WRITTEN));
+}
+
+TEST(IOStatistics, Histogram)
+{
+  IOStatistics stats;
+
+  stats.record(IOStatistics::DECODE, std::chrono::nanoseconds(1));
+  stats.record(IOStatistics::DECODE, std::chrono::nanoseconds(3));
+  stats.record(IOStatistics::DECODE, std::chrono::nanoseconds(1000));
+
+  IOStatistics::Histogram h(stats.getHistogram(IOStatistics::DECODE));
+  EXPECT_EQ(3U, h.count);
+  EXPECT_EQ(1004U, h.total);
+  EXPECT_EQ(1U, h.buckets[0]);
+  EXPECT_EQ(1U, h.buckets[1]);
+  EXPECT_EQ(1U, h.buckets[9]);
+
+  // Overlong durations are clamped to the last bucket.
+  stats.record(IOStatistics::DECODE, std::chrono::hours(24 * 365 * 100));
+  h = stats.getHistogram(IOStatistics::DECODE);
+  EXPECT_EQ(1U, h.buckets[IOStatistics::histogram_buckets - 1]);
+}
+
+TEST(IOStatistics, Lock)
+{
+  IOStatistics stats;
+
+  stats.recordLock(IOStatistics::LOCK_TAG, std::chrono::nanoseconds(0), std::chrono::nanoseconds(6));
+  stats.recordLock(IOStatistics::LOCK_TAG, std::chrono::nanoseconds(4), std::chrono::nanoseconds(10));
+
+  IOStatistics::Histogram wait(stats.getLockWait(IOStatistics::LOCK_TAG));
+  EXPECT_EQ(2U, wait.count);
+  EXPECT_EQ(4U, wait.total);
+  EXPECT_EQ(1U, wait.buckets[0]);
+  EXPECT_EQ(1U, wait.buckets[2]);
+
+  IOStatistics::Histogram hold(stats.getLockHold(IOStatistics::LOCK_TAG));
+  EXPECT_EQ(2U, hold.count);
+  EXPECT_EQ(16U, hold.total);
+
+  EXPECT_EQ(0U, stats.getLockHold(IOStatistics::LOCK_DECODE).count);
+
+  stats.reset();
+  EXPECT_EQ(0U, stats.getLockWait(IOStatistics::LOCK_TAG).count);
+  EXPECT_EQ(0U, stats.getLockHold(IOStatistics::LOCK_TAG).count);
+}
+
+TEST(IOStatistics, Reset)
+{
+  IOStatistics stats;
+
+  stats.add(IOStatistics::FILES_OPENED);
+  stats.record(IOStatistics::OPEN, std::chrono::nanoseconds(50));
+  stats.reset();
+
+  EXPECT_EQ(0U, stats.getCounter(IOStatistics::FILES_OPENED));
+  EXPECT_EQ(0U, stats.getHistogram(IOStatistics::OPEN).count);
+}
+
+TEST(IOStatistics, Names)
+{
+  EXPECT_EQ(std::string("bytes_read"), IOStatistics::name(IOStatistics::BYTES_READ));
+  EXPECT_EQ(std::string("metadata_parsed"), IOStatistics::name(IOStatistics::METADATA_PARSED));
+  EXPECT_EQ(std::string("decode"), IOStatistics::name(IOStatistics::DECODE));
+  EXPECT_EQ(std::string("metadata_parse"), IOStatistics::name(IOStatistics::METADATA_PARSE));
+  EXPECT_EQ(std::string("tag"), IOStatistics::name(IOStatistics::LOCK_TAG));
+  EXPECT_EQ(std::string("encode"), IOStatistics::name(IOStatistics::LOCK_ENCODE));
+}
+
+TEST(IOStatistics, ReadWrite)
+{
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  boost::filesystem::path filename(dir / "iostatistics.tiff");
+
+  std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+  c->sizeX = 64;
+  c->sizeY = 64;
+  c->sizeC.push_back(1);
+  c->pixelType = PixelType::UINT8;
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList{c};
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList);
+  std::shared_ptr<::ome::xml::meta::MetadataRetrieve> retrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = 64;
+  shape[ome::files::DIM_SPATIAL_Y] = 64;
+  shape[ome::files::DIM_SUBCHANNEL] = shape[ome::files::DIM_SPATIAL_Z] =
+    shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] =
+    shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, PixelType::UINT8);
+
+  std::shared_ptr<IOStatistics> wstats;
+  {
+    MinimalTIFFWriter writer;
+    writer.setMetadataRetrieve(retrieve);
+    writer.setTileSizeX(32);
+    writer.setTileSizeY(32);
+    writer.setId(filename);
+    writer.saveBytes(0, buf);
+    writer.close();
+    wstats = writer.getIOStatistics();
+  }
+  ASSERT_TRUE(static_cast<bool>(wstats));
+
+  MinimalTIFFReader reader;
+  reader.setId(filename);
+  VariantPixelBuffer rbuf;
+  reader.openBytes(0, rbuf);
+  std::shared_ptr<IOStatistics> rstats(reader.getIOStatistics());
+  ASSERT_TRUE(static_cast<bool>(rstats));
+
+  if (IOStatistics::enabled())
+    {
+      EXPECT_EQ(1U, wstats->getCounter(IOStatistics::FILES_OPENED));
+      EXPECT_EQ(4U, wstats->getCounter(IOStatistics::TILES_ENCODED));
+      EXPECT_EQ(64U * 64U, wstats->getCounter(IOStatistics::BYTES_WRITTEN));
+      EXPECT_EQ(4U, wstats->getHistogram(IOStatistics::ENCODE).count);
+
+      EXPECT_EQ(1U, rstats->getCounter(IOStatistics::FILES_OPENED));
+      EXPECT_LE(1U, rstats->getCounter(IOStatistics::DIRECTORIES_READ));
+      EXPECT_EQ(4U, rstats->getCounter(IOStatistics::TILES_DECODED));
+      EXPECT_EQ(64U * 64U, rstats->getCounter(IOStatistics::BYTES_READ));
+      EXPECT_EQ(4U, rstats->getHistogram(IOStatistics::DECODE).count);
+      EXPECT_EQ(1U, rstats->getHistogram(IOStatistics::OPEN).count);
+
+      EXPECT_LE(1U, wstats->getLockHold(IOStatistics::LOCK_ENCODE).count);
+      EXPECT_LE(1U, rstats->getLockHold(IOStatistics::LOCK_DECODE).count);
+      EXPECT_LE(1U, rstats->getLockHold(IOStatistics::LOCK_DIRECTORY).count);
+      EXPECT_EQ(rstats->getLockHold(IOStatistics::LOCK_DECODE).count,
+                rstats->getLockWait(IOStatistics::LOCK_DECODE).count);
+    }
+  else
+    {
+      EXPECT_EQ(0U, wstats->getCounter(IOStatistics::BYTES_WRITTEN));
+      EXPECT_EQ(0U, rstats->getCounter(IOStatistics::BYTES_READ));
+    }
+
+  reader.close();
+
+  // Statistics are retained after close.
+  EXPECT_EQ(rstats, reader.getIOStatistics());
+
+  boost::system::error_code ec;
+  boost::filesystem::remove(filename, ec);
+}
@@ -0,0 +1,325 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <ctime>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/common/filesystem.h>
+
+#include <ome/files/ChannelSeparator.h>
+#include <ome/files/FormatException.h>
+#include <ome/files/Memoizer.h>
+#include <ome/files/PixelProperties.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/Memo.h>
+#include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::ChannelSeparator;
+using ome::files::CoreMetadata;
+using ome::files::FormatException;
+using ome::files::FormatReader;
+using ome::files::Memoizer;
+using ome::files::MetadataMap;
+using ome::files::PixelBufferBase;
+using ome::files::PixelProperties;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::MemoReader;
+using ome::files::detail::MemoWriter;
+using ome::files::dimension_size_type;
+using ome::files::in::MinimalTIFFReader;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+typedef ome::xml::model::enums::PixelType PT;
+typedef PixelProperties<PT::UINT16>::std_type uint16_pixel_type;
+
+namespace
+{
+
+  VariantPixelBuffer
+  make_pixels(dimension_size_type size,
+              dimension_size_type seed)
+  {
+    std::array<VariantPixelBuffer::size_type, 9> shape;
+    shape[::ome::files::DIM_SPATIAL_X] = size;
+    shape[::ome::files::DIM_SPATIAL_Y] = size;
+    shape[::ome::files::DIM_SUBCHANNEL] = 1U;
+    shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+      shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+    PixelBufferBase::storage_order_type order
+      (PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+
+    VariantPixelBuffer buf(shape, PT::UINT16, order);
+    uint16_pixel_type *data = buf.data<uint16_pixel_type>();
+    for (dimension_size_type i = 0; i < buf.num_elements(); ++i)
+      data[i] = static_cast<uint16_pixel_type>((i * 7U) + (seed * 1009U));
+    return buf;
+  }
+
+  // Write a series of planes of the given size.
+  void
+  write_planes(TIFF&               tiff,
+               dimension_size_type size,
+               dimension_size_type planes,
+               dimension_size_type seed)
+  {
+    for (dimension_size_type p = 0; p < planes; ++p)
+      {
+        std::shared_ptr<IFD> ifd = tiff.getCurrentDirectory();
+        ifd->setImageWidth(size);
+        ifd->setImageHeight(size);
+        ifd->setTileType(ome::files::tiff::TILE);
+        ifd->setTileWidth(16U);
+        ifd->setTileHeight(16U);
+        ifd->setPixelType(PT::UINT16);
+        ifd->setBitsPerSample(16U);
+        ifd->setSamplesPerPixel(1U);
+        ifd->setPlanarConfiguration(ome::files::tiff::CONTIG);
+        ifd->setPhotometricInterpretation(ome::files::tiff::MIN_IS_BLACK);
+        ifd->writeImage(make_pixels(size, seed + p));
+        tiff.writeCurrentDirectory();
+      }
+  }
+
+  // Write two series: planes of 64×64 followed by a 32×32 plane.
+  void
+  write_file(const boost::filesystem::path& filename,
+             dimension_size_type            planes)
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(filename, "w");
+    write_planes(*tiff, 64U, planes, 0U);
+    write_planes(*tiff, 32U, 1U, planes);
+    tiff->close();
+  }
+
+  // Read every plane of every series.
+  std::vector<VariantPixelBuffer>
+  read_all(const FormatReader& reader)
+  {
+    std::vector<VariantPixelBuffer> ret;
+    for (dimension_size_type s = 0; s < reader.getSeriesCount(); ++s)
+      {
+        reader.setSeries(s);
+        for (dimension_size_type p = 0; p < reader.getImageCount(); ++p)
+          {
+            VariantPixelBuffer buf;
+            reader.openBytes(p, buf);
+            ret.push_back(buf);
+          }
+      }
+    reader.setSeries(0);
+    return ret;
+  }
+
+}
+
+class MemoizerTest : public ::testing::Test
+{
+public:
+  boost::filesystem::path filename;
+  boost::filesystem::path cache;
+
+  MemoizerTest():
+    filename(PROJECT_BINARY_DIR "/test/ome-files/data/memoizer.tiff"),
+    cache(PROJECT_BINARY_DIR "/test/ome-files/data/memoizer-cache")
+  {
+  }
+
+  virtual void
+  SetUp()
+  {
+    boost::filesystem::create_directories(filename.parent_path());
+    boost::filesystem::remove_all(cache);
+    write_file(filename, 3U);
+  }
+
+  virtual void
+  TearDown()
+  {
+    boost::filesystem::remove(filename);
+    boost::filesystem::remove_all(cache);
+  }
+};
+
+TEST(MemoStream, RoundTrip)
+{
+  CoreMetadata core;
+  core.sizeX = 512U;
+  core.sizeY = 256U;
+  core.sizeZ = 3U;
+  core.sizeC.assign({3U, 1U});
+  core.sizeT = 7U;
+  core.pixelType = PT::FLOAT;
+  core.bitsPerPixel = 32U;
+  core.imageCount = 42U;
+  core.moduloT.type = "lifetime";
+  core.moduloT.labels.assign({"a", "b"});
+  core.dimensionOrder = ome::xml::model::enums::DimensionOrder::XYCZT;
+  core.littleEndian = false;
+  core.seriesMetadata.set("Name", std::string("series"));
+  core.seriesMetadata.set("Flags", std::vector<bool>{true, false, true});
+  core.resolutionCount = 2U;
+
+  MetadataMap map;
+  map.set("String", std::string("value"));
+  map.set("Bool", true);
+  map.set("UInt8", static_cast<uint8_t>(200U));
+  map.set("Int64", static_cast<int64_t>(-5));
+  map.set("LongDouble", static_cast<long double>(2.5));
+  map.set("Strings", std::vector<std::string>{"x", "y"});
+  map.set("Doubles", std::vector<double>{1.0, -2.0});
+
+  std::stringstream stream;
+  MemoWriter writer(stream);
+  writer.writeCoreMetadata(core);
+  writer.writeMetadataMap(map);
+
+  MemoReader reader(stream);
+  CoreMetadata rcore;
+  MetadataMap rmap;
+  reader.readCoreMetadata(rcore);
+  reader.readMetadataMap(rmap);
+
+  EXPECT_TRUE(core == rcore);
+  EXPECT_EQ(core.seriesMetadata, rcore.seriesMetadata);
+  EXPECT_EQ(map, rmap);
+  EXPECT_THROW(reader.readUInt(), FormatException);
+
+  // Truncated memo.
+  std::stringstream truncated(stream.str().substr(0U, stream.str().size() / 2U));
+  MemoReader treader(truncated);
+  CoreMetadata tcore;
+  MetadataMap tmap;
+  EXPECT_THROW({ treader.readCoreMetadata(tcore); treader.readMetadataMap(tmap); }, FormatException);
+}
+
+TEST_F(MemoizerTest, SaveRestore)
+{
+  std::vector<std::shared_ptr<CoreMetadata>> core;
+  std::vector<VariantPixelBuffer> pixels;
+  {
+    Memoizer memoizer(std::make_shared<MinimalTIFFReader>(), cache);
+    memoizer.setId(filename);
+    EXPECT_FALSE(memoizer.isLoadedFromMemo());
+    EXPECT_TRUE(memoizer.isSavedToMemo());
+    EXPECT_TRUE(boost::filesystem::exists(memoizer.getMemoFile(ome::common::canonical(filename))));
+    ASSERT_EQ(2U, memoizer.getSeriesCount());
+    for (const auto& c : memoizer.getCoreMetadataList())
+      core.push_back(std::make_shared<CoreMetadata>(*c));
+    pixels = read_all(memoizer);
+  }
+
+  Memoizer memoizer(std::make_shared<MinimalTIFFReader>(), cache);
+  memoizer.setId(filename);
+  EXPECT_TRUE(memoizer.isLoadedFromMemo());
+  EXPECT_FALSE(memoizer.isSavedToMemo());
+
+  const auto& rcore = memoizer.getCoreMetadataList();
+  ASSERT_EQ(core.size(), rcore.size());
+  for (dimension_size_type i = 0; i < core.size(); ++i)
+    EXPECT_TRUE(*core[i] == *rcore[i]);
+
+  const std::vector<VariantPixelBuffer> rpixels(read_all(memoizer));
+  ASSERT_EQ(pixels.size(), rpixels.size());
+  for (dimension_size_type i = 0; i < pixels.size(); ++i)
+    EXPECT_TRUE(pixels[i] == rpixels[i]);
+}
+
+TEST_F(MemoizerTest, Stale)
+{
+  {
+    Memoizer memoizer(std::make_shared<MinimalTIFFReader>(), cache);
+    memoizer.setId(filename);
+    EXPECT_TRUE(memoizer.isSavedToMemo());
+  }
+
+  // Rewrite with a different plane count and modification time.
+  const std::time_t mtime = boost::filesystem::last_write_time(filename);
+  write_file(filename, 5U);
+  boost::filesystem::last_write_time(filename, mtime + 10);
+
+  Memoizer memoizer(std::make_shared<MinimalTIFFReader>(), cache);
+  memoizer.setId(filename);
+  EXPECT_FALSE(memoizer.isLoadedFromMemo());
+  EXPECT_TRUE(memoizer.isSavedToMemo());
+  EXPECT_EQ(5U, memoizer.getImageCount());
+}
+
+TEST_F(MemoizerTest, Settings)
+{
+  {
+    Memoizer memoizer(std::make_shared<MinimalTIFFReader>(), cache);
+    memoizer.setId(filename);
+    EXPECT_TRUE(memoizer.isSavedToMemo());
+  }
+
+  // Saved with different reader settings.
+  std::shared_ptr<MinimalTIFFReader> reader(std::make_shared<MinimalTIFFReader>());
+  reader->setMetadataFiltered(true);
+  Memoizer memoizer(reader, cache);
+  memoizer.setId(filename);
+  EXPECT_FALSE(memoizer.isLoadedFromMemo());
+  EXPECT_TRUE(memoizer.isSavedToMemo());
+  EXPECT_EQ(2U, memoizer.getSeriesCount());
+}
+
+TEST_F(MemoizerTest, NotMemoizable)
+{
+  std::shared_ptr<FormatReader> separator(std::make_shared<ChannelSeparator>(std::make_shared<MinimalTIFFReader>()));
+  Memoizer memoizer(separator, cache);
+  memoizer.setId(filename);
+  EXPECT_FALSE(memoizer.isLoadedFromMemo());
+  EXPECT_FALSE(memoizer.isSavedToMemo());
+  EXPECT_EQ(2U, memoizer.getSeriesCount());
+}
+
+TEST_F(MemoizerTest, NullReader)
+{
+  EXPECT_THROW(Memoizer(std::shared_ptr<FormatReader>(), cache), std::logic_error);
+}
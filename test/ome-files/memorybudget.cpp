@@ -0,0 +1,251 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <ome/files/MemoryBudget.h>
+#include <ome/files/TileBufferPool.h>
+#include <ome/files/TileCache.h>
+
+#include <ome/test/test.h>
+
+using ome::files::MemoryBudget;
+using ome::files::TileBufferPool;
+using ome::files::TileCache;
+using ome::files::dimension_size_type;
+
+TEST(MemoryBudget, Usage)
+{
+  MemoryBudget budget;
+  EXPECT_EQ(0U, budget.getLimit());
+  EXPECT_EQ(0U, budget.getUsage());
+
+  budget.add(MemoryBudget::DECODED_TILE_CACHE, 100U);
+  budget.add(MemoryBudget::WRITE_TILE_CACHE, 50U);
+  EXPECT_EQ(100U, budget.getUsage(MemoryBudget::DECODED_TILE_CACHE));
+  EXPECT_EQ(50U, budget.getUsage(MemoryBudget::WRITE_TILE_CACHE));
+  EXPECT_EQ(150U, budget.getUsage());
+  EXPECT_FALSE(budget.exceeded());
+
+  budget.remove(MemoryBudget::DECODED_TILE_CACHE, 60U);
+  EXPECT_EQ(40U, budget.getUsage(MemoryBudget::DECODED_TILE_CACHE));
+  EXPECT_EQ(100U, budget.getPeakUsage(MemoryBudget::DECODED_TILE_CACHE));
+  budget.resetPeakUsage();
+  EXPECT_EQ(40U, budget.getPeakUsage(MemoryBudget::DECODED_TILE_CACHE));
+
+  budget.setLimit(80U);
+  EXPECT_TRUE(budget.exceeded());
+}
+
+TEST(MemoryBudget, Names)
+{
+  EXPECT_EQ(std::string("tile_buffer_pool"), MemoryBudget::name(MemoryBudget::TILE_BUFFER_POOL));
+  EXPECT_EQ(std::string("decoded_tile_cache"), MemoryBudget::name(MemoryBudget::DECODED_TILE_CACHE));
+  EXPECT_EQ(std::string("write_tile_cache"), MemoryBudget::name(MemoryBudget::WRITE_TILE_CACHE));
+  EXPECT_EQ(std::string("prefetch"), MemoryBudget::name(MemoryBudget::PREFETCH));
+  EXPECT_EQ(std::string("write_queue"), MemoryBudget::name(MemoryBudget::WRITE_QUEUE));
+}
+
+TEST(MemoryBudget, Reclaim)
+{
+  MemoryBudget budget(1000U);
+  std::vector<MemoryBudget::Component> calls;
+
+  dimension_size_type cached = 600U;
+  dimension_size_type pooled = 300U;
+  budget.add(MemoryBudget::DECODED_TILE_CACHE, cached);
+  budget.add(MemoryBudget::TILE_BUFFER_POOL, pooled);
+
+  // Registered out of order; idle buffers are reclaimed first.
+  MemoryBudget::reclaimer_id cacheid =
+    budget.addReclaimer(MemoryBudget::DECODED_TILE_CACHE,
+                        [&](dimension_size_type size)
+                        {
+                          calls.push_back(MemoryBudget::DECODED_TILE_CACHE);
+                          dimension_size_type freed = std::min(size, cached);
+                          cached -= freed;
+                          budget.remove(MemoryBudget::DECODED_TILE_CACHE, freed);
+                          return freed;
+                        });
+  MemoryBudget::reclaimer_id poolid =
+    budget.addReclaimer(MemoryBudget::TILE_BUFFER_POOL,
+                        [&](dimension_size_type size)
+                        {
+                          calls.push_back(MemoryBudget::TILE_BUFFER_POOL);
+                          dimension_size_type freed = std::min(size, pooled);
+                          pooled -= freed;
+                          budget.remove(MemoryBudget::TILE_BUFFER_POOL, freed);
+                          return freed;
+                        });
+
+  // Within budget; nothing reclaimed.
+  budget.reclaim();
+  EXPECT_TRUE(calls.empty());
+
+  // 200 over budget; the pool can free 300.
+  budget.add(MemoryBudget::WRITE_TILE_CACHE, 300U);
+  budget.reclaim();
+  ASSERT_EQ(1U, calls.size());
+  EXPECT_EQ(MemoryBudget::TILE_BUFFER_POOL, calls.at(0));
+  EXPECT_EQ(100U, pooled);
+  EXPECT_EQ(600U, cached);
+
+  // 400 over budget; the pool frees 100 and the cache 300.
+  budget.add(MemoryBudget::WRITE_TILE_CACHE, 400U);
+  calls.clear();
+  budget.reclaim();
+  ASSERT_EQ(2U, calls.size());
+  EXPECT_EQ(MemoryBudget::TILE_BUFFER_POOL, calls.at(0));
+  EXPECT_EQ(MemoryBudget::DECODED_TILE_CACHE, calls.at(1));
+  EXPECT_EQ(0U, pooled);
+  EXPECT_EQ(300U, cached);
+  EXPECT_FALSE(budget.exceeded());
+
+  budget.removeReclaimer(cacheid);
+  budget.removeReclaimer(poolid);
+  budget.add(MemoryBudget::WRITE_TILE_CACHE, 400U);
+  calls.clear();
+  budget.reclaim();
+  EXPECT_TRUE(calls.empty());
+}
+
+TEST(MemoryBudget, TryReserve)
+{
+  MemoryBudget budget(1000U);
+
+  MemoryBudget::Reservation r1(budget.tryReserve(MemoryBudget::PREFETCH, 600U));
+  EXPECT_TRUE(r1.valid());
+  EXPECT_EQ(600U, r1.size());
+  EXPECT_EQ(600U, budget.getUsage(MemoryBudget::PREFETCH));
+
+  MemoryBudget::Reservation r2(budget.tryReserve(MemoryBudget::PREFETCH, 600U));
+  EXPECT_FALSE(r2.valid());
+
+  r1.release();
+  EXPECT_FALSE(r1.valid());
+  EXPECT_EQ(0U, budget.getUsage(MemoryBudget::PREFETCH));
+
+  {
+    MemoryBudget::Reservation r3(budget.tryReserve(MemoryBudget::PREFETCH, 600U));
+    EXPECT_TRUE(r3.valid());
+    MemoryBudget::Reservation moved(std::move(r3));
+    EXPECT_FALSE(r3.valid());
+    EXPECT_EQ(600U, budget.getUsage());
+  }
+  EXPECT_EQ(0U, budget.getUsage());
+}
+
+TEST(MemoryBudget, Reserve)
+{
+  MemoryBudget budget(1000U);
+
+  // Granted when over budget if nothing else is reserved.
+  MemoryBudget::Reservation big(budget.reserve(MemoryBudget::WRITE_QUEUE, 1500U));
+  EXPECT_EQ(1500U, budget.getUsage(MemoryBudget::WRITE_QUEUE));
+
+  // Blocks until the earlier reservation is released.
+  std::atomic<bool> granted(false);
+  std::thread waiter([&]()
+                     {
+                       MemoryBudget::Reservation r(budget.reserve(MemoryBudget::WRITE_QUEUE, 500U));
+                       granted = true;
+                     });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted.load());
+
+  // Reservations of other components are not waited for.
+  MemoryBudget::Reservation other(budget.reserve(MemoryBudget::PREFETCH, 100U));
+  EXPECT_TRUE(other.valid());
+
+  big.release();
+  waiter.join();
+  EXPECT_TRUE(granted.load());
+  EXPECT_EQ(0U, budget.getUsage(MemoryBudget::WRITE_QUEUE));
+}
+
+TEST(MemoryBudget, GlobalTileBufferPool)
+{
+  MemoryBudget& budget(MemoryBudget::global());
+  const dimension_size_type initial = budget.getUsage(MemoryBudget::TILE_BUFFER_POOL);
+
+  std::shared_ptr<TileBufferPool> pool(TileBufferPool::create(1024U * 1024U));
+  pool->acquire(4096U);
+  EXPECT_EQ(4096U, pool->size());
+  EXPECT_EQ(initial + 4096U, budget.getUsage(MemoryBudget::TILE_BUFFER_POOL));
+
+  // Exceeding the limit frees the retained buffers.
+  budget.setLimit(1U);
+  EXPECT_EQ(0U, pool->size());
+  pool->acquire(4096U);
+  EXPECT_EQ(0U, pool->size());
+  budget.setLimit(0U);
+
+  pool->acquire(4096U);
+  EXPECT_EQ(4096U, pool->size());
+  pool.reset();
+  EXPECT_EQ(initial, budget.getUsage(MemoryBudget::TILE_BUFFER_POOL));
+}
+
+TEST(MemoryBudget, GlobalTileCache)
+{
+  MemoryBudget& budget(MemoryBudget::global());
+  const dimension_size_type initial = budget.getUsage(MemoryBudget::WRITE_TILE_CACHE);
+
+  {
+    TileCache cache;
+    cache.acquire(0U, 1024U);
+    cache.acquire(1U, 1024U);
+    EXPECT_EQ(initial + 2048U, budget.getUsage(MemoryBudget::WRITE_TILE_CACHE));
+
+    // Recycled buffers are still held.
+    cache.erase(0U);
+    EXPECT_EQ(initial + 2048U, budget.getUsage(MemoryBudget::WRITE_TILE_CACHE));
+    cache.acquire(2U, 1024U);
+    EXPECT_EQ(initial + 2048U, budget.getUsage(MemoryBudget::WRITE_TILE_CACHE));
+
+    // Buffers beyond the free list limit are no longer held.
+    cache.setFreeLimit(0U);
+    cache.erase(1U);
+    EXPECT_EQ(initial + 1024U, budget.getUsage(MemoryBudget::WRITE_TILE_CACHE));
+  }
+  EXPECT_EQ(initial, budget.getUsage(MemoryBudget::WRITE_TILE_CACHE));
+}
@@ -38,6 +38,7 @@
 
 #include <ome/files/MetadataMap.h>
 
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
@@ -311,6 +312,28 @@ TEST_F(MetadataMapTest, Insert)
   ASSERT_EQ(m.get<int32_t>("int3"), 7823);
 }
 
+TEST_F(MetadataMapTest, InsertRange)
+{
+  std::vector<MetadataMap::map_type::value_type> values;
+  values.push_back(MetadataMap::map_type::value_type("z", int32_t(1)));
+  values.push_back(MetadataMap::map_type::value_type("int1", int32_t(2)));
+  values.push_back(MetadataMap::map_type::value_type("int10", int32_t(3)));
+  values.push_back(MetadataMap::map_type::value_type("a", int32_t(4)));
+  values.push_back(MetadataMap::map_type::value_type("z", int32_t(5)));
+
+  m.insert(values.begin(), values.end());
+
+  // Existing keys are not replaced, and the first duplicate wins.
+  ASSERT_EQ(m.size(), 6U);
+  ASSERT_EQ(m.get<int32_t>("int1"), 82);
+  ASSERT_EQ(m.get<int32_t>("int10"), 3);
+  ASSERT_EQ(m.get<int32_t>("a"), 4);
+  ASSERT_EQ(m.get<int32_t>("z"), 1);
+
+  std::vector<std::string> keys = m.keys();
+  ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
 TEST_F(MetadataMapTest, EraseKey)
 {
   m.erase("int1");
@@ -359,6 +382,26 @@ TEST_F(MetadataMapTest, Merge)
 
 }
 
+TEST_F(MetadataMapTest, MergeInterleaved)
+{
+  MetadataMap m2;
+  m2.set("1", int32_t(12));
+  m2.set("2", int32_t(13));
+  m2.set("3", int32_t(14));
+
+  // Merged keys interleave with and collide with existing keys.
+  m.set("int15", int32_t(1));
+  m.merge(m2, "int");
+  ASSERT_EQ(m.size(), 5U);
+  ASSERT_EQ(m.get<int32_t>("int1"), 82);
+  ASSERT_EQ(m.get<int32_t>("int2"), 272);
+  ASSERT_EQ(m.get<int32_t>("int3"), 14);
+  ASSERT_EQ(m.get<int32_t>("int15"), 1);
+
+  std::vector<std::string> keys = m.keys();
+  ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
 TEST_F(MetadataMapTest, Flatten)
 {
   // Vector flattening with suffix padding.
@@ -36,12 +36,23 @@
  * #L%
  */
 
+#include <exception>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/range/size.hpp>
 
+#include <ome/files/CoreMetadata.h>
 #include <ome/files/FormatException.h>
 #include <ome/files/MetadataTools.h>
+#include <ome/files/tiff/Field.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/Tags.h>
+#include <ome/files/tiff/TIFF.h>
 
 #include <ome/test/test.h>
 #include <ome/test/io.h>
@@ -56,16 +67,21 @@
 #include <ome/xml/version.h>
 #include <ome/xml/OMETransformResolver.h>
 #include <ome/xml/OMETransformResolver.h>
+#include <ome/xml/meta/OMEXMLMetadata.h>
 #include <ome/xml/model/enums/EnumerationException.h>
 
 using boost::filesystem::path;
 using boost::filesystem::directory_iterator;
 using ome::files::dimension_size_type;
+using ome::files::CoreMetadata;
 using ome::files::createID;
 using ome::files::createDimensionOrder;
 using ome::files::createOMEXMLMetadata;
 using ome::files::validateModel;
+using ome::files::validateOMEXML;
+using ome::files::validateOMEXMLStructure;
 using ome::files::FormatException;
+using ome::xml::meta::OMEXMLMetadata;
 using ome::xml::model::enums::DimensionOrder;
 using namespace ome::xml::model::primitives;
 
@@ -117,6 +133,58 @@ TEST(MetadataToolsTest, CreateID4)
   ASSERT_EQ(std::string("Unknown:9:2:4:2"), u3);
 }
 
+TEST(MetadataToolsTest, CreateIDLarge)
+{
+  std::string l1(createID("Image", std::numeric_limits<dimension_size_type>::max()));
+  ASSERT_EQ(std::string("Image:18446744073709551615"), l1);
+
+  std::string l2(createID("Channel", 38400, 10));
+  ASSERT_EQ(std::string("Channel:38400:10"), l2);
+}
+
+TEST(MetadataToolsTest, FillMetadataSeriesList)
+{
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  for (dimension_size_type s = 0; s < 50; ++s)
+    {
+      std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+      c->sizeX = 64;
+      c->sizeY = 32;
+      c->sizeZ = 2;
+      c->sizeT = 3;
+      c->sizeC.clear();
+      c->sizeC.push_back(3);
+      c->sizeC.push_back(1);
+      c->imageCount = 12;
+      c->dimensionOrder = DimensionOrder::XYZCT;
+      seriesList.push_back(c);
+    }
+
+  std::shared_ptr<OMEXMLMetadata> meta(std::make_shared<OMEXMLMetadata>());
+  ASSERT_NO_THROW(ome::files::fillMetadata(*meta, seriesList, true));
+
+  ASSERT_EQ(50U, meta->getImageCount());
+  for (dimension_size_type s = 0; s < 50; ++s)
+    {
+      EXPECT_EQ(createID("Image", s), meta->getImageID(s));
+      EXPECT_EQ(createID("Pixels", s), meta->getPixelsID(s));
+      EXPECT_EQ(4U, static_cast<dimension_size_type>(meta->getPixelsSizeC(s)));
+      ASSERT_EQ(2U, meta->getChannelCount(s));
+      for (dimension_size_type c = 0; c < 2; ++c)
+        EXPECT_EQ(createID("Channel", s, c), meta->getChannelID(s, c));
+      EXPECT_EQ(3U, static_cast<dimension_size_type>(meta->getChannelSamplesPerPixel(s, 0)));
+      EXPECT_EQ(1U, static_cast<dimension_size_type>(meta->getChannelSamplesPerPixel(s, 1)));
+
+      ASSERT_EQ(12U, meta->getPlaneCount(s));
+      for (dimension_size_type p = 0; p < 12; ++p)
+        {
+          EXPECT_EQ(p % 2, static_cast<dimension_size_type>(meta->getPlaneTheZ(s, p)));
+          EXPECT_EQ((p / 2) % 2, static_cast<dimension_size_type>(meta->getPlaneTheC(s, p)));
+          EXPECT_EQ(p / 4, static_cast<dimension_size_type>(meta->getPlaneTheT(s, p)));
+        }
+    }
+}
+
 TEST(MetadataToolsTest, CurrentModelVersion)
 {
   ASSERT_EQ(std::string(OME_XML_MODEL_VERSION), ome::files::getModelVersion());
@@ -146,6 +214,186 @@ TEST(MetadataToolsTest, ModelVersionFromDocument)
   ASSERT_EQ(std::string("2013-06"), ome::files::getModelVersion(doc));
 }
 
+TEST(MetadataToolsTest, PreloadThenUpgrade)
+{
+  ASSERT_NO_THROW(ome::files::preloadOMEXML());
+  ASSERT_NO_THROW(ome::files::preloadOMEXML());
+
+  std::string xml;
+  boost::filesystem::path sample_path(ome::common::module_runtime_path("ome-xml-sample"));
+
+  readFile(sample_path / "2012-06/multi-channel-z-series-time-series.ome.xml", xml);
+  std::string upgraded(ome::files::transformToLatestModelVersion(xml));
+  ASSERT_EQ(std::string(OME_XML_MODEL_VERSION), ome::files::getModelVersion(upgraded));
+}
+
+TEST(MetadataToolsTest, UpgradeRepeatedAndConcurrent)
+{
+  std::string xml;
+  {
+    std::shared_ptr<ome::files::tiff::TIFF> tiff =
+      ome::files::tiff::TIFF::open(PROJECT_SOURCE_DIR "/test/ome-files/data/2010-06-18x24y5z1t2c8b-text.ome.tiff", "r");
+    tiff->getDirectoryByIndex(0)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(xml);
+    tiff->close();
+  }
+  ASSERT_EQ(std::string("2010-06"), ome::files::getModelVersion(xml));
+
+  // The upgrade and metadata from a single upgrade on a new thread,
+  // with newly created resolvers.
+  std::string reference;
+  std::string referencemeta;
+  std::exception_ptr error;
+  std::thread fresh([&]()
+    {
+      try
+        {
+          reference = ome::files::transformToLatestModelVersion(xml);
+          referencemeta = createOMEXMLMetadata(xml)->dumpXML();
+        }
+      catch (...)
+        {
+          error = std::current_exception();
+        }
+    });
+  fresh.join();
+  if (error)
+    std::rethrow_exception(error);
+  ASSERT_EQ(std::string(OME_XML_MODEL_VERSION), ome::files::getModelVersion(reference));
+
+  // Repeated upgrades on one thread reuse its resolvers.
+  for (int i = 0; i < 2; ++i)
+    {
+      EXPECT_EQ(reference, ome::files::transformToLatestModelVersion(xml));
+      EXPECT_EQ(referencemeta, createOMEXMLMetadata(xml)->dumpXML());
+    }
+
+  // Concurrent upgrades use separate resolvers on each thread.
+  const unsigned int thread_count = 2U;
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(thread_count);
+  std::vector<std::string> upgraded(thread_count);
+  std::vector<std::string> meta(thread_count);
+  for (unsigned int t = 0; t < thread_count; ++t)
+    {
+      threads.push_back(std::thread([&, t]()
+        {
+          try
+            {
+              upgraded[t] = ome::files::transformToLatestModelVersion(xml);
+              meta[t] = createOMEXMLMetadata(xml)->dumpXML();
+            }
+          catch (...)
+            {
+              errors[t] = std::current_exception();
+            }
+        }));
+    }
+  for (auto& thread : threads)
+    thread.join();
+
+  for (unsigned int t = 0; t < thread_count; ++t)
+    {
+      if (errors[t])
+        std::rethrow_exception(errors[t]);
+      EXPECT_EQ(reference, upgraded[t]);
+      EXPECT_EQ(referencemeta, meta[t]);
+    }
+}
+
+namespace
+{
+
+  std::string
+  structure_document(const std::string& pixels,
+                     const std::string& channels)
+  {
+    return std::string
+      ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+       "<OME xmlns=\"http://www.openmicroscopy.org/Schemas/OME/2016-06\">\n"
+       "  <Image ID=\"Image:0\">\n"
+       "    <Pixels ID=\"Pixels:0\" ") + pixels + ">\n" + channels +
+      "      <TiffData IFD=\"0\" PlaneCount=\"6\"/>\n"
+      "    </Pixels>\n"
+      "  </Image>\n"
+      "</OME>\n";
+  }
+
+}
+
+TEST(MetadataToolsTest, ValidateOMEXMLStructure)
+{
+  const std::string pixels("DimensionOrder=\"XYZCT\" Type=\"uint16\" "
+                           "SizeX=\"16\" SizeY=\"8\" SizeZ=\"3\" SizeC=\"2\" SizeT=\"1\"");
+  const std::string channels("      <Channel ID=\"Channel:0:0\"/>\n"
+                             "      <Channel ID=\"Channel:0:1\"/>\n");
+
+  EXPECT_TRUE(validateOMEXMLStructure(structure_document(pixels, channels)));
+  EXPECT_TRUE(validateOMEXML(structure_document(pixels, channels),
+                             ome::files::OMEXML_VALIDATE_STRUCTURE));
+
+  // Missing channels.
+  EXPECT_FALSE(validateOMEXMLStructure(structure_document(pixels, "")));
+  // Too many channels.
+  EXPECT_FALSE(validateOMEXMLStructure(structure_document(pixels, channels + channels + channels)));
+  // Invalid dimension order and pixel type.
+  EXPECT_FALSE(validateOMEXMLStructure(structure_document("DimensionOrder=\"XYZZT\" Type=\"uint16\" "
+                                                          "SizeX=\"16\" SizeY=\"8\" SizeZ=\"3\" SizeC=\"2\" SizeT=\"1\"",
+                                                          channels)));
+  EXPECT_FALSE(validateOMEXMLStructure(structure_document("DimensionOrder=\"XYZCT\" Type=\"uint17\" "
+                                                          "SizeX=\"16\" SizeY=\"8\" SizeZ=\"3\" SizeC=\"2\" SizeT=\"1\"",
+                                                          channels)));
+  // Zero size.
+  EXPECT_FALSE(validateOMEXMLStructure(structure_document("DimensionOrder=\"XYZCT\" Type=\"uint16\" "
+                                                          "SizeX=\"0\" SizeY=\"8\" SizeZ=\"3\" SizeC=\"2\" SizeT=\"1\"",
+                                                          channels)));
+  // Not OME-XML.
+  EXPECT_FALSE(validateOMEXMLStructure("<Image ID=\"Image:0\"/>"));
+
+  // Not validated.
+  EXPECT_TRUE(validateOMEXML("<Image ID=\"Image:0\"/>", ome::files::OMEXML_VALIDATE_NONE));
+}
+
+TEST(MetadataToolsTest, BinaryPlateRoundTrip)
+{
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  for (dimension_size_type s = 0; s < 96; ++s)
+    {
+      std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+      c->sizeX = 512;
+      c->sizeY = 512;
+      c->sizeZ = 4;
+      c->sizeT = 2;
+      c->sizeC.clear();
+      c->sizeC.push_back(1);
+      c->sizeC.push_back(1);
+      c->imageCount = 16;
+      seriesList.push_back(c);
+    }
+
+  std::shared_ptr<OMEXMLMetadata> meta(std::make_shared<OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList, true);
+  const std::string xml(meta->dumpXML());
+
+  const std::string binary(getBinaryOMEXML(*meta));
+  EXPECT_LT(binary.size() * 2U, xml.size());
+
+  std::shared_ptr<OMEXMLMetadata> restored(createOMEXMLMetadataFromBinary(binary));
+  ASSERT_EQ(96U, restored->getImageCount());
+  EXPECT_EQ(16U, restored->getPlaneCount(95));
+  EXPECT_EQ(xml, restored->dumpXML());
+}
+
+TEST(MetadataToolsTest, BinaryInvalid)
+{
+  std::shared_ptr<OMEXMLMetadata> meta(std::make_shared<OMEXMLMetadata>());
+  const std::string binary(getBinaryOMEXML(*meta));
+
+  EXPECT_THROW(createOMEXMLMetadataFromBinary(""), FormatException);
+  EXPECT_THROW(createOMEXMLMetadataFromBinary("<OME/>"), FormatException);
+  EXPECT_THROW(createOMEXMLMetadataFromBinary(binary.substr(0, binary.size() - 1)), FormatException);
+  EXPECT_THROW(createOMEXMLMetadataFromBinary(binary + '\x01'), FormatException);
+}
+
 TEST(MetadataToolsTest, CreateDimensionOrder)
 {
   EXPECT_EQ(DimensionOrder::XYZTC, createDimensionOrder(""));
@@ -669,6 +917,23 @@ TEST_P(ModelTest, CreateMetadataFromString)
   ASSERT_NO_THROW(meta = createOMEXMLMetadata(input));
 }
 
+TEST_P(ModelTest, BinaryRoundTrip)
+{
+  const ModelTestParameters& params = GetParam();
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta;
+  ASSERT_NO_THROW(meta = createOMEXMLMetadata(params.file));
+  const std::string xml(meta->dumpXML());
+
+  std::string binary;
+  ASSERT_NO_THROW(binary = getBinaryOMEXML(*meta));
+  EXPECT_LT(binary.size(), xml.size());
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> restored;
+  ASSERT_NO_THROW(restored = createOMEXMLMetadataFromBinary(binary));
+  EXPECT_EQ(xml, restored->dumpXML());
+}
+
 // Disable missing-prototypes warning for INSTANTIATE_TEST_CASE_P;
 // this is solely to work around a missing prototype in gtest.
 #ifdef __GNUC__
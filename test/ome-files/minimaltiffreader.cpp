@@ -36,17 +36,36 @@
  * #L%
  */
 
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <stdexcept>
 #include <vector>
 
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/PlaneRegion.h>
 #include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
 #include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/tiff/Field.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/Tags.h>
+#include <ome/files/tiff/TIFF.h>
+#include <ome/files/tiff/Types.h>
 
 #include <ome/test/test.h>
 
+#include "tiffpixels.h"
+
 using ome::files::dimension_size_type;
+using ome::files::PlaneRegion;
 using ome::files::VariantPixelBuffer;
+using ome::files::VariantPixelBufferView;
 using ome::files::in::MinimalTIFFReader;
+typedef ome::xml::model::enums::PixelType PT;
 
 class TIFFTestParameters
 {
@@ -147,6 +166,605 @@ TEST_P(TIFFTest, openBytes)
     }
 }
 
+TEST_P(TIFFTest, LazyDirectories)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  ASSERT_NO_THROW(tiff.setId(params.file));
+
+  MinimalTIFFReader lazy;
+  EXPECT_FALSE(lazy.getLazyDirectories());
+  lazy.setLazyDirectories(true);
+  EXPECT_TRUE(lazy.getLazyDirectories());
+  ASSERT_NO_THROW(lazy.setId(params.file));
+
+  // All the IFDs match, so the series are identical.
+  ASSERT_EQ(tiff.getSeriesCount(), lazy.getSeriesCount());
+  EXPECT_EQ(params.sizeT, lazy.getSizeT());
+  EXPECT_EQ(tiff.getSizeX(), lazy.getSizeX());
+  EXPECT_EQ(tiff.getSizeY(), lazy.getSizeY());
+  EXPECT_EQ(tiff.getPixelType(), lazy.getPixelType());
+  ASSERT_EQ(tiff.getImageCount(), lazy.getImageCount());
+
+  // Planes are read in reverse, so later IFDs are checked first.
+  for (dimension_size_type p = lazy.getImageCount(); p > 0; --p)
+    {
+      VariantPixelBuffer expected;
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(tiff.openBytes(p - 1, expected));
+      ASSERT_NO_THROW(lazy.openBytes(p - 1, buf));
+      EXPECT_TRUE(expected == buf);
+    }
+}
+
+TEST(MinimalTIFFReaderLazy, MismatchedDirectories)
+{
+  using namespace ome::files::tiff;
+  using ome::xml::model::enums::PixelType;
+
+  boost::filesystem::path filename(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!boost::filesystem::exists(filename) && !boost::filesystem::create_directories(filename))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  filename /= "lazy-mismatch.tiff";
+
+  // Two IFDs of differing size.
+  {
+    std::shared_ptr<TIFF> wtiff(TIFF::open(filename, "w"));
+    for (uint32_t size = 8U; size <= 16U; size += 8U)
+      {
+        std::shared_ptr<IFD> wifd(wtiff->getCurrentDirectory());
+        wifd->setImageWidth(size);
+        wifd->setImageHeight(size);
+        wifd->setTileType(STRIP);
+        wifd->setTileWidth(size);
+        wifd->setTileHeight(size);
+        wifd->setPixelType(PixelType::UINT8);
+        wifd->setBitsPerSample(8U);
+        wifd->setSamplesPerPixel(1U);
+        wifd->setPlanarConfiguration(CONTIG);
+        wifd->setPhotometricInterpretation(MIN_IS_BLACK);
+
+        std::array<VariantPixelBuffer::size_type, 9> shape;
+        shape[ome::files::DIM_SPATIAL_X] = size;
+        shape[ome::files::DIM_SPATIAL_Y] = size;
+        shape[ome::files::DIM_SUBCHANNEL] = shape[ome::files::DIM_SPATIAL_Z] =
+          shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+          shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] =
+          shape[ome::files::DIM_MODULO_C] = 1;
+        VariantPixelBuffer buf(shape, PixelType::UINT8);
+        wifd->writeImage(buf);
+        wtiff->writeCurrentDirectory();
+      }
+    wtiff->close();
+  }
+
+  MinimalTIFFReader full;
+  ASSERT_NO_THROW(full.setId(filename));
+  EXPECT_EQ(2U, full.getSeriesCount());
+
+  // Lazily, the second IFD is assumed to be a second timepoint, and
+  // is rejected when read.
+  MinimalTIFFReader lazy;
+  lazy.setLazyDirectories(true);
+  ASSERT_NO_THROW(lazy.setId(filename));
+  EXPECT_EQ(1U, lazy.getSeriesCount());
+  EXPECT_EQ(2U, lazy.getImageCount());
+
+  VariantPixelBuffer buf;
+  EXPECT_NO_THROW(lazy.openBytes(0U, buf));
+  EXPECT_THROW(lazy.openBytes(1U, buf), ome::files::FormatException);
+}
+
+TEST(MinimalTIFFReaderSeries, Grouping)
+{
+  using namespace ome::files::tiff;
+  using ome::xml::model::enums::PixelType;
+
+  boost::filesystem::path filename(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!boost::filesystem::exists(filename) && !boost::filesystem::create_directories(filename))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  filename /= "series-grouping.tiff";
+
+  struct Directory
+  {
+    uint32_t width;
+    uint32_t height;
+    PixelType pixeltype;
+    uint16_t bits;
+    uint16_t samples;
+    PlanarConfiguration planarconfig;
+    PhotometricInterpretation photometric;
+  };
+
+  // Each change of a series property starts a new series, and only
+  // adjacent IFDs are grouped.
+  const std::vector<Directory> directories
+    {
+      {8U, 8U, PixelType::UINT8, 8U, 1U, CONTIG, MIN_IS_BLACK},
+      {8U, 8U, PixelType::UINT8, 8U, 1U, CONTIG, MIN_IS_BLACK},
+      {8U, 8U, PixelType::UINT8, 8U, 1U, CONTIG, MIN_IS_WHITE},
+      {8U, 8U, PixelType::UINT16, 16U, 1U, CONTIG, MIN_IS_BLACK},
+      {8U, 8U, PixelType::UINT8, 8U, 3U, CONTIG, RGB},
+      {8U, 8U, PixelType::UINT8, 8U, 3U, SEPARATE, RGB},
+      {8U, 8U, PixelType::UINT8, 8U, 3U, SEPARATE, RGB},
+      {16U, 8U, PixelType::UINT8, 8U, 1U, CONTIG, MIN_IS_BLACK},
+      {8U, 8U, PixelType::UINT8, 8U, 1U, CONTIG, MIN_IS_BLACK}
+    };
+  const std::vector<dimension_size_type> expectedSizeT{2U, 1U, 1U, 1U, 2U, 1U, 1U};
+
+  {
+    std::shared_ptr<TIFF> wtiff(TIFF::open(filename, "w"));
+    for (dimension_size_type d = 0; d < directories.size(); ++d)
+      {
+        const Directory& dir(directories.at(d));
+        std::shared_ptr<IFD> wifd(wtiff->getCurrentDirectory());
+        wifd->setImageWidth(dir.width);
+        wifd->setImageHeight(dir.height);
+        wifd->setTileType(STRIP);
+        wifd->setTileWidth(dir.width);
+        wifd->setTileHeight(dir.height);
+        wifd->setPixelType(dir.pixeltype);
+        wifd->setBitsPerSample(dir.bits);
+        wifd->setSamplesPerPixel(dir.samples);
+        wifd->setPlanarConfiguration(dir.planarconfig);
+        wifd->setPhotometricInterpretation(dir.photometric);
+
+        std::array<VariantPixelBuffer::size_type, 9> shape;
+        shape[ome::files::DIM_SPATIAL_X] = dir.width;
+        shape[ome::files::DIM_SPATIAL_Y] = dir.height;
+        shape[ome::files::DIM_SUBCHANNEL] = dir.samples;
+        shape[ome::files::DIM_SPATIAL_Z] =
+          shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+          shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] =
+          shape[ome::files::DIM_MODULO_C] = 1;
+        VariantPixelBuffer buf(shape, dir.pixeltype,
+                               ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC,
+                                                                               dir.planarconfig == CONTIG));
+        if (dir.pixeltype == PixelType::UINT8)
+          std::fill(buf.data<uint8_t>(), buf.data<uint8_t>() + buf.num_elements(), static_cast<uint8_t>(d));
+        else
+          std::fill(buf.data<uint16_t>(), buf.data<uint16_t>() + buf.num_elements(), static_cast<uint16_t>(d));
+        wifd->writeImage(buf);
+        wtiff->writeCurrentDirectory();
+      }
+    wtiff->close();
+  }
+
+  MinimalTIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(filename));
+  ASSERT_EQ(expectedSizeT.size(), reader.getSeriesCount());
+
+  dimension_size_type d = 0U;
+  for (dimension_size_type s = 0; s < reader.getSeriesCount(); ++s)
+    {
+      reader.setSeries(s);
+      const Directory& dir(directories.at(d));
+      EXPECT_EQ(expectedSizeT.at(s), reader.getSizeT());
+      EXPECT_EQ(expectedSizeT.at(s), reader.getImageCount());
+      EXPECT_EQ(dir.width, reader.getSizeX());
+      EXPECT_EQ(dir.pixeltype, reader.getPixelType());
+      EXPECT_EQ(dir.samples, reader.getRGBChannelCount(0U));
+
+      // Each plane is read from the next IFD in order.
+      for (dimension_size_type p = 0; p < reader.getImageCount(); ++p, ++d)
+        {
+          VariantPixelBuffer buf;
+          ASSERT_NO_THROW(reader.openBytes(p, buf));
+          if (dir.pixeltype == PixelType::UINT8)
+            EXPECT_EQ(d, buf.data<uint8_t>()[0]);
+          else
+            EXPECT_EQ(d, buf.data<uint16_t>()[0]);
+        }
+    }
+  EXPECT_EQ(directories.size(), d);
+}
+
+TEST(MinimalTIFFReaderNormalized, Float)
+{
+  using namespace ome::files::tiff;
+  using ome::xml::model::enums::PixelType;
+
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!boost::filesystem::exists(dir) && !boost::filesystem::create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  const boost::filesystem::path summarised(dir / "normalized-float.tiff");
+  const boost::filesystem::path plain(dir / "normalized-float-plain.tiff");
+
+  // 4×4 tiles of values from -100 to 3995, with one NaN.
+  const uint32_t size = 64U;
+  const uint32_t tilesize = 16U;
+  for (const auto& file : {std::make_pair(summarised, true),
+                           std::make_pair(plain, false)})
+    {
+      std::shared_ptr<TIFF> wtiff(TIFF::open(file.first, "w"));
+      wtiff->setTileSummaries(file.second);
+      std::shared_ptr<IFD> wifd(wtiff->getCurrentDirectory());
+      wifd->setImageWidth(size);
+      wifd->setImageHeight(size);
+      wifd->setTileType(TILE);
+      wifd->setTileWidth(tilesize);
+      wifd->setTileHeight(tilesize);
+      wifd->setPixelType(PixelType::FLOAT);
+      wifd->setBitsPerSample(32U);
+      wifd->setSamplesPerPixel(1U);
+      wifd->setPlanarConfiguration(CONTIG);
+      wifd->setPhotometricInterpretation(MIN_IS_BLACK);
+
+      std::array<VariantPixelBuffer::size_type, 9> shape;
+      shape[ome::files::DIM_SPATIAL_X] = size;
+      shape[ome::files::DIM_SPATIAL_Y] = size;
+      shape[ome::files::DIM_SUBCHANNEL] = shape[ome::files::DIM_SPATIAL_Z] =
+        shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+        shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] =
+        shape[ome::files::DIM_MODULO_C] = 1;
+      VariantPixelBuffer buf(shape, PixelType::FLOAT);
+      float *data = buf.data<float>();
+      for (uint32_t i = 0; i < size * size; ++i)
+        data[i] = static_cast<float>(i) - 100.0f;
+      data[1] = std::numeric_limits<float>::quiet_NaN();
+      wifd->writeImage(buf);
+      wtiff->writeCurrentDirectory();
+      wtiff->close();
+    }
+
+  // Each tile, an unaligned region and a view of it, read
+  // separately and in a batch, match the whole plane.
+  std::vector<PlaneRegion> regions;
+  for (uint32_t y = 0; y < size; y += tilesize)
+    for (uint32_t x = 0; x < size; x += tilesize)
+      regions.push_back(PlaneRegion(x, y, tilesize, tilesize));
+  regions.push_back(PlaneRegion(5U, 9U, 37U, 22U));
+
+  auto expect_region = [&](const VariantPixelBuffer& whole,
+                           const PlaneRegion&        region,
+                           const float              *data,
+                           dimension_size_type       pitch)
+    {
+      const float *plane = whole.data<float>();
+      for (dimension_size_type y = 0; y < region.h; ++y)
+        for (dimension_size_type x = 0; x < region.w; ++x)
+          {
+            const float expected = plane[((region.y + y) * size) + region.x + x];
+            const float value = data[(y * pitch) + x];
+            ASSERT_TRUE(value == expected || (value != value && expected != expected));
+          }
+    };
+
+  auto expect_regions = [&](const MinimalTIFFReader& reader,
+                            const VariantPixelBuffer& whole)
+    {
+      for (const auto& region : regions)
+        {
+          VariantPixelBuffer buf;
+          ASSERT_NO_THROW(reader.openBytes(0U, buf, region.x, region.y, region.w, region.h));
+          expect_region(whole, region, buf.data<float>(), region.w);
+        }
+
+      std::vector<VariantPixelBuffer> bufs;
+      ASSERT_NO_THROW(reader.openBytesBatch(0U, regions, bufs));
+      ASSERT_EQ(regions.size(), bufs.size());
+      for (std::vector<PlaneRegion>::size_type r = 0; r < regions.size(); ++r)
+        expect_region(whole, regions[r], bufs[r].data<float>(), regions[r].w);
+
+      const PlaneRegion& region(regions.back());
+      const dimension_size_type pitch = 40U;
+      std::vector<float> memory(pitch * region.h);
+      VariantPixelBufferView view(memory.data(), PixelType::FLOAT,
+                                  region.w, region.h, 1U,
+                                  sizeof(float), pitch * sizeof(float), sizeof(float));
+      ASSERT_NO_THROW(reader.openBytesInto(0U, 0U, 0U, view, region));
+      expect_region(whole, region, memory.data(), pitch);
+    };
+
+  // With tile summaries, the range of the plane is used.
+  {
+    MinimalTIFFReader reader;
+    reader.setNormalized(true);
+    ASSERT_NO_THROW(reader.setId(summarised));
+
+    VariantPixelBuffer whole;
+    ASSERT_NO_THROW(reader.openBytes(0U, whole));
+    const float *data = whole.data<float>();
+    EXPECT_FLOAT_EQ(0.0f, data[0]);
+    EXPECT_TRUE(data[1] != data[1]);
+    EXPECT_FLOAT_EQ(2.0f / 4095.0f, data[2]);
+    EXPECT_FLOAT_EQ(1.0f, data[size * size - 1U]);
+
+    expect_regions(reader, whole);
+  }
+
+  // Without summaries, the range of the pixel type, [0, 1], is used.
+  {
+    MinimalTIFFReader reader;
+    reader.setNormalized(true);
+    ASSERT_NO_THROW(reader.setId(plain));
+
+    VariantPixelBuffer whole;
+    ASSERT_NO_THROW(reader.openBytes(0U, whole));
+    const float *data = whole.data<float>();
+    EXPECT_FLOAT_EQ(0.0f, data[0]);
+    EXPECT_TRUE(data[1] != data[1]);
+    EXPECT_FLOAT_EQ(0.0f, data[100]);
+    EXPECT_FLOAT_EQ(1.0f, data[101]);
+    EXPECT_FLOAT_EQ(1.0f, data[size * size - 1U]);
+
+    expect_regions(reader, whole);
+  }
+
+  MinimalTIFFReader unnormalized;
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(unnormalized.setId(summarised));
+  ASSERT_NO_THROW(unnormalized.openBytes(0U, buf));
+  EXPECT_FLOAT_EQ(-100.0f, buf.data<float>()[0]);
+}
+
+TEST(MinimalTIFFReaderTileGrid, Geometry)
+{
+  using namespace ome::files::tiff;
+  using ome::xml::model::enums::PixelType;
+
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!boost::filesystem::exists(dir) && !boost::filesystem::create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+
+  // A 100×70 image with 32×16 tiles, and a 64×200 image with
+  // single-row strips.
+  for (const TileType type : {TILE, STRIP})
+    {
+      const uint32_t width = type == TILE ? 100U : 64U;
+      const uint32_t height = type == TILE ? 70U : 200U;
+      boost::filesystem::path filename(dir / (type == TILE ? "tilegrid-tiles.tiff" : "tilegrid-strips.tiff"));
+
+      {
+        std::shared_ptr<TIFF> wtiff(TIFF::open(filename, "w"));
+        std::shared_ptr<IFD> wifd(wtiff->getCurrentDirectory());
+        wifd->setImageWidth(width);
+        wifd->setImageHeight(height);
+        wifd->setTileType(type);
+        wifd->setTileWidth(type == TILE ? 32U : width);
+        wifd->setTileHeight(type == TILE ? 16U : 1U);
+        wifd->setPixelType(PixelType::UINT8);
+        wifd->setBitsPerSample(8U);
+        wifd->setSamplesPerPixel(1U);
+        wifd->setPlanarConfiguration(CONTIG);
+        wifd->setPhotometricInterpretation(MIN_IS_BLACK);
+
+        std::array<VariantPixelBuffer::size_type, 9> shape;
+        shape[ome::files::DIM_SPATIAL_X] = width;
+        shape[ome::files::DIM_SPATIAL_Y] = height;
+        shape[ome::files::DIM_SUBCHANNEL] = shape[ome::files::DIM_SPATIAL_Z] =
+          shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+          shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] =
+          shape[ome::files::DIM_MODULO_C] = 1;
+        VariantPixelBuffer buf(shape, PixelType::UINT8);
+        wifd->writeImage(buf);
+        wtiff->writeCurrentDirectory();
+        wtiff->close();
+      }
+
+      MinimalTIFFReader reader;
+      ASSERT_NO_THROW(reader.setId(filename));
+
+      const std::vector<TileGrid> grids(reader.getTileGrids());
+      ASSERT_EQ(reader.getResolutionCount(), grids.size());
+      const TileGrid& grid(grids.at(0));
+      EXPECT_EQ(type, grid.type);
+      EXPECT_EQ(width, grid.imageWidth);
+      EXPECT_EQ(height, grid.imageHeight);
+      EXPECT_THROW(reader.getTileGrid(reader.getResolutionCount()), std::logic_error);
+      EXPECT_THROW(grid.region(grid.rows, 0U), std::logic_error);
+
+      if (type == TILE)
+        {
+          EXPECT_EQ(32U, reader.getOptimalTileWidth());
+          EXPECT_EQ(16U, reader.getOptimalTileHeight());
+          EXPECT_EQ(5U, grid.rows);
+          EXPECT_EQ(4U, grid.columns);
+
+          // The last tile is clipped to the image.
+          const ome::files::PlaneRegion last(grid.region(4U, 3U));
+          EXPECT_EQ(96U, last.x);
+          EXPECT_EQ(64U, last.y);
+          EXPECT_EQ(4U, last.w);
+          EXPECT_EQ(6U, last.h);
+        }
+      else
+        {
+          // Whole strips up to the default band height.
+          EXPECT_EQ(64U, reader.getOptimalTileWidth());
+          EXPECT_EQ(200U, reader.getOptimalTileHeight());
+          EXPECT_EQ(200U, grid.rows);
+          EXPECT_EQ(1U, grid.columns);
+        }
+
+      // The regions tile the image exactly.
+      const std::vector<ome::files::PlaneRegion> regions(grid.regions());
+      ASSERT_EQ(grid.count(), regions.size());
+      dimension_size_type area = 0U;
+      for (const auto& region : regions)
+        area += region.area();
+      EXPECT_EQ(dimension_size_type(width) * height, area);
+    }
+}
+
+
+// A pyramid written as SubIFDs, with the pixels of each level read
+// directly from its IFD for comparison with the reader.
+class MinimalTIFFReaderPyramidTest : public TIFFPixelsTest
+{
+public:
+  boost::filesystem::path name;
+  std::vector<VariantPixelBuffer> levels;
+
+  MinimalTIFFReaderPyramidTest():
+    TIFFPixelsTest("minimaltiffreader"),
+    name(),
+    levels()
+  {
+  }
+
+  virtual void SetUp()
+  {
+    TIFFPixelsTest::SetUp();
+
+    name = datafile("pyramid.tiff");
+    {
+      std::shared_ptr<ome::files::tiff::TIFF> tiff = ome::files::tiff::TIFF::open(name, "w");
+      tiff->setSubResolutions(3U, ome::files::tiff::DOWNSAMPLE_MEAN);
+      std::shared_ptr<ome::files::tiff::IFD> ifd = tiff->getCurrentDirectory();
+      setup_ifd(ifd);
+      ifd->writeImage(expected.at(0));
+      tiff->writeCurrentDirectory();
+      tiff->close();
+    }
+
+    std::shared_ptr<ome::files::tiff::TIFF> tiff = ome::files::tiff::TIFF::open(name, "r");
+    std::shared_ptr<ome::files::tiff::IFD> ifd = tiff->getDirectoryByIndex(0);
+    std::vector<uint64_t> offsets;
+    ifd->getField(ome::files::tiff::SUBIFD).get(offsets);
+    levels.push_back(VariantPixelBuffer());
+    ifd->readImage(levels.back());
+    for (const auto offset : offsets)
+      {
+        levels.push_back(VariantPixelBuffer());
+        tiff->getDirectoryByOffset(offset)->readImage(levels.back());
+      }
+    tiff->close();
+  }
+
+  virtual void TearDown()
+  {
+    if (boost::filesystem::exists(name))
+      boost::filesystem::remove(name);
+    TIFFPixelsTest::TearDown();
+  }
+};
+
+TEST_F(MinimalTIFFReaderPyramidTest, Flattened)
+{
+  // Flattened resolutions ignore the SubIFDs.
+  MinimalTIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(name));
+  EXPECT_EQ(1U, reader.getSeriesCount());
+  EXPECT_EQ(1U, reader.getResolutionCount());
+  reader.close();
+}
+
+TEST_F(MinimalTIFFReaderPyramidTest, Resolutions)
+{
+  // Each resolution is read from its SubIFD.
+  MinimalTIFFReader reader;
+  reader.setFlattenedResolutions(false);
+  ASSERT_NO_THROW(reader.setId(name));
+  EXPECT_EQ(1U, reader.getSeriesCount());
+  ASSERT_EQ(4U, levels.size());
+  ASSERT_EQ(levels.size(), reader.getResolutionCount());
+
+  dimension_size_type size = image_size;
+  for (dimension_size_type r = 0; r < levels.size(); ++r, size /= 2U)
+    {
+      ASSERT_NO_THROW(reader.setResolution(r));
+      EXPECT_EQ(size, reader.getSizeX());
+      EXPECT_EQ(size, reader.getSizeY());
+      EXPECT_EQ(1U, reader.getImageCount());
+
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(reader.openBytes(0U, buf));
+      EXPECT_TRUE(levels.at(r) == buf);
+    }
+  reader.close();
+}
+
+TEST_F(MinimalTIFFReaderPyramidTest, OpenBytesAt)
+{
+  MinimalTIFFReader reader;
+  reader.setFlattenedResolutions(false);
+  ASSERT_NO_THROW(reader.setId(name));
+
+  // Any resolution may be read without changing the current
+  // resolution.
+  ASSERT_NO_THROW(reader.setResolution(1U));
+  dimension_size_type size = image_size;
+  for (dimension_size_type r = 0; r < levels.size(); ++r, size /= 2U)
+    {
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(reader.openBytesAt(0U, r, 0U, buf, PlaneRegion(0U, 0U, size, size)));
+      EXPECT_TRUE(levels.at(r) == buf);
+    }
+  EXPECT_EQ(1U, reader.getResolution());
+  VariantPixelBuffer invalid;
+  ASSERT_THROW(reader.openBytesAt(0U, levels.size(), 0U, invalid, PlaneRegion(0U, 0U, 1U, 1U)), std::logic_error);
+  ASSERT_THROW(reader.openBytesAt(1U, 0U, 0U, invalid, PlaneRegion(0U, 0U, 1U, 1U)), std::logic_error);
+  reader.close();
+}
+
+TEST_F(MinimalTIFFReaderPyramidTest, Thumbnail)
+{
+  MinimalTIFFReader reader;
+  reader.setFlattenedResolutions(false);
+  ASSERT_NO_THROW(reader.setId(name));
+
+  // The thumbnail is taken from the 128×128 sub-resolution.
+  ASSERT_NO_THROW(reader.setResolution(0U));
+  VariantPixelBuffer thumb;
+  ASSERT_NO_THROW(reader.openThumbBytes(0U, thumb));
+  EXPECT_EQ(0U, reader.getResolution());
+  EXPECT_TRUE(levels.at(2) == thumb);
+  reader.close();
+}
+
+class MinimalTIFFReaderMemoryTest : public TIFFPixelsTest
+{
+public:
+  MinimalTIFFReaderMemoryTest():
+    TIFFPixelsTest("minimaltiffreader-memory")
+  {
+  }
+};
+
+TEST_F(MinimalTIFFReaderMemoryTest, OpenBytesInto)
+{
+  MinimalTIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(filenames.at(0)));
+
+  const uint16_pixel_type *data = expected.at(0).data<uint16_pixel_type>();
+  const PlaneRegion region(16U, 8U, 200U, 100U);
+  const uint16_pixel_type fill = 0xFFFFU;
+
+  // Rows padded to 256 pixels, and dense rows.
+  for (const dimension_size_type pitch : {256U, 200U})
+    {
+      std::vector<uint16_pixel_type> memory(pitch * region.h, fill);
+      VariantPixelBufferView view(memory.data(), PT::UINT16,
+                                  region.w, region.h, 1U,
+                                  sizeof(uint16_pixel_type),
+                                  pitch * sizeof(uint16_pixel_type),
+                                  sizeof(uint16_pixel_type));
+      ASSERT_NO_THROW(reader.openBytesInto(0U, 0U, 0U, view, region));
+
+      for (dimension_size_type y = 0; y < region.h; ++y)
+        {
+          for (dimension_size_type x = 0; x < region.w; ++x)
+            ASSERT_EQ(data[((region.y + y) * image_size) + region.x + x], memory[(y * pitch) + x]);
+          // Padding is untouched.
+          for (dimension_size_type x = region.w; x < pitch; ++x)
+            ASSERT_EQ(fill, memory[(y * pitch) + x]);
+        }
+    }
+
+  std::vector<uint16_pixel_type> small(10U * 10U);
+  VariantPixelBufferView mismatched(small.data(), PT::UINT16, 10U, 10U, 1U,
+                                    sizeof(uint16_pixel_type),
+                                    10U * sizeof(uint16_pixel_type),
+                                    sizeof(uint16_pixel_type));
+  ASSERT_THROW(reader.openBytesInto(0U, 0U, 0U, mismatched, region), std::logic_error);
+
+  ASSERT_THROW(VariantPixelBufferView(small.data(), PT::UINT16, 10U, 10U, 1U,
+                                      sizeof(uint16_pixel_type),
+                                      21U, sizeof(uint16_pixel_type)),
+               std::logic_error);
+}
+
 namespace
 {
 
@@ -0,0 +1,133 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <ome/files/detail/Normalize.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::detail::normalizeSamples;
+
+namespace
+{
+
+  // Values within, at the limits of, and outside the range [-10,
+  // 30], with infinities, NaN and signed zero.
+  template<typename T>
+  std::vector<T>
+  sample_values()
+  {
+    std::vector<T> values;
+    for (int i = -40; i < 60; ++i)
+      values.push_back(static_cast<T>(i) * static_cast<T>(0.75));
+    values.push_back(T(-10));
+    values.push_back(T(30));
+    values.push_back(-T(0));
+    values.push_back(std::numeric_limits<T>::infinity());
+    values.push_back(-std::numeric_limits<T>::infinity());
+    values.push_back(std::numeric_limits<T>::quiet_NaN());
+    values.push_back(std::numeric_limits<T>::max());
+    values.push_back(std::numeric_limits<T>::denorm_min());
+    return values;
+  }
+
+  template<typename T>
+  T
+  expected_value(T value,
+                 T min,
+                 T scale)
+  {
+    const T v = (value - min) * scale;
+    return v < T(0) ? T(0) : (v > T(1) ? T(1) : v);
+  }
+
+  template<typename T>
+  void
+  check_normalize()
+  {
+    const T min = T(-10);
+    const T scale = T(1) / T(40);
+    const std::vector<T> values(sample_values<T>());
+
+    // Every count and alignment, so that the SIMD blocks and the
+    // remainder are both used, and nothing outside is changed.
+    for (dimension_size_type offset = 0; offset < 4U; ++offset)
+      for (dimension_size_type count = 0; count + offset <= values.size(); ++count)
+        {
+          std::vector<T> data(values);
+          normalizeSamples(data.data() + offset, count, min, scale);
+          for (dimension_size_type i = 0; i < values.size(); ++i)
+            {
+              const bool changed = i >= offset && i < offset + count;
+              const T expected = changed ? expected_value(values[i], min, scale) : values[i];
+              if (std::isnan(expected))
+                ASSERT_TRUE(std::isnan(data[i]));
+              else
+                ASSERT_EQ(0, std::memcmp(&expected, &data[i], sizeof(T)))
+                  << "value " << values[i] << " at " << i << " (offset " << offset << ", count " << count << ")";
+            }
+        }
+  }
+
+}
+
+TEST(Normalize, Float)
+{
+  check_normalize<float>();
+}
+
+TEST(Normalize, Double)
+{
+  check_normalize<double>();
+}
+
+TEST(Normalize, Range)
+{
+  std::vector<float> data{-10.0f, 10.0f, 30.0f, 50.0f, -30.0f};
+  normalizeSamples(data.data(), data.size(), -10.0f, 1.0f / 40.0f);
+  EXPECT_EQ(0.0f, data[0]);
+  EXPECT_EQ(0.5f, data[1]);
+  EXPECT_EQ(1.0f, data[2]);
+  EXPECT_EQ(1.0f, data[3]);
+  EXPECT_EQ(0.0f, data[4]);
+}
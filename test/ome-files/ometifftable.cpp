@@ -0,0 +1,153 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <stdexcept>
+
+#include <ome/files/detail/OMETIFF.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::detail::OMETIFFFileTable;
+using ome::files::detail::OMETIFFPlane;
+using ome::files::detail::OMETIFFPlaneTable;
+
+namespace
+{
+
+  OMETIFFPlane
+  make_plane(OMETIFFPlane::file_index_type file,
+             dimension_size_type           ifd)
+  {
+    OMETIFFPlane plane(file);
+    plane.ifd = ifd;
+    plane.certain = true;
+    plane.status = OMETIFFPlane::PRESENT;
+    return plane;
+  }
+
+}
+
+TEST(OMETIFFFileTable, Intern)
+{
+  OMETIFFFileTable files;
+  EXPECT_EQ(0U, files.intern("a.ome.tiff"));
+  EXPECT_EQ(1U, files.intern("b.ome.tiff"));
+  EXPECT_EQ(0U, files.intern("a.ome.tiff"));
+  EXPECT_EQ(2U, files.size());
+  EXPECT_EQ(boost::filesystem::path("b.ome.tiff"), files.at(1U));
+  EXPECT_THROW(files.at(OMETIFFPlane::no_file), std::out_of_range);
+
+  files.clear();
+  EXPECT_EQ(0U, files.size());
+}
+
+TEST(OMETIFFPlaneTable, Unset)
+{
+  OMETIFFPlaneTable table;
+  table.resize(10U);
+  EXPECT_EQ(10U, table.size());
+  EXPECT_EQ(0U, table.firstUnset());
+  EXPECT_EQ(OMETIFFPlane::no_file, table.at(5U).file);
+  EXPECT_EQ(OMETIFFPlane::UNKNOWN, table.at(5U).status);
+  EXPECT_THROW(table.at(10U), std::out_of_range);
+  EXPECT_THROW(table.assign(8U, 3U, make_plane(0U, 0U)), std::out_of_range);
+}
+
+TEST(OMETIFFPlaneTable, MergeRuns)
+{
+  OMETIFFPlaneTable table;
+  table.resize(1000000U);
+
+  // One TiffData per plane, as written by OMETIFFWriter.
+  for (dimension_size_type p = 0; p < table.size(); ++p)
+    table.assign(p, 1U, make_plane(0U, p));
+
+  ASSERT_EQ(1U, table.getRuns().size());
+  EXPECT_EQ(1000000U, table.getRuns().front().count);
+  EXPECT_EQ(table.size(), table.firstUnset());
+  EXPECT_EQ(999999U, table.at(999999U).ifd);
+  EXPECT_EQ(0U, table.at(999999U).file);
+  EXPECT_TRUE(table.at(999999U).certain);
+}
+
+TEST(OMETIFFPlaneTable, ReplaceRange)
+{
+  OMETIFFPlaneTable table;
+  table.resize(20U);
+  table.assign(0U, 20U, make_plane(0U, 0U));
+
+  // Replace the middle of the run with planes from another file.
+  table.assign(5U, 5U, make_plane(1U, 0U));
+  ASSERT_EQ(3U, table.getRuns().size());
+  EXPECT_EQ(0U, table.at(4U).file);
+  EXPECT_EQ(4U, table.at(4U).ifd);
+  EXPECT_EQ(1U, table.at(5U).file);
+  EXPECT_EQ(0U, table.at(5U).ifd);
+  EXPECT_EQ(1U, table.at(9U).file);
+  EXPECT_EQ(4U, table.at(9U).ifd);
+  EXPECT_EQ(0U, table.at(10U).file);
+  EXPECT_EQ(10U, table.at(10U).ifd);
+  EXPECT_EQ(0U, table.at(19U).file);
+  EXPECT_EQ(19U, table.at(19U).ifd);
+
+  // Restoring the original planes merges the runs again.
+  table.assign(3U, 10U, make_plane(0U, 3U));
+  ASSERT_EQ(1U, table.getRuns().size());
+  EXPECT_EQ(7U, table.at(7U).ifd);
+}
+
+TEST(OMETIFFPlaneTable, Fill)
+{
+  OMETIFFPlaneTable table;
+  table.resize(10U);
+  table.assign(0U, 1U, make_plane(0U, 4U));
+  table.assign(6U, 2U, make_plane(1U, 0U));
+  EXPECT_EQ(1U, table.firstUnset());
+
+  // Filling stops at the next certain plane.
+  EXPECT_EQ(5U, table.fill(1U, make_plane(0U, 5U)));
+  EXPECT_EQ(8U, table.firstUnset());
+  EXPECT_FALSE(table.at(3U).certain);
+  EXPECT_EQ(7U, table.at(3U).ifd);
+  EXPECT_EQ(1U, table.at(7U).file);
+
+  EXPECT_EQ(0U, table.fill(6U, make_plane(0U, 0U)));
+  EXPECT_EQ(2U, table.fill(8U, make_plane(2U, 0U)));
+  EXPECT_EQ(table.size(), table.firstUnset());
+}
@@ -36,14 +36,26 @@
  * #L%
  */
 
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <limits>
+#include <map>
+#include <set>
 #include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <ome/files/CoreMetadata.h>
+#include <ome/files/FormatException.h>
 #include <ome/files/MetadataTools.h>
+#include <ome/files/PlaneRegion.h>
 #include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
 #include <ome/files/in/OMETIFFReader.h>
 #include <ome/files/out/OMETIFFWriter.h>
+#include <ome/files/tiff/Exception.h>
 #include <ome/files/tiff/Field.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/Tags.h>
@@ -59,6 +71,7 @@
 using ome::files::dimension_size_type;
 using ome::files::CoreMetadata;
 using ome::files::VariantPixelBuffer;
+using ome::files::VariantPixelBufferView;
 using ome::files::in::OMETIFFReader;
 using ome::files::out::OMETIFFWriter;
 using ome::files::tiff::IFD;
@@ -106,99 +119,985 @@ public:
     // if (boost::filesystem::exists(testfile))
     //   boost::filesystem::remove(testfile);
   }
+
+  void
+  writeAndValidate(bool                reserve,
+                   bool                parallel = false,
+                   dimension_size_type queueDepth = 0U,
+                   bool                preallocate = false,
+                   bool                mapped = false,
+                   bool                handles = false)
+  {
+    const TIFFTestParameters& params = GetParam();
+
+    std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+    for (const auto& i : *tiff)
+      {
+        std::shared_ptr<CoreMetadata> c = ome::files::tiff::makeCoreMetadata(*i);
+        seriesList.push_back(c);
+      }
+
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+    ome::files::fillMetadata(*meta, seriesList);
+    std::shared_ptr<::ome::xml::meta::MetadataRetrieve> retrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+
+    tiffwriter.setMetadataRetrieve(retrieve);
+
+    tiffwriter.setInterleaved(!params.imageplanar);
+    if (!preallocate)
+      tiffwriter.setCompression("Deflate");
+    tiffwriter.setTileSizeX(params.tilewidth);
+    tiffwriter.setTileSizeY(params.tilelength);
+    tiffwriter.setReserveOMEXML(reserve);
+    tiffwriter.setParallelFiles(parallel);
+    tiffwriter.setWriteQueueDepth(queueDepth);
+    tiffwriter.setPreallocatedLayout(preallocate);
+
+    dimension_size_type handle = 0U;
+    if (handles)
+      {
+        ASSERT_NO_THROW(handle = tiffwriter.getFileHandle(testfile));
+        EXPECT_EQ(handle, tiffwriter.getFileHandle(testfile));
+      }
+    else
+      ASSERT_NO_THROW(tiffwriter.setId(testfile));
+
+    VariantPixelBuffer buf;
+    dimension_size_type currentSeries = 0U;
+    for (dimension_size_type i = 0U; i < seriesList.size(); ++i)
+      {
+        std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(i);
+        ASSERT_TRUE(static_cast<bool>(ifd));
+        ifd->readImage(buf);
+
+        // Make a second buffer to ensure correct ordering for saveBytes.
+        std::array<VariantPixelBuffer::size_type, 9> shape;
+        shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+        shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+        shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+        shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+          shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+
+        ome::files::PixelBufferBase::storage_order_type order(ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+
+        VariantPixelBuffer src(shape, ifd->getPixelType(), order);
+        src = buf;
+
+        if (handles)
+          ASSERT_NO_THROW(tiffwriter.setCurrentFile(handle, currentSeries, 0U));
+        else
+          ASSERT_NO_THROW(tiffwriter.setSeries(currentSeries));
+        if (mapped && tiffwriter.getTileSizeX() == shape[ome::files::DIM_SPATIAL_X])
+          {
+            // Compute straight into the file.
+            VariantPixelBuffer dest;
+            ASSERT_NO_THROW(tiffwriter.mapBytes(0, dest));
+            ASSERT_EQ(src.pixelType(), dest.pixelType());
+            dest = src;
+          }
+        else if (preallocate)
+          {
+            // Write the top and bottom halves concurrently.
+            const dimension_size_type width = shape[ome::files::DIM_SPATIAL_X];
+            const dimension_size_type height = shape[ome::files::DIM_SPATIAL_Y];
+            const dimension_size_type half = height / 2;
+            std::exception_ptr error;
+            std::thread bottom([&]()
+                               {
+                                 try
+                                   {
+                                     ome::files::PlaneRegion region(0, half, width, height - half);
+                                     tiffwriter.saveBytes(0, VariantPixelBufferView(src, region),
+                                                          region.x, region.y, region.w, region.h);
+                                   }
+                                 catch (...)
+                                   {
+                                     error = std::current_exception();
+                                   }
+                               });
+            if (half)
+              {
+                ome::files::PlaneRegion region(0, 0, width, half);
+                EXPECT_NO_THROW(tiffwriter.saveBytes(0, VariantPixelBufferView(src, region),
+                                                     region.x, region.y, region.w, region.h));
+              }
+            bottom.join();
+            ASSERT_FALSE(static_cast<bool>(error));
+          }
+        else
+          ASSERT_NO_THROW(tiffwriter.saveBytes(0, src));
+        ++currentSeries;
+      }
+    ASSERT_NO_THROW(tiffwriter.flush());
+    tiffwriter.close();
+
+    // Read and validate OME-TIFF
+    {
+      OMETIFFReader tiffreader;
+      std::shared_ptr<ome::xml::meta::MetadataStore> store(std::make_shared<ome::xml::meta::OMEXMLMetadata>());
+      ASSERT_NO_THROW(tiffreader.setMetadataStore(store));
+
+      ASSERT_NO_THROW(tiffreader.setId(testfile));
+
+      ASSERT_EQ(seriesList.size(), tiffreader.getSeriesCount());
+      for(dimension_size_type i = 0; i < tiffreader.getSeriesCount(); ++i)
+        {
+          tiffreader.setSeries(i);
+          const std::shared_ptr<CoreMetadata> ref = seriesList.at(i);
+        
+          EXPECT_EQ(ref->sizeX, tiffreader.getSizeX());
+          EXPECT_EQ(ref->sizeY, tiffreader.getSizeY());
+          EXPECT_EQ(ref->sizeZ, tiffreader.getSizeZ());
+          EXPECT_EQ(ref->sizeT, tiffreader.getSizeT());
+          EXPECT_EQ(ref->sizeC.size(), tiffreader.getEffectiveSizeC());
+          if (params.tilewidth)
+            EXPECT_EQ(*params.tilewidth, tiffreader.getOptimalTileWidth(0));
+          if (params.tilelength)
+            EXPECT_EQ(*params.tilelength, tiffreader.getOptimalTileHeight(0));
+          EXPECT_EQ(ome::xml::model::enums::PixelType::UINT8, tiffreader.getPixelType());
+          EXPECT_EQ(8, tiffreader.getBitsPerPixel());
+          EXPECT_EQ(3, tiffreader.getRGBChannelCount(0));
+          EXPECT_EQ(!params.imageplanar, tiffreader.isInterleaved());
+
+          VariantPixelBuffer buf;
+          std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(i);
+          ASSERT_TRUE(static_cast<bool>(ifd));
+          ifd->readImage(buf);
+
+          VariantPixelBuffer vb;
+          tiffreader.openBytes(0, vb);
+
+          EXPECT_TRUE(buf == vb);
+        }
+    }
+  }
 };
 
 TEST_P(TIFFWriterTest, setId)
+{
+  writeAndValidate(false);
+}
+
+TEST_P(TIFFWriterTest, reserveOMEXML)
+{
+  testfile = testfile.parent_path() / (std::string("reserve-") + testfile.filename().string());
+
+  EXPECT_FALSE(tiffwriter.getReserveOMEXML());
+  writeAndValidate(true);
+  EXPECT_TRUE(tiffwriter.getReserveOMEXML());
+
+  // The OME-XML text should have replaced the placeholder.
+  std::shared_ptr<TIFF> written;
+  ASSERT_NO_THROW(written = TIFF::open(testfile, "r"));
+  std::string description;
+  ASSERT_NO_THROW(written->getDirectoryByIndex(0)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(description));
+  EXPECT_NE(std::string::npos, description.find("<OME"));
+  EXPECT_EQ(std::string::npos, description.find("OME-TIFF "));
+}
+
+TEST_P(TIFFWriterTest, parallelFiles)
+{
+  testfile = testfile.parent_path() / (std::string("parallel-") + testfile.filename().string());
+
+  EXPECT_FALSE(tiffwriter.getParallelFiles());
+  writeAndValidate(false, true);
+  EXPECT_TRUE(tiffwriter.getParallelFiles());
+}
+
+TEST_P(TIFFWriterTest, writeQueue)
+{
+  testfile = testfile.parent_path() / (std::string("queue-") + testfile.filename().string());
+
+  EXPECT_EQ(0U, tiffwriter.getWriteQueueDepth());
+  writeAndValidate(false, false, 2U);
+  EXPECT_EQ(2U, tiffwriter.getWriteQueueDepth());
+}
+
+TEST_P(TIFFWriterTest, streamingWrites)
+{
+  testfile = testfile.parent_path() / (std::string("streaming-") + testfile.filename().string());
+
+  EXPECT_EQ(0U, tiffwriter.getStreamingWrites());
+  tiffwriter.setStreamingWrites(1024U * 1024U);
+  EXPECT_EQ(1024U * 1024U, tiffwriter.getStreamingWrites());
+  writeAndValidate(false);
+}
+
+TEST_P(TIFFWriterTest, preallocatedLayout)
+{
+  testfile = testfile.parent_path() / (std::string("preallocated-") + testfile.filename().string());
+
+  EXPECT_FALSE(tiffwriter.getPreallocatedLayout());
+  writeAndValidate(false, false, 0U, true);
+  EXPECT_TRUE(tiffwriter.getPreallocatedLayout());
+}
+
+TEST_P(TIFFWriterTest, mappedPlanes)
+{
+  testfile = testfile.parent_path() / (std::string("mapped-") + testfile.filename().string());
+
+  writeAndValidate(false, false, 0U, true, true);
+}
+
+TEST_P(TIFFWriterTest, fileHandles)
+{
+  testfile = testfile.parent_path() / (std::string("handles-") + testfile.filename().string());
+
+  writeAndValidate(false, false, 0U, false, false, true);
+  EXPECT_THROW(tiffwriter.setCurrentFile(0U, 0U, 0U), std::logic_error);
+}
+
+TEST_P(TIFFWriterTest, compactDirectories)
+{
+  testfile = testfile.parent_path() / (std::string("compact-") + testfile.filename().string());
+
+  EXPECT_FALSE(tiffwriter.getCompactDirectories());
+  tiffwriter.setCompactDirectories(true);
+  writeAndValidate(false);
+  EXPECT_TRUE(tiffwriter.getCompactDirectories());
+
+  // Only the first directory has a Software tag.
+  std::shared_ptr<TIFF> written;
+  ASSERT_NO_THROW(written = TIFF::open(testfile, "r"));
+  std::string software;
+  EXPECT_NO_THROW(written->getDirectoryByIndex(0)->getField(ome::files::tiff::SOFTWARE).get(software));
+  if (written->directoryCount() > 1)
+    EXPECT_THROW(written->getDirectoryByIndex(1)->getField(ome::files::tiff::SOFTWARE).get(software), ome::files::tiff::Exception);
+}
+
+TEST_P(TIFFWriterTest, cloudOptimized)
+{
+  testfile = testfile.parent_path() / (std::string("cloud-") + testfile.filename().string());
+
+  EXPECT_FALSE(tiffwriter.getCloudOptimized());
+  tiffwriter.setCloudOptimized(true);
+  writeAndValidate(false);
+  EXPECT_TRUE(tiffwriter.getCloudOptimized());
+
+  // Every IFD precedes all the pixel data.
+  std::shared_ptr<TIFF> written;
+  ASSERT_NO_THROW(written = TIFF::open(testfile, "r"));
+  ome::files::tiff::offset_type lastIFD = 0U;
+  uint64_t firstData = std::numeric_limits<uint64_t>::max();
+  for (dimension_size_type i = 0U; i < written->directoryCount(); ++i)
+    {
+      std::shared_ptr<IFD> ifd(written->getDirectoryByIndex(i));
+      lastIFD = std::max(lastIFD, ifd->getOffset());
+      std::vector<uint64_t> offsets;
+      ASSERT_NO_THROW(ifd->getField(ifd->getTileInfo().tileType() == ome::files::tiff::TILE ?
+                                    ome::files::tiff::TILEOFFSETS : ome::files::tiff::STRIPOFFSETS).get(offsets));
+      for (const auto offset : offsets)
+        if (offset)
+          firstData = std::min(firstData, offset);
+    }
+  EXPECT_LT(lastIFD, firstData);
+
+  std::string description;
+  ASSERT_NO_THROW(written->getDirectoryByIndex(0)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(description));
+  EXPECT_NE(std::string::npos, description.find("<OME"));
+}
+
+TEST_P(TIFFWriterTest, multiFileDirectories)
 {
   const TIFFTestParameters& params = GetParam();
 
+  path first(testfile.parent_path() / (std::string("multi1-") + testfile.filename().string()));
+  path second(testfile.parent_path() / (std::string("multi2-") + testfile.filename().string()));
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
   std::vector<std::shared_ptr<CoreMetadata>> seriesList;
-  for (const auto& i : *tiff)
+  seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+  seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList);
+  tiffwriter.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+  tiffwriter.setInterleaved(!params.imageplanar);
+
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
+
+  // Change series before changing file, and then change file
+  // before changing series; neither may leave an empty IFD behind.
+  ASSERT_NO_THROW(tiffwriter.setId(first));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+  ASSERT_NO_THROW(tiffwriter.setSeries(1));
+  ASSERT_NO_THROW(tiffwriter.setId(second));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+  ASSERT_NO_THROW(tiffwriter.setId(first));
+  ASSERT_NO_THROW(tiffwriter.setSeries(0));
+  tiffwriter.close();
+
+  for (const auto& file : {first, second})
     {
-      std::shared_ptr<CoreMetadata> c = ome::files::tiff::makeCoreMetadata(*i);
-      seriesList.push_back(c);
+      std::shared_ptr<TIFF> written;
+      ASSERT_NO_THROW(written = TIFF::open(file, "r"));
+      EXPECT_EQ(1U, written->directoryCount());
     }
 
+  OMETIFFReader tiffreader;
+  ASSERT_NO_THROW(tiffreader.setId(first));
+  ASSERT_EQ(2U, tiffreader.getSeriesCount());
+  for (dimension_size_type i = 0; i < tiffreader.getSeriesCount(); ++i)
+    {
+      tiffreader.setSeries(i);
+      VariantPixelBuffer vb;
+      ASSERT_NO_THROW(tiffreader.openBytes(0, vb));
+      EXPECT_TRUE(tmp == vb);
+    }
+}
+
+TEST_P(TIFFWriterTest, multiFileUUIDs)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  std::vector<path> files;
+  for (const auto& prefix : {"uuid1-", "uuid2-", "uuid3-"})
+    files.push_back(testfile.parent_path() / (std::string(prefix) + testfile.filename().string()));
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  for (dimension_size_type i = 0; i < files.size(); ++i)
+    seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+
   std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
   ome::files::fillMetadata(*meta, seriesList);
-  std::shared_ptr<::ome::xml::meta::MetadataRetrieve> retrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+  tiffwriter.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+  tiffwriter.setInterleaved(!params.imageplanar);
+
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
+
+  // One series per file.
+  for (dimension_size_type i = 0; i < files.size(); ++i)
+    {
+      ASSERT_NO_THROW(tiffwriter.setId(files[i]));
+      ASSERT_NO_THROW(tiffwriter.setSeries(i));
+      ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+    }
+  tiffwriter.close();
 
-  tiffwriter.setMetadataRetrieve(retrieve);
+  // Each file has its own root UUID, and the TiffData of every file
+  // refers to the other files by their root UUIDs.
+  std::map<std::string, std::string> uuids;
+  std::vector<std::shared_ptr<::ome::xml::meta::OMEXMLMetadata>> stores;
+  for (const auto& file : files)
+    {
+      std::shared_ptr<TIFF> written;
+      ASSERT_NO_THROW(written = TIFF::open(file, "r"));
+      std::string description;
+      ASSERT_NO_THROW(written->getDirectoryByIndex(0)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(description));
+      std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> store;
+      ASSERT_NO_THROW(store = ome::files::createOMEXMLMetadata(description));
+      const std::string uuid(store->getUUID());
+      EXPECT_FALSE(uuid.empty());
+      EXPECT_TRUE(uuids.insert(std::make_pair(file.filename().string(), uuid)).second);
+      stores.push_back(store);
+    }
+  std::set<std::string> distinct;
+  for (const auto& u : uuids)
+    distinct.insert(u.second);
+  EXPECT_EQ(files.size(), distinct.size());
+
+  for (const auto& store : stores)
+    {
+      ASSERT_EQ(files.size(), store->getImageCount());
+      for (dimension_size_type i = 0; i < files.size(); ++i)
+        {
+          ASSERT_EQ(1U, store->getTiffDataCount(i));
+          const std::string filename(store->getUUIDFileName(i, 0));
+          EXPECT_EQ(files[i].filename().string(), filename);
+          EXPECT_EQ(uuids[filename], store->getUUIDValue(i, 0));
+        }
+    }
+}
+
+TEST_P(TIFFWriterTest, compactTiffData)
+{
+  const TIFFTestParameters& params = GetParam();
 
+  testfile = testfile.parent_path() / (std::string("tiffdata-") + testfile.filename().string());
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+  seriesList.front()->sizeZ = 4U;
+  seriesList.front()->imageCount = 4U;
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList);
+  tiffwriter.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
   tiffwriter.setInterleaved(!params.imageplanar);
-  tiffwriter.setCompression("Deflate");
-  tiffwriter.setTileSizeX(params.tilewidth);
-  tiffwriter.setTileSizeY(params.tilelength);
+
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
 
   ASSERT_NO_THROW(tiffwriter.setId(testfile));
+  for (dimension_size_type p = 0; p < 4U; ++p)
+    ASSERT_NO_THROW(tiffwriter.saveBytes(p, buf));
+  tiffwriter.close();
+
+  // The four planes in consecutive IFDs share one TiffData element.
+  std::shared_ptr<TIFF> written;
+  ASSERT_NO_THROW(written = TIFF::open(testfile, "r"));
+  std::string description;
+  ASSERT_NO_THROW(written->getDirectoryByIndex(0)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(description));
+  const std::string::size_type tiffData = description.find("<TiffData");
+  ASSERT_NE(std::string::npos, tiffData);
+  EXPECT_EQ(std::string::npos, description.find("<TiffData", tiffData + 1U));
+  EXPECT_NE(std::string::npos, description.find("PlaneCount=\"4\""));
 
-  VariantPixelBuffer buf;
-  dimension_size_type currentSeries = 0U;
-  for (dimension_size_type i = 0U; i < seriesList.size(); ++i)
+  OMETIFFReader tiffreader;
+  ASSERT_NO_THROW(tiffreader.setId(testfile));
+  ASSERT_EQ(4U, tiffreader.getImageCount());
+  for (dimension_size_type p = 0; p < 4U; ++p)
     {
-      std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(i);
-      ASSERT_TRUE(static_cast<bool>(ifd));
-      ifd->readImage(buf);
+      VariantPixelBuffer vb;
+      ASSERT_NO_THROW(tiffreader.openBytes(p, vb));
+      EXPECT_TRUE(tmp == vb);
+    }
+}
 
-      // Make a second buffer to ensure correct ordering for saveBytes.
-      std::array<VariantPixelBuffer::size_type, 9> shape;
-      shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
-      shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
-      shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
-      shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
-        shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+TEST_P(TIFFWriterTest, parallelSeries)
+{
+  const TIFFTestParameters& params = GetParam();
 
-      ome::files::PixelBufferBase::storage_order_type order(ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  testfile = testfile.parent_path() / (std::string("pseries-") + testfile.filename().string());
 
-      VariantPixelBuffer src(shape, ifd->getPixelType(), order);
-      src = buf;
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  for (dimension_size_type s = 0; s < 3U; ++s)
+    {
+      seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+      seriesList.back()->sizeZ = 2U;
+      seriesList.back()->imageCount = 2U;
+    }
 
-      ASSERT_NO_THROW(tiffwriter.setSeries(currentSeries));
-      ASSERT_NO_THROW(tiffwriter.saveBytes(0, src));
-      ++currentSeries;
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList);
+  tiffwriter.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+  tiffwriter.setInterleaved(!params.imageplanar);
+
+  EXPECT_FALSE(tiffwriter.getParallelSeries());
+  tiffwriter.setParallelSeries(true);
+  EXPECT_TRUE(tiffwriter.getParallelSeries());
+
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
+
+  // Interleave the series, moving back as well as forward.
+  ASSERT_NO_THROW(tiffwriter.setId(testfile));
+  EXPECT_THROW(tiffwriter.setParallelSeries(false), std::logic_error);
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+  ASSERT_NO_THROW(tiffwriter.setSeries(2));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+  ASSERT_NO_THROW(tiffwriter.setSeries(1));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+  ASSERT_NO_THROW(tiffwriter.setSeries(0));
+  EXPECT_EQ(1U, tiffwriter.getPlane());
+  ASSERT_NO_THROW(tiffwriter.saveBytes(1, buf));
+  ASSERT_NO_THROW(tiffwriter.setSeries(2));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(1, buf));
+  ASSERT_NO_THROW(tiffwriter.setSeries(1));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(1, buf));
+  tiffwriter.close();
+
+  // The staged series are merged into the dataset file.
+  std::shared_ptr<TIFF> written;
+  ASSERT_NO_THROW(written = TIFF::open(testfile, "r"));
+  EXPECT_EQ(6U, written->directoryCount());
+  for (boost::filesystem::directory_iterator i(testfile.parent_path());
+       i != boost::filesystem::directory_iterator();
+       ++i)
+    EXPECT_EQ(std::string::npos, i->path().filename().string().find(testfile.filename().string() + ".series-"));
+
+  OMETIFFReader tiffreader;
+  ASSERT_NO_THROW(tiffreader.setId(testfile));
+  ASSERT_EQ(3U, tiffreader.getSeriesCount());
+  for (dimension_size_type s = 0; s < tiffreader.getSeriesCount(); ++s)
+    {
+      tiffreader.setSeries(s);
+      ASSERT_EQ(2U, tiffreader.getImageCount());
+      for (dimension_size_type p = 0; p < 2U; ++p)
+        {
+          VariantPixelBuffer vb;
+          ASSERT_NO_THROW(tiffreader.openBytes(p, vb));
+          EXPECT_TRUE(tmp == vb);
+        }
+    }
+}
+
+TEST_P(TIFFWriterTest, saveBytesStack)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+  seriesList.front()->sizeZ = 4U;
+  seriesList.front()->imageCount = 4U;
+
+  VariantPixelBuffer plane;
+  ifd->readImage(plane);
+
+  // A stack of four copies of the plane.
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  std::copy(plane.shape(), plane.shape() + ome::files::PixelBufferBase::dimensions, shape.begin());
+  shape[ome::files::DIM_SPATIAL_Z] = 4U;
+  VariantPixelBuffer stack(shape, plane.pixelType(), plane.storage_order());
+  for (dimension_size_type z = 0; z < 4U; ++z)
+    {
+      VariantPixelBufferView::indices_type offset;
+      offset.fill(0);
+      offset[ome::files::DIM_SPATIAL_Z] = static_cast<VariantPixelBufferView::indices_type::value_type>(z);
+      VariantPixelBufferView::extents_type extents;
+      std::copy(plane.shape(), plane.shape() + ome::files::PixelBufferBase::dimensions, extents.begin());
+      VariantPixelBufferView(stack, offset, extents).copyFrom(plane);
     }
+
+  // Write sequentially, and concurrently with a preallocated layout.
+  for (const bool preallocate : {false, true})
+    {
+      path file(testfile.parent_path() /
+                ((preallocate ? "stack-prealloc-" : "stack-") + testfile.filename().string()));
+
+      std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+      ome::files::fillMetadata(*meta, seriesList);
+
+      OMETIFFWriter writer;
+      writer.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+      writer.setInterleaved(!params.imageplanar);
+      writer.setPreallocatedLayout(preallocate);
+      writer.setWriteThreads(4U);
+      ASSERT_NO_THROW(writer.setId(file));
+
+      EXPECT_THROW(writer.saveBytesStack(0U, {{0U, 5U}}, {{0U, 1U}}, {{0U, 1U}}, stack), std::logic_error);
+      EXPECT_THROW(writer.saveBytesStack(0U, {{0U, 2U}}, {{0U, 1U}}, {{0U, 1U}}, stack), ome::files::FormatException);
+      ASSERT_NO_THROW(writer.saveBytesStack(0U, {{0U, 4U}}, {{0U, 1U}}, {{0U, 1U}}, stack));
+      writer.close();
+
+      OMETIFFReader reader;
+      ASSERT_NO_THROW(reader.setId(file));
+      ASSERT_EQ(4U, reader.getImageCount());
+      for (dimension_size_type p = 0; p < 4U; ++p)
+        {
+          VariantPixelBuffer vb;
+          ASSERT_NO_THROW(reader.openBytes(p, vb));
+          EXPECT_TRUE(plane == vb);
+        }
+    }
+}
+
+TEST_P(TIFFWriterTest, companionFile)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  path first(testfile.parent_path() / (std::string("companion1-") + testfile.filename().string()));
+  path second(testfile.parent_path() / (std::string("companion2-") + testfile.filename().string()));
+  path companion(testfile.parent_path() / (std::string("companion-") + testfile.stem().string() + ".companion.ome"));
+
+  EXPECT_THROW(tiffwriter.setCompanionFile(testfile.parent_path() / "companion.xml"), ome::files::FormatException);
+  ASSERT_NO_THROW(tiffwriter.setCompanionFile(companion));
+  EXPECT_EQ(companion, tiffwriter.getCompanionFile());
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+  seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList);
+  tiffwriter.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+  tiffwriter.setInterleaved(!params.imageplanar);
+
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
+
+  ASSERT_NO_THROW(tiffwriter.setId(first));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+  ASSERT_NO_THROW(tiffwriter.setSeries(1));
+  ASSERT_NO_THROW(tiffwriter.setId(second));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
   tiffwriter.close();
 
-  // Read and validate OME-TIFF
+  ASSERT_TRUE(exists(companion));
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> companionMeta;
+  ASSERT_NO_THROW(companionMeta = ome::files::createOMEXMLMetadata(companion));
+
+  // Each TIFF only embeds a stub referring to the companion file.
+  for (const auto& file : {first, second})
+    {
+      std::shared_ptr<TIFF> written;
+      ASSERT_NO_THROW(written = TIFF::open(file, "r"));
+      std::string description;
+      ASSERT_NO_THROW(written->getDirectoryByIndex(0)->getField(ome::files::tiff::IMAGEDESCRIPTION).get(description));
+      EXPECT_NE(std::string::npos, description.find("BinaryOnly"));
+      EXPECT_NE(std::string::npos, description.find(companion.filename().string()));
+      EXPECT_EQ(std::string::npos, description.find("TiffData"));
+
+      std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> stub;
+      ASSERT_NO_THROW(stub = ome::files::createOMEXMLMetadata(description));
+      EXPECT_EQ(companionMeta->getUUID(), stub->getBinaryOnlyUUID());
+      EXPECT_NE(companionMeta->getUUID(), stub->getUUID());
+    }
+
+  // The dataset may be opened from any TIFF or the companion file.
+  for (const auto& file : {first, second, companion})
+    {
+      OMETIFFReader tiffreader;
+      ASSERT_NO_THROW(tiffreader.setId(file));
+      ASSERT_EQ(2U, tiffreader.getSeriesCount());
+      for (dimension_size_type i = 0; i < tiffreader.getSeriesCount(); ++i)
+        {
+          tiffreader.setSeries(i);
+          VariantPixelBuffer vb;
+          ASSERT_NO_THROW(tiffreader.openBytes(0, vb));
+          EXPECT_TRUE(tmp == vb);
+        }
+    }
+}
+
+TEST_P(TIFFWriterTest, append)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  testfile = testfile.parent_path() / (std::string("append-") + testfile.filename().string());
+  if (exists(testfile))
+    remove(testfile);
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
+
+  EXPECT_FALSE(tiffwriter.getAppend());
+
+  // Write two timepoints, and then append two more.
+  std::string uuid;
+  for (const dimension_size_type sizeT : {2U, 4U})
+    {
+      std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+      seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+      seriesList.front()->sizeT = sizeT;
+      seriesList.front()->imageCount = sizeT;
+
+      std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+      ome::files::fillMetadata(*meta, seriesList);
+
+      OMETIFFWriter writer;
+      writer.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+      writer.setInterleaved(!params.imageplanar);
+      writer.setAppend(true);
+      EXPECT_TRUE(writer.getAppend());
+      ASSERT_NO_THROW(writer.setId(testfile));
+      for (dimension_size_type p = sizeT - 2U; p < sizeT; ++p)
+        ASSERT_NO_THROW(writer.saveBytes(p, buf));
+      writer.close();
+
+      std::shared_ptr<TIFF> written;
+      ASSERT_NO_THROW(written = TIFF::open(testfile, "r"));
+      EXPECT_EQ(sizeT, written->directoryCount());
+
+      OMETIFFReader tiffreader;
+      std::shared_ptr<ome::xml::meta::OMEXMLMetadata> store(std::make_shared<ome::xml::meta::OMEXMLMetadata>());
+      ASSERT_NO_THROW(tiffreader.setMetadataStore(store));
+      ASSERT_NO_THROW(tiffreader.setId(testfile));
+      ASSERT_EQ(sizeT, tiffreader.getImageCount());
+      for (dimension_size_type p = 0; p < sizeT; ++p)
+        {
+          VariantPixelBuffer vb;
+          ASSERT_NO_THROW(tiffreader.openBytes(p, vb));
+          EXPECT_TRUE(tmp == vb);
+        }
+
+      // The file keeps its UUID.
+      if (uuid.empty())
+        uuid = store->getUUID();
+      else
+        EXPECT_EQ(uuid, store->getUUID());
+    }
+
+  // Existing planes must lie within the new image.
+  {
+    std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+    seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+    seriesList.front()->sizeT = 2U;
+    seriesList.front()->imageCount = 2U;
+
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+    ome::files::fillMetadata(*meta, seriesList);
+
+    OMETIFFWriter writer;
+    writer.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+    writer.setAppend(true);
+    EXPECT_THROW(writer.setId(testfile), ome::files::FormatException);
+  }
+}
+
+TEST_P(TIFFWriterTest, updateMetadata)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  testfile = testfile.parent_path() / (std::string("update-") + testfile.filename().string());
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList);
+  tiffwriter.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+  tiffwriter.setInterleaved(!params.imageplanar);
+
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
+
+  ASSERT_NO_THROW(tiffwriter.setId(testfile));
+  EXPECT_THROW(tiffwriter.updateMetadata(testfile, *meta), std::logic_error);
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+  tiffwriter.close();
+
+  std::string uuid;
   {
     OMETIFFReader tiffreader;
-    std::shared_ptr<ome::xml::meta::MetadataStore> store(std::make_shared<ome::xml::meta::OMEXMLMetadata>());
+    std::shared_ptr<ome::xml::meta::OMEXMLMetadata> store(std::make_shared<ome::xml::meta::OMEXMLMetadata>());
     ASSERT_NO_THROW(tiffreader.setMetadataStore(store));
-
     ASSERT_NO_THROW(tiffreader.setId(testfile));
+    uuid = store->getUUID();
+  }
 
-    ASSERT_EQ(seriesList.size(), tiffreader.getSeriesCount());
-    for(dimension_size_type i = 0; i < tiffreader.getSeriesCount(); ++i)
-      {
-        tiffreader.setSeries(i);
-        const std::shared_ptr<CoreMetadata> ref = seriesList.at(i);
-        
-        EXPECT_EQ(ref->sizeX, tiffreader.getSizeX());
-        EXPECT_EQ(ref->sizeY, tiffreader.getSizeY());
-        EXPECT_EQ(ref->sizeZ, tiffreader.getSizeZ());
-        EXPECT_EQ(ref->sizeT, tiffreader.getSizeT());
-        EXPECT_EQ(ref->sizeC.size(), tiffreader.getEffectiveSizeC());
-        if (params.tilewidth)
-          EXPECT_EQ(*params.tilewidth, tiffreader.getOptimalTileWidth(0));
-        if (params.tilelength)
-          EXPECT_EQ(*params.tilelength, tiffreader.getOptimalTileHeight(0));
-        EXPECT_EQ(ome::xml::model::enums::PixelType::UINT8, tiffreader.getPixelType());
-        EXPECT_EQ(8, tiffreader.getBitsPerPixel());
-        EXPECT_EQ(3, tiffreader.getRGBChannelCount(0));
-        EXPECT_EQ(!params.imageplanar, tiffreader.isInterleaved());
-
-        VariantPixelBuffer buf;
-        std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(i);
-        ASSERT_TRUE(static_cast<bool>(ifd));
-        ifd->readImage(buf);
+  // Rename the channel; the pixel data are unchanged.
+  meta->setChannelName("Renamed channel", 0, 0);
+  ASSERT_NO_THROW(tiffwriter.updateMetadata(testfile, *meta));
 
-        VariantPixelBuffer vb;
-        tiffreader.openBytes(0, vb);
+  {
+    OMETIFFReader tiffreader;
+    std::shared_ptr<ome::xml::meta::OMEXMLMetadata> store(std::make_shared<ome::xml::meta::OMEXMLMetadata>());
+    ASSERT_NO_THROW(tiffreader.setMetadataStore(store));
+    ASSERT_NO_THROW(tiffreader.setId(testfile));
+    EXPECT_EQ(uuid, store->getUUID());
+    EXPECT_EQ(std::string("Renamed channel"), store->getChannelName(0, 0));
 
-        EXPECT_TRUE(buf == vb);
-      }
+    VariantPixelBuffer vb;
+    ASSERT_NO_THROW(tiffreader.openBytes(0, vb));
+    EXPECT_TRUE(tmp == vb);
   }
 
+  // The images must be unchanged.
+  seriesList.front()->sizeZ = 2U;
+  seriesList.front()->imageCount = 2U;
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> resized(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*resized, seriesList);
+  EXPECT_THROW(tiffwriter.updateMetadata(testfile, *resized), ome::files::FormatException);
+}
+
+TEST_P(TIFFWriterTest, shareMetadata)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  testfile = testfile.parent_path() / (std::string("share-") + testfile.filename().string());
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
+
+  EXPECT_FALSE(tiffwriter.getShareMetadata());
+
+  for (const bool share : {false, true})
+    {
+      std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+      seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+
+      std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+      ome::files::fillMetadata(*meta, seriesList);
+      ASSERT_EQ(0U, meta->getTiffDataCount(0));
+
+      OMETIFFWriter writer;
+      writer.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+      writer.setInterleaved(!params.imageplanar);
+      writer.setShareMetadata(share);
+      EXPECT_EQ(share, writer.getShareMetadata());
+      ASSERT_NO_THROW(writer.setId(testfile));
+      // The metadata are used without conversion.
+      EXPECT_TRUE(std::dynamic_pointer_cast<::ome::xml::meta::OMEXMLMetadata>(writer.getMetadataRetrieve()) == meta);
+      ASSERT_NO_THROW(writer.saveBytes(0, buf));
+      writer.close();
+
+      // The caller's metadata are only modified if shared.
+      if (share)
+        EXPECT_LT(0U, meta->getTiffDataCount(0));
+      else
+        EXPECT_EQ(0U, meta->getTiffDataCount(0));
+
+      OMETIFFReader tiffreader;
+      ASSERT_NO_THROW(tiffreader.setId(testfile));
+      VariantPixelBuffer vb;
+      ASSERT_NO_THROW(tiffreader.openBytes(0, vb));
+      EXPECT_TRUE(tmp == vb);
+    }
+}
+
+TEST_P(TIFFWriterTest, packedSamples)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  testfile = testfile.parent_path() / (std::string("packed-") + testfile.filename().string());
+
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+  VariantPixelBuffer tmp;
+  ifd->readImage(tmp);
+  ASSERT_EQ(ome::xml::model::enums::PixelType::UINT8, tmp.pixelType());
+
+  // Six significant bits.
+  VariantPixelBuffer::raw_type *data = tmp.data();
+  for (dimension_size_type i = 0; i < tmp.num_elements(); ++i)
+    data[i] = static_cast<VariantPixelBuffer::raw_type>(data[i] >> 2);
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[ome::files::DIM_SPATIAL_X] = ifd->getImageWidth();
+  shape[ome::files::DIM_SPATIAL_Y] = ifd->getImageHeight();
+  shape[ome::files::DIM_SUBCHANNEL] = ifd->getSamplesPerPixel();
+  shape[ome::files::DIM_SPATIAL_Z] = shape[ome::files::DIM_TEMPORAL_T] = shape[ome::files::DIM_CHANNEL] =
+    shape[ome::files::DIM_MODULO_Z] = shape[ome::files::DIM_MODULO_T] = shape[ome::files::DIM_MODULO_C] = 1;
+  VariantPixelBuffer buf(shape, ifd->getPixelType(),
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, !params.imageplanar));
+  buf = tmp;
+
+  std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+  seriesList.push_back(ome::files::tiff::makeCoreMetadata(*ifd));
+  seriesList.front()->bitsPerPixel = 6U;
+
+  std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+  ome::files::fillMetadata(*meta, seriesList);
+
+  EXPECT_FALSE(tiffwriter.getPackedSamples());
+  tiffwriter.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+  tiffwriter.setInterleaved(!params.imageplanar);
+  tiffwriter.setTileSizeX(params.tilewidth);
+  tiffwriter.setTileSizeY(params.tilelength);
+  tiffwriter.setPackedSamples(true);
+  EXPECT_TRUE(tiffwriter.getPackedSamples());
+  ASSERT_NO_THROW(tiffwriter.setId(testfile));
+  ASSERT_NO_THROW(tiffwriter.saveBytes(0, buf));
+  tiffwriter.close();
+
+  std::shared_ptr<TIFF> written;
+  ASSERT_NO_THROW(written = TIFF::open(testfile, "r"));
+  std::shared_ptr<IFD> writtenifd(written->getDirectoryByIndex(0));
+  EXPECT_EQ(6U, writtenifd->getBitsPerSample());
+  EXPECT_EQ(ome::xml::model::enums::PixelType::UINT8, writtenifd->getPixelType());
+
+  OMETIFFReader tiffreader;
+  ASSERT_NO_THROW(tiffreader.setId(testfile));
+  EXPECT_EQ(6U, tiffreader.getBitsPerPixel());
+  VariantPixelBuffer vb;
+  ASSERT_NO_THROW(tiffreader.openBytes(0, vb));
+  EXPECT_TRUE(tmp == vb);
+}
+
+TEST_P(TIFFWriterTest, lazyValidation)
+{
+  testfile = testfile.parent_path() / (std::string("lazy-") + testfile.filename().string());
+
+  writeAndValidate(false);
+
+  OMETIFFReader tiffreader;
+  EXPECT_TRUE(tiffreader.getStrictValidation());
+  tiffreader.setStrictValidation(false);
+  EXPECT_FALSE(tiffreader.getStrictValidation());
+
+  ASSERT_NO_THROW(tiffreader.setId(testfile));
+  ASSERT_EQ(tiff->directoryCount(), tiffreader.getSeriesCount());
+  for (dimension_size_type i = 0; i < tiffreader.getSeriesCount(); ++i)
+    {
+      tiffreader.setSeries(i);
+
+      VariantPixelBuffer buf;
+      tiff->getDirectoryByIndex(i)->readImage(buf);
+
+      VariantPixelBuffer vb;
+      ASSERT_NO_THROW(tiffreader.openBytes(0, vb));
+      EXPECT_TRUE(buf == vb);
+    }
 }
 
 std::vector<TIFFTestParameters> params(find_tiff_tests());
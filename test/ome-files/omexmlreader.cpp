@@ -0,0 +1,271 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/Base64.h>
+#include <ome/files/in/OMEXMLReader.h>
+
+#include <ome/test/test.h>
+
+using ome::files::FormatException;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::base64Decode;
+using ome::files::in::OMEXMLReader;
+
+namespace
+{
+
+  std::string
+  encode(const std::vector<uint8_t>& data)
+  {
+    static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string text;
+    std::vector<uint8_t>::size_type i = 0;
+    for (; i + 3 <= data.size(); i += 3)
+      {
+        uint32_t group = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | data[i + 2];
+        text += alphabet[group >> 18];
+        text += alphabet[(group >> 12) & 0x3FU];
+        text += alphabet[(group >> 6) & 0x3FU];
+        text += alphabet[group & 0x3FU];
+        // Wrap lines as MIME does.
+        if ((text.size() + 1U) % 77U == 0U)
+          text += '\n';
+      }
+    if (data.size() - i == 1U)
+      {
+        uint32_t group = uint32_t(data[i]) << 16;
+        text += alphabet[group >> 18];
+        text += alphabet[(group >> 12) & 0x3FU];
+        text += "==";
+      }
+    else if (data.size() - i == 2U)
+      {
+        uint32_t group = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8);
+        text += alphabet[group >> 18];
+        text += alphabet[(group >> 12) & 0x3FU];
+        text += alphabet[(group >> 6) & 0x3FU];
+        text += '=';
+      }
+    return text;
+  }
+
+  std::vector<uint8_t>
+  decode(const std::string& text)
+  {
+    std::vector<uint8_t> data;
+    if (!base64Decode(text.data(), text.size(), data))
+      throw FormatException("Invalid base64");
+    return data;
+  }
+
+  std::vector<uint8_t>
+  compress(const std::vector<uint8_t>& data,
+           const std::string&          compression)
+  {
+    std::vector<uint8_t> compressed;
+    {
+      boost::iostreams::filtering_ostream out;
+      if (compression == "zlib")
+        out.push(boost::iostreams::zlib_compressor());
+      else
+        out.push(boost::iostreams::bzip2_compressor());
+      out.push(boost::iostreams::back_inserter(compressed));
+      out.write(reinterpret_cast<const char *>(data.data()),
+                static_cast<std::streamsize>(data.size()));
+    }
+    return compressed;
+  }
+
+  const ome::files::dimension_size_type sizeX = 7U;
+  const ome::files::dimension_size_type sizeY = 5U;
+
+  uint16_t
+  pixel(ome::files::dimension_size_type plane,
+        ome::files::dimension_size_type x,
+        ome::files::dimension_size_type y)
+  {
+    return static_cast<uint16_t>((plane * 1000U) + (y * 100U) + x);
+  }
+
+  std::string
+  binData(ome::files::dimension_size_type plane,
+          bool                            bigEndian,
+          const std::string&              compression)
+  {
+    std::vector<uint8_t> data;
+    for (ome::files::dimension_size_type y = 0; y < sizeY; ++y)
+      for (ome::files::dimension_size_type x = 0; x < sizeX; ++x)
+        {
+          const uint16_t value = pixel(plane, x, y);
+          const uint8_t hi = static_cast<uint8_t>(value >> 8);
+          const uint8_t lo = static_cast<uint8_t>(value & 0xFFU);
+          data.push_back(bigEndian ? hi : lo);
+          data.push_back(bigEndian ? lo : hi);
+        }
+    if (compression != "none")
+      data = compress(data, compression);
+
+    const std::string text(encode(data));
+    return "      <Bin:BinData BigEndian=\"" + std::string(bigEndian ? "true" : "false") +
+      "\" Compression=\"" + compression +
+      "\" Length=\"" + std::to_string(text.size()) + "\">" + text + "</Bin:BinData>\n";
+  }
+
+  boost::filesystem::path
+  writeOMEXML()
+  {
+    boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+    if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+      throw std::runtime_error("Image directory unavailable and could not be created");
+    boost::filesystem::path filename(dir / "bindata.ome.xml");
+
+    std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<OME xmlns=\"http://www.openmicroscopy.org/Schemas/OME/2016-06\"\n"
+        << "     xmlns:Bin=\"http://www.openmicroscopy.org/Schemas/BinaryFile/2016-06\">\n"
+        << "  <Image ID=\"Image:0\" Name=\"bindata\">\n"
+        << "    <Pixels ID=\"Pixels:0\" DimensionOrder=\"XYZCT\" Type=\"uint16\"\n"
+        << "            SizeX=\"" << sizeX << "\" SizeY=\"" << sizeY
+        << "\" SizeZ=\"1\" SizeC=\"1\" SizeT=\"3\">\n"
+        << "      <Channel ID=\"Channel:0:0\" SamplesPerPixel=\"1\"/>\n"
+        << binData(0U, false, "none")
+        << binData(1U, true, "zlib")
+        << binData(2U, false, "bzip2")
+        << "    </Pixels>\n"
+        << "  </Image>\n"
+        << "</OME>\n";
+
+    return filename;
+  }
+
+}
+
+TEST(Base64, Decode)
+{
+  EXPECT_TRUE(decode("").empty());
+  const std::vector<uint8_t> man(decode("TWFu"));
+  EXPECT_EQ(std::string("Man"), std::string(man.begin(), man.end()));
+  const std::vector<uint8_t> padded(decode("TWE=\n"));
+  EXPECT_EQ(std::string("Ma"), std::string(padded.begin(), padded.end()));
+  const std::vector<uint8_t> unpadded(decode(" T W\r\n"));
+  EXPECT_EQ(std::string("M"), std::string(unpadded.begin(), unpadded.end()));
+}
+
+TEST(Base64, RoundTrip)
+{
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<unsigned int> dist(0U, 255U);
+
+  // Sizes covering the vector and scalar paths and all padding.
+  for (std::vector<uint8_t>::size_type size = 0; size < 400U; ++size)
+    {
+      std::vector<uint8_t> data(size);
+      for (auto& value : data)
+        value = static_cast<uint8_t>(dist(gen));
+      ASSERT_EQ(data, decode(encode(data)));
+    }
+}
+
+TEST(Base64, Invalid)
+{
+  std::vector<uint8_t> data;
+  EXPECT_FALSE(base64Decode("A", 1U, data));
+  EXPECT_FALSE(base64Decode("AAAA=", 5U, data));
+  EXPECT_FALSE(base64Decode("AB=C", 4U, data));
+  EXPECT_FALSE(base64Decode("A$AA", 4U, data));
+  EXPECT_FALSE(base64Decode("AAAAAAAAAAAAAAAAAAAA!AAA", 24U, data));
+}
+
+TEST(OMEXMLReader, isThisType)
+{
+  OMEXMLReader reader;
+  const std::string omexml("<?xml version=\"1.0\"?>\n<!-- <Image> -->\n<ome:OME xmlns:ome=\"ns\">");
+  const std::string other("<?xml version=\"1.0\"?>\n<svg>");
+  EXPECT_TRUE(reader.isThisType(reinterpret_cast<const uint8_t *>(omexml.data()), omexml.size()));
+  EXPECT_FALSE(reader.isThisType(reinterpret_cast<const uint8_t *>(other.data()), other.size()));
+}
+
+TEST(OMEXMLReader, openBytes)
+{
+  const boost::filesystem::path filename(writeOMEXML());
+
+  OMEXMLReader reader;
+  ASSERT_NO_THROW(reader.setId(filename));
+  EXPECT_EQ(1U, reader.getSeriesCount());
+  EXPECT_EQ(sizeX, reader.getSizeX());
+  EXPECT_EQ(sizeY, reader.getSizeY());
+  EXPECT_EQ(3U, reader.getImageCount());
+
+  // Planes may be read in any order.
+  for (ome::files::dimension_size_type plane : {2U, 0U, 1U})
+    {
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(reader.openBytes(plane, buf));
+      ASSERT_EQ(sizeX * sizeY, buf.num_elements());
+      for (ome::files::dimension_size_type y = 0; y < sizeY; ++y)
+        for (ome::files::dimension_size_type x = 0; x < sizeX; ++x)
+          ASSERT_EQ(pixel(plane, x, y), buf.array<uint16_t>()[x][y][0][0][0][0][0][0][0]);
+
+      VariantPixelBuffer region;
+      ASSERT_NO_THROW(reader.openBytes(plane, region, 2U, 1U, 3U, 2U));
+      for (ome::files::dimension_size_type y = 0; y < 2U; ++y)
+        for (ome::files::dimension_size_type x = 0; x < 3U; ++x)
+          ASSERT_EQ(pixel(plane, x + 2U, y + 1U), region.array<uint16_t>()[x][y][0][0][0][0][0][0][0]);
+    }
+
+  reader.close();
+  boost::filesystem::remove(filename);
+}
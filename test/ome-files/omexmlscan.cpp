@@ -0,0 +1,195 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ome/files/detail/OMEXMLScan.h>
+
+#include <ome/test/test.h>
+
+using ome::files::detail::OMEXMLBinData;
+using ome::files::detail::OMEXMLSummary;
+using ome::files::detail::scanOMEXML;
+using ome::files::detail::scanOMEXMLBinData;
+
+namespace
+{
+
+  const std::string omexml
+  ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+   "<!-- Warning: this comment is an OME-XML metadata block -->\n"
+   "<OME xmlns=\"http://www.openmicroscopy.org/Schemas/OME/2016-06\"\n"
+   "     UUID='urn:uuid:0b3a8a4a-ab48-4c33-ae3a-6e3d0d9dc6a1'>\n"
+   "  <Image ID=\"Image:0\" Name=\"a &amp; b &#x3c;1&#62;\">\n"
+   "    <Description><![CDATA[<Image ID=\"Fake\"/>]]></Description>\n"
+   "    <Pixels ID=\"Pixels:0\" DimensionOrder=\"XYZCT\" Type=\"uint16\"\n"
+   "            SizeX=\"512\" SizeY=\"256\" SizeZ=\"3\" SizeC=\"2\" SizeT=\"4\">\n"
+   "      <Channel ID=\"Channel:0:0\" SamplesPerPixel=\"1\"/>\n"
+   "      <Channel SamplesPerPixel=\"1\"></Channel>\n"
+   "      <TiffData IFD=\"0\" PlaneCount=\"24\"/>\n"
+   "    </Pixels>\n"
+   "  </Image>\n"
+   "  <Image ID=\"Image:1\">\n"
+   "    <Pixels ID=\"Pixels:1\" DimensionOrder=\"XYCZT\" Type=\"uint8\"\n"
+   "            SizeX=\"64\" SizeY=\"32\" SizeZ=\"1\" SizeC=\"1\" SizeT=\"1\">\n"
+   "      <Channel ID=\"Channel:1:0\"/>\n"
+   "    </Pixels>\n"
+   "  </Image>\n"
+   "  <StructuredAnnotations/>\n"
+   "</OME>\n");
+
+}
+
+TEST(OMEXMLScan, Summary)
+{
+  OMEXMLSummary summary;
+  ASSERT_TRUE(scanOMEXML(omexml, summary));
+
+  EXPECT_EQ(std::string("urn:uuid:0b3a8a4a-ab48-4c33-ae3a-6e3d0d9dc6a1"), summary.uuid);
+  EXPECT_TRUE(summary.binaryOnlyMetadataFile.empty());
+  ASSERT_EQ(2U, summary.images.size());
+
+  const auto& i0(summary.images.at(0));
+  EXPECT_EQ(std::string("Image:0"), i0.id);
+  EXPECT_EQ(std::string("Pixels:0"), i0.pixelsID);
+  EXPECT_EQ(512U, i0.sizeX);
+  EXPECT_EQ(256U, i0.sizeY);
+  EXPECT_EQ(3U, i0.sizeZ);
+  EXPECT_EQ(2U, i0.sizeC);
+  EXPECT_EQ(4U, i0.sizeT);
+  EXPECT_EQ(std::string("uint16"), i0.pixelType);
+  EXPECT_EQ(std::string("XYZCT"), i0.dimensionOrder);
+  EXPECT_EQ(2U, i0.channelCount);
+  EXPECT_EQ(1U, i0.channelsWithoutID);
+  EXPECT_EQ(1U, i0.tiffDataCount);
+
+  const auto& i1(summary.images.at(1));
+  EXPECT_EQ(std::string("Image:1"), i1.id);
+  EXPECT_EQ(std::string("Pixels:1"), i1.pixelsID);
+  EXPECT_EQ(64U, i1.sizeX);
+  EXPECT_EQ(std::string("uint8"), i1.pixelType);
+  EXPECT_EQ(1U, i1.channelCount);
+  EXPECT_EQ(0U, i1.channelsWithoutID);
+  EXPECT_EQ(0U, i1.tiffDataCount);
+}
+
+TEST(OMEXMLScan, BinaryOnly)
+{
+  OMEXMLSummary summary;
+  ASSERT_TRUE(scanOMEXML("<ome:OME xmlns:ome=\"http://www.openmicroscopy.org/Schemas/OME/2016-06\">"
+                         "<ome:BinaryOnly MetadataFile=\"multi-file.companion.ome\" UUID=\"urn:uuid:1\"/>"
+                         "</ome:OME>", summary));
+  EXPECT_EQ(std::string("multi-file.companion.ome"), summary.binaryOnlyMetadataFile);
+  EXPECT_TRUE(summary.images.empty());
+}
+
+TEST(OMEXMLScan, Invalid)
+{
+  OMEXMLSummary summary;
+  EXPECT_FALSE(scanOMEXML("", summary));
+  EXPECT_FALSE(scanOMEXML("ImageJ=1.50\nimages=4\n", summary));
+  EXPECT_FALSE(scanOMEXML("<Image ID=\"Image:0\"/>", summary));
+  EXPECT_FALSE(scanOMEXML("<OME><Image ID=\"Image:0</OME>", summary));
+  EXPECT_FALSE(scanOMEXML("<OME><!-- unterminated </OME>", summary));
+}
+
+TEST(OMEXMLScan, BinData)
+{
+  const std::string omexml
+    ("<OME xmlns=\"http://www.openmicroscopy.org/Schemas/OME/2016-06\"\n"
+     "     xmlns:Bin=\"http://www.openmicroscopy.org/Schemas/BinaryFile/2016-06\">\n"
+     "  <!-- <Bin:BinData> -->\n"
+     "  <Image ID=\"Image:0\"><Pixels ID=\"Pixels:0\">"
+     "<Channel ID=\"Channel:0:0\" Name=\"a>b\"/>"
+     "<Bin:BinData BigEndian=\"true\" Compression=\"zlib\" Length=\"4\">QUJD</Bin:BinData>"
+     "<Bin:BinData BigEndian=\"false\" Length=\"0\"/>"
+     "</Pixels></Image>\n"
+     "  <Image ID=\"Image:1\"><Pixels ID=\"Pixels:1\">"
+     "<Bin:BinData BigEndian=\"false\" Length=\"4\">\nREVG\n</Bin:BinData>"
+     "</Pixels></Image>\n"
+     "  <ROI ID=\"ROI:0\"><Union><Mask ID=\"Shape:0\">"
+     "<Bin:BinData BigEndian=\"false\" Length=\"4\">AAAA</Bin:BinData>"
+     "</Mask></Union></ROI>\n"
+     "</OME>\n");
+
+  std::istringstream stream(omexml);
+  std::string metadata;
+  std::vector<OMEXMLBinData> binData;
+  ASSERT_TRUE(scanOMEXMLBinData(stream, metadata, binData));
+  ASSERT_EQ(3U, binData.size());
+
+  EXPECT_EQ(0U, binData.at(0).image);
+  EXPECT_EQ(std::string("QUJD"), omexml.substr(binData.at(0).offset, binData.at(0).size));
+  EXPECT_EQ(std::string("zlib"), binData.at(0).compression);
+  EXPECT_TRUE(binData.at(0).bigEndian);
+
+  EXPECT_EQ(0U, binData.at(1).image);
+  EXPECT_EQ(0U, binData.at(1).size);
+  EXPECT_TRUE(binData.at(1).compression.empty());
+  EXPECT_FALSE(binData.at(1).bigEndian);
+
+  EXPECT_EQ(1U, binData.at(2).image);
+  EXPECT_EQ(std::string("\nREVG\n"), omexml.substr(binData.at(2).offset, binData.at(2).size));
+
+  // Pixels BinData are replaced; other BinData and comments are kept.
+  EXPECT_EQ(std::string::npos, metadata.find("QUJD"));
+  EXPECT_EQ(std::string::npos, metadata.find("REVG"));
+  EXPECT_NE(std::string::npos, metadata.find("<Channel ID=\"Channel:0:0\" Name=\"a>b\"/><MetadataOnly/></Pixels>"));
+  EXPECT_NE(std::string::npos, metadata.find("<Pixels ID=\"Pixels:1\"><MetadataOnly/></Pixels>"));
+  EXPECT_NE(std::string::npos, metadata.find("AAAA"));
+  EXPECT_NE(std::string::npos, metadata.find("<!-- <Bin:BinData> -->"));
+
+  OMEXMLSummary summary;
+  EXPECT_TRUE(scanOMEXML(metadata, summary));
+  EXPECT_EQ(2U, summary.images.size());
+}
+
+TEST(OMEXMLScan, BinDataInvalid)
+{
+  std::string metadata;
+  std::vector<OMEXMLBinData> binData;
+
+  std::istringstream empty("");
+  EXPECT_FALSE(scanOMEXMLBinData(empty, metadata, binData));
+  std::istringstream root("<Image ID=\"Image:0\"/>");
+  EXPECT_FALSE(scanOMEXMLBinData(root, metadata, binData));
+  std::istringstream truncated("<OME><Image><Pixels><BinData Length=\"4\">QUJD");
+  EXPECT_FALSE(scanOMEXMLBinData(truncated, metadata, binData));
+}
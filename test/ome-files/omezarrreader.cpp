@@ -0,0 +1,399 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/FormatException.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/OMEZarrReader.h>
+#include <ome/files/in/ReaderRegistry.h>
+#include <ome/files/out/OMEZarrWriter.h>
+#include <ome/files/tiff/ByteSource.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::CoreMetadata;
+using ome::files::FormatException;
+using ome::files::PixelBufferBase;
+using ome::files::VariantPixelBuffer;
+using ome::files::in::OMEZarrReader;
+using ome::files::in::ReaderRegistry;
+using ome::files::out::OMEZarrWriter;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  const dimension_size_type sizeX = 37U;
+  const dimension_size_type sizeY = 23U;
+  const dimension_size_type sizeT = 2U;
+  const dimension_size_type samples = 3U;
+  const dimension_size_type chunk = 16U;
+
+  uint16_t
+  pixel(dimension_size_type plane,
+        dimension_size_type sample,
+        dimension_size_type x,
+        dimension_size_type y)
+  {
+    return static_cast<uint16_t>((plane * 10000U) + (sample * 1000U) + (y * sizeX) + x);
+  }
+
+  boost::filesystem::path
+  dataDir()
+  {
+    boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+    if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+      throw std::runtime_error("Image directory unavailable and could not be created");
+    return dir;
+  }
+
+  // Write a single RGB series with OMEZarrWriter.
+  boost::filesystem::path
+  writeZarr(const std::string& name,
+            const std::string& compression)
+  {
+    const boost::filesystem::path root(dataDir() / (name + ".ome.zarr"));
+    boost::filesystem::remove_all(root);
+
+    std::shared_ptr<CoreMetadata> core(std::make_shared<CoreMetadata>());
+    core->sizeX = sizeX;
+    core->sizeY = sizeY;
+    core->sizeZ = 1U;
+    core->sizeT = sizeT;
+    core->sizeC.clear();
+    core->sizeC.push_back(samples);
+    core->pixelType = PixelType::UINT16;
+    core->imageCount = sizeT;
+    core->dimensionOrder = DimensionOrder::XYZCT;
+    core->interleaved = true;
+
+    std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+    seriesList.push_back(core);
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+    ome::files::fillMetadata(*meta, seriesList);
+
+    OMEZarrWriter writer;
+    writer.setMetadataRetrieve(std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta));
+    writer.setTileSizeX(chunk);
+    writer.setTileSizeY(chunk);
+    writer.setCompression(compression);
+    writer.setId(root);
+
+    std::array<VariantPixelBuffer::size_type, 9> shape;
+    shape.fill(1U);
+    shape[ome::files::DIM_SPATIAL_X] = sizeX;
+    shape[ome::files::DIM_SPATIAL_Y] = sizeY;
+    shape[ome::files::DIM_SUBCHANNEL] = samples;
+    for (dimension_size_type plane = 0; plane < sizeT; ++plane)
+      {
+        VariantPixelBuffer buf(shape, PixelType::UINT16,
+                               PixelBufferBase::make_storage_order(DimensionOrder::XYZTC, true));
+        for (dimension_size_type y = 0; y < sizeY; ++y)
+          for (dimension_size_type x = 0; x < sizeX; ++x)
+            for (dimension_size_type s = 0; s < samples; ++s)
+              buf.array<uint16_t>()[x][y][0][0][0][s][0][0][0] = pixel(plane, s, x, y);
+        writer.saveBytes(plane, buf);
+      }
+
+    writer.close();
+    return root;
+  }
+
+  void
+  checkRegion(const OMEZarrReader& reader,
+              dimension_size_type  plane,
+              dimension_size_type  x,
+              dimension_size_type  y,
+              dimension_size_type  w,
+              dimension_size_type  h)
+  {
+    VariantPixelBuffer buf;
+    reader.openBytes(plane, buf, x, y, w, h);
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        for (dimension_size_type s = 0; s < samples; ++s)
+          ASSERT_EQ(pixel(plane, s, x + i, y + j),
+                    buf.array<uint16_t>()[i][j][0][0][0][s][0][0][0]);
+  }
+
+  void
+  checkZarr(const boost::filesystem::path& root,
+            unsigned int                   threads)
+  {
+    OMEZarrReader reader;
+    reader.setDecodeThreads(threads);
+    reader.setId(root);
+
+    EXPECT_EQ(1U, reader.getSeriesCount());
+    EXPECT_EQ(1U, reader.getResolutionCount());
+    EXPECT_EQ(sizeX, reader.getSizeX());
+    EXPECT_EQ(sizeY, reader.getSizeY());
+    EXPECT_EQ(sizeT, reader.getSizeT());
+    EXPECT_EQ(sizeT, reader.getImageCount());
+    EXPECT_EQ(samples, reader.getRGBChannelCount(0U));
+    EXPECT_EQ(PixelType::UINT16, reader.getPixelType());
+    EXPECT_FALSE(reader.isInterleaved());
+    EXPECT_EQ(chunk, reader.getOptimalTileWidth());
+    EXPECT_EQ(chunk, reader.getOptimalTileHeight());
+
+    for (dimension_size_type plane = 0; plane < sizeT; ++plane)
+      {
+        checkRegion(reader, plane, 0U, 0U, sizeX, sizeY);
+        // Regions which do not align with the chunks.
+        checkRegion(reader, plane, 5U, 7U, 20U, 11U);
+        checkRegion(reader, plane, 36U, 22U, 1U, 1U);
+      }
+
+    reader.close();
+  }
+
+  // Byte source for a string held in memory.
+  class StringByteSource : public ome::files::tiff::ByteSource
+  {
+  private:
+    std::string data;
+
+  public:
+    explicit
+    StringByteSource(const std::string& data):
+      data(data)
+    {}
+
+    std::string
+    name() const
+    {
+      return "string";
+    }
+
+    ome::files::tiff::offset_type
+    size() const
+    {
+      return data.size();
+    }
+
+    void
+    read(ome::files::tiff::offset_type offset,
+         void                          *buf,
+         dimension_size_type            size) const
+    {
+      std::memcpy(buf, data.data() + offset, size);
+    }
+  };
+
+  // A two-level multiscales dataset at the root of the store, with
+  // NGFF 0.3 axes, "." separated chunk keys and a missing chunk.
+  std::map<std::string, std::string>
+  makeMultiscales()
+  {
+    std::map<std::string, std::string> keys;
+    keys[".zgroup"] = "{\"zarr_format\": 2}";
+    keys[".zattrs"] =
+      "{\"multiscales\": [{\"version\": \"0.3\", \"name\": \"pyramid\","
+      " \"axes\": [\"y\", \"x\"],"
+      " \"datasets\": [{\"path\": \"0\"}, {\"path\": \"1\"}]}]}";
+    keys["0/.zarray"] =
+      "{\"zarr_format\": 2, \"shape\": [6, 8], \"chunks\": [4, 4],"
+      " \"dtype\": \"|u1\", \"compressor\": null, \"fill_value\": 7,"
+      " \"order\": \"C\", \"filters\": null}";
+    keys["1/.zarray"] =
+      "{\"zarr_format\": 2, \"shape\": [3, 4], \"chunks\": [4, 4],"
+      " \"dtype\": \"|u1\", \"compressor\": null, \"fill_value\": 0,"
+      " \"order\": \"C\", \"filters\": null}";
+
+    // Chunk 1.1 of the full resolution is not stored.
+    for (const std::string cy : {"0", "1"})
+      for (const std::string cx : {"0", "1"})
+        {
+          if (cy == "1" && cx == "1")
+            continue;
+          std::string data(16U, '\0');
+          for (dimension_size_type j = 0; j < 4U; ++j)
+            for (dimension_size_type i = 0; i < 4U; ++i)
+              data[(j * 4U) + i] = static_cast<char>(((std::stoul(cy) * 4U + j) * 8U) + (std::stoul(cx) * 4U) + i);
+          keys["0/" + cy + "." + cx] = data;
+        }
+    std::string data(16U, '\0');
+    for (dimension_size_type j = 0; j < 4U; ++j)
+      for (dimension_size_type i = 0; i < 4U; ++i)
+        data[(j * 4U) + i] = static_cast<char>(100U + (j * 4U) + i);
+    keys["1/0.0"] = data;
+
+    return keys;
+  }
+
+  void
+  checkMultiscales(OMEZarrReader& reader)
+  {
+    EXPECT_EQ(1U, reader.getSeriesCount());
+    EXPECT_EQ(2U, reader.getResolutionCount());
+    EXPECT_EQ(PixelType::UINT8, reader.getPixelType());
+    EXPECT_EQ(1U, reader.getImageCount());
+
+    VariantPixelBuffer buf;
+    EXPECT_EQ(8U, reader.getSizeX());
+    EXPECT_EQ(6U, reader.getSizeY());
+    reader.openBytes(0U, buf);
+    for (dimension_size_type y = 0; y < 6U; ++y)
+      for (dimension_size_type x = 0; x < 8U; ++x)
+        {
+          const uint8_t expected = (x >= 4U && y >= 4U) ? 7U : static_cast<uint8_t>((y * 8U) + x);
+          ASSERT_EQ(expected, buf.array<uint8_t>()[x][y][0][0][0][0][0][0][0]);
+        }
+
+    reader.setResolution(1U);
+    EXPECT_EQ(4U, reader.getSizeX());
+    EXPECT_EQ(3U, reader.getSizeY());
+    reader.openBytes(0U, buf);
+    for (dimension_size_type y = 0; y < 3U; ++y)
+      for (dimension_size_type x = 0; x < 4U; ++x)
+        ASSERT_EQ(static_cast<uint8_t>(100U + (y * 4U) + x),
+                  buf.array<uint8_t>()[x][y][0][0][0][0][0][0][0]);
+  }
+
+  boost::filesystem::path
+  writeKeys(const std::string&                        name,
+            const std::map<std::string, std::string>& keys)
+  {
+    const boost::filesystem::path root(dataDir() / (name + ".ome.zarr"));
+    boost::filesystem::remove_all(root);
+    for (const auto& key : keys)
+      {
+        const boost::filesystem::path path(root / key.first);
+        boost::filesystem::create_directories(path.parent_path());
+        std::ofstream out(path.string().c_str(), std::ios::out | std::ios::binary);
+        out.write(key.second.data(), static_cast<std::streamsize>(key.second.size()));
+      }
+    return root;
+  }
+
+}
+
+TEST(OMEZarrReader, Read)
+{
+  const boost::filesystem::path root(writeZarr("zarrread", "default"));
+  checkZarr(root, 1U);
+  boost::filesystem::remove_all(root);
+}
+
+TEST(OMEZarrReader, Compression)
+{
+  for (const std::string compression : {"zlib", "bz2"})
+    {
+      const boost::filesystem::path root(writeZarr("zarrread" + compression, compression));
+      checkZarr(root, 1U);
+      boost::filesystem::remove_all(root);
+    }
+}
+
+TEST(OMEZarrReader, Parallel)
+{
+  const boost::filesystem::path root(writeZarr("zarrreadparallel", "zlib"));
+  checkZarr(root, 4U);
+  boost::filesystem::remove_all(root);
+}
+
+TEST(OMEZarrReader, Multiscales)
+{
+  const boost::filesystem::path root(writeKeys("zarrmultiscales", makeMultiscales()));
+
+  OMEZarrReader reader;
+  reader.setId(root);
+  checkMultiscales(reader);
+  reader.close();
+
+  boost::filesystem::remove_all(root);
+}
+
+TEST(OMEZarrReader, Store)
+{
+  const std::map<std::string, std::string> keys(makeMultiscales());
+
+  OMEZarrReader reader;
+  reader.setStore([&keys](const std::string& key) -> std::shared_ptr<ome::files::tiff::ByteSource>
+                  {
+                    auto found = keys.find(key);
+                    if (found == keys.end())
+                      return std::shared_ptr<ome::files::tiff::ByteSource>();
+                    return std::make_shared<StringByteSource>(found->second);
+                  });
+  EXPECT_TRUE(static_cast<bool>(reader.getStore()));
+  reader.setId("memory.ome.zarr");
+  checkMultiscales(reader);
+  reader.close();
+}
+
+TEST(OMEZarrReader, UnsupportedCompressor)
+{
+  std::map<std::string, std::string> keys(makeMultiscales());
+  keys["0/.zarray"] =
+    "{\"zarr_format\": 2, \"shape\": [6, 8], \"chunks\": [4, 4],"
+    " \"dtype\": \"|u1\", \"compressor\": {\"id\": \"blosc\"}, \"fill_value\": 0,"
+    " \"order\": \"C\", \"filters\": null}";
+  const boost::filesystem::path root(writeKeys("zarrblosc", keys));
+
+  OMEZarrReader reader;
+  EXPECT_THROW(reader.setId(root), FormatException);
+
+  boost::filesystem::remove_all(root);
+}
+
+TEST(OMEZarrReader, Registry)
+{
+  const boost::filesystem::path root(writeKeys("zarrregistry", makeMultiscales()));
+
+  ReaderRegistry registry;
+  std::shared_ptr<ome::files::FormatReader> reader(registry.getReader(root));
+  EXPECT_TRUE(static_cast<bool>(std::dynamic_pointer_cast<OMEZarrReader>(reader)));
+
+  boost::filesystem::remove_all(root);
+}
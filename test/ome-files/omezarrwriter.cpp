@@ -0,0 +1,292 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <ome/files/CoreMetadata.h>
+#include <ome/files/FormatException.h>
+#include <ome/files/MetadataTools.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/out/OMEZarrWriter.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::CoreMetadata;
+using ome::files::FormatException;
+using ome::files::PixelBufferBase;
+using ome::files::VariantPixelBuffer;
+using ome::files::out::OMEZarrWriter;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  const dimension_size_type sizeX = 37U;
+  const dimension_size_type sizeY = 23U;
+  const dimension_size_type sizeT = 2U;
+  const dimension_size_type samples = 3U;
+  const dimension_size_type chunk = 16U;
+
+  uint16_t
+  pixel(dimension_size_type plane,
+        dimension_size_type sample,
+        dimension_size_type x,
+        dimension_size_type y)
+  {
+    return static_cast<uint16_t>((plane * 10000U) + (sample * 1000U) + (y * sizeX) + x);
+  }
+
+  std::shared_ptr<::ome::xml::meta::MetadataRetrieve>
+  makeMetadata()
+  {
+    std::shared_ptr<CoreMetadata> core(std::make_shared<CoreMetadata>());
+    core->sizeX = sizeX;
+    core->sizeY = sizeY;
+    core->sizeZ = 1U;
+    core->sizeT = sizeT;
+    core->sizeC.clear();
+    core->sizeC.push_back(samples);
+    core->pixelType = PixelType::UINT16;
+    core->imageCount = sizeT;
+    core->dimensionOrder = DimensionOrder::XYZCT;
+    core->interleaved = true;
+
+    std::vector<std::shared_ptr<CoreMetadata>> seriesList;
+    seriesList.push_back(core);
+
+    std::shared_ptr<::ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<::ome::xml::meta::OMEXMLMetadata>());
+    ome::files::fillMetadata(*meta, seriesList);
+    return std::static_pointer_cast<::ome::xml::meta::MetadataRetrieve>(meta);
+  }
+
+  // Interleaved region of a plane.
+  VariantPixelBuffer
+  makeRegion(dimension_size_type plane,
+             dimension_size_type x,
+             dimension_size_type y,
+             dimension_size_type w,
+             dimension_size_type h)
+  {
+    std::array<VariantPixelBuffer::size_type, 9> shape;
+    shape.fill(1U);
+    shape[ome::files::DIM_SPATIAL_X] = w;
+    shape[ome::files::DIM_SPATIAL_Y] = h;
+    shape[ome::files::DIM_SUBCHANNEL] = samples;
+
+    VariantPixelBuffer buf(shape, PixelType::UINT16,
+                           PixelBufferBase::make_storage_order(DimensionOrder::XYZTC, true));
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        for (dimension_size_type s = 0; s < samples; ++s)
+          buf.array<uint16_t>()[i][j][0][0][0][s][0][0][0] = pixel(plane, s, x + i, y + j);
+    return buf;
+  }
+
+  std::string
+  readFile(const boost::filesystem::path& path)
+  {
+    std::ifstream in(path.string().c_str(), std::ios::in | std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  }
+
+  std::string
+  decompress(const std::string& data,
+             const std::string& compression)
+  {
+    boost::iostreams::filtering_istream in;
+    if (compression == "zlib")
+      in.push(boost::iostreams::zlib_decompressor());
+    else if (compression == "bz2")
+      in.push(boost::iostreams::bzip2_decompressor());
+    in.push(boost::iostreams::array_source(data.data(), data.size()));
+    return std::string((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  }
+
+  void
+  checkChunks(const boost::filesystem::path& root,
+              const std::string&             compression)
+  {
+    for (dimension_size_type t = 0; t < sizeT; ++t)
+      for (dimension_size_type s = 0; s < samples; ++s)
+        for (dimension_size_type cy = 0; cy * chunk < sizeY; ++cy)
+          for (dimension_size_type cx = 0; cx * chunk < sizeX; ++cx)
+            {
+              const boost::filesystem::path path
+                (root / "0" / "0" / std::to_string(t) / std::to_string(s) / "0" /
+                 std::to_string(cy) / std::to_string(cx));
+              ASSERT_TRUE(boost::filesystem::exists(path)) << path;
+
+              const std::string data(decompress(readFile(path), compression));
+              ASSERT_EQ(chunk * chunk * sizeof(uint16_t), data.size());
+              const uint16_t *values = reinterpret_cast<const uint16_t *>(data.data());
+
+              // Edge chunks are padded with zeros.
+              for (dimension_size_type j = 0; j < chunk; ++j)
+                for (dimension_size_type i = 0; i < chunk; ++i)
+                  {
+                    const dimension_size_type x = (cx * chunk) + i;
+                    const dimension_size_type y = (cy * chunk) + j;
+                    const uint16_t expected = (x < sizeX && y < sizeY) ? pixel(t, s, x, y) : 0U;
+                    ASSERT_EQ(expected, values[(j * chunk) + i]);
+                  }
+            }
+  }
+
+  boost::filesystem::path
+  writeZarr(const std::string& name,
+            const std::string& compression,
+            unsigned int       threads)
+  {
+    const boost::filesystem::path root(PROJECT_BINARY_DIR "/test/ome-files/data/" + name + ".ome.zarr");
+    boost::filesystem::remove_all(root);
+
+    std::shared_ptr<::ome::xml::meta::MetadataRetrieve> retrieve(makeMetadata());
+
+    OMEZarrWriter writer;
+    writer.setMetadataRetrieve(retrieve);
+    writer.setTileSizeX(chunk);
+    writer.setTileSizeY(chunk);
+    writer.setCompression(compression);
+    writer.setWriteThreads(threads);
+    writer.setId(root);
+
+    EXPECT_EQ(chunk, writer.getTileSizeX());
+    EXPECT_EQ(chunk, writer.getTileSizeY());
+
+    // Plane 1 whole, then plane 0 in regions which do not align
+    // with the chunks.
+    VariantPixelBuffer plane1(makeRegion(1U, 0U, 0U, sizeX, sizeY));
+    writer.saveBytes(1U, plane1);
+    for (dimension_size_type y = 0; y < sizeY; y += 5U)
+      {
+        const dimension_size_type h = std::min(dimension_size_type(5U), sizeY - y);
+        VariantPixelBuffer left(makeRegion(0U, 0U, y, 20U, h));
+        writer.saveBytes(0U, left, 0U, y, 20U, h);
+        VariantPixelBuffer right(makeRegion(0U, 20U, y, sizeX - 20U, h));
+        writer.saveBytes(0U, right, 20U, y, sizeX - 20U, h);
+      }
+
+    writer.close();
+    return root;
+  }
+
+}
+
+TEST(OMEZarrWriter, CompressionTypes)
+{
+  OMEZarrWriter writer;
+  const std::set<std::string>& ctypes = writer.getCompressionTypes();
+  EXPECT_EQ(1U, ctypes.count("default"));
+  EXPECT_EQ(1U, ctypes.count("zlib"));
+  EXPECT_EQ(1U, ctypes.count("bz2"));
+}
+
+TEST(OMEZarrWriter, Layout)
+{
+  const boost::filesystem::path root(writeZarr("zarrlayout", "default", 1U));
+
+  EXPECT_TRUE(boost::filesystem::exists(root / ".zgroup"));
+  EXPECT_NE(std::string::npos, readFile(root / ".zattrs").find("\"bioformats2raw.layout\": 3"));
+  EXPECT_TRUE(boost::filesystem::exists(root / "OME" / ".zgroup"));
+  EXPECT_NE(std::string::npos, readFile(root / "OME" / ".zattrs").find("\"series\": [\"0\"]"));
+  EXPECT_NE(std::string::npos, readFile(root / "OME" / "METADATA.ome.xml").find("MetadataOnly"));
+  EXPECT_NE(std::string::npos, readFile(root / "0" / ".zattrs").find("\"multiscales\""));
+
+  const std::string zarray(readFile(root / "0" / "0" / ".zarray"));
+  EXPECT_NE(std::string::npos, zarray.find("\"shape\": [2, 3, 1, 23, 37]"));
+  EXPECT_NE(std::string::npos, zarray.find("\"chunks\": [1, 1, 1, 16, 16]"));
+  EXPECT_NE(std::string::npos, zarray.find("\"compressor\": null"));
+  EXPECT_NE(std::string::npos, zarray.find("u2\""));
+
+  checkChunks(root, "default");
+  boost::filesystem::remove_all(root);
+}
+
+TEST(OMEZarrWriter, Compression)
+{
+  for (const std::string compression : {"zlib", "bz2"})
+    {
+      const boost::filesystem::path root(writeZarr("zarr" + compression, compression, 1U));
+      EXPECT_NE(std::string::npos,
+                readFile(root / "0" / "0" / ".zarray").find("\"id\": \"" + compression + "\""));
+      checkChunks(root, compression);
+      boost::filesystem::remove_all(root);
+    }
+}
+
+TEST(OMEZarrWriter, Parallel)
+{
+  const boost::filesystem::path root(writeZarr("zarrparallel", "zlib", 4U));
+  checkChunks(root, "zlib");
+  boost::filesystem::remove_all(root);
+}
+
+TEST(OMEZarrWriter, InvalidRegion)
+{
+  const boost::filesystem::path root(PROJECT_BINARY_DIR "/test/ome-files/data/zarrinvalid.ome.zarr");
+  boost::filesystem::remove_all(root);
+
+  std::shared_ptr<::ome::xml::meta::MetadataRetrieve> retrieve(makeMetadata());
+  OMEZarrWriter writer;
+  writer.setMetadataRetrieve(retrieve);
+  writer.setId(root);
+
+  VariantPixelBuffer buf(makeRegion(0U, 30U, 0U, 10U, 1U));
+  EXPECT_THROW(writer.saveBytes(0U, buf, 30U, 0U, 10U, 1U), FormatException);
+  EXPECT_THROW(writer.saveBytes(0U, buf, 0U, 0U, 10U, 2U), FormatException);
+
+  writer.close();
+  boost::filesystem::remove_all(root);
+}
@@ -53,6 +53,7 @@ using ome::files::Dimensions;
 using ome::files::PixelEndianProperties;
 using ome::files::PixelBufferBase;
 using ome::files::PixelBuffer;
+using ome::files::PixelRow;
 typedef ome::xml::model::enums::DimensionOrder DO;
 typedef ome::xml::model::enums::PixelType PT;
 
@@ -224,6 +225,85 @@ TYPED_TEST_P(PixelBufferType, Operators)
   test_operators(buf1, buf2);
 }
 
+TYPED_TEST_P(PixelBufferType, StorageOrderOperators)
+{
+  const PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZTC, true));
+  const PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZTC, false));
+
+  PixelBuffer<TypeParam> buf1(boost::extents[4][3][1][1][1][2][1][1][1], PT::UINT8, ome::files::ENDIAN_NATIVE, interleaved);
+  PixelBuffer<TypeParam> buf2(boost::extents[4][3][1][1][1][2][1][1][1], PT::UINT8, ome::files::ENDIAN_NATIVE, interleaved);
+  PixelBuffer<TypeParam> buf3(boost::extents[4][3][1][1][1][2][1][1][1], PT::UINT8, ome::files::ENDIAN_NATIVE, planar);
+
+  uint32_t i = 0;
+  typename PixelBuffer<TypeParam>::indices_type idx;
+  idx[2] = idx[3] = idx[4] = idx[6] = idx[7] = idx[8] = 0;
+  for (idx[0] = 0; idx[0] < 4; ++idx[0])
+    for (idx[1] = 0; idx[1] < 3; ++idx[1])
+      for (idx[5] = 0; idx[5] < 2; ++idx[5])
+        {
+          buf1.at(idx) = buf2.at(idx) = buf3.at(idx) = pixel_value<TypeParam>(i++);
+        }
+
+  // Same layout (contiguous comparison) and differing layout
+  // (element-wise comparison).
+  EXPECT_TRUE(buf1 == buf2);
+  EXPECT_TRUE(buf1 == buf3);
+  EXPECT_FALSE(buf1 != buf3);
+
+  // Assignment with the same and differing layout.
+  PixelBuffer<TypeParam> copy1(boost::extents[4][3][1][1][1][2][1][1][1], PT::UINT8, ome::files::ENDIAN_NATIVE, interleaved);
+  PixelBuffer<TypeParam> copy3(boost::extents[4][3][1][1][1][2][1][1][1], PT::UINT8, ome::files::ENDIAN_NATIVE, planar);
+  copy1 = buf1;
+  copy3 = buf1;
+  EXPECT_NE(buf1.data(), copy1.data());
+  EXPECT_TRUE(copy1 == buf1);
+  EXPECT_TRUE(copy3 == buf3);
+  EXPECT_TRUE(copy3 == buf1);
+
+  idx[0] = 3;
+  idx[1] = 2;
+  idx[5] = 1;
+  buf2.at(idx) = buf3.at(idx) = buf1.at(typename PixelBuffer<TypeParam>::indices_type{{0, 0, 0, 0, 0, 0, 0, 0, 0}});
+  EXPECT_FALSE(buf1 == buf2);
+  EXPECT_FALSE(buf1 == buf3);
+  EXPECT_TRUE(buf1 != buf2);
+}
+
+TYPED_TEST_P(PixelBufferType, StorageOrderTranspose)
+{
+  const PixelBufferBase::storage_order_type interleaved(PixelBufferBase::make_storage_order(DO::XYZCT, true));
+  const PixelBufferBase::storage_order_type planar(PixelBufferBase::make_storage_order(DO::XYZCT, false));
+
+  // Unrolled (2-4 samples) and blocked (1, 5 samples) transposition.
+  for (uint16_t samples = 1; samples <= 5; ++samples)
+    {
+      PixelBuffer<TypeParam> chunky(boost::extents[67][70][2][1][1][samples][1][1][1], PT::UINT8, ome::files::ENDIAN_NATIVE, interleaved);
+      PixelBuffer<TypeParam> separate(boost::extents[67][70][2][1][1][samples][1][1][1], PT::UINT8, ome::files::ENDIAN_NATIVE, planar);
+      PixelBuffer<TypeParam> roundtrip(boost::extents[67][70][2][1][1][samples][1][1][1], PT::UINT8, ome::files::ENDIAN_NATIVE, interleaved);
+
+      uint32_t i = 0;
+      typename PixelBuffer<TypeParam>::indices_type idx;
+      idx[3] = idx[4] = idx[6] = idx[7] = idx[8] = 0;
+      for (idx[2] = 0; idx[2] < 2; ++idx[2])
+        for (idx[1] = 0; idx[1] < 70; ++idx[1])
+          for (idx[0] = 0; idx[0] < 67; ++idx[0])
+            for (idx[5] = 0; idx[5] < samples; ++idx[5])
+              chunky.at(idx) = pixel_value<TypeParam>(i++);
+
+      separate = chunky;
+      roundtrip = separate;
+
+      for (idx[2] = 0; idx[2] < 2; ++idx[2])
+        for (idx[1] = 0; idx[1] < 70; ++idx[1])
+          for (idx[0] = 0; idx[0] < 67; ++idx[0])
+            for (idx[5] = 0; idx[5] < samples; ++idx[5])
+              {
+                ASSERT_EQ(chunky.at(idx), separate.at(idx));
+                ASSERT_EQ(chunky.at(idx), roundtrip.at(idx));
+              }
+    }
+}
+
 TYPED_TEST_P(PixelBufferType, Array)
 {
   PixelBuffer<TypeParam> buf(boost::extents[10][10][1][1][1][1][1][1][1]);
@@ -427,6 +507,41 @@ TYPED_TEST_P(PixelBufferType, SetIndex)
       }
 }
 
+TYPED_TEST_P(PixelBufferType, GetRow)
+{
+  PixelBuffer<TypeParam> buf(boost::extents[5][4][1][1][1][3][1][1][1]);
+  const PixelBuffer<TypeParam>& cbuf(buf);
+
+  for (uint32_t j = 0; j < 4; ++j)
+    for (uint32_t s = 0; s < 3; ++s)
+      {
+        PixelRow<TypeParam> row(buf.row(j, 0, 0, 0, s));
+        PixelRow<const TypeParam> crow(cbuf.row(j, 0, 0, 0, s));
+
+        EXPECT_EQ(5U, row.width);
+        EXPECT_EQ(buf.strides()[ome::files::DIM_SPATIAL_X], row.xstride);
+        EXPECT_EQ(buf.strides()[ome::files::DIM_SUBCHANNEL], row.sstride);
+        EXPECT_EQ(buf.strides()[ome::files::DIM_SPATIAL_Y], row.ystride);
+        EXPECT_EQ(row.data, crow.data);
+        EXPECT_TRUE(row.contiguous(3U));
+
+        for (uint32_t i = 0; i < 5; ++i)
+          {
+            typename PixelBuffer<TypeParam>::indices_type idx;
+            idx[0] = i;
+            idx[1] = j;
+            idx[2] = idx[3] = idx[4] = idx[6] = idx[7] = idx[8] = 0;
+            idx[5] = s;
+            EXPECT_EQ(&buf.at(idx), row.data + (i * row.xstride));
+            if (j < 3)
+              {
+                idx[1] = j + 1;
+                EXPECT_EQ(&buf.at(idx), row.data + (i * row.xstride) + row.ystride);
+              }
+          }
+      }
+}
+
 TYPED_TEST_P(PixelBufferType, SetIndexDeathTest)
 {
 #if !defined(NDEBUG) && !defined(BOOST_DISABLE_ASSERTS)
@@ -515,6 +630,8 @@ REGISTER_TYPED_TEST_CASE_P(PixelBufferType,
                            ConstructRangeRef,
                            ConstructCopy,
                            Operators,
+                           StorageOrderOperators,
+                           StorageOrderTranspose,
                            Array,
                            Data,
                            Valid,
@@ -528,6 +645,7 @@ REGISTER_TYPED_TEST_CASE_P(PixelBufferType,
                            StorageOrder,
                            GetIndex,
                            SetIndex,
+                           GetRow,
                            SetIndexDeathTest,
                            StreamInput,
                            StreamOutput);
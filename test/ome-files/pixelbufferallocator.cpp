@@ -0,0 +1,184 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/PixelBufferAllocator.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferAllocator;
+using ome::files::PixelBufferPoolAllocator;
+using ome::files::VariantPixelBuffer;
+typedef ome::xml::model::enums::PixelType PT;
+
+namespace
+{
+
+  void
+  check_allocator(PixelBufferAllocator& allocator)
+  {
+    const dimension_size_type size = 3U * 1024U * 1024U + 17U;
+    void *ptr = allocator.allocate(size);
+    ASSERT_NE(nullptr, ptr);
+    std::memset(ptr, 0x5A, static_cast<std::size_t>(size));
+    EXPECT_EQ(0x5A, static_cast<unsigned char *>(ptr)[size - 1U]);
+    allocator.deallocate(ptr, size);
+  }
+
+}
+
+TEST(PixelBufferAllocator, Standard)
+{
+  check_allocator(*PixelBufferAllocator::standard());
+}
+
+TEST(PixelBufferAllocator, HugePages)
+{
+  check_allocator(*PixelBufferAllocator::hugePages());
+}
+
+TEST(PixelBufferAllocator, NumaNode)
+{
+  check_allocator(*PixelBufferAllocator::numaNode(0U));
+  check_allocator(*PixelBufferAllocator::numaNode(0U, true));
+  // Nonexistent nodes fall back to the default policy.
+  check_allocator(*PixelBufferAllocator::numaNode(1000U));
+}
+
+TEST(PixelBufferPoolAllocator, Reuse)
+{
+  auto pool = PixelBufferPoolAllocator::create(PixelBufferAllocator::standard(), 1024U);
+
+  void *a = pool->allocate(256U);
+  pool->deallocate(a, 256U);
+  EXPECT_EQ(256U, pool->size());
+
+  void *b = pool->allocate(128U);
+  EXPECT_EQ(256U, pool->size());
+  void *c = pool->allocate(256U);
+  EXPECT_EQ(a, c);
+  EXPECT_EQ(0U, pool->size());
+
+  pool->deallocate(b, 128U);
+  pool->deallocate(c, 256U);
+  EXPECT_EQ(384U, pool->size());
+
+  pool->clear();
+  EXPECT_EQ(0U, pool->size());
+}
+
+TEST(PixelBufferPoolAllocator, Limit)
+{
+  auto pool = PixelBufferPoolAllocator::create(PixelBufferAllocator::standard(), 512U);
+  EXPECT_EQ(512U, pool->getLimit());
+
+  void *a = pool->allocate(400U);
+  void *b = pool->allocate(400U);
+  pool->deallocate(a, 400U);
+  pool->deallocate(b, 400U);
+  EXPECT_EQ(400U, pool->size());
+
+  void *c = pool->allocate(100U);
+  pool->deallocate(c, 100U);
+  EXPECT_EQ(500U, pool->size());
+
+  pool->setLimit(200U);
+  EXPECT_EQ(200U, pool->getLimit());
+  EXPECT_EQ(100U, pool->size());
+}
+
+TEST(PixelBufferAllocator, PixelBuffer)
+{
+  auto pool = PixelBufferPoolAllocator::create();
+
+  {
+    PixelBuffer<uint16_t> buf(boost::extents[64][32][1][1][1][3][1][1][1],
+                              PT::UINT16, ome::files::ENDIAN_NATIVE,
+                              PixelBuffer<uint16_t>::default_storage_order(),
+                              pool);
+    EXPECT_TRUE(buf.managed());
+    EXPECT_EQ(pool, buf.allocator());
+    EXPECT_EQ(64U * 32U * 3U, buf.num_elements());
+    for (PixelBuffer<uint16_t>::size_type i = 0; i < buf.num_elements(); ++i)
+      EXPECT_EQ(0U, buf.data()[i]);
+
+    PixelBuffer<uint16_t>::indices_type idx;
+    idx.fill(0);
+    idx[ome::files::DIM_SPATIAL_X] = 63;
+    idx[ome::files::DIM_SPATIAL_Y] = 31;
+    idx[ome::files::DIM_SUBCHANNEL] = 2;
+    buf.at(idx) = 42U;
+    EXPECT_EQ(42U, buf.at(idx));
+
+    // Shallow copies share the storage.
+    PixelBuffer<uint16_t> copy(buf);
+    EXPECT_EQ(buf.data(), copy.data());
+    EXPECT_EQ(0U, pool->size());
+  }
+
+  // Storage is returned to the pool with the last reference.
+  EXPECT_EQ(64U * 32U * 3U * sizeof(uint16_t), pool->size());
+
+  PixelBuffer<uint16_t> plain(boost::extents[2][2][1][1][1][1][1][1][1], PT::UINT16);
+  EXPECT_TRUE(plain.managed());
+  EXPECT_FALSE(plain.allocator());
+}
+
+TEST(PixelBufferAllocator, VariantPixelBuffer)
+{
+  const std::shared_ptr<PixelBufferAllocator>& huge(PixelBufferAllocator::hugePages());
+
+  VariantPixelBuffer buf;
+  EXPECT_FALSE(buf.allocator());
+
+  buf.setBuffer(boost::extents[16][16][1][1][1][1][1][1][1], PT::FLOAT,
+                ome::files::PixelBufferBase::default_storage_order(), huge);
+  EXPECT_EQ(PT::FLOAT, buf.pixelType());
+  EXPECT_EQ(256U, buf.num_elements());
+  EXPECT_TRUE(buf.managed());
+  EXPECT_EQ(huge, buf.allocator());
+
+  // Shallow copies share the allocator.
+  VariantPixelBuffer copy(buf);
+  EXPECT_EQ(huge, copy.allocator());
+}
@@ -0,0 +1,203 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include <ome/files/PixelConversion.h>
+#include <ome/files/VariantPixelBuffer.h>
+
+#include <ome/test/test.h>
+
+using ome::files::PixelConversion;
+using ome::files::VariantPixelBuffer;
+typedef ome::xml::model::enums::PixelType PT;
+
+TEST(PixelConversion, ClampIntegers)
+{
+  const std::vector<int16_t> src{-300, -1, 0, 1, 127, 255, 256, 32767};
+  std::vector<uint8_t> dest(src.size());
+
+  PixelConversion conv;
+  EXPECT_EQ(ome::files::CONVERT_CLAMP, conv.scaling());
+  conv.convert(src.data(), dest.data(), src.size());
+
+  const std::vector<uint8_t> expected{0, 0, 0, 1, 127, 255, 255, 255};
+  EXPECT_EQ(expected, dest);
+}
+
+TEST(PixelConversion, ClampFloat)
+{
+  const std::vector<float> src{-1.6f, -0.4f, 0.5f, 1.49f, 99.5f, 1000.0f};
+  std::vector<int8_t> dest(src.size());
+
+  PixelConversion().convert(src.data(), dest.data(), src.size());
+
+  const std::vector<int8_t> expected{-2, 0, 1, 1, 100, 127};
+  EXPECT_EQ(expected, dest);
+
+  std::vector<double> back(dest.size());
+  PixelConversion().convert(dest.data(), back.data(), dest.size());
+  EXPECT_DOUBLE_EQ(-2.0, back[0]);
+  EXPECT_DOUBLE_EQ(127.0, back[5]);
+}
+
+TEST(PixelConversion, ScaleTypeRange)
+{
+  const std::vector<uint16_t> src{0, 32768, 65535};
+  std::vector<float> dest(src.size());
+
+  PixelConversion conv(ome::files::CONVERT_SCALE);
+  conv.convert(src.data(), dest.data(), src.size());
+  EXPECT_FLOAT_EQ(0.0f, dest[0]);
+  EXPECT_NEAR(0.5f, dest[1], 1e-4f);
+  EXPECT_FLOAT_EQ(1.0f, dest[2]);
+
+  std::vector<uint8_t> preview(dest.size());
+  conv.convert(dest.data(), preview.data(), dest.size());
+  const std::vector<uint8_t> expected{0, 128, 255};
+  EXPECT_EQ(expected, preview);
+
+  std::vector<uint16_t> wide(src.size());
+  conv.convert(preview.data(), wide.data(), preview.size());
+  EXPECT_EQ(0U, wide[0]);
+  EXPECT_EQ(65535U, wide[2]);
+}
+
+TEST(PixelConversion, ScaleSigned)
+{
+  const std::vector<int8_t> src{-128, 0, 127};
+  std::vector<uint8_t> dest(src.size());
+
+  PixelConversion(ome::files::CONVERT_SCALE).convert(src.data(), dest.data(), src.size());
+  const std::vector<uint8_t> expected{0, 128, 255};
+  EXPECT_EQ(expected, dest);
+}
+
+TEST(PixelConversion, Range)
+{
+  const std::vector<uint32_t> src{100, 150, 200, 300};
+  std::vector<uint8_t> dest(src.size());
+
+  PixelConversion conv(100.0, 200.0);
+  EXPECT_EQ(ome::files::CONVERT_RANGE, conv.scaling());
+  conv.convert(src.data(), dest.data(), src.size());
+  const std::vector<uint8_t> expected{0, 128, 255, 255};
+  EXPECT_EQ(expected, dest);
+
+  // Empty ranges map to the destination minimum.
+  PixelConversion(5.0, 5.0).convert(src.data(), dest.data(), src.size());
+  EXPECT_EQ(std::vector<uint8_t>(4, 0), dest);
+}
+
+TEST(PixelConversion, Bit)
+{
+  const std::vector<uint16_t> src{0, 1, 32767, 32768, 65535};
+  bool dest[5];
+
+  PixelConversion().convert(src.data(), dest, src.size());
+  EXPECT_FALSE(dest[0]);
+  EXPECT_TRUE(dest[1]);
+  EXPECT_TRUE(dest[4]);
+
+  PixelConversion(ome::files::CONVERT_SCALE).convert(src.data(), dest, src.size());
+  EXPECT_FALSE(dest[1]);
+  EXPECT_FALSE(dest[2]);
+  EXPECT_TRUE(dest[3]);
+  EXPECT_TRUE(dest[4]);
+
+  std::vector<uint8_t> bytes(5);
+  PixelConversion(ome::files::CONVERT_SCALE).convert(dest, bytes.data(), bytes.size());
+  const std::vector<uint8_t> expected{0, 0, 0, 255, 255};
+  EXPECT_EQ(expected, bytes);
+}
+
+TEST(PixelConversion, Complex)
+{
+  const std::vector<std::complex<float>> src{{3.0f, 4.0f}, {0.0f, -2.0f}};
+  std::vector<uint16_t> magnitude(src.size());
+
+  PixelConversion().convert(src.data(), magnitude.data(), src.size());
+  EXPECT_EQ(5U, magnitude[0]);
+  EXPECT_EQ(2U, magnitude[1]);
+
+  std::vector<std::complex<double>> wide(src.size());
+  PixelConversion().convert(src.data(), wide.data(), src.size());
+  EXPECT_DOUBLE_EQ(3.0, wide[0].real());
+  EXPECT_DOUBLE_EQ(-2.0, wide[1].imag());
+
+  std::vector<std::complex<float>> cplx(magnitude.size());
+  PixelConversion().convert(magnitude.data(), cplx.data(), magnitude.size());
+  EXPECT_FLOAT_EQ(5.0f, cplx[0].real());
+  EXPECT_FLOAT_EQ(0.0f, cplx[0].imag());
+}
+
+TEST(PixelConversion, Identity)
+{
+  const std::vector<int32_t> src{-2147483647 - 1, 0, 2147483647};
+  std::vector<int32_t> dest(src.size());
+
+  PixelConversion(ome::files::CONVERT_SCALE).convert(src.data(), dest.data(), src.size());
+  EXPECT_EQ(src, dest);
+}
+
+TEST(PixelConversion, VariantPixelBuffer)
+{
+  VariantPixelBuffer buf(boost::extents[4][2][1][1][1][3][1][1][1], PT::UINT16,
+                         ome::files::PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+  uint16_t *data = buf.data<uint16_t>();
+  for (VariantPixelBuffer::size_type i = 0; i < buf.num_elements(); ++i)
+    data[i] = static_cast<uint16_t>(i * 1000U);
+
+  VariantPixelBuffer dest;
+  buf.convertTo(dest, PT::FLOAT, PixelConversion(ome::files::CONVERT_SCALE));
+  EXPECT_EQ(PT::FLOAT, dest.pixelType());
+  EXPECT_EQ(buf.num_elements(), dest.num_elements());
+  EXPECT_TRUE(dest.storage_order() == buf.storage_order());
+  EXPECT_TRUE(std::equal(buf.shape(), buf.shape() + ome::files::PixelBufferBase::dimensions, dest.shape()));
+  const float *fdata = dest.data<float>();
+  for (VariantPixelBuffer::size_type i = 0; i < dest.num_elements(); ++i)
+    EXPECT_FLOAT_EQ(static_cast<float>(i * 1000U) / 65535.0f, fdata[i]);
+
+  // Normalise into the same buffer.
+  dest.convertTo(dest, PT::UINT8, PixelConversion::normalise(dest));
+  EXPECT_EQ(PT::UINT8, dest.pixelType());
+  EXPECT_EQ(0U, dest.data<uint8_t>()[0]);
+  EXPECT_EQ(255U, dest.data<uint8_t>()[dest.num_elements() - 1]);
+}
@@ -0,0 +1,356 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <ome/files/PixelStatistics.h>
+#include <ome/files/detail/SampleStatistics.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::PixelStatistics;
+typedef ome::xml::model::enums::PixelType PT;
+
+TEST(PixelStatistics, TypeRange)
+{
+  PixelStatistics u8(PT::UINT8);
+  EXPECT_DOUBLE_EQ(0.0, u8.getRangeMin());
+  EXPECT_DOUBLE_EQ(256.0, u8.getRangeMax());
+  EXPECT_EQ(256U, u8.getBins());
+
+  PixelStatistics i16(PT::INT16, 64U);
+  EXPECT_DOUBLE_EQ(-32768.0, i16.getRangeMin());
+  EXPECT_DOUBLE_EQ(32768.0, i16.getRangeMax());
+  EXPECT_EQ(64U, i16.getBins());
+
+  PixelStatistics f(PT::FLOAT);
+  EXPECT_DOUBLE_EQ(0.0, f.getRangeMin());
+  EXPECT_DOUBLE_EQ(1.0, f.getRangeMax());
+}
+
+TEST(PixelStatistics, InvalidConstruction)
+{
+  EXPECT_THROW(PixelStatistics(PT::UINT8, 0U), std::logic_error);
+  EXPECT_THROW(PixelStatistics(1.0, 1.0, 256U), std::logic_error);
+  EXPECT_THROW(PixelStatistics(0.0, 1.0, 0U), std::logic_error);
+}
+
+TEST(PixelStatistics, Accumulate)
+{
+  const std::vector<uint8_t> values{3, 0, 255, 7, 7, 128};
+
+  PixelStatistics stats(PT::UINT8);
+  PixelStatistics::Accumulator acc(stats);
+  acc.add(0U, values.data(), values.size());
+  stats.merge(acc);
+
+  ASSERT_EQ(1U, stats.size());
+  PixelStatistics::Sample s(stats.get(0U));
+  EXPECT_EQ(6U, s.count);
+  EXPECT_DOUBLE_EQ(0.0, s.min);
+  EXPECT_DOUBLE_EQ(255.0, s.max);
+  EXPECT_DOUBLE_EQ(400.0 / 6.0, s.mean());
+  ASSERT_EQ(256U, s.histogram.size());
+  EXPECT_EQ(1U, s.histogram[0]);
+  EXPECT_EQ(1U, s.histogram[3]);
+  EXPECT_EQ(2U, s.histogram[7]);
+  EXPECT_EQ(1U, s.histogram[128]);
+  EXPECT_EQ(1U, s.histogram[255]);
+
+  stats.reset();
+  EXPECT_EQ(0U, stats.size());
+  EXPECT_EQ(0U, stats.get(0U).count);
+  EXPECT_DOUBLE_EQ(0.0, stats.get(0U).mean());
+}
+
+TEST(PixelStatistics, StridedSamples)
+{
+  // Interleaved RGB.
+  const std::vector<uint16_t> values{1, 100, 1000,
+                                     2, 200, 2000,
+                                     3, 300, 3000};
+
+  PixelStatistics stats(PT::UINT16, 16U);
+  PixelStatistics::Accumulator acc(stats);
+  for (ome::files::dimension_size_type s = 0; s < 3U; ++s)
+    acc.add(s, values.data() + s, 3U, 3);
+  stats.merge(acc);
+
+  ASSERT_EQ(3U, stats.size());
+  const double scale[] = {1.0, 100.0, 1000.0};
+  for (ome::files::dimension_size_type s = 0; s < 3U; ++s)
+    {
+      PixelStatistics::Sample sample(stats.get(s));
+      EXPECT_EQ(3U, sample.count);
+      EXPECT_DOUBLE_EQ(1.0 * scale[s], sample.min);
+      EXPECT_DOUBLE_EQ(3.0 * scale[s], sample.max);
+      EXPECT_DOUBLE_EQ(2.0 * scale[s], sample.mean());
+      EXPECT_EQ(3U, sample.histogram[0]);
+    }
+
+  PixelStatistics::Sample combined(stats.combined());
+  EXPECT_EQ(9U, combined.count);
+  EXPECT_DOUBLE_EQ(1.0, combined.min);
+  EXPECT_DOUBLE_EQ(3000.0, combined.max);
+}
+
+TEST(PixelStatistics, FloatRange)
+{
+  const std::vector<float> values{-1.0f, 0.25f, std::numeric_limits<float>::quiet_NaN(), 0.75f, 4.0f};
+
+  PixelStatistics stats(0.0, 1.0, 4U);
+  PixelStatistics::Accumulator acc(stats);
+  acc.add(0U, values.data(), values.size());
+  stats.merge(acc);
+
+  PixelStatistics::Sample s(stats.get(0U));
+  EXPECT_EQ(4U, s.count);
+  EXPECT_DOUBLE_EQ(-1.0, s.min);
+  EXPECT_DOUBLE_EQ(4.0, s.max);
+  EXPECT_DOUBLE_EQ(1.0, s.mean());
+  const std::vector<uint64_t> expected{1, 1, 0, 2};
+  EXPECT_EQ(expected, s.histogram);
+}
+
+TEST(PixelStatistics, ComplexMagnitude)
+{
+  const std::vector<std::complex<double>> values{{3.0, 4.0}, {0.0, -1.0}};
+
+  PixelStatistics stats(0.0, 10.0, 10U);
+  PixelStatistics::Accumulator acc(stats);
+  acc.add(0U, values.data(), values.size());
+  stats.merge(acc);
+
+  PixelStatistics::Sample s(stats.get(0U));
+  EXPECT_DOUBLE_EQ(1.0, s.min);
+  EXPECT_DOUBLE_EQ(5.0, s.max);
+  EXPECT_EQ(1U, s.histogram[1]);
+  EXPECT_EQ(1U, s.histogram[5]);
+}
+
+TEST(PixelStatistics, ParallelMerge)
+{
+  std::vector<int32_t> values(1000);
+  for (std::vector<int32_t>::size_type i = 0; i < values.size(); ++i)
+    values[i] = static_cast<int32_t>(i) - 500;
+
+  PixelStatistics stats(-500.0, 500.0, 10U);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t)
+    threads.push_back(std::thread([&]()
+      {
+        for (int r = 0; r < 10; ++r)
+          {
+            PixelStatistics::Accumulator acc(stats);
+            acc.add(0U, values.data(), values.size());
+            stats.merge(acc);
+          }
+      }));
+  for (auto& thread : threads)
+    thread.join();
+
+  PixelStatistics::Sample s(stats.get(0U));
+  EXPECT_EQ(40000U, s.count);
+  EXPECT_DOUBLE_EQ(-500.0, s.min);
+  EXPECT_DOUBLE_EQ(499.0, s.max);
+  EXPECT_DOUBLE_EQ(-0.5, s.mean());
+  for (const auto bin : s.histogram)
+    EXPECT_EQ(4000U, bin);
+}
+
+TEST(PixelStatistics, ContiguousMatchesStrided)
+{
+  // Contiguous values are accumulated with the sample kernels, and
+  // strided values with a scalar loop.
+  std::vector<float> values(1000U);
+  std::vector<float> strided(values.size() * 2U, -100.0f);
+  for (std::vector<float>::size_type i = 0; i < values.size(); ++i)
+    {
+      values[i] = (i % 7U) ? static_cast<float>((i * 37U) % 1000U) / 1000.0f : std::numeric_limits<float>::quiet_NaN();
+      strided[i * 2U] = values[i];
+    }
+
+  PixelStatistics contiguous(0.0, 1.0, 16U);
+  PixelStatistics::Accumulator cacc(contiguous);
+  cacc.add(0U, values.data(), values.size());
+  contiguous.merge(cacc);
+
+  PixelStatistics interleaved(0.0, 1.0, 16U);
+  PixelStatistics::Accumulator iacc(interleaved);
+  iacc.add(0U, strided.data(), values.size(), 2);
+  interleaved.merge(iacc);
+
+  const PixelStatistics::Sample c(contiguous.get(0U));
+  const PixelStatistics::Sample i(interleaved.get(0U));
+  EXPECT_EQ(857U, c.count);
+  EXPECT_EQ(i.count, c.count);
+  EXPECT_EQ(i.min, c.min);
+  EXPECT_EQ(i.max, c.max);
+  EXPECT_NEAR(i.sum, c.sum, 1e-6);
+  EXPECT_EQ(i.histogram, c.histogram);
+}
+
+namespace
+{
+
+  // Values for testing the sample kernels, with NaN and infinite
+  // values for floating point types.  Floating point values are
+  // integers divided by a power of two, so that sums are exact in
+  // any order.
+  template<typename T>
+  std::vector<T>
+  kernel_values(dimension_size_type count,
+                dimension_size_type seed)
+  {
+    typedef std::numeric_limits<T> limits;
+
+    std::vector<T> special{limits::lowest(), limits::max(), T(0)};
+    if (limits::has_quiet_NaN)
+      {
+        special.push_back(limits::quiet_NaN());
+        special.push_back(limits::infinity());
+      }
+
+    std::vector<T> values(count);
+    uint64_t state = (seed * 2654435761U) + 1U;
+    for (dimension_size_type i = 0; i < count; ++i)
+      {
+        state = (state * 6364136223846793005ULL) + 1442695040888963407ULL;
+        const uint64_t r = state >> 33;
+        if (r % 11U == 0U)
+          values[i] = special[(r / 11U) % special.size()];
+        else if (limits::is_integer)
+          std::memcpy(&values[i], &state, sizeof(T));
+        else
+          values[i] = static_cast<T>(static_cast<double>(r % 20001U) - 10000.0) / T(8);
+      }
+    // Limit floating point values to the integer range, so that
+    // sums are exact.
+    if (!limits::is_integer)
+      for (auto& v : values)
+        if (v == limits::lowest() || v == limits::max())
+          v = T(0);
+    return values;
+  }
+
+  template<typename T>
+  bool
+  is_nan(const T& v)
+  {
+    return v != v;
+  }
+
+  template<typename T, typename S>
+  void
+  check_samples()
+  {
+    // Cover lengths shorter and longer than the SIMD block sizes,
+    // and unaligned starts.
+    std::vector<dimension_size_type> counts;
+    for (dimension_size_type count = 0; count < 41; ++count)
+      counts.push_back(count);
+    counts.push_back(1001U);
+
+    for (const auto count : counts)
+      for (dimension_size_type offset = 0; offset < 3; ++offset)
+        {
+          const std::vector<T> values(kernel_values<T>(count + offset, count));
+
+          T emin = std::numeric_limits<T>::max();
+          T emax = std::numeric_limits<T>::lowest();
+          S esum = S(1);
+          dimension_size_type en = 0U;
+          for (dimension_size_type i = offset; i < values.size(); ++i)
+            {
+              const T v = values[i];
+              if (is_nan(v))
+                continue;
+              emin = v < emin ? v : emin;
+              emax = v > emax ? v : emax;
+              esum += static_cast<S>(v);
+              ++en;
+            }
+
+          T min = std::numeric_limits<T>::max();
+          T max = std::numeric_limits<T>::lowest();
+          S sum = S(1);
+          const dimension_size_type n =
+            ome::files::detail::accumulateSamples(values.data() + offset, count, min, max, sum);
+
+          ASSERT_EQ(en, n) << "count=" << count << " offset=" << offset;
+          ASSERT_EQ(emin, min) << "count=" << count << " offset=" << offset;
+          ASSERT_EQ(emax, max) << "count=" << count << " offset=" << offset;
+          ASSERT_TRUE((is_nan(esum) && is_nan(sum)) || esum == sum)
+            << "count=" << count << " offset=" << offset << " expected=" << esum << " sum=" << sum;
+        }
+  }
+
+}
+
+TEST(PixelStatisticsKernel, Samples)
+{
+  check_samples<int8_t, int64_t>();
+  check_samples<int16_t, int64_t>();
+  check_samples<int32_t, int64_t>();
+  check_samples<uint8_t, uint64_t>();
+  check_samples<uint16_t, uint64_t>();
+  check_samples<uint32_t, uint64_t>();
+  check_samples<float, double>();
+  check_samples<double, double>();
+}
+
+TEST(PixelStatisticsKernel, AllNaN)
+{
+  const std::vector<float> values(37U, std::numeric_limits<float>::quiet_NaN());
+  float min = std::numeric_limits<float>::max();
+  float max = std::numeric_limits<float>::lowest();
+  double sum = 0.0;
+  EXPECT_EQ(0U, ome::files::detail::accumulateSamples(values.data(), values.size(), min, max, sum));
+  EXPECT_EQ(std::numeric_limits<float>::max(), min);
+  EXPECT_EQ(std::numeric_limits<float>::lowest(), max);
+  EXPECT_EQ(0.0, sum);
+}
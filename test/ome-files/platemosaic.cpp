@@ -0,0 +1,247 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/PlateMosaic.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include <ome/test/test.h>
+
+using ome::files::CoreMetadata;
+using ome::files::PlateLayout;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+using ome::xml::model::primitives::NonNegativeInteger;
+using ome::xml::model::primitives::PositiveInteger;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("PlateMosaicTestReader", "Reader for plate mosaic testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  // Full-resolution size of each series; each has one
+  // sub-resolution of half the size.
+  const std::array<std::array<dimension_size_type, 2>, 4> sizes
+    {{
+        {{64U, 48U}},
+        {{64U, 48U}},
+        {{32U, 48U}},
+        {{64U, 48U}}
+      }};
+
+  // Every pixel of a series and resolution has the same value.
+  uint16_t
+  pixel_value(dimension_size_type series,
+              dimension_size_type resolution)
+  {
+    return static_cast<uint16_t>((series * 10U) + resolution + 1U);
+  }
+
+  std::shared_ptr<ome::xml::meta::OMEXMLMetadata>
+  make_plate()
+  {
+    std::shared_ptr<ome::xml::meta::OMEXMLMetadata> meta(std::make_shared<ome::xml::meta::OMEXMLMetadata>());
+    for (dimension_size_type s = 0U; s < sizes.size(); ++s)
+      meta->setImageID(std::string("Image:") + std::to_string(s), s);
+
+    // Well A1 holds series 0 and 1; well B2 holds series 2 and a
+    // field without an image.  Series 3 is not on the plate.
+    meta->setPlateID("Plate:0", 0U);
+    meta->setPlateRows(PositiveInteger(2U), 0U);
+    meta->setWellID("Well:0:0", 0U, 0U);
+    meta->setWellRow(NonNegativeInteger(0U), 0U, 0U);
+    meta->setWellColumn(NonNegativeInteger(0U), 0U, 0U);
+    meta->setWellSampleID("WellSample:0:0:0", 0U, 0U, 0U);
+    meta->setWellSampleImageRef("Image:0", 0U, 0U, 0U);
+    meta->setWellSampleID("WellSample:0:0:1", 0U, 0U, 1U);
+    meta->setWellSampleImageRef("Image:1", 0U, 0U, 1U);
+    meta->setWellID("Well:0:1", 0U, 1U);
+    meta->setWellRow(NonNegativeInteger(1U), 0U, 1U);
+    meta->setWellColumn(NonNegativeInteger(1U), 0U, 1U);
+    meta->setWellSampleID("WellSample:0:1:0", 0U, 1U, 0U);
+    meta->setWellSampleImageRef("Image:2", 0U, 1U, 0U);
+    meta->setWellSampleID("WellSample:0:1:1", 0U, 1U, 1U);
+    return meta;
+  }
+
+}
+
+// Reader generating four UINT16 series with two resolutions each.
+class PlateMosaicTestReader : public ome::files::detail::FormatReader
+{
+public:
+  PlateMosaicTestReader():
+    ome::files::detail::FormatReader(props)
+  {
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    core.clear();
+    for (const auto& size : sizes)
+      {
+        for (dimension_size_type r = 0U; r < 2U; ++r)
+          {
+            std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+            c->sizeX = size[0] >> r;
+            c->sizeY = size[1] >> r;
+            c->sizeZ = 1;
+            c->sizeT = 1;
+            c->sizeC.clear();
+            c->sizeC.push_back(1);
+            c->pixelType = PixelType::UINT16;
+            c->imageCount = 1;
+            c->dimensionOrder = DimensionOrder::XYZCT;
+            c->orderCertain = true;
+            c->interleaved = false;
+            c->indexed = false;
+            c->resolutionCount = r ? 1U : 2U;
+            core.push_back(c);
+          }
+      }
+  }
+
+  void
+  openBytesImpl(dimension_size_type /* plane */,
+                VariantPixelBuffer& buf,
+                dimension_size_type /* x */,
+                dimension_size_type /* y */,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    preparePlane(buf, w, h, 1U);
+    const uint16_t value = pixel_value(getSeries(), getResolution());
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        buf.array<uint16_t>()[i][j][0][0][0][0][0][0][0] = value;
+  }
+};
+
+TEST(PlateMosaic, Layout)
+{
+  std::shared_ptr<ome::xml::meta::OMEXMLMetadata> meta(make_plate());
+
+  PlateLayout layout;
+  ASSERT_NO_THROW(layout = ome::files::plateLayout(*meta, 0U));
+  EXPECT_EQ(2U, layout.rows);
+  EXPECT_EQ(2U, layout.columns);
+  EXPECT_EQ(1U, layout.fieldRows);
+  EXPECT_EQ(2U, layout.fieldColumns);
+  ASSERT_EQ(3U, layout.fields.size());
+  EXPECT_EQ(0U, layout.fields[0].series);
+  EXPECT_EQ(1U, layout.fields[1].series);
+  EXPECT_EQ(1U, layout.fields[1].field);
+  EXPECT_EQ(2U, layout.fields[2].series);
+  EXPECT_EQ(1U, layout.fields[2].row);
+  EXPECT_EQ(1U, layout.fields[2].column);
+
+  EXPECT_THROW(ome::files::plateLayout(*meta, 1U), std::logic_error);
+}
+
+TEST(PlateMosaic, Compose)
+{
+  PlateMosaicTestReader reader;
+  reader.setId("test");
+  reader.setDecodeThreads(3U);
+  const PlateLayout layout(ome::files::plateLayout(*make_plate(), 0U));
+
+  // 16×16 cells: fields are read from the sub-resolution.
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(ome::files::composePlateMosaic(reader, layout, 0U, 16U, 16U, buf));
+  ASSERT_EQ(PixelType::UINT16, buf.pixelType());
+  ASSERT_EQ(64U, buf.shape()[ome::files::DIM_SPATIAL_X]);
+  ASSERT_EQ(32U, buf.shape()[ome::files::DIM_SPATIAL_Y]);
+
+  auto expected = [](dimension_size_type x,
+                     dimension_size_type y) -> uint16_t
+    {
+      // Series 0 and 1 are 16×12, centred vertically.
+      if (y >= 2U && y < 14U && x < 16U)
+        return pixel_value(0U, 1U);
+      if (y >= 2U && y < 14U && x >= 16U && x < 32U)
+        return pixel_value(1U, 1U);
+      // Series 2 is 10×16, centred horizontally.
+      if (y >= 16U && x >= 35U && x < 45U)
+        return pixel_value(2U, 1U);
+      return 0U;
+    };
+
+  for (dimension_size_type y = 0; y < 32U; ++y)
+    for (dimension_size_type x = 0; x < 64U; ++x)
+      EXPECT_EQ(expected(x, y), (buf.array<uint16_t>()[x][y][0][0][0][0][0][0][0]));
+
+  // The current series is unchanged.
+  EXPECT_EQ(0U, reader.getSeries());
+
+  // Large cells: fields are read at full resolution, and not
+  // enlarged.
+  ASSERT_NO_THROW(ome::files::composePlateMosaic(reader, layout, 0U, 128U, 128U, buf));
+  ASSERT_EQ(512U, buf.shape()[ome::files::DIM_SPATIAL_X]);
+  ASSERT_EQ(256U, buf.shape()[ome::files::DIM_SPATIAL_Y]);
+  EXPECT_EQ(pixel_value(0U, 0U), (buf.array<uint16_t>()[32U][40U][0][0][0][0][0][0][0]));
+  EXPECT_EQ(0U, (buf.array<uint16_t>()[32U][39U][0][0][0][0][0][0][0]));
+  EXPECT_EQ(pixel_value(2U, 0U), (buf.array<uint16_t>()[256U + 48U][128U + 40U][0][0][0][0][0][0][0]));
+
+  EXPECT_THROW(ome::files::composePlateMosaic(reader, layout, 1U, 16U, 16U, buf), std::logic_error);
+  EXPECT_THROW(ome::files::composePlateMosaic(reader, layout, 0U, 0U, 16U, buf), std::logic_error);
+  EXPECT_THROW(ome::files::composePlateMosaic(reader, PlateLayout(), 0U, 16U, 16U, buf), std::logic_error);
+}
@@ -0,0 +1,378 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/files/CancellationToken.h>
+#include <ome/files/Executor.h>
+#include <ome/files/ProgressiveReader.h>
+#include <ome/files/ReadCancelledException.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+
+#include <ome/test/test.h>
+
+using ome::files::CancellationToken;
+using ome::files::CoreMetadata;
+using ome::files::PlaneRegion;
+using ome::files::ProgressiveReader;
+using ome::files::ProgressiveUpdate;
+using ome::files::ReadCancelledException;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("ProgressiveTestReader", "Reader for progressive read testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  // Full resolution size; each sub-resolution halves it.
+  const dimension_size_type sizeX = 64U;
+  const dimension_size_type sizeY = 48U;
+  const dimension_size_type resolutions = 4U;
+
+  uint16_t
+  pixel_value(dimension_size_type resolution,
+              dimension_size_type x,
+              dimension_size_type y)
+  {
+    return static_cast<uint16_t>(x + (y * 100U) + (resolution * 10000U));
+  }
+
+  void
+  check_update(const ProgressiveUpdate& update)
+  {
+    ASSERT_TRUE(static_cast<bool>(update.pixels));
+    const VariantPixelBuffer& buf(*update.pixels);
+    ASSERT_EQ(update.region.w, buf.shape()[ome::files::DIM_SPATIAL_X]);
+    ASSERT_EQ(update.region.h, buf.shape()[ome::files::DIM_SPATIAL_Y]);
+    for (dimension_size_type y = 0; y < update.region.h; ++y)
+      for (dimension_size_type x = 0; x < update.region.w; ++x)
+        ASSERT_EQ(pixel_value(update.resolution, update.region.x + x, update.region.y + y),
+                  (buf.array<uint16_t>()[x][y][0][0][0][0][0][0][0]));
+  }
+
+  void
+  expect_region(const PlaneRegion& expected,
+                const PlaneRegion& observed)
+  {
+    EXPECT_EQ(expected.x, observed.x);
+    EXPECT_EQ(expected.y, observed.y);
+    EXPECT_EQ(expected.w, observed.w);
+    EXPECT_EQ(expected.h, observed.h);
+  }
+
+  // Updates received by a callback.
+  struct Updates
+  {
+    std::mutex                     mutex;
+    std::vector<ProgressiveUpdate> updates;
+    std::vector<std::exception_ptr> errors;
+
+    ProgressiveReader::callback_type
+    callback()
+    {
+      return [this](const ProgressiveUpdate& update,
+                    std::exception_ptr       error)
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          updates.push_back(update);
+          errors.push_back(error);
+        };
+    }
+  };
+
+}
+
+// Reader generating one series of one UINT16 plane with four
+// resolutions, and values from pixel_value().  Reads wait until the
+// gate is opened, and the resolutions read are recorded.
+class ProgressiveTestReader : public ome::files::detail::FormatReader
+{
+public:
+  mutable std::mutex                       mutex;
+  mutable std::condition_variable          changed;
+  bool                                     open;
+  mutable std::vector<dimension_size_type> reads;
+
+  ProgressiveTestReader():
+    ome::files::detail::FormatReader(props),
+    mutex(),
+    changed(),
+    open(true),
+    reads()
+  {
+  }
+
+  void
+  setGate(bool open)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->open = open;
+    changed.notify_all();
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    core.clear();
+    for (dimension_size_type r = 0; r < resolutions; ++r)
+      {
+        std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+        c->sizeX = sizeX >> r;
+        c->sizeY = sizeY >> r;
+        c->sizeZ = 1;
+        c->sizeT = 1;
+        c->sizeC.clear();
+        c->sizeC.push_back(1);
+        c->pixelType = PixelType::UINT16;
+        c->imageCount = 1;
+        c->dimensionOrder = DimensionOrder::XYZCT;
+        c->orderCertain = true;
+        c->interleaved = false;
+        c->indexed = false;
+        c->resolutionCount = r ? 1U : resolutions;
+        core.push_back(c);
+      }
+  }
+
+  void
+  openBytesImpl(dimension_size_type /* plane */,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [this]() { return open; });
+      reads.push_back(getResolution());
+    }
+
+    const dimension_size_type r = getResolution();
+    preparePlane(buf, w, h, 1U);
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        buf.array<uint16_t>()[i][j][0][0][0][0][0][0][0] = pixel_value(r, x + i, y + j);
+  }
+};
+
+class ProgressiveReaderTest : public ::testing::Test
+{
+public:
+  std::shared_ptr<ProgressiveTestReader> reader;
+
+  virtual void
+  SetUp()
+  {
+    reader = std::make_shared<ProgressiveTestReader>();
+    reader->setId("test");
+    reader->setExecutor(std::make_shared<ome::files::ThreadPoolExecutor>(2U));
+  }
+};
+
+TEST_F(ProgressiveReaderTest, CoarseFirst)
+{
+  Updates received;
+  ProgressiveReader progressive(reader, 1U);
+  EXPECT_EQ(reader, progressive.getReader());
+
+  // With a slow estimate, reading starts at the coarsest resolution.
+  progressive.setThroughput(1.0);
+  progressive.read(0U, 0U, PlaneRegion(10U, 6U, 20U, 30U), std::chrono::milliseconds(50),
+                   received.callback());
+  progressive.wait();
+  EXPECT_EQ(0U, progressive.pending());
+
+  ASSERT_EQ(resolutions, received.updates.size());
+  for (dimension_size_type i = 0; i < resolutions; ++i)
+    {
+      const ProgressiveUpdate& update(received.updates[i]);
+      EXPECT_FALSE(received.errors[i]);
+      EXPECT_EQ(resolutions - 1U - i, update.resolution);
+      EXPECT_EQ(i == resolutions - 1U, update.final);
+      check_update(update);
+      if (i)
+        {
+          EXPECT_GE(update.elapsed, received.updates[i - 1].elapsed);
+        }
+    }
+
+  // Regions are scaled outward to cover the requested region.
+  expect_region(PlaneRegion(10U, 6U, 20U, 30U), received.updates[3].region);
+  expect_region(PlaneRegion(5U, 3U, 10U, 15U), received.updates[2].region);
+  expect_region(PlaneRegion(2U, 1U, 6U, 8U), received.updates[1].region);
+  expect_region(PlaneRegion(1U, 0U, 3U, 5U), received.updates[0].region);
+
+  // The estimate is updated by the reads.
+  EXPECT_GT(progressive.getThroughput(), 1.0);
+}
+
+TEST_F(ProgressiveReaderTest, Budget)
+{
+  ProgressiveReader progressive(reader, 1U);
+
+  // The full resolution fits the budget: one final update.
+  {
+    Updates received;
+    progressive.setThroughput(1.0e12);
+    progressive.read(0U, 0U, PlaneRegion(0U, 0U, sizeX, sizeY), std::chrono::milliseconds(50),
+                     received.callback());
+    progressive.wait();
+    ASSERT_EQ(1U, received.updates.size());
+    EXPECT_EQ(0U, received.updates[0].resolution);
+    EXPECT_TRUE(received.updates[0].final);
+    check_update(received.updates[0]);
+  }
+
+  // Only resolution 2 (16×12) and coarser fit the budget of 200
+  // pixels; resolution 3 is not read.
+  {
+    Updates received;
+    reader->reads.clear();
+    progressive.setThroughput(200.0);
+    progressive.read(0U, 0U, PlaneRegion(0U, 0U, sizeX, sizeY), std::chrono::milliseconds(1000),
+                     received.callback());
+    progressive.wait();
+    ASSERT_EQ(3U, received.updates.size());
+    EXPECT_EQ(2U, received.updates[0].resolution);
+    EXPECT_EQ(1U, received.updates[1].resolution);
+    EXPECT_EQ(0U, received.updates[2].resolution);
+    EXPECT_TRUE(received.updates[2].final);
+    EXPECT_EQ((std::vector<dimension_size_type>{2U, 1U, 0U}), reader->reads);
+  }
+
+  // A coarser target resolution.
+  {
+    Updates received;
+    progressive.setThroughput(1.0);
+    progressive.read(0U, 0U, PlaneRegion(2U, 2U, 8U, 8U), std::chrono::milliseconds(50),
+                     received.callback(), 2U);
+    progressive.wait();
+    ASSERT_EQ(2U, received.updates.size());
+    EXPECT_EQ(3U, received.updates[0].resolution);
+    EXPECT_EQ(2U, received.updates[1].resolution);
+    expect_region(PlaneRegion(2U, 2U, 8U, 8U), received.updates[1].region);
+    EXPECT_TRUE(received.updates[1].final);
+  }
+
+  EXPECT_THROW(progressive.setThroughput(0.0), std::logic_error);
+}
+
+TEST_F(ProgressiveReaderTest, Invalid)
+{
+  Updates received;
+  ProgressiveReader progressive(reader);
+
+  EXPECT_THROW(progressive.read(1U, 0U, PlaneRegion(0U, 0U, 1U, 1U), std::chrono::milliseconds(50),
+                                received.callback()), std::logic_error);
+  EXPECT_THROW(progressive.read(0U, 1U, PlaneRegion(0U, 0U, 1U, 1U), std::chrono::milliseconds(50),
+                                received.callback()), std::logic_error);
+  EXPECT_THROW(progressive.read(0U, 0U, PlaneRegion(0U, 0U, 1U, 1U), std::chrono::milliseconds(50),
+                                received.callback(), resolutions), std::logic_error);
+  EXPECT_THROW(progressive.read(0U, 0U, PlaneRegion(60U, 0U, 8U, 1U), std::chrono::milliseconds(50),
+                                received.callback()), std::logic_error);
+  EXPECT_THROW(progressive.read(0U, 0U, PlaneRegion(0U, 0U, 0U, 1U), std::chrono::milliseconds(50),
+                                received.callback()), std::logic_error);
+  EXPECT_EQ(0U, progressive.pending());
+  EXPECT_TRUE(received.updates.empty());
+}
+
+TEST_F(ProgressiveReaderTest, Cancel)
+{
+  Updates received;
+  {
+    ProgressiveReader progressive(reader, 1U);
+    progressive.setThroughput(1.0);
+
+    reader->setGate(false);
+    ProgressiveReader::request_type cancelled =
+      progressive.read(0U, 0U, PlaneRegion(0U, 0U, sizeX, sizeY), std::chrono::milliseconds(50),
+                       received.callback());
+    EXPECT_EQ(1U, progressive.pending());
+    EXPECT_TRUE(progressive.cancel(cancelled));
+    EXPECT_FALSE(progressive.cancel(cancelled));
+    EXPECT_EQ(0U, progressive.pending());
+    reader->setGate(true);
+    progressive.wait();
+    EXPECT_TRUE(received.updates.empty());
+
+    // The token of the requesting thread applies to the request,
+    // and ends it with an error.
+    CancellationToken token;
+    token.cancel();
+    {
+      CancellationToken::Scope scope(token);
+      progressive.read(0U, 0U, PlaneRegion(0U, 0U, sizeX, sizeY), std::chrono::milliseconds(50),
+                       received.callback());
+    }
+    progressive.wait();
+    ASSERT_EQ(1U, received.updates.size());
+    EXPECT_TRUE(received.updates[0].final);
+    EXPECT_FALSE(static_cast<bool>(received.updates[0].pixels));
+    EXPECT_THROW(std::rethrow_exception(received.errors[0]), ReadCancelledException);
+
+    // Destruction cancels outstanding requests.
+    reader->setGate(false);
+    progressive.read(0U, 0U, PlaneRegion(0U, 0U, sizeX, sizeY), std::chrono::milliseconds(50),
+                     received.callback());
+    reader->setGate(true);
+  }
+  EXPECT_GE(received.updates.size(), 1U);
+  EXPECT_LE(received.updates.size(), 1U + resolutions);
+}
@@ -0,0 +1,364 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/Projection.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+#include <ome/files/detail/Projection.h>
+
+#include <ome/test/test.h>
+
+using ome::files::CoreMetadata;
+using ome::files::PixelBuffer;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("ProjectionTestReader", "Reader for projection testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  const dimension_size_type sizeX = 37U;
+  const dimension_size_type sizeY = 29U;
+  const dimension_size_type sizeZ = 5U;
+
+  uint16_t
+  pixel_value(dimension_size_type plane,
+              dimension_size_type x,
+              dimension_size_type y)
+  {
+    return static_cast<uint16_t>(((x * 31U) + (y * 17U) + (plane * 4099U)) % 65521U);
+  }
+
+}
+
+// Reader generating UINT16 planes with values from pixel_value().
+class ProjectionTestReader : public ome::files::detail::FormatReader
+{
+public:
+  ProjectionTestReader():
+    ome::files::detail::FormatReader(props)
+  {
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+    c->sizeX = sizeX;
+    c->sizeY = sizeY;
+    c->sizeZ = sizeZ;
+    c->sizeT = 1;
+    c->sizeC.clear();
+    c->sizeC.push_back(1);
+    c->pixelType = PixelType::UINT16;
+    c->imageCount = c->sizeZ;
+    c->dimensionOrder = DimensionOrder::XYZCT;
+    c->orderCertain = true;
+    c->interleaved = false;
+    c->indexed = false;
+    c->resolutionCount = 1;
+
+    core.clear();
+    core.push_back(c);
+  }
+
+  void
+  openBytesImpl(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    preparePlane(buf, w, h, 1U);
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        buf.array<uint16_t>()[i][j][0][0][0][0][0][0][0] = pixel_value(plane, x + i, y + j);
+  }
+};
+
+class ProjectionTest : public ::testing::TestWithParam<unsigned int>
+{
+public:
+  ProjectionTestReader reader;
+  std::vector<dimension_size_type> planes;
+
+  void
+  SetUp()
+  {
+    reader.setId("test");
+    reader.setDecodeThreads(GetParam());
+    for (dimension_size_type z = 0; z < sizeZ; ++z)
+      planes.push_back(z);
+  }
+};
+
+TEST_P(ProjectionTest, Max)
+{
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(ome::files::projectPlanes(reader, planes, ome::files::PROJECTION_MAX, buf, 8U));
+  ASSERT_EQ(PixelType::UINT16, buf.pixelType());
+  ASSERT_EQ(sizeX, buf.shape()[ome::files::DIM_SPATIAL_X]);
+  ASSERT_EQ(sizeY, buf.shape()[ome::files::DIM_SPATIAL_Y]);
+
+  for (dimension_size_type y = 0; y < sizeY; ++y)
+    for (dimension_size_type x = 0; x < sizeX; ++x)
+      {
+        uint16_t expected = 0U;
+        for (auto z : planes)
+          expected = std::max(expected, pixel_value(z, x, y));
+        ASSERT_EQ(expected, buf.array<uint16_t>()[x][y][0][0][0][0][0][0][0]);
+      }
+}
+
+TEST_P(ProjectionTest, Mean)
+{
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(ome::files::projectPlanes(reader, planes, ome::files::PROJECTION_MEAN, buf, 8U));
+  ASSERT_EQ(PixelType::UINT16, buf.pixelType());
+
+  for (dimension_size_type y = 0; y < sizeY; ++y)
+    for (dimension_size_type x = 0; x < sizeX; ++x)
+      {
+        uint64_t sum = 0U;
+        for (auto z : planes)
+          sum += pixel_value(z, x, y);
+        const uint16_t expected = static_cast<uint16_t>((sum + (planes.size() / 2U)) / planes.size());
+        ASSERT_EQ(expected, buf.array<uint16_t>()[x][y][0][0][0][0][0][0][0]);
+      }
+}
+
+TEST_P(ProjectionTest, Sum)
+{
+  // A subset of the planes, with the default band height.
+  const std::vector<dimension_size_type> subset{1U, 3U, 4U};
+
+  VariantPixelBuffer buf;
+  ASSERT_NO_THROW(ome::files::projectPlanes(reader, subset, ome::files::PROJECTION_SUM, buf));
+  ASSERT_EQ(PixelType::DOUBLE, buf.pixelType());
+  ASSERT_EQ(PixelType::DOUBLE, ome::files::projectionPixelType(PixelType::UINT16, ome::files::PROJECTION_SUM));
+
+  for (dimension_size_type y = 0; y < sizeY; ++y)
+    for (dimension_size_type x = 0; x < sizeX; ++x)
+      {
+        double expected = 0.0;
+        for (auto z : subset)
+          expected += pixel_value(z, x, y);
+        ASSERT_EQ(expected, buf.array<double>()[x][y][0][0][0][0][0][0][0]);
+      }
+}
+
+TEST_P(ProjectionTest, Invalid)
+{
+  VariantPixelBuffer buf;
+  EXPECT_THROW(ome::files::projectPlanes(reader, std::vector<dimension_size_type>(),
+                                         ome::files::PROJECTION_MAX, buf),
+               std::logic_error);
+  EXPECT_THROW(ome::files::projectPlanes(reader, std::vector<dimension_size_type>{0U, sizeZ},
+                                         ome::files::PROJECTION_MAX, buf),
+               std::logic_error);
+}
+
+const std::vector<unsigned int> thread_counts{1U, 4U};
+
+// Disable missing-prototypes warning for INSTANTIATE_TEST_CASE_P;
+// this is solely to work around a missing prototype in gtest.
+#ifdef __GNUC__
+#  if defined __clang__ || defined __APPLE__
+#    pragma GCC diagnostic ignored "-Wmissing-prototypes"
+#  endif
+#  pragma GCC diagnostic ignored "-Wmissing-declarations"
+#endif
+
+INSTANTIATE_TEST_CASE_P(ProjectionVariants, ProjectionTest, ::testing::ValuesIn(thread_counts));
+
+namespace
+{
+
+  // Values spanning the range of the type, including the extremes
+  // and, for floating point types, NaN and infinities.
+  template<typename T>
+  std::vector<T>
+  kernel_values(dimension_size_type count,
+                dimension_size_type seed)
+  {
+    typedef std::numeric_limits<T> limits;
+    std::vector<T> special{limits::lowest(), limits::max(), T(0), T(1), T(limits::max() / 2)};
+    if (limits::is_signed)
+      special.push_back(T(-1));
+    if (limits::has_quiet_NaN)
+      {
+        special.push_back(limits::quiet_NaN());
+        special.push_back(limits::infinity());
+        special.push_back(-limits::infinity());
+      }
+
+    std::vector<T> values(count);
+    uint64_t state = (seed * 2654435761U) + 1U;
+    for (dimension_size_type i = 0; i < count; ++i)
+      {
+        state = (state * 6364136223846793005ULL) + 1442695040888963407ULL;
+        const uint64_t r = state >> 33;
+        if (r % 5U == 0U)
+          values[i] = special[(r / 5U) % special.size()];
+        else if (limits::is_integer)
+          std::memcpy(&values[i], &state, sizeof(T));
+        else
+          values[i] = static_cast<T>(static_cast<double>(r % 20001U) - 10000.0) / T(7);
+      }
+    return values;
+  }
+
+  template<typename T>
+  bool
+  same_value(const T& a,
+             const T& b)
+  {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+  }
+
+  template<typename T>
+  void
+  check_max()
+  {
+    // Cover lengths shorter and longer than the SIMD block sizes,
+    // and unaligned starts.
+    for (dimension_size_type count = 0; count < 41; ++count)
+      for (dimension_size_type offset = 0; offset < 3; ++offset)
+        {
+          std::vector<T> acc(kernel_values<T>(count + offset, count));
+          const std::vector<T> src(kernel_values<T>(count + offset, count + 100U));
+          std::vector<T> expected(acc);
+          for (dimension_size_type i = offset; i < expected.size(); ++i)
+            expected[i] = expected[i] < src[i] ? src[i] : expected[i];
+
+          ome::files::detail::projectMax(acc.data() + offset, src.data() + offset, count);
+          for (dimension_size_type i = 0; i < acc.size(); ++i)
+            ASSERT_TRUE(same_value(expected[i], acc[i]))
+              << "count=" << count << " offset=" << offset << " i=" << i;
+        }
+  }
+
+  template<typename T, typename S>
+  void
+  check_sum()
+  {
+    for (dimension_size_type count = 0; count < 41; ++count)
+      for (dimension_size_type offset = 0; offset < 3; ++offset)
+        {
+          const std::vector<T> src(kernel_values<T>(count + offset, count));
+          std::vector<S> acc(count + offset);
+          for (dimension_size_type i = 0; i < acc.size(); ++i)
+            acc[i] = static_cast<S>(kernel_values<T>(1U, i + 200U)[0]);
+          std::vector<S> expected(acc);
+          for (dimension_size_type i = offset; i < expected.size(); ++i)
+            expected[i] += static_cast<S>(src[i]);
+
+          ome::files::detail::projectSum(acc.data() + offset, src.data() + offset, count);
+          for (dimension_size_type i = 0; i < acc.size(); ++i)
+            ASSERT_TRUE(same_value(expected[i], acc[i]))
+              << "count=" << count << " offset=" << offset << " i=" << i;
+        }
+  }
+
+}
+
+TEST(ProjectionKernel, Max)
+{
+  check_max<int8_t>();
+  check_max<int16_t>();
+  check_max<int32_t>();
+  check_max<uint8_t>();
+  check_max<uint16_t>();
+  check_max<uint32_t>();
+  check_max<float>();
+  check_max<double>();
+}
+
+TEST(ProjectionKernel, MaxNaN)
+{
+  // NaN neither replaces nor is replaced.
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> acc{nan, 1.0f, nan, 1.0f, nan, 1.0f, nan, 1.0f};
+  const std::vector<float> src{2.0f, nan, 2.0f, nan, 2.0f, nan, 2.0f, nan};
+  ome::files::detail::projectMax(acc.data(), src.data(), acc.size());
+  for (dimension_size_type i = 0; i < acc.size(); ++i)
+    {
+      if (i % 2U)
+        EXPECT_EQ(1.0f, acc[i]);
+      else
+        EXPECT_TRUE(std::isnan(acc[i]));
+    }
+}
+
+TEST(ProjectionKernel, Sum)
+{
+  check_sum<int8_t, int64_t>();
+  check_sum<int16_t, int64_t>();
+  check_sum<int32_t, int64_t>();
+  check_sum<uint8_t, uint64_t>();
+  check_sum<uint16_t, uint64_t>();
+  check_sum<uint32_t, uint64_t>();
+  check_sum<float, double>();
+  check_sum<double, double>();
+}
@@ -0,0 +1,235 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/FormatException.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/RawReader.h>
+
+#include <ome/test/test.h>
+
+using ome::files::FormatException;
+using ome::files::VariantPixelBuffer;
+using ome::files::in::RawReader;
+
+namespace
+{
+
+  const ome::files::dimension_size_type sizeX = 7U;
+  const ome::files::dimension_size_type sizeY = 5U;
+  const ome::files::dimension_size_type sizeT = 3U;
+
+  uint16_t
+  pixel(ome::files::dimension_size_type plane,
+        ome::files::dimension_size_type x,
+        ome::files::dimension_size_type y)
+  {
+    return static_cast<uint16_t>((plane * 1000U) + (y * 100U) + x);
+  }
+
+  // Write a little-endian uint16 stack preceded by a header of
+  // headerSize bytes, and its sidecar.
+  boost::filesystem::path
+  writeRaw(const std::string& name,
+           std::streamsize    headerSize)
+  {
+    boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+    if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+      throw std::runtime_error("Image directory unavailable and could not be created");
+    boost::filesystem::path filename(dir / (name + ".raw"));
+    boost::filesystem::path sidecar(dir / (name + ".ome.xml"));
+
+    {
+      std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      for (std::streamsize i = 0; i < headerSize; ++i)
+        out.put('H');
+      for (ome::files::dimension_size_type plane = 0; plane < sizeT; ++plane)
+        for (ome::files::dimension_size_type y = 0; y < sizeY; ++y)
+          for (ome::files::dimension_size_type x = 0; x < sizeX; ++x)
+            {
+              const uint16_t value = pixel(plane, x, y);
+              out.put(static_cast<char>(value & 0xFFU));
+              out.put(static_cast<char>(value >> 8));
+            }
+    }
+
+    {
+      std::ofstream out(sidecar.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+      out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          << "<OME xmlns=\"http://www.openmicroscopy.org/Schemas/OME/2016-06\">\n"
+          << "  <Image ID=\"Image:0\" Name=\"" << name << "\">\n"
+          << "    <Pixels ID=\"Pixels:0\" DimensionOrder=\"XYZCT\" Type=\"uint16\"\n"
+          << "            BigEndian=\"false\" Interleaved=\"false\"\n"
+          << "            SizeX=\"" << sizeX << "\" SizeY=\"" << sizeY
+          << "\" SizeZ=\"1\" SizeC=\"1\" SizeT=\"" << sizeT << "\">\n"
+          << "      <Channel ID=\"Channel:0:0\" SamplesPerPixel=\"1\"/>\n"
+          << "      <MetadataOnly/>\n"
+          << "    </Pixels>\n"
+          << "  </Image>\n"
+          << "</OME>\n";
+    }
+
+    return filename;
+  }
+
+  void
+  removeRaw(const boost::filesystem::path& filename)
+  {
+    boost::filesystem::remove(RawReader::findMetadataFile(filename));
+    boost::filesystem::remove(filename);
+  }
+
+  void
+  checkRegion(const VariantPixelBuffer&       buf,
+              ome::files::dimension_size_type plane,
+              ome::files::dimension_size_type x,
+              ome::files::dimension_size_type y,
+              ome::files::dimension_size_type w,
+              ome::files::dimension_size_type h)
+  {
+    ASSERT_EQ(w * h, buf.num_elements());
+    for (ome::files::dimension_size_type j = 0; j < h; ++j)
+      for (ome::files::dimension_size_type i = 0; i < w; ++i)
+        ASSERT_EQ(pixel(plane, x + i, y + j), buf.array<uint16_t>()[i][j][0][0][0][0][0][0][0]);
+  }
+
+}
+
+TEST(RawReader, findMetadataFile)
+{
+  const boost::filesystem::path filename(writeRaw("rawsidecar", 0));
+  EXPECT_EQ(filename.parent_path() / "rawsidecar.ome.xml",
+            RawReader::findMetadataFile(filename));
+  EXPECT_TRUE(RawReader::findMetadataFile(filename.parent_path() / "missing.raw").empty());
+  removeRaw(filename);
+}
+
+TEST(RawReader, openBytes)
+{
+  const boost::filesystem::path filename(writeRaw("rawstack", 64));
+
+  RawReader reader;
+  ASSERT_NO_THROW(reader.setId(filename));
+  EXPECT_EQ(1U, reader.getSeriesCount());
+  EXPECT_EQ(sizeX, reader.getSizeX());
+  EXPECT_EQ(sizeY, reader.getSizeY());
+  EXPECT_EQ(sizeT, reader.getImageCount());
+  EXPECT_EQ(2U, reader.getUsedFiles().size());
+  EXPECT_EQ(1U, reader.getUsedFiles(true).size());
+
+  for (ome::files::dimension_size_type plane : {2U, 0U, 1U})
+    {
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(reader.openBytes(plane, buf));
+      checkRegion(buf, plane, 0U, 0U, sizeX, sizeY);
+
+      VariantPixelBuffer region;
+      ASSERT_NO_THROW(reader.openBytes(plane, region, 2U, 1U, 3U, 2U));
+      checkRegion(region, plane, 2U, 1U, 3U, 2U);
+    }
+
+  reader.close();
+  removeRaw(filename);
+}
+
+TEST(RawReader, openBytesMapped)
+{
+  const boost::filesystem::path filename(writeRaw("rawmapped", 64));
+  const bool native = boost::endian::order::native == boost::endian::order::little;
+
+  RawReader reader;
+  ASSERT_NO_THROW(reader.setId(filename));
+
+  for (ome::files::dimension_size_type plane = 0; plane < sizeT; ++plane)
+    {
+      // Whole planes and rows are contiguous.
+      VariantPixelBuffer buf;
+      EXPECT_EQ(native, reader.openBytesMapped(plane, buf));
+      checkRegion(buf, plane, 0U, 0U, sizeX, sizeY);
+
+      VariantPixelBuffer rows;
+      EXPECT_EQ(native, reader.openBytesMapped(plane, rows, 0U, 1U, sizeX, 3U));
+      checkRegion(rows, plane, 0U, 1U, sizeX, 3U);
+
+      // Partial rows are copied.
+      VariantPixelBuffer region;
+      EXPECT_FALSE(reader.openBytesMapped(plane, region, 2U, 1U, 3U, 2U));
+      checkRegion(region, plane, 2U, 1U, 3U, 2U);
+    }
+
+  VariantPixelBuffer buf;
+  EXPECT_THROW(reader.openBytesMapped(sizeT, buf), FormatException);
+  EXPECT_THROW(reader.openBytesMapped(0U, buf, 0U, 0U, sizeX + 1U, 1U), FormatException);
+
+  reader.close();
+  removeRaw(filename);
+}
+
+TEST(RawReader, Misaligned)
+{
+  // An odd-sized header misaligns the uint16 pixel data.
+  const boost::filesystem::path filename(writeRaw("rawmisaligned", 3));
+
+  RawReader reader;
+  ASSERT_NO_THROW(reader.setId(filename));
+
+  VariantPixelBuffer buf;
+  EXPECT_FALSE(reader.openBytesMapped(1U, buf));
+  checkRegion(buf, 1U, 0U, 0U, sizeX, sizeY);
+
+  reader.close();
+  removeRaw(filename);
+}
+
+TEST(RawReader, TooSmall)
+{
+  const boost::filesystem::path filename(writeRaw("rawsmall", 0));
+  boost::filesystem::resize_file(filename, (sizeX * sizeY * sizeT * 2U) - 1U);
+
+  RawReader reader;
+  EXPECT_THROW(reader.setId(filename), FormatException);
+
+  removeRaw(filename);
+}
@@ -0,0 +1,136 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2013 - 2015 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <ome/files/UnknownFormatException.h>
+#include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/in/OMETIFFReader.h>
+#include <ome/files/in/ReaderRegistry.h>
+
+#include <ome/test/test.h>
+
+using ome::files::FormatReader;
+using ome::files::UnknownFormatException;
+using ome::files::in::MinimalTIFFReader;
+using ome::files::in::OMETIFFReader;
+using ome::files::in::ReaderRegistry;
+
+namespace
+{
+
+  // Classic and BigTIFF headers without any IFD.
+  const std::array<uint8_t, 8> le_header{{'I', 'I', 42, 0, 0, 0, 0, 0}};
+  const std::array<uint8_t, 8> be_header{{'M', 'M', 0, 42, 0, 0, 0, 0}};
+  const std::array<uint8_t, 8> big_header{{'I', 'I', 43, 0, 8, 0, 0, 0}};
+  const std::array<uint8_t, 8> png_header{{0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A}};
+
+}
+
+TEST(ReaderRegistry, HeaderSize)
+{
+  ReaderRegistry registry;
+  EXPECT_EQ(ReaderRegistry::default_header_size, registry.getHeaderSize());
+
+  ReaderRegistry small(16U);
+  EXPECT_EQ(16U, small.getHeaderSize());
+}
+
+TEST(ReaderRegistry, DetectHeader)
+{
+  MinimalTIFFReader tiff;
+  EXPECT_TRUE(tiff.isThisType(le_header.data(), le_header.data() + le_header.size()));
+  EXPECT_TRUE(tiff.isThisType(be_header.data(), be_header.data() + be_header.size()));
+  EXPECT_TRUE(tiff.isThisType(big_header.data(), big_header.data() + big_header.size()));
+  EXPECT_FALSE(tiff.isThisType(png_header.data(), png_header.data() + png_header.size()));
+  EXPECT_FALSE(tiff.isThisType(le_header.data(), le_header.data() + 2));
+
+  OMETIFFReader ometiff;
+  EXPECT_FALSE(ometiff.isThisType(png_header.data(), png_header.data() + png_header.size()));
+}
+
+TEST(ReaderRegistry, SelectTIFF)
+{
+  ReaderRegistry registry;
+
+  std::shared_ptr<FormatReader> reader
+    (registry.getReader("image.tiff", le_header.data(), le_header.data() + le_header.size()));
+  ASSERT_TRUE(static_cast<bool>(reader));
+  EXPECT_EQ(std::string("TIFF"), reader->getFormat());
+
+  reader = registry.getReader("image.dat", be_header.data(), be_header.data() + be_header.size());
+  ASSERT_TRUE(static_cast<bool>(reader));
+  EXPECT_EQ(std::string("TIFF"), reader->getFormat());
+}
+
+TEST(ReaderRegistry, SelectOMETIFF)
+{
+  ReaderRegistry registry;
+
+  std::shared_ptr<FormatReader> reader
+    (registry.getReader(PROJECT_SOURCE_DIR "/test/ome-files/data/2010-06-18x24y5z1t2c8b-text.ome.tiff"));
+  ASSERT_TRUE(static_cast<bool>(reader));
+  EXPECT_EQ(std::string("OME-TIFF"), reader->getFormat());
+}
+
+TEST(ReaderRegistry, SelectOMEXML)
+{
+  ReaderRegistry registry;
+
+  const std::string header("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                           "<OME xmlns=\"http://www.openmicroscopy.org/Schemas/OME/2016-06\">");
+  const uint8_t *begin = reinterpret_cast<const uint8_t *>(header.data());
+
+  std::shared_ptr<FormatReader> reader
+    (registry.getReader("image.ome.xml", begin, begin + header.size()));
+  ASSERT_TRUE(static_cast<bool>(reader));
+  EXPECT_EQ(std::string("OME-XML"), reader->getFormat());
+}
+
+TEST(ReaderRegistry, SelectUnknown)
+{
+  ReaderRegistry registry;
+
+  EXPECT_THROW(registry.getReader("image.png", png_header.data(), png_header.data() + png_header.size()),
+               UnknownFormatException);
+  EXPECT_THROW(registry.getReader(PROJECT_SOURCE_DIR "/test/ome-files/data/invalid.file"),
+               UnknownFormatException);
+}
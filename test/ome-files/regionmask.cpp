@@ -0,0 +1,329 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/RegionMask.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+
+#include <ome/xml/meta/OMEXMLMetadata.h>
+
+#include <ome/test/test.h>
+
+using ome::files::CoreMetadata;
+using ome::files::MaskSpan;
+using ome::files::MaskedPixels;
+using ome::files::PlaneRegion;
+using ome::files::RegionMask;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("RegionMaskTestReader", "Reader for region mask testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  const dimension_size_type sizeX = 64U;
+  const dimension_size_type sizeY = 48U;
+  const dimension_size_type tileSize = 16U;
+
+  uint16_t
+  pixel_value(dimension_size_type plane,
+              dimension_size_type x,
+              dimension_size_type y)
+  {
+    return static_cast<uint16_t>(x + (y * 100U) + (plane * 5000U));
+  }
+
+  // Check that every pixel of every span has been read.
+  void
+  check_pixels(const MaskedPixels& pixels,
+               dimension_size_type plane)
+  {
+    dimension_size_type offset = 0U;
+    for (const auto& span : pixels.spans)
+      for (dimension_size_type x = span.x; x < span.x + span.w; ++x, ++offset)
+        EXPECT_EQ(pixel_value(plane, x, span.y),
+                  (pixels.values.array<uint16_t>()[offset][0][0][0][0][0][0][0][0]));
+    EXPECT_EQ(offset, pixels.values.shape()[ome::files::DIM_SPATIAL_X]);
+  }
+
+}
+
+// Reader generating two UINT16 planes with values from
+// pixel_value(), in 16×16 tiles, and recording the regions read.
+class RegionMaskTestReader : public ome::files::detail::FormatReader
+{
+public:
+  mutable std::mutex mutex;
+  mutable std::vector<PlaneRegion> reads;
+
+  RegionMaskTestReader():
+    ome::files::detail::FormatReader(props),
+    mutex(),
+    reads()
+  {
+  }
+
+  using ome::files::detail::FormatReader::getOptimalTileWidth;
+  using ome::files::detail::FormatReader::getOptimalTileHeight;
+
+  dimension_size_type
+  getOptimalTileWidth(dimension_size_type /* channel */) const
+  {
+    return tileSize;
+  }
+
+  dimension_size_type
+  getOptimalTileHeight(dimension_size_type /* channel */) const
+  {
+    return tileSize;
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+    c->sizeX = sizeX;
+    c->sizeY = sizeY;
+    c->sizeZ = 2;
+    c->sizeT = 1;
+    c->sizeC.clear();
+    c->sizeC.push_back(1);
+    c->pixelType = PixelType::UINT16;
+    c->imageCount = 2;
+    c->dimensionOrder = DimensionOrder::XYZCT;
+    c->orderCertain = true;
+    c->interleaved = false;
+    c->indexed = false;
+    c->resolutionCount = 1;
+
+    core.clear();
+    core.push_back(c);
+  }
+
+  void
+  openBytesImpl(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      reads.push_back(PlaneRegion(x, y, w, h));
+    }
+    preparePlane(buf, w, h, 1U);
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        buf.array<uint16_t>()[i][j][0][0][0][0][0][0][0] = pixel_value(plane, x + i, y + j);
+  }
+};
+
+TEST(RegionMask, Shapes)
+{
+  RegionMask mask;
+  EXPECT_TRUE(mask.empty());
+  EXPECT_EQ(0U, mask.size());
+
+  // Pixel centres within [2, 7) × [1, 4).
+  mask.addRectangle(2.0, 1.0, 5.0, 3.0);
+  EXPECT_FALSE(mask.empty());
+  EXPECT_EQ(15U, mask.size());
+  PlaneRegion bounds(mask.bounds());
+  EXPECT_EQ(2U, bounds.x);
+  EXPECT_EQ(1U, bounds.y);
+  EXPECT_EQ(5U, bounds.w);
+  EXPECT_EQ(3U, bounds.h);
+
+  // Overlapping and adjacent runs are merged.
+  mask.addSpan(7U, 1U, 2U);
+  mask.addSpan(0U, 1U, 1U);
+  std::vector<MaskSpan> spans(mask.spans(PlaneRegion(0U, 0U, 20U, 2U)));
+  ASSERT_EQ(2U, spans.size());
+  EXPECT_EQ(0U, spans[0].x);
+  EXPECT_EQ(1U, spans[0].w);
+  EXPECT_EQ(2U, spans[1].x);
+  EXPECT_EQ(7U, spans[1].w);
+
+  // Spans are clipped to the region.
+  spans = mask.spans(PlaneRegion(4U, 2U, 2U, 10U));
+  ASSERT_EQ(2U, spans.size());
+  EXPECT_EQ(4U, spans[0].x);
+  EXPECT_EQ(2U, spans[0].y);
+  EXPECT_EQ(2U, spans[0].w);
+
+  // Ellipse: symmetrical about its centre.
+  RegionMask ellipse;
+  ellipse.addEllipse(6.0, 5.0, 5.0, 3.0);
+  bounds = ellipse.bounds();
+  EXPECT_EQ(1U, bounds.x);
+  EXPECT_EQ(2U, bounds.y);
+  EXPECT_EQ(10U, bounds.w);
+  EXPECT_EQ(6U, bounds.h);
+
+  // Right triangle: pixel centres strictly below the diagonal.
+  RegionMask triangle;
+  triangle.addPolygon({{0.0, 0.0}, {8.0, 0.0}, {0.0, 8.0}});
+  EXPECT_EQ(28U, triangle.size());
+
+  // Parts at negative coordinates are left out.
+  RegionMask clipped;
+  clipped.addRectangle(-2.0, -2.0, 4.0, 4.0);
+  clipped.addPoint(-1.0, 3.0);
+  EXPECT_EQ(4U, clipped.size());
+
+  // Mask images.
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape.fill(1U);
+  shape[ome::files::DIM_SPATIAL_X] = 4U;
+  shape[ome::files::DIM_SPATIAL_Y] = 2U;
+  VariantPixelBuffer image(shape, PixelType::BIT);
+  image.array<bool>()[1][0][0][0][0][0][0][0][0] = true;
+  image.array<bool>()[2][0][0][0][0][0][0][0][0] = true;
+  image.array<bool>()[3][1][0][0][0][0][0][0][0] = true;
+  RegionMask fromImage;
+  fromImage.addMask(image, 10U, 20U);
+  spans = fromImage.spans(PlaneRegion(0U, 0U, 100U, 100U));
+  ASSERT_EQ(2U, spans.size());
+  EXPECT_EQ(11U, spans[0].x);
+  EXPECT_EQ(20U, spans[0].y);
+  EXPECT_EQ(2U, spans[0].w);
+  EXPECT_EQ(13U, spans[1].x);
+  EXPECT_EQ(21U, spans[1].y);
+  EXPECT_EQ(1U, spans[1].w);
+}
+
+TEST(RegionMask, ROI)
+{
+  ome::xml::meta::OMEXMLMetadata meta;
+  meta.setROIID("ROI:0", 0U);
+  meta.setRectangleID("Shape:0:0", 0U, 0U);
+  meta.setRectangleX(2.0, 0U, 0U);
+  meta.setRectangleY(1.0, 0U, 0U);
+  meta.setRectangleWidth(5.0, 0U, 0U);
+  meta.setRectangleHeight(3.0, 0U, 0U);
+  meta.setPolygonID("Shape:0:1", 0U, 1U);
+  meta.setPolygonPoints("20,20 28,20 20,28", 0U, 1U);
+  meta.setPointID("Shape:0:2", 0U, 2U);
+  meta.setPointX(40.5, 0U, 2U);
+  meta.setPointY(30.5, 0U, 2U);
+
+  RegionMask mask;
+  ASSERT_NO_THROW(mask.addROI(meta, 0U));
+  EXPECT_EQ(15U + 28U + 1U, mask.size());
+
+  EXPECT_THROW(mask.addROI(meta, 1U), std::logic_error);
+}
+
+TEST(RegionMask, Read)
+{
+  RegionMaskTestReader reader;
+  reader.setId("test");
+
+  // A thin diagonal line touches only the tiles along the diagonal.
+  RegionMask mask;
+  mask.addPolyline({{0.5, 0.5}, {63.5, 47.5}});
+  const std::vector<PlaneRegion> tiles(ome::files::maskTiles(reader, mask));
+  EXPECT_LT(tiles.size(), 12U);
+  for (const auto& tile : tiles)
+    EXPECT_FALSE(mask.spans(tile).empty());
+
+  for (unsigned int threads : {1U, 4U})
+    {
+      reader.setDecodeThreads(threads);
+      reader.reads.clear();
+
+      MaskedPixels pixels;
+      ASSERT_NO_THROW(ome::files::readMasked(reader, 1U, mask, pixels));
+      EXPECT_EQ(mask.size(), pixels.values.shape()[ome::files::DIM_SPATIAL_X]);
+      check_pixels(pixels, 1U);
+
+      // Exactly the touched tiles are read, once each.
+      ASSERT_EQ(tiles.size(), reader.reads.size());
+      for (const auto& tile : tiles)
+        EXPECT_EQ(1, std::count_if(reader.reads.begin(), reader.reads.end(),
+                                   [&](const PlaneRegion& r)
+                                   {
+                                     return r.x == tile.x && r.y == tile.y && r.w == tile.w && r.h == tile.h;
+                                   }));
+    }
+
+  // Parts outside the image are left out.
+  RegionMask large;
+  large.addEllipse(60.0, 40.0, 20.0, 20.0);
+  MaskedPixels pixels;
+  ASSERT_NO_THROW(ome::files::readMasked(reader, 0U, large, pixels));
+  ASSERT_FALSE(pixels.spans.empty());
+  for (const auto& span : pixels.spans)
+    {
+      EXPECT_LE(span.x + span.w, sizeX);
+      EXPECT_LT(span.y, sizeY);
+    }
+  check_pixels(pixels, 0U);
+
+  // An empty mask reads nothing.
+  reader.reads.clear();
+  ASSERT_NO_THROW(ome::files::readMasked(reader, 0U, RegionMask(), pixels));
+  EXPECT_TRUE(pixels.spans.empty());
+  EXPECT_TRUE(reader.reads.empty());
+
+  EXPECT_THROW(ome::files::readMasked(reader, 2U, mask, pixels), std::logic_error);
+}
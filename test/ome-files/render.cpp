@@ -0,0 +1,371 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/Render.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+#include <ome/files/detail/Render.h>
+
+#include <ome/test/test.h>
+
+using ome::files::ChannelRendering;
+using ome::files::CoreMetadata;
+using ome::files::PixelBufferBase;
+using ome::files::PlaneRegion;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("RenderTestReader", "Reader for render testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  const dimension_size_type sizeX = 21U;
+  const dimension_size_type sizeY = 13U;
+
+  uint16_t
+  pixel_value(dimension_size_type plane,
+              dimension_size_type x,
+              dimension_size_type y)
+  {
+    return static_cast<uint16_t>((x * 40U) + (y * 3U) + (plane * 500U));
+  }
+
+  VariantPixelBuffer
+  make_plane(dimension_size_type plane)
+  {
+    std::array<VariantPixelBuffer::size_type, 9> shape;
+    shape.fill(1U);
+    shape[ome::files::DIM_SPATIAL_X] = sizeX;
+    shape[ome::files::DIM_SPATIAL_Y] = sizeY;
+
+    VariantPixelBuffer buf(shape, PixelType::UINT16);
+    for (dimension_size_type y = 0; y < sizeY; ++y)
+      for (dimension_size_type x = 0; x < sizeX; ++x)
+        buf.array<uint16_t>()[x][y][0][0][0][0][0][0][0] = pixel_value(plane, x, y);
+    return buf;
+  }
+
+  uint8_t
+  expected_level(uint16_t v,
+                 double   min,
+                 double   max)
+  {
+    const double d = (static_cast<double>(v) - min) * 255.0 / (max - min);
+    if (!(d > 0.0))
+      return 0U;
+    if (d >= 255.0)
+      return 255U;
+    return static_cast<uint8_t>(d + 0.5);
+  }
+
+  std::vector<ChannelRendering>
+  red_green()
+  {
+    std::vector<ChannelRendering> channels(2U);
+    channels[0].min = 100.0;
+    channels[0].max = 900.0;
+    channels[0].colour = {{255U, 0U, 0U}};
+    channels[1].min = 500.0;
+    channels[1].max = 1500.0;
+    channels[1].colour = {{0U, 255U, 0U}};
+    return channels;
+  }
+
+}
+
+// Reader generating two UINT16 planes with values from pixel_value().
+class RenderTestReader : public ome::files::detail::FormatReader
+{
+public:
+  RenderTestReader():
+    ome::files::detail::FormatReader(props)
+  {
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+    c->sizeX = sizeX;
+    c->sizeY = sizeY;
+    c->sizeZ = 1;
+    c->sizeT = 1;
+    c->sizeC.clear();
+    c->sizeC.push_back(1);
+    c->sizeC.push_back(1);
+    c->pixelType = PixelType::UINT16;
+    c->imageCount = 2;
+    c->dimensionOrder = DimensionOrder::XYZCT;
+    c->orderCertain = true;
+    c->interleaved = false;
+    c->indexed = false;
+    c->resolutionCount = 1;
+
+    core.clear();
+    core.push_back(c);
+  }
+
+  void
+  openBytesImpl(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type x,
+                dimension_size_type y,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    preparePlane(buf, w, h, 1U);
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        buf.array<uint16_t>()[i][j][0][0][0][0][0][0][0] = pixel_value(plane, x + i, y + j);
+  }
+};
+
+TEST(Render, Buffers)
+{
+  const std::vector<VariantPixelBuffer> planes{make_plane(0U), make_plane(1U)};
+  const std::vector<ChannelRendering> channels(red_green());
+
+  // Rows padded to 24 pixels.
+  const dimension_size_type pitch = 24U * 4U;
+  std::vector<uint8_t> rgba(pitch * sizeY, 7U);
+  ASSERT_NO_THROW(ome::files::renderRGBA(planes, channels, rgba.data(), pitch));
+
+  for (dimension_size_type y = 0; y < sizeY; ++y)
+    {
+      for (dimension_size_type x = 0; x < sizeX; ++x)
+        {
+          const uint8_t *p = &rgba[(y * pitch) + (x * 4U)];
+          EXPECT_EQ(expected_level(pixel_value(0U, x, y), 100.0, 900.0), p[0]);
+          EXPECT_EQ(expected_level(pixel_value(1U, x, y), 500.0, 1500.0), p[1]);
+          EXPECT_EQ(0U, p[2]);
+          EXPECT_EQ(255U, p[3]);
+        }
+      // Padding is untouched.
+      for (dimension_size_type i = sizeX * 4U; i < pitch; ++i)
+        EXPECT_EQ(7U, rgba[(y * pitch) + i]);
+    }
+}
+
+TEST(Render, FloatAndLUT)
+{
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape.fill(1U);
+  shape[ome::files::DIM_SPATIAL_X] = 4U;
+  shape[ome::files::DIM_SPATIAL_Y] = 1U;
+  VariantPixelBuffer buf(shape, PixelType::FLOAT);
+  float *data = buf.data<float>();
+  data[0] = -1.0f;
+  data[1] = 0.0f;
+  data[2] = 0.5f;
+  data[3] = 2.0f;
+
+  // Inverted grey table.
+  std::vector<ChannelRendering> channels(1U);
+  for (unsigned int i = 0; i < 256U; ++i)
+    {
+      const uint8_t v = static_cast<uint8_t>(255U - i);
+      channels[0].lut.push_back({{v, v, v}});
+    }
+
+  std::vector<uint8_t> rgba(4U * 4U);
+  ASSERT_NO_THROW(ome::files::renderRGBA(std::vector<VariantPixelBuffer>{buf}, channels, rgba.data(), 16U));
+  EXPECT_EQ(255U, rgba[0]);
+  EXPECT_EQ(255U, rgba[4]);
+  EXPECT_EQ(127U, rgba[8]);
+  EXPECT_EQ(0U, rgba[12]);
+
+  channels[0].lut.resize(16U);
+  EXPECT_THROW(ome::files::renderRGBA(std::vector<VariantPixelBuffer>{buf}, channels, rgba.data(), 16U),
+               std::logic_error);
+}
+
+TEST(Render, Mismatch)
+{
+  const std::vector<VariantPixelBuffer> planes{make_plane(0U), make_plane(1U)};
+  std::vector<uint8_t> rgba(sizeX * sizeY * 4U);
+
+  EXPECT_THROW(ome::files::renderRGBA(planes, std::vector<ChannelRendering>(1U), rgba.data(), sizeX * 4U),
+               std::logic_error);
+  EXPECT_THROW(ome::files::renderRGBA(std::vector<VariantPixelBuffer>(), std::vector<ChannelRendering>(),
+                                      rgba.data(), sizeX * 4U),
+               std::logic_error);
+}
+
+TEST(Render, Reader)
+{
+  const std::vector<VariantPixelBuffer> planes{make_plane(0U), make_plane(1U)};
+  const std::vector<ChannelRendering> channels(red_green());
+
+  std::vector<uint8_t> expected(sizeX * sizeY * 4U);
+  ome::files::renderRGBA(planes, channels, expected.data(), sizeX * 4U);
+
+  for (unsigned int threads : {1U, 4U})
+    {
+      RenderTestReader reader;
+      reader.setId("test");
+      reader.setDecodeThreads(threads);
+
+      const PlaneRegion region(3U, 2U, 15U, 9U);
+      std::vector<uint8_t> rgba(region.w * region.h * 4U);
+      ASSERT_NO_THROW(ome::files::renderRGBA(reader, std::vector<dimension_size_type>{0U, 1U},
+                                             region, channels, rgba.data(), region.w * 4U));
+
+      for (dimension_size_type y = 0; y < region.h; ++y)
+        for (dimension_size_type i = 0; i < region.w * 4U; ++i)
+          ASSERT_EQ(expected[((region.y + y) * sizeX * 4U) + (region.x * 4U) + i],
+                    rgba[(y * region.w * 4U) + i]);
+
+      EXPECT_THROW(ome::files::renderRGBA(reader, std::vector<dimension_size_type>{0U},
+                                          region, channels, rgba.data(), region.w * 4U),
+                   std::logic_error);
+    }
+}
+
+namespace
+{
+
+  // Values around the window edges and the rounding points, and
+  // non-finite values.
+  template<typename T>
+  std::vector<T>
+  window_values(dimension_size_type count)
+  {
+    const std::array<T, 12> special
+      {{
+          std::numeric_limits<T>::quiet_NaN(),
+          std::numeric_limits<T>::infinity(),
+          -std::numeric_limits<T>::infinity(),
+          T(-1000), T(10), T(10.5), T(11), T(11.0199),
+          T(520), T(519.9), T(1000), T(-0.0)
+        }};
+    std::vector<T> values(count);
+    for (dimension_size_type i = 0; i < count; ++i)
+      values[i] = i % 3U ? T(static_cast<double>(i) * 4.17) : special[(i / 3U) % special.size()];
+    return values;
+  }
+
+  template<typename T>
+  void
+  check_window()
+  {
+    const double min = 10.0;
+    const double scale = 255.0 / 510.0;
+    // Cover lengths shorter and longer than the SIMD block size,
+    // and strided values.
+    for (std::ptrdiff_t stride = 1; stride < 4; ++stride)
+      for (dimension_size_type count = 0; count < 41; ++count)
+        {
+          const std::vector<T> values(window_values<T>(count * static_cast<dimension_size_type>(stride)));
+          std::vector<uint8_t> indices(count, 0xAAU);
+          ome::files::detail::windowIndices(values.data(), stride, count, min, scale, indices.data());
+          for (dimension_size_type i = 0; i < count; ++i)
+            ASSERT_EQ(ome::files::detail::windowIndex(static_cast<double>(values[i * static_cast<dimension_size_type>(stride)]), min, scale),
+                      indices[i])
+              << "stride=" << stride << " count=" << count << " i=" << i;
+        }
+  }
+
+}
+
+TEST(RenderKernel, WindowFloat)
+{
+  check_window<float>();
+}
+
+TEST(RenderKernel, WindowDouble)
+{
+  check_window<double>();
+}
+
+TEST(RenderKernel, WindowEmpty)
+{
+  // An empty window places everything at or above min at the top.
+  const std::vector<double> values{9.0, 10.0, 11.0, 9.0, 10.0, 11.0, 9.0, 10.0, 11.0};
+  std::vector<uint8_t> indices(values.size());
+  ome::files::detail::windowIndices(values.data(), 1, values.size(), 10.0,
+                                    std::numeric_limits<double>::max(), indices.data());
+  for (dimension_size_type i = 0; i < values.size(); ++i)
+    EXPECT_EQ(values[i] > 10.0 ? 255U : 0U, indices[i]);
+}
+
+TEST(RenderKernel, AddSaturated)
+{
+  // Cover lengths shorter and longer than the SIMD block size, and
+  // unaligned starts.
+  for (dimension_size_type count = 0; count < 41; ++count)
+    for (dimension_size_type offset = 0; offset < 3; ++offset)
+      {
+        std::vector<uint8_t> src(count + offset);
+        std::vector<uint8_t> dest(count + offset);
+        for (dimension_size_type i = 0; i < src.size(); ++i)
+          {
+            src[i] = static_cast<uint8_t>((i * 37U) + 11U);
+            dest[i] = static_cast<uint8_t>((i * 91U) + 200U);
+          }
+        std::vector<uint8_t> expected(dest);
+        for (dimension_size_type i = offset; i < expected.size(); ++i)
+          expected[i] = static_cast<uint8_t>(std::min(static_cast<unsigned int>(expected[i]) + src[i], 255U));
+
+        ome::files::detail::addSaturated(src.data() + offset, count, dest.data() + offset);
+        ASSERT_EQ(expected, dest) << "count=" << count << " offset=" << offset;
+      }
+}
@@ -0,0 +1,280 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#ifndef _MSC_VER
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+#include <ome/files/TileBuffer.h>
+#include <ome/files/Types.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/SharedTileCache.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::TileBuffer;
+using ome::files::tiff::SharedTileCache;
+
+namespace
+{
+
+  SharedTileCache::key_type
+  key(uint64_t            file,
+      dimension_size_type tile)
+  {
+    SharedTileCache::key_type k{file, 8U, tile};
+    return k;
+  }
+
+  TileBuffer&
+  fill(TileBuffer& buffer,
+       uint8_t     value)
+  {
+    std::memset(buffer.data(), value, static_cast<std::size_t>(buffer.size()));
+    return buffer;
+  }
+
+}
+
+class SharedTileCacheTest : public ::testing::Test
+{
+public:
+  boost::filesystem::path filename;
+
+  virtual void SetUp()
+  {
+    boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+    if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+      throw std::runtime_error("Image directory unavailable and could not be created");
+
+    filename = dir / "sharedtilecache.cache";
+    boost::system::error_code ec;
+    boost::filesystem::remove(filename, ec);
+  }
+
+  virtual void TearDown()
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove(filename, ec);
+  }
+};
+
+#ifndef _MSC_VER
+
+TEST_F(SharedTileCacheTest, Construct)
+{
+  SharedTileCache c(filename, 30U, 1000U);
+
+  // Rounded up to whole sets and aligned slots.
+  ASSERT_EQ(32U, c.getSlots());
+  ASSERT_EQ(1024U, c.getSlotSize());
+  ASSERT_EQ(filename, c.getPath());
+  ASSERT_TRUE(boost::filesystem::exists(filename));
+}
+
+TEST_F(SharedTileCacheTest, InsertFind)
+{
+  SharedTileCache c(filename, 64U, 1024U);
+
+  TileBuffer t(1024U);
+  for (dimension_size_type i = 0; i < 16; ++i)
+    ASSERT_TRUE(c.insert(key(1U, i), fill(t, static_cast<uint8_t>(i))));
+
+  for (dimension_size_type i = 0; i < 16; ++i)
+    {
+      SharedTileCache::value_type found(c.find(key(1U, i)));
+      ASSERT_TRUE(static_cast<bool>(found));
+      ASSERT_EQ(1024U, found->size());
+      ASSERT_EQ(static_cast<uint8_t>(i), found->data()[0]);
+      ASSERT_EQ(static_cast<uint8_t>(i), found->data()[1023]);
+    }
+  ASSERT_FALSE(static_cast<bool>(c.find(key(2U, 0))));
+
+  ASSERT_EQ(16U, c.hits());
+  ASSERT_EQ(1U, c.misses());
+
+  c.resetStatistics();
+  ASSERT_EQ(0U, c.hits());
+  ASSERT_EQ(0U, c.misses());
+}
+
+TEST_F(SharedTileCacheTest, Replace)
+{
+  SharedTileCache c(filename, 64U, 2048U);
+
+  TileBuffer t1(1024U);
+  TileBuffer t2(2048U);
+  ASSERT_TRUE(c.insert(key(1U, 0), fill(t1, 1U)));
+  ASSERT_TRUE(c.insert(key(1U, 0), fill(t2, 2U)));
+
+  SharedTileCache::value_type found(c.find(key(1U, 0)));
+  ASSERT_TRUE(static_cast<bool>(found));
+  ASSERT_EQ(2048U, found->size());
+  ASSERT_EQ(2U, found->data()[0]);
+}
+
+TEST_F(SharedTileCacheTest, Uncacheable)
+{
+  SharedTileCache c(filename, 64U, 1024U);
+
+  TileBuffer large(2048U);
+  ASSERT_FALSE(c.insert(key(1U, 0), large));
+  ASSERT_FALSE(static_cast<bool>(c.find(key(1U, 0))));
+
+  // Files without an identity are never cached.
+  TileBuffer t(1024U);
+  ASSERT_FALSE(c.insert(key(0U, 0), t));
+  ASSERT_FALSE(static_cast<bool>(c.find(key(0U, 0))));
+}
+
+TEST_F(SharedTileCacheTest, Evict)
+{
+  SharedTileCache c(filename, 16U, 64U);
+
+  TileBuffer t(64U);
+  for (dimension_size_type i = 0; i < 256; ++i)
+    c.insert(key(1U, i), fill(t, static_cast<uint8_t>(i)));
+
+  // Capacity is bounded by the slot count.
+  dimension_size_type found = 0;
+  for (dimension_size_type i = 0; i < 256; ++i)
+    {
+      SharedTileCache::value_type tile(c.find(key(1U, i)));
+      if (tile)
+        {
+          ASSERT_EQ(static_cast<uint8_t>(i), tile->data()[0]);
+          ++found;
+        }
+    }
+  ASSERT_LE(found, 16U);
+  ASSERT_GT(found, 0U);
+}
+
+TEST_F(SharedTileCacheTest, Clear)
+{
+  SharedTileCache c(filename, 64U, 1024U);
+
+  TileBuffer t(1024U);
+  ASSERT_TRUE(c.insert(key(1U, 0), t));
+  c.clear();
+  ASSERT_FALSE(static_cast<bool>(c.find(key(1U, 0))));
+}
+
+TEST_F(SharedTileCacheTest, Reopen)
+{
+  TileBuffer t(512U);
+  {
+    SharedTileCache c(filename, 64U, 1024U);
+    ASSERT_TRUE(c.insert(key(1U, 3), fill(t, 3U)));
+  }
+
+  // The existing geometry is used.
+  SharedTileCache c(filename, 8U, 64U);
+  ASSERT_EQ(64U, c.getSlots());
+  ASSERT_EQ(1024U, c.getSlotSize());
+
+  SharedTileCache::value_type found(c.find(key(1U, 3)));
+  ASSERT_TRUE(static_cast<bool>(found));
+  ASSERT_EQ(512U, found->size());
+  ASSERT_EQ(3U, found->data()[0]);
+}
+
+TEST_F(SharedTileCacheTest, Invalid)
+{
+  {
+    std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    out << std::string(4096U, 'x');
+  }
+
+  ASSERT_THROW(SharedTileCache(filename, 64U, 1024U), ome::files::tiff::Exception);
+}
+
+TEST_F(SharedTileCacheTest, CrossProcess)
+{
+  SharedTileCache c(filename, 64U, 1024U);
+
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0)
+    {
+      // Child: insert into a separate mapping of the same file.
+      SharedTileCache child(filename, 64U, 1024U);
+      TileBuffer t(1024U);
+      _exit(child.insert(key(1U, 7), fill(t, 7U)) ? 0 : 1);
+    }
+
+  int status = 0;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  SharedTileCache::value_type found(c.find(key(1U, 7)));
+  ASSERT_TRUE(static_cast<bool>(found));
+  ASSERT_EQ(7U, found->data()[0]);
+}
+
+TEST_F(SharedTileCacheTest, FileIdentity)
+{
+  ASSERT_EQ(0U, SharedTileCache::fileIdentity(filename));
+
+  {
+    std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    out << std::string(4096U, 'x');
+  }
+
+  const uint64_t identity = SharedTileCache::fileIdentity(filename);
+  ASSERT_NE(0U, identity);
+  ASSERT_EQ(identity, SharedTileCache::fileIdentity(filename));
+
+  {
+    std::ofstream out(filename.string().c_str(), std::ios::out | std::ios::binary | std::ios::app);
+    out << 'x';
+  }
+  ASSERT_NE(identity, SharedTileCache::fileIdentity(filename));
+}
+
+#endif // ! _MSC_VER
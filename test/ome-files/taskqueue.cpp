@@ -0,0 +1,88 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <ome/files/detail/TaskQueue.h>
+
+#include <ome/test/test.h>
+
+using ome::files::detail::TaskQueue;
+
+TEST(TaskQueue, Order)
+{
+  std::vector<int> order;
+  {
+    TaskQueue queue(2U);
+    for (int i = 0; i < 100; ++i)
+      queue.submit([&order, i]() { order.push_back(i); });
+    queue.wait();
+    ASSERT_EQ(100U, order.size());
+  }
+
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(i, order.at(i));
+}
+
+TEST(TaskQueue, CompleteOnDestruction)
+{
+  std::atomic<int> count(0);
+  {
+    TaskQueue queue(4U);
+    for (int i = 0; i < 10; ++i)
+      queue.submit([&count]() { ++count; });
+  }
+  EXPECT_EQ(10, count.load());
+}
+
+TEST(TaskQueue, Error)
+{
+  std::atomic<int> count(0);
+  TaskQueue queue(4U);
+
+  queue.submit([]() { throw std::runtime_error("Task failed"); });
+  EXPECT_THROW(queue.wait(), std::runtime_error);
+
+  // The error is only reported once, and the queue remains usable.
+  EXPECT_NO_THROW(queue.wait());
+  queue.submit([&count]() { ++count; });
+  EXPECT_NO_THROW(queue.wait());
+  EXPECT_EQ(1, count.load());
+}
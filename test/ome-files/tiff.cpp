@@ -36,23 +36,30 @@
  * #L%
  */
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdio>
+#include <limits>
 #include <stdexcept>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 
+#include <ome/files/FormatException.h>
 #include <ome/files/PixelProperties.h>
+#include <ome/files/PixelStatistics.h>
 #include <ome/files/tiff/Codec.h>
 #include <ome/files/tiff/TileInfo.h>
 #include <ome/files/tiff/TIFF.h>
 #include <ome/files/tiff/IFD.h>
 #include <ome/files/tiff/Field.h>
 #include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/Util.h>
 
 #include <ome/compat/regex.h>
 
@@ -62,10 +69,12 @@
 #include <png.h>
 
 #include "pixel.h"
+#include "tiffpixels.h"
 #include "tiffsamples.h"
 
 using ome::files::tiff::directory_index_type;
 using ome::files::tiff::TileInfo;
+using ome::files::tiff::TileRange;
 using ome::files::tiff::TIFF;
 using ome::files::tiff::IFD;
 using ome::files::tiff::Codec;
@@ -204,6 +213,60 @@ namespace
     ome::compat::visit(v, buf.vbuffer());
   }
 
+  // Check a decimated buffer against every xstep-th column and
+  // ystep-th row of a region of a full buffer.
+  struct DecimatedCompareVisitor
+  {
+    const VariantPixelBuffer& full;
+    const PlaneRegion&        region;
+    dimension_size_type       xstep;
+    dimension_size_type       ystep;
+
+    DecimatedCompareVisitor(const VariantPixelBuffer& full,
+                            const PlaneRegion&        region,
+                            dimension_size_type       xstep,
+                            dimension_size_type       ystep):
+      full(full),
+      region(region),
+      xstep(xstep),
+      ystep(ystep)
+    {}
+
+    template <typename T>
+    bool
+    operator()(const T& buf) const
+    {
+      const T& src = ome::compat::get<T>(full.vbuffer());
+      const VariantPixelBuffer::size_type *shape = buf->shape();
+
+      if (shape[ome::files::DIM_SPATIAL_X] != (region.w + xstep - 1) / xstep ||
+          shape[ome::files::DIM_SPATIAL_Y] != (region.h + ystep - 1) / ystep ||
+          shape[ome::files::DIM_SUBCHANNEL] != src->shape()[ome::files::DIM_SUBCHANNEL])
+        return false;
+
+      typename T::element_type::indices_type idx, srcidx;
+      idx[ome::files::DIM_SPATIAL_Z] = idx[ome::files::DIM_TEMPORAL_T] =
+        idx[ome::files::DIM_CHANNEL] = idx[ome::files::DIM_MODULO_Z] =
+        idx[ome::files::DIM_MODULO_T] = idx[ome::files::DIM_MODULO_C] = 0;
+      srcidx = idx;
+
+      for (VariantPixelBuffer::size_type y = 0; y < shape[ome::files::DIM_SPATIAL_Y]; ++y)
+        for (VariantPixelBuffer::size_type x = 0; x < shape[ome::files::DIM_SPATIAL_X]; ++x)
+          for (VariantPixelBuffer::size_type c = 0; c < shape[ome::files::DIM_SUBCHANNEL]; ++c)
+            {
+              idx[ome::files::DIM_SPATIAL_X] = x;
+              idx[ome::files::DIM_SPATIAL_Y] = y;
+              idx[ome::files::DIM_SUBCHANNEL] = srcidx[ome::files::DIM_SUBCHANNEL] = c;
+              srcidx[ome::files::DIM_SPATIAL_X] = region.x + (x * xstep);
+              srcidx[ome::files::DIM_SPATIAL_Y] = region.y + (y * ystep);
+              if (!(buf->at(idx) == src->at(srcidx)))
+                return false;
+            }
+
+      return true;
+    }
+  };
+
 }
 
 std::vector<TIFFTestParameters> tile_params(find_tiff_tests());
@@ -368,6 +431,28 @@ TEST_F(TIFFTest, FieldWrapString)
   ASSERT_THROW(ifd->getField(ome::files::tiff::TARGETPRINTER).get(text), ome::files::tiff::Exception);
 }
 
+TEST_F(TIFFTest, FieldViewString)
+{
+  std::shared_ptr<TIFF> t;
+  ASSERT_NO_THROW(t = TIFF::open(tiff_path, "r"));
+  ASSERT_TRUE(static_cast<bool>(t));
+
+  std::shared_ptr<IFD> ifd;
+  ASSERT_NO_THROW(ifd = t->getDirectoryByIndex(0));
+  ASSERT_TRUE(static_cast<bool>(ifd));
+
+  std::string text;
+  ASSERT_NO_THROW(ifd->getField(ome::files::tiff::IMAGEDESCRIPTION).get(text));
+
+  const char *view = nullptr;
+  std::size_t length = 0;
+  ASSERT_NO_THROW(ifd->getField(ome::files::tiff::IMAGEDESCRIPTION).view(view, length));
+  ASSERT_TRUE(view != nullptr);
+  EXPECT_EQ(text, std::string(view, length));
+
+  ASSERT_THROW(ifd->getField(ome::files::tiff::ARTIST).view(view, length), ome::files::tiff::Exception);
+}
+
 TEST_F(TIFFTest, FieldWrapStringArray)
 {
   std::shared_ptr<TIFF> t;
@@ -832,6 +917,927 @@ TEST(TIFFCodec, ListCodecs)
     }
 }
 
+TEST(TIFFCodec, CodecParameters)
+{
+  using namespace ome::files::tiff;
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  dir /= "codec-parameters.tiff";
+
+  std::shared_ptr<TIFF> wtiff;
+  ASSERT_NO_THROW(wtiff = TIFF::open(dir, "w"));
+  std::shared_ptr<IFD> wifd;
+  ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+
+  ASSERT_NO_THROW(wifd->setImageWidth(64));
+  ASSERT_NO_THROW(wifd->setImageHeight(64));
+  ASSERT_NO_THROW(wifd->setPixelType(PT::UINT16));
+  ASSERT_NO_THROW(wifd->setSamplesPerPixel(1));
+
+  CodecParameters params;
+  params.level = 9;
+  params.predictor = HORIZONTAL;
+  params.maxError = 0.5;
+
+  // Not applicable without compression.
+  ASSERT_NO_THROW(wifd->setCompression(COMPRESSION_NONE));
+  ASSERT_NO_THROW(wifd->setCodecParameters(params));
+  CodecParameters none(wifd->getCodecParameters());
+  EXPECT_FALSE(!!none.level);
+  EXPECT_FALSE(!!none.predictor);
+  EXPECT_FALSE(!!none.maxError);
+
+  ASSERT_NO_THROW(wifd->setCompression(COMPRESSION_ADOBE_DEFLATE));
+  ASSERT_NO_THROW(wifd->setCodecParameters(params));
+  CodecParameters deflate(wifd->getCodecParameters());
+  ASSERT_TRUE(!!deflate.predictor);
+  EXPECT_EQ(HORIZONTAL, *deflate.predictor);
+  if (deflate.level)
+    EXPECT_EQ(9, *deflate.level);
+  EXPECT_FALSE(!!deflate.maxError);
+}
+
+TEST(TIFFCodec, DefaultPredictor)
+{
+  using namespace ome::files::tiff;
+
+  EXPECT_EQ(NONE, defaultPredictor(PT::BIT));
+  EXPECT_EQ(HORIZONTAL, defaultPredictor(PT::INT8));
+  EXPECT_EQ(HORIZONTAL, defaultPredictor(PT::UINT16));
+  EXPECT_EQ(HORIZONTAL, defaultPredictor(PT::INT32));
+  EXPECT_EQ(FLOATING_POINT, defaultPredictor(PT::FLOAT));
+  EXPECT_EQ(FLOATING_POINT, defaultPredictor(PT::DOUBLE));
+  EXPECT_EQ(NONE, defaultPredictor(PT::COMPLEXFLOAT));
+}
+
+TEST(TIFFCodec, AutomaticPredictor)
+{
+  using namespace ome::files::tiff;
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  dir /= "automatic-predictor.tiff";
+
+  std::shared_ptr<TIFF> wtiff;
+  ASSERT_NO_THROW(wtiff = TIFF::open(dir, "w"));
+  std::shared_ptr<IFD> wifd;
+  ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+
+  ASSERT_NO_THROW(wifd->setImageWidth(64));
+  ASSERT_NO_THROW(wifd->setImageHeight(64));
+  ASSERT_NO_THROW(wifd->setPixelType(PT::FLOAT));
+  ASSERT_NO_THROW(wifd->setSamplesPerPixel(1));
+  ASSERT_NO_THROW(wifd->setCompression(COMPRESSION_ADOBE_DEFLATE));
+
+  CodecParameters params;
+  params.automaticPredictor = true;
+  ASSERT_NO_THROW(wifd->setCodecParameters(params));
+  CodecParameters automatic(wifd->getCodecParameters());
+  ASSERT_TRUE(!!automatic.predictor);
+  EXPECT_EQ(FLOATING_POINT, *automatic.predictor);
+
+  // An explicit predictor takes precedence.
+  params.predictor = NONE;
+  ASSERT_NO_THROW(wifd->setCodecParameters(params));
+  CodecParameters explicitnone(wifd->getCodecParameters());
+  ASSERT_TRUE(!!explicitnone.predictor);
+  EXPECT_EQ(NONE, *explicitnone.predictor);
+
+  // Floating point prediction of integer samples is invalid.
+  ASSERT_NO_THROW(wifd->setPixelType(PT::UINT16));
+  params.predictor = FLOATING_POINT;
+  EXPECT_THROW(wifd->setCodecParameters(params), ome::files::tiff::Exception);
+}
+
+TEST(TIFFCodec, CodecPlugin)
+{
+  using namespace ome::files::tiff;
+
+  const Compression scheme(static_cast<Compression>(65000));
+
+  EXPECT_FALSE(!!getCodecPlugin(scheme));
+  EXPECT_FALSE(unregisterCodecPlugin(scheme));
+
+  std::atomic<dimension_size_type> encoded(0U);
+  std::atomic<dimension_size_type> decoded(0U);
+
+  // A trivial codec inverting all bits.
+  CodecPlugin plugin;
+  plugin.name = "test-invert";
+  plugin.scheme = scheme;
+  plugin.encode = [&encoded](const CodecTile&,
+                             const uint8_t *data,
+                             dimension_size_type size,
+                             std::vector<uint8_t>& out)
+    {
+      out.resize(size);
+      for (dimension_size_type i = 0; i < size; ++i)
+        out[i] = static_cast<uint8_t>(~data[i]);
+      ++encoded;
+    };
+  plugin.decode = [&decoded](const CodecTile&,
+                             const uint8_t *data,
+                             dimension_size_type size,
+                             uint8_t *out,
+                             dimension_size_type outsize)
+    {
+      for (dimension_size_type i = 0; i < std::min(size, outsize); ++i)
+        out[i] = static_cast<uint8_t>(~data[i]);
+      ++decoded;
+    };
+  ASSERT_NO_THROW(registerCodecPlugin(plugin));
+
+  ASSERT_TRUE(!!getCodecPlugin(scheme));
+  EXPECT_EQ(std::string("test-invert"), getCodecPlugin(scheme)->name);
+  EXPECT_EQ(scheme, getCodecScheme("test-invert"));
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  dir /= "codec-plugin.tiff";
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = 40;
+  shape[::ome::files::DIM_SPATIAL_Y] = 30;
+  shape[::ome::files::DIM_SUBCHANNEL] = 1;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  VariantPixelBuffer pixels(shape, PT::UINT16);
+  std::shared_ptr<PixelBuffer<uint16_t>> pbuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(pixels.vbuffer()));
+  for (dimension_size_type i = 0; i < pbuf->num_elements(); ++i)
+    pbuf->data()[i] = static_cast<uint16_t>((i * 331U) % 65536U);
+
+  {
+    std::shared_ptr<TIFF> wtiff;
+    ASSERT_NO_THROW(wtiff = TIFF::open(dir, "w"));
+    std::shared_ptr<IFD> wifd;
+    ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+
+    ASSERT_NO_THROW(wifd->setImageWidth(40));
+    ASSERT_NO_THROW(wifd->setImageHeight(30));
+    ASSERT_NO_THROW(wifd->setTileType(TILE));
+    ASSERT_NO_THROW(wifd->setTileWidth(16));
+    ASSERT_NO_THROW(wifd->setTileHeight(16));
+    ASSERT_NO_THROW(wifd->setPixelType(PT::UINT16));
+    ASSERT_NO_THROW(wifd->setBitsPerSample(16));
+    ASSERT_NO_THROW(wifd->setSamplesPerPixel(1));
+    ASSERT_NO_THROW(wifd->setPlanarConfiguration(CONTIG));
+    ASSERT_NO_THROW(wifd->setPhotometricInterpretation(MIN_IS_BLACK));
+    ASSERT_NO_THROW(wifd->setCompression(scheme));
+    ASSERT_NO_THROW(wifd->writeImage(pixels));
+    wtiff->writeCurrentDirectory();
+    wtiff->close();
+  }
+
+  // 3×2 tiles.
+  EXPECT_EQ(6U, encoded.load());
+
+  {
+    std::shared_ptr<TIFF> tiff;
+    ASSERT_NO_THROW(tiff = TIFF::open(dir, "r"));
+    std::shared_ptr<IFD> ifd;
+    ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(0));
+    EXPECT_EQ(scheme, ifd->getCompression());
+
+    VariantPixelBuffer vb;
+    ASSERT_NO_THROW(ifd->readImage(vb));
+    EXPECT_EQ(pixels, vb);
+    EXPECT_EQ(6U, decoded.load());
+  }
+
+  EXPECT_TRUE(unregisterCodecPlugin(scheme));
+  EXPECT_FALSE(!!getCodecPlugin(scheme));
+}
+
+TEST(TIFFCodec, JPEGPlugin)
+{
+  using namespace ome::files::tiff;
+
+  std::shared_ptr<const CodecPlugin> jpeg(getCodecPlugin(COMPRESSION_JPEG));
+  if (!jpeg)
+    {
+      std::cout << "JPEG codec plugin not available; skipping\n";
+      return;
+    }
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  dir /= "codec-jpeg.tiff";
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = 40;
+  shape[::ome::files::DIM_SPATIAL_Y] = 30;
+  shape[::ome::files::DIM_SUBCHANNEL] = 3;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  VariantPixelBuffer pixels(shape, PT::UINT8);
+  std::shared_ptr<PixelBuffer<uint8_t>> pbuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint8_t>>>(pixels.vbuffer()));
+  for (dimension_size_type i = 0; i < pbuf->num_elements(); ++i)
+    pbuf->data()[i] = static_cast<uint8_t>((i * 3U) % 256U);
+
+  {
+    std::shared_ptr<TIFF> wtiff;
+    ASSERT_NO_THROW(wtiff = TIFF::open(dir, "w"));
+    std::shared_ptr<IFD> wifd;
+    ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+
+    ASSERT_NO_THROW(wifd->setImageWidth(40));
+    ASSERT_NO_THROW(wifd->setImageHeight(30));
+    ASSERT_NO_THROW(wifd->setTileType(TILE));
+    ASSERT_NO_THROW(wifd->setTileWidth(16));
+    ASSERT_NO_THROW(wifd->setTileHeight(16));
+    ASSERT_NO_THROW(wifd->setPixelType(PT::UINT8));
+    ASSERT_NO_THROW(wifd->setBitsPerSample(8));
+    ASSERT_NO_THROW(wifd->setSamplesPerPixel(3));
+    ASSERT_NO_THROW(wifd->setPlanarConfiguration(CONTIG));
+    ASSERT_NO_THROW(wifd->setPhotometricInterpretation(RGB));
+    ASSERT_NO_THROW(wifd->setCompression(COMPRESSION_JPEG));
+    ASSERT_NO_THROW(wifd->writeImage(pixels));
+    wtiff->writeCurrentDirectory();
+    wtiff->close();
+  }
+
+  // Decoded with the plugin.
+  VariantPixelBuffer plugin;
+  {
+    std::shared_ptr<TIFF> tiff;
+    ASSERT_NO_THROW(tiff = TIFF::open(dir, "r"));
+    ASSERT_NO_THROW(tiff->getDirectoryByIndex(0)->readImage(plugin));
+  }
+
+  // Decoded with libtiff.
+  ASSERT_TRUE(unregisterCodecPlugin(COMPRESSION_JPEG));
+  VariantPixelBuffer libtiff;
+  {
+    std::shared_ptr<TIFF> tiff;
+    ASSERT_NO_THROW(tiff = TIFF::open(dir, "r"));
+    ASSERT_NO_THROW(tiff->getDirectoryByIndex(0)->readImage(libtiff));
+  }
+  registerCodecPlugin(*jpeg);
+
+  EXPECT_EQ(libtiff, plugin);
+}
+
+TEST(TIFFTest, SparseTiles)
+{
+  using namespace ome::files::tiff;
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  dir /= "sparse-tiles.tiff";
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = 40;
+  shape[::ome::files::DIM_SPATIAL_Y] = 30;
+  shape[::ome::files::DIM_SUBCHANNEL] = 1;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  // Only the centre tile of the bottom row (tile 4) contains data.
+  VariantPixelBuffer pixels(shape, PT::UINT16);
+  std::shared_ptr<PixelBuffer<uint16_t>> pbuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(pixels.vbuffer()));
+  std::fill(pbuf->data(), pbuf->data() + pbuf->num_elements(), 0U);
+  pbuf->data()[(20 * 40) + 20] = 42U;
+
+  {
+    std::shared_ptr<TIFF> wtiff;
+    ASSERT_NO_THROW(wtiff = TIFF::open(dir, "w"));
+    EXPECT_FALSE(wtiff->getSparseTiles());
+    wtiff->setSparseTiles(true);
+    EXPECT_TRUE(wtiff->getSparseTiles());
+
+    std::shared_ptr<IFD> wifd;
+    ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+
+    ASSERT_NO_THROW(wifd->setImageWidth(40));
+    ASSERT_NO_THROW(wifd->setImageHeight(30));
+    ASSERT_NO_THROW(wifd->setTileType(TILE));
+    ASSERT_NO_THROW(wifd->setTileWidth(16));
+    ASSERT_NO_THROW(wifd->setTileHeight(16));
+    ASSERT_NO_THROW(wifd->setPixelType(PT::UINT16));
+    ASSERT_NO_THROW(wifd->setBitsPerSample(16));
+    ASSERT_NO_THROW(wifd->setSamplesPerPixel(1));
+    ASSERT_NO_THROW(wifd->setPlanarConfiguration(CONTIG));
+    ASSERT_NO_THROW(wifd->setPhotometricInterpretation(MIN_IS_BLACK));
+    ASSERT_NO_THROW(wifd->setCompression(COMPRESSION_ADOBE_DEFLATE));
+    ASSERT_NO_THROW(wifd->writeImage(pixels));
+    wtiff->writeCurrentDirectory();
+    wtiff->close();
+  }
+
+  {
+    std::shared_ptr<TIFF> tiff;
+    ASSERT_NO_THROW(tiff = TIFF::open(dir, "r"));
+    std::shared_ptr<IFD> ifd;
+    ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(0));
+
+    std::vector<uint64_t> bytecounts;
+    ASSERT_NO_THROW(ifd->getField(TILEBYTECOUNTS).get(bytecounts));
+    ASSERT_EQ(6U, bytecounts.size());
+    for (std::vector<uint64_t>::size_type i = 0; i < bytecounts.size(); ++i)
+      {
+        if (i == 4U)
+          EXPECT_NE(0U, bytecounts[i]);
+        else
+          EXPECT_EQ(0U, bytecounts[i]);
+      }
+
+    VariantPixelBuffer vb;
+    ASSERT_NO_THROW(ifd->readImage(vb));
+    EXPECT_EQ(pixels, vb);
+
+    // A region spanning sparse and stored tiles.
+    VariantPixelBuffer region;
+    ASSERT_NO_THROW(ifd->readImage(region, 8, 8, 20, 20));
+    std::shared_ptr<PixelBuffer<uint16_t>> rbuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(region.vbuffer()));
+    EXPECT_EQ(42U, rbuf->data()[(12 * 20) + 12]);
+    EXPECT_EQ(1U, std::count(rbuf->data(), rbuf->data() + rbuf->num_elements(), 42U));
+  }
+}
+
+TEST(TIFFTest, TileDeduplication)
+{
+  using namespace ome::files::tiff;
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  dir /= "tile-dedup.tiff";
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = 48;
+  shape[::ome::files::DIM_SPATIAL_Y] = 32;
+  shape[::ome::files::DIM_SUBCHANNEL] = 1;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  // 3×2 tiles, alternately filled with 1 and 2.
+  VariantPixelBuffer pixels(shape, PT::UINT16);
+  std::shared_ptr<PixelBuffer<uint16_t>> pbuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(pixels.vbuffer()));
+  for (dimension_size_type y = 0; y < 32; ++y)
+    for (dimension_size_type x = 0; x < 48; ++x)
+      pbuf->data()[(y * 48) + x] = static_cast<uint16_t>((((y / 16) * 3 + (x / 16)) % 2) + 1);
+
+  {
+    std::shared_ptr<TIFF> wtiff;
+    ASSERT_NO_THROW(wtiff = TIFF::open(dir, "w"));
+    EXPECT_EQ(0U, wtiff->getTileDeduplication());
+    wtiff->setTileDeduplication(1024U * 1024U);
+    EXPECT_EQ(1024U * 1024U, wtiff->getTileDeduplication());
+
+    // Two directories, so that tiles are also shared between them.
+    for (unsigned int d = 0; d < 2; ++d)
+      {
+        std::shared_ptr<IFD> wifd;
+        ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+
+        ASSERT_NO_THROW(wifd->setImageWidth(48));
+        ASSERT_NO_THROW(wifd->setImageHeight(32));
+        ASSERT_NO_THROW(wifd->setTileType(TILE));
+        ASSERT_NO_THROW(wifd->setTileWidth(16));
+        ASSERT_NO_THROW(wifd->setTileHeight(16));
+        ASSERT_NO_THROW(wifd->setPixelType(PT::UINT16));
+        ASSERT_NO_THROW(wifd->setBitsPerSample(16));
+        ASSERT_NO_THROW(wifd->setSamplesPerPixel(1));
+        ASSERT_NO_THROW(wifd->setPlanarConfiguration(CONTIG));
+        ASSERT_NO_THROW(wifd->setPhotometricInterpretation(MIN_IS_BLACK));
+        ASSERT_NO_THROW(wifd->setCompression(COMPRESSION_ADOBE_DEFLATE));
+        ASSERT_NO_THROW(wifd->writeImage(pixels));
+        wtiff->writeCurrentDirectory();
+      }
+    wtiff->close();
+  }
+
+  {
+    std::shared_ptr<TIFF> tiff;
+    ASSERT_NO_THROW(tiff = TIFF::open(dir, "r"));
+
+    std::vector<uint64_t> first;
+    for (directory_index_type d = 0; d < 2; ++d)
+      {
+        std::shared_ptr<IFD> ifd;
+        ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(d));
+
+        std::vector<uint64_t> offsets;
+        ASSERT_NO_THROW(ifd->getField(TILEOFFSETS).get(offsets));
+        ASSERT_EQ(6U, offsets.size());
+        if (!d)
+          first = offsets;
+
+        // Only the first two tiles were written.
+        for (std::vector<uint64_t>::size_type i = 0; i < offsets.size(); ++i)
+          EXPECT_EQ(first[i % 2], offsets[i]);
+        EXPECT_NE(first[0], first[1]);
+
+        VariantPixelBuffer vb;
+        ASSERT_NO_THROW(ifd->readImage(vb));
+        EXPECT_EQ(pixels, vb);
+      }
+  }
+}
+
+TEST(TIFFTest, TileHashes)
+{
+  using namespace ome::files::tiff;
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = 48;
+  shape[::ome::files::DIM_SPATIAL_Y] = 32;
+  shape[::ome::files::DIM_SUBCHANNEL] = 1;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  // 3×2 tiles, alternately filled with 1 and 2.
+  VariantPixelBuffer pixels(shape, PT::UINT16);
+  std::shared_ptr<PixelBuffer<uint16_t>> pbuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(pixels.vbuffer()));
+  for (dimension_size_type y = 0; y < 32; ++y)
+    for (dimension_size_type x = 0; x < 48; ++x)
+      pbuf->data()[(y * 48) + x] = static_cast<uint16_t>((((y / 16) * 3 + (x / 16)) % 2) + 1);
+
+  auto setup = [](IFD& ifd, Compression compression)
+    {
+      ifd.setImageWidth(48);
+      ifd.setImageHeight(32);
+      ifd.setTileType(TILE);
+      ifd.setTileWidth(16);
+      ifd.setTileHeight(16);
+      ifd.setPixelType(PT::UINT16);
+      ifd.setBitsPerSample(16);
+      ifd.setSamplesPerPixel(1);
+      ifd.setPlanarConfiguration(CONTIG);
+      ifd.setPhotometricInterpretation(MIN_IS_BLACK);
+      ifd.setCompression(compression);
+    };
+
+  const path deflate(dir / "tile-hashes-deflate.tiff");
+  const path none(dir / "tile-hashes-none.tiff");
+  const path copy(dir / "tile-hashes-copy.tiff");
+  for (const auto& file : {std::make_pair(deflate, COMPRESSION_ADOBE_DEFLATE),
+                           std::make_pair(none, COMPRESSION_NONE)})
+    {
+      std::shared_ptr<TIFF> wtiff;
+      ASSERT_NO_THROW(wtiff = TIFF::open(file.first, "w"));
+      EXPECT_EQ(0U, wtiff->getTileHashes());
+      wtiff->setTileHashes(TILE_HASH_ENCODED | TILE_HASH_DECODED);
+      EXPECT_EQ(static_cast<unsigned int>(TILE_HASH_ENCODED | TILE_HASH_DECODED), wtiff->getTileHashes());
+
+      std::shared_ptr<IFD> wifd;
+      ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+      ASSERT_NO_THROW(setup(*wifd, file.second));
+      ASSERT_NO_THROW(wifd->writeImage(pixels));
+      wtiff->writeCurrentDirectory();
+      wtiff->close();
+    }
+
+  std::shared_ptr<TIFF> tiff;
+  ASSERT_NO_THROW(tiff = TIFF::open(deflate, "r"));
+  std::shared_ptr<IFD> ifd;
+  ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(0));
+
+  // Encoded hashes match the stored data.
+  std::vector<uint64_t> encoded(ifd->getTileHashes(TILE_HASH_ENCODED));
+  ASSERT_EQ(6U, encoded.size());
+  std::vector<std::vector<uint8_t>> raw(6U);
+  for (dimension_size_type tile = 0; tile < 6U; ++tile)
+    {
+      ASSERT_NO_THROW(ifd->readRawTile(tile, raw[tile]));
+      EXPECT_NE(0U, encoded[tile]);
+      EXPECT_EQ(tileHash(raw[tile].data(), raw[tile].size()), encoded[tile]);
+    }
+
+  // Decoded hashes match for identical tiles, whatever the
+  // compression.
+  std::vector<uint64_t> decoded(ifd->getTileHashes(TILE_HASH_DECODED));
+  ASSERT_EQ(6U, decoded.size());
+  for (dimension_size_type tile = 0; tile < 6U; ++tile)
+    EXPECT_EQ(decoded[tile % 2], decoded[tile]);
+  EXPECT_NE(decoded[0], decoded[1]);
+  {
+    std::shared_ptr<TIFF> ntiff;
+    ASSERT_NO_THROW(ntiff = TIFF::open(none, "r"));
+    std::shared_ptr<IFD> nifd(ntiff->getDirectoryByIndex(0));
+    EXPECT_EQ(decoded, nifd->getTileHashes(TILE_HASH_DECODED));
+    EXPECT_NE(encoded, nifd->getTileHashes(TILE_HASH_ENCODED));
+  }
+
+  // Raw tile copies record the same encoded hashes; no hashes are
+  // recorded unless enabled.
+  {
+    std::shared_ptr<TIFF> wtiff;
+    ASSERT_NO_THROW(wtiff = TIFF::open(copy, "w"));
+    wtiff->setTileHashes(TILE_HASH_ENCODED);
+    std::shared_ptr<IFD> wifd;
+    ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+    ASSERT_NO_THROW(setup(*wifd, COMPRESSION_ADOBE_DEFLATE));
+    for (dimension_size_type tile = 0; tile < 6U; ++tile)
+      ASSERT_NO_THROW(wifd->writeRawTile(tile, raw[tile].data(), raw[tile].size()));
+    wtiff->writeCurrentDirectory();
+    wtiff->close();
+  }
+  {
+    std::shared_ptr<TIFF> ctiff;
+    ASSERT_NO_THROW(ctiff = TIFF::open(copy, "r"));
+    std::shared_ptr<IFD> cifd(ctiff->getDirectoryByIndex(0));
+    EXPECT_EQ(encoded, cifd->getTileHashes(TILE_HASH_ENCODED));
+    EXPECT_TRUE(cifd->getTileHashes(TILE_HASH_DECODED).empty());
+  }
+}
+
+TEST(TIFFTest, TileSummaries)
+{
+  using namespace ome::files::tiff;
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = 48;
+  shape[::ome::files::DIM_SPATIAL_Y] = 40;
+  shape[::ome::files::DIM_SUBCHANNEL] = 1;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  // 3×3 tiles (the last row partial), all zero except for a single
+  // pixel of 100 in tile 0 and a 4×4 block of 4000-4015 in tile 4.
+  VariantPixelBuffer pixels(shape, PT::UINT16);
+  std::shared_ptr<PixelBuffer<uint16_t>> pbuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(pixels.vbuffer()));
+  std::fill(pbuf->data(), pbuf->data() + pbuf->num_elements(), 0U);
+  pbuf->data()[(3 * 48) + 5] = 100U;
+  for (dimension_size_type y = 0; y < 4; ++y)
+    for (dimension_size_type x = 0; x < 4; ++x)
+      pbuf->data()[((20 + y) * 48) + 24 + x] = static_cast<uint16_t>(4000U + (y * 4U) + x);
+
+  const path summarised(dir / "tile-summaries.tiff");
+  const path plain(dir / "tile-summaries-none.tiff");
+  for (const auto& file : {std::make_pair(summarised, true),
+                           std::make_pair(plain, false)})
+    {
+      std::shared_ptr<TIFF> wtiff;
+      ASSERT_NO_THROW(wtiff = TIFF::open(file.first, "w"));
+      EXPECT_FALSE(wtiff->getTileSummaries());
+      wtiff->setTileSummaries(file.second);
+      EXPECT_EQ(file.second, wtiff->getTileSummaries());
+      wtiff->setSparseTiles(true);
+
+      std::shared_ptr<IFD> wifd;
+      ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+      wifd->setImageWidth(48);
+      wifd->setImageHeight(40);
+      wifd->setTileType(TILE);
+      wifd->setTileWidth(16);
+      wifd->setTileHeight(16);
+      wifd->setPixelType(PT::UINT16);
+      wifd->setBitsPerSample(16);
+      wifd->setSamplesPerPixel(1);
+      wifd->setPlanarConfiguration(CONTIG);
+      wifd->setPhotometricInterpretation(MIN_IS_BLACK);
+      wifd->setCompression(COMPRESSION_ADOBE_DEFLATE);
+      ASSERT_NO_THROW(wifd->writeImage(pixels));
+      wtiff->writeCurrentDirectory();
+      wtiff->close();
+    }
+
+  std::shared_ptr<TIFF> tiff;
+  ASSERT_NO_THROW(tiff = TIFF::open(summarised, "r"));
+  std::shared_ptr<IFD> ifd;
+  ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(0));
+
+  std::vector<TileSummary> summaries(ifd->getTileSummaries());
+  ASSERT_EQ(9U, summaries.size());
+  for (dimension_size_type tile = 0; tile < 9U; ++tile)
+    {
+      EXPECT_TRUE(summaries[tile].known());
+      EXPECT_EQ(0.0, summaries[tile].min);
+      if (tile == 0U)
+        {
+          EXPECT_EQ(100.0, summaries[tile].max);
+          EXPECT_EQ(1U, summaries[tile].nonzero);
+        }
+      else if (tile == 4U)
+        {
+          EXPECT_EQ(4015.0, summaries[tile].max);
+          EXPECT_EQ(16U, summaries[tile].nonzero);
+        }
+      else
+        {
+          // Including sparse tiles, which are not stored.
+          EXPECT_EQ(0.0, summaries[tile].max);
+          EXPECT_EQ(0U, summaries[tile].nonzero);
+        }
+    }
+
+  auto visited = [](const IFD& i, double low, double high)
+    {
+      std::vector<PlaneRegion> regions;
+      i.forEachTileInRange(low, high,
+                           [&regions](const PlaneRegion& region, const VariantPixelBuffer&)
+                           { regions.push_back(region); });
+      return regions;
+    };
+
+  // Only the tile with values above the threshold is read.
+  std::vector<PlaneRegion> regions(visited(*ifd, 4000.0, std::numeric_limits<double>::infinity()));
+  ASSERT_EQ(1U, regions.size());
+  EXPECT_EQ(16U, regions[0].x);
+  EXPECT_EQ(16U, regions[0].y);
+  EXPECT_EQ(16U, regions[0].w);
+  EXPECT_EQ(16U, regions[0].h);
+  ifd->forEachTileInRange(4010.0, 4012.0,
+                          [](const PlaneRegion&, const VariantPixelBuffer& buf)
+                          {
+                            EXPECT_EQ(4000U, (buf.array<uint16_t>()[8][4][0][0][0][0][0][0][0]));
+                          });
+  EXPECT_EQ(2U, visited(*ifd, 1.0, std::numeric_limits<double>::infinity()).size());
+  EXPECT_TRUE(visited(*ifd, 5000.0, 6000.0).empty());
+  EXPECT_EQ(9U, visited(*ifd, 0.0, 0.0).size());
+  EXPECT_EQ(std::make_pair(0.0, 4015.0), ifd->getNormalizationRange());
+
+  // Without summaries, every tile is read, and the range of the
+  // pixel type is used for normalization.
+  std::shared_ptr<TIFF> ptiff;
+  ASSERT_NO_THROW(ptiff = TIFF::open(plain, "r"));
+  std::shared_ptr<IFD> pifd(ptiff->getDirectoryByIndex(0));
+  EXPECT_TRUE(pifd->getTileSummaries().empty());
+  EXPECT_EQ(9U, visited(*pifd, 4000.0, std::numeric_limits<double>::infinity()).size());
+  const ome::files::PixelStatistics typerange(PT::UINT16, 1U);
+  EXPECT_EQ(std::make_pair(typerange.getRangeMin(), typerange.getRangeMax()),
+            pifd->getNormalizationRange());
+}
+
+TEST(TIFFTest, HalfFloat)
+{
+  using namespace ome::files::tiff;
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  dir /= "half-float.tiff";
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = 37;
+  shape[::ome::files::DIM_SPATIAL_Y] = 23;
+  shape[::ome::files::DIM_SUBCHANNEL] = 1;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  // Values exactly representable in half precision.
+  VariantPixelBuffer pixels(shape, PT::FLOAT);
+  std::shared_ptr<PixelBuffer<float>> pbuf(ome::compat::get<std::shared_ptr<PixelBuffer<float>>>(pixels.vbuffer()));
+  for (std::size_t i = 0; i < pbuf->num_elements(); ++i)
+    pbuf->data()[i] = (static_cast<float>(i) - 400.0f) * 0.125f;
+
+  for (const auto type : {STRIP, TILE})
+    {
+      {
+        std::shared_ptr<TIFF> wtiff;
+        ASSERT_NO_THROW(wtiff = TIFF::open(dir, "w"));
+        std::shared_ptr<IFD> wifd;
+        ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+
+        ASSERT_NO_THROW(wifd->setImageWidth(37));
+        ASSERT_NO_THROW(wifd->setImageHeight(23));
+        ASSERT_NO_THROW(wifd->setTileType(type));
+        ASSERT_NO_THROW(wifd->setTileWidth(16));
+        ASSERT_NO_THROW(wifd->setTileHeight(16));
+        ASSERT_NO_THROW(wifd->setPixelType(PT::FLOAT));
+        ASSERT_NO_THROW(wifd->setBitsPerSample(16));
+        ASSERT_NO_THROW(wifd->setSamplesPerPixel(1));
+        ASSERT_NO_THROW(wifd->setPlanarConfiguration(CONTIG));
+        ASSERT_NO_THROW(wifd->setPhotometricInterpretation(MIN_IS_BLACK));
+        ASSERT_NO_THROW(wifd->setCompression(COMPRESSION_ADOBE_DEFLATE));
+        ASSERT_NO_THROW(wifd->writeImage(pixels));
+        wtiff->writeCurrentDirectory();
+        wtiff->close();
+      }
+
+      {
+        std::shared_ptr<TIFF> tiff;
+        ASSERT_NO_THROW(tiff = TIFF::open(dir, "r"));
+        std::shared_ptr<IFD> ifd;
+        ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(0));
+        EXPECT_EQ(16U, ifd->getBitsPerSample());
+        EXPECT_EQ(PT::FLOAT, ifd->getPixelType());
+
+        VariantPixelBuffer vb;
+        ASSERT_NO_THROW(ifd->readImage(vb));
+        EXPECT_EQ(pixels, vb);
+
+        VariantPixelBuffer region;
+        ASSERT_NO_THROW(ifd->readImage(region, 5, 7, 20, 10));
+        std::shared_ptr<PixelBuffer<float>> rbuf(ome::compat::get<std::shared_ptr<PixelBuffer<float>>>(region.vbuffer()));
+        EXPECT_EQ(pbuf->data()[(7 * 37) + 5], rbuf->data()[0]);
+      }
+    }
+}
+
+class TIFFMappingTest : public TIFFPixelsTest
+{
+public:
+  TIFFMappingTest():
+    TIFFPixelsTest("tiff-mapping")
+  {
+  }
+};
+
+TEST_F(TIFFMappingTest, MappedRead)
+{
+  // Mapped by default when reading.
+  std::shared_ptr<TIFF> mapped = TIFF::open(filenames.at(0), "r");
+  EXPECT_TRUE(mapped->isMapped());
+
+  // Mapping disabled explicitly.
+  std::shared_ptr<TIFF> unmapped = TIFF::open(filenames.at(0), "rm");
+  EXPECT_FALSE(unmapped->isMapped());
+
+  VariantPixelBuffer mplane, uplane;
+  ASSERT_NO_THROW(mapped->getDirectoryByIndex(0)->readImage(mplane));
+  ASSERT_NO_THROW(unmapped->getDirectoryByIndex(0)->readImage(uplane));
+  EXPECT_TRUE(expected.at(0) == mplane);
+  EXPECT_TRUE(expected.at(0) == uplane);
+}
+
+TEST(TIFFExpand, PaletteToRGB)
+{
+  using namespace ome::files::tiff;
+
+  path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  dir /= "expand-palette.tiff";
+
+  std::array<std::vector<uint16_t>, 3> cmap;
+  for (uint16_t i = 0; i < 256; ++i)
+    {
+      cmap[0].push_back(static_cast<uint16_t>(i * 256U));
+      cmap[1].push_back(static_cast<uint16_t>(65535U - i));
+      cmap[2].push_back(static_cast<uint16_t>(i * 3U));
+    }
+
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = 40;
+  shape[::ome::files::DIM_SPATIAL_Y] = 30;
+  shape[::ome::files::DIM_SUBCHANNEL] = 1;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  VariantPixelBuffer indexes(shape, PT::UINT8);
+  std::shared_ptr<PixelBuffer<uint8_t>> ibuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint8_t>>>(indexes.vbuffer()));
+  for (dimension_size_type i = 0; i < ibuf->num_elements(); ++i)
+    ibuf->data()[i] = static_cast<uint8_t>((i * 7U) % 256U);
+
+  {
+    std::shared_ptr<TIFF> wtiff;
+    ASSERT_NO_THROW(wtiff = TIFF::open(dir, "w"));
+    std::shared_ptr<IFD> wifd;
+    ASSERT_NO_THROW(wifd = wtiff->getCurrentDirectory());
+
+    ASSERT_NO_THROW(wifd->setImageWidth(40));
+    ASSERT_NO_THROW(wifd->setImageHeight(30));
+    ASSERT_NO_THROW(wifd->setTileType(TILE));
+    ASSERT_NO_THROW(wifd->setTileWidth(16));
+    ASSERT_NO_THROW(wifd->setTileHeight(16));
+    ASSERT_NO_THROW(wifd->setPixelType(PT::UINT8));
+    ASSERT_NO_THROW(wifd->setBitsPerSample(8));
+    ASSERT_NO_THROW(wifd->setSamplesPerPixel(1));
+    ASSERT_NO_THROW(wifd->setPlanarConfiguration(CONTIG));
+    ASSERT_NO_THROW(wifd->setPhotometricInterpretation(PALETTE));
+    ASSERT_NO_THROW(wifd->getField(COLORMAP).set(cmap));
+    ASSERT_NO_THROW(wifd->writeImage(indexes));
+    wtiff->writeCurrentDirectory();
+    wtiff->close();
+  }
+
+  std::shared_ptr<TIFF> tiff;
+  ASSERT_NO_THROW(tiff = TIFF::open(dir, "r"));
+  std::shared_ptr<IFD> ifd;
+  ASSERT_NO_THROW(ifd = tiff->getDirectoryByIndex(0));
+  ASSERT_TRUE(ifd->isExpandable());
+
+  std::shared_ptr<const std::vector<uint16_t>> lut(ifd->getLookupTable());
+  ASSERT_EQ(256U * 3U, lut->size());
+  // Cached for the directory.
+  EXPECT_EQ(lut, tiff->getDirectoryByIndex(0)->getLookupTable());
+
+  // Whole image, and a decimated region spanning several tiles.
+  const PlaneRegion full(0, 0, 40, 30);
+  const PlaneRegion part(5, 3, 30, 25);
+  for (const auto& r : {std::make_pair(full, 1U), std::make_pair(part, 3U)})
+    {
+      const PlaneRegion& region(r.first);
+      const dimension_size_type step(r.second);
+
+      VariantPixelBuffer rgb;
+      ASSERT_NO_THROW(ifd->readImageExpanded(rgb, region, step, step));
+      ASSERT_EQ(PT::UINT16, rgb.pixelType());
+      std::shared_ptr<PixelBuffer<uint16_t>> rbuf(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(rgb.vbuffer()));
+      ASSERT_EQ(3U, rbuf->shape()[::ome::files::DIM_SUBCHANNEL]);
+      ASSERT_EQ((region.w + step - 1U) / step, rbuf->shape()[::ome::files::DIM_SPATIAL_X]);
+      ASSERT_EQ((region.h + step - 1U) / step, rbuf->shape()[::ome::files::DIM_SPATIAL_Y]);
+
+      for (dimension_size_type y = 0; y < rbuf->shape()[::ome::files::DIM_SPATIAL_Y]; ++y)
+        for (dimension_size_type x = 0; x < rbuf->shape()[::ome::files::DIM_SPATIAL_X]; ++x)
+          {
+            PixelBuffer<uint8_t>::indices_type iidx;
+            std::fill(iidx.begin(), iidx.end(), 0);
+            iidx[::ome::files::DIM_SPATIAL_X] = region.x + (x * step);
+            iidx[::ome::files::DIM_SPATIAL_Y] = region.y + (y * step);
+            const uint8_t index = ibuf->at(iidx);
+
+            PixelBuffer<uint16_t>::indices_type ridx;
+            std::fill(ridx.begin(), ridx.end(), 0);
+            ridx[::ome::files::DIM_SPATIAL_X] = x;
+            ridx[::ome::files::DIM_SPATIAL_Y] = y;
+            for (dimension_size_type s = 0; s < 3U; ++s)
+              {
+                ridx[::ome::files::DIM_SUBCHANNEL] = s;
+                EXPECT_EQ(cmap[s][index], rbuf->at(ridx));
+              }
+          }
+    }
+
+  // Non-palette images are not expandable.
+  std::shared_ptr<TIFF> gray;
+  ASSERT_NO_THROW(gray = TIFF::open(PROJECT_SOURCE_DIR "/test/ome-files/data/2010-06-18x24y5z1t2c8b-text.ome.tiff", "r"));
+  EXPECT_FALSE(gray->getDirectoryByIndex(0)->isExpandable());
+}
+
+TEST(TIFFTiling, DefaultPolicy)
+{
+  using namespace ome::files::tiff;
+
+  TileGeometry g(defaultTileGeometry(TILING_DEFAULT, 512, 512, PT::UINT16, 1, COMPRESSION_ADOBE_DEFLATE));
+  EXPECT_EQ(STRIP, g.type);
+  EXPECT_EQ(512U, g.width);
+  EXPECT_EQ(128U, g.height);
+
+  g = defaultTileGeometry(TILING_DEFAULT, 4096, 4096, PT::UINT8, 3, COMPRESSION_NONE);
+  EXPECT_EQ(TILE, g.type);
+  EXPECT_EQ(256U, g.width);
+  EXPECT_EQ(256U, g.height);
+
+  EXPECT_THROW(defaultTileGeometry(TILING_DEFAULT, 0, 512, PT::UINT8, 1, COMPRESSION_NONE),
+               ome::files::FormatException);
+}
+
+TEST(TIFFTiling, ThroughputPolicy)
+{
+  using namespace ome::files::tiff;
+
+  // 1MiB uncompressed strips.
+  TileGeometry g(defaultTileGeometry(TILING_THROUGHPUT, 4096, 4096, PT::UINT16, 1, COMPRESSION_NONE));
+  EXPECT_EQ(STRIP, g.type);
+  EXPECT_EQ(4096U, g.width);
+  EXPECT_EQ(128U, g.height);
+
+  // Deflate doubles the uncompressed strip size.
+  g = defaultTileGeometry(TILING_THROUGHPUT, 4096, 4096, PT::UINT16, 1, COMPRESSION_ADOBE_DEFLATE);
+  EXPECT_EQ(STRIP, g.type);
+  EXPECT_EQ(256U, g.height);
+
+  // Strips no taller than the image.
+  g = defaultTileGeometry(TILING_THROUGHPUT, 64, 40, PT::UINT8, 1, COMPRESSION_NONE);
+  EXPECT_EQ(STRIP, g.type);
+  EXPECT_EQ(40U, g.height);
+
+  // Rows larger than the chunk size use tiles.
+  g = defaultTileGeometry(TILING_THROUGHPUT, 1000000, 1000, PT::UINT8, 3, COMPRESSION_NONE, 65536);
+  EXPECT_EQ(TILE, g.type);
+  EXPECT_EQ(144U, g.width);
+  EXPECT_EQ(144U, g.height);
+}
+
+TEST(TIFFTiling, RandomAccessPolicy)
+{
+  using namespace ome::files::tiff;
+
+  TileGeometry g(defaultTileGeometry(TILING_RANDOM_ACCESS, 100000, 80000, PT::UINT16, 1, COMPRESSION_ADOBE_DEFLATE));
+  EXPECT_EQ(TILE, g.type);
+  EXPECT_EQ(256U, g.width);
+  EXPECT_EQ(256U, g.height);
+
+  g = defaultTileGeometry(TILING_RANDOM_ACCESS, 100000, 80000, PT::UINT16, 1, COMPRESSION_ADOBE_DEFLATE, 1024 * 1024);
+  EXPECT_EQ(1024U, g.width);
+  EXPECT_EQ(1024U, g.height);
+
+  // Tiles no larger than the image rounded up to a multiple of 16.
+  g = defaultTileGeometry(TILING_RANDOM_ACCESS, 100, 20, PT::UINT8, 1, COMPRESSION_NONE);
+  EXPECT_EQ(TILE, g.type);
+  EXPECT_EQ(112U, g.width);
+  EXPECT_EQ(32U, g.height);
+}
+
 typedef std::tuple<uint32_t,uint32_t,PT,ome::files::tiff::PlanarConfiguration> plane_configuration;
 
 struct compare_tuple
@@ -1220,6 +2226,43 @@ TEST_P(TIFFVariantTest, PlaneArea3)
       }
 }
 
+// Check the tile range matches the tile coverage, both when iterated
+// and indexed, and that tile regions are consistent with their
+// row and column.
+TEST_P(TIFFVariantTest, TileRange)
+{
+  TileInfo info = ifd->getTileInfo();
+
+  std::vector<PlaneRegion> partials;
+  partials.push_back(PlaneRegion(0U, 0U, iwidth, iheight));
+  partials.push_back(PlaneRegion(7U, 18U, iwidth - 18U, iheight - 21U));
+  partials.push_back(PlaneRegion(iwidth - 1U, iheight - 1U, 1U, 1U));
+
+  for (const auto& partial : partials)
+    {
+      std::vector<dimension_size_type> tiles = info.tileCoverage(partial);
+      TileRange range = info.tileRange(partial);
+
+      ASSERT_EQ(tiles.size(), range.size());
+      EXPECT_FALSE(range.empty());
+      EXPECT_TRUE(std::equal(tiles.begin(), tiles.end(), range.begin()));
+      for (dimension_size_type i = 0; i < range.size(); ++i)
+        {
+          EXPECT_EQ(tiles.at(i), range[i]);
+
+          PlaneRegion r = info.tileRegion(range[i]);
+          EXPECT_EQ(info.tileColumn(range[i]) * info.tileWidth(), r.x);
+          EXPECT_EQ(info.tileRow(range[i]) * info.tileHeight(), r.y);
+          EXPECT_EQ(info.tileWidth(), r.w);
+          EXPECT_EQ(info.tileHeight(), r.h);
+        }
+    }
+
+  TileRange none = info.tileRange(PlaneRegion(0U, 0U, 0U, iheight));
+  EXPECT_TRUE(none.empty());
+  EXPECT_TRUE(none.begin() == none.end());
+}
+
 namespace
 {
   void
@@ -1354,6 +2397,118 @@ TEST_P(TIFFVariantTest, PlaneReadUnalignedTileRandom)
     }
 }
 
+TEST_P(TIFFVariantTest, PlaneReadDecimated)
+{
+  VariantPixelBuffer full;
+  ifd->readImage(full);
+
+  std::vector<PlaneRegion> regions;
+  regions.push_back(PlaneRegion(0, 0, iwidth, iheight));
+  regions.push_back(PlaneRegion(3, 5, iwidth - 7, iheight - 9));
+
+  const std::vector<dimension_size_type> steps{1U, 2U, 3U, 8U};
+
+  for (const auto& region : regions)
+    for (const auto xstep : steps)
+      for (const auto ystep : steps)
+        {
+          VariantPixelBuffer vb;
+          ASSERT_NO_THROW(ifd->readImage(vb, region, xstep, ystep));
+          DecimatedCompareVisitor v(full, region, xstep, ystep);
+          EXPECT_TRUE(ome::compat::visit(v, vb.vbuffer()));
+        }
+
+  VariantPixelBuffer vb;
+  EXPECT_THROW(ifd->readImage(vb, regions.front(), 0U, 1U), ome::files::tiff::Exception);
+}
+
+TEST_P(TIFFVariantTest, PlaneReadPlanar)
+{
+  const ::ome::files::PixelBufferBase::storage_order_type order_planar
+    (::ome::files::PixelBufferBase::make_storage_order(::ome::xml::model::enums::DimensionOrder::XYZTC, false));
+
+  std::vector<PlaneRegion> regions;
+  regions.push_back(PlaneRegion(0, 0, iwidth, iheight));
+  regions.push_back(PlaneRegion(3, 5, iwidth - 7, iheight - 9));
+
+  for (const auto& region : regions)
+    {
+      VariantPixelBuffer expected;
+      ifd->readImage(expected, region.x, region.y, region.w, region.h);
+
+      std::array<VariantPixelBuffer::size_type, 9> shape;
+      std::copy(expected.shape(), expected.shape() + ::ome::files::PixelBufferBase::dimensions,
+                shape.begin());
+
+      VariantPixelBuffer vb;
+      vb.setBuffer(shape, expected.pixelType(), order_planar);
+      ASSERT_NO_THROW(ifd->readImage(vb, region.x, region.y, region.w, region.h));
+      if (expected.pixelType() != PT::BIT)
+        EXPECT_TRUE(order_planar == vb.storage_order());
+      EXPECT_TRUE(expected == vb);
+
+      VariantPixelBuffer decimated;
+      ifd->readImage(decimated, region, 2U, 3U);
+      std::copy(decimated.shape(), decimated.shape() + ::ome::files::PixelBufferBase::dimensions,
+                shape.begin());
+      vb.setBuffer(shape, decimated.pixelType(), order_planar);
+      ASSERT_NO_THROW(ifd->readImage(vb, region, 2U, 3U));
+      EXPECT_TRUE(decimated == vb);
+    }
+}
+
+TEST_P(TIFFVariantTest, PlaneReadSubchannel)
+{
+  std::vector<PlaneRegion> regions;
+  regions.push_back(PlaneRegion(0, 0, iwidth, iheight));
+  regions.push_back(PlaneRegion(3, 5, iwidth - 7, iheight - 9));
+
+  for (const auto& region : regions)
+    for (dimension_size_type s = 0; s < ifd->getSamplesPerPixel(); ++s)
+      {
+        VariantPixelBuffer all;
+        ifd->readImage(all, region.x, region.y, region.w, region.h);
+
+        VariantPixelBuffer expected;
+        ome::files::detail::CopySubchannelVisitor cv(expected, s);
+        ome::compat::visit(cv, all.vbuffer());
+
+        VariantPixelBuffer vb;
+        ASSERT_NO_THROW(ifd->readImage(vb, region.x, region.y, region.w, region.h, s));
+        EXPECT_EQ(1U, vb.shape()[ome::files::DIM_SUBCHANNEL]);
+        EXPECT_TRUE(expected == vb);
+      }
+
+  VariantPixelBuffer vb;
+  EXPECT_THROW(ifd->readImage(vb, ifd->getSamplesPerPixel()), ome::files::tiff::Exception);
+}
+
+TEST_P(TIFFVariantTest, PlaneReadForEachTile)
+{
+  TileInfo info = ifd->getTileInfo();
+
+  std::vector<PlaneRegion> regions;
+  std::vector<dimension_size_type> coverage(iwidth * iheight);
+
+  auto check = [&](const PlaneRegion& region, const VariantPixelBuffer& buf)
+    {
+      regions.push_back(region);
+      for (dimension_size_type y = region.y; y < region.y + region.h; ++y)
+        for (dimension_size_type x = region.x; x < region.x + region.w; ++x)
+          ++coverage[(y * iwidth) + x];
+
+      VariantPixelBuffer expected;
+      ifd->readImage(expected, region.x, region.y, region.w, region.h);
+      EXPECT_TRUE(expected == buf);
+    };
+  ASSERT_NO_THROW(ifd->forEachTile(check));
+
+  // One callback per spatial tile, covering every pixel once.
+  EXPECT_EQ(info.tileRowCount() * info.tileColumnCount(), regions.size());
+  EXPECT_TRUE(std::all_of(coverage.begin(), coverage.end(),
+                          [](dimension_size_type c) { return c == 1U; }));
+}
+
 class PixelTestParameters
 {
 public:
@@ -0,0 +1,393 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/PlaneRegion.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/in/MinimalTIFFReader.h>
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/Exception.h>
+#include <ome/files/tiff/IFD.h>
+#include <ome/files/tiff/TIFF.h>
+#include <ome/files/tiff/Types.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::VariantPixelBuffer;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+
+// Concurrent reading of independent TIFF files.  Each thread reads
+// a separate file; with per-TIFF locking the threads should not
+// contend with each other, and throughput should scale with the
+// thread count (up to the available cores and I/O bandwidth).  Set
+// OME_FILES_TEST_VERBOSE=true to show the timings.
+
+namespace
+{
+
+  const dimension_size_type repeat_count = 4U;
+
+  void
+  read_files(const std::vector<boost::filesystem::path>& filenames,
+             dimension_size_type                         thread_index,
+             dimension_size_type                         thread_count,
+             std::vector<VariantPixelBuffer>&            results)
+  {
+    for (dimension_size_type r = 0; r < repeat_count; ++r)
+      for (dimension_size_type f = thread_index; f < filenames.size(); f += thread_count)
+        {
+          std::shared_ptr<TIFF> tiff = TIFF::open(filenames.at(f), "r");
+          std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+          ifd->readImage(results.at(f));
+        }
+  }
+
+}
+
+class TIFFConcurrencyTest : public TIFFPixelsTest
+{
+public:
+  TIFFConcurrencyTest():
+    TIFFPixelsTest("concurrency")
+  {
+  }
+};
+
+TEST_F(TIFFConcurrencyTest, ThreadScaling)
+{
+  const std::vector<dimension_size_type> thread_counts{1U, 2U, 4U, 8U};
+  const double plane_mib = static_cast<double>(image_size * image_size * sizeof(uint16_pixel_type)) / (1024.0 * 1024.0);
+
+  double baseline = 0.0;
+
+  for (auto thread_count : thread_counts)
+    {
+      std::vector<VariantPixelBuffer> results(filenames.size());
+      std::vector<std::thread> threads;
+
+      auto start = std::chrono::steady_clock::now();
+      for (dimension_size_type t = 0; t < thread_count; ++t)
+        threads.push_back(std::thread(read_files, std::cref(filenames), t, thread_count, std::ref(results)));
+      for (auto& thread : threads)
+        thread.join();
+      auto end = std::chrono::steady_clock::now();
+
+      for (dimension_size_type f = 0; f < filenames.size(); ++f)
+        EXPECT_TRUE(expected.at(f) == results.at(f));
+
+      double seconds = std::chrono::duration<double>(end - start).count();
+      double throughput = (plane_mib * static_cast<double>(file_count * repeat_count)) / seconds;
+      if (thread_count == 1U)
+        baseline = throughput;
+
+      if (verbose())
+        std::cout << thread_count << " thread(s): "
+                  << throughput << " MiB/s ("
+                  << (baseline > 0.0 ? throughput / baseline : 0.0) << "× single thread)\n";
+    }
+}
+
+TEST_F(TIFFConcurrencyTest, ParallelDecode)
+{
+  const std::vector<unsigned int> thread_counts{1U, 2U, 3U, 8U, 128U};
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(filenames.at(0), "r");
+  std::shared_ptr<IFD> ifd = tiff->getDirectoryByIndex(0);
+
+  VariantPixelBuffer serial_region;
+  ifd->readImage(serial_region, 10U, 27U, 300U, 141U);
+
+  for (auto thread_count : thread_counts)
+    {
+      tiff->setDecodeThreads(thread_count);
+      EXPECT_EQ(thread_count, tiff->getDecodeThreads());
+
+      VariantPixelBuffer plane;
+      ASSERT_NO_THROW(ifd->readImage(plane));
+      EXPECT_TRUE(expected.at(0) == plane);
+
+      VariantPixelBuffer region;
+      ASSERT_NO_THROW(ifd->readImage(region, 10U, 27U, 300U, 141U));
+      EXPECT_TRUE(serial_region == region);
+    }
+
+  tiff->setDecodeThreads(0U);
+  EXPECT_EQ(1U, tiff->getDecodeThreads());
+}
+
+TEST_F(TIFFConcurrencyTest, ReadHandlePool)
+{
+  boost::filesystem::path multiname(datafile("pool.tiff"));
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(multiname, "w");
+    for (dimension_size_type p = 0; p < file_count; ++p)
+      {
+        std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+        setup_ifd(ifd);
+        ifd->writeImage(expected.at(p));
+        tiff->writeCurrentDirectory();
+      }
+    tiff->close();
+  }
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(multiname, "r");
+  EXPECT_EQ(0U, tiff->getReadHandles());
+  tiff->setReadHandles(2U);
+  EXPECT_EQ(2U, tiff->getReadHandles());
+
+  // Returned handles are reused, preferring one at the directory.
+  const ome::files::tiff::offset_type offset1 = tiff->getDirectoryByIndex(1)->getOffset();
+  TIFF::wrapped_type *first = nullptr;
+  {
+    std::shared_ptr<TIFF::wrapped_type> handle0(tiff->borrowReadHandle(tiff->getDirectoryByIndex(0)->getOffset()));
+    std::shared_ptr<TIFF::wrapped_type> handle1(tiff->borrowReadHandle(offset1));
+    EXPECT_NE(handle0.get(), handle1.get());
+    EXPECT_NE(tiff->getWrapped(), handle1.get());
+    first = handle1.get();
+  }
+  {
+    std::shared_ptr<TIFF::wrapped_type> handle(tiff->borrowReadHandle(offset1));
+    EXPECT_EQ(first, handle.get());
+  }
+
+  // Each thread reads every plane, starting at a different plane, so
+  // that different planes of the file are read concurrently.
+  const dimension_size_type thread_count = 4U;
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(thread_count);
+  std::vector<int> matched(thread_count * file_count, 0);
+  for (dimension_size_type t = 0; t < thread_count; ++t)
+    {
+      threads.push_back(std::thread([&, t]()
+        {
+          try
+            {
+              for (dimension_size_type i = 0; i < file_count; ++i)
+                {
+                  const dimension_size_type p = (t + i) % file_count;
+                  VariantPixelBuffer plane;
+                  tiff->getDirectoryByIndex(p)->readImage(plane);
+                  matched[(t * file_count) + p] = expected.at(p) == plane ? 1 : 0;
+                }
+            }
+          catch (...)
+            {
+              errors[t] = std::current_exception();
+            }
+        }));
+    }
+  for (auto& thread : threads)
+    thread.join();
+  for (const auto& error : errors)
+    if (error)
+      std::rethrow_exception(error);
+  for (const auto m : matched)
+    EXPECT_TRUE(m != 0);
+
+  tiff->setReadHandles(0U);
+  VariantPixelBuffer plane;
+  ASSERT_NO_THROW(tiff->getDirectoryByIndex(2)->readImage(plane));
+  EXPECT_TRUE(expected.at(2) == plane);
+
+  tiff->close();
+  boost::filesystem::remove(multiname);
+}
+
+TEST_F(TIFFConcurrencyTest, ParallelDecodeWriteMode)
+{
+  boost::filesystem::path name(datafile("write.tiff"));
+  std::shared_ptr<TIFF> tiff = TIFF::open(name, "w");
+  ASSERT_THROW(tiff->openReadHandle(), ome::files::tiff::Exception);
+  tiff->close();
+  boost::filesystem::remove(name);
+}
+
+TEST_F(TIFFConcurrencyTest, ParallelEncode)
+{
+  boost::filesystem::path name(datafile("encode.tiff"));
+  const std::vector<unsigned int> thread_counts{1U, 4U};
+  const std::vector<std::string> codecs{"Deflate", "LZW", "PackBits"};
+
+  for (const auto& codec : codecs)
+    for (auto thread_count : thread_counts)
+      {
+        {
+          std::shared_ptr<TIFF> tiff = TIFF::open(name, "w");
+          tiff->setEncodeThreads(thread_count);
+          EXPECT_EQ(thread_count, tiff->getEncodeThreads());
+          std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+          setup_ifd(ifd);
+          ifd->setCompression(ome::files::tiff::getCodecScheme(codec));
+
+          // Whole plane, then in bands of tile rows.
+          ASSERT_NO_THROW(ifd->writeImage(expected.at(0)));
+          tiff->writeCurrentDirectory();
+
+          ifd = tiff->getCurrentDirectory();
+          setup_ifd(ifd);
+          ifd->setCompression(ome::files::tiff::getCodecScheme(codec));
+          std::shared_ptr<TIFF> src = TIFF::open(filenames.at(1), "r");
+          for (dimension_size_type y = 0; y < image_size; y += tile_size * 2U)
+            {
+              VariantPixelBuffer band;
+              src->getDirectoryByIndex(0)->readImage(band, 0U, y, image_size, tile_size * 2U);
+              ASSERT_NO_THROW(ifd->writeImage(band, 0U, y, image_size, tile_size * 2U));
+            }
+          src->close();
+          tiff->writeCurrentDirectory();
+          tiff->close();
+        }
+
+        std::shared_ptr<TIFF> tiff = TIFF::open(name, "r");
+        ASSERT_EQ(2U, tiff->directoryCount());
+        for (dimension_size_type d = 0; d < 2U; ++d)
+          {
+            VariantPixelBuffer plane;
+            ASSERT_NO_THROW(tiff->getDirectoryByIndex(d)->readImage(plane));
+            EXPECT_TRUE(expected.at(d) == plane);
+          }
+        tiff->close();
+        boost::filesystem::remove(name);
+      }
+
+  std::shared_ptr<TIFF> tiff = TIFF::open(name, "w");
+  tiff->setEncodeThreads(0U);
+  EXPECT_EQ(1U, tiff->getEncodeThreads());
+  tiff->close();
+  boost::filesystem::remove(name);
+}
+
+TEST_F(TIFFConcurrencyTest, SharedReader)
+{
+  boost::filesystem::path name(datafile("shared.tiff"));
+  const dimension_size_type thread_count = 4U;
+
+  {
+    std::shared_ptr<TIFF> tiff = TIFF::open(name, "w");
+    for (const auto& pixels : expected)
+      {
+        std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+        setup_ifd(ifd);
+        ifd->writeImage(pixels);
+        tiff->writeCurrentDirectory();
+      }
+    tiff->close();
+  }
+
+  ome::files::in::MinimalTIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(name));
+  ASSERT_EQ(expected.size(), reader.getImageCount());
+
+  // One reader serves all the threads; each reads every plane in
+  // full and as four quadrants.
+  const dimension_size_type half = image_size / 2U;
+  std::vector<std::vector<VariantPixelBuffer>> planes(thread_count);
+  std::vector<std::vector<VariantPixelBuffer>> quadrants(thread_count);
+  std::vector<std::exception_ptr> errors(thread_count);
+  std::vector<std::thread> threads;
+  for (dimension_size_type t = 0; t < thread_count; ++t)
+    threads.push_back(std::thread([&, t]()
+      {
+        try
+          {
+            planes[t].resize(expected.size());
+            quadrants[t].resize(expected.size() * 4U);
+            for (dimension_size_type r = 0; r < repeat_count; ++r)
+              for (dimension_size_type i = 0; i < expected.size(); ++i)
+                {
+                  dimension_size_type p = (i + t) % expected.size();
+                  reader.openBytesAt(0U, 0U, p, planes[t][p],
+                                     ome::files::PlaneRegion(0U, 0U, image_size, image_size));
+                  for (dimension_size_type q = 0; q < 4U; ++q)
+                    reader.openBytesAt(0U, 0U, p, quadrants[t][(p * 4U) + q],
+                                       ome::files::PlaneRegion((q % 2U) * half, (q / 2U) * half, half, half));
+                }
+          }
+        catch (...)
+          {
+            errors[t] = std::current_exception();
+          }
+      }));
+  for (auto& thread : threads)
+    thread.join();
+
+  for (const auto& error : errors)
+    ASSERT_FALSE(static_cast<bool>(error));
+
+  // The current plane is unchanged.
+  EXPECT_EQ(0U, reader.getPlane());
+
+  for (dimension_size_type t = 0; t < thread_count; ++t)
+    for (dimension_size_type p = 0; p < expected.size(); ++p)
+      {
+        EXPECT_TRUE(expected.at(p) == planes[t][p]);
+        const uint16_pixel_type *data = expected.at(p).data<uint16_pixel_type>();
+        for (dimension_size_type q = 0; q < 4U; ++q)
+          {
+            const uint16_pixel_type *qdata = quadrants[t][(p * 4U) + q].data<uint16_pixel_type>();
+            dimension_size_type x0 = (q % 2U) * half;
+            dimension_size_type y0 = (q / 2U) * half;
+            for (dimension_size_type y = 0; y < half; ++y)
+              for (dimension_size_type x = 0; x < half; ++x)
+                ASSERT_EQ(data[((y0 + y) * image_size) + x0 + x], qdata[(y * half) + x]);
+          }
+      }
+
+  VariantPixelBuffer invalid;
+  ASSERT_THROW(reader.openBytesAt(0U, 0U, expected.size(), invalid, ome::files::PlaneRegion(0U, 0U, 1U, 1U)), std::logic_error);
+
+  reader.close();
+  boost::filesystem::remove(name);
+}
+
@@ -0,0 +1,141 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <array>
+#include <sstream>
+#include <stdexcept>
+
+#include <ome/files/tiff/Codec.h>
+#include <ome/files/tiff/TIFF.h>
+
+#include "tiffpixels.h"
+
+using ome::files::dimension_size_type;
+using ome::files::PixelBufferBase;
+using ome::files::VariantPixelBuffer;
+using ome::files::tiff::IFD;
+using ome::files::tiff::TIFF;
+typedef ome::xml::model::enums::PixelType PT;
+
+VariantPixelBuffer
+make_pixels(dimension_size_type seed)
+{
+  std::array<VariantPixelBuffer::size_type, 9> shape;
+  shape[::ome::files::DIM_SPATIAL_X] = image_size;
+  shape[::ome::files::DIM_SPATIAL_Y] = image_size;
+  shape[::ome::files::DIM_SUBCHANNEL] = 1U;
+  shape[::ome::files::DIM_SPATIAL_Z] = shape[::ome::files::DIM_TEMPORAL_T] = shape[::ome::files::DIM_CHANNEL] =
+    shape[::ome::files::DIM_MODULO_Z] = shape[::ome::files::DIM_MODULO_T] = shape[::ome::files::DIM_MODULO_C] = 1;
+
+  PixelBufferBase::storage_order_type order
+    (PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+
+  VariantPixelBuffer buf(shape, PT::UINT16, order);
+  uint16_pixel_type *data = buf.data<uint16_pixel_type>();
+  for (dimension_size_type i = 0; i < buf.num_elements(); ++i)
+    data[i] = static_cast<uint16_pixel_type>((i * 7U + seed * 131U) % 4096U);
+
+  return buf;
+}
+
+void
+setup_ifd(std::shared_ptr<IFD>& ifd)
+{
+  ifd->setImageWidth(image_size);
+  ifd->setImageHeight(image_size);
+  ifd->setTileType(ome::files::tiff::TILE);
+  ifd->setTileWidth(tile_size);
+  ifd->setTileHeight(tile_size);
+  ifd->setPixelType(PT::UINT16);
+  ifd->setBitsPerSample(16U);
+  ifd->setSamplesPerPixel(1U);
+  ifd->setPlanarConfiguration(ome::files::tiff::CONTIG);
+  ifd->setPhotometricInterpretation(ome::files::tiff::MIN_IS_BLACK);
+  ifd->setCompression(ome::files::tiff::getCodecScheme("Deflate"));
+}
+
+void
+write_file(const boost::filesystem::path& filename,
+           const VariantPixelBuffer&      pixels)
+{
+  std::shared_ptr<TIFF> tiff = TIFF::open(filename, "w");
+  std::shared_ptr<IFD> ifd = tiff->getCurrentDirectory();
+
+  setup_ifd(ifd);
+  ifd->writeImage(pixels);
+  tiff->writeCurrentDirectory();
+  tiff->close();
+}
+
+TIFFPixelsTest::TIFFPixelsTest(const std::string& prefix):
+  filenames(),
+  expected(),
+  prefix(prefix)
+{
+}
+
+boost::filesystem::path
+TIFFPixelsTest::datafile(const std::string& name) const
+{
+  return boost::filesystem::path(PROJECT_BINARY_DIR "/test/ome-files/data") / (prefix + "-" + name);
+}
+
+void
+TIFFPixelsTest::SetUp()
+{
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+
+  for (dimension_size_type f = 0; f < file_count; ++f)
+    {
+      std::ostringstream name;
+      name << f << ".tiff";
+      filenames.push_back(datafile(name.str()));
+      expected.push_back(make_pixels(f));
+      write_file(filenames.back(), expected.back());
+    }
+}
+
+void
+TIFFPixelsTest::TearDown()
+{
+  for (const auto& f : filenames)
+    if (boost::filesystem::exists(f))
+      boost::filesystem::remove(f);
+}
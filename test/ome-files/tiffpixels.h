@@ -0,0 +1,145 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#ifndef TEST_TIFFPIXELS_H
+#define TEST_TIFFPIXELS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/PixelProperties.h>
+#include <ome/files/Types.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/tiff/IFD.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+// Tiled uint16 TIFF files with known pixel values, for tests of
+// reading and writing through the TIFF layer.
+
+/// Pixel type of the test images.
+typedef ome::files::PixelProperties<ome::xml::model::enums::PixelType::UINT16>::std_type uint16_pixel_type;
+
+/// Width and height of the test images.
+const ome::files::dimension_size_type image_size = 512U;
+/// Width and height of the tiles of the test images.
+const ome::files::dimension_size_type tile_size = 64U;
+/// Number of test images.
+const ome::files::dimension_size_type file_count = 8U;
+
+/**
+ * Create the pixels of a test image.
+ *
+ * @param seed the seed for the pixel values.
+ * @returns an image_size × image_size uint16 plane.
+ */
+ome::files::VariantPixelBuffer
+make_pixels(ome::files::dimension_size_type seed);
+
+/**
+ * Set the tags for a test image.
+ *
+ * The image is tiled, with Deflate compression.
+ *
+ * @param ifd the directory to set up.
+ */
+void
+setup_ifd(std::shared_ptr<ome::files::tiff::IFD>& ifd);
+
+/**
+ * Write a test image to a single-directory TIFF file.
+ *
+ * @param filename the file to write.
+ * @param pixels the pixels to write.
+ */
+void
+write_file(const boost::filesystem::path&        filename,
+           const ome::files::VariantPixelBuffer& pixels);
+
+/**
+ * Test fixture providing test images.
+ *
+ * file_count files are written on set up and removed on tear down.
+ * The files are named using the prefix given by the derived
+ * fixture, so that tests run concurrently do not share files.
+ */
+class TIFFPixelsTest : public ::testing::Test
+{
+public:
+  /// Test files.
+  std::vector<boost::filesystem::path> filenames;
+  /// Pixels of each test file.
+  std::vector<ome::files::VariantPixelBuffer> expected;
+
+  /**
+   * Constructor.
+   *
+   * @param prefix the prefix of the test file names.
+   */
+  explicit
+  TIFFPixelsTest(const std::string& prefix);
+
+  /**
+   * Get the path of a temporary file for a test.
+   *
+   * @param name the name of the file, without prefix.
+   * @returns the path.
+   */
+  boost::filesystem::path
+  datafile(const std::string& name) const;
+
+  virtual void SetUp();
+
+  virtual void TearDown();
+
+private:
+  /// Prefix of the test file names.
+  std::string prefix;
+};
+
+#endif // TEST_TIFFPIXELS_H
+
+/*
+ * Local Variables:
+ * mode:C++
+ * End:
+ */
@@ -36,15 +36,25 @@
  * #L%
  */
 
+#include <algorithm>
+#include <array>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <ome/files/PixelBuffer.h>
+#include <ome/files/PlaneRegion.h>
 #include <ome/files/VariantPixelBuffer.h>
 #include <ome/files/in/TIFFReader.h>
 
 #include <ome/test/test.h>
 
 using ome::files::dimension_size_type;
+using ome::files::PixelBuffer;
 using ome::files::VariantPixelBuffer;
 using ome::files::in::TIFFReader;
 
@@ -147,6 +157,392 @@ TEST_P(TIFFTest, openBytes)
     }
 }
 
+TEST_P(TIFFTest, openBytesPrefetch)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  std::vector<VariantPixelBuffer> expected;
+  {
+    TIFFReader ref;
+    ASSERT_NO_THROW(ref.setId(params.file));
+    for (dimension_size_type p = 0; p < ref.getImageCount(); ++p)
+      {
+        VariantPixelBuffer buf;
+        ASSERT_NO_THROW(ref.openBytes(p, buf));
+        expected.push_back(buf);
+      }
+  }
+
+  EXPECT_EQ(0U, tiff.getPrefetchPlanes());
+  tiff.setPrefetchPlanes(3U);
+  EXPECT_EQ(3U, tiff.getPrefetchPlanes());
+  ASSERT_NO_THROW(tiff.setId(params.file));
+
+  // Sequential access is served from the prefetched planes.
+  for (dimension_size_type p = 0; p < tiff.getImageCount(); ++p)
+    {
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(tiff.openBytes(p, buf));
+      EXPECT_TRUE(expected.at(p) == buf);
+    }
+
+  // Non-sequential access and region reads are also correct.
+  for (dimension_size_type p = tiff.getImageCount(); p > 0; p -= 2)
+    {
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(tiff.openBytes(p - 1, buf));
+      EXPECT_TRUE(expected.at(p - 1) == buf);
+      VariantPixelBuffer region;
+      ASSERT_NO_THROW(tiff.openBytes(p - 1, region, 2U, 3U, 5U, 7U));
+      ASSERT_EQ(5U * 7U, region.num_elements());
+      if (p < 2)
+        break;
+    }
+
+  ASSERT_NO_THROW(tiff.close());
+}
+
+TEST_P(TIFFTest, openBytesBatch)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  ASSERT_NO_THROW(tiff.setId(params.file));
+
+  std::vector<ome::files::PlaneRegion> regions;
+  regions.push_back(ome::files::PlaneRegion(0U, 0U, tiff.getSizeX(), tiff.getSizeY()));
+  regions.push_back(ome::files::PlaneRegion(2U, 3U, 5U, 7U));
+  regions.push_back(ome::files::PlaneRegion(1U, 1U, tiff.getSizeX() - 1U, 4U));
+
+  for (dimension_size_type p = 0; p < tiff.getImageCount(); ++p)
+    {
+      std::vector<VariantPixelBuffer> batch;
+      ASSERT_NO_THROW(tiff.openBytesBatch(p, regions, batch));
+      ASSERT_EQ(regions.size(), batch.size());
+      for (std::vector<ome::files::PlaneRegion>::size_type r = 0; r < regions.size(); ++r)
+        {
+          VariantPixelBuffer buf;
+          ASSERT_NO_THROW(tiff.openBytes(p, buf, regions[r].x, regions[r].y, regions[r].w, regions[r].h));
+          EXPECT_TRUE(buf == batch.at(r));
+        }
+    }
+
+  ASSERT_NO_THROW(tiff.close());
+}
+
+TEST_P(TIFFTest, openBytesDecimated)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  ASSERT_NO_THROW(tiff.setId(params.file));
+
+  const ome::files::PlaneRegion full(0U, 0U, tiff.getSizeX(), tiff.getSizeY());
+  const ome::files::PlaneRegion partial(2U, 3U, 11U, 7U);
+
+  for (dimension_size_type p = 0; p < tiff.getImageCount(); ++p)
+    {
+      // A step of one is a plain region read.
+      VariantPixelBuffer buf;
+      VariantPixelBuffer decimated;
+      ASSERT_NO_THROW(tiff.openBytes(p, buf, partial.x, partial.y, partial.w, partial.h));
+      ASSERT_NO_THROW(tiff.openBytesDecimated(p, decimated, partial, 1U, 1U));
+      EXPECT_TRUE(buf == decimated);
+
+      ASSERT_NO_THROW(tiff.openBytesDecimated(p, decimated, full, 4U, 3U));
+      EXPECT_EQ(((tiff.getSizeX() + 3U) / 4U) * ((tiff.getSizeY() + 2U) / 3U), decimated.num_elements());
+
+      ASSERT_NO_THROW(tiff.openBytesDecimated(p, decimated, partial, 3U, 2U));
+      EXPECT_EQ(4U * 4U, decimated.num_elements());
+
+      // Each sampled pixel matches the pixel at its position.
+      ASSERT_NO_THROW(tiff.openBytesDecimated(p, decimated, partial, 11U, 7U));
+      ASSERT_NO_THROW(tiff.openBytes(p, buf, partial.x, partial.y, 1U, 1U));
+      EXPECT_TRUE(buf == decimated);
+    }
+
+  VariantPixelBuffer buf;
+  EXPECT_THROW(tiff.openBytesDecimated(0U, buf, full, 0U, 2U), std::logic_error);
+
+  ASSERT_NO_THROW(tiff.close());
+}
+
+TEST_P(TIFFTest, forEachTile)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  ASSERT_NO_THROW(tiff.setId(params.file));
+
+  for (dimension_size_type p = 0; p < tiff.getImageCount(); ++p)
+    {
+      std::vector<ome::files::PlaneRegion> regions;
+      std::vector<VariantPixelBuffer> bufs;
+      auto collect = [&](const ome::files::PlaneRegion& region, const VariantPixelBuffer& buf)
+        {
+          regions.push_back(region);
+          bufs.emplace_back();
+          std::array<VariantPixelBuffer::size_type, ome::files::PixelBufferBase::dimensions> shape;
+          std::copy(buf.shape(), buf.shape() + ome::files::PixelBufferBase::dimensions, shape.begin());
+          bufs.back().setBuffer(shape, buf.pixelType(), buf.storage_order());
+          bufs.back() = buf;
+        };
+      ASSERT_NO_THROW(tiff.forEachTile(p, collect));
+
+      dimension_size_type area = 0;
+      for (std::vector<ome::files::PlaneRegion>::size_type r = 0; r < regions.size(); ++r)
+        {
+          area += regions[r].area();
+          VariantPixelBuffer buf;
+          ASSERT_NO_THROW(tiff.openBytes(p, buf, regions[r].x, regions[r].y, regions[r].w, regions[r].h));
+          EXPECT_TRUE(buf == bufs.at(r));
+        }
+      EXPECT_EQ(tiff.getSizeX() * tiff.getSizeY(), area);
+    }
+
+  ASSERT_NO_THROW(tiff.close());
+}
+
+TEST_P(TIFFTest, openThumbBytes)
+{
+  const TIFFTestParameters& params = GetParam();
+
+  ASSERT_NO_THROW(tiff.setId(params.file));
+
+  // The image is smaller than the default thumbnail size, so the
+  // thumbnail is the whole plane.
+  for (dimension_size_type p = 0; p < tiff.getImageCount(); ++p)
+    {
+      VariantPixelBuffer buf;
+      VariantPixelBuffer thumb;
+      ASSERT_NO_THROW(tiff.openBytes(p, buf));
+      ASSERT_NO_THROW(tiff.openThumbBytes(p, thumb));
+      EXPECT_EQ(tiff.getThumbSizeX() * tiff.getThumbSizeY(), thumb.num_elements());
+      EXPECT_TRUE(buf == thumb);
+
+      // Cached thumbnails are copied.
+      VariantPixelBuffer cached;
+      ASSERT_NO_THROW(tiff.openThumbBytes(p, cached));
+      EXPECT_TRUE(thumb == cached);
+    }
+
+  ASSERT_NO_THROW(tiff.close());
+}
+
+namespace
+{
+
+  // Pixel value of the synthetic ImageJ planes.
+  uint16_t
+  imagej_value(dimension_size_type plane,
+               dimension_size_type x,
+               dimension_size_type y,
+               dimension_size_type width)
+  {
+    return static_cast<uint16_t>((plane * 1000U) + (y * width) + x);
+  }
+
+  // Write a little-endian ImageJ hyperstack in the layout ImageJ
+  // uses for large files: a single IFD for the first plane, with all
+  // of the planes stored contiguously and uncompressed.
+  boost::filesystem::path
+  write_imagej_raw(uint32_t width,
+                   uint32_t height,
+                   uint32_t slices,
+                   uint32_t frames)
+  {
+    boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+    if (!boost::filesystem::exists(dir) && !boost::filesystem::create_directories(dir))
+      throw std::runtime_error("Image directory unavailable and could not be created");
+    boost::filesystem::path filename(dir / "imagej-raw.tif");
+
+    const uint32_t images = slices * frames;
+    std::string desc("ImageJ=1.52a\nimages=" + std::to_string(images) +
+                     "\nslices=" + std::to_string(slices) +
+                     "\nframes=" + std::to_string(frames) +
+                     "\nhyperstack=true\n");
+    desc.push_back('\0');
+
+    std::vector<uint8_t> data;
+    auto put16 = [&data](uint16_t v)
+      {
+        data.push_back(static_cast<uint8_t>(v & 0xFFU));
+        data.push_back(static_cast<uint8_t>(v >> 8));
+      };
+    auto put32 = [&](uint32_t v)
+      {
+        put16(static_cast<uint16_t>(v & 0xFFFFU));
+        put16(static_cast<uint16_t>(v >> 16));
+      };
+    auto entry = [&](uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+      {
+        put16(tag);
+        put16(type);
+        put32(count);
+        if (type == 3U && count == 1U) // SHORT
+          {
+            put16(static_cast<uint16_t>(value));
+            put16(0U);
+          }
+        else
+          put32(value);
+      };
+
+    const uint16_t entries = 10U;
+    const uint32_t descoffset = 8U + 2U + (entries * 12U) + 4U;
+    const uint32_t pixeloffset = (descoffset + static_cast<uint32_t>(desc.size()) + 1U) & ~1U;
+    const uint32_t planesize = width * height * 2U;
+
+    data.push_back('I');
+    data.push_back('I');
+    put16(42U);
+    put32(8U);
+    put16(entries);
+    entry(256U, 4U, 1U, width);                   // ImageWidth
+    entry(257U, 4U, 1U, height);                  // ImageLength
+    entry(258U, 3U, 1U, 16U);                     // BitsPerSample
+    entry(259U, 3U, 1U, 1U);                      // Compression
+    entry(262U, 3U, 1U, 1U);                      // PhotometricInterpretation
+    entry(270U, 2U, static_cast<uint32_t>(desc.size()), descoffset); // ImageDescription
+    entry(273U, 4U, 1U, pixeloffset);             // StripOffsets
+    entry(277U, 3U, 1U, 1U);                      // SamplesPerPixel
+    entry(278U, 4U, 1U, height);                  // RowsPerStrip
+    entry(279U, 4U, 1U, planesize);               // StripByteCounts
+    put32(0U);
+    data.insert(data.end(), desc.begin(), desc.end());
+    while (data.size() < pixeloffset)
+      data.push_back(0U);
+
+    for (uint32_t p = 0; p < images; ++p)
+      for (uint32_t y = 0; y < height; ++y)
+        for (uint32_t x = 0; x < width; ++x)
+          put16(imagej_value(p, x, y, width));
+
+    boost::filesystem::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!out)
+      throw std::runtime_error("Failed to write ImageJ TIFF");
+
+    return filename;
+  }
+
+}
+
+TEST(TIFFReaderImageJ, RawPlanes)
+{
+  const uint32_t width = 7U;
+  const uint32_t height = 5U;
+  boost::filesystem::path filename(write_imagej_raw(width, height, 3U, 2U));
+
+  TIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(filename));
+
+  EXPECT_EQ(1U, reader.getSeriesCount());
+  EXPECT_EQ(width, reader.getSizeX());
+  EXPECT_EQ(height, reader.getSizeY());
+  EXPECT_EQ(3U, reader.getSizeZ());
+  EXPECT_EQ(2U, reader.getSizeT());
+  ASSERT_EQ(6U, reader.getImageCount());
+
+  const ome::files::PlaneRegion partial(2U, 1U, 4U, 3U);
+
+  // Planes are read in reverse to check random access.
+  for (dimension_size_type p = reader.getImageCount(); p > 0; --p)
+    {
+      const dimension_size_type plane = p - 1U;
+
+      VariantPixelBuffer buf;
+      ASSERT_NO_THROW(reader.openBytes(plane, buf));
+      std::shared_ptr<PixelBuffer<uint16_t>> pixels(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(buf.vbuffer()));
+      PixelBuffer<uint16_t>::indices_type idx;
+      std::fill(idx.begin(), idx.end(), 0);
+      for (dimension_size_type y = 0; y < height; ++y)
+        for (dimension_size_type x = 0; x < width; ++x)
+          {
+            idx[ome::files::DIM_SPATIAL_X] = x;
+            idx[ome::files::DIM_SPATIAL_Y] = y;
+            EXPECT_EQ(imagej_value(plane, x, y, width), pixels->at(idx));
+          }
+
+      VariantPixelBuffer region;
+      ASSERT_NO_THROW(reader.openBytes(plane, region, partial.x, partial.y, partial.w, partial.h));
+      std::shared_ptr<PixelBuffer<uint16_t>> rpixels(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(region.vbuffer()));
+      for (dimension_size_type y = 0; y < partial.h; ++y)
+        for (dimension_size_type x = 0; x < partial.w; ++x)
+          {
+            idx[ome::files::DIM_SPATIAL_X] = x;
+            idx[ome::files::DIM_SPATIAL_Y] = y;
+            EXPECT_EQ(imagej_value(plane, partial.x + x, partial.y + y, width), rpixels->at(idx));
+          }
+
+      VariantPixelBuffer at;
+      ASSERT_NO_THROW(reader.openBytesAt(0U, 0U, plane, at, partial));
+      EXPECT_TRUE(region == at);
+
+      std::vector<uint8_t> raw;
+      ASSERT_NO_THROW(reader.openRawTile(plane, 0U, raw));
+      ASSERT_EQ(width * height * 2U, raw.size());
+      EXPECT_EQ(imagej_value(plane, 0U, 0U, width), raw[0] | (raw[1] << 8));
+    }
+
+  VariantPixelBuffer buf;
+  EXPECT_THROW(reader.openBytes(reader.getImageCount(), buf), std::logic_error);
+
+  ASSERT_NO_THROW(reader.close());
+}
+
+TEST(TIFFReaderImageJ, PlaneStack)
+{
+  const uint32_t width = 7U;
+  const uint32_t height = 5U;
+  boost::filesystem::path filename(write_imagej_raw(width, height, 3U, 2U));
+
+  TIFFReader reader;
+  ASSERT_NO_THROW(reader.setId(filename));
+
+  const ome::files::PlaneRegion partial(2U, 1U, 4U, 3U);
+  const TIFFReader::plane_range zRange{{1U, 3U}};
+  const TIFFReader::plane_range cRange{{0U, 1U}};
+  const TIFFReader::plane_range tRange{{0U, 2U}};
+
+  for (unsigned int threads = 1U; threads <= 4U; threads *= 4U)
+    {
+      reader.setDecodeThreads(threads);
+
+      VariantPixelBuffer stack;
+      ASSERT_NO_THROW(reader.openBytesStack(0U, 0U, zRange, cRange, tRange, stack, partial));
+      EXPECT_EQ(partial.w, stack.shape()[ome::files::DIM_SPATIAL_X]);
+      EXPECT_EQ(partial.h, stack.shape()[ome::files::DIM_SPATIAL_Y]);
+      EXPECT_EQ(2U, stack.shape()[ome::files::DIM_SPATIAL_Z]);
+      EXPECT_EQ(1U, stack.shape()[ome::files::DIM_CHANNEL]);
+      EXPECT_EQ(2U, stack.shape()[ome::files::DIM_TEMPORAL_T]);
+
+      std::shared_ptr<PixelBuffer<uint16_t>> pixels(ome::compat::get<std::shared_ptr<PixelBuffer<uint16_t>>>(stack.vbuffer()));
+      PixelBuffer<uint16_t>::indices_type idx;
+      std::fill(idx.begin(), idx.end(), 0);
+      for (dimension_size_type t = 0; t < 2U; ++t)
+        for (dimension_size_type z = 0; z < 2U; ++z)
+          {
+            const dimension_size_type plane = reader.getIndex(zRange[0] + z, 0U, t);
+            idx[ome::files::DIM_SPATIAL_Z] = z;
+            idx[ome::files::DIM_TEMPORAL_T] = t;
+            for (dimension_size_type y = 0; y < partial.h; ++y)
+              for (dimension_size_type x = 0; x < partial.w; ++x)
+                {
+                  idx[ome::files::DIM_SPATIAL_X] = x;
+                  idx[ome::files::DIM_SPATIAL_Y] = y;
+                  EXPECT_EQ(imagej_value(plane, partial.x + x, partial.y + y, width), pixels->at(idx));
+                }
+          }
+    }
+
+  VariantPixelBuffer buf;
+  const TIFFReader::plane_range empty{{1U, 1U}};
+  const TIFFReader::plane_range outside{{2U, 4U}};
+  EXPECT_THROW(reader.openBytesStack(0U, 0U, empty, cRange, tRange, buf, partial), std::logic_error);
+  EXPECT_THROW(reader.openBytesStack(0U, 0U, outside, cRange, tRange, buf, partial), std::logic_error);
+  EXPECT_THROW(reader.openBytesStack(1U, 0U, zRange, cRange, tRange, buf, partial), std::logic_error);
+
+  ASSERT_NO_THROW(reader.close());
+}
+
 namespace
 {
 
@@ -36,6 +36,8 @@
  * #L%
  */
 
+#include <cstdint>
+
 #include <ome/files/TileBuffer.h>
 
 #include <ome/test/test.h>
@@ -50,3 +52,12 @@ TEST(TileBuffer, Construct)
   for (int i =0; i < 50; ++i)
     ASSERT_EQ(0U, *(b.data()+i));
 }
+
+TEST(TileBuffer, Alignment)
+{
+  for (int size = 1; size < 300; size += 37)
+    {
+      TileBuffer b(size);
+      ASSERT_EQ(0U, reinterpret_cast<std::uintptr_t>(b.data()) % TileBuffer::alignment);
+    }
+}
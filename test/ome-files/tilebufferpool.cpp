@@ -0,0 +1,137 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+
+#include <ome/files/Types.h>
+#include <ome/files/TileBuffer.h>
+#include <ome/files/TileBufferPool.h>
+
+#include <ome/test/test.h>
+
+using ome::files::dimension_size_type;
+using ome::files::TileBuffer;
+using ome::files::TileBufferPool;
+
+TEST(TileBufferPool, Create)
+{
+  std::shared_ptr<TileBufferPool> p(TileBufferPool::create());
+  ASSERT_EQ(TileBufferPool::default_limit, p->getLimit());
+  ASSERT_EQ(0U, p->size());
+
+  ASSERT_TRUE(static_cast<bool>(TileBufferPool::global()));
+}
+
+TEST(TileBufferPool, Acquire)
+{
+  std::shared_ptr<TileBufferPool> p(TileBufferPool::create());
+
+  std::shared_ptr<TileBuffer> b(p->acquire(8192U));
+  ASSERT_EQ(8192U, b->size());
+  ASSERT_EQ(0U, reinterpret_cast<std::uintptr_t>(b->data()) % TileBuffer::alignment);
+  for (dimension_size_type i = 0; i < b->size(); ++i)
+    ASSERT_EQ(0U, b->data()[i]);
+  ASSERT_EQ(0U, p->size());
+}
+
+TEST(TileBufferPool, Reuse)
+{
+  std::shared_ptr<TileBufferPool> p(TileBufferPool::create());
+
+  const TileBuffer *addr;
+  {
+    std::shared_ptr<TileBuffer> b(p->acquire(8192U));
+    b->data()[0] = 42U;
+    addr = b.get();
+  }
+  ASSERT_EQ(8192U, p->size());
+
+  {
+    // Not cleared.
+    std::shared_ptr<TileBuffer> b(p->acquire(8192U, false));
+    ASSERT_EQ(addr, b.get());
+    ASSERT_EQ(42U, b->data()[0]);
+    ASSERT_EQ(0U, p->size());
+  }
+
+  {
+    // Cleared.
+    std::shared_ptr<TileBuffer> b(p->acquire(8192U));
+    ASSERT_EQ(addr, b.get());
+    ASSERT_EQ(0U, b->data()[0]);
+  }
+
+  {
+    // Different size class.
+    std::shared_ptr<TileBuffer> b(p->acquire(4096U));
+    ASSERT_EQ(4096U, b->size());
+    ASSERT_EQ(8192U, p->size());
+  }
+  ASSERT_EQ(8192U + 4096U, p->size());
+
+  p->clear();
+  ASSERT_EQ(0U, p->size());
+}
+
+TEST(TileBufferPool, Limit)
+{
+  std::shared_ptr<TileBufferPool> p(TileBufferPool::create(16384U));
+
+  {
+    std::shared_ptr<TileBuffer> b1(p->acquire(8192U));
+    std::shared_ptr<TileBuffer> b2(p->acquire(8192U));
+    std::shared_ptr<TileBuffer> b3(p->acquire(8192U));
+  }
+  // Only two buffers fit within the limit.
+  ASSERT_EQ(16384U, p->size());
+
+  p->setLimit(8192U);
+  ASSERT_EQ(8192U, p->getLimit());
+  ASSERT_EQ(8192U, p->size());
+}
+
+TEST(TileBufferPool, OutlivePool)
+{
+  std::shared_ptr<TileBuffer> b;
+  {
+    std::shared_ptr<TileBufferPool> p(TileBufferPool::create());
+    b = p->acquire(8192U);
+  }
+  // Released after the pool is destroyed.
+  b.reset();
+}
@@ -133,3 +133,94 @@ TEST(TileCache, Clear)
   c.clear();
   ASSERT_EQ(0U, c.size());
 }
+
+TEST(TileCache, Reserve)
+{
+  TileCache c(64U);
+  ASSERT_EQ(0U, c.size());
+
+  c.reserve(128U);
+  ASSERT_EQ(0U, c.size());
+  ASSERT_FALSE(static_cast<bool>(c.find(127U)));
+  ASSERT_FALSE(static_cast<bool>(c.find(1000U)));
+
+  // Slots beyond the reservation are added on demand.
+  ASSERT_TRUE(c.insert(1000U, std::shared_ptr<TileBuffer>(new TileBuffer((8192)))));
+  ASSERT_TRUE(static_cast<bool>(c.find(1000U)));
+  ASSERT_EQ(1U, c.size());
+}
+
+TEST(TileCache, Acquire)
+{
+  TileCache c;
+
+  TileBuffer& b1(c.acquire(3U, 8192U));
+  ASSERT_EQ(8192U, b1.size());
+  ASSERT_EQ(1U, c.size());
+
+  // Existing tiles are returned unchanged.
+  b1.data()[0] = 42U;
+  TileBuffer& b2(c.acquire(3U, 8192U));
+  ASSERT_EQ(&b1, &b2);
+  ASSERT_EQ(42U, b2.data()[0]);
+  ASSERT_EQ(1U, c.size());
+}
+
+TEST(TileCache, AcquireRecycle)
+{
+  TileCache c;
+
+  TileBuffer& b1(c.acquire(0U, 8192U));
+  b1.data()[0] = 42U;
+  const TileBuffer *p1 = &b1;
+  c.erase(0U);
+  ASSERT_EQ(0U, c.size());
+
+  // The erased buffer is reused for a new tile, and zero-filled.
+  TileBuffer& b2(c.acquire(1U, 8192U));
+  ASSERT_EQ(p1, &b2);
+  ASSERT_EQ(0U, b2.data()[0]);
+
+  // Buffers of a different size are not reused.
+  c.erase(1U);
+  TileBuffer& b3(c.acquire(2U, 4096U));
+  ASSERT_EQ(4096U, b3.size());
+}
+
+TEST(TileCache, EraseReferenced)
+{
+  TileCache c;
+
+  c.acquire(0U, 8192U);
+  std::shared_ptr<TileBuffer> held(c.find(0U));
+  c.erase(0U);
+
+  // A buffer still referenced elsewhere must not be reused.
+  TileBuffer& b(c.acquire(1U, 8192U));
+  ASSERT_NE(held.get(), &b);
+}
+
+TEST(TileCache, FreeLimit)
+{
+  TileCache c;
+  ASSERT_EQ(TileCache::default_free_limit, c.getFreeLimit());
+
+  c.setFreeLimit(2U);
+  ASSERT_EQ(2U, c.getFreeLimit());
+
+  for (dimension_size_type i = 0; i < 4U; ++i)
+    c.acquire(i, 8192U);
+  c.clear();
+
+  // Only two buffers are kept; the others are released to the pool.
+  ASSERT_EQ(2U, c.freeSize());
+
+  c.setFreeLimit(1U);
+  ASSERT_EQ(1U, c.freeSize());
+
+  c.setFreeLimit(0U);
+  ASSERT_EQ(0U, c.freeSize());
+  c.acquire(0U, 8192U);
+  c.erase(0U);
+  ASSERT_EQ(0U, c.freeSize());
+}
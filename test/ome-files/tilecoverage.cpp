@@ -36,6 +36,8 @@
  * #L%
  */
 
+#include <algorithm>
+
 #include <ome/files/Types.h>
 #include <ome/files/TileCoverage.h>
 
@@ -207,3 +209,37 @@ TEST(TileCoverage, CoverageIncomplete1)
   ASSERT_EQ(16U * 16U, c.coverage(r));
   ASSERT_TRUE(c.covered(r));
 }
+
+// Scanline writes to tiles, stored as tile row intervals
+TEST(TileCoverage, TileRows)
+{
+  TileCoverage c(64, 16);
+  for (dimension_size_type y = 0; y < 48; ++y)
+    for (dimension_size_type x = 0; x < 200; x += 64)
+      {
+        PlaneRegion r(x, y, std::min(dimension_size_type(64U), 200U - x), 1);
+        ASSERT_TRUE(c.insert(r));
+
+        PlaneRegion tile(x, (y / 16U) * 16U, r.w, 16);
+        if (y % 16U == 15U)
+          ASSERT_TRUE(c.covered(tile));
+        else
+          ASSERT_FALSE(c.covered(tile));
+      }
+  // One region per tile after automatic coalescing
+  ASSERT_EQ(4U * 3U, c.size());
+
+  // Unaligned regions are checked against the tile rows.
+  ASSERT_FALSE(c.insert(PlaneRegion(10, 10, 5, 5)));
+  ASSERT_TRUE(c.insert(PlaneRegion(10, 50, 5, 5)));
+  ASSERT_EQ((200U * 48U) + (5U * 5U), c.coverage(PlaneRegion(0, 0, 200, 60)));
+
+  // Aligned regions are checked against unaligned regions.
+  ASSERT_FALSE(c.insert(PlaneRegion(0, 48, 64, 3)));
+  ASSERT_TRUE(c.insert(PlaneRegion(0, 48, 64, 2)));
+  ASSERT_EQ((200U * 48U) + (5U * 5U) + (64U * 2U), c.coverage(PlaneRegion(0, 0, 200, 64)));
+
+  c.clear();
+  ASSERT_EQ(0U, c.size());
+  ASSERT_EQ(0U, c.coverage(PlaneRegion(0, 0, 200, 64)));
+}
@@ -0,0 +1,118 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <ome/files/detail/TileDedup.h>
+
+#include <ome/test/test.h>
+
+using ome::files::detail::TileDedup;
+
+namespace
+{
+
+  std::vector<uint8_t>
+  tile(uint8_t     value,
+       std::size_t size)
+  {
+    return std::vector<uint8_t>(size, value);
+  }
+
+}
+
+TEST(TileDedup, FindInserted)
+{
+  TileDedup dedup(1024U);
+  EXPECT_EQ(1024U, dedup.getLimit());
+
+  std::vector<uint8_t> a(tile(1U, 100U));
+  std::vector<uint8_t> b(tile(2U, 100U));
+  uint64_t offset = 0U;
+
+  EXPECT_FALSE(dedup.find(a.data(), a.size(), offset));
+  dedup.insert(a.data(), a.size(), 8U);
+  dedup.insert(b.data(), b.size(), 108U);
+  EXPECT_EQ(200U, dedup.size());
+
+  EXPECT_TRUE(dedup.find(a.data(), a.size(), offset));
+  EXPECT_EQ(8U, offset);
+  EXPECT_TRUE(dedup.find(b.data(), b.size(), offset));
+  EXPECT_EQ(108U, offset);
+
+  // Same size, differing content.
+  std::vector<uint8_t> c(a);
+  c[50] = 7U;
+  EXPECT_FALSE(dedup.find(c.data(), c.size(), offset));
+
+  // Prefix of existing data.
+  EXPECT_FALSE(dedup.find(a.data(), a.size() - 1U, offset));
+}
+
+TEST(TileDedup, Limit)
+{
+  TileDedup dedup(300U);
+
+  std::vector<uint8_t> a(tile(1U, 100U));
+  std::vector<uint8_t> b(tile(2U, 100U));
+  std::vector<uint8_t> c(tile(3U, 100U));
+  std::vector<uint8_t> d(tile(4U, 100U));
+  std::vector<uint8_t> large(tile(5U, 301U));
+  uint64_t offset = 0U;
+
+  dedup.insert(a.data(), a.size(), 0U);
+  dedup.insert(b.data(), b.size(), 100U);
+  dedup.insert(c.data(), c.size(), 200U);
+
+  // Use a, so that b is the least recently used.
+  EXPECT_TRUE(dedup.find(a.data(), a.size(), offset));
+
+  dedup.insert(d.data(), d.size(), 300U);
+  EXPECT_EQ(300U, dedup.size());
+  EXPECT_TRUE(dedup.find(a.data(), a.size(), offset));
+  EXPECT_FALSE(dedup.find(b.data(), b.size(), offset));
+  EXPECT_TRUE(dedup.find(c.data(), c.size(), offset));
+  EXPECT_TRUE(dedup.find(d.data(), d.size(), offset));
+  EXPECT_EQ(300U, offset);
+
+  // Too large to hold.
+  dedup.insert(large.data(), large.size(), 400U);
+  EXPECT_FALSE(dedup.find(large.data(), large.size(), offset));
+  EXPECT_EQ(300U, dedup.size());
+}
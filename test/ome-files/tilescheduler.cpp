@@ -0,0 +1,316 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ome/files/Executor.h>
+#include <ome/files/ReadCancelledException.h>
+#include <ome/files/TileScheduler.h>
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/detail/FormatReader.h>
+
+#include <ome/test/test.h>
+
+using ome::files::CoreMetadata;
+using ome::files::PlaneRegion;
+using ome::files::ReadCancelledException;
+using ome::files::ThreadPoolExecutor;
+using ome::files::TileRequest;
+using ome::files::TileScheduler;
+using ome::files::VariantPixelBuffer;
+using ome::files::detail::ReaderProperties;
+using ome::files::dimension_size_type;
+using ome::xml::model::enums::DimensionOrder;
+using ome::xml::model::enums::PixelType;
+
+namespace
+{
+
+  ReaderProperties
+  test_properties()
+  {
+    ReaderProperties p("SchedulerTestReader", "Reader for tile scheduler testing");
+    p.suffixes.push_back("test");
+    return p;
+  }
+
+  const ReaderProperties props(test_properties());
+
+  TileRequest
+  tile(dimension_size_type plane)
+  {
+    return TileRequest(0U, 0U, plane, PlaneRegion(0U, 0U, 2U, 2U));
+  }
+
+}
+
+// Reader generating 2×2 UINT8 planes with the plane index as the
+// pixel value, and recording the order of reads.  Reads block while
+// the reader is held.
+class SchedulerTestReader : public ome::files::detail::FormatReader
+{
+public:
+  mutable std::mutex mutex;
+  mutable std::condition_variable changed;
+  /// Reads block while held.
+  bool held;
+  /// Number of reads waiting while held.
+  mutable unsigned int waiting;
+  /// Planes read, in order.
+  mutable std::vector<dimension_size_type> reads;
+
+  SchedulerTestReader():
+    ome::files::detail::FormatReader(props),
+    mutex(),
+    changed(),
+    held(false),
+    waiting(0U),
+    reads()
+  {
+  }
+
+  void
+  hold()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    held = true;
+  }
+
+  void
+  release()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    held = false;
+    changed.notify_all();
+  }
+
+  void
+  waitForReader()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return waiting > 0U; });
+  }
+
+protected:
+  void
+  initFile(const boost::filesystem::path& id)
+  {
+    ome::files::detail::FormatReader::initFile(id);
+
+    std::shared_ptr<CoreMetadata> c(std::make_shared<CoreMetadata>());
+    c->sizeX = 2;
+    c->sizeY = 2;
+    c->sizeZ = 16;
+    c->sizeT = 1;
+    c->sizeC.clear();
+    c->sizeC.push_back(1);
+    c->pixelType = PixelType::UINT8;
+    c->imageCount = c->sizeZ;
+    c->dimensionOrder = DimensionOrder::XYZCT;
+    c->orderCertain = true;
+    c->interleaved = false;
+    c->indexed = false;
+    c->resolutionCount = 1;
+
+    core.clear();
+    core.push_back(c);
+  }
+
+  void
+  openBytesImpl(dimension_size_type plane,
+                VariantPixelBuffer& buf,
+                dimension_size_type /* x */,
+                dimension_size_type /* y */,
+                dimension_size_type w,
+                dimension_size_type h) const
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ++waiting;
+      changed.notify_all();
+      changed.wait(lock, [this]() { return !held; });
+      --waiting;
+      reads.push_back(plane);
+    }
+
+    preparePlane(buf, w, h, 1U);
+    for (dimension_size_type j = 0; j < h; ++j)
+      for (dimension_size_type i = 0; i < w; ++i)
+        buf.array<uint8_t>()[i][j][0][0][0][0][0][0][0] = static_cast<uint8_t>(plane);
+  }
+};
+
+class TileSchedulerTest : public ::testing::Test
+{
+public:
+  std::shared_ptr<SchedulerTestReader> reader;
+  std::shared_ptr<ThreadPoolExecutor> executor;
+
+  void
+  SetUp()
+  {
+    reader = std::make_shared<SchedulerTestReader>();
+    reader->setId("test");
+    executor = std::make_shared<ThreadPoolExecutor>(2U);
+  }
+};
+
+TEST_F(TileSchedulerTest, Read)
+{
+  TileScheduler scheduler(reader, executor);
+
+  std::vector<TileScheduler::future_type> results;
+  for (dimension_size_type p = 0; p < 16U; ++p)
+    results.push_back(scheduler.request(tile(p), 0));
+
+  for (dimension_size_type p = 0; p < 16U; ++p)
+    {
+      TileScheduler::result_type buf(results.at(p).get());
+      ASSERT_TRUE(static_cast<bool>(buf));
+      EXPECT_EQ(p, buf->array<uint8_t>()[1][1][0][0][0][0][0][0][0]);
+    }
+
+  scheduler.wait();
+  EXPECT_EQ(0U, scheduler.queued());
+  EXPECT_EQ(0U, scheduler.active());
+  EXPECT_EQ(16U, reader->reads.size());
+}
+
+TEST_F(TileSchedulerTest, Priority)
+{
+  TileScheduler scheduler(reader, executor, 1U);
+
+  // Occupy the single runner until all requests are queued.
+  reader->hold();
+  TileScheduler::future_type first(scheduler.request(tile(0U), 0));
+  reader->waitForReader();
+
+  scheduler.request(tile(1U), 1);
+  scheduler.request(tile(2U), 5);
+  scheduler.request(tile(3U), 3);
+  scheduler.request(tile(4U), 3);
+  scheduler.request(tile(5U), 0);
+  EXPECT_EQ(5U, scheduler.queued());
+
+  // Raise by a duplicate request and by a priority change.
+  scheduler.request(tile(5U), 4);
+  EXPECT_TRUE(scheduler.setPriority(tile(1U), 10));
+  EXPECT_FALSE(scheduler.setPriority(tile(0U), 10));
+  EXPECT_EQ(5U, scheduler.queued());
+
+  reader->release();
+  scheduler.wait();
+
+  const std::vector<dimension_size_type> expected{0U, 1U, 2U, 5U, 3U, 4U};
+  EXPECT_EQ(expected, reader->reads);
+  EXPECT_EQ(0U, first.get()->array<uint8_t>()[0][0][0][0][0][0][0][0][0]);
+}
+
+TEST_F(TileSchedulerTest, Merge)
+{
+  TileScheduler scheduler(reader, executor, 1U);
+
+  reader->hold();
+  TileScheduler::future_type a(scheduler.request(tile(0U), 0));
+  reader->waitForReader();
+  // Merged with the active request.
+  TileScheduler::future_type b(scheduler.request(tile(0U), 0));
+  TileScheduler::future_type c(scheduler.request(tile(1U), 0));
+  // Merged with the queued request.
+  TileScheduler::future_type d(scheduler.request(tile(1U), 0));
+  EXPECT_EQ(1U, scheduler.queued());
+  reader->release();
+
+  EXPECT_EQ(a.get(), b.get());
+  EXPECT_EQ(c.get(), d.get());
+  EXPECT_EQ(2U, reader->reads.size());
+}
+
+TEST_F(TileSchedulerTest, Cancel)
+{
+  TileScheduler scheduler(reader, executor, 1U);
+
+  reader->hold();
+  TileScheduler::future_type active(scheduler.request(tile(0U), 0));
+  reader->waitForReader();
+  TileScheduler::future_type queued(scheduler.request(tile(1U), 0));
+  TileScheduler::future_type kept(scheduler.request(tile(2U), 0));
+
+  EXPECT_TRUE(scheduler.cancel(tile(1U)));
+  EXPECT_FALSE(scheduler.cancel(tile(1U)));
+  EXPECT_FALSE(scheduler.cancel(tile(7U)));
+  EXPECT_THROW(queued.get(), ReadCancelledException);
+  EXPECT_EQ(1U, scheduler.queued());
+
+  reader->release();
+  EXPECT_NO_THROW(active.get());
+  EXPECT_NO_THROW(kept.get());
+  scheduler.wait();
+
+  const std::vector<dimension_size_type> expected{0U, 2U};
+  EXPECT_EQ(expected, reader->reads);
+
+  // A cancelled tile may be requested again.
+  EXPECT_NO_THROW(scheduler.request(tile(1U), 0).get());
+}
+
+TEST_F(TileSchedulerTest, CancelAll)
+{
+  std::vector<TileScheduler::future_type> results;
+  {
+    TileScheduler scheduler(reader, executor, 1U);
+
+    reader->hold();
+    results.push_back(scheduler.request(tile(0U), 0));
+    reader->waitForReader();
+    for (dimension_size_type p = 1; p < 8U; ++p)
+      results.push_back(scheduler.request(tile(p), 0));
+
+    scheduler.cancelAll();
+    EXPECT_EQ(0U, scheduler.queued());
+    reader->release();
+  }
+
+  // The active read is not interrupted within the plane.
+  EXPECT_NO_THROW(results.at(0).get());
+  for (dimension_size_type p = 1; p < 8U; ++p)
+    EXPECT_THROW(results.at(p).get(), ReadCancelledException);
+}
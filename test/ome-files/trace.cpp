@@ -0,0 +1,149 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <ome/files/Trace.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::ChromeTraceSink;
+using ome::files::TraceEvent;
+using ome::files::TraceScope;
+using ome::files::TraceSink;
+
+namespace
+{
+
+  class CountingSink : public TraceSink
+  {
+  public:
+    std::vector<std::string> names;
+    std::vector<uint64_t> threads;
+
+    void
+    write(const TraceEvent& event)
+    {
+      names.push_back(event.name);
+      threads.push_back(event.thread);
+    }
+  };
+
+  std::string
+  readFile(const boost::filesystem::path& filename)
+  {
+    std::ifstream in(filename.string().c_str());
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+  }
+
+}
+
+TEST(Trace, NoSink)
+{
+  ome::files::setTraceSink(std::shared_ptr<TraceSink>());
+  ASSERT_FALSE(ome::files::getTraceSink());
+
+  // Must not fail without a sink.
+  TraceScope scope("test", "nosink");
+}
+
+TEST(Trace, Scope)
+{
+  std::shared_ptr<CountingSink> sink(std::make_shared<CountingSink>());
+  ome::files::setTraceSink(sink);
+  ASSERT_EQ(sink, ome::files::getTraceSink());
+
+  {
+    TraceScope outer("test", "outer");
+    {
+      TraceScope inner("test", "inner");
+    }
+    std::thread([](){ TraceScope thread("test", "thread"); }).join();
+  }
+
+  ome::files::setTraceSink(std::shared_ptr<TraceSink>());
+
+  {
+    TraceScope after("test", "after");
+  }
+
+  ASSERT_EQ(3U, sink->names.size());
+  EXPECT_EQ(std::string("inner"), sink->names[0]);
+  EXPECT_EQ(std::string("thread"), sink->names[1]);
+  EXPECT_EQ(std::string("outer"), sink->names[2]);
+  EXPECT_EQ(sink->threads[0], sink->threads[2]);
+  EXPECT_NE(sink->threads[0], sink->threads[1]);
+}
+
+TEST(Trace, ChromeJSON)
+{
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Image directory unavailable and could not be created");
+  boost::filesystem::path filename(dir / "trace.json");
+
+  {
+    std::shared_ptr<ChromeTraceSink> sink(std::make_shared<ChromeTraceSink>(filename));
+    sink->write(TraceEvent{"first", "test", 1500U, 2001U, 1U});
+    sink->write(TraceEvent{"second", "test", 4000000U, 7U, 2U});
+  }
+
+  EXPECT_EQ(std::string("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                        "{\"name\":\"first\",\"cat\":\"test\",\"ph\":\"X\",\"ts\":1.500,\"dur\":2.001,\"pid\":1,\"tid\":1},\n"
+                        "{\"name\":\"second\",\"cat\":\"test\",\"ph\":\"X\",\"ts\":4000.000,\"dur\":0.007,\"pid\":1,\"tid\":2}\n"
+                        "]}\n"),
+            readFile(filename));
+
+  boost::system::error_code ec;
+  boost::filesystem::remove(filename, ec);
+}
+
+TEST(Trace, ChromeInvalidPath)
+{
+  EXPECT_THROW(ChromeTraceSink(PROJECT_BINARY_DIR "/test/ome-files/nonexistent/dir/trace.json"),
+               std::runtime_error);
+}
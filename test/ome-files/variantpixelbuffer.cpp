@@ -36,6 +36,8 @@
  * #L%
  */
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 
@@ -1020,6 +1022,90 @@ TEST_P(VariantPixelBufferTest, StreamOutput)
   ome::compat::visit(v, buf.vbuffer());
 }
 
+TEST(VariantPixelBufferStorage, ReuseSmaller)
+{
+  VariantPixelBuffer buf;
+  EXPECT_EQ(0U, buf.capacity());
+
+  buf.setBuffer(boost::extents[8][8][1][1][1][1][1][1][1], PT::UINT16);
+  EXPECT_EQ(128U, buf.capacity());
+  const VariantPixelBuffer::raw_type *start = buf.data();
+
+  buf.setBuffer(boost::extents[4][4][1][1][1][1][1][1][1], PT::UINT16);
+  EXPECT_EQ(start, buf.data());
+  EXPECT_EQ(16U, buf.num_elements());
+
+  // Reuse with a different type, shape and order.
+  buf.setBuffer(boost::extents[8][4][1][1][1][1][1][1][1], PT::UINT32,
+                PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, false));
+  EXPECT_EQ(start, buf.data());
+  EXPECT_EQ(PT::UINT32, buf.pixelType());
+  EXPECT_EQ(128U, buf.capacity());
+
+  // Reused storage is value-initialised.
+  const uint32_t *values = buf.data<uint32_t>();
+  for (VariantPixelBuffer::size_type i = 0; i < buf.num_elements(); ++i)
+    EXPECT_EQ(0U, values[i]);
+
+  // Larger buffers need new storage.
+  buf.setBuffer(boost::extents[16][16][1][1][1][1][1][1][1], PT::UINT8);
+  EXPECT_EQ(256U, buf.capacity());
+}
+
+TEST(VariantPixelBufferStorage, SharedNotReused)
+{
+  VariantPixelBuffer buf;
+  buf.setBuffer(boost::extents[4][4][1][1][1][1][1][1][1], PT::UINT8);
+  std::fill(buf.data(), buf.data() + buf.num_elements(), 7U);
+  const VariantPixelBuffer::raw_type *start = buf.data();
+
+  // A shallow copy keeps the existing storage in use.
+  VariantPixelBuffer copy(buf);
+  buf.setBuffer(boost::extents[4][4][1][1][1][1][1][1][1], PT::UINT8);
+  EXPECT_NE(start, buf.data());
+  EXPECT_EQ(start, copy.data());
+  for (VariantPixelBuffer::size_type i = 0; i < copy.num_elements(); ++i)
+    EXPECT_EQ(7U, copy.data()[i]);
+}
+
+TEST(VariantPixelBufferStorage, Reserve)
+{
+  VariantPixelBuffer buf;
+  buf.reserve(1024U);
+  EXPECT_EQ(1024U, buf.capacity());
+
+  buf.setBuffer(boost::extents[32][32][1][1][1][1][1][1][1], PT::UINT8);
+  const VariantPixelBuffer::raw_type *start = buf.data();
+  buf.setBuffer(boost::extents[16][8][1][1][1][1][1][1][1], PT::DOUBLE);
+  EXPECT_EQ(start, buf.data());
+  buf.setBuffer(boost::extents[32][16][1][1][1][1][1][1][1], PT::INT16);
+  EXPECT_EQ(start, buf.data());
+
+  // Reserving less than the capacity does nothing.
+  buf.reserve(16U);
+  EXPECT_EQ(1024U, buf.capacity());
+  buf.setBuffer(boost::extents[2][2][1][1][1][1][1][1][1], PT::UINT8);
+  EXPECT_EQ(start, buf.data());
+}
+
+TEST(VariantPixelBufferCompare, FloatValues)
+{
+  VariantPixelBuffer buf1(boost::extents[64][64][1][1][1][1][1][1][1], PT::FLOAT);
+  VariantPixelBuffer buf2(boost::extents[64][64][1][1][1][1][1][1][1], PT::FLOAT);
+  EXPECT_TRUE(buf1 == buf2);
+
+  // Values are compared, not their representations.
+  buf1.data<float>()[100] = 0.0f;
+  buf2.data<float>()[100] = -0.0f;
+  EXPECT_TRUE(buf1 == buf2);
+
+  buf1.data<float>()[4000] = std::numeric_limits<float>::quiet_NaN();
+  buf2.data<float>()[4000] = std::numeric_limits<float>::quiet_NaN();
+  EXPECT_FALSE(buf1 == buf2);
+  EXPECT_FALSE(buf1 == buf1);
+  EXPECT_TRUE(buf1 != buf2);
+}
+
 const std::vector<VariantPixelBufferTestParameters> variant_params
   { // PixelType
     {PT::INT8},
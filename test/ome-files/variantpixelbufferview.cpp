@@ -0,0 +1,188 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <stdexcept>
+
+#include <ome/files/VariantPixelBuffer.h>
+#include <ome/files/VariantPixelBufferView.h>
+
+#include <ome/test/test.h>
+
+using ome::files::PixelBuffer;
+using ome::files::PixelBufferBase;
+using ome::files::PlaneRegion;
+using ome::files::VariantPixelBuffer;
+using ome::files::VariantPixelBufferView;
+typedef ome::xml::model::enums::PixelType PT;
+
+namespace
+{
+
+  typedef PixelBuffer<uint16_t> buffer_type;
+
+  // 6×4 buffer with 3 interleaved subchannels; each value encodes
+  // its x, y and subchannel coordinates.
+  void
+  fill(VariantPixelBuffer& buf)
+  {
+    buf.setBuffer(boost::extents[6][4][1][1][1][3][1][1][1], PT::UINT16,
+                  PixelBufferBase::make_storage_order(ome::xml::model::enums::DimensionOrder::XYZTC, true));
+    buffer_type& pb = *ome::compat::get<std::shared_ptr<buffer_type>>(buf.vbuffer());
+
+    buffer_type::indices_type idx;
+    idx.fill(0);
+    for (idx[ome::files::DIM_SPATIAL_Y] = 0; idx[ome::files::DIM_SPATIAL_Y] < 4; ++idx[ome::files::DIM_SPATIAL_Y])
+      for (idx[ome::files::DIM_SPATIAL_X] = 0; idx[ome::files::DIM_SPATIAL_X] < 6; ++idx[ome::files::DIM_SPATIAL_X])
+        for (idx[ome::files::DIM_SUBCHANNEL] = 0; idx[ome::files::DIM_SUBCHANNEL] < 3; ++idx[ome::files::DIM_SUBCHANNEL])
+          pb.at(idx) = static_cast<uint16_t>((idx[ome::files::DIM_SPATIAL_Y] * 100) +
+                                             (idx[ome::files::DIM_SPATIAL_X] * 10) +
+                                             idx[ome::files::DIM_SUBCHANNEL]);
+  }
+
+  uint16_t
+  value(const VariantPixelBuffer& buf,
+        PixelBufferBase::index    x,
+        PixelBufferBase::index    y,
+        PixelBufferBase::index    s)
+  {
+    const buffer_type& pb = *ome::compat::get<std::shared_ptr<buffer_type>>(buf.vbuffer());
+    buffer_type::indices_type idx;
+    idx.fill(0);
+    idx[ome::files::DIM_SPATIAL_X] = x;
+    idx[ome::files::DIM_SPATIAL_Y] = y;
+    idx[ome::files::DIM_SUBCHANNEL] = s;
+    return pb.at(idx);
+  }
+
+}
+
+TEST(VariantPixelBufferView, Whole)
+{
+  VariantPixelBuffer buf;
+  fill(buf);
+
+  VariantPixelBufferView view(buf);
+  EXPECT_EQ(PT::UINT16, view.pixelType());
+  EXPECT_EQ(buf.num_elements(), view.num_elements());
+
+  VariantPixelBuffer copy;
+  view.copyTo(copy, buf.storage_order());
+  EXPECT_TRUE(buf == copy);
+}
+
+TEST(VariantPixelBufferView, Crop)
+{
+  VariantPixelBuffer buf;
+  fill(buf);
+
+  VariantPixelBufferView view(buf, PlaneRegion(2, 1, 3, 2));
+  EXPECT_EQ(3U, view.shape()[ome::files::DIM_SPATIAL_X]);
+  EXPECT_EQ(2U, view.shape()[ome::files::DIM_SPATIAL_Y]);
+  EXPECT_EQ(3U, view.shape()[ome::files::DIM_SUBCHANNEL]);
+  EXPECT_EQ(18U, view.num_elements());
+
+  VariantPixelBuffer copy;
+  view.copyTo(copy);
+  for (PixelBufferBase::index y = 0; y < 2; ++y)
+    for (PixelBufferBase::index x = 0; x < 3; ++x)
+      for (PixelBufferBase::index s = 0; s < 3; ++s)
+        EXPECT_EQ(value(buf, x + 2, y + 1, s), value(copy, x, y, s));
+}
+
+TEST(VariantPixelBufferView, Subchannel)
+{
+  VariantPixelBuffer buf;
+  fill(buf);
+
+  VariantPixelBufferView view(buf, PlaneRegion(1, 0, 4, 3), 2);
+  EXPECT_EQ(4U, view.shape()[ome::files::DIM_SPATIAL_X]);
+  EXPECT_EQ(3U, view.shape()[ome::files::DIM_SPATIAL_Y]);
+  EXPECT_EQ(1U, view.shape()[ome::files::DIM_SUBCHANNEL]);
+
+  VariantPixelBuffer copy;
+  view.copyTo(copy);
+  for (PixelBufferBase::index y = 0; y < 3; ++y)
+    for (PixelBufferBase::index x = 0; x < 4; ++x)
+      EXPECT_EQ(value(buf, x + 1, y, 2), value(copy, x, y, 0));
+}
+
+TEST(VariantPixelBufferView, CopyFrom)
+{
+  VariantPixelBuffer buf;
+  fill(buf);
+
+  VariantPixelBuffer source(boost::extents[2][2][1][1][1][1][1][1][1], PT::UINT16);
+  buffer_type& pb = *ome::compat::get<std::shared_ptr<buffer_type>>(source.vbuffer());
+  std::fill(pb.data(), pb.data() + pb.num_elements(), 9999U);
+
+  VariantPixelBufferView view(buf, PlaneRegion(3, 2, 2, 2), 1);
+  view.copyFrom(source);
+
+  for (PixelBufferBase::index y = 0; y < 4; ++y)
+    for (PixelBufferBase::index x = 0; x < 6; ++x)
+      for (PixelBufferBase::index s = 0; s < 3; ++s)
+        {
+          bool inside = x >= 3 && x < 5 && y >= 2 && s == 1;
+          uint16_t expected = inside ? 9999U : static_cast<uint16_t>((y * 100) + (x * 10) + s);
+          EXPECT_EQ(expected, value(buf, x, y, s));
+        }
+}
+
+TEST(VariantPixelBufferView, OutOfRange)
+{
+  VariantPixelBuffer buf;
+  fill(buf);
+
+  EXPECT_THROW(VariantPixelBufferView(buf, PlaneRegion(4, 0, 3, 1)), std::logic_error);
+  EXPECT_THROW(VariantPixelBufferView(buf, PlaneRegion(0, 3, 1, 2)), std::logic_error);
+  EXPECT_THROW(VariantPixelBufferView(buf, PlaneRegion(0, 0, 1, 1), 3), std::logic_error);
+}
+
+TEST(VariantPixelBufferView, CopyFromMismatch)
+{
+  VariantPixelBuffer buf;
+  fill(buf);
+
+  VariantPixelBufferView view(buf, PlaneRegion(0, 0, 2, 2), 0);
+
+  VariantPixelBuffer wrongtype(boost::extents[2][2][1][1][1][1][1][1][1], PT::UINT8);
+  EXPECT_THROW(view.copyFrom(wrongtype), std::logic_error);
+
+  VariantPixelBuffer wrongshape(boost::extents[3][2][1][1][1][1][1][1][1], PT::UINT16);
+  EXPECT_THROW(view.copyFrom(wrongshape), std::logic_error);
+}
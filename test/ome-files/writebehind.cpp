@@ -0,0 +1,106 @@
+/*
+ * #%L
+ * OME-FILES C++ library for image IO.
+ * %%
+ * Copyright © 2018 Open Microscopy Environment:
+ *   - Massachusetts Institute of Technology
+ *   - National Institutes of Health
+ *   - University of Dundee
+ *   - Board of Regents of the University of Wisconsin-Madison
+ *   - Glencoe Software, Inc.
+ * %%
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of any organization.
+ * #L%
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#ifndef _MSC_VER
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <ome/files/detail/WriteBehind.h>
+
+#include <ome/test/config.h>
+#include <ome/test/test.h>
+
+using ome::files::detail::WriteBehind;
+
+TEST(WriteBehind, Window)
+{
+  EXPECT_EQ(1024U * 1024U, WriteBehind(-1, 1U).getWindow());
+  EXPECT_EQ(1024U * 1024U, WriteBehind(-1, 1024U * 1024U).getWindow());
+  EXPECT_EQ(2U * 1024U * 1024U, WriteBehind(-1, 1024U * 1024U + 1U).getWindow());
+
+  // No file; nothing is done.
+  WriteBehind stream(-1, 1U);
+  EXPECT_NO_THROW(stream.written(16U * 1024U * 1024U));
+  EXPECT_NO_THROW(stream.finish(16U * 1024U * 1024U));
+}
+
+#ifndef _MSC_VER
+
+TEST(WriteBehind, Write)
+{
+  boost::filesystem::path dir(PROJECT_BINARY_DIR "/test/ome-files/data");
+  if (!exists(dir) && !is_directory(dir) && !create_directories(dir))
+    throw std::runtime_error("Data directory unavailable and could not be created");
+  boost::filesystem::path filename(dir / "writebehind.bin");
+
+  int fd = ::open(filename.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  ASSERT_LE(0, fd);
+
+  // Write in chunks which do not align with the window, with a
+  // rewrite behind the current window.
+  std::vector<uint8_t> chunk(300U * 1024U);
+  std::vector<uint8_t> expected;
+  WriteBehind stream(fd, 1024U * 1024U);
+  for (unsigned int i = 0U; i < 20U; ++i)
+    {
+      std::fill(chunk.begin(), chunk.end(), static_cast<uint8_t>(i));
+      ASSERT_EQ(static_cast<ssize_t>(chunk.size()), ::write(fd, chunk.data(), chunk.size()));
+      expected.insert(expected.end(), chunk.begin(), chunk.end());
+      EXPECT_NO_THROW(stream.written(expected.size()));
+    }
+  const uint8_t header[4] = {1U, 2U, 3U, 4U};
+  ASSERT_EQ(4, ::pwrite(fd, header, 4U, 0));
+  std::copy(header, header + 4, expected.begin());
+  EXPECT_NO_THROW(stream.finish(expected.size()));
+  ::close(fd);
+
+  std::ifstream in(filename.string().c_str(), std::ios::in | std::ios::binary);
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  EXPECT_TRUE(data == expected);
+}
+
+#endif // ! _MSC_VER
@@ -66,6 +66,44 @@ TEST(XMLTools, Filter)
   ASSERT_EQ(expected, observed);
 }
 
+TEST(XMLTools, EscapeLarge)
+{
+  std::string plain;
+  for (int i = 0; i < 1000; ++i)
+    plain += "Metadata value without special characters. ";
+  EXPECT_EQ(plain, ome::files::escapeXML(plain));
+
+  std::string original(plain);
+  std::string expected(plain);
+  for (int i = 0; i < 37; ++i)
+    {
+      original += "<tag a='1'>x&y</tag>\"";
+      expected += "&lt;tag a=&apos;1&apos;&gt;x&amp;y&lt;/tag&gt;&quot;";
+    }
+  original += "tail";
+  expected += "tail";
+  EXPECT_EQ(expected, ome::files::escapeXML(original));
+}
+
+TEST(XMLTools, FilterLarge)
+{
+  std::string plain;
+  for (int i = 0; i < 1000; ++i)
+    plain += "Line of text\twith tab, & ampersand.\r\n";
+  EXPECT_EQ(plain, ome::files::sanitizeXML(plain));
+
+  std::string original(plain);
+  std::string expected(plain);
+  for (int i = 0; i < 37; ++i)
+    {
+      original += "ab\bc\x7F&#x41;\x01\x02 0123456789ABCDEF&";
+      expected += "abc&amp;#x41; 0123456789ABCDEF&";
+    }
+  original += "#end";
+  expected += "amp;#end";
+  EXPECT_EQ(expected, ome::files::sanitizeXML(original));
+}
+
 class XMLToolsFileTestParameters
 {
 public: